@@ -0,0 +1,163 @@
+#!/usr/bin/env python2
+# Copyright (c) 2018 SuperNET developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Latency benchmark of the heavy CC and index RPCs.
+#
+# Builds a regtest chain with --tokens tokens, --orders asks on the first one,
+# --utxos utxos on one address and --samples data samples of one oracle, then
+# sends --requests calls of each RPC from --concurrency connections and prints
+# one JSON line per RPC (also written to --output if given):
+#   {"rpc": ..., "requests": ..., "errors": ..., "rps": ..., "p50_ms": ..., "p90_ms": ..., "p99_ms": ..., "max_ms": ...}
+# The nspv_* RPCs are client side only, a server answers nSPV requests over p2p,
+# so they are not driven here. DEX_orderbook is skipped unless -dexp2p is on.
+# This is a benchmark, it is not part of pull-tester/rpc-tests.sh.
+#
+
+import json
+import threading
+import time
+
+from test_framework.test_framework import CryptoconditionsTestFramework
+from test_framework.authproxy import AuthServiceProxy, JSONRPCException
+
+
+class RPCLatencyBench(CryptoconditionsTestFramework):
+
+    def add_options(self, parser):
+        parser.add_option("--tokens", dest="tokens", default=100, type="int",
+                          help="Number of tokens to create (default: %default)")
+        parser.add_option("--orders", dest="orders", default=100, type="int",
+                          help="Number of asks on the first token (default: %default)")
+        parser.add_option("--utxos", dest="utxos", default=1000, type="int",
+                          help="Number of utxos on the benchmarked address (default: %default)")
+        parser.add_option("--samples", dest="samples", default=100, type="int",
+                          help="Number of oracle data samples (default: %default)")
+        parser.add_option("--requests", dest="requests", default=200, type="int",
+                          help="Calls of each RPC (default: %default)")
+        parser.add_option("--concurrency", dest="concurrency", default=4, type="int",
+                          help="Parallel RPC connections (default: %default)")
+        parser.add_option("--output", dest="output", default="",
+                          help="File to write the JSON results to")
+
+    def build_chain(self):
+        rpc = self.nodes[0]
+        opts = self.options
+
+        print("Creating %d tokens" % opts.tokens)
+        self.tokenids = []
+        for i in range(opts.tokens):
+            result = rpc.tokencreate("BENCH%d" % i, "1000", "benchmark token")
+            self.tokenids.append(rpc.sendrawtransaction(result['hex']))
+            if i % 50 == 49:
+                rpc.generate(1)
+        rpc.generate(1)
+
+        print("Placing %d asks" % opts.orders)
+        for i in range(opts.orders):
+            result = rpc.tokenask("1", self.tokenids[0], "0.0001")
+            rpc.sendrawtransaction(result['hex'])
+            if i % 50 == 49:
+                rpc.generate(1)
+        rpc.generate(1)
+
+        print("Making %d utxos" % opts.utxos)
+        self.benchaddr = self.addr1
+        for i in range(opts.utxos):
+            rpc.sendtoaddress(self.benchaddr, 0.0001)
+            if i % 100 == 99:
+                rpc.generate(1)
+        rpc.generate(1)
+
+        print("Publishing %d oracle samples" % opts.samples)
+        result = rpc.oraclescreate("Bench", "benchmark oracle", "s")
+        self.oracleid = self.send_and_mine(result['hex'], rpc)
+        result = rpc.oraclesregister(self.oracleid, "10000")
+        self.send_and_mine(result['hex'], rpc)
+        result = rpc.oraclessubscribe(self.oracleid, self.pubkey, "1")
+        self.send_and_mine(result['hex'], rpc)
+        for i in range(opts.samples):
+            result = rpc.oraclesdata(self.oracleid, "05416e746f6e")
+            self.send_and_mine(result['hex'], rpc)
+        self.batonaddr = rpc.oraclesinfo(self.oracleid)['registered'][0]['baton']
+
+    def run_rpc(self, name, params):
+        opts = self.options
+        latencies = []
+        errors = [0]
+        lock = threading.Lock()
+        todo = [opts.requests]
+
+        def worker():
+            proxy = AuthServiceProxy(self.nodes[0].url)
+            while True:
+                with lock:
+                    if todo[0] <= 0:
+                        return
+                    todo[0] -= 1
+                start = time.time()
+                try:
+                    getattr(proxy, name)(*params)
+                    failed = False
+                except JSONRPCException:
+                    failed = True
+                elapsed = time.time() - start
+                with lock:
+                    latencies.append(elapsed)
+                    if failed:
+                        errors[0] += 1
+
+        start = time.time()
+        threads = [threading.Thread(target=worker) for _ in range(max(opts.concurrency, 1))]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        duration = time.time() - start
+
+        latencies.sort()
+        def percentile(p):
+            return round(latencies[min(len(latencies) - 1, int(p * len(latencies)))] * 1000, 3) if latencies else 0
+        return {"rpc": name, "requests": len(latencies), "errors": errors[0], "concurrency": opts.concurrency,
+                "rps": round(len(latencies) / duration, 1) if duration > 0 else 0,
+                "p50_ms": percentile(0.5), "p90_ms": percentile(0.9), "p99_ms": percentile(0.99), "max_ms": percentile(1.0)}
+
+    def run_test(self):
+        rpc = self.nodes[0]
+        print("Mining blocks...")
+        rpc.generate(101)
+        self.sync_all()
+        rpc.importprivkey(self.privkey)
+        self.build_chain()
+
+        targets = [
+            ("tokenbalance", [self.tokenids[0], self.pubkey]),
+            ("tokenorders", [self.tokenids[0]]),
+            ("tokenlist", []),
+            ("oraclessamples", [self.oracleid, self.batonaddr, str(self.options.samples)]),
+            ("getaddressutxos", [{"addresses": [self.benchaddr]}]),
+            ("getaddressdeltas", [{"addresses": [self.benchaddr]}]),
+            ("getaddressbalance", [{"addresses": [self.benchaddr]}]),
+        ]
+        try:
+            rpc.DEX_stats()
+            targets.append(("DEX_orderbook", ["100", "0", "KMD", "BTC"]))
+        except JSONRPCException:
+            print("DEX_orderbook skipped, the node runs without -dexp2p")
+
+        results = []
+        for name, params in targets:
+            result = self.run_rpc(name, params)
+            print(json.dumps(result))
+            results.append(result)
+        if self.options.output:
+            with open(self.options.output, "w") as f:
+                json.dump({"tokens": self.options.tokens, "orders": self.options.orders,
+                           "utxos": self.options.utxos, "samples": self.options.samples,
+                           "results": results}, f, indent=2)
+
+
+if __name__ == '__main__':
+    RPCLatencyBench().main()
@@ -0,0 +1,117 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef ADDRESSBALANCEINDEX_H
+#define ADDRESSBALANCEINDEX_H
+
+#include "amount.h"
+#include "uint256.h"
+#include "serialize.h"
+
+extern bool fAddressBalanceIndex;  // if -addressbalanceindex is enabled
+
+// address balance index value, under the address index type and hash: the sum and number of the non zero unspent outputs
+struct CAddressBalanceValue {
+    CAmount satoshis;
+    int64_t utxos;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(satoshis);
+        READWRITE(utxos);
+    }
+
+    CAddressBalanceValue() : satoshis(0), utxos(0) {}
+};
+
+// rich list key: the balance of an address with non zero unspent outputs, followed by its address index type and hash
+struct CAddressRichListKey {
+    CAmount satoshis;
+    unsigned int type;
+    uint160 hashBytes;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 29;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        // Balances are stored big-endian for key sorting in LevelDB
+        ser_writedata32be(s, (uint32_t)((uint64_t)satoshis >> 32));
+        ser_writedata32be(s, (uint32_t)satoshis);
+        ser_writedata8(s, type);
+        hashBytes.Serialize(s);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        uint64_t high = ser_readdata32be(s);
+        satoshis = (CAmount)((high << 32) | ser_readdata32be(s));
+        type = ser_readdata8(s);
+        hashBytes.Unserialize(s);
+    }
+
+    CAddressRichListKey(CAmount amount, unsigned int addressType, uint160 addressHash) {
+        satoshis = amount;
+        type = addressType;
+        hashBytes = addressHash;
+    }
+
+    CAddressRichListKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        satoshis = 0;
+        type = 0;
+        hashBytes.SetNull();
+    }
+};
+
+// sums of the address balance index, CC addresses (type 3) are counted apart as the snapshots skip them
+struct CAddressBalanceTotals {
+    CAmount satoshis;
+    int64_t utxos;
+    int64_t addresses;
+    CAmount ccSatoshis;
+    int64_t ccUtxos;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(satoshis);
+        READWRITE(utxos);
+        READWRITE(addresses);
+        READWRITE(ccSatoshis);
+        READWRITE(ccUtxos);
+    }
+
+    CAddressBalanceTotals() : satoshis(0), utxos(0), addresses(0), ccSatoshis(0), ccUtxos(0) {}
+
+    void Add(unsigned int type, const CAddressBalanceValue &balance, int sign) {
+        if (type == 3) {
+            ccSatoshis += sign * balance.satoshis;
+            ccUtxos += sign * balance.utxos;
+        } else {
+            satoshis += sign * balance.satoshis;
+            utxos += sign * balance.utxos;
+            if (balance.utxos > 0)
+                addresses += sign;
+        }
+    }
+};
+
+#endif // #ifndef ADDRESSBALANCEINDEX_H
@@ -54,6 +54,11 @@ struct CMempoolAddressDeltaKey
         index = 0;
         spending = 0;
     }
+
+    friend bool operator==(const CMempoolAddressDeltaKey& a, const CMempoolAddressDeltaKey& b) {
+        return a.txhash == b.txhash && a.index == b.index && a.spending == b.spending &&
+            a.addressBytes == b.addressBytes && a.type == b.type;
+    }
 };
 
 struct CMempoolAddressDeltaKeyCompare
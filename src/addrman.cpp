@@ -160,6 +160,9 @@ void CAddrMan::ClearNew(int nUBucket, int nUBucketPos)
         assert(infoDelete.nRefCount > 0);
         infoDelete.nRefCount--;
         vvNew[nUBucket][nUBucketPos] = -1;
+        vNewBucketSize[nUBucket]--;
+        nNewPositions--;
+        nChanges++;
         if (infoDelete.nRefCount == 0) {
             Delete(nIdDelete);
         }
@@ -173,6 +176,8 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
         int pos = info.GetBucketPosition(nKey, true, bucket);
         if (vvNew[bucket][pos] == nId) {
             vvNew[bucket][pos] = -1;
+            vNewBucketSize[bucket]--;
+            nNewPositions--;
             info.nRefCount--;
         }
     }
@@ -194,6 +199,7 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
         // Remove the to-be-evicted item from the tried set.
         infoOld.fInTried = false;
         vvTried[nKBucket][nKBucketPos] = -1;
+        vTriedBucketSize[nKBucket]--;
         nTried--;
 
         // find which new bucket it belongs to
@@ -205,13 +211,17 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
         // Enter it into the new set again.
         infoOld.nRefCount = 1;
         vvNew[nUBucket][nUBucketPos] = nIdEvict;
+        vNewBucketSize[nUBucket]++;
+        nNewPositions++;
         nNew++;
     }
     assert(vvTried[nKBucket][nKBucketPos] == -1);
 
     vvTried[nKBucket][nKBucketPos] = nId;
+    vTriedBucketSize[nKBucket]++;
     nTried++;
     info.fInTried = true;
+    nChanges++;
 }
 
 void CAddrMan::Good_(const CService& addr, int64_t nTime)
@@ -233,6 +243,7 @@ void CAddrMan::Good_(const CService& addr, int64_t nTime)
     info.nLastSuccess = nTime;
     info.nLastTry = nTime;
     info.nAttempts = 0;
+    nChanges++;
     // nTime is not updated here, to avoid leaking information about
     // currently-connected peers.
 
@@ -276,11 +287,16 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
         // periodically update nTime
         bool fCurrentlyOnline = (GetTime() - addr.nTime < 24 * 60 * 60);
         int64_t nUpdateInterval = (fCurrentlyOnline ? 60 * 60 : 24 * 60 * 60);
-        if (addr.nTime && (!pinfo->nTime || pinfo->nTime < addr.nTime - nUpdateInterval - nTimePenalty))
+        if (addr.nTime && (!pinfo->nTime || pinfo->nTime < addr.nTime - nUpdateInterval - nTimePenalty)) {
             pinfo->nTime = std::max((int64_t)0, addr.nTime - nTimePenalty);
+            nChanges++;
+        }
 
         // add services
-        pinfo->nServices |= addr.nServices;
+        if ((pinfo->nServices | addr.nServices) != pinfo->nServices) {
+            pinfo->nServices |= addr.nServices;
+            nChanges++;
+        }
 
         // do not update if no new information is present
         if (!addr.nTime || (pinfo->nTime && addr.nTime <= pinfo->nTime))
@@ -304,6 +320,7 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
         pinfo = Create(addr, source, &nId);
         pinfo->nTime = std::max((int64_t)0, (int64_t)pinfo->nTime - nTimePenalty);
         nNew++;
+        nChanges++;
         fNew = true;
     }
 
@@ -322,6 +339,9 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
             ClearNew(nUBucket, nUBucketPos);
             pinfo->nRefCount++;
             vvNew[nUBucket][nUBucketPos] = nId;
+            vNewBucketSize[nUBucket]++;
+            nNewPositions++;
+            nChanges++;
         } else {
             if (pinfo->nRefCount == 0) {
                 Delete(nId);
@@ -348,6 +368,7 @@ void CAddrMan::Attempt_(const CService& addr, int64_t nTime)
     // update info
     info.nLastTry = nTime;
     info.nAttempts++;
+    nChanges++;
 }
 
 CAddrInfo CAddrMan::Select_(bool newOnly)
@@ -355,11 +376,6 @@ CAddrInfo CAddrMan::Select_(bool newOnly)
     if (size() == 0)
         return CAddrInfo();
 
-    // Track number of attempts to find a table entry, before giving up to avoid infinite loop
-    const int kMaxRetries = 200000;         // magic number so unit tests can pass
-    const int kRetriesBetweenSleep = 1000;
-    const int kRetrySleepInterval = 0;      // replaced 100 milliseconds to 0 to prevent long addrman lock
-
     if (newOnly && nNew == 0)
         return CAddrInfo();
 
@@ -369,18 +385,7 @@ CAddrInfo CAddrMan::Select_(bool newOnly)
         // use a tried node
         double fChanceFactor = 1.0;
         while (1) {
-            int i = 0;
-            int nKBucket = RandomInt(ADDRMAN_TRIED_BUCKET_COUNT);
-            int nKBucketPos = RandomInt(ADDRMAN_BUCKET_SIZE);
-            while (vvTried[nKBucket][nKBucketPos] == -1) {
-                nKBucket = (nKBucket + insecure_rand()) % ADDRMAN_TRIED_BUCKET_COUNT;
-                nKBucketPos = (nKBucketPos + insecure_rand()) % ADDRMAN_BUCKET_SIZE;
-                if (i++ > kMaxRetries)
-                    return CAddrInfo();
-                if (i % kRetriesBetweenSleep == 0 && !nKey.IsNull())
-                    MilliSleep(kRetrySleepInterval);
-            }
-            int nId = vvTried[nKBucket][nKBucketPos];
+            int nId = SelectPosition(vvTried, vTriedBucketSize, ADDRMAN_TRIED_BUCKET_COUNT, nTried);
             assert(mapInfo.count(nId) == 1);
             CAddrInfo& info = mapInfo[nId];
             if (RandomInt(1 << 30) < fChanceFactor * info.GetChance() * (1 << 30))
@@ -391,18 +396,7 @@ CAddrInfo CAddrMan::Select_(bool newOnly)
         // use a new node
         double fChanceFactor = 1.0;
         while (1) {
-            int i = 0;
-            int nUBucket = RandomInt(ADDRMAN_NEW_BUCKET_COUNT);
-            int nUBucketPos = RandomInt(ADDRMAN_BUCKET_SIZE);
-            while (vvNew[nUBucket][nUBucketPos] == -1) {
-                nUBucket = (nUBucket + insecure_rand()) % ADDRMAN_NEW_BUCKET_COUNT;
-                nUBucketPos = (nUBucketPos + insecure_rand()) % ADDRMAN_BUCKET_SIZE;
-                if (i++ > kMaxRetries)
-                    return CAddrInfo();
-                if (i % kRetriesBetweenSleep == 0 && !nKey.IsNull())
-                    MilliSleep(kRetrySleepInterval);
-            }
-            int nId = vvNew[nUBucket][nUBucketPos];
+            int nId = SelectPosition(vvNew, vNewBucketSize, ADDRMAN_NEW_BUCKET_COUNT, nNewPositions);
             assert(mapInfo.count(nId) == 1);
             CAddrInfo& info = mapInfo[nId];
             if (RandomInt(1 << 30) < fChanceFactor * info.GetChance() * (1 << 30))
@@ -414,6 +408,27 @@ CAddrInfo CAddrMan::Select_(bool newOnly)
     return CAddrInfo();
 }
 
+int CAddrMan::SelectPosition(const int vvTable[][ADDRMAN_BUCKET_SIZE], const int* vBucketSize, int nBuckets, int nPositions)
+{
+    // Walking the per-bucket counts replaces probing random positions until an
+    // occupied one turns up, which took many thousands of tries on sparse tables.
+    assert(nPositions > 0);
+    int nPos = RandomInt(nPositions);
+    for (int bucket = 0; bucket < nBuckets; bucket++) {
+        if (nPos >= vBucketSize[bucket]) {
+            nPos -= vBucketSize[bucket];
+            continue;
+        }
+        for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+            if (vvTable[bucket][i] != -1 && nPos-- == 0)
+                return vvTable[bucket][i];
+        }
+        break;
+    }
+    assert(false); // the per-bucket counts are out of sync with the tables
+    return -1;
+}
+
 #ifdef DEBUG_ADDRMAN
 int CAddrMan::Check_()
 {
@@ -455,8 +470,10 @@ int CAddrMan::Check_()
         return -10;
 
     for (int n = 0; n < ADDRMAN_TRIED_BUCKET_COUNT; n++) {
+        int nSize = 0;
         for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
              if (vvTried[n][i] != -1) {
+                 nSize++;
                  if (!setTried.count(vvTried[n][i]))
                      return -11;
                  if (mapInfo[vvTried[n][i]].GetTriedBucket(nKey, m_asmap) != n)
@@ -466,11 +483,16 @@ int CAddrMan::Check_()
                  setTried.erase(vvTried[n][i]);
              }
         }
+        if (vTriedBucketSize[n] != nSize)
+            return -20;
     }
 
+    int nPositions = 0;
     for (int n = 0; n < ADDRMAN_NEW_BUCKET_COUNT; n++) {
+        int nSize = 0;
         for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
             if (vvNew[n][i] != -1) {
+                nSize++;
                 if (!mapNew.count(vvNew[n][i]))
                     return -12;
                 if (mapInfo[vvNew[n][i]].GetBucketPosition(nKey, true, n) != i)
@@ -479,7 +501,12 @@ int CAddrMan::Check_()
                     mapNew.erase(vvNew[n][i]);
             }
         }
+        if (vNewBucketSize[n] != nSize)
+            return -21;
+        nPositions += nSize;
     }
+    if (nPositions != nNewPositions)
+        return -22;
 
     if (setTried.size())
         return -13;
@@ -555,8 +582,10 @@ void CAddrMan::Connected_(const CService& addr, int64_t nTime)
 
     // update info
     int64_t nUpdateInterval = 20 * 60;
-    if (nTime - info.nTime > nUpdateInterval)
+    if (nTime - info.nTime > nUpdateInterval) {
         info.nTime = nTime;
+        nChanges++;
+    }
 }
 
 int CAddrMan::RandomInt(int nMax){
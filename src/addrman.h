@@ -214,12 +214,24 @@ private:
     //! list of "tried" buckets
     int vvTried[ADDRMAN_TRIED_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
 
+    //! number of occupied positions in each "tried" bucket (they sum to nTried)
+    int vTriedBucketSize[ADDRMAN_TRIED_BUCKET_COUNT];
+
     //! number of (unique) "new" entries
     int nNew;
 
     //! list of "new" buckets
     int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
 
+    //! number of occupied positions in each "new" bucket
+    int vNewBucketSize[ADDRMAN_NEW_BUCKET_COUNT];
+
+    //! number of occupied positions in all "new" buckets (an entry may occupy several)
+    int nNewPositions;
+
+    //! incremented whenever anything that gets serialized changes
+    uint64_t nChanges;
+
 protected:
     //! secret key to randomize bucket select with
     uint256 nKey;
@@ -255,6 +267,9 @@ protected:
     //! Select an address to connect to, if newOnly is set to true, only the new table is selected from.
     CAddrInfo Select_(bool newOnly);
 
+    //! Pick one of the nPositions occupied positions of a table uniformly at random, returning its nId.
+    int SelectPosition(const int vvTable[][ADDRMAN_BUCKET_SIZE], const int* vBucketSize, int nBuckets, int nPositions);
+
     //! Wraps GetRandInt to allow tests to override RandomInt and make it deterministic.
     virtual int RandomInt(int nMax);
 
@@ -436,6 +451,7 @@ public:
                 mapInfo[nIdCount] = info;
                 mapAddr[info] = nIdCount;
                 vvTried[nKBucket][nKBucketPos] = nIdCount;
+                vTriedBucketSize[nKBucket]++;
                 nIdCount++;
             } else {
                 nLost++;
@@ -444,7 +460,7 @@ public:
         nTried -= nLost;
 
         // Store positions in the new table buckets to apply later (if possible).
-        std::map<int, int> entryToBucket; // Represents which entry belonged to which bucket when serializing
+        std::vector<int> entryToBucket(nNew, 0); // Represents which entry belonged to which bucket when serializing
 
         for (int bucket = 0; bucket < nUBuckets; bucket++) {
             int nSize = 0;
@@ -467,23 +483,30 @@ public:
             s >> serialized_asmap_version;
         }
 
+        bool fRebucket = !(nVersion == 2 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && serialized_asmap_version == supplied_asmap_version);
+        if (fRebucket) {
+            LogPrint("addrman", "Bucketing method was updated, re-bucketing addrman entries from disk\n");
+        }
+
         for (int n = 0; n < nNew; n++) {
             CAddrInfo &info = mapInfo[n];
             int bucket = entryToBucket[n];
-                    int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
-            if (nVersion == 2 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 &&
-                info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS && serialized_asmap_version == supplied_asmap_version) {
+            int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
+            if (!fRebucket && vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
                 // Bucketing has not changed, using existing bucket positions for the new table
                 vvNew[bucket][nUBucketPos] = n;
-                        info.nRefCount++;
+                vNewBucketSize[bucket]++;
+                nNewPositions++;
+                info.nRefCount++;
             } else {
                 // In case the new table data cannot be used (nVersion unknown, bucket count wrong or new asmap),
                 // try to give them a reference based on their primary source address.
-                LogPrint("addrman", "Bucketing method was updated, re-bucketing addrman entries from disk\n");
                 bucket = info.GetNewBucket(nKey, m_asmap);
                 nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
                 if (vvNew[bucket][nUBucketPos] == -1) {
                     vvNew[bucket][nUBucketPos] = n;
+                    vNewBucketSize[bucket]++;
+                    nNewPositions++;
                     info.nRefCount++;
                 }
             }
@@ -516,22 +539,26 @@ private:
             for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
                 vvNew[bucket][entry] = -1;
             }
+            vNewBucketSize[bucket] = 0;
         }
         for (size_t bucket = 0; bucket < ADDRMAN_TRIED_BUCKET_COUNT; bucket++) {
             for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
                 vvTried[bucket][entry] = -1;
             }
+            vTriedBucketSize[bucket] = 0;
         }
 
         nIdCount = 0;
         nTried = 0;
         nNew = 0;
+        nNewPositions = 0;
+        nChanges++;
         mapInfo.clear();
         mapAddr.clear();
     }
 
 public:
-    CAddrMan()
+    CAddrMan() : nChanges(0)
     {
         Clear_(); // use unlocked version bcz locked one caused boost: mutex lock failed in pthread_mutex_lock: Invalid argument exception because of static init concurrency (static dd_mutex has not been constructed yet)
     }
@@ -553,6 +580,13 @@ public:
         return vRandom.size();
     }
 
+    //! Return a counter that moves whenever the tables change, so callers can skip rewriting unchanged data.
+    uint64_t GetChangeCount()
+    {
+        LOCK(cs);
+        return nChanges;
+    }
+
     //! Consistency check
     void Check()
     {
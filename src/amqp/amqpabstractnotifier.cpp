@@ -19,3 +19,18 @@ bool AMQPAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool AMQPAbstractNotifier::NotifyCCEvent(const std::string &/*event*/)
+{
+    return true;
+}
+
+bool AMQPAbstractNotifier::NotifyTransactionRemoved(const CTransaction &/*transaction*/)
+{
+    return true;
+}
+
+bool AMQPAbstractNotifier::NotifyNotarized(const std::string &/*event*/)
+{
+    return true;
+}
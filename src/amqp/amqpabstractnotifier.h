@@ -34,6 +34,11 @@ public:
 
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    //! event is the JSON of CCEventToJSON, of a tx NotifyTransaction was called for
+    virtual bool NotifyCCEvent(const std::string &event);
+    virtual bool NotifyTransactionRemoved(const CTransaction &transaction);
+    //! event is the JSON of NotarizationEventToJSON
+    virtual bool NotifyNotarized(const std::string &event);
 
 protected:
     std::string type;
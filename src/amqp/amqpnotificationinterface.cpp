@@ -5,6 +5,7 @@
 #include "amqpnotificationinterface.h"
 #include "amqppublishnotifier.h"
 
+#include "cc/CCevents.h"
 #include "version.h"
 #include "main.h"
 #include "streams.h"
@@ -26,7 +27,7 @@
 // Like the ZMQ notification interface, if a notifier fails to send a message, the notifier is shut down.
 //
 
-AMQPNotificationInterface::AMQPNotificationInterface()
+AMQPNotificationInterface::AMQPNotificationInterface() : fCCEvents(false)
 {
 }
 
@@ -49,6 +50,9 @@ AMQPNotificationInterface* AMQPNotificationInterface::CreateWithArguments(const
     factories["pubhashtx"] = AMQPAbstractNotifier::Create<AMQPPublishHashTransactionNotifier>;
     factories["pubrawblock"] = AMQPAbstractNotifier::Create<AMQPPublishRawBlockNotifier>;
     factories["pubrawtx"] = AMQPAbstractNotifier::Create<AMQPPublishRawTransactionNotifier>;
+    factories["pubccevent"] = AMQPAbstractNotifier::Create<AMQPPublishCCEventNotifier>;
+    factories["pubremovedtx"] = AMQPAbstractNotifier::Create<AMQPPublishRemovedTransactionNotifier>;
+    factories["pubnotarized"] = AMQPAbstractNotifier::Create<AMQPPublishNotarizedNotifier>;
 
     for (std::map<std::string, AMQPNotifierFactory>::const_iterator i=factories.begin(); i!=factories.end(); ++i) {
         std::map<std::string, std::string>::const_iterator j = args.find("-amqp" + i->first);
@@ -65,6 +69,7 @@ AMQPNotificationInterface* AMQPNotificationInterface::CreateWithArguments(const
     if (!notifiers.empty()) {
         notificationInterface = new AMQPNotificationInterface();
         notificationInterface->notifiers = notifiers;
+        notificationInterface->fCCEvents = args.count("-amqppubccevent") != 0;
 
         if (!notificationInterface->Initialize()) {
             delete notificationInterface;
@@ -124,9 +129,45 @@ void AMQPNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
 
 void AMQPNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
 {
+    // decoded once for all the notifiers
+    std::string strCCEvent;
+    UniValue ccEvent;
+    if (fCCEvents && CCEventToJSON(tx, ccEvent)) {
+        if (pblock != nullptr)
+            ccEvent.push_back(Pair("blockhash", pblock->GetHash().GetHex()));
+        strCCEvent = ccEvent.write();
+    }
+
+    for (std::list<AMQPAbstractNotifier*>::iterator i = notifiers.begin(); i != notifiers.end(); ) {
+        AMQPAbstractNotifier *notifier = *i;
+        if (notifier->NotifyTransaction(tx) && (strCCEvent.empty() || notifier->NotifyCCEvent(strCCEvent))) {
+            i++;
+        } else {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void AMQPNotificationInterface::TransactionRemovedFromMempool(const CTransaction &tx)
+{
+    for (std::list<AMQPAbstractNotifier*>::iterator i = notifiers.begin(); i != notifiers.end(); ) {
+        AMQPAbstractNotifier *notifier = *i;
+        if (notifier->NotifyTransactionRemoved(tx)) {
+            i++;
+        } else {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void AMQPNotificationInterface::Notarized(int32_t height, int32_t notarizedHeight, const uint256 &notarizedHash, const uint256 &destTxid, const uint256 &txid)
+{
+    std::string strEvent = NotarizationEventToJSON(height, notarizedHeight, notarizedHash, destTxid, txid).write();
     for (std::list<AMQPAbstractNotifier*>::iterator i = notifiers.begin(); i != notifiers.end(); ) {
         AMQPAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx)) {
+        if (notifier->NotifyNotarized(strEvent)) {
             i++;
         } else {
             notifier->Shutdown();
@@ -26,10 +26,15 @@ protected:
     // CValidationInterface
     void SyncTransaction(const CTransaction &tx, const CBlock *pblock);
     void UpdatedBlockTip(const CBlockIndex *pindex);
+    void TransactionRemovedFromMempool(const CTransaction &tx);
+    void Notarized(int32_t height, int32_t notarizedHeight, const uint256 &notarizedHash, const uint256 &destTxid, const uint256 &txid);
 
 private:
     AMQPNotificationInterface();
 
+    //! whether a notifier publishes CC events, so the txs need decoding
+    bool fCCEvents;
+
     std::list<AMQPAbstractNotifier*> notifiers;
 };
 
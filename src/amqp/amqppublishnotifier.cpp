@@ -17,6 +17,9 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_CCEVENT   = "ccevent";
+static const char *MSG_REMOVEDTX = "removedtx";
+static const char *MSG_NOTARIZED = "notarized";
 
 // Invoke this method from a new thread to run the proton container event loop.
 void AMQPAbstractPublishNotifier::SpawnProtonContainer()
@@ -175,3 +178,25 @@ bool AMQPPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+bool AMQPPublishCCEventNotifier::NotifyCCEvent(const std::string &event)
+{
+    LogPrint("amqp", "amqp: Publish ccevent %s\n", event);
+    return SendMessage(MSG_CCEVENT, event.data(), event.size());
+}
+
+bool AMQPPublishRemovedTransactionNotifier::NotifyTransactionRemoved(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint("amqp", "amqp: Publish removedtx %s\n", hash.GetHex());
+    char data[32];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    return SendMessage(MSG_REMOVEDTX, data, 32);
+}
+
+bool AMQPPublishNotarizedNotifier::NotifyNotarized(const std::string &event)
+{
+    LogPrint("amqp", "amqp: Publish notarized %s\n", event);
+    return SendMessage(MSG_NOTARIZED, event.data(), event.size());
+}
@@ -53,4 +53,22 @@ public:
     bool NotifyTransaction(const CTransaction &transaction);
 };
 
+class AMQPPublishCCEventNotifier : public AMQPAbstractPublishNotifier
+{
+public:
+    bool NotifyCCEvent(const std::string &event);
+};
+
+class AMQPPublishRemovedTransactionNotifier : public AMQPAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionRemoved(const CTransaction &transaction);
+};
+
+class AMQPPublishNotarizedNotifier : public AMQPAbstractPublishNotifier
+{
+public:
+    bool NotifyNotarized(const std::string &event);
+};
+
 #endif // ZCASH_AMQP_AMQPPUBLISHNOTIFIER_H
@@ -47,11 +47,12 @@ AsyncRPCOperation::AsyncRPCOperation() : error_code_(0), error_message_() {
     boost::uuids::uuid uuid = uuidgen();
     id_ = "opid-" + boost::uuids::to_string(uuid);
     creation_time_ = (int64_t)time(NULL);
+    queue_time_ = std::chrono::system_clock::now();
     set_state(OperationStatus::READY);
 }
 
 AsyncRPCOperation::AsyncRPCOperation(const AsyncRPCOperation& o) :
-        id_(o.id_), creation_time_(o.creation_time_), state_(o.state_.load()),
+        id_(o.id_), creation_time_(o.creation_time_), queue_time_(o.queue_time_), state_(o.state_.load()),
         start_time_(o.start_time_), end_time_(o.end_time_),
         error_code_(o.error_code_), error_message_(o.error_message_),
         result_(o.result_)
@@ -61,6 +62,7 @@ AsyncRPCOperation::AsyncRPCOperation(const AsyncRPCOperation& o) :
 AsyncRPCOperation& AsyncRPCOperation::operator=( const AsyncRPCOperation& other ) {
     this->id_ = other.id_;
     this->creation_time_ = other.creation_time_;
+    this->queue_time_ = other.queue_time_;
     this->state_.store(other.state_.load());
     this->start_time_ = other.start_time_;
     this->end_time_ = other.end_time_;
@@ -170,6 +172,17 @@ UniValue AsyncRPCOperation::getStatus() const {
     obj.push_back(Pair("id", this->id_));
     obj.push_back(Pair("status", OperationStatusMap[status]));
     obj.push_back(Pair("creation_time", this->creation_time_));
+    // Time spent in the queue before the operation started, or so far
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        std::chrono::duration<double> queue_seconds(0);
+        if (status == OperationStatus::READY) {
+            queue_seconds = std::chrono::system_clock::now() - queue_time_;
+        } else if (start_time_ > queue_time_) {
+            queue_seconds = start_time_ - queue_time_;
+        }
+        obj.push_back(Pair("queue_secs", queue_seconds.count()));
+    }
     // TODO: Issue #1354: There may be other useful metadata to return to the user.
     UniValue err = this->getError();
     if (!err.isNull()) {
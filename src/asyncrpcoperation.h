@@ -76,6 +76,12 @@ public:
         return creation_time_;
     }
 
+    // The RPC method which created the operation, the AsyncRPCQueue applies
+    // its -rpcasyncpriority and -rpcasynclimit settings per method.
+    virtual std::string getMethod() const {
+        return std::string();
+    }
+
     // Override this method to add data to the default status object.
     virtual UniValue getStatus() const;
 
@@ -161,6 +167,7 @@ private:
     // Initialized in the operation constructor, never to be modified again.
     AsyncRPCOperationId id_;
     int64_t creation_time_;
+    std::chrono::time_point<std::chrono::system_clock> queue_time_;
 };
 
 #endif /* ASYNCRPCOPERATION_H */
@@ -19,6 +19,8 @@
 
 #include "asyncrpcqueue.h"
 
+#include <algorithm>
+
 static std::atomic<size_t> workerCounter(0);
 
 /**
@@ -43,46 +45,78 @@ AsyncRPCQueue::~AsyncRPCQueue() {
 void AsyncRPCQueue::run(size_t workerId) {
 
     while (true) {
-        AsyncRPCOperationId key;
         std::shared_ptr<AsyncRPCOperation> operation;
         {
             std::unique_lock<std::mutex> guard(lock_);
-            while (operation_id_queue_.empty() && !isClosed() && !isFinishing()) {
-                this->condition_.wait(guard);
-            }
-
-            // Exit if the queue is empty and we are finishing up
-            if (isFinishing() && operation_id_queue_.empty()) {
-                break;
-            }
+            while (true) {
+                // Exit if the queue is closing.
+                if (isClosed()) {
+                    operation_id_queue_.clear();
+                    return;
+                }
 
-            // Exit if the queue is closing.
-            if (isClosed()) {
-                while (!operation_id_queue_.empty()) {
-                    operation_id_queue_.pop();
+                operation = next_operation();
+                if (operation) {
+                    break;
                 }
-                break;
-            }
 
-            // Get operation id
-            key = operation_id_queue_.front();
-            operation_id_queue_.pop();
+                // Exit if the queue is empty and we are finishing up
+                if (isFinishing() && operation_id_queue_.empty()) {
+                    return;
+                }
 
-            // Search operation map
-            AsyncRPCOperationMap::const_iterator iter = operation_map_.find(key);
-            if (iter != operation_map_.end()) {
-                operation = iter->second;
+                // Wait for an operation to be added, or one to finish if
+                // the queued ones are all at the limit of their method
+                this->condition_.wait(guard);
             }
         }
 
-        if (!operation) {
-            // cannot find operation in map, may have been removed
-        } else if (operation->isCancelled()) {
-            // skip cancelled operation
-        } else {
+        if (!operation->isCancelled()) {
             operation->main();
         }
+
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            running_[operation->getMethod()]--;
+            this->condition_.notify_all();
+        }
+    }
+}
+
+/**
+ * The queued operation with the highest priority whose method is below its
+ * concurrency limit, the oldest one of those with equal priority.
+ */
+std::shared_ptr<AsyncRPCOperation> AsyncRPCQueue::next_operation() {
+    // Drop the operations removed from the map or cancelled while queued
+    operation_id_queue_.erase(std::remove_if(operation_id_queue_.begin(), operation_id_queue_.end(),
+        [this](const AsyncRPCOperationId& id) {
+            AsyncRPCOperationMap::const_iterator iter = operation_map_.find(id);
+            return iter == operation_map_.end() || iter->second->isCancelled();
+        }), operation_id_queue_.end());
+
+    std::deque<AsyncRPCOperationId>::iterator best = operation_id_queue_.end();
+    std::shared_ptr<AsyncRPCOperation> operation;
+    int bestPriority = 0;
+    for (std::deque<AsyncRPCOperationId>::iterator it = operation_id_queue_.begin(); it != operation_id_queue_.end(); ++it) {
+        AsyncRPCOperationMap::const_iterator iter = operation_map_.find(*it);
+        std::string method = iter->second->getMethod();
+        std::map<std::string, size_t>::const_iterator limit = limits_.find(method);
+        if (limit == limits_.end() || limit->second == 0 || running_[method] < limit->second) {
+            std::map<std::string, int>::const_iterator priority = priorities_.find(method);
+            int nPriority = priority == priorities_.end() ? 0 : priority->second;
+            if (!operation || nPriority > bestPriority) {
+                best = it;
+                operation = iter->second;
+                bestPriority = nPriority;
+            }
+        }
+    }
+    if (operation) {
+        operation_id_queue_.erase(best);
+        running_[operation->getMethod()]++;
     }
+    return operation;
 }
 
 
@@ -106,10 +140,28 @@ void AsyncRPCQueue::addOperation(const std::shared_ptr<AsyncRPCOperation> &ptrOp
 
     AsyncRPCOperationId id = ptrOperation->getId();
     operation_map_.emplace(id, ptrOperation);
-    operation_id_queue_.push(id);
+    operation_id_queue_.push_back(id);
     this->condition_.notify_one();
 }
 
+/**
+ * Set the priority of the operations of a method, higher ones run first.
+ */
+void AsyncRPCQueue::setPriority(const std::string& method, int priority) {
+    std::lock_guard<std::mutex> guard(lock_);
+    priorities_[method] = priority;
+    this->condition_.notify_all();
+}
+
+/**
+ * Set how many operations of a method may run at once, 0 for no limit.
+ */
+void AsyncRPCQueue::setConcurrencyLimit(const std::string& method, size_t limit) {
+    std::lock_guard<std::mutex> guard(lock_);
+    limits_[method] = limit;
+    this->condition_.notify_all();
+}
+
 /**
  * Return the operation for a given operation id.
  */
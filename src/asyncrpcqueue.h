@@ -25,7 +25,8 @@
 #include <iostream>
 #include <string>
 #include <chrono>
-#include <queue>
+#include <deque>
+#include <map>
 #include <unordered_map>
 #include <vector>
 #include <future>
@@ -65,10 +66,17 @@ public:
     void addOperation(const std::shared_ptr<AsyncRPCOperation> &ptrOperation);
     std::vector<AsyncRPCOperationId> getAllOperationIds() const;
 
+    // Operations of a method with a higher priority run first, the default is 0
+    void setPriority(const std::string& method, int priority);
+    // At most limit operations of a method run at once, 0 for no limit
+    void setConcurrencyLimit(const std::string& method, size_t limit);
+
 private:
     // addWorker() will spawn a new thread on run())
     void run(size_t workerId);
     void wait_for_worker_threads();
+    // Takes the next operation to run off the queue, if one may run now. Call with lock_ held.
+    std::shared_ptr<AsyncRPCOperation> next_operation();
 
     // Why this is not a recursive lock: http://www.zaval.org/resources/library/butenhof1.html
     mutable std::mutex lock_;
@@ -76,8 +84,11 @@ private:
     std::atomic<bool> closed_;
     std::atomic<bool> finish_;
     AsyncRPCOperationMap operation_map_;
-    std::queue <AsyncRPCOperationId> operation_id_queue_;
+    std::deque<AsyncRPCOperationId> operation_id_queue_;
     std::vector<std::thread> workers_;
+    std::map<std::string, int> priorities_;
+    std::map<std::string, size_t> limits_;
+    std::map<std::string, size_t> running_;
 };
 
 #endif
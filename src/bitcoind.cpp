@@ -72,8 +72,8 @@ void WaitForShutdown(boost::thread_group* threadGroup)
     if ( ASSETCHAINS_CBOPRET != 0 )
         komodo_pricesinit();
     /*
-        komodo_passport_iteration and komodo_cbopretupdate moved to a separate thread
-        ThreadUpdateKomodoInternals fired every second (see init.cpp), original wait
+        komodo_passport_iteration and komodo_cbopretupdate run from the scheduler
+        (see StartKomodoInternalsUpdater in init.cpp), original wait
         for shutdown loop restored.
     */
     while (!fShutdown)
@@ -0,0 +1,172 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2014 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "blockcompress.h"
+
+#include "crypto/common.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace {
+
+const size_t MIN_MATCH = 4;
+const size_t MAX_OFFSET = 0xffff;
+const int HASH_BITS = 14;
+
+inline uint32_t HashSequence(uint32_t nSeq)
+{
+    return (nSeq * 2654435761U) >> (32 - HASH_BITS);
+}
+
+void WriteLength(std::vector<unsigned char>& vOut, size_t nLen)
+{
+    while (nLen >= 255) {
+        vOut.push_back(255);
+        nLen -= 255;
+    }
+    vOut.push_back((unsigned char)nLen);
+}
+
+/** Append one sequence: literals followed by a match, or only literals if nMatch == 0 */
+void WriteSequence(std::vector<unsigned char>& vOut, const unsigned char* pLiterals, size_t nLiterals, size_t nOffset, size_t nMatch)
+{
+    size_t nMatchCode = nMatch ? nMatch - MIN_MATCH : 0;
+    vOut.push_back((unsigned char)((std::min<size_t>(nLiterals, 15) << 4) | std::min<size_t>(nMatchCode, 15)));
+    if (nLiterals >= 15)
+        WriteLength(vOut, nLiterals - 15);
+    vOut.insert(vOut.end(), pLiterals, pLiterals + nLiterals);
+    if (nMatch) {
+        vOut.push_back(nOffset & 0xff);
+        vOut.push_back(nOffset >> 8);
+        if (nMatchCode >= 15)
+            WriteLength(vOut, nMatchCode - 15);
+    }
+}
+
+bool ReadLength(const unsigned char*& p, const unsigned char* pEnd, size_t& nLen)
+{
+    unsigned char c;
+    do {
+        if (p == pEnd)
+            return false;
+        c = *p++;
+        nLen += c;
+    } while (c == 255);
+    return true;
+}
+
+}
+
+bool IsBlockDataFrame(const unsigned char* pch)
+{
+    return memcmp(pch, BLOCKDATA_FRAME_MAGIC, sizeof(BLOCKDATA_FRAME_MAGIC)) == 0;
+}
+
+bool CompressBlockData(const unsigned char* pch, size_t nSize, std::vector<unsigned char>& vFrame)
+{
+    vFrame.clear();
+    if (nSize <= BLOCKDATA_FRAME_HEADER_SIZE + MIN_MATCH || nSize > BLOCKDATA_MAX_RAW_SIZE)
+        return false;
+
+    vFrame.reserve(nSize);
+    vFrame.resize(BLOCKDATA_FRAME_HEADER_SIZE);
+    memcpy(&vFrame[0], BLOCKDATA_FRAME_MAGIC, sizeof(BLOCKDATA_FRAME_MAGIC));
+    WriteLE32(&vFrame[4], nSize);
+
+    // table of the last position + 1 at which each hashed 4-byte sequence was seen
+    std::vector<uint32_t> vTable(1 << HASH_BITS, 0);
+    size_t nAnchor = 0, i = 0;
+    while (i + MIN_MATCH <= nSize) {
+        uint32_t nSeq = ReadLE32(pch + i);
+        uint32_t& nSlot = vTable[HashSequence(nSeq)];
+        size_t nCandidate = nSlot;
+        nSlot = i + 1;
+        if (nCandidate == 0 || i - (nCandidate - 1) > MAX_OFFSET || ReadLE32(pch + nCandidate - 1) != nSeq) {
+            i++;
+            continue;
+        }
+        size_t nRef = nCandidate - 1, nMatch = MIN_MATCH;
+        while (i + nMatch < nSize && pch[nRef + nMatch] == pch[i + nMatch])
+            nMatch++;
+        WriteSequence(vFrame, pch + nAnchor, i - nAnchor, i - nRef, nMatch);
+        i += nMatch;
+        nAnchor = i;
+        if (vFrame.size() >= nSize)
+            break;
+    }
+    if (vFrame.size() < nSize)
+        WriteSequence(vFrame, pch + nAnchor, nSize - nAnchor, 0, 0);
+
+    if (vFrame.size() >= nSize) {
+        vFrame.clear();
+        return false;
+    }
+    WriteLE32(&vFrame[8], vFrame.size() - BLOCKDATA_FRAME_HEADER_SIZE);
+    return true;
+}
+
+bool ParseBlockDataFrameHeader(const unsigned char* pch, uint32_t& nRawSize, uint32_t& nCompressedSize)
+{
+    if (!IsBlockDataFrame(pch))
+        return false;
+    nRawSize = ReadLE32(pch + 4);
+    nCompressedSize = ReadLE32(pch + 8);
+    return nRawSize <= BLOCKDATA_MAX_RAW_SIZE && nCompressedSize < nRawSize;
+}
+
+bool DecompressBlockData(const unsigned char* pch, size_t nCompressedSize, uint32_t nRawSize, std::vector<unsigned char>& vData)
+{
+    vData.clear();
+    if (nRawSize > BLOCKDATA_MAX_RAW_SIZE)
+        return false;
+    vData.reserve(nRawSize);
+
+    const unsigned char* p = pch;
+    const unsigned char* pEnd = pch + nCompressedSize;
+    while (p < pEnd) {
+        unsigned char nToken = *p++;
+        size_t nLiterals = nToken >> 4;
+        if (nLiterals == 15 && !ReadLength(p, pEnd, nLiterals))
+            return false;
+        if (nLiterals > (size_t)(pEnd - p) || nLiterals > nRawSize - vData.size())
+            return false;
+        vData.insert(vData.end(), p, p + nLiterals);
+        p += nLiterals;
+        if (p == pEnd)
+            break; // the last sequence has no match
+
+        if (pEnd - p < 2)
+            return false;
+        size_t nOffset = p[0] | (p[1] << 8);
+        p += 2;
+        size_t nMatch = nToken & 0x0f;
+        if (nMatch == 15 && !ReadLength(p, pEnd, nMatch))
+            return false;
+        nMatch += MIN_MATCH;
+        if (nOffset == 0 || nOffset > vData.size() || nMatch > nRawSize - vData.size())
+            return false;
+        // matches may overlap the bytes they produce, so copy one byte at a time
+        size_t nFrom = vData.size() - nOffset;
+        for (size_t j = 0; j < nMatch; j++)
+            vData.push_back(vData[nFrom + j]);
+    }
+    return vData.size() == nRawSize;
+}
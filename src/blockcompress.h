@@ -0,0 +1,58 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2014 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef KOMODO_BLOCKCOMPRESS_H
+#define KOMODO_BLOCKCOMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Optional compressed record format for blk?????.dat and rev?????.dat.
+ *
+ * A compressed record replaces the serialized block or undo data that follows
+ * the usual message start and size fields with a frame:
+ *   magic (4 bytes) | raw size (LE32) | compressed size (LE32) | LZ77 stream
+ * Read as a raw block the magic would be a negative nVersion, read as raw undo
+ * data a 64-bit vector size, so readers can tell both formats apart by the
+ * first four bytes and files may mix them freely.
+ */
+static const unsigned char BLOCKDATA_FRAME_MAGIC[4] = { 0xff, 'K', 'Z', 0xff };
+static const unsigned int BLOCKDATA_FRAME_HEADER_SIZE = 12;
+/** Largest raw record size a frame may announce */
+static const uint32_t BLOCKDATA_MAX_RAW_SIZE = 64 * 1024 * 1024;
+
+/** Whether the first four bytes of a record mark it as a compressed frame */
+bool IsBlockDataFrame(const unsigned char* pch);
+
+/**
+ * Compress nSize bytes into a complete frame. Returns false, leaving vFrame
+ * empty, if the frame would not be smaller than the input.
+ */
+bool CompressBlockData(const unsigned char* pch, size_t nSize, std::vector<unsigned char>& vFrame);
+
+/** Parse a frame header, returning the raw and compressed payload sizes */
+bool ParseBlockDataFrameHeader(const unsigned char* pch, uint32_t& nRawSize, uint32_t& nCompressedSize);
+
+/** Decompress the payload of a frame (without its header) into vData */
+bool DecompressBlockData(const unsigned char* pch, size_t nCompressedSize, uint32_t nRawSize, std::vector<unsigned char>& vData);
+
+#endif // KOMODO_BLOCKCOMPRESS_H
@@ -0,0 +1,317 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "blockfilter.h"
+
+#include "crypto/common.h"
+#include "hash.h"
+#include "komodo_defs.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "streams.h"
+#include "undo.h"
+#include "version.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string.h>
+
+namespace {
+
+/// writes bit strings most significant bit first, as BIP 158 orders them
+class CBitWriter
+{
+private:
+    std::vector<unsigned char>& vch;
+    uint8_t nBuffer;
+    int nOffset;    //!< bits of nBuffer used
+
+public:
+    explicit CBitWriter(std::vector<unsigned char>& vchIn) : vch(vchIn), nBuffer(0), nOffset(0) {}
+
+    /// the nBits low bits of data, nBits <= 64
+    void Write(uint64_t data, int nBits)
+    {
+        while (nBits > 0)
+        {
+            int bits = std::min(8 - nOffset, nBits);
+            nBuffer |= ((data >> (nBits - bits)) & ((1U << bits) - 1)) << (8 - nOffset - bits);
+            nOffset += bits;
+            nBits -= bits;
+            if (nOffset == 8)
+                Flush();
+        }
+    }
+
+    /// pads the last byte with zero bits
+    void Flush()
+    {
+        if (nOffset == 0)
+            return;
+        vch.push_back(nBuffer);
+        nBuffer = 0;
+        nOffset = 0;
+    }
+};
+
+class CBitReader
+{
+private:
+    const unsigned char* p;
+    const unsigned char* pend;
+    uint8_t nBuffer;
+    int nOffset;    //!< bits of nBuffer read
+
+public:
+    CBitReader(const unsigned char* pbegin, const unsigned char* pendIn) : p(pbegin), pend(pendIn), nBuffer(0), nOffset(8) {}
+
+    uint64_t Read(int nBits)
+    {
+        uint64_t data = 0;
+        while (nBits > 0)
+        {
+            if (nOffset == 8) {
+                if (p == pend)
+                    throw std::ios_base::failure("end of filter data");
+                nBuffer = *p++;
+                nOffset = 0;
+            }
+            int bits = std::min(8 - nOffset, nBits);
+            data <<= bits;
+            data |= (nBuffer >> (8 - nOffset - bits)) & ((1U << bits) - 1);
+            nOffset += bits;
+            nBits -= bits;
+        }
+        return data;
+    }
+};
+
+void GolombRiceEncode(CBitWriter& writer, uint8_t nP, uint64_t x)
+{
+    // the quotient in unary, ones ended by a zero
+    uint64_t q = x >> nP;
+    while (q > 0)
+    {
+        int nBits = q <= 64 ? (int)q : 64;
+        writer.Write(~0ULL, nBits);
+        q -= nBits;
+    }
+    writer.Write(0, 1);
+    writer.Write(x, nP);
+}
+
+uint64_t GolombRiceDecode(CBitReader& reader, uint8_t nP)
+{
+    uint64_t q = 0;
+    while (reader.Read(1) == 1)
+        q++;
+    uint64_t r = reader.Read(nP);
+    return (q << nP) + r;
+}
+
+/// the high 64 bits of x * n, maps a uniform 64 bit hash into [0, n)
+uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+#ifdef __SIZEOF_INT128__
+    return (uint64_t)(((unsigned __int128)x * n) >> 64);
+#else
+    uint64_t xHi = x >> 32, xLo = x & 0xFFFFFFFF;
+    uint64_t nHi = n >> 32, nLo = n & 0xFFFFFFFF;
+    uint64_t lolo = xLo * nLo, lohi = xLo * nHi, hilo = xHi * nLo, hihi = xHi * nHi;
+    uint64_t carry = ((lolo >> 32) + (lohi & 0xFFFFFFFF) + (hilo & 0xFFFFFFFF)) >> 32;
+    return hihi + (lohi >> 32) + (hilo >> 32) + carry;
+#endif
+}
+
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn) : params(paramsIn), nN(0), nF(0)
+{
+    CVectorWriter writer(vEncoded, SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(writer, 0);
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn, const std::vector<unsigned char>& vEncodedIn) : params(paramsIn), vEncoded(vEncodedIn)
+{
+    CSpanReader reader(vEncoded, SER_NETWORK, PROTOCOL_VERSION);
+    uint64_t nElements = ReadCompactSize(reader);
+    if (nElements > std::numeric_limits<uint32_t>::max())
+        throw std::ios_base::failure("N must be < 2^32");
+    nN = (uint32_t)nElements;
+    nF = (uint64_t)nN * params.nM;
+
+    // checks the encoding holds N elements, so a match never reads past it
+    CBitReader bits(vEncoded.data() + GetSizeOfCompactSize(nN), vEncoded.data() + vEncoded.size());
+    for (uint32_t i = 0; i < nN; i++)
+        GolombRiceDecode(bits, params.nP);
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn, const ElementSet& elements) : params(paramsIn)
+{
+    if (elements.size() > std::numeric_limits<uint32_t>::max())
+        throw std::invalid_argument("N must be < 2^32");
+    nN = (uint32_t)elements.size();
+    nF = (uint64_t)nN * params.nM;
+
+    CVectorWriter writer(vEncoded, SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(writer, nN);
+    if (elements.empty())
+        return;
+    CBitWriter bits(vEncoded);
+    uint64_t nLast = 0;
+    for (uint64_t value : HashedSet(elements))
+    {
+        GolombRiceEncode(bits, params.nP, value - nLast);
+        nLast = value;
+    }
+    bits.Flush();
+}
+
+uint64_t GCSFilter::HashToRange(const Element& element) const
+{
+    uint64_t hash = SipHashBytes(params.nSipHashK0, params.nSipHashK1, element.data(), element.size());
+    return MapIntoRange(hash, nF);
+}
+
+std::vector<uint64_t> GCSFilter::HashedSet(const ElementSet& elements) const
+{
+    std::vector<uint64_t> vHashed;
+    vHashed.reserve(elements.size());
+    for (const Element& element : elements)
+        vHashed.push_back(HashToRange(element));
+    std::sort(vHashed.begin(), vHashed.end());
+    return vHashed;
+}
+
+bool GCSFilter::MatchHashes(std::vector<uint64_t>& vQueries) const
+{
+    if (nN == 0 || vQueries.empty())
+        return false;
+    std::sort(vQueries.begin(), vQueries.end());
+
+    CBitReader bits(vEncoded.data() + GetSizeOfCompactSize(nN), vEncoded.data() + vEncoded.size());
+
+    // both are sorted, a single merge pass decides
+    uint64_t value = 0;
+    size_t nQuery = 0;
+    for (uint32_t i = 0; i < nN; i++)
+    {
+        value += GolombRiceDecode(bits, params.nP);
+        while (vQueries[nQuery] < value)
+            if (++nQuery == vQueries.size())
+                return false;
+        if (vQueries[nQuery] == value)
+            return true;
+    }
+    return false;
+}
+
+bool GCSFilter::Match(const Element& element) const
+{
+    std::vector<uint64_t> vQueries(1, HashToRange(element));
+    return MatchHashes(vQueries);
+}
+
+bool GCSFilter::MatchAny(const ElementSet& elements) const
+{
+    std::vector<uint64_t> vQueries;
+    vQueries.reserve(elements.size());
+    for (const Element& element : elements)
+        vQueries.push_back(HashToRange(element));
+    return MatchHashes(vQueries);
+}
+
+const std::string& BlockFilterTypeName(BlockFilterType filterType)
+{
+    static const std::string strBasic = "basic", strUnknown = "";
+    return filterType == BLOCK_FILTER_BASIC ? strBasic : strUnknown;
+}
+
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filterType)
+{
+    if (name == BlockFilterTypeName(BLOCK_FILTER_BASIC)) {
+        filterType = BLOCK_FILTER_BASIC;
+        return true;
+    }
+    return false;
+}
+
+static void BasicFilterAddScript(const CScript& scriptPubKey, GCSFilter::ElementSet& elements)
+{
+    if (scriptPubKey.empty() || scriptPubKey[0] == OP_RETURN)
+        return;
+    elements.insert(GCSFilter::Element(scriptPubKey.begin(), scriptPubKey.end()));
+    if (scriptPubKey.IsPayToCryptoCondition())
+    {
+        char destaddr[KOMODO_ADDRESS_BUFSIZE];
+        if (Getscriptaddress(destaddr, scriptPubKey))
+            elements.insert(GCSFilter::Element((unsigned char*)destaddr, (unsigned char*)destaddr + strlen(destaddr)));
+    }
+}
+
+static GCSFilter::ElementSet BasicFilterElements(const CBlock& block, const CBlockUndo& blockUndo)
+{
+    GCSFilter::ElementSet elements;
+
+    for (const CTransaction& tx : block.vtx)
+        for (const CTxOut& txout : tx.vout)
+            BasicFilterAddScript(txout.scriptPubKey, elements);
+    for (const CTxUndo& txundo : blockUndo.vtxundo)
+        for (const CTxInUndo& prevout : txundo.vprevout)
+            BasicFilterAddScript(prevout.txout.scriptPubKey, elements);
+    return elements;
+}
+
+bool BlockFilter::BuildParams(GCSFilter::Params& params) const
+{
+    if (filterType != BLOCK_FILTER_BASIC)
+        return false;
+    params.nSipHashK0 = ReadLE64(blockHash.begin());
+    params.nSipHashK1 = ReadLE64(blockHash.begin() + 8);
+    params.nP = BASIC_FILTER_P;
+    params.nM = BASIC_FILTER_M;
+    return true;
+}
+
+BlockFilter::BlockFilter(BlockFilterType filterTypeIn, const CBlock& block, const CBlockUndo& blockUndo) :
+    filterType(filterTypeIn), blockHash(block.GetHash())
+{
+    GCSFilter::Params params;
+    if (!BuildParams(params))
+        throw std::invalid_argument("unknown filter type");
+    filter = GCSFilter(params, BasicFilterElements(block, blockUndo));
+}
+
+BlockFilter::BlockFilter(BlockFilterType filterTypeIn, const uint256& blockHashIn, const std::vector<unsigned char>& vEncoded) :
+    filterType(filterTypeIn), blockHash(blockHashIn)
+{
+    GCSFilter::Params params;
+    if (!BuildParams(params))
+        throw std::ios_base::failure("unknown filter type");
+    filter = GCSFilter(params, vEncoded);
+}
+
+uint256 BlockFilter::GetHash() const
+{
+    const std::vector<unsigned char>& vEncoded = filter.GetEncoded();
+    return Hash(vEncoded.begin(), vEncoded.end());
+}
+
+uint256 BlockFilter::ComputeHeader(const uint256& prevHeader) const
+{
+    const uint256 filterHash = GetHash();
+    return Hash(filterHash.begin(), filterHash.end(), prevHeader.begin(), prevHeader.end());
+}
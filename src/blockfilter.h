@@ -0,0 +1,144 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef BITCOIN_BLOCKFILTER_H
+#define BITCOIN_BLOCKFILTER_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+
+/**
+ * Golomb-coded set of BIP 158: the elements are hashed into [0, N * M) with
+ * SipHash, sorted, and the deltas written Golomb-Rice coded with P low bits.
+ * The encoding is the CompactSize N followed by the bit stream.
+ */
+class GCSFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::set<Element> ElementSet;
+
+    struct Params
+    {
+        uint64_t nSipHashK0;
+        uint64_t nSipHashK1;
+        uint8_t nP;     //!< Golomb-Rice coding parameter
+        uint32_t nM;    //!< inverse false positive rate
+
+        Params(uint64_t nK0 = 0, uint64_t nK1 = 0, uint8_t nPIn = 0, uint32_t nMIn = 1) :
+            nSipHashK0(nK0), nSipHashK1(nK1), nP(nPIn), nM(nMIn) {}
+    };
+
+private:
+    Params params;
+    uint32_t nN;        //!< number of elements
+    uint64_t nF;        //!< range of the element hashes, N * M
+    std::vector<unsigned char> vEncoded;
+
+    uint64_t HashToRange(const Element& element) const;
+    std::vector<uint64_t> HashedSet(const ElementSet& elements) const;
+    bool MatchHashes(std::vector<uint64_t>& vQueries) const;
+
+public:
+    explicit GCSFilter(const Params& paramsIn = Params());
+    /** decodes a filter, throws std::ios_base::failure if it is not one */
+    GCSFilter(const Params& paramsIn, const std::vector<unsigned char>& vEncodedIn);
+    GCSFilter(const Params& paramsIn, const ElementSet& elements);
+
+    uint32_t GetN() const { return nN; }
+    const Params& GetParams() const { return params; }
+    const std::vector<unsigned char>& GetEncoded() const { return vEncoded; }
+
+    /** true if the element is in the set, or for a false positive with a 1/M chance */
+    bool Match(const Element& element) const;
+    /** true if any of the elements is in the set, a single pass over the filter */
+    bool MatchAny(const ElementSet& elements) const;
+};
+
+enum BlockFilterType : uint8_t
+{
+    BLOCK_FILTER_BASIC = 0,
+};
+
+/** BIP 158 basic filter parameters */
+static const uint8_t BASIC_FILTER_P = 19;
+static const uint32_t BASIC_FILTER_M = 784931;
+
+/** the name of the filter type in the RPC and REST paths, empty if it is not one */
+const std::string& BlockFilterTypeName(BlockFilterType filterType);
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filterType);
+
+/**
+ * Block filter of a block, keyed by the first 16 bytes of its hash. The basic
+ * filter holds the scriptPubKeys of the outputs, except empty and OP_RETURN ones,
+ * and of the outputs spent by the block. For a cc scriptPubKey the cc address
+ * string is added too, as nSPV clients only know the cc addresses they watch.
+ */
+class BlockFilter
+{
+private:
+    BlockFilterType filterType;
+    uint256 blockHash;
+    GCSFilter filter;
+
+    bool BuildParams(GCSFilter::Params& params) const;
+
+public:
+    BlockFilter() : filterType(BLOCK_FILTER_BASIC) {}
+    /** blockUndo is empty for the genesis block */
+    BlockFilter(BlockFilterType filterTypeIn, const CBlock& block, const CBlockUndo& blockUndo);
+    /** rebuilds a filter read from the index or the network, throws std::ios_base::failure on a bad encoding */
+    BlockFilter(BlockFilterType filterTypeIn, const uint256& blockHashIn, const std::vector<unsigned char>& vEncoded);
+
+    BlockFilterType GetFilterType() const { return filterType; }
+    const uint256& GetBlockHash() const { return blockHash; }
+    const GCSFilter& GetFilter() const { return filter; }
+    const std::vector<unsigned char>& GetEncodedFilter() const { return filter.GetEncoded(); }
+
+    /** double sha256 of the encoded filter */
+    uint256 GetHash() const;
+    /** the filter header chains the filter hashes, the genesis block has a null prevHeader */
+    uint256 ComputeHeader(const uint256& prevHeader) const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        uint8_t nFilterType = filterType;
+        std::vector<unsigned char> vEncoded;
+        if (!ser_action.ForRead())
+            vEncoded = filter.GetEncoded();
+        READWRITE(nFilterType);
+        READWRITE(blockHash);
+        READWRITE(vEncoded);
+        if (ser_action.ForRead()) {
+            filterType = (BlockFilterType)nFilterType;
+            GCSFilter::Params params;
+            if (!BuildParams(params))
+                throw std::ios_base::failure("unknown filter type");
+            filter = GCSFilter(params, vEncoded);
+        }
+    }
+};
+
+#endif // BITCOIN_BLOCKFILTER_H
@@ -0,0 +1,297 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "blockfilterindex.h"
+
+#include "chain.h"
+#include "dbwrapper.h"
+#include "main.h"
+#include "ui_interface.h"
+#include "undo.h"
+#include "util.h"
+
+#include <boost/signals2/connection.hpp>
+#include <boost/thread.hpp>
+
+static const char DB_FILTER = 'f';
+static const char DB_BEST = 'B';
+
+// blocks read by the index thread between two writes of its best block
+static const unsigned int BLOCKFILTERINDEX_RUN_BLOCKS = 256;
+
+namespace {
+
+/// the filter of a block, with its hash and header so getcfheaders does not decode it
+struct CBlockFilterEntry
+{
+    int nHeight;
+    std::vector<unsigned char> vEncoded;
+    uint256 hash;
+    uint256 header;
+
+    CBlockFilterEntry() : nHeight(-1) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nHeight);
+        READWRITE(vEncoded);
+        READWRITE(hash);
+        READWRITE(header);
+    }
+};
+
+CDBWrapper *pfilterdb = NULL;
+boost::mutex cs_filterindex;
+boost::condition_variable condFilterIndexTip;
+boost::signals2::connection connFilterIndexTip;
+CBlockFilterIndexStatus filterIndexStatus;
+
+}
+
+static bool ReadFilterEntry(const uint256& hash, CBlockFilterEntry& entry)
+{
+    return pfilterdb != NULL && pfilterdb->Read(std::make_pair(DB_FILTER, hash), entry);
+}
+
+static void FilterIndexSetStatus(const CBlockIndex* pbest, int nTipHeight)
+{
+    boost::unique_lock<boost::mutex> lock(cs_filterindex);
+    filterIndexStatus.nHeight = pbest != NULL ? pbest->GetHeight() : -1;
+    filterIndexStatus.nTipHeight = nTipHeight;
+}
+
+// the filter entry of pindex, prevHeader is the header of its parent
+static bool FilterIndexBuildEntry(const CBlockIndex* pindex, const uint256& prevHeader, CBlockFilterEntry& entry)
+{
+    CBlock block;
+    CBlockUndo blockUndo;
+
+    if (!ReadBlockFromDisk(block, pindex, 1))
+        return error("%s: failed to read block %s", __func__, pindex->GetBlockHash().ToString());
+    // the genesis block spends nothing and has no undo data
+    if (pindex->pprev != NULL && !ReadBlockUndoFromDisk(blockUndo, pindex))
+        return error("%s: failed to read undo data of %s", __func__, pindex->GetBlockHash().ToString());
+
+    BlockFilter filter(BLOCK_FILTER_BASIC, block, blockUndo);
+    entry.nHeight = pindex->GetHeight();
+    entry.vEncoded = filter.GetEncodedFilter();
+    entry.hash = filter.GetHash();
+    entry.header = filter.ComputeHeader(prevHeader);
+    return true;
+}
+
+static void ThreadBlockFilterIndex()
+{
+    RenameThread("komodo-filterindex");
+
+    const CBlockIndex *pbest = NULL;
+    uint256 headerBest;
+    {
+        LOCK(cs_main);
+        uint256 hashBest;
+        CBlockFilterEntry entry;
+        if (pfilterdb->Read(DB_BEST, hashBest) && ReadFilterEntry(hashBest, entry))
+        {
+            BlockMap::iterator mi = mapBlockIndex.find(hashBest);
+            if (mi != mapBlockIndex.end()) {
+                pbest = mi->second;
+                headerBest = entry.header;
+            }
+        }
+        FilterIndexSetStatus(pbest, chainActive.Height());
+    }
+    LogPrintf("%s: building block filters from height %d\n", __func__, pbest != NULL ? pbest->GetHeight() + 1 : 0);
+
+    try {
+        while (true)
+        {
+            boost::this_thread::interruption_point();
+
+            std::vector<const CBlockIndex*> vBlocks;
+            {
+                LOCK(cs_main);
+                // the entries of the disconnected blocks are left, they are keyed by hash
+                if (pbest != NULL && !chainActive.Contains(pbest))
+                {
+                    CBlockFilterEntry entry;
+                    pbest = chainActive.FindFork(pbest);
+                    if (pbest != NULL && !ReadFilterEntry(pbest->GetBlockHash(), entry))
+                    {
+                        LogPrintf("%s: no filter for the fork %s, index stopped\n", __func__, pbest->GetBlockHash().ToString());
+                        return;
+                    }
+                    headerBest = pbest != NULL ? entry.header : uint256();
+                    if (pbest != NULL)
+                        pfilterdb->Write(DB_BEST, pbest->GetBlockHash());
+                    else
+                        pfilterdb->Erase(DB_BEST);
+                }
+                for (int nHeight = pbest != NULL ? pbest->GetHeight() + 1 : 0; nHeight <= chainActive.Height() && vBlocks.size() < BLOCKFILTERINDEX_RUN_BLOCKS; nHeight++)
+                    vBlocks.push_back(chainActive[nHeight]);
+                FilterIndexSetStatus(pbest, chainActive.Height());
+            }
+
+            if (vBlocks.empty())
+            {
+                // at the tip, woken up by the next one
+                boost::unique_lock<boost::mutex> lock(cs_filterindex);
+                condFilterIndexTip.timed_wait(lock, boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(10));
+                continue;
+            }
+
+            // written with the best block in one batch, a block disconnected meanwhile is handled by the next pass
+            CDBBatch batch(*pfilterdb);
+            for (const CBlockIndex *pindex : vBlocks)
+            {
+                CBlockFilterEntry entry;
+                if (!FilterIndexBuildEntry(pindex, headerBest, entry))
+                {
+                    LogPrintf("%s: failed to build the filter of %s, index stopped\n", __func__, pindex->GetBlockHash().ToString());
+                    return;
+                }
+                batch.Write(std::make_pair(DB_FILTER, pindex->GetBlockHash()), entry);
+                headerBest = entry.header;
+                pbest = pindex;
+            }
+            batch.Write(DB_BEST, pbest->GetBlockHash());
+            if (!pfilterdb->WriteBatch(batch))
+            {
+                LogPrintf("%s: failed to write the filters up to %s, index stopped\n", __func__, pbest->GetBlockHash().ToString());
+                return;
+            }
+        }
+    } catch (const boost::thread_interrupted&) {
+        LogPrintf("%s: interrupted at height %d\n", __func__, pbest != NULL ? pbest->GetHeight() : -1);
+        throw;
+    }
+}
+
+bool InitBlockFilterIndex(size_t nCacheSize, bool fWipe)
+{
+    const std::string& strName = BlockFilterTypeName(BLOCK_FILTER_BASIC);
+    try {
+        pfilterdb = new CDBWrapper(GetDataDir() / "indexes" / "blockfilter" / strName, nCacheSize, false, fWipe);
+    } catch (const std::exception& e) {
+        return error("%s: failed to open the %s block filter index: %s", __func__, strName, e.what());
+    }
+    boost::unique_lock<boost::mutex> lock(cs_filterindex);
+    filterIndexStatus.fEnabled = true;
+    return true;
+}
+
+void StartBlockFilterIndex(boost::thread_group& threadGroup)
+{
+    if (pfilterdb == NULL)
+        return;
+    connFilterIndexTip = uiInterface.NotifyBlockTip.connect([](const uint256&) {
+        condFilterIndexTip.notify_all();
+    });
+    threadGroup.create_thread(&ThreadBlockFilterIndex);
+}
+
+void DestroyBlockFilterIndex()
+{
+    connFilterIndexTip.disconnect();
+    delete pfilterdb;
+    pfilterdb = NULL;
+    boost::unique_lock<boost::mutex> lock(cs_filterindex);
+    filterIndexStatus = CBlockFilterIndexStatus();
+}
+
+bool IsBlockFilterIndexEnabled()
+{
+    return pfilterdb != NULL;
+}
+
+CBlockFilterIndexStatus GetBlockFilterIndexStatus()
+{
+    boost::unique_lock<boost::mutex> lock(cs_filterindex);
+    return filterIndexStatus;
+}
+
+bool LookupBlockFilter(BlockFilterType filterType, const CBlockIndex* pindex, BlockFilter& filter)
+{
+    CBlockFilterEntry entry;
+    if (filterType != BLOCK_FILTER_BASIC || !ReadFilterEntry(pindex->GetBlockHash(), entry))
+        return false;
+    try {
+        filter = BlockFilter(filterType, pindex->GetBlockHash(), entry.vEncoded);
+    } catch (const std::exception& e) {
+        return error("%s: bad filter of %s: %s", __func__, pindex->GetBlockHash().ToString(), e.what());
+    }
+    return true;
+}
+
+bool LookupBlockFilterHeader(BlockFilterType filterType, const CBlockIndex* pindex, uint256& header)
+{
+    CBlockFilterEntry entry;
+    if (filterType != BLOCK_FILTER_BASIC || !ReadFilterEntry(pindex->GetBlockHash(), entry))
+        return false;
+    header = entry.header;
+    return true;
+}
+
+// the ancestors of pstop from nStartHeight, in height order
+static bool FilterIndexRange(int nStartHeight, const CBlockIndex* pstop, std::vector<const CBlockIndex*>& vBlocks)
+{
+    if (nStartHeight < 0 || pstop == NULL || nStartHeight > pstop->GetHeight())
+        return false;
+    vBlocks.resize(pstop->GetHeight() - nStartHeight + 1);
+    for (const CBlockIndex *pindex = pstop; pindex != NULL && pindex->GetHeight() >= nStartHeight; pindex = pindex->pprev)
+        vBlocks[pindex->GetHeight() - nStartHeight] = pindex;
+    return true;
+}
+
+bool LookupBlockFilterRange(BlockFilterType filterType, int nStartHeight, const CBlockIndex* pstop, std::vector<BlockFilter>& filters)
+{
+    std::vector<const CBlockIndex*> vBlocks;
+    if (!FilterIndexRange(nStartHeight, pstop, vBlocks))
+        return false;
+    filters.resize(vBlocks.size());
+    for (size_t i = 0; i < vBlocks.size(); i++)
+        if (!LookupBlockFilter(filterType, vBlocks[i], filters[i]))
+            return false;
+    return true;
+}
+
+bool LookupBlockFilterHashRange(BlockFilterType filterType, int nStartHeight, const CBlockIndex* pstop, std::vector<uint256>& hashes)
+{
+    std::vector<const CBlockIndex*> vBlocks;
+    if (filterType != BLOCK_FILTER_BASIC || !FilterIndexRange(nStartHeight, pstop, vBlocks))
+        return false;
+    hashes.resize(vBlocks.size());
+    for (size_t i = 0; i < vBlocks.size(); i++)
+    {
+        CBlockFilterEntry entry;
+        if (!ReadFilterEntry(vBlocks[i]->GetBlockHash(), entry))
+            return false;
+        hashes[i] = entry.hash;
+    }
+    return true;
+}
+
+bool LookupBlockFilterHeaderRange(BlockFilterType filterType, int nStartHeight, const CBlockIndex* pstop, std::vector<uint256>& headers)
+{
+    std::vector<const CBlockIndex*> vBlocks;
+    if (!FilterIndexRange(nStartHeight, pstop, vBlocks))
+        return false;
+    headers.resize(vBlocks.size());
+    for (size_t i = 0; i < vBlocks.size(); i++)
+        if (!LookupBlockFilterHeader(filterType, vBlocks[i], headers[i]))
+            return false;
+    return true;
+}
@@ -0,0 +1,79 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef BITCOIN_BLOCKFILTERINDEX_H
+#define BITCOIN_BLOCKFILTERINDEX_H
+
+#include "blockfilter.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <vector>
+
+class CBlockIndex;
+
+namespace boost {
+    class thread_group;
+}
+
+/** -blockfilterindex default: maintain the basic compact block filters of the active chain */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+/** most MiB of the -dbcache given to the filter index database */
+static const int64_t MAX_FILTER_INDEX_CACHE = 1024;
+/** -peerblockfilters default: serve the filters to peers, with NODE_COMPACT_FILTERS */
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
+/** most filters of a getcfilters request, as BIP 157 */
+static const int MAX_GETCFILTERS_SIZE = 1000;
+/** most filter headers of a getcfheaders request, as BIP 157 */
+static const int MAX_GETCFHEADERS_SIZE = 2000;
+/** the filter headers of a cfcheckpt are of every interval-th block */
+static const int CFCHECKPT_INTERVAL = 1000;
+
+struct CBlockFilterIndexStatus
+{
+    bool fEnabled;
+    int nHeight;        //!< height of the last block indexed, -1 before the genesis block
+    int nTipHeight;
+
+    CBlockFilterIndexStatus() : fEnabled(false), nHeight(-1), nTipHeight(-1) {}
+};
+
+/**
+ * Compact block filter index of BIP 157 and 158, a companion of the nSPV
+ * server: a light client downloads the filters and matches its scripts and
+ * cc addresses itself, instead of asking the server for the txids and utxos
+ * of its addresses.
+ *
+ * The filters and their headers are kept in their own database under
+ * indexes/blockfilter/<type>, by block hash. A thread builds them from the
+ * block and undo files of the active chain and then follows its tip, after
+ * a reorg it goes back to the fork. The filter headers commit to the filters
+ * of all blocks up to theirs, a client checks them across several peers.
+ */
+bool InitBlockFilterIndex(size_t nCacheSize, bool fWipe);
+void StartBlockFilterIndex(boost::thread_group& threadGroup);
+void DestroyBlockFilterIndex();
+bool IsBlockFilterIndexEnabled();
+CBlockFilterIndexStatus GetBlockFilterIndexStatus();
+
+/** the lookups fail for a block that is not indexed yet */
+bool LookupBlockFilter(BlockFilterType filterType, const CBlockIndex* pindex, BlockFilter& filter);
+bool LookupBlockFilterHeader(BlockFilterType filterType, const CBlockIndex* pindex, uint256& header);
+/** the filters or headers of the ancestors of pstop from nStartHeight up to pstop */
+bool LookupBlockFilterRange(BlockFilterType filterType, int nStartHeight, const CBlockIndex* pstop, std::vector<BlockFilter>& filters);
+bool LookupBlockFilterHashRange(BlockFilterType filterType, int nStartHeight, const CBlockIndex* pstop, std::vector<uint256>& hashes);
+bool LookupBlockFilterHeaderRange(BlockFilterType filterType, int nStartHeight, const CBlockIndex* pstop, std::vector<uint256>& headers);
+
+#endif // BITCOIN_BLOCKFILTERINDEX_H
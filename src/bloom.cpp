@@ -148,7 +148,67 @@ bool CBloomFilter::IsWithinSizeConstraints() const
     return vData.size() <= MAX_BLOOM_FILTER_SIZE && nHashFuncs <= MAX_HASH_FUNCS;
 }
 
+static void GetDataPushes(const CScript& script, vector<vector<unsigned char> >& vPushes)
+{
+    CScript::const_iterator pc = script.begin();
+    vector<unsigned char> data;
+    while (pc < script.end())
+    {
+        opcodetype opcode;
+        if (!script.GetOp(pc, opcode, data))
+            break;
+        if (data.size() != 0)
+            vPushes.push_back(data);
+    }
+}
+
+CBloomTxData::CBloomTxData(const CTransaction& tx) : hash(tx.GetHash())
+{
+    vout.resize(tx.vout.size());
+    for (unsigned int i = 0; i < tx.vout.size(); i++)
+    {
+        const CScript& scriptPubKey = tx.vout[i].scriptPubKey;
+        GetDataPushes(scriptPubKey, vout[i].vPushes);
+        txnouttype type;
+        vector<vector<unsigned char> > vSolutions;
+        vout[i].fPubKeyOrMultisig = !vout[i].vPushes.empty() && Solver(scriptPubKey, type, vSolutions) &&
+            (type == TX_PUBKEY || type == TX_MULTISIG);
+    }
+    vin.resize(tx.vin.size());
+    for (unsigned int i = 0; i < tx.vin.size(); i++)
+    {
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << tx.vin[i].prevout;
+        vin[i].vPrevout.assign(stream.begin(), stream.end());
+        GetDataPushes(tx.vin[i].scriptSig, vin[i].vPushes);
+    }
+}
+
+size_t CBloomTxData::DynamicMemoryUsage() const
+{
+    size_t nUsage = vout.capacity() * sizeof(OutputData) + vin.capacity() * sizeof(InputData);
+    BOOST_FOREACH(const OutputData& out, vout)
+        BOOST_FOREACH(const vector<unsigned char>& data, out.vPushes)
+            nUsage += sizeof(data) + data.capacity();
+    BOOST_FOREACH(const InputData& in, vin)
+    {
+        nUsage += in.vPrevout.capacity();
+        BOOST_FOREACH(const vector<unsigned char>& data, in.vPushes)
+            nUsage += sizeof(data) + data.capacity();
+    }
+    return nUsage;
+}
+
 bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
+{
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    return IsRelevantAndUpdate(CBloomTxData(tx));
+}
+
+bool CBloomFilter::IsRelevantAndUpdate(const CBloomTxData& txdata)
 {
     bool fFound = false;
     // Match if the filter contains the hash of tx
@@ -157,37 +217,26 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
         return true;
     if (isEmpty)
         return false;
-    const uint256& hash = tx.GetHash();
+    const uint256& hash = txdata.hash;
     if (contains(hash))
         fFound = true;
 
-    for (unsigned int i = 0; i < tx.vout.size(); i++)
+    for (unsigned int i = 0; i < txdata.vout.size(); i++)
     {
-        const CTxOut& txout = tx.vout[i];
+        const CBloomTxData::OutputData& out = txdata.vout[i];
         // Match if the filter contains any arbitrary script data element in any scriptPubKey in tx
         // If this matches, also add the specific output that was matched.
         // This means clients don't have to update the filter themselves when a new relevant tx 
         // is discovered in order to find spending transactions, which avoids round-tripping and race conditions.
-        CScript::const_iterator pc = txout.scriptPubKey.begin();
-        vector<unsigned char> data;
-        while (pc < txout.scriptPubKey.end())
+        BOOST_FOREACH(const vector<unsigned char>& data, out.vPushes)
         {
-            opcodetype opcode;
-            if (!txout.scriptPubKey.GetOp(pc, opcode, data))
-                break;
-            if (data.size() != 0 && contains(data))
+            if (contains(data))
             {
                 fFound = true;
                 if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
                     insert(COutPoint(hash, i));
-                else if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY)
-                {
-                    txnouttype type;
-                    vector<vector<unsigned char> > vSolutions;
-                    if (Solver(txout.scriptPubKey, type, vSolutions) &&
-                            (type == TX_PUBKEY || type == TX_MULTISIG))
-                        insert(COutPoint(hash, i));
-                }
+                else if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY && out.fPubKeyOrMultisig)
+                    insert(COutPoint(hash, i));
                 break;
             }
         }
@@ -196,23 +245,16 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     if (fFound)
         return true;
 
-    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    BOOST_FOREACH(const CBloomTxData::InputData& in, txdata.vin)
     {
         // Match if the filter contains an outpoint tx spends
-        if (contains(txin.prevout))
+        if (contains(in.vPrevout))
             return true;
 
         // Match if the filter contains any arbitrary script data element in any scriptSig in tx
-        CScript::const_iterator pc = txin.scriptSig.begin();
-        vector<unsigned char> data;
-        while (pc < txin.scriptSig.end())
-        {
-            opcodetype opcode;
-            if (!txin.scriptSig.GetOp(pc, opcode, data))
-                break;
-            if (data.size() != 0 && contains(data))
+        BOOST_FOREACH(const vector<unsigned char>& data, in.vPushes)
+            if (contains(data))
                 return true;
-        }
     }
 
     return false;
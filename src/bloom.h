@@ -21,12 +21,12 @@
 #define BITCOIN_BLOOM_H
 
 #include "serialize.h"
+#include "uint256.h"
 
 #include <vector>
 
 class COutPoint;
 class CTransaction;
-class uint256;
 
 //! 20,000 items with fp rate < 0.1% or 10,000 items and <0.0001%
 static const unsigned int MAX_BLOOM_FILTER_SIZE = 36000; // bytes
@@ -45,6 +45,40 @@ enum bloomflags
     BLOOM_UPDATE_MASK = 3,
 };
 
+/**
+ * What a bloom filter matches a transaction on, decoded once: the data pushes
+ * of its scripts and its txid and spent outpoints in the byte form they are
+ * hashed in. Built once for a block being served, it is matched against the
+ * filters of any number of peers without parsing its scripts again.
+ */
+class CBloomTxData
+{
+public:
+    struct OutputData
+    {
+        //! non-empty data pushes of the scriptPubKey, up to the first bad opcode
+        std::vector<std::vector<unsigned char> > vPushes;
+        //! pay-to-pubkey or pay-to-multisig, the outputs BLOOM_UPDATE_P2PUBKEY_ONLY adds
+        bool fPubKeyOrMultisig;
+    };
+    struct InputData
+    {
+        //! serialized prevout
+        std::vector<unsigned char> vPrevout;
+        //! non-empty data pushes of the scriptSig, up to the first bad opcode
+        std::vector<std::vector<unsigned char> > vPushes;
+    };
+
+    uint256 hash;
+    std::vector<OutputData> vout;
+    std::vector<InputData> vin;
+
+    explicit CBloomTxData(const CTransaction& tx);
+
+    //! Rough heap bytes, to bound caches of decoded blocks
+    size_t DynamicMemoryUsage() const;
+};
+
 /**
  * BloomFilter is a probabilistic filter which SPV clients provide
  * so that we can filter the transactions we send them.
@@ -112,6 +146,7 @@ public:
 
     //! Also adds any outputs which match the filter to the filter (to match their spending txes)
     bool IsRelevantAndUpdate(const CTransaction& tx);
+    bool IsRelevantAndUpdate(const CBloomTxData& txdata);
 
     //! Checks for empty and full filters to avoid wasting cpu
     void UpdateEmptyFull();
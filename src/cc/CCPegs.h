@@ -19,6 +19,8 @@
 
 #include "CCinclude.h"
 
+uint8_t DecodePegsOpRet(CTransaction tx,uint256& pegstxid,uint256& tokenid);
+std::string PegsDecodeAccountTx(CTransaction tx,CPubKey& pk,int64_t &amount,std::pair<int64_t,int64_t> &account);
 bool PegsValidate(struct CCcontract_info *cp,Eval* eval,const CTransaction &tx, uint32_t nIn);
 
 // CCcustom
@@ -71,7 +71,7 @@ bool AgreementsValidate(struct CCcontract_info *cp, Eval* eval, const CTransacti
 /// @param cp CCcontract_info object with Agreements CC variables (global CC address, global private key, etc.)
 /// @param eventtxid [out] the latest event's transaction id. If no events exists for agreementtxid, returns agreementtxid.
 /// @returns funcid of eventtxid if it is found, else returns (uint8_t)0.
-uint8_t FindLatestAgreementEvent(uint256 agreementtxid, struct CCcontract_info *cp, uint256 &eventtxid);
+uint8_t FindLatestAgreementEvent(uint256 agreementtxid, struct CCcontract_info *cp, uint256 &eventtxid, std::vector<std::pair<uint256,uint8_t>> *pchain = nullptr);
 
 UniValue AgreementCreate(const CPubKey& pk, uint64_t txfee, std::vector<uint8_t> destkey, std::string agreementname, std::string agreementmemo, \
 uint8_t offerflags, uint256 refagreementtxid, int64_t deposit, int64_t payment, int64_t disputefee, std::vector<uint8_t> arbkey, std::vector<std::vector<uint8_t>> unlockconds);
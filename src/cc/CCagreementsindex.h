@@ -0,0 +1,37 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_AGREEMENTSINDEX_H
+#define CC_AGREEMENTSINDEX_H
+
+class CBlock;
+class CBlockIndex;
+
+extern bool fAgreementsIndex;  // if -agreementsindex is enabled
+
+/**
+ * Agreements index: each agreement with its events (closures, disputes,
+ * dispute cancels, resolutions and unlocks) and the agreements referencing
+ * it, in chain order, so the agreements queries find the latest event and
+ * the references without loading every event and agreement tx.
+ *
+ * Txns are added when their block is connected and erased when it is
+ * disconnected. Only confirmed txns are indexed, FindLatestAgreementEvent
+ * continues from the last indexed event with the spent index as before.
+ */
+bool AgreementsIndexConnectBlock(const CBlock &block, const CBlockIndex *pindex);     // in agreements.cpp
+bool AgreementsIndexDisconnectBlock(const CBlock &block, const CBlockIndex *pindex);
+
+#endif // CC_AGREEMENTSINDEX_H
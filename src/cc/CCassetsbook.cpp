@@ -0,0 +1,292 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCassetsbook.h"
+
+#include "CCassets.h"
+#include "main.h"
+
+#include <map>
+#include <boost/thread.hpp>
+
+namespace {
+
+class CAssetsBook
+{
+private:
+    struct AssetOrders {
+        std::multimap<CAmount, uint256> bids;  //!< by unit price
+        std::multimap<CAmount, uint256> asks;
+    };
+    std::map<uint256, AssetsBookOrder> mapOrders;  //!< by txid
+    std::map<uint256, AssetOrders> mapAssets;      //!< by assetid
+    bool fBuilt;
+    uint256 hashTip;
+    std::string globaladdr, globaltokenaddr;
+
+    static bool IsBid(uint8_t funcid) { return funcid == 'b' || funcid == 'B'; }
+
+    std::multimap<CAmount, uint256> &Side(const AssetsBookOrder &order)
+    {
+        AssetOrders &asset = mapAssets[order.assetid];
+        return IsBid(order.funcid) ? asset.bids : asset.asks;
+    }
+
+    void Clear()
+    {
+        mapOrders.clear();
+        mapAssets.clear();
+        fBuilt = false;
+    }
+
+    void Erase(const uint256 &txid)
+    {
+        std::map<uint256, AssetsBookOrder>::iterator it = mapOrders.find(txid);
+        if (it == mapOrders.end())
+            return;
+        std::multimap<CAmount, uint256> &side = Side(it->second);
+        auto range = side.equal_range(it->second.unit_price);
+        for (auto itSide = range.first; itSide != range.second; itSide++)
+            if (itSide->second == txid) {
+                side.erase(itSide);
+                break;
+            }
+        AssetOrders &asset = mapAssets[it->second.assetid];
+        if (asset.bids.empty() && asset.asks.empty())
+            mapAssets.erase(it->second.assetid);
+        mapOrders.erase(it);
+    }
+
+    void Insert(const AssetsBookOrder &order)
+    {
+        if (mapOrders.count(order.txid) != 0)
+            return;
+        mapOrders[order.txid] = order;
+        Side(order).insert(std::make_pair(order.unit_price, order.txid));
+    }
+
+    /// decodes tx as an order open on its ASSETS_GLOBALADDR_VOUT, as AssetOrders did for each global address utxo
+    bool DecodeOrder(const CTransaction &tx, int32_t nHeight, AssetsBookOrder &order)
+    {
+        char destaddr[KOMODO_ADDRESS_BUFSIZE];
+        uint8_t evalCode;
+
+        if (tx.vout.size() < 2 || tx.vout[ASSETS_GLOBALADDR_VOUT].nValue <= 0 || !tx.vout[ASSETS_GLOBALADDR_VOUT].scriptPubKey.IsPayToCryptoCondition())
+            return false;
+        if ((order.funcid = Decode(tx.vout.back().scriptPubKey, evalCode, order.assetid, order.unit_price, order.origpubkey, order.expiryHeight)) == 0)
+            return false;
+        if (!IsBid(order.funcid) && order.funcid != 's' && order.funcid != 'S')
+            return false;
+        if (!Getscriptaddress(destaddr, tx.vout[ASSETS_GLOBALADDR_VOUT].scriptPubKey) || (globaladdr != destaddr && globaltokenaddr != destaddr))
+            return false;
+
+        order.txid = tx.GetHash();
+        order.amount = tx.vout[ASSETS_GLOBALADDR_VOUT].nValue;
+        order.blockHeight = nHeight;
+        order.origaddr.clear();
+        order.origtokenaddr.clear();
+        if (order.origpubkey.size() == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE)
+        {
+            struct CCcontract_info *cp, C;
+            char origaddr[KOMODO_ADDRESS_BUFSIZE], origtokenaddr[KOMODO_ADDRESS_BUFSIZE];
+
+            cp = CCinit(&C, evalcode);
+            GetCCaddress(cp, origaddr, pubkey2pk(order.origpubkey), fMixed);
+            cp = CCinit(&C, tokensEvalcode);
+            GetTokensCCaddress(cp, origtokenaddr, pubkey2pk(order.origpubkey), fMixed);
+            order.origaddr = origaddr;
+            order.origtokenaddr = origtokenaddr;
+        }
+        return true;
+    }
+
+    /// loads the orders from the unspents of the global addresses, cs_main is held
+    void Build()
+    {
+        struct CCcontract_info *cp, C;
+        char addr[KOMODO_ADDRESS_BUFSIZE];
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspents;
+
+        Clear();
+        cp = CCinit(&C, evalcode);
+        GetCCaddress(cp, addr, GetUnspendable(cp, NULL), fMixed);
+        globaladdr = addr;
+        SetCCunspents(unspents, addr, true);
+        GetTokensCCaddress(cp, addr, GetUnspendable(cp, NULL), fMixed);
+        globaltokenaddr = addr;
+        SetCCunspents(unspents, addr, true);
+
+        for (const auto &unspent : unspents)
+        {
+            if (!IsTxidInActiveChain(unspent.first.txhash))
+                continue;
+            // partially filled orders continue in the last fill
+            uint256 ordertxid = unspent.first.txhash, spenttxid;
+            int32_t spentvin, height;
+            while (CCgetspenttxid(spenttxid, spentvin, height, ordertxid, ASSETS_GLOBALADDR_VOUT) == 0 && IsTxidInActiveChain(spenttxid))
+                ordertxid = spenttxid;
+            if (mapOrders.count(ordertxid) != 0)
+                continue;
+
+            CTransaction ordertx;
+            uint256 hashBlock;
+            AssetsBookOrder order;
+            if (!myGetTransaction(ordertxid, ordertx, hashBlock))
+                continue;
+            CBlockIndex *pindex = komodo_getblockindex(hashBlock);
+            if (pindex != NULL && DecodeOrder(ordertx, pindex->GetHeight(), order))
+                Insert(order);
+        }
+        hashTip = chainActive.Tip() != NULL ? chainActive.Tip()->GetBlockHash() : uint256();
+        fBuilt = true;
+        LogPrint(ccassets_log, "%s evalcode %d built with %d orders\n", __func__, (int)evalcode, (int)mapOrders.size());
+    }
+
+public:
+    const uint8_t evalcode, tokensEvalcode;
+    const bool fMixed;
+    uint8_t (*const Decode)(const CScript &scriptPubKey, uint8_t &assetsEvalCode, uint256 &tokenid, CAmount &unit_price, vscript_t &origpubkey, int32_t &expiryHeight);
+    boost::mutex cs_book;
+
+    template <class A>
+    static CAssetsBook *Create()
+    {
+        return new CAssetsBook(A::EvalCode(), A::TokensEvalCode(), A::IsMixed(), A::DecodeAssetTokenOpRet);
+    }
+
+    CAssetsBook(uint8_t evalcodeIn, uint8_t tokensEvalcodeIn, bool fMixedIn,
+        uint8_t (*DecodeIn)(const CScript&, uint8_t&, uint256&, CAmount&, vscript_t&, int32_t&)) :
+        fBuilt(false), evalcode(evalcodeIn), tokensEvalcode(tokensEvalcodeIn), fMixed(fMixedIn), Decode(DecodeIn) {}
+
+    bool IsBuilt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        return fBuilt;
+    }
+
+    /// cs_main is held
+    void EnsureBuilt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        if (!fBuilt)
+            Build();
+    }
+
+    void GetOrders(const uint256 &assetid, std::vector<AssetsBookOrder> &orders)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        auto add = [&](const AssetOrders &asset) {
+            for (auto it = asset.bids.rbegin(); it != asset.bids.rend(); it++)
+                orders.push_back(mapOrders[it->second]);
+            for (auto it = asset.asks.begin(); it != asset.asks.end(); it++)
+                orders.push_back(mapOrders[it->second]);
+        };
+        if (!assetid.IsNull()) {
+            std::map<uint256, AssetOrders>::const_iterator it = mapAssets.find(assetid);
+            if (it != mapAssets.end())
+                add(it->second);
+        }
+        else
+            for (const auto &asset : mapAssets)
+                add(asset.second);
+    }
+
+    bool IsOpenOrder(const uint256 &ordertxid)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        return fBuilt && mapOrders.count(ordertxid) != 0;
+    }
+
+    void ConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        if (!fBuilt)
+            return;
+        if (pindex->pprev == NULL || pindex->pprev->GetBlockHash() != hashTip) {
+            Clear();
+            return;
+        }
+        for (const CTransaction &tx : block.vtx)
+        {
+            for (const CTxIn &vin : tx.vin)
+                if (vin.prevout.n == ASSETS_GLOBALADDR_VOUT)
+                    Erase(vin.prevout.hash);
+            AssetsBookOrder order;
+            if (DecodeOrder(tx, pindex->GetHeight(), order))
+                Insert(order);
+        }
+        hashTip = pindex->GetBlockHash();
+    }
+
+    void DisconnectBlock()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        // the orders spent by the block would have to be reloaded, the next query rebuilds instead
+        if (fBuilt)
+            Clear();
+    }
+};
+
+CAssetsBook *assetsBookV1 = CAssetsBook::Create<AssetsV1>();
+CAssetsBook *assetsBookV2 = CAssetsBook::Create<AssetsV2>();
+
+CAssetsBook *GetAssetsBook(uint8_t evalcode)
+{
+    if (KOMODO_NSPV_SUPERLITE)
+        return NULL;
+    if (evalcode == AssetsV1::EvalCode())
+        return assetsBookV1;
+    if (evalcode == AssetsV2::EvalCode())
+        return assetsBookV2;
+    return NULL;
+}
+
+}
+
+bool AssetsBookGetOrders(uint8_t evalcode, const uint256 &assetid, std::vector<AssetsBookOrder> &orders)
+{
+    CAssetsBook *book = GetAssetsBook(evalcode);
+    if (book == NULL)
+        return false;
+    if (!book->IsBuilt())
+    {
+        LOCK(cs_main);
+        book->EnsureBuilt();
+    }
+    book->GetOrders(assetid, orders);
+    return true;
+}
+
+bool AssetsBookIsOpenOrder(uint8_t evalcode, const uint256 &ordertxid)
+{
+    CAssetsBook *book = GetAssetsBook(evalcode);
+    if (book == NULL || !book->IsOpenOrder(ordertxid))
+        return false;
+    std::vector<bool> spent;
+    mempool.getSpentOutpoints(std::vector<COutPoint>(1, COutPoint(ordertxid, ASSETS_GLOBALADDR_VOUT)), spent);
+    return !spent[0];
+}
+
+void AssetsBookConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+    assetsBookV1->ConnectBlock(block, pindex);
+    assetsBookV2->ConnectBlock(block, pindex);
+}
+
+void AssetsBookDisconnectBlock()
+{
+    assetsBookV1->DisconnectBlock();
+    assetsBookV2->DisconnectBlock();
+}
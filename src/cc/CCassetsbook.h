@@ -0,0 +1,64 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_ASSETSBOOK_H
+#define CC_ASSETSBOOK_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "amount.h"
+#include "uint256.h"
+
+class CBlock;
+class CBlockIndex;
+
+/// open bid or ask of the assets cc, as listed by tokenorders
+struct AssetsBookOrder
+{
+    uint256 txid;               //!< tx holding the order on its ASSETS_GLOBALADDR_VOUT (the last fill or the order itself)
+    uint8_t funcid;             //!< 'b', 'B', 's' or 'S'
+    uint256 assetid;
+    CAmount unit_price;
+    CAmount amount;             //!< coins (bids) or token units (asks) left in the order
+    std::vector<uint8_t> origpubkey;
+    std::string origaddr;       //!< assets cc address of origpubkey, empty if origpubkey is not a valid pubkey
+    std::string origtokenaddr;  //!< tokens cc address of origpubkey
+    int32_t blockHeight;
+    int32_t expiryHeight;
+};
+
+/**
+ * In-memory order book of the assets cc (EVAL_ASSETS or EVAL_ASSETSV2), so
+ * tokenorders does not enumerate the global address and reload every order tx.
+ *
+ * A book is built from the address and spent indexes on its first use and
+ * then follows the active chain on each connected tip. A disconnected tip
+ * drops the book, it is rebuilt on the next query. Only confirmed orders are
+ * kept, as tokenorders always listed.
+ */
+
+/// returns false if there is no book for the evalcode (nspv mode or unknown evalcode), the caller uses the indexes itself then.
+/// Orders are grouped by assetid (all assets if assetid is null), bids by descending and asks by ascending price.
+bool AssetsBookGetOrders(uint8_t evalcode, const uint256 &assetid, std::vector<AssetsBookOrder> &orders);
+
+/// true if the book holds ordertxid as an open order confirmed in the active chain and not spent in the mempool.
+/// False only means the book cannot tell, an unconfirmed order is not in it
+bool AssetsBookIsOpenOrder(uint8_t evalcode, const uint256 &ordertxid);
+
+void AssetsBookConnectBlock(const CBlock &block, const CBlockIndex *pindex);
+void AssetsBookDisconnectBlock();
+
+#endif // CC_ASSETSBOOK_H
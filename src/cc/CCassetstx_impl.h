@@ -19,6 +19,45 @@
 #include "CCtokens.h"
 #include "CCassets.h"
 #include "CCTokelData.h"
+#include "CCassetsbook.h"
+
+static UniValue AssetsOrderToJSON(const AssetsBookOrder &order)
+{
+    UniValue item(UniValue::VOBJ);
+
+    std::string funcidstr(1, (char)order.funcid);
+    item.push_back(Pair("funcid", funcidstr));
+    item.push_back(Pair("txid", order.txid.GetHex()));
+    if (order.funcid == 'b' || order.funcid == 'B')
+        item.push_back(Pair("bidamount", ValueFromAmount(order.amount)));
+    else
+        item.push_back(Pair("askamount", order.amount));
+    if (order.origpubkey.size() == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE)
+    {
+        item.push_back(Pair("origaddress", order.origaddr));
+        item.push_back(Pair("origtokenaddress", order.origtokenaddr));
+    }
+    if (order.assetid != zeroid)
+        item.push_back(Pair("tokenid", order.assetid.GetHex()));
+    if (order.unit_price > 0)
+    {
+        if (order.funcid == 's' || order.funcid == 'S' /*|| funcid == 'e' || funcid == 'E' not supported */)
+        {
+            item.push_back(Pair("totalrequired", ValueFromAmount(order.unit_price * order.amount)));
+            item.push_back(Pair("price", ValueFromAmount(order.unit_price)));
+        }
+        else
+        {
+            item.push_back(Pair("totalrequired", order.amount / order.unit_price));
+            item.push_back(Pair("price", ValueFromAmount(order.unit_price)));
+        }
+    }
+    if (order.blockHeight > 0)
+        item.push_back(Pair("blockHeight", order.blockHeight));
+    if (order.expiryHeight > 0)
+        item.push_back(Pair("ExpiryHeight", order.expiryHeight));
+    return item;
+}
 
 template<class T, class A>
 UniValue AssetOrders(uint256 refassetid, const CPubKey &mypk, const UniValue &params)
@@ -105,54 +144,33 @@ UniValue AssetOrders(uint256 refassetid, const CPubKey &mypk, const UniValue &pa
                     return;
                 }
 
-                UniValue item(UniValue::VOBJ);
-
-                std::string funcidstr(1, (char)funcid);
-                item.push_back(Pair("funcid", funcidstr));
-                item.push_back(Pair("txid", ordertxid.GetHex()));
-                if (funcid == 'b' || funcid == 'B')
-                {
-                    item.push_back(Pair("bidamount", ValueFromAmount(ordertx.vout[0].nValue)));
-                }
-                else if (funcid == 's' || funcid == 'S')
-                {
-                    item.push_back(Pair("askamount", ordertx.vout[0].nValue));
-                }
-                else
+                if (funcid != 'b' && funcid != 'B' && funcid != 's' && funcid != 'S')
                     return;
+                AssetsBookOrder order;
+                order.txid = ordertxid;
+                order.funcid = funcid;
+                order.assetid = assetid;
+                order.unit_price = unit_price;
+                order.amount = ordertx.vout[0].nValue;
+                order.origpubkey = vorigpubkey;
                 if (vorigpubkey.size() == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE)
                 {
                     GetCCaddress(cp, origaddr, pubkey2pk(vorigpubkey), A::IsMixed());  
-                    item.push_back(Pair("origaddress", origaddr));
+                    order.origaddr = origaddr;
                     GetTokensCCaddress(cpTokens, origtokenaddr, pubkey2pk(vorigpubkey), A::IsMixed());
-                    item.push_back(Pair("origtokenaddress", origtokenaddr));
-                }
-                if (assetid != zeroid)
-                    item.push_back(Pair("tokenid", assetid.GetHex()));
-                if (unit_price > 0)
-                {
-                    if (funcid == 's' || funcid == 'S' /*|| funcid == 'e' || funcid == 'E' not supported */)
-                    {
-                        item.push_back(Pair("totalrequired", ValueFromAmount(unit_price * ordertx.vout[0].nValue)));
-                        item.push_back(Pair("price", ValueFromAmount(unit_price)));
-                    }
-                    else if (funcid == 'b' || funcid == 'B')
-                    {
-                        item.push_back(Pair("totalrequired", unit_price ? ordertx.vout[0].nValue / unit_price : 0));
-                        item.push_back(Pair("price", ValueFromAmount(unit_price)));
-                    }
+                    order.origtokenaddr = origtokenaddr;
                 }
+                order.blockHeight = 0;
                 {
                     LOCK(cs_main);
                     CBlockIndex *pindex = komodo_getblockindex(hashBlock);
                     if (pindex)
-                        item.push_back(Pair("blockHeight", pindex->GetHeight()));
+                        order.blockHeight = pindex->GetHeight();
                 }
-                if (expiryHeight > 0)
-                    item.push_back(Pair("ExpiryHeight", expiryHeight));
+                order.expiryHeight = expiryHeight;
 
                 if (ordertx.vout[0].nValue > 0LL) // do not add totally filled orders 
-                    result.push_back(item);
+                    result.push_back(AssetsOrderToJSON(order));
                 LOGSTREAM(ccassets_log, CCLOG_DEBUG1, stream << funcname << " added order funcId=" << (char)(funcid ? funcid : ' ') << " orderid=" << ordertxid.GetHex() << " tokenid=" << assetid.GetHex() << std::endl);
             }
         }
@@ -202,6 +220,15 @@ UniValue AssetOrders(uint256 refassetid, const CPubKey &mypk, const UniValue &pa
         }
         else
         {
+            // open orders are kept in the book
+            std::vector<AssetsBookOrder> bookOrders;
+            if (AssetsBookGetOrders(A::EvalCode(), refassetid, bookOrders))
+            {
+                for (const auto &order : bookOrders)
+                    result.push_back(AssetsOrderToJSON(order));
+                return result;
+            }
+
             // tokenbids:
             std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputsCoins;
             char assetsGlobalAddr[KOMODO_ADDRESS_BUFSIZE];
@@ -476,7 +503,7 @@ UniValue CancelBuyOffer(const CPubKey &mypk, CAmount txfee, uint256 assetid, uin
         int32_t spendingvin, h;
 
         LOCK(cs_main);
-        if ((CCgetspenttxid(spendingtxid, spendingvin, h, bidtxid, ASSETS_GLOBALADDR_VOUT) != 0 || !IsTxidInActiveChain(spendingtxid)) && 
+        if ((AssetsBookIsOpenOrder(A::EvalCode(), bidtxid) || CCgetspenttxid(spendingtxid, spendingvin, h, bidtxid, ASSETS_GLOBALADDR_VOUT) != 0 || !IsTxidInActiveChain(spendingtxid)) && 
             myGetTransaction(bidtxid, vintx, hashBlock) && vintx.vout.size() > ASSETS_GLOBALADDR_VOUT)
         {
             uint8_t dummyEvalCode; uint256 dummyAssetid; 
@@ -558,7 +585,7 @@ UniValue CancelSell(const CPubKey &mypk, CAmount txfee, uint256 assetid, uint256
         int32_t spendingvin, h;
 
         LOCK(cs_main);
-        if ((CCgetspenttxid(spendingtxid, spendingvin, h, asktxid, ASSETS_GLOBALADDR_VOUT) != 0 || !IsTxidInActiveChain(spendingtxid)) && myGetTransaction(asktxid, vintx, hashBlock) != 0 && vintx.vout.size() > 0)
+        if ((AssetsBookIsOpenOrder(A::EvalCode(), asktxid) || CCgetspenttxid(spendingtxid, spendingvin, h, asktxid, ASSETS_GLOBALADDR_VOUT) != 0 || !IsTxidInActiveChain(spendingtxid)) && myGetTransaction(asktxid, vintx, hashBlock) != 0 && vintx.vout.size() > 0)
         {
             uint8_t dummyEvalCode; 
             uint256 dummyAssetid; 
@@ -657,7 +684,7 @@ UniValue FillBuyOffer(const CPubKey &mypk, CAmount txfee, uint256 assetid, uint2
 
         LOCK(cs_main);
         int32_t nextHeight = komodo_nextheight();
-        if ((CCgetspenttxid(spendingtxid, spendingvin, h, bidtxid, bidvout) != 0 || !IsTxidInActiveChain(spendingtxid)) && myGetTransaction(bidtxid, vintx, hashBlock) != 0 && vintx.vout.size() > bidvout)
+        if ((AssetsBookIsOpenOrder(A::EvalCode(), bidtxid) || CCgetspenttxid(spendingtxid, spendingvin, h, bidtxid, bidvout) != 0 || !IsTxidInActiveChain(spendingtxid)) && myGetTransaction(bidtxid, vintx, hashBlock) != 0 && vintx.vout.size() > bidvout)
         {
             uint256 assetidOpret;
             int32_t expiryHeight;
@@ -802,7 +829,7 @@ UniValue FillSell(const CPubKey &mypk, CAmount txfee, uint256 assetid, uint256 a
     int32_t spendingvin, h;
 
     LOCK(cs_main);
-    if ((CCgetspenttxid(spendingtxid, spendingvin, h, asktxid, askvout) != 0 || !IsTxidInActiveChain(spendingtxid)) && myGetTransaction(asktxid, vintx, hashBlock) && vintx.vout.size() > askvout)
+    if ((AssetsBookIsOpenOrder(A::EvalCode(), asktxid) || CCgetspenttxid(spendingtxid, spendingvin, h, asktxid, askvout) != 0 || !IsTxidInActiveChain(spendingtxid)) && myGetTransaction(asktxid, vintx, hashBlock) && vintx.vout.size() > askvout)
     {
         int32_t nextHeight = komodo_nextheight();
         uint256 assetidOpret;
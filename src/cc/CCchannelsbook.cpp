@@ -0,0 +1,256 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCchannelsbook.h"
+
+#include "CCchannels.h"
+#include "main.h"
+
+#include <map>
+#include <set>
+#include <boost/thread.hpp>
+
+// every channels tx has a marker cc vout1, checked before decoding the opret of every tx of a block
+static bool ChannelsBookIsChannelsTx(const CTransaction &tx)
+{
+    return tx.vout.size() > 2 && tx.vout[1].scriptPubKey.IsPayToCryptoCondition();
+}
+
+namespace {
+
+class CChannelsBook
+{
+private:
+    struct Channel {
+        bool fValid;                //!< false if the txid is not a confirmed channel open
+        ChannelsBookState state;
+        Channel() : fValid(false) {}
+    };
+    std::map<uint256, Channel> mapChannels;    //!< loaded channels by opentxid
+    std::map<uint256, uint256> mapLatest;      //!< opentxid of each latesttxid, to drop the spent vout0
+    bool fBuilt;
+    uint256 hashTip;
+
+    void Clear()
+    {
+        mapChannels.clear();
+        mapLatest.clear();
+        fBuilt = false;
+    }
+
+    void SetLatest(struct CCcontract_info *cp, ChannelsBookState &state, const CTransaction &tx, uint8_t funcid, int32_t depth)
+    {
+        if (IsChannelsvout(cp, tx, state.srcpub, state.destpub, 0) <= 0)
+            return;
+        if (!state.latesttxid.IsNull())
+            mapLatest.erase(state.latesttxid);
+        state.latesttxid = tx.GetHash();
+        state.latestfuncid = funcid;
+        state.depth = depth;
+        state.funds = tx.vout[0].nValue;
+        mapLatest[state.latesttxid] = state.opentxid;
+    }
+
+    void Spend(const COutPoint &outpoint)
+    {
+        if (outpoint.n != 0)
+            return;
+        std::map<uint256, uint256>::iterator it = mapLatest.find(outpoint.hash);
+        if (it == mapLatest.end())
+            return;
+        std::map<uint256, Channel>::iterator itChannel = mapChannels.find(it->second);
+        if (itChannel != mapChannels.end()) {
+            ChannelsBookState &state = itChannel->second.state;
+            state.latesttxid.SetNull();
+            state.latestfuncid = 0;
+            state.funds = 0;
+        }
+        mapLatest.erase(it);
+    }
+
+    /// loads the channel from its open tx and the marker and 1of2 address indexes, cs_main is held
+    Channel &Load(const uint256 &opentxid)
+    {
+        std::map<uint256, Channel>::iterator it = mapChannels.find(opentxid);
+        if (it != mapChannels.end())
+            return it->second;
+        Channel &channel = mapChannels[opentxid];
+        struct CCcontract_info *cp, C;
+        CTransaction tx;
+        uint256 hashBlock, txid, hashchain;
+        int32_t param1;
+        int64_t param2;
+        char coinaddr[KOMODO_ADDRESS_BUFSIZE];
+        ChannelsBookState &state = channel.state;
+
+        cp = CCinit(&C, EVAL_CHANNELS);
+        if (myGetTransaction(opentxid, tx, hashBlock) == 0 || tx.vout.size() < 2 || !IsTxidInActiveChain(opentxid) ||
+            DecodeChannelsOpRet(tx.vout.back().scriptPubKey, state.tokenid, txid, state.srcpub, state.destpub, param1, param2, hashchain) != 'O')
+            return channel;
+        state.opentxid = opentxid;
+        state.numpayments = 0;
+        state.latestfuncid = 0;
+        state.depth = 0;
+        state.funds = 0;
+
+        // both parties get a marker in every channel tx, the marker address of srcpub has the whole history
+        std::vector<uint256> txids;
+        std::set<uint256> seen;
+        GetCCaddress(cp, coinaddr, state.srcpub);
+        SetCCtxids(txids, coinaddr, true, EVAL_CHANNELS, 0, opentxid, 0);
+        for (const uint256 &hash : txids)
+        {
+            CTransaction histTx;
+            uint256 tokenid, histopentxid, param3;
+            CPubKey srcpub, destpub;
+            uint8_t funcid;
+            if (!seen.insert(hash).second)
+                continue;
+            if (hash == opentxid) {
+                state.txids.push_back(hash);
+                continue;
+            }
+            if (myGetTransaction(hash, histTx, hashBlock) == 0 || histTx.vout.empty())
+                continue;
+            if ((funcid = DecodeChannelsOpRet(histTx.vout.back().scriptPubKey, tokenid, histopentxid, srcpub, destpub, param1, param2, param3)) == 0 ||
+                funcid == 'O' || histopentxid != opentxid)
+                continue;
+            state.txids.push_back(hash);
+            if (funcid == 'P')
+                state.numpayments++;
+        }
+
+        // the latest tx is the one of the history with the unspent vout0 on the channel address, as AddChannelsInputs
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspents;
+        if (state.tokenid != zeroid)
+            GetTokensCCaddress1of2(cp, coinaddr, state.srcpub, state.destpub);
+        else
+            GetCCaddress1of2(cp, coinaddr, state.srcpub, state.destpub);
+        SetCCunspents(unspents, coinaddr, true);
+        for (const auto &unspent : unspents)
+        {
+            CTransaction latestTx;
+            uint256 tokenid, latestopentxid, param3;
+            CPubKey srcpub, destpub;
+            uint8_t funcid;
+            if (unspent.first.index != 0 || seen.count(unspent.first.txhash) == 0)
+                continue;
+            if (myGetTransaction(unspent.first.txhash, latestTx, hashBlock) == 0 || latestTx.vout.empty())
+                continue;
+            if ((funcid = DecodeChannelsOpRet(latestTx.vout.back().scriptPubKey, tokenid, latestopentxid, srcpub, destpub, param1, param2, param3)) != 0)
+            {
+                SetLatest(cp, state, latestTx, funcid, param1);
+                break;
+            }
+        }
+        channel.fValid = true;
+        return channel;
+    }
+
+public:
+    boost::mutex cs_book;
+
+    CChannelsBook() : fBuilt(false) {}
+
+    /// cs_main is held
+    bool GetState(const uint256 &opentxid, ChannelsBookState &state)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        if (!fBuilt)
+        {
+            hashTip = chainActive.Tip() != NULL ? chainActive.Tip()->GetBlockHash() : uint256();
+            fBuilt = true;
+        }
+        const Channel &channel = Load(opentxid);
+        if (!channel.fValid)
+        {
+            // not kept, the open may confirm later
+            mapChannels.erase(opentxid);
+            return false;
+        }
+        state = channel.state;
+        return true;
+    }
+
+    void ConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        struct CCcontract_info *cp, C;
+
+        if (!fBuilt)
+            return;
+        if (pindex->pprev == NULL || pindex->pprev->GetBlockHash() != hashTip) {
+            Clear();
+            return;
+        }
+        hashTip = pindex->GetBlockHash();
+        if (mapChannels.empty())
+            return;
+        cp = CCinit(&C, EVAL_CHANNELS);
+        for (const CTransaction &tx : block.vtx)
+        {
+            uint256 tokenid, opentxid, param3;
+            CPubKey srcpub, destpub;
+            int32_t param1;
+            int64_t param2;
+            uint8_t funcid;
+
+            for (const CTxIn &vin : tx.vin)
+                Spend(vin.prevout);
+            if (!ChannelsBookIsChannelsTx(tx))
+                continue;
+            if ((funcid = DecodeChannelsOpRet(tx.vout.back().scriptPubKey, tokenid, opentxid, srcpub, destpub, param1, param2, param3)) == 0 || funcid == 'O')
+                continue;
+            std::map<uint256, Channel>::iterator it = mapChannels.find(opentxid);
+            if (it == mapChannels.end())
+                continue;
+            ChannelsBookState &state = it->second.state;
+            state.txids.push_back(tx.GetHash());
+            if (funcid == 'P')
+                state.numpayments++;
+            SetLatest(cp, state, tx, funcid, param1);
+        }
+    }
+
+    void DisconnectBlock()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        // the spent vout0 would have to be restored, the channels are reloaded on the next query instead
+        if (fBuilt)
+            Clear();
+    }
+};
+
+CChannelsBook channelsBook;
+
+}
+
+bool ChannelsBookGetState(const uint256 &opentxid, ChannelsBookState &state)
+{
+    if (KOMODO_NSPV_SUPERLITE)
+        return false;
+    LOCK(cs_main);
+    return channelsBook.GetState(opentxid, state);
+}
+
+void ChannelsBookConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+    channelsBook.ConnectBlock(block, pindex);
+}
+
+void ChannelsBookDisconnectBlock()
+{
+    channelsBook.DisconnectBlock();
+}
@@ -0,0 +1,60 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_CHANNELSBOOK_H
+#define CC_CHANNELSBOOK_H
+
+#include <stdint.h>
+#include <vector>
+#include "amount.h"
+#include "pubkey.h"
+#include "uint256.h"
+
+class CBlock;
+class CBlockIndex;
+
+/// confirmed state of a channel from its open tx
+struct ChannelsBookState
+{
+    uint256 opentxid;
+    uint256 tokenid;                //!< null for a coins channel
+    CPubKey srcpub, destpub;
+    int32_t numpayments;            //!< 'P' txns confirmed so far
+    uint256 latesttxid;             //!< the 'O', 'P' or 'C' tx with the unspent channel vout0, null once it is spent ('R')
+    uint8_t latestfuncid;
+    int32_t depth;                  //!< payments left in the opret of latesttxid
+    CAmount funds;                  //!< vout0 of latesttxid, the remaining balance
+    std::vector<uint256> txids;     //!< confirmed channel txns in chain order, the open tx first
+};
+
+/**
+ * In-memory index of the channels cc channels, so a payment, close or refund
+ * does not enumerate the unspents of the 1of2 channel address and reload each
+ * of them to find the latest tx, and channelsinfo does not filter the whole
+ * marker address of the pubkey.
+ *
+ * A channel is loaded from the address indexes the first time it is queried
+ * and then follows the active chain on each connected tip. A disconnected tip
+ * drops all channels, they are reloaded on the next query. Only confirmed
+ * txns are kept, the callers still look at the mempool for newer payments.
+ */
+
+/// returns false if there is no index (nspv mode) or opentxid is not a confirmed channel open, the caller scans the addresses itself then
+bool ChannelsBookGetState(const uint256 &opentxid, ChannelsBookState &state);
+
+void ChannelsBookConnectBlock(const CBlock &block, const CBlockIndex *pindex);
+void ChannelsBookDisconnectBlock();
+
+#endif // CC_CHANNELSBOOK_H
@@ -36,6 +36,8 @@
 #include "CCagreements.h"
 #include "CCtokentags.h"
 #include "CCassetloans.h"
+#include "chainparams.h"
+#include <boost/thread/mutex.hpp>
 
 
 /*
@@ -330,7 +332,7 @@ int32_t CClib_initcp(struct CCcontract_info *cp,uint8_t evalcode)
     return(-1);
 }
 
-struct CCcontract_info *CCinit(struct CCcontract_info *cp, uint8_t evalcode)
+static struct CCcontract_info *CCbuildinfo(struct CCcontract_info *cp, uint8_t evalcode)
 {
     // memset(cp, '\0', sizeof(*cp)); <-- it is not good to initialize objects like this. 
 	// special init func now used:
@@ -499,3 +501,45 @@ struct CCcontract_info *CCinit(struct CCcontract_info *cp, uint8_t evalcode)
     return(cp);
 }
 
+namespace {
+
+/// CCinit results depend only on the evalcode and the selected chain params,
+/// so each evalcode is built once (hexstr parsing, cc and normal addresses) and then copied out
+struct CCdescriptor
+{
+    uint8_t state;  // 0 not built, 1 valid, 2 init failed
+    struct CCcontract_info info;
+};
+
+boost::mutex cs_ccdescriptors;
+const CChainParams *ccdescriptorsParams = NULL;
+CCdescriptor ccdescriptors[0x100];
+
+}
+
+struct CCcontract_info *CCinit(struct CCcontract_info *cp, uint8_t evalcode)
+{
+    boost::mutex::scoped_lock lock(cs_ccdescriptors);
+    if (ccdescriptorsParams != &Params())  // address prefixes changed, drop all (tests only)
+    {
+        for (int32_t i = 0; i < 0x100; i++)
+            ccdescriptors[i].state = 0;
+        ccdescriptorsParams = &Params();
+    }
+    CCdescriptor &desc = ccdescriptors[evalcode];
+    if (desc.state == 0)
+        desc.state = CCbuildinfo(&desc.info, evalcode) != 0 ? 1 : 2;
+    if (desc.state != 1)
+    {
+        cp->clear();
+        cp->evalcode = evalcode;
+        return(0);
+    }
+    // keep the caller's probes as clear() always did
+    std::vector< struct CCVintxProbe > probes;
+    probes.swap(cp->CCvintxprobes);
+    *cp = desc.info;
+    cp->CCvintxprobes.swap(probes);
+    return(cp);
+}
+
@@ -0,0 +1,274 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCdicebook.h"
+
+#include "CCdice.h"
+#include "main.h"
+
+#include <algorithm>
+#include <map>
+#include <boost/thread.hpp>
+
+// vout0 pays to the dice global address, checked before decoding the opret of every tx of a block
+static bool DiceBookIsDiceVout0(const CTransaction &tx)
+{
+    struct CCcontract_info *cp, C;
+    char destaddr[KOMODO_ADDRESS_BUFSIZE];
+
+    if (tx.vout.size() < 2 || !tx.vout[0].scriptPubKey.IsPayToCryptoCondition())
+        return false;
+    cp = CCinit(&C, EVAL_DICE);
+    return Getscriptaddress(destaddr, tx.vout[0].scriptPubKey) && strcmp(destaddr, cp->unspendableCCaddr) == 0;
+}
+
+// house entropy checks of DicePlanFunds: vout1 to the dealer and vin0 from a dealer tx
+static bool DiceBookIsEntropy(const CTransaction &tx, const CScript &fundingPubKey, const uint256 &fundingtxid)
+{
+    CTransaction vinTx;
+    uint256 hashBlock;
+
+    if (tx.vout.size() < 2 || fundingPubKey.empty() || tx.vout[1].scriptPubKey != fundingPubKey)
+        return false;
+    if (tx.vin.empty() || myGetTransaction(tx.vin[0].prevout.hash, vinTx, hashBlock) == 0)
+        return false;
+    // skip coinbase or strange entropy tx
+    if (vinTx.vin.empty() || (int32_t)vinTx.vin[0].prevout.n < 0 || vinTx.vout.size() < 2)
+        return false;
+    if (fundingtxid != tx.vin[0].prevout.hash && vinTx.vout[1].scriptPubKey != fundingPubKey)
+    {
+        char addr0[KOMODO_ADDRESS_BUFSIZE], addr1[KOMODO_ADDRESS_BUFSIZE];
+        Getscriptaddress(addr0, vinTx.vout[1].scriptPubKey);
+        Getscriptaddress(addr1, fundingPubKey);
+        if (strcmp(addr0, addr1) != 0)
+            return false;
+    }
+    return true;
+}
+
+bool DiceBookDecode(const CTransaction &tx, const CScript &fundingPubKey, DiceBookUtxo &utxo)
+{
+    uint256 hash, proof;
+
+    if (!DiceBookIsDiceVout0(tx))
+        return false;
+    utxo.txid = tx.GetHash();
+    if ((utxo.funcid = DecodeDiceOpRet(utxo.txid, tx.vout.back().scriptPubKey, utxo.sbits, utxo.fundingtxid, hash, proof)) == 0)
+        return false;
+    utxo.nValue = tx.vout[0].nValue;
+    utxo.fEntropy = (utxo.funcid == 'E' || utxo.funcid == 'W' || utxo.funcid == 'L') && DiceBookIsEntropy(tx, fundingPubKey, utxo.fundingtxid);
+    return true;
+}
+
+namespace {
+
+class CDiceBook
+{
+private:
+    struct Plan {
+        bool fLoaded;
+        CScript fundingPubKey;                  //!< vout1 of the funding tx, empty if it is not a valid plan
+        std::map<uint256, DiceBookUtxo> utxos;  //!< by txid
+        Plan() : fLoaded(false) {}
+    };
+    std::map<uint256, Plan> mapPlans;       //!< by fundingtxid
+    std::map<uint256, uint256> mapUtxos;    //!< fundingtxid of each vout0
+    bool fBuilt;
+    uint256 hashTip;
+
+    void Clear()
+    {
+        mapPlans.clear();
+        mapUtxos.clear();
+        fBuilt = false;
+    }
+
+    Plan &GetPlan(const uint256 &fundingtxid)
+    {
+        Plan &plan = mapPlans[fundingtxid];
+        if (!plan.fLoaded)
+        {
+            struct CCcontract_info *cp, C;
+            CTransaction tx;
+            uint256 hashBlock;
+            cp = CCinit(&C, EVAL_DICE);
+            if (myGetTransaction(fundingtxid, tx, hashBlock) != 0 && tx.vout.size() > 1 && ConstrainVout(tx.vout[0], 1, cp->unspendableCCaddr, 0) != 0)
+                plan.fundingPubKey = tx.vout[1].scriptPubKey;
+            plan.fLoaded = true;
+        }
+        return plan;
+    }
+
+    void Erase(const COutPoint &outpoint)
+    {
+        if (outpoint.n != 0)
+            return;
+        std::map<uint256, uint256>::iterator it = mapUtxos.find(outpoint.hash);
+        if (it == mapUtxos.end())
+            return;
+        std::map<uint256, Plan>::iterator itPlan = mapPlans.find(it->second);
+        if (itPlan != mapPlans.end())
+            itPlan->second.utxos.erase(outpoint.hash);
+        mapUtxos.erase(it);
+    }
+
+    void Insert(const CTransaction &tx)
+    {
+        DiceBookUtxo utxo;
+        uint256 hash, proof;
+        const uint256 &txid = tx.GetHash();
+
+        if (mapUtxos.count(txid) != 0 || !DiceBookIsDiceVout0(tx))
+            return;
+        // the plan is needed first for the entropy checks
+        if (DecodeDiceOpRet(txid, tx.vout.back().scriptPubKey, utxo.sbits, utxo.fundingtxid, hash, proof) == 0)
+            return;
+        Plan &plan = GetPlan(utxo.fundingtxid);
+        if (!DiceBookDecode(tx, plan.fundingPubKey, utxo))
+            return;
+        plan.utxos[txid] = utxo;
+        mapUtxos[txid] = utxo.fundingtxid;
+    }
+
+    /// loads the vout0 utxos from the unspents of the global address, cs_main is held
+    void Build()
+    {
+        struct CCcontract_info *cp, C;
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspents;
+
+        Clear();
+        cp = CCinit(&C, EVAL_DICE);
+        SetCCunspents(unspents, cp->unspendableCCaddr, true);
+        for (const auto &unspent : unspents)
+        {
+            CTransaction tx;
+            uint256 hashBlock;
+            if (unspent.first.index != 0 || !IsTxidInActiveChain(unspent.first.txhash))
+                continue;
+            if (myGetTransaction(unspent.first.txhash, tx, hashBlock) != 0)
+                Insert(tx);
+        }
+        hashTip = chainActive.Tip() != NULL ? chainActive.Tip()->GetBlockHash() : uint256();
+        fBuilt = true;
+        LogPrint("dice", "%s built with %d utxos of %d plans\n", __func__, (int)mapUtxos.size(), (int)mapPlans.size());
+    }
+
+public:
+    boost::mutex cs_book;
+
+    CDiceBook() : fBuilt(false) {}
+
+    bool IsBuilt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        return fBuilt;
+    }
+
+    /// cs_main is held
+    void EnsureBuilt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        if (!fBuilt)
+            Build();
+    }
+
+    void GetUtxos(const uint256 &fundingtxid, std::vector<DiceBookUtxo> &utxos)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        std::map<uint256, Plan>::const_iterator it = mapPlans.find(fundingtxid);
+        if (it == mapPlans.end())
+            return;
+        for (const auto &utxo : it->second.utxos)
+            utxos.push_back(utxo.second);
+    }
+
+    void GetBets(uint64_t sbits, std::vector<DiceBookUtxo> &bets)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        for (const auto &plan : mapPlans)
+            for (const auto &utxo : plan.second.utxos)
+                if (utxo.second.funcid == 'B' && utxo.second.sbits == sbits)
+                    bets.push_back(utxo.second);
+        std::sort(bets.begin(), bets.end(), [](const DiceBookUtxo &a, const DiceBookUtxo &b) { return a.txid < b.txid; });
+    }
+
+    void ConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        if (!fBuilt)
+            return;
+        if (pindex->pprev == NULL || pindex->pprev->GetBlockHash() != hashTip) {
+            Clear();
+            return;
+        }
+        for (const CTransaction &tx : block.vtx)
+        {
+            for (const CTxIn &vin : tx.vin)
+                Erase(vin.prevout);
+            Insert(tx);
+        }
+        hashTip = pindex->GetBlockHash();
+    }
+
+    void DisconnectBlock()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        // the utxos spent by the block would have to be reloaded, the next query rebuilds instead
+        if (fBuilt)
+            Clear();
+    }
+};
+
+CDiceBook diceBook;
+
+bool EnsureDiceBook()
+{
+    if (KOMODO_NSPV_SUPERLITE)
+        return false;
+    if (!diceBook.IsBuilt())
+    {
+        LOCK(cs_main);
+        diceBook.EnsureBuilt();
+    }
+    return true;
+}
+
+}
+
+bool DiceBookGetUtxos(const uint256 &fundingtxid, std::vector<DiceBookUtxo> &utxos)
+{
+    if (!EnsureDiceBook())
+        return false;
+    diceBook.GetUtxos(fundingtxid, utxos);
+    return true;
+}
+
+bool DiceBookGetBets(uint64_t sbits, std::vector<DiceBookUtxo> &bets)
+{
+    if (!EnsureDiceBook())
+        return false;
+    diceBook.GetBets(sbits, bets);
+    return true;
+}
+
+void DiceBookConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+    diceBook.ConnectBlock(block, pindex);
+}
+
+void DiceBookDisconnectBlock()
+{
+    diceBook.DisconnectBlock();
+}
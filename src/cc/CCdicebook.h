@@ -0,0 +1,64 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_DICEBOOK_H
+#define CC_DICEBOOK_H
+
+#include <stdint.h>
+#include <vector>
+#include "amount.h"
+#include "uint256.h"
+#include "script/script.h"
+
+class CBlock;
+class CBlockIndex;
+class CTransaction;
+
+/// unspent dice cc vout0 on the dice global address: plan funds, entropy ('E', 'W', 'L') or a pending bet ('B')
+struct DiceBookUtxo
+{
+    uint256 txid;
+    uint8_t funcid;
+    uint64_t sbits;
+    uint256 fundingtxid;    //!< the plan, the txid itself for 'F'
+    CAmount nValue;
+    bool fEntropy;          //!< an 'E', 'W' or 'L' vout0 the dealer of the plan can use as house entropy
+};
+
+/**
+ * In-memory book of the dice cc vout0 utxos by plan, so bets, finishes and
+ * the dealer loop do not enumerate the dice global address and reload every
+ * tx for each call. The house entropy checks on the funding pubkey are done
+ * once, when a utxo is added.
+ *
+ * The book is built from the address index on its first use and then follows
+ * the active chain on each connected tip. A disconnected tip drops the book,
+ * it is rebuilt on the next query. Only confirmed utxos are kept, the callers
+ * still skip those spent in the mempool.
+ */
+
+/// decodes vout0 of tx as a dice utxo, fundingPubKey is vout1 of the plan funding tx
+bool DiceBookDecode(const CTransaction &tx, const CScript &fundingPubKey, DiceBookUtxo &utxo);
+
+/// the utxos of the plan fundingtxid by txid. Returns false if there is no book (nspv mode), the caller scans the address itself then
+bool DiceBookGetUtxos(const uint256 &fundingtxid, std::vector<DiceBookUtxo> &utxos);
+
+/// the pending bets of all plans named sbits by txid
+bool DiceBookGetBets(uint64_t sbits, std::vector<DiceBookUtxo> &bets);
+
+void DiceBookConnectBlock(const CBlock &block, const CBlockIndex *pindex);
+void DiceBookDisconnectBlock();
+
+#endif // CC_DICEBOOK_H
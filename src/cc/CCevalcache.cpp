@@ -0,0 +1,133 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCevalcache.h"
+
+#include "cc/eval.h"
+#include "cc/CCupgrades.h"
+#include "random.h"
+#include "util.h"
+
+#include <map>
+#include <boost/thread.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
+
+namespace {
+
+class CCCEvalCache
+{
+private:
+    //! key is (txid, nIn, evalcode)
+    typedef boost::tuple<uint256, uint32_t, uint8_t> evalkey_type;
+    //! context the result was obtained in
+    struct EvalContext {
+        uint256 hashPrevBlock;
+        int32_t nHeight;
+        int64_t nTime;
+    };
+    std::map<evalkey_type, EvalContext> mapValid;
+    boost::shared_mutex cs_evalcache;
+
+    static bool SameUpgrades(int64_t nTime1, int64_t nTime2, int32_t nHeight)
+    {
+        const CCUpgrades::ChainUpgrades &upgrades = CCUpgrades::GetUpgrades();
+        for (const auto &upgrade : upgrades.mUpgrades)
+            if (CCUpgrades::IsUpgradeActive(nTime1, nHeight, upgrades, upgrade.first) != CCUpgrades::IsUpgradeActive(nTime2, nHeight, upgrades, upgrade.first))
+                return false;
+        return true;
+    }
+
+public:
+    bool Get(const uint256 &txid, uint32_t nIn, uint8_t evalcode, const uint256 &hashPrevBlock, int32_t nHeight, int64_t nTime)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_evalcache);
+
+        std::map<evalkey_type, EvalContext>::iterator mi = mapValid.find(evalkey_type(txid, nIn, evalcode));
+        if (mi == mapValid.end())
+            return false;
+        const EvalContext &ctx = mi->second;
+        return ctx.hashPrevBlock == hashPrevBlock && ctx.nHeight == nHeight && SameUpgrades(ctx.nTime, nTime, nHeight);
+    }
+
+    void Set(const uint256 &txid, uint32_t nIn, uint8_t evalcode, const uint256 &hashPrevBlock, int32_t nHeight, int64_t nTime)
+    {
+        int64_t nMaxCacheSize = GetArg("-maxccevalcachesize", DEFAULT_MAX_CCEVAL_CACHE_SIZE);
+        if (nMaxCacheSize <= 0) return;
+
+        boost::unique_lock<boost::shared_mutex> lock(cs_evalcache);
+
+        while (static_cast<int64_t>(mapValid.size()) > nMaxCacheSize)
+        {
+            // Evict a random entry, see CSignatureCache
+            std::map<evalkey_type, EvalContext>::iterator it =
+                mapValid.lower_bound(evalkey_type(GetRandHash(), 0, 0));
+            if (it == mapValid.end())
+                it = mapValid.begin();
+            mapValid.erase(it);
+        }
+
+        EvalContext ctx;
+        ctx.hashPrevBlock = hashPrevBlock;
+        ctx.nHeight = nHeight;
+        ctx.nTime = nTime;
+        mapValid[evalkey_type(txid, nIn, evalcode)] = ctx;
+    }
+
+    void Clear()
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_evalcache);
+        mapValid.clear();
+    }
+};
+
+CCCEvalCache ccEvalCache;
+
+}
+
+bool CCEvalCacheIsCacheable(uint8_t evalcode)
+{
+    // modules whose validators read the current time, oracle data, notarisations or
+    // block entropy are not listed and are always validated again
+    switch (evalcode)
+    {
+        case EVAL_ASSETS:
+        case EVAL_TOKENS:
+        case EVAL_ASSETSV2:
+        case EVAL_TOKENSV2:
+        case EVAL_TOKELDATA:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool CCEvalCacheGet(const uint256 &txid, uint32_t nIn, uint8_t evalcode, const uint256 &hashPrevBlock, int32_t nHeight, int64_t nTime)
+{
+    if (hashPrevBlock.IsNull() || !CCEvalCacheIsCacheable(evalcode))
+        return false;
+    return ccEvalCache.Get(txid, nIn, evalcode, hashPrevBlock, nHeight, nTime);
+}
+
+void CCEvalCacheSet(const uint256 &txid, uint32_t nIn, uint8_t evalcode, const uint256 &hashPrevBlock, int32_t nHeight, int64_t nTime)
+{
+    if (hashPrevBlock.IsNull() || !CCEvalCacheIsCacheable(evalcode))
+        return;
+    ccEvalCache.Set(txid, nIn, evalcode, hashPrevBlock, nHeight, nTime);
+}
+
+void CCEvalCacheClear()
+{
+    ccEvalCache.Clear();
+}
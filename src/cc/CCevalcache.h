@@ -0,0 +1,40 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_EVALCACHE_H
+#define CC_EVALCACHE_H
+
+#include <stdint.h>
+#include "uint256.h"
+
+/** -maxccevalcachesize default (number of cached positive CC eval results, 0 = disabled) */
+static const int64_t DEFAULT_MAX_CCEVAL_CACHE_SIZE = 50000;
+
+/**
+ * Valid CC eval results cache, to avoid running a module validator twice for
+ * every transaction (once when accepted into the mempool, and again when the
+ * block that contains it is connected on top of the same tip).
+ *
+ * An entry is reused only if:
+ *  - the evalcode is allowed to be cached (its validator depends on the tx, its inputs and the height only),
+ *  - the validation is done on top of the same previous block and at the same height,
+ *  - no CC upgrade activates between the cached and the current validation time.
+ */
+bool CCEvalCacheIsCacheable(uint8_t evalcode);
+bool CCEvalCacheGet(const uint256 &txid, uint32_t nIn, uint8_t evalcode, const uint256 &hashPrevBlock, int32_t nHeight, int64_t nTime);
+void CCEvalCacheSet(const uint256 &txid, uint32_t nIn, uint8_t evalcode, const uint256 &hashPrevBlock, int32_t nHeight, int64_t nTime);
+void CCEvalCacheClear();
+
+#endif // CC_EVALCACHE_H
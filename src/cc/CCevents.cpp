@@ -0,0 +1,99 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCevents.h"
+
+#include "cc/CCinclude.h"
+#include "cc/eval.h"
+#include "primitives/transaction.h"
+#include "rpc/server.h"
+#include "script/cc.h"
+#include "utilstrencodings.h"
+
+static void PushEvalFuncid(UniValue &obj, const std::string &prefix, const vscript_t &opret)
+{
+    if (opret.size() < 2)
+        return;
+    obj.push_back(Pair(prefix + "evalcode", HexStr(&opret[0], &opret[1])));
+    obj.push_back(Pair(prefix + "funcid", std::string(1, (char)opret[1])));
+}
+
+bool CCEventToJSON(const CTransaction &tx, UniValue &event)
+{
+    UniValue vins(UniValue::VARR), vouts(UniValue::VARR);
+    for (const CTxIn &txin : tx.vin) {
+        if (!IsCCInput(txin.scriptSig))
+            continue;
+        UniValue in(UniValue::VOBJ);
+        in.push_back(Pair("txid", txin.prevout.hash.GetHex()));
+        in.push_back(Pair("vout", (uint64_t)txin.prevout.n));
+        vins.push_back(in);
+    }
+    CAmount nCCValueOut = 0;
+    for (size_t n = 0; n < tx.vout.size(); n++) {
+        if (!tx.vout[n].scriptPubKey.IsPayToCryptoCondition())
+            continue;
+        char ccaddr[KOMODO_ADDRESS_BUFSIZE] = "";
+        Getscriptaddress(ccaddr, tx.vout[n].scriptPubKey);
+        UniValue out(UniValue::VOBJ);
+        out.push_back(Pair("n", (uint64_t)n));
+        out.push_back(Pair("value", ValueFromAmount(tx.vout[n].nValue)));
+        out.push_back(Pair("valueSat", tx.vout[n].nValue));
+        out.push_back(Pair("address", ccaddr));
+        vouts.push_back(out);
+        nCCValueOut += tx.vout[n].nValue;
+    }
+    if (vins.empty() && vouts.empty())
+        return false;
+
+    event = UniValue(UniValue::VOBJ);
+    event.push_back(Pair("txid", tx.GetHash().GetHex()));
+
+    vscript_t opret;
+    if (!tx.vout.empty() && GetOpReturnData(tx.vout.back().scriptPubKey, opret) && opret.size() >= 2) {
+        PushEvalFuncid(event, "", opret);
+        if (opret[0] == EVAL_TOKENS || opret[0] == EVAL_TOKENSV2) {
+            uint256 tokenid;
+            std::vector<CPubKey> voutPubkeys;
+            std::vector<vscript_t> oprets;
+            uint8_t funcid = opret[0] == EVAL_TOKENS ?
+                DecodeTokenOpRetV1(tx.vout.back().scriptPubKey, tokenid, voutPubkeys, oprets) :
+                DecodeTokenOpRetV2(tx.vout.back().scriptPubKey, tokenid, oprets);
+            // a token creation tx is the tokenid
+            if (funcid == 'c')
+                tokenid = tx.GetHash();
+            if (funcid != 0)
+                event.push_back(Pair("tokenid", tokenid.GetHex()));
+            vscript_t vopretCC;
+            if (funcid != 0 && GetOpReturnCCBlob(oprets, vopretCC))
+                PushEvalFuncid(event, "inner", vopretCC);
+        }
+    }
+    event.push_back(Pair("vin", vins));
+    event.push_back(Pair("vout", vouts));
+    event.push_back(Pair("ccvalueout", ValueFromAmount(nCCValueOut)));
+    return true;
+}
+
+UniValue NotarizationEventToJSON(int32_t height, int32_t notarizedHeight, const uint256 &notarizedHash, const uint256 &destTxid, const uint256 &txid)
+{
+    UniValue event(UniValue::VOBJ);
+    event.push_back(Pair("txid", txid.GetHex()));
+    event.push_back(Pair("height", height));
+    event.push_back(Pair("notarizedheight", notarizedHeight));
+    event.push_back(Pair("notarizedhash", notarizedHash.GetHex()));
+    event.push_back(Pair("desttxid", destTxid.GetHex()));
+    return event;
+}
@@ -0,0 +1,38 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_EVENTS_H
+#define CC_EVENTS_H
+
+#include <univalue.h>
+
+#include <stdint.h>
+
+class CTransaction;
+class uint256;
+
+/**
+ * Decodes a CC transaction into the event the ZMQ and AMQP notifiers publish:
+ * the evalcode and funcid of its opreturn, the tokenid of a token tx, the
+ * evalcode and funcid of the opreturn a token tx carries for another module
+ * (an assets order), and its CC inputs and outputs with their amounts.
+ * Returns false for a tx which spends and pays no CC output.
+ */
+bool CCEventToJSON(const CTransaction &tx, UniValue &event);
+
+/** The notarization event of the notarized signal: notarizedHeight is notarized by txid in the block at height */
+UniValue NotarizationEventToJSON(int32_t height, int32_t notarizedHeight, const uint256 &notarizedHash, const uint256 &destTxid, const uint256 &txid);
+
+#endif // CC_EVENTS_H
@@ -0,0 +1,37 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_GATEWAYSINDEX_H
+#define CC_GATEWAYSINDEX_H
+
+class CBlock;
+class CBlockIndex;
+
+extern bool fGatewaysIndex;  // if -gatewaysindex is enabled
+
+/**
+ * Gateways index: the state of the withdraws of each bind, as the withdraw,
+ * partial signing or complete signing tx holding the unspent vout0 marker,
+ * so gatewayspendingwithdraws and gatewaysprocessed read the markers of one
+ * bind instead of every unspent output of the gateways address.
+ *
+ * A marker is added when its tx is connected and erased when the next tx of
+ * the withdraw spends it, disconnecting a block reverts both. Only confirmed
+ * txns are indexed, as the address unspent index they replace.
+ */
+bool GatewaysIndexConnectBlock(const CBlock &block, const CBlockIndex *pindex);     // in gateways.cpp
+bool GatewaysIndexDisconnectBlock(const CBlock &block, const CBlockIndex *pindex);
+
+#endif // CC_GATEWAYSINDEX_H
@@ -0,0 +1,355 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCheirbook.h"
+
+#include "heir_validate.h"
+#include "main.h"
+
+#include <map>
+#include <boost/thread.hpp>
+
+// most plan vouts heirinfo reports as available, as many as heirclaim adds
+static const int32_t HEIR_BOOK_MAX_AVAILABLE_INPUTS = 60;
+
+namespace {
+
+class CHeirBook
+{
+private:
+    /// 'A' or 'C' tx of a plan with unspent plan vouts
+    struct TxState {
+        int32_t nHeight;
+        bool fOwner;                    //!< has owner inputs, donations do not reset the inactivity time
+        uint8_t hasHeirSpendingBegun;
+        int32_t nUnspent;
+    };
+    struct Plan {
+        HeirBookPlan info;
+        std::string addr;               //!< coins or tokens 1of2 address of the owner and heir
+        std::map<COutPoint, CAmount> unspents;
+        std::map<uint256, TxState> txs;
+    };
+    std::map<uint256, Plan> mapPlans;       //!< by fundingtxid
+    std::map<COutPoint, uint256> mapUtxos;  //!< fundingtxid of each unspent plan vout
+    bool fBuilt;
+    uint256 hashTip;
+    std::string markeraddr;
+
+    void Clear()
+    {
+        mapPlans.clear();
+        mapUtxos.clear();
+        fBuilt = false;
+    }
+
+    /// decodes the plan a heir tx belongs to, fundingtxid is the txid itself for 'F'
+    static uint8_t DecodePlanTx(const CTransaction &tx, uint256 &fundingtxid, uint256 &tokenid, uint8_t &hasHeirSpendingBegun)
+    {
+        if (tx.vout.size() < 2)
+            return 0;
+        uint8_t funcId = DecodeHeirEitherOpRetV1(tx.vout.back().scriptPubKey, tokenid, fundingtxid, hasHeirSpendingBegun, true);
+        if (funcId == 'F')
+            fundingtxid = tx.GetHash();
+        return funcId;
+    }
+
+    static bool IsPlanVout(const Plan &plan, const CTransaction &tx, int32_t v)
+    {
+        char destaddr[KOMODO_ADDRESS_BUFSIZE];
+
+        if (tx.vout[v].nValue <= 0 || !tx.vout[v].scriptPubKey.IsPayToCryptoCondition())
+            return false;
+        if (!Getscriptaddress(destaddr, tx.vout[v].scriptPubKey) || plan.addr != destaddr)
+            return false;
+        if (!plan.info.tokenid.IsNull())
+        {
+            struct CCcontract_info *cp, C;
+            cp = CCinit(&C, EVAL_TOKENS);
+            return IsTokensvout<TokensV1>(cp, nullptr, tx, v, plan.info.tokenid) > 0;
+        }
+        return true;
+    }
+
+    /// creates the plan of an 'F' tx with its marker on the heir global address, as heirlist finds them
+    void CreatePlan(const CTransaction &tx)
+    {
+        char destaddr[KOMODO_ADDRESS_BUFSIZE];
+        Plan plan;
+        HeirBookPlan &info = plan.info;
+        bool fMarker = false;
+
+        info.fundingtxid = tx.GetHash();
+        if (mapPlans.count(info.fundingtxid) != 0 || tx.vout.size() < 2)
+            return;
+        if (DecodeHeirEitherOpRetV1(tx.vout.back().scriptPubKey, info.tokenid, info.ownerPubkey, info.heirPubkey, info.inactivityTimeSec, info.heirName, info.memo, true) != 'F')
+            return;
+        for (int32_t v = 0; v < (int32_t)tx.vout.size() - 1 && !fMarker; v++)
+            fMarker = tx.vout[v].scriptPubKey.IsPayToCryptoCondition() && Getscriptaddress(destaddr, tx.vout[v].scriptPubKey) && markeraddr == destaddr;
+        if (!fMarker)
+            return;
+        if (info.tokenid.IsNull())
+            CoinHelper::GetCoinsOrTokensCCaddress1of2(destaddr, info.ownerPubkey, info.heirPubkey);
+        else
+            TokenHelper::GetCoinsOrTokensCCaddress1of2(destaddr, info.ownerPubkey, info.heirPubkey);
+        plan.addr = destaddr;
+        info.latesttxid = info.fundingtxid;
+        info.hasHeirSpendingBegun = 0;
+        info.lifetime = info.available = 0;
+        mapPlans[info.fundingtxid] = plan;
+    }
+
+    void AddUnspent(Plan &plan, const CTransaction &tx, int32_t v, int32_t nHeight, uint8_t funcId, uint8_t hasHeirSpendingBegun)
+    {
+        const uint256 &txid = tx.GetHash();
+        COutPoint outpoint(txid, v);
+        if (mapUtxos.count(outpoint) != 0)
+            return;
+        mapUtxos[outpoint] = plan.info.fundingtxid;
+        plan.unspents[outpoint] = tx.vout[v].nValue;
+        if (funcId == 'F')
+            return;
+        std::map<uint256, TxState>::iterator it = plan.txs.find(txid);
+        if (it == plan.txs.end()) {
+            TxState state;
+            state.nHeight = nHeight;
+            state.fOwner = TotalPubkeyNormalInputs(nullptr, tx, plan.info.ownerPubkey) > 0 || TotalPubkeyCCInputs(nullptr, tx, plan.info.ownerPubkey) > 0;
+            state.hasHeirSpendingBegun = hasHeirSpendingBegun;
+            state.nUnspent = 0;
+            it = plan.txs.insert(std::make_pair(txid, state)).first;
+        }
+        it->second.nUnspent++;
+    }
+
+    void EraseUnspent(const COutPoint &outpoint)
+    {
+        std::map<COutPoint, uint256>::iterator it = mapUtxos.find(outpoint);
+        if (it == mapUtxos.end())
+            return;
+        std::map<uint256, Plan>::iterator itPlan = mapPlans.find(it->second);
+        if (itPlan != mapPlans.end()) {
+            Plan &plan = itPlan->second;
+            plan.unspents.erase(outpoint);
+            std::map<uint256, TxState>::iterator itTx = plan.txs.find(outpoint.hash);
+            if (itTx != plan.txs.end() && --itTx->second.nUnspent <= 0)
+                plan.txs.erase(itTx);
+        }
+        mapUtxos.erase(it);
+    }
+
+    /// loads the plans from the markers and the state of each plan from its 1of2 address, cs_main is held
+    void Build()
+    {
+        struct CCcontract_info *cp, C;
+        char addr[KOMODO_ADDRESS_BUFSIZE];
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > markers;
+
+        Clear();
+        cp = CCinit(&C, EVAL_HEIR);
+        GetCCaddress(cp, addr, GetUnspendable(cp, NULL));
+        markeraddr = addr;
+        SetCCunspents(markers, addr, true);
+        for (const auto &marker : markers)
+        {
+            CTransaction tx;
+            uint256 hashBlock;
+            if (IsTxidInActiveChain(marker.first.txhash) && myGetTransaction(marker.first.txhash, tx, hashBlock))
+                CreatePlan(tx);
+        }
+
+        for (auto &entry : mapPlans)
+        {
+            Plan &plan = entry.second;
+            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspents;
+            std::vector<std::pair<CAddressIndexKey, CAmount> > outputs;
+            strcpy(addr, plan.addr.c_str());
+
+            SetCCunspents(unspents, addr, true);
+            for (const auto &unspent : unspents)
+            {
+                CTransaction tx;
+                uint256 hashBlock, fundingtxid, tokenid;
+                uint8_t hasHeirSpendingBegun = 0, funcId;
+                int32_t v = (int32_t)unspent.first.index;
+                if (!myGetTransaction(unspent.first.txhash, tx, hashBlock) || v >= (int32_t)tx.vout.size() - 1)
+                    continue;
+                if ((funcId = DecodePlanTx(tx, fundingtxid, tokenid, hasHeirSpendingBegun)) == 0 || fundingtxid != entry.first)
+                    continue;
+                if ((plan.info.tokenid.IsNull() || plan.info.tokenid == tokenid) && IsPlanVout(plan, tx, v))
+                    AddUnspent(plan, tx, v, (int32_t)unspent.second.blockHeight, funcId, hasHeirSpendingBegun);
+            }
+
+            SetAddressIndexOutputs(outputs, addr, true);
+            for (const auto &output : outputs)
+            {
+                CTransaction tx;
+                uint256 hashBlock, fundingtxid, tokenid;
+                uint8_t hasHeirSpendingBegun = 0, funcId;
+                if (output.second <= 0 || output.first.spending || !myGetTransaction(output.first.txhash, tx, hashBlock) || (int32_t)output.first.index >= (int32_t)tx.vout.size() - 1)
+                    continue;
+                if ((funcId = DecodePlanTx(tx, fundingtxid, tokenid, hasHeirSpendingBegun)) == 0 || isSpendingTx(funcId) || fundingtxid != entry.first)
+                    continue;
+                if ((plan.info.tokenid.IsNull() || plan.info.tokenid == tokenid) && IsPlanVout(plan, tx, (int32_t)output.first.index))
+                    plan.info.lifetime += output.second;
+            }
+        }
+        hashTip = chainActive.Tip() != NULL ? chainActive.Tip()->GetBlockHash() : uint256();
+        fBuilt = true;
+        LogPrint("heir", "%s built with %d plans and %d unspent plan vouts\n", __func__, (int)mapPlans.size(), (int)mapUtxos.size());
+    }
+
+public:
+    boost::mutex cs_book;
+
+    CHeirBook() : fBuilt(false) {}
+
+    bool IsBuilt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        return fBuilt;
+    }
+
+    /// cs_main is held
+    void EnsureBuilt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        if (!fBuilt)
+            Build();
+    }
+
+    void GetPlanIds(std::vector<uint256> &fundingtxids)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        for (const auto &entry : mapPlans)
+            fundingtxids.push_back(entry.first);
+    }
+
+    bool GetPlan(const uint256 &fundingtxid, HeirBookPlan &info, std::vector<std::pair<COutPoint, CAmount> > &unspents)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        std::map<uint256, Plan>::const_iterator it = mapPlans.find(fundingtxid);
+        if (it == mapPlans.end())
+            return false;
+        const Plan &plan = it->second;
+        info = plan.info;
+        // the highest owner tx, the lowest txid of a height first as the address index lists them
+        int32_t nLatestHeight = 0;
+        for (const auto &tx : plan.txs)
+            if (tx.second.fOwner && tx.second.nHeight > nLatestHeight) {
+                nLatestHeight = tx.second.nHeight;
+                info.latesttxid = tx.first;
+                info.hasHeirSpendingBegun = tx.second.hasHeirSpendingBegun;
+            }
+        unspents.assign(plan.unspents.begin(), plan.unspents.end());
+        return true;
+    }
+
+    void ConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        if (!fBuilt)
+            return;
+        if (pindex->pprev == NULL || pindex->pprev->GetBlockHash() != hashTip) {
+            Clear();
+            return;
+        }
+        for (const CTransaction &tx : block.vtx)
+        {
+            uint256 fundingtxid, tokenid;
+            uint8_t hasHeirSpendingBegun = 0, funcId;
+
+            for (const CTxIn &vin : tx.vin)
+                EraseUnspent(vin.prevout);
+            if ((funcId = DecodePlanTx(tx, fundingtxid, tokenid, hasHeirSpendingBegun)) == 0)
+                continue;
+            if (funcId == 'F')
+                CreatePlan(tx);
+            std::map<uint256, Plan>::iterator it = mapPlans.find(fundingtxid);
+            if (it == mapPlans.end())
+                continue;
+            Plan &plan = it->second;
+            if (!plan.info.tokenid.IsNull() && plan.info.tokenid != tokenid)
+                continue;
+            for (int32_t v = 0; v < (int32_t)tx.vout.size() - 1; v++)
+                if (IsPlanVout(plan, tx, v))
+                {
+                    if (!isSpendingTx(funcId))
+                        plan.info.lifetime += tx.vout[v].nValue;
+                    AddUnspent(plan, tx, v, pindex->GetHeight(), funcId, hasHeirSpendingBegun);
+                }
+        }
+        hashTip = pindex->GetBlockHash();
+    }
+
+    void DisconnectBlock()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        // the vouts spent by the block would have to be reloaded, the next query rebuilds instead
+        if (fBuilt)
+            Clear();
+    }
+};
+
+CHeirBook heirBook;
+
+bool EnsureHeirBook()
+{
+    if (KOMODO_NSPV_SUPERLITE)
+        return false;
+    if (!heirBook.IsBuilt())
+    {
+        LOCK(cs_main);
+        heirBook.EnsureBuilt();
+    }
+    return true;
+}
+
+}
+
+bool HeirBookGetPlanIds(std::vector<uint256> &fundingtxids)
+{
+    if (!EnsureHeirBook())
+        return false;
+    heirBook.GetPlanIds(fundingtxids);
+    return true;
+}
+
+bool HeirBookGetPlan(const uint256 &fundingtxid, HeirBookPlan &plan)
+{
+    std::vector<std::pair<COutPoint, CAmount> > unspents;
+    int32_t n = 0;
+
+    if (!EnsureHeirBook() || !heirBook.GetPlan(fundingtxid, plan, unspents))
+        return false;
+    for (const auto &unspent : unspents)
+    {
+        if (myIsutxo_spentinmempool(ignoretxid, ignorevin, unspent.first.hash, unspent.first.n))
+            continue;
+        plan.available += unspent.second;
+        if (++n >= HEIR_BOOK_MAX_AVAILABLE_INPUTS)
+            break;
+    }
+    return true;
+}
+
+void HeirBookConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+    heirBook.ConnectBlock(block, pindex);
+}
+
+void HeirBookDisconnectBlock()
+{
+    heirBook.DisconnectBlock();
+}
@@ -0,0 +1,63 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_HEIRBOOK_H
+#define CC_HEIRBOOK_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "amount.h"
+#include "pubkey.h"
+#include "uint256.h"
+
+class CBlock;
+class CBlockIndex;
+
+/// state of a heir plan, as heirinfo reports it
+struct HeirBookPlan
+{
+    uint256 fundingtxid;
+    uint256 tokenid;                //!< null for a coins plan
+    CPubKey ownerPubkey, heirPubkey;
+    std::string heirName, memo;
+    int64_t inactivityTimeSec;
+    uint256 latesttxid;             //!< latest owner 'A' or 'C' tx with an unspent plan vout, fundingtxid if none (as FindLatestFundingTx)
+    uint8_t hasHeirSpendingBegun;   //!< flag in the opret of latesttxid
+    CAmount lifetime;               //!< deposited to the plan by its 'F' and 'A' txns
+    CAmount available;              //!< unspent plan vouts not spent in the mempool, at most 60 of them as heirclaim would add
+};
+
+/**
+ * In-memory book of the heir cc plans and their state, so heirlist does not
+ * load the tx of every marker on the heir global address and heirinfo does
+ * not walk the unspents and the address index of the 1of2 plan address.
+ *
+ * The book is built from the marker and plan address indexes on its first use
+ * and then follows the active chain on each connected tip. A disconnected tip
+ * drops the book, it is rebuilt on the next query. Only confirmed plans and
+ * txns are kept, an unconfirmed plan is not in it.
+ */
+
+/// returns false if there is no book (nspv mode), the caller scans the indexes itself then
+bool HeirBookGetPlanIds(std::vector<uint256> &fundingtxids);
+
+/// returns false if there is no book or fundingtxid is not a confirmed plan. The owner activity is from latesttxid, see CCduration
+bool HeirBookGetPlan(const uint256 &fundingtxid, HeirBookPlan &plan);
+
+void HeirBookConnectBlock(const CBlock &block, const CBlockIndex *pindex);
+void HeirBookDisconnectBlock();
+
+#endif // CC_HEIRBOOK_H
@@ -388,6 +388,12 @@ static int32_t ignorevin;
 /// @param[out] hashBlock hash of the block where the tx resides
 bool myGetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock);
 
+/// myGetTransaction without a copy of the transaction, it is shared with the mempool or the CC tx cache
+/// @param hash hash of transaction to get (txid)
+/// @param[out] ptx returned transaction, NULL when not found
+/// @param[out] hashBlock hash of the block where the tx resides
+bool myGetTransaction(const uint256 &hash, CTransactionRef &ptx, uint256 &hashBlock);
+
 /// NSPV_myGetTransaction is called in NSPV mode
 /// @param hash hash of transaction to get (txid)
 /// @param[out] txOut returned transaction object
@@ -860,6 +866,11 @@ CPubKey check_signing_pubkey(CScript scriptSig);
 /// @param scriptPubKey scriptPubKey of the utxo spent by the input to sign
 bool SignTx(CMutableTransaction &mtx,int32_t vini,int64_t utxovalue,const CScript scriptPubKey);
 
+/// same as SignTx, for signing several inputs of a transaction
+/// @param txConst copy of mtx to compute the signature hash from, the scriptSigs are not hashed so it is taken once with the final vouts
+/// @param txdata signature hash midstates of txConst, shared by all its inputs
+bool SignTx(CMutableTransaction &mtx,int32_t vini,int64_t utxovalue,const CScript scriptPubKey,const CTransaction &txConst,const PrecomputedTransactionData &txdata);
+
 extern std::vector<CPubKey> NULL_pubkeys; //!< constant value for use in functions where such value might be passed @see FinalizeCCTx
 
 #define FINALIZECCTX_ALWAYS_CHANGE       0x0
@@ -922,17 +933,27 @@ void SetCCunspents(std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValu
 /// @param CCflag if true the function searches for cc outputs, otherwise for normal outputs
 void SetCCunspentsWithMempool(std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs, char *coinaddr, bool ccflag = true);
 
+/// IterateCCunspents calls func for each unspent output on an address, without collecting all of them in a vector first
+/// @param coinaddr address where unspent outputs are searched
+/// @param CCflag if true the function searches for cc outputs, otherwise for normal outputs
+/// @param func called with the key and value of each output, returns false to stop the iteration
+/// @param[in,out] cursor optional resume position: the iteration starts after the output it holds (a null key starts from the first output), on return it holds the last output passed to func
+/// @returns true if all outputs were passed to func, false if func stopped the iteration
+bool IterateCCunspents(char *coinaddr, bool CCflag, const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> &func, CAddressUnspentKey *cursor = NULL);
+
 /// SetCCunspents returns a vector of unspent outputs for a cc address and creationid of cc instance
 /// @param[out] unspentOutputs vector of pairs of objects CAddressUnspentCCKey and CAddressUnspentCCValue
 /// @param coinaddr cc address where unspent outputs are searched
 /// @param creationid cc instance creationid for which outputs are searched
-void SetCCunspentsCCIndex(std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, const char *coinaddr, uint256 creationId = uint256());
+/// @param funcids if not empty only outputs with one of these funcids are returned, without reading their transactions
+void SetCCunspentsCCIndex(std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, const char *coinaddr, uint256 creationId = uint256(), const std::string &funcids = std::string());
 
 /// Adds mempool outputs to a vector of unspent outputs for a cc address
 /// @param[out] unspentOutputs vector of pairs of objects CAddressUnspentCCKey and CAddressUnspentCCValue
 /// @param coinaddr cc address where unspent outputs are searched
 /// @param creationId txid of cc instance creation tx, can be empty to return all txns on coinaddr 
-void AddCCunspentsCCIndexMempool(std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, const char *coinaddr, uint256 creationId = uint256());
+/// @param funcids if not empty only outputs with one of these funcids are added
+void AddCCunspentsCCIndexMempool(std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, const char *coinaddr, uint256 creationId = uint256(), const std::string &funcids = std::string());
 
 /// SetAddressIndexOutputs searches address index for a vector of outputs on an address
 /// @param[out] addressIndex vector of pairs of address index key and amount
@@ -951,6 +972,14 @@ void SetAddressIndexOutputs(std::vector<std::pair<CAddressIndexKey, CAmount>>& a
 /// @param func funcid for which outputs will be filtered
 void SetCCtxids(std::vector<uint256> &txids,char *coinaddr,bool ccflag, uint8_t evalcode, int64_t amount, uint256 filtertxid, uint8_t func);
 
+/// IterateCCtxids calls func for each address index entry of an address (outputs and spends), without collecting all of them in a vector first
+/// @param coinaddr address where the outputs are searched
+/// @param ccflag if true the function searches for cc outputs, otherwise for normal outputs
+/// @param func called with the key and amount of each entry (negative for spends), returns false to stop the iteration
+/// @param[in,out] cursor optional resume position, see IterateCCunspents
+/// @returns true if all entries were passed to func, false if func stopped the iteration
+bool IterateCCtxids(char *coinaddr, bool ccflag, const std::function<bool(const CAddressIndexKey&, CAmount)> &func, CAddressIndexKey *cursor = NULL);
+
 /// In NSPV mode adds normal (not cc) inputs to the transaction object vin array for the specified total amount using available utxos on mypk's TX_PUBKEY address
 /// @param mtx mutable transaction object
 /// @param mypk pubkey to make TX_PUBKEY address from
@@ -1006,6 +1035,13 @@ int64_t CCutxovalue(char *coinaddr,uint256 utxotxid,int32_t utxovout,int32_t CCf
 /// @private
 int32_t CC_vinselect(int32_t *aboveip, CAmount *abovep, int32_t *belowip, CAmount *belowp, struct CC_utxo utxos[], int32_t numunspents, CAmount value);
 
+/// @private
+/// selects inputs for total out of the candidate values, sorted once: each pick is the smallest value covering the remaining amount or the largest one if none covers it
+/// @param values candidate utxo values, values <= 0 are skipped
+/// @param[out] totalinputs sum of the picked values
+/// @returns indexes into values in the pick order
+std::vector<int32_t> CC_selectinputs(const std::vector<CAmount> &values, CAmount total, int32_t maxinputs, CAmount &totalinputs);
+
 /// @private
 void CCAddVintxCond(struct CCcontract_info *cp, const CCwrapper &condWrapped, const uint8_t *priv = NULL);
 
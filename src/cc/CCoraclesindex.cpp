@@ -0,0 +1,147 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCoraclesindex.h"
+
+#include "CCinclude.h"
+#include "base58.h"
+#include "main.h"
+#include "txdb.h"
+
+#include <limits>
+
+#define CC_MARKER_VALUE 10000  // oracles baton value, as in oracles.cpp
+
+// number of samples read at once by OraclesIndexWalkBaton
+static const int ORACLES_INDEX_WALK_BATCH = 64;
+
+static bool OraclesBatonHash(const char *batonaddr, uint160 &hashBytes)
+{
+    int type;
+    return CBitcoinAddress(batonaddr).GetIndexKey(hashBytes, type, true);
+}
+
+// decodes tx as an oracles data tx with its baton on vout1, as OracleDataSamples selects them
+static bool OraclesIndexSample(const CTransaction &tx, uint256 &oracletxid, uint160 &hashBytes, COraclesSample &sample)
+{
+    char batonaddr[KOMODO_ADDRESS_BUFSIZE];
+    CPubKey pk;
+
+    if (tx.vout.size() < 2 || tx.vout[1].nValue != CC_MARKER_VALUE || !tx.vout[1].scriptPubKey.IsPayToCryptoCondition())
+        return false;
+    if (DecodeOraclesData(tx.vout.back().scriptPubKey, oracletxid, sample.batontxid, pk, sample.data) != 'D')
+        return false;
+    if (!Getscriptaddress(batonaddr, tx.vout[1].scriptPubKey) || !OraclesBatonHash(batonaddr, hashBytes))
+        return false;
+    sample.txid = tx.GetHash();
+    return true;
+}
+
+static void OraclesIndexBlockSamples(const CBlock &block, const CBlockIndex *pindex, std::vector<std::pair<COraclesSampleKey, COraclesSample> > &samples)
+{
+    for (unsigned int i = 0; i < block.vtx.size(); i++)
+    {
+        uint256 oracletxid;
+        uint160 hashBytes;
+        COraclesSample sample;
+        if (OraclesIndexSample(block.vtx[i], oracletxid, hashBytes, sample))
+            samples.push_back(std::make_pair(COraclesSampleKey(oracletxid, hashBytes, pindex->GetHeight(), i), sample));
+    }
+}
+
+bool OraclesIndexConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+    std::vector<std::pair<COraclesSampleKey, COraclesSample> > samples;
+
+    OraclesIndexBlockSamples(block, pindex, samples);
+    if (samples.empty())
+        return true;
+    return pblocktree->WriteOraclesSamples(samples);
+}
+
+bool OraclesIndexDisconnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+    std::vector<std::pair<COraclesSampleKey, COraclesSample> > samples;
+    std::vector<COraclesSampleKey> keys;
+
+    OraclesIndexBlockSamples(block, pindex, samples);
+    if (samples.empty())
+        return true;
+    for (const auto &sample : samples)
+        keys.push_back(sample.first);
+    return pblocktree->EraseOraclesSamples(keys);
+}
+
+bool OraclesIndexGetSamples(const uint256 &oracletxid, const char *batonaddr, int32_t startHeight, int32_t endHeight, int32_t num, std::vector<COraclesSample> &samples)
+{
+    uint160 hashBytes;
+    std::vector<std::pair<COraclesSampleKey, COraclesSample> > indexed;
+
+    if (!OraclesBatonHash(batonaddr, hashBytes))
+        return false;
+    int32_t endKeyHeight = endHeight < 0 ? std::numeric_limits<int32_t>::max() : endHeight + 1;
+    if (!pblocktree->ReadOraclesSamples(COraclesSampleKey(oracletxid, hashBytes, endKeyHeight, 0), startHeight, num, indexed))
+        return false;
+    for (const auto &sample : indexed)
+        samples.push_back(sample.second);
+    return true;
+}
+
+uint256 OraclesIndexWalkBaton(const uint256 &oracletxid, const uint256 &batontxid, std::function<bool(const COraclesSample&)> fn)
+{
+    CTransaction tx;
+    uint256 hashBlock, txOracletxid;
+    uint160 hashBytes;
+    COraclesSample sample;
+    int32_t height;
+
+    if (!fOraclesIndex || myGetTransaction(batontxid, tx, hashBlock) == 0 || hashBlock.IsNull())
+        return batontxid;
+    if (!OraclesIndexSample(tx, txOracletxid, hashBytes, sample) || txOracletxid != oracletxid)
+        return batontxid;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+        if (mi == mapBlockIndex.end() || mi->second == NULL || !chainActive.Contains(mi->second))
+            return batontxid;
+        height = mi->second->GetHeight();
+    }
+
+    // samples are linked by their baton txid, the index order is only followed while it matches the chain
+    COraclesSampleKey endKey(oracletxid, hashBytes, height + 1, 0);
+    uint256 expected = batontxid;
+    bool fStarted = false;
+    while (true)
+    {
+        std::vector<std::pair<COraclesSampleKey, COraclesSample> > indexed;
+        if (!pblocktree->ReadOraclesSamples(endKey, 0, ORACLES_INDEX_WALK_BATCH, indexed) || indexed.empty())
+            return expected;
+        for (const auto &entry : indexed)
+        {
+            if (entry.second.txid != expected)
+            {
+                // skip the later samples at the baton tx height
+                if (!fStarted && entry.first.blockHeight == height)
+                    continue;
+                return expected;
+            }
+            fStarted = true;
+            if (!fn(entry.second))
+                return zeroid;
+            expected = entry.second.batontxid;
+        }
+        endKey = indexed.back().first;
+    }
+}
@@ -0,0 +1,50 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_ORACLESINDEX_H
+#define CC_ORACLESINDEX_H
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+#include "uint256.h"
+#include "oraclesindex.h"
+
+class CBlock;
+class CBlockIndex;
+
+extern bool fOraclesIndex;  // if -oraclesindex is enabled
+
+/**
+ * Oracles samples index: the decoded oracles data txns by oracle txid,
+ * publisher baton address and height, so oraclessamples and the gateways
+ * baton scans read a range of samples instead of loading each data tx.
+ *
+ * A data tx is indexed under the address of its baton vout1 when its block
+ * is connected and erased when it is disconnected. Only confirmed samples
+ * are indexed.
+ */
+bool OraclesIndexConnectBlock(const CBlock &block, const CBlockIndex *pindex);
+bool OraclesIndexDisconnectBlock(const CBlock &block, const CBlockIndex *pindex);
+
+/// the confirmed samples of oracletxid sent to batonaddr, newest first, in [startHeight, endHeight] (endHeight < 0 = the tip),
+/// at most num samples (0 = all)
+bool OraclesIndexGetSamples(const uint256 &oracletxid, const char *batonaddr, int32_t startHeight, int32_t endHeight, int32_t num, std::vector<COraclesSample> &samples);
+
+/// follows the baton chain of oracletxid back from batontxid through the index, calling fn for each sample until it returns false.
+/// Returns the txid the chain continues with when the index cannot tell (not indexed or not a sample), zeroid if fn stopped
+uint256 OraclesIndexWalkBaton(const uint256 &oracletxid, const uint256 &batontxid, std::function<bool(const COraclesSample&)> fn);
+
+#endif // CC_ORACLESINDEX_H
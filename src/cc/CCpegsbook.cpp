@@ -0,0 +1,278 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCpegsbook.h"
+
+#include "CCPegs.h"
+#include "arith_uint256.h"
+#include "main.h"
+
+#include <map>
+#include <set>
+#include <boost/thread.hpp>
+
+#define CC_MARKER_VALUE 10000  // pegs account marker value, as in pegs.cpp
+
+namespace {
+
+/// orders the accounts by debt / deposit, highest first. Those without a deposit or a debt have no ratio and are last
+struct PegsBookRatioOrder
+{
+    bool operator()(const PegsBookAccount &a, const PegsBookAccount &b) const
+    {
+        bool fRatioA = a.account.first > 0 && a.account.second > 0;
+        bool fRatioB = b.account.first > 0 && b.account.second > 0;
+        if (fRatioA != fRatioB)
+            return fRatioA;
+        if (fRatioA)
+        {
+            arith_uint256 lhs = arith_uint256((uint64_t)a.account.second) * arith_uint256((uint64_t)b.account.first);
+            arith_uint256 rhs = arith_uint256((uint64_t)b.account.second) * arith_uint256((uint64_t)a.account.first);
+            if (lhs != rhs)
+                return lhs > rhs;
+        }
+        return a.txid < b.txid;
+    }
+};
+
+class CPegsBook
+{
+private:
+    typedef std::set<PegsBookAccount, PegsBookRatioOrder> AccountSet;
+    struct Pegs {
+        std::map<uint256, AccountSet> tokens;   //!< by tokenid
+    };
+    std::map<uint256, Pegs> mapPegs;                //!< by pegstxid
+    std::map<uint256, std::pair<uint256, PegsBookAccount> > mapAccounts;  //!< pegstxid and account of each vout0 marker
+    char globaladdr[KOMODO_ADDRESS_BUFSIZE];
+    bool fBuilt;
+    uint256 hashTip;
+
+    void Clear()
+    {
+        mapPegs.clear();
+        mapAccounts.clear();
+        fBuilt = false;
+    }
+
+    /// vout0 is a marker on the pegs global 1of2 address
+    static bool IsAccountTx(const CTransaction &tx, const char *globaladdr)
+    {
+        char destaddr[KOMODO_ADDRESS_BUFSIZE];
+        if (tx.vout.size() < 3 || tx.vout[0].nValue != CC_MARKER_VALUE || !tx.vout[0].scriptPubKey.IsPayToCryptoCondition())
+            return false;
+        return Getscriptaddress(destaddr, tx.vout[0].scriptPubKey) && strcmp(destaddr, globaladdr) == 0;
+    }
+
+    void Erase(const COutPoint &outpoint)
+    {
+        if (outpoint.n != 0)
+            return;
+        std::map<uint256, std::pair<uint256, PegsBookAccount> >::iterator it = mapAccounts.find(outpoint.hash);
+        if (it == mapAccounts.end())
+            return;
+        std::map<uint256, Pegs>::iterator itPegs = mapPegs.find(it->second.first);
+        if (itPegs != mapPegs.end())
+        {
+            std::map<uint256, AccountSet>::iterator itToken = itPegs->second.tokens.find(it->second.second.tokenid);
+            if (itToken != itPegs->second.tokens.end())
+            {
+                itToken->second.erase(it->second.second);
+                if (itToken->second.empty())
+                    itPegs->second.tokens.erase(itToken);
+            }
+            if (itPegs->second.tokens.empty())
+                mapPegs.erase(itPegs);
+        }
+        mapAccounts.erase(it);
+    }
+
+    void Insert(const CTransaction &tx, const char *globaladdr)
+    {
+        PegsBookAccount account;
+        uint256 pegstxid;
+        CPubKey pk;
+        int64_t amount;
+        char owneraddr[KOMODO_ADDRESS_BUFSIZE];
+
+        account.txid = tx.GetHash();
+        if (mapAccounts.count(account.txid) != 0 || !IsAccountTx(tx, globaladdr))
+            return;
+        if ((account.funcid = DecodePegsOpRet(tx, pegstxid, account.tokenid)) == 0)
+            return;
+        account.account = std::make_pair(0, 0);
+        account.type = PegsDecodeAccountTx(tx, pk, amount, account.account);
+        if (Getscriptaddress(owneraddr, tx.vout[1].scriptPubKey))
+            account.owneraddr = owneraddr;
+        mapPegs[pegstxid].tokens[account.tokenid].insert(account);
+        mapAccounts[account.txid] = std::make_pair(pegstxid, account);
+    }
+
+    /// loads the accounts from the unspents of the global 1of2 address, cs_main is held
+    void Build(const char *globaladdr)
+    {
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspents;
+
+        Clear();
+        SetCCunspents(unspents, (char *)globaladdr, true);
+        for (const auto &unspent : unspents)
+        {
+            CTransaction tx;
+            uint256 hashBlock;
+            if (unspent.first.index != 0 || unspent.second.satoshis != CC_MARKER_VALUE || !IsTxidInActiveChain(unspent.first.txhash))
+                continue;
+            if (myGetTransaction(unspent.first.txhash, tx, hashBlock) != 0)
+                Insert(tx, globaladdr);
+        }
+        hashTip = chainActive.Tip() != NULL ? chainActive.Tip()->GetBlockHash() : uint256();
+        fBuilt = true;
+        LogPrint("pegs", "%s built with %d accounts of %d pegs\n", __func__, (int)mapAccounts.size(), (int)mapPegs.size());
+    }
+
+public:
+    boost::mutex cs_book;
+
+    CPegsBook() : fBuilt(false) { globaladdr[0] = 0; }
+
+    bool IsBuilt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        return fBuilt;
+    }
+
+    /// cs_main is held
+    void EnsureBuilt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        if (!fBuilt)
+        {
+            struct CCcontract_info *cp, C;
+            CPubKey pegspk;
+            cp = CCinit(&C, EVAL_PEGS);
+            pegspk = GetUnspendable(cp, 0);
+            GetCCaddress1of2(cp, globaladdr, pegspk, pegspk);
+            Build(globaladdr);
+        }
+    }
+
+    void GetAccounts(const uint256 &pegstxid, const uint256 &tokenid, std::vector<PegsBookAccount> &accounts)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        std::map<uint256, Pegs>::const_iterator it = mapPegs.find(pegstxid);
+        if (it == mapPegs.end())
+            return;
+        std::map<uint256, AccountSet>::const_iterator itToken = it->second.tokens.find(tokenid);
+        if (itToken != it->second.tokens.end())
+            accounts.insert(accounts.end(), itToken->second.begin(), itToken->second.end());
+    }
+
+    void GetTokens(const uint256 &pegstxid, std::vector<uint256> &tokenids)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        std::map<uint256, Pegs>::const_iterator it = mapPegs.find(pegstxid);
+        if (it == mapPegs.end())
+            return;
+        for (const auto &token : it->second.tokens)
+            tokenids.push_back(token.first);
+    }
+
+    void GetOwnerAccounts(const uint256 &pegstxid, const std::string &owneraddr, std::vector<PegsBookAccount> &accounts)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        std::map<uint256, Pegs>::const_iterator it = mapPegs.find(pegstxid);
+        if (it == mapPegs.end())
+            return;
+        for (const auto &token : it->second.tokens)
+            for (const PegsBookAccount &account : token.second)
+                if (account.owneraddr == owneraddr)
+                    accounts.push_back(account);
+    }
+
+    void ConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        if (!fBuilt)
+            return;
+        if (pindex->pprev == NULL || pindex->pprev->GetBlockHash() != hashTip) {
+            Clear();
+            return;
+        }
+        for (const CTransaction &tx : block.vtx)
+        {
+            for (const CTxIn &vin : tx.vin)
+                Erase(vin.prevout);
+            Insert(tx, globaladdr);
+        }
+        hashTip = pindex->GetBlockHash();
+    }
+
+    void DisconnectBlock()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        // the accounts spent by the block would have to be reloaded, the next query rebuilds instead
+        if (fBuilt)
+            Clear();
+    }
+};
+
+CPegsBook pegsBook;
+
+bool EnsurePegsBook()
+{
+    if (KOMODO_NSPV_SUPERLITE)
+        return false;
+    if (!pegsBook.IsBuilt())
+    {
+        LOCK(cs_main);
+        pegsBook.EnsureBuilt();
+    }
+    return true;
+}
+
+}
+
+bool PegsBookGetAccounts(const uint256 &pegstxid, const uint256 &tokenid, std::vector<PegsBookAccount> &accounts)
+{
+    if (!EnsurePegsBook())
+        return false;
+    pegsBook.GetAccounts(pegstxid, tokenid, accounts);
+    return true;
+}
+
+bool PegsBookGetTokens(const uint256 &pegstxid, std::vector<uint256> &tokenids)
+{
+    if (!EnsurePegsBook())
+        return false;
+    pegsBook.GetTokens(pegstxid, tokenids);
+    return true;
+}
+
+bool PegsBookGetOwnerAccounts(const uint256 &pegstxid, const std::string &owneraddr, std::vector<PegsBookAccount> &accounts)
+{
+    if (!EnsurePegsBook())
+        return false;
+    pegsBook.GetOwnerAccounts(pegstxid, owneraddr, accounts);
+    return true;
+}
+
+void PegsBookConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+    pegsBook.ConnectBlock(block, pindex);
+}
+
+void PegsBookDisconnectBlock()
+{
+    pegsBook.DisconnectBlock();
+}
@@ -0,0 +1,65 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_PEGSBOOK_H
+#define CC_PEGSBOOK_H
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "uint256.h"
+
+class CBlock;
+class CBlockIndex;
+
+/// pegs account tx with its unspent vout0 marker on the pegs global 1of2 address
+struct PegsBookAccount
+{
+    uint256 txid;
+    uint256 tokenid;
+    uint8_t funcid;
+    std::string type;                       //!< as PegsDecodeAccountTx, empty for the txns it does not decode
+    std::pair<int64_t, int64_t> account;    //!< deposit, debt
+    std::string owneraddr;                  //!< 1of2 address of the owner and pegs pubkeys of the vout1 marker
+};
+
+/**
+ * In-memory index of the pegs accounts by pegstxid and tokenid, ordered by
+ * debt to deposit ratio, highest first. All accounts of a token are valued at
+ * the same token price, so the order does not change when prices move: the
+ * accounts for a redemption or a liquidation are at the head, and only those
+ * need their ratio computed at the current price.
+ *
+ * The index is built from the unspents of the pegs global 1of2 address on
+ * its first use and then follows the active chain on each connected tip. A
+ * disconnected tip drops the index, it is rebuilt on the next query. Only
+ * confirmed accounts are kept, the callers still skip those spent in the
+ * mempool.
+ */
+
+/// the accounts of tokenid in pegstxid, highest ratio first. Returns false if there is no index (nspv mode), the caller scans the address itself then
+bool PegsBookGetAccounts(const uint256 &pegstxid, const uint256 &tokenid, std::vector<PegsBookAccount> &accounts);
+
+/// the tokens with accounts in pegstxid
+bool PegsBookGetTokens(const uint256 &pegstxid, std::vector<uint256> &tokenids);
+
+/// the accounts of pegstxid with the vout1 marker on owneraddr
+bool PegsBookGetOwnerAccounts(const uint256 &pegstxid, const std::string &owneraddr, std::vector<PegsBookAccount> &accounts);
+
+void PegsBookConnectBlock(const CBlock &block, const CBlockIndex *pindex);
+void PegsBookDisconnectBlock();
+
+#endif // CC_PEGSBOOK_H
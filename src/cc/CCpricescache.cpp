@@ -0,0 +1,128 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCpricescache.h"
+
+#include "util.h"
+
+#include <list>
+#include <map>
+#include <utility>
+#include <boost/thread.hpp>
+
+namespace {
+
+class CPricesCache
+{
+private:
+    typedef std::pair<uint256, int32_t> Key;  //!< synthetic expression hash, height
+    struct Entry {
+        int64_t price;
+        std::list<Key>::iterator itLru;
+    };
+    //! most recently used first
+    std::list<Key> lru;
+    std::map<Key, Entry> mapPrices;
+    int32_t nMaxHeight = -1;  //!< highest cached height, to skip EraseFrom on a new tip
+    boost::mutex cs_pricescache;
+
+    void Erase(std::map<Key, Entry>::iterator it)
+    {
+        lru.erase(it->second.itLru);
+        mapPrices.erase(it);
+    }
+
+public:
+    bool Get(const Key &key, int64_t &price)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_pricescache);
+
+        std::map<Key, Entry>::iterator it = mapPrices.find(key);
+        if (it == mapPrices.end())
+            return false;
+        lru.splice(lru.begin(), lru, it->second.itLru);
+        price = it->second.price;
+        return true;
+    }
+
+    void Set(const Key &key, int64_t price)
+    {
+        int64_t nMaxCacheSize = GetArg("-maxpricescachesize", DEFAULT_MAX_PRICES_CACHE_SIZE);
+        if (nMaxCacheSize <= 0) return;
+
+        boost::unique_lock<boost::mutex> lock(cs_pricescache);
+
+        std::map<Key, Entry>::iterator it = mapPrices.find(key);
+        if (it != mapPrices.end())
+            Erase(it);
+        while (static_cast<int64_t>(mapPrices.size()) >= nMaxCacheSize)
+            Erase(mapPrices.find(lru.back()));
+
+        lru.push_front(key);
+        Entry &entry = mapPrices[key];
+        entry.price = price;
+        entry.itLru = lru.begin();
+        if (key.second > nMaxHeight)
+            nMaxHeight = key.second;
+    }
+
+    void EraseFrom(int32_t height)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_pricescache);
+
+        if (height > nMaxHeight)
+            return;
+        std::map<Key, Entry>::iterator it = mapPrices.begin();
+        while (it != mapPrices.end()) {
+            if (it->first.second >= height)
+                Erase(it++);
+            else
+                it++;
+        }
+        nMaxHeight = height - 1;
+    }
+
+    void Clear()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_pricescache);
+        mapPrices.clear();
+        lru.clear();
+        nMaxHeight = -1;
+    }
+};
+
+CPricesCache pricesCache;
+
+}
+
+bool PricesCacheGet(const uint256 &exprhash, int32_t height, int64_t &price)
+{
+    return pricesCache.Get(std::make_pair(exprhash, height), price);
+}
+
+void PricesCacheSet(const uint256 &exprhash, int32_t height, int64_t price)
+{
+    pricesCache.Set(std::make_pair(exprhash, height), price);
+}
+
+void PricesCacheEraseFrom(int32_t height)
+{
+    pricesCache.EraseFrom(height);
+}
+
+void PricesCacheClear()
+{
+    pricesCache.Clear();
+}
@@ -0,0 +1,39 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_PRICESCACHE_H
+#define CC_PRICESCACHE_H
+
+#include <stdint.h>
+#include "uint256.h"
+
+/** -maxpricescachesize default (number of cached synthetic prices, 0 = disabled) */
+static const int64_t DEFAULT_MAX_PRICES_CACHE_SIZE = 100000;
+
+/**
+ * LRU cache of evaluated prices cc synthetic expressions by expression hash
+ * and height, so the bet, cashout and rekt checks do not reevaluate the same
+ * synthetic at the same height for every bet and every call.
+ *
+ * Only successfully evaluated prices are cached. The prices of a height and
+ * above are erased when komodo_pricesupdate writes the price data of that
+ * height, as a reorg rewrites it.
+ */
+bool PricesCacheGet(const uint256 &exprhash, int32_t height, int64_t &price);
+void PricesCacheSet(const uint256 &exprhash, int32_t height, int64_t price);
+void PricesCacheEraseFrom(int32_t height);
+void PricesCacheClear();
+
+#endif // CC_PRICESCACHE_H
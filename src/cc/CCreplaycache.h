@@ -0,0 +1,81 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_REPLAYCACHE_H
+#define CC_REPLAYCACHE_H
+
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "hash.h"
+#include "uint256.h"
+
+/**
+ * Results of the game engine replays, by seed, recorded keystrokes and the
+ * starting player. The engines can only run a game from its start, so the
+ * snapshot kept is the final player state of the keystrokes replayed. A
+ * highlander or bailout tx is replayed by the finish rpc, again when it is
+ * accepted to the mempool and again when its block is connected, the same
+ * keystrokes are then only replayed once.
+ */
+class CCReplayCache
+{
+private:
+    std::mutex cs;
+    std::map<uint256, std::vector<uint8_t> > results;
+    std::list<uint256> order;   //!< oldest first, to drop the results over maxResults
+    size_t maxResults;
+
+public:
+    CCReplayCache(size_t _maxResults) : maxResults(_maxResults) {}
+
+    static uint256 Key(uint64_t seed, const void *keystrokes, size_t keystrokesSize, const void *player, size_t playerSize)
+    {
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << seed;
+        ss.write((const char *)keystrokes, keystrokesSize);
+        ss << (uint32_t)playerSize;
+        if (player != NULL)
+            ss.write((const char *)player, playerSize);
+        return ss.GetHash();
+    }
+
+    bool Get(const uint256 &key, std::vector<uint8_t> &result)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        std::map<uint256, std::vector<uint8_t> >::const_iterator it = results.find(key);
+        if (it == results.end())
+            return false;
+        result = it->second;
+        return true;
+    }
+
+    void Put(const uint256 &key, const std::vector<uint8_t> &result)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (!results.insert(std::make_pair(key, result)).second)
+            return;
+        order.push_back(key);
+        while (results.size() > maxResults)
+        {
+            results.erase(order.front());
+            order.pop_front();
+        }
+    }
+};
+
+#endif // CC_REPLAYCACHE_H
@@ -0,0 +1,252 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCrewardsbook.h"
+
+#include "CCrewards.h"
+#include "main.h"
+
+#include <map>
+#include <boost/thread.hpp>
+
+bool RewardsBookDecode(const CTransaction &tx, int32_t vout, RewardsBookUtxo &utxo)
+{
+    struct CCcontract_info *cp, C;
+    char destaddr[KOMODO_ADDRESS_BUFSIZE];
+
+    if (tx.vout.size() < 2 || vout < 0 || vout >= (int32_t)tx.vout.size() - 1 || tx.vout[vout].nValue <= 0 || !tx.vout[vout].scriptPubKey.IsPayToCryptoCondition())
+        return false;
+    utxo.txid = tx.GetHash();
+    if ((utxo.funcid = DecodeRewardsOpRet(utxo.txid, tx.vout.back().scriptPubKey, utxo.sbits, utxo.fundingtxid)) == 0)
+        return false;
+    // as IsRewardsvout, only the vouts to the rewards global address count
+    cp = CCinit(&C, EVAL_REWARDS);
+    if (!Getscriptaddress(destaddr, tx.vout[vout].scriptPubKey) || strcmp(destaddr, cp->unspendableCCaddr) != 0)
+        return false;
+    utxo.vout = vout;
+    utxo.nValue = tx.vout[vout].nValue;
+    utxo.nTime = 0;
+    utxo.unlockScript.clear();
+    if (utxo.funcid == 'L')
+        utxo.unlockScript = tx.vout[1].scriptPubKey;
+    return true;
+}
+
+namespace {
+
+class CRewardsBook
+{
+private:
+    struct Plan {
+        std::map<COutPoint, RewardsBookUtxo> funds;
+        std::map<COutPoint, RewardsBookUtxo> deposits;
+        std::multimap<uint32_t, COutPoint> depositsByTime;
+    };
+    std::map<uint256, Plan> mapPlans;         //!< by fundingtxid
+    std::map<COutPoint, uint256> mapUtxos;    //!< fundingtxid of each utxo, to erase the spent ones
+    bool fBuilt;
+    uint256 hashTip;
+
+    void Clear()
+    {
+        mapPlans.clear();
+        mapUtxos.clear();
+        fBuilt = false;
+    }
+
+    void Erase(const COutPoint &outpoint)
+    {
+        std::map<COutPoint, uint256>::iterator it = mapUtxos.find(outpoint);
+        if (it == mapUtxos.end())
+            return;
+        Plan &plan = mapPlans[it->second];
+        std::map<COutPoint, RewardsBookUtxo>::iterator itDeposit = plan.deposits.find(outpoint);
+        if (itDeposit != plan.deposits.end()) {
+            auto range = plan.depositsByTime.equal_range(itDeposit->second.nTime);
+            for (auto itTime = range.first; itTime != range.second; itTime++)
+                if (itTime->second == outpoint) {
+                    plan.depositsByTime.erase(itTime);
+                    break;
+                }
+            plan.deposits.erase(itDeposit);
+        }
+        else
+            plan.funds.erase(outpoint);
+        if (plan.funds.empty() && plan.deposits.empty())
+            mapPlans.erase(it->second);
+        mapUtxos.erase(it);
+    }
+
+    void Insert(const RewardsBookUtxo &utxo)
+    {
+        COutPoint outpoint(utxo.txid, utxo.vout);
+        if (mapUtxos.count(outpoint) != 0)
+            return;
+        mapUtxos[outpoint] = utxo.fundingtxid;
+        Plan &plan = mapPlans[utxo.fundingtxid];
+        if (utxo.funcid == 'L') {
+            plan.deposits[outpoint] = utxo;
+            plan.depositsByTime.insert(std::make_pair(utxo.nTime, outpoint));
+        }
+        else
+            plan.funds[outpoint] = utxo;
+    }
+
+    /// loads the utxos from the unspents of the global address, cs_main is held
+    void Build()
+    {
+        struct CCcontract_info *cp, C;
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspents;
+
+        Clear();
+        cp = CCinit(&C, EVAL_REWARDS);
+        SetCCunspents(unspents, cp->unspendableCCaddr, true);
+        for (const auto &unspent : unspents)
+        {
+            CTransaction tx;
+            uint256 hashBlock;
+            RewardsBookUtxo utxo;
+            if (!myGetTransaction(unspent.first.txhash, tx, hashBlock))
+                continue;
+            CBlockIndex *pindex = komodo_getblockindex(hashBlock);
+            if (pindex == NULL || !chainActive.Contains(pindex))
+                continue;
+            if (RewardsBookDecode(tx, (int32_t)unspent.first.index, utxo))
+            {
+                utxo.nTime = pindex->nTime;
+                Insert(utxo);
+            }
+        }
+        hashTip = chainActive.Tip() != NULL ? chainActive.Tip()->GetBlockHash() : uint256();
+        fBuilt = true;
+        LogPrint("rewards", "%s built with %d utxos of %d plans\n", __func__, (int)mapUtxos.size(), (int)mapPlans.size());
+    }
+
+public:
+    boost::mutex cs_book;
+
+    CRewardsBook() : fBuilt(false) {}
+
+    bool IsBuilt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        return fBuilt;
+    }
+
+    /// cs_main is held
+    void EnsureBuilt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        if (!fBuilt)
+            Build();
+    }
+
+    void GetFunds(const uint256 &fundingtxid, std::vector<RewardsBookUtxo> &utxos)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        std::map<uint256, Plan>::const_iterator it = mapPlans.find(fundingtxid);
+        if (it == mapPlans.end())
+            return;
+        for (const auto &fund : it->second.funds)
+            utxos.push_back(fund.second);
+    }
+
+    void GetDeposits(const uint256 &fundingtxid, uint32_t maxTime, std::vector<RewardsBookUtxo> &utxos)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        std::map<uint256, Plan>::const_iterator it = mapPlans.find(fundingtxid);
+        if (it == mapPlans.end())
+            return;
+        const Plan &plan = it->second;
+        for (auto itTime = plan.depositsByTime.begin(); itTime != plan.depositsByTime.end() && itTime->first <= maxTime; itTime++)
+            utxos.push_back(plan.deposits.find(itTime->second)->second);
+    }
+
+    void ConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        if (!fBuilt)
+            return;
+        if (pindex->pprev == NULL || pindex->pprev->GetBlockHash() != hashTip) {
+            Clear();
+            return;
+        }
+        for (const CTransaction &tx : block.vtx)
+        {
+            for (const CTxIn &vin : tx.vin)
+                Erase(vin.prevout);
+            for (int32_t v = 0; v < (int32_t)tx.vout.size() - 1; v++)
+            {
+                RewardsBookUtxo utxo;
+                if (RewardsBookDecode(tx, v, utxo))
+                {
+                    utxo.nTime = pindex->nTime;
+                    Insert(utxo);
+                }
+            }
+        }
+        hashTip = pindex->GetBlockHash();
+    }
+
+    void DisconnectBlock()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_book);
+        // the utxos spent by the block would have to be reloaded, the next query rebuilds instead
+        if (fBuilt)
+            Clear();
+    }
+};
+
+CRewardsBook rewardsBook;
+
+bool EnsureRewardsBook()
+{
+    if (KOMODO_NSPV_SUPERLITE)
+        return false;
+    if (!rewardsBook.IsBuilt())
+    {
+        LOCK(cs_main);
+        rewardsBook.EnsureBuilt();
+    }
+    return true;
+}
+
+}
+
+bool RewardsBookGetFunds(const uint256 &fundingtxid, std::vector<RewardsBookUtxo> &utxos)
+{
+    if (!EnsureRewardsBook())
+        return false;
+    rewardsBook.GetFunds(fundingtxid, utxos);
+    return true;
+}
+
+bool RewardsBookGetDeposits(const uint256 &fundingtxid, uint32_t maxTime, std::vector<RewardsBookUtxo> &utxos)
+{
+    if (!EnsureRewardsBook())
+        return false;
+    rewardsBook.GetDeposits(fundingtxid, maxTime, utxos);
+    return true;
+}
+
+void RewardsBookConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+    rewardsBook.ConnectBlock(block, pindex);
+}
+
+void RewardsBookDisconnectBlock()
+{
+    rewardsBook.DisconnectBlock();
+}
@@ -0,0 +1,65 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_REWARDSBOOK_H
+#define CC_REWARDSBOOK_H
+
+#include <stdint.h>
+#include <vector>
+#include "amount.h"
+#include "uint256.h"
+#include "script/script.h"
+
+class CBlock;
+class CBlockIndex;
+class CTransaction;
+
+/// unspent rewards cc vout on the rewards global address: a plan funding, an added funding, an unlock change or a locked deposit
+struct RewardsBookUtxo
+{
+    uint256 txid;
+    int32_t vout;
+    uint8_t funcid;         //!< 'F', 'A', 'U' or 'L'
+    uint64_t sbits;
+    uint256 fundingtxid;    //!< the plan, the txid itself for 'F'
+    CAmount nValue;
+    uint32_t nTime;         //!< block time, the lock time of a deposit as CCduration measures it
+    CScript unlockScript;   //!< vout1 of a lock, the only destination it unlocks to
+};
+
+/**
+ * In-memory book of the rewards cc utxos by plan, so rewardsunlock, rewardslock
+ * and rewardsinfo do not enumerate the rewards global address and reload every
+ * tx of every plan. The deposits of a plan are also ordered by lock time, an
+ * unlock only reads the ones locked long enough.
+ *
+ * The book is built from the address index on its first use and then follows
+ * the active chain on each connected tip. A disconnected tip drops the book,
+ * it is rebuilt on the next query. Only confirmed utxos are kept.
+ */
+
+/// decodes vout of tx as a rewards cc utxo, nTime is left for the caller
+bool RewardsBookDecode(const CTransaction &tx, int32_t vout, RewardsBookUtxo &utxo);
+
+/// the funding utxos ('F', 'A' and 'U') of the plan fundingtxid. Returns false if there is no book (nspv mode), the caller scans the address itself then
+bool RewardsBookGetFunds(const uint256 &fundingtxid, std::vector<RewardsBookUtxo> &utxos);
+
+/// the deposits ('L') of the plan fundingtxid locked at or before maxTime, oldest first
+bool RewardsBookGetDeposits(const uint256 &fundingtxid, uint32_t maxTime, std::vector<RewardsBookUtxo> &utxos);
+
+void RewardsBookConnectBlock(const CBlock &block, const CBlockIndex *pindex);
+void RewardsBookDisconnectBlock();
+
+#endif // CC_REWARDSBOOK_H
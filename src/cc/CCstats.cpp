@@ -0,0 +1,159 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCstats.h"
+
+#include "cc/eval.h"
+#include "primitives/transaction.h"
+#include "script/cc.h"
+#include "util.h"
+
+#include <map>
+#include <boost/thread.hpp>
+
+namespace {
+
+class CCCStats
+{
+private:
+    //! key is (evalcode, funcid)
+    std::map<std::pair<uint8_t, uint8_t>, CCStatsEntry> mapStats;
+    boost::mutex cs_stats;
+
+public:
+    void Record(uint8_t evalcode, uint8_t funcid, bool fMempool, bool fValid, int64_t nMicros, uint64_t nTxFetches, uint64_t nDBLookups)
+    {
+        int bucket = 0;
+        while (bucket < CCSTATS_LATENCY_BUCKETS - 1 && nMicros >= (1LL << bucket))
+            bucket++;
+
+        boost::unique_lock<boost::mutex> lock(cs_stats);
+        std::pair<uint8_t, uint8_t> key(evalcode, funcid);
+        std::map<std::pair<uint8_t, uint8_t>, CCStatsEntry>::iterator mi = mapStats.find(key);
+        if (mi == mapStats.end())
+            mi = mapStats.insert(std::make_pair(key, CCStatsEntry(evalcode, funcid))).first;
+        CCStatsEntry &entry = mi->second;
+        if (fMempool)
+            entry.nMempool++;
+        else
+            entry.nBlock++;
+        if (!fValid)
+            entry.nFailed++;
+        entry.nTotalMicros += nMicros;
+        entry.nMaxMicros = std::max(entry.nMaxMicros, nMicros);
+        entry.nTxFetches += nTxFetches;
+        entry.nDBLookups += nDBLookups;
+        entry.vLatency[bucket]++;
+    }
+
+    std::vector<CCStatsEntry> Get()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_stats);
+        std::vector<CCStatsEntry> entries;
+        entries.reserve(mapStats.size());
+        for (const auto &stat : mapStats)
+            entries.push_back(stat.second);
+        return entries;
+    }
+
+    void Clear()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_stats);
+        mapStats.clear();
+    }
+};
+
+CCCStats ccStats;
+bool fCCStats = DEFAULT_CCSTATS;
+thread_local uint64_t nThreadTxFetches = 0;
+thread_local uint64_t nThreadDBLookups = 0;
+
+}
+
+CCStatsEntry::CCStatsEntry(uint8_t evalcodeIn, uint8_t funcidIn) :
+    evalcode(evalcodeIn), funcid(funcidIn), nMempool(0), nBlock(0), nFailed(0), nTotalMicros(0), nMaxMicros(0), nTxFetches(0), nDBLookups(0)
+{
+    for (int i = 0; i < CCSTATS_LATENCY_BUCKETS; i++)
+        vLatency[i] = 0;
+}
+
+int64_t CCStatsEntry::Percentile(double p) const
+{
+    uint64_t nCount = Count(), nSum = 0;
+    if (nCount == 0)
+        return 0;
+    for (int i = 0; i < CCSTATS_LATENCY_BUCKETS; i++)
+    {
+        nSum += vLatency[i];
+        if (nSum >= p * nCount)
+            return i == CCSTATS_LATENCY_BUCKETS - 1 ? nMaxMicros : std::min(nMaxMicros, (int64_t)1 << i);
+    }
+    return nMaxMicros;
+}
+
+void CCStatsEnable(bool fEnable)
+{
+    fCCStats = fEnable;
+}
+
+bool CCStatsEnabled()
+{
+    return fCCStats;
+}
+
+void CCStatsCountTxFetch()
+{
+    nThreadTxFetches++;
+}
+
+void CCStatsCountDBLookup()
+{
+    nThreadDBLookups++;
+}
+
+uint64_t CCStatsThreadTxFetches()
+{
+    return nThreadTxFetches;
+}
+
+uint64_t CCStatsThreadDBLookups()
+{
+    return nThreadDBLookups;
+}
+
+uint8_t CCStatsFuncid(const CTransaction &tx, uint8_t evalcode)
+{
+    std::vector<unsigned char> vopret;
+    if (tx.vout.size() > 0 && GetOpReturnData(tx.vout.back().scriptPubKey, vopret) && vopret.size() >= 2 && vopret[0] == evalcode)
+        return vopret[1];
+    return 0;
+}
+
+void CCStatsRecord(uint8_t evalcode, uint8_t funcid, bool fMempool, bool fValid, int64_t nMicros, uint64_t nTxFetches, uint64_t nDBLookups)
+{
+    ccStats.Record(evalcode, funcid, fMempool, fValid, nMicros, nTxFetches, nDBLookups);
+    LogPrint("ccstats", "%s: evalcode %s funcid %02x %s %s %dus txfetches %u dblookups %u\n", __func__, EvalToStr(evalcode), funcid,
+        fMempool ? "mempool" : "block", fValid ? "valid" : "invalid", nMicros, nTxFetches, nDBLookups);
+}
+
+std::vector<CCStatsEntry> CCStatsGet()
+{
+    return ccStats.Get();
+}
+
+void CCStatsClear()
+{
+    ccStats.Clear();
+}
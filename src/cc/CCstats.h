@@ -0,0 +1,70 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_STATS_H
+#define CC_STATS_H
+
+#include <stdint.h>
+#include <vector>
+
+class CTransaction;
+
+/** -ccstats default (collect CC validation statistics by evalcode and funcid for getccstats) */
+static const bool DEFAULT_CCSTATS = false;
+
+/** number of latency histogram buckets, bucket i counts evals taking less than 2^i microseconds */
+static const int CCSTATS_LATENCY_BUCKETS = 24;
+
+/**
+ * CC validation statistics for one (evalcode, funcid) pair: evals done during
+ * mempool acceptance and while connecting blocks, failures, latency and the
+ * transaction fetches and index lookups the validators did.
+ * The funcid is the second byte of the tx opreturn if its first byte is the evalcode, 0 otherwise.
+ */
+struct CCStatsEntry
+{
+    uint8_t evalcode;
+    uint8_t funcid;
+    uint64_t nMempool;
+    uint64_t nBlock;
+    uint64_t nFailed;
+    int64_t nTotalMicros;
+    int64_t nMaxMicros;
+    uint64_t nTxFetches;
+    uint64_t nDBLookups;
+    uint64_t vLatency[CCSTATS_LATENCY_BUCKETS];
+
+    CCStatsEntry(uint8_t evalcodeIn = 0, uint8_t funcidIn = 0);
+    uint64_t Count() const { return nMempool + nBlock; }
+    //! upper bound of the latency below which the fraction p of the evals completed
+    int64_t Percentile(double p) const;
+};
+
+void CCStatsEnable(bool fEnable);
+bool CCStatsEnabled();
+
+//! count a transaction fetch or an index read by the current thread
+void CCStatsCountTxFetch();
+void CCStatsCountDBLookup();
+//! totals counted by the current thread so far
+uint64_t CCStatsThreadTxFetches();
+uint64_t CCStatsThreadDBLookups();
+
+uint8_t CCStatsFuncid(const CTransaction &tx, uint8_t evalcode);
+void CCStatsRecord(uint8_t evalcode, uint8_t funcid, bool fMempool, bool fValid, int64_t nMicros, uint64_t nTxFetches, uint64_t nDBLookups);
+std::vector<CCStatsEntry> CCStatsGet();
+void CCStatsClear();
+
+#endif // CC_STATS_H
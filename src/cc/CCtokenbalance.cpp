@@ -0,0 +1,216 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCtokenbalance.h"
+
+#include "CCtokens.h"
+#include "base58.h"
+#include "main.h"
+#include "txdb.h"
+#include "txmempool.h"
+
+// returns true if vout v of tx is a valid token output, as GetAllTokenBalances checks it
+static bool TokenBalanceVout(const CTransaction &tx, int32_t v, CTokenBalanceUtxo &utxo)
+{
+    const CTxOut &vout = tx.vout[v];
+    if (vout.nValue <= 0 || !vout.scriptPubKey.IsPayToCryptoCondition())
+        return false;
+
+    struct CCcontract_info *cp, C;
+    CScript opret;
+    uint256 tokenid;
+    uint8_t funcId = 0, evalcode;
+    std::string errorStr;
+    CAmount amount;
+    if (vout.scriptPubKey.SpkHasEvalcodeCCV2(TokensV2::EvalCode()))
+    {
+        evalcode = TokensV2::EvalCode();
+        cp = CCinit(&C, evalcode);
+        amount = TokensV2::CheckTokensvout(cp, NULL, tx, v, opret, tokenid, funcId, errorStr);
+    }
+    else
+    {
+        evalcode = TokensV1::EvalCode();
+        cp = CCinit(&C, evalcode);
+        amount = TokensV1::CheckTokensvout(cp, NULL, tx, v, opret, tokenid, funcId, errorStr);
+    }
+    if (amount <= 0)
+        return false;
+
+    char destaddr[KOMODO_ADDRESS_BUFSIZE];
+    uint160 hashBytes;
+    int type;
+    if (!Getscriptaddress(destaddr, vout.scriptPubKey) || !CBitcoinAddress(destaddr).GetIndexKey(hashBytes, type, true))
+        return false;
+    utxo = CTokenBalanceUtxo(CTokenBalanceKey(evalcode, hashBytes, tokenid), amount);
+    return true;
+}
+
+// adds deltas to the stored balances
+static bool TokenBalanceApply(const std::map<CTokenBalanceKey, CAmount> &deltas, std::map<CTokenBalanceKey, CAmount> &balances)
+{
+    for (const auto &delta : deltas)
+    {
+        CAmount balance;
+        if (delta.second == 0)
+            continue;
+        if (!pblocktree->ReadTokenBalance(delta.first, balance))
+            return error("%s: failed to read token balance", __func__);
+        balances[delta.first] = balance + delta.second;
+    }
+    return true;
+}
+
+bool TokenBalanceIndexConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+    std::map<COutPoint, CTokenBalanceUtxo> created;
+    std::map<CTokenBalanceKey, CAmount> deltas, balances;
+    std::vector<COutPoint> erased;
+    CTokenBalanceUndo undo;
+
+    for (const CTransaction &tx : block.vtx)
+    {
+        if (!tx.IsCoinBase())
+        {
+            for (const CTxIn &vin : tx.vin)
+            {
+                CTokenBalanceUtxo utxo;
+                std::map<COutPoint, CTokenBalanceUtxo>::iterator it = created.find(vin.prevout);
+                if (it != created.end())  // created and spent in this block
+                {
+                    deltas[it->second.key] -= it->second.amount;
+                    created.erase(it);
+                }
+                else if (pblocktree->ReadTokenBalanceUtxo(vin.prevout, utxo))
+                {
+                    deltas[utxo.key] -= utxo.amount;
+                    undo.spent.push_back(std::make_pair(vin.prevout, utxo));
+                    erased.push_back(vin.prevout);
+                }
+            }
+        }
+        for (int32_t v = 0; v < tx.vout.size(); v++)
+        {
+            CTokenBalanceUtxo utxo;
+            if (TokenBalanceVout(tx, v, utxo))
+            {
+                created[COutPoint(tx.GetHash(), v)] = utxo;
+                deltas[utxo.key] += utxo.amount;
+            }
+        }
+    }
+    if (!TokenBalanceApply(deltas, balances))
+        return false;
+
+    std::vector<std::pair<COutPoint, CTokenBalanceUtxo> > utxos(created.begin(), created.end());
+    for (const auto &utxo : utxos)
+        undo.created.push_back(utxo.first);
+    return pblocktree->WriteTokenBalanceIndex(balances, utxos, erased, pindex->GetBlockHash(), &undo);
+}
+
+bool TokenBalanceIndexDisconnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+    std::map<CTokenBalanceKey, CAmount> deltas, balances;
+    std::vector<COutPoint> erased;
+    CTokenBalanceUndo undo;
+
+    if (!pblocktree->ReadTokenBalanceUndo(pindex->GetBlockHash(), undo))
+        return true;  // the block did not change any balance
+
+    for (const COutPoint &outpoint : undo.created)
+    {
+        CTokenBalanceUtxo utxo;
+        if (pblocktree->ReadTokenBalanceUtxo(outpoint, utxo))
+        {
+            deltas[utxo.key] -= utxo.amount;
+            erased.push_back(outpoint);
+        }
+    }
+    for (const auto &spent : undo.spent)
+        deltas[spent.second.key] += spent.second.amount;
+    if (!TokenBalanceApply(deltas, balances))
+        return false;
+    return pblocktree->WriteTokenBalanceIndex(balances, undo.spent, erased, pindex->GetBlockHash(), NULL);
+}
+
+// adds the changes made by the mempool to the token balances of key.hashBytes, of tokenid only if it is not null
+static void TokenBalanceMempoolDeltas(const CTokenBalanceKey &key, bool fMempool, std::map<uint256, CAmount> &deltas)
+{
+    AssertLockHeld(mempool.cs);
+    auto matches = [&](const CTokenBalanceUtxo &utxo) {
+        return utxo.key.evalcode == key.evalcode && utxo.key.hashBytes == key.hashBytes && (key.tokenid.IsNull() || utxo.key.tokenid == key.tokenid);
+    };
+
+    for (const auto &next : mempool.mapNextTx)
+    {
+        CTokenBalanceUtxo utxo;
+        if (pblocktree->ReadTokenBalanceUtxo(next.first, utxo) && matches(utxo))
+            deltas[utxo.key.tokenid] -= utxo.amount;
+    }
+    if (!fMempool)
+        return;
+    for (CTxMemPool::indexed_transaction_set::const_iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi)
+    {
+        const CTransaction &tx = mi->GetTx();
+        for (int32_t v = 0; v < tx.vout.size(); v++)
+        {
+            CTokenBalanceUtxo utxo;
+            if (mempool.mapNextTx.count(COutPoint(tx.GetHash(), v)) == 0 && TokenBalanceVout(tx, v, utxo) && matches(utxo))
+                deltas[utxo.key.tokenid] += utxo.amount;
+        }
+    }
+}
+
+static bool TokenBalanceAddressHash(const char *tokenaddr, uint160 &hashBytes)
+{
+    int type;
+    return CBitcoinAddress(tokenaddr).GetIndexKey(hashBytes, type, true);
+}
+
+CAmount TokenBalanceIndexGet(uint8_t evalcode, const char *tokenaddr, const uint256 &tokenid, bool fMempool)
+{
+    uint160 hashBytes;
+    CAmount balance = 0;
+    std::map<uint256, CAmount> deltas;
+
+    if (!TokenBalanceAddressHash(tokenaddr, hashBytes) || tokenid.IsNull())
+        return 0;
+    CTokenBalanceKey key(evalcode, hashBytes, tokenid);
+
+    LOCK2(cs_main, mempool.cs);  // consistent with the mempool
+    if (!pblocktree->ReadTokenBalance(key, balance))
+        return 0;
+    TokenBalanceMempoolDeltas(key, fMempool, deltas);
+    return balance + deltas[tokenid];
+}
+
+void TokenBalanceIndexGetAll(uint8_t evalcode, const char *tokenaddr, bool fMempool, std::map<uint256, CAmount> &balances)
+{
+    uint160 hashBytes;
+    std::vector<std::pair<CTokenBalanceKey, CAmount> > stored;
+    std::map<uint256, CAmount> deltas;
+
+    if (!TokenBalanceAddressHash(tokenaddr, hashBytes))
+        return;
+
+    LOCK2(cs_main, mempool.cs);
+    pblocktree->ReadTokenBalances(evalcode, hashBytes, stored);
+    TokenBalanceMempoolDeltas(CTokenBalanceKey(evalcode, hashBytes, zeroid), fMempool, deltas);
+    for (const auto &balance : stored)
+        deltas[balance.first.tokenid] += balance.second;
+    for (const auto &delta : deltas)
+        if (delta.second > 0)
+            balances[delta.first] += delta.second;
+}
@@ -0,0 +1,47 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_TOKENBALANCE_H
+#define CC_TOKENBALANCE_H
+
+#include <stdint.h>
+#include <map>
+#include "amount.h"
+#include "uint256.h"
+
+class CBlock;
+class CBlockIndex;
+
+extern bool fTokenBalanceIndex;  // if -tokenbalanceindex is enabled
+
+/**
+ * Token balance index: running token balances per tokens evalcode, token cc
+ * address and tokenid, so tokenbalance and tokenallbalances do not load and
+ * check every token utxo of an address.
+ *
+ * Token outputs are checked with CheckTokensvout when their block is
+ * connected, the counted ones are kept by outpoint so spending them updates
+ * the balance. Each block stores what it changed, DisconnectBlock uses it to
+ * roll the balances back.
+ */
+bool TokenBalanceIndexConnectBlock(const CBlock &block, const CBlockIndex *pindex);
+bool TokenBalanceIndexDisconnectBlock(const CBlock &block, const CBlockIndex *pindex);
+
+/// balance of tokenid on tokenaddr: confirmed token outputs not spent in the mempool, plus unspent mempool outputs if fMempool
+CAmount TokenBalanceIndexGet(uint8_t evalcode, const char *tokenaddr, const uint256 &tokenid, bool fMempool);
+/// adds the balances of all tokens on tokenaddr, as TokenBalanceIndexGet, to balances
+void TokenBalanceIndexGetAll(uint8_t evalcode, const char *tokenaddr, bool fMempool, std::map<uint256, CAmount> &balances);
+
+#endif // CC_TOKENBALANCE_H
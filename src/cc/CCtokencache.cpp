@@ -0,0 +1,135 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCtokencache.h"
+
+#include "primitives/block.h"
+#include "util.h"
+
+#include <list>
+#include <map>
+#include <utility>
+#include <boost/thread.hpp>
+
+namespace {
+
+class CTokenCreateCache
+{
+private:
+    typedef std::pair<uint256, uint8_t> Key;  //!< tokenid, tokens evalcode
+    struct Entry {
+        TokenCreateInfo info;
+        std::list<Key>::iterator itLru;
+    };
+    //! most recently used first
+    std::list<Key> lru;
+    std::map<Key, Entry> mapTokens;
+    boost::mutex cs_tokencache;
+
+    void Erase(std::map<Key, Entry>::iterator it)
+    {
+        lru.erase(it->second.itLru);
+        mapTokens.erase(it);
+    }
+
+public:
+    bool Get(const Key &key, TokenCreateInfo &info)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_tokencache);
+
+        std::map<Key, Entry>::iterator it = mapTokens.find(key);
+        if (it == mapTokens.end())
+            return false;
+        lru.splice(lru.begin(), lru, it->second.itLru);
+        info = it->second.info;
+        return true;
+    }
+
+    void Set(const Key &key, const TokenCreateInfo &info)
+    {
+        int64_t nMaxCacheSize = GetArg("-maxtokencachesize", DEFAULT_MAX_TOKEN_CACHE_SIZE);
+        if (nMaxCacheSize <= 0) return;
+
+        boost::unique_lock<boost::mutex> lock(cs_tokencache);
+
+        std::map<Key, Entry>::iterator it = mapTokens.find(key);
+        if (it != mapTokens.end())
+            Erase(it);
+        while (static_cast<int64_t>(mapTokens.size()) >= nMaxCacheSize)
+            Erase(mapTokens.find(lru.back()));
+
+        lru.push_front(key);
+        Entry &entry = mapTokens[key];
+        entry.info = info;
+        entry.itLru = lru.begin();
+    }
+
+    void SetSupply(const Key &key, CAmount supply)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_tokencache);
+
+        std::map<Key, Entry>::iterator it = mapTokens.find(key);
+        if (it != mapTokens.end())
+            it->second.info.supply = supply;
+    }
+
+    void EraseBlock(const CBlock &block)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_tokencache);
+        for (const CTransaction &tx : block.vtx) {
+            std::map<Key, Entry>::iterator it = mapTokens.lower_bound(Key(tx.GetHash(), 0));
+            while (it != mapTokens.end() && it->first.first == tx.GetHash())
+                Erase(it++);
+        }
+    }
+
+    void Clear()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_tokencache);
+        mapTokens.clear();
+        lru.clear();
+    }
+};
+
+CTokenCreateCache tokenCreateCache;
+
+}
+
+bool TokenCreateCacheGet(uint8_t evalcode, const uint256 &tokenid, TokenCreateInfo &info)
+{
+    return tokenCreateCache.Get(std::make_pair(tokenid, evalcode), info);
+}
+
+void TokenCreateCacheSet(uint8_t evalcode, const uint256 &tokenid, const TokenCreateInfo &info)
+{
+    if (info.hashBlock.IsNull())
+        return;
+    tokenCreateCache.Set(std::make_pair(tokenid, evalcode), info);
+}
+
+void TokenCreateCacheSetSupply(uint8_t evalcode, const uint256 &tokenid, CAmount supply)
+{
+    tokenCreateCache.SetSupply(std::make_pair(tokenid, evalcode), supply);
+}
+
+void TokenCreateCacheEraseBlock(const CBlock &block)
+{
+    tokenCreateCache.EraseBlock(block);
+}
+
+void TokenCreateCacheClear()
+{
+    tokenCreateCache.Clear();
+}
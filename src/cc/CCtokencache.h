@@ -0,0 +1,62 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_TOKENCACHE_H
+#define CC_TOKENCACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "amount.h"
+#include "uint256.h"
+
+class CBlock;
+
+/** -maxtokencachesize default (number of cached token creation txns, 0 = disabled) */
+static const int64_t DEFAULT_MAX_TOKEN_CACHE_SIZE = 20000;
+
+/// decoded token creation tx, as GetTokenData, TokenInfo and CCfullsupply read it
+struct TokenCreateInfo
+{
+    uint8_t funcid;
+    uint8_t version;                        //!< token opreturn version
+    std::vector<uint8_t> origpubkey;
+    std::string name, description;
+    std::vector<std::vector<uint8_t> > oprets;  //!< token extra data
+    CAmount fullsupply;                     //!< vout1 value, as CCfullsupply returns it
+    CAmount supply;                         //!< sum of the token vouts, -1 until TokenInfo computed it
+    bool fImported;
+    bool fCCV2;                             //!< IsTxCCV2 for the tokens v2 evalcode
+    uint256 hashBlock;
+
+    TokenCreateInfo() : funcid(0), version(0), fullsupply(0), supply(-1), fImported(false), fCCV2(false) {}
+};
+
+/**
+ * LRU cache of decoded token creation txns by tokens evalcode and tokenid,
+ * so token validation and the token RPCs do not reload and decode the same
+ * tokenbase tx for every token vout.
+ *
+ * Only confirmed creations are cached, the creations of a connected tip are
+ * added and those of a disconnected block are erased.
+ */
+bool TokenCreateCacheGet(uint8_t evalcode, const uint256 &tokenid, TokenCreateInfo &info);
+void TokenCreateCacheSet(uint8_t evalcode, const uint256 &tokenid, const TokenCreateInfo &info);
+void TokenCreateCacheSetSupply(uint8_t evalcode, const uint256 &tokenid, CAmount supply);
+void TokenCreateCacheConnectBlock(const CBlock &block, const uint256 &hashBlock);  // in CCtokens.cpp
+void TokenCreateCacheEraseBlock(const CBlock &block);
+void TokenCreateCacheClear();
+
+#endif // CC_TOKENCACHE_H
@@ -49,7 +49,7 @@ static std::vector<uint8_t> GetEvalCodesCCV2(const CScript& spk)
 
     if (ccdata.empty())
         return vevalcodes;
-    CC* cond = cc_readFulfillmentBinaryMixedMode((unsigned char*)ccdata.data() + 1, ccdata.size() - 1);
+    CC* cond = CCReadFulfillmentCached((unsigned char*)ccdata.data() + 1, ccdata.size() - 1, true);
     if (cond)
     {
         VerifyEval eval = [](CC* cond, void* param) {
@@ -67,6 +67,12 @@ static std::vector<uint8_t> GetEvalCodesCCV2(const CScript& spk)
 // returns amount or -1 
 // return also tokenid
 CAmount TokensV1::CheckTokensvout(struct CCcontract_info *cp, Eval* eval, const CTransaction& tx, int32_t v, CScript &opret, uint256 &reftokenid, uint8_t &funcId, std::string &errorStr)
+{
+    TokenTxFacts facts;
+    return CheckTokensvout(cp, eval, tx, v, opret, reftokenid, funcId, errorStr, facts);
+}
+
+CAmount TokensV1::CheckTokensvout(struct CCcontract_info *cp, Eval* eval, const CTransaction& tx, int32_t v, CScript &opret, uint256 &reftokenid, uint8_t &funcId, std::string &errorStr, TokenTxFacts &facts)
 {
 	// this is just for log messages indentation fur debugging recursive calls:
 	std::string indentStr = std::string().append(tokenValIndentSize, '.');
@@ -105,8 +111,16 @@ CAmount TokensV1::CheckTokensvout(struct CCcontract_info *cp, Eval* eval, const
 		}*/
 
         // instead of recursively checking tx just check that the tx has token cc vin, that is it was validated by tokens cc module
-        bool hasMyccvin = false;
-        std::for_each (tx.vin.begin(), tx.vin.end(), [&](const CTxIn &vin){ cp->ismyvin(vin.scriptSig) ? hasMyccvin = true : hasMyccvin = hasMyccvin; });
+        if (facts.txid != tx.GetHash()) {
+            facts = TokenTxFacts();
+            facts.txid = tx.GetHash();
+        }
+        if (facts.hasMyccvin < 0) {
+            bool hasMyccvin = false;
+            std::for_each (tx.vin.begin(), tx.vin.end(), [&](const CTxIn &vin){ cp->ismyvin(vin.scriptSig) ? hasMyccvin = true : hasMyccvin = hasMyccvin; });
+            facts.hasMyccvin = hasMyccvin;
+        }
+        bool hasMyccvin = facts.hasMyccvin > 0;
 
         bool isLastVoutOpret;
         if (!(opret = GetCCDropAsOpret(tx.vout[v].scriptPubKey)).empty())
@@ -252,16 +266,20 @@ CAmount TokensV1::CheckTokensvout(struct CCcontract_info *cp, Eval* eval, const
                 vuint8_t vopretNFT;
                 GetOpReturnCCBlob(vdatas, vopretNFT);
 
-                // calc cc outputs for origPubkey 
-                CAmount ccOutputs = 0;
-                for (const auto &vout : tx.vout)
-                    if (vout.scriptPubKey.IsPayToCryptoCondition())  {
-                        CTxOut testvout = vopretNFT.size() == 0 ? MakeCC1vout(EVAL_TOKENS, vout.nValue, origPubkey) : MakeTokensCC1vout(vopretNFT[0], vout.nValue, origPubkey);
-                        if (IsEqualDestinations(vout.scriptPubKey, testvout.scriptPubKey)) 
-                            ccOutputs += vout.nValue;
-                    }
-
-                CAmount normalInputs = TotalPubkeyNormalInputs(eval, tx, origPubkey);  // calc normal inputs really signed by originator pubkey (someone not cheating with originator pubkey)
+                // calc cc outputs for origPubkey, once for all the vouts of the tx
+                if (!facts.fCreateTotals) {
+                    facts.ccOutputs = 0;
+                    for (const auto &vout : tx.vout)
+                        if (vout.scriptPubKey.IsPayToCryptoCondition())  {
+                            CTxOut testvout = vopretNFT.size() == 0 ? MakeCC1vout(EVAL_TOKENS, vout.nValue, origPubkey) : MakeTokensCC1vout(vopretNFT[0], vout.nValue, origPubkey);
+                            if (IsEqualDestinations(vout.scriptPubKey, testvout.scriptPubKey)) 
+                                facts.ccOutputs += vout.nValue;
+                        }
+                    facts.normalInputs = TotalPubkeyNormalInputs(eval, tx, origPubkey);  // calc normal inputs really signed by originator pubkey (someone not cheating with originator pubkey)
+                    facts.fCreateTotals = true;
+                }
+                const CAmount ccOutputs = facts.ccOutputs;
+                const CAmount normalInputs = facts.normalInputs;
                 if (normalInputs >= ccOutputs) {
                     LOGSTREAM(cctokens_log, CCLOG_DEBUG2, stream << indentStr << funcname << "()" << " assured normalInputs >= ccOutputs" << " for tokenbase=" << reftokenid.GetHex() << std::endl);
 
@@ -682,6 +700,37 @@ bool Tokensv2Validate(struct CCcontract_info *cp, Eval* eval, const CTransaction
 }
 
 
+int64_t CCfullsupply(uint256 tokenid)
+{
+    TokenCreateInfo info;
+    if (GetTokenCreateInfo<TokensV1>(NULL, tokenid, info))
+        return(info.fullsupply);
+    return(0);
+}
+
+int64_t CCfullsupplyV2(uint256 tokenid)
+{
+    TokenCreateInfo info;
+    if (GetTokenCreateInfo<TokensV2>(NULL, tokenid, info) && info.fCCV2)
+        return(info.fullsupply);
+    return(0);
+}
+
+// adds the token creations of a connected tip to the token cache
+void TokenCreateCacheConnectBlock(const CBlock &block, const uint256 &hashBlock)
+{
+    for (const CTransaction &tx : block.vtx)
+    {
+        TokenCreateInfo info;
+        if (tx.vout.size() < 2 || !tx.vout.back().scriptPubKey.IsOpReturn())
+            continue;
+        if (DecodeTokenCreateInfo<TokensV1>(tx, hashBlock, info))
+            TokenCreateCacheSet(TokensV1::EvalCode(), tx.GetHash(), info);
+        if (DecodeTokenCreateInfo<TokensV2>(tx, hashBlock, info))
+            TokenCreateCacheSet(TokensV2::EvalCode(), tx.GetHash(), info);
+    }
+}
+
 UniValue TokenList()
 {
 	UniValue result(UniValue::VARR);
@@ -692,24 +741,16 @@ UniValue TokenList()
 	cp = CCinit(&C, EVAL_TOKENS);
 
     auto addTokenId = [&](uint256 txid) {
-        CTransaction vintx; 
-        uint256 hashBlock;
-        std::vector<uint8_t> origpubkey;
-	    std::string name, description;
+        TokenCreateInfo info;
 
-        if (myGetTransaction(txid, vintx, hashBlock) != false) 
+        if (GetTokenCreateInfo<TokensV1>(NULL, txid, info)) 
         {
             LOCK(cs_main);
-            if (IsBlockHashInActiveChain(hashBlock))
-            {
-                std::vector<vscript_t>  oprets;
-                if (vintx.vout.size() > 0 && DecodeTokenCreateOpRetV1(vintx.vout.back().scriptPubKey, origpubkey, name, description, oprets) != 0) {
-                    result.push_back(txid.GetHex());
-                }
-                else {
-                    LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << "DecodeTokenCreateOpRetV1 failed for txid=" << txid.GetHex() <<std::endl);
-                }
-            }
+            if (IsBlockHashInActiveChain(info.hashBlock))
+                result.push_back(txid.GetHex());
+        }
+        else {
+            LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << "not a token creation txid=" << txid.GetHex() <<std::endl);
         }
     };
 
@@ -803,7 +844,7 @@ UniValue TokenV2List(const UniValue &params)
         {
             std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > unspentOutputs;
 
-            SetCCunspentsCCIndex(unspentOutputs, cp->unspendableCCaddr, zeroid);    // find by burnable validated cc addr marker
+            SetCCunspentsCCIndex(unspentOutputs, cp->unspendableCCaddr, zeroid, "c");    // find by burnable validated cc addr marker, token creations only
             LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << " cp->unspendableCCaddr=" << cp->unspendableCCaddr << " SetCCunspentsCCIndex unspentOutputs.size()=" << unspentOutputs.size() << std::endl);
             for (const auto &it : unspentOutputs) {
                 bool isTxidInActiveChain = false;
@@ -817,14 +858,11 @@ UniValue TokenV2List(const UniValue &params)
         }
         else
         {
-            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
-
-            SetCCunspents(unspentOutputs, cp->unspendableCCaddr, CC_OUTPUTS_TRUE);
-            LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << " cp->unspendableCCaddr=" << cp->unspendableCCaddr << " SetCCunspents unspentOutputs.size()=" << unspentOutputs.size() << std::endl);    
-            for (const auto &it : unspentOutputs) {
+            // the marker address holds an output of every token, so don't collect them all first
+            IterateCCunspents(cp->unspendableCCaddr, CC_OUTPUTS_TRUE, [&](const CAddressUnspentKey &key, const CAddressUnspentValue &value) {
                 CTransaction creationtx;
                 uint256 hashBlock;
-                if (myGetTransaction(it.first.txhash, creationtx, hashBlock) && creationtx.vout.size() > 0)
+                if (myGetTransaction(key.txhash, creationtx, hashBlock) && creationtx.vout.size() > 0)
                 {
                     bool isBlockHashInActiveChain = false;
                     {
@@ -832,9 +870,10 @@ UniValue TokenV2List(const UniValue &params)
                         isBlockHashInActiveChain = IsBlockHashInActiveChain(hashBlock);
                     }
                     if (isBlockHashInActiveChain)
-                        addTokenId(it.first.txhash, creationtx.vout.back().scriptPubKey);    
+                        addTokenId(key.txhash, creationtx.vout.back().scriptPubKey);    
                 }
-            }
+                return true;
+            });
         }
     }
 
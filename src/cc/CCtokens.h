@@ -296,6 +296,18 @@ bool IsEqualDestinations(const CScript &spk1, const CScript &spk2);
 
 const char cctokens_log[] = "cctokens";
 
+/// checks of a token tx that do not depend on the checked vout, so TokensExactAmounts does them once for all the vouts it checks in the tx
+struct TokenTxFacts
+{
+    uint256 txid;
+    int8_t hasMyccvin;          //!< the tx has a token cc vin, -1 if not known yet
+    bool fCreateTotals;         //!< ccOutputs and normalInputs of a tokenbase tx are set
+    CAmount ccOutputs;          //!< cc outputs to the creator pubkey
+    CAmount normalInputs;       //!< normal inputs signed by the creator pubkey
+
+    TokenTxFacts() : hasMyccvin(-1), fCreateTotals(false), ccOutputs(0), normalInputs(0) {}
+};
+
 // old tokens specific functions
 class TokensV1 {
 public:
@@ -321,6 +333,8 @@ public:
     }
 
     static CAmount CheckTokensvout(struct CCcontract_info *cp, Eval* eval, const CTransaction& tx, int32_t v, CScript &opret, uint256 &reftokenid, uint8_t &funcId, std::string &errorStr);    
+    /// same, facts of tx are reused from the previous checks of its vouts
+    static CAmount CheckTokensvout(struct CCcontract_info *cp, Eval* eval, const CTransaction& tx, int32_t v, CScript &opret, uint256 &reftokenid, uint8_t &funcId, std::string &errorStr, TokenTxFacts &facts);
 
     // conds:
     static CC *MakeTokensCCcond1(uint8_t evalcode, CPubKey pk)
@@ -422,6 +436,11 @@ public:
     }
 
     static CAmount CheckTokensvout(struct CCcontract_info *cp, Eval* eval, const CTransaction& tx, int32_t v, CScript &opret, uint256 &reftokenid, uint8_t &funcId, std::string &errorStr);    
+    /// same, there are no vout-independent checks for tokens v2
+    static CAmount CheckTokensvout(struct CCcontract_info *cp, Eval* eval, const CTransaction& tx, int32_t v, CScript &opret, uint256 &reftokenid, uint8_t &funcId, std::string &errorStr, TokenTxFacts &facts)
+    {
+        return CheckTokensvout(cp, eval, tx, v, opret, reftokenid, funcId, errorStr);
+    }
         
     // conds:
     static CC *MakeTokensCCcond1(uint8_t evalcode, CPubKey pk)
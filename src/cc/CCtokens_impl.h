@@ -23,53 +23,76 @@
 #include "CCtokens.h"
 #include "CCassets.h"
 #include "CCassetsCore_impl.h"
+#include "CCtokenbalance.h"
+#include "CCtokencache.h"
 #include "importcoin.h"
 #include "base58.h"
 
-// get non-fungible data from 'tokenbase' tx (the data might be empty)
+// decodes a token creation tx, the token supply is not computed here (it could run other cc validation code)
 template <class V>
-bool GetTokenData(Eval *eval, uint256 tokenid, TokenDataTuple &tokenData, vscript_t &vextraData)
+bool DecodeTokenCreateInfo(const CTransaction &tx, const uint256 &hashBlock, TokenCreateInfo &info)
+{
+    info = TokenCreateInfo();
+    if (tx.vout.size() == 0)
+        return false;
+    info.funcid = V::DecodeTokenCreateOpRet(tx.vout.back().scriptPubKey, info.origpubkey, info.name, info.description, info.oprets);
+    if (!IsTokenCreateFuncid(info.funcid))
+        return false;
+    info.version = DecodeTokenOpretVersion(tx.vout.back().scriptPubKey);
+    info.fullsupply = tx.vout.size() > 1 ? tx.vout[1].nValue : 0;
+    info.fImported = tx.IsCoinImport();
+    if (V::EvalCode() == TokensV2::EvalCode()) {
+        struct CCcontract_info *cp, C;
+        cp = CCinit(&C, V::EvalCode());
+        info.fCCV2 = IsTxCCV2(cp, tx);
+    }
+    info.hashBlock = hashBlock;
+    return true;
+}
+
+// loads decoded token creation tx from the token cache or from the tx (confirmed txns are cached then)
+template <class V>
+bool GetTokenCreateInfo(Eval *eval, const uint256 &tokenid, TokenCreateInfo &info)
 {
     CTransaction tokenbasetx;
     uint256 hashBlock;
 
-    tokenData = std::make_tuple(vuint8_t(), std::string(), std::string());
-
+    if (TokenCreateCacheGet(V::EvalCode(), tokenid, info))
+        return true;
     if (!GetTxUnconfirmedOpt(eval, tokenid, tokenbasetx, hashBlock)) {
         LOGSTREAMFN(cctokens_log, CCLOG_INFO, stream << "could not load token creation tx=" << tokenid.GetHex() << std::endl);
         return false;
     }
+    if (!DecodeTokenCreateInfo<V>(tokenbasetx, hashBlock, info))
+        return false;
+    TokenCreateCacheSet(V::EvalCode(), tokenid, info);
+    return true;
+}
 
-    // check if it is non-fungible tx and get its second evalcode from non-fungible payload
-    if (tokenbasetx.vout.size() > 0) {
-        std::vector<uint8_t> origpubkey;
-        std::string name, description;
-        std::vector<vscript_t>  vdatas;
-        uint8_t funcid;
+// get non-fungible data from 'tokenbase' tx (the data might be empty)
+template <class V>
+bool GetTokenData(Eval *eval, uint256 tokenid, TokenDataTuple &tokenData, vscript_t &vextraData)
+{
+    TokenCreateInfo info;
 
-        if (IsTokenCreateFuncid(V::DecodeTokenCreateOpRet(tokenbasetx.vout.back().scriptPubKey, origpubkey, name, description, vdatas))) {
-            if (vdatas.size() > 0)
-                vextraData = vdatas[0];
-            tokenData = std::make_tuple(origpubkey, name, description);
-            return true;
-        }
-    }
-    return false;
+    tokenData = std::make_tuple(vuint8_t(), std::string(), std::string());
+
+    // check if it is non-fungible tx and get its second evalcode from non-fungible payload
+    if (!GetTokenCreateInfo<V>(eval, tokenid, info))
+        return false;
+    if (info.oprets.size() > 0)
+        vextraData = info.oprets[0];
+    tokenData = std::make_tuple(info.origpubkey, info.name, info.description);
+    return true;
 }
 
 template <class V>
 uint8_t GetTokenOpReturnVersion(Eval *eval, uint256 tokenid)
 {
-    CTransaction tokencreatetx;
-    uint256 hashBlock;
-    vuint8_t vorigpk;
-    std::string name, desc;
-    std::vector<vuint8_t> oprets;
-
-    if (GetTxUnconfirmedOpt(eval, tokenid, tokencreatetx, hashBlock) && 
-        tokencreatetx.vout.size() > 0 && 
-        V::DecodeTokenCreateOpRet(tokencreatetx.vout.back().scriptPubKey, vorigpk, name, desc, oprets) != 0)
-        return DecodeTokenOpretVersion(tokencreatetx.vout.back().scriptPubKey);
+    TokenCreateInfo info;
+
+    if (GetTokenCreateInfo<V>(eval, tokenid, info))
+        return info.version;
     else
         return 0;
 }
@@ -592,6 +615,14 @@ CAmount GetTokenBalance(CPubKey pk, uint256 tokenid, bool usemempool)
         return 0;
     }
 
+    if (fTokenBalanceIndex)
+    {
+        CAmount balance = 0;
+        for (const std::string &tokenindexkey : V::GetTokenIndexKeys(pk))
+            balance += TokenBalanceIndexGet(V::EvalCode(), tokenindexkey.c_str(), tokenid, usemempool);
+        return balance;
+    }
+
 	struct CCcontract_info *cp, C;
 	cp = CCinit(&C, V::EvalCode());
 	return(AddTokenCCInputs<V>(cp, mtx, pk, tokenid, 0, 0, usemempool));
@@ -647,7 +678,11 @@ UniValue GetAllTokenBalances(CPubKey pk, bool useMempool)
 
     for (std::string &tokenindexkey : tokenindexkeys) 
     {
-        if (fUnspentCCIndex)
+        if (fTokenBalanceIndex)
+        {
+            TokenBalanceIndexGetAll(V::EvalCode(), tokenindexkey.c_str(), useMempool, mapBalances);
+        }
+        else if (fUnspentCCIndex)
         {
             std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > unspentOutputs;
 
@@ -689,50 +724,54 @@ UniValue TokenInfo(uint256 tokenid, E parseExtraData)
 	UniValue result(UniValue::VOBJ); 
     uint256 hashBlock; 
     CTransaction tokenbaseTx; 
-    std::vector<uint8_t> origpubkey; 
-    std::vector<vscript_t>  oprets;
+    TokenCreateInfo info;
     vscript_t vextraData;
-    std::string name, description; 
-    uint8_t version;
 
     struct CCcontract_info *cpTokens, CTokens;
     cpTokens = CCinit(&CTokens, V::EvalCode());
 
-	if( !myGetTransaction(tokenid, tokenbaseTx, hashBlock) )
-	{
-        LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << "cant find tokenid=" << tokenid.GetHex() << std::endl);
-		result.push_back(Pair("result", "error"));
-		result.push_back(Pair("error", "cant find tokenid"));
-		return(result);
-	}
-    if ( KOMODO_NSPV_FULLNODE && hashBlock.IsNull()) {
-        result.push_back(Pair("result", "error"));
-        result.push_back(Pair("error", "the transaction is still in mempool"));
-        return(result);
+    // imported tokens need the tx for the import proof
+    if (!TokenCreateCacheGet(V::EvalCode(), tokenid, info) || info.supply < 0 || info.fImported)
+    {
+        if( !myGetTransaction(tokenid, tokenbaseTx, hashBlock) )
+        {
+            LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << "cant find tokenid=" << tokenid.GetHex() << std::endl);
+            result.push_back(Pair("result", "error"));
+            result.push_back(Pair("error", "cant find tokenid"));
+            return(result);
+        }
+        if ( KOMODO_NSPV_FULLNODE && hashBlock.IsNull()) {
+            result.push_back(Pair("result", "error"));
+            result.push_back(Pair("error", "the transaction is still in mempool"));
+            return(result);
+        }
+
+        if (!DecodeTokenCreateInfo<V>(tokenbaseTx, hashBlock, info))
+        {
+            LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << "passed tokenid isnt token creation txid=" << tokenid.GetHex() << std::endl);
+            result.push_back(Pair("result", "error"));
+            result.push_back(Pair("error", "tokenid isnt token creation txid"));
+            return result;
+        }
+
+        CAmount output;
+        info.supply = 0;
+        for (int v = 0; v < tokenbaseTx.vout.size(); v++)
+            if ((output = IsTokensvout<V>(cpTokens, NULL, tokenbaseTx, v, tokenid)) > 0)
+                info.supply += output;
+        TokenCreateCacheSet(V::EvalCode(), tokenid, info);
     }
+    hashBlock = info.hashBlock;
 
-    uint8_t funcid = V::DecodeTokenCreateOpRet(tokenbaseTx.vout.back().scriptPubKey, origpubkey, name, description, oprets);
-	if (tokenbaseTx.vout.size() > 0 && !IsTokenCreateFuncid(funcid))
-	{
-        LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << "passed tokenid isnt token creation txid=" << tokenid.GetHex() << std::endl);
-		result.push_back(Pair("result", "error"));
-		result.push_back(Pair("error", "tokenid isnt token creation txid"));
-        return result;
-	}
 	result.push_back(Pair("result", "success"));
 	result.push_back(Pair("tokenid", tokenid.GetHex()));
-	result.push_back(Pair("owner", HexStr(origpubkey)));
-	result.push_back(Pair("name", name));
-
-    CAmount supply = 0, output;
-    for (int v = 0; v < tokenbaseTx.vout.size(); v++)
-        if ((output = IsTokensvout<V>(cpTokens, NULL, tokenbaseTx, v, tokenid)) > 0)
-            supply += output;
-	result.push_back(Pair("supply", supply));
-	result.push_back(Pair("description", description));
+	result.push_back(Pair("owner", HexStr(info.origpubkey)));
+	result.push_back(Pair("name", info.name));
+	result.push_back(Pair("supply", info.supply));
+	result.push_back(Pair("description", info.description));
 
-    if (oprets.size() > 0)
-        vextraData = oprets[0];
+    if (info.oprets.size() > 0)
+        vextraData = info.oprets[0];
     if( !vextraData.empty() )    {
         result.push_back(Pair("data", HexStr(vextraData)));
         UniValue extraDataAsJson = parseExtraData(vextraData);
@@ -741,10 +780,10 @@ UniValue TokenInfo(uint256 tokenid, E parseExtraData)
 
     }
 
-    result.push_back(Pair("version", DecodeTokenOpretVersion(tokenbaseTx.vout.back().scriptPubKey)));
+    result.push_back(Pair("version", info.version));
     result.push_back(Pair("IsMixed", V::EvalCode() == TokensV2::EvalCode() ? "yes" : "no"));
 
-    if (tokenbaseTx.IsCoinImport()) { // if imported token
+    if (info.fImported) { // if imported token
         ImportProof proof;
         CTransaction burnTx;
         std::vector<CTxOut> payouts;
@@ -1086,6 +1125,9 @@ bool TokensExactAmounts(bool goDeeper, struct CCcontract_info *cp, Eval* eval, c
     const char *funcname = __func__; 
 	
     std::map <uint256, CAmount> mapinputs, mapoutputs;
+    // vin txns and their facts, several vins often spend vouts of the same tx
+    std::map <uint256, CTransaction> mapvintxns;
+    std::map <uint256, TokenTxFacts> mapfacts;
 
 	// this is just for log messages indentation for debugging recursive calls:
 	std::string indentStr = std::string().append(tokenValIndentSize, '.');
@@ -1095,7 +1137,13 @@ bool TokensExactAmounts(bool goDeeper, struct CCcontract_info *cp, Eval* eval, c
     {
 		if ((*cp->ismyvin)(tx.vin[i].scriptSig))
 		{
-			if (!GetTxUnconfirmedOpt(eval, tx.vin[i].prevout.hash, vinTx, hashBlock))
+            std::map <uint256, CTransaction>::const_iterator itvintx = mapvintxns.find(tx.vin[i].prevout.hash);
+            bool fVinTx = true;
+            if (itvintx != mapvintxns.end())
+                vinTx = itvintx->second;
+            else if ((fVinTx = GetTxUnconfirmedOpt(eval, tx.vin[i].prevout.hash, vinTx, hashBlock)))
+                mapvintxns[tx.vin[i].prevout.hash] = vinTx;
+			if (!fVinTx)
 			{
                 LOGSTREAM(cctokens_log, CCLOG_ERROR, stream << indentStr << funcname << "()" << " cannot read vintx for vin i=" << i << std::endl);
 				return (!eval) ? false : eval->Invalid("could not load vin tx " + std::to_string(i));
@@ -1109,7 +1157,7 @@ bool TokensExactAmounts(bool goDeeper, struct CCcontract_info *cp, Eval* eval, c
                 CScript opret;
                 // validate vouts of vintx  
                 tokenValIndentSize++;
-				tokenoshis = V::CheckTokensvout(cp, eval, vinTx, tx.vin[i].prevout.n, opret, reftokenid, funcId, errorStr);
+				tokenoshis = V::CheckTokensvout(cp, eval, vinTx, tx.vin[i].prevout.n, opret, reftokenid, funcId, errorStr, mapfacts[vinTx.GetHash()]);
                 // std::cerr << __func__ << " reftokenid=" << reftokenid.GetHex() << " vin=" << i << " funcId=" << (int)funcId << " " << funcId << std::endl;
 				tokenValIndentSize--;
                 if (tokenoshis < 0) 
@@ -1147,7 +1195,7 @@ bool TokensExactAmounts(bool goDeeper, struct CCcontract_info *cp, Eval* eval, c
 
             // indeed, if we pass 'true' we'll be checking this tx vout again
             tokenValIndentSize++;
-            tokenoshis = V::CheckTokensvout(cp, eval, tx, i, opret, reftokenid, funcId, errorStr);
+            tokenoshis = V::CheckTokensvout(cp, eval, tx, i, opret, reftokenid, funcId, errorStr, mapfacts[tx.GetHash()]);
             // std::cerr << __func__ << " reftokenid=" << reftokenid.GetHex() << " vout=" << i << " funcId=" << (int)funcId << " " << funcId << std::endl;
             tokenValIndentSize--;
             if (tokenoshis < 0) 
@@ -0,0 +1,36 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_TOKENTAGSINDEX_H
+#define CC_TOKENTAGSINDEX_H
+
+class CBlock;
+class CBlockIndex;
+
+extern bool fTokenTagsIndex;  // if -tokentagsindex is enabled
+
+/**
+ * Token tags index: the create, update and escrow update txns of each token
+ * tag in chain order, with the baton each one spends, so tokentaginfo and
+ * tokentaghistory follow the update chain without loading every update tx.
+ *
+ * Txns are added when their block is connected and erased when it is
+ * disconnected. Only confirmed txns are indexed, the token tags queries
+ * continue from the last indexed update with the spent index as before.
+ */
+bool TokenTagsIndexConnectBlock(const CBlock &block, const CBlockIndex *pindex);     // in tokentags.cpp
+bool TokenTagsIndexDisconnectBlock(const CBlock &block, const CBlockIndex *pindex);
+
+#endif // CC_TOKENTAGSINDEX_H
@@ -16,17 +16,92 @@
 #include "CCinclude.h"
 #include "CCtokens.h"
 #include "key_io.h"
+#include "checkqueue.h"
 
 std::vector<CPubKey> NULL_pubkeys;
 struct NSPV_CCmtxinfo NSPV_U;
 
+/**
+ * One CC vin to sign: a private copy of its cond, the key and the sighash computed
+ * while the vins were matched. Signing the copies can run on any thread, the
+ * scriptSigs are written back into mtx in vin order afterwards.
+ */
+struct CCSignJob
+{
+    int32_t vini;
+    CCwrapper cond;
+    const uint8_t *privkey;
+    uint256 sighash;
+    bool fHashMsg;      // also try cc_signTreeSecp256k1HashMsg32 if nothing was signed (V2 conds)
+    int nSigned;
+    CScript scriptSig;
+
+    CCSignJob() : vini(0), privkey(NULL), fHashMsg(false), nSigned(0) {}
+};
+
+class CCCSignCheck
+{
+private:
+    CCSignJob *pjob;
+
+public:
+    CCCSignCheck(): pjob(NULL) {}
+    CCCSignCheck(CCSignJob &jobIn): pjob(&jobIn) {}
+
+    bool operator()() {
+        pjob->nSigned = cc_signTreeSecp256k1Msg32(pjob->cond.get(), pjob->privkey, pjob->sighash.begin());
+        if (pjob->nSigned == 0 && pjob->fHashMsg)
+            pjob->nSigned = cc_signTreeSecp256k1HashMsg32(pjob->cond.get(), pjob->privkey, pjob->sighash.begin());
+        if (pjob->nSigned != 0)
+            pjob->scriptSig = CCSig(pjob->cond.get());
+        return true;
+    }
+
+    void swap(CCCSignCheck &check) {
+        std::swap(pjob, check.pjob);
+    }
+};
+
+static CCheckQueue<CCCSignCheck> ccsignqueue(16);
+static boost::mutex cs_ccsignqueue;  // the queue serves one FinalizeCCTx at a time
+
+void ThreadCCSign() {
+    RenameThread("komodo-ccsign");
+    ccsignqueue.Thread();
+}
+
+// signs the jobs, on the cc sign threads if there are several of them
+static void CCSignJobs(std::vector<CCSignJob> &jobs)
+{
+    if (!nScriptCheckThreads || jobs.size() < 2) {
+        for (auto &job : jobs)
+            CCCSignCheck(job)();
+        return;
+    }
+    boost::unique_lock<boost::mutex> lock(cs_ccsignqueue);
+    CCheckQueueControl<CCCSignCheck> control(&ccsignqueue);
+    std::vector<CCCSignCheck> vChecks;
+    vChecks.reserve(jobs.size());
+    for (auto &job : jobs)
+        vChecks.push_back(CCCSignCheck(job));
+    control.Add(vChecks);
+    control.Wait();
+}
+
 /* see description to function definition in CCinclude.h */
 bool SignTx(CMutableTransaction &mtx,int32_t vini,int64_t utxovalue,const CScript scriptPubKey)
+{
+    CTransaction txNewConst(mtx);
+    PrecomputedTransactionData txdata(txNewConst);
+    return SignTx(mtx, vini, utxovalue, scriptPubKey, txNewConst, txdata);
+}
+
+bool SignTx(CMutableTransaction &mtx,int32_t vini,int64_t utxovalue,const CScript scriptPubKey,const CTransaction &txConst,const PrecomputedTransactionData &txdata)
 {
 #ifdef ENABLE_WALLET
-    CTransaction txNewConst(mtx); SignatureData sigdata; const CKeyStore& keystore = *pwalletMain;
+    SignatureData sigdata; const CKeyStore& keystore = *pwalletMain;
     auto consensusBranchId = CurrentEpochBranchId(chainActive.Height() + 1, Params().GetConsensus());
-    if ( ProduceSignature(TransactionSignatureCreator(&keystore,&txNewConst,vini,utxovalue,SIGHASH_ALL),scriptPubKey,sigdata,consensusBranchId) != 0 )
+    if ( ProduceSignature(TransactionSignatureCreator(&keystore,&txConst,vini,utxovalue,SIGHASH_ALL,&txdata),scriptPubKey,sigdata,consensusBranchId) != 0 )
     {
         UpdateTransaction(mtx,vini,sigdata);
         return(true);
@@ -53,7 +128,7 @@ std::string FinalizeCCTx(uint32_t changeFlag, struct CCcontract_info *cp, CMutab
 UniValue FinalizeCCTxExt(bool remote, uint32_t changeFlag, struct CCcontract_info *cp, CMutableTransaction &mtx, CPubKey mypk, CAmount txfee, CScript opret, std::vector<CPubKey> pubkeys)
 {
     auto consensusBranchId = CurrentEpochBranchId(chainActive.Height() + 1, Params().GetConsensus());
-    CTransaction vintx; std::string hex; CPubKey globalpk; uint256 hashBlock; uint64_t mask=0,nmask=0,vinimask=0;
+    CTransactionRef pvintx; std::string hex; CPubKey globalpk; uint256 hashBlock; uint64_t mask=0,nmask=0,vinimask=0;
     int64_t utxovalues[CC_MAXVINS],change,normalinputs=0,totaloutputs=0,normaloutputs=0,totalinputs=0,normalvins=0,ccvins=0; 
     int32_t i,flag,mgret,utxovout,n,err = 0;
 	char myaddr[64], destaddr[64], unspendable[64], mytokensaddr[64], mysingletokensaddr[64], unspendabletokensaddr[64],CC1of2CCaddr[64];
@@ -121,15 +196,15 @@ UniValue FinalizeCCTxExt(bool remote, uint32_t changeFlag, struct CCcontract_inf
     {
         if (i==0 && mtx.vin[i].prevout.n==10e8)
             continue;
-        if ( myGetTransaction(mtx.vin[i].prevout.hash,vintx,hashBlock) != 0 && mtx.vin[i].prevout.n < vintx.vout.size() )
+        if ( myGetTransaction(mtx.vin[i].prevout.hash,pvintx,hashBlock) != 0 && mtx.vin[i].prevout.n < pvintx->vout.size() )
         {
-            if ( vintx.vout[mtx.vin[i].prevout.n].scriptPubKey.IsPayToCryptoCondition() == 0 && ccvins==0)
+            if ( pvintx->vout[mtx.vin[i].prevout.n].scriptPubKey.IsPayToCryptoCondition() == 0 && ccvins==0)
                 normalvins++;            
             else ccvins++;
         }
         else
         {
-            fprintf(stderr,"vin.%d vout.%d is bigger than vintx.%d\n",i,mtx.vin[i].prevout.n,(int32_t)vintx.vout.size());
+            fprintf(stderr,"vin.%d vout.%d is bigger than vintx.%d\n",i,mtx.vin[i].prevout.n,pvintx ? (int32_t)pvintx->vout.size() : 0);
             memset(myprivkey,0,32);
             return UniValue(UniValue::VOBJ);
         }
@@ -146,12 +221,12 @@ UniValue FinalizeCCTxExt(bool remote, uint32_t changeFlag, struct CCcontract_inf
     for (i=0; i<n; i++)
     {
         if (i==0 && mtx.vin[i].prevout.n==10e8) continue;
-        if ( (mgret= myGetTransaction(mtx.vin[i].prevout.hash,vintx,hashBlock)) != 0 )
+        if ( (mgret= myGetTransaction(mtx.vin[i].prevout.hash,pvintx,hashBlock)) != 0 )
         {
             utxovout = mtx.vin[i].prevout.n;
-            utxovalues[i] = vintx.vout[utxovout].nValue;
+            utxovalues[i] = pvintx->vout[utxovout].nValue;
             totalinputs += utxovalues[i];
-            if ( vintx.vout[utxovout].scriptPubKey.IsPayToCryptoCondition() == 0 )
+            if ( pvintx->vout[utxovout].scriptPubKey.IsPayToCryptoCondition() == 0 )
             {
                 //fprintf(stderr,"vin.%d is normal %.8f\n",i,(double)utxovalues[i]/COIN);               
                 normalinputs += utxovalues[i];
@@ -182,22 +257,26 @@ UniValue FinalizeCCTxExt(bool remote, uint32_t changeFlag, struct CCcontract_inf
     }
     if ( opret.size() > 0 )
         mtx.vout.push_back(CTxOut(0,opret));
-    PrecomputedTransactionData txdata(mtx);
+    // the vouts are final, only the scriptSigs change and they are not hashed: all vins are signed from one copy and its sighash midstates
+    const CTransaction txConst(mtx);
+    PrecomputedTransactionData txdata(txConst);
     n = mtx.vin.size(); 
+    std::vector<CCSignJob> signJobs;
+    signJobs.reserve(n);
     for (i=0; i<n; i++)
     {
         if (i==0 && mtx.vin[i].prevout.n==10e8)
             continue;
-        if ( (mgret= myGetTransaction(mtx.vin[i].prevout.hash,vintx,hashBlock)) != 0 )
+        if ( (mgret= myGetTransaction(mtx.vin[i].prevout.hash,pvintx,hashBlock)) != 0 )
         {
             utxovout = mtx.vin[i].prevout.n;
-            if ( vintx.vout[utxovout].scriptPubKey.IsPayToCryptoCondition() == 0 )
+            if ( pvintx->vout[utxovout].scriptPubKey.IsPayToCryptoCondition() == 0 )
             {
                 if ( KOMODO_NSPV_FULLNODE )
                 {
                     if (!remote)
                     {
-                        if (SignTx(mtx, i, vintx.vout[utxovout].nValue, vintx.vout[utxovout].scriptPubKey) == 0)
+                        if (SignTx(mtx, i, pvintx->vout[utxovout].nValue, pvintx->vout[utxovout].scriptPubKey, txConst, txdata) == 0)
                             fprintf(stderr, "signing error for vini.%d of %llx\n", i, (long long)vinimask);
                     }
                     else
@@ -205,23 +284,23 @@ UniValue FinalizeCCTxExt(bool remote, uint32_t changeFlag, struct CCcontract_inf
                         // if no myprivkey for mypk it means remote call from nspv superlite client
                         // add sigData for superlite client
                         UniValue cc(UniValue::VNULL);
-                        AddSigData2UniValue(sigData, i, cc, HexStr(vintx.vout[utxovout].scriptPubKey), vintx.vout[utxovout].nValue );  // store vin i with scriptPubKey
+                        AddSigData2UniValue(sigData, i, cc, HexStr(pvintx->vout[utxovout].scriptPubKey), pvintx->vout[utxovout].nValue );  // store vin i with scriptPubKey
                     }
                 }
                 else
                 {
                     {
                         char addr[64];
-                        Getscriptaddress(addr,vintx.vout[utxovout].scriptPubKey);
-                        fprintf(stderr,"vout[%d] %.8f -> %s\n",utxovout,dstr(vintx.vout[utxovout].nValue),addr);
+                        Getscriptaddress(addr,pvintx->vout[utxovout].scriptPubKey);
+                        fprintf(stderr,"vout[%d] %.8f -> %s\n",utxovout,dstr(pvintx->vout[utxovout].nValue),addr);
                     }
-                    if ( NSPV_SignTx(mtx,i,vintx.vout[utxovout].nValue,vintx.vout[utxovout].scriptPubKey,0) == 0 )
+                    if ( NSPV_SignTx(mtx,i,pvintx->vout[utxovout].nValue,pvintx->vout[utxovout].scriptPubKey,0) == 0 )
                         fprintf(stderr,"NSPV signing error for vini.%d of %llx\n",i,(long long)vinimask);
                 }
             }
             else
             {
-                Getscriptaddress(destaddr,vintx.vout[utxovout].scriptPubKey);
+                Getscriptaddress(destaddr,pvintx->vout[utxovout].scriptPubKey);
                 //fprintf(stderr,"FinalizeCCTx() vin.%d is CC %.8f -> (%s) vs %s\n",i,(double)utxovalues[i]/COIN,destaddr,mysingletokensaddr);
 				//std::cerr << "FinalizeCCtx() searching destaddr=" << destaddr << " for vin[" << i << "] satoshis=" << utxovalues[i] << std::endl;
                 if( strcmp(destaddr, myaddr) == 0 )
@@ -349,7 +428,7 @@ UniValue FinalizeCCTxExt(bool remote, uint32_t changeFlag, struct CCcontract_inf
                         return sigDataNull;
                     }
                 }
-                uint256 sighash = SignatureHash(CCPubKey(cond), mtx, i, SIGHASH_ALL,utxovalues[i],consensusBranchId, &txdata);
+                uint256 sighash = SignatureHash(CCPubKey(cond), txConst, i, SIGHASH_ALL,utxovalues[i],consensusBranchId, &txdata);
                 if ( false )
                 {
                     int32_t z;
@@ -363,16 +442,13 @@ UniValue FinalizeCCTxExt(bool remote, uint32_t changeFlag, struct CCcontract_inf
 
                 if (!remote)  // we have privkey in the wallet
                 {
-                    if (cc_signTreeSecp256k1Msg32(cond, privkey, sighash.begin()) != 0)
-                    {
-                        mtx.vin[i].scriptSig = CCSig(cond);
-                    }
-                    else
-                    {
-                        fprintf(stderr, "vini.%d has CC signing error: cc_signTreeSecp256k1Msg32 returned error, address.(%s) %s\n", i, destaddr, EncodeHexTx(mtx).c_str());
-                        memset(myprivkey, 0, sizeof(myprivkey));
-                        return sigDataNull;
-                    }
+                    // signed after all vins are matched, cond is copied as it is shared between vins
+                    signJobs.push_back(CCSignJob());
+                    signJobs.back().vini = i;
+                    signJobs.back().cond.reset(cc_copy(cond));
+                    signJobs.back().privkey = privkey;
+                    signJobs.back().sighash = sighash;
+                    signJobs.back().fHashMsg = false;
                 }
                 else   // no privkey locally - remote call
                 {
@@ -386,11 +462,22 @@ UniValue FinalizeCCTxExt(bool remote, uint32_t changeFlag, struct CCcontract_inf
                         return sigDataNull;
                     }
 
-                    AddSigData2UniValue(sigData, i, ccjson, std::string(), vintx.vout[utxovout].nValue);  // store vin i with scriptPubKey
+                    AddSigData2UniValue(sigData, i, ccjson, std::string(), pvintx->vout[utxovout].nValue);  // store vin i with scriptPubKey
                 }
             }
         } else fprintf(stderr,"FinalizeCCTx2 couldnt find %s mgret.%d\n",mtx.vin[i].prevout.hash.ToString().c_str(),mgret);
     }
+    CCSignJobs(signJobs);
+    for (const auto &job : signJobs)
+    {
+        if (job.nSigned == 0)
+        {
+            fprintf(stderr, "vini.%d has CC signing error: cc_signTreeSecp256k1Msg32 returned error %s\n", job.vini, EncodeHexTx(mtx).c_str());
+            err = 1;
+            break;
+        }
+        mtx.vin[job.vini].scriptSig = job.scriptSig;
+    }
     if ( mycond != 0 )
         cc_free(mycond);
     if ( condCC2 != 0 )
@@ -414,6 +501,8 @@ UniValue FinalizeCCTxExt(bool remote, uint32_t changeFlag, struct CCcontract_inf
     if ( othertokenscond != 0 )
         cc_free(othertokenscond);   
     memset(myprivkey,0,sizeof(myprivkey));
+    if (err)
+        return sigDataNull;
 
     std::string strHex = EncodeHexTx(mtx);
     if ( strHex.size() > 0 )
@@ -429,7 +518,7 @@ UniValue FinalizeCCTxExt(bool remote, uint32_t changeFlag, struct CCcontract_inf
 UniValue FinalizeCCV2Tx(bool remote, uint32_t changeFlag, struct CCcontract_info* cp, CMutableTransaction& mtx, CPubKey mypk, CAmount txfee, CScript opret)
 {
     auto consensusBranchId = CurrentEpochBranchId(chainActive.Height() + 1, Params().GetConsensus());
-    CTransaction vintx;
+    CTransactionRef pvintx;
     std::string hex;
     CPubKey globalpk;
     uint256 hashBlock;
@@ -473,9 +562,9 @@ UniValue FinalizeCCV2Tx(bool remote, uint32_t changeFlag, struct CCcontract_info
     for (int i = 0; i < n; i++) {
         if (i == 0 && mtx.vin[i].prevout.n == 10e8)
             continue; // skip pegs vin
-        if ((mgret = myGetTransaction(mtx.vin[i].prevout.hash, vintx, hashBlock)) != 0) {
+        if ((mgret = myGetTransaction(mtx.vin[i].prevout.hash, pvintx, hashBlock)) != 0) {
             utxovout = mtx.vin[i].prevout.n;
-            utxovalues[i] = vintx.vout[utxovout].nValue;
+            utxovalues[i] = pvintx->vout[utxovout].nValue;
             totalinputs += utxovalues[i];
         } else
             fprintf(stderr, "%s couldnt find %s mgret.%d\n", __func__, mtx.vin[i].prevout.hash.ToString().c_str(), mgret);
@@ -494,19 +583,24 @@ UniValue FinalizeCCV2Tx(bool remote, uint32_t changeFlag, struct CCcontract_info
     }
     if (opret.size() > 0)
         mtx.vout.push_back(CTxOut(0, opret));
-    PrecomputedTransactionData txdata(mtx);
+    // the vouts are final, only the scriptSigs change and they are not hashed: all vins are signed from one copy and its sighash midstates
+    const CTransaction txConst(mtx);
+    PrecomputedTransactionData txdata(txConst);
     n = mtx.vin.size();
+    std::vector<CCSignJob> signJobs;
+    std::vector<std::string> signAddrs;
+    signJobs.reserve(n);
     for (int i = 0; i < n; i++) {
         if (i == 0 && mtx.vin[i].prevout.n == 10e8) // skip PEGS vin
             continue;
-        if ((mgret = myGetTransaction(mtx.vin[i].prevout.hash, vintx, hashBlock)) != 0) {
+        if ((mgret = myGetTransaction(mtx.vin[i].prevout.hash, pvintx, hashBlock)) != 0) {
             CCwrapper cond;
             uint8_t *privkey = NULL;
             utxovout = mtx.vin[i].prevout.n;
-            if (vintx.vout[utxovout].scriptPubKey.IsPayToCryptoCondition() == 0) {
+            if (pvintx->vout[utxovout].scriptPubKey.IsPayToCryptoCondition() == 0) {
                 if (KOMODO_NSPV_FULLNODE) {
                     if (!remote) {
-                        if (SignTx(mtx, i, vintx.vout[utxovout].nValue, vintx.vout[utxovout].scriptPubKey) == 0)  {
+                        if (SignTx(mtx, i, pvintx->vout[utxovout].nValue, pvintx->vout[utxovout].scriptPubKey, txConst, txdata) == 0)  {
                             fprintf(stderr, "%s signing error for normal vini.%d\n", __func__, i);
                             return sigDataNull;
                         }
@@ -514,21 +608,21 @@ UniValue FinalizeCCV2Tx(bool remote, uint32_t changeFlag, struct CCcontract_info
                         // if no myprivkey for mypk it means remote call from nspv superlite client
                         // add sigData for superlite client
                         UniValue cc(UniValue::VNULL);
-                        AddSigData2UniValue(sigData, i, cc, HexStr(vintx.vout[utxovout].scriptPubKey), vintx.vout[utxovout].nValue); // store vin i with scriptPubKey
+                        AddSigData2UniValue(sigData, i, cc, HexStr(pvintx->vout[utxovout].scriptPubKey), pvintx->vout[utxovout].nValue); // store vin i with scriptPubKey
                     }
                 } else {
                     // NSPV client
                     {
                         char addr[KOMODO_ADDRESS_BUFSIZE];
-                        Getscriptaddress(addr, vintx.vout[utxovout].scriptPubKey);
-                        fprintf(stderr, "%s vout[%d] %.8f -> %s\n", __func__, utxovout, dstr(vintx.vout[utxovout].nValue), addr);
+                        Getscriptaddress(addr, pvintx->vout[utxovout].scriptPubKey);
+                        fprintf(stderr, "%s vout[%d] %.8f -> %s\n", __func__, utxovout, dstr(pvintx->vout[utxovout].nValue), addr);
                     }
-                    if (NSPV_SignTx(mtx, i, vintx.vout[utxovout].nValue, vintx.vout[utxovout].scriptPubKey, 0) == 0)
+                    if (NSPV_SignTx(mtx, i, pvintx->vout[utxovout].nValue, pvintx->vout[utxovout].scriptPubKey, 0) == 0)
                         fprintf(stderr, "%s NSPV signing error for vini.%d\n", __func__, i);
                 }
             } else {
                 bool bdontsign = false;
-                Getscriptaddress(destaddr, vintx.vout[utxovout].scriptPubKey);
+                Getscriptaddress(destaddr, pvintx->vout[utxovout].scriptPubKey);
                 if (strcmp(destaddr, globaladdr) == 0) {
                     privkey = cp->CCpriv;
                     cond.reset(MakeCCcond1(cp->evalcode, globalpk));
@@ -580,38 +674,14 @@ UniValue FinalizeCCV2Tx(bool remote, uint32_t changeFlag, struct CCcontract_info
                 }
                 else if (!remote) // we have privkey in the wallet
                 {
-                    uint256 sighash = SignatureHash(CCPubKey(cond.get()), mtx, i, SIGHASH_ALL, utxovalues[i], consensusBranchId, &txdata);
-                    if (cc_signTreeSecp256k1Msg32(cond.get(), privkey, sighash.begin()) != 0 ||
-                        cc_signTreeSecp256k1HashMsg32(cond.get(), privkey, sighash.begin()) != 0) {
-
-                        mtx.vin[i].scriptSig = CCSig(cond.get());
-                        if (!IsCCInput(mtx.vin[i].scriptSig)) {
-                            // if fulfillment could not be serialised treat as signature threshold not reached
-                            // return partially signed condition:
-                            std::string strcond;
-                            cJSON *params = cc_conditionToJSON(cond.get());
-                            if (params)  {
-                                char *out = cJSON_PrintUnformatted(params);
-                                cJSON_Delete(params);
-                                if (out)   {
-                                    strcond = out;
-                                    cJSON_free(out);
-                                }
-                            }
-
-                            UniValue unicond(UniValue::VOBJ);
-                            unicond.read(strcond);
-                            UniValue elem(UniValue::VOBJ);
-                            elem.push_back(Pair("vin", i));
-                            elem.push_back(Pair("ccaddress", destaddr));
-                            elem.push_back(Pair("condition", unicond));
-                            partialConds.push_back(elem);
-                        }
-                    } else {
-                        fprintf(stderr, "%s vini.%d has CC signing error: cc_signTreeSecp256k1Msg32 returned error, address.(%s) %s\n", __func__, i, destaddr, EncodeHexTx(mtx).c_str());
-                        memset(myprivkey, 0, sizeof(myprivkey));
-                        return sigDataNull;
-                    }
+                    // signed after all vins are matched
+                    signJobs.push_back(CCSignJob());
+                    signJobs.back().vini = i;
+                    signJobs.back().cond = cond;
+                    signJobs.back().privkey = privkey;
+                    signJobs.back().sighash = SignatureHash(CCPubKey(cond.get()), txConst, i, SIGHASH_ALL, utxovalues[i], consensusBranchId, &txdata);
+                    signJobs.back().fHashMsg = true;
+                    signAddrs.push_back(destaddr);
                 } else {   // no privkey locally - remote call
                     // serialize cc:
                     UniValue ccjson;
@@ -621,13 +691,44 @@ UniValue FinalizeCCV2Tx(bool remote, uint32_t changeFlag, struct CCcontract_info
                         memset(myprivkey, 0, sizeof(myprivkey));
                         return sigDataNull;
                     }
-                    AddSigData2UniValue(sigData, i, ccjson, std::string(), vintx.vout[utxovout].nValue); // store vin i with scriptPubKey
+                    AddSigData2UniValue(sigData, i, ccjson, std::string(), pvintx->vout[utxovout].nValue); // store vin i with scriptPubKey
                 }
             }
         } else
             fprintf(stderr, "%s could not find tx %s myGetTransaction returned %d\n", __func__, mtx.vin[i].prevout.hash.ToString().c_str(), mgret);
     }
+    CCSignJobs(signJobs);
     memset(myprivkey, 0, sizeof(myprivkey));
+    for (size_t j = 0; j < signJobs.size(); j++) {
+        const CCSignJob &job = signJobs[j];
+        if (job.nSigned == 0) {
+            fprintf(stderr, "%s vini.%d has CC signing error: cc_signTreeSecp256k1Msg32 returned error, address.(%s) %s\n", __func__, job.vini, signAddrs[j].c_str(), EncodeHexTx(mtx).c_str());
+            return sigDataNull;
+        }
+        mtx.vin[job.vini].scriptSig = job.scriptSig;
+        if (!IsCCInput(mtx.vin[job.vini].scriptSig)) {
+            // if fulfillment could not be serialised treat as signature threshold not reached
+            // return partially signed condition:
+            std::string strcond;
+            cJSON *params = cc_conditionToJSON(job.cond.get());
+            if (params)  {
+                char *out = cJSON_PrintUnformatted(params);
+                cJSON_Delete(params);
+                if (out)   {
+                    strcond = out;
+                    cJSON_free(out);
+                }
+            }
+
+            UniValue unicond(UniValue::VOBJ);
+            unicond.read(strcond);
+            UniValue elem(UniValue::VOBJ);
+            elem.push_back(Pair("vin", job.vini));
+            elem.push_back(Pair("ccaddress", signAddrs[j]));
+            elem.push_back(Pair("condition", unicond));
+            partialConds.push_back(elem);
+        }
+    }
 
     //cp->CCvintxprobes.clear();
     std::string strHex = EncodeHexTx(mtx);
@@ -652,7 +753,8 @@ UniValue AddSignatureCCTxV2(vuint8_t & vtx, const UniValue &jsonParams)
 
     if (!E_UNMARSHAL(vtx, ss >> mtx) || mtx.vin.size() == 0)
         return MakeResultError("could not decode or no vins in tx");
-    PrecomputedTransactionData txdata(mtx);
+    const CTransaction txConst(mtx);
+    PrecomputedTransactionData txdata(txConst);
 
 #ifdef ENABLE_WALLET
     // get privkey for mypk
@@ -684,7 +786,7 @@ UniValue AddSignatureCCTxV2(vuint8_t & vtx, const UniValue &jsonParams)
 
                     CCwrapper cond( cc_conditionFromJSONString(jcond.c_str(), ccerr) );
                     if (cond.get())  {
-                        uint256 sighash = SignatureHash(CCPubKey(cond.get()), mtx, i, SIGHASH_ALL, vintx.vout[mtx.vin[i].prevout.n].nValue, consensusBranchId, &txdata);
+                        uint256 sighash = SignatureHash(CCPubKey(cond.get()), txConst, i, SIGHASH_ALL, vintx.vout[mtx.vin[i].prevout.n].nValue, consensusBranchId, &txdata);
                         if (cc_signTreeSecp256k1Msg32(cond.get(), myprivkey, sighash.begin()) != 0) {
                             std::string strcond;
                             cJSON *params = cc_conditionToJSON(cond.get());
@@ -741,41 +843,28 @@ static void AddCCunspentsInMempool(std::vector<std::pair<CAddressUnspentKey, CAd
     if (address.GetIndexKey(hashBytes, type, isCC) == false)
         return;
 
-    // lock mempool
-    ENTER_CRITICAL_SECTION(mempool.cs);
-
     std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > memOutputs;
     std::vector< std::pair<uint160, int> > addresses;
     addresses.push_back(std::make_pair(hashBytes, type));
-    mempool.getAddressIndex(addresses, memOutputs);
+    mempool.getAddressUnspent(addresses, memOutputs);  // mempool outputs not spent in mempool
     
-    // impl using mempool address and spent indexes
     for (std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >::iterator mo = memOutputs.begin(); mo != memOutputs.end(); mo ++)
     {
-        uint256 dummytxid;
-        int32_t dummyvout;
-        
-        if (mo->first.spending == 0 // the entry is an output
-            && !myIsutxo_spentinmempool(dummytxid, dummyvout, mo->first.txhash, mo->first.index) && mo->first.type == type)
-        {
-            // create unspent output key value pair
-            CAddressUnspentKey key;
-            CAddressUnspentValue value;
+        // create unspent output key value pair
+        CAddressUnspentKey key;
+        CAddressUnspentValue value;
 
-            key.type = type;
-            key.hashBytes = hashBytes;
-            key.txhash = mo->first.txhash; 
-            key.index = mo->first.index; 
+        key.type = type;
+        key.hashBytes = hashBytes;
+        key.txhash = mo->first.txhash; 
+        key.index = mo->first.index; 
 
-            value.satoshis = mo->second.amount;  
-            value.blockHeight = 0;
-            // note: value.script is not set
+        value.satoshis = mo->second.amount;  
+        value.blockHeight = 0;
+        // note: value.script is not set
 
-            //std::cerr << __func__ << " adding txhash=" << mo->first.txhash.GetHex() << " index=" << mo->first.index << " amount=" << mo->second.amount << " spending=" << mo->first.spending << " mo->second.prevhash=" << mo->second.prevhash.GetHex() << " mo->second.prevout=" << mo->second.prevout << std::endl;
-            unspentOutputs.push_back(std::make_pair(key, value));
-        }
+        unspentOutputs.push_back(std::make_pair(key, value));
     }
-    LEAVE_CRITICAL_SECTION(mempool.cs);
 }
 
 
@@ -800,6 +889,45 @@ void SetCCunspents(std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValu
     }
 }
 
+bool IterateCCunspents(char *coinaddr, bool ccflag, const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> &func, CAddressUnspentKey *cursor)
+{
+    int32_t type = 0; uint160 hashBytes; bool fCompleted = true;
+    auto visit = [&](const CAddressUnspentKey &key, const CAddressUnspentValue &value) {
+        if (cursor != NULL)
+            *cursor = key;
+        if (!func(key, value)) {
+            fCompleted = false;
+            return false;
+        }
+        return true;
+    };
+
+    if ( KOMODO_NSPV_SUPERLITE )
+    {
+        // nspv returns all the utxos at once anyway
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+        NSPV_CCunspents(unspentOutputs, coinaddr, ccflag);
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it = unspentOutputs.begin();
+        if (cursor != NULL && !cursor->hashBytes.IsNull()) {
+            while (it != unspentOutputs.end() && !(it->first.txhash == cursor->txhash && it->first.index == cursor->index))
+                it++;
+            if (it != unspentOutputs.end())
+                it++;
+        }
+        for (; it != unspentOutputs.end(); it++)
+            if (!visit(it->first, it->second))
+                break;
+        return fCompleted;
+    }
+    if (!coinaddr) return true;
+
+    CBitcoinAddress address(coinaddr);
+    if (address.GetIndexKey(hashBytes, type, ccflag) == 0)
+        return true;
+    ForEachAddressUnspent(hashBytes, type, (cursor != NULL && !cursor->hashBytes.IsNull()) ? cursor : NULL, visit);
+    return fCompleted;
+}
+
 // SetCCunspents with support of looking utxos in mempool and checking that utxos are not spent in mempool too
 void SetCCunspentsWithMempool(std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs, char *coinaddr, bool ccflag)
 {
@@ -811,7 +939,7 @@ void SetCCunspentsWithMempool(std::vector<std::pair<CAddressUnspentKey, CAddress
 
 
 // find cc unspent outputs with use unspents cc index
-void SetCCunspentsCCIndex(std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, const char *coinaddr, uint256 creationId)
+void SetCCunspentsCCIndex(std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, const char *coinaddr, uint256 creationId, const std::string &funcids)
 {
     int32_t type=0;
     uint160 hashBytes; 
@@ -826,12 +954,12 @@ void SetCCunspentsCCIndex(std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIn
     searchKeys.push_back(std::make_pair(hashBytes, creationId));
     for (std::vector<std::pair<uint160, uint256> >::iterator it = searchKeys.begin(); it != searchKeys.end(); it++)
     {
-        if (GetUnspentCCIndex((*it).first, (*it).second, unspentOutputs, -1, -1, 0) == 0)
+        if (GetUnspentCCIndex((*it).first, (*it).second, unspentOutputs, -1, -1, 0, funcids) == 0)
             return;
     }
 }
 
-void AddCCunspentsCCIndexMempool(std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, const char *coinaddr, uint256 creationId)
+void AddCCunspentsCCIndexMempool(std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, const char *coinaddr, uint256 creationId, const std::string &funcids)
 {
     if (!coinaddr)
         return;
@@ -839,7 +967,12 @@ void AddCCunspentsCCIndexMempool(std::vector<std::pair<CUnspentCCIndexKey, CUnsp
     uint160 hashBytes;
     int type;
     if (address.GetIndexKey(hashBytes, type, true)) {
+        size_t nOld = unspentOutputs.size();
         mempool.getUnspentCCIndex({ std::make_pair(hashBytes, creationId) }, unspentOutputs);
+        if (!funcids.empty())
+            unspentOutputs.erase(std::remove_if(unspentOutputs.begin() + nOld, unspentOutputs.end(),
+                [&](const std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> &o) { return funcids.find((char)o.second.funcid) == std::string::npos; }),
+                unspentOutputs.end());
     }
 }
 
@@ -868,8 +1001,6 @@ void SetCCtxids(std::vector<uint256>& txids, char* coinaddr, bool ccflag, uint8_
 {
     int32_t type = 0;
     uint160 hashBytes;
-    std::vector<std::pair<uint160, int>> addresses;
-    std::vector<std::pair<CAddressIndexKey, CAmount>> addressIndex;
     if (KOMODO_NSPV_SUPERLITE) {
         NSPV_CCtxids(txids, coinaddr, ccflag, evalcode, filtertxid, func);
         return;
@@ -880,28 +1011,48 @@ void SetCCtxids(std::vector<uint256>& txids, char* coinaddr, bool ccflag, uint8_
     CBitcoinAddress address(coinaddr);
     if (address.GetIndexKey(hashBytes, type, ccflag) == 0)
         return;
-    addresses.push_back(std::make_pair(hashBytes, type));
-    for (std::vector<std::pair<uint160, int>>::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (GetAddressIndex((*it).first, (*it).second, addressIndex) == 0)
-            return;
-        for (std::vector<std::pair<CAddressIndexKey, CAmount>>::const_iterator it1 = addressIndex.begin(); it1 != addressIndex.end(); it1++) {
-            if ((amount == 0 && it1->second >= 0) || (amount > 0 && it1->second == amount))
-                txids.push_back(it1->first.txhash);
+    // filter while reading the index, without a copy of all entries of the address
+    ForEachAddressIndex(hashBytes, type, 0, 0, NULL, [&](const CAddressIndexKey &key, CAmount nValue) {
+        if ((amount == 0 && nValue >= 0) || (amount > 0 && nValue == amount))
+            txids.push_back(key.txhash);
+        return true;
+    });
+}
+
+bool IterateCCtxids(char *coinaddr, bool ccflag, const std::function<bool(const CAddressIndexKey&, CAmount)> &func, CAddressIndexKey *cursor)
+{
+    int32_t type = 0; uint160 hashBytes; bool fCompleted = true;
+
+    if (!coinaddr)
+        return true;
+    CBitcoinAddress address(coinaddr);
+    if (address.GetIndexKey(hashBytes, type, ccflag) == 0)
+        return true;
+    ForEachAddressIndex(hashBytes, type, 0, 0, (cursor != NULL && !cursor->hashBytes.IsNull()) ? cursor : NULL, [&](const CAddressIndexKey &key, CAmount nValue) {
+        if (cursor != NULL)
+            *cursor = key;
+        if (!func(key, nValue)) {
+            fCompleted = false;
+            return false;
         }
-    }
+        return true;
+    });
+    return fCompleted;
 }
 
 int64_t CCutxovalue(char *coinaddr,uint256 utxotxid,int32_t utxovout,int32_t CCflag)
 {
-    uint256 txid; std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
-    SetCCunspents(unspentOutputs,coinaddr,CCflag!=0?true:false);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    int64_t satoshis = 0;
+    IterateCCunspents(coinaddr,CCflag!=0?true:false,[&](const CAddressUnspentKey &key,const CAddressUnspentValue &value)
     {
-        txid = it->first.txhash;
-        if ( txid == utxotxid && utxovout == it->first.index )
-            return(it->second.satoshis);
-    }
-    return(0);
+        if ( key.txhash == utxotxid && utxovout == key.index )
+        {
+            satoshis = value.satoshis;
+            return(false);
+        }
+        return(true);
+    });
+    return(satoshis);
 }
 
 int64_t CCgettxout(uint256 txid,int32_t vout,int32_t mempoolflag,int32_t lockflag)
@@ -961,37 +1112,6 @@ int64_t CCaddress_balance(char *coinaddr,int32_t CCflag)
     return(sum);
 }
 
-int64_t CCfullsupply(uint256 tokenid)
-{
-    uint256 hashBlock; int32_t numvouts; CTransaction tx; std::vector<uint8_t> origpubkey; std::string name,description;
-    if ( myGetTransaction(tokenid,tx,hashBlock) != 0 && (numvouts= tx.vout.size()) > 0 )
-    {
-        std::vector<vscript_t> oprets;
-        if (DecodeTokenCreateOpRetV1(tx.vout[numvouts-1].scriptPubKey,origpubkey,name,description,oprets))
-        {
-            return(tx.vout[1].nValue);
-        }
-    }
-    return(0);
-}
-
-int64_t CCfullsupplyV2(uint256 tokenid)
-{
-    uint256 hashBlock; int32_t numvouts; CTransaction tx; std::vector<uint8_t> origpubkey; std::string name,description;
-    struct CCcontract_info *cp,C;
-
-    cp = CCinit(&C,EVAL_TOKENSV2);
-    if ( myGetTransactionCCV2(cp,tokenid,tx,hashBlock) != 0 )
-    {
-        std::vector<vscript_t> oprets;
-        if (TokensV2::DecodeTokenCreateOpRet(tx.vout[tx.vout.size()-1].scriptPubKey,origpubkey,name,description,oprets))
-        {
-            return(tx.vout[1].nValue);
-        }
-    }
-    return(0);
-}
-
 // TODO: remove this func or add IsTokenVout check (in other places just AddTokenCCInputs is used instead, maybe make it to do the job here)
 int64_t CCtoken_balance(char *coinaddr,uint256 reftokenid)
 {
@@ -1099,6 +1219,57 @@ int32_t CC_vinselect(int32_t *aboveip, CAmount *abovep, int32_t *belowip, CAmoun
     else return(belowi);
 }
 
+std::vector<int32_t> CC_selectinputs(const std::vector<CAmount> &values, CAmount total, int32_t maxinputs, CAmount &totalinputs)
+{
+    std::multimap<CAmount, int32_t> sorted;
+    std::vector<int32_t> picked;
+    CAmount remains = total;
+
+    for (int32_t i = 0; i < (int32_t)values.size(); i++)
+        if (values[i] > 0)
+            sorted.insert(std::make_pair(values[i], i));
+    totalinputs = 0;
+    while (!sorted.empty() && (int32_t)picked.size() < maxinputs && (picked.empty() || totalinputs < total))
+    {
+        // the smallest utxo covering the remains, or the largest one if none covers it
+        std::multimap<CAmount, int32_t>::iterator it = sorted.lower_bound(remains);
+        if (it == sorted.end())
+            --it;
+        picked.push_back(it->second);
+        totalinputs += it->first;
+        remains -= it->first;
+        sorted.erase(it);
+    }
+    return picked;
+}
+
+// outpoints already spent by the tx vins
+static std::set<COutPoint> CC_vinoutpoints(const CMutableTransaction &mtx)
+{
+    std::set<COutPoint> outpoints;
+    for (const auto &vin : mtx.vin)
+        outpoints.insert(vin.prevout);
+    return outpoints;
+}
+
+// adds vins for the utxos picked by CC_selectinputs, returns their total or 0 if it is less than total
+static CAmount CC_addselectedinputs(CMutableTransaction &mtx, const std::vector<struct CC_utxo> &utxos, CAmount total, int32_t maxinputs)
+{
+    std::vector<CAmount> values;
+    CAmount totalinputs;
+
+    values.reserve(utxos.size());
+    for (const auto &utxo : utxos)
+        values.push_back(utxo.nValue);
+    for (int32_t ind : CC_selectinputs(values, total, maxinputs, totalinputs))
+        mtx.vin.push_back(CTxIn(utxos[ind].txid, utxos[ind].vout, CScript(), (4294967295U-1)));  // for TOKEL sequence non-final to allow CLTV spending
+    if (totalinputs >= total) {
+        //fprintf(stderr,"return totalinputs %.8f\n",(double)totalinputs/COIN);
+        return (totalinputs);
+    }
+    return (0);
+}
+
 static int MyGetDepthInMainChain(const CTransaction &tx, uint256 hashBlock)
 {
     if (hashBlock.IsNull())
@@ -1129,14 +1300,12 @@ static int CoinbaseGetBlocksToMaturity(const CTransaction &tx, uint256 hashBlock
 
 CAmount AddNormalinputsLocal(CMutableTransaction& mtx, CPubKey mypk, CAmount total, int32_t maxinputs)
 {
-    int32_t abovei, belowi, ind, vout, n = 0;
-    CAmount sum, above, below;
-    CAmount remains, nValue, totalinputs = 0;
-    // CAmount threshold = 0LL;
-    uint256 txid, hashBlock;
+    CAmount sum;
     std::vector<COutput> vecOutputs;
-    CTransaction tx;
-    struct CC_utxo *utxos, *up;
+    std::vector<const COutput*> candidates;
+    std::vector<COutPoint> outpoints;
+    std::vector<bool> spent;
+    std::vector<struct CC_utxo> utxos;
     if (KOMODO_NSPV_SUPERLITE)
         return (NSPV_AddNormalinputs(mtx, mypk, total, maxinputs, &NSPV_U));
 
@@ -1145,90 +1314,47 @@ CAmount AddNormalinputsLocal(CMutableTransaction& mtx, CPubKey mypk, CAmount tot
 
 #ifdef ENABLE_WALLET
     assert(pwalletMain != NULL);
-    const CKeyStore& keystore = *pwalletMain;
     LOCK2(cs_main, pwalletMain->cs_wallet);
     int64_t txLockTime = (int64_t)komodo_next_tx_locktime();
     pwalletMain->AvailableCoins(vecOutputs, false, NULL, true, txLockTime);
-    utxos = (struct CC_utxo*)calloc(CC_MAXVINS, sizeof(*utxos));
     if (maxinputs > CC_MAXVINS)
         maxinputs = CC_MAXVINS;
-    /*if (maxinputs > 0)
-        threshold = total / maxinputs;
-    else
-        threshold = total;*/
-
 
     //TokelRemoveTimeLockedCoins(vecOutputs, txLockTime);
 
-    sum = 0LL;
+    std::set<COutPoint> added = CC_vinoutpoints(mtx);
     BOOST_FOREACH (const COutput& out, vecOutputs) {
         if (out.fSpendable != 0 && (vecOutputs.size() < maxinputs || out.tx->vout[out.i].nValue > 0LL)) {  // threshold not used as may lead to insufficient inputs messages
-            txid = out.tx->GetHash();
-            vout = out.i;
-            if (myGetTransaction(txid, tx, hashBlock) != false && tx.vout.size() > 0 && vout < tx.vout.size() && tx.vout[vout].scriptPubKey.IsPayToCryptoCondition() == 0) 
-            {
-                {
-                    LOCK(cs_main);
-                    if (CoinbaseGetBlocksToMaturity(tx, hashBlock) > 0) {
-                        //std::cerr << __func__ << " skipping immature coinbase tx=" << txid.GetHex() << " COINBASE_MATURITY=" << COINBASE_MATURITY << std::endl;
-                        continue;
-                    }
-                }
-                //fprintf(stderr,"check %.8f to vins array.%d of %d %s/v%d\n",(double)out.tx->vout[out.i].nValue/COIN,n,maxutxos,txid.GetHex().c_str(),(int32_t)vout);
-                if (mtx.vin.size() > 0) {
-                    if (std::find_if(mtx.vin.begin(), mtx.vin.end(), [&](const CTxIn &vin){ return vin.prevout.hash == txid && vin.prevout.n == vout; }) != mtx.vin.end())  
-                        continue; //already added
-                }
-                if (n > 0) {
-                    if (std::find_if(utxos, utxos+n, [&](const CC_utxo &utxo){ return utxo.txid == txid && utxo.vout == vout; }) != utxos+n)  
-                        continue; //already added
-                }
-                if (myIsutxo_spentinmempool(ignoretxid, ignorevin, txid, vout) == 0) {
-                    up = &utxos[n++];
-                    up->txid = txid;
-                    up->nValue = out.tx->vout[out.i].nValue;
-                    up->vout = vout;
-                    sum += up->nValue;
-                    //fprintf(stderr,"add %.8f to vins array.%d of %d\n",(double)up->nValue/COIN,n,maxutxos);
-                    if (n >= maxinputs || sum >= total)
-                        break;
-                }
+            COutPoint outpoint(out.tx->GetHash(), out.i);
+            if (added.insert(outpoint).second) {  // skip already added
+                candidates.push_back(&out);
+                outpoints.push_back(outpoint);
             }
         }
     }
-    remains = total;
-    for (int32_t i = 0; i < maxinputs && n > 0; i++) {
-        below = above = 0;
-        abovei = belowi = -1;
-        if (CC_vinselect(&abovei, &above, &belowi, &below, utxos, n, remains) < 0) {
-            printf("error finding unspent i.%d of %d, %.8f vs %.8f\n", i, n, (double)remains / COIN, (double)total / COIN);
-            free(utxos);
-            return (0);
-        }
-        if (belowi < 0 || abovei >= 0)
-            ind = abovei;
-        else
-            ind = belowi;
-        if (ind < 0) {
-            printf("error finding unspent i.%d of %d, %.8f vs %.8f, abovei.%d belowi.%d ind.%d\n", i, n, (double)remains / COIN, (double)total / COIN, abovei, belowi, ind);
-            free(utxos);
-            return (0);
+    mempool.getSpentOutpoints(outpoints, spent);
+
+    sum = 0LL;
+    for (size_t j = 0; j < candidates.size(); j++) {
+        const COutput &out = *candidates[j];
+        // the wallet tx is used directly instead of reloading it with myGetTransaction
+        if (spent[j] || out.tx->vout[out.i].scriptPubKey.IsPayToCryptoCondition() != 0)
+            continue;
+        if (CoinbaseGetBlocksToMaturity(*out.tx, out.tx->hashBlock) > 0) {
+            //std::cerr << __func__ << " skipping immature coinbase tx=" << outpoints[j].hash.GetHex() << " COINBASE_MATURITY=" << COINBASE_MATURITY << std::endl;
+            continue;
         }
-        up = &utxos[ind];
-        mtx.vin.push_back(CTxIn(up->txid, up->vout, CScript(), (4294967295U-1)));  // for TOKEL sequence non-final to allow CLTV spending
-        totalinputs += up->nValue;
-        remains -= up->nValue;
-        utxos[ind] = utxos[--n];
-        memset(&utxos[n], 0, sizeof(utxos[n]));
-        //fprintf(stderr,"totalinputs %.8f vs total %.8f i.%d vs max.%d\n",(double)totalinputs/COIN,(double)total/COIN,i,maxinputs);
-        if (totalinputs >= total || (i + 1) >= maxinputs)
+        struct CC_utxo utxo;
+        utxo.txid = outpoints[j].hash;
+        utxo.nValue = out.tx->vout[out.i].nValue;
+        utxo.vout = (int32_t)outpoints[j].n;
+        utxos.push_back(utxo);
+        sum += utxo.nValue;
+        //fprintf(stderr,"add %.8f to vins array.%d of %d\n",(double)utxo.nValue/COIN,(int32_t)utxos.size(),maxinputs);
+        if (utxos.size() >= maxinputs || sum >= total)
             break;
     }
-    free(utxos);
-    if (totalinputs >= total) {
-        //fprintf(stderr,"return totalinputs %.8f\n",(double)totalinputs/COIN);
-        return (totalinputs);
-    }
+    return CC_addselectedinputs(mtx, utxos, total, maxinputs);
 #endif
     return (0);
 }
@@ -1243,25 +1369,19 @@ CAmount AddNormalinputs2(CMutableTransaction &mtx, CAmount total, int32_t maxinp
 // has additional mypk param for nspv calls
 CAmount AddNormalinputsRemote(CMutableTransaction& mtx, CPubKey mypk, CAmount total, int32_t maxinputs, bool useMempool)
 {
-    int32_t abovei, belowi, ind, vout, n = 0;
-    CAmount sum, /*threshold,*/ above, below;
-    CAmount remains, nValue, totalinputs = 0;
+    CAmount sum;
     char coinaddr[64];
-    uint256 txid, hashBlock;
+    uint256 hashBlock;
     CTransaction tx;
-    struct CC_utxo *utxos, *up;
+    std::vector<struct CC_utxo> candidates, utxos;
+    std::vector<COutPoint> outpoints;
+    std::vector<bool> spent;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> unspentOutputs;
 
     if (KOMODO_NSPV_SUPERLITE)
         return (NSPV_AddNormalinputs(mtx, mypk, total, maxinputs, &NSPV_U));
-    utxos = (struct CC_utxo*)calloc(CC_MAXVINS, sizeof(*utxos));
     if (maxinputs > CC_MAXVINS)
         maxinputs = CC_MAXVINS;
-    /*if (maxinputs > 0)
-        threshold = total / maxinputs;
-    else
-        threshold = total;*/
-    sum = 0;
     Getscriptaddress(coinaddr, CScript() << vscript_t(mypk.begin(), mypk.end()) << OP_CHECKSIG);
     if (!useMempool)
         SetCCunspents(unspentOutputs, coinaddr, false);
@@ -1270,11 +1390,8 @@ CAmount AddNormalinputsRemote(CMutableTransaction& mtx, CPubKey mypk, CAmount to
 
     int64_t txLockTime = (int64_t)komodo_next_tx_locktime();
 
+    std::set<COutPoint> added = CC_vinoutpoints(mtx);
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>::const_iterator it = unspentOutputs.begin(); it != unspentOutputs.end(); it++) {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        //if ( it->second.satoshis < threshold )
-        //    continue;  // do not use threshold
         if (it->second.satoshis == 0)
             continue; //skip null outputs
 
@@ -1283,71 +1400,40 @@ CAmount AddNormalinputsRemote(CMutableTransaction& mtx, CPubKey mypk, CAmount to
         if (it->second.script.IsCheckLockTimeVerify(&nLockTime) && !TokelCheckLockTimeHelper(nLockTime, txLockTime))
             continue;
 
-        if (myGetTransaction(txid, tx, hashBlock) != 0 && tx.vout.size() > 0 && vout < tx.vout.size() && tx.vout[vout].scriptPubKey.IsPayToCryptoCondition() == 0) 
+        COutPoint outpoint(it->first.txhash, (uint32_t)it->first.index);
+        if (added.insert(outpoint).second) {  // skip already added
+            struct CC_utxo utxo;
+            utxo.txid = outpoint.hash;
+            utxo.nValue = it->second.satoshis;
+            utxo.vout = (int32_t)outpoint.n;
+            candidates.push_back(utxo);
+            outpoints.push_back(outpoint);
+        }
+    }
+    mempool.getSpentOutpoints(outpoints, spent);
+
+    sum = 0;
+    for (size_t j = 0; j < candidates.size(); j++) {
+        const struct CC_utxo &utxo = candidates[j];
+        if (spent[j])
+            continue;
+        if (myGetTransaction(utxo.txid, tx, hashBlock) != 0 && tx.vout.size() > 0 && utxo.vout < tx.vout.size() && tx.vout[utxo.vout].scriptPubKey.IsPayToCryptoCondition() == 0) 
         {
             {
                 LOCK(cs_main);
                 if (CoinbaseGetBlocksToMaturity(tx, hashBlock) > 0) {
-                    //std::cerr << __func__ << " skipping immature coinbase tx=" << txid.GetHex() << " COINBASE_MATURITY=" << COINBASE_MATURITY << std::endl;
+                    //std::cerr << __func__ << " skipping immature coinbase tx=" << utxo.txid.GetHex() << " COINBASE_MATURITY=" << COINBASE_MATURITY << std::endl;
                     continue;
                 }
             }
-            //fprintf(stderr,"check %.8f to vins array.%d of %d %s/v%d\n",(double)tx.vout[vout].nValue/COIN,n,maxinputs,txid.GetHex().c_str(),(int32_t)vout);
-            if (mtx.vin.size() > 0) {
-                if (std::find_if(mtx.vin.begin(), mtx.vin.end(), [&](const CTxIn &vin){ return vin.prevout.hash == txid && vin.prevout.n == vout; }) != mtx.vin.end())  
-                    continue; //already added
-            }
-            if (n > 0) {
-                if (std::find_if(utxos, utxos+n, [&](const CC_utxo &utxo){ return utxo.txid == txid && utxo.vout == vout; }) != utxos+n)  
-                    continue; //already added
-            }
-            if (myIsutxo_spentinmempool(ignoretxid, ignorevin, txid, vout) == 0) {
-                up = &utxos[n++];
-                up->txid = txid;
-                up->nValue = it->second.satoshis;
-                up->vout = vout;
-                sum += up->nValue;
-                //fprintf(stderr,"add %.8f to vins array.%d of %d\n",(double)up->nValue/COIN,n,maxinputs);
-                if (n >= maxinputs || sum >= total)
-                    break;
-            }
-        }
-    }
-
-    remains = total;
-    for (int32_t i = 0; i < maxinputs && n > 0; i++) {
-        below = above = 0;
-        abovei = belowi = -1;
-        if (CC_vinselect(&abovei, &above, &belowi, &below, utxos, n, remains) < 0) {
-            printf("error finding unspent i.%d of %d, %.8f vs %.8f\n", i, n, (double)remains / COIN, (double)total / COIN);
-            free(utxos);
-            return (0);
+            utxos.push_back(utxo);
+            sum += utxo.nValue;
+            //fprintf(stderr,"add %.8f to vins array.%d of %d\n",(double)utxo.nValue/COIN,(int32_t)utxos.size(),maxinputs);
+            if (utxos.size() >= maxinputs || sum >= total)
+                break;
         }
-        if (belowi < 0 || abovei >= 0)
-            ind = abovei;
-        else
-            ind = belowi;
-        if (ind < 0) {
-            printf("error finding unspent i.%d of %d, %.8f vs %.8f, abovei.%d belowi.%d ind.%d\n", i, n, (double)remains / COIN, (double)total / COIN, abovei, belowi, ind);
-            free(utxos);
-            return (0);
-        }
-        up = &utxos[ind];
-        mtx.vin.push_back(CTxIn(up->txid, up->vout, CScript(), (4294967295U-1)));  // for TOKEL sequence non-final to allow CLTV spending
-        totalinputs += up->nValue;
-        remains -= up->nValue;
-        utxos[ind] = utxos[--n];
-        memset(&utxos[n], 0, sizeof(utxos[n]));
-        //fprintf(stderr,"totalinputs %.8f vs total %.8f i.%d vs max.%d\n",(double)totalinputs/COIN,(double)total/COIN,i,maxinputs);
-        if (totalinputs >= total || (i + 1) >= maxinputs)
-            break;
     }
-    free(utxos);
-    if (totalinputs >= total) {
-        //fprintf(stderr,"return totalinputs %.8f\n",(double)totalinputs/COIN);
-        return (totalinputs);
-    }
-    return (0);
+    return CC_addselectedinputs(mtx, utxos, total, maxinputs);
 }
 
 CAmount AddNormalinputs(CMutableTransaction& mtx, CPubKey mypk, CAmount total, int32_t maxinputs, bool remote)
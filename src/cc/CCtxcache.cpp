@@ -0,0 +1,144 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCtxcache.h"
+
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "util.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <boost/thread.hpp>
+
+namespace {
+
+class CCCTxCache
+{
+private:
+    struct TxEntry {
+        std::shared_ptr<const CTransaction> ptx;
+        uint256 hashBlock;
+        int32_t nHeight;
+        std::list<uint256>::iterator itLru;
+    };
+    //! most recently used txid first
+    std::list<uint256> lru;
+    std::map<uint256, TxEntry> mapTxs;
+    boost::mutex cs_txcache;
+
+    void Erase(std::map<uint256, TxEntry>::iterator it)
+    {
+        lru.erase(it->second.itLru);
+        mapTxs.erase(it);
+    }
+
+public:
+    bool Get(const uint256 &txid, CTransactionRef &ptx, uint256 &hashBlock, int32_t &nHeight)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_txcache);
+
+        std::map<uint256, TxEntry>::iterator it = mapTxs.find(txid);
+        if (it == mapTxs.end())
+            return false;
+        lru.splice(lru.begin(), lru, it->second.itLru);
+        ptx = it->second.ptx;
+        hashBlock = it->second.hashBlock;
+        nHeight = it->second.nHeight;
+        return true;
+    }
+
+    void Set(const CTransactionRef &ptx, const uint256 &hashBlock, int32_t nHeight, int64_t nMaxCacheSize)
+    {
+        const uint256 &txid = ptx->GetHash();
+        boost::unique_lock<boost::mutex> lock(cs_txcache);
+
+        std::map<uint256, TxEntry>::iterator it = mapTxs.find(txid);
+        if (it != mapTxs.end())
+            Erase(it);
+        while (static_cast<int64_t>(mapTxs.size()) >= nMaxCacheSize)
+            Erase(mapTxs.find(lru.back()));
+
+        lru.push_front(txid);
+        TxEntry &entry = mapTxs[txid];
+        entry.ptx = ptx;
+        entry.hashBlock = hashBlock;
+        entry.nHeight = nHeight;
+        entry.itLru = lru.begin();
+    }
+
+    void EraseBlock(const CBlock &block)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_txcache);
+        for (const CTransaction &tx : block.vtx) {
+            std::map<uint256, TxEntry>::iterator it = mapTxs.find(tx.GetHash());
+            if (it != mapTxs.end())
+                Erase(it);
+        }
+    }
+
+    void Clear()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_txcache);
+        mapTxs.clear();
+        lru.clear();
+    }
+};
+
+CCCTxCache ccTxCache;
+
+}
+
+bool CCTxCacheGet(const uint256 &txid, CTransactionRef &ptx, uint256 &hashBlock, int32_t &nHeight)
+{
+    return ccTxCache.Get(txid, ptx, hashBlock, nHeight);
+}
+
+bool CCTxCacheGet(const uint256 &txid, CTransaction &txOut, uint256 &hashBlock, int32_t &nHeight)
+{
+    CTransactionRef ptx;
+    if (!ccTxCache.Get(txid, ptx, hashBlock, nHeight))
+        return false;
+    // copied outside of the lock, the entries are immutable
+    txOut = *ptx;
+    return true;
+}
+
+void CCTxCacheSet(const CTransactionRef &ptx, const uint256 &hashBlock, int32_t nHeight)
+{
+    int64_t nMaxCacheSize = GetArg("-maxcctxcachesize", DEFAULT_MAX_CCTX_CACHE_SIZE);
+    if (hashBlock.IsNull() || nMaxCacheSize <= 0)
+        return;
+    ccTxCache.Set(ptx, hashBlock, nHeight, nMaxCacheSize);
+}
+
+void CCTxCacheSet(const CTransaction &tx, const uint256 &hashBlock, int32_t nHeight)
+{
+    int64_t nMaxCacheSize = GetArg("-maxcctxcachesize", DEFAULT_MAX_CCTX_CACHE_SIZE);
+    if (hashBlock.IsNull() || nMaxCacheSize <= 0)
+        return;
+    ccTxCache.Set(MakeTransactionRef(tx), hashBlock, nHeight, nMaxCacheSize);
+}
+
+void CCTxCacheEraseBlock(const CBlock &block)
+{
+    ccTxCache.EraseBlock(block);
+}
+
+void CCTxCacheClear()
+{
+    ccTxCache.Clear();
+}
@@ -0,0 +1,47 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_TXCACHE_H
+#define CC_TXCACHE_H
+
+#include <stdint.h>
+#include <memory>
+#include "uint256.h"
+
+class CBlock;
+class CTransaction;
+typedef std::shared_ptr<const CTransaction> CTransactionRef;
+
+/** -maxcctxcachesize default (number of cached confirmed transactions, 0 = disabled) */
+static const int64_t DEFAULT_MAX_CCTX_CACHE_SIZE = 20000;
+
+/**
+ * LRU cache of decoded confirmed transactions, shared by myGetTransaction,
+ * Eval::GetTxUnconfirmed and NSPV_myGetTransaction, so CC modules and RPCs
+ * reading the same transactions for every utxo do not go to disk each time.
+ *
+ * Only transactions with a block hash are cached. The transactions of a
+ * disconnected block are erased, so an entry always refers to the block the
+ * tx index pointed at when it was read. nHeight is 0 when it is not known.
+ */
+bool CCTxCacheGet(const uint256 &txid, CTransaction &txOut, uint256 &hashBlock, int32_t &nHeight);
+void CCTxCacheSet(const CTransaction &tx, const uint256 &hashBlock, int32_t nHeight);
+/** The same without a copy, the cache keeps ptx itself */
+bool CCTxCacheGet(const uint256 &txid, CTransactionRef &ptx, uint256 &hashBlock, int32_t &nHeight);
+void CCTxCacheSet(const CTransactionRef &ptx, const uint256 &hashBlock, int32_t nHeight);
+void CCTxCacheEraseBlock(const CBlock &block);
+void CCTxCacheClear();
+
+#endif // CC_TXCACHE_H
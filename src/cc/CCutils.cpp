@@ -21,6 +21,8 @@
 #include "komodo_structs.h"
 #include "CCinclude.h"
 #include "CCtokens.h"
+#include "CCevalcache.h"
+#include "CCoraclesindex.h"
 
 thread_local CCERROR CCerror = "";
 
@@ -170,7 +172,7 @@ CC* GetCryptoCondition(CScript const& scriptSig)
     std::vector<unsigned char> ffbin;
     if (scriptSig.GetOp(pc, opcode, ffbin))
         if (ffbin.data() != NULL)  // could return NULL if called for coinbase
-            return cc_readFulfillmentBinary((uint8_t*)ffbin.data(), ffbin.size()-1);
+            return CCReadFulfillmentCached((uint8_t*)ffbin.data(), ffbin.size()-1, false);
     
     return(NULL);
 }
@@ -654,34 +656,48 @@ uint256 CCOraclesReverseScan(char const *logcategory,uint256 &txid,int32_t heigh
 {
     CTransaction tx; uint256 hash,mhash,bhash,hashBlock,oracletxid; int32_t len,len2,numvouts;
     int64_t val,merkleht; CPubKey pk; std::vector<uint8_t>data; char str[65],str2[65];
-    
+    bool done = false;
+
+    // returns false when the scan ends with the sample
+    auto checksample = [&](const uint256 &samplehash, const std::vector<uint8_t> &sampledata) -> bool
+    {
+        LogPrint(logcategory,"decoded %s\n",uint256_str(str,samplehash));
+        if ( oracle_format(&hash,&merkleht,0,'I',(uint8_t *)sampledata.data(),0,(int32_t)sampledata.size()) == sizeof(int32_t) && merkleht == height )
+        {
+            len = oracle_format(&hash,&val,0,'h',(uint8_t *)sampledata.data(),sizeof(int32_t),(int32_t)sampledata.size());
+            len2 = oracle_format(&mhash,&val,0,'h',(uint8_t *)sampledata.data(),(int32_t)(sizeof(int32_t)+sizeof(uint256)),(int32_t)sampledata.size());
+
+            LogPrint(logcategory,"found merkleht.%d len.%d len2.%d %s %s\n",(int32_t)merkleht,len,len2,uint256_str(str,hash),uint256_str(str2,mhash));
+            done = true;
+            if ( len == sizeof(hash)+sizeof(int32_t) && len2 == 2*sizeof(mhash)+sizeof(int32_t) && mhash != zeroid )
+            {
+                txid = samplehash;
+                LogPrint(logcategory,"set txid\n");
+            }
+            else
+            {
+                LogPrint(logcategory,"missing hash\n");
+                mhash = zeroid;
+            }
+            return false;
+        }
+        else LogPrint(logcategory,"height.%d vs search ht.%d\n",(int32_t)merkleht,(int32_t)height);
+        return true;
+    };
+
     txid = zeroid;
     LogPrint(logcategory,"start reverse scan %s\n",uint256_str(str,batontxid));
+    // confirmed samples are read from the oracles index while it follows the baton chain
+    batontxid = OraclesIndexWalkBaton(reforacletxid, batontxid, [&](const COraclesSample &sample) { return checksample(sample.txid, sample.data); });
+    if ( done )
+        return(mhash);
     while ( myGetTransaction(batontxid,tx,hashBlock) != 0 && (numvouts= tx.vout.size()) > 0 )
     {
         LogPrint(logcategory,"check %s\n",uint256_str(str,batontxid));
         if ( DecodeOraclesData(tx.vout[numvouts-1].scriptPubKey,oracletxid,bhash,pk,data) == 'D' && oracletxid == reforacletxid )
         {
-            LogPrint(logcategory,"decoded %s\n",uint256_str(str,batontxid));
-            if ( oracle_format(&hash,&merkleht,0,'I',(uint8_t *)data.data(),0,(int32_t)data.size()) == sizeof(int32_t) && merkleht == height )
-            {
-                len = oracle_format(&hash,&val,0,'h',(uint8_t *)data.data(),sizeof(int32_t),(int32_t)data.size());
-                len2 = oracle_format(&mhash,&val,0,'h',(uint8_t *)data.data(),(int32_t)(sizeof(int32_t)+sizeof(uint256)),(int32_t)data.size());
-
-                LogPrint(logcategory,"found merkleht.%d len.%d len2.%d %s %s\n",(int32_t)merkleht,len,len2,uint256_str(str,hash),uint256_str(str2,mhash));
-                if ( len == sizeof(hash)+sizeof(int32_t) && len2 == 2*sizeof(mhash)+sizeof(int32_t) && mhash != zeroid )
-                {
-                    txid = batontxid;
-                    LogPrint(logcategory,"set txid\n");
-                    return(mhash);
-                }
-                else
-                {
-                    LogPrint(logcategory,"missing hash\n");
-                    return(zeroid);
-                }
-            }
-            else LogPrint(logcategory,"height.%d vs search ht.%d\n",(int32_t)merkleht,(int32_t)height);
+            if ( !checksample(batontxid, data) )
+                return(mhash);
             batontxid = bhash;
             LogPrint(logcategory,"new hash %s\n",uint256_str(str,batontxid));
         } else break;
@@ -928,13 +944,20 @@ bool ProcessCC(struct CCcontract_info* cp, Eval* eval, std::vector<uint8_t> para
     CCclearvars(cp);
     if (paramsNull.size() != 0) // Don't expect params
         return eval->Invalid("eval conds cannot have params yet");
+    if (evalcodeChecker.get() != NULL && CCEvalCacheGet(ctx.GetHash(), nIn, cp->evalcode, evalcodeChecker->hashPrevBlock, eval->GetCurrentHeight(), eval->GetCurrentTime())) {
+        evalcodeChecker->MarkEvalCode(ctx.GetHash(), cp->evalcode);
+        return true;
+    }
     //else if ( ctx.vout.size() == 0 )      // spend can go to z-addresses
     //    return eval->Invalid("no-vouts");
-    else if ((*cp->validate)(cp, eval, ctx, nIn) != 0) {
+    if ((*cp->validate)(cp, eval, ctx, nIn) != 0) {
         //fprintf(stderr,"done CC %02x\n",cp->evalcode);
         //cp->prevtxid = txid;
-        if (evalcodeChecker.get() != NULL)
+        if (evalcodeChecker.get() != NULL) {
             evalcodeChecker->MarkEvalCode(ctx.GetHash(), cp->evalcode);
+            if (evalcodeChecker->fStoreEvalResults)
+                CCEvalCacheSet(ctx.GetHash(), nIn, cp->evalcode, evalcodeChecker->hashPrevBlock, eval->GetCurrentHeight(), eval->GetCurrentTime());
+        }
         return true;
     }
     //fprintf(stderr,"invalid CC %02x\n",cp->evalcode);
@@ -956,12 +979,17 @@ bool SubcallCCValidate(Eval* eval, uint8_t evalcode, const CTransaction& ctx, in
         }
     }
 
-    struct CCcontract_info *cp;
-    cp = &CCinfos[(int32_t)evalcode];
-    if ( cp->didinit == 0 )
+    struct CCcontract_info *cp, C;
+    if ( fParallelCCEval )
+        cp = CCinit(&C, evalcode); // private copy, see Eval::Dispatch
+    else
     {
-        CCinit(cp, evalcode);
-        cp->didinit = 1;
+        cp = &CCinfos[(int32_t)evalcode];
+        if ( cp->didinit == 0 )
+        {
+            CCinit(cp, evalcode);
+            cp->didinit = 1;
+        }
     }
 
     if (cp->validate == NULL)
@@ -1018,19 +1046,87 @@ bool CClib_Dispatch(const CC* cond, Eval* eval, std::vector<uint8_t> paramsNull,
     return eval->Invalid("cclib CC must have evalcode between 16 and 127");
 }
 
+/**
+ * Direct mapped cache of 32 byte values derived from keys with a scalar
+ * multiplication, looked up by the sha256 of the keys. The keys themselves
+ * are not kept.
+ */
+template <int32_t N>
+class CSuperNETKeyCache
+{
+private:
+    struct entry { uint8_t id[32]; uint8_t value[32]; int32_t valid; } entries[N];
+    CCriticalSection cs;
+
+public:
+    CSuperNETKeyCache() { memset(entries,0,sizeof(entries)); }
+
+    bool Get(const uint8_t id[32],uint8_t value[32])
+    {
+        LOCK(cs);
+        const struct entry &e = entries[(id[0] | ((int32_t)id[1] << 8)) % N];
+        if ( e.valid == 0 || memcmp(e.id,id,32) != 0 )
+            return(false);
+        memcpy(value,e.value,32);
+        return(true);
+    }
+
+    void Set(const uint8_t id[32],const uint8_t value[32])
+    {
+        LOCK(cs);
+        struct entry &e = entries[(id[0] | ((int32_t)id[1] << 8)) % N];
+        memcpy(e.id,id,32);
+        memcpy(e.value,value,32);
+        e.valid = 1;
+    }
+};
+
+// crypto_box precomputations of recent peers, DEX trial decryption of anon packets repeats them for every packet of a sender
+static CSuperNETKeyCache<256> SuperNET_boxkeys;
+// the pubkeys of the few privkeys that encrypt
+static CSuperNETKeyCache<8> SuperNET_pubkeys;
+
+// -1 when pubkey is one crypto_box refuses, as it would for the whole box
+static int32_t SuperNET_boxkey(uint8_t k[crypto_box_BEFORENMBYTES],bits256 pubkey,bits256 privkey)
+{
+    uint8_t buf[64],id[32];
+    memcpy(buf,pubkey.bytes,32);
+    memcpy(&buf[32],privkey.bytes,32);
+    vcalc_sha256(0,id,buf,sizeof(buf));
+    memset(buf,0,sizeof(buf));
+    if ( SuperNET_boxkeys.Get(id,k) )
+        return(0);
+    if ( crypto_box_beforenm(k,pubkey.bytes,privkey.bytes) != 0 )
+        return(-1);
+    SuperNET_boxkeys.Set(id,k);
+    return(0);
+}
+
+static bits256 SuperNET_pubkey(bits256 privkey)
+{
+    bits256 pubkey; uint8_t id[32];
+    vcalc_sha256(0,id,privkey.bytes,sizeof(privkey));
+    if ( SuperNET_pubkeys.Get(id,pubkey.bytes) )
+        return(pubkey);
+    pubkey = curve25519(privkey,curve25519_basepoint9());
+    SuperNET_pubkeys.Set(id,pubkey.bytes);
+    return(pubkey);
+}
+
 int32_t _SuperNET_cipher(uint8_t nonce[crypto_box_NONCEBYTES],uint8_t *cipher,uint8_t *message,int32_t len,bits256 destpub,bits256 srcpriv,uint8_t *buf)
 {
+    uint8_t k[crypto_box_BEFORENMBYTES];
     memset(cipher,0,len+crypto_box_ZEROBYTES);
     memset(buf,0,crypto_box_ZEROBYTES);
     memcpy(buf+crypto_box_ZEROBYTES,message,len);
-    if ( crypto_box(cipher,buf,len+crypto_box_ZEROBYTES,nonce,destpub.bytes,srcpriv.bytes) != 0 )
+    if ( SuperNET_boxkey(k,destpub,srcpriv) != 0 || crypto_box_afternm(cipher,buf,len+crypto_box_ZEROBYTES,nonce,k) != 0 )
         return(-1);
     return(len + crypto_box_ZEROBYTES);
 }
 
 uint8_t *_SuperNET_decipher(uint8_t nonce[crypto_box_NONCEBYTES],uint8_t *cipher,uint8_t *message,int32_t len,bits256 srcpub,bits256 mypriv)
 {
-    int32_t err;
+    int32_t err; uint8_t k[crypto_box_BEFORENMBYTES];
     if ( (0) )
     {
         int32_t z;
@@ -1047,7 +1143,7 @@ uint8_t *_SuperNET_decipher(uint8_t nonce[crypto_box_NONCEBYTES],uint8_t *cipher
             fprintf(stderr,"%02x",cipher[z]);
         fprintf(stderr," cipher[%d]\n",len);
     }
-    if ( (err= crypto_box_open(message,cipher,len,nonce,srcpub.bytes,mypriv.bytes)) == 0 )
+    if ( SuperNET_boxkey(k,srcpub,mypriv) == 0 && (err= crypto_box_open_afternm(message,cipher,len,nonce,k)) == 0 )
     {
         message += crypto_box_ZEROBYTES;
         len -= crypto_box_ZEROBYTES;
@@ -1093,7 +1189,7 @@ uint8_t *SuperNET_ciphercalc(uint8_t **ptrp,int32_t *cipherlenp,bits256 privkey,
     cipher = (uint8_t *)calloc(1,allocsize);
     *ptrp = cipher;
     origptr = nonce = cipher;
-    mypubkey = curve25519(privkey,curve25519_basepoint9());
+    mypubkey = SuperNET_pubkey(privkey);
     memcpy(cipher,mypubkey.bytes,sizeof(mypubkey));
     nonce = &cipher[sizeof(mypubkey)];
     OS_randombytes(nonce,crypto_box_NONCEBYTES);
@@ -14,6 +14,10 @@
  ******************************************************************************/
 
 #include "CCagreements.h"
+#include "CCagreementsindex.h"
+
+#include "base58.h"
+#include "txdb.h"
 
 /*
 The goal here is to create FSM-like on-chain agreements, which are created and their state updated by mutual assent of two separate keys.
@@ -1454,7 +1458,142 @@ bool AgreementsValidate(struct CCcontract_info *cp, Eval* eval, const CTransacti
 
 // --- Helper functions for RPC implementations ---
 
-uint8_t FindLatestAgreementEvent(uint256 agreementtxid, struct CCcontract_info *cp, uint256 &eventtxid)
+// Decodes an agreement accept or agreement event transaction for the agreements index.
+// Adds the agreement txid of an event, or the agreement txid and the referenced agreement txid of an agreement, to agreementtxids.
+static bool DecodeAgreementEvent(struct CCcontract_info *cp, const CTransaction &tx, std::vector<uint256> &agreementtxids, CAgreementEvent &event)
+{
+	CTransaction offertx;
+	uint256 hashBlock, agreementtxid, offertxid, refagreementtxid, dummyuint256;
+	uint8_t version, offerflags, dummyuint8;
+	int64_t dummyint64, deposit, payment, disputefee;
+	std::vector<uint8_t> srckey, destkey, arbkey;
+	std::string dummystring, agreementname, agreementmemo;
+	char batonaddr[KOMODO_ADDRESS_BUFSIZE];
+	int type;
+
+	if (tx.vout.size() == 0 || (event.funcid = DecodeAgreementOpRet(tx.vout.back().scriptPubKey)) == 0 || !IsTxCCV2(cp, tx))
+		return false;
+	switch (event.funcid)
+	{
+		case 'c':
+			agreementtxids.push_back(tx.GetHash());
+			// The accepted offer is confirmed before the agreement, as GetAcceptedOfferTx requires.
+			if (DecodeAgreementAcceptOpRet(tx.vout.back().scriptPubKey, version, offertxid) != 0 &&
+			myGetTransaction(offertxid, offertx, hashBlock) && !hashBlock.IsNull() && offertx.vout.size() > 0 &&
+			DecodeAgreementOfferOpRet(offertx.vout.back().scriptPubKey, version, srckey, destkey, arbkey, offerflags, refagreementtxid, deposit,
+			payment, disputefee, agreementname, agreementmemo) == 'o' && refagreementtxid != zeroid)
+				agreementtxids.push_back(refagreementtxid);
+			break;
+		case 't':
+			if (DecodeAgreementCloseOpRet(tx.vout.back().scriptPubKey, version, agreementtxid, offertxid, dummyint64) == 0)
+				return false;
+			agreementtxids.push_back(agreementtxid);
+			break;
+		case 'd':
+			if (DecodeAgreementDisputeOpRet(tx.vout.back().scriptPubKey, version, agreementtxid, srckey, dummyuint8, dummystring) == 0)
+				return false;
+			agreementtxids.push_back(agreementtxid);
+			break;
+		case 'x':
+			if (DecodeAgreementDisputeCancelOpRet(tx.vout.back().scriptPubKey, version, agreementtxid, dummyuint256, srckey, dummystring) == 0)
+				return false;
+			agreementtxids.push_back(agreementtxid);
+			break;
+		case 'r':
+			if (DecodeAgreementDisputeResolveOpRet(tx.vout.back().scriptPubKey, version, agreementtxid, dummyuint256, dummyint64, dummystring) == 0)
+				return false;
+			agreementtxids.push_back(agreementtxid);
+			break;
+		case 'u':
+			if (DecodeAgreementUnlockOpRet(tx.vout.back().scriptPubKey, version, srckey, agreementtxid, dummyuint256) == 0)
+				return false;
+			agreementtxids.push_back(agreementtxid);
+			break;
+		default:
+			return false;
+	}
+	event.txid = tx.GetHash();
+	event.prevtxid = (tx.vin.size() > 0 && tx.vin[0].prevout.n == 0) ? tx.vin[0].prevout.hash : zeroid;
+	event.batonHash.SetNull();
+	if (tx.vout[0].scriptPubKey.IsPayToCryptoCondition() && Getscriptaddress(batonaddr, tx.vout[0].scriptPubKey))
+		CBitcoinAddress(batonaddr).GetIndexKey(event.batonHash, type, true);
+	return true;
+}
+
+static void AgreementsBlockEvents(const CBlock &block, const CBlockIndex *pindex, std::vector<std::pair<CAgreementEventKey, CAgreementEvent> > &events)
+{
+	struct CCcontract_info *cp,C;
+	cp = CCinit(&C,EVAL_AGREEMENTS);
+
+	for (unsigned int i = 0; i < block.vtx.size(); i++)
+	{
+		std::vector<uint256> agreementtxids;
+		CAgreementEvent event;
+		if (DecodeAgreementEvent(cp, block.vtx[i], agreementtxids, event))
+			for (const uint256 &agreementtxid : agreementtxids)
+				events.push_back(std::make_pair(CAgreementEventKey(agreementtxid, pindex->GetHeight(), i), event));
+	}
+}
+
+bool AgreementsIndexConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+	std::vector<std::pair<CAgreementEventKey, CAgreementEvent> > events;
+
+	AgreementsBlockEvents(block, pindex, events);
+	if (events.empty())
+		return true;
+	return pblocktree->WriteAgreementEvents(events);
+}
+
+bool AgreementsIndexDisconnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+	std::vector<std::pair<CAgreementEventKey, CAgreementEvent> > events;
+	std::vector<CAgreementEventKey> keys;
+
+	AgreementsBlockEvents(block, pindex, events);
+	if (events.empty())
+		return true;
+	for (const auto &event : events)
+		keys.push_back(event.first);
+	return pblocktree->EraseAgreementEvents(keys);
+}
+
+// Returns true if no further events can follow an event with this function id.
+static bool IsFinalAgreementEvent(uint8_t funcid)
+{
+	return (funcid == 'c' || funcid == 'r' || funcid == 'u' || funcid == 't');
+}
+
+// Follows the baton chain of an agreement through the agreements index, from the agreement transaction to the latest indexed event
+// that spent the previous baton, adding the events to chain. Returns false if the index doesn't have the agreement transaction.
+static bool FindLatestIndexedAgreementEvent(uint256 agreementtxid, char *eventCCaddress, CAgreementEvent &latest, std::vector<std::pair<uint256,uint8_t>> &chain)
+{
+	std::vector<std::pair<CAgreementEventKey, CAgreementEvent> > events;
+	uint160 eventHash;
+	int type;
+
+	if (!CBitcoinAddress(eventCCaddress).GetIndexKey(eventHash, type, true) ||
+	!pblocktree->ReadAgreementEvents(agreementtxid, events) || events.empty() || events[0].second.txid != agreementtxid)
+		return false;
+
+	// vout0 of a transaction can only be spent once, so the event spending the latest baton is the next one in the chain
+	latest = events[0].second;
+	for (size_t i = 1; i < events.size() && latest.batonHash == eventHash; i++)
+	{
+		if (events[i].second.prevtxid == latest.txid)
+		{
+			latest = events[i].second;
+			chain.push_back(std::make_pair(latest.txid, latest.funcid));
+			if (IsFinalAgreementEvent(latest.funcid))
+				break;
+		}
+	}
+	return true;
+}
+
+// Finds the function id of the latest event of the specified agreement, and its txid in eventtxid.
+// If pchain is set, all events from the agreement transaction to the latest one are added to it with their function ids.
+uint8_t FindLatestAgreementEvent(uint256 agreementtxid, struct CCcontract_info *cp, uint256 &eventtxid, std::vector<std::pair<uint256,uint8_t>> *pchain)
 {
 	CTransaction sourcetx, batontx;
 	uint256 hashBlock, batontxid, refagreementtxid;
@@ -1464,6 +1603,9 @@ uint8_t FindLatestAgreementEvent(uint256 agreementtxid, struct CCcontract_info *
 	CPubKey Agreementspk,offertxidpk;
 	int64_t deposit, disputefee;
 	uint256 offertxid;
+	CAgreementEvent latest;
+	std::vector<std::pair<uint256,uint8_t>> indexed;
+	bool bFinal = false;
 
 	eventtxid = zeroid;
 
@@ -1478,9 +1620,23 @@ uint8_t FindLatestAgreementEvent(uint256 agreementtxid, struct CCcontract_info *
 		Agreementspk = GetUnspendable(cp, NULL);
 		offertxidpk = CCtxidaddr_tweak(txidaddr,offertxid);
 		GetCCaddress1of2(cp, eventCCaddress, Agreementspk, offertxidpk, true);
+
+		if (pchain != nullptr)
+			pchain->push_back(std::make_pair(agreementtxid, funcid));
+
+		// Skip the confirmed events found in the agreements index, the rest of the chain is followed below.
+		if (fAgreementsIndex && FindLatestIndexedAgreementEvent(agreementtxid, eventCCaddress, latest, indexed) &&
+		latest.txid != agreementtxid && myGetTransactionCCV2(cp, latest.txid, batontx, hashBlock) && !hashBlock.IsNull())
+		{
+			sourcetx = batontx;
+			funcid = latest.funcid;
+			bFinal = IsFinalAgreementEvent(funcid);
+			if (pchain != nullptr)
+				pchain->insert(pchain->end(), indexed.begin(), indexed.end());
+		}
 		
 		// Iterate through vout0 batons while we're finding valid Agreements transactions that spent the last baton.
-		while ((IsAgreementsvout(cp,sourcetx,0,eventCCaddress) != 0) &&
+		while (!bFinal && (IsAgreementsvout(cp,sourcetx,0,eventCCaddress) != 0) &&
 		
 		// Check if vout0 was spent.
 		(retcode = CCgetspenttxid(batontxid, vini, height, sourcetx.GetHash(), 0)) == 0 &&
@@ -1490,9 +1646,11 @@ uint8_t FindLatestAgreementEvent(uint256 agreementtxid, struct CCcontract_info *
 		(funcid = DecodeAgreementOpRet(batontx.vout.back().scriptPubKey)) != 0)
 		{
 			sourcetx = batontx;
+			if (pchain != nullptr)
+				pchain->push_back(std::make_pair(batontxid, funcid));
 
 			// Stop iterating through batons if we've reach a transaction type that terminates any future events for this agreement.
-			if (funcid == 'c' || funcid == 'r' || funcid == 'u' || funcid == 't')
+			if (IsFinalAgreementEvent(funcid))
 				break;
 		}
 
@@ -3094,6 +3252,32 @@ UniValue AgreementInfo(const uint256 txid)
 	CCERR_RESULT("agreementscc", CCLOG_INFO, stream << "invalid Agreements transaction id");
 }
 
+// Adds eventtxid to the agreementeventlog result if its function id is selected by flags.
+static void AddAgreementEventLogEntry(UniValue &result, const uint256 agreementtxid, uint8_t flags, const uint256 eventtxid, uint8_t funcid)
+{
+	switch(funcid)
+	{
+		case 'c':
+			if (flags & ASF_AMENDMENTS && eventtxid != agreementtxid) result.push_back(eventtxid.GetHex());
+			break;
+		case 't':
+			if (flags & ASF_CLOSURES) result.push_back(eventtxid.GetHex());
+			break;
+		case 'd':
+			if (flags & ASF_DISPUTES) result.push_back(eventtxid.GetHex());
+			break;
+		case 'r':
+			if (flags & ASF_RESOLUTIONS) result.push_back(eventtxid.GetHex());
+			break;
+		case 'u':
+			if (flags & ASF_UNLOCKS) result.push_back(eventtxid.GetHex());
+			break;
+		case 'x':
+			if (flags & ASF_DISPUTECANCELS) result.push_back(eventtxid.GetHex());
+			break;
+	}
+}
+
 UniValue AgreementEventLog(const uint256 agreementtxid,uint8_t flags,int64_t samplenum,bool bReverse)
 {
 	UniValue result(UniValue::VARR);
@@ -3102,6 +3286,7 @@ UniValue AgreementEventLog(const uint256 agreementtxid,uint8_t flags,int64_t sam
 	int64_t total = 0LL;
 	int32_t numvouts,vini,height;
 	uint8_t funcid;
+	std::vector<std::pair<uint256,uint8_t>> chain;
 
 	struct CCcontract_info *cp,C;
 	cp = CCinit(&C,EVAL_AGREEMENTS);
@@ -3109,9 +3294,22 @@ UniValue AgreementEventLog(const uint256 agreementtxid,uint8_t flags,int64_t sam
 	if (myGetTransactionCCV2(cp,agreementtxid,agreementtx,hashBlock) && (numvouts = agreementtx.vout.size()) > 0 &&
 	DecodeAgreementOpRet(agreementtx.vout[numvouts-1].scriptPubKey) == 'c')
 	{
-		FindLatestAgreementEvent(agreementtxid,cp,eventtxid);
+		FindLatestAgreementEvent(agreementtxid,cp,eventtxid,fAgreementsIndex ? &chain : nullptr);
 
-		if (eventtxid != agreementtxid)
+		if (eventtxid != agreementtxid && fAgreementsIndex)
+		{
+			// The events were already collected while finding the latest one, no need to fetch them again.
+			if (bReverse) // from latest event to oldest
+				std::reverse(chain.begin(), chain.end());
+			for (const auto &event : chain)
+			{
+				if (total >= samplenum && samplenum != 0)
+					break;
+				AddAgreementEventLogEntry(result, agreementtxid, flags, event.first, event.second);
+				if (event.first != agreementtxid) total++;
+			}
+		}
+		else if (eventtxid != agreementtxid)
 		{
 			if (bReverse) // from latest event to oldest
 				batontxid = eventtxid;
@@ -3125,27 +3323,7 @@ UniValue AgreementEventLog(const uint256 agreementtxid,uint8_t flags,int64_t sam
 			// Fetch function id.
 			(funcid = DecodeAgreementOpRet(batontx.vout.back().scriptPubKey)) != 0)
 			{
-				switch(funcid)
-				{
-					case 'c':
-						if (flags & ASF_AMENDMENTS && batontxid != agreementtxid) result.push_back(batontxid.GetHex());
-						break;
-					case 't':
-						if (flags & ASF_CLOSURES) result.push_back(batontxid.GetHex());
-						break;
-					case 'd':
-						if (flags & ASF_DISPUTES) result.push_back(batontxid.GetHex());
-						break;
-					case 'r':
-						if (flags & ASF_RESOLUTIONS) result.push_back(batontxid.GetHex());
-						break;
-					case 'u':
-						if (flags & ASF_UNLOCKS) result.push_back(batontxid.GetHex());
-						break;
-					case 'x':
-						if (flags & ASF_DISPUTECANCELS) result.push_back(batontxid.GetHex());
-						break;
-				}
+				AddAgreementEventLogEntry(result, agreementtxid, flags, batontxid, funcid);
 				
 				if (batontxid != agreementtxid) total++;
 
@@ -3188,6 +3366,16 @@ UniValue AgreementReferences(const uint256 agreementtxid)
 	if (myGetTransactionCCV2(cp,agreementtxid,agreementtx,hashBlock) && (numvouts = agreementtx.vout.size()) > 0 &&
 	DecodeAgreementOpRet(agreementtx.vout[numvouts-1].scriptPubKey) == 'c')
 	{
+		// The agreements index lists the confirmed agreements referencing agreementtxid under its key.
+		std::vector<std::pair<CAgreementEventKey, CAgreementEvent> > events;
+		if (fAgreementsIndex && pblocktree->ReadAgreementEvents(agreementtxid, events))
+		{
+			for (const auto &event : events)
+				if (event.second.funcid == 'c' && event.second.txid != agreementtxid)
+					result.push_back(event.second.txid.GetHex());
+			return(result);
+		}
+
 		SetCCtxids(txids,AgreementsCCaddr,true,cp->evalcode,0,zeroid,'c');
 		for (std::vector<uint256>::const_iterator it=txids.begin(); it!=txids.end(); it++)
 		{
@@ -16,6 +16,7 @@
 #include "CCtokens.h"
 #include "CCtokens_impl.h"
 #include "CCchannels.h"
+#include "CCchannelsbook.h"
 
 /*
  The idea here is to allow instant (mempool) payments that are secured by dPoW. In order to simplify things, channels CC will require creating reserves for each payee locked in the destination user's CC address. This will look like the payment is already made, but it is locked until further released. The dPoW protection comes from the cancel channel having a delayed effect until the next notarization. This way, if a payment release is made and the chain reorged, the same payment release will still be valid when it is re-broadcast into the mempool.
@@ -402,12 +403,15 @@ int64_t AddChannelsInputs(struct CCcontract_info *cp,CMutableTransaction &mtx, C
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
     CPubKey srcpub,destpub;
     uint8_t myprivkey[32];    
+    ChannelsBookState state; bool fBook = false;
 
     if ((numvouts=openTx.vout.size()) > 0 && DecodeChannelsOpRet(openTx.vout[numvouts-1].scriptPubKey,tokenid,tmp_txid,srcpub,destpub,param1,param2,param3)=='O')
     {
         if (tokenid!=zeroid) GetTokensCCaddress1of2(cp,coinaddr,srcpub,destpub);
         else GetCCaddress1of2(cp,coinaddr,srcpub,destpub);
-        SetCCunspents(unspentOutputs,coinaddr,true);
+        // the book has the latest confirmed tx of the channel, the address is only scanned without it
+        if ((fBook=ChannelsBookGetState(openTx.GetHash(),state)) == false)
+            SetCCunspents(unspentOutputs,coinaddr,true);
     }
     else
     {
@@ -416,7 +420,13 @@ int64_t AddChannelsInputs(struct CCcontract_info *cp,CMutableTransaction &mtx, C
     }
     if (srcpub==mypk) marker=1;
     else marker=2;
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    if (fBook)
+    {
+        if (!state.latesttxid.IsNull() && myGetTransaction(state.latesttxid,tx,hashBlock) != 0 && tx.vout.size() > 3 &&
+          IsChannelsMarkervout(cp,tx,marker==1?srcpub:destpub,marker)>0 && (totalinputs=IsChannelsvout(cp,tx,srcpub,destpub,0))>0)
+            txid = state.latesttxid;
+    }
+    else for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
     {
         if ( (int32_t)it->first.index==0 && myGetTransaction(it->first.txhash,tx,hashBlock) != 0 && (numvouts=tx.vout.size()) > 0)
         {
@@ -712,10 +722,10 @@ UniValue ChannelsList(const CPubKey& pk)
 
 UniValue ChannelsInfo(const CPubKey& pk,uint256 channeltxid)
 {
-    UniValue result(UniValue::VOBJ),array(UniValue::VARR); CTransaction tx,opentx; uint256 txid,tmp_txid,hashBlock,param3,opentxid,hashchain,tokenid;
-    struct CCcontract_info *cp,C; char CCaddr[65],addr[65],str[512]; int32_t vout,numvouts,param1,numpayments;
+    UniValue result(UniValue::VOBJ),array(UniValue::VARR); CTransaction tx; uint256 txid,tmp_txid,hashBlock,param3,opentxid,tokenid;
+    struct CCcontract_info *cp,C; char CCaddr[65],addr[65],str[512]; int32_t vout,numvouts,param1;
     int64_t param2,payment; CPubKey srcpub,destpub,mypk;
-    std::vector<uint256> txids; std::vector<CTransaction> txs;
+    std::vector<uint256> txids; std::vector<CTransaction> txs; ChannelsBookState state;
     
     cp = CCinit(&C,EVAL_CHANNELS);
     mypk = pk.IsValid()?pk:pubkey2pk(Mypubkey());
@@ -729,6 +739,7 @@ UniValue ChannelsInfo(const CPubKey& pk,uint256 channeltxid)
         result.push_back(Pair("Channel CC address",CCaddr));
         result.push_back(Pair("Destination address",addr));
         result.push_back(Pair("Number of payments",param1));
+        payment=param2;
         if(tokenid!=zeroid)
         {
             result.push_back(Pair("Token id",tokenid.GetHex().data()));
@@ -740,13 +751,26 @@ UniValue ChannelsInfo(const CPubKey& pk,uint256 channeltxid)
             result.push_back(Pair("Denomination (satoshi)",i64tostr(param2)));
             result.push_back(Pair("Amount (satoshi)",i64tostr(param1*param2)));
         }
-        GetCCaddress(cp,CCaddr,mypk);
-        SetCCtxids(txids,CCaddr,true,EVAL_CHANNELS,0,channeltxid,0);                      
-        for (std::vector<uint256>::const_iterator it=txids.begin(); it!=txids.end(); it++)
+        if (ChannelsBookGetState(channeltxid,state))
+        {
+            // as the marker address of mypk, the history is only there for the parties of the channel
+            if (mypk==state.srcpub || mypk==state.destpub)
+            {
+                for (std::vector<uint256>::const_iterator it=state.txids.begin(); it!=state.txids.end(); it++)
+                    if (myGetTransaction(*it,tx,hashBlock) != 0)
+                        txs.push_back(tx);
+            }
+        }
+        else
         {
-            if (myGetTransaction(*it,tx,hashBlock) != 0 && (numvouts= tx.vout.size()) > 0 &&
-                DecodeChannelsOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,tmp_txid,srcpub,destpub,param1,param2,param3)!=0 && (tmp_txid==channeltxid || tx.GetHash()==channeltxid))
-                    txs.push_back(tx);               
+            GetCCaddress(cp,CCaddr,mypk);
+            SetCCtxids(txids,CCaddr,true,EVAL_CHANNELS,0,channeltxid,0);                      
+            for (std::vector<uint256>::const_iterator it=txids.begin(); it!=txids.end(); it++)
+            {
+                if (myGetTransaction(*it,tx,hashBlock) != 0 && (numvouts= tx.vout.size()) > 0 &&
+                    DecodeChannelsOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,tmp_txid,srcpub,destpub,param1,param2,param3)!=0 && (tmp_txid==channeltxid || tx.GetHash()==channeltxid))
+                        txs.push_back(tx);               
+            }
         }
         std::vector<CTransaction> tmp_txs;
         myGet_mempool_txs(tmp_txs,EVAL_CHANNELS,'P');
@@ -769,17 +793,14 @@ UniValue ChannelsInfo(const CPubKey& pk,uint256 channeltxid)
                 }
                 else if (DecodeChannelsOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,opentxid,srcpub,destpub,param1,param2,param3) == 'P' && opentxid==channeltxid)
                 {
-                    if (myGetTransaction(opentxid,opentx,hashBlock) != 0 && (numvouts=opentx.vout.size()) > 0 &&
-                            DecodeChannelsOpRet(opentx.vout[numvouts-1].scriptPubKey,tokenid,tmp_txid,srcpub,destpub,numpayments,payment,hashchain) == 'O')
-                    {
-                        Getscriptaddress(str,tx.vout[3].scriptPubKey);  
-                        obj.push_back(Pair("Payment",tx.GetHash().GetHex().data()));
-                        obj.push_back(Pair("Number of payments",param2));
-                        obj.push_back(Pair("Amount",param2*payment));
-                        obj.push_back(Pair("Destination",str));
-                        obj.push_back(Pair("Secret",param3.ToString().c_str()));
-                        obj.push_back(Pair("Payments left",param1));
-                    }
+                    // the payment size is from the open tx decoded above
+                    Getscriptaddress(str,tx.vout[3].scriptPubKey);  
+                    obj.push_back(Pair("Payment",tx.GetHash().GetHex().data()));
+                    obj.push_back(Pair("Number of payments",param2));
+                    obj.push_back(Pair("Amount",param2*payment));
+                    obj.push_back(Pair("Destination",str));
+                    obj.push_back(Pair("Secret",param3.ToString().c_str()));
+                    obj.push_back(Pair("Payments left",param1));
                 }
                 else if (DecodeChannelsOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,opentxid,srcpub,destpub,param1,param2,param3) == 'C' && opentxid==channeltxid)
                 {
@@ -14,6 +14,7 @@
  ******************************************************************************/
 
 #include "CCdice.h"
+#include "CCdicebook.h"
 
 // timeout
 
@@ -1047,80 +1048,83 @@ bool DiceValidate(struct CCcontract_info *cp,Eval *eval,const CTransaction &tx,
     return(true);
 }
 
-uint64_t AddDiceInputs(struct CCcontract_info *cp,CMutableTransaction &mtx,CPubKey pk,uint64_t total,int32_t maxinputs,uint64_t refsbits,uint256 reffundingtxid)
+// the confirmed vout0 utxos of a plan by txid, from the dice book or the dice address
+static void DicePlanUtxos(std::vector<DiceBookUtxo> &utxos,struct CCcontract_info *cp,CPubKey pk,uint256 reffundingtxid,const CScript &fundingPubKey)
 {
-    char coinaddr[64],str[65]; uint64_t threshold,sbits,nValue,totalinputs = 0; uint256 txid,hash,proof,hashBlock,fundingtxid; CTransaction tx; int32_t j,vout,n = 0; uint8_t funcid;
+    char coinaddr[64]; uint256 hashBlock; CTransaction tx;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
     GetCCaddress(cp,coinaddr,pk);
+    if ( strcmp(coinaddr,cp->unspendableCCaddr) == 0 && DiceBookGetUtxos(reffundingtxid,utxos) != 0 )
+        return;
     SetCCunspents(unspentOutputs,coinaddr,true);
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    {
+        DiceBookUtxo utxo;
+        if ( it->first.index != 0 || myGetTransaction(it->first.txhash,tx,hashBlock) == 0 )
+            continue;
+        if ( DiceBookDecode(tx,fundingPubKey,utxo) != 0 && utxo.fundingtxid == reffundingtxid )
+            utxos.push_back(utxo);
+    }
+}
+
+uint64_t AddDiceInputs(struct CCcontract_info *cp,CMutableTransaction &mtx,CPubKey pk,uint64_t total,int32_t maxinputs,uint64_t refsbits,uint256 reffundingtxid)
+{
+    char str[65],sstr[16]; uint64_t threshold,totalinputs = 0; int32_t j,n = 0;
+    std::vector<DiceBookUtxo> utxos;
+    // the funding pubkey is only needed for the entropy flag, which is not used here
+    DicePlanUtxos(utxos,cp,pk,reffundingtxid,CScript());
     if ( maxinputs > CC_MAXVINS )
         maxinputs = CC_MAXVINS;
     if ( maxinputs > 0 )
         threshold = total / maxinputs;
     else threshold = total;
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    for (const DiceBookUtxo &utxo : utxos)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        if ( vout != 0 || it->second.satoshis < threshold )
+        if ( utxo.nValue < threshold )
+            continue;
+        if ( utxo.funcid != 'R' && utxo.funcid != 'F' && utxo.funcid != 'E' && utxo.funcid != 'W' && utxo.funcid != 'L' && utxo.funcid != 'T' )
             continue;
-        //fprintf(stderr,"(%s) %s/v%d %.8f\n",coinaddr,uint256_str(str,txid),vout,(double)it->second.satoshis/COIN);
         for (j=0; j<mtx.vin.size(); j++)
-            if ( txid == mtx.vin[j].prevout.hash && vout == mtx.vin[j].prevout.n )
+            if ( utxo.txid == mtx.vin[j].prevout.hash && mtx.vin[j].prevout.n == 0 )
                 break;
         if ( j != mtx.vin.size() )
             continue;
-        if ( myGetTransaction(txid,tx,hashBlock) != 0 && tx.vout.size() > 0 && tx.vout[vout].scriptPubKey.IsPayToCryptoCondition() != 0 && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 )
+        if ( myIsutxo_spentinmempool(ignoretxid,ignorevin,utxo.txid,0) != 0 )
+            continue;
+        if ( total != 0 && maxinputs != 0 )
         {
-            if ( (funcid= DecodeDiceOpRet(txid,tx.vout[tx.vout.size()-1].scriptPubKey,sbits,fundingtxid,hash,proof)) != 0 )
+            if ( utxo.funcid == 'R' )
             {
-                char str[65],sstr[16];
-                unstringbits(sstr,sbits);
-                if ( sbits == refsbits && (funcid == 'F' && reffundingtxid == txid) || reffundingtxid == fundingtxid )
-                {
-                    if ( funcid == 'R' || funcid == 'F' || funcid == 'E' || funcid == 'W' || funcid == 'L' || funcid == 'T' )
-                    {
-                        if ( total != 0 && maxinputs != 0 )
-                        {
-                            if ( funcid == 'R' )
-                                fprintf(stderr,">>>>>>>>>>>> use (%c) %.8f %s %s/v%d\n",funcid,(double)tx.vout[0].nValue/COIN,sstr,uint256_str(str,txid),vout);
-                            mtx.vin.push_back(CTxIn(txid,vout,CScript()));
-                        }
-                        totalinputs += it->second.satoshis;
-                        n++;
-                        if ( (total > 0 && totalinputs >= total) || (maxinputs > 0 && n >= maxinputs) )
-                            break;
-                    }
-                }
-            } else fprintf(stderr,"null funcid\n");
+                unstringbits(sstr,utxo.sbits);
+                fprintf(stderr,">>>>>>>>>>>> use (%c) %.8f %s %s/v%d\n",utxo.funcid,(double)utxo.nValue/COIN,sstr,uint256_str(str,utxo.txid),0);
+            }
+            mtx.vin.push_back(CTxIn(utxo.txid,0,CScript()));
         }
+        totalinputs += utxo.nValue;
+        n++;
+        if ( (total > 0 && totalinputs >= total) || (maxinputs > 0 && n >= maxinputs) )
+            break;
     }
     return(totalinputs);
 }
 
 int64_t DicePlanFunds(uint64_t &entropyval,uint256 &entropytxid,uint64_t refsbits,struct CCcontract_info *cp,CPubKey dicepk,uint256 reffundingtxid, int32_t &entropytxs,bool random)
 {
-    char coinaddr[64],str[65]; uint64_t sbits; int64_t nValue,sum,totalinputs = 0; uint256 hash,txid,proof,hashBlock,fundingtxid; CScript fundingPubKey; CTransaction tx,vinTx; int32_t vout,first=0,n=0,i=0,pendingbets=0; uint8_t funcid;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    char str[65]; int64_t sum = 0,totalinputs = 0; uint256 hashBlock; CScript fundingPubKey; CTransaction tx; int32_t first=0,n=0,pendingbets=0; uint8_t funcid;
+    std::vector<DiceBookUtxo> utxos;
     entropyval = 0;
     entropytxid = zeroid;
     if ( myGetTransaction(reffundingtxid,tx,hashBlock) != 0 && tx.vout.size() > 1 && ConstrainVout(tx.vout[0],1,cp->unspendableCCaddr,0) != 0 )
     {
         fundingPubKey = tx.vout[1].scriptPubKey;
     } else return(0);
-    GetCCaddress(cp,coinaddr,dicepk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    entropyval = 0;
+    DicePlanUtxos(utxos,cp,dicepk,reffundingtxid,fundingPubKey);
     int loops = 0;
-    int numtxs = unspentOutputs.size()/2;
+    int numtxs = utxos.size();
     int startfrom = rand() % (numtxs+1);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    for (const DiceBookUtxo &utxo : utxos)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        if ( vout != 0 )
-            continue;
-        sum += it->second.satoshis;
+        sum += utxo.nValue;
         loops++;
         if (random) {
             if ( loops < startfrom )
@@ -1128,86 +1132,30 @@ int64_t DicePlanFunds(uint64_t &entropyval,uint256 &entropytxid,uint64_t refsbit
             if ( (rand() % 100) < 90 )
                 continue;
         }
-        if ( myGetTransaction(txid,tx,hashBlock) != 0 && tx.vout[vout].scriptPubKey.IsPayToCryptoCondition() != 0 )
+        if ( utxo.sbits != refsbits )
+            continue;
+        if ( (funcid= utxo.funcid) == 'B' )
         {
-            if ( (funcid= DecodeDiceOpRet(txid,tx.vout[tx.vout.size()-1].scriptPubKey,sbits,fundingtxid,hash,proof)) != 0 && sbits == refsbits )
+            pendingbets++;
+            fprintf(stderr,"%d: %s/v%d (%c %.8f) %.8f %.8f\n",n,uint256_str(str,utxo.txid),0,funcid,(double)utxo.nValue/COIN,(double)totalinputs/COIN,(double)sum/COIN);
+            continue;
+        }
+        if ( utxo.nValue >= 10000 && (funcid == 'R' || funcid == 'F' || funcid == 'E' || funcid == 'W' || funcid == 'L' || funcid == 'T') )
+        {
+            if ( funcid == 'L' || funcid == 'W' || funcid == 'E' )
+                n++;
+            totalinputs += utxo.nValue;
+            // the entropy checks against the funding pubkey were done by DiceBookDecode
+            if ( first == 0 && utxo.fEntropy && myIsutxo_spentinmempool(ignoretxid,ignorevin,utxo.txid,0) == 0 )
             {
-                if ( funcid == 'B' )
-                {
-                    pendingbets++;
-                    fprintf(stderr,"%d: %s/v%d (%c %.8f) %.8f %.8f\n",n,uint256_str(str,txid),vout,funcid,(double)it->second.satoshis/COIN,(double)totalinputs/COIN,(double)sum/COIN);
+                entropytxid = utxo.txid;
+                entropyval = utxo.nValue;
+                first = 1;
+                if (random) {
+                    fprintf(stderr, "chosen entropy on loop: %d\n",loops);
                 }
-                if ( (funcid == 'F' && reffundingtxid == txid) || reffundingtxid == fundingtxid )
-                {
-                    //fprintf(stderr,"%d: %s/v%d (%c %.8f) %.8f %.8f\n",n,uint256_str(str,txid),vout,funcid,(double)it->second.satoshis/COIN,(double)totalinputs/COIN,(double)sum/COIN);
-                    if ( (nValue= IsDicevout(cp,tx,vout,refsbits,reffundingtxid)) >= 10000 && (funcid == 'R' || funcid == 'F' || funcid == 'E' || funcid == 'W' || funcid == 'L' || funcid == 'T')  )
-                    {
-                        if ( funcid == 'L' || funcid == 'W' || funcid == 'E' )
-                            n++;
-                        totalinputs += nValue;
-                        if ( first == 0 && (funcid == 'E' || funcid == 'W' || funcid == 'L') )
-                        {
-                            //fprintf(stderr,"check first\n");
-                            if ( tx.vout.size() > 1 && fundingPubKey == tx.vout[1].scriptPubKey )
-                            {
-                                if ( myGetTransaction(tx.vin[0].prevout.hash,vinTx,hashBlock) == 0 || (int32_t)tx.vin[0].prevout.n < 0 )
-                                {
-                                    fprintf(stderr,"cant find entropy vin0 %s or vin0prev %d vouts[%d], iscoinbase.%d\n",uint256_str(str,tx.vin[0].prevout.hash),(int32_t)tx.vin[0].prevout.n,(int32_t)vinTx.vout.size(),(int32_t)vinTx.vin.size());
-                                    continue;
-                                }
-                                if ( (int32_t)vinTx.vin[0].prevout.n < 0 || vinTx.vout.size() < 2 )
-                                {
-                                    fprintf(stderr,"skip coinbase or strange entropy tx\n");
-                                    continue;
-                                }
-                                //if ( fundingtxid != tx.vin[0].prevout.hash && vinTx.vout[tx.vin[0].prevout.n].scriptPubKey != fundingPubKey )
-                                if ( fundingtxid != tx.vin[0].prevout.hash && vinTx.vout[1].scriptPubKey != fundingPubKey )
-                                {
-                                    uint8_t *ptr0,*ptr1; int32_t i; char str[65],addr0[64],addr1[64];
-                                    Getscriptaddress(addr0,vinTx.vout[1].scriptPubKey);
-                                    Getscriptaddress(addr1,fundingPubKey);
-                                    if ( strcmp(addr0,addr1) != 0 )
-                                    {
-                                        ptr0 = (uint8_t *)&vinTx.vout[1].scriptPubKey[0];
-                                        ptr1 = (uint8_t *)&fundingPubKey[0];
-                                        for (i=0; i<vinTx.vout[1].scriptPubKey.size(); i++)
-                                            fprintf(stderr,"%02x",ptr0[i]);
-                                        fprintf(stderr," script vs ");
-                                        for (i=0; i<fundingPubKey.size(); i++)
-                                            fprintf(stderr,"%02x",ptr1[i]);
-                                        fprintf(stderr," (%c) entropy vin.%d fundingPubKey mismatch %s %s vs %s\n",funcid,1,uint256_str(str,tx.vin[0].prevout.hash),addr0,addr1);
-                                        continue;
-                                    }
-                                }
-                                if ( myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 )
-                                {
-                                    entropytxid = txid;
-                                    entropyval = tx.vout[0].nValue;
-                                    //fprintf(stderr,"funcid.%c first.%d entropytxid.%s val %.8f\n",funcid,first,txid.GetHex().c_str(),(double)entropyval/COIN);
-                                    first = 1;
-                                    if (random) {
-                                        fprintf(stderr, "chosen entropy on loop: %d\n",loops);
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                uint8_t *ptr0,*ptr1; int32_t i; char str[65];
-                                const CScript &s0 = tx.vout[1].scriptPubKey;
-                                for (i=0; i<tx.vout[1].scriptPubKey.size(); i++)
-                                    fprintf(stderr,"%02x",s0[i]);
-                                fprintf(stderr," script vs ");
-                                for (i=0; i<fundingPubKey.size(); i++)
-                                    fprintf(stderr,"%02x",fundingPubKey[i]);
-                                fprintf(stderr," (%c) tx vin.%d fundingPubKey mismatch %s\n",funcid,tx.vin[0].prevout.n,uint256_str(str,tx.vin[0].prevout.hash));
-                            }
-                        }
-                    }
-                    else if ( 0 && funcid != 'B' )
-                        fprintf(stderr,"%s %c refsbits.%llx sbits.%llx nValue %.8f\n",uint256_str(str,txid),funcid,(long long)refsbits,(long long)sbits,(double)nValue/COIN);
-                } //else fprintf(stderr,"else case funcid (%c) %d %s vs %s\n",funcid,funcid,uint256_str(str,reffundingtxid),uint256_str(str2,fundingtxid));
-            } //else fprintf(stderr,"funcid.%d %c skipped %.8f\n",funcid,funcid,(double)tx.vout[vout].nValue/COIN);
-        } i = i + 1;
+            }
+        }
     }
     if (!random) {
         fprintf(stderr,"pendingbets.%d numentropy tx %d: %.8f\n",pendingbets,n,(double)totalinputs/COIN);
@@ -1216,9 +1164,6 @@ int64_t DicePlanFunds(uint64_t &entropyval,uint256 &entropytxid,uint64_t refsbit
     } else {
         return(0);
     }
-    //fprintf(stderr,"numentropy tx %d: %.8f\n",n,(double)totalinputs/COIN);
-    entropytxs = n;
-    return(totalinputs);
 }
 
 bool DicePlanExists(CScript &fundingPubKey,uint256 &fundingtxid,struct CCcontract_info *cp,uint64_t refsbits,CPubKey dicepk,int64_t &minbet,int64_t &maxbet,int64_t &maxodds,int64_t &timeoutblocks)
@@ -1773,15 +1718,27 @@ double DiceStatus(uint64_t txfee,char *planstr,uint256 fundingtxid,uint256 bettx
             fprintf(stderr,"%s\n", CCerror.get_msg() );
             return(0.);
         }
-        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
-        SetCCunspents(unspentOutputs,coinaddr,true);
-        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+        // the pending bets from the dice book, txid and vout0 value
+        std::vector<std::pair<uint256, CAmount> > bets;
+        std::vector<DiceBookUtxo> bookbets;
+        if ( DiceBookGetBets(refsbits,bookbets) != 0 )
         {
-            txid = it->first.txhash;
-            vout = (int32_t)it->first.index;
-            if ( vout != 0 )
-                continue;
-            sum += it->second.satoshis;
+            for (const DiceBookUtxo &bet : bookbets)
+                bets.push_back(std::make_pair(bet.txid,bet.nValue));
+        }
+        else
+        {
+            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+            SetCCunspents(unspentOutputs,coinaddr,true);
+            for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+                if ( it->first.index == 0 )
+                    bets.push_back(std::make_pair(it->first.txhash,(CAmount)it->second.satoshis));
+        }
+        for (std::vector<std::pair<uint256, CAmount> >::const_iterator it=bets.begin(); it!=bets.end(); it++)
+        {
+            txid = it->first;
+            vout = 0;
+            sum += it->second;
             if ( myGetTransaction(txid,betTx,hashBlock) != 0 && betTx.vout.size() >= 4 && betTx.vout[vout].scriptPubKey.IsPayToCryptoCondition() != 0 )
             {
                 if ( DecodeDiceOpRet(txid,betTx.vout[betTx.vout.size()-1].scriptPubKey,sbits,fundingtxid,hash,proof) == 'B' && sbits == refsbits )
@@ -1804,7 +1761,7 @@ double DiceStatus(uint64_t txfee,char *planstr,uint256 fundingtxid,uint256 bettx
                         }
                         if ( scriptPubKey != fundingPubKey )
                         {
-                            fprintf(stderr,"serialized bettxid %d: iswin.%d W.%d L.%d %s/v%d (%c %.8f) %.8f\n",n,iswin,win,loss,txid.GetHex().c_str(),vout,funcid,(double)it->second.satoshis/COIN,(double)sum/COIN);
+                            fprintf(stderr,"serialized bettxid %d: iswin.%d W.%d L.%d %s/v%d (%c %.8f) %.8f\n",n,iswin,win,loss,txid.GetHex().c_str(),vout,funcid,(double)it->second/COIN,(double)sum/COIN);
                             res = DiceBetFinish(funcid,entropyused,entropyvout,&result,txfee,planstr,fundingtxid,txid,scriptPubKey == fundingPubKey,zeroid,-1);
                             if ( result > 0 )
                             {
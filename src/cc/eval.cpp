@@ -22,10 +22,12 @@
 #include "cc/eval.h"
 #include "cc/utils.h"
 #include "cc/CCinclude.h"
+#include "cc/CCstats.h"
 #include "main.h"
 #include "chain.h"
 #include "core_io.h"
 #include "crosschain.h"
+#include "metrics.h"
 
 bool CClib_Dispatch(const CC *cond,Eval *eval,std::vector<uint8_t> paramsNull,const CTransaction &txTo,unsigned int nIn, std::shared_ptr<CCheckCCEvalCodes> evalcodeChecker);
 char *CClib_name();
@@ -39,9 +41,31 @@ bool RunCCEval(const CC *cond, const CTransaction &tx, unsigned int nIn, int64_t
     EvalRef eval;
     eval->SetCurrentTime(nTime);
     eval->SetCurrentHeight(nHeight);
-    pthread_mutex_lock(&KOMODO_CC_mutex);
+    // in parallel mode each script-check job has its own eval and CCcontract_info,
+    // cclib modules keep their own globals so they are always serialised
+    bool fSerialise = !fParallelCCEval || EVAL_TEST != 0 ||
+        (cond->codeLength > 0 && cond->code[0] >= EVAL_FIRSTUSER && cond->code[0] <= EVAL_LASTUSER);
+    if (fSerialise)
+        pthread_mutex_lock(&KOMODO_CC_mutex);
+    static CMetricsHistogram& histBlock = GetMetricsHistogram("komodo_cc_eval_seconds",
+        "Time a CC input validation took, in a block or for the mempool", "context=\"block\"");
+    static CMetricsHistogram& histMempool = GetMetricsHistogram("komodo_cc_eval_seconds",
+        "Time a CC input validation took, in a block or for the mempool", "context=\"mempool\"");
+    bool fStats = CCStatsEnabled();
+    bool fMempool = (KOMODO_CONNECTING & (1 << 30)) != 0;
+    int64_t nTimeStart = GetTimeMicros();
+    uint64_t nTxFetches = CCStatsThreadTxFetches(), nDBLookups = CCStatsThreadDBLookups();
     bool out = eval->Dispatch(cond, tx, nIn, evalcodeChecker);
-    pthread_mutex_unlock(&KOMODO_CC_mutex);
+    int64_t nTimeEval = GetTimeMicros() - nTimeStart;
+    (fMempool ? histMempool : histBlock).Observe(nTimeEval);
+    if (fStats)
+    {
+        uint8_t evalcode = cond->codeLength > 0 ? cond->code[0] : 0;
+        CCStatsRecord(evalcode, CCStatsFuncid(tx, evalcode), fMempool, out, nTimeEval,
+            CCStatsThreadTxFetches() - nTxFetches, CCStatsThreadDBLookups() - nDBLookups);
+    }
+    if (fSerialise)
+        pthread_mutex_unlock(&KOMODO_CC_mutex);
     if ( eval->state.IsValid() != out)
         fprintf(stderr,"out %d vs %d isValid\n",(int32_t)out,(int32_t)eval->state.IsValid());
     //assert(eval->state.IsValid() == out);
@@ -49,7 +73,7 @@ bool RunCCEval(const CC *cond, const CTransaction &tx, unsigned int nIn, int64_t
     if (eval->state.IsValid()) return true;
 
     if (evalcodeChecker != nullptr)
-        evalcodeChecker->lastEvalErrorState = eval->state;
+        evalcodeChecker->SetLastEvalErrorState(eval->state);
 
     // report cc error:
     std::string lvl = eval->state.IsInvalid() ? "Invalid" : "Error!";
@@ -101,11 +125,17 @@ bool Eval::Dispatch(const CC *cond, const CTransaction &txTo, unsigned int nIn,s
             return CClib_Dispatch(cond,this,vparams,txTo,nIn,evalcodeChecker);
         else return Invalid("mismatched -ac_cclib vs CClib_name");
     }
-    cp = &CCinfos[(int32_t)ecode];
-    if ( cp->didinit == 0 )
+    struct CCcontract_info C;
+    if ( fParallelCCEval )
+        cp = CCinit(&C,ecode); // private copy, validators use cp as scratch space
+    else
     {
-        CCinit(cp,ecode);
-        cp->didinit = 1;
+        cp = &CCinfos[(int32_t)ecode];
+        if ( cp->didinit == 0 )
+        {
+            CCinit(cp,ecode);
+            cp->didinit = 1;
+        }
     }
 
     if (GetCurrentHeight() <= 0)
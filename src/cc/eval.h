@@ -319,6 +319,10 @@ class CCheckCCEvalCodes
     boost::mutex mutex_eval;
 
 public:
+    CCheckCCEvalCodes() : fStoreEvalResults(false) {}
+    //! Tip context used for the CC eval results cache, null disables the cache
+    CCheckCCEvalCodes(const uint256 &hashPrevBlockIn, bool fStoreEvalResultsIn) : hashPrevBlock(hashPrevBlockIn), fStoreEvalResults(fStoreEvalResultsIn) {}
+
     void MarkEvalCode(uint256 txid, uint8_t ecode)
     {
         boost::unique_lock<boost::mutex> lock(mutex_eval);
@@ -337,7 +341,16 @@ public:
         auto search = evalcodes.find(txid);
         return search == evalcodes.end() ? false : (search->second.find(ecode) != search->second.end());
     }
+
+    //! Script-check threads may fail concurrently, keep the error state consistent
+    void SetLastEvalErrorState(const CValidationState &state)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_eval);
+        lastEvalErrorState = state;
+    }
     CValidationState lastEvalErrorState;  // store last eval error aborting the validation process
+    const uint256 hashPrevBlock;          // block the tx is validated on top of
+    const bool fStoreEvalResults;         // store positive eval results in the CC eval cache (mempool acceptance)
 };
 
 
@@ -171,6 +171,25 @@ int32_t games_replay2(uint8_t *newdata,uint64_t seed,gamesevent *keystrokes,int3
 #else
 #include "games/tetris.cpp"
 #endif
+#include "CCreplaycache.h"
+
+static CCReplayCache gamesReplays(256);
+
+// games_replay2 without display, the same keystrokes of a game are only replayed once
+int32_t games_replay2cached(uint8_t *newdata,uint64_t seed,gamesevent *keystrokes,int32_t num,struct games_player *player)
+{
+    std::vector<uint8_t> result; uint256 key; int32_t n;
+    key = CCReplayCache::Key(seed,keystrokes,num * sizeof(*keystrokes),player,player != 0 ? sizeof(*player) : 0);
+    if ( gamesReplays.Get(key,result) == false )
+    {
+        if ( (n= games_replay2(newdata,seed,keystrokes,num,player,0)) > 0 )
+            result.assign(newdata,newdata+n);
+        gamesReplays.Put(key,result);
+    }
+    else if ( result.size() > 0 )
+        memcpy(newdata,result.data(),result.size());
+    return((int32_t)result.size());
+}
 
 void GAMEJSON(UniValue &obj,struct games_player *P);
 
@@ -1392,7 +1411,7 @@ gamesevent *games_extractgame(int32_t makefiles,char *str,int32_t *numkeysp,std:
                         fclose(fp);
                     }
                 }
-                num = games_replay2(newplayer,seed,keystrokes,numkeys,playerdata.size()==0?0:&P,0);
+                num = games_replay2cached(newplayer,seed,keystrokes,numkeys,playerdata.size()==0?0:&P);
                 newdata.resize(num);
                 for (i=0; i<num; i++)
                 {
@@ -1546,7 +1565,7 @@ UniValue games_finish(uint64_t txfee,struct CCcontract_info *cp,cJSON *params,ch
                     }
                     if ( keystrokes != 0 )
                     {
-                        num = games_replay2(player,seed,keystrokes,numkeys,playerdata.size()==0?0:&P,0);
+                        num = games_replay2cached(player,seed,keystrokes,numkeys,playerdata.size()==0?0:&P);
                         if ( keystrokes != 0 )
                             free(keystrokes), keystrokes = 0;
                     } else num = 0;
@@ -16,7 +16,9 @@
 #include "CCtokens.h"
 #include "CCtokens_impl.h"
 #include "CCGateways.h"
+#include "CCgatewaysindex.h"
 #include "key_io.h"
+#include "txdb.h"
 
 /*
  prevent duplicate bindtxid via mempool scan
@@ -1219,6 +1221,138 @@ UniValue GatewaysMarkDone(const CPubKey& pk, uint64_t txfee,uint256 completetxid
     CCERR_RESULT("gatewayscc",CCLOG_INFO, stream << "error adding funds for markdone");
 }
 
+// Decodes a withdraw ('W'), partial signing ('P'), complete signing ('S') or markdone ('M') tx for the gateways index,
+// with the bind txid of its withdraw. The withdraw tx is looked up in blocktxs first.
+static bool DecodeGatewaysIndexTx(const CTransaction &tx, const std::map<uint256, const CTransaction*> &blocktxs, uint256 &bindtxid, CGatewaysMarker &marker)
+{
+    CTransaction withdrawtx; const CTransaction *pwithdrawtx = &tx; uint256 hashBlock,tokenid,completetxid; std::string coin,hex;
+    CPubKey withdrawpub,signerpk; int64_t amount; uint8_t K;
+
+    if (tx.vout.size() == 0)
+        return false;
+    const CScript &opret = tx.vout.back().scriptPubKey;
+    switch (marker.funcid = DecodeGatewaysOpRet(opret))
+    {
+        case 'W':
+            marker.withdrawtxid = tx.GetHash();
+            break;
+        case 'P':
+            if (DecodeGatewaysPartialOpRet(opret,marker.withdrawtxid,coin,K,signerpk,hex) != 'P')
+                return false;
+            break;
+        case 'S':
+            if (DecodeGatewaysCompleteSigningOpRet(opret,marker.withdrawtxid,coin,K,hex) != 'S')
+                return false;
+            break;
+        case 'M':
+            if (DecodeGatewaysMarkDoneOpRet(opret,marker.withdrawtxid,coin,completetxid) != 'M')
+                return false;
+            break;
+        default:
+            return false;
+    }
+    if (marker.funcid != 'W')
+    {
+        std::map<uint256, const CTransaction*>::const_iterator it = blocktxs.find(marker.withdrawtxid);
+        if (it != blocktxs.end())
+            pwithdrawtx = it->second;
+        else if (myGetTransaction(marker.withdrawtxid,withdrawtx,hashBlock) != 0)
+            pwithdrawtx = &withdrawtx;
+        else
+            return false;
+    }
+    return (pwithdrawtx->vout.size() > 0 &&
+        DecodeGatewaysWithdrawOpRet(pwithdrawtx->vout.back().scriptPubKey,tokenid,bindtxid,coin,withdrawpub,amount) == 'W');
+}
+
+// Returns true if vout0 of a decoded gateways index tx is a withdraw marker on the gateways address.
+static bool IsGatewaysIndexMarker(const CTransaction &tx, const CGatewaysMarker &marker, const char *gatewaysaddr)
+{
+    char destaddr[KOMODO_ADDRESS_BUFSIZE];
+
+    return (marker.funcid != 'M' && tx.vout[0].nValue == CC_MARKER_VALUE && tx.vout[0].scriptPubKey.IsPayToCryptoCondition() &&
+        Getscriptaddress(destaddr,tx.vout[0].scriptPubKey) && strcmp(destaddr,gatewaysaddr) == 0);
+}
+
+static void GatewaysIndexBlockTxs(const CBlock &block, std::map<uint256, const CTransaction*> &blocktxs, char *gatewaysaddr)
+{
+    struct CCcontract_info *cp,C;
+
+    cp = CCinit(&C,EVAL_GATEWAYS);
+    _GetCCaddress(gatewaysaddr,EVAL_GATEWAYS,GetUnspendable(cp,0));
+    for (const CTransaction &tx : block.vtx)
+        blocktxs[tx.GetHash()] = &tx;
+}
+
+bool GatewaysIndexConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+    std::map<uint256, const CTransaction*> blocktxs; std::map<uint256, std::pair<CGatewaysMarkerKey, CGatewaysMarker> > added;
+    std::vector<std::pair<CGatewaysMarkerKey, CGatewaysMarker> > markers; std::vector<CGatewaysMarkerKey> spent;
+    char gatewaysaddr[KOMODO_ADDRESS_BUFSIZE];
+
+    GatewaysIndexBlockTxs(block, blocktxs, gatewaysaddr);
+    for (const CTransaction &tx : block.vtx)
+    {
+        uint256 bindtxid; CGatewaysMarker marker;
+        if (!DecodeGatewaysIndexTx(tx, blocktxs, bindtxid, marker))
+            continue;
+        // the markers are spent from vout0 by the next tx of the same withdraw
+        for (const CTxIn &vin : tx.vin)
+            if (vin.prevout.n == 0 && added.erase(vin.prevout.hash) == 0)
+                spent.push_back(CGatewaysMarkerKey(bindtxid, vin.prevout.hash));
+        if (IsGatewaysIndexMarker(tx, marker, gatewaysaddr))
+            added[tx.GetHash()] = std::make_pair(CGatewaysMarkerKey(bindtxid, tx.GetHash()), marker);
+    }
+    if (added.empty() && spent.empty())
+        return true;
+    for (const auto &marker : added)
+        markers.push_back(marker.second);
+    return pblocktree->UpdateGatewaysMarkers(markers, spent);
+}
+
+bool GatewaysIndexDisconnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+    std::map<uint256, const CTransaction*> blocktxs; std::vector<std::pair<CGatewaysMarkerKey, CGatewaysMarker> > restored;
+    std::vector<CGatewaysMarkerKey> erased; char gatewaysaddr[KOMODO_ADDRESS_BUFSIZE];
+
+    GatewaysIndexBlockTxs(block, blocktxs, gatewaysaddr);
+    for (const CTransaction &tx : block.vtx)
+    {
+        uint256 bindtxid; CGatewaysMarker marker;
+        if (!DecodeGatewaysIndexTx(tx, blocktxs, bindtxid, marker))
+            continue;
+        if (IsGatewaysIndexMarker(tx, marker, gatewaysaddr))
+            erased.push_back(CGatewaysMarkerKey(bindtxid, tx.GetHash()));
+        // restore the markers of the previous blocks spent by this block
+        for (const CTxIn &vin : tx.vin)
+        {
+            CTransaction prevtx; uint256 hashBlock, prevbindtxid; CGatewaysMarker prevmarker;
+            if (vin.prevout.n != 0 || blocktxs.count(vin.prevout.hash) != 0 || myGetTransaction(vin.prevout.hash,prevtx,hashBlock) == 0)
+                continue;
+            if (DecodeGatewaysIndexTx(prevtx, blocktxs, prevbindtxid, prevmarker) && prevbindtxid == bindtxid && IsGatewaysIndexMarker(prevtx, prevmarker, gatewaysaddr))
+                restored.push_back(std::make_pair(CGatewaysMarkerKey(bindtxid, vin.prevout.hash), prevmarker));
+        }
+    }
+    if (restored.empty() && erased.empty())
+        return true;
+    return pblocktree->UpdateGatewaysMarkers(restored, erased);
+}
+
+// Gets the unspent markers of the withdraws of bindtxid on the gateways address, from the gateways index if it is enabled.
+static void SetGatewaysMarkerUnspents(std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs, char *coinaddr, uint256 bindtxid)
+{
+    std::vector<std::pair<CGatewaysMarkerKey, CGatewaysMarker> > markers;
+
+    if (fGatewaysIndex && pblocktree->ReadGatewaysMarkers(bindtxid, markers))
+    {
+        // the index is sorted by txid within a bind, as the address unspent index within an address
+        for (const auto &marker : markers)
+            unspentOutputs.push_back(std::make_pair(CAddressUnspentKey(3 /* cc */, uint160(), marker.first.txid, 0), CAddressUnspentValue(CC_MARKER_VALUE, CScript(), 0)));
+        return;
+    }
+    SetCCunspents(unspentOutputs,coinaddr,true);
+}
+
 UniValue GatewaysPendingDeposits(const CPubKey& pk, uint256 bindtxid,std::string refcoin)
 {
     UniValue result(UniValue::VOBJ),pending(UniValue::VARR); CTransaction tx; std::string coin,hex,pub; 
@@ -1307,7 +1441,7 @@ UniValue GatewaysPendingWithdraws(const CPubKey& pk, uint256 bindtxid,std::strin
             queueflag = 1;
             break;
         }    
-    SetCCunspents(unspentOutputs,coinaddr,true);
+    SetGatewaysMarkerUnspents(unspentOutputs,coinaddr,bindtxid);
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
     {
         txid = it->first.txhash;
@@ -1395,7 +1529,7 @@ UniValue GatewaysProcessedWithdraws(const CPubKey& pk, uint256 bindtxid,std::str
             queueflag = 1;
             break;
         }    
-    SetCCunspents(unspentOutputs,coinaddr,true);
+    SetGatewaysMarkerUnspents(unspentOutputs,coinaddr,bindtxid);
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
     {
         txid = it->first.txhash;
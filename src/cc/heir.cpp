@@ -15,6 +15,7 @@
 
 #include "CCHeir.h"
 #include "heir_validate.h"
+#include "CCheirbook.h"
 #include <iomanip>
 
 class CoinHelper;
@@ -1025,10 +1026,12 @@ UniValue HeirInfo(uint256 fundingtxid)
     CTransaction fundingtx;
     uint256 hashBlock;
     const bool allowSlow = false;
-    
+    HeirBookPlan plan;
+    // a confirmed plan is in the heir book, its state is not recomputed from the plan address
+    const bool fBook = HeirBookGetPlan(fundingtxid, plan);
     
     // get initial funding tx and set it as initial lasttx:
-    if (myGetTransaction(fundingtxid, fundingtx, hashBlock) && fundingtx.vout.size()) {
+    if (fBook || (myGetTransaction(fundingtxid, fundingtx, hashBlock) && fundingtx.vout.size())) {
         
         CPubKey ownerPubkey, heirPubkey;
         uint256 dummyTokenid, tokenid = zeroid;  // important to clear tokenid
@@ -1039,7 +1042,19 @@ UniValue HeirInfo(uint256 fundingtxid)
         
         uint8_t hasHeirSpendingBegun = 0;
         
-        uint256 latestFundingTxid = FindLatestFundingTx(fundingtxid, funcId, tokenid, ownerPubkey, heirPubkey, inactivityTimeSec, heirName, memo, hasHeirSpendingBegun);
+        uint256 latestFundingTxid;
+        if (fBook) {
+            tokenid = plan.tokenid;
+            ownerPubkey = plan.ownerPubkey;
+            heirPubkey = plan.heirPubkey;
+            inactivityTimeSec = plan.inactivityTimeSec;
+            heirName = plan.heirName;
+            memo = plan.memo;
+            hasHeirSpendingBegun = plan.hasHeirSpendingBegun;
+            latestFundingTxid = plan.latesttxid;
+        }
+        else
+            latestFundingTxid = FindLatestFundingTx(fundingtxid, funcId, tokenid, ownerPubkey, heirPubkey, inactivityTimeSec, heirName, memo, hasHeirSpendingBegun);
         
         if (latestFundingTxid != zeroid) {
             int32_t numblocks;
@@ -1079,7 +1094,9 @@ UniValue HeirInfo(uint256 fundingtxid)
                 cp = CCinit(&C, EVAL_TOKENS);
             
             int64_t total;
-            if (tokenid == zeroid)
+            if (fBook)
+                total = plan.lifetime;
+            else if (tokenid == zeroid)
                 total = LifetimeHeirContractFunds<CoinHelper>(cp, fundingtxid, ownerPubkey, heirPubkey);
             else
                 total = LifetimeHeirContractFunds<TokenHelper>(cp, fundingtxid, ownerPubkey, heirPubkey);
@@ -1107,7 +1124,9 @@ UniValue HeirInfo(uint256 fundingtxid)
             stream.clear();
             
             int64_t inputs;
-            if (tokenid == zeroid)
+            if (fBook)
+                inputs = plan.available;
+            else if (tokenid == zeroid)
                 inputs = Add1of2AddressInputs<CoinHelper>(cp, fundingtxid, mtx, ownerPubkey, heirPubkey, 0, 60); //NOTE: amount = 0 means all unspent inputs
             else
                 inputs = Add1of2AddressInputs<TokenHelper>(cp, fundingtxid, mtx, ownerPubkey, heirPubkey, 0, 60);
@@ -1182,6 +1201,14 @@ void _HeirList(struct CCcontract_info *cp, UniValue &result)
 {
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> unspentOutputs;
     char markeraddr[64];
+    std::vector<uint256> fundingtxids;
+
+    // the confirmed plans are listed by the heir book
+    if (HeirBookGetPlanIds(fundingtxids)) {
+        for (const uint256 &fundingtxid : fundingtxids)
+            result.push_back(fundingtxid.GetHex());
+        return;
+    }
 
 	GetCCaddress(cp, markeraddr, GetUnspendable(cp, NULL));
     SetCCunspents(unspentOutputs, markeraddr,true);
@@ -15,6 +15,7 @@
 
 #include "komodo_defs.h"
 #include "CCOracles.h"
+#include "CCoraclesindex.h"
 #include <secp256k1.h>
 
 /*
@@ -923,6 +924,20 @@ UniValue OracleDataSamples(uint256 reforacletxid, char* batonaddr, int32_t num)
                     }
                 }
             }
+            if (fOraclesIndex) {
+                std::vector<COraclesSample> samples;
+                if ((formatstr = (char*)format.c_str()) == NULL)
+                    formatstr = (char*)"";
+                OraclesIndexGetSamples(reforacletxid, batonaddr, 0, -1, num != 0 ? num - n : 0, samples);
+                for (const COraclesSample &sample : samples) {
+                    UniValue a(UniValue::VOBJ);
+                    a.push_back(Pair("txid", sample.txid.GetHex()));
+                    a.push_back(Pair("data", OracleFormat((uint8_t*)sample.data.data(), (int32_t)sample.data.size(), formatstr, (int32_t)format.size())));
+                    b.push_back(a);
+                }
+                result.push_back(Pair("samples", b));
+                return (result);
+            }
             SetCCtxids(txids, batonaddr, true, EVAL_ORACLES, CC_MARKER_VALUE, reforacletxid, 'D');
             if (txids.size() > 0) {
                 for (std::vector<uint256>::const_iterator it = txids.end() - 1; it != txids.begin(); it--) {
@@ -116,6 +116,39 @@ uint8_t DecodePaymentsTxidOpRet(CScript scriptPubKey,int64_t &allocation,std::ve
     return(0);
 }
 
+// decoded txidopret recipients, a txid always decodes to the same allocation so entries are never stale
+struct PaymentsTxidOpret { int64_t allocation; std::vector<uint8_t> scriptPubKey,opret; };
+static std::map<uint256,PaymentsTxidOpret> paymentsTxidOprets;
+static CCriticalSection cs_paymentstxidoprets;
+#define PAYMENTS_MAXTXIDOPRETS 10000
+
+// myGetTransaction and DecodePaymentsTxidOpRet of a txidopret, without reloading the tx of a plan recipient on every release
+uint8_t payments_txidopret(uint256 txid,int64_t &allocation,std::vector<uint8_t> &scriptPubKey,std::vector<uint8_t> &opret)
+{
+    CTransaction tx; uint256 hashBlock;
+    {
+        LOCK(cs_paymentstxidoprets);
+        std::map<uint256,PaymentsTxidOpret>::iterator it = paymentsTxidOprets.find(txid);
+        if ( it != paymentsTxidOprets.end() )
+        {
+            allocation = it->second.allocation;
+            scriptPubKey = it->second.scriptPubKey;
+            opret = it->second.opret;
+            return('T');
+        }
+    }
+    if ( myGetTransaction(txid,tx,hashBlock) == 0 || tx.vout.size() <= 1 || DecodePaymentsTxidOpRet(tx.vout[tx.vout.size()-1].scriptPubKey,allocation,scriptPubKey,opret) != 'T' )
+        return(0);
+    LOCK(cs_paymentstxidoprets);
+    if ( paymentsTxidOprets.size() >= PAYMENTS_MAXTXIDOPRETS )
+        paymentsTxidOprets.clear();
+    PaymentsTxidOpret &entry = paymentsTxidOprets[txid];
+    entry.allocation = allocation;
+    entry.scriptPubKey = scriptPubKey;
+    entry.opret = opret;
+    return('T');
+}
+
 CScript EncodePaymentsFundOpRet(uint256 checktxid)
 {
     CScript opret; uint8_t evalcode = EVAL_PAYMENTS;
@@ -374,8 +407,8 @@ bool PaymentsValidate(struct CCcontract_info *cp,Eval* eval,const CTransaction &
                     int64_t checkallocations = 0;
                     for ( auto txidopret : txidoprets)
                     {
-                        CTransaction tx0; std::vector<uint8_t> scriptPubKey,opret; int64_t allocation;
-                        if ( myGetTransaction(txidopret,tx0,blockhash) != 0 && tx0.vout.size() > 1 && DecodePaymentsTxidOpRet(tx0.vout[tx0.vout.size()-1].scriptPubKey,allocation,scriptPubKey,opret) == 'T' )
+                        std::vector<uint8_t> scriptPubKey,opret; int64_t allocation;
+                        if ( payments_txidopret(txidopret,allocation,scriptPubKey,opret) == 'T' )
                         {
                             scriptPubKeys.push_back(CScript(scriptPubKey.begin(), scriptPubKey.end()));
                             allocations.push_back(allocation);
@@ -760,7 +793,7 @@ UniValue PaymentsRelease(struct CCcontract_info *cp,char *jsonstr)
                     {
                         std::vector<uint8_t> scriptPubKey,opret;
                         vout.nValue = 0;
-                        if ( myGetTransaction(txidoprets[i],txO,hashBlock) != 0 && txO.vout.size() > 1 && DecodePaymentsTxidOpRet(txO.vout[txO.vout.size()-1].scriptPubKey,allocation,scriptPubKey,opret) == 'T' )
+                        if ( payments_txidopret(txidoprets[i],allocation,scriptPubKey,opret) == 'T' )
                         {
                             vout.nValue = allocation;
                             vout.scriptPubKey.resize(scriptPubKey.size());
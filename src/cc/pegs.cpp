@@ -17,6 +17,7 @@
 #include "CCtokens_impl.h"
 
 #include "CCPegs.h"
+#include "CCpegsbook.h"
 #include "../importcoin.h"
 #include "key_io.h"
 #include "komodo_defs.h"
@@ -561,20 +562,25 @@ int64_t PegsGetTokensAmountPerPrice(int64_t amount,uint256 tokenid)
     return (mpz_get_si(res));           
 }
 
-double PegsGetRatio(uint256 tokenid,std::pair<int64_t,int64_t> account)
+double PegsGetRatioAtPrice(int64_t price,std::pair<int64_t,int64_t> account)
 {      
     mpz_t res,a,b;
     mpz_init(res);
     mpz_init(a);
     mpz_init(b);
     mpz_set_si(a, account.first);
-    mpz_set_si(b, PegsGetTokenPrice(tokenid));
+    mpz_set_si(b, price);
     mpz_mul(res, a, b);
     mpz_set_si(a, COIN);
     mpz_tdiv_q(res, res, a);
     return ((double)account.second)*100/mpz_get_si(res);           
 }
 
+double PegsGetRatio(uint256 tokenid,std::pair<int64_t,int64_t> account)
+{      
+    return PegsGetRatioAtPrice(PegsGetTokenPrice(tokenid),account);
+}
+
 double PegsGetAccountRatio(uint256 pegstxid,uint256 tokenid,uint256 accounttxid)
 {
     int64_t amount; uint256 hashBlock,tmptokenid,tmppegstxid;
@@ -596,24 +602,41 @@ double PegsGetGlobalRatio(uint256 pegstxid)
     char coinaddr[64]; int64_t nValue,amount,globaldebt=0; uint256 txid,accounttxid,hashBlock,tmppegstxid,tokenid;
     CTransaction tx; int32_t numvouts,vout; char funcid; CPubKey mypk,pegspk,pk;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs; std::pair<int64_t,int64_t> account;
-    std::map<uint256,std::pair<int64_t,int64_t>> globalaccounts;
+    std::map<uint256,std::pair<int64_t,int64_t>> globalaccounts; std::vector<uint256> tokenids;
     struct CCcontract_info *cp,C;
 
     cp = CCinit(&C,EVAL_PEGS);
     pegspk = GetUnspendable(cp,0);
     GetCCaddress1of2(cp,coinaddr,pegspk,pegspk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    if (PegsBookGetTokens(pegstxid,tokenids))
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        if (vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
-            (funcid=DecodePegsOpRet(tx,tmppegstxid,tokenid))!=0 && pegstxid==tmppegstxid && (funcid=='F' || funcid=='G' || funcid=='E'))
-        {              
-            PegsDecodeAccountTx(tx,pk,amount,account);
-            globalaccounts[tokenid].first+=account.first;
-            globalaccounts[tokenid].second+=account.second;
+        for (std::vector<uint256>::const_iterator it=tokenids.begin(); it!=tokenids.end(); it++)
+        {
+            std::vector<PegsBookAccount> accounts;
+            PegsBookGetAccounts(pegstxid,*it,accounts);
+            for (std::vector<PegsBookAccount>::const_iterator itacc=accounts.begin(); itacc!=accounts.end(); itacc++)
+                if (itacc->funcid=='F' || itacc->funcid=='G' || itacc->funcid=='E')
+                {
+                    globalaccounts[*it].first+=itacc->account.first;
+                    globalaccounts[*it].second+=itacc->account.second;
+                }
+        }
+    }
+    else
+    {
+        SetCCunspents(unspentOutputs,coinaddr,true);
+        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+        {
+            txid = it->first.txhash;
+            vout = (int32_t)it->first.index;
+            nValue = (int64_t)it->second.satoshis;
+            if (vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
+                (funcid=DecodePegsOpRet(tx,tmppegstxid,tokenid))!=0 && pegstxid==tmppegstxid && (funcid=='F' || funcid=='G' || funcid=='E'))
+            {              
+                PegsDecodeAccountTx(tx,pk,amount,account);
+                globalaccounts[tokenid].first+=account.first;
+                globalaccounts[tokenid].second+=account.second;
+            }
         }
     }
     unspentOutputs.clear();
@@ -660,10 +683,29 @@ std::string PegsFindBestAccount(struct CCcontract_info *cp,uint256 pegstxid, uin
     char coinaddr[64]; int64_t nValue,tmpamount; uint256 txid,hashBlock,tmptokenid,tmppegstxid;
     CTransaction tx,acctx; int32_t numvouts,vout; char funcid,f; CPubKey pegspk,tmppk;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
-    ImportProof proof; CTransaction burntx; std::vector<CTxOut> payouts; double ratio,maxratio=0;
-    std::pair<int64_t,int64_t> tmpaccount;
+    ImportProof proof; CTransaction burntx; std::vector<CTxOut> payouts; double ratio,maxratio=0,zone;
+    std::pair<int64_t,int64_t> tmpaccount; std::vector<PegsBookAccount> bookaccounts; int64_t price;
 
     accounttxid=zeroid;
+    if (PegsBookGetAccounts(pegstxid,tokenid,bookaccounts))
+    {
+        // highest ratio first, the best account is the first one over the zone with enough deposit
+        zone=ASSETCHAINS_PEGSCCPARAMS[2]?ASSETCHAINS_PEGSCCPARAMS[2]:PEGS_ACCOUNT_YELLOW_ZONE;
+        if ((price=PegsGetTokenPrice(tokenid))<=0)
+            return("");
+        for (std::vector<PegsBookAccount>::const_iterator it=bookaccounts.begin(); it!=bookaccounts.end(); it++)
+        {
+            if (it->account.first<=0 || it->account.second<=0 || PegsGetRatioAtPrice(price,it->account)<=zone)
+                break;
+            if (!it->type.empty() && it->account.first>=tokenamount && myIsutxo_spentinmempool(ignoretxid,ignorevin,it->txid,0) == 0)
+            {
+                accounttxid=it->txid;
+                account=it->account;
+                return(it->type);
+            }
+        }
+        return("");
+    }
     pegspk = GetUnspendable(cp,0);
     GetCCaddress1of2(cp,coinaddr,pegspk,pegspk);
     SetCCunspents(unspentOutputs,coinaddr,true);
@@ -1130,7 +1172,7 @@ UniValue PegsAccountInfo(const CPubKey& pk,uint256 pegstxid)
     char coinaddr[64]; int64_t nValue,amount; uint256 txid,accounttxid,hashBlock,tmptokenid,tmppegstxid; std::map<uint256,std::pair<int64_t,int64_t>> accounts;
     CTransaction tx; int32_t numvouts,vout; char funcid; CPubKey mypk,pegspk,tmppk; std::vector<uint256> bindtxids;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs; std::pair<int64_t,int64_t> account; 
-    UniValue result(UniValue::VOBJ),acc(UniValue::VARR); struct CCcontract_info *cp,C;
+    UniValue result(UniValue::VOBJ),acc(UniValue::VARR); struct CCcontract_info *cp,C; std::vector<PegsBookAccount> bookaccounts;
 
     if (myGetTransaction(pegstxid,tx,hashBlock)==0 || (numvouts=tx.vout.size())<=0)
         CCERR_RESULT("pegscc",CCLOG_INFO, stream << "cant find pegstxid " << pegstxid.GetHex());
@@ -1142,20 +1184,28 @@ UniValue PegsAccountInfo(const CPubKey& pk,uint256 pegstxid)
     mypk = pk.IsValid()?pk:pubkey2pk(Mypubkey());
     pegspk = GetUnspendable(cp,0);
     GetCCaddress1of2(cp,coinaddr,mypk,pegspk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    if (PegsBookGetOwnerAccounts(pegstxid,coinaddr,bookaccounts))
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        //LOGSTREAM("pegscc",CCLOG_DEBUG2, stream << "txid=" << txid.GetHex() << ", vout=" << vout << ", nValue=" << nValue << std::endl);
-        if (vout == 1 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
-            (funcid=DecodePegsOpRet(tx,tmppegstxid,tmptokenid))!=0 && pegstxid==tmppegstxid)
+        for (std::vector<PegsBookAccount>::const_iterator it=bookaccounts.begin(); it!=bookaccounts.end(); it++)
+            accounts[it->tokenid]=it->account;
+    }
+    else
+    {
+        SetCCunspents(unspentOutputs,coinaddr,true);
+        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
         {
-            //LOGSTREAM("pegscc",CCLOG_DEBUG2, stream << "txid=" << txid.GetHex() << ", vout=" << vout << ", nValue=" << nValue << ", tokenid=" << tmptokenid.GetHex() << std::endl);
-            PegsDecodeAccountTx(tx,tmppk,amount,account);           
-            accounts[tmptokenid].first=account.first;
-            accounts[tmptokenid].second=account.second;
+            txid = it->first.txhash;
+            vout = (int32_t)it->first.index;
+            nValue = (int64_t)it->second.satoshis;
+            //LOGSTREAM("pegscc",CCLOG_DEBUG2, stream << "txid=" << txid.GetHex() << ", vout=" << vout << ", nValue=" << nValue << std::endl);
+            if (vout == 1 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
+                (funcid=DecodePegsOpRet(tx,tmppegstxid,tmptokenid))!=0 && pegstxid==tmppegstxid)
+            {
+                //LOGSTREAM("pegscc",CCLOG_DEBUG2, stream << "txid=" << txid.GetHex() << ", vout=" << vout << ", nValue=" << nValue << ", tokenid=" << tmptokenid.GetHex() << std::endl);
+                PegsDecodeAccountTx(tx,tmppk,amount,account);           
+                accounts[tmptokenid].first=account.first;
+                accounts[tmptokenid].second=account.second;
+            }
         }
     }
     for (std::map<uint256,std::pair<int64_t,int64_t>>::iterator it = accounts.begin(); it != accounts.end(); ++it)
@@ -1177,7 +1227,7 @@ UniValue PegsWorstAccounts(uint256 pegstxid)
     char coinaddr[64]; int64_t nValue,amount; uint256 txid,accounttxid,hashBlock,tmppegstxid,tokenid,prev;
     CTransaction tx; int32_t numvouts,vout; char funcid; CPubKey pegspk,pk; double ratio; std::vector<uint256> bindtxids;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs; std::pair<int64_t,int64_t> account;
-    UniValue result(UniValue::VOBJ),acc(UniValue::VARR); struct CCcontract_info *cp,C; std::multimap<uint256,UniValue> map;
+    UniValue result(UniValue::VOBJ),acc(UniValue::VARR); struct CCcontract_info *cp,C; std::multimap<uint256,UniValue> map; std::vector<uint256> tokenids;
 
     if (myGetTransaction(pegstxid,tx,hashBlock)==0 || (numvouts=tx.vout.size())<=0)
         CCERR_RESULT("pegscc",CCLOG_INFO, stream << "cant find pegstxid " << pegstxid.GetHex());
@@ -1188,26 +1238,50 @@ UniValue PegsWorstAccounts(uint256 pegstxid)
     cp = CCinit(&C,EVAL_PEGS);
     pegspk = GetUnspendable(cp,0);
     GetCCaddress1of2(cp,coinaddr,pegspk,pegspk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    if (PegsBookGetTokens(pegstxid,tokenids))
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        if (vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
-            (funcid=DecodePegsOpRet(tx,tmppegstxid,tokenid))!=0 && pegstxid==tmppegstxid)
-        {               
-            PegsDecodeAccountTx(tx,pk,amount,account);
-            if (account.first==0 || account.second==0 || PegsGetTokenPrice(tokenid)<=0) ratio=0;
-            else ratio=PegsGetRatio(tokenid,account);
-            if (ratio>PEGS_ACCOUNT_RED_ZONE)
+        for (std::vector<uint256>::const_iterator ittoken=tokenids.begin(); ittoken!=tokenids.end(); ittoken++)
+        {
+            std::vector<PegsBookAccount> accounts; int64_t price;
+            // highest ratio first, the accounts in the red zone are at the head
+            if ((price=PegsGetTokenPrice(*ittoken))<=0 || !PegsBookGetAccounts(pegstxid,*ittoken,accounts))
+                continue;
+            for (std::vector<PegsBookAccount>::const_iterator itacc=accounts.begin(); itacc!=accounts.end(); itacc++)
             {
+                if (itacc->account.first==0 || itacc->account.second==0 || (ratio=PegsGetRatioAtPrice(price,itacc->account))<=PEGS_ACCOUNT_RED_ZONE)
+                    break;
                 UniValue obj(UniValue::VOBJ);
-                obj.push_back(Pair("accounttxid",txid.GetHex()));
-                obj.push_back(Pair("deposit",account.first));
-                obj.push_back(Pair("debt",account.second));
+                obj.push_back(Pair("accounttxid",itacc->txid.GetHex()));
+                obj.push_back(Pair("deposit",itacc->account.first));
+                obj.push_back(Pair("debt",itacc->account.second));
                 obj.push_back(Pair("ratio",strprintf("%.2f%%",ratio)));                
-                map.insert(std::pair<uint256,UniValue>(tokenid,obj));
+                map.insert(std::pair<uint256,UniValue>(*ittoken,obj));
+            }
+        }
+    }
+    else
+    {
+        SetCCunspents(unspentOutputs,coinaddr,true);
+        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+        {
+            txid = it->first.txhash;
+            vout = (int32_t)it->first.index;
+            nValue = (int64_t)it->second.satoshis;
+            if (vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
+                (funcid=DecodePegsOpRet(tx,tmppegstxid,tokenid))!=0 && pegstxid==tmppegstxid)
+            {               
+                PegsDecodeAccountTx(tx,pk,amount,account);
+                if (account.first==0 || account.second==0 || PegsGetTokenPrice(tokenid)<=0) ratio=0;
+                else ratio=PegsGetRatio(tokenid,account);
+                if (ratio>PEGS_ACCOUNT_RED_ZONE)
+                {
+                    UniValue obj(UniValue::VOBJ);
+                    obj.push_back(Pair("accounttxid",txid.GetHex()));
+                    obj.push_back(Pair("deposit",account.first));
+                    obj.push_back(Pair("debt",account.second));
+                    obj.push_back(Pair("ratio",strprintf("%.2f%%",ratio)));                
+                    map.insert(std::pair<uint256,UniValue>(tokenid,obj));
+                }
             }
         }
     }
@@ -1231,7 +1305,7 @@ UniValue PegsInfo(uint256 pegstxid)
     char coinaddr[64]; int64_t nValue,amount; uint256 txid,accounttxid,hashBlock,tmppegstxid,tokenid;
     CTransaction tx; int32_t numvouts,vout; char funcid; CPubKey pegspk,pk; std::vector<uint256> bindtxids;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs; std::pair<int64_t,int64_t> account;
-    std::map<uint256,std::pair<int64_t,int64_t>> globalaccounts; double globaldeposit=0;
+    std::map<uint256,std::pair<int64_t,int64_t>> globalaccounts; double globaldeposit=0; std::vector<uint256> tokenids;
     UniValue result(UniValue::VOBJ),acc(UniValue::VARR); struct CCcontract_info *cp,C;
 
     if (myGetTransaction(pegstxid,tx,hashBlock)==0 || (numvouts=tx.vout.size())<=0)
@@ -1243,18 +1317,34 @@ UniValue PegsInfo(uint256 pegstxid)
     cp = CCinit(&C,EVAL_PEGS);
     pegspk = GetUnspendable(cp,0);
     GetCCaddress1of2(cp,coinaddr,pegspk,pegspk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    if (PegsBookGetTokens(pegstxid,tokenids))
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        if (vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
-            (funcid=DecodePegsOpRet(tx,tmppegstxid,tokenid))!=0 && pegstxid==tmppegstxid)
-        {               
-            PegsDecodeAccountTx(tx,pk,amount,account);
-            globalaccounts[tokenid].first+=account.first;
-            globalaccounts[tokenid].second+=account.second;
+        for (std::vector<uint256>::const_iterator it=tokenids.begin(); it!=tokenids.end(); it++)
+        {
+            std::vector<PegsBookAccount> accounts;
+            PegsBookGetAccounts(pegstxid,*it,accounts);
+            for (std::vector<PegsBookAccount>::const_iterator itacc=accounts.begin(); itacc!=accounts.end(); itacc++)
+            {
+                globalaccounts[*it].first+=itacc->account.first;
+                globalaccounts[*it].second+=itacc->account.second;
+            }
+        }
+    }
+    else
+    {
+        SetCCunspents(unspentOutputs,coinaddr,true);
+        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+        {
+            txid = it->first.txhash;
+            vout = (int32_t)it->first.index;
+            nValue = (int64_t)it->second.satoshis;
+            if (vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
+                (funcid=DecodePegsOpRet(tx,tmppegstxid,tokenid))!=0 && pegstxid==tmppegstxid)
+            {               
+                PegsDecodeAccountTx(tx,pk,amount,account);
+                globalaccounts[tokenid].first+=account.first;
+                globalaccounts[tokenid].second+=account.second;
+            }
         }
     }
     unspentOutputs.clear();
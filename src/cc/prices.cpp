@@ -71,6 +71,7 @@ GetKomodoEarlytxidScriptPub is on line #2080 of komodo_bitcoind.h
 
 #include "CCassets.h"
 #include "CCPrices.h"
+#include "CCpricescache.h"
 
 #include <cstdlib>
 #include <gmp.h>
@@ -80,6 +81,8 @@ GetKomodoEarlytxidScriptPub is on line #2080 of komodo_bitcoind.h
 #define NVOUT_CCMARKER 1
 #define NVOUT_NORMALMARKER 3
 
+#define PRICES_SCANBATCH 1440  // heights evaluated at once by prices_scanchain
+
 typedef struct OneBetData {
     int64_t positionsize;
     int32_t firstheight;
@@ -965,12 +968,12 @@ int32_t prices_syntheticvec(std::vector<uint16_t> &vec, std::vector<std::string>
     return(0);
 }
 
-// calculates price for synthetic expression
-int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t minmax, int16_t leverage)
+// calculates price for synthetic expression with the index prices returned by getprice, returns the price or a negative error code
+static int64_t prices_evalsynthetic(const std::vector<uint16_t> &vec, std::function<bool(int32_t ind, int64_t &price)> getprice)
 {
     int32_t i, value, errcode, depth, retval = -1;
     uint16_t opcode;
-    int64_t *pricedata, pricestack[4], a, b, c;
+    int64_t pricestack[4], a, b, c;
 
     mpz_t mpzTotalPrice, mpzPriceValue, mpzDen, mpzA, mpzB, mpzC, mpzResult;
 
@@ -983,7 +986,6 @@ int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t
     mpz_init(mpzC);
     mpz_init(mpzResult);
 
-    pricedata = (int64_t *)calloc(sizeof(*pricedata) * 3, 1 + PRICES_DAYWINDOW * 2 + PRICES_SMOOTHWIDTH);
     depth = errcode = 0;
     mpz_set_si(mpzTotalPrice, 0);
     mpz_set_si(mpzDen, 0);
@@ -1000,23 +1002,7 @@ int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t
         {
         case 0: // indices 
             pricestack[depth] = 0;
-            if (komodo_priceget(pricedata, value, height, 1) >= 0)
-            {
-                //std::cerr << "prices_syntheticprice" << " pricedata[0]=" << pricedata[0] << " pricedata[1]=" << pricedata[1] << " pricedata[2]=" << pricedata[2] << std::endl;
-                // push price to the prices stack
-                /*if (!minmax)
-                    pricestack[depth] = pricedata[2];   // use smoothed value if we are over 24h
-                else
-                {
-                    // if we are within 24h use min or max price
-                    if (leverage > 0)
-                        pricestack[depth] = (pricedata[1] > pricedata[2]) ? pricedata[1] : pricedata[2]; // MAX
-                    else
-                        pricestack[depth] = (pricedata[1] < pricedata[2]) ? pricedata[1] : pricedata[2]; // MIN
-                }*/
-                pricestack[depth] = pricedata[2];
-            }
-            else
+            if (!getprice(value, pricestack[depth]))
                 errcode = -1;
 
             if (pricestack[depth] == 0)
@@ -1183,7 +1169,6 @@ int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t
  //           std::cerr << "prices_syntheticprice pricestack empty" << std::endl;
 
     }
-    free(pricedata);
     mpz_clear(mpzResult);
     mpz_clear(mpzA);
     mpz_clear(mpzB);
@@ -1233,15 +1218,82 @@ int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t
 }
 
 // calculates costbasis and profit/loss for the bet
-int32_t prices_syntheticprofits(int64_t &costbasis, int32_t firstheight, int32_t height, int16_t leverage, std::vector<uint16_t> vec, int64_t positionsize,  int64_t &profits, int64_t &outprice)
+// calculates price for synthetic expression at height, with the smoothed price of each index
+int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t minmax, int16_t leverage)
+{
+    uint256 exprhash = SerializeHash(vec);
+    int64_t price, pricedata[PRICES_MAXDATAPOINTS];
+
+    // the synthetic price does not depend on minmax and leverage
+    if (PricesCacheGet(exprhash, height, price))
+        return price;
+
+    price = prices_evalsynthetic(vec, [&](int32_t ind, int64_t &indprice) {
+        if (komodo_priceget(pricedata, ind, height, 1) < 0)
+            return false;
+        indprice = pricedata[2];
+        return true;
+    });
+    if (price >= 0)
+        PricesCacheSet(exprhash, height, price);
+    return price;
+}
+
+// evaluates the synthetic expression vec at each height from firstheight to lastheight, with one read of the price data of each index in vec.
+// prices[i] is set to the synthetic price at firstheight + i or a negative error code, as prices_syntheticprice returns it
+static void prices_syntheticprices(const std::vector<uint16_t> &vec, int32_t firstheight, int32_t lastheight, std::vector<int64_t> &prices)
+{
+    uint256 exprhash = SerializeHash(vec);
+    int32_t numblocks = lastheight - firstheight + 1;
+    std::map<int32_t, std::vector<int64_t> > pricedata;
+    bool fCached = true;
+
+    prices.assign(std::max(numblocks, 0), -1);
+    for (int32_t i = 0; i < numblocks; i++)
+        if (!PricesCacheGet(exprhash, firstheight + i, prices[i]))
+            fCached = false;
+    if (fCached)
+        return;
+
+    for (const uint16_t opcode : vec)
+    {
+        int32_t ind = (opcode & (KOMODO_MAXPRICES - 1));
+        if ((opcode & KOMODO_PRICEMASK) != 0 || pricedata.count(ind) != 0)
+            continue;
+        std::vector<int64_t> &indprices = pricedata[ind];
+        indprices.resize(numblocks * PRICES_MAXDATAPOINTS);
+        if (komodo_priceget(indprices.data(), ind, firstheight, numblocks) < 0)
+        {
+            // some heights are not available, evaluate each of them
+            for (int32_t i = 0; i < numblocks; i++)
+                prices[i] = prices_syntheticprice(vec, firstheight + i, 0, 0);
+            return;
+        }
+    }
+    for (int32_t i = 0; i < numblocks; i++)
+    {
+        prices[i] = prices_evalsynthetic(vec, [&](int32_t ind, int64_t &indprice) {
+            indprice = pricedata[ind][i * PRICES_MAXDATAPOINTS + 2];
+            return true;
+        });
+        if (prices[i] >= 0)
+            PricesCacheSet(exprhash, firstheight + i, prices[i]);
+    }
+}
+
+static int32_t prices_costbasisperiod()
 {
-    int64_t price;
 #ifndef TESTMODE
-    const int32_t COSTBASIS_PERIOD = PRICES_DAYWINDOW;
+    return PRICES_DAYWINDOW;
 #else
-    const int32_t COSTBASIS_PERIOD = 7;
+    return 7;
 #endif
+}
 
+// calculates the bet profits at height with the synthetic price at this height
+static int32_t prices_syntheticprofitsatprice(int64_t &costbasis, int32_t firstheight, int32_t height, int16_t leverage, int64_t price, int64_t positionsize, int64_t &profits, int64_t &outprice)
+{
+    const int32_t COSTBASIS_PERIOD = prices_costbasisperiod();
 
     if (height < firstheight) {
         fprintf(stderr, "requested height is lower than bet firstheight.%d\n", height);
@@ -1250,7 +1302,7 @@ int32_t prices_syntheticprofits(int64_t &costbasis, int32_t firstheight, int32_t
 
     int32_t minmax = (height < firstheight + COSTBASIS_PERIOD);  // if we are within 24h then use min or max value 
 
-    if ((price = prices_syntheticprice(vec, height, minmax, leverage)) < 0)
+    if (price < 0)
     {
         fprintf(stderr, "error getting synthetic price at height.%d\n", height);
         return -1;
@@ -1342,6 +1394,18 @@ int32_t prices_syntheticprofits(int64_t &costbasis, int32_t firstheight, int32_t
     return 0; //  (positionsize + addedbets + profits);
 }
 
+int32_t prices_syntheticprofits(int64_t &costbasis, int32_t firstheight, int32_t height, int16_t leverage, std::vector<uint16_t> vec, int64_t positionsize,  int64_t &profits, int64_t &outprice)
+{
+    if (height < firstheight) {
+        fprintf(stderr, "requested height is lower than bet firstheight.%d\n", height);
+        return -1;
+    }
+
+    int32_t minmax = (height < firstheight + prices_costbasisperiod());  // if we are within 24h then use min or max value 
+    int64_t price = prices_syntheticprice(vec, height, minmax, leverage);
+    return prices_syntheticprofitsatprice(costbasis, firstheight, height, leverage, price, positionsize, profits, outprice);
+}
+
 // makes result json object
 void prices_betjson(UniValue &result, std::vector<OneBetData> bets, int16_t leverage, int32_t endheight, int64_t lastprice)
 {
@@ -1606,17 +1670,31 @@ int32_t prices_scanchain(std::vector<OneBetData> &bets, int16_t leverage, std::v
         return -1;
 
     bool stop = false;
+    int32_t tipheight = komodo_nextheight() - 1;
+    int32_t pricesheight = 0;      // height of prices[0]
+    std::vector<int64_t> prices;
     for (int32_t height = bets[0].firstheight+1; ; height++)   // the last datum for 24h is the costbasis value
     {
         int64_t totalposition = 0;
         int64_t totalprofits = 0;
+        int64_t price;
+
+        // evaluate the synthetic for the next heights up to the chain tip at once
+        if (height <= tipheight && height >= pricesheight + (int32_t)prices.size()) {
+            pricesheight = height;
+            prices_syntheticprices(vec, height, std::min(tipheight, height + PRICES_SCANBATCH - 1), prices);
+        }
+        if (height >= pricesheight && height < pricesheight + (int32_t)prices.size())
+            price = prices[height - pricesheight];
+        else
+            price = prices_syntheticprice(vec, height, 0, leverage);
 
         // scan upto the chain tip
         for (int i = 0; i < bets.size(); i++) {
 
             if (height > bets[i].firstheight) {
 
-                int32_t retcode = prices_syntheticprofits(bets[i].costbasis, bets[i].firstheight, height, leverage, vec, bets[i].positionsize, bets[i].profits, lastprice);
+                int32_t retcode = prices_syntheticprofitsatprice(bets[i].costbasis, bets[i].firstheight, height, leverage, price, bets[i].positionsize, bets[i].profits, lastprice);
                 if (retcode < 0) {
                     std::cerr << "prices_scanchain() prices_syntheticprofits returned -1, finishing..." << std::endl;
                     stop = true;
@@ -14,6 +14,7 @@
  ******************************************************************************/
 
 #include "CCrewards.h"
+#include "CCrewardsbook.h"
 
 /*
  The rewards CC contract is initially for OOT, which needs this functionality. However, many of the attributes can be parameterized to allow different rewards programs to run. Multiple rewards plans could even run on the same blockchain, though the user would need to choose which one to lock funds into.
@@ -343,89 +344,114 @@ bool RewardsValidate(struct CCcontract_info *cp,Eval* eval,const CTransaction &t
     return(true);
 }
 
-static uint64_t myIs_unlockedtx_inmempool(uint256 &txid,int32_t &vout,uint64_t refsbits,uint256 reffundingtxid,uint64_t needed)
+static uint64_t myIs_unlockedtx_inmempool(struct CCcontract_info *cp,uint256 &txid,int32_t &vout,uint64_t refsbits,uint256 reffundingtxid,uint64_t needed)
 {
-    uint8_t funcid; uint64_t sbits,nValue; uint256 fundingtxid; char str[65];
+    uint8_t funcid; uint64_t sbits,nValue; uint256 fundingtxid; char str[65]; uint160 hashBytes; int type; CTransaction tx;
+    std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > memOutputs;
+    std::vector<std::pair<uint160, int> > addresses;
     memset(&txid,0,sizeof(txid));
     vout = -1;
     nValue = 0;
-    BOOST_FOREACH(const CTxMemPoolEntry &e,mempool.mapTx)
-    {
-        const CTransaction &tx = e.GetTx();
-        if ( tx.vout.size() > 0 && tx.vout[0].nValue >= needed )
+    // only the outputs to the rewards address that are not spent in the mempool, instead of every mempool tx
+    if ( CBitcoinAddress(cp->unspendableCCaddr).GetIndexKey(hashBytes,type,true) == false )
+        return(nValue);
+    addresses.push_back(std::make_pair(hashBytes,type));
+    mempool.getAddressUnspent(addresses,memOutputs);
+    for (std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >::const_iterator it=memOutputs.begin(); it!=memOutputs.end(); it++)
+    {
+        const uint256 &hash = it->first.txhash;
+        if ( it->first.index != 0 || it->second.amount < (CAmount)needed || mempool.lookup(hash,tx) == 0 )
+            continue;
+        if ( tx.vout[0].scriptPubKey.IsPayToCryptoCondition() != 0 && myIsutxo_spentinmempool(ignoretxid,ignorevin,hash,0) == 0 )
         {
-            const uint256 &hash = tx.GetHash();
-            if ( tx.vout[0].scriptPubKey.IsPayToCryptoCondition() != 0 && myIsutxo_spentinmempool(ignoretxid,ignorevin,hash,0) == 0 )
+            if ( (funcid= DecodeRewardsOpRet(hash,tx.vout[tx.vout.size()-1].scriptPubKey,sbits,fundingtxid)) == 'U' && sbits == refsbits && fundingtxid == reffundingtxid )
             {
-                if ( (funcid= DecodeRewardsOpRet(hash,tx.vout[tx.vout.size()-1].scriptPubKey,sbits,fundingtxid)) == 'U' && sbits == refsbits && fundingtxid == reffundingtxid )
-                {
-                    txid = hash;
-                    vout = 0;
-                    nValue = tx.vout[0].nValue;
-                    fprintf(stderr,"found 'U' %s %.8f in unspent in mempool\n",uint256_str(str,txid),(double)nValue/COIN);
-                    return(nValue);
-                }
+                txid = hash;
+                vout = 0;
+                nValue = tx.vout[0].nValue;
+                fprintf(stderr,"found 'U' %s %.8f in unspent in mempool\n",uint256_str(str,txid),(double)nValue/COIN);
+                return(nValue);
             }
         }
     }
     return(nValue);
 }
 
-// 'L' vs 'F' and 'A'
-int64_t AddRewardsInputs(CScript &scriptPubKey,uint64_t maxseconds,struct CCcontract_info *cp,CMutableTransaction &mtx,CPubKey pk,int64_t total,int32_t maxinputs,uint64_t refsbits,uint256 reffundingtxid)
+// the confirmed funding ('F', 'A' and 'U') or deposit ('L') utxos of a plan, deposits locked at or before maxTime oldest first
+static void RewardsPlanUtxos(std::vector<RewardsBookUtxo> &utxos,struct CCcontract_info *cp,CPubKey pk,uint64_t refsbits,uint256 reffundingtxid,bool fDeposits,uint32_t maxTime)
 {
-    char coinaddr[64],str[65]; uint64_t threshold,sbits,nValue,totalinputs = 0; uint256 txid,hashBlock,fundingtxid; CTransaction tx; int32_t numblocks,j,vout,n = 0; uint8_t funcid;
+    char coinaddr[64]; uint256 hashBlock; CTransaction tx; CBlockIndex *pindex;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    std::vector<RewardsBookUtxo> planutxos;
     GetCCaddress(cp,coinaddr,pk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
+    if ( strcmp(coinaddr,cp->unspendableCCaddr) != 0 || (fDeposits ? RewardsBookGetDeposits(reffundingtxid,maxTime,planutxos) : RewardsBookGetFunds(reffundingtxid,planutxos)) == 0 )
+    {
+        SetCCunspents(unspentOutputs,coinaddr,true);
+        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+        {
+            RewardsBookUtxo utxo;
+            if ( myGetTransaction(it->first.txhash,tx,hashBlock) == 0 || (pindex= komodo_getblockindex(hashBlock)) == 0 )
+                continue;
+            if ( RewardsBookDecode(tx,(int32_t)it->first.index,utxo) != 0 && utxo.fundingtxid == reffundingtxid && (utxo.funcid == 'L') == fDeposits )
+            {
+                utxo.nTime = pindex->nTime;
+                if ( fDeposits == 0 || utxo.nTime <= maxTime )
+                    planutxos.push_back(utxo);
+            }
+        }
+        if ( fDeposits != 0 )
+            std::stable_sort(planutxos.begin(),planutxos.end(),[](const RewardsBookUtxo &a,const RewardsBookUtxo &b) { return(a.nTime < b.nTime); });
+    }
+    for (const RewardsBookUtxo &utxo : planutxos)
+        if ( utxo.sbits == refsbits )
+            utxos.push_back(utxo);
+}
+
+// deposits 'L' locked for at least minseconds vs funds 'F', 'A' and 'U'
+int64_t AddRewardsInputs(CScript &scriptPubKey,bool fDeposits,uint64_t minseconds,struct CCcontract_info *cp,CMutableTransaction &mtx,CPubKey pk,int64_t total,int32_t maxinputs,uint64_t refsbits,uint256 reffundingtxid)
+{
+    char str[65]; uint64_t threshold,nValue,totalinputs = 0; uint256 txid; uint32_t maxTime = 0xffffffff; int32_t j,vout,n = 0; CBlockIndex *tip;
+    std::vector<RewardsBookUtxo> utxos;
     if ( maxinputs > CC_MAXVINS )
         maxinputs = CC_MAXVINS;
     if ( maxinputs > 0 )
         threshold = total/maxinputs;
     else threshold = total;
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    if ( fDeposits != 0 )
+    {
+        // a deposit locked for less than minseconds earns no reward, the book only returns the matured ones
+        if ( (tip= chainActive.LastTip()) == 0 || tip->nTime < minseconds )
+            return(0);
+        maxTime = (uint32_t)(tip->nTime - minseconds);
+    }
+    RewardsPlanUtxos(utxos,cp,pk,refsbits,reffundingtxid,fDeposits,maxTime);
+    for (const RewardsBookUtxo &utxo : utxos)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        if ( it->second.satoshis < threshold )
+        if ( utxo.nValue < threshold )
             continue;
-        //fprintf(stderr,"(%s) %s/v%d %.8f\n",coinaddr,uint256_str(str,txid),vout,(double)it->second.satoshis/COIN);
         for (j=0; j<mtx.vin.size(); j++)
-            if ( txid == mtx.vin[j].prevout.hash && vout == mtx.vin[j].prevout.n )
+            if ( utxo.txid == mtx.vin[j].prevout.hash && utxo.vout == mtx.vin[j].prevout.n )
                 break;
         if ( j != mtx.vin.size() )
             continue;
-        if ( myGetTransaction(txid,tx,hashBlock) != 0 && tx.vout.size() > 0 && tx.vout[vout].scriptPubKey.IsPayToCryptoCondition() != 0 && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 )
+        if ( myIsutxo_spentinmempool(ignoretxid,ignorevin,utxo.txid,utxo.vout) != 0 )
+            continue;
+        fprintf(stderr,"minseconds.%d (%c) %s/v%d %.8f\n",(int32_t)minseconds,utxo.funcid,uint256_str(str,utxo.txid),utxo.vout,(double)utxo.nValue/COIN);
+        if ( total != 0 && maxinputs != 0 )
         {
-            if ( (funcid= DecodeRewardsOpRet(txid,tx.vout[tx.vout.size()-1].scriptPubKey,sbits,fundingtxid)) != 0 )
-            {
-                if ( sbits != refsbits || fundingtxid != reffundingtxid )
-                    continue;
-                if ( maxseconds == 0 && funcid != 'F' && funcid != 'A' && funcid != 'U' )
-                    continue;
-                else if ( maxseconds != 0 && funcid != 'L' )
-                {
-                    if ( CCduration(numblocks,txid) < maxseconds )
-                        continue;
-                }
-                fprintf(stderr,"maxseconds.%d (%c) %.8f %.8f\n",(int32_t)maxseconds,funcid,(double)tx.vout[vout].nValue/COIN,(double)it->second.satoshis/COIN);
-                if ( total != 0 && maxinputs != 0 )
-                {
-                    if ( maxseconds != 0 )
-                        scriptPubKey = tx.vout[1].scriptPubKey;
-                    mtx.vin.push_back(CTxIn(txid,vout,CScript()));
-                }
-                totalinputs += it->second.satoshis;
-                n++;
-                if ( (total > 0 && totalinputs >= total) || (maxinputs > 0 && n >= maxinputs) )
-                    break;
-            } else fprintf(stderr,"null funcid\n");
+            if ( fDeposits != 0 )
+                scriptPubKey = utxo.unlockScript;
+            mtx.vin.push_back(CTxIn(utxo.txid,utxo.vout,CScript()));
         }
+        totalinputs += utxo.nValue;
+        n++;
+        if ( (total > 0 && totalinputs >= total) || (maxinputs > 0 && n >= maxinputs) )
+            break;
     }
-    if ( maxseconds == 0 && totalinputs < total && (maxinputs == 0 || n < maxinputs-1) )
+    if ( fDeposits == 0 && totalinputs < total && (maxinputs == 0 || n < maxinputs-1) )
     {
         fprintf(stderr,"search mempool for unlocked and unspent CC rewards output for %.8f\n",(double)(total-totalinputs)/COIN);
-        if ( (nValue= myIs_unlockedtx_inmempool(txid,vout,refsbits,reffundingtxid,total-totalinputs)) > 0 )
+        if ( (nValue= myIs_unlockedtx_inmempool(cp,txid,vout,refsbits,reffundingtxid,total-totalinputs)) > 0 )
         {
             mtx.vin.push_back(CTxIn(txid,vout,CScript()));
             fprintf(stderr,"added mempool vout for %.8f\n",(double)nValue/COIN);
@@ -438,32 +464,14 @@ int64_t AddRewardsInputs(CScript &scriptPubKey,uint64_t maxseconds,struct CCcont
 
 int64_t RewardsPlanFunds(uint64_t &lockedfunds,uint64_t refsbits,struct CCcontract_info *cp,CPubKey pk,uint256 reffundingtxid)
 {
-    char coinaddr[64]; uint64_t sbits; int64_t nValue,totalinputs = 0; uint256 txid,hashBlock,fundingtxid; CTransaction tx; int32_t vout; uint8_t funcid;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    int64_t totalinputs = 0; std::vector<RewardsBookUtxo> funds,deposits;
     lockedfunds = 0;
-    GetCCaddress(cp,coinaddr,pk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
-    {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        if ( myGetTransaction(txid,tx,hashBlock) != 0 && tx.vout[vout].scriptPubKey.IsPayToCryptoCondition() != 0 )
-        {
-            if ( (funcid= DecodeRewardsOpRet(txid,tx.vout[tx.vout.size()-1].scriptPubKey,sbits,fundingtxid)) == 'F' || funcid == 'A' || funcid == 'U' || funcid == 'L' )
-            {
-                if ( refsbits == sbits && (funcid == 'F' && reffundingtxid == txid) || reffundingtxid == fundingtxid )
-                {
-                    if ( (nValue= IsRewardsvout(cp,tx,vout,sbits,fundingtxid)) > 0 )
-                    {
-                        if ( funcid == 'L' )
-                            lockedfunds += nValue;
-                        else totalinputs += nValue;
-                    }
-                    else fprintf(stderr,"refsbits.%llx sbits.%llx nValue %.8f\n",(long long)refsbits,(long long)sbits,(double)nValue/COIN);
-                } //else fprintf(stderr,"else case\n");
-            } else fprintf(stderr,"funcid.%d %c skipped %.8f\n",funcid,funcid,(double)tx.vout[vout].nValue/COIN);
-        }
-    }
+    RewardsPlanUtxos(funds,cp,pk,refsbits,reffundingtxid,false,0);
+    for (const RewardsBookUtxo &utxo : funds)
+        totalinputs += utxo.nValue;
+    RewardsPlanUtxos(deposits,cp,pk,refsbits,reffundingtxid,true,0xffffffff);
+    for (const RewardsBookUtxo &utxo : deposits)
+        lockedfunds += utxo.nValue;
     return(totalinputs);
 }
 
@@ -685,7 +693,7 @@ std::string RewardsUnlock(uint64_t txfee,char *planstr,uint256 fundingtxid,uint2
     }
     fprintf(stderr,"APR %.8f minseconds.%llu maxseconds.%llu mindeposit %.8f\n",(double)APR/COIN,(long long)minseconds,(long long)maxseconds,(double)mindeposit/COIN);
     if ( locktxid == zeroid )
-        amount = AddRewardsInputs(scriptPubKey,maxseconds,cp,mtx,rewardspk,(1LL << 30),1,sbits,fundingtxid);
+        amount = AddRewardsInputs(scriptPubKey,true,minseconds,cp,mtx,rewardspk,(1LL << 30),1,sbits,fundingtxid);
     else
     {
         GetCCaddress(cp,coinaddr,rewardspk);
@@ -715,7 +723,7 @@ std::string RewardsUnlock(uint64_t txfee,char *planstr,uint256 fundingtxid,uint2
             if ( reward > txfee )
             {
                 firstmtx = mtx;
-                if ( (inputs= AddRewardsInputs(ignore,0,cp,mtx,rewardspk,reward+txfee,30,sbits,fundingtxid)) >= reward+txfee )
+                if ( (inputs= AddRewardsInputs(ignore,false,0,cp,mtx,rewardspk,reward+txfee,30,sbits,fundingtxid)) >= reward+txfee )
                 {
                     if ( inputs >= (reward + 2*txfee) )
                         CCchange = (inputs - (reward + txfee));
@@ -26,9 +26,28 @@
 #define ROGUE_MAXCASHOUT (777 * COIN)
 
 #include "rogue/rogue_player.h"
+#include "CCreplaycache.h"
 
 std::string Rogue_pname = "";
 
+static CCReplayCache rogueReplays(256);
+
+// rogue_replay2 without display, the same keystrokes of a game are only replayed once
+int32_t rogue_replay2cached(uint8_t *newdata,uint64_t seed,char *keystrokes,int32_t num,struct rogue_player *player)
+{
+    std::vector<uint8_t> result; uint256 key; int32_t n;
+    key = CCReplayCache::Key(seed,keystrokes,num,player,player != 0 ? sizeof(*player) : 0);
+    if ( rogueReplays.Get(key,result) == false )
+    {
+        if ( (n= rogue_replay2(newdata,seed,keystrokes,num,player,0)) > 0 )
+            result.assign(newdata,newdata+n);
+        rogueReplays.Put(key,result);
+    }
+    else if ( result.size() > 0 )
+        memcpy(newdata,result.data(),result.size());
+    return((int32_t)result.size());
+}
+
 /*
  Roguelander - using highlander competition between rogue players
 
@@ -1015,7 +1034,7 @@ char *rogue_extractgame(int32_t makefiles,char *str,int32_t *numkeysp,std::vecto
                     }
                 }
                 //fprintf(stderr,"call replay2\n");
-                num = rogue_replay2(newplayer,seed,keystrokes,numkeys,playerdata.size()==0?0:&P,0);
+                num = rogue_replay2cached(newplayer,seed,keystrokes,numkeys,playerdata.size()==0?0:&P);
                 newdata.resize(num);
                 for (i=0; i<num; i++)
                 {
@@ -1259,7 +1278,7 @@ UniValue rogue_finishgame(uint64_t txfee,struct CCcontract_info *cp,cJSON *param
                     }
                     if ( keystrokes != 0 )
                     {
-                        num = rogue_replay2(player,seed,keystrokes,numkeys,playerdata.size()==0?0:&P,0);
+                        num = rogue_replay2cached(player,seed,keystrokes,numkeys,playerdata.size()==0?0:&P);
                         if ( keystrokes != 0 )
                             free(keystrokes), keystrokes = 0;
                     } else num = 0;
@@ -16,6 +16,9 @@
 #include "CCtokentags.h"
 #include "CCtokens.h"
 #include "CCtokens_impl.h"
+#include "CCtokentagsindex.h"
+#include "base58.h"
+#include "txdb.h"
 
 /*
 This is an implementation of a simple linked list data storage method, similar to Oracles in functionality.
@@ -718,20 +721,121 @@ static CTxOut MakeTokensCCvoutforTag(uint256 tokenid, uint8_t evalcode, CAmount
 	return CTxOut();
 }
 
+// Decodes a token tag create, update or escrow update transaction for the token tags index.
+static bool DecodeTokenTagEvent(struct CCcontract_info *cp, const CTransaction &tx, uint256 &tokentagid, CTokenTagEvent &event)
+{
+	uint8_t version;
+	CPubKey srcpub;
+	uint256 escrowtxid;
+	int64_t updatesupply;
+	std::string data;
+	char batonaddr[KOMODO_ADDRESS_BUFSIZE];
+	int type;
+
+	if (tx.vout.size() == 0 || (event.funcid = DecodeTokenTagOpRet(tx.vout.back().scriptPubKey)) == 0 || !IsTxCCV2(cp, tx))
+		return false;
+	switch (event.funcid)
+	{
+		case 'c':
+			tokentagid = tx.GetHash();
+			break;
+		case 'u':
+			if (DecodeTokenTagUpdateOpRet(tx.vout.back().scriptPubKey,version,srcpub,tokentagid,updatesupply,data) == 0)
+				return false;
+			break;
+		case 'e':
+			if (DecodeTokenTagEscrowOpRet(tx.vout.back().scriptPubKey,version,srcpub,tokentagid,escrowtxid,updatesupply,data) == 0)
+				return false;
+			break;
+		default:
+			return false;
+	}
+	event.txid = tx.GetHash();
+	event.prevtxid = (tx.vin.size() > 0 && tx.vin[0].prevout.n == 0) ? tx.vin[0].prevout.hash : zeroid;
+	event.batonHash.SetNull();
+	if (tx.vout[0].scriptPubKey.IsPayToCryptoCondition() && Getscriptaddress(batonaddr, tx.vout[0].scriptPubKey))
+		CBitcoinAddress(batonaddr).GetIndexKey(event.batonHash, type, true);
+	return true;
+}
+
+static void TokenTagsBlockEvents(const CBlock &block, const CBlockIndex *pindex, std::vector<std::pair<CTokenTagEventKey, CTokenTagEvent> > &events)
+{
+	struct CCcontract_info *cp,C;
+	cp = CCinit(&C,EVAL_TOKENTAGS);
+
+	for (unsigned int i = 0; i < block.vtx.size(); i++)
+	{
+		uint256 tokentagid;
+		CTokenTagEvent event;
+		if (DecodeTokenTagEvent(cp, block.vtx[i], tokentagid, event))
+			events.push_back(std::make_pair(CTokenTagEventKey(tokentagid, pindex->GetHeight(), i), event));
+	}
+}
+
+bool TokenTagsIndexConnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+	std::vector<std::pair<CTokenTagEventKey, CTokenTagEvent> > events;
+
+	TokenTagsBlockEvents(block, pindex, events);
+	if (events.empty())
+		return true;
+	return pblocktree->WriteTokenTagEvents(events);
+}
+
+bool TokenTagsIndexDisconnectBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+	std::vector<std::pair<CTokenTagEventKey, CTokenTagEvent> > events;
+	std::vector<CTokenTagEventKey> keys;
+
+	TokenTagsBlockEvents(block, pindex, events);
+	if (events.empty())
+		return true;
+	for (const auto &event : events)
+		keys.push_back(event.first);
+	return pblocktree->EraseTokenTagEvents(keys);
+}
+
+// Follows the baton chain of a token tag through the token tags index, from the creation transaction to the latest indexed update
+// that spent the previous baton, adding the updates to chain. Returns false if the index doesn't have the creation transaction.
+static bool FindLatestIndexedTagUpdate(uint256 tokentagid, char *tagCCaddress, CTokenTagEvent &latest, std::vector<uint256> &chain)
+{
+	std::vector<std::pair<CTokenTagEventKey, CTokenTagEvent> > events;
+	uint160 tagHash;
+	int type;
+
+	if (!CBitcoinAddress(tagCCaddress).GetIndexKey(tagHash, type, true) ||
+	!pblocktree->ReadTokenTagEvents(tokentagid, events) || events.empty() || events[0].second.txid != tokentagid)
+		return false;
+
+	// vout0 of a transaction can only be spent once, so the event spending the latest baton is the next one in the chain
+	latest = events[0].second;
+	for (size_t i = 1; i < events.size() && latest.batonHash == tagHash; i++)
+	{
+		if (events[i].second.prevtxid == latest.txid)
+		{
+			latest = events[i].second;
+			chain.push_back(latest.txid);
+		}
+	}
+	return true;
+}
+
 // Finds the function id of the transaction that spent the latest baton for the specified token tag.
 // Returns 'c' if event log baton is unspent, or 0 if token tag with the specified txid couldn't be found.
-// Also returns the txid of the latest update the function found in the latesttxid variable.
-static uint8_t FindLatestTagUpdate(uint256 tokentagid, struct CCcontract_info *cp, uint256 &latesttxid)
+// Also returns the txid of the latest update the function found in the latesttxid variable, and all updates in pchain if it is set.
+static uint8_t FindLatestTagUpdate(uint256 tokentagid, struct CCcontract_info *cp, uint256 &latesttxid, std::vector<uint256> *pchain = nullptr)
 {
 	CTransaction sourcetx, batontx;
 	uint256 hashBlock, batontxid, refagreementtxid;
 	int32_t vini, height, retcode;
-	uint8_t funcid,version,flags;
+	uint8_t funcid = 'c',version,flags;
 	char tagCCaddress[KOMODO_ADDRESS_BUFSIZE], *txidaddr;
 	CPubKey TokenTagspk,tagtxidpk,creatorpub;
 	int64_t tokensupply, updatesupply;
 	uint256 tokenid;
 	std::string name, data;
+	CTokenTagEvent latest;
+	std::vector<uint256> indexed;
 
 	latesttxid = zeroid;
 
@@ -746,6 +850,19 @@ static uint8_t FindLatestTagUpdate(uint256 tokentagid, struct CCcontract_info *c
 		TokenTagspk = GetUnspendable(cp, NULL);
 		tagtxidpk = CCtxidaddr(txidaddr,tokenid);
 		GetCCaddress1of2(cp, tagCCaddress, TokenTagspk, tagtxidpk, true);
+
+		if (pchain != nullptr)
+			pchain->push_back(tokentagid);
+
+		// Skip the confirmed updates found in the token tags index, the rest of the chain is followed below.
+		if (fTokenTagsIndex && !hashBlock.IsNull() && FindLatestIndexedTagUpdate(tokentagid, tagCCaddress, latest, indexed) &&
+		latest.txid != tokentagid && myGetTransactionCCV2(cp, latest.txid, batontx, hashBlock))
+		{
+			sourcetx = batontx;
+			funcid = latest.funcid;
+			if (pchain != nullptr)
+				pchain->insert(pchain->end(), indexed.begin(), indexed.end());
+		}
 		
 		// Iterate through vout0 batons while we're finding valid token tag transactions that spent the last baton.
 		while ((IsTokenTagsvout(cp,sourcetx,0,tagCCaddress) != 0) &&
@@ -758,6 +875,8 @@ static uint8_t FindLatestTagUpdate(uint256 tokentagid, struct CCcontract_info *c
 		(funcid = DecodeTokenTagOpRet(batontx.vout.back().scriptPubKey)) != 0)
 		{
 			sourcetx = batontx;
+			if (pchain != nullptr)
+				pchain->push_back(batontxid);
 		}
 
 		latesttxid = sourcetx.GetHash();
@@ -1304,9 +1423,23 @@ UniValue TokenTagHistory(const uint256 tokentagid,int64_t samplenum,bool bRevers
 	if (myGetTransactionCCV2(cp,tokentagid,tokentagtx,hashBlock) != 0 && (numvouts = tokentagtx.vout.size()) > 0 &&
 	DecodeTokenTagOpRet(tokentagtx.vout[numvouts-1].scriptPubKey) == 'c')
 	{
-		FindLatestTagUpdate(tokentagid, cp, latesttxid);
+		std::vector<uint256> chain;
+		FindLatestTagUpdate(tokentagid, cp, latesttxid, &chain);
 
-		if (latesttxid != tokentagid)
+		// The whole update chain is known from the token tags index, no need to fetch the updates.
+		if (fTokenTagsIndex && latesttxid != tokentagid)
+		{
+			if (bReverse) // from latest event to oldest
+				std::reverse(chain.begin(), chain.end());
+			for (const uint256 &txid : chain)
+			{
+				if (total >= samplenum && samplenum != 0)
+					break;
+				result.push_back(txid.GetHex());
+				total++;
+			}
+		}
+		else if (latesttxid != tokentagid)
 		{
 			if (bReverse) // from latest event to oldest
 				batontxid = latesttxid;
@@ -33,7 +33,7 @@ std::vector<uint8_t> SerializeF(const T f)
 }
 
 template <class T>
-bool DeserializeF(const std::vector<unsigned char> vIn, T f)
+bool DeserializeF(const std::vector<unsigned char>& vIn, T f)
 {
     CDataStream ss(vIn, SER_NETWORK, PROTOCOL_VERSION);
     try {
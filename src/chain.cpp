@@ -20,6 +20,9 @@
 
 #include "chain.h"
 
+#include <algorithm>
+#include <new>
+
 using namespace std;
 
 /**
@@ -76,6 +79,35 @@ const CBlockIndex *CChain::FindFork(const CBlockIndex *pindex) const {
     return pindex;
 }
 
+/**
+ * CChainLogicalTimes implementation
+ */
+void CChainLogicalTimes::SetTip(const CChain &chain) {
+    const CBlockIndex *pindexFork = chain.FindFork(pindexTip);
+    vTimes.resize(pindexFork == NULL ? 0 : pindexFork->GetHeight() + 1);
+    for (int nHeight = vTimes.size(); nHeight <= chain.Height(); nHeight++) {
+        unsigned int nTime = nHeight == 0 ? 0 : chain[nHeight]->nTime;
+        if (nHeight > 0 && nTime <= vTimes[nHeight - 1])
+            nTime = vTimes[nHeight - 1] + 1;
+        vTimes.push_back(nTime);
+    }
+    pindexTip = chain.Tip();
+}
+
+void CChainLogicalTimes::Clear() {
+    vTimes.clear();
+    pindexTip = NULL;
+}
+
+void CChainLogicalTimes::FindRange(unsigned int low, unsigned int high, int &nBegin, int &nEnd) const {
+    nBegin = nEnd = 0;
+    if (vTimes.size() <= 1 || low >= high)
+        return;
+    std::vector<unsigned int>::const_iterator itBegin = std::lower_bound(vTimes.begin() + 1, vTimes.end(), low);
+    nBegin = itBegin - vTimes.begin();
+    nEnd = std::lower_bound(itBegin, vTimes.end(), high) - vTimes.begin();
+}
+
 CChainPower::CChainPower(CBlockIndex *pblockIndex)
 {
      nHeight = pblockIndex->GetHeight();
@@ -177,3 +209,47 @@ void CBlockIndex::BuildSkip()
     if (pprev)
         pskip = pprev->GetAncestor(GetSkipHeight(GetHeight()));
 }
+
+/**
+ * CBlockIndexArena implementation
+ */
+CBlockIndexArena::Entry* CBlockIndexArena::NextEntry()
+{
+    if (nUsed == SLAB_ENTRIES) {
+        vSlabs.push_back(static_cast<Entry*>(::operator new(SLAB_ENTRIES * sizeof(Entry))));
+        nUsed = 0;
+    }
+    return vSlabs.back() + nUsed;
+}
+
+CBlockIndex* CBlockIndexArena::Allocate(const uint256& hash)
+{
+    Entry* pentry = NextEntry();
+    new (&pentry->index) CBlockIndex();
+    new (&pentry->hash) uint256(hash);
+    pentry->index.phashBlock = &pentry->hash;
+    nUsed++;
+    return &pentry->index;
+}
+
+CBlockIndex* CBlockIndexArena::Allocate(const uint256& hash, const CBlockHeader& block)
+{
+    Entry* pentry = NextEntry();
+    new (&pentry->index) CBlockIndex(block);
+    new (&pentry->hash) uint256(hash);
+    pentry->index.phashBlock = &pentry->hash;
+    nUsed++;
+    return &pentry->index;
+}
+
+void CBlockIndexArena::Clear()
+{
+    for (size_t i = 0; i < vSlabs.size(); i++) {
+        size_t nEntries = (i + 1 == vSlabs.size()) ? nUsed : SLAB_ENTRIES;
+        for (size_t j = 0; j < nEntries; j++)
+            vSlabs[i][j].index.~CBlockIndex();
+        ::operator delete(vSlabs[i]);
+    }
+    vSlabs.clear();
+    nUsed = SLAB_ENTRIES;
+}
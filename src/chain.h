@@ -234,7 +234,7 @@ class CChainPower
 class CBlockIndex
 {
 public:
-    //! pointer to the hash of the block, if any. Memory is owned by this CBlockIndex
+    //! pointer to the hash of the block, if any. Memory is owned by CBlockIndexArena for mapBlockIndex entries
     const uint256* phashBlock;
 
     //! pointer to the index of the predecessor of this block
@@ -245,6 +245,12 @@ public:
 
     //! height of the entry in the chain. The genesis block has height 0
     int64_t newcoins,zfunds,sproutfunds,nNotaryPay; int8_t segid; // jl777 fields
+    //! newcoins, zfunds and sproutfunds are known, they are persisted next to the index entry once komodo_coinsupply computed them
+    bool fHaveNewcoins;
+    //! (memory only) sums of newcoins, zfunds and sproutfunds over the chain up to and including this block, valid if fHaveChainSupply
+    int64_t nChainNewcoins, nChainZfunds, nChainSproutfunds; bool fHaveChainSupply;
+    //! coinbase signer and its notary id, persisted next to the index entry so komodo_index2pubkey33 needs no block read. notaryid -2 means not known yet
+    uint8_t pubkey33[33]; int8_t notaryid;
     //! Which # file this block is stored in (blk?????.dat)
     int nFile;
 
@@ -313,8 +319,13 @@ public:
     void SetNull()
     {
         phashBlock = NULL;
-        newcoins = zfunds = 0;
+        newcoins = zfunds = sproutfunds = 0;
+        fHaveNewcoins = false;
+        nChainNewcoins = nChainZfunds = nChainSproutfunds = 0;
+        fHaveChainSupply = false;
         segid = -2;
+        memset(pubkey33,0,sizeof(pubkey33));
+        notaryid = -2;
         nNotaryPay = 0;
         pprev = NULL;
         pskip = NULL;
@@ -594,6 +605,51 @@ public:
     }
 };
 
+/**
+ * Slab allocator for the CBlockIndex entries kept in mapBlockIndex.
+ *
+ * Entries are never freed one at a time, only all at once when the block
+ * index is unloaded, so they are carved out of large contiguous slabs instead
+ * of one heap allocation each. Every entry is stored together with its block
+ * hash and phashBlock points at that copy, so it stays valid regardless of
+ * how the owning map lays out its keys.
+ */
+class CBlockIndexArena
+{
+private:
+    struct Entry {
+        uint256 hash;
+        CBlockIndex index;
+    };
+
+    static const size_t SLAB_ENTRIES = 16384;
+
+    std::vector<Entry*> vSlabs;
+    //! number of entries used in the last slab
+    size_t nUsed;
+
+    //! Storage for the next entry, the caller constructs it and bumps nUsed
+    Entry* NextEntry();
+
+public:
+    CBlockIndexArena() : nUsed(SLAB_ENTRIES) {}
+    ~CBlockIndexArena() { Clear(); }
+
+    //! Construct a new, empty entry for hash
+    CBlockIndex* Allocate(const uint256& hash);
+    //! Construct a new entry for hash initialised from a block header
+    CBlockIndex* Allocate(const uint256& hash, const CBlockHeader& block);
+    //! Destroy every entry handed out so far. All pointers become invalid.
+    void Clear();
+
+    size_t Size() const { return vSlabs.empty() ? 0 : (vSlabs.size() - 1) * SLAB_ENTRIES + nUsed; }
+    size_t DynamicMemoryUsage() const { return vSlabs.size() * SLAB_ENTRIES * sizeof(Entry); }
+
+private:
+    CBlockIndexArena(const CBlockIndexArena&);
+    CBlockIndexArena& operator=(const CBlockIndexArena&);
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain {
 private:
@@ -657,4 +713,33 @@ public:
     const CBlockIndex *FindFork(const CBlockIndex *pindex) const;
 };
 
+/**
+ * The logical timestamps of the blocks of a chain, as the timestamp index has them: the block time, or one more
+ * than the previous logical timestamp when that is not older. They increase with the height, so the blocks of a
+ * time range are found by binary search instead of reading the index.
+ */
+class CChainLogicalTimes {
+private:
+    //! by height, 0 for the genesis block, which is not in the timestamp index
+    std::vector<unsigned int> vTimes;
+    //! the tip of the chain vTimes was built for
+    const CBlockIndex *pindexTip;
+
+public:
+    CChainLogicalTimes() : pindexTip(NULL) {}
+
+    /** Follow chain from its fork with the chain of the last call, the first call builds the whole chain */
+    void SetTip(const CChain &chain);
+
+    /** Forget the chain, before its block index entries are freed */
+    void Clear();
+
+    bool IsEmpty() const { return pindexTip == NULL; }
+
+    unsigned int Get(int nHeight) const { return vTimes[nHeight]; }
+
+    /** The heights [nBegin, nEnd) of the blocks with a logical timestamp in [low, high) */
+    void FindRange(unsigned int low, unsigned int high, int &nBegin, int &nEnd) const;
+};
+
 #endif // BITCOIN_CHAIN_H
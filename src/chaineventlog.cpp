@@ -0,0 +1,85 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "chaineventlog.h"
+
+#include "chain.h"
+#include "primitives/transaction.h"
+
+CChainEventLog chainEventLog;
+
+std::string CChainEvent::TypeName() const
+{
+    switch (type) {
+        case BLOCK_CONNECTED: return "blockconnected";
+        case BLOCK_DISCONNECTED: return "blockdisconnected";
+        case MEMPOOL_ADDED: return "mempooladded";
+        case MEMPOOL_REMOVED: return "mempoolremoved";
+    }
+    return "unknown";
+}
+
+void CChainEventLog::Record(CChainEvent::Type type, const uint256& hash, int nHeight)
+{
+    CChainEvent event;
+    event.type = type;
+    event.hash = hash;
+    event.nHeight = nHeight;
+
+    // announced under the lock so the listeners see the events in sequence order
+    LOCK(cs);
+    event.nSequence = ++nSequence;
+    events.push_back(event);
+    while (events.size() > nMaxSize)
+        events.pop_front();
+    GetMainSignals().ChainEvent(event);
+}
+
+void CChainEventLog::ChainTip(const CBlockIndex *pindex, const CBlock *pblock, SproutMerkleTree sproutTree, SaplingMerkleTree saplingTree, bool added)
+{
+    Record(added ? CChainEvent::BLOCK_CONNECTED : CChainEvent::BLOCK_DISCONNECTED, pindex->GetBlockHash(), pindex->GetHeight());
+}
+
+void CChainEventLog::TransactionAddedToMempool(const CTransaction &tx)
+{
+    Record(CChainEvent::MEMPOOL_ADDED, tx.GetHash(), -1);
+}
+
+void CChainEventLog::TransactionRemovedFromMempool(const CTransaction &tx)
+{
+    Record(CChainEvent::MEMPOOL_REMOVED, tx.GetHash(), -1);
+}
+
+void CChainEventLog::SetMaxSize(size_t nMaxSizeIn)
+{
+    LOCK(cs);
+    nMaxSize = std::max(nMaxSizeIn, (size_t)1);
+    while (events.size() > nMaxSize)
+        events.pop_front();
+}
+
+bool CChainEventLog::GetEventsSince(uint64_t nSince, size_t nMax, std::vector<CChainEvent>& result, uint64_t& nLast) const
+{
+    LOCK(cs);
+    nLast = nSequence;
+    if (events.empty())
+        return nSince >= nSequence;
+    uint64_t nFirst = events.front().nSequence;
+    bool fComplete = nSince + 1 >= nFirst;
+    size_t i = fComplete ? nSince + 1 - nFirst : 0;
+    for (; i < events.size() && result.size() < nMax; i++)
+        result.push_back(events[i]);
+    return fComplete;
+}
@@ -0,0 +1,88 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef KOMODO_CHAINEVENTLOG_H
+#define KOMODO_CHAINEVENTLOG_H
+
+#include "sync.h"
+#include "uint256.h"
+#include "validationinterface.h"
+
+#include <deque>
+#include <stdint.h>
+#include <vector>
+
+/** -chaineventlogsize default, the number of chain events getchainevents can return */
+static const unsigned int DEFAULT_CHAINEVENTLOG_SIZE = 10000;
+
+/** A block connected to or disconnected from the tip or a tx added to or removed from the mempool */
+struct CChainEvent
+{
+    enum Type : unsigned char {
+        BLOCK_CONNECTED = 'C',
+        BLOCK_DISCONNECTED = 'D',
+        MEMPOOL_ADDED = 'A',
+        MEMPOOL_REMOVED = 'R',
+    };
+
+    uint64_t nSequence;
+    Type type;
+    //! the block hash or the txid
+    uint256 hash;
+    //! the height of the block, -1 for a tx
+    int nHeight;
+
+    bool IsBlock() const { return type == BLOCK_CONNECTED || type == BLOCK_DISCONNECTED; }
+    std::string TypeName() const;
+};
+
+/**
+ * Numbers the chain events in the order they happen and keeps the last ones,
+ * so a subscriber of the ZMQ sequence topic that missed a message can fetch
+ * what it missed with getchainevents instead of resyncing the mempool.
+ * Every event is announced with the ChainEvent signal, in sequence order.
+ * Removals of mined txs aren't events, the block connection stands for them.
+ */
+class CChainEventLog : public CValidationInterface
+{
+private:
+    mutable CCriticalSection cs;
+    std::deque<CChainEvent> events;
+    uint64_t nSequence;
+    size_t nMaxSize;
+
+    void Record(CChainEvent::Type type, const uint256& hash, int nHeight);
+
+protected:
+    // CValidationInterface
+    void ChainTip(const CBlockIndex *pindex, const CBlock *pblock, SproutMerkleTree sproutTree, SaplingMerkleTree saplingTree, bool added);
+    void TransactionAddedToMempool(const CTransaction &tx);
+    void TransactionRemovedFromMempool(const CTransaction &tx);
+
+public:
+    CChainEventLog() : nSequence(0), nMaxSize(DEFAULT_CHAINEVENTLOG_SIZE) {}
+
+    void SetMaxSize(size_t nMaxSizeIn);
+    /**
+     * Appends up to nMax events following nSince to result. Returns false if
+     * some of them aren't kept anymore, result then starts with the oldest
+     * event kept. nLast is the sequence number of the last event so far.
+     */
+    bool GetEventsSince(uint64_t nSince, size_t nMax, std::vector<CChainEvent>& result, uint64_t& nLast) const;
+};
+
+extern CChainEventLog chainEventLog;
+
+#endif // KOMODO_CHAINEVENTLOG_H
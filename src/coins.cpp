@@ -99,7 +99,11 @@ bool CCoinsViewBacked::GetStats(CCoinsStats &stats) const { return base->GetStat
 
 CCoinsKeyHasher::CCoinsKeyHasher() : salt(GetRandHash()) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), hasModifier(false), cachedCoinsUsage(0) { }
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), hasModifier(false),
+    cacheCoins(0, CCoinsKeyHasher(), CCoinsMap::key_equal(), CCoinsMap::allocator_type(&cacheCoinsResource)),
+    cacheSproutNullifiers(0, CCoinsKeyHasher(), CNullifiersMap::key_equal(), CNullifiersMap::allocator_type(&cacheSproutNullifiersResource)),
+    cacheSaplingNullifiers(0, CCoinsKeyHasher(), CNullifiersMap::key_equal(), CNullifiersMap::allocator_type(&cacheSaplingNullifiersResource)),
+    cachedCoinsUsage(0) { }
 
 CCoinsViewCache::~CCoinsViewCache()
 {
@@ -107,14 +111,31 @@ CCoinsViewCache::~CCoinsViewCache()
 }
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
-    return memusage::DynamicUsage(cacheCoins) +
+    // the pools hold the nodes and bucket arrays of their maps, as taken from the system
+    return cacheCoinsResource.DynamicMemoryUsage() +
            memusage::DynamicUsage(cacheSproutAnchors) +
            memusage::DynamicUsage(cacheSaplingAnchors) +
-           memusage::DynamicUsage(cacheSproutNullifiers) +
-           memusage::DynamicUsage(cacheSaplingNullifiers) +
+           cacheSproutNullifiersResource.DynamicMemoryUsage() +
+           cacheSaplingNullifiersResource.DynamicMemoryUsage() +
            cachedCoinsUsage;
 }
 
+void CCoinsViewCache::ReallocateCache() {
+    assert(cacheCoins.empty() && cacheSproutNullifiers.empty() && cacheSaplingNullifiers.empty());
+    cacheCoins.~CCoinsMap();
+    cacheSproutNullifiers.~CNullifiersMap();
+    cacheSaplingNullifiers.~CNullifiersMap();
+    cacheCoinsResource.~CCoinsMapResource();
+    cacheSproutNullifiersResource.~CNullifiersMapResource();
+    cacheSaplingNullifiersResource.~CNullifiersMapResource();
+    ::new (&cacheCoinsResource) CCoinsMapResource();
+    ::new (&cacheSproutNullifiersResource) CNullifiersMapResource();
+    ::new (&cacheSaplingNullifiersResource) CNullifiersMapResource();
+    ::new (&cacheCoins) CCoinsMap(0, CCoinsKeyHasher(), CCoinsMap::key_equal(), CCoinsMap::allocator_type(&cacheCoinsResource));
+    ::new (&cacheSproutNullifiers) CNullifiersMap(0, CCoinsKeyHasher(), CNullifiersMap::key_equal(), CNullifiersMap::allocator_type(&cacheSproutNullifiersResource));
+    ::new (&cacheSaplingNullifiers) CNullifiersMap(0, CCoinsKeyHasher(), CNullifiersMap::key_equal(), CNullifiersMap::allocator_type(&cacheSaplingNullifiersResource));
+}
+
 CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256 &txid) const {
     CCoinsMap::iterator it = cacheCoins.find(txid);
     if (it != cacheCoins.end())
@@ -551,6 +572,7 @@ bool CCoinsViewCache::Flush() {
     cacheSproutNullifiers.clear();
     cacheSaplingNullifiers.clear();
     cachedCoinsUsage = 0;
+    ReallocateCache();
     return fOk;
 }
 
@@ -30,6 +30,7 @@
 #include "uint256.h"
 #include "base58.h"
 #include "pubkey.h"
+#include "support/allocators/pool.h"
 
 #include <assert.h>
 #include <stdint.h>
@@ -349,10 +350,27 @@ enum ShieldedType
     SAPLING,
 };
 
-typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher> CCoinsMap;
+/**
+ * The coins and nullifier maps of CCoinsViewCache have their nodes in a
+ * pool, sized for the map nodes with room for the pointers boost adds.
+ * Maps built elsewhere have no pool and allocate as usual.
+ */
+template <typename Entry>
+struct CCoinsPooledMap
+{
+    typedef std::pair<const uint256, Entry> value_type;
+    static const size_t NODE_SIZE_BYTES = sizeof(value_type) + 4 * sizeof(void*);
+    typedef PoolAllocator<value_type, NODE_SIZE_BYTES> allocator_type;
+    typedef typename allocator_type::resource_type resource_type;
+    typedef boost::unordered_map<uint256, Entry, CCoinsKeyHasher, std::equal_to<uint256>, allocator_type> map_type;
+};
+
+typedef CCoinsPooledMap<CCoinsCacheEntry>::map_type CCoinsMap;
+typedef CCoinsPooledMap<CCoinsCacheEntry>::resource_type CCoinsMapResource;
 typedef boost::unordered_map<uint256, CAnchorsSproutCacheEntry, CCoinsKeyHasher> CAnchorsSproutMap;
 typedef boost::unordered_map<uint256, CAnchorsSaplingCacheEntry, CCoinsKeyHasher> CAnchorsSaplingMap;
-typedef boost::unordered_map<uint256, CNullifiersCacheEntry, CCoinsKeyHasher> CNullifiersMap;
+typedef CCoinsPooledMap<CNullifiersCacheEntry>::map_type CNullifiersMap;
+typedef CCoinsPooledMap<CNullifiersCacheEntry>::resource_type CNullifiersMapResource;
 
 struct CCoinsStats
 {
@@ -361,7 +379,8 @@ struct CCoinsStats
     uint64_t nTransactions;
     uint64_t nTransactionOutputs;
     uint64_t nSerializedSize;
-    uint256 hashSerialized;
+    uint256 hashSerialized;  //!< only set by a scan of the whole set
+    uint256 hashMuHash;      //!< the multiset hash of the unspent outputs
     CAmount nTotalAmount;
 
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
@@ -506,6 +525,10 @@ protected:
      * declared as "const". 
      */
     mutable uint256 hashBlock;
+    // the pools are declared before, so destroyed after, their maps
+    CCoinsMapResource cacheCoinsResource;
+    CNullifiersMapResource cacheSproutNullifiersResource;
+    CNullifiersMapResource cacheSaplingNullifiersResource;
     mutable CCoinsMap cacheCoins;
     mutable uint256 hashSproutAnchor;
     mutable uint256 hashSaplingAnchor;
@@ -608,6 +631,9 @@ private:
     CCoinsMap::iterator FetchCoins(const uint256 &txid);
     CCoinsMap::const_iterator FetchCoins(const uint256 &txid) const;
 
+    //! Rebuild the empty coins and nullifier maps on new pools, which gives the memory of the old ones back at once
+    void ReallocateCache();
+
     /**
      * By making the copy constructor private, we prevent accidentally using it when one intends to create a cache on top of a base cache.
      */
@@ -111,7 +111,7 @@ bool DecodeHexTx(CTransaction& tx, const std::string& strHexTx)
         return false;
 
     vector<unsigned char> txData(ParseHex(strHexTx));
-    CDataStream ssData(txData, SER_NETWORK, PROTOCOL_VERSION);
+    CSpanReader ssData(txData, SER_NETWORK, PROTOCOL_VERSION);
     try {
         ssData >> tx;
     }
@@ -128,7 +128,7 @@ bool DecodeHexBlk(CBlock& block, const std::string& strHexBlk)
         return false;
 
     std::vector<unsigned char> blockData(ParseHex(strHexBlk));
-    CDataStream ssBlock(blockData, SER_NETWORK, PROTOCOL_VERSION);
+    CSpanReader ssBlock(blockData, SER_NETWORK, PROTOCOL_VERSION);
     try {
         ssBlock >> block;
     }
@@ -21,6 +21,10 @@
 #include "merkleblock.h"
 
 #include "cc/CCinclude.h"
+#include "sync.h"
+
+#include <map>
+#include <tuple>
 
 /*
  * The crosschain workflow.
@@ -44,9 +48,141 @@
 
 int NOTARISATION_SCAN_LIMIT_BLOCKS = 1440;
 
+
+/*
+ * MoMoM cache
+ *
+ * The result of CalculateProofRoot only depends on the notarisations in the blocks
+ * at and below kmdHeight, so once the block at kmdHeight is known it is fixed and
+ * can be keyed by that block hash. A reorg changes the hash, so stale entries are
+ * never returned and simply age out.
+ */
+typedef std::tuple<std::string, uint32_t, uint256> ProofRootKey;
+
+struct ProofRootEntry
+{
+    std::vector<uint256> moms;
+    uint256 destNotarisationTxid;
+    uint256 MoMoM;
+};
+
+static const size_t PROOFROOT_CACHE_SIZE = 4096;
+static CCriticalSection cs_proofroots;
+static std::map<ProofRootKey, ProofRootEntry> mapProofRoots;
+
+
+static uint256 ScanProofRoot(const char* symbol, uint32_t targetCCid, int kmdHeight,
+        std::vector<uint256> &moms, uint256 &destNotarisationTxid);
+
+
+/*
+ * Checked MoMoM cache
+ *
+ * Every import proven by the same MoMoM makes CheckMoMoM scan the same notarisations,
+ * once when it enters the mempool and again when its block is connected. Whether the
+ * scan matches only depends on the block holding the backnotarisation and the block
+ * holding the matching notarisation, so a match is kept with those two block hashes
+ * and only used while both are still in the active chain.
+ */
+typedef std::pair<uint256, uint256> CheckedMoMoMKey;
+
+struct CheckedMoMoMEntry
+{
+    uint256 backNotarisationBlock;
+    uint256 matchBlock;
+};
+
+static const size_t CHECKEDMOMOM_CACHE_SIZE = 4096;
+static CCriticalSection cs_checkedmomoms;
+static std::map<CheckedMoMoMKey, CheckedMoMoMEntry> mapCheckedMoMoMs;
+
+/*
+ * Merkle tree cache
+ *
+ * A proof is cut from the MoM tree of a notarisation on the assetchain and from the
+ * MoMoM tree of a backnotarisation on KMD, trees every burn proven through them shares.
+ * They are kept by root and number of leaves, which the same leaves always give, and
+ * only after the root built matched the one notarised. A branch cut from a kept tree is
+ * checked like a freshly built one.
+ */
+typedef std::pair<uint256, int> MerkleTreeKey;
+
+static const size_t MERKLETREE_CACHE_SIZE = 1024;
+static CCriticalSection cs_merkletrees;
+static std::map<MerkleTreeKey, std::vector<uint256> > mapMerkleTrees;
+
+static bool GetCachedMerkleBranch(const uint256 &root, int nLeaves, int nIndex, std::vector<uint256> &branch)
+{
+    LOCK(cs_merkletrees);
+    std::map<MerkleTreeKey, std::vector<uint256> >::const_iterator it = mapMerkleTrees.find(MerkleTreeKey(root, nLeaves));
+    if (it == mapMerkleTrees.end())
+        return false;
+    branch = GetMerkleBranch(nIndex, nLeaves, it->second);
+    return true;
+}
+
+static std::vector<uint256> BuildMerkleBranch(const uint256 &root, const std::vector<uint256> &leaves, int nIndex)
+{
+    std::vector<uint256> tree;
+    bool fMutated;
+    bool fMatch = !leaves.empty() && BuildMerkleTree(&fMutated, leaves, tree) == root;
+    std::vector<uint256> branch = GetMerkleBranch(nIndex, leaves.size(), tree);
+    if (fMatch) {
+        LOCK(cs_merkletrees);
+        if (mapMerkleTrees.size() >= MERKLETREE_CACHE_SIZE)
+            mapMerkleTrees.erase(mapMerkleTrees.begin());
+        mapMerkleTrees[MerkleTreeKey(root, leaves.size())].swap(tree);
+    }
+    return branch;
+}
+
+static int ActiveBlockHeight(const uint256 &hash)
+{
+    BlockMap::const_iterator mi = mapBlockIndex.find(hash);
+    if (mi == mapBlockIndex.end() || mi->second == NULL || !chainActive.Contains(mi->second))
+        return -1;
+    return mi->second->GetHeight();
+}
+
 /* On KMD */
 uint256 CalculateProofRoot(const char* symbol, uint32_t targetCCid, int kmdHeight,
         std::vector<uint256> &moms, uint256 &destNotarisationTxid)
+{
+    if (targetCCid < 2)
+        return uint256();
+
+    if (kmdHeight < 0 || kmdHeight > chainActive.Height())
+        return uint256();
+
+    ProofRootKey key(symbol, targetCCid, *chainActive[kmdHeight]->phashBlock);
+    {
+        LOCK(cs_proofroots);
+        std::map<ProofRootKey, ProofRootEntry>::const_iterator it = mapProofRoots.find(key);
+        if (it != mapProofRoots.end()) {
+            moms = it->second.moms;
+            destNotarisationTxid = it->second.destNotarisationTxid;
+            return it->second.MoMoM;
+        }
+    }
+
+    uint256 MoMoM = ScanProofRoot(symbol, targetCCid, kmdHeight, moms, destNotarisationTxid);
+
+    // Only determinate MoMoMs are worth keeping
+    if (!MoMoM.IsNull()) {
+        LOCK(cs_proofroots);
+        if (mapProofRoots.size() >= PROOFROOT_CACHE_SIZE)
+            mapProofRoots.erase(mapProofRoots.begin());
+        ProofRootEntry &entry = mapProofRoots[key];
+        entry.moms = moms;
+        entry.destNotarisationTxid = destNotarisationTxid;
+        entry.MoMoM = MoMoM;
+    }
+    return MoMoM;
+}
+
+
+static uint256 ScanProofRoot(const char* symbol, uint32_t targetCCid, int kmdHeight,
+        std::vector<uint256> &moms, uint256 &destNotarisationTxid)
 {
     /*
      * Notaries don't wait for confirmation on KMD before performing a backnotarisation,
@@ -59,12 +195,6 @@ uint256 CalculateProofRoot(const char* symbol, uint32_t targetCCid, int kmdHeigh
      *        > scan backwards >
      */
 
-    if (targetCCid < 2)
-        return uint256();
-
-    if (kmdHeight < 0 || kmdHeight > chainActive.Height())
-        return uint256();
-
     int seenOwnNotarisations = 0, i = 0;
 
     int authority = GetSymbolAuthority(symbol);
@@ -142,6 +272,36 @@ int ScanNotarisationsFromHeight(int nHeight, const IsTarget f, Notarisation &fou
 }
 
 
+/*
+ * As above, for targets that only match notarisations of symbol. Only the
+ * blocks holding such a notarisation are read, found by the height index.
+ */
+template <typename IsTarget>
+int ScanNotarisationsFromHeight(int nHeight, const char* symbol, const IsTarget f, Notarisation &found)
+{
+    if (!pnotarisations->fHeightIndex)
+        return ScanNotarisationsFromHeight(nHeight, f, found);
+
+    int limit = std::min(nHeight + NOTARISATION_SCAN_LIMIT_BLOCKS, chainActive.Height());
+    int h = std::max(nHeight, 1);
+    uint256 blockHash;
+
+    while (h < limit && (h = SeekNotarisationHeight(h, symbol, true, limit-1, blockHash)) > 0) {
+        NotarisationsInBlock notarisations;
+
+        if (GetBlockNotarisations(blockHash, notarisations)) {
+            BOOST_FOREACH(found, notarisations) {
+                if (f(found)) {
+                    return h;
+                }
+            }
+        }
+        h++;
+    }
+    return 0;
+}
+
+
 /* On KMD */
 TxProof GetCrossChainProof(const uint256 txid, const char* targetSymbol, uint32_t targetCCid,
         const TxProof assetChainProof, int32_t offset)
@@ -176,7 +336,7 @@ TxProof GetCrossChainProof(const uint256 txid, const char* targetSymbol, uint32_
     auto isTarget = [&](Notarisation &nota) {
         return strcmp(nota.second.symbol, targetSymbol) == 0;
     };
-    kmdHeight = ScanNotarisationsFromHeight(kmdHeight, isTarget, nota);
+    kmdHeight = ScanNotarisationsFromHeight(kmdHeight, targetSymbol, isTarget, nota);
     if (!kmdHeight)
         throw std::runtime_error("Cannot find notarisation for target inclusive of source");
         
@@ -201,16 +361,8 @@ cont:
 
     // Create a branch
     std::vector<uint256> vBranch;
-    {
-        CBlock fakeBlock;
-        for (int i=0; i<moms.size(); i++) {
-            CTransaction fakeTx;
-            // first value in CTransaction memory is it's hash
-            memcpy((void*)&fakeTx, moms[i].begin(), 32);
-            fakeBlock.vtx.push_back(fakeTx);
-        }
-        vBranch = fakeBlock.GetMerkleBranch(nIndex);
-    }
+    if (!GetCachedMerkleBranch(MoMoM, moms.size(), nIndex, vBranch))
+        vBranch = BuildMerkleBranch(MoMoM, moms, nIndex);
 
     // Concatenate branches
     MerkleBranch newBranch = assetChainProof.second;
@@ -275,7 +427,7 @@ bool GetNextBacknotarisation(uint256 kmdNotarisationTxid, Notarisation &out)
         return false;
     }
 
-    return (bool) ScanNotarisationsFromHeight(block.GetHeight()+1, &IsSameAssetChain, out);
+    return (bool) ScanNotarisationsFromHeight(block.GetHeight()+1, ASSETCHAINS_SYMBOL, &IsSameAssetChain, out);
 }
 
 
@@ -288,6 +440,19 @@ bool CheckMoMoM(uint256 kmdNotarisationHash, uint256 momom)
      * This is a sledgehammer approach...
      */
 
+    CheckedMoMoMKey key(kmdNotarisationHash, momom);
+    {
+        LOCK(cs_checkedmomoms);
+        std::map<CheckedMoMoMKey, CheckedMoMoMEntry>::const_iterator it = mapCheckedMoMoMs.find(key);
+        if (it != mapCheckedMoMoMs.end()) {
+            // the scan stops short of the tip, so must the match
+            int matchHeight = ActiveBlockHeight(it->second.matchBlock);
+            if (ActiveBlockHeight(it->second.backNotarisationBlock) >= 0 &&
+                    matchHeight >= 0 && matchHeight < chainActive.Height())
+                return true;
+        }
+    }
+
     Notarisation bn;
     if (!GetBackNotarisation(kmdNotarisationHash, bn))
         return false;
@@ -306,8 +471,18 @@ bool CheckMoMoM(uint256 kmdNotarisationHash, uint256 momom)
         return nota.second.MoMoM == momom;
     };
 
-    return (bool) ScanNotarisationsFromHeight(block.GetHeight()-100, checkMoMoM, nota);
+    int matchHeight = ScanNotarisationsFromHeight(block.GetHeight()-100, checkMoMoM, nota);
+    if (!matchHeight)
+        return false;
 
+    // Failures are not kept, the backnotarisation may just not have arrived yet
+    LOCK(cs_checkedmomoms);
+    if (mapCheckedMoMoMs.size() >= CHECKEDMOMOM_CACHE_SIZE)
+        mapCheckedMoMoMs.erase(mapCheckedMoMoMs.begin());
+    CheckedMoMoMEntry &entry = mapCheckedMoMoMs[key];
+    entry.backNotarisationBlock = block.GetBlockHash();
+    entry.matchBlock = chainActive[matchHeight]->GetBlockHash();
+    return true;
 }
 
 /*
@@ -446,7 +621,7 @@ TxProof GetAssetchainProof(uint256 hash,CTransaction burnTx)
             if (!IsSameAssetChain(nota)) return false;
             return nota.second.height >= blockIndex->GetHeight();
         };
-        if (!ScanNotarisationsFromHeight(blockIndex->GetHeight(), isTarget, nota))
+        if (!ScanNotarisationsFromHeight(blockIndex->GetHeight(), ASSETCHAINS_SYMBOL, isTarget, nota))
             throw std::runtime_error("backnotarisation not yet confirmed");
 
         // index of block in MoM leaves
@@ -454,22 +629,20 @@ TxProof GetAssetchainProof(uint256 hash,CTransaction burnTx)
     }
 
     // build merkle chain from blocks to MoM
+    if (!GetCachedMerkleBranch(nota.second.MoM, nota.second.MoMDepth, nIndex, branch))
     {
-        std::vector<uint256> leaves, tree;
+        std::vector<uint256> leaves;
         for (int i=0; i<nota.second.MoMDepth; i++) {
             uint256 mRoot = chainActive[nota.second.height - i]->hashMerkleRoot;
             leaves.push_back(mRoot);
         }
-        bool fMutated;
-        BuildMerkleTree(&fMutated, leaves, tree);
-        branch = GetMerkleBranch(nIndex, leaves.size(), tree);
-
-        // Check branch
-        uint256 ourResult = SafeCheckMerkleBranch(blockIndex->hashMerkleRoot, branch, nIndex);
-        if (nota.second.MoM != ourResult)
-            throw std::runtime_error("Failed merkle block->MoM");
+        branch = BuildMerkleBranch(nota.second.MoM, leaves, nIndex);
     }
 
+    // Check branch
+    if (nota.second.MoM != SafeCheckMerkleBranch(blockIndex->hashMerkleRoot, branch, nIndex))
+        throw std::runtime_error("Failed merkle block->MoM");
+
     // Now get the tx merkle branch
     {
         CBlock block;
@@ -0,0 +1,197 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "crypto/blake2b.h"
+#include "crypto/common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__amd64__)
+namespace blake2b_avx2
+{
+void Compress_4way(uint64_t* out, const uint64_t* h, const unsigned char* blocks, uint64_t t);
+}
+#endif
+
+namespace
+{
+
+const uint64_t IV[8] = {
+    0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull, 0x3c6ef372fe94f82bull, 0xa54ff53a5f1d36f1ull,
+    0x510e527fade682d1ull, 0x9b05688c2b3e6c1full, 0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull
+};
+
+const uint8_t SIGMA[12][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3}
+};
+
+uint64_t inline Rot(uint64_t x, int n) { return (x >> n) | (x << (64 - n)); }
+
+void inline G(uint64_t* v, int a, int b, int c, int d, uint64_t x, uint64_t y)
+{
+    v[a] = v[a] + v[b] + x; v[d] = Rot(v[d] ^ v[a], 32);
+    v[c] = v[c] + v[d];     v[b] = Rot(v[b] ^ v[c], 24);
+    v[a] = v[a] + v[b] + y; v[d] = Rot(v[d] ^ v[a], 16);
+    v[c] = v[c] + v[d];     v[b] = Rot(v[b] ^ v[c], 63);
+}
+
+/** Compresses block into h, t counts the bytes up to the end of block */
+void Compress(uint64_t* h, const unsigned char* block, uint64_t t, bool last)
+{
+    uint64_t m[16], v[16];
+    for (int i = 0; i < 16; i++)
+        m[i] = ReadLE64(block + 8 * i);
+    for (int i = 0; i < 8; i++) {
+        v[i] = h[i];
+        v[i + 8] = IV[i];
+    }
+    v[12] ^= t;
+    if (last)
+        v[14] = ~v[14];
+    for (int r = 0; r < 12; r++) {
+        const uint8_t* s = SIGMA[r];
+        G(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+        G(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+        G(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+        G(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+        G(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+        G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+        G(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+        G(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+    }
+    for (int i = 0; i < 8; i++)
+        h[i] ^= v[i] ^ v[i + 8];
+}
+
+void WriteOutput(unsigned char* out, const uint64_t* h, size_t outlen)
+{
+    unsigned char full[CBlake2bPrefix::OUTPUT_SIZE];
+    for (int i = 0; i < 8; i++)
+        WriteLE64(full + 8 * i, h[i]);
+    memcpy(out, full, outlen);
+}
+
+typedef void (*Compress4Type)(uint64_t*, const uint64_t*, const unsigned char*, uint64_t);
+
+/** The 4 way kernel if the cpu has AVX2 and it matches the scalar compression */
+Compress4Type DetectCompress4()
+{
+#if (defined(__x86_64__) || defined(__amd64__)) && defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) {
+        unsigned char blocks[4 * CBlake2bPrefix::BLOCK_SIZE];
+        uint64_t out[4 * 8], expected[8];
+        for (size_t i = 0; i < sizeof(blocks); i++)
+            blocks[i] = (unsigned char)(i * 13 + 5);
+        blake2b_avx2::Compress_4way(out, IV, blocks, 77);
+        for (int j = 0; j < 4; j++) {
+            memcpy(expected, IV, sizeof(expected));
+            Compress(expected, blocks + j * CBlake2bPrefix::BLOCK_SIZE, 77, true);
+            assert(memcmp(expected, out + 8 * j, sizeof(expected)) == 0);
+        }
+        return blake2b_avx2::Compress_4way;
+    }
+#endif
+    return NULL;
+}
+
+} // namespace
+
+CBlake2bPrefix::CBlake2bPrefix(size_t outlenIn, const unsigned char personal[PERSONAL_SIZE]) : t(0), buflen(0), outlen(outlenIn)
+{
+    assert(outlen > 0 && outlen <= OUTPUT_SIZE);
+    memcpy(h, IV, sizeof(h));
+    h[0] ^= 0x01010000ull | outlen; // fanout and depth 1, no key
+    h[6] ^= ReadLE64(personal);
+    h[7] ^= ReadLE64(personal + 8);
+}
+
+CBlake2bPrefix& CBlake2bPrefix::Write(const unsigned char* data, size_t len)
+{
+    while (len > 0) {
+        if (buflen == BLOCK_SIZE) {
+            // more data follows, so this block is not the last one
+            t += BLOCK_SIZE;
+            Compress(h, buf, t, false);
+            buflen = 0;
+        }
+        size_t n = BLOCK_SIZE - buflen < len ? BLOCK_SIZE - buflen : len;
+        memcpy(buf + buflen, data, n);
+        buflen += n;
+        data += n;
+        len -= n;
+    }
+    return *this;
+}
+
+void CBlake2bPrefix::FinalizeIndices(const uint32_t* indices, size_t n, unsigned char* out) const
+{
+    static const Compress4Type compress4 = DetectCompress4();
+    size_t i = 0;
+
+    if (buflen + sizeof(uint32_t) <= BLOCK_SIZE) {
+        // the index fits in the last block, each hash is a single compression
+        uint64_t tlast = t + buflen + sizeof(uint32_t);
+        if (compress4 != NULL) {
+            unsigned char blocks[4 * BLOCK_SIZE];
+            uint64_t hs[4 * 8];
+            memset(blocks, 0, sizeof(blocks));
+            for (int j = 0; j < 4; j++)
+                memcpy(blocks + j * BLOCK_SIZE, buf, buflen);
+            for (; i + 4 <= n; i += 4) {
+                for (int j = 0; j < 4; j++)
+                    WriteLE32(blocks + j * BLOCK_SIZE + buflen, indices[i + j]);
+                compress4(hs, h, blocks, tlast);
+                for (int j = 0; j < 4; j++)
+                    WriteOutput(out + (i + j) * outlen, hs + 8 * j, outlen);
+            }
+        }
+        unsigned char block[BLOCK_SIZE];
+        memset(block, 0, sizeof(block));
+        memcpy(block, buf, buflen);
+        for (; i < n; i++) {
+            uint64_t hi[8];
+            memcpy(hi, h, sizeof(hi));
+            WriteLE32(block + buflen, indices[i]);
+            Compress(hi, block, tlast, true);
+            WriteOutput(out + i * outlen, hi, outlen);
+        }
+        return;
+    }
+
+    // the index spills over into one more block
+    for (; i < n; i++) {
+        unsigned char tail[2 * BLOCK_SIZE];
+        uint64_t hi[8];
+        memset(tail, 0, sizeof(tail));
+        memcpy(tail, buf, buflen);
+        WriteLE32(tail + buflen, indices[i]);
+        memcpy(hi, h, sizeof(hi));
+        Compress(hi, tail, t + BLOCK_SIZE, false);
+        Compress(hi, tail + BLOCK_SIZE, t + buflen + sizeof(uint32_t), true);
+        WriteOutput(out + i * outlen, hi, outlen);
+    }
+}
@@ -0,0 +1,53 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef KOMODO_CRYPTO_BLAKE2B_H
+#define KOMODO_CRYPTO_BLAKE2B_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Personalised Blake2b of a prefix followed by a 4 byte little endian index,
+ * the hashes Equihash takes of a header for each index of a solution. Every
+ * block of the prefix that can't be the last one is compressed when it is
+ * written, so a copy of the state per header shares that work between all the
+ * indices, and a hash with a short tail costs a single compression.
+ * FinalizeIndices runs 4 of those at once on cpus that have AVX2.
+ */
+class CBlake2bPrefix
+{
+public:
+    static const size_t BLOCK_SIZE = 128;
+    static const size_t PERSONAL_SIZE = 16;
+    static const size_t OUTPUT_SIZE = 64;
+
+private:
+    uint64_t h[8];
+    uint64_t t; // bytes compressed so far
+    unsigned char buf[BLOCK_SIZE];
+    size_t buflen;
+    size_t outlen;
+
+public:
+    CBlake2bPrefix(size_t outlenIn, const unsigned char personal[PERSONAL_SIZE]);
+
+    CBlake2bPrefix& Write(const unsigned char* data, size_t len);
+    /** Writes outlen bytes to out for each of the n indices, in their order */
+    void FinalizeIndices(const uint32_t* indices, size_t n, unsigned char* out) const;
+    size_t OutputLength() const { return outlen; }
+};
+
+#endif // KOMODO_CRYPTO_BLAKE2B_H
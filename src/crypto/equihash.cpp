@@ -98,6 +98,19 @@ int Equihash<N,K>::InitialiseState(eh_HashState& base_state)
                                                          personalization);
 }
 
+template<unsigned int N, unsigned int K>
+CBlake2bPrefix Equihash<N,K>::InitialisePrefix()
+{
+    uint32_t le_N = htole32(N);
+    uint32_t le_K = htole32(K);
+
+    unsigned char personalization[CBlake2bPrefix::PERSONAL_SIZE] = {};
+    memcpy(personalization, "ZcashPoW", 8);
+    memcpy(personalization+8,  &le_N, 4);
+    memcpy(personalization+12, &le_K, 4);
+    return CBlake2bPrefix(HashOutput, personalization);
+}
+
 void GenerateHash(const eh_HashState& base_state, eh_index g,
                   unsigned char* hash, size_t hLen, size_t N)
 {
@@ -822,7 +835,38 @@ bool Equihash<N,K>::IsValidSolution(const eh_HashState& base_state, std::vector<
         X.emplace_back(tmpHash+((i % IndicesPerHashOutput) * GetSizeInBytes(N)),
                        GetSizeInBytes(N), HashLength, CollisionBitLength, i);
     }
+    return IsValidTree(X);
+}
+
+template<unsigned int N, unsigned int K>
+bool Equihash<N,K>::IsValidSolution(const CBlake2bPrefix& prefix, std::vector<unsigned char> soln)
+{
+    assert(ASSETCHAINS_NK[0] == 0 && ASSETCHAINS_NK[1] == 0);
+    if (soln.size() != SolutionWidth) {
+        LogPrint("pow", "Invalid solution length: %d (expected %d)\n",
+                 soln.size(), SolutionWidth);
+        return false;
+    }
+
+    std::vector<eh_index> indices = GetIndicesFromMinimal(soln, CollisionBitLength);
+    std::vector<uint32_t> hashIndices(indices.size());
+    for (size_t j = 0; j < indices.size(); j++)
+        hashIndices[j] = indices[j] / IndicesPerHashOutput;
+    std::vector<unsigned char> hashes(indices.size() * HashOutput);
+    prefix.FinalizeIndices(hashIndices.data(), hashIndices.size(), hashes.data());
 
+    std::vector<FullStepRow<FinalFullWidth>> X;
+    X.reserve(1 << K);
+    for (size_t j = 0; j < indices.size(); j++) {
+        X.emplace_back(&hashes[j * HashOutput] + ((indices[j] % IndicesPerHashOutput) * GetSizeInBytes(N)),
+                       GetSizeInBytes(N), HashLength, CollisionBitLength, indices[j]);
+    }
+    return IsValidTree(X);
+}
+
+template<unsigned int N, unsigned int K>
+bool Equihash<N,K>::IsValidTree(std::vector<FullStepRow<FinalFullWidth>>& X)
+{
     size_t hashLen = HashLength;
     size_t lenIndices = sizeof(eh_index);
     while (X.size() > 1) {
@@ -864,6 +908,8 @@ template bool Equihash<200,9>::OptimisedSolve(const eh_HashState& base_state,
                                               const std::function<bool(EhSolverCancelCheck)> cancelled);
 #endif
 template bool Equihash<200,9>::IsValidSolution(const eh_HashState& base_state, std::vector<unsigned char> soln);
+template bool Equihash<200,9>::IsValidSolution(const CBlake2bPrefix& prefix, std::vector<unsigned char> soln);
+template CBlake2bPrefix Equihash<200,9>::InitialisePrefix();
                                               
 // Explicit instantiations for Equihash<96,3>
 template int Equihash<150,5>::InitialiseState(eh_HashState& base_state);
@@ -876,6 +922,8 @@ template bool Equihash<150,5>::OptimisedSolve(const eh_HashState& base_state,
                                              const std::function<bool(EhSolverCancelCheck)> cancelled);
 #endif
 template bool Equihash<150,5>::IsValidSolution(const eh_HashState& base_state, std::vector<unsigned char> soln);
+template bool Equihash<150,5>::IsValidSolution(const CBlake2bPrefix& prefix, std::vector<unsigned char> soln);
+template CBlake2bPrefix Equihash<150,5>::InitialisePrefix();
 
 // Explicit instantiations for Equihash<48,5>
 template int Equihash<144,5>::InitialiseState(eh_HashState& base_state);
@@ -888,6 +936,8 @@ template bool Equihash<144,5>::OptimisedSolve(const eh_HashState& base_state,
                                              const std::function<bool(EhSolverCancelCheck)> cancelled);
 #endif
 template bool Equihash<144,5>::IsValidSolution(const eh_HashState& base_state, std::vector<unsigned char> soln);
+template bool Equihash<144,5>::IsValidSolution(const CBlake2bPrefix& prefix, std::vector<unsigned char> soln);
+template CBlake2bPrefix Equihash<144,5>::InitialisePrefix();
 
 // Explicit instantiations for Equihash<96,5>
 template int Equihash<ASSETCHAINS_N,ASSETCHAINS_K>::InitialiseState(eh_HashState& base_state);
@@ -900,6 +950,8 @@ template bool Equihash<ASSETCHAINS_N,ASSETCHAINS_K>::OptimisedSolve(const eh_Has
                                              const std::function<bool(EhSolverCancelCheck)> cancelled);
 #endif
 template bool Equihash<ASSETCHAINS_N,ASSETCHAINS_K>::IsValidSolution(const eh_HashState& base_state, std::vector<unsigned char> soln);
+template bool Equihash<ASSETCHAINS_N,ASSETCHAINS_K>::IsValidSolution(const CBlake2bPrefix& prefix, std::vector<unsigned char> soln);
+template CBlake2bPrefix Equihash<ASSETCHAINS_N,ASSETCHAINS_K>::InitialisePrefix();
 
 // Explicit instantiations for Equihash<96,5>
 template int Equihash<48,5>::InitialiseState(eh_HashState& base_state);
@@ -912,6 +964,8 @@ template bool Equihash<48,5>::OptimisedSolve(const eh_HashState& base_state,
                                              const std::function<bool(EhSolverCancelCheck)> cancelled);
 #endif
 template bool Equihash<48,5>::IsValidSolution(const eh_HashState& base_state, std::vector<unsigned char> soln);
+template bool Equihash<48,5>::IsValidSolution(const CBlake2bPrefix& prefix, std::vector<unsigned char> soln);
+template CBlake2bPrefix Equihash<48,5>::InitialisePrefix();
 
 // Explicit instantiations for Equihash<48,5>
 template int Equihash<210,9>::InitialiseState(eh_HashState& base_state);
@@ -924,3 +978,5 @@ template bool Equihash<210,9>::OptimisedSolve(const eh_HashState& base_state,
                                              const std::function<bool(EhSolverCancelCheck)> cancelled);
 #endif
 template bool Equihash<210,9>::IsValidSolution(const eh_HashState& base_state, std::vector<unsigned char> soln);
+template bool Equihash<210,9>::IsValidSolution(const CBlake2bPrefix& prefix, std::vector<unsigned char> soln);
+template CBlake2bPrefix Equihash<210,9>::InitialisePrefix();
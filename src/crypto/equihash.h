@@ -6,6 +6,7 @@
 #ifndef BITCOIN_EQUIHASH_H
 #define BITCOIN_EQUIHASH_H
 
+#include "crypto/blake2b.h"
 #include "crypto/sha256.h"
 #include "utilstrencodings.h"
 
@@ -192,6 +193,8 @@ public:
     Equihash() { }
 
     int InitialiseState(eh_HashState& base_state);
+    /** The personalised Blake2b state to write I||V to, for the IsValidSolution taking it */
+    CBlake2bPrefix InitialisePrefix();
 #ifdef ENABLE_MINING
     bool BasicSolve(const eh_HashState& base_state,
                     const std::function<bool(const std::vector<unsigned char>&)> validBlock,
@@ -201,6 +204,11 @@ public:
                         const std::function<bool(EhSolverCancelCheck)> cancelled);
 #endif
     bool IsValidSolution(const eh_HashState& base_state, std::vector<unsigned char> soln);
+    /** Same check with the hashes of all the indices of soln computed in one batch, not for ASSETCHAINS_NK chains */
+    bool IsValidSolution(const CBlake2bPrefix& prefix, std::vector<unsigned char> soln);
+
+private:
+    bool IsValidTree(std::vector<FullStepRow<FinalFullWidth>>& X);
 };
 
 #include "equihash.tcc"
@@ -311,4 +319,23 @@ inline bool EhOptimisedSolveUncancellable(unsigned int n, unsigned int k, const
         throw std::invalid_argument("Unsupported Equihash parameters"); \
     }
 
+inline CBlake2bPrefix EhInitialisePrefix(unsigned int n, unsigned int k)
+{
+    if (n == 200 && k == 9) {
+        return Eh200_9.InitialisePrefix();
+    } else if (n == 150 && k == 5) {
+        return Eh150_5.InitialisePrefix();
+    } else if (n == 144 && k == 5) {
+        return Eh144_5.InitialisePrefix();
+    } else if (n == ASSETCHAINS_N && k == ASSETCHAINS_K) {
+        return Eh96_5.InitialisePrefix();
+    } else if (n == 48 && k == 5) {
+        return Eh48_5.InitialisePrefix();
+    } else if (n == 210 && k == 9) {
+        return Eh210_9.InitialisePrefix();
+    } else {
+        throw std::invalid_argument("Unsupported Equihash parameters");
+    }
+}
+
 #endif // BITCOIN_EQUIHASH_H
@@ -0,0 +1,153 @@
+// Copyright (c) 2017-2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+
+#include <string.h>
+
+namespace {
+
+/** 2^3072 - MAX_PRIME_DIFF is the modulus */
+const uint32_t MAX_PRIME_DIFF = 1103717;
+
+/** Add n * MAX_PRIME_DIFF to limbs, returning the carry out of the top limb */
+uint32_t AddPrimeDiff(uint32_t* limbs, uint64_t n)
+{
+    uint64_t carry = n * MAX_PRIME_DIFF;
+    for (int i = 0; i < Num3072::LIMBS && carry != 0; i++) {
+        carry += limbs[i];
+        limbs[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    return (uint32_t)carry;
+}
+
+}
+
+Num3072::Num3072(const unsigned char* data)
+{
+    for (int i = 0; i < LIMBS; i++)
+        limbs[i] = ReadLE32(data + 4 * i);
+    if (IsOverflow())
+        FullReduce();
+}
+
+void Num3072::SetToOne()
+{
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; i++)
+        limbs[i] = 0;
+}
+
+bool Num3072::IsOverflow() const
+{
+    if (limbs[0] <= 0xFFFFFFFFU - MAX_PRIME_DIFF)
+        return false;
+    for (int i = 1; i < LIMBS; i++)
+        if (limbs[i] != 0xFFFFFFFFU)
+            return false;
+    return true;
+}
+
+void Num3072::FullReduce()
+{
+    // subtracting the modulus is adding MAX_PRIME_DIFF and dropping 2^3072
+    AddPrimeDiff(limbs, 1);
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    uint32_t product[2 * LIMBS];
+
+    memset(product, 0, sizeof(product));
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < LIMBS; j++) {
+            carry += (uint64_t)limbs[i] * a.limbs[j] + product[i + j];
+            product[i + j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        product[i + LIMBS] = (uint32_t)carry;
+    }
+
+    // 2^3072 is MAX_PRIME_DIFF modulo the prime: fold the high half into the low one
+    uint64_t carry = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        carry += (uint64_t)product[i + LIMBS] * MAX_PRIME_DIFF + product[i];
+        limbs[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    while (carry != 0)
+        carry = AddPrimeDiff(limbs, carry);
+    if (IsOverflow())
+        FullReduce();
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // Fermat: a^-1 = a^(p - 2), where p - 2 is all ones but for its lowest limb
+    const uint32_t nLowLimb = 0xFFFFFFFFU - MAX_PRIME_DIFF - 1;
+    Num3072 result;
+
+    for (int i = LIMBS - 1; i >= 0; i--) {
+        uint32_t exp = i == 0 ? nLowLimb : 0xFFFFFFFFU;
+        for (int bit = 31; bit >= 0; bit--) {
+            result.Multiply(result);
+            if ((exp >> bit) & 1)
+                result.Multiply(*this);
+        }
+    }
+    return result;
+}
+
+void Num3072::ToBytes(unsigned char* out) const
+{
+    for (int i = 0; i < LIMBS; i++)
+        WriteLE32(out + 4 * i, limbs[i]);
+}
+
+Num3072 MuHash3072::ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    unsigned char bytes[Num3072::BYTE_SIZE];
+
+    // expand the SHA256 of the element to 3072 bits in counter mode
+    CSHA256().Write(data, len).Finalize(hash);
+    for (size_t i = 0; i < Num3072::BYTE_SIZE / CSHA256::OUTPUT_SIZE; i++) {
+        unsigned char counter[4];
+        WriteLE32(counter, (uint32_t)i);
+        CSHA256().Write(hash, sizeof(hash)).Write(counter, sizeof(counter)).Finalize(bytes + i * CSHA256::OUTPUT_SIZE);
+    }
+    return Num3072(bytes);
+}
+
+void MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    numerator.Multiply(ToNum3072(data, len));
+}
+
+void MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    denominator.Multiply(ToNum3072(data, len));
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul)
+{
+    numerator.Multiply(mul.numerator);
+    denominator.Multiply(mul.denominator);
+    return *this;
+}
+
+void MuHash3072::Finalize(unsigned char hash[OUTPUT_SIZE]) const
+{
+    unsigned char bytes[Num3072::BYTE_SIZE];
+    Num3072 result = numerator;
+
+    result.Multiply(denominator.GetInverse());
+    result.ToBytes(bytes);
+    CSHA256().Write(bytes, sizeof(bytes)).Finalize(hash);
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2017-2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** A number modulo the prime 2^3072 - 1103717, in 32-bit little-endian limbs. */
+class Num3072
+{
+public:
+    static const size_t BYTE_SIZE = 384;
+    static const int LIMBS = 96;
+
+    uint32_t limbs[LIMBS];
+
+    Num3072() { SetToOne(); }
+    //! from BYTE_SIZE little-endian bytes
+    explicit Num3072(const unsigned char* data);
+
+    void SetToOne();
+    void Multiply(const Num3072& a);
+    Num3072 GetInverse() const;
+    //! BYTE_SIZE little-endian bytes of the reduced number
+    void ToBytes(unsigned char* out) const;
+
+private:
+    bool IsOverflow() const;
+    void FullReduce();
+};
+
+/**
+ * A multiset hash: the hash of a set of elements that is updated by adding and
+ * removing single elements, in any order, each in constant time.
+ *
+ * Elements are hashed to numbers modulo a 3072-bit prime, the set is their
+ * product. Removed elements are multiplied into a denominator instead of being
+ * divided out, so that the one inversion is made by Finalize.
+ */
+class MuHash3072
+{
+private:
+    Num3072 numerator;
+    Num3072 denominator;
+
+    static Num3072 ToNum3072(const unsigned char* data, size_t len);
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+
+    //! the hash of the empty set
+    MuHash3072() {}
+
+    void Insert(const unsigned char* data, size_t len);
+    void Remove(const unsigned char* data, size_t len);
+    //! the hash of the union of both sets
+    MuHash3072& operator*=(const MuHash3072& mul);
+
+    void Finalize(unsigned char hash[OUTPUT_SIZE]) const;
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        unsigned char buf[Num3072::BYTE_SIZE];
+        numerator.ToBytes(buf);
+        s.write((const char*)buf, sizeof(buf));
+        denominator.ToBytes(buf);
+        s.write((const char*)buf, sizeof(buf));
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        unsigned char buf[Num3072::BYTE_SIZE];
+        s.read((char*)buf, sizeof(buf));
+        numerator = Num3072(buf);
+        s.read((char*)buf, sizeof(buf));
+        denominator = Num3072(buf);
+    }
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
@@ -34,4 +34,9 @@ public:
  */
 std::string SHA256AutoDetect();
 
+/** Double SHA-256 of blocks 64 byte inputs, the 32 byte hashes are written to
+ *  out in their order. Uses the multi input kernels SHA256AutoDetect found.
+ */
+void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
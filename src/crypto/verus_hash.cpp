@@ -8,11 +8,78 @@ function with a Haraka V2 core. Unlike Haraka, which is made for short
 inputs only, Verus Hash takes any length of input and produces a 256 
 bit output.
 */
+#include <assert.h>
 #include <string.h>
+#include <algorithm>
 #include "crypto/common.h"
 #include "crypto/verus_hash.h"
 
+namespace
+{
+
+typedef void (*haraka512_fn)(unsigned char *out, const unsigned char *in);
+
+// the portable haraka has no multi lane version, it runs the lanes one by one
+void haraka512_port_8x(unsigned char *out, const unsigned char *in)
+{
+    for (int i = 0; i < VERUSHASH_LANES; i++)
+        haraka512_port(out + 32 * i, in + 64 * i);
+}
+
+void haraka512_port_zero_8x(unsigned char *out, const unsigned char *in)
+{
+    for (int i = 0; i < VERUSHASH_LANES; i++)
+        haraka512_port_zero(out + 32 * i, in + 64 * i);
+}
+
+// each lane does what Hash() does for its own input, 32 bytes at a time
+void HashLanes(haraka512_fn fn8x, unsigned char *results, const unsigned char *const *data, size_t len, int n)
+{
+    alignas(16) unsigned char in[VERUSHASH_LANES * 64], out[VERUSHASH_LANES * 32];
+
+    for (int first = 0; first < n; first += VERUSHASH_LANES)
+    {
+        int lanes = std::min(n - first, VERUSHASH_LANES);
+
+        // zero for the first result of each lane, and for the unused lanes
+        memset(in, 0, sizeof(in));
+        for (size_t pos = 0; pos < len; pos += 32)
+        {
+            size_t i = std::min(len - pos, (size_t)32);
+            for (int l = 0; l < lanes; l++)
+            {
+                memcpy(in + 64 * l + 32, data[first + l] + pos, i);
+                memset(in + 64 * l + 32 + i, 0, 32 - i);
+            }
+            (*fn8x)(out, in);
+            for (int l = 0; l < lanes; l++)
+                memcpy(in + 64 * l, out + 32 * l, 32);
+        }
+        for (int l = 0; l < lanes; l++)
+            memcpy(results + 32 * (first + l), in + 64 * l, 32);
+    }
+}
+
+// the pending block with the extra i64 set to nExtra + lane in each lane
+void ExtraHashLanes(haraka512_fn fn8x, unsigned char *hashes, const unsigned char *curBuf, int64_t nExtra, int count)
+{
+    alignas(16) unsigned char in[VERUSHASH_LANES * 64], out[VERUSHASH_LANES * 32];
+
+    assert(count >= 0 && count <= VERUSHASH_LANES);
+    for (int l = 0; l < VERUSHASH_LANES; l++)
+    {
+        int64_t extra = nExtra + l;
+        memcpy(in + 64 * l, curBuf, 64);
+        memcpy(in + 64 * l + 32, &extra, sizeof(extra));
+    }
+    (*fn8x)(out, in);
+    memcpy(hashes, out, 32 * count);
+}
+
+}
+
 void (*CVerusHash::haraka512Function)(unsigned char *out, const unsigned char *in);
+void (*CVerusHash::haraka512Function8x)(unsigned char *out, const unsigned char *in);
 
 void CVerusHash::Hash(void *result, const void *data, size_t _len)
 {
@@ -52,13 +119,25 @@ void CVerusHash::init()
     if (IsCPUVerusOptimized())
     {
         haraka512Function = &haraka512_zero;
+        haraka512Function8x = &haraka512_zero_8x;
     }
     else
     {
         haraka512Function = &haraka512_port_zero;
+        haraka512Function8x = &haraka512_port_zero_8x;
     }
 }
 
+void CVerusHash::HashMulti(unsigned char *results, const unsigned char *const *data, size_t len, int n)
+{
+    HashLanes(haraka512Function8x, results, data, len, n);
+}
+
+void CVerusHash::ExtraHashes(unsigned char *hashes, int64_t nExtra, int count) const
+{
+    ExtraHashLanes(haraka512Function8x, hashes, curBuf, nExtra, count);
+}
+
 CVerusHash &CVerusHash::Write(const unsigned char *data, size_t _len)
 {
     unsigned char *tmp;
@@ -95,7 +174,13 @@ void verus_hash(void *result, const void *data, size_t len)
     return CVerusHash::Hash(result, data, len);
 }
 
+void verus_hash_multi(unsigned char *results, const unsigned char *const *data, size_t len, int n)
+{
+    CVerusHash::HashMulti(results, data, len, n);
+}
+
 void (*CVerusHashV2::haraka512Function)(unsigned char *out, const unsigned char *in);
+void (*CVerusHashV2::haraka512Function8x)(unsigned char *out, const unsigned char *in);
 
 void CVerusHashV2::init()
 {
@@ -103,15 +188,27 @@ void CVerusHashV2::init()
     {
         load_constants();
         haraka512Function = &haraka512;
+        haraka512Function8x = &haraka512_8x;
     }
     else
     {
         // load and tweak the haraka constants
         load_constants_port();
         haraka512Function = &haraka512_port;
+        haraka512Function8x = &haraka512_port_8x;
     }
 }
 
+void CVerusHashV2::HashMulti(unsigned char *results, const unsigned char *const *data, size_t len, int n)
+{
+    HashLanes(haraka512Function8x, results, data, len, n);
+}
+
+void CVerusHashV2::ExtraHashes(unsigned char *hashes, int64_t nExtra, int count) const
+{
+    ExtraHashLanes(haraka512Function8x, hashes, curBuf, nExtra, count);
+}
+
 void CVerusHashV2::Hash(void *result, const void *data, size_t len)
 {
     unsigned char buf[128];
@@ -178,3 +275,8 @@ void verus_hash_v2(void *result, const void *data, size_t len)
 {
     return CVerusHashV2::Hash(result, data, len);
 }
+
+void verus_hash_v2_multi(unsigned char *results, const unsigned char *const *data, size_t len, int n)
+{
+    CVerusHashV2::HashMulti(results, data, len, n);
+}
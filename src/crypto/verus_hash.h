@@ -19,11 +19,17 @@ extern "C"
 #include "crypto/haraka_portable.h"
 }
 
+/** Number of inputs HashMulti and ExtraHashes run through the haraka512 lanes at once */
+static const int VERUSHASH_LANES = 8;
+
 class CVerusHash
 {
     public:
         static void Hash(void *result, const void *data, size_t len);
+        /** Hash of n inputs of len bytes each, results is n * 32 bytes */
+        static void HashMulti(unsigned char *results, const unsigned char *const *data, size_t len, int n);
         static void (*haraka512Function)(unsigned char *out, const unsigned char *in);
+        static void (*haraka512Function8x)(unsigned char *out, const unsigned char *in);
 
         static void init();
 
@@ -49,6 +55,8 @@ class CVerusHash
             }
         }
         void ExtraHash(unsigned char hash[32]) { (*haraka512Function)(hash, curBuf); }
+        /** ExtraHash of up to VERUSHASH_LANES extra values nExtra, nExtra + 1, ... into hashes */
+        void ExtraHashes(unsigned char *hashes, int64_t nExtra, int count) const;
 
         void Finalize(unsigned char hash[32])
         {
@@ -72,7 +80,10 @@ class CVerusHashV2
 {
     public:
         static void Hash(void *result, const void *data, size_t len);
+        /** Hash of n inputs of len bytes each, results is n * 32 bytes */
+        static void HashMulti(unsigned char *results, const unsigned char *const *data, size_t len, int n);
         static void (*haraka512Function)(unsigned char *out, const unsigned char *in);
+        static void (*haraka512Function8x)(unsigned char *out, const unsigned char *in);
 
         static void init();
 
@@ -98,6 +109,8 @@ class CVerusHashV2
             }
         }
         void ExtraHash(unsigned char hash[32]) { (*haraka512Function)(hash, curBuf); }
+        /** ExtraHash of up to VERUSHASH_LANES extra values nExtra, nExtra + 1, ... into hashes */
+        void ExtraHashes(unsigned char *hashes, int64_t nExtra, int count) const;
 
         void Finalize(unsigned char hash[32])
         {
@@ -119,6 +132,8 @@ class CVerusHashV2
 
 extern void verus_hash(void *result, const void *data, size_t len);
 extern void verus_hash_v2(void *result, const void *data, size_t len);
+extern void verus_hash_multi(unsigned char *results, const unsigned char *const *data, size_t len, int n);
+extern void verus_hash_v2_multi(unsigned char *results, const unsigned char *const *data, size_t len, int n);
 
 inline bool IsCPUVerusOptimized()
 {
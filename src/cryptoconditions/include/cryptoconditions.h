@@ -123,6 +123,23 @@ void            cc_free(struct CC *cond);
 struct CC*      cc_copy(const CC *cond);
 int             cc_hasSubtypes(enum CCTypeId cctypeid);
 
+/*
+ * Optional cache of verified secp256k1 signatures, set by the host application.
+ * The get callback returns nonzero if (msg32, 33 byte pubkey, 64 byte compact sig)
+ * was verified before, the set callback is called for each newly verified triple.
+ */
+typedef int (*Secp256k1VerifyCacheGet)(const uint8_t *msg32, const uint8_t *publicKey, const uint8_t *signature);
+typedef void (*Secp256k1VerifyCacheSet)(const uint8_t *msg32, const uint8_t *publicKey, const uint8_t *signature);
+void            cc_setSecp256k1VerifyCache(Secp256k1VerifyCacheGet get, Secp256k1VerifyCacheSet set);
+
+/*
+ * The same for ed25519 signatures, (msg32, 32 byte pubkey, 64 byte sig). Only
+ * fulfillments verified against a 32 byte message go through the cache.
+ */
+typedef int (*Ed25519VerifyCacheGet)(const uint8_t *msg32, const uint8_t *publicKey, const uint8_t *signature);
+typedef void (*Ed25519VerifyCacheSet)(const uint8_t *msg32, const uint8_t *publicKey, const uint8_t *signature);
+void            cc_setEd25519VerifyCache(Ed25519VerifyCacheGet get, Ed25519VerifyCacheSet set);
+
 #ifdef __cplusplus
 }
 #endif
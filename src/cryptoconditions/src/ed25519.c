@@ -32,10 +32,28 @@ static void ed25519Fingerprint(const CC *cond, uint8_t *out) {
 }
 
 
+static Ed25519VerifyCacheGet ed25519VerifyCacheGet = NULL;
+static Ed25519VerifyCacheSet ed25519VerifyCacheSet = NULL;
+
+
+void cc_setEd25519VerifyCache(Ed25519VerifyCacheGet get, Ed25519VerifyCacheSet set) {
+    ed25519VerifyCacheGet = get;
+    ed25519VerifyCacheSet = set;
+}
+
+
 int ed25519Verify(CC *cond, CCVisitor visitor) {
     if (cond->type->typeId != CC_Ed25519Type.typeId) return 1;
     // TODO: test failure mode: empty sig / null pointer
-    return ed25519_verify(cond->signature, visitor.msg, visitor.msgLength, cond->publicKey);
+    // the cache is keyed by a 32 byte message, the sighash komodod verifies against
+    int cacheable = visitor.msgLength == 32;
+    if (cacheable && ed25519VerifyCacheGet &&
+            ed25519VerifyCacheGet(visitor.msg, cond->publicKey, cond->signature))
+        return 1;
+    int rc = ed25519_verify(cond->signature, visitor.msg, visitor.msgLength, cond->publicKey);
+    if (rc == 1 && cacheable && ed25519VerifyCacheSet)
+        ed25519VerifyCacheSet(visitor.msg, cond->publicKey, cond->signature);
+    return rc;
 }
 
 
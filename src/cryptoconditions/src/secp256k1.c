@@ -43,12 +43,14 @@ static const size_t SECP256K1_SK_SIZE = 32;
 static const size_t SECP256K1_SIG_SIZE = 64;
 
 
-secp256k1_context *ec_ctx_sign = 0, *ec_ctx_verify = 0;
+// the signing context is per thread (created on first use and rerandomized on each
+// signing) so threads signing concurrently do not serialise on a global lock
+__thread secp256k1_context *ec_ctx_sign = 0;
+secp256k1_context *ec_ctx_verify = 0;
 pthread_mutex_t cc_secp256k1ContextLock = PTHREAD_MUTEX_INITIALIZER;
 
 
 void lockSign() {
-    pthread_mutex_lock(&cc_secp256k1ContextLock);
     if (!ec_ctx_sign) {
         ec_ctx_sign = secp256k1_context_create(SECP256K1_CONTEXT_SIGN);
     }
@@ -74,7 +76,6 @@ void lockSign() {
 
 
 void unlockSign() {
-    pthread_mutex_unlock(&cc_secp256k1ContextLock);
 }
 
 
@@ -95,6 +96,30 @@ static void secp256k1Fingerprint(const CC *cond, uint8_t *out) {
 }
 
 
+static Secp256k1VerifyCacheGet secp256k1VerifyCacheGet = NULL;
+static Secp256k1VerifyCacheSet secp256k1VerifyCacheSet = NULL;
+
+
+void cc_setSecp256k1VerifyCache(Secp256k1VerifyCacheGet get, Secp256k1VerifyCacheSet set) {
+    secp256k1VerifyCacheGet = get;
+    secp256k1VerifyCacheSet = set;
+}
+
+
+/*
+ * secp256k1_ecdsa_verify skipped for signatures already in the verify cache
+ */
+int secp256k1VerifyCached(const secp256k1_ecdsa_signature *sig, const unsigned char *msg32, const secp256k1_pubkey *pk,
+        const unsigned char *publicKey, const unsigned char *signature) {
+    if (secp256k1VerifyCacheGet && secp256k1VerifyCacheGet(msg32, publicKey, signature))
+        return 1;
+    int rc = secp256k1_ecdsa_verify(ec_ctx_verify, sig, msg32, pk);
+    if (rc == 1 && secp256k1VerifyCacheSet)
+        secp256k1VerifyCacheSet(msg32, publicKey, signature);
+    return rc;
+}
+
+
 int secp256k1Verify(CC *cond, CCVisitor visitor) {
     if (cond->type->typeId != CC_Secp256k1Type.typeId) return 1;
     initVerify();
@@ -115,7 +140,7 @@ int secp256k1Verify(CC *cond, CCVisitor visitor) {
     //free(hex);
 
     // Only accepts lower S signatures
-    rc = secp256k1_ecdsa_verify(ec_ctx_verify, &sig, visitor.msg, &pk);
+    rc = secp256k1VerifyCached(&sig, visitor.msg, &pk, cond->publicKey, cond->signature);
     if (rc != 1) return 0;
 
     return 1;
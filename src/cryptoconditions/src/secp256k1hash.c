@@ -44,11 +44,14 @@ static const size_t SECP256K1_HASH_SIZE = 20;
 
 
 // use secp256k1 ctx functions
-extern secp256k1_context *ec_ctx_sign, *ec_ctx_verify; 
+extern __thread secp256k1_context *ec_ctx_sign;
+extern secp256k1_context *ec_ctx_verify;
 extern pthread_mutex_t cc_secp256k1ContextLock;
 void lockSign(); 
 void unlockSign(); 
 void initVerify();
+int secp256k1VerifyCached(const secp256k1_ecdsa_signature *sig, const unsigned char *msg32, const secp256k1_pubkey *pk,
+        const unsigned char *publicKey, const unsigned char *signature);
 
 // we dont use cryptocondition default hash sha256 function
 // use btc address sha256+ripemd160
@@ -103,7 +106,7 @@ int secp256k1hashVerify(CC *cond, CCVisitor visitor) {
     if (rc != 1) return 0;
 
     // Only accepts lower S signatures
-    rc = secp256k1_ecdsa_verify(ec_ctx_verify, &sig, visitor.msg, &pk);
+    rc = secp256k1VerifyCached(&sig, visitor.msg, &pk, cond->publicKey, cond->signature);
     if (rc != 1) return 0;
 
     return 1;
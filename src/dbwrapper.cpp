@@ -5,6 +5,7 @@
 #include "dbwrapper.h"
 
 #include "util.h"
+#include "utilstrencodings.h"
 
 #include <boost/filesystem.hpp>
 
@@ -13,14 +14,133 @@
 #include <leveldb/filter_policy.h>
 #include <memenv.h>
 #include <stdint.h>
+#include <stdio.h>
 
-static leveldb::Options GetOptions(size_t nCacheSize, bool compression, int maxOpenFiles)
+#include <atomic>
+#include <mutex>
+#include <sstream>
+
+namespace {
+
+/** LRU block cache that accounts the charge of the blocks it holds, which leveldb's cache does not report */
+class CAccountingCache : public leveldb::Cache
+{
+private:
+    struct Entry {
+        void* value;
+        size_t charge;
+        void (*deleter)(const leveldb::Slice& key, void* value);
+        CAccountingCache* cache;
+    };
+
+    leveldb::Cache* pcache;
+    size_t nCapacity;
+    std::atomic<size_t> nUsage;
+
+    static void DeleteEntry(const leveldb::Slice& key, void* value)
+    {
+        Entry* entry = reinterpret_cast<Entry*>(value);
+        entry->cache->nUsage -= entry->charge;
+        (*entry->deleter)(key, entry->value);
+        delete entry;
+    }
+
+public:
+    CAccountingCache(size_t nCapacityIn) : pcache(leveldb::NewLRUCache(nCapacityIn)), nCapacity(nCapacityIn), nUsage(0) {}
+    ~CAccountingCache() { delete pcache; }
+
+    Handle* Insert(const leveldb::Slice& key, void* value, size_t charge, void (*deleter)(const leveldb::Slice& key, void* value))
+    {
+        nUsage += charge;
+        return pcache->Insert(key, new Entry{value, charge, deleter, this}, charge, &DeleteEntry);
+    }
+    Handle* Lookup(const leveldb::Slice& key) { return pcache->Lookup(key); }
+    void Release(Handle* handle) { pcache->Release(handle); }
+    void* Value(Handle* handle) { return reinterpret_cast<Entry*>(pcache->Value(handle))->value; }
+    void Erase(const leveldb::Slice& key) { pcache->Erase(key); }
+    uint64_t NewId() { return pcache->NewId(); }
+
+    size_t GetCapacity() const { return nCapacity; }
+    size_t GetUsage() const { return nUsage; }
+};
+
+struct COpenDB
+{
+    std::string strName;
+    leveldb::DB* pdb;
+    CDBTuning tuning;
+    const CAccountingCache* pcache;
+};
+
+std::mutex cs_opendbs;
+std::vector<COpenDB> vOpenDBs;
+
+//! block cache of the databases without a -dbtune cache, lives until exit after the databases using it
+CAccountingCache* psharedcache = NULL;
+
+}
+
+static std::string GetDBName(const boost::filesystem::path& path)
+{
+    if (path.parent_path().filename() == "blocks")
+        return "blocks/" + path.filename().string();
+    return path.filename().string();
+}
+
+// applies the -dbtune=<db>:<option>=<value> of the database, sizes in MiB and the block size in KiB
+static void ApplyDBTuning(const std::string& strName, CDBTuning& tuning)
+{
+    for (const std::string& strTune : mapMultiArgs["-dbtune"]) {
+        size_t nColon = strTune.find(':');
+        size_t nEquals = strTune.find('=', nColon == std::string::npos ? 0 : nColon);
+        if (nColon == std::string::npos || nEquals == std::string::npos) {
+            LogPrintf("Ignoring -dbtune=%s, expected <db>:<option>=<value>\n", strTune);
+            continue;
+        }
+        if (strTune.substr(0, nColon) != strName)
+            continue;
+        std::string strOption = strTune.substr(nColon + 1, nEquals - nColon - 1);
+        int64_t nValue = atoi64(strTune.substr(nEquals + 1));
+        if (nValue < 0) {
+            LogPrintf("Ignoring -dbtune=%s, negative value\n", strTune);
+        } else if (strOption == "cache") {
+            tuning.nBlockCache = nValue << 20;
+            tuning.fSharedCache = false;
+        } else if (strOption == "writebuffer") {
+            tuning.nWriteBuffer = nValue << 20;
+        } else if (strOption == "blocksize") {
+            tuning.nBlockSize = nValue << 10;
+        } else if (strOption == "bloombits") {
+            tuning.nBloomBits = nValue;
+        } else if (strOption == "compression") {
+            tuning.fCompression = nValue != 0;
+        } else {
+            LogPrintf("Ignoring -dbtune=%s, unknown option %s\n", strTune, strOption);
+        }
+    }
+}
+
+static leveldb::Options GetOptions(const std::string& strName, size_t nCacheSize, bool compression, int maxOpenFiles, CDBTuning& tuning)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = compression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+    tuning.nBlockCache = nCacheSize / 2;
+    tuning.nWriteBuffer = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
+    tuning.nBlockSize = options.block_size;
+    tuning.nBloomBits = 10;
+    tuning.fCompression = compression;
+    tuning.fSharedCache = psharedcache != NULL;
+    ApplyDBTuning(strName, tuning);
+
+    if (tuning.fSharedCache) {
+        options.block_cache = psharedcache;
+        tuning.nBlockCache = psharedcache->GetCapacity();
+    } else {
+        options.block_cache = new CAccountingCache(tuning.nBlockCache);
+    }
+    options.write_buffer_size = tuning.nWriteBuffer;
+    options.block_size = tuning.nBlockSize;
+    options.filter_policy = tuning.nBloomBits > 0 ? leveldb::NewBloomFilterPolicy(tuning.nBloomBits) : NULL;
+    options.compression = tuning.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
     options.max_open_files = maxOpenFiles;
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -37,7 +157,9 @@ CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, b
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize, compression, maxOpenFiles);
+    std::string strName = GetDBName(path);
+    CDBTuning tuning;
+    options = GetOptions(strName, nCacheSize, compression, maxOpenFiles, tuning);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -54,15 +176,18 @@ CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, b
     leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
     dbwrapper_private::HandleError(status);
     LogPrintf("Opened LevelDB successfully\n");
+    dbwrapper_private::RegisterDB(strName, pdb, tuning, options.block_cache);
 }
 
 CDBWrapper::~CDBWrapper()
 {
+    dbwrapper_private::UnregisterDB(pdb);
     delete pdb;
     pdb = NULL;
     delete options.filter_policy;
     options.filter_policy = NULL;
-    delete options.block_cache;
+    if (options.block_cache != psharedcache)
+        delete options.block_cache;
     options.block_cache = NULL;
     delete penv;
     options.env = NULL;
@@ -89,6 +214,53 @@ void CDBIterator::SeekToLast() { piter->SeekToLast(); }
 void CDBIterator::Next() { piter->Next(); }
 void CDBIterator::Prev() { piter->Prev(); }
 
+void InitSharedDBCache(size_t nBudget)
+{
+    assert(psharedcache == NULL);
+    psharedcache = new CAccountingCache(nBudget);
+}
+
+bool GetSharedDBCacheUsage(size_t& nBudget, size_t& nUsage)
+{
+    if (psharedcache == NULL)
+        return false;
+    nBudget = psharedcache->GetCapacity();
+    nUsage = psharedcache->GetUsage();
+    return true;
+}
+
+std::vector<CDBStats> GetDBStats()
+{
+    std::vector<CDBStats> vStats;
+    std::lock_guard<std::mutex> lock(cs_opendbs);
+
+    for (const COpenDB& db : vOpenDBs) {
+        CDBStats stats;
+        stats.strName = db.strName;
+        stats.tuning = db.tuning;
+        stats.nCacheUsage = db.pcache != NULL ? db.pcache->GetUsage() : 0;
+
+        // the key prefixes are below 0xff, so this range holds all the keys
+        leveldb::Range range(leveldb::Slice(), leveldb::Slice("\xff\xff\xff\xff", 4));
+        db.pdb->GetApproximateSizes(&range, 1, &stats.nApproximateSize);
+
+        // the per level lines of leveldb.stats, below its three header lines
+        std::string strStats;
+        if (db.pdb->GetProperty("leveldb.stats", &strStats)) {
+            std::istringstream ss(strStats);
+            std::string strLine;
+            while (std::getline(ss, strLine)) {
+                CDBLevelStats level;
+                if (sscanf(strLine.c_str(), "%d %d %lf %lf %lf %lf", &level.nLevel, &level.nFiles, &level.dSizeMB,
+                           &level.dCompactionSeconds, &level.dReadMB, &level.dWriteMB) == 6)
+                    stats.vLevels.push_back(level);
+            }
+        }
+        vStats.push_back(stats);
+    }
+    return vStats;
+}
+
 namespace dbwrapper_private {
 
 void HandleError(const leveldb::Status& status)
@@ -105,4 +277,21 @@ void HandleError(const leveldb::Status& status)
     throw dbwrapper_error("Unknown database error");
 }
 
+void RegisterDB(const std::string& strName, leveldb::DB* pdb, const CDBTuning& tuning, leveldb::Cache* pcache)
+{
+    std::lock_guard<std::mutex> lock(cs_opendbs);
+    vOpenDBs.push_back(COpenDB{strName, pdb, tuning, dynamic_cast<const CAccountingCache*>(pcache)});
+}
+
+void UnregisterDB(leveldb::DB* pdb)
+{
+    std::lock_guard<std::mutex> lock(cs_opendbs);
+    for (std::vector<COpenDB>::iterator it = vOpenDBs.begin(); it != vOpenDBs.end(); it++) {
+        if (it->pdb == pdb) {
+            vOpenDBs.erase(it);
+            break;
+        }
+    }
+}
+
 };
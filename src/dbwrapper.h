@@ -27,6 +27,52 @@ public:
 
 class CDBWrapper;
 
+/** leveldb settings of a database, -dbtune=<db>:<option>=<value> overrides the defaults */
+struct CDBTuning
+{
+    size_t nBlockCache;     //!< LRU block cache, bytes
+    size_t nWriteBuffer;    //!< memtable size, bytes, up to two are held in memory
+    size_t nBlockSize;      //!< uncompressed table block size, bytes
+    int nBloomBits;         //!< bloom filter bits per key, 0 = no filter
+    bool fCompression;
+    bool fSharedCache;      //!< the block cache is the shared one, nBlockCache is its budget
+
+    CDBTuning() : nBlockCache(0), nWriteBuffer(0), nBlockSize(0), nBloomBits(0), fCompression(false), fSharedCache(false) {}
+};
+
+/** compactions of one leveldb level, from leveldb.stats */
+struct CDBLevelStats
+{
+    int nLevel;
+    int nFiles;
+    double dSizeMB;
+    double dCompactionSeconds;
+    double dReadMB;
+    double dWriteMB;
+};
+
+/** statistics of an open database, as getdbinfo reports them */
+struct CDBStats
+{
+    std::string strName;
+    CDBTuning tuning;
+    uint64_t nApproximateSize;  //!< bytes on disk of all the keys
+    size_t nCacheUsage;         //!< bytes held by its own block cache, 0 with the shared one
+    std::vector<CDBLevelStats> vLevels;
+};
+
+/** the statistics of the open databases */
+std::vector<CDBStats> GetDBStats();
+
+/**
+ * Create the block cache shared by the databases opened afterwards, nBudget bytes
+ * for all of them, instead of a cache of their own sized from their nCacheSize.
+ * A -dbtune cache gives a database its own cache again.
+ */
+void InitSharedDBCache(size_t nBudget);
+/** the budget and the bytes held of the shared block cache, false without one */
+bool GetSharedDBCacheUsage(size_t& nBudget, size_t& nUsage);
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -35,6 +81,10 @@ namespace dbwrapper_private {
  */
 void HandleError(const leveldb::Status& status);
 
+/** Add a database to those getdbinfo reports, until it is unregistered before it is closed */
+void RegisterDB(const std::string& strName, leveldb::DB* pdb, const CDBTuning& tuning, leveldb::Cache* pcache = NULL);
+void UnregisterDB(leveldb::DB* pdb);
+
 };
 
 /** Batch of changes queued to be written to a CDBWrapper */
@@ -68,6 +118,12 @@ public:
         batch.Put(slKey, slValue);
     }
 
+    //! Write an entry already serialized, as returned by CDBIterator::GetRawKey and GetRawValue
+    void WriteRaw(const std::string& key, const std::string& value)
+    {
+        batch.Put(key, value);
+    }
+
     template <typename K>
     void Erase(const K& key)
     {
@@ -78,6 +134,11 @@ public:
 
         batch.Delete(slKey);
     }
+
+    void Clear()
+    {
+        batch.Clear();
+    }
 };
 
 class CDBIterator
@@ -152,6 +213,15 @@ public:
         return piter->value().size();
     }
 
+    //! the key and value as stored, to copy the entry without decoding it
+    std::string GetRawKey() {
+        return piter->key().ToString();
+    }
+
+    std::string GetRawValue() {
+        return piter->value().ToString();
+    }
+
 };
 
 class CDBWrapper
@@ -180,7 +250,9 @@ private:
 
 public:
     /**
-     * @param[in] path        Location in the filesystem where leveldb data will be stored.
+     * @param[in] path        Location in the filesystem where leveldb data will be stored,
+     *                        its last component (blocks/ and its last one below the blocks
+     *                        directory) names the database for -dbtune and getdbinfo.
      * @param[in] nCacheSize  Configures various leveldb cache settings.
      * @param[in] fMemory     If true, use leveldb's memory environment.
      * @param[in] fWipe       If true, remove all existing data.
@@ -267,6 +339,12 @@ public:
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
+    //! Iterator that fills the block cache like Read does, for short scans on a lookup path
+    CDBIterator *NewCachedIterator()
+    {
+        return new CDBIterator(*this, pdb->NewIterator(readoptions));
+    }
+
     /**
      * Return true if the database managed by this class contains no entries.
      */
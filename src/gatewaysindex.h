@@ -0,0 +1,72 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef GATEWAYSINDEX_H
+#define GATEWAYSINDEX_H
+
+#include "uint256.h"
+#include "serialize.h"
+
+// gateways index key: bind txid and txid of a withdraw, partial signing or complete signing tx with an unspent marker
+struct CGatewaysMarkerKey {
+    uint256 bindtxid;
+    uint256 txid;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 64;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        bindtxid.Serialize(s);
+        txid.Serialize(s);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        bindtxid.Unserialize(s);
+        txid.Unserialize(s);
+    }
+
+    CGatewaysMarkerKey(uint256 _bindtxid, uint256 _txid) {
+        bindtxid = _bindtxid;
+        txid = _txid;
+    }
+
+    CGatewaysMarkerKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        bindtxid.SetNull();
+        txid.SetNull();
+    }
+};
+
+// state of a withdraw: the funcid of the tx holding its vout0 marker ('W', 'P' or 'S')
+struct CGatewaysMarker {
+    uint256 withdrawtxid;
+    uint8_t funcid;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(withdrawtxid);
+        READWRITE(funcid);
+    }
+
+    CGatewaysMarker() : funcid(0) {}
+};
+
+#endif // #ifndef GATEWAYSINDEX_H
@@ -5,6 +5,7 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include "compat/endian.h"
 #include "crypto/equihash.h"
 #include "uint256.h"
 
@@ -289,3 +290,34 @@ TEST(equihash_tests, check_optimised_solver_cancelled) {
     }
 }
 #endif // ENABLE_MINING
+
+TEST(equihash_tests, blake2b_prefix_matches_libsodium) {
+    unsigned char personalization[CBlake2bPrefix::PERSONAL_SIZE] = {};
+    memcpy(personalization, "ZcashPoW", 8);
+    unsigned char data[300];
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = (unsigned char)(i * 31 + 7);
+    std::vector<uint32_t> indices;
+    for (uint32_t i = 0; i < 11; i++)
+        indices.push_back(i * 123457);
+
+    // prefix lengths around the block size, 140 is the I||V of a header
+    for (size_t len : {0, 1, 12, 124, 125, 128, 129, 140, 256, 300}) {
+        SCOPED_TRACE(len);
+        CBlake2bPrefix prefix(50, personalization);
+        prefix.Write(data, len / 3).Write(data + len / 3, len - len / 3);
+        std::vector<unsigned char> out(indices.size() * 50);
+        prefix.FinalizeIndices(indices.data(), indices.size(), out.data());
+
+        for (size_t i = 0; i < indices.size(); i++) {
+            crypto_generichash_blake2b_state state;
+            crypto_generichash_blake2b_init_salt_personal(&state, NULL, 0, 50, NULL, personalization);
+            crypto_generichash_blake2b_update(&state, data, len);
+            uint32_t lei = htole32(indices[i]);
+            crypto_generichash_blake2b_update(&state, (unsigned char*)&lei, sizeof(lei));
+            unsigned char expected[50];
+            crypto_generichash_blake2b_final(&state, expected, sizeof(expected));
+            EXPECT_EQ(0, memcmp(expected, &out[i * 50], sizeof(expected)));
+        }
+    }
+}
@@ -3,6 +3,7 @@
 
 #include "consensus/upgrades.h"
 #include "consensus/validation.h"
+#include "chaineventlog.h"
 #include "core_io.h"
 #include "main.h"
 #include "primitives/transaction.h"
@@ -285,3 +286,42 @@ TEST(Mempool, SproutNegativeVersionTxWhenOverwinterActive) {
     // Revert to default
     UpdateNetworkUpgradeParameters(Consensus::UPGRADE_OVERWINTER, Consensus::NetworkUpgrade::NO_ACTIVATION_HEIGHT);
 }
+
+TEST(Mempool, ChainEventLogKeepsTheLastEvents) {
+    CChainEventLog log;
+    log.SetMaxSize(3);
+    RegisterValidationInterface(&log, true);
+
+    std::vector<uint256> txids;
+    for (int i = 0; i < 4; i++) {
+        CMutableTransaction mtx = GetValidTransaction();
+        mtx.nLockTime = i;
+        CTransaction tx(mtx);
+        txids.push_back(tx.GetHash());
+        if (i == 3)
+            GetMainSignals().TransactionRemovedFromMempool(tx);
+        else
+            GetMainSignals().TransactionAddedToMempool(tx);
+    }
+    UnregisterValidationInterface(&log);
+
+    std::vector<CChainEvent> events;
+    uint64_t nLast;
+    // the first event was dropped
+    EXPECT_FALSE(log.GetEventsSince(0, 10, events, nLast));
+    EXPECT_EQ(4, nLast);
+    ASSERT_EQ(3, events.size());
+    EXPECT_EQ(2, events[0].nSequence);
+    EXPECT_EQ(txids[1], events[0].hash);
+    EXPECT_EQ(CChainEvent::MEMPOOL_ADDED, events[0].type);
+    EXPECT_EQ(CChainEvent::MEMPOOL_REMOVED, events[2].type);
+
+    events.clear();
+    EXPECT_TRUE(log.GetEventsSince(2, 1, events, nLast));
+    ASSERT_EQ(1, events.size());
+    EXPECT_EQ(3, events[0].nSequence);
+
+    events.clear();
+    EXPECT_TRUE(log.GetEventsSince(4, 10, events, nLast));
+    EXPECT_TRUE(events.empty());
+}
@@ -133,3 +133,26 @@ TEST(Metrics, EstimateNetHeightInner) {
     //   -> estimated height: 153 -> 150
     EXPECT_EQ(150, EstimateNetHeightInner(100, 14100, 50, 12000, 0, 150));
 }
+
+TEST(Metrics, HistogramPrometheusText) {
+    CMetricsHistogram& h = GetMetricsHistogram("test_latency_seconds", "Test histogram", "step=\"a\"");
+    EXPECT_EQ(&h, &GetMetricsHistogram("test_latency_seconds", "Test histogram", "step=\"a\""));
+
+    h.Observe(50);
+    h.Observe(100);
+    h.Observe(3000);
+    h.Observe(60000000);
+    EXPECT_EQ(4, h.Count());
+
+    std::string text;
+    h.Write(text, "test_latency_seconds", "step=\"a\"");
+    EXPECT_NE(std::string::npos, text.find("test_latency_seconds_bucket{step=\"a\",le=\"0.0001\"} 2\n"));
+    EXPECT_NE(std::string::npos, text.find("test_latency_seconds_bucket{step=\"a\",le=\"0.005\"} 3\n"));
+    EXPECT_NE(std::string::npos, text.find("test_latency_seconds_bucket{step=\"a\",le=\"30\"} 3\n"));
+    EXPECT_NE(std::string::npos, text.find("test_latency_seconds_bucket{step=\"a\",le=\"+Inf\"} 4\n"));
+    EXPECT_NE(std::string::npos, text.find("test_latency_seconds_sum{step=\"a\"} 60.003150\n"));
+    EXPECT_NE(std::string::npos, text.find("test_latency_seconds_count{step=\"a\"} 4\n"));
+
+    std::string all = GetPrometheusMetrics();
+    EXPECT_NE(std::string::npos, all.find("# TYPE test_latency_seconds histogram\n"));
+}
@@ -324,4 +324,10 @@ unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char
 
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
 
+/** SipHash-2-4 of a uint256 with the key (k0, k1), as the BIP 152 short txids use it */
+uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
+
+/** SipHash-2-4 of len bytes with the key (k0, k1), as the BIP 158 filter elements use it */
+uint64_t SipHashBytes(uint64_t k0, uint64_t k1, const unsigned char* data, size_t len);
+
 #endif // BITCOIN_HASH_H
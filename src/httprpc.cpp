@@ -18,6 +18,7 @@
 #include "chainparams.h"
 #include "httpserver.h"
 #include "key_io.h"
+#include "metrics.h"
 #include "rpc/protocol.h"
 #include "rpc/server.h"
 #include "random.h"
@@ -90,6 +91,45 @@ static void JSONErrorReply(HTTPRequest* req, const UniValue& objError, const Uni
     req->WriteReply(nStatus, strReply);
 }
 
+/**
+ * Send the reply of a single request while its result is written. A reply
+ * that fits in one chunk of the writer is sent as is, a larger one as a
+ * chunked HTTP body.
+ */
+static void JSONRPCStreamReply(HTTPRequest* req, const RPCStreamWriterFn& writeResult, const UniValue& id)
+{
+    req->WriteHeader("Content-Type", "application/json");
+    CJSONStreamWriter writer([req](const std::string& chunk) {
+        if (!req->IsReplyChunked())
+            req->StartReplyChunks(HTTP_OK);
+        req->WriteReplyChunk(chunk);
+    });
+    try {
+        // the members of JSONRPCReplyObj, in its order
+        writer.BeginObject();
+        writer.Key("result");
+        writeResult(writer);
+        writer.Key("error");
+        writer.Value(NullUniValue);
+        writer.Key("id");
+        writer.Value(id);
+        writer.EndObject();
+        writer.Raw("\n");
+    } catch (...) {
+        // an error reply can't be sent once the status went out
+        if (!writer.Flushed())
+            throw;
+        LogPrintf("%s: reply truncated by an error\n", __func__);
+        req->EndReplyChunks();
+        return;
+    }
+    if (writer.Flushed()) {
+        writer.Flush();
+        req->EndReplyChunks();
+    } else
+        req->WriteReply(HTTP_OK, writer.Release());
+}
+
 static bool RPCAuthorized(const std::string& strAuth)
 {
     if (strRPCUserColonPass.empty()) // Belt-and-suspenders measure if InitRPCAuthentication was not called
@@ -151,10 +191,15 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
                 return false;
             }
 
+            CRPCStreamScope stream;
             UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
 
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            // Send reply, a large result isn't held as a whole string too
+            if (stream.GetResult())
+                JSONRPCStreamReply(req, stream.GetResult(), jreq.id);
+            else
+                JSONRPCStreamReply(req, [&result](CJSONStreamWriter& writer) { writer.Value(result); }, jreq.id);
+            return true;
 
         // array of requests
         } else if (valRequest.isArray())
@@ -174,6 +219,60 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
     return true;
 }
 
+/** Calls cheap enough to be served ahead of the queued ones, so monitoring
+ * keeps working while the work queue is busy with heavy calls */
+static const char* const LIGHT_RPC_METHODS[] = {
+    "getinfo", "getblockcount", "getbestblockhash", "getconnectioncount", "getdifficulty", "ping",
+};
+/** Bodies longer than this aren't looked at, they aren't a single light call */
+static const size_t MAX_LIGHT_RPC_BODY = 512;
+
+static bool HTTPReq_JSONRPC_IsLight(HTTPRequest* req)
+{
+    if (req->GetRequestMethod() != HTTPRequest::POST)
+        return false;
+    std::string strBody = req->PeekBody(MAX_LIGHT_RPC_BODY + 1);
+    if (strBody.size() > MAX_LIGHT_RPC_BODY)
+        return false;
+    UniValue valRequest;
+    if (!valRequest.read(strBody) || !valRequest.isObject())
+        return false;
+    const UniValue& method = find_value(valRequest, "method");
+    if (!method.isStr())
+        return false;
+    for (const char* strLight : LIGHT_RPC_METHODS)
+        if (method.get_str() == strLight)
+            return true;
+    return false;
+}
+
+/** Prometheus scrape of the metrics registry, behind the same Basic auth as JSON-RPC */
+static bool HTTPReq_Metrics(HTTPRequest* req, const std::string &)
+{
+    if (req->GetRequestMethod() != HTTPRequest::GET) {
+        req->WriteReply(HTTP_BAD_METHOD, "metrics are only served to GET requests");
+        return false;
+    }
+    std::pair<bool, std::string> authHeader = req->GetHeader("authorization");
+    if (!authHeader.first || !RPCAuthorized(authHeader.second)) {
+        if (authHeader.first) {
+            LogPrintf("ThreadRPCServer incorrect password attempt from %s\n", req->GetPeer().ToString());
+            MilliSleep(250);
+        }
+        req->WriteHeader("WWW-Authenticate", WWW_AUTH_HEADER_DATA);
+        req->WriteReply(HTTP_UNAUTHORIZED);
+        return false;
+    }
+    req->WriteHeader("Content-Type", "text/plain; version=0.0.4");
+    req->WriteReply(HTTP_OK, GetPrometheusMetrics());
+    return true;
+}
+
+static bool HTTPReq_Metrics_IsLight(HTTPRequest* req)
+{
+    return true;
+}
+
 static bool InitRPCAuthentication()
 {
     if (mapArgs["-rpcpassword"] == "")
@@ -197,7 +296,8 @@ bool StartHTTPRPC()
     if (!InitRPCAuthentication())
         return false;
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, HTTPReq_JSONRPC_IsLight);
+    RegisterHTTPHandler("/metrics", true, HTTPReq_Metrics, HTTPReq_Metrics_IsLight);
 
     assert(EventBase());
     httpRPCTimerInterface = new HTTPRPCTimerInterface(EventBase());
@@ -214,6 +314,7 @@ void StopHTTPRPC()
 {
     LogPrint("rpc", "Stopping HTTP RPC server\n");
     UnregisterHTTPHandler("/", true);
+    UnregisterHTTPHandler("/metrics", true);
     if (httpRPCTimerInterface) {
         RPCUnregisterTimerInterface(httpRPCTimerInterface);
         delete httpRPCTimerInterface;
@@ -40,6 +40,9 @@
 #include <boost/foreach.hpp>
 #include <boost/scoped_ptr.hpp>
 
+#include <deque>
+#include <map>
+
 /** HTTP request work item */
 class HTTPWorkItem : public HTTPClosure
 {
@@ -60,21 +63,36 @@ private:
     HTTPRequestHandler func;
 };
 
-/** Simple work queue for distributing work over multiple threads.
- * Work items are simply callable objects.
+/** Work queue for distributing work over multiple threads.
+ * Work items are simply callable objects. Every client has a queue of its
+ * own and the workers serve the clients in turn, so a client flooding the
+ * server delays its own requests and not those of the others. Priority
+ * items, cheap calls such as monitoring ones, are served first.
  */
 template <typename WorkItem>
 class WorkQueue
 {
 private:
+    struct Entry
+    {
+        WorkItem* item;
+        int64_t nTimeQueued;
+    };
+
     /** Mutex protects entire object */
     CWaitableCriticalSection cs;
     CConditionVariable cond;
     /* XXX in C++11 we can use std::unique_ptr here and avoid manual cleanup */
-    std::deque<WorkItem*> queue;
+    std::map<std::string, std::deque<Entry> > clientQueues;
+    /** The clients with queued items, in the order they are served */
+    std::deque<std::string> clientOrder;
+    std::deque<Entry> priorityQueue;
+    size_t depth;
     bool running;
     size_t maxDepth;
+    size_t maxClientDepth;
     int numThreads;
+    HTTPWorkQueueStats stats;
 
     /** RAII object to keep track of number of running worker threads */
     class ThreadCounter
@@ -94,10 +112,38 @@ private:
         }
     };
 
+    /** Take the next item, the lock is held and there is one */
+    WorkItem* Pop()
+    {
+        Entry entry;
+        if (!priorityQueue.empty()) {
+            entry = priorityQueue.front();
+            priorityQueue.pop_front();
+        } else {
+            std::string client = clientOrder.front();
+            clientOrder.pop_front();
+            std::deque<Entry>& clientQueue = clientQueues[client];
+            entry = clientQueue.front();
+            clientQueue.pop_front();
+            depth--;
+            if (clientQueue.empty())
+                clientQueues.erase(client);
+            else
+                clientOrder.push_back(client);
+        }
+        int64_t nWait = GetTimeMicros() - entry.nTimeQueued;
+        stats.nServed++;
+        stats.nTotalWaitMicros += nWait;
+        stats.nMaxWaitMicros = std::max(stats.nMaxWaitMicros, nWait);
+        return entry.item;
+    }
+
 public:
-    WorkQueue(size_t maxDepth) : running(true),
-                                 maxDepth(maxDepth),
-                                 numThreads(0)
+    WorkQueue(size_t maxDepth, size_t maxClientDepth) : depth(0),
+                                                        running(true),
+                                                        maxDepth(maxDepth),
+                                                        maxClientDepth(maxClientDepth),
+                                                        numThreads(0)
     {
     }
     /*( Precondition: worker threads have all stopped
@@ -105,19 +151,39 @@ public:
      */
     ~WorkQueue()
     {
-        while (!queue.empty()) {
-            delete queue.front();
-            queue.pop_front();
-        }
-    }
-    /** Enqueue a work item */
-    bool Enqueue(WorkItem* item)
+        for (typename std::map<std::string, std::deque<Entry> >::iterator it = clientQueues.begin(); it != clientQueues.end(); ++it)
+            for (size_t i = 0; i < it->second.size(); i++)
+                delete it->second[i].item;
+        for (size_t i = 0; i < priorityQueue.size(); i++)
+            delete priorityQueue[i].item;
+    }
+    /** Enqueue a work item of client. Priority items have a queue of the same
+     * depth of their own, the others can be at most maxClientDepth per client. */
+    bool Enqueue(WorkItem* item, const std::string& client, bool fPriority)
     {
         boost::unique_lock<boost::mutex> lock(cs);
-        if (queue.size() >= maxDepth) {
-            return false;
+        Entry entry;
+        entry.item = item;
+        entry.nTimeQueued = GetTimeMicros();
+        if (fPriority) {
+            if (priorityQueue.size() >= maxDepth) {
+                stats.nRejected++;
+                return false;
+            }
+            priorityQueue.push_back(entry);
+        } else {
+            typename std::map<std::string, std::deque<Entry> >::iterator it = clientQueues.find(client);
+            if (depth >= maxDepth || (it != clientQueues.end() && it->second.size() >= maxClientDepth)) {
+                stats.nRejected++;
+                return false;
+            }
+            if (it == clientQueues.end()) {
+                it = clientQueues.insert(std::make_pair(client, std::deque<Entry>())).first;
+                clientOrder.push_back(client);
+            }
+            it->second.push_back(entry);
+            depth++;
         }
-        queue.push_back(item);
         cond.notify_one();
         return true;
     }
@@ -129,12 +195,11 @@ public:
             WorkItem* i = 0;
             {
                 boost::unique_lock<boost::mutex> lock(cs);
-                while (running && queue.empty())
+                while (running && priorityQueue.empty() && clientOrder.empty())
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = queue.front();
-                queue.pop_front();
+                i = Pop();
             }
             (*i)();
             delete i;
@@ -159,20 +224,31 @@ public:
     size_t Depth()
     {
         boost::unique_lock<boost::mutex> lock(cs);
-        return queue.size();
+        return depth + priorityQueue.size();
+    }
+
+    HTTPWorkQueueStats GetStats()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        HTTPWorkQueueStats ret = stats;
+        ret.nDepth = depth;
+        ret.nPriorityDepth = priorityQueue.size();
+        ret.nClients = clientQueues.size();
+        return ret;
     }
 };
 
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string prefix, bool exactMatch, HTTPRequestHandler handler):
-        prefix(prefix), exactMatch(exactMatch), handler(handler)
+    HTTPPathHandler(std::string prefix, bool exactMatch, HTTPRequestHandler handler, HTTPPriorityCheck priority):
+        prefix(prefix), exactMatch(exactMatch), handler(handler), priority(priority)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPPriorityCheck priority;
 };
 
 /** HTTP module state */
@@ -248,6 +324,33 @@ static std::string RequestMethodString(HTTPRequest::RequestMethod m)
     }
 }
 
+/** Re-enable reading from the socket once a reply is sent. This is the second
+ * part of the libevent workaround in http_request_cb. */
+static void ReenableReading(struct evhttp_request* req)
+{
+    if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+        evhttp_connection* conn = evhttp_request_get_connection(req);
+        if (conn) {
+            bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+            if (bev) {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            }
+        }
+    }
+}
+
+/** The work queue of a request: its peer's IP and the user it authenticates as */
+static std::string HTTPClientKey(HTTPRequest* req)
+{
+    std::string key = req->GetPeer().ToStringIP();
+    std::pair<bool, std::string> authHeader = req->GetHeader("authorization");
+    if (authHeader.first && authHeader.second.substr(0, 6) == "Basic ") {
+        std::string strUserPass = DecodeBase64(authHeader.second.substr(6));
+        key += "/" + strUserPass.substr(0, strUserPass.find(':'));
+    }
+    return key;
+}
+
 /** HTTP request callback */
 static void http_request_cb(struct evhttp_request* req, void* arg)
 {
@@ -301,9 +404,11 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
+        std::string client = HTTPClientKey(hreq.get());
+        bool fPriority = i->priority && i->priority(hreq.get());
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(hreq.release(), path, i->handler));
         assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        if (workQueue->Enqueue(item.get(), client, fPriority))
             item.release(); /* if true, queue took ownership */
         else
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
@@ -446,9 +551,10 @@ bool InitHTTPServer()
 
     LogPrint("http", "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
-    LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
+    int clientQueueDepth = std::max((long)GetArg("-rpcworkqueueclient", std::max(workQueueDepth / 2, 1)), 1L);
+    LogPrintf("HTTP: creating work queue of depth %d, %d per client\n", workQueueDepth, clientQueueDepth);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth, clientQueueDepth);
     eventBase = base;
     eventHTTP = http;
     return true;
@@ -552,12 +658,17 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       replyChunked(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (replyChunked && !replySent) {
+        // The client gets a truncated body, the status was sent already
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        EndReplyChunks();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -596,6 +707,18 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+std::string HTTPRequest::PeekBody(size_t nMax)
+{
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return "";
+    size_t size = std::min(evbuffer_get_length(buf), nMax);
+    std::string strBody(size, '\0');
+    if (size > 0)
+        evbuffer_copyout(buf, &strBody[0], size);
+    return strBody;
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -610,7 +733,7 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
  */
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
-    assert(!replySent && req);
+    assert(!replySent && !replyChunked && req);
     // Send event to main http thread to send reply message
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
@@ -618,17 +741,49 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     auto req_copy = req;
     HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
         evhttp_send_reply(req_copy, nStatus, (const char*)NULL, (struct evbuffer *)NULL);
-        // Re-enable reading from the socket. This is the second part of the libevent
-        // workaround above.
-        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
-            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
-            if (conn) {
-                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
-                if (bev) {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
-            }
-        }
+        ReenableReading(req_copy);
+    });
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+void HTTPRequest::StartReplyChunks(int nStatus)
+{
+    assert(!replySent && !replyChunked && req);
+    // The chunks are sent by events too, the main thread runs them in order
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
+        evhttp_send_reply_start(req_copy, nStatus, (const char*)NULL);
+    });
+    ev->trigger(0);
+    replyChunked = true;
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(!replySent && replyChunked && req);
+    // an empty chunk would end the body
+    if (strChunk.empty())
+        return;
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, evb]{
+        evhttp_send_reply_chunk(req_copy, evb);
+        evbuffer_free(evb);
+    });
+    ev->trigger(0);
+}
+
+void HTTPRequest::EndReplyChunks()
+{
+    assert(!replySent && replyChunked && req);
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy]{
+        evhttp_send_reply_end(req_copy);
+        ReenableReading(req_copy);
     });
     ev->trigger(0);
     replySent = true;
@@ -675,10 +830,18 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPPriorityCheck &priority)
 {
     LogPrint("http", "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, priority));
+}
+
+bool GetHTTPWorkQueueStats(HTTPWorkQueueStats& stats)
+{
+    if (!workQueue)
+        return false;
+    stats = workQueue->GetStats();
+    return true;
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
@@ -39,14 +39,39 @@ void StopHTTPServer();
 
 /** Handler for requests to a certain HTTP path */
 typedef boost::function<void(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+/** Whether a request for a path is cheap enough to be served ahead of the
+ * queued ones. It runs on the event loop thread, before the request is
+ * authorized, and must only look at the request. */
+typedef boost::function<bool(HTTPRequest* req)> HTTPPriorityCheck;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
  * be invoked.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler,
+                         const HTTPPriorityCheck &priority = HTTPPriorityCheck());
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+struct HTTPWorkQueueStats
+{
+    size_t nDepth;
+    size_t nPriorityDepth;
+    /** Clients with queued requests */
+    size_t nClients;
+    uint64_t nServed;
+    /** Requests turned away with a full queue */
+    uint64_t nRejected;
+    /** Time the served requests waited in the queue */
+    int64_t nTotalWaitMicros;
+    int64_t nMaxWaitMicros;
+
+    HTTPWorkQueueStats() : nDepth(0), nPriorityDepth(0), nClients(0), nServed(0), nRejected(0),
+                           nTotalWaitMicros(0), nMaxWaitMicros(0) {}
+};
+
+/** The state of the work queue so far, false before InitHTTPServer */
+bool GetHTTPWorkQueueStats(HTTPWorkQueueStats& stats);
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
@@ -63,6 +88,7 @@ private:
     // For test access
 protected:
     bool replySent;
+    bool replyChunked;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -102,6 +128,9 @@ public:
      */
     std::string ReadBody();
 
+    /** Up to nMax bytes of the body, which a later ReadBody still returns */
+    std::string PeekBody(size_t nMax);
+
     /**
      * Write output header.
      *
@@ -118,6 +147,21 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     virtual void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a chunked HTTP reply, to send a body not known in full yet.
+     * Write the body with WriteReplyChunk and finish it with EndReplyChunks,
+     * instead of calling WriteReply.
+     */
+    void StartReplyChunks(int nStatus);
+    bool IsReplyChunked() const { return replyChunked; }
+    void WriteReplyChunk(const std::string& strChunk);
+    /**
+     * Finish a chunked HTTP reply.
+     *
+     * @note As WriteReply, this gives the request back to the main thread.
+     */
+    void EndReplyChunks();
 };
 
 /** Event handler closure.
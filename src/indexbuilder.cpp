@@ -0,0 +1,396 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "indexbuilder.h"
+
+#include "addressbalanceindex.h"
+#include "chain.h"
+#include "main.h"
+#include "txdb.h"
+#include "undo.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <vector>
+#include <boost/thread.hpp>
+
+extern bool fAddressIndex, fSpentIndex, fTimestampIndex;
+
+// blocks read and decoded by the workers before the builder writes them
+static const unsigned int INDEXBUILDER_RUN_BLOCKS = 256;
+
+namespace {
+
+/// index entries of one block, as ConnectBlock or DisconnectBlock builds them
+struct CIndexBuilderBlock
+{
+    const CBlockIndex *pindex;
+    bool fOk;
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+
+    CIndexBuilderBlock() : pindex(NULL), fOk(false) {}
+};
+
+int nPendingIndexes = 0;
+boost::mutex cs_indexbuilder;
+CIndexBuilderStatus indexBuilderStatus;
+
+}
+
+static bool IndexBuilderConnectEntries(const CBlock &block, const CBlockUndo &blockUndo, int nIndexes, CIndexBuilderBlock &entries)
+{
+    const int nHeight = entries.pindex->GetHeight();
+
+    for (unsigned int i = 0; i < block.vtx.size(); i++)
+    {
+        const CTransaction &tx = block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+
+        if (!tx.IsMint() && (nIndexes & (INDEXBUILDER_ADDRESS | INDEXBUILDER_SPENT)))
+        {
+            if (i == 0 || i > blockUndo.vtxundo.size())
+                return false;
+            CTxUndo txundo = blockUndo.vtxundo[i-1];
+            if (tx.IsPegsImport()) txundo.vprevout.insert(txundo.vprevout.begin(), CTxInUndo());
+            if (txundo.vprevout.size() != tx.vin.size())
+                return false;
+            for (size_t j = 0; j < tx.vin.size(); j++)
+            {
+                if (tx.IsPegsImport() && j==0) continue;
+                const CTxIn &input = tx.vin[j];
+                const CTxOut &prevout = txundo.vprevout[j].txout;
+
+                std::vector<std::vector<unsigned char>> vSols;
+                CTxDestination vDest;
+                txnouttype txType = TX_PUBKEYHASH;
+                uint160 addrHash;
+                int keyType = GetAddressType(prevout.scriptPubKey, vDest, txType, vSols);
+                if (keyType == 0)
+                    continue;
+                for (auto addr : vSols)
+                {
+                    addrHash = addr.size() == 20 ? uint160(addr) : Hash160(addr);
+                    if (nIndexes & INDEXBUILDER_ADDRESS)
+                    {
+                        entries.addressIndex.push_back(std::make_pair(CAddressIndexKey(keyType, addrHash, nHeight, i, txhash, j, true), prevout.nValue * -1));
+                        entries.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(keyType, addrHash, input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
+                    }
+                }
+                if (nIndexes & INDEXBUILDER_SPENT)
+                    entries.spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(txhash, j, nHeight, prevout.nValue, keyType, addrHash)));
+            }
+        }
+
+        if (nIndexes & INDEXBUILDER_ADDRESS)
+        {
+            for (unsigned int k = 0; k < tx.vout.size(); k++)
+            {
+                const CTxOut &out = tx.vout[k];
+
+                std::vector<std::vector<unsigned char>> vSols;
+                CTxDestination vDest;
+                txnouttype txType = TX_PUBKEYHASH;
+                int keyType = GetAddressType(out.scriptPubKey, vDest, txType, vSols);
+                if (keyType == 0)
+                    continue;
+                for (auto addr : vSols)
+                {
+                    uint160 addrHash = addr.size() == 20 ? uint160(addr) : Hash160(addr);
+                    entries.addressIndex.push_back(std::make_pair(CAddressIndexKey(keyType, addrHash, nHeight, i, txhash, k, false), out.nValue));
+                    entries.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(keyType, addrHash, txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, nHeight)));
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// the entries DisconnectBlock writes for the block, in its reverse order
+static bool IndexBuilderDisconnectEntries(const CBlock &block, const CBlockUndo &blockUndo, int nIndexes, CIndexBuilderBlock &entries)
+{
+    const int nHeight = entries.pindex->GetHeight();
+
+    for (int i = block.vtx.size() - 1; i >= 0; i--)
+    {
+        const CTransaction &tx = block.vtx[i];
+        const uint256 hash = tx.GetHash();
+
+        if (nIndexes & INDEXBUILDER_ADDRESS)
+        {
+            for (unsigned int k = tx.vout.size(); k-- > 0;)
+            {
+                const CTxOut &out = tx.vout[k];
+
+                std::vector<std::vector<unsigned char>> vSols;
+                CTxDestination vDest;
+                txnouttype txType = TX_PUBKEYHASH;
+                int keyType = GetAddressType(out.scriptPubKey, vDest, txType, vSols);
+                if (keyType == 0)
+                    continue;
+                for (auto addr : vSols)
+                {
+                    uint160 addrHash = addr.size() == 20 ? uint160(addr) : Hash160(addr);
+                    entries.addressIndex.push_back(std::make_pair(CAddressIndexKey(keyType, addrHash, nHeight, i, hash, k, false), out.nValue));
+                    entries.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(keyType, addrHash, hash, k), CAddressUnspentValue()));
+                }
+            }
+        }
+
+        if (!tx.IsMint() && (nIndexes & (INDEXBUILDER_ADDRESS | INDEXBUILDER_SPENT)))
+        {
+            if (i == 0 || i > (int)blockUndo.vtxundo.size())
+                return false;
+            CTxUndo txundo = blockUndo.vtxundo[i-1];
+            if (tx.IsPegsImport()) txundo.vprevout.insert(txundo.vprevout.begin(), CTxInUndo());
+            if (txundo.vprevout.size() != tx.vin.size())
+                return false;
+            for (unsigned int j = tx.vin.size(); j-- > 0;)
+            {
+                if (tx.IsPegsImport() && j==0) continue;
+                const CTxIn &input = tx.vin[j];
+                const CTxInUndo &undo = txundo.vprevout[j];
+                const CTxOut &prevout = undo.txout;
+
+                if (nIndexes & INDEXBUILDER_SPENT)
+                    entries.spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue()));
+
+                if (nIndexes & INDEXBUILDER_ADDRESS)
+                {
+                    std::vector<std::vector<unsigned char>> vSols;
+                    CTxDestination vDest;
+                    txnouttype txType = TX_PUBKEYHASH;
+                    int keyType = GetAddressType(prevout.scriptPubKey, vDest, txType, vSols);
+                    if (keyType == 0)
+                        continue;
+                    for (auto addr : vSols)
+                    {
+                        uint160 addrHash = addr.size() == 20 ? uint160(addr) : Hash160(addr);
+                        entries.addressIndex.push_back(std::make_pair(CAddressIndexKey(keyType, addrHash, nHeight, i, hash, j, true), prevout.nValue * -1));
+                        entries.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(keyType, addrHash, input.prevout.hash, input.prevout.n), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undo.nHeight)));
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// reads pindex and its undo data from disk and builds its index entries
+static bool IndexBuilderReadBlock(int nIndexes, bool fConnect, CIndexBuilderBlock &entries)
+{
+    CBlock block;
+    CBlockUndo blockUndo;
+
+    if (!ReadBlockFromDisk(block, entries.pindex, 1))
+        return false;
+    if ((nIndexes & (INDEXBUILDER_ADDRESS | INDEXBUILDER_SPENT)) && !ReadBlockUndoFromDisk(blockUndo, entries.pindex))
+        return false;
+    if (fConnect)
+        return IndexBuilderConnectEntries(block, blockUndo, nIndexes, entries);
+    return IndexBuilderDisconnectEntries(block, blockUndo, nIndexes, entries);
+}
+
+static bool IndexBuilderWriteBlock(int nIndexes, bool fConnect, const CIndexBuilderBlock &entries)
+{
+    if (nIndexes & INDEXBUILDER_ADDRESS)
+    {
+        if (fConnect ? !pblocktree->WriteAddressIndex(entries.addressIndex) : !pblocktree->EraseAddressIndex(entries.addressIndex))
+            return error("%s: failed to write address index", __func__);
+        if (!pblocktree->UpdateAddressUnspentIndex(entries.addressUnspentIndex))
+            return error("%s: failed to write address unspent index", __func__);
+    }
+    if (nIndexes & INDEXBUILDER_SPENT)
+        if (!pblocktree->UpdateSpentIndex(entries.spentIndex))
+            return error("%s: failed to write spent index", __func__);
+
+    // as in DisconnectBlock, the timestamp entries of a disconnected block are left
+    if (fConnect && (nIndexes & INDEXBUILDER_TIMESTAMP))
+    {
+        const CBlockIndex *pindex = entries.pindex;
+        unsigned int logicalTS = pindex->nTime;
+        unsigned int prevLogicalTS = 0;
+
+        if (pindex->pprev && pindex->pprev->pprev)
+            if (!pblocktree->ReadTimestampBlockIndex(pindex->pprev->GetBlockHash(), prevLogicalTS))
+                return error("%s: failed to read the logical timestamp of %s", __func__, pindex->pprev->GetBlockHash().ToString());
+        if (logicalTS <= prevLogicalTS)
+            logicalTS = prevLogicalTS + 1;
+        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(logicalTS, pindex->GetBlockHash())))
+            return error("%s: failed to write timestamp index", __func__);
+        if (!pblocktree->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(logicalTS)))
+            return error("%s: failed to write blockhash index", __func__);
+    }
+    return true;
+}
+
+static void IndexBuilderSetStatus(int nIndexes, const CBlockIndex *pbest, int nTipHeight)
+{
+    boost::unique_lock<boost::mutex> lock(cs_indexbuilder);
+    indexBuilderStatus.nIndexes = nIndexes;
+    indexBuilderStatus.nHeight = pbest != NULL ? pbest->GetHeight() : -1;
+    indexBuilderStatus.nTipHeight = nTipHeight;
+}
+
+// enables the built indexes, called under cs_main with the builder at the tip
+static void IndexBuilderHandover(int nIndexes)
+{
+    if (nIndexes & INDEXBUILDER_ADDRESS) {
+        fAddressIndex = true;
+        pblocktree->WriteFlag("addressindex", true);
+        pblocktree->WriteFlag("addressbalanceindex", fAddressBalanceIndex);
+    }
+    if (nIndexes & INDEXBUILDER_SPENT) {
+        fSpentIndex = true;
+        pblocktree->WriteFlag("spentindex", true);
+    }
+    if (nIndexes & INDEXBUILDER_TIMESTAMP) {
+        fTimestampIndex = true;
+        pblocktree->WriteFlag("timestampindex", true);
+    }
+    pblocktree->EraseIndexBuilderBest();
+}
+
+static void ThreadIndexBuilder(int nIndexes)
+{
+    RenameThread("komodo-indexer");
+
+    int nThreads = GetArg("-backgroundindexthreads", DEFAULT_BACKGROUNDINDEX_THREADS);
+    if (nThreads <= 0)
+        nThreads = boost::thread::hardware_concurrency();
+    nThreads = std::max(1, std::min(nThreads, MAX_SCRIPTCHECK_THREADS));
+
+    // the genesis block is not indexed, as ConnectBlock returns before the indexes for it
+    const CBlockIndex *pbest = NULL;
+    {
+        LOCK(cs_main);
+        uint256 hashBest;
+        int nBestIndexes = 0;
+        if (pblocktree->ReadIndexBuilderBest(hashBest, nBestIndexes))
+        {
+            BlockMap::iterator mi = mapBlockIndex.find(hashBest);
+            if (nBestIndexes == nIndexes && mi != mapBlockIndex.end())
+                pbest = mi->second;
+            else
+                LogPrintf("%s: indexes %d were built up to %s, starting again for indexes %d\n", __func__, nBestIndexes, hashBest.ToString(), nIndexes);
+        }
+        if (pbest == NULL)
+            pbest = chainActive.Genesis();
+        if (pbest == NULL)
+        {
+            LogPrintf("%s: no active chain, indexes not built\n", __func__);
+            return;
+        }
+        boost::unique_lock<boost::mutex> lock(cs_indexbuilder);
+        indexBuilderStatus.nStartTime = GetTime();
+        indexBuilderStatus.nStartHeight = pbest->GetHeight();
+    }
+    LogPrintf("%s: building indexes %d from height %d with %d threads\n", __func__, nIndexes, pbest->GetHeight(), nThreads);
+
+    try {
+        while (true)
+        {
+            boost::this_thread::interruption_point();
+
+            std::vector<CIndexBuilderBlock> vBlocks;
+            {
+                LOCK(cs_main);
+                IndexBuilderSetStatus(nIndexes, pbest, chainActive.Height());
+
+                // the last block indexed was disconnected: undo its entries back to the fork
+                if (!chainActive.Contains(pbest))
+                {
+                    CIndexBuilderBlock entries;
+                    entries.pindex = pbest;
+                    if (!IndexBuilderReadBlock(nIndexes, false, entries) || !IndexBuilderWriteBlock(nIndexes, false, entries))
+                    {
+                        LogPrintf("%s: failed to disconnect %s, indexes not built\n", __func__, pbest->GetBlockHash().ToString());
+                        IndexBuilderSetStatus(0, pbest, chainActive.Height());
+                        return;
+                    }
+                    pbest = pbest->pprev;
+                    pblocktree->WriteIndexBuilderBest(pbest->GetBlockHash(), nIndexes);
+                    continue;
+                }
+                if (pbest == chainActive.Tip())
+                {
+                    IndexBuilderHandover(nIndexes);
+                    IndexBuilderSetStatus(0, pbest, chainActive.Height());
+                    LogPrintf("%s: indexes %d built up to height %d\n", __func__, nIndexes, pbest->GetHeight());
+                    return;
+                }
+                for (int nHeight = pbest->GetHeight() + 1; nHeight <= chainActive.Height() && vBlocks.size() < INDEXBUILDER_RUN_BLOCKS; nHeight++)
+                {
+                    vBlocks.push_back(CIndexBuilderBlock());
+                    vBlocks.back().pindex = chainActive[nHeight];
+                }
+            }
+
+            // workers read and decode blocks t, t+nThreads, ... of the run
+            boost::thread_group workers;
+            for (int t = 0; t < nThreads; t++)
+                workers.create_thread([&vBlocks, t, nThreads, nIndexes]() {
+                    for (size_t i = t; i < vBlocks.size(); i += nThreads)
+                        vBlocks[i].fOk = IndexBuilderReadBlock(nIndexes, true, vBlocks[i]);
+                });
+            try {
+                workers.join_all();
+            } catch (const boost::thread_interrupted&) {
+                // the workers use vBlocks, let them finish the run
+                workers.join_all();
+                throw;
+            }
+
+            // written in chain order, a block disconnected meanwhile is undone by the next pass
+            for (const CIndexBuilderBlock &entries : vBlocks)
+            {
+                if (!entries.fOk || !IndexBuilderWriteBlock(nIndexes, true, entries))
+                {
+                    LogPrintf("%s: failed to index %s, indexes not built\n", __func__, entries.pindex->GetBlockHash().ToString());
+                    IndexBuilderSetStatus(0, pbest, -1);
+                    return;
+                }
+                pbest = entries.pindex;
+            }
+            pblocktree->WriteIndexBuilderBest(pbest->GetBlockHash(), nIndexes);
+        }
+    } catch (const boost::thread_interrupted&) {
+        LogPrintf("%s: interrupted at height %d\n", __func__, pbest->GetHeight());
+        throw;
+    }
+}
+
+void IndexBuilderSetPending(int nIndexes)
+{
+    nPendingIndexes = nIndexes;
+}
+
+void StartIndexBuilder(boost::thread_group& threadGroup)
+{
+    // a reindex started by the block index loading builds them
+    if (nPendingIndexes == 0 || fReindex)
+        return;
+    if (nPendingIndexes & INDEXBUILDER_ADDRESS)
+        fAddressBalanceIndex = GetBoolArg("-addressbalanceindex", DEFAULT_ADDRESSBALANCEINDEX);
+    IndexBuilderSetStatus(nPendingIndexes, NULL, -1);
+    threadGroup.create_thread(boost::bind(&ThreadIndexBuilder, nPendingIndexes));
+}
+
+CIndexBuilderStatus GetIndexBuilderStatus()
+{
+    boost::unique_lock<boost::mutex> lock(cs_indexbuilder);
+    return indexBuilderStatus;
+}
@@ -0,0 +1,63 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef BITCOIN_INDEXBUILDER_H
+#define BITCOIN_INDEXBUILDER_H
+
+#include <stdint.h>
+
+namespace boost {
+    class thread_group;
+}
+
+/** -backgroundindex default: build newly enabled address, spent and timestamp indexes while the node runs, instead of a -reindex */
+static const bool DEFAULT_BACKGROUNDINDEX = false;
+/** -backgroundindexthreads default, threads reading blocks and undo data for the builder (0 = the number of cores) */
+static const int DEFAULT_BACKGROUNDINDEX_THREADS = 0;
+
+/** indexes built by the background index builder */
+enum IndexBuilderIndexes {
+    INDEXBUILDER_ADDRESS = 1,
+    INDEXBUILDER_SPENT = 2,
+    INDEXBUILDER_TIMESTAMP = 4,
+};
+
+struct CIndexBuilderStatus
+{
+    int nIndexes;       //!< IndexBuilderIndexes still being built, 0 when none
+    int nHeight;        //!< height of the last block indexed, -1 before the first one
+    int nTipHeight;
+    int64_t nStartTime;
+    int nStartHeight;
+
+    CIndexBuilderStatus() : nIndexes(0), nHeight(-1), nTipHeight(-1), nStartTime(0), nStartHeight(-1) {}
+};
+
+/**
+ * Background index builder: the indexes that init finds enabled but not
+ * built are written from the block and undo files of the active chain by
+ * a builder thread, with worker threads reading and decoding the blocks
+ * ahead of it. It follows reorgs of the blocks it indexed and records its
+ * last block, so a restart continues where it stopped.
+ *
+ * Until it reaches the tip ConnectBlock does not write these indexes and
+ * their RPCs report them disabled. At the tip they are enabled under
+ * cs_main, so the next block is indexed by ConnectBlock.
+ */
+void IndexBuilderSetPending(int nIndexes);
+void StartIndexBuilder(boost::thread_group& threadGroup);
+CIndexBuilderStatus GetIndexBuilderStatus();
+
+#endif // BITCOIN_INDEXBUILDER_H
@@ -28,28 +28,41 @@
 #include "primitives/block.h"
 #include "addrman.h"
 #include "amount.h"
+#include "blockfilterindex.h"
+#include "cc/CCevalcache.h"
+#include "cc/CCtxcache.h"
+#include "cc/CCtokencache.h"
+#include "cc/CCpricescache.h"
+#include "cc/CCstats.h"
+#include "chaineventlog.h"
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "consensus/upgrades.h"
 #include "consensus/validation.h"
 #include "httpserver.h"
 #include "httprpc.h"
+#include "indexbuilder.h"
 #include "key.h"
 #include "notarisationdb.h"
 #include "komodo_version.h"
 
 #ifdef ENABLE_MINING
 #include "key_io.h"
+#include "stratum.h"
 #endif
 #include "main.h"
 #include "metrics.h"
 #include "miner.h"
 #include "net.h"
+#include "policy/fees.h"
+#include "random.h"
 #include "rpc/server.h"
 #include "rpc/register.h"
+#include "script/sigcache.h"
 #include "script/standard.h"
 #include "scheduler.h"
 #include "txdb.h"
+#include "txoutsnapshot.h"
 #include "torcontrol.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -60,6 +73,7 @@
 #include "wallet/walletdb.h"
 
 #endif
+#include <atomic>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -91,6 +105,7 @@
 #endif
 
 #include "librustzcash.h"
+#include "zcash/Params.hpp"
 
 #ifdef ENABLE_WEBSOCKETS
 #include "komodo_websockets.h"
@@ -99,13 +114,13 @@
 using namespace std;
 
 #include "komodo_defs.h"
+#include "komodo_nSPV_defs.h"
 
 ZCJoinSplit* pzcashParams = NULL;
 
 #ifdef ENABLE_WALLET
 CWallet* pwalletMain = NULL;
 #endif
-bool fFeeEstimatesInitialized = false;
 
 #if ENABLE_ZMQ
 static CZMQNotificationInterface* pzmqNotificationInterface = NULL;
@@ -132,10 +147,17 @@ enum BindFlags {
     BF_WHITELIST    = (1U << 2),
 };
 
-static const char* FEE_ESTIMATES_FILENAME="fee_estimates.dat";
 
 static const char* DEFAULT_ASMAP_FILENAME="ip_asn.map";
 
+/** Smallest -memorybudget in megabytes, enough for the -dbcache and -maxmempool minimums */
+static const int64_t MIN_MEMORY_BUDGET = 32;
+/** Approximate memory per signature cache and decoded CC transaction cache entry, in bytes */
+static const int64_t SIGCACHE_ENTRY_BYTES = 96;
+static const int64_t CCTXCACHE_ENTRY_BYTES = 2048;
+/** -lazyparams default, read the Groth16 parameters on the first shielded proof instead of on startup */
+static const bool DEFAULT_LAZY_PARAMS = true;
+
 CClientUIInterface uiInterface; // Declared but not defined in ui_interface.h
 
 //////////////////////////////////////////////////////////////////////////////
@@ -195,9 +217,11 @@ public:
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
-static CCoinsViewDB *pcoinsdbview = NULL;
+CCoinsViewDB *pcoinsdbview = NULL;  // the chainstate database under pcoinsTip, for txoutsnapshot.cpp
 static CCoinsViewErrorCatcher *pcoinscatcher = NULL;
 static boost::scoped_ptr<ECCVerifyHandle> globalVerifyHandle;
+//! the new tip trigger of the komodo internals updater, see StartKomodoInternalsUpdater
+static boost::signals2::connection connKomodoInternalsTip;
 
 void Interrupt(boost::thread_group& threadGroup)
 {
@@ -206,6 +230,9 @@ void Interrupt(boost::thread_group& threadGroup)
     InterruptRPC();
     InterruptREST();
     InterruptTorControl();
+#ifdef ENABLE_MINING
+    InterruptStratum();
+#endif
     threadGroup.interrupt_all();
 }
 
@@ -234,6 +261,9 @@ void Shutdown()
     StopREST();
     StopRPC();
     StopHTTPServer();
+#ifdef ENABLE_MINING
+    StopStratum();
+#endif
 #ifdef ENABLE_WALLET
     if (pwalletMain)
         pwalletMain->Flush(false);
@@ -245,40 +275,48 @@ void Shutdown()
     GenerateBitcoins(false, 0);
  #endif
 #endif
+    connKomodoInternalsTip.disconnect();
     StopNode();
     StopTorControl();
     UnregisterNodeSignals(GetNodeSignals());
+    StopBlockPrefetch();
+    StopTxPreCheck();
+    StopMessageWorkers();
+    if (KOMODO_NSPV_SUPERLITE)
+        NSPV_saveproofcache();
 
-    if (fFeeEstimatesInitialized)
-    {
-        boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
-        CAutoFile est_fileout(fopen(est_path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
-        if (!est_fileout.IsNull())
-            mempool.WriteFeeEstimates(est_fileout);
-        else
-            LogPrintf("%s: Failed to write fee estimates to %s\n", __func__, est_path.string());
-        fFeeEstimatesInitialized = false;
-    }
+    DumpFeeEstimates();
+    if (GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL))
+        DumpMempool();
 
     {
         LOCK(cs_main);
         if (pcoinsTip != NULL) {
             FlushStateToDisk();
+            komodo_statecheck_save();
         }
         delete pcoinsTip;
         pcoinsTip = NULL;
+        // writes the flush above if it is still pending
+        delete pcoinsflush;
+        pcoinsflush = NULL;
         delete pcoinscatcher;
         pcoinscatcher = NULL;
         delete pcoinsdbview;
         pcoinsdbview = NULL;
         delete pblocktree;
         pblocktree = NULL;
+        DestroyBlockFilterIndex();
     }
+    // the wallet gets the notifications still queued before it is closed
+    SyncWithValidationInterfaceQueue();
 #ifdef ENABLE_WALLET
     if (pwalletMain)
         pwalletMain->Flush(true);
 #endif
 
+    UnregisterValidationInterface(&chainEventLog);
+
 #if ENABLE_ZMQ
     if (pzmqNotificationInterface) {
         UnregisterValidationInterface(pzmqNotificationInterface);
@@ -376,11 +414,20 @@ std::string HelpMessage(HelpMessageMode mode)
     string strUsage = HelpMessageGroup(_("Options:"));
     strUsage += HelpMessageOpt("-?", _("This help message"));
     strUsage += HelpMessageOpt("-alerts", strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS));
+    strUsage += HelpMessageOpt("-assumenotarized=<hex>", _("Skip the script, CC and shielded proof checks of the blocks this notarised block descends from, when it is on the best header chain. Coins and indexes are still updated (default: none)"));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-blockprefetch=<n>", strprintf(_("Read and deserialize up to <n> blocks ahead of the block being connected on a background thread, 0 to disable (default: %u)"), DEFAULT_BLOCK_PREFETCH));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
+    strUsage += HelpMessageOpt("-blockservecache=<n>", strprintf(_("Keep up to <n> MiB of the blocks recently served to peers ready to send, 0 to disable (default: %u)"), DEFAULT_BLOCK_SERVE_CACHE_SIZE));
     strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), 288));
+    strUsage += HelpMessageOpt("-checkheadersolutions", strprintf(_("Verify the Equihash solutions of received headers before adding them to the block index, using the script verification threads (default: %u)"), DEFAULT_CHECK_HEADER_SOLUTIONS));
     strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), 3));
     strUsage += HelpMessageOpt("-clientname=<SomeName>", _("Full node client name, default 'MagicBean'"));
+    strUsage += HelpMessageOpt("-compactevents", _("Free komodo state events below the latest notarized height, keeping only the rewindable tail (default: 1)"));
+    strUsage += HelpMessageOpt("-blockfilechunk=<n>", strprintf(_("Grow blk files on disk in steps of <n> MiB (1 to %u, default: %u)"), MAX_BLOCKFILE_SIZE >> 20, BLOCKFILE_CHUNK_SIZE >> 20));
+    strUsage += HelpMessageOpt("-undofilechunk=<n>", strprintf(_("Grow rev files on disk in steps of <n> MiB (1 to %u, default: %u)"), MAX_BLOCKFILE_SIZE >> 20, UNDOFILE_CHUNK_SIZE >> 20));
+    strUsage += HelpMessageOpt("-dropblockcache", strprintf(_("Drop blk and rev files from the page cache once written or reindexed, so that they don't push the chainstate out of it (default: %u)"), DEFAULT_DROP_BLOCK_CACHE));
+    strUsage += HelpMessageOpt("-compressblocks", strprintf(_("Store new blocks and undo data compressed in blk/rev files, files written either way stay readable (default: %u)"), DEFAULT_COMPRESS_BLOCKS));
     strUsage += HelpMessageOpt("-conf=<file>", strprintf(_("Specify configuration file (default: %s)"), "komodo.conf"));
     if (mode == HMM_BITCOIND)
     {
@@ -390,19 +437,42 @@ std::string HelpMessage(HelpMessageMode mode)
     }
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-exportdir=<dir>", _("Specify directory to be used when exporting data"));
+    strUsage += HelpMessageOpt("-indexdbcache=<n>", strprintf(_("Keep the address, spent, unspent CC and timestamp indexes in their own database with a cache of <n> megabytes, taken from -dbcache (0 = in the block index database, default: %d)"), 0));
+    strUsage += HelpMessageOpt("-dbsharedcache", strprintf(_("Share one LevelDB block cache between the databases, sized as the sum of their own block caches (default: %u)"), DEFAULT_DB_SHARED_CACHE));
+    strUsage += HelpMessageOpt("-dbtune=<db>:<option>=<n>", _("Override a LevelDB setting of the database <db> (chainstate, blocks/index, blocks/indexes, notarisations): cache (its own instead of the shared one) and writebuffer in megabytes, blocksize in kilobytes, bloombits per key (0 = no filter) or compression (0 or 1). Can be specified multiple times"));
+    strUsage += HelpMessageOpt("-backgroundflush", strprintf(_("Write the chainstate to disk on a thread of its own while blocks keep being connected, the flush being written takes up to -dbcache of memory more meanwhile (default: %u)"), DEFAULT_BACKGROUND_FLUSH));
+    strUsage += HelpMessageOpt("-memorybudget=<n>", strprintf(_("Size the caches of the node from one budget of <n> megabytes, for hosts running many chains side by side: the defaults of -dbcache, -maxmempool, -nspvcache, -maxsigcachesize and -maxcctxcachesize are taken from it (at least %d, default: none)"), MIN_MEMORY_BUDGET));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file") + " " + _("on startup"));
+    strUsage += HelpMessageOpt("-loadtxoutset=<file>", _("Load the chainstate from a dumptxoutset snapshot when it is empty, the blocks up to the snapshot must be on disk"));
+    strUsage += HelpMessageOpt("-loadtxoutsethash=<hex>", _("The hash a -loadtxoutset snapshot must have"));
+    strUsage += HelpMessageOpt("-loadindexthreads=<n>", strprintf(_("Set the number of threads reading the block index on startup (0 = auto, <0 = leave that many cores free, default: %d)"), DEFAULT_LOADINDEX_THREADS));
+    strUsage += HelpMessageOpt("-feeestimatehalflife=<n>", strprintf(_("Let the transactions confirmed <n> blocks ago count half in fee estimates, lower it on chains with few transactions for estimates to follow their fees sooner (default: %u)"), DEFAULT_FEE_ESTIMATE_HALFLIFE));
+    strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes, evicting the lowest fee rate transactions and their descendants (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
+    strUsage += HelpMessageOpt("-chaineventlogsize=<n>", strprintf(_("Keep the last <n> block and mempool events for getchainevents (default: %u)"), DEFAULT_CHAINEVENTLOG_SIZE));
+    strUsage += HelpMessageOpt("-asyncvalidation", strprintf(_("Run the callbacks of the wallet and the ZMQ and AMQP notifiers on threads of their own instead of the one connecting blocks (default: %u)"), DEFAULT_ASYNC_VALIDATION));
+    strUsage += HelpMessageOpt("-lazyparams", strprintf(_("Read the Sapling and Sprout Groth16 parameters when the first shielded proof is made or checked instead of on startup (default: %u)"), DEFAULT_LAZY_PARAMS));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+    strUsage += HelpMessageOpt("-maxorphanpeerbytes=<n>", strprintf(_("Keep at most <n> bytes of unconnectable transactions from one peer (default: %u)"), DEFAULT_MAX_ORPHAN_PEER_BYTES));
+    strUsage += HelpMessageOpt("-persistmempool", strprintf(_("Whether to save the mempool and its prioritised fee deltas on shutdown and load them on restart (default: %u)"), DEFAULT_PERSIST_MEMPOOL));
     strUsage += HelpMessageOpt("-mempooltxinputlimit=<n>", _("[DEPRECATED FROM OVERWINTER] Set the maximum number of transparent inputs in a transaction that the mempool will accept (default: 0 = no limit applied)"));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -(int)boost::thread::hardware_concurrency(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-txinvinterval=<n>", strprintf(_("Announce the relayed transactions to each peer in one inv batch about every <n> milliseconds, 0 trickles each announcement (default: %d)"), DEFAULT_TXINV_INTERVAL));
+    strUsage += HelpMessageOpt("-txprecheckthreads=<n>", strprintf(_("Check the signatures and Sapling proofs of relayed transactions on <n> threads before they are accepted under the main lock (0 to %d, default: %d)"), MAX_SCRIPTCHECK_THREADS, DEFAULT_TXPRECHECK_THREADS));
+    strUsage += HelpMessageOpt("-parallelcceval", strprintf(_("Validate independent CC inputs concurrently on the script verification threads, each with its own eval context (experimental, requires -par > 1, default: %u)"), DEFAULT_PARALLEL_CCEVAL));
+    strUsage += HelpMessageOpt("-ccstats", strprintf(_("Collect CC validation statistics by evalcode and funcid, reported by getccstats (default: %u)"), DEFAULT_CCSTATS));
 #ifndef _WIN32
+    strUsage += HelpMessageOpt("-passportshm", _("Export the KMD realtime state in a mapped passport.shm file in the data dir, so the assetchains on this host read it from memory instead of polling the state files (default: 0)"));
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), "komodod.pid"));
 #endif
     strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by pruning (deleting) old blocks. This mode disables wallet support and is incompatible with -txindex. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, >%u = target size in MiB to use for block files)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
+    strUsage += HelpMessageOpt("-prunekeeptxs", _("Keep the coinbase, staking, notarisation and CC transactions of the pruned blocks in the block index database, for the CC and notarisation lookups. -txindex can be used with -prune then (default: 0)"));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild block chain index from current blk000??.dat files on startup"));
+    strUsage += HelpMessageOpt("-fastkomodostate", _("Record the komodostate file and its tip on shutdown, a later -reindex keeps it when it still matches and does not scan the blocks it covers for notarisations again (default: 0)"));
+    strUsage += HelpMessageOpt("-reindexthreads=<n>", strprintf(_("Number of threads reading and deserializing blk files ahead of the block import during -reindex, 0 to read them in the import thread (default: %u)"), DEFAULT_REINDEX_THREADS));
 #if !defined(WIN32)
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
@@ -410,12 +480,22 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)"), DEFAULT_TIMESTAMPINDEX));
     strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)"), DEFAULT_SPENTINDEX));
+    strUsage += HelpMessageOpt("-tokenbalanceindex", strprintf(_("Maintain per address and tokenid token balances, used by tokenbalance and tokenallbalances (default: %u)"), DEFAULT_TOKENBALANCEINDEX));
+    strUsage += HelpMessageOpt("-oraclesindex", strprintf(_("Maintain an index of oracles data samples by oracle, publisher and height, used by oraclessamples and the gateways (default: %u)"), DEFAULT_ORACLESINDEX));
+    strUsage += HelpMessageOpt("-tokentagsindex", strprintf(_("Maintain an index of the token tags updates, used by tokentaginfo and tokentaghistory (default: %u)"), DEFAULT_TOKENTAGSINDEX));
+    strUsage += HelpMessageOpt("-agreementsindex", strprintf(_("Maintain an index of the agreements events and references, used by agreementinfo, agreementeventlog and agreementreferences (default: %u)"), DEFAULT_AGREEMENTSINDEX));
+    strUsage += HelpMessageOpt("-gatewaysindex", strprintf(_("Maintain an index of the gateways withdraws state, used by gatewayspendingwithdraws and gatewaysprocessed (default: %u)"), DEFAULT_GATEWAYSINDEX));
+    strUsage += HelpMessageOpt("-addressbalanceindex", strprintf(_("Maintain per address balances and a rich list with the address index, used by getsnapshot and the daily snapshots (default: %u)"), DEFAULT_ADDRESSBALANCEINDEX));
+    strUsage += HelpMessageOpt("-backgroundindex", strprintf(_("Build a newly enabled -addressindex, -spentindex or -timestampindex in the background from the block files instead of reindexing, the index is enabled once it reaches the tip (default: %u)"), DEFAULT_BACKGROUNDINDEX));
+    strUsage += HelpMessageOpt("-backgroundindexthreads=<n>", strprintf(_("Number of threads reading blocks for -backgroundindex, 0 = the number of cores (default: %u)"), DEFAULT_BACKGROUNDINDEX_THREADS));
+    strUsage += HelpMessageOpt("-blockfilterindex", strprintf(_("Maintain the basic compact block filters of BIP 158, with the cc addresses of the cc scripts, for nSPV and light clients (default: %u)"), DEFAULT_BLOCKFILTERINDEX));
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
     strUsage += HelpMessageOpt("-asmap=<file>", strprintf("Specify asn mapping used for bucketing of the peers (default: %s). Relative paths will be prefixed by the net-specific datadir location.", DEFAULT_ASMAP_FILENAME));
     strUsage += HelpMessageOpt("-banscore=<n>", strprintf(_("Threshold for disconnecting misbehaving peers (default: %u)"), 100));
     strUsage += HelpMessageOpt("-bantime=<n>", strprintf(_("Number of seconds to keep misbehaving peers from reconnecting (default: %u)"), 86400));
     strUsage += HelpMessageOpt("-bind=<addr>", _("Bind to given address and always listen on it. Use [host]:port notation for IPv6"));
+    strUsage += HelpMessageOpt("-cmpctblocks", strprintf(_("Relay and fetch new blocks as compact blocks (BIP 152) with the peers that support them (default: %u)"), DEFAULT_CMPCTBLOCKS));
     strUsage += HelpMessageOpt("-connect=<ip>", _("Connect only to the specified node(s)"));
     strUsage += HelpMessageOpt("-discover", _("Discover own IP addresses (default: 1 when listening and no -externalip or -proxy)"));
     strUsage += HelpMessageOpt("-dns", _("Allow DNS lookups for -addnode, -seednode and -connect") + " " + _("(default: 1)"));
@@ -427,17 +507,22 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxconnections=<n>", strprintf(_("Maintain at most <n> connections to peers (default: %u)"), DEFAULT_MAX_PEER_CONNECTIONS));
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), 5000));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), 1000));
+    strUsage += HelpMessageOpt("-msgworkerthreads=<n>", strprintf(_("Serve block getdata and nSPV requests on <n> threads beside the message handler (0 to %d, default: %d)"), MAX_SCRIPTCHECK_THREADS, DEFAULT_MSGWORKER_THREADS));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), 1));
+    strUsage += HelpMessageOpt("-peerblockfilters", strprintf(_("Serve the compact block filters of -blockfilterindex to peers (default: %u)"), DEFAULT_PEERBLOCKFILTERS));
     strUsage += HelpMessageOpt("-peerbloomfilters", strprintf(_("Support filtering of blocks and transaction with Bloom filters (default: %u)"), 1));
     strUsage += HelpMessageOpt("-nspv_msg", strprintf(_("Enable NSPV messages processing (default: %u)"), DEFAULT_NSPV_PROCESSING));
+    strUsage += HelpMessageOpt("-nspvcache=<n>", strprintf(_("Keep up to <n> MiB of the nSPV responses for the current tip ready to send, 0 to disable (default: %u)"), DEFAULT_NSPV_RESPONSE_CACHE_SIZE));
+    strUsage += HelpMessageOpt("-nspvpeerrate=<n>", strprintf(_("Let each nSPV peer spend <n> request cost units per second, an info request costs 1 and a remote rpc 10, 0 for no limit (default: %u)"), DEFAULT_NSPV_PEER_RATE));
     if (showDebug)
         strUsage += HelpMessageOpt("-enforcenodebloom", strprintf("Enforce minimum protocol version to limit use of Bloom filters (default: %u)", 0));
     strUsage += HelpMessageOpt("-port=<port>", strprintf(_("Listen for connections on <port> (default: %u or testnet: %u)"), 7770, 17770));
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
     strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)"), 1));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
+    strUsage += HelpMessageOpt("-socketevents=<mode>", strprintf(_("How to wait for the peer sockets to be ready, one of: %s (default: %s)"), GetSocketEventsModes(), DEFAULT_SOCKETEVENTS));
     strUsage += HelpMessageOpt("-timeout=<n>", strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT));
     strUsage += HelpMessageOpt("-torcontrol=<ip>:<port>", strprintf(_("Tor control port to use if onion listening enabled (default: %s)"), DEFAULT_TOR_CONTROL));
     strUsage += HelpMessageOpt("-torpassword=<pass>", _("Tor control port password (default: empty)"));
@@ -477,6 +562,10 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubccevent=<address>", _("Enable publish decoded CC transaction events in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubremovedtx=<address>", _("Enable publish hash of transactions removed from the mempool in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubnotarized=<address>", _("Enable publish notarizations in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubsequence=<address>", _("Enable publish the numbered block connect and disconnect and mempool add and remove events in <address>"));
 #endif
 
 #if ENABLE_PROTON
@@ -485,6 +574,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-amqppubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-amqppubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-amqppubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-amqppubccevent=<address>", _("Enable publish decoded CC transaction events in <address>"));
+    strUsage += HelpMessageOpt("-amqppubremovedtx=<address>", _("Enable publish hash of transactions removed from the mempool in <address>"));
+    strUsage += HelpMessageOpt("-amqppubnotarized=<address>", _("Enable publish notarizations in <address>"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -501,7 +593,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-nuparams=hexBranchId:activationHeight", "Use given activation height for specified network upgrade (regtest-only)");
     }
     string debugCategories = "addrman, alert, bench, coindb, db, estimatefee, http, libevent, lock, mempool, net, partitioncheck, pow, proxy, prune, "
-                             "rand, reindex, rpc, selectcoins, tor, zmq, zrpc, zrpcunsafe (implies zrpc)"; // Don't translate these
+                             "rand, reindex, rpc, selectcoins, tor, zmq, zrpc, zrpcunsafe (implies zrpc), ccstats"; // Don't translate these
     strUsage += HelpMessageOpt("-debug=<category>", strprintf(_("Output debugging information (default: %u, supplying <category> is optional)"), 0) + ". " +
         _("If <category> is not supplied or if <category> = 1, output all debugging information.") + " " + _("<category> can be:") + " " + debugCategories + ".");
     strUsage += HelpMessageOpt("-experimentalfeatures", _("Enable use of experimental features"));
@@ -512,8 +604,14 @@ std::string HelpMessage(HelpMessageMode mode)
     {
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default: %u)", 15));
         strUsage += HelpMessageOpt("-relaypriority", strprintf("Require high priority for relaying free or low-fee transactions (default: %u)", 0));
-        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit size of signature cache to <n> entries (default: %u)", 50000));
+        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit size of signature cache, and of the crypto-condition signature cache, to <n> entries (default: %u)", 50000));
+        strUsage += HelpMessageOpt("-maxccevalcachesize=<n>", strprintf("Limit size of CC eval results cache to <n> entries, 0 to disable (default: %u)", DEFAULT_MAX_CCEVAL_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxccdecodecachesize=<n>", strprintf("Limit size of the decoded crypto-condition fulfillments cache to <n> entries, 0 to disable (default: %u)", DEFAULT_MAX_CC_DECODE_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxcctxcachesize=<n>", strprintf("Limit size of the decoded transaction cache used by CC modules to <n> entries, 0 to disable (default: %u)", DEFAULT_MAX_CCTX_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxtokencachesize=<n>", strprintf("Limit size of the decoded token creation cache to <n> entries, 0 to disable (default: %u)", DEFAULT_MAX_TOKEN_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxpricescachesize=<n>", strprintf("Limit size of the prices cc synthetic prices cache to <n> entries, 0 to disable (default: %u)", DEFAULT_MAX_PRICES_CACHE_SIZE));
         strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE));
+        strUsage += HelpMessageOpt("-lockprofile", strprintf("Count the locks, wait and hold times of every lock site, including the DEX lock, for getlockprofile (default: %u)", 0));
     }
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in %s/kB) smaller than this are considered zero fee for relaying (default: %s)"),
         CURRENCY_UNIT, FormatMoney(::minRelayTxFee.GetFeePerK())));
@@ -544,7 +642,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-mint", strprintf(_("Mint/stake coins automatically (default: %u)"), 0));
     strUsage += HelpMessageOpt("-gen", strprintf(_("Mine/generate coins (default: %u)"), 0));
     strUsage += HelpMessageOpt("-genproclimit=<n>", strprintf(_("Set the number of threads for coin mining if enabled (-1 = all cores, default: %d)"), 0));
-    strUsage += HelpMessageOpt("-equihashsolver=<name>", _("Specify the Equihash solver to be used if enabled (default: \"default\")"));
+    strUsage += HelpMessageOpt("-equihashsolver=<name>", _("Specify the Equihash solver to be used if enabled, \"tromp\" or \"default\" (default: \"tromp\" where n = 200, k = 9, otherwise \"default\")"));
     strUsage += HelpMessageOpt("-mineraddress=<addr>", _("Send mined coins to a specific single address"));
     strUsage += HelpMessageOpt("-minetolocalwallet", strprintf(
             _("Require that mined blocks use a coinbase address in the local wallet (default: %u)"),
@@ -554,6 +652,10 @@ std::string HelpMessage(HelpMessageMode mode)
             0
  #endif
             ));
+    strUsage += HelpMessageOpt("-stratum", strprintf(_("Push work to external Equihash miners over the stratum protocol (default: %u)"), DEFAULT_STRATUM));
+    strUsage += HelpMessageOpt("-stratumport=<port>", _("Listen for stratum connections on <port> (default: the JSON-RPC port + 1)"));
+    strUsage += HelpMessageOpt("-stratumbind=<addr>", _("Bind to given address to listen for stratum connections. Use [host]:port notation for IPv6. This option can be specified multiple times (default: bind to all interfaces)"));
+    strUsage += HelpMessageOpt("-stratumallowip=<ip>", _("Allow stratum connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
 #endif
 
     strUsage += HelpMessageGroup(_("RPC server options:"));
@@ -567,11 +669,13 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
     if (showDebug) {
         strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
+        strUsage += HelpMessageOpt("-rpcworkqueueclient=<n>", "Set how many of the queued RPC calls can come from one client, by IP and user (default: half the work queue depth)");
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT));
     }
 
-    // Disabled until we can lock notes and also tune performance of libsnark which by default uses multiple threads
-    //strUsage += HelpMessageOpt("-rpcasyncthreads=<n>", strprintf(_("Set the number of threads to service Async RPC calls (default: %d)"), 1));
+    strUsage += HelpMessageOpt("-rpcasyncthreads=<n>", strprintf(_("Set the number of threads to service Async RPC calls (default: %d)"), DEFAULT_RPC_ASYNC_THREADS));
+    strUsage += HelpMessageOpt("-rpcasyncpriority=<method>:<n>", _("Run the queued async operations of an RPC method before those of lower priority (default: 0, -1 for z_mergetoaddress and z_shieldcoinbase). This option can be specified multiple times"));
+    strUsage += HelpMessageOpt("-rpcasynclimit=<method>:<n>", _("Run at most <n> async operations of an RPC method at once, 0 for no limit (default: 0). This option can be specified multiple times"));
 
     if (mode == HMM_BITCOIND) {
         strUsage += HelpMessageGroup(_("Metrics Options (only if -daemon and -printtoconsole are not set):"));
@@ -662,8 +766,6 @@ void CleanupBlockRevFiles()
                 remove(it->path());
         }
     }
-    path komodostate = GetDataDir() / "komodostate";
-    remove(komodostate);
     path minerids = GetDataDir() / "minerids";
     remove(minerids);
     // Remove all block files that aren't part of a contiguous set starting at
@@ -687,16 +789,21 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
     if (fReindex) {
         CImportingNow imp;
         int nFile = 0;
-        while (true) {
-            CDiskBlockPos pos(nFile, 0);
-            if (!boost::filesystem::exists(GetBlockPosFilename(pos, "blk")))
-                break; // No block files left to reindex
-            FILE *file = OpenBlockFile(pos, true);
-            if (!file)
-                break; // This error is logged in OpenBlockFile
-            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-            LoadExternalBlockFile(file, &pos);
-            nFile++;
+        int nReindexThreads = std::min((int)GetArg("-reindexthreads", DEFAULT_REINDEX_THREADS), MAX_SCRIPTCHECK_THREADS);
+        if (nReindexThreads > 0) {
+            LoadBlockFilesParallel(nReindexThreads);
+        } else {
+            while (true) {
+                CDiskBlockPos pos(nFile, 0);
+                if (!boost::filesystem::exists(GetBlockPosFilename(pos, "blk")))
+                    break; // No block files left to reindex
+                FILE *file = OpenBlockFile(pos, true);
+                if (!file)
+                    break; // This error is logged in OpenBlockFile
+                LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
+                LoadExternalBlockFile(file, &pos);
+                nFile++;
+            }
         }
         pblocktree->WriteReindexing(false);
         fReindex = false;
@@ -737,6 +844,10 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
         LogPrintf("Stopping after block import\n");
         StartShutdown();
     }
+
+    // the mempool is loaded here, off the startup path, the node serves peers meanwhile
+    if (GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL) && !KOMODO_NSPV_SUPERLITE)
+        LoadMempool();
 }
 
 void ThreadNotifyRecentlyAdded()
@@ -755,64 +866,72 @@ void ThreadNotifyRecentlyAdded()
     }
 }
 
-void ThreadUpdateKomodoInternals() {
-    RenameThread("int-updater");
-
-    // boost::signals2::connection c = uiInterface.NotifyBlockTip.connect(
-    //     [](const uint256& hashNewTip) mutable {
-    //         CBlockIndex* pblockindex = mapBlockIndex[hashNewTip];
-    //         std::cerr << __FUNCTION__ << ": NotifyBlockTip " << hashNewTip.ToString() << " - " << pblockindex->GetHeight() << std::endl;
-    //     }
-    //     );
+/**
+ * The komodo internals (passport iteration on KMD, the cbopret prices on
+ * assetchains) are updated from the scheduler thread every
+ * KomodoInternalsInterval() seconds, plus up to a quarter of that at random
+ * so many daemons on one host don't all wake at once, and right away on
+ * each new tip. A run reschedules the next one, a periodic run that was
+ * overtaken by a tip run is skipped.
+ */
+static std::atomic<uint64_t> nKomodoInternalsRun(0);
+static std::atomic<bool> fKomodoInternalsTipRunQueued(false);
 
-    int fireDelaySeconds = 10;
+static int64_t KomodoInternalsInterval()
+{
+    if ( ASSETCHAINS_SYMBOL[0] == 0 )
+        return 10;
+    return ASSETCHAINS_BLOCKTIME/5 + 1;
+}
 
+static void UpdateKomodoInternals()
+{
     try {
-        while (true) {
-
-            if ( ASSETCHAINS_SYMBOL[0] == 0 )
-                fireDelaySeconds = 10;
-            else
-                fireDelaySeconds = ASSETCHAINS_BLOCKTIME/5 + 1;
-
-            // Run the updater on an integer fireDelaySeconds seconds in the steady clock.
-            auto now = std::chrono::steady_clock::now().time_since_epoch();
-            auto nextFire = std::chrono::duration_cast<std::chrono::seconds>(
-                now + std::chrono::seconds(fireDelaySeconds));
-            std::this_thread::sleep_until(
-                std::chrono::time_point<std::chrono::steady_clock>(nextFire));
-
-            boost::this_thread::interruption_point();
-
-            if ( ASSETCHAINS_SYMBOL[0] == 0 )
-                {
-                    if ( KOMODO_NSPV_FULLNODE ) {
-                        auto start = std::chrono::high_resolution_clock::now();
-                        komodo_passport_iteration(); // call komodo_interestsum() inside (possible locks)
-                        auto finish = std::chrono::high_resolution_clock::now();
-                        std::chrono::duration<double, std::milli> elapsed = finish - start;
-                        // std::cerr << DateTimeStrFormat("%Y-%m-%d %H:%M:%S", GetTime()) << " " << __FUNCTION__ << ": komodo_passport_iteration -> Elapsed Time: " << elapsed.count() << " ms" << std::endl;
-                    }
-                }
-            else
-                {
-                    if ( ASSETCHAINS_CBOPRET != 0 )
-                        komodo_cbopretupdate(0);
-                }
+        if ( ASSETCHAINS_SYMBOL[0] == 0 )
+        {
+            if ( KOMODO_NSPV_FULLNODE )
+                komodo_passport_iteration(); // call komodo_interestsum() inside (possible locks)
+        }
+        else
+        {
+            if ( ASSETCHAINS_CBOPRET != 0 )
+                komodo_cbopretupdate(0);
         }
     }
     catch (const boost::thread_interrupted&) {
-        // std::cerr << "ThreadUpdateKomodoInternals() interrupted" << std::endl;
-        // c.disconnect();
         throw;
     }
     catch (const std::exception& e) {
-        PrintExceptionContinue(&e, "ThreadUpdateKomodoInternals()");
+        PrintExceptionContinue(&e, "UpdateKomodoInternals()");
     }
     catch (...) {
-        PrintExceptionContinue(NULL, "ThreadUpdateKomodoInternals()");
+        PrintExceptionContinue(NULL, "UpdateKomodoInternals()");
     }
+}
+
+static void RunKomodoInternals(CScheduler* scheduler, uint64_t nRun)
+{
+    if ( nRun == 0 )
+        fKomodoInternalsTipRunQueued = false;
+    else if ( nRun != nKomodoInternalsRun )
+        return;
 
+    UpdateKomodoInternals();
+
+    int64_t nInterval = KomodoInternalsInterval();
+    int64_t nDelayMillis = nInterval * 1000 + GetRand(nInterval * 250 + 1);
+    scheduler->schedule(boost::bind(&RunKomodoInternals, scheduler, ++nKomodoInternalsRun),
+                        boost::chrono::system_clock::now() + boost::chrono::milliseconds(nDelayMillis));
+}
+
+static void StartKomodoInternalsUpdater(CScheduler& scheduler)
+{
+    CScheduler* pscheduler = &scheduler;
+    connKomodoInternalsTip = uiInterface.NotifyBlockTip.connect([pscheduler](const uint256&) {
+        if ( !fKomodoInternalsTipRunQueued.exchange(true) )
+            pscheduler->schedule(boost::bind(&RunKomodoInternals, pscheduler, 0), boost::chrono::system_clock::now());
+    });
+    scheduler.scheduleFromNow(boost::bind(&RunKomodoInternals, pscheduler, ++nKomodoInternalsRun), KomodoInternalsInterval());
 }
 
 /** Sanity checks
@@ -871,33 +990,10 @@ static void ZC_LoadParams(
     elapsed = float(tv_end.tv_sec-tv_start.tv_sec) + (tv_end.tv_usec-tv_start.tv_usec)/float(1000000);
     LogPrintf("Loaded verifying key in %fs seconds.\n", elapsed);
 
-    static_assert(
-        sizeof(boost::filesystem::path::value_type) == sizeof(codeunit),
-        "librustzcash not configured correctly");
-    auto sapling_spend_str = sapling_spend.native();
-    auto sapling_output_str = sapling_output.native();
-    auto sprout_groth16_str = sprout_groth16.native();
-
-    LogPrintf("Loading Sapling (Spend) parameters from %s\n", sapling_spend.string().c_str());
-    LogPrintf("Loading Sapling (Output) parameters from %s\n", sapling_output.string().c_str());
-    LogPrintf("Loading Sapling (Sprout Groth16) parameters from %s\n", sprout_groth16.string().c_str());
-    gettimeofday(&tv_start, 0);
-
-    librustzcash_init_zksnark_params(
-        reinterpret_cast<const codeunit*>(sapling_spend_str.c_str()),
-        sapling_spend_str.length(),
-        "8270785a1a0d0bc77196f000ee6d221c9c9894f55307bd9357c3f0105d31ca63991ab91324160d8f53e2bbd3c2633a6eb8bdf5205d822e7f3f73edac51b2b70c",
-        reinterpret_cast<const codeunit*>(sapling_output_str.c_str()),
-        sapling_output_str.length(),
-        "657e3d38dbb5cb5e7dd2970e8b03d69b4787dd907285b5a7f0790dcc8072f60bf593b32cc2d1c030e00ff5ae64bf84c5c3beb84ddc841d48264b4a171744d028",
-        reinterpret_cast<const codeunit*>(sprout_groth16_str.c_str()),
-        sprout_groth16_str.length(),
-        "e9b238411bd6c0ec4791e9d04245ec350c9c5744f5610dfcce4365d5ca49dfefd5054e371842b3f88fa1b9d7e8e075249b3ebabd167fa8b0f3161292d36c180a"
-    );
-
-    gettimeofday(&tv_end, 0);
-    elapsed = float(tv_end.tv_sec-tv_start.tv_sec) + (tv_end.tv_usec-tv_start.tv_usec)/float(1000000);
-    LogPrintf("Loaded Sapling parameters in %fs seconds.\n", elapsed);
+    // the Groth16 parameters are the bulk of it, read them when a shielded proof is first made or checked
+    libzcash::SetGrothParamsPaths(sapling_spend, sapling_output, sprout_groth16);
+    if (!GetBoolArg("-lazyparams", DEFAULT_LAZY_PARAMS))
+        libzcash::LoadGrothParams();
 }
 
 bool AppInitServers(boost::thread_group& threadGroup)
@@ -1052,6 +1148,28 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             LogPrintf("%s: parameter interaction: -externalip set -> setting -discover=0\n", __func__);
     }
 
+    if (mapArgs.count("-memorybudget")) {
+        // split one budget between the caches that scale, anything set explicitly wins
+        int64_t nBudget = GetArg("-memorybudget", 0);
+        if (nBudget < MIN_MEMORY_BUDGET)
+            return InitError(strprintf(_("-memorybudget must be at least %d MB"), MIN_MEMORY_BUDGET));
+        int64_t nDbCache = std::max(nBudget * 55 / 100, nMinDbCache);
+        int64_t nMempool = std::max(nBudget * 35 / 100, (int64_t)5);
+        int64_t nNSPVCache = nBudget * 5 / 100;
+        int64_t nSigCache = (nBudget << 20) * 25 / 1000 / SIGCACHE_ENTRY_BYTES;
+        int64_t nCCTxCache = (nBudget << 20) * 25 / 1000 / CCTXCACHE_ENTRY_BYTES;
+        if (SoftSetArg("-dbcache", i64tostr(nDbCache)))
+            LogPrintf("%s: parameter interaction: -memorybudget=%d -> setting -dbcache=%d\n", __func__, nBudget, nDbCache);
+        if (SoftSetArg("-maxmempool", i64tostr(nMempool)))
+            LogPrintf("%s: parameter interaction: -memorybudget=%d -> setting -maxmempool=%d\n", __func__, nBudget, nMempool);
+        if (SoftSetArg("-nspvcache", i64tostr(nNSPVCache)))
+            LogPrintf("%s: parameter interaction: -memorybudget=%d -> setting -nspvcache=%d\n", __func__, nBudget, nNSPVCache);
+        if (SoftSetArg("-maxsigcachesize", i64tostr(nSigCache)))
+            LogPrintf("%s: parameter interaction: -memorybudget=%d -> setting -maxsigcachesize=%d\n", __func__, nBudget, nSigCache);
+        if (SoftSetArg("-maxcctxcachesize", i64tostr(nCCTxCache)))
+            LogPrintf("%s: parameter interaction: -memorybudget=%d -> setting -maxcctxcachesize=%d\n", __func__, nBudget, nCCTxCache);
+    }
+
     // Read asmap file if configured
     if (mapArgs.count("-asmap")) {
         fs::path asmap_path = fs::path(GetArg("-asmap", ""));
@@ -1089,11 +1207,19 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             LogPrintf("%s: parameter interaction: -zapwallettxes=<mode> -> setting -rescan=1\n", __func__);
     }
 
+    std::string strSocketEvents = GetArg("-socketevents", DEFAULT_SOCKETEVENTS);
+    if (!SetSocketEventsMode(strSocketEvents))
+        return InitError(strprintf(_("Invalid -socketevents '%s', valid values: %s"), strSocketEvents, GetSocketEventsModes()));
+
     // Make sure enough file descriptors are available
     int nBind = std::max((int)mapArgs.count("-bind") + (int)mapArgs.count("-whitebind"), 1);
     nMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     //fprintf(stderr,"nMaxConnections %d\n",nMaxConnections);
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+    // only select() can't wait on the sockets over FD_SETSIZE
+    if (GetSocketEventsMode() == SOCKETEVENTS_SELECT)
+        nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+    else
+        nMaxConnections = std::max(nMaxConnections, 0);
     int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     //fprintf(stderr,"nMaxConnections %d FD_SETSIZE.%d nBind.%d expr.%d \n",nMaxConnections,FD_SETSIZE,nBind,(int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS));
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
@@ -1104,7 +1230,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     // if using block pruning, then disable txindex
     // also disable the wallet (for now, until SPV support is implemented in wallet)
     if (GetArg("-prune", 0)) {
-        if (GetBoolArg("-txindex", true))
+        // the kept transactions are found without their block files, so the tx index still serves them
+        if (GetBoolArg("-txindex", true) && !GetBoolArg("-prunekeeptxs", false))
             return InitError(_("Prune mode is incompatible with -txindex."));
 #ifdef ENABLE_WALLET
         if (!GetBoolArg("-disablewallet", false)) {
@@ -1153,6 +1280,13 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = GetBoolArg("-checkpoints", true);
+    if (mapArgs.count("-assumenotarized")) {
+        std::string strAssumeNotarized = GetArg("-assumenotarized", "");
+        if (!IsHex(strAssumeNotarized) || strAssumeNotarized.size() != 64)
+            return InitError(strprintf(_("Invalid block hash for -assumenotarized: '%s'"), strAssumeNotarized));
+        hashAssumeNotarized = uint256S(strAssumeNotarized);
+        LogPrintf("Skipping script, CC and proof checks of the ancestors of notarised block %s\n", hashAssumeNotarized.GetHex());
+    }
 
     // -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
     nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
@@ -1162,6 +1296,16 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         nScriptCheckThreads = 0;
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
+    fParallelCCEval = GetBoolArg("-parallelcceval", DEFAULT_PARALLEL_CCEVAL) && nScriptCheckThreads != 0;
+    nTxInvInterval = std::max((int64_t)0, GetArg("-txinvinterval", DEFAULT_TXINV_INTERVAL));
+    CCStatsEnable(GetBoolArg("-ccstats", DEFAULT_CCSTATS));
+    InitCCSignatureCache();
+    fCheckHeaderSolutions = GetBoolArg("-checkheadersolutions", DEFAULT_CHECK_HEADER_SOLUTIONS);
+    fCompressBlocks = GetBoolArg("-compressblocks", DEFAULT_COMPRESS_BLOCKS);
+    nBlockFileChunkSize = (unsigned int)std::min<int64_t>(std::max<int64_t>(GetArg("-blockfilechunk", BLOCKFILE_CHUNK_SIZE >> 20), 1), MAX_BLOCKFILE_SIZE >> 20) << 20;
+    nUndoFileChunkSize = (unsigned int)std::min<int64_t>(std::max<int64_t>(GetArg("-undofilechunk", UNDOFILE_CHUNK_SIZE >> 20), 1), MAX_BLOCKFILE_SIZE >> 20) << 20;
+    fDropBlockCache = GetBoolArg("-dropblockcache", DEFAULT_DROP_BLOCK_CACHE);
+    fCompactBlocks = GetBoolArg("-cmpctblocks", DEFAULT_CMPCTBLOCKS);
 
     fServer = GetBoolArg("-server", false);
 
@@ -1177,6 +1321,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
         LogPrintf("Prune configured to target %uMiB on disk for block and undo files.\n", nPruneTarget / 1024 / 1024);
         fPruneMode = true;
+        fPruneKeepTxs = GetBoolArg("-prunekeeptxs", false);
     }
 
     RegisterAllCoreRPCCommands(tableRPC);
@@ -1291,6 +1436,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
     }
 
+    // the mempool needs room for a few large transactions
+    if (GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) < 5)
+        return InitError(_("-maxmempool must be at least 5 MB"));
+
     if (!mapMultiArgs["-nuparams"].empty()) {
         // Allow overriding network upgrade parameters for testing
         if (Params().NetworkIDString() != "regtest") {
@@ -1400,9 +1549,31 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     std::ostringstream strErrors;
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+    if (fParallelCCEval)
+        LogPrintf("CC validation runs concurrently on the script verification threads\n");
+    if (fCheckHeaderSolutions)
+        LogPrintf("Verifying header Equihash solutions on %u threads\n", std::max(1, nScriptCheckThreads));
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        if (fCheckHeaderSolutions) {
+            for (int i=0; i<nScriptCheckThreads-1; i++)
+                threadGroup.create_thread(&ThreadHeaderSolutionCheck);
+        }
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadSaplingProofCheck);
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadCCSign);
+    }
+    int nTxPreCheckThreads = std::min((int)GetArg("-txprecheckthreads", DEFAULT_TXPRECHECK_THREADS), MAX_SCRIPTCHECK_THREADS);
+    if (nTxPreCheckThreads > 0) {
+        LogPrintf("Checking relayed transactions on %d threads before AcceptToMemoryPool\n", nTxPreCheckThreads);
+        StartTxPreCheck(nTxPreCheckThreads);
+    }
+    int nMessageWorkerThreads = std::min((int)GetArg("-msgworkerthreads", DEFAULT_MSGWORKER_THREADS), MAX_SCRIPTCHECK_THREADS);
+    if (nMessageWorkerThreads > 0) {
+        LogPrintf("Serving block getdata and nSPV requests on %d threads\n", nMessageWorkerThreads);
+        StartMessageWorkers(nMessageWorkerThreads);
     }
 
     // Start the lightweight task scheduler thread
@@ -1411,6 +1582,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     // Count uptime
     MarkStartTime();
+    StartLockWaitMetrics();
+    EnableLockProfile(GetBoolArg("-lockprofile", false));
 
     if ((chainparams.NetworkIDString() != "regtest") &&
             GetBoolArg("-showmetrics", 0) &&
@@ -1584,6 +1757,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     BOOST_FOREACH(const std::string& strDest, mapMultiArgs["-seednode"])
         AddOneShot(strDest);
 
+    chainEventLog.SetMaxSize(std::max(GetArg("-chaineventlogsize", DEFAULT_CHAINEVENTLOG_SIZE), (int64_t)1));
+    // synchronous, the events are numbered in the order they happen
+    RegisterValidationInterface(&chainEventLog, true);
+
 #if ENABLE_ZMQ
     pzmqNotificationInterface = CZMQNotificationInterface::CreateWithArguments(mapArgs);
 
@@ -1611,6 +1788,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     {
         std::vector<boost::filesystem::path> vImportFiles;
         threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
+        NSPV_loadproofcache();
         StartNode(threadGroup, scheduler);
         pcoinsTip = new CCoinsViewCache(pcoinscatcher);
         InitBlockIndex();
@@ -1638,8 +1816,13 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     nTotalCache = std::max(nTotalCache, nMinDbCache << 20); // total cache cannot be less than nMinDbCache
     nTotalCache = std::min(nTotalCache, nMaxDbCache << 20); // total cache cannot be greated than nMaxDbcache
     int64_t nBlockTreeDBCache = nTotalCache / 8;
-
-    if (GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) || GetBoolArg("-spentindex", DEFAULT_SPENTINDEX)) {
+    int64_t nIndexDBCache = GetArg("-indexdbcache", 0) << 20;
+    if (nIndexDBCache > 0) {
+        // the index writes get their own cache and write buffer, apart from the block index reads
+        nIndexDBCache = std::max(std::min(nIndexDBCache, nTotalCache * 3 / 4), nMinDbCache << 20);
+        nTotalCache -= nIndexDBCache;
+        nBlockTreeDBCache = nTotalCache / 8;
+    } else if (GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) || GetBoolArg("-spentindex", DEFAULT_SPENTINDEX)) {
         // enable 3/4 of the cache if addressindex and/or spentindex is enabled
         nBlockTreeDBCache = nTotalCache * 3 / 4;
     } else {
@@ -1648,23 +1831,45 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
     }
     nTotalCache -= nBlockTreeDBCache;
+    int64_t nFilterIndexCache = 0;
+    if (KOMODO_NSPV_FULLNODE && GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+        nFilterIndexCache = std::min(nTotalCache / 8, MAX_FILTER_INDEX_CACHE << 20);
+        nTotalCache -= nFilterIndexCache;
+    }
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Max cache setting possible %.1fMiB\n", nMaxDbCache);
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    if (nIndexDBCache > 0)
+        LogPrintf("* Using %.1fMiB for index database\n", nIndexDBCache * (1.0 / 1024 / 1024));
+    if (nFilterIndexCache > 0)
+        LogPrintf("* Using %.1fMiB for block filter index database\n", nFilterIndexCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set\n", nCoinCacheUsage * (1.0 / 1024 / 1024));
+    if (GetBoolArg("-dbsharedcache", DEFAULT_DB_SHARED_CACHE)) {
+        // the block caches each database would have, half of its cache, in one LRU
+        size_t nSharedDBCache = (nBlockTreeDBCache + nIndexDBCache + nCoinDBCache + nNotarisationsDbCache) / 2;
+        InitSharedDBCache(nSharedDBCache);
+        LogPrintf("* Using %.1fMiB for the block cache shared by the databases\n", nSharedDBCache * (1.0 / 1024 / 1024));
+    }
 
     if ( fReindex == 0 )
     {
-        bool checkval, fAddressIndex, fSpentIndex, fUnspentCCIndexTmp;
-        pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex, dbCompression, dbMaxOpenFiles);
+        bool checkval, fAddressIndex, fSpentIndex, fUnspentCCIndexTmp, fTokenBalanceIndexTmp, fOraclesIndexTmp, fTokenTagsIndexTmp, fAgreementsIndexTmp, fGatewaysIndexTmp, fAddressBalanceIndexTmp, fTimestampIndexTmp;
+        bool fBackgroundIndex = GetBoolArg("-backgroundindex", DEFAULT_BACKGROUNDINDEX);
+        int nPendingIndexes = 0;
+        pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex, dbCompression, dbMaxOpenFiles, nIndexDBCache);
         fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
         checkval = false;  // need to reinit checkval otherwise it might be undefined if ReadFlag returns false
         pblocktree->ReadFlag("addressindex", checkval);
-        if ( checkval != fAddressIndex && fAddressIndex != 0 )
+        if ( checkval != fAddressIndex && fAddressIndex != 0 && fBackgroundIndex )
+        {
+            fprintf(stderr,"set addressindex, will build it in the background.\n");
+            nPendingIndexes |= INDEXBUILDER_ADDRESS;
+        }
+        else if ( checkval != fAddressIndex && fAddressIndex != 0 )
         {
             pblocktree->WriteFlag("addressindex", fAddressIndex);
             fprintf(stderr,"set addressindex, will reindex. could take a while.\n");
@@ -1673,13 +1878,28 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
         checkval = false;  
         pblocktree->ReadFlag("spentindex", checkval);
-        if ( checkval != fSpentIndex && fSpentIndex != 0 )
+        if ( checkval != fSpentIndex && fSpentIndex != 0 && fBackgroundIndex )
+        {
+            fprintf(stderr,"set spentindex, will build it in the background.\n");
+            nPendingIndexes |= INDEXBUILDER_SPENT;
+        }
+        else if ( checkval != fSpentIndex && fSpentIndex != 0 )
         {
             pblocktree->WriteFlag("spentindex", fSpentIndex);
             fprintf(stderr,"set spentindex, will reindex. could take a while.\n");
             fReindex = true;
         }
 
+        // without -backgroundindex a timestamp index enabled later is only built by -reindex
+        fTimestampIndexTmp = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+        checkval = false;
+        pblocktree->ReadFlag("timestampindex", checkval);
+        if ( checkval != fTimestampIndexTmp && fTimestampIndexTmp != 0 && fBackgroundIndex )
+        {
+            fprintf(stderr,"set timestampindex, will build it in the background.\n");
+            nPendingIndexes |= INDEXBUILDER_TIMESTAMP;
+        }
+
         fUnspentCCIndexTmp = GetBoolArg("-unspentccindex", false);
         checkval = false;  
         pblocktree->ReadFlag("unspentccindex", checkval);
@@ -1689,6 +1909,80 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             fprintf(stderr,"set unspentccindex, will reindex. could take a while.\n");
             fReindex = true;
         }
+
+        fTokenBalanceIndexTmp = GetBoolArg("-tokenbalanceindex", DEFAULT_TOKENBALANCEINDEX);
+        checkval = false;
+        pblocktree->ReadFlag("tokenbalanceindex", checkval);
+        if ( checkval != fTokenBalanceIndexTmp && fTokenBalanceIndexTmp != 0 )
+        {
+            pblocktree->WriteFlag("tokenbalanceindex", fTokenBalanceIndexTmp);
+            fprintf(stderr,"set tokenbalanceindex, will reindex. could take a while.\n");
+            fReindex = true;
+        }
+
+        fOraclesIndexTmp = GetBoolArg("-oraclesindex", DEFAULT_ORACLESINDEX);
+        checkval = false;
+        pblocktree->ReadFlag("oraclesindex", checkval);
+        if ( checkval != fOraclesIndexTmp && fOraclesIndexTmp != 0 )
+        {
+            pblocktree->WriteFlag("oraclesindex", fOraclesIndexTmp);
+            fprintf(stderr,"set oraclesindex, will reindex. could take a while.\n");
+            fReindex = true;
+        }
+
+        fTokenTagsIndexTmp = GetBoolArg("-tokentagsindex", DEFAULT_TOKENTAGSINDEX);
+        checkval = false;
+        pblocktree->ReadFlag("tokentagsindex", checkval);
+        if ( checkval != fTokenTagsIndexTmp && fTokenTagsIndexTmp != 0 )
+        {
+            pblocktree->WriteFlag("tokentagsindex", fTokenTagsIndexTmp);
+            fprintf(stderr,"set tokentagsindex, will reindex. could take a while.\n");
+            fReindex = true;
+        }
+
+        fAgreementsIndexTmp = GetBoolArg("-agreementsindex", DEFAULT_AGREEMENTSINDEX);
+        checkval = false;
+        pblocktree->ReadFlag("agreementsindex", checkval);
+        if ( checkval != fAgreementsIndexTmp && fAgreementsIndexTmp != 0 )
+        {
+            pblocktree->WriteFlag("agreementsindex", fAgreementsIndexTmp);
+            fprintf(stderr,"set agreementsindex, will reindex. could take a while.\n");
+            fReindex = true;
+        }
+
+        fGatewaysIndexTmp = GetBoolArg("-gatewaysindex", DEFAULT_GATEWAYSINDEX);
+        checkval = false;
+        pblocktree->ReadFlag("gatewaysindex", checkval);
+        if ( checkval != fGatewaysIndexTmp && fGatewaysIndexTmp != 0 )
+        {
+            pblocktree->WriteFlag("gatewaysindex", fGatewaysIndexTmp);
+            fprintf(stderr,"set gatewaysindex, will reindex. could take a while.\n");
+            fReindex = true;
+        }
+
+        fAddressBalanceIndexTmp = fAddressIndex && GetBoolArg("-addressbalanceindex", DEFAULT_ADDRESSBALANCEINDEX);
+        checkval = false;
+        pblocktree->ReadFlag("addressbalanceindex", checkval);
+        // the balances of an address index built in the background are built with it
+        if ( checkval != fAddressBalanceIndexTmp && fAddressBalanceIndexTmp != 0 && (nPendingIndexes & INDEXBUILDER_ADDRESS) == 0 )
+        {
+            pblocktree->WriteFlag("addressbalanceindex", fAddressBalanceIndexTmp);
+            fprintf(stderr,"set addressbalanceindex, will reindex. could take a while.\n");
+            fReindex = true;
+        }
+
+        // the indexes are rebuilt in the database they move to
+        checkval = false;
+        pblocktree->ReadFlag("separateindexdb", checkval);
+        if ( checkval != (nIndexDBCache > 0) )
+        {
+            pblocktree->WriteFlag("separateindexdb", nIndexDBCache > 0);
+            fprintf(stderr,"set separateindexdb, will reindex. could take a while.\n");
+            fReindex = true;
+        }
+
+        // a reindex builds every enabled index
+        IndexBuilderSetPending(fReindex ? 0 : nPendingIndexes);
     }
 
     bool clearWitnessCaches = false;
@@ -1705,20 +1999,47 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             try {
                 UnloadBlockIndex();
                 delete pcoinsTip;
+                delete pcoinsflush;
+                pcoinsflush = NULL;
                 delete pcoinsdbview;
                 delete pcoinscatcher;
                 delete pblocktree;
                 delete pnotarisations;
 
-                pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex, dbCompression, dbMaxOpenFiles);
+                pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex, dbCompression, dbMaxOpenFiles, nIndexDBCache);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex);
+                if (!fReindex && mapArgs.count("-loadtxoutset") && pcoinsdbview->GetBestBlock().IsNull()) {
+                    uiInterface.InitMessage(_("Loading UTXO set snapshot..."));
+                    CTxOutSetSnapshotInfo info;
+                    std::string strSnapshotError;
+                    if (!LoadTxOutSet(GetArg("-loadtxoutset", ""), uint256S(GetArg("-loadtxoutsethash", "")), info, strSnapshotError))
+                        return InitError(strprintf(_("Unable to load the UTXO set snapshot: %s"), strSnapshotError));
+                }
+                if (!pcoinsdbview->InitRunningStats()) {
+                    strLoadError = _("Error computing the UTXO set statistics");
+                    break;
+                }
+                if (pcoinsdbview->HasLegacyCoins()) {
+                    uiInterface.InitMessage(_("Upgrading the coin database..."));
+                    if (!pcoinsdbview->UpgradeCoinsFormat()) {
+                        strLoadError = _("Error upgrading the coin database");
+                        break;
+                    }
+                }
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
-                pcoinsTip = new CCoinsViewCache(pcoinscatcher);
-                pnotarisations = new NotarisationDB(100*1024*1024, false, fReindex);
+                if (GetBoolArg("-backgroundflush", DEFAULT_BACKGROUND_FLUSH)) {
+                    pcoinsflush = new CCoinsViewBackgroundFlush(pcoinscatcher, pcoinsdbview);
+                    pcoinsTip = new CCoinsViewCache(pcoinsflush);
+                } else {
+                    pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+                }
+                pnotarisations = new NotarisationDB(nNotarisationsDbCache, false, fReindex);
 
 
                 if (fReindex) {
-                    boost::filesystem::remove(GetDataDir() / "komodostate");
+                    // -fastkomodostate keeps a komodostate matching the one recorded on shutdown
+                    if (!komodo_statecheck_keep())
+                        boost::filesystem::remove(GetDataDir() / "komodostate");
                     boost::filesystem::remove(GetDataDir() / "signedmasks");
                     pblocktree->WriteReindexing(true);
                     //If we're reindexing in prune mode, wipe away unusable block files and all undo data files
@@ -1814,6 +2135,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
     KOMODO_LOADINGBLOCKS = 0;
 
+    // the filters of a reindexed chain are built again
+    if (nFilterIndexCache > 0 && !InitBlockFilterIndex(nFilterIndexCache, fReindex))
+        return InitError(_("Error opening the block filter index database"));
+
     // As LoadBlockIndex can take several minutes, it's possible the user
     // requested to kill the GUI during the last operation. If so, exit.
     // As the program has not fully started yet, Shutdown() is possibly overkill.
@@ -1824,12 +2149,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
     LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
 
-    boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
-    CAutoFile est_filein(fopen(est_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
-    // Allowed to fail as this file IS missing on first startup.
-    if (!est_filein.IsNull())
-        mempool.ReadFeeEstimates(est_filein);
-    fFeeEstimatesInitialized = true;
+    mempool.SetFeeEstimateHalfLife(GetArg("-feeestimatehalflife", DEFAULT_FEE_ESTIMATE_HALFLIFE));
+    LoadFeeEstimates();
 
 
     // ********************************************************* Step 8: load wallet
@@ -2024,6 +2345,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             nLocalServices |= NODE_ADDRINDEX;
         if ( GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) != 0 )
             nLocalServices |= NODE_SPENTINDEX;
+        if (GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS))
+        {
+            if (!IsBlockFilterIndexEnabled())
+                return InitError(_("Cannot set -peerblockfilters without -blockfilterindex."));
+            nLocalServices |= NODE_COMPACT_FILTERS;
+        }
     }
     // ********************************************************* Step 10: import blocks
 
@@ -2073,8 +2400,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     // recently added to the mempool.
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "txnotify", &ThreadNotifyRecentlyAdded));
 
-    // Start the thread that updates komodo internal structures
-    threadGroup.create_thread(&ThreadUpdateKomodoInternals);
+    // Update komodo internal structures from the scheduler
+    StartKomodoInternalsUpdater(scheduler);
+
+    // Start the thread that builds the indexes enabled without a reindex
+    StartIndexBuilder(threadGroup);
+    StartBlockFilterIndex(threadGroup);
 
     if (GetBoolArg("-listenonion", DEFAULT_LISTEN_ONION))
         StartTorControl(threadGroup, scheduler);
@@ -2091,6 +2422,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
  #else
     GenerateBitcoins(GetBoolArg("-gen", false), GetArg("-genproclimit", -1));
  #endif
+
+    if (GetBoolArg("-stratum", DEFAULT_STRATUM) && !StartStratum())
+        return InitError(_("Unable to start the stratum server. See debug log for details."));
 #endif
 
     // ********************************************************* Step 11: finished
@@ -236,7 +236,7 @@ int32_t komodo_parsestatefiledata(struct komodo_state *sp,uint8_t *filedata,long
             errs++;
         if ( func == 'P' )
         {
-            if ( (num= filedata[fpos++]) <= 64 )
+            if ( fpos < datalen && (num= filedata[fpos++]) <= 64 )
             {
                 if ( memread(pubkeys,33*num,filedata,&fpos,datalen) != 33*num )
                     errs++;
@@ -275,8 +275,8 @@ int32_t komodo_parsestatefiledata(struct komodo_state *sp,uint8_t *filedata,long
         else if ( func == 'U' ) // deprecated
         {
             uint8_t n,nid; uint256 hash; uint64_t mask;
-            n = filedata[fpos++];
-            nid = filedata[fpos++];
+            n = fpos < datalen ? filedata[fpos++] : 0;
+            nid = fpos < datalen ? filedata[fpos++] : 0;
             //printf("U %d %d\n",n,nid);
             if ( memread(&mask,sizeof(mask),filedata,&fpos,datalen) != sizeof(mask) )
                 errs++;
@@ -325,9 +325,7 @@ int32_t komodo_parsestatefiledata(struct komodo_state *sp,uint8_t *filedata,long
                 komodo_eventadd_opreturn(sp,symbol,ht,txid,ovalue,v,opret,olen); // global shared state -> global PAX
             } else
             {
-                int32_t i;
-                for (i=0; i<olen; i++)
-                    filedata[fpos++];
+                fpos += olen;
                 //printf("illegal olen.%u\n",olen);
             }
         }
@@ -338,7 +336,7 @@ int32_t komodo_parsestatefiledata(struct komodo_state *sp,uint8_t *filedata,long
         else if ( func == 'V' )
         {
             int32_t numpvals; uint32_t pvals[128];
-            numpvals = filedata[fpos++];
+            numpvals = fpos < datalen ? filedata[fpos++] : 0xff;
             if ( numpvals*sizeof(uint32_t) <= sizeof(pvals) && memread(pvals,(int32_t)(sizeof(uint32_t)*numpvals),filedata,&fpos,datalen) == numpvals*sizeof(uint32_t) )
             {
                 //if ( matched != 0 ) global shared state -> global PVALS
@@ -714,6 +712,7 @@ int32_t komodo_voutupdate(bool fJustCheck,int32_t *isratificationp,int32_t notar
                         sp->MoMdepth = MoMdepth;
                     }
                     komodo_stateupdate(height,0,0,0,zero,0,0,0,0,0,0,0,0,0,0,sp->MoM,sp->MoMdepth);
+                    GetMainSignals().Notarized(height,sp->NOTARIZED_HEIGHT,srchash,desttxid,txhash);
                     //if ( ASSETCHAINS_SYMBOL[0] != 0 )
                         printf("[%s] ht.%d NOTARIZED.%d %s.%s %sTXID.%s lens.(%d %d) MoM.%s %d\n",ASSETCHAINS_SYMBOL,height,sp->NOTARIZED_HEIGHT,ASSETCHAINS_SYMBOL[0]==0?"KMD":ASSETCHAINS_SYMBOL,srchash.ToString().c_str(),ASSETCHAINS_SYMBOL[0]==0?"BTC":"KMD",desttxid.ToString().c_str(),opretlen,len,sp->MoM.ToString().c_str(),sp->MoMdepth);
                     
@@ -804,6 +803,99 @@ int32_t komodo_notarycmp(uint8_t *scriptPubKey,int32_t scriptlen,uint8_t pubkeys
     return(-1);
 }
 
+/*
+ * komodostate.chk: with -fastkomodostate a clean shutdown records the size and sha256 of
+ * komodostate and the tip it was written up to. A -reindex then keeps a komodostate that
+ * still matches it instead of deleting it, and komodo_connectblock skips scanning the
+ * blocks below that tip, their events being in the file already. The first block that is
+ * not an ancestor of the recorded tip rewinds the state to its height and scanning resumes.
+ */
+#define KOMODO_STATECHECK_MAGIC 0x6b736331
+
+struct komodo_statecheck
+{
+    uint32_t magic; int32_t height;
+    uint256 blockhash,filehash;
+    uint64_t filesize;
+};
+
+static int32_t KOMODO_FASTSTATE_HEIGHT;
+static uint256 KOMODO_FASTSTATE_HASH;
+
+static int32_t komodo_statefile_hash(char *fname,uint64_t *filesizep,uint256 *filehashp)
+{
+    FILE *fp; CSHA256 hasher; uint8_t buf[1 << 16]; size_t n; uint64_t len = 0;
+    if ( (fp= fopen(fname,"rb")) == 0 )
+        return(-1);
+    while ( (n= fread(buf,1,sizeof(buf),fp)) > 0 )
+    {
+        hasher.Write(buf,n);
+        len += n;
+    }
+    fclose(fp);
+    hasher.Finalize(filehashp->begin());
+    *filesizep = len;
+    return(0);
+}
+
+void komodo_statecheck_save()
+{
+    struct komodo_statecheck chk; char fname[512],chkfname[512]; FILE *fp;
+    AssertLockHeld(cs_main);
+    komodo_statefname(chkfname,ASSETCHAINS_SYMBOL,(char *)"komodostate.chk");
+    remove(chkfname);
+    if ( !GetBoolArg("-fastkomodostate",false) || chainActive.Tip() == 0 )
+        return;
+    memset(&chk,0,sizeof(chk));
+    komodo_statefname(fname,ASSETCHAINS_SYMBOL,(char *)"komodostate");
+    if ( komodo_statefile_hash(fname,&chk.filesize,&chk.filehash) < 0 )
+        return;
+    chk.magic = KOMODO_STATECHECK_MAGIC;
+    chk.height = chainActive.Height();
+    chk.blockhash = chainActive.Tip()->GetBlockHash();
+    if ( (fp= fopen(chkfname,"wb")) != 0 )
+    {
+        if ( fwrite(&chk,1,sizeof(chk),fp) != sizeof(chk) )
+            fprintf(stderr,"error writing %s\n",chkfname);
+        fclose(fp);
+        LogPrintf("komodostate up to ht.%d recorded for -fastkomodostate\n",chk.height);
+    }
+}
+
+int32_t komodo_statecheck_keep()
+{
+    struct komodo_statecheck chk; char fname[512],chkfname[512]; FILE *fp; uint64_t filesize; uint256 filehash; int32_t n = 0;
+    komodo_statefname(chkfname,ASSETCHAINS_SYMBOL,(char *)"komodostate.chk");
+    if ( !GetBoolArg("-fastkomodostate",false) || (fp= fopen(chkfname,"rb")) == 0 )
+        return(0);
+    n = fread(&chk,1,sizeof(chk),fp);
+    fclose(fp);
+    // whatever happens next the recorded tip is used once
+    remove(chkfname);
+    komodo_statefname(fname,ASSETCHAINS_SYMBOL,(char *)"komodostate");
+    if ( n != sizeof(chk) || chk.magic != KOMODO_STATECHECK_MAGIC || chk.height <= 0 ||
+         komodo_statefile_hash(fname,&filesize,&filehash) < 0 || filesize != chk.filesize || filehash != chk.filehash )
+    {
+        LogPrintf("komodostate doesnt match komodostate.chk, rebuilding it\n");
+        return(0);
+    }
+    KOMODO_FASTSTATE_HEIGHT = chk.height;
+    KOMODO_FASTSTATE_HASH = chk.blockhash;
+    LogPrintf("keeping komodostate up to ht.%d %s\n",chk.height,chk.blockhash.ToString());
+    return(1);
+}
+
+// 1 when the kept komodostate covers pindex, 0 once past it, -1 when the chain left it
+static int32_t komodo_faststate_covers(CBlockIndex *pindex)
+{
+    BlockMap::const_iterator mi;
+    if ( KOMODO_FASTSTATE_HEIGHT == 0 || pindex->GetHeight() > KOMODO_FASTSTATE_HEIGHT )
+        return(0);
+    if ( (mi= mapBlockIndex.find(KOMODO_FASTSTATE_HASH)) == mapBlockIndex.end() || mi->second == 0 )
+        return(-1);
+    return(mi->second->GetAncestor(pindex->GetHeight()) == pindex ? 1 : -1);
+}
+
 // int32_t (!!!)
 /*
     read blackjok3rtt comments in main.cpp 
@@ -845,6 +937,24 @@ int32_t komodo_connectblock(bool fJustCheck, CBlockIndex *pindex,CBlock& block)
             lastStakedEra = staked_era;
         }
     }
+    if ( !fJustCheck && KOMODO_FASTSTATE_HEIGHT != 0 )
+    {
+        int32_t covered = komodo_faststate_covers(pindex);
+        if ( covered > 0 )
+        {
+            hwmheight = pindex->GetHeight();
+            komodo_currentheight_set(chainActive.LastTip()->GetHeight());
+            return(0);
+        }
+        if ( covered < 0 )
+        {
+            printf("[%s] ht.%d is not below the kept komodostate tip ht.%d, rewinding it\n",ASSETCHAINS_SYMBOL,pindex->GetHeight(),KOMODO_FASTSTATE_HEIGHT);
+            komodo_event_rewind(sp,symbol,pindex->GetHeight());
+            komodo_stateupdate(pindex->GetHeight(),0,0,0,zero,0,0,0,0,-pindex->GetHeight(),pindex->nTime,0,0,0,0,zero,0);
+            hwmheight = pindex->GetHeight() - 1;
+        }
+        KOMODO_FASTSTATE_HEIGHT = 0;
+    }
     numnotaries = komodo_notaries(pubkeys,pindex->GetHeight(),pindex->GetBlockTime());
     calc_rmd160_sha256(rmd160,pubkeys[0],33);
     if ( pindex->GetHeight() > hwmheight )
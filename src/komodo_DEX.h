@@ -18,8 +18,8 @@
 /*
  MAKE SURE YOU NTP sync your node, precise timestamps are assumed
  
- _functions() assume DEX_globalmutex is locked when it is called
- functions() assume that DEX_globalmutes is not locked when it is called and must lock/unlock to call _functions()
+ _functions() assume DEX_globallock is held when it is called, for writing unless they only read
+ functions() assume that DEX_globallock is not held when it is called and must lock/unlock to call _functions()
  
  message format: <relay depth> <funcid> <timestamp> <payload>
  
@@ -61,8 +61,6 @@ later:
  */
 
 
-#define KOMODO_DEX_PURGELIST 0
-
 #define KOMODO_DEX_BLAST (iter/3)  // define as iter to make it have 10 different priorities, as 0 to blast diff 0
 #define KOMODO_DEX_ROUTESIZE 6 // (relaydepth + funcid + timestamp)
 
@@ -76,6 +74,13 @@ later:
 #define KOMODO_DEX_MAXPERSEC (1 << KOMODO_DEX_HASHLOG2) // effective limit of sustained datablobs/sec
 //#define KOMODO_DEX_HASHMASK (KOMODO_DEX_MAXPERSEC - 1)
 #define KOMODO_DEX_PURGETIME (3600)
+#define KOMODO_DEX_ARENACHUNK (1 << 12) // first chunk of a bucket arena, each next one doubles
+#define KOMODO_DEX_ARENAMAXCHUNK (1 << 22)
+#define KOMODO_DEX_BOOKCOMPACT 60 // seconds of purged buckets before the dead orders are erased from a book
+#define KOMODO_DEX_INGRESSTHREADS 4 // hash and txpow packets before the locked insertion
+#define KOMODO_DEX_INGRESSQUEUE 8192 // packets waiting for them, more are dropped
+#define KOMODO_DEX_INSERTBATCH 64 // validated packets inserted per hold of DEX_globallock
+#define KOMODO_DEX_PERFBINS 24 // seconds for the lag histograms, log2 usec for the timings
 #define KOMODO_DEX_MAXPING (KOMODO_DEX_MAXPERSEC / 17)
 
 #define KOMOD_DEX_PEERMASKSIZE 128
@@ -103,6 +108,7 @@ later:
 #define KOMODO_DEX_FILEBUFSIZE 10000
 #define KOMODO_DEX_STREAMSIZE 100
 #define KOMODO_DEX_ANONSIZE 1024
+#define KOMODO_DEX_SYNCTHREADS 4 // decrypt the fragments of a subscribed file in parallel
 
 #define _komodo_DEXquotehash(hash,len) (uint32_t)(((hash).ulongs[0] >> (KOMODO_DEX_TXPOWBITS + komodo_DEX_sizepriority(len))))
 #define komodo_DEX_id(ptr) _komodo_DEXquotehash(ptr->hash,ptr->datalen)
@@ -113,22 +119,41 @@ later:
 struct DEX_datablob
 {
     UT_hash_handle hh;
-    struct DEX_datablob *nexts[KOMODO_DEX_MAXINDICES],*prevs[KOMODO_DEX_MAXINDICES];
+    struct DEX_datablob *prevs[KOMODO_DEX_MAXINDICES]; // older datablob of each index, only valid while prevtimes[ind] is not purged
+    uint32_t prevtimes[KOMODO_DEX_MAXINDICES];
     bits256 hash;
     uint8_t peermask[KOMOD_DEX_PEERMASKSIZE];
-    uint32_t recvtime,cancelled,lastlist,shorthash;
+    uint32_t recvtime,cancelled,shorthash,timestamp;
     int32_t datalen;
     int8_t priority,sizepriority;
     uint8_t numsent,offset,linkmask,requested;
     uint8_t data[];
 };
 
-struct DEX_index_list { struct DEX_datablob *nexts[KOMODO_DEX_MAXINDICES],*prevs[KOMODO_DEX_MAXINDICES]; };
+// all datablobs of one timestamp second are carved from the chunks of its bucket and freed together when it is purged
+struct DEX_arenachunk
+{
+    struct DEX_arenachunk *next;
+    int32_t size,used;
+    uint8_t space[];
+};
+
+struct DEX_bucket
+{
+    struct DEX_arenachunk *chunks;
+    int64_t lagsum;
+    uint32_t timestamp,purgehash;
+    int32_t num,numvip,numrequested;
+    uint16_t haves[KOMODO_DEX_MAXPEERID],viphaves[KOMODO_DEX_MAXPEERID]; // datablobs (VIP ones) of the bucket in each peermask position, an undercount is harmless
+};
 
+// newest first by timestamp, the links into purged buckets are skipped lazily by checking prevtimes against G->purgecutoff
 struct DEX_index
 {
     UT_hash_handle hh;
-    struct DEX_datablob *head,*tail;
+    struct DEX_datablob *tail;
+    struct DEX_book *book; // tagAB indices only
+    uint32_t tailtime;
     uint8_t keylen;
     uint8_t key[KOMODO_DEX_MAXKEYSIZE];
 } *DEX_destpubs,*DEX_tagAs,*DEX_tagBs,*DEX_tagABs;
@@ -142,16 +167,207 @@ struct DEX_orderbookentry
     uint8_t pubkey33[33],priority;
 };
 
+// an order of a tagAB book, it is dead once its timestamp is purged and skipped without touching ptr
+struct DEX_bookentry
+{
+    double price;
+    uint64_t amount;
+    uint32_t timestamp;
+    struct DEX_datablob *ptr;
+};
+
+struct DEX_book
+{
+    std::vector<struct DEX_bookentry> orders[2]; // [revflag] in the orders DEX_orderbook returns them
+    uint32_t compacted;
+};
+
 // start perf metrics
 static double DEX_lag,DEX_lag2,DEX_lag3;
 static int64_t DEX_totalsent,DEX_totalrecv,DEX_totaladd,DEX_duplicate,DEX_progress;
 static int64_t DEX_lookup32,DEX_collision32,DEX_add32,DEX_maxlag;
 static int64_t DEX_Numpending,DEX_freed,DEX_truncated;
+static std::atomic<int64_t> DEX_ingressdropped,DEX_ingressinvalid;
 // end perf metrics
 
 static uint32_t Got_Recent_Quote;
 bits256 DEX_pubkey,GENESIS_PUBKEY,GENESIS_PRIVKEY;
-pthread_mutex_t DEX_globalmutex;
+pthread_rwlock_t DEX_globallock; // writers are preferred so RPC readers cant starve the packet insertion
+
+// DEX_perfstats, updated under the DEX_globallock write lock, lockholds are the times it is held for writing
+static struct DEX_perfcounters
+{
+    int64_t funcids[256];
+    int64_t recvlags[KOMODO_DEX_PERFBINS],relaylags[KOMODO_DEX_PERFBINS];
+    int64_t priorities[16],relays,relayed; // datablobs added by priority, relay sends and datablobs relayed at least once
+    int64_t lockholds[KOMODO_DEX_PERFBINS],purgetimes[KOMODO_DEX_PERFBINS];
+    int64_t maxlockhold,maxpurgetime,lockstart;
+} DEX_perf;
+
+int32_t komodo_DEX_perfbin(int64_t usecs)
+{
+    int32_t bin = 0;
+    while ( usecs > 1 && bin < KOMODO_DEX_PERFBINS-1 )
+        usecs >>= 1, bin++;
+    return(bin);
+}
+
+static int32_t DEX_lockprofilesite = -1; // -lockprofile site of the write lock holder
+
+void komodo_DEX_lockat(const char *file,int32_t line)
+{
+    int64_t waitstart = 0; int32_t site = -1;
+    if ( g_lockProfile.load(std::memory_order_relaxed) == 0 )
+        pthread_rwlock_wrlock(&DEX_globallock);
+    else
+    {
+        if ( pthread_rwlock_trywrlock(&DEX_globallock) != 0 )
+        {
+            waitstart = LockProfileMicros();
+            pthread_rwlock_wrlock(&DEX_globallock);
+        }
+        if ( (site= LockProfileSite("DEX_globallock",file,line)) >= 0 )
+            LockProfileAcquired(site,waitstart != 0,waitstart != 0 ? LockProfileMicros() - waitstart : 0);
+    }
+    DEX_lockprofilesite = site;
+    DEX_perf.lockstart = GetTimeMicros();
+}
+#define komodo_DEX_lock() komodo_DEX_lockat(__FILE__,__LINE__)
+
+void komodo_DEX_unlock()
+{
+    int64_t held = GetTimeMicros() - DEX_perf.lockstart;
+    DEX_perf.lockholds[komodo_DEX_perfbin(held)]++;
+    if ( held > DEX_perf.maxlockhold )
+        DEX_perf.maxlockhold = held;
+    if ( DEX_lockprofilesite >= 0 )
+        LockProfileReleased(DEX_lockprofilesite,held);
+    pthread_rwlock_unlock(&DEX_globallock);
+}
+
+// for the RPC queries that only read, so they run along each other
+void komodo_DEX_rdlock()
+{
+    pthread_rwlock_rdlock(&DEX_globallock);
+}
+
+void komodo_DEX_rdunlock()
+{
+    pthread_rwlock_unlock(&DEX_globallock);
+}
+
+struct DEX_ingress
+{
+    CNode *pfrom;
+    std::vector<uint8_t> msg;
+    uint32_t recvtime;
+    bits256 hash;
+};
+
+/**
+ * Bounded lock free ring for many producers and consumers, each slot has a
+ * sequence number telling whose turn it is. Push fails when the ring is full.
+ */
+template <typename T,int32_t N>
+class CDEXRing
+{
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> seq;
+        T item;
+    };
+    Slot slots[N];
+    std::atomic<uint64_t> head,tail;
+
+public:
+    CDEXRing() : head(0), tail(0)
+    {
+        for (int32_t i=0; i<N; i++)
+            slots[i].seq.store(i,std::memory_order_relaxed);
+    }
+
+    bool Push(T &item)
+    {
+        uint64_t pos = tail.load(std::memory_order_relaxed);
+        while ( 1 )
+        {
+            Slot &slot = slots[pos % N];
+            int64_t dif = (int64_t)slot.seq.load(std::memory_order_acquire) - (int64_t)pos;
+            if ( dif == 0 )
+            {
+                if ( tail.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed) )
+                {
+                    std::swap(slot.item,item);
+                    slot.seq.store(pos+1,std::memory_order_release);
+                    return(true);
+                }
+            }
+            else if ( dif < 0 )
+                return(false);
+            else pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool Pop(T &item)
+    {
+        uint64_t pos = head.load(std::memory_order_relaxed);
+        while ( 1 )
+        {
+            Slot &slot = slots[pos % N];
+            int64_t dif = (int64_t)slot.seq.load(std::memory_order_acquire) - (int64_t)(pos+1);
+            if ( dif == 0 )
+            {
+                if ( head.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed) )
+                {
+                    std::swap(item,slot.item);
+                    slot.seq.store(pos+N,std::memory_order_release);
+                    return(true);
+                }
+            }
+            else if ( dif < 0 )
+                return(false);
+            else pos = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    int64_t Size() const { return((int64_t)(tail.load(std::memory_order_relaxed) - head.load(std::memory_order_relaxed))); }
+};
+
+// consumers of a ring sleep on its bell when it is empty, the timed wait covers a ring call racing the sleep
+struct DEX_bell
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    std::atomic<int32_t> sleepers;
+};
+
+void komodo_DEX_bellwait(struct DEX_bell *bell)
+{
+    struct timespec ts; int64_t until = GetTimeMicros() + 10000;
+    ts.tv_sec = until / 1000000;
+    ts.tv_nsec = (until % 1000000) * 1000;
+    pthread_mutex_lock(&bell->mutex);
+    bell->sleepers++;
+    pthread_cond_timedwait(&bell->cond,&bell->mutex,&ts);
+    bell->sleepers--;
+    pthread_mutex_unlock(&bell->mutex);
+}
+
+void komodo_DEX_bellring(struct DEX_bell *bell)
+{
+    if ( bell->sleepers.load() > 0 )
+    {
+        pthread_mutex_lock(&bell->mutex);
+        pthread_cond_signal(&bell->cond);
+        pthread_mutex_unlock(&bell->mutex);
+    }
+}
+
+static CDEXRing<struct DEX_ingress,KOMODO_DEX_INGRESSQUEUE> *DEX_ingressring,*DEX_insertring; // from the network to the validators, from them to the insert thread
+static struct DEX_bell DEX_ingressbell,DEX_insertbell;
+void *komodo_DEX_ingressloop(void *arg);
+void *komodo_DEX_insertloop(void *arg);
 
 static struct DEX_globals
 {
@@ -159,10 +375,8 @@ static struct DEX_globals
     uint32_t Pendings[KOMODO_DEX_MAXLAG * KOMODO_DEX_MAXPERSEC - 1];
     
     struct DEX_datablob *Hashtables[KOMODO_DEX_PURGETIME];
-#if KOMODO_DEX_PURGELIST
-    struct DEX_datablob *Purgelist[KOMODO_DEX_MAXPERSEC * KOMODO_DEX_MAXLAG];
-    int32_t numpurges;
-#endif
+    struct DEX_bucket Buckets[KOMODO_DEX_PURGETIME];
+    uint32_t purgecutoff; // every datablob with timestamp <= purgecutoff is freed
     FILE *fp;
 } *G;
 
@@ -205,7 +419,21 @@ void komodo_DEX_init()
     {
         decode_hex(GENESIS_PUBKEY.bytes,sizeof(GENESIS_PUBKEY),GENESIS_PUBKEYSTR);
         decode_hex(GENESIS_PRIVKEY.bytes,sizeof(GENESIS_PRIVKEY),GENESIS_PRIVKEYSTR);
-        pthread_mutex_init(&DEX_globalmutex,0);
+        {
+            pthread_rwlockattr_t attr;
+            pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+            pthread_rwlockattr_setkind_np(&attr,PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+            pthread_rwlock_init(&DEX_globallock,&attr);
+            pthread_rwlockattr_destroy(&attr);
+        }
+        pthread_mutex_init(&DEX_ingressbell.mutex,0);
+        pthread_cond_init(&DEX_ingressbell.cond,0);
+        pthread_mutex_init(&DEX_insertbell.mutex,0);
+        pthread_cond_init(&DEX_insertbell.cond,0);
+        DEX_ingressring = new CDEXRing<struct DEX_ingress,KOMODO_DEX_INGRESSQUEUE>();
+        DEX_insertring = new CDEXRing<struct DEX_ingress,KOMODO_DEX_INGRESSQUEUE>();
         komodo_DEX_pubkeyupdate();
         G = (struct DEX_globals *)calloc(1,sizeof(*G));
         if ( (G->fp= fopen((char *)"DEX.log",(char *)"wb")) == 0 )
@@ -214,16 +442,23 @@ void komodo_DEX_init()
             exit(-1);
         }
         char str[67]; fprintf(stderr,"DEX_pubkey.(01%s) sizeof DEX_globals %ld\n\n",bits256_str(str,DEX_pubkey),sizeof(*G));
+        for (int32_t i=0; i<KOMODO_DEX_INGRESSTHREADS; i++)
+        {
+            pthread_t tid;
+            if ( pthread_create(&tid,0,komodo_DEX_ingressloop,0) == 0 )
+                pthread_detach(tid);
+            else fprintf(stderr,"couldnt start DEX ingress thread.%d\n",i);
+        }
+        {
+            pthread_t tid;
+            if ( pthread_create(&tid,0,komodo_DEX_insertloop,0) == 0 )
+                pthread_detach(tid);
+            else fprintf(stderr,"couldnt start DEX insert thread\n");
+        }
         onetime = 1;
     }
 }
 
-uint32_t komodo_DEX_listid()
-{
-    static uint32_t listid;
-    return(++listid);
-}
-
 int32_t komodo_DEX_islagging()
 {
     if ( (DEX_lag > DEX_lag2 && DEX_lag2 > DEX_lag3 && DEX_lag > KOMODO_DEX_MAXLAG/KOMODO_DEX_MAXHOPS && DEX_Numpending >= KOMODO_DEX_MAXPERSEC/2) || DEX_Numpending >= KOMODO_DEX_MAXPERSEC )
@@ -351,67 +586,174 @@ int32_t komodo_DEXfind32(uint32_t hashtable[],int32_t hashsize,uint32_t shorthas
     return(-1);
 }
 
-#define DL_APPENDind(head,add,ind)                                                                    \
-DL_APPEND2ind(head,add,prevs,nexts,ind)
-
-#define DL_APPEND2ind(head,add,prevs,nexts,ind)                                                         \
-do {                                                                                           \
-if (head) {                                                                                  \
-(add)->prevs[ind] = (head)->prevs[ind];                                                              \
-(head)->prevs[ind]->nexts[ind] = (add);                                                              \
-(head)->prevs[ind] = (add);                                                                    \
-(add)->nexts[ind] = NULL;                                                                      \
-} else {                                                                                     \
-(head)=(add);                                                                            \
-(head)->prevs[ind] = (head);                                                                   \
-(head)->nexts[ind] = NULL;                                                                     \
-}                                                                                            \
-} while (0)
-
-#define DL_DELETEind(head,del,ind)                                                                    \
-DL_DELETE2ind(head,del,prevs,nexts,ind)
-
-#define DL_DELETE2ind(head,del,prevs,nexts,ind)                                                         \
-do {                                                                                           \
-assert((del)->prevs[ind] != NULL);                                                                 \
-if ((del)->prevs[ind] == (del)) {                                                                  \
-(head)=NULL;                                                                             \
-} else if ((del)==(head)) {                                                                  \
-(del)->nexts[ind]->prevs[ind] = (del)->prevs[ind];                                                         \
-(head) = (del)->nexts[ind];                                                                    \
-} else {                                                                                     \
-(del)->prevs[ind]->nexts[ind] = (del)->nexts[ind];                                                         \
-if ((del)->nexts[ind]) {                                                                       \
-(del)->nexts[ind]->prevs[ind] = (del)->prevs[ind];                                                     \
-} else {                                                                                 \
-(head)->prevs[ind] = (del)->prevs[ind];                                                          \
-}                                                                                        \
-}                                                                                            \
-} while (0)
-
-#define DL_FOREACHind(tail,el,ind)                                                                    \
-DL_FOREACH2ind(tail,el,prevs,ind)
-
-#define DL_FOREACH2ind(tail,el,prevs,ind)                                                              \
-for(el=tail;el;el=(el)->prevs[ind])
+struct DEX_datablob *_komodo_DEX_tail(struct DEX_index *index)
+{
+    if ( index->tail == 0 || index->tailtime <= G->purgecutoff ) // only read, it is called under the read lock
+        return(0);
+    return(index->tail);
+}
+
+struct DEX_datablob *_komodo_DEX_prev(int32_t ind,struct DEX_datablob *ptr)
+{
+    if ( ptr->prevtimes[ind] <= G->purgecutoff ) // older one is in a purged bucket
+        return(0);
+    return(ptr->prevs[ind]);
+}
 
 void _komodo_DEX_enqueue(int32_t ind,struct DEX_index *index,struct DEX_datablob *ptr)
 {
+    struct DEX_datablob *prev,*next = 0;
     if ( GETBIT(&ptr->linkmask,ind) != 0 )
     {
-        fprintf(stderr,"duplicate link attempted ind.%d ptr.%p listid.%d\n",ind,ptr,ptr->lastlist);
+        fprintf(stderr,"duplicate link attempted ind.%d ptr.%p\n",ind,ptr);
         return;
     }
-    if ( ptr->datalen < KOMODO_DEX_ROUTESIZE )
+    // keep the list ordered by timestamp so the purged datablobs are always its oldest part
+    for (prev=_komodo_DEX_tail(index); prev!=0 && prev->timestamp > ptr->timestamp; prev=_komodo_DEX_prev(ind,prev))
+        next = prev;
+    ptr->prevs[ind] = prev;
+    ptr->prevtimes[ind] = (prev != 0) ? prev->timestamp : 0;
+    if ( next != 0 )
     {
-        fprintf(stderr,"already truncated datablob cant be linked ind.%d ptr.%p listid.%d\n",ind,ptr,ptr->lastlist);
-        return;
+        next->prevs[ind] = ptr;
+        next->prevtimes[ind] = ptr->timestamp;
+    }
+    else
+    {
+        index->tail = ptr;
+        index->tailtime = ptr->timestamp;
     }
-    DL_APPENDind(index->head,ptr,ind);
-    index->tail = ptr;
     SETBIT(&ptr->linkmask,ind);
 }
 
+struct DEX_datablob *_komodo_DEX_arenaalloc(struct DEX_bucket *bucket,int32_t size)
+{
+    struct DEX_arenachunk *chunk; uint8_t *space; int32_t chunksize;
+    size = (size + 15) & ~15;
+    if ( (chunk= bucket->chunks) == 0 || chunk->used + size > chunk->size )
+    {
+        chunksize = (chunk == 0) ? KOMODO_DEX_ARENACHUNK : chunk->size * 2;
+        if ( chunksize > KOMODO_DEX_ARENAMAXCHUNK )
+            chunksize = KOMODO_DEX_ARENAMAXCHUNK;
+        if ( chunksize < size )
+            chunksize = size;
+        if ( (chunk= (struct DEX_arenachunk *)malloc(sizeof(*chunk) + chunksize)) == 0 )
+            return(0);
+        chunk->size = chunksize;
+        chunk->used = 0;
+        chunk->next = bucket->chunks;
+        bucket->chunks = chunk;
+    }
+    space = &chunk->space[chunk->used];
+    chunk->used += size;
+    memset(space,0,size);
+    return((struct DEX_datablob *)space);
+}
+
+int32_t _komodo_DEX_bucketfree(struct DEX_bucket *bucket)
+{
+    struct DEX_arenachunk *chunk; int32_t n = 0;
+    while ( (chunk= bucket->chunks) != 0 )
+    {
+        bucket->chunks = chunk->next;
+        free(chunk);
+        n++;
+    }
+    memset(bucket,0,sizeof(*bucket));
+    return(n);
+}
+
+struct DEX_bucket *_komodo_DEX_bucket(struct DEX_datablob *ptr)
+{
+    return(&G->Buckets[ptr->timestamp % KOMODO_DEX_PURGETIME]);
+}
+
+void _komodo_DEX_peerhas(struct DEX_datablob *ptr,int32_t peerpos)
+{
+    struct DEX_bucket *bucket;
+    if ( GETBIT(ptr->peermask,peerpos) != 0 )
+        return;
+    SETBIT(ptr->peermask,peerpos);
+    bucket = _komodo_DEX_bucket(ptr);
+    if ( bucket->haves[peerpos] < 0xffff )
+        bucket->haves[peerpos]++;
+    if ( ptr->priority >= KOMODO_DEX_VIPLEVEL && bucket->viphaves[peerpos] < 0xffff )
+        bucket->viphaves[peerpos]++;
+}
+
+void _komodo_DEX_peerlost(struct DEX_datablob *ptr,int32_t peerpos)
+{
+    struct DEX_bucket *bucket;
+    if ( GETBIT(ptr->peermask,peerpos) == 0 )
+        return;
+    CLEARBIT(ptr->peermask,peerpos);
+    bucket = _komodo_DEX_bucket(ptr);
+    if ( bucket->haves[peerpos] > 0 )
+        bucket->haves[peerpos]--;
+    if ( ptr->priority >= KOMODO_DEX_VIPLEVEL && bucket->viphaves[peerpos] > 0 )
+        bucket->viphaves[peerpos]--;
+}
+
+void _komodo_DEX_setrequested(struct DEX_datablob *ptr,int32_t numrequests)
+{
+    struct DEX_bucket *bucket = _komodo_DEX_bucket(ptr);
+    if ( ptr->requested == 0 && numrequests > 0 )
+        bucket->numrequested++;
+    else if ( ptr->requested > 0 && numrequests == 0 )
+        bucket->numrequested--;
+    ptr->requested = numrequests;
+}
+
+static bool _cmp_orderbook(const struct DEX_bookentry &a,const struct DEX_bookentry &b) // bids
+{
+    if ( a.price != b.price )
+        return(a.price < b.price);
+    return(a.amount > b.amount);
+}
+
+static bool _revcmp_orderbook(const struct DEX_bookentry &a,const struct DEX_bookentry &b) // asks
+{
+    if ( a.price != b.price )
+        return(a.price > b.price);
+    return(a.amount > b.amount);
+}
+
+static bool _komodo_DEX_bookdead(const struct DEX_bookentry &e)
+{
+    return(e.timestamp <= G->purgecutoff);
+}
+
+void _komodo_DEX_bookcompact(struct DEX_book *book)
+{
+    int32_t revflag;
+    if ( G->purgecutoff < book->compacted + KOMODO_DEX_BOOKCOMPACT )
+        return;
+    for (revflag=0; revflag<2; revflag++)
+        book->orders[revflag].erase(std::remove_if(book->orders[revflag].begin(),book->orders[revflag].end(),_komodo_DEX_bookdead),book->orders[revflag].end());
+    book->compacted = G->purgecutoff;
+}
+
+void _komodo_DEX_bookadd(struct DEX_index *index,struct DEX_datablob *ptr,uint64_t amountA,uint64_t amountB)
+{
+    struct DEX_book *book; struct DEX_bookentry e;
+    if ( amountA == 0 || amountB == 0 )
+        return;
+    if ( (book= index->book) == 0 )
+    {
+        book = index->book = new DEX_book();
+        book->compacted = G->purgecutoff;
+    }
+    _komodo_DEX_bookcompact(book);
+    e.ptr = ptr;
+    e.timestamp = ptr->timestamp;
+    e.price = (double)amountB / amountA;
+    e.amount = amountA;
+    book->orders[0].insert(std::upper_bound(book->orders[0].begin(),book->orders[0].end(),e,_cmp_orderbook),e);
+    e.price = (double)amountA / amountB;
+    e.amount = amountB;
+    book->orders[1].insert(std::upper_bound(book->orders[1].begin(),book->orders[1].end(),e,_revcmp_orderbook),e);
+}
+
 uint32_t _komodo_DEXtotal(int32_t *histo,int32_t &total)
 {
     struct DEX_datablob *ptr,*tmp; int32_t priority; uint32_t modval,n,hash,totalhash = 0;
@@ -443,81 +785,39 @@ uint32_t _komodo_DEX_peerclear(int32_t peerpos)
             if ( ptr->priority >= KOMODO_DEX_VIPLEVEL )
             {
                 n++;
-                CLEARBIT(ptr->peermask,peerpos);
+                _komodo_DEX_peerlost(ptr,peerpos);
             }
         }
     }
     return(n);
 }
 
-int32_t _komodo_DEX_purgeindex(int32_t ind,struct DEX_index *index,uint32_t cutoff)
-{
-    uint32_t t; int32_t n=0; struct DEX_datablob *ptr = 0;
-    ptr = index->head;
-    while ( ptr != 0 )
-    {
-        if ( GETBIT(&ptr->linkmask,ind) == 0 )
-        {
-            fprintf(stderr,"unlink attempted for clearbit ind.%d ptr.%p\n",ind,ptr);
-            break;
-        }
-        iguana_rwnum(0,&ptr->data[2],sizeof(t),&t);
-        if ( t <= cutoff )
-        {
-            if ( index->tail == index->head )
-                index->tail = 0;
-            DL_DELETEind(index->head,ptr,ind);
-            n++;
-            CLEARBIT(&ptr->linkmask,ind);
-            if ( ptr->linkmask == 0 )
-            {
-#if KOMODO_DEX_PURGELIST
-                G->Purgelist[G->numpurges++] = ptr;
-#else
-                free(ptr);
-                DEX_freed++;
-#endif
-             } // else fprintf(stderr,"%p ind.%d linkmask.%x\n",ptr,ind,ptr->linkmask);
-             ptr = index->head;
-        }
-        else
-        {
-            if ( 0 && t > cutoff )
-                fprintf(stderr,"purgeindex.%d cutoff %u got future t.%u\n",ind,cutoff,t);
-            break;
-        }
-    }
-    return(n);
-}
-
 int32_t _komodo_DEXpurge(uint32_t cutoff)
 {
     static uint32_t prevtotalhash,lastadd,lastcutoff;
-    int32_t i,n=0,modval,total,offset,h; int64_t lagsum = 0; uint8_t relay,funcid,*msg; uint32_t t,totalhash,purgehash=0; struct DEX_datablob *ptr,*tmp;
+    int32_t i,n=0,modval,total; int64_t lagsum = 0; uint32_t totalhash,purgehash=0; struct DEX_bucket *bucket;
     if ( (cutoff % SECONDS_IN_DAY) == (SECONDS_IN_DAY-1) )
     {
         fprintf(stderr,"reset peermaps at end of day!\n");
         memset(G->DEX_peermaps,0,sizeof(G->DEX_peermaps));
     }
     modval = (cutoff % KOMODO_DEX_PURGETIME);
-    HASH_ITER(hh,G->Hashtables[modval],ptr,tmp)
-    {
-        msg = &ptr->data[0];
-        relay = msg[0];
-        funcid = msg[1];
-        iguana_rwnum(0,&msg[2],sizeof(t),&t);
-        if ( t <= cutoff )
-        {
-            if ( ptr->recvtime >= t )
-                lagsum += (ptr->recvtime - t);
-            purgehash ^= ptr->shorthash;
-            HASH_DELETE(hh,G->Hashtables[modval],ptr);
-            ptr->datalen = 0;
-            CLEARBIT(&ptr->linkmask,KOMODO_DEX_MAXINDICES);
-            DEX_truncated++;
-            n++;
-        } // else fprintf(stderr,"modval.%d unexpected purge.%d t.%u vs cutoff.%u\n",modval,i,t,cutoff);
-    }
+    bucket = &G->Buckets[modval];
+    if ( bucket->chunks != 0 && bucket->timestamp <= cutoff )
+    {
+        // the bucket only has datablobs of one second, drop its hashtable and arena at once. purgecutoff is raised first so no index follows a link into the freed arena
+        if ( cutoff > G->purgecutoff )
+            G->purgecutoff = cutoff;
+        n = bucket->num;
+        lagsum = bucket->lagsum;
+        purgehash = bucket->purgehash;
+        HASH_CLEAR(hh,G->Hashtables[modval]);
+        _komodo_DEX_bucketfree(bucket);
+        DEX_truncated += n;
+        DEX_freed += n;
+    }
+    else if ( cutoff > G->purgecutoff )
+        G->purgecutoff = cutoff;
     //totalhash = _komodo_DEXtotal(total);
     if ( (modval % 60) == 0 ) // n != 0 ||  //totalhash != prevtotalhash )
     {
@@ -541,60 +841,6 @@ int32_t _komodo_DEXpurge(uint32_t cutoff)
     return(n);
 }
 
-int32_t _komodo_DEX_purgeindices(uint32_t cutoff)
-{
-    int32_t i,j,n=0; uint32_t t; struct DEX_datablob *ptr; struct DEX_index *index = 0,*tmp;
-    if ( DEX_destpubs != 0 )
-    {
-        HASH_ITER(hh,DEX_destpubs,index,tmp)
-        {
-            n += _komodo_DEX_purgeindex(0,index,cutoff);
-        }
-    }
-    if ( DEX_tagAs != 0 )
-    {
-        HASH_ITER(hh,DEX_tagAs,index,tmp)
-        {
-            n += _komodo_DEX_purgeindex(1,index,cutoff);
-        }
-    }
-    if ( DEX_tagBs != 0 )
-    {
-        HASH_ITER(hh,DEX_tagBs,index,tmp)
-        {
-            n += _komodo_DEX_purgeindex(2,index,cutoff);
-        }
-    }
-    if ( DEX_tagABs != 0 )
-    {
-        HASH_ITER(hh,DEX_tagABs,index,tmp)
-        {
-            n += _komodo_DEX_purgeindex(3,index,cutoff);
-        }
-    }
-#if KOMODO_DEX_PURGELIST
-    for (i=0; i<G->numpurges; i++)
-    {
-        if ( (ptr= G->Purgelist[i]) != 0 )
-        {
-            iguana_rwnum(0,&ptr->data[2],sizeof(t),&t);
-            if ( t <= cutoff - KOMODO_DEX_MAXLAG/2 )
-            {
-                if ( ptr->linkmask == 0 )
-                {
-                    G->Purgelist[i] = G->Purgelist[--G->numpurges];
-                    G->Purgelist[G->numpurges] = 0;
-                    i--;
-                    free(ptr);
-                    DEX_freed++;
-                } else fprintf(stderr,"ptr is still accessed? linkmask.%x\n",ptr->linkmask);
-            }
-        } else fprintf(stderr,"unexpected null ptr at %d of %d\n",i,G->numpurges);
-    }
-#endif
-    return(n);
-}
-
 char *komodo_DEX_keystr(char *str,uint8_t *key,int8_t keylen)
 {
     int32_t i;
@@ -864,12 +1110,16 @@ struct DEX_datablob *_komodo_DEXfind(int32_t modval,uint32_t shorthash)
 
 struct DEX_datablob *_komodo_DEXadd(uint32_t now,int32_t modval,bits256 hash,uint32_t shorthash,uint8_t *msg,int32_t len)
 {
-    int32_t ind,offset,priority; struct DEX_datablob *ptr; struct DEX_index *tips[KOMODO_DEX_MAXINDICES]; uint64_t amountA,amountB; uint8_t tagA[KOMODO_DEX_TAGSIZE+1],tagB[KOMODO_DEX_TAGSIZE+1],destpub33[33]; int8_t lenA,lenB,plen;
+    int32_t ind,offset,priority; uint32_t t; struct DEX_datablob *ptr; struct DEX_bucket *bucket; struct DEX_index *tips[KOMODO_DEX_MAXINDICES]; uint64_t amountA,amountB; uint8_t tagA[KOMODO_DEX_TAGSIZE+1],tagB[KOMODO_DEX_TAGSIZE+1],destpub33[33]; int8_t lenA,lenB,plen;
     if ( modval < 0 || modval >= KOMODO_DEX_PURGETIME )
     {
         fprintf(stderr,"komodo_DEXadd illegal modval.%d\n",modval);
         return(0);
     }
+    iguana_rwnum(0,&msg[2],sizeof(t),&t);
+    bucket = &G->Buckets[modval];
+    if ( t <= G->purgecutoff || (bucket->chunks != 0 && bucket->timestamp != t) ) // already expired, its bucket is purged or holds a newer second
+        return(0);
     if ( (hash.ulongs[0] & KOMODO_DEX_TXPOWMASK) != (0x777 & KOMODO_DEX_TXPOWMASK) )
     {
         static uint32_t count; char str[65];
@@ -883,9 +1133,17 @@ struct DEX_datablob *_komodo_DEXadd(uint32_t now,int32_t modval,bits256 hash,uin
     memset(tagB,0,sizeof(tagB));
     if ( (offset= komodo_DEX_extract(amountA,amountB,lenA,tagA,lenB,tagB,destpub33,plen,&msg[KOMODO_DEX_ROUTESIZE],len-KOMODO_DEX_ROUTESIZE)) < 0 )
         return(0);
-    if ( (ptr= (struct DEX_datablob *)calloc(1,sizeof(*ptr) + len)) != 0 )
-    {
+    if ( (ptr= _komodo_DEX_arenaalloc(bucket,sizeof(*ptr) + len)) != 0 )
+    {
+        bucket->timestamp = t;
+        bucket->num++;
+        if ( priority >= KOMODO_DEX_VIPLEVEL )
+            bucket->numvip++;
+        bucket->purgehash ^= shorthash;
+        if ( now >= t )
+            bucket->lagsum += (now - t);
         ptr->recvtime = now;
+        ptr->timestamp = t;
         ptr->hash = hash;
         ptr->shorthash = shorthash;
         ptr->datalen = len;
@@ -896,10 +1154,12 @@ struct DEX_datablob *_komodo_DEXadd(uint32_t now,int32_t modval,bits256 hash,uin
         ptr->data[0] = msg[0] != 0xff ? msg[0] - 1 : msg[0];
         {
             HASH_ADD(hh,G->Hashtables[modval],shorthash,sizeof(ptr->shorthash),ptr);
-            SETBIT(&ptr->linkmask,KOMODO_DEX_MAXINDICES);
             DEX_totaladd++;
+            DEX_perf.priorities[std::min(std::max((int32_t)priority,0),15)]++;
             if ( (_DEX_updatetips(tips,priority,ptr,lenA,tagA,lenB,tagB,destpub33,plen) >> 16) != 0 )
                 fprintf(stderr,"update M.%d slot.%d [%d] with %08x error updating tips\n",modval,ind,ptr->data[0],ptr->shorthash);
+            else if ( tips[KOMODO_DEX_MAXINDICES-1] != 0 )
+                _komodo_DEX_bookadd(tips[KOMODO_DEX_MAXINDICES-1],ptr,amountA,amountB);
         }
         return(ptr);
     }
@@ -1004,9 +1264,23 @@ int32_t komodo_DEXpacketsend(CNode *peer,uint8_t peerpos,struct DEX_datablob *pt
 int32_t _komodo_DEXmodval(uint32_t now,const int32_t modval,CNode *peer)
 {
     static uint32_t recents[16][KOMODO_DEX_MAXPERSEC],sendbuf[KOMODO_DEX_MAXPING];
-    std::vector<uint8_t> packet; int32_t i,j,n=0,mult,p,vip=0,maxp=0,sum=0; uint16_t peerpos,num[16]; uint8_t priority,relay,funcid,*msg; uint32_t t,h; struct DEX_datablob *ptr=0,*tmp;
+    std::vector<uint8_t> packet; int32_t i,j,n=0,mult,p,vip=0,maxp=0,sum=0; uint16_t peerpos,num[16]; uint8_t priority,relay,funcid,*msg; uint32_t t,h; struct DEX_datablob *ptr=0,*tmp; struct DEX_bucket *bucket;
     if ( modval < 0 || modval >= KOMODO_DEX_PURGETIME || (peerpos= _komodo_DEXpeerpos(now,peer->id)) == 0xffff )
         return(-1);
+    // skip the walk when the peer already has every datablob that would be pinged, the counts are kept as its peermask bits are set
+    bucket = &G->Buckets[modval];
+    if ( bucket->num == 0 )
+        return(0);
+    else if ( bucket->numrequested == 0 )
+    {
+        if ( now < bucket->timestamp+KOMODO_DEX_MAXLAG )
+        {
+            if ( bucket->haves[peerpos] >= bucket->num )
+                return(0);
+        }
+        else if ( bucket->viphaves[peerpos] >= bucket->numvip )
+            return(0);
+    }
     memset(num,0,sizeof(num));
     HASH_ITER(hh,G->Hashtables[modval],ptr,tmp)
     {
@@ -1045,7 +1319,7 @@ int32_t _komodo_DEXmodval(uint32_t now,const int32_t modval,CNode *peer)
                     if ( ptr->requested > 0 )
                     {
                         //fprintf(G->fp,"%08x.R%d.%d ",ptr->shorthash,ptr->requested,GETBIT(ptr->peermask,peerpos));
-                        ptr->requested--;
+                        _komodo_DEX_setrequested(ptr,ptr->requested - 1);
                         vip++;
                     }
                     if ( ptr->numsent < KOMODO_DEX_MAXFANOUT )
@@ -1055,7 +1329,10 @@ int32_t _komodo_DEXmodval(uint32_t now,const int32_t modval,CNode *peer)
                             if ( komodo_DEX_islagging() == 0 )
                             {
                                 komodo_DEXpacketsend(peer,peerpos,ptr,ptr->data[0]);
-                                ptr->numsent++;
+                                if ( ptr->numsent++ == 0 )
+                                    DEX_perf.relayed++;
+                                DEX_perf.relays++;
+                                DEX_perf.relaylags[now > ptr->recvtime ? std::min((int32_t)(now - ptr->recvtime),KOMODO_DEX_PERFBINS-1) : 0]++;
                             }
                         }
                     }
@@ -1189,7 +1466,7 @@ int32_t _komodo_DEX_cancelpubkey(char *tagA,char *tagB,uint8_t *cancelkey33,uint
     memcpy(senderpub.bytes,cancelkey33+1,32);
     if ( (index= _DEX_indexsearch(0,0,0,33,cancelkey33,0,0)) != 0 )
     {
-        for (ptr=index->tail; ptr!=0; ptr=ptr->prevs[ind])
+        for (ptr=_komodo_DEX_tail(index); ptr!=0; ptr=_komodo_DEX_prev(ind,ptr))
         {
             iguana_rwnum(0,&ptr->data[2],sizeof(t),&t);
             if ( t < cutoff-KOMODO_DEX_MAXHOPS && komodo_DEX_cancelupdate(ptr,tagA,tagB,senderpub,cutoff) >= 0 )
@@ -1197,8 +1474,6 @@ int32_t _komodo_DEX_cancelpubkey(char *tagA,char *tagB,uint8_t *cancelkey33,uint
                 //fprintf(stderr,"cancel ptr.%p %08x t.%u cutoff.%u (%s,%s) cancelled.%u\n",ptr,ptr->shorthash,t,cutoff-KOMODO_DEX_MAXHOPS,tagA,tagB,ptr->cancelled);
                 n++;
             }
-            if ( ptr == index->head )
-                break;
        }
     }
     return(n);
@@ -1220,7 +1495,7 @@ int32_t _komodo_DEX_locatorsextract(int32_t sendflag,uint32_t shorthash,int32_t
             iguana_rwnum(0,&decoded[j*8 + 8],sizeof(locator),&locator);
             if ( (ptr= _komodo_DEXfind((int32_t)(locator >> 32) % KOMODO_DEX_PURGETIME,(uint32_t)locator)) != 0 )
             {
-                ptr->requested = numrequests;
+                _komodo_DEX_setrequested(ptr,numrequests);
                 //fprintf(stderr,"%u ",ptr->shorthash);
                 n++;
             }
@@ -1249,7 +1524,7 @@ int32_t _komodo_DEX_commandprocessor(struct DEX_datablob *ptr,int32_t addedflag,
     memcpy(pubkey.bytes,pubkey33+1,32);
     //if ( memcmp(pubkey.bytes,DEX_pubkey.bytes,32) == 0 )
     //    addedflag = 1;
-    if ( addedflag != 0 )
+    if ( addedflag != 0 && ptr->data[1] != 'A' ) // an anonsend is only decoded when it is listed
     {
         if ( (decoded= komodo_DEX_datablobdecrypt(&senderpub,&allocated,&newlen,ptr,pubkey,taga)) != 0 && newlen > 0 )
         {
@@ -1265,10 +1540,6 @@ int32_t _komodo_DEX_commandprocessor(struct DEX_datablob *ptr,int32_t addedflag,
                     fprintf(stderr,"received REQUEST command for (%s/%s) %08x t.%u -> updated %d ptrs\n",taga,tagb,shorthash,t,n);
                 } else fprintf(stderr,"newlen.%d != 8 for 'R'\n",newlen);
             }
-            else if ( ptr->data[1] == 'A' )
-            {
-                //fprintf(stderr,"got anonsend newlen.%d\n",newlen);
-            }
             else if ( ptr->data[1] == 'X' )
             {
                 if ( strcmp(taga,"cancel") != 0 )
@@ -1320,7 +1591,8 @@ int32_t _komodo_DEX_commandprocessor(struct DEX_datablob *ptr,int32_t addedflag,
     return(newlen);
 }
 
-int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len)
+// a nonzero hash is komodo_DEXquotehash of msg, done by the ingress threads outside of DEX_globallock
+int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len,bits256 prehash)
 {
     static uint32_t cache[2],pongbuf[KOMODO_DEX_MAXPING];
     int32_t i,j,ind,m,p,tmpval,haves,offset,flag,modval,lag,priority,addedflag=0; uint16_t n,peerpos; uint32_t t,h; uint8_t funcid,relay=0; bits256 hash; struct DEX_datablob *ptr;
@@ -1335,7 +1607,14 @@ int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len)
         lag = (now - t);
         if ( lag < 0 )
             lag = 0;
-        h = komodo_DEXquotehash(hash,msg,len);
+        DEX_perf.funcids[funcid]++;
+        if ( funcid == 'Q' || funcid == 'X' || funcid == 'R' || funcid == 'A' )
+            DEX_perf.recvlags[std::min(lag,KOMODO_DEX_PERFBINS-1)]++;
+        if ( bits256_nonz(prehash) != 0 )
+        {
+            hash = prehash;
+            h = _komodo_DEXquotehash(hash,len);
+        } else h = komodo_DEXquotehash(hash,msg,len);
         priority = komodo_DEX_priority(hash.ulongs[0],len);
         if ( t > now+KOMODO_DEX_LOCALHEARTBEAT )
         {
@@ -1403,7 +1682,7 @@ int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len)
                 }
                 if ( ptr != 0 )
                 {
-                    SETBIT(ptr->peermask,peerpos);
+                    _komodo_DEX_peerhas(ptr,peerpos);
                     if ( funcid != 'Q' )
                         _komodo_DEX_commandprocessor(ptr,addedflag,peerpos);
                 }
@@ -1425,7 +1704,7 @@ int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len)
                         offset += iguana_rwnum(0,&msg[offset],sizeof(h),&h);
                         if ( (ptr= _komodo_DEXfind(m,h)) != 0 )
                         {
-                            SETBIT(ptr->peermask,peerpos);
+                            _komodo_DEX_peerhas(ptr,peerpos);
                             pongbuf[haves++] = h;
                             continue;
                         }
@@ -1828,7 +2107,7 @@ UniValue komodo_DEXbroadcast(uint64_t *locatorp,uint8_t funcid,char *hexstr,int3
             return(0);
         }
         {
-            pthread_mutex_lock(&DEX_globalmutex);
+            komodo_DEX_lock();
             iguana_rwnum(0,&packet[2],sizeof(timestamp),&timestamp);
             modval = (timestamp % KOMODO_DEX_PURGETIME);
             if ( (ptr= _komodo_DEXfind(modval,shorthash)) == 0 )
@@ -1848,7 +2127,7 @@ UniValue komodo_DEXbroadcast(uint64_t *locatorp,uint8_t funcid,char *hexstr,int3
                     fprintf(stderr," cant issue duplicate order modval.%d t.%u %08x %016llx\n",modval,timestamp,shorthash,(long long)hash.ulongs[0]);
                 srand((int32_t)timestamp);
             }
-            pthread_mutex_unlock(&DEX_globalmutex);
+            komodo_DEX_unlock();
         }
         if ( blastflag == 0 )
             break;
@@ -1962,7 +2241,7 @@ int32_t komodo_DEX_ptrfilter(uint64_t &amountA,uint64_t &amountB,struct DEX_data
 
 UniValue _komodo_DEXlist(uint32_t stopat,int32_t minpriority,char *tagA,char *tagB,char *destpub33,char *minA,char *maxA,char *minB,char *maxB,char *stophashstr)
 {
-    UniValue result(UniValue::VOBJ),a(UniValue::VARR);  struct DEX_datablob *ptr; int32_t err,ind,n=0,skipflag; bits256 stophash; struct DEX_index *tips[KOMODO_DEX_MAXINDICES],*index; uint64_t minamountA=0,maxamountA=(1LL<<63),minamountB=0,maxamountB=(1LL<<63),amountA,amountB; int8_t lenA=0,lenB=0,plen=0; uint8_t destpub[33]; uint32_t thislist;
+    UniValue result(UniValue::VOBJ),a(UniValue::VARR);  struct DEX_datablob *ptr; int32_t err,ind,n=0,skipflag; bits256 stophash; struct DEX_index *tips[KOMODO_DEX_MAXINDICES],*index; uint64_t minamountA=0,maxamountA=(1LL<<63),minamountB=0,maxamountB=(1LL<<63),amountA,amountB; int8_t lenA=0,lenB=0,plen=0; uint8_t destpub[33]; std::set<struct DEX_datablob *> listed;
     if ( stophashstr != 0 && is_hexstr(stophashstr,0) == 64 )
         decode_hex(stophash.bytes,32,stophashstr);
     else memset(stophash.bytes,0,32);
@@ -1973,26 +2252,22 @@ UniValue _komodo_DEXlist(uint32_t stopat,int32_t minpriority,char *tagA,char *ta
         result.push_back(Pair((char *)"errcode",err));
         return(result);
     }
-    thislist = komodo_DEX_listid();
     n = 0;
     for (ind=0; ind<KOMODO_DEX_MAXINDICES; ind++)
     {
         if ( (index= tips[ind]) != 0 )
         {
-            for (ptr=index->tail; ptr!=0; ptr=ptr->prevs[ind])
+            for (ptr=_komodo_DEX_tail(index); ptr!=0; ptr=_komodo_DEX_prev(ind,ptr))
             {
                 if ( (stopat != 0 && komodo_DEX_id(ptr) == stopat) || memcmp(stophash.bytes,ptr->hash.bytes,32) == 0 )
                     break;
                 skipflag = komodo_DEX_ptrfilter(amountA,amountB,ptr,minpriority,lenA,tagA,lenB,tagB,plen,destpub,minamountA,maxamountA,minamountB,maxamountB);
-                if ( skipflag == 0 && ptr->lastlist != thislist )
+                if ( skipflag == 0 && listed.insert(ptr).second )
                 {
-                    ptr->lastlist = thislist;
                     //fprintf(stderr,"%u ",ptr->shorthash);
                     a.push_back(komodo_DEX_dataobj(ptr));
                     n++;
                 }
-                if ( ptr == index->head )
-                    break;
             }
         }
     }
@@ -2008,60 +2283,6 @@ UniValue _komodo_DEXlist(uint32_t stopat,int32_t minpriority,char *tagA,char *ta
 
 // orderbook support
 
-static int _cmp_orderbook(const void *a,const void *b) // bids
-{
-    int32_t retval = 0;
-#define ptr_a (*(struct DEX_orderbookentry **)a)->price
-#define ptr_b (*(struct DEX_orderbookentry **)b)->price
-    if ( ptr_b > ptr_a+SMALLVAL )
-        retval = -1;
-    else if ( ptr_b < ptr_a-SMALLVAL )
-        retval = 1;
-    else
-    {
-#undef ptr_a
-#undef ptr_b
-#define ptr_a (*(struct DEX_orderbookentry **)a)->amountA
-#define ptr_b (*(struct DEX_orderbookentry **)b)->amountA
-        //printf("cmp %.8f vs %.8f <- %p %p\n",dstr(ptr_a),dstr(ptr_b),a,b);
-        if ( ptr_b > ptr_a )
-            return(1);
-        else if ( ptr_b < ptr_a )
-            return(-1);
-    }
-    // printf("%.8f vs %.8f -> %d\n",ptr_a,ptr_b,retval);
-    return(retval);
-#undef ptr_a
-#undef ptr_b
-}
-
-static int _revcmp_orderbook(const void *a,const void *b) // asks
-{
-    int32_t retval = 0;
-#define ptr_a (*(struct DEX_orderbookentry **)a)->price
-#define ptr_b (*(struct DEX_orderbookentry **)b)->price
-    if ( ptr_b > ptr_a+SMALLVAL )
-        retval = 1;
-    else if ( ptr_b < ptr_a-SMALLVAL )
-        retval = -1;
-    else
-    {
-#undef ptr_a
-#undef ptr_b
-#define ptr_a (*(struct DEX_orderbookentry **)a)->amountA
-#define ptr_b (*(struct DEX_orderbookentry **)b)->amountA
-        //printf("revcmp %.8f vs %.8f <- %p %p\n",dstr(ptr_a),dstr(ptr_b),a,b);
-        if ( ptr_b > ptr_a )
-            return(1);
-        else if ( ptr_b < ptr_a )
-            return(-1);
-    }
-    // printf("%.8f vs %.8f -> %d\n",ptr_a,ptr_b,retval);
-    return(retval);
-#undef ptr_a
-#undef ptr_b
-}
-
 UniValue DEX_orderbookjson(struct DEX_orderbookentry *op)
 {
     UniValue item(UniValue::VOBJ); char str[67]; int32_t i;
@@ -2125,7 +2346,7 @@ struct DEX_orderbookentry *DEX_orderbookentry(struct DEX_datablob *ptr,int32_t r
 
 UniValue _komodo_DEXorderbook(int32_t revflag,int32_t maxentries,int32_t minpriority,char *tagA,char *tagB,char *destpub33,char *minA,char *maxA,char *minB,char *maxB)
 {
-    UniValue result(UniValue::VOBJ),a(UniValue::VARR); struct DEX_orderbookentry *op; std::vector<struct DEX_orderbookentry *>orders; struct DEX_datablob *ptr; uint32_t thislist; int32_t i,err,ind,n=0,skipflag; struct DEX_index *tips[KOMODO_DEX_MAXINDICES],*index; uint64_t minamountA=0,maxamountA=(1LL<<63),minamountB=0,maxamountB=(1LL<<63),amountA,amountB; int8_t lenA=0,lenB=0,plen=0; uint8_t destpub[33];
+    UniValue result(UniValue::VOBJ),a(UniValue::VARR); struct DEX_orderbookentry *op; struct DEX_datablob *ptr; int32_t i,err,n=0,skipflag; struct DEX_index *tips[KOMODO_DEX_MAXINDICES],*index; uint64_t minamountA=0,maxamountA=(1LL<<63),minamountB=0,maxamountB=(1LL<<63),amountA,amountB; int8_t lenA=0,lenB=0,plen=0; uint8_t destpub[33];
     if ( maxentries <= 0 )
         maxentries = 10;
     if ( tagA[0] == 0 || tagB[0] == 0 )
@@ -2140,41 +2361,23 @@ UniValue _komodo_DEXorderbook(int32_t revflag,int32_t maxentries,int32_t minprio
         //fprintf(stderr,"couldnt find any\n");
         return(a);
     }
-    thislist = komodo_DEX_listid();
-    n = 0;
-    for (ind=KOMODO_DEX_MAXINDICES-1; ind<KOMODO_DEX_MAXINDICES; ind++) // only need tagABs
+    // the tagAB book is kept sorted as datablobs are added, so only the best orders that pass the filters are read
+    if ( (index= tips[KOMODO_DEX_MAXINDICES-1]) != 0 && index->book != 0 )
     {
-        if ( (index= tips[ind]) != 0 )
+        std::vector<struct DEX_bookentry> &orders = index->book->orders[revflag != 0];
+        for (i=0; i<(int32_t)orders.size() && n<maxentries; i++)
         {
-            for (ptr=index->tail; ptr!=0; ptr=ptr->prevs[ind])
+            if ( _komodo_DEX_bookdead(orders[i]) )
+                continue;
+            ptr = orders[i].ptr;
+            skipflag = komodo_DEX_ptrfilter(amountA,amountB,ptr,minpriority,lenA,tagA,lenB,tagB,plen,destpub,minamountA,maxamountA,minamountB,maxamountB);
+            if ( skipflag == 0 && ptr->cancelled == 0 && amountA != 0 && amountB != 0 && (op= DEX_orderbookentry(ptr,revflag,tagA,tagB)) != 0 )
             {
-                skipflag = komodo_DEX_ptrfilter(amountA,amountB,ptr,minpriority,lenA,tagA,lenB,tagB,plen,destpub,minamountA,maxamountA,minamountB,maxamountB);
-                if ( skipflag == 0 && ptr->cancelled == 0 && amountA != 0 && amountB != 0 )
-                {
-                    if ( ptr->lastlist != thislist && (op= DEX_orderbookentry(ptr,revflag,tagA,tagB)) != 0 ) //
-                    {
-                        //fprintf(stderr,"ADD n.%d lastlist.%u vs %u\n",n,ptr->lastlist,thislist);
-                        ptr->lastlist = thislist;
-                        orders.push_back(op);
-                        n++;
-                    } else fprintf(stderr,"skip ptr->lastlist.%u vs thislist.%d\n",ptr->lastlist,thislist);
-                } //else fprintf(stderr,"skipflag.%d cancelled.%u plen.%d amountA %.8f amountB %.8f\n",skipflag,ptr->cancelled,plen,dstr(amountA),dstr(amountB));
-                if ( ptr == index->head )
-                    break;
-            }
-        }
-    }
-    if ( n > 0 )
-    {
-        //fprintf(stderr,"sort %d orders for %s/%s\n",n,tagA,tagB);
-        qsort(&orders[0],n,sizeof(struct DEX_orderbookentry *),revflag != 0 ? _revcmp_orderbook : _cmp_orderbook);
-        for (i=0; i<maxentries&&i<n; i++)
-        {
-            a.push_back(DEX_orderbookjson(orders[i]));
-            free(orders[i]);
+                a.push_back(DEX_orderbookjson(op));
+                free(op);
+                n++;
+            } //else fprintf(stderr,"skipflag.%d cancelled.%u plen.%d amountA %.8f amountB %.8f\n",skipflag,ptr->cancelled,plen,dstr(amountA),dstr(amountB));
         }
-        for (; i<n; i++)
-            free(orders[i]);
     }
     return(a);
 }
@@ -2186,7 +2389,7 @@ UniValue komodo_DEX_stats()
     static uint32_t lastadd,lasttime;
     UniValue result(UniValue::VOBJ); char str[65],pubstr[67],logstr[1024],recvaddr[64]; int32_t i,total,histo[64]; uint32_t now,totalhash,d;
     pubkey2addr(recvaddr,NOTARY_PUBKEY33);
-    pthread_mutex_lock(&DEX_globalmutex);
+    komodo_DEX_lock();
     now = (uint32_t)time(NULL);
     bits256_str(pubstr+2,DEX_pubkey);
     pubstr[0] = '0';
@@ -2215,7 +2418,77 @@ UniValue komodo_DEX_stats()
     lasttime = now;
     lastadd = DEX_totaladd;
     result.push_back(Pair((char *)"perfstats",logstr));
-    pthread_mutex_unlock(&DEX_globalmutex);
+    komodo_DEX_unlock();
+    result.push_back(Pair((char *)"ingress",DEX_ingressring->Size()));
+    result.push_back(Pair((char *)"insert",DEX_insertring->Size()));
+    result.push_back(Pair((char *)"ingress_dropped",DEX_ingressdropped.load()));
+    result.push_back(Pair((char *)"ingress_invalid",DEX_ingressinvalid.load()));
+    return(result);
+}
+
+UniValue komodo_DEX_perfarray(int64_t *bins,int32_t n)
+{
+    UniValue a(UniValue::VARR); int32_t i;
+    for (i=0; i<n; i++)
+        a.push_back((int64_t)bins[i]);
+    return(a);
+}
+
+UniValue komodo_DEX_perfstats()
+{
+    static int64_t prevfuncids[256],prevtime;
+    UniValue result(UniValue::VOBJ),rates(UniValue::VOBJ),occupancy(UniValue::VOBJ),fanout(UniValue::VOBJ); int64_t now,chunkbytes=0; int32_t i,filled=0,maxnum=0,total=0; struct DEX_arenachunk *chunk; char key[8];
+    komodo_DEX_lock();
+    now = GetTimeMicros();
+    // packets/sec of each funcid since the previous call
+    for (i=0; i<256; i++)
+    {
+        if ( DEX_perf.funcids[i] != 0 )
+        {
+            if ( i >= 0x20 && i < 0x7f )
+                sprintf(key,"%c",i);
+            else sprintf(key,"%02x",i);
+            rates.push_back(Pair(key,prevtime != 0 && now > prevtime ? (double)(DEX_perf.funcids[i] - prevfuncids[i]) * 1000000 / (now - prevtime) : 0.));
+        }
+    }
+    memcpy(prevfuncids,DEX_perf.funcids,sizeof(prevfuncids));
+    prevtime = now;
+    for (i=0; i<KOMODO_DEX_PURGETIME; i++)
+    {
+        if ( G->Buckets[i].num != 0 )
+        {
+            filled++;
+            total += G->Buckets[i].num;
+            maxnum = std::max(maxnum,G->Buckets[i].num);
+            for (chunk=G->Buckets[i].chunks; chunk!=0; chunk=chunk->next)
+                chunkbytes += chunk->size;
+        }
+    }
+    occupancy.push_back(Pair("buckets",(int64_t)filled));
+    occupancy.push_back(Pair("datablobs",(int64_t)total));
+    occupancy.push_back(Pair("maxperbucket",(int64_t)maxnum));
+    occupancy.push_back(Pair("arenabytes",chunkbytes));
+    fanout.push_back(Pair("maxfanout",(int64_t)KOMODO_DEX_MAXFANOUT));
+    fanout.push_back(Pair("relaydepth",(int64_t)KOMODO_DEX_RELAYDEPTH));
+    fanout.push_back(Pair("relays",DEX_perf.relays));
+    fanout.push_back(Pair("relayed",DEX_perf.relayed));
+    fanout.push_back(Pair("added",DEX_totaladd));
+    fanout.push_back(Pair("duplicates",DEX_duplicate));
+    fanout.push_back(Pair("duplicateratio",DEX_totalrecv != 0 ? (double)DEX_duplicate / DEX_totalrecv : 0.));
+    result.push_back(Pair("result","success"));
+    result.push_back(Pair("rates",rates));
+    result.push_back(Pair("occupancy",occupancy));
+    result.push_back(Pair("fanout",fanout));
+    result.push_back(Pair("priorities",komodo_DEX_perfarray(DEX_perf.priorities,16)));
+    result.push_back(Pair("recvlags",komodo_DEX_perfarray(DEX_perf.recvlags,KOMODO_DEX_PERFBINS)));
+    result.push_back(Pair("relaylags",komodo_DEX_perfarray(DEX_perf.relaylags,KOMODO_DEX_PERFBINS)));
+    result.push_back(Pair("lockholds",komodo_DEX_perfarray(DEX_perf.lockholds,KOMODO_DEX_PERFBINS)));
+    result.push_back(Pair("maxlockhold",DEX_perf.maxlockhold));
+    result.push_back(Pair("purgetimes",komodo_DEX_perfarray(DEX_perf.purgetimes,KOMODO_DEX_PERFBINS)));
+    result.push_back(Pair("maxpurgetime",DEX_perf.maxpurgetime));
+    komodo_DEX_unlock();
+    result.push_back(Pair("ingress_dropped",DEX_ingressdropped.load()));
+    result.push_back(Pair("ingress_invalid",DEX_ingressinvalid.load()));
     return(result);
 }
 
@@ -2230,9 +2503,9 @@ UniValue komodo_DEXcancel(char *pubkeystr,uint32_t shorthash,char *tagA,char *ta
     {
         len = iguana_rwnum(1,&hex[len],sizeof(shorthash),&shorthash);
         {
-            pthread_mutex_lock(&DEX_globalmutex);
+            komodo_DEX_lock();
             _komodo_DEX_cancelid(shorthash,DEX_pubkey,(uint32_t)time(NULL));
-            pthread_mutex_unlock(&DEX_globalmutex);
+            komodo_DEX_unlock();
         }
     }
     else if ( pubkeystr[0] != 0 )
@@ -2248,9 +2521,9 @@ UniValue komodo_DEXcancel(char *pubkeystr,uint32_t shorthash,char *tagA,char *ta
         decode_hex(hex,33,checkstr);
         len = 33;
         {
-            pthread_mutex_lock(&DEX_globalmutex);
+            komodo_DEX_lock();
             _komodo_DEX_cancelpubkey((char *)"",(char *)"",pub33,(uint32_t)time(NULL));
-            pthread_mutex_unlock(&DEX_globalmutex);
+            komodo_DEX_unlock();
         }
     }
     else if ( tagA[0] != 0 && tagB[0] != 0 )
@@ -2270,9 +2543,9 @@ UniValue komodo_DEXcancel(char *pubkeystr,uint32_t shorthash,char *tagA,char *ta
         hex[len++] = lenB;
         memcpy(&hex[len],tagB,lenB), len += lenB;
         {
-            pthread_mutex_lock(&DEX_globalmutex);
+            komodo_DEX_lock();
             _komodo_DEX_cancelpubkey(tagA,tagB,pub33,(uint32_t)time(NULL));
-            pthread_mutex_unlock(&DEX_globalmutex);
+            komodo_DEX_unlock();
         }
     }
     for (i=0; i<len; i++)
@@ -2287,39 +2560,63 @@ UniValue komodo_DEXcancel(char *pubkeystr,uint32_t shorthash,char *tagA,char *ta
 UniValue komodo_DEXget(uint32_t shorthash)
 {
     UniValue result;
-    pthread_mutex_lock(&DEX_globalmutex);
+    komodo_DEX_rdlock();
     result = _komodo_DEXget(shorthash);
-    pthread_mutex_unlock(&DEX_globalmutex);
+    komodo_DEX_rdunlock();
     return(result);
 }
 
 UniValue komodo_DEXlist(uint32_t stopat,int32_t minpriority,char *tagA,char *tagB,char *destpub33,char *minA,char *maxA,char *minB,char *maxB,char *stophashstr)
 {
     UniValue result;
-    pthread_mutex_lock(&DEX_globalmutex);
+    komodo_DEX_rdlock();
     result = _komodo_DEXlist(stopat,minpriority,tagA,tagB,destpub33,minA,maxA,minB,maxB,stophashstr);
-    pthread_mutex_unlock(&DEX_globalmutex);
+    komodo_DEX_rdunlock();
     return(result);
 }
 
 UniValue komodo_DEXorderbook(int32_t revflag,int32_t maxentries,int32_t minpriority,char *tagA,char *tagB,char *destpub33,char *minA,char *maxA,char *minB,char *maxB)
 {
     UniValue result;
-    pthread_mutex_lock(&DEX_globalmutex);
+    komodo_DEX_rdlock();
     result = _komodo_DEXorderbook(revflag,maxentries,minpriority,tagA,tagB,destpub33,minA,maxA,minB,maxB);
-    pthread_mutex_unlock(&DEX_globalmutex);
+    komodo_DEX_rdunlock();
     return(result);
 }
 
+// sha256 of rlen bytes at offset0, same as vcalc_sha256 over them, from a mapping of the file or streamed without a copy of it in memory
 bits256 komodo_DEX_filehash(FILE *fp,uint64_t offset0,uint64_t rlen,char *fname)
 {
-    bits256 filehash; uint8_t *data = (uint8_t *)calloc(1,rlen);
-    fseek(fp,offset0,SEEK_SET);
+    bits256 filehash; CSHA256 hasher; uint8_t buf[1 << 16]; uint64_t n,len;
     memset(filehash.bytes,0,sizeof(filehash));
-    if ( fread(data,1,rlen,fp) == rlen )
-        vcalc_sha256(0,filehash.bytes,data,rlen);
-    else fprintf(stderr," reading %lld bytes from %s.%llu\n",(long long)rlen,fname,(long long)offset0);
-    free(data);
+    fflush(fp);
+#ifndef _WIN32
+    if ( rlen > 0 )
+    {
+        uint64_t pagestart = offset0 & ~((uint64_t)sysconf(_SC_PAGESIZE) - 1); void *map;
+        if ( (map= mmap(0,rlen + (offset0 - pagestart),PROT_READ,MAP_SHARED,fileno(fp),pagestart)) != MAP_FAILED )
+        {
+            madvise(map,rlen + (offset0 - pagestart),MADV_SEQUENTIAL);
+            hasher.Write((uint8_t *)map + (offset0 - pagestart),rlen);
+            munmap(map,rlen + (offset0 - pagestart));
+            hasher.Finalize(filehash.bytes);
+            return(filehash);
+        }
+    }
+#endif
+    fseek(fp,offset0,SEEK_SET);
+    for (n=0; n<rlen; n+=len)
+    {
+        len = (rlen - n) < sizeof(buf) ? (rlen - n) : sizeof(buf);
+        if ( fread(buf,1,len,fp) != len )
+        {
+            fprintf(stderr," reading %lld bytes from %s.%llu\n",(long long)rlen,fname,(long long)offset0);
+            memset(filehash.bytes,0,sizeof(filehash));
+            return(filehash);
+        }
+        hasher.Write(buf,len);
+    }
+    hasher.Finalize(filehash.bytes);
     return(filehash);
 }
 
@@ -2331,7 +2628,7 @@ struct DEX_datablob *_komodo_DEX_latestptr(char *tagA,char *tagB,char *pubkeystr
     {
         if ( (index= tips[ind]) != 0 ) // pubkey list should be shortest, on average
         {
-            for (ptr=index->tail; ptr!=0; ptr=ptr->prevs[ind])
+            for (ptr=_komodo_DEX_tail(index); ptr!=0; ptr=_komodo_DEX_prev(ind,ptr))
             {
                 if ( ptr->cancelled == 0 && komodo_DEX_tagsmatch(amountA,amountB,ptr,(uint8_t *)tagA,lenA,(uint8_t *)tagB,lenB,pubkey33,plen) == 0 )
                 {
@@ -2347,8 +2644,6 @@ struct DEX_datablob *_komodo_DEX_latestptr(char *tagA,char *tagB,char *pubkeystr
                     //if ( strcmp(tagA,(char *)"slices") == 0 )
                     //    fprintf(stderr,"slices amountA %llu vs %llu\n",(long long)amountA/COIN,(long long)offset0);
                 }
-                if ( ptr == index->head )
-                    break;
             }
         } else fprintf(stderr,"gettips error.%d\n",errflag);
     }
@@ -2404,21 +2699,22 @@ int32_t komodo_DEX_request(int32_t priority,uint32_t shorthash,uint32_t timestam
     return(_komodo_DEX_locatorsextract(1,shorthash,timestamp % KOMODO_DEX_PURGETIME,priority));
 }
 
-int32_t komodo_DEX_locatorsync(int32_t &needrequest,int32_t &written,FILE *fp,uint64_t locator,long offset,bits256 senderpub,char *tagA)
+int32_t komodo_DEX_locatorsync(int32_t &needrequest,int32_t &written,FILE *fp,boost::mutex &fpmutex,uint64_t locator,long offset,bits256 senderpub,char *tagA)
 {
     uint32_t t,h; struct DEX_datablob *fragptr; int32_t fraglen,errflag=0; uint8_t buf[KOMODO_DEX_FILEBUFSIZE];
     t = locator >> 32;
     h = locator & 0xffffffff;
     {
-        pthread_mutex_lock(&DEX_globalmutex);
+        komodo_DEX_lock();
         fragptr = _komodo_DEXfind(t % KOMODO_DEX_PURGETIME,h);
-        pthread_mutex_unlock(&DEX_globalmutex);
+        komodo_DEX_unlock();
     }
     errflag = 0;
     if ( fragptr != 0 )
     {
         if ( (fraglen= komodo_DEX_decryptbuf(buf,sizeof(buf),fragptr,senderpub,(char *)tagA)) > 0 )
         {
+            boost::unique_lock<boost::mutex> lock(fpmutex);
             fseek(fp,offset,SEEK_SET);
             if ( fwrite(buf,1,fraglen,fp) != fraglen )
             {
@@ -2446,6 +2742,37 @@ int32_t komodo_DEX_locatorsync(int32_t &needrequest,int32_t &written,FILE *fp,ui
     return(-errflag);
 }
 
+// syncs the fragments of locators into fp, only the writes are serialized. A locator already synced by a previous call is 0 and is restored from prevlocators, one that is not synced now becomes 0
+int32_t komodo_DEX_locatorsyncall(int32_t &needrequest,int32_t &written,FILE *fp,uint64_t *locators,uint64_t *prevlocators,int32_t num,bits256 senderpub,char *tagA)
+{
+    boost::mutex fpmutex; boost::thread_group threads; int32_t t,missing = 0,nthreads = std::min((int32_t)boost::thread::hardware_concurrency(),KOMODO_DEX_SYNCTHREADS);
+    if ( nthreads < 1 || num < KOMODO_DEX_STREAMSIZE )
+        nthreads = 1;
+    for (t=0; t<nthreads; t++)
+        threads.create_thread([&,t]() {
+            int32_t i,needed=0,wrote=0,errs=0;
+            for (i=t; i<num; i+=nthreads)
+            {
+                if ( locators[i] == 0 ) // we already had it from previous rpc call
+                {
+                    locators[i] = prevlocators[i];
+                    continue;
+                }
+                if ( komodo_DEX_locatorsync(needed,wrote,fp,fpmutex,locators[i],(long)i*KOMODO_DEX_FILEBUFSIZE,senderpub,tagA) < 0 )
+                {
+                    errs++;
+                    locators[i] = 0;
+                }
+            }
+            boost::unique_lock<boost::mutex> lock(fpmutex);
+            needrequest |= needed;
+            written += wrote;
+            missing += errs;
+        });
+    threads.join_all();
+    return(missing);
+}
+
 UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,uint32_t shorthash,char *publisher,int32_t sliceid)
 {
     static uint64_t locators[KOMODO_DEX_MAXPACKETSIZE/sizeof(uint64_t)+1],zero[4];
@@ -2478,7 +2805,7 @@ UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,u
         sprintf(tagBstr,"locators");
     }
     {
-        pthread_mutex_lock(&DEX_globalmutex);
+        komodo_DEX_lock();
         memset(checkhash.bytes,0,sizeof(checkhash));
         if ( (ptr= _komodo_DEX_latestptr(sliceid == 0 ? (char *)"files" : (char *)"slices",origfname,publisher,offset0)) != 0 )
         {
@@ -2509,7 +2836,7 @@ UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,u
                     break;
             }
         }
-        pthread_mutex_unlock(&DEX_globalmutex);
+        komodo_DEX_unlock();
     }
     if ( ptr == 0 )
     {
@@ -2574,19 +2901,11 @@ UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,u
                 fp = fopen(fullfname,(char *)"wb");
             if ( fp != 0 )
             {
-                for (i=0; i<(int32_t)amountB; i++)
-                {
-                    if ( (locator= locators[i]) == 0 ) // we already had it from previous rpc call
-                    {
-                        locators[i] = prevlocators[i];
-                        continue;
-                    }
-                    if ( komodo_DEX_locatorsync(requestflag,written,fp,locator,i*KOMODO_DEX_FILEBUFSIZE,senderpub,(char *)tagA) < 0 )
-                    {
-                        missing++;
-                        locators[i] = 0;
-                    }
-                }
+#ifndef _WIN32
+                if ( ftruncate(fileno(fp),(off_t)amountA) != 0 ) // sparse until its fragments are written
+                    fprintf(stderr,"couldnt preallocate %s to %llu\n",fullfname,(long long)amountA);
+#endif
+                missing = komodo_DEX_locatorsyncall(requestflag,written,fp,locators,prevlocators,(int32_t)amountB,senderpub,(char *)tagA);
                 fclose(fp), fp = 0;
                 if ( (fp= fopen(fullfname,"rb")) != 0 )
                 {
@@ -3108,7 +3427,7 @@ UniValue komodo_DEX_notarize(char *coin,int32_t prevheight)
     pubkeystr[1] = '1';
     bits256_str(pubkeystr+2,DEX_pubkey);
     {
-        pthread_mutex_lock(&DEX_globalmutex);
+        komodo_DEX_lock();
         if ( (ptr= _komodo_DEX_latestptr(coin,(char *)"notarizations",pubkeystr,0)) != 0 )
         {
             if ( (decoded= komodo_DEX_datablobdecrypt(&senderpub,&allocated,&newlen,ptr,DEX_pubkey,coin)) != 0 && newlen == 40 )
@@ -3129,7 +3448,7 @@ UniValue komodo_DEX_notarize(char *coin,int32_t prevheight)
                     else if ( tips[ind] != 0 )
                     {
                         memset(blkhash.bytes,0,sizeof(blkhash));
-                        for (ptr=tips[ind]->tail; ptr!=0; ptr=ptr->prevs[ind])
+                        for (ptr=_komodo_DEX_tail(tips[ind]); ptr!=0; ptr=_komodo_DEX_prev(ind,ptr))
                         {
                             if ( ptr->cancelled == 0 )
                             {
@@ -3148,8 +3467,6 @@ UniValue komodo_DEX_notarize(char *coin,int32_t prevheight)
                                     n++;
                                 }
                             }
-                            if ( ptr == tips[ind]->head )
-                                break;
                         }
                     }
                     if ( n == 0 )
@@ -3161,20 +3478,90 @@ UniValue komodo_DEX_notarize(char *coin,int32_t prevheight)
                 free(allocated), allocated = 0;
         }
         //fprintf(stderr,"fname.%s auto search %s %s %s shorthash.%08x sliceid.%d\n",fname,origfname,tagBstr,publisher,shorthash,sliceid);
-         pthread_mutex_unlock(&DEX_globalmutex);
+         komodo_DEX_unlock();
     }
     return(result);
 }
 
-void komodo_DEXmsg(CNode *pfrom,std::vector<uint8_t> request) // received a packet during interrupt time
+void *komodo_DEX_ingressloop(void *arg)
+{
+    struct DEX_ingress pkt; uint8_t funcid; int32_t len;
+    while ( 1 )
+    {
+        if ( DEX_ingressring->Pop(pkt) == false )
+        {
+            komodo_DEX_bellwait(&DEX_ingressbell);
+            continue;
+        }
+        memset(pkt.hash.bytes,0,sizeof(pkt.hash));
+        len = (int32_t)pkt.msg.size();
+        funcid = pkt.msg[1];
+        if ( pkt.pfrom->fDisconnect == false )
+        {
+            if ( len > KOMODO_DEX_ROUTESIZE+sizeof(uint32_t) && len < KOMODO_DEX_MAXPACKETSIZE && (funcid == 'Q' || funcid == 'X' || funcid == 'R' || funcid == 'A') )
+            {
+                // the hash is the costly part, a datablob whose txpow or priority is not enough would be rejected anyway
+                komodo_DEXquotehash(pkt.hash,&pkt.msg[0],len);
+                if ( (pkt.hash.ulongs[0] & KOMODO_DEX_TXPOWMASK) != (0x777 & KOMODO_DEX_TXPOWMASK) || komodo_DEX_priority(pkt.hash.ulongs[0],len) < 0 )
+                {
+                    DEX_ingressinvalid++;
+                    pkt.pfrom->Release();
+                    continue;
+                }
+            }
+            if ( DEX_insertring->Push(pkt) != false )
+            {
+                komodo_DEX_bellring(&DEX_insertbell);
+                continue;
+            }
+            DEX_ingressdropped++;
+        }
+        pkt.pfrom->Release();
+    }
+    return(0);
+}
+
+// the only thread inserting network packets, a batch of them per hold of the write lock
+void *komodo_DEX_insertloop(void *arg)
 {
-    int32_t len; std::vector<uint8_t> response; bits256 hash; uint32_t timestamp = (uint32_t)time(NULL);
-    if ( (len= request.size()) > 0 )
+    struct DEX_ingress pkt; int32_t n;
+    while ( 1 )
     {
-        pthread_mutex_lock(&DEX_globalmutex);
-        _komodo_DEXprocess(timestamp,pfrom,&request[0],len);
-        pthread_mutex_unlock(&DEX_globalmutex);
+        if ( DEX_insertring->Pop(pkt) == false )
+        {
+            komodo_DEX_bellwait(&DEX_insertbell);
+            continue;
+        }
+        komodo_DEX_lock();
+        for (n=0; n<KOMODO_DEX_INSERTBATCH; n++)
+        {
+            if ( pkt.pfrom->fDisconnect == false )
+                _komodo_DEXprocess(pkt.recvtime,pkt.pfrom,&pkt.msg[0],(int32_t)pkt.msg.size(),pkt.hash);
+            pkt.pfrom->Release();
+            if ( n+1 < KOMODO_DEX_INSERTBATCH && DEX_insertring->Pop(pkt) == false )
+                break;
+        }
+        komodo_DEX_unlock();
+    }
+    return(0);
+}
+
+void komodo_DEXmsg(CNode *pfrom,std::vector<uint8_t> request) // received a packet during interrupt time
+{
+    struct DEX_ingress pkt;
+    if ( request.size() < 2 )
+        return;
+    pfrom->AddRef();
+    pkt.pfrom = pfrom;
+    pkt.msg.swap(request);
+    pkt.recvtime = (uint32_t)time(NULL);
+    if ( DEX_ingressring->Push(pkt) == false )
+    {
+        DEX_ingressdropped++;
+        pfrom->Release();
+        return;
     }
+    komodo_DEX_bellring(&DEX_ingressbell);
 }
 
 void komodo_DEXpoll(CNode *pto) // from mainloop polling
@@ -3183,7 +3570,7 @@ void komodo_DEXpoll(CNode *pto) // from mainloop polling
     std::vector<uint8_t> packet; uint32_t i,now,numiters,shorthash,len,ptime,modval,peerpos;
     now = (uint32_t)time(NULL);
     ptime = now - KOMODO_DEX_PURGETIME + 6;
-    pthread_mutex_lock(&DEX_globalmutex);
+    komodo_DEX_lock();
     peerpos = _komodo_DEXpeerpos(now,pto->id);
     if ( ptime > purgetime )
     {
@@ -3191,9 +3578,13 @@ void komodo_DEXpoll(CNode *pto) // from mainloop polling
             purgetime = ptime;
         else
         {
+            int64_t purgestart = GetTimeMicros(),purgeusecs;
             for (; purgetime<ptime; purgetime++)
                 _komodo_DEXpurge(purgetime);
-            _komodo_DEX_purgeindices(ptime - 3); // call once at the end
+            purgeusecs = GetTimeMicros() - purgestart;
+            DEX_perf.purgetimes[komodo_DEX_perfbin(purgeusecs)]++;
+            if ( purgeusecs > DEX_perf.maxpurgetime )
+                DEX_perf.maxpurgetime = purgeusecs;
         }
         DEX_Numpending *= 0.999; // decay pending to compensate for hashcollision remnants
     }
@@ -3214,6 +3605,6 @@ void komodo_DEXpoll(CNode *pto) // from mainloop polling
         }
         pto->dexlastping = now;
     }
-    pthread_mutex_unlock(&DEX_globalmutex);
+    komodo_DEX_unlock();
 }
 
@@ -17,6 +17,8 @@
 
 #include <curl/curl.h>
 #include <curl/easy.h>
+#include <deque>
+#include <mutex>
 #include "primitives/nonce.h"
 #include "consensus/params.h"
 #include "script/standard.h"
@@ -915,20 +917,13 @@ int32_t komodo_block2pubkey33(uint8_t *pubkey33,CBlock *block)
     return(0);
 }
 
+bool ReadBlockFromDisk(int32_t height,CBlock& block, const CDiskBlockPos& pos,bool checkPOW);
+
 int32_t komodo_blockload(CBlock& block,CBlockIndex *pindex)
 {
-    block.SetNull();
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pindex->GetBlockPos(),true),SER_DISK,CLIENT_VERSION);
-    if (filein.IsNull())
-        return(-1);
-    // Read block
-    try { filein >> block; }
-    catch (const std::exception& e)
-    {
-        fprintf(stderr,"readblockfromdisk err B\n");
+    // ReadBlockFromDisk also understands compressed blk records
+    if ( !ReadBlockFromDisk(pindex->GetHeight(),block,pindex->GetBlockPos(),false) )
         return(-1);
-    }
     return(0);
 }
 
@@ -1004,14 +999,31 @@ uint32_t komodo_heightstamp(int32_t height)
     }
 }*/
 
+void komodo_index_setsigner(CBlockIndex *pindex,uint8_t *pubkey33)
+{
+    int32_t numnotaries,notaryid;
+    if ( pindex->notaryid != -2 )
+        return;
+    notaryid = komodo_electednotary(&numnotaries,pubkey33,pindex->GetHeight(),pindex->nTime);
+    memcpy(pindex->pubkey33,pubkey33,33);
+    __sync_synchronize(); // pubkey33 must be visible before notaryid marks it valid
+    pindex->notaryid = (notaryid >= 0 ? notaryid : -1);
+}
+
 void komodo_index2pubkey33(uint8_t *pubkey33,CBlockIndex *pindex,int32_t height)
 {
-    int32_t num,i; CBlock block;
+    CBlock block;
     memset(pubkey33,0,33);
     if ( pindex != 0 )
     {
-        if ( komodo_blockload(block,pindex) == 0 )
+        if ( pindex->notaryid != -2 ) // persisted with the block index, see DB_BLOCK_SIGNER
+            memcpy(pubkey33,pindex->pubkey33,33);
+        else if ( komodo_blockload(block,pindex) == 0 )
+        {
             komodo_block2pubkey33(pubkey33,&block);
+            if ( block.vtx.size() > 0 && block.vtx[0].vout.size() > 0 )
+                komodo_index_setsigner(pindex,pubkey33);
+        }
     }
 }
 
@@ -1043,33 +1055,105 @@ void komodo_index2pubkey33(uint8_t *pubkey33,CBlockIndex *pindex,int32_t height)
     return(komodo_electednotary(&numnotaries,pubkey33,height,timestamp));
 }*/
 
+#define KOMODO_MINERWINDOW 128 // power of 2 covering the 66 blocks komodo_eligiblenotary looks back
+
+// signer of a recent chainActive block, maintained by UpdateTip under cs_main
+struct komodo_minerwindow_entry
+{
+    CBlockIndex *pindex; const struct komodo_notaryset *ns;
+    int32_t height,notaryid; uint32_t blocktime; uint8_t pubkey33[33];
+};
+static struct komodo_minerwindow_entry KOMODO_MINERWIN[KOMODO_MINERWINDOW];
+static int32_t KOMODO_MINERWIN_TIP = -1;
+
+void komodo_minerwindow_set(struct komodo_minerwindow_entry *wp,CBlockIndex *pindex)
+{
+    int32_t height = pindex->GetHeight();
+    memset(wp,0,sizeof(*wp));
+    wp->height = -1;
+    komodo_index2pubkey33(wp->pubkey33,pindex,height);
+    if ( pindex->notaryid == -2 ) // block couldnt be loaded, leave it to the slow path
+        return;
+    wp->pindex = pindex;
+    wp->blocktime = pindex->nTime;
+    wp->ns = komodo_notaryset_get(height,0);
+    wp->notaryid = (wp->ns != 0 && wp->pubkey33[0] != 0) ? komodo_notaryset_find(wp->ns,0,0,wp->pubkey33) : -1;
+    wp->height = height;
+}
+
+void komodo_minerwindow_update(CBlockIndex *pindexNew)
+{
+    int32_t i,height; CBlockIndex *pindex; struct komodo_minerwindow_entry *wp;
+    AssertLockHeld(cs_main);
+    if ( pindexNew == 0 )
+    {
+        memset(KOMODO_MINERWIN,0,sizeof(KOMODO_MINERWIN));
+        KOMODO_MINERWIN_TIP = -1;
+        return;
+    }
+    height = pindexNew->GetHeight();
+    KOMODO_MINERWIN_TIP = height;
+    // rolled back or reorged entries at or above the new tip are dropped and refilled as the chain grows again
+    KOMODO_MINERWIN[(height + 1) & (KOMODO_MINERWINDOW-1)].height = -1;
+    wp = &KOMODO_MINERWIN[(height - 1) & (KOMODO_MINERWINDOW-1)];
+    if ( height > 0 && wp->height == height-1 && wp->pindex == pindexNew->pprev )
+    {
+        komodo_minerwindow_set(&KOMODO_MINERWIN[height & (KOMODO_MINERWINDOW-1)],pindexNew);
+        return;
+    }
+    for (i=0; i<KOMODO_MINERWINDOW && height-i >= 0; i++)
+    {
+        wp = &KOMODO_MINERWIN[(height - i) & (KOMODO_MINERWINDOW-1)];
+        if ( (pindex= chainActive[height-i]) != 0 && (wp->height != height-i || wp->pindex != pindex) )
+            komodo_minerwindow_set(wp,pindex);
+    }
+}
+
+struct komodo_minerwindow_entry *komodo_minerwindow_get(int32_t height)
+{
+    struct komodo_minerwindow_entry *wp;
+    AssertLockHeld(cs_main);
+    if ( height < 0 || height > KOMODO_MINERWIN_TIP || height <= KOMODO_MINERWIN_TIP-KOMODO_MINERWINDOW )
+        return(0);
+    wp = &KOMODO_MINERWIN[height & (KOMODO_MINERWINDOW-1)];
+    if ( wp->height != height || wp->pindex != chainActive[height] )
+        return(0);
+    return(wp);
+}
+
 int32_t komodo_eligiblenotary(uint8_t pubkeys[66][33],int32_t *mids,uint32_t blocktimes[66],int32_t *nonzpkeysp,int32_t height)
 {
     // after the season HF block ALL new notaries instantly become elegible. 
-    int32_t i,j,n,duplicate; CBlock block; CBlockIndex *pindex; uint8_t notarypubs33[64][33];
+    int32_t i,j,n,duplicate; CBlockIndex *pindex; uint8_t notarypubs33[64][33]; const struct komodo_notaryset *ns; struct komodo_minerwindow_entry *wp;
     memset(mids,-1,sizeof(*mids)*66);
-    n = komodo_notaries(notarypubs33,height,0);
+    if ( (ns= komodo_notaryset_get(height,0)) != 0 )
+        n = ns->numnotaries;
+    else n = komodo_notaries(notarypubs33,height,0);
     for (i=duplicate=0; i<66; i++)
     {
-        if ( (pindex= komodo_chainactive(height-i)) != 0 )
+        if ( (wp= komodo_minerwindow_get(height-i)) != 0 )
+        {
+            blocktimes[i] = wp->blocktime;
+            memcpy(pubkeys[i],wp->pubkey33,33);
+            if ( ns != 0 && wp->ns == ns )
+                j = wp->notaryid;
+            else j = (pubkeys[i][0] != 0) ? komodo_notaryset_find(ns,notarypubs33,n,pubkeys[i]) : -1;
+        }
+        else if ( (pindex= komodo_chainactive(height-i)) != 0 )
         {
             blocktimes[i] = pindex->nTime;
-            if ( komodo_blockload(block,pindex) == 0 )
-            {
-                komodo_block2pubkey33(pubkeys[i],&block);
-                for (j=0; j<n; j++)
-                {
-                    if ( memcmp(notarypubs33[j],pubkeys[i],33) == 0 )
-                    {
-                        mids[i] = j;
-                        (*nonzpkeysp)++;
-                        break;
-                    }
-                }
-            } else fprintf(stderr,"couldnt load block.%d\n",height);
-            if ( mids[0] >= 0 && i > 0 && mids[i] == mids[0] )
-                duplicate++;
+            komodo_index2pubkey33(pubkeys[i],pindex,height-i);
+            if ( pubkeys[i][0] == 0 && pindex->notaryid == -2 )
+                fprintf(stderr,"couldnt load block.%d\n",height);
+            j = (pubkeys[i][0] != 0) ? komodo_notaryset_find(ns,notarypubs33,n,pubkeys[i]) : -1;
+        } else continue;
+        if ( j >= 0 )
+        {
+            mids[i] = j;
+            (*nonzpkeysp)++;
         }
+        if ( mids[0] >= 0 && i > 0 && mids[i] == mids[0] )
+            duplicate++;
     }
     if ( i == 66 && duplicate == 0 && (height > 186233 || *nonzpkeysp > 0) )
         return(1);
@@ -1078,27 +1162,29 @@ int32_t komodo_eligiblenotary(uint8_t pubkeys[66][33],int32_t *mids,uint32_t blo
 
 int32_t komodo_minerids(uint8_t *minerids,int32_t height,int32_t width)
 {
-    int32_t i,j,nonz,numnotaries; CBlock block; CBlockIndex *pindex; uint8_t notarypubs33[64][33],pubkey33[33];
-    numnotaries = komodo_notaries(notarypubs33,height,0);
+    int32_t i,j,nonz,numnotaries; CBlockIndex *pindex; uint8_t notarypubs33[64][33],pubkey33[33]; const struct komodo_notaryset *ns; struct komodo_minerwindow_entry *wp;
+    if ( (ns= komodo_notaryset_get(height,0)) != 0 )
+        numnotaries = ns->numnotaries;
+    else numnotaries = komodo_notaries(notarypubs33,height,0);
     for (i=nonz=0; i<width; i++)
     {
         if ( height-i <= 0 )
             continue;
-        if ( (pindex= komodo_chainactive(height-width+i+1)) != 0 )
+        if ( (wp= komodo_minerwindow_get(height-width+i+1)) != 0 )
         {
-            if ( komodo_blockload(block,pindex) == 0 )
+            if ( ns != 0 && wp->ns == ns )
+                j = wp->notaryid;
+            else j = komodo_notaryset_find(ns,notarypubs33,numnotaries,wp->pubkey33);
+            minerids[nonz++] = (j >= 0 ? j : numnotaries);
+        }
+        else if ( (pindex= komodo_chainactive(height-width+i+1)) != 0 )
+        {
+            komodo_index2pubkey33(pubkey33,pindex,height-width+i+1);
+            if ( pubkey33[0] != 0 || pindex->notaryid != -2 )
             {
-                komodo_block2pubkey33(pubkey33,&block);
-                for (j=0; j<numnotaries; j++)
-                {
-                    if ( memcmp(notarypubs33[j],pubkey33,33) == 0 )
-                    {
-                        minerids[nonz++] = j;
-                        break;
-                    }
-                }
-                if ( j == numnotaries )
-                    minerids[nonz++] = j;
+                if ( (j= komodo_notaryset_find(ns,notarypubs33,numnotaries,pubkey33)) < 0 )
+                    j = numnotaries;
+                minerids[nonz++] = j;
             } else fprintf(stderr,"couldnt load block.%d\n",height);
         }
     }
@@ -1238,12 +1324,37 @@ int32_t komodo_checkpoint(int32_t *notarized_heightp,int32_t nHeight,uint256 has
     return(0);
 }
 
+/**
+ * What komodo_interest_args needs of a confirmed output, memoized per outpoint so the
+ * source tx isn't read again for every input and every wallet utxo. An entry is only
+ * used while its block is in the active chain. Guarded by cs_main.
+ */
+struct komodo_interestargs { CBlockIndex *pindex; uint64_t value; uint32_t locktime; };
+#define KOMODO_INTERESTMEMO_MAX 100000
+static std::map<COutPoint,struct komodo_interestargs> komodo_interestmemo;
+
 uint32_t komodo_interest_args(uint32_t *txheighttimep,int32_t *txheightp,uint32_t *tiptimep,uint64_t *valuep,uint256 hash,int32_t n)
 {
     LOCK(cs_main);
     CTransaction tx; uint256 hashBlock; CBlockIndex *pindex,*tipindex;
     *txheighttimep = *txheightp = *tiptimep = 0;
     *valuep = 0;
+    COutPoint outpoint(hash,n);
+    std::map<COutPoint,struct komodo_interestargs>::iterator it = komodo_interestmemo.find(outpoint);
+    if ( it != komodo_interestmemo.end() )
+    {
+        if ( chainActive.Contains(it->second.pindex) != 0 )
+        {
+            pindex = it->second.pindex;
+            *valuep = it->second.value;
+            *txheightp = pindex->GetHeight();
+            *txheighttimep = pindex->nTime;
+            if ( *tiptimep == 0 && (tipindex= chainActive.LastTip()) != 0 )
+                *tiptimep = (uint32_t)tipindex->nTime;
+            return(it->second.locktime);
+        }
+        komodo_interestmemo.erase(it);
+    }
     if ( !GetTransaction(hash,tx,hashBlock,true) )
         return(0);
     uint32_t locktime = 0;
@@ -1257,6 +1368,15 @@ uint32_t komodo_interest_args(uint32_t *txheighttimep,int32_t *txheightp,uint32_
             if ( *tiptimep == 0 && (tipindex= chainActive.LastTip()) != 0 )
                 *tiptimep = (uint32_t)tipindex->nTime;
             locktime = tx.nLockTime;
+            if ( chainActive.Contains(pindex) != 0 )
+            {
+                if ( komodo_interestmemo.size() >= KOMODO_INTERESTMEMO_MAX )
+                    komodo_interestmemo.clear();
+                struct komodo_interestargs &args = komodo_interestmemo[outpoint];
+                args.pindex = pindex;
+                args.value = *valuep;
+                args.locktime = locktime;
+            }
             //fprintf(stderr,"tx locktime.%u %.8f height.%d | tiptime.%u\n",locktime,(double)*valuep/COIN,*txheightp,*tiptimep);
         }
     }
@@ -1281,6 +1401,28 @@ uint64_t komodo_accrued_interest(int32_t *txheightp,uint32_t *locktimep,uint256
     return(0);
 }
 
+uint64_t komodo_accrued_interests(std::vector<struct komodo_interestutxo> &utxos,int32_t tipheight)
+{
+    uint64_t value,sum = 0; uint32_t tiptime=0,txheighttime; CBlockIndex *pindex; int32_t i;
+    AssertLockHeld(cs_main);
+
+    if ( (pindex= chainActive[tipheight]) != 0 )
+        tiptime = (uint32_t)pindex->nTime;
+    else fprintf(stderr,"cant find height[%d]\n",tipheight);
+    for (i=0; i<utxos.size(); i++)
+    {
+        struct komodo_interestutxo &utxo = utxos[i];
+        utxo.interest = 0;
+        if ( (utxo.locktime= komodo_interest_args(&txheighttime,&utxo.txheight,&tiptime,&value,utxo.txid,utxo.vout)) != 0 )
+        {
+            if ( utxo.value == 0 || value == utxo.value )
+                sum += (utxo.interest= komodo_interest(utxo.txheight,value,utxo.locktime,tiptime));
+            else fprintf(stderr,"komodo_accrued_interests value mismatch %llu vs %llu\n",(long long)value,(long long)utxo.value);
+        }
+    }
+    return(sum);
+}
+
 int32_t komodo_nextheight()
 {
     CBlockIndex* pindex;
@@ -1442,9 +1584,37 @@ uint32_t komodo_segid32(char *coinaddr)
     return(addrhash.uints[0]);
 }
 
+// the staking segid of a block: its staking address segid for a PoS block, -1 for a PoW block
+int8_t komodo_blocksegid(const CBlock &block,CBlockIndex *pindex)
+{
+    CTxDestination voutaddress; uint64_t value; uint32_t txtime; char voutaddr[64],destaddr[64]; int32_t height,txn_count,vout,newStakerActive; uint256 txid,merkleroot; CScript opret; int8_t segid = -1;
+
+    height = pindex->GetHeight();
+    newStakerActive = komodo_newStakerActive(height, block.nTime);
+    txn_count = block.vtx.size();
+    if ( txn_count > 1 && block.vtx[txn_count-1].vin.size() == 1 && block.vtx[txn_count-1].vout.size() == 1+komodo_hasOpRet(height,pindex->nTime) )
+    {
+        txid = block.vtx[txn_count-1].vin[0].prevout.hash;
+        vout = block.vtx[txn_count-1].vin[0].prevout.n;
+        txtime = komodo_txtime(opret,&value,txid,vout,destaddr);
+        if ( ExtractDestination(block.vtx[txn_count-1].vout[0].scriptPubKey,voutaddress) )
+        {
+            strcpy(voutaddr,CBitcoinAddress(voutaddress).ToString().c_str());
+            if ( newStakerActive == 1 && block.vtx[txn_count-1].vout.size() == 2 && DecodeStakingOpRet(block.vtx[txn_count-1].vout[1].scriptPubKey, merkleroot) != 0 )
+                newStakerActive++;
+            if ( newStakerActive == 2 || (newStakerActive == 0 && strcmp(destaddr,voutaddr) == 0 && block.vtx[txn_count-1].vout[0].nValue == value) )
+            {
+                segid = komodo_segid32(voutaddr) & 0x3f;
+                LOGSTREAMFN(LOG_KOMODOBITCOIND, CCLOG_DEBUG1, stream << "set calculated segid, height." << height << " -> " << (int)segid << std::endl);
+            }
+        } //else fprintf(stderr,"komodo_segid ht.%d couldnt extract voutaddress\n",height);
+    }
+    return(segid);
+}
+
 int8_t komodo_segid(int32_t nocache,int32_t height)
 {
-    CTxDestination voutaddress; CBlock block; CBlockIndex *pindex; uint64_t value; uint32_t txtime; char voutaddr[64],destaddr[64]; int32_t txn_count,vout,newStakerActive; uint256 txid,merkleroot; CScript opret; int8_t segid = -1;
+    CBlock block; CBlockIndex *pindex; int8_t segid = -1;
     
     if ( height > 0 && (pindex= komodo_chainactive(height)) != 0 )
     {
@@ -1453,30 +1623,10 @@ int8_t komodo_segid(int32_t nocache,int32_t height)
             return(pindex->segid);
         }
         if ( komodo_blockload(block,pindex) == 0 )
-        {
-            newStakerActive = komodo_newStakerActive(height, block.nTime);
-            txn_count = block.vtx.size();
-            if ( txn_count > 1 && block.vtx[txn_count-1].vin.size() == 1 && block.vtx[txn_count-1].vout.size() == 1+komodo_hasOpRet(height,pindex->nTime) )
-            {
-                txid = block.vtx[txn_count-1].vin[0].prevout.hash;
-                vout = block.vtx[txn_count-1].vin[0].prevout.n;
-                txtime = komodo_txtime(opret,&value,txid,vout,destaddr);
-                if ( ExtractDestination(block.vtx[txn_count-1].vout[0].scriptPubKey,voutaddress) )
-                {
-                    strcpy(voutaddr,CBitcoinAddress(voutaddress).ToString().c_str());
-                    if ( newStakerActive == 1 && block.vtx[txn_count-1].vout.size() == 2 && DecodeStakingOpRet(block.vtx[txn_count-1].vout[1].scriptPubKey, merkleroot) != 0 )
-                        newStakerActive++;
-                    if ( newStakerActive == 2 || (newStakerActive == 0 && strcmp(destaddr,voutaddr) == 0 && block.vtx[txn_count-1].vout[0].nValue == value) )
-                    {
-                        segid = komodo_segid32(voutaddr) & 0x3f;
-                        //fprintf(stderr, "komodo_segid: ht.%i --> %i\n",height,pindex->segid);
-                        LOGSTREAMFN(LOG_KOMODOBITCOIND, CCLOG_DEBUG1, stream << "set calculated segid, height." << height << " -> " << (int)pindex->segid << std::endl);  // uncommented
-                    }
-                } //else fprintf(stderr,"komodo_segid ht.%d couldnt extract voutaddress\n",height);
-            }
-        }
+            segid = komodo_blocksegid(block,pindex);
         // The new staker sets segid in komodo_checkPOW, this persists after restart by being saved in the blockindex for blocks past the HF timestamp, to keep backwards compatibility.
         // PoW blocks cannot contain a staking tx. If segid has not yet been set, we can set it here accurately.
+        // Earlier blocks get it set in ConnectBlock and persisted in the DB_BLOCK_SEGID side record.
         if ( pindex->segid == -2 ) 
             pindex->segid = segid;
     }
@@ -1490,27 +1640,49 @@ int8_t komodo_segid(int32_t nocache,int32_t height)
     return(segid);
 }
 
+// the last few segid windows read by the staker and the validation of its blocks, keyed by the hash of
+// the window's last block so a reorg inside the window is never served from the cache
+struct komodo_segidswindow
+{
+    uint256 lasthash;
+    int32_t height;
+    uint8_t segids[100];
+};
+#define KOMODO_SEGIDS_WINDOWS 4
+
 void komodo_segids(uint8_t *hashbuf,int32_t height,int32_t n)
 {
-    static uint8_t prevhashbuf[100]; static int32_t prevheight;
-    int32_t i;
-    if ( height == prevheight && n == 100 )
-        memcpy(hashbuf,prevhashbuf,100);
-    else
+    static CCriticalSection cs_segids; static komodo_segidswindow windows[KOMODO_SEGIDS_WINDOWS]; static int32_t nextwindow;
+    CBlockIndex *pindex; uint256 lasthash; int32_t i;
+    if ( n == 100 && (pindex= komodo_chainactive(height+n-1)) != 0 )
     {
-        memset(hashbuf,0xff,n);
-        for (i=0; i<n; i++)
-        {
-            hashbuf[i] = (uint8_t)komodo_segid(0,height+i);
-            //fprintf(stderr,"%02x ",hashbuf[i]);
-        }
-        if ( n == 100 )
+        lasthash = pindex->GetBlockHash();
+        LOCK(cs_segids);
+        for (i=0; i<KOMODO_SEGIDS_WINDOWS; i++)
         {
-            memcpy(prevhashbuf,hashbuf,100);
-            prevheight = height;
-            //fprintf(stderr,"prevsegids.%d\n",height+n);
+            if ( windows[i].height == height && windows[i].lasthash == lasthash )
+            {
+                memcpy(hashbuf,windows[i].segids,100);
+                return;
+            }
         }
     }
+    memset(hashbuf,0xff,n);
+    for (i=0; i<n; i++)
+    {
+        hashbuf[i] = (uint8_t)komodo_segid(0,height+i);
+        //fprintf(stderr,"%02x ",hashbuf[i]);
+    }
+    if ( !lasthash.IsNull() )
+    {
+        LOCK(cs_segids);
+        komodo_segidswindow &window = windows[nextwindow];
+        nextwindow = (nextwindow + 1) % KOMODO_SEGIDS_WINDOWS;
+        memcpy(window.segids,hashbuf,100);
+        window.height = height;
+        window.lasthash = lasthash;
+        //fprintf(stderr,"prevsegids.%d\n",height+n);
+    }
 }
 
 uint32_t komodo_stakehash(uint256 *hashp,char *address,uint8_t *hashbuf,uint256 txid,int32_t vout)
@@ -2151,13 +2323,51 @@ bool GetNotarisationNotaries(uint8_t notarypubkeys[64][33], int8_t &numNN, const
     return true;
 }
 
+// the notaries of the recent notarisation txns by txid and notary set, so the validations of a notarisation block (TestBlockValidity of the template, then its connect) do not load the vin txns again
+#define KOMODO_NOTARISATIONNOTARIES_CACHESIZE 64
+static std::map<uint256, std::vector<int8_t> > NotarisationNotariesCache;
+static std::deque<uint256> NotarisationNotariesOrder;
+static std::mutex notarisationnotariesmutex;
+
+bool komodo_notarisationnotaries(const CTransaction &tx, uint8_t notarypubkeys[64][33], int8_t &numNN, std::vector<int8_t> &NotarisationNotaries)
+{
+    uint256 txid = tx.GetHash(), key;
+    if ( notarypubkeys[0][0] == 0 || numNN <= 0 )
+        return GetNotarisationNotaries(notarypubkeys, numNN, tx.vin, NotarisationNotaries);
+    key = Hash(txid.begin(), txid.end(), &notarypubkeys[0][0], &notarypubkeys[0][0] + numNN * 33);
+    {
+        std::lock_guard<std::mutex> lock(notarisationnotariesmutex);
+        std::map<uint256, std::vector<int8_t> >::const_iterator it = NotarisationNotariesCache.find(key);
+        if ( it != NotarisationNotariesCache.end() )
+        {
+            NotarisationNotaries.insert(NotarisationNotaries.end(), it->second.begin(), it->second.end());
+            return true;
+        }
+    }
+    std::vector<int8_t> notaries;
+    if ( !GetNotarisationNotaries(notarypubkeys, numNN, tx.vin, notaries) )
+        return false; // a vin tx could not be loaded, not kept as it may be found later
+    std::lock_guard<std::mutex> lock(notarisationnotariesmutex);
+    if ( NotarisationNotariesCache.insert(std::make_pair(key, notaries)).second )
+    {
+        NotarisationNotariesOrder.push_back(key);
+        if ( NotarisationNotariesOrder.size() > KOMODO_NOTARISATIONNOTARIES_CACHESIZE )
+        {
+            NotarisationNotariesCache.erase(NotarisationNotariesOrder.front());
+            NotarisationNotariesOrder.pop_front();
+        }
+    }
+    NotarisationNotaries.insert(NotarisationNotaries.end(), notaries.begin(), notaries.end());
+    return true;
+}
+
 uint64_t komodo_checknotarypay(CBlock *pblock,int32_t height)
 {
     std::vector<int8_t> NotarisationNotaries; uint8_t *script; int32_t scriptlen;
     uint64_t timestamp = pblock->nTime;
     int8_t numSN = 0; uint8_t notarypubkeys[64][33] = {0};
     numSN = komodo_notaries(notarypubkeys, height, timestamp);
-    if ( !GetNotarisationNotaries(notarypubkeys, numSN, pblock->vtx[1].vin, NotarisationNotaries) )
+    if ( !komodo_notarisationnotaries(pblock->vtx[1], notarypubkeys, numSN, NotarisationNotaries) )
         return(0);
     
     // check a notary didnt sign twice (this would be an invalid notarisation later on and cause problems)
@@ -2411,15 +2621,8 @@ int32_t komodo_checkPOW(int64_t stakeTxValue, int32_t slowflag,CBlock *pblock,in
         failed = 1;
         if ( height > 0 && ASSETCHAINS_SYMBOL[0] == 0 ) // for the fast case
         {
-            if ( (n= komodo_notaries(pubkeys,height,pblock->nTime)) > 0 )
-            {
-                for (i=0; i<n; i++)
-                    if ( memcmp(pubkey33,pubkeys[i],33) == 0 )
-                    {
-                        notaryid = i;
-                        break;
-                    }
-            }
+            if ( (i= komodo_electednotary(&n,pubkey33,height,pblock->nTime)) >= 0 )
+                notaryid = i;
         }
         else if ( possible == 0 || ASSETCHAINS_SYMBOL[0] != 0 )
         {
@@ -2649,39 +2852,66 @@ int64_t komodo_newcoins(int64_t *zfundsp,int64_t *sproutfundsp,int32_t nHeight,C
     return(voutsum - vinsum);
 }
 
+/**
+ * The sums of komodo_newcoins up to height. Every block index keeps the sums
+ * of its chain once they are known, so only the blocks after the last one
+ * with known sums are added up, and only the ones whose komodo_newcoins was
+ * never computed are read. Those results are persisted with the block index.
+ */
 int64_t komodo_coinsupply(int64_t *zfundsp,int64_t *sproutfundsp,int32_t height)
 {
-    CBlockIndex *pindex; CBlock block; int64_t zfunds=0,sproutfunds=0,supply = 0;
-    //fprintf(stderr,"coinsupply %d\n",height);
+    CBlockIndex *pindex; CBlock block; std::vector<CBlockIndex*> vMissing,vRead;
     *zfundsp = *sproutfundsp = 0;
-    if ( (pindex= komodo_chainactive(height)) != 0 )
     {
-        while ( pindex != 0 && pindex->GetHeight() > 0 )
+        LOCK(cs_main);
+        if ( (pindex= komodo_chainactive(height)) == 0 )
+            return(0);
+        for (CBlockIndex *p = pindex; p != 0 && p->GetHeight() > 0 && !p->fHaveChainSupply; p = p->pprev)
         {
-            if ( pindex->newcoins == 0 && pindex->zfunds == 0 )
-            {
-                if ( komodo_blockload(block,pindex) == 0 )
-                    pindex->newcoins = komodo_newcoins(&pindex->zfunds,&pindex->sproutfunds,pindex->GetHeight(),&block);
-                else
-                {
-                    LOGSTREAMFN(LOG_KOMODOBITCOIND, CCLOG_ERROR, stream << "error loading block ht=" << pindex->GetHeight() << std::endl);
-                    return(0);
-                }
-            }
-            supply += pindex->newcoins;
-            zfunds += pindex->zfunds;
-            sproutfunds += pindex->sproutfunds;
-            //printf("start ht.%d new %.8f -> supply %.8f zfunds %.8f -> %.8f\n",pindex->GetHeight(),dstr(pindex->newcoins),dstr(supply),dstr(pindex->zfunds),dstr(zfunds));
-            pindex = pindex->pprev;
+            vMissing.push_back(p);
+            if ( !p->fHaveNewcoins )
+                vRead.push_back(p);
         }
     }
-    *zfundsp = zfunds;
-    *sproutfundsp = sproutfunds;
-    return(supply);
+    // the blocks and their inputs are read without cs_main
+    std::vector<int64_t> vNewcoins(vRead.size()),vZfunds(vRead.size()),vSproutfunds(vRead.size());
+    for (size_t i = 0; i < vRead.size(); i++)
+    {
+        if ( komodo_blockload(block,vRead[i]) != 0 )
+        {
+            LOGSTREAMFN(LOG_KOMODOBITCOIND, CCLOG_ERROR, stream << "error loading block ht=" << vRead[i]->GetHeight() << std::endl);
+            return(0);
+        }
+        vNewcoins[i] = komodo_newcoins(&vZfunds[i],&vSproutfunds[i],vRead[i]->GetHeight(),&block);
+    }
+
+    LOCK(cs_main);
+    for (size_t i = 0; i < vRead.size(); i++)
+    {
+        vRead[i]->newcoins = vNewcoins[i];
+        vRead[i]->zfunds = vZfunds[i];
+        vRead[i]->sproutfunds = vSproutfunds[i];
+        vRead[i]->fHaveNewcoins = true;
+        setDirtyBlockIndex.insert(vRead[i]);
+    }
+    for (std::vector<CBlockIndex*>::reverse_iterator it = vMissing.rbegin(); it != vMissing.rend(); ++it)
+    {
+        CBlockIndex *p = *it, *pprev = p->pprev;
+        bool fHavePrev = pprev != 0 && pprev->GetHeight() > 0;
+        p->nChainNewcoins = (fHavePrev ? pprev->nChainNewcoins : 0) + p->newcoins;
+        p->nChainZfunds = (fHavePrev ? pprev->nChainZfunds : 0) + p->zfunds;
+        p->nChainSproutfunds = (fHavePrev ? pprev->nChainSproutfunds : 0) + p->sproutfunds;
+        p->fHaveChainSupply = true;
+    }
+    if ( pindex->GetHeight() <= 0 )
+        return(0);
+    *zfundsp = pindex->nChainZfunds;
+    *sproutfundsp = pindex->nChainSproutfunds;
+    return(pindex->nChainNewcoins);
 }
 
 
-void komodo_addutxo(std::vector<struct komodo_staking> &array, int32_t *numkp, int32_t *maxkp, uint32_t txtime, uint64_t nValue, uint256 txid, int32_t vout, char *address, uint8_t *hashbuf, CScript pk)
+void komodo_addutxo(std::vector<struct komodo_staking> &array, int32_t *numkp, int32_t *maxkp, uint32_t txtime, uint64_t nValue, uint64_t stakevalue, uint256 txid, int32_t vout, char *address, uint8_t *hashbuf, int32_t hashheight, CScript pk)
 {
     uint256 hash; uint32_t segid32; struct komodo_staking *kp;
 
@@ -2709,9 +2939,125 @@ void komodo_addutxo(std::vector<struct komodo_staking> &array, int32_t *numkp, i
     kp->txtime = txtime;
     kp->segid32 = segid32;
     kp->nValue = nValue;
+    kp->stakevalue = stakevalue;
+    kp->hashheight = hashheight;
     kp->scriptPubKey = pk; 
 }
 
+// adds the stakeable outputs of a wallet tx confirmed at txtime, as AvailableCoins would list them
+static void komodo_addwalletutxos(std::vector<struct komodo_staking> &array, int32_t *numkp, int32_t *maxkp, const CWalletTx &wtx, uint32_t txtime, uint8_t *hashbuf, int32_t hashheight)
+{
+    CTxDestination address; CTransaction tx(wtx);
+    for (int32_t i=0; i<tx.vout.size(); i++)
+    {
+        const CScript &pk = tx.vout[i].scriptPubKey;
+        if ( tx.vout[i].nValue < COIN || (pwalletMain->IsMine(tx.vout[i]) & ISMINE_SPENDABLE) == 0 )
+            continue;
+        if ( ExtractDestination(pk,address) == 0 || IsMine(*pwalletMain,address) == 0 )
+            continue;
+        komodo_addutxo(array,numkp,maxkp,txtime,(uint64_t)tx.vout[i].nValue,(uint64_t)tx.vout[i].nValue * GetStakeMultiplier(tx,i),tx.GetHash(),i,(char *)CBitcoinAddress(address).ToString().c_str(),hashbuf,hashheight,pk);
+    }
+}
+
+/**
+ * Brings the staking utxos from the block after *lastheightp up to the tip: the
+ * utxos the blocks spend are dropped and the wallet outputs they confirm are added.
+ * Returns false if the array has to be rebuilt from the wallet (a reorg or too many blocks).
+ */
+static bool komodo_updatestakeutxos(std::vector<struct komodo_staking> &array, int32_t *numkp, int32_t *maxkp, int32_t *lastheightp, uint256 *lasthashp, uint8_t *hashbuf, int32_t hashheight)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(pwalletMain->cs_wallet);
+    CBlockIndex *pindex = chainActive[*lastheightp];
+    if ( pindex == 0 || pindex->GetBlockHash() != *lasthashp || chainActive.Height() - *lastheightp > KOMODO_STAKER_MAXUPDATE )
+        return(false);
+    std::set<COutPoint> spent;
+    for (int32_t ht=*lastheightp+1; ht<=chainActive.Height(); ht++)
+    {
+        CBlock block;
+        pindex = chainActive[ht];
+        if ( ReadBlockFromDisk(block, pindex, 1) == 0 )
+            return(false);
+        BOOST_FOREACH(const CTransaction &tx, block.vtx)
+        {
+            BOOST_FOREACH(const CTxIn &txin, tx.vin)
+                spent.insert(txin.prevout);
+            // coinbase outputs are immature, the periodic rebuild adds them
+            const CWalletTx *wtx = pwalletMain->GetWalletTx(tx.GetHash());
+            if ( wtx != 0 && !tx.IsCoinBase() )
+                komodo_addwalletutxos(array,numkp,maxkp,*wtx,pindex->nTime,hashbuf,hashheight);
+        }
+    }
+    if ( !spent.empty() )
+    {
+        int32_t j = 0;
+        for (int32_t i=0; i<*numkp; i++)
+            if ( spent.count(COutPoint(array[i].txid,array[i].vout)) == 0 )
+            {
+                if ( j != i )
+                    array[j] = array[i];
+                j++;
+            }
+        *numkp = j;
+    }
+    *lastheightp = chainActive.Height();
+    *lasthashp = chainActive.Tip()->GetBlockHash();
+    return(true);
+}
+
+// komodo_stake(0,...) for a staking utxo, with its tx time, stake value and stake hash at nHeight taken from kp instead of being looked up
+static uint32_t komodo_stakeeligible(const struct komodo_staking *kp, arith_uint256 bnTarget, const arith_uint256 &ratio, int32_t nHeight, int32_t minage, uint32_t blocktime, uint32_t prevtime)
+{
+    arith_uint256 hashval,coinage256; int32_t segid,iter; int64_t diff=0; uint32_t txtime = kp->txtime; uint64_t value = kp->stakevalue,coinage;
+    if ( blocktime < prevtime+3 )
+        blocktime = prevtime+3;
+    if ( blocktime < GetTime()-60 )
+        blocktime = GetTime()+30;
+    if ( value == 0 || txtime == 0 || blocktime == 0 || prevtime == 0 || value < SATOSHIDEN )
+        return(0);
+    value /= SATOSHIDEN;
+    segid = ((nHeight + kp->segid32) & 0x3f);
+    for (iter=0; iter<600; iter++)
+    {
+        if ( blocktime+iter+segid*2 < txtime+minage )
+            continue;
+        diff = (iter + blocktime - txtime - minage);
+        if ( diff < 0 )
+            diff = 60;
+        else if ( diff > 3600*24*30 )
+            diff = 3600*24*30;
+        if ( iter > 0 )
+            diff += segid*2;
+        coinage = (value * diff);
+        if ( blocktime+iter+segid*2 > prevtime+480 )
+            coinage *= ((blocktime+iter+segid*2) - (prevtime+400));
+        coinage256 = arith_uint256(coinage+1);
+        hashval = ratio * (kp->hashval / coinage256);
+        if ( hashval <= bnTarget )
+            return(blocktime + iter + segid*2);
+    }
+    if ( nHeight < 10 )
+        return(blocktime);
+    return(0);
+}
+
+// staking candidates by eligible time, then by the smaller value, as a min heap
+struct komodo_stakecandidate
+{
+    uint32_t eligible;
+    uint64_t nValue;
+    int32_t index;
+
+    bool operator<(const komodo_stakecandidate &other) const
+    {
+        if ( eligible != other.eligible )
+            return(eligible > other.eligible);
+        if ( nValue != other.nValue )
+            return(nValue > other.nValue);
+        return(index > other.index);
+    }
+};
+
 int32_t komodo_staked(CMutableTransaction &txNew,uint32_t nBits,uint32_t *blocktimep,uint32_t *txtimep,uint256 *utxotxidp,int32_t *utxovoutp,uint64_t *utxovaluep,uint8_t *utxosig, uint256 merkleroot)
 {
     // this malloc/free array did not free c++ objects like scriptPubKey as its destructor never called (memleak), 
@@ -2721,6 +3067,8 @@ int32_t komodo_staked(CMutableTransaction &txNew,uint32_t nBits,uint32_t *blockt
     thread_local std::vector<struct komodo_staking> array; 
     thread_local int32_t numkp = 0, maxkp = 0; 
     thread_local uint32_t lasttime = 0L;
+    thread_local int32_t lastheight = 0;
+    thread_local uint256 lasthash;
 
     int32_t PoSperc = 0, newStakerActive; 
     set<CBitcoinAddress> setAddress; struct komodo_staking *kp; int32_t winners,segid,minage,nHeight,counter=0,i,m,siglen=0,nMinDepth = 1,nMaxDepth = 99999999; vector<COutput> vecOutputs; uint32_t block_from_future_rejecttime,besttime,eligible,earliest = 0; CScript best_scriptPubKey; arith_uint256 mindiff,ratio,bnTarget,tmpTarget; CBlockIndex *tipindex,*pindex; CTxDestination address; bool fNegative,fOverflow; uint8_t hashbuf[256]; CTransaction tx; uint256 hashBlock;
@@ -2749,15 +3097,13 @@ int32_t komodo_staked(CMutableTransaction &txNew,uint32_t nBits,uint32_t *blockt
     bool resetstaker = false;
     if ( array.size() != 0 )
     {
-        LOCK(cs_main);
-        CBlockIndex* pblockindex = chainActive[tipindex->GetHeight()];
-        CBlock block; CTxDestination addressout;
+        LOCK2(cs_main, pwalletMain->cs_wallet);
         if (needSpecialStakeUtxo)
             resetstaker = true;
-        else if ( ReadBlockFromDisk(block, pblockindex, 1) && komodo_isPoS(&block, nHeight, &addressout) != 0 && IsMine(*pwalletMain,addressout) != 0 )
+        else if ( !komodo_updatestakeutxos(array,&numkp,&maxkp,&lastheight,&lasthash,hashbuf,nHeight) )
         {
               resetstaker = true;
-              fprintf(stderr, "[%s:%d] Reset ram staker after mining a block!\n",ASSETCHAINS_SYMBOL,nHeight);
+              fprintf(stderr, "[%s:%d] Reset ram staker after a reorg!\n",ASSETCHAINS_SYMBOL,nHeight);
         }
     }
 
@@ -2797,7 +3143,7 @@ int32_t komodo_staked(CMutableTransaction &txNew,uint32_t nBits,uint32_t *blockt
                         continue;
                     if ( myGetTransaction(out.tx->GetHash(),tx,hashBlock) != 0 && (pindex= komodo_getblockindex(hashBlock)) != 0 )
                     {
-                        komodo_addutxo(array,&numkp,&maxkp,(uint32_t)pindex->nTime,(uint64_t)nValue,out.tx->GetHash(),out.i,(char *)CBitcoinAddress(address).ToString().c_str(),hashbuf,(CScript)pk);
+                        komodo_addutxo(array,&numkp,&maxkp,(uint32_t)pindex->nTime,(uint64_t)nValue,(uint64_t)nValue * GetStakeMultiplier(tx,out.i),out.tx->GetHash(),out.i,(char *)CBitcoinAddress(address).ToString().c_str(),hashbuf,nHeight,(CScript)pk);
                         //fprintf(stderr,"addutxo numkp.%d vs max.%d\n",numkp,maxkp);
                     }
                 }
@@ -2807,10 +3153,16 @@ int32_t komodo_staked(CMutableTransaction &txNew,uint32_t nBits,uint32_t *blockt
         {
             // placeholder for special staking utxo cases:
         }
+        // the array is updated from the blocks after this one
+        lastheight = chainActive.Height();
+        lasthash = chainActive.Tip()->GetBlockHash();
         lasttime = (uint32_t)time(NULL);
         //fprintf(stderr,"finished kp data of utxo for staking %u ht.%d numkp.%d maxkp.%d\n",(uint32_t)time(NULL),nHeight,numkp,maxkp);
     }
     block_from_future_rejecttime = (uint32_t)GetTime() + ASSETCHAINS_STAKED_BLOCK_FUTURE_MAX;    
+    mindiff.SetCompact(STAKING_MIN_DIFF,&fNegative,&fOverflow);
+    ratio = (mindiff / bnTarget);
+    std::vector<struct komodo_stakecandidate> candidates;
     for (i=winners=0; i<numkp; i++)
     {
         if ( fRequestShutdown || !GetBoolArg("-gen",false) )
@@ -2821,30 +3173,47 @@ int32_t komodo_staked(CMutableTransaction &txNew,uint32_t nBits,uint32_t *blockt
             return(0);
         }
         kp = &array[i];
-        eligible = komodo_stake(0,bnTarget,nHeight,kp->txid,kp->vout,0,(uint32_t)tipindex->nTime+ASSETCHAINS_STAKED_BLOCK_FUTURE_HALF,kp->address,PoSperc);
-        if ( eligible > 0 )
-        {
-            besttime = 0;
-            if ( eligible == komodo_stake(1,bnTarget,nHeight,kp->txid,kp->vout,eligible,(uint32_t)tipindex->nTime+ASSETCHAINS_STAKED_BLOCK_FUTURE_HALF,kp->address,PoSperc) )
-            {
-                // have elegible utxo to stake with. 
-                if ( earliest == 0 || eligible < earliest || (eligible == earliest && (*utxovaluep == 0 || kp->nValue < *utxovaluep)) )
-                {
-                    // is better than the previous best, so use it instead.
-                    earliest = eligible;
-                    best_scriptPubKey = kp->scriptPubKey;
-                    *utxovaluep = (uint64_t)kp->nValue;
-                    decode_hex((uint8_t *)utxotxidp,32,(char *)kp->txid.GetHex().c_str());
-                    *utxovoutp = kp->vout;
-                    *txtimep = kp->txtime;
-                }
-                /*if ( eligible < block_from_future_rejecttime )
-                { 
-                    // better to scan all and choose earliest! 
-                    fprintf(stderr, "block_from_future_rejecttime.%u vs eligible.%u \n", block_from_future_rejecttime, eligible);
-                    break;
-                } */ 
-            }
+        // the stake hash changes with the segids of the last 100 blocks, once per height
+        if ( kp->hashheight != nHeight )
+        {
+            uint256 hash;
+            kp->segid32 = komodo_stakehash(&hash,kp->address,hashbuf,kp->txid,kp->vout);
+            kp->hashval = UintToArith256(hash);
+            kp->hashheight = nHeight;
+        }
+        if ( (eligible= komodo_stakeeligible(kp,bnTarget,ratio,nHeight,minage,0,(uint32_t)tipindex->nTime+ASSETCHAINS_STAKED_BLOCK_FUTURE_HALF)) > 0 )
+        {
+            struct komodo_stakecandidate candidate;
+            candidate.eligible = eligible;
+            candidate.nValue = kp->nValue;
+            candidate.index = i;
+            candidates.push_back(candidate);
+        }
+    }
+    // validate the candidates from the earliest one until one is confirmed
+    std::make_heap(candidates.begin(),candidates.end());
+    while ( !candidates.empty() )
+    {
+        std::pop_heap(candidates.begin(),candidates.end());
+        struct komodo_stakecandidate candidate = candidates.back();
+        candidates.pop_back();
+        kp = &array[candidate.index];
+        {
+            // the array is not updated for the wallet txns in the mempool
+            LOCK2(cs_main, pwalletMain->cs_wallet);
+            if ( pwalletMain->IsSpent(kp->txid,kp->vout) || pwalletMain->IsLockedCoin(kp->txid,kp->vout) )
+                continue;
+        }
+        if ( candidate.eligible == komodo_stake(1,bnTarget,nHeight,kp->txid,kp->vout,candidate.eligible,(uint32_t)tipindex->nTime+ASSETCHAINS_STAKED_BLOCK_FUTURE_HALF,kp->address,PoSperc) )
+        {
+            // have elegible utxo to stake with. 
+            earliest = candidate.eligible;
+            best_scriptPubKey = kp->scriptPubKey;
+            *utxovaluep = (uint64_t)kp->nValue;
+            decode_hex((uint8_t *)utxotxidp,32,(char *)kp->txid.GetHex().c_str());
+            *utxovoutp = kp->vout;
+            *txtimep = kp->txtime;
+            break;
         }
     }
     if (numkp < 500 && array.size() != 0)
@@ -43,6 +43,7 @@
 #define KOMODO_SAPLING_DEADLINE 1550188800 // Feb 15th, 2019
 #define ASSETCHAINS_STAKED_BLOCK_FUTURE_MAX 57
 #define ASSETCHAINS_STAKED_BLOCK_FUTURE_HALF 27
+#define KOMODO_STAKER_MAXUPDATE 10 // blocks the ram staker reads to update its utxos, after a longer gap it rebuilds them
 #define ASSETCHAINS_STAKED_MIN_POW_DIFF 536900000 // 537000000 537300000
 #define _COINBASE_MATURITY 100
 
@@ -623,12 +624,19 @@ int32_t getkmdseason(int32_t height);
 uint64_t komodo_paxprice(uint64_t *seedp,int32_t height,char *base,char *rel,uint64_t basevolume);
 int32_t komodo_paxprices(int32_t *heights,uint64_t *prices,int32_t max,char *base,char *rel);
 int32_t komodo_notaries(uint8_t pubkeys[64][33],int32_t height,uint32_t timestamp);
+const struct komodo_notaryset *komodo_notaryset_get(int32_t height,uint32_t timestamp);
+int32_t komodo_notaryset_find(const struct komodo_notaryset *ns,uint8_t notarypubs33[64][33],int32_t n,uint8_t *pubkey33);
+int32_t komodo_electednotary(int32_t *numnotariesp,uint8_t *pubkey33,int32_t height,uint32_t timestamp);
 char *bitcoin_address(char *coinaddr,uint8_t addrtype,uint8_t *pubkey_or_rmd160,int32_t len);
 int32_t komodo_minerids(uint8_t *minerids,int32_t height,int32_t width);
 
 uint32_t komodo_blocktime(uint256 hash);
 int32_t komodo_dpowconfs(int32_t height,int32_t numconfs);
+int32_t komodo_dpowconfs_snapshot();
+int32_t komodo_dpowconfs_at(int32_t ntzheight,int32_t txheight,int32_t numconfs);
+void komodo_dpowconfs_many(int32_t n,const int32_t *txheights,int32_t *numconfs);
 int8_t komodo_segid(int32_t nocache,int32_t height);
+int8_t komodo_blocksegid(const CBlock &block,CBlockIndex *pindex);
 int32_t komodo_heightpricebits(uint64_t *seedp,uint32_t *heightbits,int32_t nHeight);
 char *komodo_pricename(char *name,int32_t ind);
 int32_t komodo_priceind(const char *symbol);
@@ -639,6 +647,10 @@ uint32_t komodo_heightstamp(int32_t height);
 int64_t komodo_pricemult_to10e8(int32_t ind);
 int32_t komodo_priceget(int64_t *buf64,int32_t ind,int32_t height,int32_t numblocks);
 uint64_t komodo_accrued_interest(int32_t *txheightp,uint32_t *locktimep,uint256 hash,int32_t n,int32_t checkheight,uint64_t checkvalue,int32_t tipheight);
+/** A utxo for komodo_accrued_interests, which fills in txheight, locktime and interest */
+struct komodo_interestutxo { uint256 txid; int32_t vout; uint64_t value; int32_t txheight; uint32_t locktime; uint64_t interest; };
+/** komodo_accrued_interest for many utxos at once, returns the sum. Requires cs_main */
+uint64_t komodo_accrued_interests(std::vector<struct komodo_interestutxo> &utxos,int32_t tipheight);
 int32_t komodo_currentheight();
 int32_t komodo_notarized_bracket(struct notarized_checkpoint *nps[2],int32_t height);
 arith_uint256 komodo_adaptivepow_target(int32_t height,arith_uint256 bnTarget,uint32_t nTime);
@@ -655,6 +667,8 @@ CBlockIndex *komodo_chainactive(int32_t height);
 int32_t komodo_blockheight(uint256 hash);
 int64_t komodo_get_blocktime(uint256 hash);
 bool komodo_txnotarizedconfirmed(uint256 txid,int32_t minconfirms=1);
+int32_t komodo_notarizedheight_snapshot();
+bool komodo_notarizedconfirmed(int32_t txheight,int32_t confirms,int32_t notarizedheight,int32_t minconfirms);
 int32_t komodo_blockload(CBlock& block, CBlockIndex *pindex);
 uint32_t komodo_chainactive_timestamp();
 uint32_t GetLatestTimestamp(int32_t height);
@@ -704,6 +718,8 @@ void komodo_broadcast(CBlock *pblock,int32_t limit);
 int32_t komodo_block2pubkey33(uint8_t *pubkey33,CBlock *block);
 void komodo_event_rewind(struct komodo_state *sp,char *symbol,int32_t height);
 int32_t komodo_connectblock(bool fJustCheck, CBlockIndex *pindex,CBlock& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main) ;
+void komodo_statecheck_save() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+int32_t komodo_statecheck_keep();
 arith_uint256 komodo_PoWtarget(int32_t *percPoSp,arith_uint256 target,int32_t height,int32_t goalperc,int32_t newStakerActive);
 int32_t komodo_baseid(char *origbase);
 int32_t komodo_eligiblenotary(uint8_t pubkeys[66][33],int32_t *mids,uint32_t *blocktimes,int32_t *nonzpkeysp,int32_t height);
@@ -733,6 +749,7 @@ extern uint32_t ASSETCHAINS_MINDIFF[];
 extern uint64_t ASSETCHAINS_TIMEUNLOCKFROM;
 extern uint64_t ASSETCHAINS_TIMEUNLOCKTO;
 extern uint32_t KOMODO_DPOWCONFS;
+extern int32_t KOMODO_COMPACTEVENTS;
 extern uint16_t KMD_PORT, BITCOIND_RPCPORT, DEST_PORT;
 extern char KMDUSERPASS[], BTCUSERPASS[];
 extern uint32_t KOMODO_STOPAT;
@@ -753,14 +770,15 @@ struct komodo_staking
     char address[64];
     uint256 txid;
     arith_uint256 hashval;
-    uint64_t nValue;
+    uint64_t nValue, stakevalue;
     uint32_t segid32, txtime;
-    int32_t vout;
+    int32_t vout, hashheight;  // hashval and segid32 are for the segids at hashheight
     CScript scriptPubKey;
 };
 struct komodo_staking *komodo_addutxo(struct komodo_staking *array, int32_t *numkp, int32_t *maxkp, uint32_t txtime, uint64_t nValue, uint256 txid, int32_t vout, char *address, uint8_t *hashbuf, CScript pk);
 void komodo_createminerstransactions();
 uint32_t komodo_segid32(char *coinaddr);
+uint32_t komodo_stakehash(uint256 *hashp,char *address,uint8_t *hashbuf,uint256 txid,int32_t vout);
 
 int32_t komodo_voutupdate(bool fJustCheck,int32_t *isratificationp,int32_t notaryid,uint8_t *scriptbuf,int32_t scriptlen,int32_t height,uint256 txhash,int32_t i,int32_t j,uint64_t *voutmaskp,int32_t *specialtxp,int32_t *notarizedheightp,uint64_t value,int32_t notarized,uint64_t signedmask,uint32_t timestamp);
 
@@ -781,6 +799,7 @@ bits256 curve25519_basepoint9();
 bits256 curve25519(bits256 mysecret,bits256 basepoint);
 void vcalc_sha256(char deprecated[(256 >> 3) * 2 + 1],uint8_t hash[256 >> 3],uint8_t *src,int32_t len);
 bits256 bits256_doublesha256(char *deprecated,uint8_t *data,int32_t datalen);
+void calc_rmd160_sha256s(uint8_t rmd160s[][20],uint8_t *data,int32_t datalen,int32_t n);
 
 // supernet cipher
 int32_t _SuperNET_cipher(uint8_t nonce[crypto_box_NONCEBYTES],uint8_t *cipher,uint8_t *message,int32_t len,bits256 destpub,bits256 srcpriv,uint8_t *buf);
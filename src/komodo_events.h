@@ -30,13 +30,46 @@ struct komodo_event *komodo_eventadd(struct komodo_state *sp,int32_t height,char
         strcpy(ep->symbol,symbol);
         if ( datalen != 0 )
             memcpy(ep->space,data,datalen);
-        sp->Komodo_events = (struct komodo_event **)realloc(sp->Komodo_events,(1 + sp->Komodo_numevents) * sizeof(*sp->Komodo_events));
+        if ( sp->Komodo_numevents >= sp->Komodo_maxevents )
+        {
+            sp->Komodo_maxevents = (sp->Komodo_maxevents < 1024) ? 1024 : (sp->Komodo_maxevents << 1);
+            sp->Komodo_events = (struct komodo_event **)realloc(sp->Komodo_events,sp->Komodo_maxevents * sizeof(*sp->Komodo_events));
+        }
         sp->Komodo_events[sp->Komodo_numevents++] = ep;
         portable_mutex_unlock(&komodo_mutex);
     }
     return(ep);
 }
 
+#define KOMODO_EVENTS_COMPACTMIN 1024 // dont memmove the event array for less than this many foldable events
+
+// events below the notarized height can no longer be rewound; their effects already live in the komodo_state fields, so only the bounded tail above it is kept
+void komodo_event_compact(struct komodo_state *sp,int32_t floorheight)
+{
+    struct komodo_event *ep; int32_t i,n;
+    if ( sp == 0 || KOMODO_COMPACTEVENTS == 0 || floorheight <= sp->Komodo_eventsfloor )
+        return;
+    portable_mutex_lock(&komodo_mutex);
+    for (n=0; n<sp->Komodo_numevents; n++)
+        if ( (ep= sp->Komodo_events[n]) != 0 && ep->height >= floorheight )
+            break;
+    if ( n >= KOMODO_EVENTS_COMPACTMIN )
+    {
+        for (i=0; i<n; i++)
+            free(sp->Komodo_events[i]);
+        memmove(sp->Komodo_events,&sp->Komodo_events[n],(sp->Komodo_numevents - n) * sizeof(*sp->Komodo_events));
+        sp->Komodo_numevents -= n;
+        sp->Komodo_numcompacted += n;
+        sp->Komodo_eventsfloor = floorheight;
+        if ( sp->Komodo_maxevents > 1024 && sp->Komodo_numevents < (sp->Komodo_maxevents >> 2) )
+        {
+            sp->Komodo_maxevents >>= 1;
+            sp->Komodo_events = (struct komodo_event **)realloc(sp->Komodo_events,sp->Komodo_maxevents * sizeof(*sp->Komodo_events));
+        }
+    }
+    portable_mutex_unlock(&komodo_mutex);
+}
+
 void komodo_eventadd_notarized(struct komodo_state *sp,char *symbol,int32_t height,char *dest,uint256 notarized_hash,uint256 notarized_desttxid,int32_t notarizedheight,uint256 MoM,int32_t MoMdepth)
 {
     static uint32_t counter; int32_t verified=0; char *coin; struct komodo_event_notarized N;
@@ -59,7 +92,10 @@ void komodo_eventadd_notarized(struct komodo_state *sp,char *symbol,int32_t heig
         strncpy(N.dest,dest,sizeof(N.dest)-1);
         komodo_eventadd(sp,height,symbol,KOMODO_EVENT_NOTARIZED,(uint8_t *)&N,sizeof(N));
         if ( sp != 0 )
+        {
             komodo_notarized_update(sp,height,notarizedheight,notarized_hash,notarized_desttxid,MoM,MoMdepth);
+            komodo_event_compact(sp,sp->NOTARIZED_HEIGHT);
+        }
     }
 }
 
@@ -138,6 +174,8 @@ void komodo_event_rewind(struct komodo_state *sp,char *symbol,int32_t height)
             KOMODO_LASTMINED = prevKOMODO_LASTMINED;
             prevKOMODO_LASTMINED = 0;
         }
+        if ( height < sp->Komodo_eventsfloor )
+            printf("[%s] rewind to ht.%d is below the compacted events floor.%d, %d folded events cant be undone\n",ASSETCHAINS_SYMBOL,height,sp->Komodo_eventsfloor,sp->Komodo_numcompacted);
         while ( sp->Komodo_events != 0 && sp->Komodo_numevents > 0 )
         {
             if ( (ep= sp->Komodo_events[sp->Komodo_numevents-1]) != 0 )
@@ -16,8 +16,14 @@
 
 // paxdeposit equivalent in reverse makes opreturn and KMD does the same in reverse
 #include "komodo_defs.h"
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#include <mutex>
+#endif
 
 #include "cc/CCPrices.h"
+#include "cc/CCpricescache.h"
 #include "cc/pricesfeed.h"
 
 /*#include "secp256k1/include/secp256k1.h"
@@ -1296,6 +1302,47 @@ uint8_t *OS_fileptr(long *allocsizep,char *fname)
     return((uint8_t *)retptr);
 }
 
+uint8_t *OS_mapfile(char *fname,long *lenp,int32_t *mappedp)
+{
+    *mappedp = 0;
+#ifndef _WIN32
+    int fd; struct stat st; void *ptr;
+    *lenp = 0;
+    if ( (fd= open(fname,O_RDONLY)) < 0 )
+        return(0);
+    if ( fstat(fd,&st) != 0 || st.st_size == 0 )
+    {
+        close(fd);
+        return(0);
+    }
+    ptr = mmap(0,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if ( ptr == MAP_FAILED )
+    {
+        fprintf(stderr,"OS_mapfile couldnt mmap %s %ld bytes, falling back to read\n",fname,(long)st.st_size);
+        return(OS_fileptr(lenp,fname));
+    }
+    madvise(ptr,(size_t)st.st_size,MADV_SEQUENTIAL);
+    *lenp = (long)st.st_size;
+    *mappedp = 1;
+    return((uint8_t *)ptr);
+#else
+    return(OS_fileptr(lenp,fname));
+#endif
+}
+
+void OS_unmapfile(uint8_t *ptr,long len,int32_t mapped)
+{
+#ifndef _WIN32
+    if ( mapped != 0 )
+    {
+        munmap(ptr,(size_t)len);
+        return;
+    }
+#endif
+    free(ptr);
+}
+
 long komodo_stateind_validate(struct komodo_state *sp,char *indfname,uint8_t *filedata,long datalen,uint32_t *prevpos100p,uint32_t *indcounterp,char *symbol,char *dest)
 {
     FILE *fp; long fsize,lastfpos=0,fpos=0; uint8_t *inds,func; int32_t i,n; uint32_t offset,tmp,prevpos100 = 0;
@@ -1362,11 +1409,11 @@ long komodo_indfile_update(FILE *indfp,uint32_t *prevpos100p,long lastfpos,long
 
 int32_t komodo_faststateinit(struct komodo_state *sp,char *fname,char *symbol,char *dest)
 {
-    FILE *indfp; char indfname[1024]; uint8_t *filedata; long validated=-1,datalen,fpos,lastfpos; uint32_t tmp,prevpos100,indcounter,starttime; int32_t func,finished = 0;
+    FILE *indfp; char indfname[1024]; uint8_t *filedata; long validated=-1,datalen,fpos,lastfpos; uint32_t tmp,prevpos100,indcounter,starttime; int32_t func,mapped,finished = 0;
     starttime = (uint32_t)time(NULL);
     safecopy(indfname,fname,sizeof(indfname)-4);
     strcat(indfname,".ind");
-    if ( (filedata= OS_fileptr(&datalen,fname)) != 0 )
+    if ( (filedata= OS_mapfile(fname,&datalen,&mapped)) != 0 )
     {
         if ( 1 )//datalen >= (1LL << 32) || GetArg("-genind",0) != 0 || (validated= komodo_stateind_validate(0,indfname,filedata,datalen,&prevpos100,&indcounter,symbol,dest)) < 0 )
         {
@@ -1418,17 +1465,125 @@ int32_t komodo_faststateinit(struct komodo_state *sp,char *fname,char *symbol,ch
                 }
             }
         } else printf("komodo_faststateinit unexpected case\n");
-        free(filedata);
+        OS_unmapfile(filedata,datalen,mapped);
         return(finished == 1);
     }
     return(-1);
 }
 
+/**
+ * With -passportshm the KMD daemon also exports its realtime state and the size of its
+ * komodostate file in passport.shm, a small file in its data dir that sibling daemons on the
+ * host map read only. They then read the realtime state from memory and only open komodostate
+ * when it has grown, instead of polling both files on every passport iteration. The export is
+ * a seqlock: seq is odd while the writer updates it. Readers fall back to the files when there
+ * is no export or it is stale.
+ */
+#define KOMODO_PASSPORT_SHM_MAGIC 0x4d485350
+#define KOMODO_PASSPORT_SHM_FNAME "passport.shm"
+struct komodo_passport_shm { uint32_t magic,seq,height,longest,timestamp,pad; uint64_t statesize; };
+
+#ifndef _WIN32
+static struct komodo_passport_shm *komodo_passport_shmmap(int32_t writeflag)
+{
+    int fd; struct stat st; void *ptr; char fname[512];
+    komodo_statefname(fname,(char *)"",(char *)KOMODO_PASSPORT_SHM_FNAME);
+    if ( (fd= open(fname,writeflag != 0 ? O_RDWR|O_CREAT : O_RDONLY,0644)) < 0 )
+        return(0);
+    if ( writeflag != 0 && ftruncate(fd,sizeof(struct komodo_passport_shm)) != 0 )
+    {
+        close(fd);
+        return(0);
+    }
+    if ( fstat(fd,&st) != 0 || st.st_size < (off_t)sizeof(struct komodo_passport_shm) )
+    {
+        close(fd);
+        return(0);
+    }
+    ptr = mmap(0,sizeof(struct komodo_passport_shm),writeflag != 0 ? PROT_READ|PROT_WRITE : PROT_READ,MAP_SHARED,fd,0);
+    close(fd);
+    if ( ptr == MAP_FAILED )
+        return(0);
+    return((struct komodo_passport_shm *)ptr);
+}
+#endif
+
+void komodo_passport_shmexport(uint32_t buf[3])
+{
+#ifndef _WIN32
+    static struct komodo_passport_shm *shm; static int32_t didinit;
+    struct stat st; char fname[512]; uint32_t seq;
+    if ( didinit == 0 )
+    {
+        didinit = 1;
+        if ( GetBoolArg("-passportshm",false) != 0 && (shm= komodo_passport_shmmap(1)) == 0 )
+            fprintf(stderr,"[%s] couldnt create %s, not exporting the passport state\n",ASSETCHAINS_SYMBOL,KOMODO_PASSPORT_SHM_FNAME);
+    }
+    if ( shm == 0 )
+        return;
+    komodo_statefname(fname,(char *)"",(char *)"komodostate");
+    seq = __atomic_load_n(&shm->seq,__ATOMIC_RELAXED) | 1;
+    __atomic_store_n(&shm->seq,seq,__ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&shm->height,buf[0],__ATOMIC_RELAXED);
+    __atomic_store_n(&shm->longest,buf[1],__ATOMIC_RELAXED);
+    __atomic_store_n(&shm->timestamp,(uint32_t)time(NULL),__ATOMIC_RELAXED);
+    __atomic_store_n(&shm->statesize,stat(fname,&st) == 0 ? (uint64_t)st.st_size : 0,__ATOMIC_RELAXED);
+    __atomic_store_n(&shm->magic,KOMODO_PASSPORT_SHM_MAGIC,__ATOMIC_RELAXED);
+    __atomic_store_n(&shm->seq,seq + 1,__ATOMIC_RELEASE);
+#endif
+}
+
+// returns 1 with KMD's exported state, or 0 to read the files
+int32_t komodo_passport_shmimport(uint32_t buf[3],uint64_t *statesizep)
+{
+#ifndef _WIN32
+    static struct komodo_passport_shm *shm; static uint32_t lastattempt;
+    struct komodo_passport_shm S; int32_t i; uint32_t now = (uint32_t)time(NULL);
+    if ( shm == 0 )
+    {
+        if ( now < lastattempt+60 )
+            return(0);
+        lastattempt = now;
+        if ( (shm= komodo_passport_shmmap(0)) == 0 )
+            return(0);
+    }
+    for (i=0; i<100; i++)
+    {
+        S.seq = __atomic_load_n(&shm->seq,__ATOMIC_ACQUIRE);
+        if ( (S.seq & 1) != 0 )
+            continue;
+        S.magic = __atomic_load_n(&shm->magic,__ATOMIC_RELAXED);
+        S.height = __atomic_load_n(&shm->height,__ATOMIC_RELAXED);
+        S.longest = __atomic_load_n(&shm->longest,__ATOMIC_RELAXED);
+        S.timestamp = __atomic_load_n(&shm->timestamp,__ATOMIC_RELAXED);
+        S.statesize = __atomic_load_n(&shm->statesize,__ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ( __atomic_load_n(&shm->seq,__ATOMIC_RELAXED) == S.seq )
+            break;
+    }
+    // the KMD daemon is gone or no longer exporting, map the file again later as it may be recreated
+    if ( i == 100 || S.magic != KOMODO_PASSPORT_SHM_MAGIC || S.timestamp < now-60 )
+    {
+        munmap(shm,sizeof(*shm));
+        shm = 0;
+        return(0);
+    }
+    buf[0] = S.height;
+    buf[1] = S.longest;
+    buf[2] = S.timestamp;
+    *statesizep = S.statesize;
+    return(1);
+#else
+    return(0);
+#endif
+}
+
 void komodo_passport_iteration()
 {
     static long lastpos[34]; static char userpass[33][1024]; static uint32_t lasttime,callcounter,lastinterest;
     int32_t maxseconds = 10;
-    FILE *fp; uint8_t *filedata; long fpos,datalen,lastfpos; int32_t baseid,limit,n,ht,isrealtime,expired,refid,blocks,longest; struct komodo_state *sp,*refsp; char *retstr,fname[512],*base,symbol[KOMODO_ASSETCHAIN_MAXLEN],dest[KOMODO_ASSETCHAIN_MAXLEN]; uint32_t buf[3],starttime; uint64_t RTmask = 0; //CBlockIndex *pindex;
+    FILE *fp; uint8_t *filedata; long fpos,datalen,lastfpos; int32_t baseid,limit,n,ht,isrealtime,expired,refid,blocks,longest; struct komodo_state *sp,*refsp; char *retstr,fname[512],*base,symbol[KOMODO_ASSETCHAIN_MAXLEN],dest[KOMODO_ASSETCHAIN_MAXLEN]; uint32_t buf[3],shmbuf[3],starttime; uint64_t RTmask = 0,statesize = 0; int32_t isshm = 0; //CBlockIndex *pindex;
     expired = 0;
     while ( 0 && KOMODO_INITDONE == 0 )
     {
@@ -1485,7 +1640,10 @@ void komodo_passport_iteration()
                 komodo_nameset(symbol,dest,base);
                 sp = komodo_stateptrget(symbol);
                 n = 0;
-                if ( lastpos[baseid] == 0 && (filedata= OS_fileptr(&datalen,fname)) != 0 )
+                isshm = komodo_passport_shmimport(shmbuf,&statesize);
+                if ( isshm != 0 && lastpos[baseid] != 0 && statesize <= lastpos[baseid] )
+                    ; // komodostate hasn't grown
+                else if ( lastpos[baseid] == 0 && (filedata= OS_fileptr(&datalen,fname)) != 0 )
                 {
                     fpos = 0;
                     fprintf(stderr,"%s processing %s %ldKB\n",ASSETCHAINS_SYMBOL,fname,datalen/1024);
@@ -1526,9 +1684,11 @@ void komodo_passport_iteration()
                     fclose(fp);
                 } else fprintf(stderr,"load error.(%s) %p\n",fname,sp);
                 komodo_statefname(fname,baseid<32?base:(char *)"",(char *)"realtime");
-                if ( (fp= fopen(fname,"rb")) != 0 )
+                if ( isshm != 0 || (fp= fopen(fname,"rb")) != 0 )
                 {
-                    if ( fread(buf,1,sizeof(buf),fp) == sizeof(buf) )
+                    if ( isshm != 0 )
+                        memcpy(buf,shmbuf,sizeof(buf));
+                    if ( isshm != 0 || fread(buf,1,sizeof(buf),fp) == sizeof(buf) )
                     {
                         sp->CURRENT_HEIGHT = buf[0];
                         if ( buf[0] != 0 && buf[0] >= buf[1] && buf[2] > time(NULL)-60 )
@@ -1540,7 +1700,8 @@ void komodo_passport_iteration()
                         else if ( KOMODO_PAX != 0 && (time(NULL)-buf[2]) > 60 && ASSETCHAINS_SYMBOL[0] != 0 )
                             fprintf(stderr,"[%s]: %s not RT %u %u %d\n",ASSETCHAINS_SYMBOL,base,buf[0],buf[1],(int32_t)(time(NULL)-buf[2]));
                     } //else fprintf(stderr,"%s size error RT\n",base);
-                    fclose(fp);
+                    if ( isshm == 0 )
+                        fclose(fp);
                 } //else fprintf(stderr,"%s open error RT\n",base);
             }
         }
@@ -1563,6 +1724,7 @@ void komodo_passport_iteration()
                 if ( fwrite(buf,1,sizeof(buf),fp) != sizeof(buf) )
                     fprintf(stderr,"[%s] %s error writing realtime\n",ASSETCHAINS_SYMBOL,base);
                 fclose(fp);
+                komodo_passport_shmexport(buf);
             } else fprintf(stderr,"%s create error RT\n",base);
         }
         if ( sp != 0 && isrealtime == 0 )
@@ -1620,7 +1782,39 @@ void komodo_PriceCache_shift()
     memcpy(PriceCache[0],Mineropret.data(),Mineropret.size());
 }
 
-int32_t _komodo_heightpricebits(uint64_t *seedp,uint32_t *heightbits,CBlock *block)
+// coinbase price data of the recent heights at height % KOMODO_PRICEBITS_RINGSIZE, so prices validation of each new block does not reload the previous blocks
+#define KOMODO_PRICEBITS_RINGSIZE 1440
+struct komodo_pricebitsentry
+{
+    uint256 blockhash;  // the entry is for the block with this hash only
+    uint64_t seed;
+    std::vector<uint8_t> vopret;
+};
+static komodo_pricebitsentry PricebitsRing[KOMODO_PRICEBITS_RINGSIZE];
+static std::mutex pricebitsringmutex;
+
+static void komodo_pricebitsring_put(int32_t nHeight, const uint256 &blockhash, uint64_t seed, const std::vector<uint8_t> &vopret)
+{
+    std::lock_guard<std::mutex> lock(pricebitsringmutex);
+    komodo_pricebitsentry &entry = PricebitsRing[nHeight % KOMODO_PRICEBITS_RINGSIZE];
+    entry.blockhash = blockhash;
+    entry.seed = seed;
+    entry.vopret = vopret;
+}
+
+static int32_t komodo_pricebitsring_get(int32_t nHeight, const uint256 &blockhash, uint64_t *seedp, uint32_t *heightbits)
+{
+    std::lock_guard<std::mutex> lock(pricebitsringmutex);
+    const komodo_pricebitsentry &entry = PricebitsRing[nHeight % KOMODO_PRICEBITS_RINGSIZE];
+    if ( entry.blockhash != blockhash || entry.vopret.empty() )
+        return(-1);
+    if ( seedp != 0 )
+        *seedp = entry.seed;
+    memcpy(heightbits,entry.vopret.data(),entry.vopret.size());
+    return((int32_t)(entry.vopret.size()/sizeof(uint32_t)));
+}
+
+int32_t _komodo_heightpricebits(uint64_t *seedp,uint32_t *heightbits,CBlock *block,int32_t nHeight = -1)
 {
     CTransaction tx; int32_t numvouts; std::vector<uint8_t> vopret;
     tx = block->vtx[0];
@@ -1631,6 +1825,12 @@ int32_t _komodo_heightpricebits(uint64_t *seedp,uint32_t *heightbits,CBlock *blo
         if ( seedp != 0 )
             memcpy(seedp,&block->hashMerkleRoot,sizeof(*seedp));
         memcpy(heightbits,vopret.data(),vopret.size());
+        if ( nHeight > 0 )
+        {
+            uint64_t seed;
+            memcpy(&seed,&block->hashMerkleRoot,sizeof(seed));
+            komodo_pricebitsring_put(nHeight,block->GetHash(),seed,vopret);
+        }
         return((int32_t)(vopret.size()/sizeof(uint32_t)));
     }
     return(-1);
@@ -1644,9 +1844,12 @@ int32_t komodo_heightpricebits(uint64_t *seedp,uint32_t *heightbits,int32_t nHei
         *seedp = 0;
     if ( (pindex= komodo_chainactive(nHeight)) != 0 )
     {
+        int32_t n;
+        if ( (n= komodo_pricebitsring_get(nHeight,pindex->GetBlockHash(),seedp,heightbits)) >= 0 )
+            return(n);
         if ( komodo_blockload(block,pindex) == 0 )
         {
-            return(_komodo_heightpricebits(seedp,heightbits,&block));
+            return(_komodo_heightpricebits(seedp,heightbits,&block,nHeight));
         }
     }
     fprintf(stderr,"couldnt get pricebits for %d\n",nHeight);
@@ -2310,6 +2513,32 @@ int32_t komodo_priceind(const char *symbol)
     }
     return(-1);
 }
+// komodo_pricecorrelated without nonzprices, from its second iteration on: the first reference price in seed order with more than half
+// of the window in its interval. The prices in an interval are counted with two binary searches instead of a scan of the window.
+static int64_t komodo_pricecorrelated_sorted(uint64_t seed,int64_t mult,uint32_t *rawprices,int32_t rawskip)
+{
+    int32_t i,iter,correlation; int64_t refprice,lowprice,highprice; std::vector<uint32_t> sorted(PRICES_DAYWINDOW);
+    for (i=0; i<PRICES_DAYWINDOW; i++)
+        sorted[i] = rawprices[i*rawskip];
+    std::sort(sorted.begin(),sorted.end());
+    for (iter=1; iter<PRICES_DAYWINDOW; iter++)
+    {
+        i = (iter + seed) % PRICES_DAYWINDOW;
+        refprice = rawprices[i*rawskip];
+        highprice = (refprice * (COIN + PRICES_ERRORRATE*5)) / COIN;
+        lowprice = (refprice * (COIN - PRICES_ERRORRATE*5)) / COIN;
+        if ( highprice == refprice )
+            highprice++;
+        if ( lowprice == refprice )
+            lowprice--;
+        correlation = (int32_t)(std::upper_bound(sorted.begin(),sorted.end(),highprice,[](int64_t price,uint32_t val) { return price < val; }) -
+            std::lower_bound(sorted.begin(),sorted.end(),lowprice,[](uint32_t val,int64_t price) { return val < price; }));
+        if ( correlation > (PRICES_DAYWINDOW>>1) )
+            return(refprice * mult);
+    }
+    return(0);
+}
+
 // returns price value which is in a 10% interval for more than 50% points for the preceding 24 hours
 int64_t komodo_pricecorrelated(uint64_t seed,int32_t ind,uint32_t *rawprices,int32_t rawskip,uint32_t *nonzprices,int32_t smoothwidth)
 {
@@ -2406,6 +2635,11 @@ int64_t komodo_pricecorrelated(uint64_t seed,int32_t ind,uint32_t *rawprices,int
         }
         if ( correlation > maxcorrelation )
             maxcorrelation = correlation;
+        if ( nonzprices == 0 )
+        {
+            // the first iteration checked the whole window for null prices, count the prices of the other intervals in the sorted window
+            return(komodo_pricecorrelated_sorted(seed,mult,rawprices,rawskip));
+        }
     }
     //fprintf(stderr,"ind.%d iter.%d maxcorrelation.%d ref.%llu high.%llu low.%llu\n",ind,iter,maxcorrelation,(long long)refprice,(long long)highprice,(long long)lowprice);
     return(0);
@@ -2626,7 +2860,8 @@ void komodo_pricesupdate(int32_t height,CBlock *pblock)
         tmpbuf = (int64_t *)calloc(sizeof(int64_t),2*PRICES_DAYWINDOW);
         fprintf(stderr,"prices update: numprices.%d %p %p\n",numprices,ptr32,ptr64);
     }
-    if ( _komodo_heightpricebits(&seed,rawprices,pblock) == numprices )
+    PricesCacheEraseFrom(height); // the price data of height is rewritten, drop the synthetic prices evaluated with the previous data
+    if ( _komodo_heightpricebits(&seed,rawprices,pblock,height) == numprices ) // also keeps them for the validation of the next blocks
     {
         //for (ind=0; ind<numprices; ind++)
         //    fprintf(stderr,"%u ",rawprices[ind]);
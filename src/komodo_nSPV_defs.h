@@ -176,13 +176,34 @@
 // see NSPV_txidsresp
 #define NSPV_TXIDSRESP_V2 0x19
 
+// get utxos for an address from a cursor, the index scan resumes where the previous response ended
+// params:
+// uint8_t addrlen, char coinaddr[addrlen] - address or index key to get utxos from
+// uint8_t isCC - is CC (1) or normal (0) address
+// int32_t maxrecords - max records to return in a response (max is 32767)
+// uint8_t fStream - if 1 up to NSPV_MAXSTREAMMSGS responses are sent, each one resuming from the previous one
+// uint8_t cursorlen, uint8_t cursor[cursorlen] - cursor of the previous response, empty to start from the first utxo
+#define NSPV_UTXOS_CURSOR 0x1a
+
+// get utxos from a cursor response
+// see NSPV_utxosresp struct, followed by uint8_t cursorlen, uint8_t cursor[cursorlen] (empty after the last utxo)
+#define NSPV_UTXOSRESP_CURSOR 0x1b
+
+// get transactions inputs and outputs for an address/index key from a cursor
+// params: as NSPV_UTXOS_CURSOR
+#define NSPV_TXIDS_CURSOR 0x1c
+
+// get transactions inputs and outputs from a cursor response
+// see NSPV_txidsresp struct, followed by uint8_t cursorlen, uint8_t cursor[cursorlen] (empty after the last record)
+#define NSPV_TXIDSRESP_CURSOR 0x1d
+
 // error response for an NSPV request
 // params:
 // int32_t errorId
 // string errorDesc - network serialised error description
 #define NSPV_ERRORRESP 0xff
 
-#define NSPV_MAX_REQ NSPV_TXIDS_V2
+#define NSPV_MAX_REQ NSPV_TXIDS_CURSOR
 
 
 #define NSPV_MEMPOOL_ALL 0
@@ -204,6 +225,36 @@
 #define NSPV_ERROR_DEPRECATED               (-18)
 
 #define NSPV_MAXREQSPERSEC 15
+// seconds of -nspvpeerrate a peer may spend at once
+#define NSPV_PEER_BURST_SECONDS 5
+// responses sent for a streamed cursor request, the client continues from the cursor of the last one
+#define NSPV_MAXSTREAMMSGS 16
+// proofs and notarisations of the superlite client kept between runs
+#define NSPV_PROOFCACHE_FILENAME "nspvproofs.dat"
+// a superlite request unanswered after the 90th percentile of the recent response times is also sent to a second peer
+#define NSPV_LATENCY_SAMPLES 64
+#define NSPV_HEDGE_MIN_SAMPLES 8
+#define NSPV_HEDGE_DEFAULT_USEC 1000000
+#define NSPV_HEDGE_MIN_USEC 100000
+// notarisation header chains at least this long are hashed on up to NSPV_HDRHASH_THREADS threads
+#define NSPV_HDRHASH_PARALLEL_MIN 64
+#define NSPV_HDRHASH_THREADS 4
+// notarisation txs remembered as validated by the superlite client
+#define NSPV_VERIFIEDNTZS_MAX 4096
+
+// nSPV server counters of a request type
+struct NSPV_requeststats
+{
+    uint64_t nRequests;     // requests received
+    uint64_t nCacheHits;    // answered from the response cache
+    uint64_t nRateLimited;  // dropped by the per peer or per type limits
+    uint64_t nCost;         // cost units charged
+};
+
+int32_t NSPV_requestcost(uint8_t requestType);
+void NSPV_getrequeststats(std::map<uint8_t, NSPV_requeststats> &mapStats, bool fReset);
+void NSPV_loadproofcache();
+void NSPV_saveproofcache();
 
 #ifndef KOMODO_NSPV_FULLNODE
 #define KOMODO_NSPV_FULLNODE (KOMODO_NSPV <= 0)
@@ -284,6 +284,68 @@ int32_t NSPV_getaddressutxos(struct NSPV_utxosresp* ptr, char* coinaddr, bool is
     //return (0);
 }
 
+// NSPV_getaddressutxos resuming the unspent index iterator after cursor instead of skipping records of a full scan.
+// On return cursor is the last utxo read, fMore is set if there are utxos after it
+int32_t NSPV_getaddressutxos_cursor(struct NSPV_utxosresp* ptr, char* coinaddr, bool isCC, int32_t maxrecords, CAddressUnspentKey &cursor, bool &fMore)
+{
+    CAmount total = 0LL, interest = 0LL;
+    uint32_t locktime;
+    int32_t tipheight, txheight, script_len_total = 0;
+    std::vector<struct NSPV_utxoresp> utxos;
+    CAddressUnspentKey last = cursor, resume = cursor;
+
+    {
+        LOCK(cs_main);
+        tipheight = chainActive.LastTip()->GetHeight();
+    }
+    if (maxrecords <= 0 || maxrecords >= std::numeric_limits<int16_t>::max())
+        maxrecords = std::numeric_limits<int16_t>::max();  // prevent large requests
+
+    fMore = false;
+    IterateCCunspents(coinaddr, isCC, [&](const CAddressUnspentKey &key, const CAddressUnspentValue &value) {
+        if (utxos.size() == maxrecords) {
+            fMore = true;
+            return false;
+        }
+        last = key;
+        if (myIsutxo_spentinmempool(ignoretxid, ignorevin, key.txhash, (int32_t)key.index))
+            return true;
+        struct NSPV_utxoresp utxo;
+        memset(&utxo, 0, sizeof(utxo));
+        utxo.txid = key.txhash;
+        utxo.vout = (int32_t)key.index;
+        utxo.satoshis = value.satoshis;
+        utxo.height = value.blockHeight;
+        if (IS_KMD_CHAIN() && value.satoshis >= 10 * COIN) {  // calc interest on the kmd chain
+            utxo.extradata = komodo_accrued_interest(&txheight, &locktime, utxo.txid, utxo.vout, utxo.height, utxo.satoshis, tipheight);
+            interest += utxo.extradata;
+        }
+        utxo.script = (uint8_t*)malloc(value.script.size());
+        memcpy(utxo.script, &value.script[0], value.script.size());
+        utxo.script_size = value.script.size();
+        script_len_total += value.script.size() + 9; // add 9 for max varint script size
+        total += value.satoshis;
+        utxos.push_back(utxo);
+        return true;
+    }, &resume);
+    cursor = last;
+
+    strncpy(ptr->coinaddr, coinaddr, sizeof(ptr->coinaddr) - 1);
+    ptr->CCflag = isCC;
+    ptr->maxrecords = maxrecords;
+    ptr->skipcount = 0;
+    ptr->nodeheight = tipheight;
+    ptr->numutxos = utxos.size();
+    ptr->utxos = nullptr;
+    if (!utxos.empty()) {
+        ptr->utxos = (struct NSPV_utxoresp*)calloc(utxos.size(), sizeof(ptr->utxos[0]));
+        memcpy(ptr->utxos, utxos.data(), utxos.size() * sizeof(ptr->utxos[0]));
+    }
+    ptr->total = total;
+    ptr->interest = interest;
+    return (int32_t)(sizeof(*ptr) + sizeof(ptr->utxos[0]) * ptr->numutxos - sizeof(ptr->utxos)) + script_len_total;
+}
+
 class BaseCCChecker {
 public:
     /// base check function
@@ -564,6 +626,50 @@ int32_t NSPV_getaddresstxids(struct NSPV_txidsresp* ptr, char* coinaddr, bool is
     return (len);
 }
 
+// NSPV_getaddresstxids resuming the address index iterator after cursor instead of skipping records of a full scan.
+// On return cursor is the last record read, fMore is set if there are records after it
+int32_t NSPV_getaddresstxids_cursor(struct NSPV_txidsresp* ptr, char* coinaddr, bool isCC, int32_t maxrecords, CAddressIndexKey &cursor, bool &fMore)
+{
+    std::vector<struct NSPV_txidresp> txids;
+    CAddressIndexKey last = cursor, resume = cursor;
+
+    if (maxrecords <= 0 || maxrecords >= std::numeric_limits<int16_t>::max())
+        maxrecords = std::numeric_limits<int16_t>::max();  // prevent large requests
+
+    fMore = false;
+    IterateCCtxids(coinaddr, isCC, [&](const CAddressIndexKey &key, CAmount nValue) {
+        if (txids.size() == maxrecords) {
+            fMore = true;
+            return false;
+        }
+        last = key;
+        struct NSPV_txidresp txid;
+        txid.txid = key.txhash;
+        txid.index = (int32_t)key.index;
+        txid.satoshis = (int64_t)nValue;
+        txid.height = key.blockHeight;
+        txids.push_back(txid);
+        return true;
+    }, &resume);
+    cursor = last;
+
+    strncpy(ptr->coinaddr, coinaddr, sizeof(ptr->coinaddr) - 1);
+    ptr->CCflag = isCC;
+    ptr->maxrecords = maxrecords;
+    ptr->skipcount = 0;
+    {
+        LOCK(cs_main);
+        ptr->nodeheight = chainActive.LastTip()->GetHeight();
+    }
+    ptr->numtxids = txids.size();
+    ptr->txids = nullptr;
+    if (!txids.empty()) {
+        ptr->txids = (struct NSPV_txidresp*)calloc(txids.size(), sizeof(ptr->txids[0]));
+        memcpy(ptr->txids, txids.data(), txids.size() * sizeof(ptr->txids[0]));
+    }
+    return (int32_t)(sizeof(*ptr) + sizeof(ptr->txids[0]) * ptr->numtxids - sizeof(ptr->txids));
+}
+
 // get txids from addressindex or mempool by different criteria
 // looks like as a set of ad-hoc functions and it should be rewritten
 int32_t NSPV_mempoolfuncs(bits256* satoshisp, int32_t* vindexp, std::vector<uint256>& txids, char* coinaddr, bool isCC, uint8_t funcid, uint256 txid, int32_t vout)
@@ -1006,6 +1112,267 @@ static void NSPV_senderror(CNode* pfrom, uint32_t requestId, int32_t err, const
     pfrom->PushMessage("nSPV", response);
 }
 
+/**
+ * LRU cache of the nSPV responses, by request type and request data, so the
+ * same request of many light clients is answered from the indices once per
+ * tip. The responses are kept with a zero requestId, it is patched in when a
+ * response is served. A new tip clears the cache, the utxos responses which
+ * also depend on the mempool are keyed by its update counter too.
+ * Bounded by -nspvcache MiB.
+ */
+class CNSPVResponseCache
+{
+private:
+    struct ResponseEntry {
+        std::vector<uint8_t> response;
+        std::list<std::vector<uint8_t>>::iterator itLru;
+    };
+    //! most recently served response first
+    std::list<std::vector<uint8_t>> lru;
+    std::map<std::vector<uint8_t>, ResponseEntry> mapResponses;
+    size_t nBytes;
+    uint256 hashTip;
+    boost::mutex cs;
+
+    void Erase(std::map<std::vector<uint8_t>, ResponseEntry>::iterator it)
+    {
+        nBytes -= it->first.size() + it->second.response.size();
+        lru.erase(it->second.itLru);
+        mapResponses.erase(it);
+    }
+
+    void SetTip(const uint256 &hashTipIn)
+    {
+        if (hashTipIn != hashTip) {
+            lru.clear();
+            mapResponses.clear();
+            nBytes = 0;
+            hashTip = hashTipIn;
+        }
+    }
+
+public:
+    CNSPVResponseCache() : nBytes(0) {}
+
+    /** The key of a request, empty if its response is not cached */
+    static std::vector<uint8_t> GetKey(uint8_t requestType, const uint8_t *requestData, int32_t requestDataLen)
+    {
+        std::vector<uint8_t> key;
+        switch (requestType) {
+        case NSPV_INFO:
+        case NSPV_UTXOS:
+        case NSPV_TXIDS:
+        case NSPV_TXIDS_V2:
+        case NSPV_NTZS:
+        case NSPV_TXPROOF:
+            break;
+        default:
+            return key;
+        }
+        key.push_back(requestType);
+        key.insert(key.end(), requestData, requestData + requestDataLen);
+        if (requestType == NSPV_UTXOS) { // spent in mempool utxos are left out
+            uint32_t nMempoolUpdated = mempool.GetTransactionsUpdated();
+            key.insert(key.end(), (uint8_t*)&nMempoolUpdated, (uint8_t*)&nMempoolUpdated + sizeof(nMempoolUpdated));
+        }
+        return key;
+    }
+
+    bool Get(const std::vector<uint8_t> &key, const uint256 &hashTipIn, uint32_t requestId, std::vector<uint8_t> &response)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        SetTip(hashTipIn);
+        std::map<std::vector<uint8_t>, ResponseEntry>::iterator it = mapResponses.find(key);
+        if (it == mapResponses.end())
+            return false;
+        lru.splice(lru.begin(), lru, it->second.itLru);
+        response = it->second.response;
+        memcpy(&response[1], &requestId, sizeof(requestId));
+        return true;
+    }
+
+    void Set(const std::vector<uint8_t> &key, const uint256 &hashTipIn, const std::vector<uint8_t> &response)
+    {
+        size_t nMaxBytes = std::max((int64_t)0, GetArg("-nspvcache", DEFAULT_NSPV_RESPONSE_CACHE_SIZE)) << 20;
+        size_t nEntryBytes = key.size() + response.size();
+        if (key.empty() || nEntryBytes > nMaxBytes / 4)
+            return;
+
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (hashTipIn != hashTip) // built for a tip which is not the best one any more
+            return;
+        std::map<std::vector<uint8_t>, ResponseEntry>::iterator it = mapResponses.find(key);
+        if (it != mapResponses.end())
+            Erase(it);
+        while (!lru.empty() && nBytes + nEntryBytes > nMaxBytes)
+            Erase(mapResponses.find(lru.back()));
+
+        lru.push_front(key);
+        ResponseEntry &entry = mapResponses[key];
+        entry.response = response;
+        memset(&entry.response[1], 0, sizeof(uint32_t));
+        entry.itLru = lru.begin();
+        nBytes += nEntryBytes;
+    }
+};
+
+static CNSPVResponseCache nspvResponseCache;
+
+static CCriticalSection cs_nspvstats;
+static std::map<uint8_t, NSPV_requeststats> mapNSPVRequestStats;
+
+/** Cost units of a request against -nspvpeerrate, by how much index reading it takes */
+int32_t NSPV_requestcost(uint8_t requestType)
+{
+    switch (requestType) {
+    case NSPV_INFO:
+    case NSPV_NTZS:
+        return 1;
+    case NSPV_NTZSPROOF:
+    case NSPV_TXPROOF:
+    case NSPV_SPENTINFO:
+        return 2;
+    case NSPV_CCMODULEUTXOS:
+    case NSPV_REMOTERPC:
+        return 10;
+    default:
+        return 5;
+    }
+}
+
+void NSPV_getrequeststats(std::map<uint8_t, NSPV_requeststats> &mapStats, bool fReset)
+{
+    LOCK(cs_nspvstats);
+    mapStats = mapNSPVRequestStats;
+    if (fReset)
+        mapNSPVRequestStats.clear();
+}
+
+static void NSPV_countrequest(uint8_t requestType, int32_t cost, bool fCacheHit, bool fRateLimited)
+{
+    LOCK(cs_nspvstats);
+    NSPV_requeststats &stats = mapNSPVRequestStats[requestType];
+    stats.nRequests++;
+    stats.nCost += cost;
+    if (fCacheHit)
+        stats.nCacheHits++;
+    if (fRateLimited)
+        stats.nRateLimited++;
+}
+
+/**
+ * Takes cost units from the token bucket of pfrom, which refills with
+ * -nspvpeerrate units a second up to NSPV_PEER_BURST_SECONDS of them, so one
+ * peer spamming expensive requests can't take the server from the others.
+ * The requests of a peer are never run concurrently, they hold cs_vRecvMsg.
+ */
+static bool NSPV_ratelimit(CNode* pfrom, int32_t cost)
+{
+    int64_t nRate = GetArg("-nspvpeerrate", DEFAULT_NSPV_PEER_RATE);
+    if (nRate <= 0)
+        return true;
+    double nMaxTokens = (double)nRate * NSPV_PEER_BURST_SECONDS;
+    int64_t nNow = GetTimeMicros();
+    if (pfrom->nNspvTokens < 0)
+        pfrom->nNspvTokens = nMaxTokens;
+    else if (nNow > pfrom->nNspvTokensTime)
+        pfrom->nNspvTokens = std::min(nMaxTokens, pfrom->nNspvTokens + (double)nRate * (nNow - pfrom->nNspvTokensTime) / 1000000.0);
+    pfrom->nNspvTokensTime = nNow;
+    if (pfrom->nNspvTokens < cost)
+        return false;
+    pfrom->nNspvTokens -= cost;
+    return true;
+}
+
+/**
+ * Answers an NSPV_UTXOS_CURSOR or NSPV_TXIDS_CURSOR request with respType
+ * responses of the records getfn reads after the request cursor. A streamed
+ * request gets up to NSPV_MAXSTREAMMSGS responses, each one charged cost,
+ * while the peer has the tokens for them.
+ */
+template <typename Resp, typename Key>
+static void NSPV_sendcursorresponses(CNode* pfrom, uint8_t respType, uint32_t requestId, const uint8_t *requestData, int32_t requestDataLen, int32_t cost,
+                                     int32_t (*getfn)(Resp*, char*, bool, int32_t, Key&, bool&),
+                                     int32_t (*rwfn)(int32_t, uint8_t*, Resp*),
+                                     void (*purgefn)(Resp*))
+{
+    const int nspvHeaderSize = sizeof(respType) + sizeof(requestId);
+    char coinaddr[KOMODO_ADDRESS_BUFSIZE];
+    uint8_t isCC, fStream;
+    int32_t maxrecords;
+    Key cursor;
+    const int32_t cursorSize = cursor.GetSerializeSize(SER_DISK, CLIENT_VERSION);
+
+    int32_t addrlen = requestDataLen > 0 ? requestData[0] : 0;
+    int32_t offset = 1;
+    if (requestDataLen < 1 || addrlen > sizeof(coinaddr) - 1 || offset + addrlen + sizeof(isCC) + sizeof(maxrecords) + sizeof(fStream) + 1 > requestDataLen) {
+        LogPrint("nspv", "requestType=0x%02x bad request len.%d or addrlen.%d, node=%d\n", (int)respType - 1, requestDataLen, addrlen, pfrom->id);
+        NSPV_senderror(pfrom, requestId, NSPV_ERROR_INVALID_REQUEST_DATA);
+        return;
+    }
+    memcpy(coinaddr, &requestData[offset], addrlen);
+    coinaddr[addrlen] = 0;
+    offset += addrlen;
+    isCC = (requestData[offset++] != 0);
+    offset += iguana_rwnum(IGUANA_READ, (uint8_t*)&requestData[offset], sizeof(maxrecords), &maxrecords);
+    fStream = (requestData[offset++] != 0);
+    int32_t cursorlen = requestData[offset++];
+    if (offset + cursorlen != requestDataLen || (cursorlen != 0 && cursorlen != cursorSize)) {
+        LogPrint("nspv", "requestType=0x%02x bad request cursorlen.%d len.%d, node=%d\n", (int)respType - 1, cursorlen, requestDataLen, pfrom->id);
+        NSPV_senderror(pfrom, requestId, NSPV_ERROR_INVALID_REQUEST_DATA);
+        return;
+    }
+    if (cursorlen != 0) {
+        uint160 hashBytes;
+        int type = 0;
+        CDataStream ss((const char*)&requestData[offset], (const char*)&requestData[offset + cursorlen], SER_DISK, CLIENT_VERSION);
+        ss >> cursor;
+        if (!CBitcoinAddress(coinaddr).GetIndexKey(hashBytes, type, isCC) || cursor.hashBytes != hashBytes || cursor.type != (unsigned int)type) {
+            LogPrint("nspv", "requestType=0x%02x cursor is not for address %s, node=%d\n", (int)respType - 1, coinaddr, pfrom->id);
+            NSPV_senderror(pfrom, requestId, NSPV_ERROR_INVALID_REQUEST_DATA);
+            return;
+        }
+    }
+
+    for (int i = 0; i < (fStream ? NSPV_MAXSTREAMMSGS : 1); i++) {
+        if (i > 0 && !NSPV_ratelimit(pfrom, cost))
+            break; // the peer continues from the last cursor when it has the tokens
+        Resp R;
+        bool fMore;
+        memset(&R, 0, sizeof(R));
+        int32_t respEstimated = getfn(&R, coinaddr, isCC, maxrecords, cursor, fMore);
+        std::vector<uint8_t> response(nspvHeaderSize + respEstimated + 1 + cursorSize);
+        response[0] = respType;
+        memcpy(&response[1], &requestId, sizeof(requestId));
+        int32_t respWritten = rwfn(IGUANA_WRITE, &response[nspvHeaderSize], &R);
+        purgefn(&R);
+        if (respWritten <= 0 || respWritten > respEstimated) {
+            LogPrint("nspv", "requestType=0x%02x incorrect response written len.%d\n", (int)respType - 1, respWritten);
+            NSPV_senderror(pfrom, requestId, NSPV_ERROR_INVALID_RESPONSE);
+            return;
+        }
+        offset = nspvHeaderSize + respWritten;
+        if (fMore) {
+            CDataStream ss(SER_DISK, CLIENT_VERSION);
+            ss << cursor;
+            response[offset++] = (uint8_t)ss.size();
+            memcpy(&response[offset], &ss[0], ss.size());
+            offset += ss.size();
+        } else
+            response[offset++] = 0;
+        response.resize(offset);
+        pfrom->PushMessage("nSPV", response);
+        LogPrint("nspv-details", "requestType=0x%02x response %d more.%d to node=%d\n", (int)respType - 1, i, fMore, pfrom->id);
+        if (!fMore)
+            break;
+    }
+}
+
+/** Whether a getnSPV request is cheap enough to go ahead of the queued ones of other peers */
+bool NSPV_ischeaprequest(const std::vector<uint8_t> &request)
+{
+    return !request.empty() && NSPV_requestcost(request[0]) == 1;
+}
 
 // processing nspv requests
 void komodo_nSPVreq(CNode* pfrom, std::vector<uint8_t> request) // received a request
@@ -1035,12 +1402,22 @@ void komodo_nSPVreq(CNode* pfrom, std::vector<uint8_t> request) // received a re
     } else if (timestamp == pfrom->nspvdata[idata].prevtime) {
         if (pfrom->nspvdata[idata].nreqs > NSPV_MAXREQSPERSEC) {
             LogPrint("nspv", "rate limit reached from peer %d\n", pfrom->id);
+            NSPV_countrequest(requestType, 0, false, true);
             return;
         }
     } else {
         pfrom->nspvdata[idata].nreqs = 0;  // clear request stat if new second
     }
 
+    // and no more than -nspvpeerrate cost units/sec over all types:
+    int32_t cost = NSPV_requestcost(requestType);
+    if (!NSPV_ratelimit(pfrom, cost)) {
+        pfrom->nNspvRateLimited++;
+        LogPrint("nspv", "requestType=0x%02x cost %d over the rate limit of peer %d\n", (int)requestType, cost, pfrom->id);
+        NSPV_countrequest(requestType, 0, false, true);
+        return;
+    }
+
     // check if nspv connected:
     if (!pfrom->fNspvConnected)  {
         if (requestType != NSPV_INFO) {
@@ -1050,6 +1427,28 @@ void komodo_nSPVreq(CNode* pfrom, std::vector<uint8_t> request) // received a re
         }
     }
 
+    std::vector<uint8_t> cacheKey = CNSPVResponseCache::GetKey(requestType, requestData, requestDataLen);
+    uint256 hashTip;
+    if (!cacheKey.empty()) {
+        {
+            LOCK(cs_main);
+            if (chainActive.LastTip() != nullptr)
+                hashTip = chainActive.LastTip()->GetBlockHash();
+        }
+        if (nspvResponseCache.Get(cacheKey, hashTip, requestId, response)) {
+            pfrom->nNspvTokens += cost - 1; // a cached response costs as an info request
+            NSPV_countrequest(requestType, 1, true, false);
+            pfrom->PushMessage("nSPV", response);
+            pfrom->nspvdata[idata].prevtime = timestamp;
+            pfrom->nspvdata[idata].nreqs++;
+            LogPrint("nspv-details", "requestType=0x%02x response from cache to node=%d\n", (int)requestType, pfrom->id);
+            if (requestType == NSPV_INFO)
+                pfrom->fNspvConnected = true; // the cached request had a supported version
+            return;
+        }
+    }
+    NSPV_countrequest(requestType, cost, false, false);
+
     switch (requestType) {
     case NSPV_INFO: // info, mandatory first request
         {
@@ -1084,6 +1483,7 @@ void komodo_nSPVreq(CNode* pfrom, std::vector<uint8_t> request) // received a re
                 if (NSPV_rwinforesp(IGUANA_WRITE, &response[nspvHeaderSize], &I) <= respLen) {
                     //fprintf(stderr,"send info resp to id %d\n",(int32_t)pfrom->id);
                     pfrom->PushMessage("nSPV", response);
+                    nspvResponseCache.Set(cacheKey, hashTip, response);
                     pfrom->nspvdata[idata].prevtime = timestamp;
                     pfrom->nspvdata[idata].nreqs++;
                     LogPrint("nspv-details", "NSPV_INFO sent response: version %d to node=%d\n", I.version, pfrom->id);
@@ -1158,6 +1558,7 @@ void komodo_nSPVreq(CNode* pfrom, std::vector<uint8_t> request) // received a re
                 if (respWritten > 0 && respWritten <= respEstimated) {
                     response.resize(nspvHeaderSize + respWritten);
                     pfrom->PushMessage("nSPV", response);
+                    nspvResponseCache.Set(cacheKey, hashTip, response);
                     pfrom->nspvdata[idata].prevtime = timestamp;
                     pfrom->nspvdata[idata].nreqs++;
                     LogPrint("nspv-details", "NSPV_UTXOS response: numutxos=%d to node=%d\n", U.numutxos, pfrom->id);
@@ -1173,6 +1574,20 @@ void komodo_nSPVreq(CNode* pfrom, std::vector<uint8_t> request) // received a re
         } 
         break;
 
+    case NSPV_UTXOS_CURSOR:
+        NSPV_sendcursorresponses<NSPV_utxosresp, CAddressUnspentKey>(pfrom, NSPV_UTXOSRESP_CURSOR, requestId, requestData, requestDataLen, cost,
+                                                                      &NSPV_getaddressutxos_cursor, &NSPV_rwutxosresp, &NSPV_utxosresp_purge);
+        pfrom->nspvdata[idata].prevtime = timestamp;
+        pfrom->nspvdata[idata].nreqs++;
+        break;
+
+    case NSPV_TXIDS_CURSOR:
+        NSPV_sendcursorresponses<NSPV_txidsresp, CAddressIndexKey>(pfrom, NSPV_TXIDSRESP_CURSOR, requestId, requestData, requestDataLen, cost,
+                                                                    &NSPV_getaddresstxids_cursor, &NSPV_rwtxidsresp, &NSPV_txidsresp_purge);
+        pfrom->nspvdata[idata].prevtime = timestamp;
+        pfrom->nspvdata[idata].nreqs++;
+        break;
+
     case NSPV_TXIDS: 
     case NSPV_TXIDS_V2: 
         {
@@ -1231,6 +1646,7 @@ void komodo_nSPVreq(CNode* pfrom, std::vector<uint8_t> request) // received a re
                 if (respWritten > 0 && respWritten <= respEstimated) {
                     response.resize(nspvHeaderSize + respWritten);
                     pfrom->PushMessage("nSPV", response);
+                    nspvResponseCache.Set(cacheKey, hashTip, response);
                     pfrom->nspvdata[idata].prevtime = timestamp;
                     pfrom->nspvdata[idata].nreqs++;
                     LogPrint("nspv-details", "NSPV_TXIDS[_V2] response: numtxids=%d to node=%d\n", (int)T.numtxids, pfrom->id);
@@ -1320,6 +1736,7 @@ void komodo_nSPVreq(CNode* pfrom, std::vector<uint8_t> request) // received a re
                     if (respWritten > 0 && respWritten <= respEstimated) {
                         response.resize(nspvHeaderSize + respWritten);
                         pfrom->PushMessage("nSPV", response);
+                        nspvResponseCache.Set(cacheKey, hashTip, response);
                         pfrom->nspvdata[idata].prevtime = timestamp;
                         pfrom->nspvdata[idata].nreqs++;
                         LogPrint("nspv-details", "NSPV_NTZS response: ntz.txid=%s node=%d\n", N.ntz.txid.GetHex(), pfrom->id);
@@ -1399,6 +1816,7 @@ void komodo_nSPVreq(CNode* pfrom, std::vector<uint8_t> request) // received a re
                         response.resize(nspvHeaderSize + respWritten);
                         //fprintf(stderr,"send response\n");
                         pfrom->PushMessage("nSPV", response);
+                        nspvResponseCache.Set(cacheKey, hashTip, response);
                         pfrom->nspvdata[idata].prevtime = timestamp;
                         pfrom->nspvdata[idata].nreqs++;
                         LogPrint("nspv-details", "NSPV_TXPROOF response: txlen=%d txprooflen=%d node=%d\n", P.txlen, P.txprooflen, pfrom->id);
@@ -17,7 +17,11 @@
 #ifndef KOMODO_NSPVSUPERLITE_H
 #define KOMODO_NSPVSUPERLITE_H
 
+#include <list>
 #include <string>
+#include <unordered_map>
+
+#include <boost/filesystem.hpp>
 
 #include "key_io.h"
 #include "main.h"
@@ -51,100 +55,228 @@ struct NSPV_ntzsproofresp NSPV_ntzsproofresult;
 struct NSPV_txproof NSPV_txproofresult;
 struct NSPV_broadcastresp NSPV_broadcastresult;
 
-struct NSPV_ntzsresp NSPV_ntzsresp_cache[NSPV_MAXVINS];
-struct NSPV_ntzsproofresp NSPV_ntzsproofresp_cache[NSPV_MAXVINS * 2];
-struct NSPV_txproof NSPV_txproof_cache[NSPV_MAXVINS * 4];
+/**
+ * LRU cache of the proofs and notarisations a superlite client received,
+ * looked up by hash. Each entry keeps the response it was parsed from, the
+ * immutable ones (fPersist) are written to NSPV_PROOFCACHE_FILENAME at
+ * shutdown and read back at startup. Entry is the response struct, copied
+ * in with copyfn and freed with purgefn.
+ */
+template <typename Key, typename Entry, typename Hasher>
+class CNSPVProofCache
+{
+private:
+    struct Item {
+        Entry entry;
+        std::vector<uint8_t> response;
+        typename std::list<Key>::iterator itLru;
+
+        Item() { memset(&entry, 0, sizeof(entry)); }
+    };
+    //! most recently used entry first
+    std::list<Key> lru;
+    std::unordered_map<Key, Item, Hasher> mapItems;
+    size_t nMaxEntries;
+    void (*copyfn)(Entry*, Entry*);
+    void (*purgefn)(Entry*);
+    bool (*persistfn)(const Entry*);
+    boost::mutex cs;
+
+public:
+    CNSPVProofCache(size_t nMaxEntriesIn, void (*copyfnIn)(Entry*, Entry*), void (*purgefnIn)(Entry*), bool (*persistfnIn)(const Entry*)) :
+        nMaxEntries(nMaxEntriesIn), copyfn(copyfnIn), purgefn(purgefnIn), persistfn(persistfnIn) {}
+    ~CNSPVProofCache() { Clear(); }
+
+    Entry *Find(const Key &key)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        typename std::unordered_map<Key, Item, Hasher>::iterator it = mapItems.find(key);
+        if (it == mapItems.end())
+            return nullptr;
+        lru.splice(lru.begin(), lru, it->second.itLru);
+        return &it->second.entry;
+    }
+
+    /** Adds or replaces the entry of key with a copy of ptr, parsed from response */
+    Entry *Add(const Key &key, Entry *ptr, const std::vector<uint8_t> &response)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        typename std::unordered_map<Key, Item, Hasher>::iterator it = mapItems.find(key);
+        if (it != mapItems.end()) {
+            purgefn(&it->second.entry);
+            lru.splice(lru.begin(), lru, it->second.itLru);
+        } else {
+            while (!lru.empty() && mapItems.size() >= nMaxEntries) {
+                typename std::unordered_map<Key, Item, Hasher>::iterator itOld = mapItems.find(lru.back());
+                purgefn(&itOld->second.entry);
+                mapItems.erase(itOld);
+                lru.pop_back();
+            }
+            lru.push_front(key);
+            it = mapItems.insert(std::make_pair(key, Item())).first;
+            it->second.itLru = lru.begin();
+        }
+        copyfn(&it->second.entry, ptr);
+        it->second.response = response;
+        return &it->second.entry;
+    }
+
+    void Clear()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        for (typename std::unordered_map<Key, Item, Hasher>::iterator it = mapItems.begin(); it != mapItems.end(); ++it)
+            purgefn(&it->second.entry);
+        mapItems.clear();
+        lru.clear();
+    }
+
+    /** Appends the responses of the persistent entries, least recently used first so the reloaded order is kept */
+    void GetPersistent(std::vector<std::vector<uint8_t>> &responses)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        for (typename std::list<Key>::reverse_iterator it = lru.rbegin(); it != lru.rend(); ++it) {
+            const Item &item = mapItems.find(*it)->second;
+            if (persistfn(&item.entry))
+                responses.push_back(item.response);
+        }
+    }
+};
+
+struct NSPV_uint256hasher
+{
+    size_t operator()(const uint256 &hash) const { return hash.GetCheapHash(); }
+};
+
+static bool NSPV_ntzsresp_persist(const struct NSPV_ntzsresp *ptr) { return !ptr->ntz.txid.IsNull(); } // a notarisation found is final
+static bool NSPV_ntzsproof_persist(const struct NSPV_ntzsproofresp *ptr) { return ptr->common.hdrs != nullptr; }
+static bool NSPV_txproof_persist(const struct NSPV_txproof *ptr) { return ptr->height > 0 && ptr->txprooflen != 0; }
+
+CNSPVProofCache<int32_t, struct NSPV_ntzsresp, std::hash<int32_t>> NSPV_ntzsresp_cache(NSPV_MAXVINS * 16, &NSPV_ntzsresp_copy, &NSPV_ntzsresp_purge, &NSPV_ntzsresp_persist);
+CNSPVProofCache<uint256, struct NSPV_ntzsproofresp, NSPV_uint256hasher> NSPV_ntzsproofresp_cache(NSPV_MAXVINS * 32, &NSPV_ntzsproofresp_copy, &NSPV_ntzsproofresp_purge, &NSPV_ntzsproof_persist);
+CNSPVProofCache<uint256, struct NSPV_txproof, NSPV_uint256hasher> NSPV_txproof_cache(NSPV_MAXVINS * 64, &NSPV_txproof_copy, &NSPV_txproof_purge, &NSPV_txproof_persist);
 
 struct NSPV_ntzsresp *NSPV_ntzsresp_find(int32_t reqheight)
 {
-    int32_t i;
-    for (i=0; i<sizeof(NSPV_ntzsresp_cache)/sizeof(*NSPV_ntzsresp_cache); i++)
-        if ( NSPV_ntzsresp_cache[i].reqheight == reqheight )
-            return(&NSPV_ntzsresp_cache[i]);
-    return(0);
+    return NSPV_ntzsresp_cache.Find(reqheight);
 }
 
-struct NSPV_ntzsresp *NSPV_ntzsresp_add(struct NSPV_ntzsresp *ptr)
+struct NSPV_ntzsresp *NSPV_ntzsresp_add(struct NSPV_ntzsresp *ptr, const std::vector<uint8_t> &response)
 {
-    int32_t i;
-    for (i=0; i<sizeof(NSPV_ntzsresp_cache)/sizeof(*NSPV_ntzsresp_cache); i++)
-        if ( NSPV_ntzsresp_cache[i].reqheight == 0 )
-            break;
-    if ( i == sizeof(NSPV_ntzsresp_cache)/sizeof(*NSPV_ntzsresp_cache) )
-        i = (rand() % (sizeof(NSPV_ntzsresp_cache)/sizeof(*NSPV_ntzsresp_cache)));
-    NSPV_ntzsresp_purge(&NSPV_ntzsresp_cache[i]);
-    NSPV_ntzsresp_copy(&NSPV_ntzsresp_cache[i],ptr);
-    fprintf(stderr,"ADD CACHE ntzsresp req.%d\n",ptr->reqheight);
-    return(&NSPV_ntzsresp_cache[i]);
+    return NSPV_ntzsresp_cache.Add(ptr->reqheight, ptr, response);
 }
 
 struct NSPV_txproof *NSPV_txproof_find(uint256 txid)
 {
-    int32_t i; struct NSPV_txproof *backup = 0;
-    for (i=0; i<sizeof(NSPV_txproof_cache)/sizeof(*NSPV_txproof_cache); i++)
-        if ( NSPV_txproof_cache[i].txid == txid )
-        {
-            if ( NSPV_txproof_cache[i].txprooflen != 0 )
-                return(&NSPV_txproof_cache[i]);
-            else backup = &NSPV_txproof_cache[i];
-        }
-    return(backup);
+    return NSPV_txproof_cache.Find(txid);
+}
+
+struct NSPV_txproof *NSPV_txproof_add(struct NSPV_txproof *ptr, const std::vector<uint8_t> &response)
+{
+    struct NSPV_txproof *cached = NSPV_txproof_cache.Find(ptr->txid);
+    if ( cached != nullptr && (cached->txprooflen != 0 || ptr->txprooflen == 0) ) // only a proof replaces an entry without one
+        return(cached);
+    return NSPV_txproof_cache.Add(ptr->txid, ptr, response);
 }
 
-struct NSPV_txproof *NSPV_txproof_add(struct NSPV_txproof *ptr)
+struct NSPV_ntzsproofresp *NSPV_ntzsproof_find(uint256 nexttxid)
+{
+    return NSPV_ntzsproofresp_cache.Find(nexttxid);
+}
+
+struct NSPV_ntzsproofresp *NSPV_ntzsproof_add(struct NSPV_ntzsproofresp *ptr, const std::vector<uint8_t> &response)
 {
-    int32_t i;
-    for (i=0; i<sizeof(NSPV_txproof_cache)/sizeof(*NSPV_txproof_cache); i++)
-        if ( NSPV_txproof_cache[i].txid == ptr->txid )
+    return NSPV_ntzsproofresp_cache.Add(ptr->nexttxid, ptr, response);
+}
+
+// adds a cached response read back from NSPV_PROOFCACHE_FILENAME
+static void NSPV_cacheresponse(const std::vector<uint8_t> &response)
+{
+    if ( response.size() < 2 )
+        return;
+    switch ( response[0] )
+    {
+        case NSPV_NTZSRESP:
         {
-            if ( NSPV_txproof_cache[i].txprooflen == 0 && ptr->txprooflen != 0 )
-            {
-                NSPV_txproof_purge(&NSPV_txproof_cache[i]);
-                NSPV_txproof_copy(&NSPV_txproof_cache[i],ptr);
-                return(&NSPV_txproof_cache[i]);
-            }
-            else if ( NSPV_txproof_cache[i].txprooflen != 0 || ptr->txprooflen == 0 )
-                return(&NSPV_txproof_cache[i]);
+            struct NSPV_ntzsresp N;
+            memset(&N,0,sizeof(N));
+            NSPV_rwntzsresp(0,(uint8_t *)&response[1],&N);
+            NSPV_ntzsresp_add(&N,response);
+            NSPV_ntzsresp_purge(&N);
+            break;
         }
-    for (i=0; i<sizeof(NSPV_txproof_cache)/sizeof(*NSPV_txproof_cache); i++)
-        if ( NSPV_txproof_cache[i].txlen == 0 )
+        case NSPV_NTZSPROOFRESP:
+        {
+            struct NSPV_ntzsproofresp P;
+            memset(&P,0,sizeof(P));
+            NSPV_rwntzsproofresp(0,(uint8_t *)&response[1],&P);
+            NSPV_ntzsproof_add(&P,response);
+            NSPV_ntzsproofresp_purge(&P);
             break;
-    if ( i == sizeof(NSPV_txproof_cache)/sizeof(*NSPV_txproof_cache) )
-        i = (rand() % (sizeof(NSPV_txproof_cache)/sizeof(*NSPV_txproof_cache)));
-    NSPV_txproof_purge(&NSPV_txproof_cache[i]);
-    NSPV_txproof_copy(&NSPV_txproof_cache[i],ptr);
-    fprintf(stderr,"ADD CACHE txproof %s\n",ptr->txid.GetHex().c_str());
-    return(&NSPV_txproof_cache[i]);
+        }
+        case NSPV_TXPROOFRESP:
+        {
+            struct NSPV_txproof P;
+            memset(&P,0,sizeof(P));
+            NSPV_rwtxproof(0,(uint8_t *)&response[1],&P);
+            NSPV_txproof_add(&P,response);
+            NSPV_txproof_purge(&P);
+            break;
+        }
+    }
 }
 
-struct NSPV_ntzsproofresp *NSPV_ntzsproof_find(uint256 nexttxid)
+void NSPV_loadproofcache()
 {
-    int32_t i;
-    for (i=0; i<sizeof(NSPV_ntzsproofresp_cache)/sizeof(*NSPV_ntzsproofresp_cache); i++)
-        if ( NSPV_ntzsproofresp_cache[i].nexttxid == nexttxid )
-            return(&NSPV_ntzsproofresp_cache[i]);
-    return(0);
+    boost::filesystem::path path = GetDataDir() / NSPV_PROOFCACHE_FILENAME;
+    CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if ( filein.IsNull() )
+        return;
+    try {
+        int nVersion;
+        std::vector<std::vector<uint8_t>> responses;
+        filein >> nVersion;
+        if ( nVersion != NSPV_PROTOCOL_VERSION ) // the responses are in the wire format of this version
+            return;
+        filein >> responses;
+        BOOST_FOREACH(const std::vector<uint8_t> &response, responses)
+            NSPV_cacheresponse(response);
+        LogPrintf("%s: loaded %u nSPV proofs\n", __func__, responses.size());
+    } catch (const std::exception& e) {
+        LogPrintf("%s: failed to read %s: %s\n", __func__, path.string(), e.what());
+    }
 }
 
-struct NSPV_ntzsproofresp *NSPV_ntzsproof_add(struct NSPV_ntzsproofresp *ptr)
+void NSPV_saveproofcache()
 {
-    int32_t i;
-    for (i=0; i<sizeof(NSPV_ntzsproofresp_cache)/sizeof(*NSPV_ntzsproofresp_cache); i++)
-        if ( NSPV_ntzsproofresp_cache[i].common.hdrs == 0 )
-            break;
-    if ( i == sizeof(NSPV_ntzsproofresp_cache)/sizeof(*NSPV_ntzsproofresp_cache) )
-        i = (rand() % (sizeof(NSPV_ntzsproofresp_cache)/sizeof(*NSPV_ntzsproofresp_cache)));
-    NSPV_ntzsproofresp_purge(&NSPV_ntzsproofresp_cache[i]);
-    NSPV_ntzsproofresp_copy(&NSPV_ntzsproofresp_cache[i],ptr);
-    fprintf(stderr,"ADD CACHE ntzsproof %s\n", ptr->nexttxid.GetHex().c_str());
-    return(&NSPV_ntzsproofresp_cache[i]);
+    std::vector<std::vector<uint8_t>> responses;
+    NSPV_ntzsresp_cache.GetPersistent(responses);
+    NSPV_ntzsproofresp_cache.GetPersistent(responses);
+    NSPV_txproof_cache.GetPersistent(responses);
+
+    boost::filesystem::path path = GetDataDir() / NSPV_PROOFCACHE_FILENAME;
+    CAutoFile fileout(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if ( fileout.IsNull() )
+    {
+        LogPrintf("%s: failed to write %s\n", __func__, path.string());
+        return;
+    }
+    try {
+        int nVersion = NSPV_PROTOCOL_VERSION;
+        fileout << nVersion << responses;
+    } catch (const std::exception& e) {
+        LogPrintf("%s: failed to write %s: %s\n", __func__, path.string(), e.what());
+    }
 }
 
 // komodo_nSPVresp is called from async message processing
 
+static bool NSPV_responsefirst(CNode *pfrom,uint8_t respType);
+
 void komodo_nSPVresp(CNode *pfrom,std::vector<uint8_t> response) // received a response
 {
     struct NSPV_inforesp I; int32_t len; uint32_t timestamp = (uint32_t)time(NULL);
+    if ( response.size() > 0 && !NSPV_responsefirst(pfrom,response[0]) )
+        return; // a hedged request was answered by the other peer already
     strncpy(NSPV_lastpeer,pfrom->addr.ToString().c_str(),sizeof(NSPV_lastpeer)-1);
     if ( (len= response.size()) > 0 )
     {
@@ -188,21 +320,21 @@ void komodo_nSPVresp(CNode *pfrom,std::vector<uint8_t> response) // received a r
                 NSPV_ntzsresp_purge(&NSPV_ntzsresult);
                 NSPV_rwntzsresp(0,&response[1],&NSPV_ntzsresult);
                 if ( NSPV_ntzsresp_find(NSPV_ntzsresult.reqheight) == 0 )
-                    NSPV_ntzsresp_add(&NSPV_ntzsresult);
+                    NSPV_ntzsresp_add(&NSPV_ntzsresult,response);
                 fprintf(stderr,"got ntzs response %u size.%d ntz.txid %s ntzed.height.%d\n",timestamp,(int32_t)response.size(), NSPV_ntzsresult.ntz.txid.GetHex().c_str(), NSPV_ntzsresult.ntz.ntzheight);
                 break;
             case NSPV_NTZSPROOFRESP:
                 NSPV_ntzsproofresp_purge(&NSPV_ntzsproofresult);
                 NSPV_rwntzsproofresp(0,&response[1],&NSPV_ntzsproofresult);
                 if ( NSPV_ntzsproof_find(NSPV_ntzsproofresult.nexttxid) == 0 )
-                    NSPV_ntzsproof_add(&NSPV_ntzsproofresult);
+                    NSPV_ntzsproof_add(&NSPV_ntzsproofresult,response);
                 fprintf(stderr,"got ntzproof response %u size.%d next.%d\n",timestamp,(int32_t)response.size(), NSPV_ntzsproofresult.common.nextht);
                 break;
             case NSPV_TXPROOFRESP:
                 NSPV_txproof_purge(&NSPV_txproofresult);
                 NSPV_rwtxproof(0,&response[1],&NSPV_txproofresult);
                 if ( NSPV_txproof_find(NSPV_txproofresult.txid) == 0 )
-                    NSPV_txproof_add(&NSPV_txproofresult);
+                    NSPV_txproof_add(&NSPV_txproofresult,response);
                 fprintf(stderr,"got txproof response %u size.%d %s ht.%d\n",timestamp,(int32_t)response.size(), NSPV_txproofresult.txid.GetHex().c_str(),NSPV_txproofresult.height);
                 break;
             case NSPV_SPENTINFORESP:
@@ -229,33 +361,65 @@ void komodo_nSPVresp(CNode *pfrom,std::vector<uint8_t> response) // received a r
 
 // superlite message issuing
 
+// the latest request of each type sent to a peer picked by NSPV_req, until it is answered
+struct NSPV_pendingreq
+{
+    std::vector<uint8_t> request;
+    uint64_t mask;
+    int64_t nSentTime, nHedgeTime;
+    NodeId firstnode, hedgenode;
+    bool fHedged, fAnswered;
+};
+
+static CCriticalSection cs_nspvpending;
+static std::map<int32_t, NSPV_pendingreq> NSPV_pending;
+static std::deque<int64_t> NSPV_latencies; // the last NSPV_LATENCY_SAMPLES response times
+
+// how long a request waits for its first peer before it is sent to a second one
+static int64_t NSPV_hedgedelay()
+{
+    AssertLockHeld(cs_nspvpending);
+    if ( NSPV_latencies.size() < NSPV_HEDGE_MIN_SAMPLES )
+        return(NSPV_HEDGE_DEFAULT_USEC);
+    std::vector<int64_t> samples(NSPV_latencies.begin(),NSPV_latencies.end());
+    std::nth_element(samples.begin(),samples.begin() + samples.size()*9/10,samples.end());
+    int64_t nMaxDelay = (int64_t)NSPV_POLLITERS * NSPV_POLLMICROS / 2;
+    return(std::min(nMaxDelay,std::max((int64_t)NSPV_HEDGE_MIN_USEC,samples[samples.size()*9/10])));
+}
+
+// picks the faster of two random peers with the mask services which were not sent a request of this type in the current second,
+// a peer which never answered counts as the fastest so every peer gets measured
+static CNode *NSPV_pickpeer(uint64_t mask,int32_t ind,uint32_t timestamp,NodeId exclude)
+{
+    int32_t n = 0; CNode *pnodes[64];
+    //LOCK(cs_vNodes);
+    BOOST_FOREACH(CNode *ptr,vNodes)
+    {
+        if ( ptr->nspvdata[ind].prevtime > timestamp )
+            ptr->nspvdata[ind].prevtime = 0;
+        if ( ptr->hSocket == INVALID_SOCKET || ptr->id == exclude )
+            continue;
+        if ( (ptr->nServices & mask) == mask && timestamp > ptr->nspvdata[ind].prevtime )
+        {
+            pnodes[n++] = ptr;
+            if ( n == sizeof(pnodes)/sizeof(*pnodes) )
+                break;
+        } // else fprintf(stderr,"nServices %llx vs mask %llx, t%u vs %u, ind.%d\n",(long long)ptr->nServices,(long long)mask,timestamp,ptr->nspvdata[ind].prevtime,ind);
+    }
+    if ( n == 0 )
+        return(0);
+    CNode *pa = pnodes[rand() % n], *pb = pnodes[rand() % n];
+    return(pb->nNspvLatencyUsec < pa->nNspvLatencyUsec ? pb : pa);
+}
+
 CNode *NSPV_req(CNode *pnode,uint8_t *msg,int32_t len,uint64_t mask,int32_t ind)
 {
-    int32_t n,flag = 0; CNode *pnodes[64]; uint32_t timestamp = (uint32_t)time(NULL);
+    int32_t flag = 0; uint32_t timestamp = (uint32_t)time(NULL);
     if ( KOMODO_NSPV_FULLNODE )
         return(0);
     if ( pnode == 0 )
-    {
-        memset(pnodes,0,sizeof(pnodes));
-        //LOCK(cs_vNodes);
-        n = 0;
-        BOOST_FOREACH(CNode *ptr,vNodes)
-        {
-            if ( ptr->nspvdata[ind].prevtime > timestamp )
-                ptr->nspvdata[ind].prevtime = 0;
-            if ( ptr->hSocket == INVALID_SOCKET )
-                continue;
-            if ( (ptr->nServices & mask) == mask && timestamp > ptr->nspvdata[ind].prevtime )
-            {
-                flag = 1;
-                pnodes[n++] = ptr;
-                if ( n == sizeof(pnodes)/sizeof(*pnodes) )
-                    break;
-            } // else fprintf(stderr,"nServices %llx vs mask %llx, t%u vs %u, ind.%d\n",(long long)ptr->nServices,(long long)mask,timestamp,ptr->nspvdata[ind].prevtime,ind);
-        }
-        if ( n > 0 )
-            pnode = pnodes[rand() % n];
-    } else flag = 1;
+        pnode = NSPV_pickpeer(mask,ind,timestamp,-1);
+    else flag = 1;
     if ( pnode != 0 )
     {
         std::vector<uint8_t> request;
@@ -265,11 +429,74 @@ CNode *NSPV_req(CNode *pnode,uint8_t *msg,int32_t len,uint64_t mask,int32_t ind)
             fprintf(stderr,"pushmessage [%d] len.%d\n",msg[0],len);
         pnode->PushMessage("getnSPV",request);
         pnode->nspvdata[ind].prevtime = timestamp;
+        if ( flag == 0 ) // requests to a chosen peer are not hedged
+        {
+            LOCK(cs_nspvpending);
+            NSPV_pendingreq &pending = NSPV_pending[ind];
+            pending.request = request;
+            pending.mask = mask;
+            pending.nSentTime = GetTimeMicros();
+            pending.nHedgeTime = 0;
+            pending.firstnode = pnode->id;
+            pending.hedgenode = -1;
+            pending.fHedged = pending.fAnswered = false;
+        }
         return(pnode);
     } else fprintf(stderr,"no pnodes\n");
     return(0);
 }
 
+// sends the pending requests which waited longer than NSPV_hedgedelay to a second peer
+static void NSPV_hedgerequests()
+{
+    uint32_t timestamp = (uint32_t)time(NULL); int64_t nNow = GetTimeMicros();
+    LOCK(cs_nspvpending);
+    int64_t nDelay = NSPV_hedgedelay();
+    for (std::map<int32_t, NSPV_pendingreq>::iterator it = NSPV_pending.begin(); it != NSPV_pending.end(); ++it)
+    {
+        NSPV_pendingreq &pending = it->second;
+        if ( pending.fHedged || pending.fAnswered || nNow < pending.nSentTime + nDelay )
+            continue;
+        pending.fHedged = true; // once, even if there is no other peer
+        CNode *pnode = NSPV_pickpeer(pending.mask,it->first,timestamp,pending.firstnode);
+        if ( pnode == 0 )
+            continue;
+        pnode->PushMessage("getnSPV",pending.request);
+        pnode->nspvdata[it->first].prevtime = timestamp;
+        pending.nHedgeTime = nNow;
+        pending.hedgenode = pnode->id;
+        LogPrint("nspv","hedged request [%d] to peer %d after %d ms\n",(int32_t)pending.request[0],pnode->id,(int32_t)((nNow - pending.nSentTime)/1000));
+    }
+}
+
+// records the response time of pfrom, returns false for the response of the slower peer of a hedged request
+static bool NSPV_responsefirst(CNode *pfrom,uint8_t respType)
+{
+    int64_t nNow = GetTimeMicros();
+    LOCK(cs_nspvpending);
+    std::map<int32_t, NSPV_pendingreq>::iterator it = NSPV_pending.find(respType >> 1);
+    if ( it == NSPV_pending.end() || (it->second.request[0] | 1) != respType )
+        return(true);
+    NSPV_pendingreq &pending = it->second;
+    if ( pfrom->id != pending.firstnode && pfrom->id != pending.hedgenode )
+        return(true);
+    if ( pending.fAnswered )
+        return(!pending.fHedged);
+    int64_t nLatency = nNow - (pfrom->id == pending.hedgenode ? pending.nHedgeTime : pending.nSentTime);
+    pfrom->nNspvLatencyUsec = pfrom->nNspvLatencyUsec == 0 ? nLatency : (pfrom->nNspvLatencyUsec * 7 + nLatency) / 8;
+    NSPV_latencies.push_back(nNow - pending.nSentTime);
+    if ( NSPV_latencies.size() > NSPV_LATENCY_SAMPLES )
+        NSPV_latencies.pop_front();
+    if ( pfrom->id == pending.hedgenode ) // the first peer is at least as slow as the time waited for it
+    {
+        BOOST_FOREACH(CNode *ptr,vNodes)
+            if ( ptr->id == pending.firstnode )
+                ptr->nNspvLatencyUsec = std::max(ptr->nNspvLatencyUsec,nNow - pending.nSentTime);
+    }
+    pending.fAnswered = true;
+    return(true);
+}
+
 UniValue NSPV_logout()
 {
     UniValue result(UniValue::VOBJ);
@@ -277,9 +504,6 @@ UniValue NSPV_logout()
     if ( NSPV_logintime != 0 )
         fprintf(stderr,"scrub wif and privkey from NSPV memory\n");
     else result.push_back(Pair("status","wasnt logged in"));
-    memset(NSPV_ntzsproofresp_cache,0,sizeof(NSPV_ntzsproofresp_cache));
-    memset(NSPV_txproof_cache,0,sizeof(NSPV_txproof_cache));
-    memset(NSPV_ntzsresp_cache,0,sizeof(NSPV_ntzsresp_cache));
     memset(NSPV_wifstr,0,sizeof(NSPV_wifstr));
     memset(&NSPV_key,0,sizeof(NSPV_key));
     NSPV_logintime = 0;
@@ -299,6 +523,7 @@ void komodo_nSPV(CNode *pto) // polling loop from SendMessages
         pto->nspvdata[NSPV_INFO>>1].prevtime = 0;
     if ( KOMODO_NSPV_SUPERLITE )
     {
+        NSPV_hedgerequests();
         if ( timestamp > NSPV_lastinfo + ASSETCHAINS_BLOCKTIME/2 && timestamp > pto->nspvdata[NSPV_INFO>>1].prevtime + 2*ASSETCHAINS_BLOCKTIME/3 )
         {
             int32_t reqht;
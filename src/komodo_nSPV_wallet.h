@@ -25,30 +25,76 @@
 
 // nSPV wallet uses superlite functions (and some komodod built in functions) to implement nSPV_spend
 
+// notarisation txs whose signatures were validated, by txid, with the height and blockhash they notarise
+static CCriticalSection cs_nspvverifiedntzs;
+static std::map<uint256, std::pair<int32_t, uint256>> NSPV_verifiedntzs;
+
+// NSPV_hdrhash of the headers, on up to NSPV_HDRHASH_THREADS threads for long header chains
+static void NSPV_hdrhashes(struct NSPV_equihdr *hdrs,int32_t numhdrs,std::vector<uint256> &hashes)
+{
+    hashes.resize(numhdrs);
+    int32_t nThreads = std::min((int32_t)boost::thread::hardware_concurrency(),NSPV_HDRHASH_THREADS);
+    if ( numhdrs < NSPV_HDRHASH_PARALLEL_MIN || nThreads <= 1 )
+    {
+        for (int32_t i=0; i<numhdrs; i++)
+            hashes[i] = NSPV_hdrhash(&hdrs[i]);
+        return;
+    }
+    boost::thread_group threads;
+    for (int32_t t=0; t<nThreads; t++)
+        threads.create_thread([&hashes,hdrs,numhdrs,nThreads,t]() {
+            for (int32_t i=t; i<numhdrs; i+=nThreads)
+                hashes[i] = NSPV_hdrhash(&hdrs[i]);
+        });
+    threads.join_all();
+}
+
 int32_t NSPV_validatehdrs(struct NSPV_ntzsproofresp *ptr)
 {
     int32_t i,height,txidht; CTransaction tx; uint256 blockhash,txid,desttxid;
     int16_t momdepthprev, momdepthnext;
     const int32_t VALIDATESIGS = 1;
+    bool fVerified = false;
+    std::vector<uint256> hashes;
 
     /*if (ptr->common.depth != ptr->common.numhdrs)
     {
         fprintf(stderr,"next.%d prev.%d -> %d vs %d\n",ptr->common.nextht,ptr->common.prevht,ptr->common.nextht-ptr->common.prevht+1,ptr->common.numhdrs);
         return(-2);
     } else */
-    if ( NSPV_txextract(tx,ptr->nextntz,ptr->nexttxlen) < 0 )
-        return(-3);
-    else if ( tx.GetHash() != ptr->nexttxid )
-        return(-4);
-    else if ( NSPV_notarizationextract(VALIDATESIGS, &height, &blockhash, &desttxid, &momdepthprev, tx) < 0 )
-        return(-5);
-    else if ( height != ptr->common.nextht )
+    if ( ptr->common.numhdrs <= 0 || ptr->common.hdrs == 0 )
+        return(-2);
+    {
+        LOCK(cs_nspvverifiedntzs);
+        std::map<uint256, std::pair<int32_t, uint256>>::const_iterator it = NSPV_verifiedntzs.find(ptr->nexttxid);
+        if ( it != NSPV_verifiedntzs.end() ) // the txid commits to the tx, its signatures are checked once
+        {
+            height = it->second.first;
+            blockhash = it->second.second;
+            fVerified = true;
+        }
+    }
+    if ( !fVerified )
+    {
+        if ( NSPV_txextract(tx,ptr->nextntz,ptr->nexttxlen) < 0 )
+            return(-3);
+        else if ( tx.GetHash() != ptr->nexttxid )
+            return(-4);
+        else if ( NSPV_notarizationextract(VALIDATESIGS, &height, &blockhash, &desttxid, &momdepthprev, tx) < 0 )
+            return(-5);
+        LOCK(cs_nspvverifiedntzs);
+        if ( NSPV_verifiedntzs.size() >= NSPV_VERIFIEDNTZS_MAX )
+            NSPV_verifiedntzs.clear();
+        NSPV_verifiedntzs[ptr->nexttxid] = std::make_pair(height,blockhash);
+    }
+    if ( height != ptr->common.nextht )
         return(-6);
-    else if ( NSPV_hdrhash(&ptr->common.hdrs[ptr->common.numhdrs-1]) != blockhash )
+    NSPV_hdrhashes(ptr->common.hdrs,ptr->common.numhdrs,hashes);
+    if ( hashes[ptr->common.numhdrs-1] != blockhash )
         return(-7);
     for (i=ptr->common.numhdrs-1; i>0; i--)
     {
-        blockhash = NSPV_hdrhash(&ptr->common.hdrs[i-1]);
+        blockhash = hashes[i-1];
         if ( blockhash != ptr->common.hdrs[i].hashPrevBlock )
             return(-i-13);
     }
@@ -158,6 +204,37 @@ int32_t NSPV_gettransaction(int32_t skipvalidation,int32_t vout,uint256 txid,int
     return retval;
 }
 
+// requests the txproofs of the txids not in the cache from as many peers as there are, before they are validated one by one from the cache
+void NSPV_prefetchtxproofs(const std::vector<uint256> &txids,const std::vector<int32_t> &vouts,const std::vector<int32_t> &heights)
+{
+    std::vector<size_t> missing;
+    for (size_t i=0; i<txids.size(); i++)
+        if ( NSPV_txproof_find(txids[i]) == 0 )
+            missing.push_back(i);
+    for (int32_t iter=0; iter<NSPV_POLLITERS && !missing.empty(); iter++)
+    {
+        std::vector<size_t> stillmissing;
+        BOOST_FOREACH(size_t i,missing)
+        {
+            if ( NSPV_txproof_find(txids[i]) != 0 )
+                continue;
+            stillmissing.push_back(i);
+            if ( iter % (1000000 / NSPV_POLLMICROS) == 0 ) // the peers take one request of a type a second
+            {
+                uint8_t msg[512]; int32_t len = 0, vout = vouts[i], height = heights[i]; uint256 txid = txids[i];
+                msg[len++] = NSPV_TXPROOF;
+                len += iguana_rwnum(1,&msg[len],sizeof(height),&height);
+                len += iguana_rwnum(1,&msg[len],sizeof(vout),&vout);
+                len += iguana_rwbignum(1,&msg[len],sizeof(txid),(uint8_t *)&txid);
+                NSPV_req(0,msg,len,NODE_NSPV,msg[0]>>1);
+            }
+        }
+        missing.swap(stillmissing);
+        if ( !missing.empty() )
+            usleep(NSPV_POLLMICROS);
+    }
+}
+
 int32_t NSPV_vinselect(int32_t *aboveip,int64_t *abovep,int32_t *belowip,int64_t *belowp,struct NSPV_utxoresp utxos[],int32_t numunspents,int64_t value)
 {
     int32_t i,abovei,belowi; int64_t above,below,gap,atx_value;
@@ -210,48 +287,28 @@ int32_t NSPV_vinselect(int32_t *aboveip,int64_t *abovep,int32_t *belowip,int64_t
 
 int64_t NSPV_addinputs(struct NSPV_utxoresp *used,CMutableTransaction &mtx,int64_t total,int32_t maxinputs,struct NSPV_utxoresp *ptr,int32_t num)
 {
-    int32_t abovei,belowi,ind,vout,i,n = 0; int64_t threshold,above,below; int64_t remains,totalinputs = 0; CTransaction tx; struct NSPV_utxoresp utxos[NSPV_MAXVINS],*up;
-    memset(utxos,0,sizeof(utxos));
+    int32_t i,n = 0; int64_t threshold,totalinputs = 0; std::vector<int64_t> values; std::vector<int32_t> picked;
     if ( maxinputs > NSPV_MAXVINS )
         maxinputs = NSPV_MAXVINS;
     if ( maxinputs > 0 )
         threshold = total/maxinputs;
     else threshold = total;
+    std::vector<int32_t> utxoinds;
     for (i=0; i<num; i++)
     {
         if ( num < NSPV_MAXVINS || ptr[i].satoshis > threshold )
-            utxos[n++] = ptr[i];
-    }
-    remains = total;
-    //fprintf(stderr,"threshold %.8f n.%d for total %.8f\n",(double)threshold/COIN,n,(double)total/COIN);
-    for (i=0; i<maxinputs && n>0; i++)
-    {
-        below = above = 0;
-        abovei = belowi = -1;
-        if ( NSPV_vinselect(&abovei,&above,&belowi,&below,utxos,n,remains) < 0 )
         {
-            fprintf(stderr,"error finding unspent i.%d of %d, %.8f vs %.8f\n",i,n,(double)remains/COIN,(double)total/COIN);
-            return(0);
+            utxoinds.push_back(i);
+            values.push_back(ptr[i].satoshis);
         }
-        if ( belowi < 0 || abovei >= 0 )
-            ind = abovei;
-        else ind = belowi;
-        if ( ind < 0 )
-        {
-            fprintf(stderr,"error finding unspent i.%d of %d, %.8f vs %.8f, abovei.%d belowi.%d ind.%d\n",i,n,(double)remains/COIN,(double)total/COIN,abovei,belowi,ind);
-            return(0);
-        }
-        //fprintf(stderr,"i.%d ind.%d abovei.%d belowi.%d n.%d\n",i,ind,abovei,belowi,n);
-        up = &utxos[ind];
+    }
+    //fprintf(stderr,"threshold %.8f n.%d for total %.8f\n",(double)threshold/COIN,(int32_t)values.size(),(double)total/COIN);
+    picked = CC_selectinputs(values,total,maxinputs,totalinputs);
+    for (n=0; n<(int32_t)picked.size(); n++)
+    {
+        struct NSPV_utxoresp *up = &ptr[utxoinds[picked[n]]];
         mtx.vin.push_back(CTxIn(up->txid,up->vout,CScript()));
-        used[i] = *up;
-        totalinputs += up->satoshis;
-        remains -= up->satoshis;
-        utxos[ind] = utxos[--n];
-        memset(&utxos[n],0,sizeof(utxos[n]));
-        //fprintf(stderr,"totalinputs %.8f vs total %.8f i.%d vs max.%d\n",(double)totalinputs/COIN,(double)total/COIN,i,maxinputs);
-        if ( totalinputs >= total || (i+1) >= maxinputs )
-            break;
+        used[n] = *up;
     }
     //fprintf(stderr,"totalinputs %.8f vs total %.8f\n",(double)totalinputs/COIN,(double)total/COIN);
     if ( totalinputs >= total )
@@ -302,10 +359,20 @@ std::string NSPV_signtx(int64_t &rewardsum,int64_t &interestsum,UniValue &retcod
     }
     if ( opret.size() > 0 )
         mtx.vout.push_back(CTxOut(0,opret));
+    {
+        std::vector<uint256> vintxids; std::vector<int32_t> vinvouts,vinheights;
+        for (i=0; i<n; i++)
+        {
+            vintxids.push_back(mtx.vin[i].prevout.hash);
+            vinvouts.push_back(mtx.vin[i].prevout.n);
+            vinheights.push_back(used[i].height);
+        }
+        NSPV_prefetchtxproofs(vintxids,vinvouts,vinheights);
+    }
     for (i=0; i<n; i++)
     {
         utxovout = mtx.vin[i].prevout.n;
-        if ( i > 0 )
+        if ( i > 0 && NSPV_txproof_find(mtx.vin[i].prevout.hash) == 0 )
             sleep(1);
         validation = NSPV_gettransaction(0,utxovout,mtx.vin[i].prevout.hash,used[i].height,vintx,hashBlock,txheight,currentheight,used[i].extradata,NSPV_tiptime,rewardsum);
         retcodes.push_back(validation);
@@ -87,10 +87,83 @@ int32_t getacseason(uint32_t timestamp)
     return(0);
 }
 
+static struct komodo_notaryset KMD_NOTARYSETS[NUM_KMD_SEASONS];
+
+// hardcoded seasons never change once decoded, so the set is built once and then shared read-only by all callers
+const struct komodo_notaryset *komodo_notaryset_season(int32_t kmd_season)
+{
+    struct komodo_notaryset *ns; struct knotary_entry *kp; int32_t i;
+    if ( kmd_season <= 0 || kmd_season > NUM_KMD_SEASONS )
+        return(0);
+    ns = &KMD_NOTARYSETS[kmd_season-1];
+    if ( ns->didinit == 0 )
+    {
+        pthread_mutex_lock(&komodo_mutex);
+        if ( ns->didinit == 0 )
+        {
+            ns->season = kmd_season;
+            ns->numnotaries = NUM_KMD_NOTARIES;
+            for (i=0; i<NUM_KMD_NOTARIES; i++)
+            {
+                decode_hex(ns->pubkeys[i],33,(char *)notaries_elected[kmd_season-1][i][1]);
+                kp = (struct knotary_entry *)calloc(1,sizeof(*kp));
+                memcpy(kp->pubkey,ns->pubkeys[i],33);
+                kp->notaryid = i;
+                HASH_ADD_KEYPTR(hh,ns->Notaries,kp->pubkey,33,kp);
+            }
+            if ( ASSETCHAINS_PRIVATE != 0 )
+            {
+                // this is PIRATE, we need to populate the address array for the notary exemptions.
+                for (i = 0; i<NUM_KMD_NOTARIES; i++)
+                    pubkey2addr((char *)NOTARY_ADDRESSES[kmd_season-1][i],(uint8_t *)ns->pubkeys[i]);
+            }
+            __sync_synchronize();
+            ns->didinit = 1;
+        }
+        pthread_mutex_unlock(&komodo_mutex);
+    }
+    return(ns);
+}
+
+// returns the hardcoded season set active at height/timestamp, or 0 when the notaries come from staked eras or the elected Pubkeys table
+const struct komodo_notaryset *komodo_notaryset_get(int32_t height,uint32_t timestamp)
+{
+    int32_t kmd_season = 0;
+    if ( is_STAKED(ASSETCHAINS_SYMBOL) != 0 )
+        return(0);
+    if ( ASSETCHAINS_SYMBOL[0] == 0 )
+    {
+        // This is KMD, use block heights to determine the KMD notary season..
+        if ( height >= KOMODO_NOTARIES_HARDCODED )
+            kmd_season = getkmdseason(height);
+    }
+    else
+    {
+        // This is a non LABS assetchain, use timestamp to detemine notary pubkeys.
+        if ( timestamp == 0 )
+            timestamp = komodo_heightstamp(height);
+        kmd_season = getacseason(timestamp);
+    }
+    return(komodo_notaryset_season(kmd_season));
+}
+
+int32_t komodo_notaryset_find(const struct komodo_notaryset *ns,uint8_t notarypubs33[64][33],int32_t n,uint8_t *pubkey33)
+{
+    struct knotary_entry *kp; int32_t i;
+    if ( ns != 0 )
+    {
+        HASH_FIND(hh,ns->Notaries,pubkey33,33,kp);
+        return(kp != 0 ? kp->notaryid : -1);
+    }
+    for (i=0; i<n; i++)
+        if ( memcmp(pubkey33,notarypubs33[i],33) == 0 )
+            return(i);
+    return(-1);
+}
+
 int32_t komodo_notaries(uint8_t pubkeys[64][33],int32_t height,uint32_t timestamp)
 {
-    int32_t i,htind,n; uint64_t mask = 0; struct knotary_entry *kp,*tmp;
-    static uint8_t kmd_pubkeys[NUM_KMD_SEASONS][64][33],didinit[NUM_KMD_SEASONS];
+    int32_t i,htind,n; uint64_t mask = 0; struct knotary_entry *kp,*tmp; const struct komodo_notaryset *ns;
     
     if ( timestamp == 0 && ASSETCHAINS_SYMBOL[0] != 0 )
         timestamp = komodo_heightstamp(height);
@@ -100,34 +173,10 @@ int32_t komodo_notaries(uint8_t pubkeys[64][33],int32_t height,uint32_t timestam
     // If this chain is not a staked chain, use the normal Komodo logic to determine notaries. This allows KMD to still sync and use its proper pubkeys for dPoW.
     if ( is_STAKED(ASSETCHAINS_SYMBOL) == 0 )
     {
-        int32_t kmd_season = 0;
-        if ( ASSETCHAINS_SYMBOL[0] == 0 )
-        {
-            // This is KMD, use block heights to determine the KMD notary season.. 
-            if ( height >= KOMODO_NOTARIES_HARDCODED )
-                kmd_season = getkmdseason(height);
-        }
-        else 
-        {
-            // This is a non LABS assetchain, use timestamp to detemine notary pubkeys. 
-            kmd_season = getacseason(timestamp);
-        }
-        if ( kmd_season != 0 )
+        if ( (ns= komodo_notaryset_get(height,timestamp)) != 0 )
         {
-            if ( didinit[kmd_season-1] == 0 )
-            {
-                for (i=0; i<NUM_KMD_NOTARIES; i++) 
-                    decode_hex(kmd_pubkeys[kmd_season-1][i],33,(char *)notaries_elected[kmd_season-1][i][1]);
-                if ( ASSETCHAINS_PRIVATE != 0 )
-                {
-                    // this is PIRATE, we need to populate the address array for the notary exemptions. 
-                    for (i = 0; i<NUM_KMD_NOTARIES; i++)
-                        pubkey2addr((char *)NOTARY_ADDRESSES[kmd_season-1][i],(uint8_t *)kmd_pubkeys[kmd_season-1][i]);
-                }
-                didinit[kmd_season-1] = 1;
-            }
-            memcpy(pubkeys,kmd_pubkeys[kmd_season-1],NUM_KMD_NOTARIES * 33);
-            return(NUM_KMD_NOTARIES);
+            memcpy(pubkeys,ns->pubkeys,ns->numnotaries * 33);
+            return(ns->numnotaries);
         }
     }
     else if ( timestamp != 0 )
@@ -170,7 +219,12 @@ int32_t komodo_notaries(uint8_t pubkeys[64][33],int32_t height,uint32_t timestam
 
 int32_t komodo_electednotary(int32_t *numnotariesp,uint8_t *pubkey33,int32_t height,uint32_t timestamp)
 {
-    int32_t i,n; uint8_t pubkeys[64][33];
+    int32_t i,n; uint8_t pubkeys[64][33]; const struct komodo_notaryset *ns;
+    if ( (ns= komodo_notaryset_get(height,ASSETCHAINS_SYMBOL[0] != 0 ? timestamp : 0)) != 0 )
+    {
+        *numnotariesp = ns->numnotaries;
+        return(komodo_notaryset_find(ns,0,0,pubkey33));
+    }
     n = komodo_notaries(pubkeys,height,timestamp);
     *numnotariesp = n;
     for (i=0; i<n; i++)
@@ -288,11 +342,36 @@ int32_t komodo_chosennotary(int32_t *notaryidp,int32_t height,uint8_t *pubkey33,
 
 //struct komodo_state *komodo_stateptr(char *symbol,char *dest);
 
+// returns the most recent checkpoint whose MoM range (notarized_height-MoMdepth,notarized_height] contains height
 struct notarized_checkpoint *komodo_npptr_for_height(int32_t height, int *idx)
 {
-    char symbol[KOMODO_ASSETCHAIN_MAXLEN],dest[KOMODO_ASSETCHAIN_MAXLEN]; int32_t i; struct komodo_state *sp; struct notarized_checkpoint *np = 0;
+    char symbol[KOMODO_ASSETCHAIN_MAXLEN],dest[KOMODO_ASSETCHAIN_MAXLEN]; int32_t i,lo,hi,mid; struct komodo_state *sp; struct notarized_checkpoint *np = 0;
     if ( (sp= komodo_stateptr(symbol,dest)) != 0 )
     {
+        if ( sp->MoMPOINTS_unsorted == 0 )
+        {
+            // both ends of the ranges never decrease, so only the last range starting below height can contain it
+            lo = 0, hi = sp->NUM_MoMPOINTS;
+            while ( lo < hi )
+            {
+                mid = lo + (hi - lo) / 2;
+                np = &sp->NPOINTS[sp->MoMPOINTS[mid]];
+                if ( np->notarized_height-(np->MoMdepth&0xffff) < height )
+                    lo = mid + 1;
+                else hi = mid;
+            }
+            if ( lo > 0 )
+            {
+                np = &sp->NPOINTS[sp->MoMPOINTS[lo-1]];
+                if ( height <= np->notarized_height )
+                {
+                    *idx = sp->MoMPOINTS[lo-1];
+                    return(np);
+                }
+            }
+            *idx = -1;
+            return(0);
+        }
         for (i=sp->NUM_NPOINTS-1; i>=0; i--)
         {
             *idx = i;
@@ -362,25 +441,50 @@ int32_t komodo_notarized_height(int32_t *prevMoMheightp,uint256 *hashp,uint256 *
     } else return(0);
 }
 
-int32_t komodo_dpowconfs(int32_t txheight,int32_t numconfs)
+// snapshot of the notarization state komodo_dpowconfs compares against: 0 to report confirmations unchanged, -1 to report 1 confirmation until a notarization is active again, otherwise the notarized height
+int32_t komodo_dpowconfs_snapshot()
 {
     static int32_t hadnotarization;
     char symbol[KOMODO_ASSETCHAIN_MAXLEN],dest[KOMODO_ASSETCHAIN_MAXLEN]; struct komodo_state *sp;
-    if ( KOMODO_DPOWCONFS != 0 && txheight > 0 && numconfs > 0 && (sp= komodo_stateptr(symbol,dest)) != 0 )
+    if ( KOMODO_DPOWCONFS != 0 && (sp= komodo_stateptr(symbol,dest)) != 0 )
     {
         if ( sp->NOTARIZED_HEIGHT > 0 )
         {
             hadnotarization = 1;
-            if ( txheight < sp->NOTARIZED_HEIGHT )
-                return(numconfs);
-            else return(1);
+            return(sp->NOTARIZED_HEIGHT);
         }
         else if ( hadnotarization != 0 )
-            return(1);
+            return(-1);
+    }
+    return(0);
+}
+
+int32_t komodo_dpowconfs_at(int32_t ntzheight,int32_t txheight,int32_t numconfs)
+{
+    if ( ntzheight != 0 && txheight > 0 && numconfs > 0 )
+    {
+        if ( ntzheight > 0 && txheight < ntzheight )
+            return(numconfs);
+        else return(1);
     }
     return(numconfs);
 }
 
+int32_t komodo_dpowconfs(int32_t txheight,int32_t numconfs)
+{
+    if ( txheight > 0 && numconfs > 0 )
+        return(komodo_dpowconfs_at(komodo_dpowconfs_snapshot(),txheight,numconfs));
+    return(numconfs);
+}
+
+// converts n raw confirmation counts in place against a single notarization snapshot
+void komodo_dpowconfs_many(int32_t n,const int32_t *txheights,int32_t *numconfs)
+{
+    int32_t i,ntzheight = komodo_dpowconfs_snapshot();
+    for (i=0; i<n; i++)
+        numconfs[i] = komodo_dpowconfs_at(ntzheight,txheights[i],numconfs[i]);
+}
+
 int32_t komodo_MoMdata(int32_t *notarized_htp,uint256 *MoMp,uint256 *kmdtxidp,int32_t height,uint256 *MoMoMp,int32_t *MoMoMoffsetp,int32_t *MoMoMdepthp,int32_t *kmdstartip,int32_t *kmdendip)
 {
     struct notarized_checkpoint *np = 0;
@@ -479,6 +583,21 @@ void komodo_notarized_update(struct komodo_state *sp,int32_t nHeight,int32_t not
     sp->NOTARIZED_DESTTXID = np->notarized_desttxid = notarized_desttxid;
     sp->MoM = np->MoM = MoM;
     sp->MoMdepth = np->MoMdepth = MoMdepth;
+    if ( MoMdepth != 0 )
+    {
+        if ( sp->NUM_MoMPOINTS > 0 )
+        {
+            struct notarized_checkpoint *prev = &sp->NPOINTS[sp->MoMPOINTS[sp->NUM_MoMPOINTS-1]];
+            if ( notarized_height < prev->notarized_height || notarized_height-(MoMdepth&0xffff) < prev->notarized_height-(prev->MoMdepth&0xffff) )
+            {
+                if ( sp->MoMPOINTS_unsorted == 0 )
+                    fprintf(stderr,"komodo_notarized_update MoM range of ht.%d out of order, using linear checkpoint lookups\n",notarized_height);
+                sp->MoMPOINTS_unsorted = 1;
+            }
+        }
+        sp->MoMPOINTS = (int32_t *)realloc(sp->MoMPOINTS,(sp->NUM_MoMPOINTS+1) * sizeof(*sp->MoMPOINTS));
+        sp->MoMPOINTS[sp->NUM_MoMPOINTS++] = sp->NUM_NPOINTS-1;
+    }
     portable_mutex_unlock(&komodo_mutex);
 }
 
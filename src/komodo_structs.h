@@ -86,6 +86,7 @@ struct pax_transaction
 
 struct knotary_entry { UT_hash_handle hh; uint8_t pubkey[33],notaryid; };
 struct knotaries_entry { int32_t height,numnotaries; struct knotary_entry *Notaries; };
+struct komodo_notaryset { volatile int32_t didinit; int32_t season,numnotaries; uint8_t pubkeys[64][33]; struct knotary_entry *Notaries; };
 struct notarized_checkpoint
 {
     uint256 notarized_hash,notarized_desttxid,MoM,MoMoM;
@@ -123,7 +124,9 @@ struct komodo_state
     uint32_t SAVEDTIMESTAMP;
     uint64_t deposited,issued,withdrawn,approved,redeemed,shorted;
     struct notarized_checkpoint *NPOINTS; int32_t NUM_NPOINTS,last_NPOINTSi;
-    struct komodo_event **Komodo_events; int32_t Komodo_numevents;
+    int32_t *MoMPOINTS,NUM_MoMPOINTS,MoMPOINTS_unsorted; // NPOINTS indexes with MoMdepth != 0, see komodo_npptr_for_height
+    struct komodo_event **Komodo_events; int32_t Komodo_numevents,Komodo_maxevents;
+    int32_t Komodo_eventsfloor,Komodo_numcompacted; // events below Komodo_eventsfloor were folded into the state fields, see komodo_event_compact
     uint32_t RTbufs[64][3]; uint64_t RTmask;
 };
 
@@ -136,6 +136,8 @@ void AdvertizeLocalWebSockets(CNode *pnode)
 }
 
 class CWsNode;
+class CWsEndpointWrapper;
+void WebSocketSendData(CWsEndpointWrapper *pEndPoint, websocketpp::connection_hdl hdl, CWsNode *pnode);
 
 // base wrapper class both for server and outbound endpoints
 class CWsEndpointWrapper {
@@ -146,6 +148,8 @@ public:
 
     virtual void close(websocketpp::connection_hdl hdl, websocketpp::close::status::value) = 0;
     virtual void sendWsData(CWsNode *pNode) = 0;
+    /** Largest frame several whole messages are packed into, 0 to send a frame per message */
+    virtual size_t maxBatchSize() const { return 0; }
 };
 
 typedef std::shared_ptr<CWsEndpointWrapper> ws_endpoint_ptr;
@@ -183,6 +187,14 @@ public:
                     nLocalHostNonce, strSubVersion, nBestHeight, true);
     }
 
+    // websocketpp queues the frames on the connection and writes them from its asio
+    // loop, so a message is handed over as soon as it is queued
+    virtual void SendQueuedData()
+    {
+        if (m_spWsEndpoint)
+            WebSocketSendData(m_spWsEndpoint.get(), m_hdl, this);
+    }
+
     ~CWsNode() {
         wsaddrman.Connected(addr);
     }
@@ -602,29 +614,40 @@ bool SendWsMessages(CWsNode *pto, bool fTrickle)
 // requires LOCK(cs_vSend)
 void WebSocketSendData(CWsEndpointWrapper *pEndPoint, websocketpp::connection_hdl hdl, CWsNode *pnode)
 {
-    std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
+    std::deque<CSharedMessage>::iterator it = pnode->vSendMsg.begin();
     pnode->closeErrorOnSend = 0;
+    size_t nMaxBatchSize = pEndPoint->maxBatchSize();
 
     while (it != pnode->vSendMsg.end()) {
-        const CSerializeData &data = *it;
+        const CSerializeData &data = **it;
         assert(data.size() > pnode->nSendOffset);
         websocketpp::lib::error_code ec;
-        int nBytes = data.size() - pnode->nSendOffset;
-        pEndPoint->send(hdl, &data[pnode->nSendOffset], nBytes, websocketpp::frame::opcode::binary, ec);  // should not throw ws exception as ec is passed
+        const char *pch = &data[pnode->nSendOffset];
+        size_t nBytes = data.size() - pnode->nSendOffset;
+
+        // the peer parses the frames as a byte stream, so whole messages can share a frame
+        std::deque<CSharedMessage>::iterator itEnd = it + 1;
+        CSerializeData batch;
+        if (nMaxBatchSize > 0 && pnode->nSendOffset == 0) {
+            while (itEnd != pnode->vSendMsg.end() && nBytes + (*itEnd)->size() <= nMaxBatchSize)
+                nBytes += (*itEnd++)->size();
+            if (itEnd != it + 1) {
+                batch.reserve(nBytes);
+                for (std::deque<CSharedMessage>::iterator jt = it; jt != itEnd; jt++)
+                    batch.insert(batch.end(), (*jt)->begin(), (*jt)->end());
+                pch = &batch[0];
+            }
+        }
+        pEndPoint->send(hdl, pch, nBytes, websocketpp::frame::opcode::binary, ec);  // should not throw ws exception as ec is passed
 
         if (!ec) {
+            // websocketpp takes the whole frame
             pnode->nLastSend = GetTime();  // needed to prevent inactivity disconnect
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             pnode->RecordBytesSent(nBytes);
-            if (pnode->nSendOffset == data.size()) {
-                pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
-                it++;
-            } else {
-                // could not send full message; stop sending more
-                break;
-            }
+            pnode->nSendSize -= pnode->nSendOffset + nBytes;
+            pnode->nSendOffset = 0;
+            it = itEnd;
         } else {  // error
             // int nErr = WSAGetLastError();
             // if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)  // no similar errs in websocketpp...
@@ -645,25 +668,107 @@ void WebSocketSendData(CWsEndpointWrapper *pEndPoint, websocketpp::connection_hd
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
 }
 
-void HandleWebSocketMessage(CWsEndpointWrapper *pEndPoint, CWsNode *pNode, websocketpp::connection_hdl hdl, wsserver::message_ptr msg)
+/**
+ * Runs ProcessMessages for the websocket peers off the asio threads, so a
+ * slow nSPV request doesn't hold up the reads and writes of the other
+ * connections. A peer is queued at most once however many frames it sent,
+ * its messages are processed in order under its cs_vRecvMsg.
+ */
+class CWsMessageWorkers
+{
+public:
+    CWsMessageWorkers() : fStop(false) {}
+
+    void Start(int nThreads)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = false;
+        for (int i = 0; i < nThreads; i++)
+            workers.create_thread(boost::bind(&CWsMessageWorkers::Thread, this));
+    }
+
+    void Schedule(const CWsNodePtr &pNode)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            if (fStop || !setQueued.insert(pNode.get()).second)
+                return;
+            queue.push_back(pNode);
+        }
+        cond.notify_one();
+    }
+
+    void Stop()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fStop = true;
+        }
+        cond.notify_all();
+        workers.join_all();
+        boost::unique_lock<boost::mutex> lock(cs);
+        queue.clear();
+        setQueued.clear();
+    }
+
+private:
+    void Thread()
+    {
+        RenameThread("komodo-wswork");
+        while (true) {
+            CWsNodePtr pNode;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (!fStop && queue.empty())
+                    cond.wait(lock);
+                if (fStop)
+                    return;
+                pNode = queue.front();
+                queue.pop_front();
+                // frames received from now on queue the peer again
+                setQueued.erase(pNode.get());
+            }
+            if (pNode->fDisconnect)
+                continue;
+            try {
+                LOCK(pNode->cs_vRecvMsg);
+                ProcessMessages(pNode.get());
+            } catch (const std::exception& e) {
+                PrintExceptionContinue(&e, "CWsMessageWorkers::Thread()");
+            } catch (...) {
+                PrintExceptionContinue(NULL, "CWsMessageWorkers::Thread()");
+            }
+        }
+    }
+
+    bool fStop;
+    boost::mutex cs;
+    boost::condition_variable cond;
+    std::deque<CWsNodePtr> queue;
+    std::set<CWsNode*> setQueued;
+    boost::thread_group workers;
+};
+
+static CWsMessageWorkers wsMessageWorkers;
+
+void HandleWebSocketMessage(const CWsNodePtr &pNode, wsserver::message_ptr msg)
 {
     pNode->closeErrorOnReceive = 0;
 
-    LOCK(pNode->cs_vRecvMsg);
-    if (pNode->ReceiveMsgBytes(msg->get_payload().c_str(), msg->get_payload().size())) {
+    {
+        LOCK(pNode->cs_vRecvMsg);
+        if (!pNode->ReceiveMsgBytes(msg->get_payload().c_str(), msg->get_payload().size())) {
+            LogPrint("websockets", "error websocket message processing, disconnecting peer %d\n", pNode->id);
+            pNode->closeErrorOnReceive = websocketpp::close::status::unsupported_data;
+            pNode->fDisconnect = true;
+            return;
+        }
         pNode->nLastRecv = GetTime(); // needed to prevent inactivity disconnect
         pNode->nRecvBytes += msg->get_payload().size();
         pNode->RecordBytesRecv(msg->get_payload().size());
-        if (ProcessMessages(pNode)) {
-            LOCK(pNode->cs_vSend); 
-            WebSocketSendData(pEndPoint, hdl, pNode);
-        }
-    }
-    else {
-        LogPrint("websockets", "error websocket message processing, disconnecting peer %d\n", pNode->id);
-        pNode->closeErrorOnReceive = websocketpp::close::status::unsupported_data;
-        pNode->fDisconnect = true;
     }
+    // the replies are sent as they are queued, see CWsNode::SendQueuedData
+    wsMessageWorkers.Schedule(pNode);
 }
 
 
@@ -672,6 +777,8 @@ public:
     bool init() {
 
         LogPrintf("Starting websockets listener\n");
+        // browser clients may expect a message per frame, batching is opt-in
+        m_nMaxBatchSize = std::max((int64_t)0, GetArg("-wsbatchsize", DEFAULT_WS_BATCH_SIZE));
 
         try {
 
@@ -733,7 +840,7 @@ public:
         //std::cerr << __func__ << " payload=" << HexStr(msg->get_payload()) << std::endl;
         //m_endpoint.send(hdl, msg->get_payload(), msg->get_opcode());
         CAddress clientAddr = GetClientAddressFromHdl(hdl);
-        LOCK(cs_vWsNodes);
+        // FindWsNode takes cs_vWsNodes, the node is kept alive by its shared pointer
         CWsNodePtr pNode = FindWsNode(clientAddr);
         //CWsNode *pNode = m_connections[hdl];
         if (!pNode) {
@@ -745,7 +852,7 @@ public:
 
         //std::cerr << __func__ << " pnode found=" << clientAddr.ToStringIPPort() << " id=" << pNode->id << std::endl;
 
-        HandleWebSocketMessage(this, pNode.get(), hdl, msg);       
+        HandleWebSocketMessage(pNode, msg);
     }
 
     void stop()
@@ -799,6 +906,8 @@ public:
         m_endpoint.send(hdl, payload, len, op, ec);
     }
 
+    virtual size_t maxBatchSize() const { return m_nMaxBatchSize; }
+
 private:
     bool on_validate(websocketpp::connection_hdl hdl)
     {
@@ -936,6 +1045,7 @@ private:
     }
 private:
     wsserver m_endpoint;
+    size_t m_nMaxBatchSize;
 };
 
 // object to try peer websocket nodes
@@ -1042,7 +1152,8 @@ public:
         }
     }
     void on_message(websocketpp::connection_hdl hdl, wsclient::message_ptr msg) {
-        HandleWebSocketMessage(this, m_pNode.get(), hdl, msg);
+        if (m_pNode)
+            HandleWebSocketMessage(m_pNode, msg);
     }
     void on_close(websocketpp::connection_hdl) {
         if ((bool)m_pNode) { 
@@ -1191,14 +1302,23 @@ void ThreadWebSocketMessageHandler()
             if (pnode->fDisconnect)
                 continue;
 
+            // Messages the workers left behind, e.g. while a block getdata of the peer was served
+            {
+                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+                if (lockRecv && !pnode->vRecvMsg.empty() && pnode->vRecvMsg.front().complete())
+                    wsMessageWorkers.Schedule(pnode);
+            }
+
             // Send messages
             {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
                 if (lockSend)   {
                     bool fTrickle = pnode == pnodeTrickle || pnode->fWhitelisted;
                     SendWsMessages(pnode.get(), fTrickle);
+                    // queued messages are sent right away, this retries what a failed send left
+                    if (!pnode->vSendMsg.empty())
+                        WebSocketSendData(pnode->m_spWsEndpoint.get(), pnode->m_hdl, pnode.get());
                     if (fTrickle) {
-                        WebSocketSendData(pnode->m_spWsEndpoint.get(), pnode->m_hdl, pnode.get());  
                         if (pnode->closeErrorOnSend || pnode->closeErrorOnReceive) {
                             try {
                                pnode->m_spWsEndpoint->close(pnode->m_hdl, (pnode->closeErrorOnSend ? pnode->closeErrorOnSend : pnode->closeErrorOnReceive));              
@@ -1544,6 +1664,8 @@ static void ThreadOpenAddedWebSocketConnections()
 
 bool StartWebSockets(boost::thread_group& threadGroup) 
 {
+    wsMessageWorkers.Start(std::max(1, (int)GetArg("-wsworkerthreads", DEFAULT_WS_WORKER_THREADS)));
+
     spWebSocketServer.reset(new CWebSocketServer);
 
     if (!static_cast<CWebSocketServer*>(spWebSocketServer.get())->init())
@@ -1619,6 +1741,7 @@ void StopWebSockets()
 
     wsThreadGroup.interrupt_all();
     wsThreadGroup.join_all();
+    wsMessageWorkers.Stop();
 
     LogPrintf("All websockets threads stopped\n");
 
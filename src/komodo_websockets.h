@@ -28,7 +28,9 @@
 #include <websocketpp/client.hpp>
 #include <websocketpp/endpoint.hpp>
 #include <websocketpp/connection.hpp>
-//#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+#ifdef WEBSOCKETS_PERMESSAGE_DEFLATE
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+#endif
 
 //using websocketpp::lib::bind;
 
@@ -36,6 +38,10 @@ namespace ws
 {
 
 static const int WSADDR_VERSION = 170008;
+/** -wsbatchsize default (largest websocket frame the listener packs several protocol messages into, 0 = one message per frame) */
+static const int DEFAULT_WS_BATCH_SIZE = 0;
+/** -wsworkerthreads default (number of threads processing the websocket peers' messages) */
+static const int DEFAULT_WS_WORKER_THREADS = 2;
 #define WEBSOCKETS_TIMEOUT_INTERVAL 120
 
 
@@ -49,11 +55,14 @@ struct wsserver_mt_config : public websocketpp::config::asio {  // no tls
         static bool const enable_multithreading = true;
     };
 
-    /// permessage_compress extension
-    // struct permessage_deflate_config {};
+#ifdef WEBSOCKETS_PERMESSAGE_DEFLATE
+    /// permessage_compress extension, negotiated with the clients that offer it. Build with
+    /// -DWEBSOCKETS_PERMESSAGE_DEFLATE and link zlib (-lz), which the depends tree doesn't provide
+    struct permessage_deflate_config {};
 
-    // typedef websocketpp::extensions::permessage_deflate::enabled
-    //     <permessage_deflate_config> permessage_deflate_type;
+    typedef websocketpp::extensions::permessage_deflate::enabled
+        <permessage_deflate_config> permessage_deflate_type;
+#endif
 };
 
 typedef websocketpp::server<wsserver_mt_config> wsserver;   // no tls
@@ -26,6 +26,23 @@
 #include "addrman.h"
 #include "alert.h"
 #include "arith_uint256.h"
+#include "blockcompress.h"
+#include "blockencodings.h"
+#include "blockfilterindex.h"
+#include "cc/CCtxcache.h"
+#include "cc/CCassetsbook.h"
+#include "cc/CCrewardsbook.h"
+#include "cc/CCheirbook.h"
+#include "cc/CCdicebook.h"
+#include "cc/CCchannelsbook.h"
+#include "cc/CCpegsbook.h"
+#include "cc/CCtokencache.h"
+#include "cc/CCtokenbalance.h"
+#include "cc/CCoraclesindex.h"
+#include "cc/CCtokentagsindex.h"
+#include "cc/CCagreementsindex.h"
+#include "cc/CCgatewaysindex.h"
+#include "cc/CCstats.h"
 #include "importcoin.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -77,6 +94,7 @@ using namespace std;
 #endif
 
 #include "librustzcash.h"
+#include "zcash/Params.hpp"
 
 /**
  * Global state
@@ -88,12 +106,24 @@ int32_t KOMODO_NEWBLOCKS;
 
 
 BlockMap mapBlockIndex;
+/** Owns every CBlockIndex in mapBlockIndex, released in UnloadBlockIndex */
+static CBlockIndexArena blockIndexArena;
 CChain chainActive;
+/** The logical timestamps of chainActive for active only timestamp queries, built by the first one and followed by UpdateTip */
+static CChainLogicalTimes chainActiveLogicalTimes;
 CBlockIndex *pindexBestHeader = NULL;
 static int64_t nTimeBestReceived = 0;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
+bool fParallelCCEval = DEFAULT_PARALLEL_CCEVAL;
+bool fCheckHeaderSolutions = DEFAULT_CHECK_HEADER_SOLUTIONS;
+bool fCompactBlocks = DEFAULT_CMPCTBLOCKS;
+int64_t nTxInvInterval = DEFAULT_TXINV_INTERVAL;
+bool fCompressBlocks = DEFAULT_COMPRESS_BLOCKS;
+unsigned int nBlockFileChunkSize = BLOCKFILE_CHUNK_SIZE;
+unsigned int nUndoFileChunkSize = UNDOFILE_CHUNK_SIZE;
+bool fDropBlockCache = DEFAULT_DROP_BLOCK_CACHE;
 bool fExperimentalMode = true;
 bool fImporting = false;
 bool fReindex = false;
@@ -103,14 +133,22 @@ bool fTimestampIndex = false;
 bool fSpentIndex = false;
 bool fHavePruned = false;
 bool fPruneMode = false;
+bool fPruneKeepTxs = false;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = true;
+uint256 hashAssumeNotarized;
 bool fCoinbaseEnforcedProtectionEnabled = true;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
 bool fAlerts = DEFAULT_ALERTS;
 bool fUnspentCCIndex = false;
+bool fTokenBalanceIndex = false;
+bool fOraclesIndex = false;
+bool fTokenTagsIndex = false;
+bool fAgreementsIndex = false;
+bool fGatewaysIndex = false;
+bool fAddressBalanceIndex = false;
 
 /* If the tip is older than this (in seconds), the node is considered to be in initial block download.
  */
@@ -127,10 +165,15 @@ CTxMemPool tmpmempool(::minRelayTxFee);
 struct COrphanTx {
     CTransaction tx;
     NodeId fromPeer;
+    unsigned int nTxSize;
 };
 map<uint256, COrphanTx> mapOrphanTransactions GUARDED_BY(cs_main);;
-map<uint256, set<uint256> > mapOrphanTransactionsByPrev GUARDED_BY(cs_main);;
+map<COutPoint, set<uint256> > mapOrphanTransactionsByPrev GUARDED_BY(cs_main);;  //!< orphans by the outpoints they spend
+map<NodeId, size_t> mapOrphanBytesByPeer GUARDED_BY(cs_main);
+vector<uint256> vOrphanWorkQueue GUARDED_BY(cs_main);  //!< txids of connected blocks with orphans spending their outputs
+COrphanPoolInfo orphanPoolInfo GUARDED_BY(cs_main);
 void EraseOrphansFor(NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+static void ProcessQueuedOrphans();
 
 /**
  * Returns true if there are nRequired or more blocks of minVersion or above
@@ -268,9 +311,15 @@ namespace {
     /** Number of blocks in flight with validated headers. */
     int nQueuedValidatedHeaders = 0;
 
+    /** Moving average of the serialized size of the blocks we requested and received, 0 until the first one. */
+    int64_t nAvgBlockDownloadSize = 0;
+
     /** Number of preferable block download peers. */
     int nPreferredDownload = 0;
 
+    /** Peers asked to push new blocks to us as compact blocks, oldest first. Protected by cs_main. */
+    list<NodeId> lNodesAnnouncingHeaderAndIDs;
+
     /** Dirty block index entries. */
     set<CBlockIndex*> setDirtyBlockIndex;
 
@@ -320,11 +369,21 @@ namespace {
         bool fSyncStarted;
         //! Since when we're stalling block download progress (in microseconds), or 0.
         int64_t nStallingSince;
+        //! Moving average of the time (in microseconds) this peer takes to deliver one requested block, or 0.
+        int64_t nAvgBlockServiceTime;
+        //! When this peer last delivered a block we requested (in microseconds), or 0.
+        int64_t nLastBlockReceived;
         list<QueuedBlock> vBlocksInFlight;
         int nBlocksInFlight;
         int nBlocksInFlightValidHeaders;
         //! Whether we consider this a preferred download peer.
         bool fPreferredDownload;
+        //! Whether this peer sends us compact blocks when asked to (it sent sendcmpct).
+        bool fProvidesHeaderAndIDs;
+        //! Whether this peer wants new blocks pushed as compact blocks without an announcement.
+        bool fPreferHeaderAndIDs;
+        //! The compact block of this peer we wait for the missing txns of with getblocktxn.
+        std::shared_ptr<PartiallyDownloadedBlock> partialBlock;
 
         CNodeState() {
             fCurrentlyConnected = false;
@@ -335,9 +394,13 @@ namespace {
             pindexLastCommonBlock = NULL;
             fSyncStarted = false;
             nStallingSince = 0;
+            nAvgBlockServiceTime = 0;
+            nLastBlockReceived = 0;
             nBlocksInFlight = 0;
             nBlocksInFlightValidHeaders = 0;
             fPreferredDownload = false;
+            fProvidesHeaderAndIDs = false;
+            fPreferHeaderAndIDs = false;
         }
     };
 
@@ -385,6 +448,37 @@ namespace {
         return nTime + 500000 * consensusParams.nPowTargetSpacing * (4 + nValidatedQueuedBefore);
     }
 
+    // Requires cs_main.
+    // Number of blocks to keep in flight from one peer: enough to have BLOCKS_IN_TRANSIT_BYTES_PER_PEER
+    // on the wire at the average block size seen, so chains of small blocks are not latency bound.
+    int MaxBlocksInTransitPerPeer()
+    {
+        if (nAvgBlockDownloadSize <= 0)
+            return MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+        int64_t nBlocks = BLOCKS_IN_TRANSIT_BYTES_PER_PEER / nAvgBlockDownloadSize;
+        return (int)std::max<int64_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER, std::min<int64_t>(MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER, nBlocks));
+    }
+
+    // Requires cs_main.
+    // The download window grows with the in-flight count, so that all peers can be kept busy.
+    unsigned int BlockDownloadWindow()
+    {
+        if (BLOCK_DOWNLOAD_WINDOW <= 1)
+            return BLOCK_DOWNLOAD_WINDOW;
+        return std::max<unsigned int>(BLOCK_DOWNLOAD_WINDOW, 64 * MaxBlocksInTransitPerPeer());
+    }
+
+    // Requires cs_main.
+    // Stalling timeout of a peer in microseconds: a few of its block delivery times, between
+    // MIN_BLOCK_STALLING_TIMEOUT_MS and BLOCK_STALLING_TIMEOUT.
+    int64_t GetBlockStallingTimeout(const CNodeState &state)
+    {
+        int64_t nMax = 1000000 * (int64_t)BLOCK_STALLING_TIMEOUT;
+        if (state.nAvgBlockServiceTime <= 0)
+            return nMax;
+        return std::max<int64_t>(1000 * (int64_t)MIN_BLOCK_STALLING_TIMEOUT_MS, std::min<int64_t>(nMax, 8 * state.nAvgBlockServiceTime));
+    }
+
     void InitializeNode(NodeId nodeid, const CNode *pnode) {
         LOCK(cs_main);
         CNodeState &state = mapNodeState.insert(std::make_pair(nodeid, CNodeState())).first->second;
@@ -407,6 +501,7 @@ namespace {
         mapBlocksInFlight.erase(entry.hash);
         EraseOrphansFor(nodeid);
         nPreferredDownload -= state->fPreferredDownload;
+        lNodesAnnouncingHeaderAndIDs.remove(nodeid);
 
         mapNodeState.erase(nodeid);
     }
@@ -425,10 +520,20 @@ namespace {
 
     // Requires cs_main.
     // Returns a bool indicating whether we requested this block.
-    bool MarkBlockAsReceived(const uint256& hash) {
+    // A non-zero nBlockSize means the block itself arrived, and feeds the download statistics.
+    bool MarkBlockAsReceived(const uint256& hash, int64_t nBlockSize = 0) {
         map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
         if (itInFlight != mapBlocksInFlight.end()) {
             CNodeState *state = State(itInFlight->second.first);
+            if (nBlockSize > 0) {
+                nAvgBlockDownloadSize = nAvgBlockDownloadSize == 0 ? nBlockSize : (7 * nAvgBlockDownloadSize + nBlockSize) / 8;
+                // Time since the request, or since the previous block if the peer was busy with it
+                int64_t nNow = GetTimeMicros();
+                int64_t nServiceTime = nNow - std::max(itInFlight->second.second->nTime, state->nLastBlockReceived);
+                if (nServiceTime >= 0)
+                    state->nAvgBlockServiceTime = state->nAvgBlockServiceTime == 0 ? nServiceTime : (7 * state->nAvgBlockServiceTime + nServiceTime) / 8;
+                state->nLastBlockReceived = nNow;
+            }
             nQueuedValidatedHeaders -= itInFlight->second.second->fValidatedHeaders;
             state->nBlocksInFlightValidHeaders -= itInFlight->second.second->fValidatedHeaders;
             state->vBlocksInFlight.erase(itInFlight->second.second);
@@ -457,6 +562,37 @@ namespace {
         mapBlocksInFlight[hash] = std::make_pair(nodeid, it);
     }
 
+    /**
+     * Asks a peer that just gave us a new block first to push its next ones
+     * as compact blocks, and the oldest such peer beyond
+     * MAX_CMPCTBLOCK_ANNOUNCERS to announce them again. Requires cs_main.
+     */
+    void MaybeSetPeerAsAnnouncingHeaderAndIDs(CNode* pfrom) {
+        CNodeState *state = State(pfrom->GetId());
+        if (state == NULL || !state->fProvidesHeaderAndIDs)
+            return;
+        for (list<NodeId>::iterator it = lNodesAnnouncingHeaderAndIDs.begin(); it != lNodesAnnouncingHeaderAndIDs.end(); it++) {
+            if (*it == pfrom->GetId()) {
+                lNodesAnnouncingHeaderAndIDs.erase(it);
+                lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
+                return;
+            }
+        }
+        if (lNodesAnnouncingHeaderAndIDs.size() >= MAX_CMPCTBLOCK_ANNOUNCERS) {
+            NodeId evicted = lNodesAnnouncingHeaderAndIDs.front();
+            lNodesAnnouncingHeaderAndIDs.pop_front();
+            LOCK(cs_vNodes);
+            BOOST_FOREACH(CNode* pnode, vNodes) {
+                if (pnode->GetId() == evicted) {
+                    pnode->PushMessage("sendcmpct", false, CMPCTBLOCKS_VERSION);
+                    break;
+                }
+            }
+        }
+        pfrom->PushMessage("sendcmpct", true, CMPCTBLOCKS_VERSION);
+        lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
+    }
+
     /** Check whether the last unknown block a peer advertized is not yet known. */
     void ProcessBlockAvailability(NodeId nodeid) {
         CNodeState *state = State(nodeid);
@@ -548,7 +684,7 @@ namespace {
         // download that next block if the window were 1 larger.
         if ( ASSETCHAINS_CBOPRET != 0 && IsInitialBlockDownload() == 0 )
             BLOCK_DOWNLOAD_WINDOW = 1;
-        int nWindowEnd = state->pindexLastCommonBlock->GetHeight() + BLOCK_DOWNLOAD_WINDOW;
+        int nWindowEnd = state->pindexLastCommonBlock->GetHeight() + BlockDownloadWindow();
         int nMaxHeight = std::min<int>(state->pindexBestKnownBlock->GetHeight(), nWindowEnd + 1);
         NodeId waitingfor = -1;
         while (pindexWalk->GetHeight() < nMaxHeight) {
@@ -651,6 +787,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewCache *pcoinsTip = NULL;
+CCoinsViewBackgroundFlush *pcoinsflush = NULL;
 CBlockTreeDB *pblocktree = NULL;
 
 // Komodo globals
@@ -689,6 +826,90 @@ bool komodo_snapshot2(std::map <std::string, CAmount> &addressAmounts)
 int32_t lastSnapShotHeight = 0;
 std::vector <std::pair<CAmount, CTxDestination>> vAddressSnapshot;
 
+bool getAddressFromIndex(const int &type, const uint160 &hash, std::string &address);
+
+// Snapshot2 balances at the tip of the last daily snapshot, the next one advances them instead of walking the address index again
+std::map <std::string, CAmount> snapshotTipAmounts;
+int32_t snapshotTipHeight = -1;
+uint256 snapshotTipHash;
+
+// adds (or removes) out to the Snapshot2 balances, under the address index entries ConnectBlock records for it
+static void komodo_snapshotapply(std::map <std::string, CAmount> &addressAmounts, const CTxOut &out, bool fReceived)
+{
+    std::vector<std::vector<unsigned char>> vSols; CTxDestination vDest; txnouttype txType = TX_PUBKEYHASH; std::set<uint160> addrHashes; std::string address;
+    int keyType = GetAddressType(out.scriptPubKey, vDest, txType, vSols);
+    // zero value utxos and CC vouts are not counted by Snapshot2
+    if ( out.nValue == 0 || keyType == 0 || keyType == 3 )
+        return;
+    for (auto addr : vSols)
+    {
+        uint160 addrHash = addr.size() == 20 ? uint160(addr) : Hash160(addr);
+        // the same index key is written once
+        if ( !addrHashes.insert(addrHash).second || !getAddressFromIndex(keyType, addrHash, address) || SnapshotIgnoredAddress(address) )
+            continue;
+        if ( fReceived )
+            addressAmounts[address] += out.nValue;
+        else if ( (addressAmounts[address] -= out.nValue) <= 0 )
+            addressAmounts.erase(address);
+    }
+}
+
+// applies the address unspent index changes of the blocks (fromheight, toheight] to Snapshot2 balances taken at fromheight
+static bool komodo_snapshotadvance(std::map <std::string, CAmount> &addressAmounts, int32_t fromheight, int32_t toheight)
+{
+    for (int32_t n = fromheight+1; n <= toheight; n++)
+    {
+        CBlockIndex *pindex; CBlock block;
+        if ( (pindex= komodo_chainactive(n)) == 0 || komodo_blockload(block, pindex) != 0 )
+            return false;
+        for (int32_t i = 0; i < block.vtx.size(); i++)
+        {
+            const CTransaction &tx = block.vtx[i];
+            if ( !tx.IsMint() )
+            {
+                for (int32_t j = 0; j < tx.vin.size(); j++)
+                {
+                    uint256 blockhash; CTransaction txin;
+                    if (tx.IsPegsImport() && j==0) continue;
+                    if ( !myGetTransaction(tx.vin[j].prevout.hash,txin,blockhash) || tx.vin[j].prevout.n >= txin.vout.size() )
+                        return false;
+                    komodo_snapshotapply(addressAmounts, txin.vout[tx.vin[j].prevout.n], false);
+                }
+            }
+            for (int32_t k = 0; k < tx.vout.size(); k++)
+                komodo_snapshotapply(addressAmounts, tx.vout[k], true);
+        }
+    }
+    return true;
+}
+
+// the Snapshot2 balances at the tip, advanced from those of the last snapshot while its tip is still on the chain
+static bool komodo_snapshottip(std::map <std::string, CAmount> &addressAmounts)
+{
+    CBlockIndex *pindex, *ptip;
+    if ( !fAddressIndex || pblocktree == 0 || (ptip= chainActive.LastTip()) == 0 )
+        return false;
+    if ( snapshotTipHeight >= 0 && snapshotTipHeight <= ptip->GetHeight() && (pindex= komodo_chainactive(snapshotTipHeight)) != 0 && pindex->GetBlockHash() == snapshotTipHash )
+    {
+        addressAmounts = snapshotTipAmounts;
+        if ( !komodo_snapshotadvance(addressAmounts, snapshotTipHeight, ptip->GetHeight()) )
+            addressAmounts.clear();
+        else
+        {
+            snapshotTipAmounts = addressAmounts;
+            snapshotTipHeight = ptip->GetHeight();
+            snapshotTipHash = ptip->GetBlockHash();
+            return true;
+        }
+    }
+    if ( !komodo_snapshot2(addressAmounts) )
+        return false;
+    snapshotTipAmounts = addressAmounts;
+    snapshotTipHeight = ptip->GetHeight();
+    snapshotTipHash = ptip->GetBlockHash();
+    return true;
+}
+
 bool komodo_dailysnapshot(int32_t height)
 {
     int reorglimit = 100; 
@@ -719,7 +940,7 @@ bool komodo_dailysnapshot(int32_t height)
     if ( undo_height == lastSnapShotHeight )
         return true;
     std::map <std::string, int64_t> addressAmounts;
-    if ( !komodo_snapshot2(addressAmounts) )
+    if ( !komodo_snapshottip(addressAmounts) )
         return false;
 
     // undo blocks in reverse order
@@ -803,10 +1024,27 @@ bool AddOrphanTx(const CTransaction& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(c
         return false;
     }
 
-    mapOrphanTransactions[hash].tx = tx;
-    mapOrphanTransactions[hash].fromPeer = peer;
+    // A peer can only fill its share of the pool, so one sending many orphans
+    // does not evict the chains of transactions other peers are resolving.
+    size_t nMaxPeerBytes = (size_t)std::max((int64_t)0, GetArg("-maxorphanpeerbytes", DEFAULT_MAX_ORPHAN_PEER_BYTES));
+    size_t& nPeerBytes = mapOrphanBytesByPeer[peer];
+    if (nPeerBytes + sz > nMaxPeerBytes)
+    {
+        LogPrint("mempool", "ignoring orphan tx %s, peer=%d has %u bytes of orphans\n", hash.ToString(), peer, nPeerBytes);
+        if (nPeerBytes == 0)
+            mapOrphanBytesByPeer.erase(peer);
+        return false;
+    }
+    nPeerBytes += sz;
+
+    COrphanTx& orphan = mapOrphanTransactions[hash];
+    orphan.tx = tx;
+    orphan.fromPeer = peer;
+    orphan.nTxSize = sz;
     BOOST_FOREACH(const CTxIn& txin, tx.vin)
-    mapOrphanTransactionsByPrev[txin.prevout.hash].insert(hash);
+    mapOrphanTransactionsByPrev[txin.prevout].insert(hash);
+    orphanPoolInfo.nBytes += sz;
+    orphanPoolInfo.nAdded++;
 
     LogPrint("mempool", "stored orphan tx %s (mapsz %u prevsz %u)\n", hash.ToString(),
              mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size());
@@ -820,13 +1058,21 @@ void static EraseOrphanTx(uint256 hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         return;
     BOOST_FOREACH(const CTxIn& txin, it->second.tx.vin)
     {
-        map<uint256, set<uint256> >::iterator itPrev = mapOrphanTransactionsByPrev.find(txin.prevout.hash);
+        map<COutPoint, set<uint256> >::iterator itPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
         if (itPrev == mapOrphanTransactionsByPrev.end())
             continue;
         itPrev->second.erase(hash);
         if (itPrev->second.empty())
             mapOrphanTransactionsByPrev.erase(itPrev);
     }
+    map<NodeId, size_t>::iterator itPeer = mapOrphanBytesByPeer.find(it->second.fromPeer);
+    if (itPeer != mapOrphanBytesByPeer.end())
+    {
+        itPeer->second -= std::min(itPeer->second, (size_t)it->second.nTxSize);
+        if (itPeer->second == 0)
+            mapOrphanBytesByPeer.erase(itPeer);
+    }
+    orphanPoolInfo.nBytes -= std::min(orphanPoolInfo.nBytes, (size_t)it->second.nTxSize);
     mapOrphanTransactions.erase(it);
 }
 
@@ -843,6 +1089,7 @@ void EraseOrphansFor(NodeId peer)
             ++nErased;
         }
     }
+    orphanPoolInfo.nRemoved += nErased;
     if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx from peer %d\n", nErased, peer);
 }
 
@@ -860,9 +1107,46 @@ unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans) EXCLUSIVE_LOCKS_REQUIRE
             EraseOrphanTx(it->first);
             ++nEvicted;
     }
+    orphanPoolInfo.nEvicted += nEvicted;
     return nEvicted;
 }
 
+/** Drops the orphans a connected block confirms or conflicts with, and queues its txids that orphans spend from */
+static void OrphanPoolConnectBlock(const vector<CTransaction>& vtx) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (mapOrphanTransactions.empty())
+        return;
+    set<uint256> setErase;
+    BOOST_FOREACH(const CTransaction& tx, vtx)
+    {
+        const uint256& hash = tx.GetHash();
+        if (mapOrphanTransactions.count(hash))
+            setErase.insert(hash);
+        BOOST_FOREACH(const CTxIn& txin, tx.vin)
+        {
+            map<COutPoint, set<uint256> >::iterator itPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
+            if (itPrev != mapOrphanTransactionsByPrev.end())
+                setErase.insert(itPrev->second.begin(), itPrev->second.end());
+        }
+        map<COutPoint, set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.lower_bound(COutPoint(hash, 0));
+        if (itByPrev != mapOrphanTransactionsByPrev.end() && itByPrev->first.hash == hash)
+            vOrphanWorkQueue.push_back(hash);
+    }
+    BOOST_FOREACH(const uint256& hash, setErase)
+    EraseOrphanTx(hash);
+    orphanPoolInfo.nRemoved += setErase.size();
+    if (!setErase.empty())
+        LogPrint("mempool", "Erased %u orphan tx included or conflicted by block\n", setErase.size());
+}
+
+COrphanPoolInfo GetOrphanPoolInfo()
+{
+    LOCK(cs_main);
+    COrphanPoolInfo info = orphanPoolInfo;
+    info.nCount = mapOrphanTransactions.size();
+    return info;
+}
+
 
 bool IsStandardTx(const CTransaction& tx, string& reason, const int nHeight)
 {
@@ -1180,6 +1464,189 @@ bool ContextualCheckCoinbaseTransaction(int32_t slowflag,const CBlock *block,CBl
     return(true);
 }
 
+/**
+ * Sapling proofs and binding signatures that verified on the tx pre-check
+ * threads, so ContextualCheckTransaction does not verify them again under
+ * cs_main. Entries are Hash(txid, dataToBeSigned), the txid commits to the
+ * proofs and the signature hash to the consensus branch they were checked for.
+ */
+class CSaplingProofCache
+{
+private:
+    std::set<uint256> setValid;
+    boost::shared_mutex cs;
+
+public:
+    static uint256 Key(const CTransaction &tx, const uint256 &dataToBeSigned)
+    {
+        const uint256 &txid = tx.GetHash();
+        return Hash(txid.begin(), txid.end(), dataToBeSigned.begin(), dataToBeSigned.end());
+    }
+
+    bool Get(const uint256 &key)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs);
+        return setValid.count(key) != 0;
+    }
+
+    void Set(const uint256 &key)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs);
+        while (setValid.size() >= MAX_SAPLING_PROOF_CACHE_SIZE)
+        {
+            // evict a random entry, as the signature cache does
+            std::set<uint256>::iterator it = setValid.lower_bound(GetRandHash());
+            if (it == setValid.end())
+                it = setValid.begin();
+            setValid.erase(it);
+        }
+        setValid.insert(key);
+    }
+};
+
+static CSaplingProofCache saplingProofCache;
+
+static bool VerifySaplingProofs(const CTransaction& tx, const uint256& dataToBeSigned, CValidationState &state)
+{
+    if (!tx.vShieldedSpend.empty() || !tx.vShieldedOutput.empty())
+        libzcash::LoadGrothParams();
+    auto ctx = librustzcash_sapling_verification_ctx_init();
+
+    for (const SpendDescription &spend : tx.vShieldedSpend) {
+        if (!librustzcash_sapling_check_spend(
+            ctx,
+            spend.cv.begin(),
+            spend.anchor.begin(),
+            spend.nullifier.begin(),
+            spend.rk.begin(),
+            spend.zkproof.begin(),
+            spend.spendAuthSig.begin(),
+            dataToBeSigned.begin()
+        ))
+        {
+            librustzcash_sapling_verification_ctx_free(ctx);
+            return state.DoS(100, error("ContextualCheckTransaction(): Sapling spend description invalid"),
+                                  REJECT_INVALID, "bad-txns-sapling-spend-description-invalid");
+        }
+    }
+
+    for (const OutputDescription &output : tx.vShieldedOutput) {
+        if (!librustzcash_sapling_check_output(
+            ctx,
+            output.cv.begin(),
+            output.cm.begin(),
+            output.ephemeralKey.begin(),
+            output.zkproof.begin()
+        ))
+        {
+            librustzcash_sapling_verification_ctx_free(ctx);
+            return state.DoS(100, error("ContextualCheckTransaction(): Sapling output description invalid"),
+                                  REJECT_INVALID, "bad-txns-sapling-output-description-invalid");
+        }
+    }
+
+    if (!librustzcash_sapling_final_check(
+        ctx,
+        tx.valueBalance,
+        tx.bindingSig.begin(),
+        dataToBeSigned.begin()
+    ))
+    {
+        librustzcash_sapling_verification_ctx_free(ctx);
+        return state.DoS(100, error("ContextualCheckTransaction(): Sapling binding signature invalid"),
+                              REJECT_INVALID, "bad-txns-sapling-binding-signature-invalid");
+    }
+
+    librustzcash_sapling_verification_ctx_free(ctx);
+    return true;
+}
+
+/**
+ * Closure verifying the Sapling proofs and binding signature of one block tx.
+ * A tx that verifies goes into saplingProofCache; a bad one is left out, so
+ * ContextualCheckTransaction verifies it again and reports its error.
+ */
+class CSaplingProofCheck
+{
+private:
+    const CTransaction *ptx;
+    uint256 dataToBeSigned;
+
+public:
+    CSaplingProofCheck(): ptx(NULL) {}
+    CSaplingProofCheck(const CTransaction& txIn, const uint256& dataToBeSignedIn): ptx(&txIn), dataToBeSigned(dataToBeSignedIn) {}
+
+    bool operator()() {
+        CValidationState state;
+        if (VerifySaplingProofs(*ptx, dataToBeSigned, state))
+            saplingProofCache.Set(CSaplingProofCache::Key(*ptx, dataToBeSigned));
+        return true;
+    }
+
+    void swap(CSaplingProofCheck &check) {
+        std::swap(ptx, check.ptx);
+        std::swap(dataToBeSigned, check.dataToBeSigned);
+    }
+};
+
+static CCheckQueue<CSaplingProofCheck> saplingproofqueue(16);
+
+void ThreadSaplingProofCheck() {
+    RenameThread("komodo-saplingcheck");
+    saplingproofqueue.Thread();
+}
+
+/**
+ * Verify the Sapling txs of a block on the script verification threads ahead
+ * of the serial ContextualCheckTransaction pass, which then only looks the
+ * valid ones up in saplingProofCache.
+ */
+/**
+ * Whether the block with this hash at nHeight is an ancestor of the -assumenotarized block,
+ * and that block is on the best header chain. Requires cs_main.
+ */
+static bool IsAssumedNotarized(const uint256 &hash, int nHeight)
+{
+    if (hashAssumeNotarized.IsNull() || pindexBestHeader == NULL)
+        return false;
+    BlockMap::iterator mi = mapBlockIndex.find(hashAssumeNotarized);
+    if (mi == mapBlockIndex.end() || mi->second == NULL)
+        return false;
+    CBlockIndex *pindexAssumed = mi->second;
+    if (nHeight > pindexAssumed->GetHeight() || pindexBestHeader->GetAncestor(pindexAssumed->GetHeight()) != pindexAssumed)
+        return false;
+    CBlockIndex *pindexAncestor = pindexAssumed->GetAncestor(nHeight);
+    return pindexAncestor != NULL && pindexAncestor->GetBlockHash() == hash;
+}
+
+static void CheckBlockSaplingProofs(const CBlock& block, int nHeight)
+{
+    if (!nScriptCheckThreads)
+        return;
+    auto consensusBranchId = CurrentEpochBranchId(nHeight, Params().GetConsensus());
+    std::vector<CSaplingProofCheck> vChecks;
+    for (const CTransaction &tx : block.vtx)
+    {
+        if (tx.IsMint() || (tx.vShieldedSpend.empty() && tx.vShieldedOutput.empty()))
+            continue;
+        uint256 dataToBeSigned;
+        CScript scriptCode;
+        try {
+            dataToBeSigned = SignatureHash(scriptCode, tx, NOT_AN_INPUT, SIGHASH_ALL, 0, consensusBranchId);
+        } catch (std::logic_error ex) {
+            continue;
+        }
+        if (!saplingProofCache.Get(CSaplingProofCache::Key(tx, dataToBeSigned)))
+            vChecks.push_back(CSaplingProofCheck(tx, dataToBeSigned));
+    }
+    // a single tx is verified by ContextualCheckTransaction as before
+    if (vChecks.size() < 2)
+        return;
+    CCheckQueueControl<CSaplingProofCheck> control(&saplingproofqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
 /**
  * Check a transaction contextually against a set of consensus rules valid at a given block height.
  *
@@ -1194,7 +1661,7 @@ bool ContextualCheckTransaction(int32_t slowflag,const CBlock *block, CBlockInde
         CValidationState &state,
         const int nHeight,
         const int dosLevel,
-        bool (*isInitBlockDownload)(),int32_t validateprices)
+        bool (*isInitBlockDownload)(),int32_t validateprices,bool fCheckShieldedProofs)
 {
     bool overwinterActive = NetworkUpgradeActive(nHeight, Params().GetConsensus(), Consensus::UPGRADE_OVERWINTER);
     bool saplingActive = NetworkUpgradeActive(nHeight, Params().GetConsensus(), Consensus::UPGRADE_SAPLING);
@@ -1335,57 +1802,11 @@ bool ContextualCheckTransaction(int32_t slowflag,const CBlock *block, CBlockInde
                                 REJECT_INVALID, "bad-txns-invalid-script-data-for-coinbase-time-lock");
     }
 
-    if (!tx.vShieldedSpend.empty() ||
-        !tx.vShieldedOutput.empty())
+    if (fCheckShieldedProofs && (!tx.vShieldedSpend.empty() ||
+        !tx.vShieldedOutput.empty()))
     {
-        auto ctx = librustzcash_sapling_verification_ctx_init();
-
-        for (const SpendDescription &spend : tx.vShieldedSpend) {
-            if (!librustzcash_sapling_check_spend(
-                ctx,
-                spend.cv.begin(),
-                spend.anchor.begin(),
-                spend.nullifier.begin(),
-                spend.rk.begin(),
-                spend.zkproof.begin(),
-                spend.spendAuthSig.begin(),
-                dataToBeSigned.begin()
-            ))
-            {
-                librustzcash_sapling_verification_ctx_free(ctx);
-                return state.DoS(100, error("ContextualCheckTransaction(): Sapling spend description invalid"),
-                                      REJECT_INVALID, "bad-txns-sapling-spend-description-invalid");
-            }
-        }
-
-        for (const OutputDescription &output : tx.vShieldedOutput) {
-            if (!librustzcash_sapling_check_output(
-                ctx,
-                output.cv.begin(),
-                output.cm.begin(),
-                output.ephemeralKey.begin(),
-                output.zkproof.begin()
-            ))
-            {
-                librustzcash_sapling_verification_ctx_free(ctx);
-                return state.DoS(100, error("ContextualCheckTransaction(): Sapling output description invalid"),
-                                      REJECT_INVALID, "bad-txns-sapling-output-description-invalid");
-            }
-        }
-
-        if (!librustzcash_sapling_final_check(
-            ctx,
-            tx.valueBalance,
-            tx.bindingSig.begin(),
-            dataToBeSigned.begin()
-        ))
-        {
-            librustzcash_sapling_verification_ctx_free(ctx);
-            return state.DoS(100, error("ContextualCheckTransaction(): Sapling binding signature invalid"),
-                                  REJECT_INVALID, "bad-txns-sapling-binding-signature-invalid");
-        }
-
-        librustzcash_sapling_verification_ctx_free(ctx);
+        if (!saplingProofCache.Get(CSaplingProofCache::Key(tx, dataToBeSigned)) && !VerifySaplingProofs(tx, dataToBeSigned, state))
+            return false;
     }
     return true;
 }
@@ -1802,7 +2223,7 @@ CAmount GetMinRelayFee(const CTransaction& tx, unsigned int nBytes, bool fAllowF
 }
 
 
-bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,bool* pfMissingInputs, bool fRejectAbsurdFee, int dosLevel)
+static bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,bool* pfMissingInputs, bool fRejectAbsurdFee, int dosLevel)
 {
     AssertLockHeld(cs_main);
     if (pfMissingInputs)
@@ -2044,6 +2465,17 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
             }
         }
         
+        // A full mempool raises the fee it takes to get in above the packages it evicted
+        if (fLimitFree && &pool == &mempool && !tx.IsCoinImport() && !tx.IsPegsImport())
+        {
+            double dPriorityDelta = 0;
+            CAmount nFeeDelta = 0;
+            pool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
+            CAmount mempoolRejectFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+            if (mempoolRejectFee > 0 && nFees + nFeeDelta < mempoolRejectFee)
+                return state.DoS(0, error("AcceptToMemoryPool: mempool min fee not met %s, %d < %d", hash.ToString(), nFees, mempoolRejectFee), REJECT_INSUFFICIENTFEE, "mempool min fee not met");
+        }
+
         // Require that free transactions have sufficient priority to be mined in the next block.
         if (GetBoolArg("-relaypriority", false) && nFees < ::minRelayTxFee.GetFee(nSize) && !AllowFree(view.GetPriority(tx, chainActive.Height() + 1))) {
             //fprintf(stderr,"accept failure.6\n");
@@ -2091,7 +2523,7 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
         PrecomputedTransactionData txdata(tx);
-        std::shared_ptr<CCheckCCEvalCodes> evalcodeChecker(new CCheckCCEvalCodes());
+        std::shared_ptr<CCheckCCEvalCodes> evalcodeChecker(new CCheckCCEvalCodes(chainActive.LastTip()->GetBlockHash(), true));
         if (!ContextualCheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, txdata, Params().GetConsensus(), consensusBranchId, GetTime(), chainActive.LastTip()->GetHeight() + 1, evalcodeChecker)) // we can use GetTime() here, does not make big difference as this time is used to activate HF code for txns in mempool
         {
             //fprintf(stderr,"accept failure.9\n");
@@ -2148,6 +2580,13 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                     pool.addUnspentCCIndex(entry, view);  // add mempool unspent cc index for cc vin/vouts
                 }
             }
+
+            // trim the mempool and check if the tx was trimmed
+            if (&pool == &mempool) {
+                pool.TrimToSize(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
+                if (!pool.exists(hash))
+                    return state.DoS(0, error("AcceptToMemoryPool: mempool full %s", hash.ToString()), REJECT_INSUFFICIENTFEE, "mempool full");
+            }
         }
     }
     // This should be here still? 
@@ -2155,6 +2594,18 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return true;
 }
 
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,bool* pfMissingInputs, bool fRejectAbsurdFee, int dosLevel)
+{
+    static CMetricsHistogram& histAccepted = GetMetricsHistogram("komodo_mempool_accept_seconds",
+        "Time AcceptToMemoryPool took, by its result", "result=\"accepted\"");
+    static CMetricsHistogram& histRejected = GetMetricsHistogram("komodo_mempool_accept_seconds",
+        "Time AcceptToMemoryPool took, by its result", "result=\"rejected\"");
+    int64_t nTimeStart = GetTimeMicros();
+    bool fAccepted = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, fRejectAbsurdFee, dosLevel);
+    (fAccepted ? histAccepted : histRejected).Observe(GetTimeMicros() - nTimeStart);
+    return fAccepted;
+}
+
 bool CCTxFixAcceptToMemPoolUnchecked(CTxMemPool& pool, const CTransaction &tx)
 {
     // called from CheckBlock which is in cs_main and mempool.cs locks already. 
@@ -2170,6 +2621,17 @@ bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, const
     if (!fTimestampIndex)
         return error("Timestamp index not enabled");
 
+    if (fActiveOnly) {
+        // the active chain has the logical timestamps of the index in memory
+        LOCK(cs_main);
+        int nBegin, nEnd;
+        chainActiveLogicalTimes.SetTip(chainActive);
+        chainActiveLogicalTimes.FindRange(low, high, nBegin, nEnd);
+        for (int nHeight = nBegin; nHeight < nEnd; nHeight++)
+            hashes.push_back(std::make_pair(chainActive[nHeight]->GetBlockHash(), chainActiveLogicalTimes.Get(nHeight)));
+        return true;
+    }
+
     if (!pblocktree->ReadTimestampIndex(high, low, fActiveOnly, hashes))
         return error("Unable to get hashes for timestamps");
 
@@ -2184,6 +2646,7 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     if (mempool.getSpentIndex(key, value))
         return true;
 
+    CCStatsCountDBLookup();
     if (!pblocktree->ReadSpentIndex(key, value))
         return false;
 
@@ -2196,6 +2659,7 @@ bool GetAddressIndex(uint160 addressHash, int type,
     if (!fAddressIndex)
         return error("address index not enabled");
 
+    CCStatsCountDBLookup();
     if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
         return error("unable to get txids for address");
 
@@ -2208,19 +2672,61 @@ bool GetAddressUnspent(uint160 addressHash, int type,
     if (!fAddressIndex)
         return error("address index not enabled");
 
+    CCStatsCountDBLookup();
     if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
         return error("unable to get txids for address");
 
     return true;
 }
 
+bool ForEachAddressIndex(uint160 addressHash, int type, int start, int end, const CAddressIndexKey *pStartAfter,
+                         const std::function<bool(const CAddressIndexKey&, CAmount)> &func)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    CCStatsCountDBLookup();
+    if (!pblocktree->ForEachAddressIndex(addressHash, type, start, end, pStartAfter, func))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool ForEachAddressIndexReverse(uint160 addressHash, int type, int start, int end, const CAddressIndexKey *pStartBefore,
+                                const std::function<bool(const CAddressIndexKey&, CAmount)> &func)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    CCStatsCountDBLookup();
+    if (!pblocktree->ForEachAddressIndexReverse(addressHash, type, start, end, pStartBefore, func))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool ForEachAddressUnspent(uint160 addressHash, int type, const CAddressUnspentKey *pStartAfter,
+                           const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> &func)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    CCStatsCountDBLookup();
+    if (!pblocktree->ForEachAddressUnspentIndex(addressHash, type, pStartAfter, func))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
 bool GetUnspentCCIndex(uint160 addressHash, uint256 creationId,
-                       std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, int32_t beginHeight, int32_t endHeight, int64_t maxOutputs)
+                       std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, int32_t beginHeight, int32_t endHeight, int64_t maxOutputs,
+                       const std::string &funcids)
 {
     if (!fUnspentCCIndex)
         return error("unspent cc index not enabled");
 
-    if (!pblocktree->ReadUnspentCCIndex(addressHash, creationId, unspentOutputs, beginHeight, endHeight, maxOutputs))
+    CCStatsCountDBLookup();
+    if (!pblocktree->ReadUnspentCCIndex(addressHash, creationId, unspentOutputs, beginHeight, endHeight, maxOutputs, funcids))
         return error("unable to get outputs for address from unspent cc index");
 
     return true;
@@ -2269,34 +2775,154 @@ bool myAddtomempool(const CTransaction &tx, CValidationState *pstate, bool *pMis
     else return(true);
 }
 
-bool myGetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock)
+/** Serialize a blk/rev record, as a compressed frame if -compressblocks is set and that is smaller */
+template <typename T>
+static void GetDiskRecord(const T& obj, std::vector<unsigned char>& vRecord)
 {
-    memset(&hashBlock,0,sizeof(hashBlock));
-    if ( KOMODO_NSPV_SUPERLITE )
-    {
-        int64_t rewardsum = 0; int32_t i,retval,txheight,currentheight,height=0,vout = 0;
-        for (i=0; i<NSPV_U.U.numutxos; i++)
-            if ( NSPV_U.U.utxos[i].txid == hash )
-            {
-                height = NSPV_U.U.utxos[i].height;
-                break;
-            }
-        retval = NSPV_gettransaction(1,vout,hash,height,txOut,hashBlock,txheight,currentheight,0,0,rewardsum);
-        return(retval != -1);
+    // sized up front, so the record is serialized with a single allocation
+    size_t nSize = GetSerializeSize(obj, SER_DISK, CLIENT_VERSION);
+    if (!fCompressBlocks) {
+        vRecord.clear();
+        vRecord.reserve(nSize);
+        CVectorWriter(vRecord, SER_DISK, CLIENT_VERSION) << obj;
+        return;
     }
-    // need a GetTransaction without lock so the validation code for assets can run without deadlock
-    {
-        //fprintf(stderr,"check mempool %s\n",hash.GetHex().c_str());
-        if (mempool.lookup(hash, txOut))
-        {
-            //fprintf(stderr,"found in mempool\n");
-            return true;
-        }
+    std::vector<unsigned char> vRaw;
+    vRaw.reserve(nSize);
+    CVectorWriter(vRaw, SER_DISK, CLIENT_VERSION) << obj;
+    if (!CompressBlockData(vRaw.data(), vRaw.size(), vRecord))
+        vRecord.swap(vRaw);
+}
+
+/**
+ * If the blk/rev record at the current file position is a compressed frame,
+ * decompress it into vData. Otherwise rewind to the start of the raw record
+ * and return false. Throws like operator>> on I/O errors or a corrupt frame.
+ */
+static bool ReadDiskRecordFrame(CAutoFile& filein, std::vector<unsigned char>& vData)
+{
+    long nStart = ftell(filein.Get());
+    if (nStart < 0)
+        throw std::ios_base::failure("ReadDiskRecordFrame: ftell failed");
+    unsigned char header[BLOCKDATA_FRAME_HEADER_SIZE];
+    filein.read((char*)header, sizeof(BLOCKDATA_FRAME_MAGIC));
+    if (!IsBlockDataFrame(header)) {
+        if (fseek(filein.Get(), nStart, SEEK_SET) != 0)
+            throw std::ios_base::failure("ReadDiskRecordFrame: fseek failed");
+        return false;
     }
-    //fprintf(stderr,"check disk %s\n",hash.GetHex().c_str());
+    filein.read((char*)header + sizeof(BLOCKDATA_FRAME_MAGIC), BLOCKDATA_FRAME_HEADER_SIZE - sizeof(BLOCKDATA_FRAME_MAGIC));
+    uint32_t nRawSize, nCompressedSize;
+    if (!ParseBlockDataFrameHeader(header, nRawSize, nCompressedSize))
+        throw std::ios_base::failure("ReadDiskRecordFrame: invalid frame header");
+    std::vector<unsigned char> vCompressed(nCompressedSize);
+    if (nCompressedSize > 0)
+        filein.read((char*)&vCompressed[0], nCompressedSize);
+    if (!DecompressBlockData(vCompressed.empty() ? NULL : &vCompressed[0], nCompressedSize, nRawSize, vData))
+        throw std::ios_base::failure("ReadDiskRecordFrame: corrupt frame");
+    return true;
+}
 
-    if (fTxIndex) {
-        CDiskTxPos postx;
+/** Deserialize a blk/rev record in either format */
+template <typename T>
+static void ReadDiskRecord(CAutoFile& filein, T& obj)
+{
+    std::vector<unsigned char> vData;
+    if (ReadDiskRecordFrame(filein, vData)) {
+        CSpanReader ss(vData, SER_DISK, CLIENT_VERSION);
+        ss >> obj;
+    } else {
+        filein >> obj;
+    }
+}
+
+/** Read the header and the transaction at a tx index position, whose offset refers to the raw block serialization */
+static void ReadTxAtDiskPos(CAutoFile& file, const CDiskTxPos& postx, CBlockHeader& header, CTransaction& txOut)
+{
+    std::vector<unsigned char> vData;
+    if (ReadDiskRecordFrame(file, vData)) {
+        CSpanReader ss(vData, SER_DISK, CLIENT_VERSION);
+        ss >> header;
+        ss.ignore(postx.nTxOffset);
+        ss >> txOut;
+    } else {
+        file >> header;
+        fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+        file >> txOut;
+    }
+}
+
+/** NSPV_gettransaction through the CC tx cache, which keeps at most confirmed txs */
+static int32_t NSPV_cachedgettransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock, int32_t &txheight, int32_t &currentheight)
+{
+    int64_t rewardsum = 0; int32_t i,retval,height=0,vout = 0;
+    if ( CCTxCacheGet(hash,txOut,hashBlock,txheight) && txheight > 0 )
+    {
+        currentheight = NSPV_inforesult.height;
+        return(0);
+    }
+    for (i=0; i<NSPV_U.U.numutxos; i++)
+        if ( NSPV_U.U.utxos[i].txid == hash )
+        {
+            height = NSPV_U.U.utxos[i].height;
+            break;
+        }
+    retval = NSPV_gettransaction(1,vout,hash,height,txOut,hashBlock,txheight,currentheight,0,0,rewardsum);
+    if ( retval != -1 && txheight > 0 && txOut.GetHash() == hash )
+        CCTxCacheSet(txOut,hashBlock,txheight);
+    return(retval);
+}
+
+bool myGetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock)
+{
+    CTransactionRef ptx;
+    if (!myGetTransaction(hash, ptx, hashBlock))
+        return false;
+    txOut = *ptx;
+    return true;
+}
+
+bool myGetTransaction(const uint256 &hash, CTransactionRef &ptx, uint256 &hashBlock)
+{
+    CCStatsCountTxFetch();
+    memset(&hashBlock,0,sizeof(hashBlock));
+    ptx.reset();
+    if ( KOMODO_NSPV_SUPERLITE )
+    {
+        int32_t txheight,currentheight;
+        CTransaction tx;
+        if (NSPV_cachedgettransaction(hash,tx,hashBlock,txheight,currentheight) == -1)
+            return false;
+        ptx = MakeTransactionRef(tx);
+        return true;
+    }
+    // need a GetTransaction without lock so the validation code for assets can run without deadlock
+    {
+        //fprintf(stderr,"check mempool %s\n",hash.GetHex().c_str());
+        if ((ptx = mempool.get(hash)))
+        {
+            //fprintf(stderr,"found in mempool\n");
+            return true;
+        }
+    }
+    {
+        int32_t nHeight;
+        if (CCTxCacheGet(hash, ptx, hashBlock, nHeight))
+            return true;
+    }
+    if (fHavePruned && fPruneKeepTxs)
+    {
+        CTransaction tx;
+        if (pblocktree->ReadPrunedTx(hash, tx, hashBlock)) {
+            ptx = MakeTransactionRef(tx);
+            CCTxCacheSet(ptx, hashBlock, 0);
+            return true;
+        }
+    }
+    //fprintf(stderr,"check disk %s\n",hash.GetHex().c_str());
+
+    if (fTxIndex) {
+        CDiskTxPos postx;
         //fprintf(stderr,"ReadTxIndex\n");
         if (pblocktree->ReadTxIndex(hash, postx)) {
             //fprintf(stderr,"OpenBlockFile\n");
@@ -2304,18 +2930,20 @@ bool myGetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlo
             if (file.IsNull())
                 return error("%s: OpenBlockFile failed", __func__);
             CBlockHeader header;
+            // read in place, the cache keeps this allocation
+            std::shared_ptr<CTransaction> ptxRead = std::make_shared<CTransaction>();
             //fprintf(stderr,"seek and read\n");
             try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
+                ReadTxAtDiskPos(file, postx, header, *ptxRead);
             } catch (const std::exception& e) {
                 return error("%s: Deserialize or I/O error - %s", __func__, e.what());
             }
             hashBlock = header.GetHash();
-            if (txOut.GetHash() != hash)
+            if (ptxRead->GetHash() != hash)
                 return error("%s: txid mismatch", __func__);
             //fprintf(stderr,"found on disk %s\n",hash.GetHex().c_str());
+            ptx = ptxRead;
+            CCTxCacheSet(ptx, hashBlock, 0);
             return true;
         }
     }
@@ -2327,17 +2955,7 @@ bool NSPV_myGetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &ha
 {
     memset(&hashBlock,0,sizeof(hashBlock));
     if ( KOMODO_NSPV_SUPERLITE )
-    {
-        int64_t rewardsum = 0; int32_t i,retval,height=0,vout = 0;
-        for (i=0; i<NSPV_U.U.numutxos; i++)
-            if ( NSPV_U.U.utxos[i].txid == hash )
-            {
-                height = NSPV_U.U.utxos[i].height;
-                break;
-            }
-        retval = NSPV_gettransaction(1,vout,hash,height,txOut,hashBlock,txheight,currentheight,0,0,rewardsum);
-        return(retval != -1);
-    }
+        return(NSPV_cachedgettransaction(hash,txOut,hashBlock,txheight,currentheight) != -1);
     return false;
 }
 
@@ -2347,13 +2965,18 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock
     CBlockIndex *pindexSlow = NULL;
     memset(&hashBlock,0,sizeof(hashBlock));
 
-    LOCK(cs_main);
-
+    // cs_main is only held to find the block of a slow lookup, the mempool
+    // and the tx index have locks of their own and a block file is read
+    // without it. The tx index is written before its txs leave the mempool.
     if (mempool.lookup(hash, txOut))
     {
         return true;
     }
 
+    // the block file of a kept transaction may be gone
+    if (fHavePruned && fPruneKeepTxs && pblocktree->ReadPrunedTx(hash, txOut, hashBlock))
+        return true;
+
     if (fTxIndex) {
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
@@ -2362,9 +2985,7 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock
                 return error("%s: OpenBlockFile failed", __func__);
             CBlockHeader header;
             try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
+                ReadTxAtDiskPos(file, postx, header, txOut);
             } catch (const std::exception& e) {
                 return error("%s: Deserialize or I/O error - %s", __func__, e.what());
             }
@@ -2376,6 +2997,7 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock
     }
 
     if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
+        LOCK(cs_main);
         int nHeight = -1;
         {
             CCoinsViewCache &view = *pcoinsTip;
@@ -2423,7 +3045,19 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock
 // CBlock and CBlockIndex
 //
 
+void GetBlockDiskRecord(const CBlock& block, std::vector<unsigned char>& vRecord)
+{
+    GetDiskRecord(block, vRecord);
+}
+
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    std::vector<unsigned char> vRecord;
+    GetBlockDiskRecord(block, vRecord);
+    return WriteBlockToDisk(vRecord, pos, messageStart);
+}
+
+bool WriteBlockToDisk(const std::vector<unsigned char>& vRecord, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
 {
     // Open history file to append
     CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
@@ -2431,7 +3065,7 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHea
         return error("WriteBlockToDisk: OpenBlockFile failed");
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, block);
+    unsigned int nSize = vRecord.size();
     fileout << FLATDATA(messageStart) << nSize;
 
     // Write block
@@ -2439,7 +3073,7 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHea
     if (fileOutPos < 0)
         return error("WriteBlockToDisk: ftell failed");
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << block;
+    fileout.write((const char*)&vRecord[0], vRecord.size());
 
     return true;
 }
@@ -2449,17 +3083,18 @@ bool ReadBlockFromDisk(int32_t height,CBlock& block, const CDiskBlockPos& pos,bo
     uint8_t pubkey33[33];
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
+    // Read the whole record with one read, then deserialize it in place
+    std::vector<unsigned char> vData;
+    if (!ReadRawBlockFromDisk(vData, pos))
     {
         //fprintf(stderr,"readblockfromdisk err A\n");
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+        return error("ReadBlockFromDisk: ReadRawBlockFromDisk failed for %s", pos.ToString());
     }
 
     // Read block
     try {
-        filein >> block;
+        CSpanReader ss(vData, SER_DISK, CLIENT_VERSION);
+        ss >> block;
     }
     catch (const std::exception& e) {
         fprintf(stderr,"readblockfromdisk err B\n");
@@ -2481,6 +3116,39 @@ bool ReadBlockFromDisk(int32_t height,CBlock& block, const CDiskBlockPos& pos,bo
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vData, const CDiskBlockPos& pos)
+{
+    // the record size is stored right before the record, after the message start
+    if (pos.nPos < sizeof(unsigned int))
+        return error("ReadRawBlockFromDisk: invalid position %s", pos.ToString());
+    CDiskBlockPos posSize(pos.nFile, pos.nPos - sizeof(unsigned int));
+    CAutoFile filein(OpenBlockFile(posSize, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("ReadRawBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+    try {
+        unsigned int nSize;
+        filein >> nSize;
+        if (nSize < BLOCKDATA_FRAME_HEADER_SIZE || nSize > MAX_SIZE)
+            return error("ReadRawBlockFromDisk: invalid record size %u at %s", nSize, pos.ToString());
+        vData.resize(nSize);
+        filein.read((char*)&vData[0], nSize);
+    }
+    catch (const std::exception& e) {
+        return error("%s: I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+
+    if (IsBlockDataFrame(&vData[0])) {
+        uint32_t nRawSize, nCompressedSize;
+        std::vector<unsigned char> vRaw;
+        if (!ParseBlockDataFrameHeader(&vData[0], nRawSize, nCompressedSize) || nCompressedSize + BLOCKDATA_FRAME_HEADER_SIZE != vData.size() ||
+            !DecompressBlockData(&vData[BLOCKDATA_FRAME_HEADER_SIZE], nCompressedSize, nRawSize, vRaw))
+            return error("ReadRawBlockFromDisk: corrupt frame at %s", pos.ToString());
+        vData.swap(vRaw);
+    }
+    return true;
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex,bool checkPOW)
 {
     if ( pindex == 0 )
@@ -3108,7 +3776,7 @@ bool ContextualCheckOutputs(
 
 namespace {
 
-    bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
+    bool UndoWriteToDisk(const CBlockUndo& blockundo, const std::vector<unsigned char>& vRecord, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
     {
         // Open history file to append
         CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
@@ -3116,7 +3784,7 @@ namespace {
             return error("%s: OpenUndoFile failed", __func__);
 
         // Write index header
-        unsigned int nSize = GetSerializeSize(fileout, blockundo);
+        unsigned int nSize = vRecord.size();
         fileout << FLATDATA(messageStart) << nSize;
 
         // Write undo data
@@ -3124,7 +3792,7 @@ namespace {
         if (fileOutPos < 0)
             return error("%s: ftell failed", __func__);
         pos.nPos = (unsigned int)fileOutPos;
-        fileout << blockundo;
+        fileout.write((const char*)&vRecord[0], vRecord.size());
 
         // calculate & write checksum
         CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
@@ -3145,7 +3813,7 @@ namespace {
         // Read block
         uint256 hashChecksum;
         try {
-            filein >> blockundo;
+            ReadDiskRecord(filein, blockundo);
             filein >> hashChecksum;
         }
         catch (const std::exception& e) {
@@ -3181,6 +3849,14 @@ namespace {
 
 } // anon namespace
 
+bool ReadBlockUndoFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    CDiskBlockPos pos = pindex->GetUndoPos();
+    if (pos.IsNull() || pindex->pprev == NULL)
+        return false;
+    return UndoReadFromDisk(blockundo, pos, pindex->pprev->GetBlockHash());
+}
+
 /**
  * Apply the undo operation of a CTxInUndo to the given chain state.
  * @param undo The undo object.
@@ -3188,7 +3864,7 @@ namespace {
  * @param out The out point that corresponds to the tx input.
  * @return True on success.
  */
-static bool ApplyTxInUndo(const CTxInUndo& undo, CCoinsViewCache& view, const COutPoint& out)
+bool ApplyTxInUndo(const CTxInUndo& undo, CCoinsViewCache& view, const COutPoint& out)
 {
     bool fClean = true;
 
@@ -3223,6 +3899,7 @@ void ConnectNotarisations(const CBlock &block, int height)
         CDBBatch batch = CDBBatch(*pnotarisations);
         batch.Write(block.GetHash(), notarisations);
         WriteBackNotarisations(notarisations, batch);
+        WriteNotarisationHeights(notarisations, block.GetHash(), height, batch);
         pnotarisations->WriteBatch(batch, true);
         LogPrintf("ConnectBlock: wrote %i block notarisations in block: %s\n",
                 notarisations.size(), block.GetHash().GetHex().data());
@@ -3230,20 +3907,51 @@ void ConnectNotarisations(const CBlock &block, int height)
 }
 
 
-void DisconnectNotarisations(const CBlock &block)
+/** Add the erasure of the notarisations of block to batch, returns their number */
+static int EraseNotarisations(const CBlock &block, int height, CDBBatch &batch)
 {
-    // Delete from notarisations cache
     NotarisationsInBlock nibs;
-    if (GetBlockNotarisations(block.GetHash(), nibs)) {
-        CDBBatch batch = CDBBatch(*pnotarisations);
-        batch.Erase(block.GetHash());
-        EraseBackNotarisations(nibs, batch);
+    if (!GetBlockNotarisations(block.GetHash(), nibs))
+        return 0;
+    batch.Erase(block.GetHash());
+    EraseBackNotarisations(nibs, batch);
+    EraseNotarisationHeights(nibs, height, batch);
+    LogPrintf("DisconnectTip: deleted %i block notarisations in block: %s\n",
+        nibs.size(), block.GetHash().GetHex().data());
+    return nibs.size();
+}
+
+void DisconnectNotarisations(const CBlock &block, int height)
+{
+    // Delete from notarisations cache
+    CDBBatch batch = CDBBatch(*pnotarisations);
+    if (EraseNotarisations(block, height, batch) > 0)
         pnotarisations->WriteBatch(batch, true);
-        LogPrintf("DisconnectTip: deleted %i block notarisations in block: %s\n",
-            nibs.size(), block.GetHash().GetHex().data());
-    }
 }
 
+/**
+ * Block tree index and notarisation DB changes of a run of DisconnectTip
+ * calls, written with one batch per database by Commit() instead of once per
+ * block. Transactions of the disconnected blocks are returned to the mempool
+ * only after that, since CC validation reads the indexes.
+ * Commit() must be called before any block is connected again.
+ */
+class CDisconnectBatch
+{
+public:
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > unspentCCIndex;
+    CDBBatch notarisations;
+    int nNotarisations;
+    //! disconnected blocks whose transactions go back to the mempool, tip first
+    std::vector<std::pair<CBlock, const CBlockIndex*> > vResurrect;
+
+    CDisconnectBatch() : notarisations(*pnotarisations), nNotarisations(0) {}
+
+    bool Commit(CValidationState& state);
+};
+
 int8_t GetAddressType(const CScript &scriptPubKey, CTxDestination &vDest, txnouttype &txType, vector<vector<unsigned char>> &vSols)
 {
     int8_t keyType = 0;
@@ -3272,7 +3980,7 @@ int8_t GetAddressType(const CScript &scriptPubKey, CTxDestination &vDest, txnout
     return keyType;
 }
 
-bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean)
+bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean, CDisconnectBatch* pbatch)
 {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
 
@@ -3465,6 +4173,33 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
         return true;
     }
 
+    // read-modify-write of the balances, so it is not deferred to the disconnect batch
+    if (fTokenBalanceIndex)
+        if (!TokenBalanceIndexDisconnectBlock(block, pindex))
+            return AbortNode(state, "Failed to roll back token balance index");
+    if (fOraclesIndex)
+        if (!OraclesIndexDisconnectBlock(block, pindex))
+            return AbortNode(state, "Failed to erase oracles samples index");
+    if (fTokenTagsIndex)
+        if (!TokenTagsIndexDisconnectBlock(block, pindex))
+            return AbortNode(state, "Failed to erase token tags index");
+    if (fAgreementsIndex)
+        if (!AgreementsIndexDisconnectBlock(block, pindex))
+            return AbortNode(state, "Failed to erase agreements index");
+    if (fGatewaysIndex)
+        if (!GatewaysIndexDisconnectBlock(block, pindex))
+            return AbortNode(state, "Failed to erase gateways index");
+
+    if (pbatch != NULL) {
+        if (fAddressIndex) {
+            pbatch->addressIndex.insert(pbatch->addressIndex.end(), addressIndex.begin(), addressIndex.end());
+            pbatch->addressUnspentIndex.insert(pbatch->addressUnspentIndex.end(), addressUnspentIndex.begin(), addressUnspentIndex.end());
+        }
+        if (fUnspentCCIndex)
+            pbatch->unspentCCIndex.insert(pbatch->unspentCCIndex.end(), unspentCCIndex.begin(), unspentCCIndex.end());
+        return fClean;
+    }
+
     if (fAddressIndex) {
         if (!pblocktree->EraseAddressIndex(addressIndex)) {
             return AbortNode(state, "Failed to delete address index");
@@ -3494,6 +4229,9 @@ void static FlushBlockFile(bool fFinalize = false)
         if (fFinalize)
             TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nSize);
         FileCommit(fileOld);
+        // the pages are on disk now, don't let them push the chainstate out of the page cache
+        if (fDropBlockCache)
+            FileAdvise(fileOld, 0, 0, FILE_ADVICE_DONTNEED);
         fclose(fileOld);
     }
 
@@ -3502,6 +4240,8 @@ void static FlushBlockFile(bool fFinalize = false)
         if (fFinalize)
             TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nUndoSize);
         FileCommit(fileOld);
+        if (fDropBlockCache)
+            FileAdvise(fileOld, 0, 0, FILE_ADVICE_DONTNEED);
         fclose(fileOld);
     }
 }
@@ -3515,6 +4255,64 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Closure verifying the Equihash solution of one header of a headers message.
+ * The result is written to its own slot instead of failing the whole batch, so
+ * the headers before the first bad one are still accepted.
+ */
+class CHeaderSolutionCheck
+{
+private:
+    const CBlockHeader *pheader;
+    const CBlake2bPrefix *pbase;
+    char *pfValid;
+
+public:
+    CHeaderSolutionCheck(): pheader(NULL), pbase(NULL), pfValid(NULL) {}
+    CHeaderSolutionCheck(const CBlockHeader& headerIn, const CBlake2bPrefix *pbaseIn, char *pfValidIn): pheader(&headerIn), pbase(pbaseIn), pfValid(pfValidIn) {}
+
+    bool operator()() {
+        *pfValid = CheckEquihashSolution(pheader, Params(), pbase);
+        return true;
+    }
+
+    void swap(CHeaderSolutionCheck &check) {
+        std::swap(pheader, check.pheader);
+        std::swap(pbase, check.pbase);
+        std::swap(pfValid, check.pfValid);
+    }
+};
+
+static CCheckQueue<CHeaderSolutionCheck> headersolutionqueue(16);
+
+void ThreadHeaderSolutionCheck() {
+    RenameThread("komodo-hdrcheck");
+    headersolutionqueue.Thread();
+}
+
+/**
+ * Verify the Equihash solutions of a headers message without holding cs_main.
+ * vValid[i] is set to whether headers[i] carries a valid solution.
+ */
+static void CheckHeaderSolutions(const std::vector<CBlockHeader>& headers, std::vector<char>& vValid)
+{
+    vValid.assign(headers.size(), 0);
+    // every header starts from the same personalised Blake2b state
+    std::unique_ptr<CBlake2bPrefix> pbase = EquihashBaseState(Params());
+    if (!nScriptCheckThreads) {
+        for (unsigned int i = 0; i < headers.size(); i++)
+            vValid[i] = CheckEquihashSolution(&headers[i], Params(), pbase.get());
+        return;
+    }
+    CCheckQueueControl<CHeaderSolutionCheck> control(&headersolutionqueue);
+    std::vector<CHeaderSolutionCheck> vChecks;
+    vChecks.reserve(headers.size());
+    for (unsigned int i = 0; i < headers.size(); i++)
+        vChecks.push_back(CHeaderSolutionCheck(headers[i], pbase.get(), &vValid[i]));
+    control.Add(vChecks);
+    control.Wait();
+}
+
 //
 // Called periodically asynchronously; alerts if it smells like
 // we're being fed a bad chain (blocks being generated much
@@ -3586,6 +4384,14 @@ static int64_t nTimeConnect = 0;
 static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
+
+/** The histogram of a ConnectBlock/ConnectTip step, phase names the step like the bench log does */
+static CMetricsHistogram& ConnectBlockPhaseHistogram(const std::string& phase)
+{
+    return GetMetricsHistogram("komodo_connectblock_phase_seconds", "Time spent in each step of connecting a block to the tip",
+        "phase=\"" + phase + "\"");
+}
+
 bool FindBlockPos(int32_t tmpflag,CValidationState &state, CDiskBlockPos &pos, unsigned int nAddSize, unsigned int nHeight, uint64_t nTime, bool fKnown = false);
 bool ReceivedBlockTransactions(const CBlock &block, CValidationState& state, CBlockIndex *pindexNew, const CDiskBlockPos& pos);
 
@@ -3608,6 +4414,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             fExpensiveChecks = false;
         }
     }
+    if (fExpensiveChecks && IsAssumedNotarized(pindex->GetBlockHash(), pindex->GetHeight())) {
+        // This block is an ancestor of the -assumenotarized block: disable script, CC and proof checks
+        fExpensiveChecks = false;
+    }
     auto verifier = libzcash::ProofVerifier::Strict();
     auto disabledVerifier = libzcash::ProofVerifier::Disabled();
     int32_t futureblock;
@@ -3662,10 +4472,11 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     // Move the block to the main block file, we need this to create the TxIndex in the following loop.
     if ( (pindex->nStatus & BLOCK_IN_TMPFILE) != 0 )
     {
-        unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
-        if (!FindBlockPos(0,state, blockPos, nBlockSize+8, pindex->GetHeight(), block.GetBlockTime(),false))
+        std::vector<unsigned char> vRecord;
+        GetBlockDiskRecord(block, vRecord);
+        if (!FindBlockPos(0,state, blockPos, vRecord.size()+8, pindex->GetHeight(), block.GetBlockTime(),false))
             return error("ConnectBlock(): FindBlockPos failed");
-        if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart()))
+        if (!WriteBlockToDisk(vRecord, blockPos, chainparams.MessageStart()))
             return error("ConnectBlock(): FindBlockPos failed");
         pindex->nStatus &= (~BLOCK_IN_TMPFILE);
         pindex->nFile = blockPos.nFile;
@@ -3726,7 +4537,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         }
     }
     CCheckQueueControl<CScriptCheck> control(fExpensiveChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
-    std::shared_ptr<CCheckCCEvalCodes> evalcodeChecker(new CCheckCCEvalCodes());
+    std::shared_ptr<CCheckCCEvalCodes> evalcodeChecker(new CCheckCCEvalCodes(pindex->pprev != NULL ? pindex->pprev->GetBlockHash() : uint256(), false));
 
     int64_t nTimeStart = GetTimeMicros();
     CAmount nFees = 0;
@@ -4005,6 +4816,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         }
     }
     int64_t nTime1 = GetTimeMicros(); nTimeConnect += nTime1 - nTimeStart;
+    static CMetricsHistogram& histConnectTxs = ConnectBlockPhaseHistogram("txs");
+    histConnectTxs.Observe(nTime1 - nTimeStart);
     LogPrint("bench", "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs]\n", (unsigned)block.vtx.size(), 0.001 * (nTime1 - nTimeStart), 0.001 * (nTime1 - nTimeStart) / block.vtx.size(), nInputs <= 1 ? 0 : 0.001 * (nTime1 - nTimeStart) / (nInputs-1), nTimeConnect * 0.000001);
 
     blockReward += nFees + sum;
@@ -4040,6 +4853,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     if (!control.Wait())
         return state.DoS(100, false);
     int64_t nTime2 = GetTimeMicros(); nTimeVerify += nTime2 - nTimeStart;
+    static CMetricsHistogram& histConnectScripts = ConnectBlockPhaseHistogram("scripts");
+    histConnectScripts.Observe(nTime2 - nTime1);
     LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime2 - nTimeStart), nInputs <= 1 ? 0 : 0.001 * (nTime2 - nTimeStart) / (nInputs-1), nTimeVerify * 0.000001);
 
     if (fJustCheck)
@@ -4052,11 +4867,13 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (pindex->GetUndoPos().IsNull())
         {
             CDiskBlockPos pos;
-            if (!FindUndoPos(state, pindex->nFile, pos, ::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION) + 40))
+            std::vector<unsigned char> vUndoRecord;
+            GetDiskRecord(blockundo, vUndoRecord);
+            if (!FindUndoPos(state, pindex->nFile, pos, vUndoRecord.size() + 40))
                 return error("ConnectBlock(): FindUndoPos failed");
             if ( pindex->pprev == 0 )
                 fprintf(stderr,"ConnectBlock: unexpected null pprev\n");
-            if (!UndoWriteToDisk(blockundo, pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
+            if (!UndoWriteToDisk(blockundo, vUndoRecord, pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
                 return AbortNode(state, "Failed to write undo data");
             // update nUndoPos in block index
             pindex->nUndoPos = pos.nPos;
@@ -4075,38 +4892,26 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         }
         
         pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
+        if ( block.vtx.size() > 0 && block.vtx[0].vout.size() > 0 )
+        {
+            // persisted with the index entry so komodo_index2pubkey33 never has to read this block back
+            uint8_t pubkey33[33];
+            komodo_block2pubkey33(pubkey33,(CBlock *)&block);
+            komodo_index_setsigner(pindex,pubkey33);
+        }
+        // the new staker sets it in komodo_checkPOW, older blocks get it here from the block in memory
+        if ( ASSETCHAINS_STAKED != 0 && pindex->segid == -2 )
+            pindex->segid = komodo_blocksegid(block,pindex);
         setDirtyBlockIndex.insert(pindex);
     }
 
     ConnectNotarisations(block, pindex->GetHeight()); // MoMoM notarisation DB.
 
-    if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
-            return AbortNode(state, "Failed to write transaction index");
-    if (fAddressIndex) {
-        if (!pblocktree->WriteAddressIndex(addressIndex)) {
-            return AbortNode(state, "Failed to write address index");
-        }
-
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            return AbortNode(state, "Failed to write address unspent index");
-        }
-    }
-
-    if (fUnspentCCIndex)    {
-        if (!pblocktree->UpdateUnspentCCIndex(unspentCCIndex)) {
-            return AbortNode(state, "Failed to write address unspent cc index");
-        }
-    }
-
-    if (fSpentIndex)
-        if (!pblocktree->UpdateSpentIndex(spentIndex))
-            return AbortNode(state, "Failed to write transaction index");
-
+    unsigned int logicalTS = 0;
     if (fTimestampIndex)
     {
-        unsigned int logicalTS = pindex->nTime;
         unsigned int prevLogicalTS = 0;
+        logicalTS = pindex->nTime;
 
         // retrieve logical timestamp of the previous block
         if (pindex->pprev)
@@ -4117,18 +4922,53 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             logicalTS = prevLogicalTS + 1;
             LogPrintf("%s: Previous logical timestamp is newer Actual[%d] prevLogical[%d] Logical[%d]\n", __func__, pindex->nTime, prevLogicalTS, logicalTS);
         }
+    }
 
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(logicalTS, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
-
-        if (!pblocktree->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(logicalTS)))
-            return AbortNode(state, "Failed to write blockhash index");
+    // the tx, address, unspent cc, spent and timestamp indexes of the block in one batch,
+    // the entries are collected for more indexes than those enabled
+    if (fTxIndex || fAddressIndex || fUnspentCCIndex || fSpentIndex || fTimestampIndex)
+    {
+        if (!fTxIndex)
+            vPos.clear();
+        if (!fAddressIndex) {
+            addressIndex.clear();
+            addressUnspentIndex.clear();
+        }
+        if (!fUnspentCCIndex)
+            unspentCCIndex.clear();
+        if (!fSpentIndex)
+            spentIndex.clear();
+        if (!pblocktree->WriteConnectedIndexes(vPos, addressIndex, addressUnspentIndex, unspentCCIndex, spentIndex, pindex->GetBlockHash(), logicalTS))
+            return AbortNode(state, "Failed to write block indexes");
     }
 
+    if (fTokenBalanceIndex)
+        if (!TokenBalanceIndexConnectBlock(block, pindex))
+            return AbortNode(state, "Failed to write token balance index");
+
+    if (fOraclesIndex)
+        if (!OraclesIndexConnectBlock(block, pindex))
+            return AbortNode(state, "Failed to write oracles samples index");
+
+    if (fTokenTagsIndex)
+        if (!TokenTagsIndexConnectBlock(block, pindex))
+            return AbortNode(state, "Failed to write token tags index");
+
+    if (fAgreementsIndex)
+        if (!AgreementsIndexConnectBlock(block, pindex))
+            return AbortNode(state, "Failed to write agreements index");
+
+    if (fGatewaysIndex)
+        if (!GatewaysIndexConnectBlock(block, pindex))
+            return AbortNode(state, "Failed to write gateways index");
+
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
     int64_t nTime3 = GetTimeMicros(); nTimeIndex += nTime3 - nTime2;
+    static CMetricsHistogram& histConnectIndex = ConnectBlockPhaseHistogram("index");
+    histConnectIndex.Observe(nTime3 - nTime2);
     LogPrint("bench", "    - Index writing: %.2fms [%.2fs]\n", 0.001 * (nTime3 - nTime2), nTimeIndex * 0.000001);
 
     // Watch for changes to the previous coinbase transaction.
@@ -4150,6 +4990,187 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     return true;
 }
 
+static const char* FEE_ESTIMATES_FILENAME = "fee_estimates.dat";
+//! fee_estimates.dat is only written once it has been read, not to lose what it had
+static bool fFeeEstimatesLoaded = false;
+
+void LoadFeeEstimates()
+{
+    boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
+    CAutoFile est_filein(fopen(est_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    // Allowed to fail as this file IS missing on first startup.
+    if (!est_filein.IsNull())
+        mempool.ReadFeeEstimates(est_filein);
+    fFeeEstimatesLoaded = true;
+}
+
+void DumpFeeEstimates()
+{
+    if (!fFeeEstimatesLoaded)
+        return;
+    // written next to the file and renamed over it, so a crash while writing doesn't lose the history
+    boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
+    boost::filesystem::path est_path_new = GetDataDir() / (std::string(FEE_ESTIMATES_FILENAME) + ".new");
+    {
+        CAutoFile est_fileout(fopen(est_path_new.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        if (est_fileout.IsNull() || !mempool.WriteFeeEstimates(est_fileout)) {
+            LogPrintf("%s: Failed to write fee estimates to %s\n", __func__, est_path_new.string());
+            return;
+        }
+        FileCommit(est_fileout.Get());
+    }
+    if (!RenameOver(est_path_new, est_path))
+        LogPrintf("%s: Failed to rename %s to %s\n", __func__, est_path_new.string(), est_path.string());
+}
+
+static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+//! mempool.dat is only written once it has been loaded, a shutdown while loading it keeps the file
+static std::atomic<bool> fMempoolLoaded(false);
+
+bool LoadMempool()
+{
+    int64_t nStart = GetTimeMillis();
+    FILE* filestr = fopen((GetDataDir() / "mempool.dat").string().c_str(), "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
+        fMempoolLoaded = true;
+        return false;
+    }
+
+    std::vector<CTransaction> vtx;
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != MEMPOOL_DUMP_VERSION) {
+            fMempoolLoaded = true;
+            return false;
+        }
+        uint64_t num;
+        file >> num;
+        vtx.reserve(std::min(num, (uint64_t)1000000));
+        while (num--) {
+            CTransaction tx;
+            double dPriorityDelta;
+            CAmount nFeeDelta;
+            file >> tx;
+            file >> dPriorityDelta;
+            file >> nFeeDelta;
+            if (dPriorityDelta != 0 || nFeeDelta != 0)
+                mempool.PrioritiseTransaction(tx.GetHash(), tx.GetHash().ToString(), dPriorityDelta, nFeeDelta);
+            vtx.push_back(tx);
+        }
+        // and the deltas of txns that weren't in the mempool
+        std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+        file >> mapDeltas;
+        for (std::map<uint256, std::pair<double, CAmount> >::iterator it = mapDeltas.begin(); it != mapDeltas.end(); ++it)
+            mempool.PrioritiseTransaction(it->first, it->first.ToString(), it->second.first, it->second.second);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
+        fMempoolLoaded = true;
+        return false;
+    }
+
+    // The txns were saved parents first. They are accepted in batches, so blocks and
+    // relayed txns get cs_main in between and a big mempool doesn't hold up the node
+    int64_t nAccepted = 0, nFailed = 0, nAlreadyThere = 0;
+    for (size_t i = 0; i < vtx.size(); ) {
+        boost::this_thread::interruption_point();
+        LOCK(cs_main);
+        for (size_t nBatch = 0; nBatch < MEMPOOL_LOAD_BATCH_SIZE && i < vtx.size(); nBatch++, i++) {
+            if (mempool.exists(vtx[i].GetHash())) {
+                nAlreadyThere++;
+                continue;
+            }
+            CValidationState state;
+            if (AcceptToMemoryPool(mempool, state, vtx[i], false, NULL))
+                nAccepted++;
+            else
+                nFailed++;
+        }
+    }
+    fMempoolLoaded = true;
+    LogPrintf("Imported mempool transactions from disk: %i successes, %i failed, %i already there, %dms\n",
+              nAccepted, nFailed, nAlreadyThere, GetTimeMillis() - nStart);
+    return true;
+}
+
+bool DumpMempool()
+{
+    if (!fMempoolLoaded)
+        return false;
+    int64_t nStart = GetTimeMillis();
+
+    // Each tx is written after the mempool txns it spends, to be accepted after them when loaded
+    std::vector<CTransactionRef> vtx;
+    std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+    {
+        LOCK(mempool.cs);
+        mapDeltas = mempool.mapDeltas;
+        std::set<uint256> setWritten;
+        std::vector<std::pair<CTransactionRef, size_t> > vStack;
+        for (CTxMemPool::indexed_transaction_set::const_iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi) {
+            if (setWritten.count(mi->GetTx().GetHash()))
+                continue;
+            vStack.push_back(std::make_pair(mi->GetSharedTx(), 0));
+            while (!vStack.empty()) {
+                CTransactionRef ptx = vStack.back().first;
+                size_t &nIn = vStack.back().second;
+                if (nIn < ptx->vin.size()) {
+                    const uint256 &hashParent = ptx->vin[nIn++].prevout.hash;
+                    if (!setWritten.count(hashParent)) {
+                        CTransactionRef ptxParent = mempool.get(hashParent);
+                        if (ptxParent)
+                            vStack.push_back(std::make_pair(ptxParent, 0));
+                    }
+                    continue;
+                }
+                if (setWritten.insert(ptx->GetHash()).second)
+                    vtx.push_back(ptx);
+                vStack.pop_back();
+            }
+        }
+    }
+    int64_t nMid = GetTimeMillis();
+
+    try {
+        boost::filesystem::path path = GetDataDir() / "mempool.dat";
+        boost::filesystem::path pathNew = GetDataDir() / "mempool.dat.new";
+        FILE* filestr = fopen(pathNew.string().c_str(), "wb");
+        if (!filestr)
+            return false;
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+
+        uint64_t version = MEMPOOL_DUMP_VERSION;
+        file << version;
+        file << (uint64_t)vtx.size();
+        BOOST_FOREACH(const CTransactionRef &ptx, vtx) {
+            double dPriorityDelta = 0;
+            CAmount nFeeDelta = 0;
+            std::map<uint256, std::pair<double, CAmount> >::iterator it = mapDeltas.find(ptx->GetHash());
+            if (it != mapDeltas.end()) {
+                dPriorityDelta = it->second.first;
+                nFeeDelta = it->second.second;
+                mapDeltas.erase(it);
+            }
+            file << *ptx;
+            file << dPriorityDelta;
+            file << nFeeDelta;
+        }
+        file << mapDeltas;
+        FileCommit(file.Get());
+        file.fclose();
+        if (!RenameOver(pathNew, path))
+            return error("%s: Rename-into-place failed", __func__);
+        int64_t nLast = GetTimeMillis();
+        LogPrintf("Dumped mempool: %gs to copy, %gs to dump\n", (nMid-nStart)*0.001, (nLast-nMid)*0.001);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump mempool: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+    return true;
+}
+
 enum FlushStateMode {
     FLUSH_STATE_NONE,
     FLUSH_STATE_IF_NEEDED,
@@ -4171,6 +5192,9 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
     std::set<int> setFilesToPrune;
     bool fFlushForPrune = false;
     try {
+        // a background write of the chainstate failed, what is connected since can't be written either
+        if (pcoinsflush != NULL && pcoinsflush->HasFailed())
+            return AbortNode(state, "Failed to write to coin database");
         if (fPruneMode && fCheckForPruning && !fReindex) {
             FindFilesToPrune(setFilesToPrune);
             fCheckForPruning = false;
@@ -4247,11 +5271,17 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
             // Flush the chainstate (which may refer to block index entries).
             if (!pcoinsTip->Flush())
                 return AbortNode(state, "Failed to write to coin database");
+            // With the background flush the tip is only handed to its thread, wait for the write when the
+            // chainstate has to be on disk now, or block files are pruned from under it
+            if (pcoinsflush != NULL && (mode == FLUSH_STATE_ALWAYS || fFlushForPrune) && !pcoinsflush->Sync())
+                return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
         }
         if ((mode == FLUSH_STATE_ALWAYS || mode == FLUSH_STATE_PERIODIC) && nNow > nLastSetChain + (int64_t)DATABASE_WRITE_INTERVAL * 1000000) {
             // Update best block in wallet (so we can detect restored wallets).
             GetMainSignals().SetBestChain(chainActive.GetLocator());
+            // and keep the fee estimates of a node that doesn't get to shut down cleanly
+            DumpFeeEstimates();
             nLastSetChain = nNow;
         }
     } catch (const std::runtime_error& e) {
@@ -4276,6 +5306,9 @@ void PruneAndFlush() {
 void static UpdateTip(CBlockIndex *pindexNew) {
     const CChainParams& chainParams = Params();
     chainActive.SetTip(pindexNew);
+    if (!chainActiveLogicalTimes.IsEmpty())
+        chainActiveLogicalTimes.SetTip(chainActive);
+    komodo_minerwindow_update(pindexNew);
 
     // New best block
     nTimeBestReceived = GetTime();
@@ -4331,7 +5364,52 @@ void static UpdateTip(CBlockIndex *pindexNew) {
  * Disconnect chainActive's tip. You probably want to call mempool.removeForReorg and
  * mempool.removeWithoutBranchId after this, with cs_main held.
  */
-bool static DisconnectTip(CValidationState &state, bool fBare = false) {
+/** Return the transactions of a disconnected block to the mempool */
+static void ResurrectBlockTransactions(const CBlock& block, const CBlockIndex* pindexDelete)
+{
+    for (int i = 0; i < block.vtx.size(); i++)
+    {
+        // ignore validation errors in resurrected transactions
+        const CTransaction &tx = block.vtx[i];
+        list<CTransaction> removed;
+        CValidationState stateDummy;
+
+        // don't keep staking or invalid transactions
+        if (tx.IsCoinBase() || (i == block.vtx.size()-1 && komodo_newStakerActive(0, pindexDelete->nTime) == 0 && komodo_isPoS((CBlock *)&block,pindexDelete->GetHeight(),0) != 0) || !AcceptToMemoryPool(mempool, stateDummy, tx, false, NULL))
+        {
+            mempool.remove(tx, removed, true);
+        }
+    }
+}
+
+bool CDisconnectBatch::Commit(CValidationState& state)
+{
+    bool fOk = true;
+    if (!addressIndex.empty() || !addressUnspentIndex.empty() || !unspentCCIndex.empty()) {
+        if (!pblocktree->WriteDisconnectedIndexes(addressIndex, addressUnspentIndex, unspentCCIndex))
+            fOk = AbortNode(state, "Failed to write index changes of disconnected blocks");
+        addressIndex.clear();
+        addressUnspentIndex.clear();
+        unspentCCIndex.clear();
+    }
+    if (nNotarisations > 0) {
+        pnotarisations->WriteBatch(notarisations, true);
+        notarisations.Clear();
+        nNotarisations = 0;
+    }
+    // oldest block first, so transactions can spend outputs of lower resurrected blocks
+    for (int i = (int)vResurrect.size() - 1; i >= 0; i--)
+        ResurrectBlockTransactions(vResurrect[i].first, vResurrect[i].second);
+    vResurrect.clear();
+    return fOk;
+}
+
+/**
+ * Disconnect chainActive's tip. If pbatch is provided, the block tree index
+ * and notarisation DB changes and the return of transactions to the mempool
+ * are left to pbatch->Commit().
+ */
+bool static DisconnectTip(CValidationState &state, bool fBare = false, CDisconnectBatch *pbatch = NULL) {
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
     // Read block from disk.
@@ -4355,11 +5433,22 @@ bool static DisconnectTip(CValidationState &state, bool fBare = false) {
     int64_t nStart = GetTimeMicros();
     {
         CCoinsViewCache view(pcoinsTip);
-        if (!DisconnectBlock(block, state, pindexDelete, view))
+        if (!DisconnectBlock(block, state, pindexDelete, view, NULL, pbatch))
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         assert(view.Flush());
-        DisconnectNotarisations(block);
-    }
+        if (pbatch != NULL)
+            pbatch->nNotarisations += EraseNotarisations(block, pindexDelete->GetHeight(), pbatch->notarisations);
+        else
+            DisconnectNotarisations(block, pindexDelete->GetHeight());
+    }
+    CCTxCacheEraseBlock(block);
+    TokenCreateCacheEraseBlock(block);
+    AssetsBookDisconnectBlock();
+    RewardsBookDisconnectBlock();
+    HeirBookDisconnectBlock();
+    DiceBookDisconnectBlock();
+    ChannelsBookDisconnectBlock();
+    PegsBookDisconnectBlock();
     pindexDelete->segid = -2;
     pindexDelete->nNotaryPay = 0; 
     pindexDelete->newcoins = 0;
@@ -4374,19 +5463,10 @@ bool static DisconnectTip(CValidationState &state, bool fBare = false) {
 
     if (!fBare) {
         // resurrect mempool transactions from the disconnected block.
-        for (int i = 0; i < block.vtx.size(); i++)
-        {
-            // ignore validation errors in resurrected transactions
-            CTransaction &tx = block.vtx[i];
-            list<CTransaction> removed;
-            CValidationState stateDummy;
-            
-            // don't keep staking or invalid transactions
-            if (tx.IsCoinBase() || (i == block.vtx.size()-1 && komodo_newStakerActive(0, pindexDelete->nTime) == 0 && komodo_isPoS((CBlock *)&block,pindexDelete->GetHeight(),0) != 0) || !AcceptToMemoryPool(mempool, stateDummy, tx, false, NULL))
-            {
-                mempool.remove(tx, removed, true);
-            }
-        }
+        if (pbatch != NULL)
+            pbatch->vResurrect.push_back(std::make_pair(block, pindexDelete));
+        else
+            ResurrectBlockTransactions(block, pindexDelete);
         if (sproutAnchorBeforeDisconnect != sproutAnchorAfterDisconnect) {
             // The anchor may not change between block disconnects,
             // in which case we don't want to evict from the mempool yet!
@@ -4576,16 +5656,177 @@ private:
 
 
 /**
- * Connect a new block to chainActive. pblock is either NULL or a pointer to a CBlock
- * corresponding to pindexNew, to bypass loading it again from disk.
- * You probably want to call mempool.removeWithoutBranchId after this, with cs_main held.
+ * Reads and deserializes the blocks about to be connected by ActivateBestChainStep
+ * on a background thread, so ConnectTip does not stall on disk I/O.
+ * Block positions are captured under cs_main when scheduled, the worker never touches the block index.
  */
-bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *pblock) {
+class CBlockPrefetcher
+{
+public:
+    CBlockPrefetcher() : nDepth(0), fStop(false), fAdvise(false) {}
+    ~CBlockPrefetcher() { Stop(); }
 
-    assert(pindexNew->pprev == chainActive.Tip());
-    // Read block from disk.
-    int64_t nTime1 = GetTimeMicros();
-    CBlock block;
+    /** Schedule the blocks to be connected next, in connect order. Prefetched blocks not in the list are dropped */
+    void Prefetch(const std::vector<const CBlockIndex*> &vpindex, size_t nDepthIn)
+    {
+        AssertLockHeld(cs_main);
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (fStop)
+            return;
+        nDepth = nDepthIn;
+        std::set<uint256> setScheduled;
+        vPending.clear();
+        BOOST_FOREACH(const CBlockIndex *pindex, vpindex) {
+            const uint256 hash = pindex->GetBlockHash();
+            setScheduled.insert(hash);
+            if (mapReady.count(hash) == 0 && hash != hashReading && vPending.size() < nDepth)
+                vPending.push_back(CPendingBlock(hash, pindex->GetHeight(), pindex->GetBlockPos()));
+        }
+        for (std::map<uint256, std::shared_ptr<CBlock> >::iterator it = mapReady.begin(); it != mapReady.end(); ) {
+            if (setScheduled.count(it->first) == 0)
+                mapReady.erase(it++);
+            else
+                ++it;
+        }
+        fAdvise = !vPending.empty();
+        if (!vPending.empty() && !worker.joinable())
+            worker = boost::thread(&CBlockPrefetcher::Thread, this);
+        cond.notify_all();
+    }
+
+    /** Get a prefetched block, waits if it is being read. Returns false if the caller should read it itself */
+    bool Get(const CBlockIndex *pindex, CBlock &block)
+    {
+        const uint256 hash = pindex->GetBlockHash();
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (hashReading == hash)
+            cond.wait(lock);
+        std::map<uint256, std::shared_ptr<CBlock> >::iterator it = mapReady.find(hash);
+        if (it == mapReady.end()) {
+            // not read yet, the caller reads it now so don't read it twice
+            for (std::deque<CPendingBlock>::iterator pit = vPending.begin(); pit != vPending.end(); ++pit) {
+                if (pit->hash == hash) {
+                    vPending.erase(pit);
+                    break;
+                }
+            }
+            return false;
+        }
+        block = *it->second;
+        mapReady.erase(it);
+        cond.notify_all();
+        return true;
+    }
+
+    void Stop()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fStop = true;
+            vPending.clear();
+            mapReady.clear();
+        }
+        cond.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+private:
+    struct CPendingBlock {
+        CPendingBlock(const uint256 &hashIn, int32_t nHeightIn, const CDiskBlockPos &posIn) : hash(hashIn), nHeight(nHeightIn), pos(posIn) {}
+        uint256 hash;
+        int32_t nHeight;
+        CDiskBlockPos pos;
+    };
+
+    void Thread()
+    {
+        RenameThread("komodo-prefetch");
+        while (true) {
+            CPendingBlock next(uint256(), 0, CDiskBlockPos());
+            std::vector<CDiskBlockPos> vAdvise;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (!fStop && (vPending.empty() || mapReady.size() >= nDepth))
+                    cond.wait(lock);
+                if (fStop)
+                    return;
+                next = vPending.front();
+                vPending.pop_front();
+                hashReading = next.hash;
+                if (fAdvise) {
+                    vAdvise.push_back(next.pos);
+                    BOOST_FOREACH(const CPendingBlock &pending, vPending)
+                        vAdvise.push_back(pending.pos);
+                    fAdvise = false;
+                }
+            }
+            if (!vAdvise.empty())
+                AdviseReads(vAdvise);
+            std::shared_ptr<CBlock> pblock(new CBlock());
+            bool fRead = ReadBlockFromDisk(next.nHeight, *pblock, next.pos, 0) && pblock->GetHash() == next.hash;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                // on a read failure ConnectTip reads the block itself and reports the error
+                if (fRead && !fStop)
+                    mapReady[next.hash] = pblock;
+                hashReading.SetNull();
+            }
+            cond.notify_all();
+        }
+    }
+
+    /** Ask the kernel to read the scheduled blocks in: one range per blk file, the tail of the last block may be left out */
+    static void AdviseReads(const std::vector<CDiskBlockPos> &vpos)
+    {
+        static const unsigned int READAHEAD_SLACK = 0x40000; // 256 KiB
+        std::map<int, std::pair<unsigned int, unsigned int> > mapRanges;
+        BOOST_FOREACH(const CDiskBlockPos &pos, vpos) {
+            std::map<int, std::pair<unsigned int, unsigned int> >::iterator it = mapRanges.find(pos.nFile);
+            if (it == mapRanges.end())
+                mapRanges[pos.nFile] = std::make_pair(pos.nPos, pos.nPos);
+            else
+                it->second = std::make_pair(std::min(it->second.first, pos.nPos), std::max(it->second.second, pos.nPos));
+        }
+        for (std::map<int, std::pair<unsigned int, unsigned int> >::iterator it = mapRanges.begin(); it != mapRanges.end(); ++it) {
+            FILE *file = OpenBlockFile(CDiskBlockPos(it->first, 0), true);
+            if (file == NULL)
+                continue;
+            unsigned int nStart = it->second.first >= 8 ? it->second.first - 8 : 0;
+            FileAdvise(file, nStart, it->second.second - nStart + READAHEAD_SLACK, FILE_ADVICE_WILLNEED);
+            fclose(file);
+        }
+    }
+
+    size_t nDepth;
+    bool fStop;
+    bool fAdvise;   //!< the schedule changed, hint its reads to the kernel
+    boost::mutex cs;
+    boost::condition_variable cond;
+    std::deque<CPendingBlock> vPending;
+    uint256 hashReading;
+    std::map<uint256, std::shared_ptr<CBlock> > mapReady;
+    boost::thread worker;
+};
+
+static CBlockPrefetcher blockPrefetcher;
+
+void StopBlockPrefetch()
+{
+    blockPrefetcher.Stop();
+}
+
+/**
+ * Connect a new block to chainActive. pblock is either NULL or a pointer to a CBlock
+ * corresponding to pindexNew, to bypass loading it again from disk.
+ * You probably want to call mempool.removeWithoutBranchId after this, with cs_main held.
+ */
+bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *pblock) {
+
+    assert(pindexNew->pprev == chainActive.Tip());
+    // Read block from disk.
+    int64_t nTime1 = GetTimeMicros();
+    CBlock block;
     if (!pblock) {
         if (!ReadBlockFromDisk(block, pindexNew,1))
             return AbortNode(state, "Failed to read block");
@@ -4603,6 +5844,8 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *
     }
     // Apply the block atomically to the chain state.
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
+    static CMetricsHistogram& histConnectRead = ConnectBlockPhaseHistogram("read");
+    histConnectRead.Observe(nTime2 - nTime1);
     int64_t nTime3;
     LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
     {
@@ -4629,12 +5872,21 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *
             return error("ConnectTip(): ConnectBlock %s failed", pindexNew->GetBlockHash().ToString());
         }
         mapBlockSource.erase(pindexNew->GetBlockHash());
+        AssetsBookConnectBlock(*pblock, pindexNew);
+        RewardsBookConnectBlock(*pblock, pindexNew);
+        HeirBookConnectBlock(*pblock, pindexNew);
+        DiceBookConnectBlock(*pblock, pindexNew);
+        ChannelsBookConnectBlock(*pblock, pindexNew);
+        PegsBookConnectBlock(*pblock, pindexNew);
+        TokenCreateCacheConnectBlock(*pblock, pindexNew->GetBlockHash());
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
         LogPrint("bench", "  - Connect total: %.2fms [%.2fs]\n", (nTime3 - nTime2) * 0.001, nTimeConnectTotal * 0.000001);
         if ( KOMODO_NSPV_FULLNODE )
             assert(view.Flush());
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
+    static CMetricsHistogram& histConnectFlush = ConnectBlockPhaseHistogram("flush");
+    histConnectFlush.Observe(nTime4 - nTime3);
     LogPrint("bench", "  - Flush: %.2fms [%.2fs]\n", (nTime4 - nTime3) * 0.001, nTimeFlush * 0.000001);
     // Write the chain state to disk, if necessary.
     if ( KOMODO_NSPV_FULLNODE )
@@ -4643,10 +5895,13 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *
             return false;
     }
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
+    static CMetricsHistogram& histConnectChainState = ConnectBlockPhaseHistogram("chainstate");
+    histConnectChainState.Observe(nTime5 - nTime4);
     LogPrint("bench", "  - Writing chainstate: %.2fms [%.2fs]\n", (nTime5 - nTime4) * 0.001, nTimeChainState * 0.000001);
     // Remove conflicting transactions from the mempool.
     list<CTransaction> txConflicted;
     mempool.removeForBlock(pblock->vtx, pindexNew->GetHeight(), txConflicted, !IsInitialBlockDownload());
+    OrphanPoolConnectBlock(pblock->vtx);
 
     // Remove transactions that expire at new block height from mempool
     mempool.removeExpired(pindexNew->GetHeight());
@@ -4671,6 +5926,8 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *
     EnforceNodeDeprecation(pindexNew->GetHeight());
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
+    static CMetricsHistogram& histConnectPostProcess = ConnectBlockPhaseHistogram("postprocess");
+    histConnectPostProcess.Observe(nTime6 - nTime5);
     LogPrint("bench", "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001, nTimePostConnect * 0.000001);
     LogPrint("bench", "- Connect block: %.2fms [%.2fs]\n", (nTime6 - nTime1) * 0.001, nTimeTotal * 0.000001);
     if ( KOMODO_LONGESTCHAIN != 0 && (pindexNew->GetHeight() == KOMODO_LONGESTCHAIN || pindexNew->GetHeight() == KOMODO_LONGESTCHAIN+1) )
@@ -4850,11 +6107,17 @@ static bool ActivateBestChainStep(bool fSkipdpow, CValidationState &state, CBloc
 
     // Disconnect active blocks which are no longer in the best chain.
     bool fBlocksDisconnected = false;
-
-    while (chainActive.Tip() && chainActive.Tip() != pindexFork) {
-        if (!DisconnectTip(state))
+    {
+        CDisconnectBatch disconnectBatch;
+        bool fDisconnected = true;
+        while (chainActive.Tip() && chainActive.Tip() != pindexFork) {
+            if (!(fDisconnected = DisconnectTip(state, false, &disconnectBatch)))
+                break;
+            fBlocksDisconnected = true;
+        }
+        // the blocks disconnected before a failure still need their changes written
+        if (!disconnectBatch.Commit(state) || !fDisconnected)
             return false;
-        fBlocksDisconnected = true;
     }
     if ( KOMODO_REWIND != 0 )
     {
@@ -4891,9 +6154,23 @@ static bool ActivateBestChainStep(bool fSkipdpow, CValidationState &state, CBloc
         }
         nHeight = nTargetHeight;
 
+        // Read the next blocks ahead while the previous ones are connected.
+        int64_t nPrefetch = GetArg("-blockprefetch", DEFAULT_BLOCK_PREFETCH);
+        if (nPrefetch > 0) {
+            std::vector<const CBlockIndex*> vpindexPrefetch;
+            BOOST_REVERSE_FOREACH(CBlockIndex *pindexConnect, vpindexToConnect)
+                if (pindexConnect != pindexMostWork || pblock == NULL)
+                    vpindexPrefetch.push_back(pindexConnect);
+            blockPrefetcher.Prefetch(vpindexPrefetch, nPrefetch);
+        }
+
         // Connect new blocks.
         BOOST_REVERSE_FOREACH(CBlockIndex *pindexConnect, vpindexToConnect) {
-            if (!ConnectTip(state, pindexConnect, pindexConnect == pindexMostWork ? pblock : NULL)) {
+            CBlock blockPrefetched;
+            CBlock *pblockConnect = pindexConnect == pindexMostWork ? pblock : NULL;
+            if (pblockConnect == NULL && nPrefetch > 0 && blockPrefetcher.Get(pindexConnect, blockPrefetched))
+                pblockConnect = &blockPrefetched;
+            if (!ConnectTip(state, pindexConnect, pblockConnect)) {
                 if (state.IsInvalid()) {
                     // The block violates a consensus rule.
                     if (!state.CorruptionPossible())
@@ -4944,8 +6221,12 @@ bool ActivateBestChain(bool fSkipdpow, CValidationState &state, CBlock *pblock)
     const CChainParams& chainParams = Params();
     do {
         boost::this_thread::interruption_point();
+        // let the asynchronous subscribers catch up, so their queues don't take blocks without bound during a sync
+        LimitValidationInterfaceQueue();
 
         bool fInitialDownload;
+        // The peers that asked for new blocks as compact blocks, when pblock is the new tip
+        std::set<NodeId> setCmpctPeers;
         {
             LOCK(cs_main);
             pindexMostWork = FindMostWorkChain();
@@ -4958,6 +6239,11 @@ bool ActivateBestChain(bool fSkipdpow, CValidationState &state, CBlock *pblock)
                 return false;
             pindexNewTip = chainActive.Tip();
             fInitialDownload = IsInitialBlockDownload();
+            if (fCompactBlocks && pblock != NULL && pblock->GetHash() == pindexNewTip->GetBlockHash() && pblock->vtx.size() <= MAX_CMPCTBLOCK_TXN) {
+                for (map<NodeId, CNodeState>::iterator it = mapNodeState.begin(); it != mapNodeState.end(); it++)
+                    if (it->second.fPreferHeaderAndIDs)
+                        setCmpctPeers.insert(it->first);
+            }
         }
         // When we reach this point, we switched to a new tip (stored in pindexNewTip).
 
@@ -4971,10 +6257,29 @@ bool ActivateBestChain(bool fSkipdpow, CValidationState &state, CBlock *pblock)
             // Don't relay blocks if pruning -- could cause a peer to try to download, resulting
             // in a stalled download if the block file is pruned before the request.
             if (nLocalServices & NODE_NETWORK) {
+                CInv inv(MSG_BLOCK, hashNewTip);
+                CSharedMessage cmpctblock;
+                if (!setCmpctPeers.empty())
+                    cmpctblock = MakeSharedMessage("cmpctblock", CBlockHeaderAndShortTxIDs(*pblock, ASSETCHAINS_STAKED != 0));
                 LOCK(cs_vNodes);
                 BOOST_FOREACH(CNode* pnode, vNodes)
-                if (chainActive.Height() > (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : nBlockEstimate))
-                    pnode->PushInventory(CInv(MSG_BLOCK, hashNewTip));
+                {
+                    if (chainActive.Height() <= (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : nBlockEstimate))
+                        continue;
+                    // push the block right away to the peers that asked for it, skipping the inv round trip
+                    if (cmpctblock && setCmpctPeers.count(pnode->GetId())) {
+                        bool fKnown;
+                        {
+                            LOCK(pnode->cs_inventory);
+                            fKnown = pnode->setInventoryKnown.count(inv) != 0;
+                        }
+                        if (!fKnown) {
+                            pnode->PushSharedMessage(cmpctblock);
+                            pnode->AddInventoryKnown(inv);
+                        }
+                    }
+                    pnode->PushInventory(inv);
+                }
             }
             // Notify external listeners about the new tip.
             GetMainSignals().UpdatedBlockTip(pindexNewTip);
@@ -4999,6 +6304,7 @@ bool InvalidateBlock(CValidationState& state, CBlockIndex *pindex) {
     setDirtyBlockIndex.insert(pindex);
     setBlockIndexCandidates.erase(pindex);
 
+    CDisconnectBatch disconnectBatch;
     while (chainActive.Contains(pindex)) {
         CBlockIndex *pindexWalk = chainActive.Tip();
         pindexWalk->nStatus |= BLOCK_FAILED_CHILD;
@@ -5006,13 +6312,16 @@ bool InvalidateBlock(CValidationState& state, CBlockIndex *pindex) {
         setBlockIndexCandidates.erase(pindexWalk);
         // ActivateBestChain considers blocks already in chainActive
         // unconditionally valid already, so force disconnect away from it.
-        if (!DisconnectTip(state)) {
+        if (!DisconnectTip(state, false, &disconnectBatch)) {
+            disconnectBatch.Commit(state);
             mempool.removeForReorg(pcoinsTip, chainActive.Tip()->GetHeight() + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
             mempool.removeWithoutBranchId(
                                           CurrentEpochBranchId(chainActive.Tip()->GetHeight() + 1, Params().GetConsensus()));
             return false;
         }
     }
+    if (!disconnectBatch.Commit(state))
+        return false;
     //LimitMempoolSize(mempool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
 
     // The resulting new best tip may not be in setBlockIndexCandidates anymore, so
@@ -5101,14 +6410,13 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
         }
     }
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
+    CBlockIndex* pindexNew = blockIndexArena.Allocate(hash, block);
     assert(pindexNew);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
     pindexNew->nSequenceId = 0;
     BlockMap::iterator mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
-    pindexNew->phashBlock = &((*mi).first);
     if (miPrev != mapBlockIndex.end())
     {
         if ( (pindexNew->pprev = (*miPrev).second) != 0 )
@@ -5269,7 +6577,7 @@ bool FindBlockPos(int32_t tmpflag,CValidationState &state, CDiskBlockPos &pos, u
                     pos.nFile = TMPFILE_START;
                     pos.nPos = (*ptr)[0].nSize;
                     // Increase temp file one's max size by a chunk, so we wait a reasonable time to recheck the other file.
-                    maxTempFileSize0 += BLOCKFILE_CHUNK_SIZE;
+                    maxTempFileSize0 += nBlockFileChunkSize;
                 }
                 else 
                 {
@@ -5296,7 +6604,7 @@ bool FindBlockPos(int32_t tmpflag,CValidationState &state, CDiskBlockPos &pos, u
                     pos.nFile = TMPFILE_START+1;
                     pos.nPos = (*ptr)[1].nSize;
                     // Increase temp file one's max size by a chunk, so we wait a reasonable time to recheck the other file.
-                    maxTempFileSize1 += BLOCKFILE_CHUNK_SIZE;
+                    maxTempFileSize1 += nBlockFileChunkSize;
                 }
                 else 
                 {
@@ -5327,16 +6635,16 @@ bool FindBlockPos(int32_t tmpflag,CValidationState &state, CDiskBlockPos &pos, u
         (*ptr)[nFile].nSize += nAddSize;
 
     if (!fKnown) {
-        unsigned int nOldChunks = (pos.nPos + BLOCKFILE_CHUNK_SIZE - 1) / BLOCKFILE_CHUNK_SIZE;
-        unsigned int nNewChunks = ((*ptr)[nFile].nSize + BLOCKFILE_CHUNK_SIZE - 1) / BLOCKFILE_CHUNK_SIZE;
+        unsigned int nOldChunks = (pos.nPos + nBlockFileChunkSize - 1) / nBlockFileChunkSize;
+        unsigned int nNewChunks = ((*ptr)[nFile].nSize + nBlockFileChunkSize - 1) / nBlockFileChunkSize;
         if (nNewChunks > nOldChunks) {
             if (fPruneMode)
                 fCheckForPruning = true;
-            if (CheckDiskSpace(nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos)) {
+            if (CheckDiskSpace(nNewChunks * nBlockFileChunkSize - pos.nPos)) {
                 FILE *file = OpenBlockFile(pos);
                 if (file) {
-                    LogPrintf("Pre-allocating up to position 0x%x in blk%05u.dat\n", nNewChunks * BLOCKFILE_CHUNK_SIZE, pos.nFile);
-                    AllocateFileRange(file, pos.nPos, nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos);
+                    LogPrintf("Pre-allocating up to position 0x%x in blk%05u.dat\n", nNewChunks * nBlockFileChunkSize, pos.nFile);
+                    AllocateFileRange(file, pos.nPos, nNewChunks * nBlockFileChunkSize - pos.nPos);
                     fclose(file);
                 }
             }
@@ -5367,16 +6675,16 @@ bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigne
     nNewSize = (*ptr)[nFile].nUndoSize += nAddSize;
     setDirtyFileInfo.insert(nFile);
 
-    unsigned int nOldChunks = (pos.nPos + UNDOFILE_CHUNK_SIZE - 1) / UNDOFILE_CHUNK_SIZE;
-    unsigned int nNewChunks = (nNewSize + UNDOFILE_CHUNK_SIZE - 1) / UNDOFILE_CHUNK_SIZE;
+    unsigned int nOldChunks = (pos.nPos + nUndoFileChunkSize - 1) / nUndoFileChunkSize;
+    unsigned int nNewChunks = (nNewSize + nUndoFileChunkSize - 1) / nUndoFileChunkSize;
     if (nNewChunks > nOldChunks) {
         if (fPruneMode)
             fCheckForPruning = true;
-        if (CheckDiskSpace(nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos)) {
+        if (CheckDiskSpace(nNewChunks * nUndoFileChunkSize - pos.nPos)) {
             FILE *file = OpenUndoFile(pos);
             if (file) {
-                LogPrintf("Pre-allocating up to position 0x%x in rev%05u.dat\n", nNewChunks * UNDOFILE_CHUNK_SIZE, pos.nFile);
-                AllocateFileRange(file, pos.nPos, nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos);
+                LogPrintf("Pre-allocating up to position 0x%x in rev%05u.dat\n", nNewChunks * nUndoFileChunkSize, pos.nFile);
+                AllocateFileRange(file, pos.nPos, nNewChunks * nUndoFileChunkSize - pos.nPos);
                 fclose(file);
             }
         }
@@ -5800,13 +7108,18 @@ bool ContextualCheckBlock(int32_t slowflag,const CBlock& block, CValidationState
     const int nHeight = pindexPrev == NULL ? 0 : pindexPrev->GetHeight() + 1;
     const Consensus::Params& consensusParams = Params().GetConsensus();
     bool sapling = NetworkUpgradeActive(nHeight, consensusParams, Consensus::UPGRADE_SAPLING);
+    // History secured by a notarisation the user vouched for is not proof checked again
+    bool fCheckShieldedProofs = !IsAssumedNotarized(block.GetHash(), nHeight);
+
+    if (sapling && fCheckShieldedProofs)
+        CheckBlockSaplingProofs(block, nHeight);
 
     // Check that all transactions are finalized
     for (uint32_t i = 0; i < block.vtx.size(); i++) {
         const CTransaction& tx = block.vtx[i];
 
         // Check transaction contextually against consensus rules at block height
-        if (!ContextualCheckTransaction(slowflag,&block,pindexPrev,tx, state, nHeight, 100)) {
+        if (!ContextualCheckTransaction(slowflag,&block,pindexPrev,tx, state, nHeight, 100, IsInitialBlockDownload, 1, fCheckShieldedProofs)) {
             return false; // Failure reason has been set in validation state object
         }
 
@@ -5961,7 +7274,7 @@ bool AcceptBlock(int32_t *futureblockp,CBlock& block, CValidationState& state, C
     // blocks which are too close in height to the tip.  Apply this test
     // regardless of whether pruning is enabled; it should generally be safe to
     // not process unrequested blocks.
-    bool fTooFarAhead = (pindex->GetHeight() > int(chainActive.Height() + BLOCK_DOWNLOAD_WINDOW)); //MIN_BLOCKS_TO_KEEP));
+    bool fTooFarAhead = (pindex->GetHeight() > int(chainActive.Height() + BlockDownloadWindow())); //MIN_BLOCKS_TO_KEEP));
 
     // TODO: deal better with return value and error conditions for duplicate
     // and unrequested blocks.
@@ -6025,14 +7338,21 @@ bool AcceptBlock(int32_t *futureblockp,CBlock& block, CValidationState& state, C
 
     // Write block to history file
     try {
+        // a block already on disk (dbp != NULL) may be stored raw or compressed,
+        // its raw size is an upper bound of either record
         unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+        std::vector<unsigned char> vRecord;
+        if (dbp == NULL) {
+            GetBlockDiskRecord(block, vRecord);
+            nBlockSize = vRecord.size();
+        }
         CDiskBlockPos blockPos;
         if (dbp != NULL)
             blockPos = *dbp;
         if (!FindBlockPos(usetmp,state, blockPos, nBlockSize+8, nHeight, block.GetBlockTime(), dbp != NULL))
             return error("AcceptBlock(): FindBlockPos failed");
         if (dbp == NULL)
-            if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart()))
+            if (!WriteBlockToDisk(vRecord, blockPos, chainparams.MessageStart()))
                 AbortNode(state, "Failed to write block");
         if (!ReceivedBlockTransactions(block, state, pindex, blockPos))
             return error("AcceptBlock(): ReceivedBlockTransactions failed");
@@ -6096,11 +7416,8 @@ CBlockIndex *oldkomodo_ensure(CBlock *pblock, uint256 hash)
     CBlockIndex *pindex=0,*previndex=0;
     if ( (pindex = komodo_getblockindex(hash)) == 0 )
     {
-        pindex = new CBlockIndex();
-        if (!pindex)
-            throw runtime_error("komodo_ensure: new CBlockIndex failed");
-        BlockMap::iterator mi = mapBlockIndex.insert(make_pair(hash, pindex)).first;
-        pindex->phashBlock = &((*mi).first);
+        pindex = blockIndexArena.Allocate(hash);
+        mapBlockIndex.insert(make_pair(hash, pindex));
     }
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     if ( miSelf == mapBlockIndex.end() )
@@ -6162,7 +7479,7 @@ bool ProcessNewBlock(bool from_miner,int32_t height,CValidationState &state, CNo
         if ( chainActive.LastTip() != 0 )
             komodo_currentheight_set(chainActive.LastTip()->GetHeight());
         checked = CheckBlock(&futureblock,height!=0?height:komodo_block2height(pblock),0,*pblock, state, verifier,0);
-        bool fRequested = MarkBlockAsReceived(hash);
+        bool fRequested = MarkBlockAsReceived(hash, ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION));
         fRequested |= fForceProcessing;
         if ( checked != 0 && komodo_checkPOW(0,0,pblock,height) < 0 ) //from_miner && ASSETCHAINS_STAKED == 0
         {
@@ -6334,6 +7651,50 @@ void UnlinkPrunedFiles(std::set<int>& setFilesToPrune)
     }
 }
 
+bool IsCCInput(CScript const& scriptSig);
+
+/** The transactions of a pruned block that -prunekeeptxs keeps: the coinbase, the staking tx, notarisations and CC txs */
+static bool IsPrunedTxKept(const CBlock &block, int nTx)
+{
+    const CTransaction &tx = block.vtx[nTx];
+    if (nTx == 0 || (ASSETCHAINS_STAKED != 0 && nTx == (int)block.vtx.size() - 1))
+        return true;
+    if (komodo_is_notarytx(tx) != 0)
+        return true;
+    for (const CTxOut &txout : tx.vout)
+        if (txout.scriptPubKey.IsPayToCryptoCondition())
+            return true;
+    for (const CTxIn &txin : tx.vin)
+        if (IsCCInput(txin.scriptSig))
+            return true;
+    return false;
+}
+
+/** Copy the kept transactions of the main chain blocks in block file fileNumber, before it is pruned */
+static bool KeepPrunedTxs(int fileNumber)
+{
+    AssertLockHeld(cs_main);
+    std::vector<std::pair<uint256, CTransaction> > vKept;
+    int nBlocks = 0;
+    for (BlockMap::iterator it = mapBlockIndex.begin(); it != mapBlockIndex.end(); ++it)
+    {
+        CBlockIndex* pindex = it->second;
+        if (pindex == NULL || pindex->nFile != fileNumber || !(pindex->nStatus & BLOCK_HAVE_DATA) || !chainActive.Contains(pindex))
+            continue;
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, 0))
+            return error("%s: can't read block %s of blk%05u.dat, not pruning it", __func__, pindex->GetBlockHash().ToString(), fileNumber);
+        for (int i = 0; i < (int)block.vtx.size(); i++)
+            if (IsPrunedTxKept(block, i))
+                vKept.push_back(std::make_pair(pindex->GetBlockHash(), block.vtx[i]));
+        nBlocks++;
+    }
+    if (!vKept.empty() && !pblocktree->WritePrunedTxs(vKept))
+        return error("%s: can't write the kept transactions of blk%05u.dat, not pruning it", __func__, fileNumber);
+    LogPrint("prune", "Prune: kept %u transactions of %d blocks in blk%05u.dat\n", vKept.size(), nBlocks, fileNumber);
+    return true;
+}
+
 /* Calculate the block/rev files that should be deleted to remain under target*/
 void FindFilesToPrune(std::set<int>& setFilesToPrune)
 {
@@ -6349,7 +7710,7 @@ void FindFilesToPrune(std::set<int>& setFilesToPrune)
     // We don't check to prune until after we've allocated new space for files
     // So we should leave a buffer under our target to account for another allocation
     // before the next pruning.
-    uint64_t nBuffer = BLOCKFILE_CHUNK_SIZE + UNDOFILE_CHUNK_SIZE;
+    uint64_t nBuffer = nBlockFileChunkSize + nUndoFileChunkSize;
     uint64_t nBytesToPrune;
     int count=0;
 
@@ -6367,6 +7728,10 @@ void FindFilesToPrune(std::set<int>& setFilesToPrune)
             if (vinfoBlockFile[fileNumber].nHeightLast > nLastBlockWeCanPrune)
                 continue;
 
+            // the transactions CC and notarisation lookups need are copied out first
+            if (fPruneKeepTxs && !KeepPrunedTxs(fileNumber))
+                continue;
+
             PruneOneBlockFile(false, fileNumber);
             // Queue up the files for removal
             setFilesToPrune.insert(fileNumber);
@@ -6445,11 +7810,8 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw runtime_error("LoadBlockIndex(): new CBlockIndex failed");
-    mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
-    pindexNew->phashBlock = &((*mi).first);
+    CBlockIndex* pindexNew = blockIndexArena.Allocate(hash);
+    mapBlockIndex.insert(make_pair(hash, pindexNew));
     //fprintf(stderr,"inserted to block index %s\n",hash.ToString().c_str());
 
     return pindexNew;
@@ -6460,10 +7822,16 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
 bool static LoadBlockIndexDB()
 {
     const CChainParams& chainparams = Params();
+    int64_t nTimeStart = GetTimeMillis();
+    int nLoadThreads = GetArg("-loadindexthreads", DEFAULT_LOADINDEX_THREADS);
+    if (nLoadThreads <= 0)
+        nLoadThreads += GetNumCores();
+    nLoadThreads = std::max(1, std::min(nLoadThreads, MAX_SCRIPTCHECK_THREADS));
     LogPrintf("%s: start loading guts\n", __func__);
-    if (!pblocktree->LoadBlockIndexGuts())
+    if (!pblocktree->LoadBlockIndexGuts(nLoadThreads))
         return false;
-    LogPrintf("%s: loaded guts\n", __func__);
+    int64_t nTimeGuts = GetTimeMillis();
+    LogPrintf("%s: loaded guts, %u entries in %dms\n", __func__, (unsigned int)mapBlockIndex.size(), nTimeGuts - nTimeStart);
     boost::this_thread::interruption_point();
 
     // Calculate chainPower
@@ -6534,6 +7902,8 @@ bool static LoadBlockIndexDB()
         //komodo_pindex_init(pindex,(int32_t)pindex->GetHeight());
     }
     //fprintf(stderr,"load blockindexDB chained %u\n",(uint32_t)time(NULL));
+    int64_t nTimeChained = GetTimeMillis();
+    LogPrintf("%s: calculated chain power in %dms\n", __func__, nTimeChained - nTimeGuts);
 
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
@@ -6572,6 +7942,8 @@ bool static LoadBlockIndexDB()
         }
     }
 
+    LogPrintf("%s: loaded block file info and checked blk files in %dms\n", __func__, GetTimeMillis() - nTimeChained);
+
     // Check whether we have ever pruned block & undo files
     pblocktree->ReadFlag("prunedblockfiles", fHavePruned);
     if (fHavePruned)
@@ -6600,6 +7972,21 @@ bool static LoadBlockIndexDB()
     pblocktree->ReadFlag("unspentccindex", fUnspentCCIndex);
     LogPrintf("%s: unspent cc index %s\n", __func__, fUnspentCCIndex ? "enabled" : "disabled");
 
+    pblocktree->ReadFlag("tokenbalanceindex", fTokenBalanceIndex);
+    LogPrintf("%s: token balance index %s\n", __func__, fTokenBalanceIndex ? "enabled" : "disabled");
+
+    pblocktree->ReadFlag("oraclesindex", fOraclesIndex);
+    LogPrintf("%s: oracles samples index %s\n", __func__, fOraclesIndex ? "enabled" : "disabled");
+
+    pblocktree->ReadFlag("tokentagsindex", fTokenTagsIndex);
+    LogPrintf("%s: token tags index %s\n", __func__, fTokenTagsIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("agreementsindex", fAgreementsIndex);
+    LogPrintf("%s: agreements index %s\n", __func__, fAgreementsIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("gatewaysindex", fGatewaysIndex);
+    LogPrintf("%s: gateways index %s\n", __func__, fGatewaysIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("addressbalanceindex", fAddressBalanceIndex);
+    LogPrintf("%s: address balance index %s\n", __func__, fAddressBalanceIndex ? "enabled" : "disabled");
+
     // Fill in-memory data
     BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
     {
@@ -6664,66 +8051,140 @@ CVerifyDB::~CVerifyDB()
     uiInterface.ShowProgress("", 100);
 }
 
+/** Shared state of the threads running check levels 0-2 of CVerifyDB */
+struct CVerifyDBBlocks
+{
+    //! blocks to check, tip first
+    std::vector<CBlockIndex*> vBlocks;
+    int nCheckLevel;
+    std::atomic<size_t> nNext;
+    std::atomic<bool> fStop;
+    bool fShutdown;
+    boost::mutex mutex;
+    //! first failure found, empty if none
+    std::string strError;
+
+    CVerifyDBBlocks(int nCheckLevelIn) : nCheckLevel(nCheckLevelIn), nNext(0), fStop(false), fShutdown(false) {}
+};
+
+/** Read and check blocks of pshared until all are done or one fails, the master also reports progress */
+static void VerifyDBBlocksThread(CVerifyDBBlocks* pshared, bool fMaster)
+{
+    // No need to verify JoinSplits twice
+    auto verifier = libzcash::ProofVerifier::Disabled();
+    while (!pshared->fStop) {
+        size_t i = pshared->nNext++;
+        if (i >= pshared->vBlocks.size())
+            break;
+        if (ShutdownRequested()) {
+            boost::unique_lock<boost::mutex> lock(pshared->mutex);
+            pshared->fShutdown = true;
+            pshared->fStop = true;
+            break;
+        }
+        if (fMaster)
+            uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)((double)i / (double)pshared->vBlocks.size() * (pshared->nCheckLevel >= 4 ? 50 : 100)))));
+
+        CBlockIndex* pindex = pshared->vBlocks[i];
+        CBlock block;
+        CValidationState state;
+        std::string strError;
+        int32_t futureblock;
+        // check level 0: read from disk
+        if (!ReadBlockFromDisk(block, pindex,0))
+            strError = strprintf("ReadBlockFromDisk failed at %d, hash=%s", pindex->GetHeight(), pindex->GetBlockHash().ToString());
+        // check level 1: verify block validity
+        else if (pshared->nCheckLevel >= 1 && !CheckBlock(&futureblock,pindex->GetHeight(),pindex,block, state, verifier,0))
+            strError = strprintf("found bad block at %d, hash=%s", pindex->GetHeight(), pindex->GetBlockHash().ToString());
+        // check level 2: verify undo validity
+        else if (pshared->nCheckLevel >= 2) {
+            CBlockUndo undo;
+            CDiskBlockPos pos = pindex->GetUndoPos();
+            if (!pos.IsNull() && !UndoReadFromDisk(undo, pos, pindex->pprev->GetBlockHash()))
+                strError = strprintf("found bad undo data at %d, hash=%s", pindex->GetHeight(), pindex->GetBlockHash().ToString());
+        }
+        if (!strError.empty()) {
+            boost::unique_lock<boost::mutex> lock(pshared->mutex);
+            if (pshared->strError.empty())
+                pshared->strError = strError;
+            pshared->fStop = true;
+        }
+    }
+}
+
 bool CVerifyDB::VerifyDB(CCoinsView *coinsview, int nCheckLevel, int nCheckDepth)
 {
-    LOCK(cs_main);
-    if (chainActive.Tip() == NULL || chainActive.Tip()->pprev == NULL)
+    CBlockIndex* pindexTip;
+    nCheckLevel = std::max(0, std::min(4, nCheckLevel));
+    CVerifyDBBlocks blocks(nCheckLevel);
+    {
+        LOCK(cs_main);
+        if (chainActive.Tip() == NULL || chainActive.Tip()->pprev == NULL)
+            return true;
+
+        // Verify blocks in the best chain
+        if (nCheckDepth <= 0)
+            nCheckDepth = 1000000000; // suffices until the year 19000
+        if (nCheckDepth > chainActive.Height())
+            nCheckDepth = chainActive.Height();
+        LogPrintf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
+        pindexTip = chainActive.Tip();
+        for (CBlockIndex* pindex = pindexTip; pindex && pindex->pprev && pindex->GetHeight() >= chainActive.Height()-nCheckDepth; pindex = pindex->pprev)
+            blocks.vBlocks.push_back(pindex);
+    }
+
+    // Levels 0-2 only read the blocks and their undo data, so they run on
+    // several threads without holding cs_main.
+    int nThreads = std::max(1, nScriptCheckThreads);
+    boost::thread_group threadGroup;
+    try {
+        for (int i = 0; i < nThreads - 1; i++)
+            threadGroup.create_thread(boost::bind(&VerifyDBBlocksThread, &blocks, false));
+        VerifyDBBlocksThread(&blocks, true);
+        threadGroup.join_all();
+    } catch (const boost::thread_interrupted&) {
+        blocks.fStop = true;
+        threadGroup.join_all();
+        throw;
+    }
+    if (blocks.fShutdown)
         return true;
+    if (!blocks.strError.empty())
+        return error("VerifyDB(): *** %s", blocks.strError);
 
-    // Verify blocks in the best chain
-    if (nCheckDepth <= 0)
-        nCheckDepth = 1000000000; // suffices until the year 19000
-    if (nCheckDepth > chainActive.Height())
-        nCheckDepth = chainActive.Height();
-    nCheckLevel = std::max(0, std::min(4, nCheckLevel));
-    LogPrintf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
+    LOCK(cs_main);
+    if (chainActive.Tip() != pindexTip) {
+        LogPrintf("VerifyDB(): best chain changed while verifying blocks, skipping coin database checks\n");
+        return true;
+    }
     CCoinsViewCache coins(coinsview);
     CBlockIndex* pindexState = chainActive.Tip();
     CBlockIndex* pindexFailure = NULL;
     int nGoodTransactions = 0;
     CValidationState state;
-    // No need to verify JoinSplits twice
-    auto verifier = libzcash::ProofVerifier::Disabled();
-    //fprintf(stderr,"start VerifyDB %u\n",(uint32_t)time(NULL));
-    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev)
+    // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
+    for (size_t i = 0; nCheckLevel >= 3 && i < blocks.vBlocks.size(); i++)
     {
+        CBlockIndex* pindex = blocks.vBlocks[i];
         boost::this_thread::interruption_point();
         uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->GetHeight())) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
-        if (pindex->GetHeight() < chainActive.Height()-nCheckDepth)
+        if (pindex != pindexState || (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) > nCoinCacheUsage)
             break;
         CBlock block;
-        // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex,0))
             return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->GetHeight(), pindex->GetBlockHash().ToString());
-        // check level 1: verify block validity
-        int32_t futureblock;
-        if (nCheckLevel >= 1 && !CheckBlock(&futureblock,pindex->GetHeight(),pindex,block, state, verifier,0) )
-            return error("VerifyDB(): *** found bad block at %d, hash=%s\n", pindex->GetHeight(), pindex->GetBlockHash().ToString());
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            CDiskBlockPos pos = pindex->GetUndoPos();
-            if (!pos.IsNull()) {
-                if (!UndoReadFromDisk(undo, pos, pindex->pprev->GetBlockHash()))
-                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->GetHeight(), pindex->GetBlockHash().ToString());
-            }
-        }
-        // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
-            bool fClean = true;
-            if (!DisconnectBlock(block, state, pindex, coins, &fClean))
-                return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->GetHeight(), pindex->GetBlockHash().ToString());
-            pindexState = pindex->pprev;
-            if (!fClean) {
-                nGoodTransactions = 0;
-                pindexFailure = pindex;
-            } else
-                nGoodTransactions += block.vtx.size();
-        }
+        bool fClean = true;
+        if (!DisconnectBlock(block, state, pindex, coins, &fClean))
+            return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->GetHeight(), pindex->GetBlockHash().ToString());
+        pindexState = pindex->pprev;
+        if (!fClean) {
+            nGoodTransactions = 0;
+            pindexFailure = pindex;
+        } else
+            nGoodTransactions += block.vtx.size();
         if (ShutdownRequested())
             return true;
     }
-    //fprintf(stderr,"end VerifyDB %u\n",(uint32_t)time(NULL));
     if (pindexFailure)
         return error("VerifyDB(): *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", chainActive.Height() - pindexFailure->GetHeight() + 1, nGoodTransactions);
 
@@ -6801,6 +8262,7 @@ bool RewindBlockIndex(const CChainParams& params, bool& clearWitnessCaches)
 
     CValidationState state;
     CBlockIndex* pindex = chainActive.Tip();
+    CDisconnectBatch disconnectBatch;
     while (chainActive.Height() >= nHeight) {
         if (fPruneMode && !(chainActive.Tip()->nStatus & BLOCK_HAVE_DATA)) {
             // If pruning, don't try rewinding past the HAVE_DATA point;
@@ -6810,13 +8272,18 @@ bool RewindBlockIndex(const CChainParams& params, bool& clearWitnessCaches)
             // of the blockchain).
             break;
         }
-        if (!DisconnectTip(state, true)) {
+        if (!DisconnectTip(state, true, &disconnectBatch)) {
+            disconnectBatch.Commit(state);
             return error("RewindBlockIndex: unable to disconnect block at height %i", pindex->GetHeight());
         }
         // Occasionally flush state to disk.
-        if (!FlushStateToDisk(state, FLUSH_STATE_PERIODIC))
+        if (!FlushStateToDisk(state, FLUSH_STATE_PERIODIC)) {
+            disconnectBatch.Commit(state);
             return false;
+        }
     }
+    if (!disconnectBatch.Commit(state))
+        return false;
 
     // Reduce validity flag and have-data flags.
 
@@ -6897,11 +8364,16 @@ void UnloadBlockIndex()
     LOCK(cs_main);
     setBlockIndexCandidates.clear();
     chainActive.SetTip(NULL);
+    chainActiveLogicalTimes.Clear();
+    komodo_minerwindow_update(NULL);
     pindexBestInvalid = NULL;
     pindexBestHeader = NULL;
     mempool.clear();
     mapOrphanTransactions.clear();
     mapOrphanTransactionsByPrev.clear();
+    mapOrphanBytesByPeer.clear();
+    vOrphanWorkQueue.clear();
+    orphanPoolInfo = COrphanPoolInfo();
     nSyncStarted = 0;
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
@@ -6917,10 +8389,8 @@ void UnloadBlockIndex()
     mapNodeState.clear();
     recentRejects.reset(NULL);
 
-    BOOST_FOREACH(BlockMap::value_type& entry, mapBlockIndex) {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
+    blockIndexArena.Clear();
     fHavePruned = false;
 }
 
@@ -6971,6 +8441,23 @@ bool InitBlockIndex() {
         pblocktree->WriteFlag("unspentccindex", fUnspentCCIndex);
         fprintf(stderr, "fUnspentCCIndex.%d\n", fUnspentCCIndex);
 
+        fTokenBalanceIndex = GetBoolArg("-tokenbalanceindex", DEFAULT_TOKENBALANCEINDEX);
+        pblocktree->WriteFlag("tokenbalanceindex", fTokenBalanceIndex);
+
+        fOraclesIndex = GetBoolArg("-oraclesindex", DEFAULT_ORACLESINDEX);
+        pblocktree->WriteFlag("oraclesindex", fOraclesIndex);
+
+        fTokenTagsIndex = GetBoolArg("-tokentagsindex", DEFAULT_TOKENTAGSINDEX);
+        pblocktree->WriteFlag("tokentagsindex", fTokenTagsIndex);
+        fAgreementsIndex = GetBoolArg("-agreementsindex", DEFAULT_AGREEMENTSINDEX);
+        pblocktree->WriteFlag("agreementsindex", fAgreementsIndex);
+        fGatewaysIndex = GetBoolArg("-gatewaysindex", DEFAULT_GATEWAYSINDEX);
+        pblocktree->WriteFlag("gatewaysindex", fGatewaysIndex);
+        // the balances are maintained with the address unspent index
+        fAddressBalanceIndex = fAddressIndex && GetBoolArg("-addressbalanceindex", DEFAULT_ADDRESSBALANCEINDEX);
+        pblocktree->WriteFlag("addressbalanceindex", fAddressBalanceIndex);
+        pblocktree->WriteFlag("separateindexdb", GetArg("-indexdbcache", 0) > 0);
+
         LogPrintf("Initializing databases...\n");
     }
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -7006,21 +8493,82 @@ bool InitBlockIndex() {
 
 
 
-bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos *dbp)
+// Map of disk positions for blocks with unknown parent (only used for reindex)
+static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+
+/**
+ * Process a block read from an external file, out of order blocks are kept in mapBlocksUnknownParent
+ * until their parent is processed. Returns false if a system error should stop the import.
+ */
+static bool ProcessExternalBlock(CBlock& block, CDiskBlockPos *dbp, int& nLoaded)
 {
     const CChainParams& chainparams = Params();
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
+    // detect out of order blocks, and store them for later
+    uint256 hash = block.GetHash();
+    if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+        LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                 block.hashPrevBlock.ToString());
+        if (dbp)
+            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+        return true;
+    }
 
-    int nLoaded = 0;
+    // process in case the block isn't known yet
+    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+        CValidationState state;
+        if (ProcessNewBlock(0,0,state, NULL, &block, true, dbp))
+            nLoaded++;
+        if (state.IsError())
+            return false;
+    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && komodo_blockheight(hash) % 1000 == 0) {
+        LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), komodo_blockheight(hash));
+    }
+
+    // Recursively process earlier encountered successors of this block
+    deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            
+            if (ReadBlockFromDisk(mapBlockIndex.count(hash)!=0?mapBlockIndex[hash]->GetHeight():0,block, it->second,1))
+            {
+                LogPrintf("%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
+                          head.ToString());
+                CValidationState dummy;
+                if (ProcessNewBlock(0,0,dummy, NULL, &block, true, &it->second))
+                {
+                    nLoaded++;
+                    queue.push_back(block.GetHash());
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+        }
+    }
+    return true;
+}
+
+/**
+ * Locate and deserialize the blocks in fileIn. If pvScanned is NULL the blocks are processed as they are read,
+ * otherwise they are collected with their file offset for ordered processing by the caller.
+ */
+static void ScanExternalBlockFile(FILE* fileIn, CDiskBlockPos *dbp, int& nLoaded, std::vector<std::pair<std::shared_ptr<CBlock>, unsigned int> > *pvScanned, const std::atomic<bool> *pfStop)
+{
     try {
+        // The whole file is read front to back, let the kernel read ahead further
+        FileAdvise(fileIn, 0, 0, FILE_ADVICE_SEQUENTIAL);
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         //CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SIZE, MAX_BLOCK_SIZE+8, SER_DISK, CLIENT_VERSION);
         CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SIZE(10000000), MAX_BLOCK_SIZE(10000000)+8, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
         while (!blkdat.eof()) {
             boost::this_thread::interruption_point();
+            if (pfStop && *pfStop)
+                break;
 
             blkdat.SetPos(nRewind);
             nRewind++; // start one byte further next time, in case of failure
@@ -7044,73 +8592,165 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos *dbp)
             }
             try {
                 // read block
-                CBlock block;
+                std::shared_ptr<CBlock> pblock(new CBlock());
                 uint64_t nBlockPos = blkdat.GetPos();
                 if (dbp)
                     dbp->nPos = nBlockPos;
                 blkdat.SetLimit(nBlockPos + nSize);
                 blkdat.SetPos(nBlockPos);
-                blkdat >> block;
+                unsigned char magic[sizeof(BLOCKDATA_FRAME_MAGIC)];
+                blkdat >> FLATDATA(magic);
+                if (IsBlockDataFrame(magic)) {
+                    std::vector<unsigned char> vFrame(nSize);
+                    blkdat.SetPos(nBlockPos);
+                    blkdat.read((char*)&vFrame[0], nSize);
+                    uint32_t nRawSize, nCompressedSize;
+                    std::vector<unsigned char> vData;
+                    if (!ParseBlockDataFrameHeader(&vFrame[0], nRawSize, nCompressedSize) || nCompressedSize + BLOCKDATA_FRAME_HEADER_SIZE != nSize ||
+                        !DecompressBlockData(&vFrame[BLOCKDATA_FRAME_HEADER_SIZE], nCompressedSize, nRawSize, vData))
+                        throw std::ios_base::failure("corrupt compressed block record");
+                    CSpanReader ss(vData, SER_DISK, CLIENT_VERSION);
+                    ss >> *pblock;
+                } else {
+                    blkdat.SetPos(nBlockPos);
+                    blkdat >> *pblock;
+                }
                 
                 nRewind = blkdat.GetPos();
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                             block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+                if (pvScanned) {
+                    pvScanned->push_back(std::make_pair(pblock, (unsigned int)nBlockPos));
                     continue;
                 }
-
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    CValidationState state;
-                    if (ProcessNewBlock(0,0,state, NULL, &block, true, dbp))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != chainparams.GetConsensus().hashGenesisBlock && komodo_blockheight(hash) % 1000 == 0) {
-                    LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), komodo_blockheight(hash));
-                }
-
-                // Recursively process earlier encountered successors of this block
-                deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        
-                        if (ReadBlockFromDisk(mapBlockIndex.count(hash)!=0?mapBlockIndex[hash]->GetHeight():0,block, it->second,1))
-                        {
-                            LogPrintf("%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
-                                      head.ToString());
-                            CValidationState dummy;
-                            if (ProcessNewBlock(0,0,dummy, NULL, &block, true, &it->second))
-                            {
-                                nLoaded++;
-                                queue.push_back(block.GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                    }
-                }
+                if (!ProcessExternalBlock(*pblock, dbp, nLoaded))
+                    break;
             } catch (const std::exception& e) {
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
         }
+        if (fDropBlockCache)
+            FileAdvise(fileIn, 0, 0, FILE_ADVICE_DONTNEED);
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
+}
+
+bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos *dbp)
+{
+    int64_t nStart = GetTimeMillis();
+
+    int nLoaded = 0;
+    ScanExternalBlockFile(fileIn, dbp, nLoaded, NULL, NULL);
     if (nLoaded > 0)
         LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
     return nLoaded > 0;
 }
 
+/** Shared state of the reindex scan threads, see LoadBlockFilesParallel */
+struct CBlockFileScan
+{
+    struct CScannedFile {
+        CScannedFile() : fExists(false) {}
+        bool fExists;
+        std::vector<std::pair<std::shared_ptr<CBlock>, unsigned int> > vBlocks;
+    };
+
+    CBlockFileScan(int nWindowIn) : nWindow(nWindowIn), nNextFile(0), nProcessing(0), fStop(false) {}
+
+    const int nWindow;
+    int nNextFile;      //!< next blk file to hand out to a scan thread
+    int nProcessing;    //!< blk file being processed by the import thread
+    std::atomic<bool> fStop;
+    boost::mutex cs;
+    boost::condition_variable cond;
+    std::map<int, CScannedFile> mapScanned;
+
+    void Thread()
+    {
+        RenameThread("komodo-blkscan");
+        while (true) {
+            int nFile;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                // don't read too far ahead of the import thread, scanned files are kept in memory
+                while (!fStop && nNextFile >= nProcessing + nWindow)
+                    cond.wait(lock);
+                if (fStop)
+                    return;
+                nFile = nNextFile++;
+            }
+            CScannedFile scanned;
+            CDiskBlockPos pos(nFile, 0);
+            FILE *file = NULL;
+            if (boost::filesystem::exists(GetBlockPosFilename(pos, "blk")) && (file = OpenBlockFile(pos, true)) != NULL) {
+                int nUnused = 0;
+                scanned.fExists = true;
+                ScanExternalBlockFile(file, NULL, nUnused, &scanned.vBlocks, &fStop);
+            }
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                mapScanned[nFile].fExists = scanned.fExists;
+                mapScanned[nFile].vBlocks.swap(scanned.vBlocks);
+            }
+            cond.notify_all();
+            if (!scanned.fExists)
+                return; // no block files left to reindex
+        }
+    }
+};
+
+bool LoadBlockFilesParallel(int nThreads)
+{
+    int64_t nStart = GetTimeMillis();
+    int nLoaded = 0;
+    CBlockFileScan scan(nThreads + 1);
+    boost::thread_group scanThreads;
+    for (int i = 0; i < nThreads; i++)
+        scanThreads.create_thread(boost::bind(&CBlockFileScan::Thread, &scan));
+
+    try {
+        for (int nFile = 0; ; nFile++) {
+            CBlockFileScan::CScannedFile scanned;
+            {
+                boost::unique_lock<boost::mutex> lock(scan.cs);
+                scan.nProcessing = nFile;
+                scan.cond.notify_all();
+                while (scan.mapScanned.count(nFile) == 0)
+                    scan.cond.wait(lock);
+                std::map<int, CBlockFileScan::CScannedFile>::iterator it = scan.mapScanned.find(nFile);
+                scanned.fExists = it->second.fExists;
+                scanned.vBlocks.swap(it->second.vBlocks);
+                scan.mapScanned.erase(it);
+            }
+            if (!scanned.fExists)
+                break; // No block files left to reindex
+            LogPrintf("Reindexing block file blk%05u.dat (%u blocks)...\n", (unsigned int)nFile, (unsigned int)scanned.vBlocks.size());
+            bool fError = false;
+            for (size_t i = 0; i < scanned.vBlocks.size() && !fError; i++) {
+                boost::this_thread::interruption_point();
+                CDiskBlockPos pos(nFile, scanned.vBlocks[i].second);
+                try {
+                    fError = !ProcessExternalBlock(*scanned.vBlocks[i].first, &pos, nLoaded);
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+                }
+                scanned.vBlocks[i].first.reset();
+            }
+        }
+    } catch (const boost::thread_interrupted&) {
+        scan.fStop = true;
+        scan.cond.notify_all();
+        scanThreads.join_all();
+        throw;
+    }
+
+    scan.fStop = true;
+    scan.cond.notify_all();
+    scanThreads.join_all();
+    if (nLoaded > 0)
+        LogPrintf("Loaded %i blocks from block files with %d scan threads in %dms\n", nLoaded, nThreads, GetTimeMillis() - nStart);
+    return nLoaded > 0;
+}
+
 void static CheckBlockIndex()
 {
     const Consensus::Params& consensusParams = Params().GetConsensus();
@@ -7399,72 +9039,288 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
     return true;
 }
 
-void static ProcessGetData(CNode* pfrom)
+/**
+ * LRU cache of the block messages served to peers, so a block asked for by
+ * many syncing peers is read from disk and framed once, never decoded, and
+ * shares one buffer on all their send queues. The disk serialization of a
+ * block is its wire serialization. Bounded by -blockservecache MiB.
+ */
+class CServedBlockCache
 {
-    std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
+private:
+    struct BlockEntry {
+        CSharedMessage pmsg;
+        std::list<uint256>::iterator itLru;
+    };
+    //! most recently served block first
+    std::list<uint256> lru;
+    std::map<uint256, BlockEntry> mapBlocks;
+    size_t nBytes;
+    boost::mutex cs;
 
-    vector<CInv> vNotFound;
+    void Erase(std::map<uint256, BlockEntry>::iterator it)
+    {
+        nBytes -= it->second.pmsg->size();
+        lru.erase(it->second.itLru);
+        mapBlocks.erase(it);
+    }
 
-    LOCK(cs_main);
+public:
+    CServedBlockCache() : nBytes(0) {}
 
-    while (it != pfrom->vRecvGetData.end()) {
-        // Don't bother if send buffer is too full to respond anyway
-        if (pfrom->nSendSize >= SendBufferSize())
-            break;
+    CSharedMessage Get(const uint256 &hash)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        std::map<uint256, BlockEntry>::iterator it = mapBlocks.find(hash);
+        if (it == mapBlocks.end())
+            return CSharedMessage();
+        lru.splice(lru.begin(), lru, it->second.itLru);
+        return it->second.pmsg;
+    }
 
-        const CInv &inv = *it;
-        {
-            boost::this_thread::interruption_point();
-            it++;
+    void Set(const uint256 &hash, const CSharedMessage &pmsg)
+    {
+        size_t nMaxBytes = std::max((int64_t)0, GetArg("-blockservecache", DEFAULT_BLOCK_SERVE_CACHE_SIZE)) << 20;
+        if (pmsg->size() > nMaxBytes / 4)
+            return;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
-            {
-                bool send = false;
-                BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
-                if (mi != mapBlockIndex.end())
-                {
-                    if (chainActive.Contains(mi->second)) {
-                        send = true;
-                    } else {
-                        static const int nOneMonth = 30 * 24 * 60 * 60;
-                        // To prevent fingerprinting attacks, only send blocks outside of the active
-                        // chain if they are valid, and no more than a month older (both in time, and in
-                        // best equivalent proof of work) than the best header chain we know about.
-                        send = mi->second->IsValid(BLOCK_VALID_SCRIPTS) && (pindexBestHeader != NULL) &&
-                        (pindexBestHeader->GetBlockTime() - mi->second->GetBlockTime() < nOneMonth) &&
-                        (GetBlockProofEquivalentTime(*pindexBestHeader, *mi->second, *pindexBestHeader, Params().GetConsensus()) < nOneMonth);
-                        if (!send) {
-                            LogPrintf("%s: ignoring request from peer=%i for old block that isn't in the main chain\n", __func__, pfrom->GetId());
-                        }
-                    }
-                }
-                // Pruned nodes may have deleted the block, so check whether
-                // it's available before trying to send.
-                if (send && (mi->second->nStatus & BLOCK_HAVE_DATA))
-                {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second,1))
+        boost::unique_lock<boost::mutex> lock(cs);
+        std::map<uint256, BlockEntry>::iterator it = mapBlocks.find(hash);
+        if (it != mapBlocks.end())
+            Erase(it);
+        while (!lru.empty() && nBytes + pmsg->size() > nMaxBytes)
+            Erase(mapBlocks.find(lru.back()));
+
+        lru.push_front(hash);
+        BlockEntry &entry = mapBlocks[hash];
+        entry.pmsg = pmsg;
+        entry.itLru = lru.begin();
+        nBytes += pmsg->size();
+    }
+};
+
+static CServedBlockCache servedBlockCache;
+
+/** The block message for the block at pos, from the served block cache or from disk. NULL if it can't be read */
+static CSharedMessage GetServedBlockMessage(const uint256 &hash, const CDiskBlockPos &pos)
+{
+    CSharedMessage pmsg = servedBlockCache.Get(hash);
+    if (pmsg)
+        return pmsg;
+
+    std::vector<unsigned char> vData;
+    if (!ReadRawBlockFromDisk(vData, pos))
+        return pmsg;
+    // only the header is decoded, to make sure the record is the block asked for, its
+    // Equihash solution takes well under 64 KiB
+    try {
+        size_t nHeaderBytes = std::min(vData.size(), CBlockHeader::HEADER_SIZE + 65536);
+        CSpanReader ss(&vData[0], &vData[0] + nHeaderBytes, SER_NETWORK, PROTOCOL_VERSION);
+        CBlockHeader header;
+        ss >> header;
+        if (header.GetHash() != hash)
+            return pmsg;
+    } catch (const std::exception&) {
+        return pmsg;
+    }
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss.reserve(CMessageHeader::HEADER_SIZE + vData.size());
+    BeginSharedMessage(ss, "block");
+    ss.write((const char*)&vData[0], vData.size());
+    pmsg = EndSharedMessage(ss);
+    servedBlockCache.Set(hash, pmsg);
+    return pmsg;
+}
+
+/** A block read for filtered block requests, with its decoding for bloom filter matching */
+struct CFilteredBlockSource
+{
+    CBlock block;
+    CBloomBlockData data;
+    size_t nBytes;
+
+    explicit CFilteredBlockSource(const CBlock &blockIn) : block(blockIn), data(block)
+    {
+        nBytes = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION) + data.DynamicMemoryUsage();
+    }
+};
+typedef std::shared_ptr<const CFilteredBlockSource> CFilteredBlockSourceRef;
+
+/**
+ * LRU cache of the blocks recently served as filtered blocks, decoded and with
+ * the data pushes of their scripts parsed out. SPV wallets syncing from us ask
+ * for the same recent blocks with their own filters; each filter is matched
+ * against the cached decoding instead of reading and parsing the block again.
+ * Bounded by -blockservecache MiB, like the served block cache.
+ */
+class CFilteredBlockCache
+{
+private:
+    struct BlockEntry {
+        CFilteredBlockSourceRef psource;
+        std::list<uint256>::iterator itLru;
+    };
+    //! most recently served block first
+    std::list<uint256> lru;
+    std::map<uint256, BlockEntry> mapBlocks;
+    size_t nBytes;
+    boost::mutex cs;
+
+    void Erase(std::map<uint256, BlockEntry>::iterator it)
+    {
+        nBytes -= it->second.psource->nBytes;
+        lru.erase(it->second.itLru);
+        mapBlocks.erase(it);
+    }
+
+public:
+    CFilteredBlockCache() : nBytes(0) {}
+
+    CFilteredBlockSourceRef Get(const uint256 &hash)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        std::map<uint256, BlockEntry>::iterator it = mapBlocks.find(hash);
+        if (it == mapBlocks.end())
+            return CFilteredBlockSourceRef();
+        lru.splice(lru.begin(), lru, it->second.itLru);
+        return it->second.psource;
+    }
+
+    void Set(const uint256 &hash, const CFilteredBlockSourceRef &psource)
+    {
+        size_t nMaxBytes = std::max((int64_t)0, GetArg("-blockservecache", DEFAULT_BLOCK_SERVE_CACHE_SIZE)) << 20;
+        if (psource->nBytes > nMaxBytes / 4)
+            return;
+
+        boost::unique_lock<boost::mutex> lock(cs);
+        std::map<uint256, BlockEntry>::iterator it = mapBlocks.find(hash);
+        if (it != mapBlocks.end())
+            Erase(it);
+        while (!lru.empty() && nBytes + psource->nBytes > nMaxBytes)
+            Erase(mapBlocks.find(lru.back()));
+
+        lru.push_front(hash);
+        BlockEntry &entry = mapBlocks[hash];
+        entry.psource = psource;
+        entry.itLru = lru.begin();
+        nBytes += psource->nBytes;
+    }
+};
+
+static CFilteredBlockCache filteredBlockCache;
+
+/** The block at pos decoded for filtered block requests, from the cache or from disk. NULL if it can't be read */
+static CFilteredBlockSourceRef GetFilteredBlockSource(const CBlockIndex *pindex, const uint256 &hash, const CDiskBlockPos &pos)
+{
+    CFilteredBlockSourceRef psource = filteredBlockCache.Get(hash);
+    if (psource)
+        return psource;
+
+    CBlock block;
+    if (!ReadBlockFromDisk(pindex->GetHeight(), block, pos, 1) || block.GetHash() != hash)
+        return psource;
+    psource = std::make_shared<const CFilteredBlockSource>(block);
+    filteredBlockCache.Set(hash, psource);
+    return psource;
+}
+
+void static ProcessGetData(CNode* pfrom)
+{
+    std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
+
+    vector<CInv> vNotFound;
+
+    while (it != pfrom->vRecvGetData.end()) {
+        // Don't bother if send buffer is too full to respond anyway
+        if (pfrom->nSendSize >= SendBufferSize())
+            break;
+
+        const CInv &inv = *it;
+        {
+            boost::this_thread::interruption_point();
+            it++;
+
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
+            {
+                // only the lookup takes cs_main, the block is read from disk and sent without it
+                CBlockIndex *pindex = NULL;
+                CDiskBlockPos pos;
+                bool fRecent = false;
+                {
+                    LOCK(cs_main);
+                    bool send = false;
+                    BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
+                    if (mi != mapBlockIndex.end())
+                    {
+                        if (chainActive.Contains(mi->second)) {
+                            send = true;
+                        } else {
+                            static const int nOneMonth = 30 * 24 * 60 * 60;
+                            // To prevent fingerprinting attacks, only send blocks outside of the active
+                            // chain if they are valid, and no more than a month older (both in time, and in
+                            // best equivalent proof of work) than the best header chain we know about.
+                            send = mi->second->IsValid(BLOCK_VALID_SCRIPTS) && (pindexBestHeader != NULL) &&
+                            (pindexBestHeader->GetBlockTime() - mi->second->GetBlockTime() < nOneMonth) &&
+                            (GetBlockProofEquivalentTime(*pindexBestHeader, *mi->second, *pindexBestHeader, Params().GetConsensus()) < nOneMonth);
+                            if (!send) {
+                                LogPrintf("%s: ignoring request from peer=%i for old block that isn't in the main chain\n", __func__, pfrom->GetId());
+                            }
+                        }
+                    }
+                    // Pruned nodes may have deleted the block, so check whether
+                    // it's available before trying to send.
+                    if (send && (mi->second->nStatus & BLOCK_HAVE_DATA))
                     {
-                        assert(!"cannot load block from disk");
+                        pindex = mi->second;
+                        pos = pindex->GetBlockPos();
+                        // a peer that got behind is better served by the full block than by a reconstruction from its mempool
+                        fRecent = chainActive.Contains(pindex) && chainActive.Height() - pindex->GetHeight() < MAX_CMPCTBLOCK_DEPTH;
+                    }
+                }
+                if (pindex != NULL)
+                {
+                    // Send block from disk. A full block is sent as it is stored, without
+                    // decoding and encoding it again, the others need the decoded block
+                    bool fRaw = inv.type == MSG_BLOCK || (inv.type == MSG_CMPCT_BLOCK && !fRecent);
+                    CSharedMessage pmsg;
+                    CFilteredBlockSourceRef psource;
+                    CBlock block;
+                    bool fRead;
+                    if (fRaw) {
+                        pmsg = GetServedBlockMessage(inv.hash, pos);
+                        fRead = pmsg != NULL;
+                    } else if (inv.type == MSG_FILTERED_BLOCK) {
+                        psource = GetFilteredBlockSource(pindex, inv.hash, pos);
+                        fRead = psource != NULL;
+                    } else
+                        fRead = ReadBlockFromDisk(pindex->GetHeight(), block, pos, 1) && block.GetHash() == inv.hash;
+                    if (!fRead)
+                    {
+                        // the block may have been pruned since the lookup
+                        LOCK(cs_main);
+                        if (pindex->nStatus & BLOCK_HAVE_DATA)
+                            assert(!"cannot load block from disk");
                     }
                     else
                     {
-                        if (inv.type == MSG_BLOCK)
+                        if (fRaw)
+                        {
+                            pfrom->PushSharedMessage(pmsg);
+                        }
+                        else if (inv.type == MSG_CMPCT_BLOCK)
                         {
-                            //uint256 hash; int32_t z;
-                            //hash = block.GetHash();
-                            //for (z=31; z>=0; z--)
-                            //    fprintf(stderr,"%02x",((uint8_t *)&hash)[z]);
-                            //fprintf(stderr," send block %d\n",komodo_block2height(&block));
-                            pfrom->PushMessage("block", block);
+                            // too many txns for the 16 bit indexes of a compact block
+                            if (block.vtx.size() <= MAX_CMPCTBLOCK_TXN)
+                                pfrom->PushMessage("cmpctblock", CBlockHeaderAndShortTxIDs(block, ASSETCHAINS_STAKED != 0));
+                            else
+                                pfrom->PushMessage("block", block);
                         }
                         else // MSG_FILTERED_BLOCK)
                         {
                             LOCK(pfrom->cs_filter);
                             if (pfrom->pfilter)
                             {
-                                CMerkleBlock merkleBlock(block, *pfrom->pfilter);
+                                CMerkleBlock merkleBlock(psource->data, *pfrom->pfilter);
                                 pfrom->PushMessage("merkleblock", merkleBlock);
                                 // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
                                 // This avoids hurting performance by pointlessly requiring a round-trip
@@ -7475,7 +9331,7 @@ void static ProcessGetData(CNode* pfrom)
                                 typedef std::pair<unsigned int, uint256> PairType;
                                 BOOST_FOREACH(PairType& pair, merkleBlock.vMatchedTxn)
                                 if (!pfrom->setInventoryKnown.count(CInv(MSG_TX, pair.second)))
-                                    pfrom->PushMessage("tx", block.vtx[pair.first]);
+                                    pfrom->PushMessage("tx", psource->block.vtx[pair.first]);
                             }
                             // else
                             // no response
@@ -7488,7 +9344,10 @@ void static ProcessGetData(CNode* pfrom)
                         // and we want it right after the last block so they don't
                         // wait for other stuff first.
                         vector<CInv> vInv;
-                        vInv.push_back(CInv(MSG_BLOCK, chainActive.Tip()->GetBlockHash()));
+                        {
+                            LOCK(cs_main);
+                            vInv.push_back(CInv(MSG_BLOCK, chainActive.Tip()->GetBlockHash()));
+                        }
                         pfrom->PushMessage("inv", vInv);
                         pfrom->hashContinue.SetNull();
                     }
@@ -7532,7 +9391,7 @@ void static ProcessGetData(CNode* pfrom)
             // Track requests for our stuff.
             GetMainSignals().Inventory(inv.hash);
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
                 break;
         }
     }
@@ -7551,6 +9410,650 @@ void static ProcessGetData(CNode* pfrom)
     }
 }
 
+/**
+ * Runs the peer handlers that don't hold cs_main for their whole run, the
+ * block getdata serving and the nSPV requests, on the -msgworkerthreads
+ * threads, so one slow peer doesn't hold up the message handler for all the
+ * others.
+ *
+ * A peer has at most one task queued or running and ProcessMessages and
+ * SendMessages skip it until the task is done, so its messages are still
+ * handled in order. The task runs under the peer's cs_vRecvMsg, as it would
+ * on the message handler.
+ */
+class CPeerWorkQueue
+{
+public:
+    CPeerWorkQueue() : fStop(false), nWorkers(0) {}
+    ~CPeerWorkQueue() { Stop(); }
+
+    void Start(int nThreads)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = false;
+        for (int i = 0; i < nThreads; i++)
+            workers.create_thread(boost::bind(&CPeerWorkQueue::Thread, this));
+        nWorkers += nThreads;
+    }
+
+    /**
+     * Queue task for pfrom, fFront to run it before the queued ones. Returns
+     * false if it is not queued, the caller runs it now
+     */
+    bool Submit(CNode *pfrom, const boost::function<void()> &task, bool fFront = false)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            if (fStop || nWorkers == 0 || setBusy.count(pfrom->id))
+                return false;
+            pfrom->AddRef();
+            setBusy.insert(pfrom->id);
+            if (fFront)
+                tasks.push_front(std::make_pair(pfrom, task));
+            else
+                tasks.push_back(std::make_pair(pfrom, task));
+        }
+        cond.notify_one();
+        return true;
+    }
+
+    /** Whether peer id has a task queued or running */
+    bool IsBusy(NodeId id)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        return setBusy.count(id) != 0;
+    }
+
+    void Stop()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fStop = true;
+        }
+        cond.notify_all();
+        workers.join_all();
+        boost::unique_lock<boost::mutex> lock(cs);
+        nWorkers = 0;
+        for (std::deque<CPeerTask>::iterator it = tasks.begin(); it != tasks.end(); ++it)
+            it->first->Release();
+        tasks.clear();
+        setBusy.clear();
+    }
+
+private:
+    typedef std::pair<CNode*, boost::function<void()> > CPeerTask;
+
+    void Thread()
+    {
+        RenameThread("komodo-msgwork");
+        while (true) {
+            CPeerTask task;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (!fStop && tasks.empty())
+                    cond.wait(lock);
+                if (fStop)
+                    return;
+                task = tasks.front();
+                tasks.pop_front();
+            }
+            CNode *pfrom = task.first;
+            {
+                LOCK(pfrom->cs_vRecvMsg);
+                try {
+                    if (!pfrom->fDisconnect)
+                        task.second();
+                } catch (const std::exception& e) {
+                    PrintExceptionContinue(&e, "CPeerWorkQueue::Thread()");
+                } catch (...) {
+                    PrintExceptionContinue(NULL, "CPeerWorkQueue::Thread()");
+                }
+            }
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                setBusy.erase(pfrom->id);
+                pfrom->Release();
+            }
+            WakeMessageHandler();
+        }
+    }
+
+    bool fStop;
+    int nWorkers;
+    boost::mutex cs;
+    boost::condition_variable cond;
+    std::deque<CPeerTask> tasks;
+    std::set<NodeId> setBusy;
+    boost::thread_group workers;
+};
+
+static CPeerWorkQueue peerWorkQueue;
+
+void StartMessageWorkers(int nThreads)
+{
+    peerWorkQueue.Start(nThreads);
+}
+
+void StopMessageWorkers()
+{
+    peerWorkQueue.Stop();
+}
+
+/** Serve the getdata queue of pfrom, on a message worker if it holds blocks to read from disk */
+static void ServeGetData(CNode* pfrom)
+{
+    BOOST_FOREACH(const CInv &inv, pfrom->vRecvGetData)
+    {
+        if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
+        {
+            if (peerWorkQueue.Submit(pfrom, boost::bind(&ProcessGetData, pfrom)))
+                return;
+            break;
+        }
+    }
+    ProcessGetData(pfrom);
+}
+
+/** Answers a getblocktxn with the txns asked for, or with the full block if it is no longer near the tip */
+static void ProcessGetBlockTxn(CNode* pfrom, const BlockTransactionsRequest& req)
+{
+    CBlockIndex *pindex = NULL;
+    CDiskBlockPos pos;
+    bool fFull = false;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(req.blockhash);
+        if (mi == mapBlockIndex.end() || mi->second == NULL || !(mi->second->nStatus & BLOCK_HAVE_DATA)) {
+            LogPrint("net", "peer %d sent us a getblocktxn for a block we don't have\n", pfrom->id);
+            return;
+        }
+        pindex = mi->second;
+        if (!chainActive.Contains(pindex) || chainActive.Height() - pindex->GetHeight() >= MAX_BLOCKTXN_DEPTH) {
+            LogPrint("net", "peer %d sent us a getblocktxn for a block > %i deep\n", pfrom->id, MAX_BLOCKTXN_DEPTH);
+            fFull = true;
+        }
+        pos = pindex->GetBlockPos();
+    }
+    if (fFull) {
+        pfrom->vRecvGetData.push_back(CInv(MSG_BLOCK, req.blockhash));
+        ProcessGetData(pfrom);
+        return;
+    }
+
+    CBlock block;
+    if (!ReadBlockFromDisk(pindex->GetHeight(), block, pos, 1) || block.GetHash() != req.blockhash)
+        return;
+
+    BlockTransactions resp(req);
+    for (size_t i = 0; i < req.indexes.size(); i++) {
+        if (req.indexes[i] >= block.vtx.size()) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 100);
+            LogPrintf("peer %d sent us a getblocktxn with out-of-bounds tx indices\n", pfrom->id);
+            return;
+        }
+        resp.txn[i] = block.vtx[req.indexes[i]];
+    }
+    pfrom->PushMessage("blocktxn", resp);
+}
+
+/**
+ * Checks a BIP 157 request for the filters of the blocks from nStartHeight to
+ * hashStop, a peer asking for filters that are not served is disconnected.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, uint8_t nFilterType, uint32_t nStartHeight, const uint256& hashStop, uint32_t nMaxSize, const CBlockIndex*& pstop)
+{
+    if (!(nLocalServices & NODE_COMPACT_FILTERS) || nFilterType != BLOCK_FILTER_BASIC) {
+        LogPrint("net", "peer %d requested unsupported block filter type %d\n", pfrom->id, nFilterType);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    LOCK(cs_main);
+    BlockMap::iterator mi = mapBlockIndex.find(hashStop);
+    if (mi == mapBlockIndex.end() || !chainActive.Contains(mi->second)) {
+        LogPrint("net", "peer %d requested block filters up to unknown block %s\n", pfrom->id, hashStop.ToString());
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    pstop = mi->second;
+    uint32_t nStopHeight = pstop->GetHeight();
+    if (nStartHeight > nStopHeight || nStopHeight - nStartHeight >= nMaxSize) {
+        LogPrint("net", "peer %d sent a bad block filter range, start %d stop %d\n", pfrom->id, nStartHeight, nStopHeight);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    return true;
+}
+
+static void ProcessGetCFilters(CNode* pfrom, CDataStream& vRecv)
+{
+    uint8_t nFilterType;
+    uint32_t nStartHeight;
+    uint256 hashStop;
+    const CBlockIndex *pstop = NULL;
+    std::vector<BlockFilter> filters;
+
+    vRecv >> nFilterType >> nStartHeight >> hashStop;
+    if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, hashStop, MAX_GETCFILTERS_SIZE, pstop))
+        return;
+    // the filters not indexed yet are not answered, as a peer still syncing them
+    if (!LookupBlockFilterRange((BlockFilterType)nFilterType, nStartHeight, pstop, filters)) {
+        LogPrint("net", "failed to find the block filters for height %d to %s\n", nStartHeight, hashStop.ToString());
+        return;
+    }
+    for (const BlockFilter& filter : filters)
+        pfrom->PushMessage("cfilter", nFilterType, filter.GetBlockHash(), filter.GetEncodedFilter());
+}
+
+static void ProcessGetCFHeaders(CNode* pfrom, CDataStream& vRecv)
+{
+    uint8_t nFilterType;
+    uint32_t nStartHeight;
+    uint256 hashStop, prevHeader;
+    const CBlockIndex *pstop = NULL;
+    std::vector<uint256> hashes;
+
+    vRecv >> nFilterType >> nStartHeight >> hashStop;
+    if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, hashStop, MAX_GETCFHEADERS_SIZE, pstop))
+        return;
+    if (nStartHeight > 0 && !LookupBlockFilterHeader((BlockFilterType)nFilterType, pstop->GetAncestor(nStartHeight - 1), prevHeader)) {
+        LogPrint("net", "failed to find the block filter header for height %d\n", nStartHeight - 1);
+        return;
+    }
+    if (!LookupBlockFilterHashRange((BlockFilterType)nFilterType, nStartHeight, pstop, hashes)) {
+        LogPrint("net", "failed to find the block filter hashes for height %d to %s\n", nStartHeight, hashStop.ToString());
+        return;
+    }
+    pfrom->PushMessage("cfheaders", nFilterType, hashStop, prevHeader, hashes);
+}
+
+static void ProcessGetCFCheckPt(CNode* pfrom, CDataStream& vRecv)
+{
+    uint8_t nFilterType;
+    uint256 hashStop;
+    const CBlockIndex *pstop = NULL;
+
+    vRecv >> nFilterType >> hashStop;
+    if (!PrepareBlockFilterRequest(pfrom, nFilterType, 0, hashStop, std::numeric_limits<uint32_t>::max(), pstop))
+        return;
+    std::vector<uint256> headers(pstop->GetHeight() / CFCHECKPT_INTERVAL);
+    for (size_t i = 0; i < headers.size(); i++)
+        if (!LookupBlockFilterHeader((BlockFilterType)nFilterType, pstop->GetAncestor((i + 1) * CFCHECKPT_INTERVAL), headers[i])) {
+            LogPrint("net", "failed to find the block filter header for height %d\n", (int)((i + 1) * CFCHECKPT_INTERVAL));
+            return;
+        }
+    pfrom->PushMessage("cfcheckpt", nFilterType, hashStop, headers);
+}
+
+/** Processes a block reconstructed from a compact block, as the block message does */
+static void ProcessCompactBlock(CNode* pfrom, CBlock& block)
+{
+    CInv inv(MSG_BLOCK, block.GetHash());
+    pfrom->AddInventoryKnown(inv);
+
+    CValidationState state;
+    // the block was requested, MarkBlockAsInFlight was called when its compact block arrived
+    ProcessNewBlock(0,0,state, pfrom, &block, false, NULL);
+    ProcessQueuedOrphans();
+    int nDoS;
+    if (state.IsInvalid(nDoS)) {
+        pfrom->PushMessage("reject", std::string("cmpctblock"), state.GetRejectCode(),
+                           state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
+        if (nDoS > 0) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), nDoS);
+        }
+        return;
+    }
+    LOCK(cs_main);
+    if (chainActive.Tip() != NULL && chainActive.Tip()->GetBlockHash() == inv.hash)
+        MaybeSetPeerAsAnnouncingHeaderAndIDs(pfrom);
+}
+
+/**
+ * Checks a relayed tx ahead of AcceptToMemoryPool on the -txprecheckthreads
+ * threads, without holding cs_main during the checks. The results are not
+ * trusted: the checks only fill the signature caches and the Sapling proof
+ * cache, AcceptToMemoryPool still validates the tx under cs_main and finds
+ * the expensive checks done.
+ *
+ * Txns are handed back to the message handler in the order they were queued,
+ * so a parent relayed before its child is still accepted first.
+ */
+class CTxPreChecker
+{
+public:
+    CTxPreChecker() : fStop(false), nWorkers(0) {}
+    ~CTxPreChecker() { Stop(); }
+
+    void Start(int nThreads)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = false;
+        for (int i = 0; i < nThreads; i++)
+            workers.create_thread(boost::bind(&CTxPreChecker::Thread, this));
+        nWorkers += nThreads;
+    }
+
+    /** Queue tx received from pfrom. Returns false if it is not queued, the caller processes it now */
+    bool Submit(CNode *pfrom, const CTransaction &tx)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            if (fStop || nWorkers == 0 || jobs.size() >= MAX_TXPRECHECK_QUEUE)
+                return false;
+            pfrom->AddRef();
+            jobs.push_back(CPreCheckJob(pfrom, tx));
+            CPreCheckJob &job = jobs.back();
+            // the same tx from several peers is checked once
+            if (setQueued.insert(tx.GetHash()).second) {
+                job.fChecked = true;
+                vTodo.push_back(&job);
+            } else
+                job.fDone = true;
+        }
+        cond.notify_one();
+        return true;
+    }
+
+    /** Move the checked txns to vChecked in the order they were queued. The caller releases the nodes */
+    void PopChecked(std::vector<std::pair<CNode*, CTransaction> > &vChecked)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (!jobs.empty() && jobs.front().fDone) {
+            CPreCheckJob &job = jobs.front();
+            if (job.fChecked)
+                setQueued.erase(job.tx.GetHash());
+            vChecked.push_back(std::make_pair(job.pfrom, job.tx));
+            jobs.pop_front();
+        }
+    }
+
+    void Stop()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fStop = true;
+        }
+        cond.notify_all();
+        workers.join_all();
+        boost::unique_lock<boost::mutex> lock(cs);
+        nWorkers = 0;
+        BOOST_FOREACH(CPreCheckJob &job, jobs)
+            job.pfrom->Release();
+        jobs.clear();
+        vTodo.clear();
+        setQueued.clear();
+    }
+
+private:
+    struct CPreCheckJob {
+        CPreCheckJob(CNode *pfromIn, const CTransaction &txIn) : pfrom(pfromIn), tx(txIn), fChecked(false), fDone(false) {}
+        CNode *pfrom;
+        CTransaction tx;
+        bool fChecked;
+        bool fDone;
+    };
+
+    /** AcceptToMemoryPool's checker without the CC eval, which needs cs_main. The fulfillment signatures are still checked and cached */
+    class CPreCheckSignatureChecker : public ServerTransactionSignatureChecker
+    {
+    public:
+        CPreCheckSignatureChecker(const CTransaction* txToIn, unsigned int nIn, const CAmount& amount, const PrecomputedTransactionData& txdataIn) :
+            ServerTransactionSignatureChecker(txToIn, nIn, amount, true, 0, 0, NULL, txdataIn) {}
+
+        int CheckEvalCondition(const CC *cond) const { return 1; }
+    };
+
+    static void Check(const CTransaction &tx)
+    {
+        if (tx.IsCoinBase())
+            return;
+
+        // snapshot the spent coins and the branch id, the checks run on the copy
+        CCoinsView dummy;
+        CCoinsViewCache view(&dummy);
+        uint32_t consensusBranchId;
+        {
+            LOCK2(cs_main, mempool.cs);
+            if (chainActive.LastTip() == NULL || mempool.exists(tx.GetHash()))
+                return;
+            consensusBranchId = CurrentEpochBranchId(chainActive.Height() + 1, Params().GetConsensus());
+            CCoinsViewMemPool viewMemPool(pcoinsTip, mempool);
+            view.SetBackend(viewMemPool);
+            BOOST_FOREACH(const CTxIn &txin, tx.vin)
+                view.AccessCoins(txin.prevout.hash);
+            view.SetBackend(dummy);
+        }
+
+        // JoinSplits are left to AcceptToMemoryPool, the Sprout verifier is not run concurrently
+        if (!tx.vShieldedSpend.empty() || !tx.vShieldedOutput.empty())
+        {
+            uint256 dataToBeSigned;
+            CScript scriptCode;
+            try {
+                dataToBeSigned = SignatureHash(scriptCode, tx, NOT_AN_INPUT, SIGHASH_ALL, 0, consensusBranchId);
+            } catch (std::logic_error ex) {
+                return;
+            }
+            CValidationState state;
+            uint256 key = CSaplingProofCache::Key(tx, dataToBeSigned);
+            if (!saplingProofCache.Get(key) && VerifySaplingProofs(tx, dataToBeSigned, state))
+                saplingProofCache.Set(key);
+        }
+
+        PrecomputedTransactionData txdata(tx);
+        for (unsigned int i = 0; i < tx.vin.size(); i++)
+        {
+            const COutPoint &prevout = tx.vin[i].prevout;
+            const CCoins *coins = view.AccessCoins(prevout.hash);
+            // inputs of unknown parents and imports are checked by AcceptToMemoryPool only
+            if (coins == NULL || !coins->IsAvailable(prevout.n))
+                continue;
+            CPreCheckSignatureChecker checker(&tx, i, coins->vout[prevout.n].nValue, txdata);
+            VerifyScript(tx.vin[i].scriptSig, coins->vout[prevout.n].scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, checker, consensusBranchId);
+        }
+    }
+
+    void Thread()
+    {
+        RenameThread("komodo-txcheck");
+        while (true) {
+            CPreCheckJob *pjob;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (!fStop && vTodo.empty())
+                    cond.wait(lock);
+                if (fStop)
+                    return;
+                pjob = vTodo.front();
+                vTodo.pop_front();
+            }
+            try {
+                Check(pjob->tx);
+            } catch (const std::exception& e) {
+                LogPrint("mempool", "tx pre-check of %s failed: %s\n", pjob->tx.GetHash().ToString(), e.what());
+            }
+            boost::unique_lock<boost::mutex> lock(cs);
+            pjob->fDone = true;
+        }
+    }
+
+    bool fStop;
+    int nWorkers;
+    boost::mutex cs;
+    boost::condition_variable cond;
+    std::list<CPreCheckJob> jobs;
+    std::deque<CPreCheckJob*> vTodo;
+    std::set<uint256> setQueued;
+    boost::thread_group workers;
+};
+
+static CTxPreChecker txPreChecker;
+
+void StartTxPreCheck(int nThreads)
+{
+    txPreChecker.Start(nThreads);
+}
+
+void StopTxPreCheck()
+{
+    txPreChecker.Stop();
+}
+
+/**
+ * Tries the orphans spending outputs of the txids in vWorkQueue, whose transactions are
+ * in the mempool or a block now. All the orphans of a txid are tried as one batch, each
+ * once even if it spends several of its outputs, and the accepted ones are added to
+ * vWorkQueue for their own orphans.
+ */
+static void ProcessOrphansFor(vector<uint256>& vWorkQueue) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    set<NodeId> setMisbehaving;
+    for (unsigned int i = 0; i < vWorkQueue.size(); i++)
+    {
+        set<uint256> setOrphans;
+        for (map<COutPoint, set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.lower_bound(COutPoint(vWorkQueue[i], 0));
+             itByPrev != mapOrphanTransactionsByPrev.end() && itByPrev->first.hash == vWorkQueue[i];
+             ++itByPrev)
+            setOrphans.insert(itByPrev->second.begin(), itByPrev->second.end());
+
+        BOOST_FOREACH(const uint256& orphanHash, setOrphans)
+        {
+            map<uint256, COrphanTx>::iterator itOrphan = mapOrphanTransactions.find(orphanHash);
+            if (itOrphan == mapOrphanTransactions.end())
+                continue;  // resolved by an earlier txid of the batch
+            const CTransaction orphanTx = itOrphan->second.tx;
+            NodeId fromPeer = itOrphan->second.fromPeer;
+            bool fMissingInputs2 = false;
+            // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
+            // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
+            // anyone relaying LegitTxX banned)
+            CValidationState stateDummy;
+
+            if (setMisbehaving.count(fromPeer))
+                continue;
+            if (AcceptToMemoryPool(mempool, stateDummy, orphanTx, true, &fMissingInputs2))
+            {
+                LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
+                RelayTransaction(orphanTx);
+                vWorkQueue.push_back(orphanHash);
+                EraseOrphanTx(orphanHash);
+                orphanPoolInfo.nResolved++;
+            }
+            else if (!fMissingInputs2)
+            {
+                int nDos = 0;
+                if (stateDummy.IsInvalid(nDos) && nDos > 0)
+                {
+                    // Punish peer that gave us an invalid orphan tx
+                    Misbehaving(fromPeer, nDos);
+                    setMisbehaving.insert(fromPeer);
+                    LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash.ToString());
+                }
+                // Has inputs but not accepted to mempool
+                // Probably non-standard or insufficient fee/priority
+                LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
+                EraseOrphanTx(orphanHash);
+                orphanPoolInfo.nRejected++;
+                assert(recentRejects);
+                recentRejects->insert(orphanHash);
+            }
+            mempool.check(pcoinsTip);
+        }
+    }
+}
+
+/** Tries the orphans of the blocks connected since the last call */
+static void ProcessQueuedOrphans()
+{
+    LOCK(cs_main);
+    if (vOrphanWorkQueue.empty())
+        return;
+    vector<uint256> vWorkQueue;
+    vWorkQueue.swap(vOrphanWorkQueue);
+    ProcessOrphansFor(vWorkQueue);
+}
+
+/** Accept a tx relayed by pfrom to the mempool, with the orphans it resolves */
+static void ProcessTransaction(CNode* pfrom, const CTransaction& tx, const std::string& strCommand)
+{
+    vector<uint256> vWorkQueue;
+    CInv inv(MSG_TX, tx.GetHash());
+
+    LOCK(cs_main);
+
+    bool fMissingInputs = false;
+    CValidationState state;
+
+    pfrom->setAskFor.erase(inv.hash);
+    mapAlreadyAskedFor.erase(inv);
+
+    if (!AlreadyHave(inv) && AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs))
+    {
+        mempool.check(pcoinsTip);
+        RelayTransaction(tx);
+        vWorkQueue.push_back(inv.hash);
+
+        LogPrint("mempool", "AcceptToMemoryPool: peer=%d %s: accepted %s (poolsz %u)\n",
+                 pfrom->id, pfrom->cleanSubVer,
+                 tx.GetHash().ToString(),
+                 mempool.mapTx.size());
+
+        // Process any orphan transactions that depended on this one
+        ProcessOrphansFor(vWorkQueue);
+    }
+    // TODO: currently, prohibit joinsplits and shielded spends/outputs from entering mapOrphans
+    else if (fMissingInputs &&
+             tx.vjoinsplit.empty() &&
+             tx.vShieldedSpend.empty() &&
+             tx.vShieldedOutput.empty())
+    {
+        // valid stake transactions end up in the orphan tx bin
+        AddOrphanTx(tx, pfrom->GetId());
+
+        // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
+        unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+        unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
+        if (nEvicted > 0)
+            LogPrint("mempool", "mapOrphan overflow, removed %u tx\n", nEvicted);
+    } else {
+        assert(recentRejects);
+        recentRejects->insert(tx.GetHash());
+
+        if (pfrom->fWhitelisted) {
+            // Always relay transactions received from whitelisted peers, even
+            // if they were already in the mempool or rejected from it due
+            // to policy, allowing the node to function as a gateway for
+            // nodes hidden behind it.
+            //
+            // Never relay transactions that we would assign a non-zero DoS
+            // score for, as we expect peers to do the same with us in that
+            // case.
+            int nDoS = 0;
+            if (!state.IsInvalid(nDoS) || nDoS == 0) {
+                LogPrintf("Force relaying tx %s from whitelisted peer=%d\n", tx.GetHash().ToString(), pfrom->id);
+                RelayTransaction(tx);
+            } else {
+                LogPrintf("Not relaying invalid transaction %s from whitelisted peer=%d (%s (code %d))\n",
+                          tx.GetHash().ToString(), pfrom->id, state.GetRejectReason(), state.GetRejectCode());
+            }
+        }
+    }
+    int nDoS = 0;
+    if (state.IsInvalid(nDoS))
+    {
+        LogPrint("mempool", "%s from peer=%d %s was not accepted into the memory pool: %s\n", tx.GetHash().ToString(),
+                 pfrom->id, pfrom->cleanSubVer,
+                 state.GetRejectReason());
+        pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
+                           state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
+        if (nDoS > 0)
+            Misbehaving(pfrom->GetId(), nDoS);
+    }
+}
+
 #include "komodo_nSPV_defs.h"
 #include "komodo_nSPV.h"            // shared defines, structs, serdes, purge functions
 #include "komodo_nSPV_fullnode.h"   // nSPV fullnode handling of the getnSPV request messages
@@ -7762,6 +10265,9 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             LOCK(cs_main);
             State(pfrom->GetId())->fCurrentlyConnected = true;
         }
+        // Tell the peer we can receive compact blocks, peers that don't know sendcmpct ignore it
+        if (fCompactBlocks && !KOMODO_NSPV_SUPERLITE)
+            pfrom->PushMessage("sendcmpct", false, CMPCTBLOCKS_VERSION);
     }
 
 
@@ -7954,7 +10460,9 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         vRecv >> payload;
 
         if (strCommand == "getnSPV" && KOMODO_NSPV_FULLNODE) {
-            komodo_nSPVreq(pfrom, payload);
+            // info and notarisation requests of light clients go ahead of the index scans of others
+            if (!peerWorkQueue.Submit(pfrom, boost::bind(&komodo_nSPVreq, pfrom, payload), NSPV_ischeaprequest(payload)))
+                komodo_nSPVreq(pfrom, payload);
         } else if (strCommand == "nSPV" && KOMODO_NSPV_SUPERLITE) {
             komodo_nSPVresp(pfrom, payload);
         }
@@ -8003,8 +10511,12 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                     pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), inv.hash);
                     CNodeState *nodestate = State(pfrom->GetId());
                     if (chainActive.Tip()->GetBlockTime() > GetTime() - chainparams.GetConsensus().nPowTargetSpacing * 20 &&
-                        nodestate->nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
-                        vToFetch.push_back(inv);
+                        nodestate->nBlocksInFlight < MaxBlocksInTransitPerPeer()) {
+                        // a new block near the tip is mostly made of txns we have, fetch it as a compact block if we can
+                        if (fCompactBlocks && nodestate->fProvidesHeaderAndIDs)
+                            vToFetch.push_back(CInv(MSG_CMPCT_BLOCK, inv.hash));
+                        else
+                            vToFetch.push_back(inv);
                         // Mark block as in flight already, even though the actual "getdata" message only goes out
                         // later (within the same cs_main lock, though).
                         MarkBlockAsInFlight(pfrom->GetId(), inv.hash, chainparams.GetConsensus());
@@ -8044,7 +10556,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             LogPrint("net", "received getdata for: %s peer=%d\n", vInv[0].ToString(), pfrom->id);
 
         pfrom->vRecvGetData.insert(pfrom->vRecvGetData.end(), vInv.begin(), vInv.end());
-        ProcessGetData(pfrom);
+        ServeGetData(pfrom);
     }
 
 
@@ -8149,135 +10661,15 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         if (IsInitialBlockDownload())
             return true;
 
-        vector<uint256> vWorkQueue;
-        vector<uint256> vEraseQueue;
         CTransaction tx;
         vRecv >> tx;
 
         CInv inv(MSG_TX, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        LOCK(cs_main);
-
-        bool fMissingInputs = false;
-        CValidationState state;
-
-        pfrom->setAskFor.erase(inv.hash);
-        mapAlreadyAskedFor.erase(inv);
-
-        if (!AlreadyHave(inv) && AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs))
-        {
-            mempool.check(pcoinsTip);
-            RelayTransaction(tx);
-            vWorkQueue.push_back(inv.hash);
-
-            LogPrint("mempool", "AcceptToMemoryPool: peer=%d %s: accepted %s (poolsz %u)\n",
-                     pfrom->id, pfrom->cleanSubVer,
-                     tx.GetHash().ToString(),
-                     mempool.mapTx.size());
-
-            // Recursively process any orphan transactions that depended on this one
-            set<NodeId> setMisbehaving;
-            for (unsigned int i = 0; i < vWorkQueue.size(); i++)
-            {
-                map<uint256, set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue[i]);
-                if (itByPrev == mapOrphanTransactionsByPrev.end())
-                    continue;
-                for (set<uint256>::iterator mi = itByPrev->second.begin();
-                     mi != itByPrev->second.end();
-                     ++mi)
-                {
-                    const uint256& orphanHash = *mi;
-                    const CTransaction& orphanTx = mapOrphanTransactions[orphanHash].tx;
-                    NodeId fromPeer = mapOrphanTransactions[orphanHash].fromPeer;
-                    bool fMissingInputs2 = false;
-                    // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
-                    // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
-                    // anyone relaying LegitTxX banned)
-                    CValidationState stateDummy;
-
-
-                    if (setMisbehaving.count(fromPeer))
-                        continue;
-                    if (AcceptToMemoryPool(mempool, stateDummy, orphanTx, true, &fMissingInputs2))
-                    {
-                        LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
-                        RelayTransaction(orphanTx);
-                        vWorkQueue.push_back(orphanHash);
-                        vEraseQueue.push_back(orphanHash);
-                    }
-                    else if (!fMissingInputs2)
-                    {
-                        int nDos = 0;
-                        if (stateDummy.IsInvalid(nDos) && nDos > 0)
-                        {
-                            // Punish peer that gave us an invalid orphan tx
-                            Misbehaving(fromPeer, nDos);
-                            setMisbehaving.insert(fromPeer);
-                            LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash.ToString());
-                        }
-                        // Has inputs but not accepted to mempool
-                        // Probably non-standard or insufficient fee/priority
-                        LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
-                        vEraseQueue.push_back(orphanHash);
-                        assert(recentRejects);
-                        recentRejects->insert(orphanHash);
-                    }
-                    mempool.check(pcoinsTip);
-                }
-            }
-
-            BOOST_FOREACH(uint256 hash, vEraseQueue)
-            EraseOrphanTx(hash);
-        }
-        // TODO: currently, prohibit joinsplits and shielded spends/outputs from entering mapOrphans
-        else if (fMissingInputs &&
-                 tx.vjoinsplit.empty() &&
-                 tx.vShieldedSpend.empty() &&
-                 tx.vShieldedOutput.empty())
-        {
-            // valid stake transactions end up in the orphan tx bin
-            AddOrphanTx(tx, pfrom->GetId());
-
-            // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
-            unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
-            if (nEvicted > 0)
-                LogPrint("mempool", "mapOrphan overflow, removed %u tx\n", nEvicted);
-        } else {
-            assert(recentRejects);
-            recentRejects->insert(tx.GetHash());
-
-            if (pfrom->fWhitelisted) {
-                // Always relay transactions received from whitelisted peers, even
-                // if they were already in the mempool or rejected from it due
-                // to policy, allowing the node to function as a gateway for
-                // nodes hidden behind it.
-                //
-                // Never relay transactions that we would assign a non-zero DoS
-                // score for, as we expect peers to do the same with us in that
-                // case.
-                int nDoS = 0;
-                if (!state.IsInvalid(nDoS) || nDoS == 0) {
-                    LogPrintf("Force relaying tx %s from whitelisted peer=%d\n", tx.GetHash().ToString(), pfrom->id);
-                    RelayTransaction(tx);
-                } else {
-                    LogPrintf("Not relaying invalid transaction %s from whitelisted peer=%d (%s (code %d))\n",
-                              tx.GetHash().ToString(), pfrom->id, state.GetRejectReason(), state.GetRejectCode());
-                }
-            }
-        }
-        int nDoS = 0;
-        if (state.IsInvalid(nDoS))
-        {
-            LogPrint("mempool", "%s from peer=%d %s was not accepted into the memory pool: %s\n", tx.GetHash().ToString(),
-                     pfrom->id, pfrom->cleanSubVer,
-                     state.GetRejectReason());
-            pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
-                               state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
-            if (nDoS > 0)
-                Misbehaving(pfrom->GetId(), nDoS);
-        }
+        // with -txprecheckthreads the signatures and proofs are checked off cs_main first
+        if (!txPreChecker.Submit(pfrom, tx))
+            ProcessTransaction(pfrom, tx, strCommand);
     }
 
     else if (strCommand == "headers" && !fImporting && !fReindex) // Ignore headers received while importing
@@ -8296,6 +10688,12 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
+        // AcceptBlockHeader does not check the Equihash solution, optionally
+        // verify the whole message up front while not holding cs_main.
+        std::vector<char> vSolutionValid;
+        if (fCheckHeaderSolutions)
+            CheckHeaderSolutions(headers, vSolutionValid);
+
         LOCK(cs_main);
 
         if (nCount == 0) {
@@ -8329,6 +10727,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         }
 
         CBlockIndex *pindexLast = NULL;
+        unsigned int nHeader = 0;
         BOOST_FOREACH(const CBlockHeader& header, headers) {
             //printf("size.%i, solution size.%i\n", (int)sizeof(header), (int)header.nSolution.size());
             //printf("hash.%s prevhash.%s nonce.%s\n", header.GetHash().ToString().c_str(), header.hashPrevBlock.ToString().c_str(), header.nNonce.ToString().c_str());
@@ -8338,6 +10737,12 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                 Misbehaving(pfrom->GetId(), 20);
                 return error("non-continuous headers sequence");
             }
+            if (!vSolutionValid.empty() && !vSolutionValid[nHeader] && mapBlockIndex.count(header.GetHash()) == 0) {
+                state.DoS(100, error("%s: Equihash solution invalid", __func__), REJECT_INVALID, "invalid-solution");
+                Misbehaving(pfrom->GetId(), 1);
+                return error("invalid header received");
+            }
+            nHeader++;
             int32_t futureblock;
             if (!AcceptBlockHeader(&futureblock,header, state, &pindexLast)) {
                 int nDoS;
@@ -8393,6 +10798,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         // conditions in AcceptBlock().
         bool forceProcessing = pfrom->fWhitelisted && !IsInitialBlockDownload();
         ProcessNewBlock(0,0,state, pfrom, &block, forceProcessing, NULL);
+        ProcessQueuedOrphans();
         int nDoS;
         if (state.IsInvalid(nDoS)) {
             pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
@@ -8406,6 +10812,180 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
 
 
+    else if (strCommand == "sendcmpct")
+    {
+        bool fAnnounceUsingCMPCTBLOCK = false;
+        uint64_t nCMPCTBLOCKVersion = 0;
+        vRecv >> fAnnounceUsingCMPCTBLOCK >> nCMPCTBLOCKVersion;
+        if (nCMPCTBLOCKVersion == CMPCTBLOCKS_VERSION) {
+            LOCK(cs_main);
+            State(pfrom->GetId())->fProvidesHeaderAndIDs = true;
+            State(pfrom->GetId())->fPreferHeaderAndIDs = fAnnounceUsingCMPCTBLOCK;
+        }
+    }
+
+
+    else if (strCommand == "getblocktxn")
+    {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        // reading the block from disk is left to a message worker, as for a block getdata
+        if (!peerWorkQueue.Submit(pfrom, boost::bind(&ProcessGetBlockTxn, pfrom, req)))
+            ProcessGetBlockTxn(pfrom, req);
+    }
+
+
+    else if (strCommand == "getcfilters")
+    {
+        ProcessGetCFilters(pfrom, vRecv);
+    }
+
+
+    else if (strCommand == "getcfheaders")
+    {
+        ProcessGetCFHeaders(pfrom, vRecv);
+    }
+
+
+    else if (strCommand == "getcfcheckpt")
+    {
+        ProcessGetCFCheckPt(pfrom, vRecv);
+    }
+
+
+    else if (strCommand == "cmpctblock" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+
+        const uint256 hash = cmpctblock.header.GetHash();
+        LogPrint("net", "received cmpctblock %s peer=%d\n", hash.ToString(), pfrom->id);
+
+        if (fCheckHeaderSolutions && !CheckEquihashSolution(&cmpctblock.header, Params())) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 1);
+            return error("invalid cmpctblock header received");
+        }
+
+        std::shared_ptr<PartiallyDownloadedBlock> partialBlock;
+        {
+            LOCK(cs_main);
+
+            if (mapBlockIndex.find(cmpctblock.header.hashPrevBlock) == mapBlockIndex.end()) {
+                // Doesn't connect to a header we know, the headers leading to it come first
+                if (!IsInitialBlockDownload())
+                    pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), uint256());
+                return true;
+            }
+
+            CBlockIndex *pindex = NULL;
+            CValidationState state;
+            int32_t futureblock;
+            if (!AcceptBlockHeader(&futureblock, cmpctblock.header, state, &pindex)) {
+                int nDoS;
+                if (state.IsInvalid(nDoS) && futureblock == 0)
+                {
+                    if (nDoS > 0)
+                        Misbehaving(pfrom->GetId(), nDoS/nDoS);
+                    return error("invalid cmpctblock header received");
+                }
+            }
+            if (pindex == NULL)
+                return true;
+            UpdateBlockAvailability(pfrom->GetId(), hash);
+
+            if (pindex->nStatus & BLOCK_HAVE_DATA)
+                return true;
+
+            map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+            bool fRequested = itInFlight != mapBlocksInFlight.end() && itInFlight->second.first == pfrom->GetId();
+            CNodeState *nodestate = State(pfrom->GetId());
+
+            // Only a block on top of the tip is worth reconstructing, the others are left to the regular download
+            if (pindex->pprev != chainActive.Tip()) {
+                if (fRequested) {
+                    std::vector<CInv> vInv(1, CInv(MSG_BLOCK, hash));
+                    pfrom->PushMessage("getdata", vInv);
+                }
+                return true;
+            }
+            if (!fRequested && nodestate->nBlocksInFlight >= MaxBlocksInTransitPerPeer())
+                return true;
+
+            partialBlock.reset(new PartiallyDownloadedBlock(&mempool));
+            ReadStatus status = partialBlock->InitData(cmpctblock);
+            if (status == READ_STATUS_INVALID) {
+                MarkBlockAsReceived(hash);
+                Misbehaving(pfrom->GetId(), 100);
+                return error("peer %d sent us an invalid cmpctblock", pfrom->id);
+            }
+            MarkBlockAsInFlight(pfrom->GetId(), hash, chainparams.GetConsensus(), pindex);
+            if (status == READ_STATUS_FAILED) {
+                // a short id collision, fall back to the full block
+                std::vector<CInv> vInv(1, CInv(MSG_BLOCK, hash));
+                pfrom->PushMessage("getdata", vInv);
+                return true;
+            }
+
+            BlockTransactionsRequest req;
+            partialBlock->GetMissing(req.indexes);
+            if (!req.indexes.empty()) {
+                LogPrint("net", "cmpctblock %s peer=%d: %u prefilled, %u from mempool, %u to fetch\n", hash.ToString(), pfrom->id,
+                         partialBlock->PrefilledCount(), partialBlock->MempoolCount(), req.indexes.size());
+                nodestate->partialBlock = partialBlock;
+                req.blockhash = hash;
+                pfrom->PushMessage("getblocktxn", req);
+                return true;
+            }
+        }
+
+        // All the txns were prefilled or found in the mempool
+        CBlock block;
+        std::vector<CTransaction> vtx_missing;
+        if (partialBlock->FillBlock(block, vtx_missing) != READ_STATUS_OK) {
+            // the merkle root didn't match, a mempool tx collided with a short id
+            std::vector<CInv> vInv(1, CInv(MSG_BLOCK, hash));
+            pfrom->PushMessage("getdata", vInv);
+            return true;
+        }
+        ProcessCompactBlock(pfrom, block);
+    }
+
+
+    else if (strCommand == "blocktxn" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        std::shared_ptr<PartiallyDownloadedBlock> partialBlock;
+        {
+            LOCK(cs_main);
+            CNodeState *nodestate = State(pfrom->GetId());
+            if (!nodestate->partialBlock || nodestate->partialBlock->header.GetHash() != resp.blockhash) {
+                LogPrint("net", "peer %d sent us blocktxn for a block we didn't ask for\n", pfrom->id);
+                return true;
+            }
+            partialBlock.swap(nodestate->partialBlock);
+        }
+
+        CBlock block;
+        ReadStatus status = partialBlock->FillBlock(block, resp.txn);
+        if (status == READ_STATUS_INVALID) {
+            LOCK(cs_main);
+            MarkBlockAsReceived(resp.blockhash);
+            Misbehaving(pfrom->GetId(), 100);
+            return error("peer %d sent us invalid compact block txns", pfrom->id);
+        } else if (status == READ_STATUS_FAILED) {
+            // the merkle root didn't match, a mempool tx collided with a short id
+            std::vector<CInv> vInv(1, CInv(MSG_BLOCK, resp.blockhash));
+            pfrom->PushMessage("getdata", vInv);
+            return true;
+        }
+        ProcessCompactBlock(pfrom, block);
+    }
+
+
     else if (strCommand == "mempool")
     {
         LOCK2(cs_main, pfrom->cs_filter);
@@ -8563,6 +11143,17 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 }
 
 // requires LOCK(cs_vRecvMsg)
+/** Accept the txns the pre-check threads are done with, of any peer */
+static void ProcessPreCheckedTransactions()
+{
+    std::vector<std::pair<CNode*, CTransaction> > vChecked;
+    txPreChecker.PopChecked(vChecked);
+    for (unsigned int i = 0; i < vChecked.size(); i++) {
+        ProcessTransaction(vChecked[i].first, vChecked[i].second, "tx");
+        vChecked[i].first->Release();
+    }
+}
+
 bool ProcessMessages(CNode* pfrom)
 {
     //if (fDebug)
@@ -8578,8 +11169,14 @@ bool ProcessMessages(CNode* pfrom)
     //
     bool fOk = true;
 
+    ProcessPreCheckedTransactions();
+
+    // a message worker is handling this peer
+    if (peerWorkQueue.IsBusy(pfrom->id))
+        return fOk;
+
     if (!pfrom->vRecvGetData.empty())
-        ProcessGetData(pfrom);
+        ServeGetData(pfrom);
 
     // this maintains the order of responses
     if (!pfrom->vRecvGetData.empty()) return fOk;
@@ -8698,6 +11295,10 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         if (pto->nVersion == 0)
             return true;
 
+        // nor while a message worker is handling the peer
+        if (peerWorkQueue.IsBusy(pto->id))
+            return true;
+
         //
         // Message: ping
         //
@@ -8829,15 +11430,33 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         vector<CInv> vInvWait;
         {
             LOCK(pto->cs_inventory);
+            // with -txinvinterval the tx invs are announced in one batch per interval, at a randomized time
+            bool fFlushTxInv = true;
+            if (nTxInvInterval > 0) {
+                int64_t nInvNow = GetTimeMicros();
+                fFlushTxInv = nInvNow >= pto->nNextTxInvSend;
+                if (fFlushTxInv)
+                    pto->nNextTxInvSend = nInvNow + nTxInvInterval * 500 + GetRand(nTxInvInterval * 1000);
+            }
             vInv.reserve(pto->vInventoryToSend.size());
             vInvWait.reserve(pto->vInventoryToSend.size());
             BOOST_FOREACH(const CInv& inv, pto->vInventoryToSend)
             {
-                if (pto->setInventoryKnown.count(inv))
+                if (pto->setInventoryKnown.count(inv)) {
+                    pto->RecordInv(0, 1);
                     continue;
+                }
 
+                if (inv.type == MSG_TX && nTxInvInterval > 0)
+                {
+                    if (!fFlushTxInv)
+                    {
+                        vInvWait.push_back(inv);
+                        continue;
+                    }
+                }
                 // trickle out tx inv to protect privacy
-                if (inv.type == MSG_TX && !fSendTrickle)
+                else if (inv.type == MSG_TX && !fSendTrickle)
                 {
                     // 1/4 of tx invs blast to all immediately
                     static uint256 hashSalt;
@@ -8858,6 +11477,7 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
                 if (pto->setInventoryKnown.insert(inv).second)
                 {
                     vInv.push_back(inv);
+                    pto->RecordInv(1, 0);
                     if (vInv.size() >= 1000)
                     {
                         pto->PushMessage("inv", vInv);
@@ -8872,7 +11492,7 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
 
         // Detect whether we're stalling
         int64_t nNow = GetTimeMicros();
-        if (!pto->fDisconnect && state.nStallingSince && state.nStallingSince < nNow - 1000000 * BLOCK_STALLING_TIMEOUT) {
+        if (!pto->fDisconnect && state.nStallingSince && state.nStallingSince < nNow - GetBlockStallingTimeout(state)) {
             // Stalling only triggers when the block download window cannot move. During normal steady state,
             // the download window should be much larger than the to-be-downloaded set of blocks, so disconnection
             // should only happen during initial block download.
@@ -8907,10 +11527,10 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         //
         static uint256 zero;
         vector<CInv> vGetData;
-        if (!pto->fDisconnect && !pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        if (!pto->fDisconnect && !pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < MaxBlocksInTransitPerPeer()) {
             vector<CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller);
+            FindNextBlocksToDownload(pto->GetId(), MaxBlocksInTransitPerPeer() - state.nBlocksInFlight, vToDownload, staller);
             BOOST_FOREACH(CBlockIndex *pindex, vToDownload) {
                 vGetData.push_back(CInv(MSG_BLOCK, pindex->GetBlockHash()));
                 MarkBlockAsInFlight(pto->GetId(), pindex->GetBlockHash(), consensusParams, pindex);
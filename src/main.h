@@ -47,6 +47,7 @@
 
 #include <algorithm>
 #include <exception>
+#include <functional>
 #include <map>
 #include <set>
 #include <stdint.h>
@@ -58,9 +59,14 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CCoinsViewBackgroundFlush;
+class CBlockUndo;
 class CBloomFilter;
+class CDisconnectBatch;
 class CInv;
 class CScriptCheck;
+class CTxInUndo;
+class CTxUndo;
 class CValidationInterface;
 class CValidationState;
 class PrecomputedTransactionData;
@@ -88,8 +94,16 @@ static const unsigned int MAX_P2SH_SIGOPS = 15;
 static const unsigned int MAX_STANDARD_TX_SIGOPS = MAX_BLOCK_SIGOPS/5;
 /** Default for -minrelaytxfee, minimum relay fee for transactions */
 static const unsigned int DEFAULT_MIN_RELAY_TX_FEE = 100;
+/** Default for -maxmempool, maximum megabytes of mempool memory usage */
+static const unsigned int DEFAULT_MAX_MEMPOOL_SIZE = 300;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/** Default for -maxorphanpeerbytes, maximum bytes of orphan transactions kept from one peer */
+static const unsigned int DEFAULT_MAX_ORPHAN_PEER_BYTES = 250000;
+/** Default for -persistmempool, save the mempool on shutdown and load it on startup */
+static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Transactions of mempool.dat accepted under one cs_main lock when it is loaded */
+static const unsigned int MEMPOOL_LOAD_BATCH_SIZE = 100;
 /** Default for -txexpirydelta, in number of blocks */
 static const unsigned int DEFAULT_TX_EXPIRY_DELTA = 200;
 /** The maximum size of a blk?????.dat file (since 0.8) */
@@ -99,21 +113,61 @@ static const unsigned int MAX_TEMPFILE_SIZE = 0x1000000; // 16 MiB 0x8000000
 static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
+/** -dropblockcache default (drop the page cache of blk/rev files once they are flushed) */
+static const bool DEFAULT_DROP_BLOCK_CACHE = false;
 /** Maximum number of script-checking threads allowed */
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
-/** Number of blocks that can be requested at any given time from a single peer. */
+/** -loadindexthreads default (number of threads reading the block index on startup, 0 = auto, 1 = serial) */
+static const int DEFAULT_LOADINDEX_THREADS = 1;
+/** -reindexthreads default (number of threads scanning blk files ahead during -reindex, 0 = serial) */
+static const int DEFAULT_REINDEX_THREADS = 0;
+/** -blockprefetch default (number of blocks read ahead of ConnectTip, 0 = disabled) */
+static const int64_t DEFAULT_BLOCK_PREFETCH = 8;
+/** -txinvinterval default (milliseconds between the coalesced tx inv flushes to a peer, 0 = trickle each tx inv) */
+static const int64_t DEFAULT_TXINV_INTERVAL = 0;
+/** -txprecheckthreads default (number of threads checking relayed txns before AcceptToMemoryPool, 0 = disabled) */
+static const int DEFAULT_TXPRECHECK_THREADS = 0;
+/** -msgworkerthreads default (number of threads serving block getdata and nSPV requests off the message handler, 0 = disabled) */
+static const int DEFAULT_MSGWORKER_THREADS = 2;
+/** Maximum number of relayed txns waiting for or done with their pre-checks */
+static const unsigned int MAX_TXPRECHECK_QUEUE = 5000;
+/** -blockservecache default (MiB of recently served blocks kept in their wire format, 0 = disabled) */
+static const int64_t DEFAULT_BLOCK_SERVE_CACHE_SIZE = 32;
+/** Maximum number of entries in the verified Sapling proofs cache */
+static const unsigned int MAX_SAPLING_PROOF_CACHE_SIZE = 20000;
+/** -parallelcceval default (run CC validation on the script-check threads without the global CC mutex) */
+static const bool DEFAULT_PARALLEL_CCEVAL = false;
+/** -checkheadersolutions default (verify the Equihash solutions of a headers message on the script-check threads before accepting them) */
+static const bool DEFAULT_CHECK_HEADER_SOLUTIONS = false;
+/** -cmpctblocks default (relay blocks as BIP 152 compact blocks to the peers that ask for them) */
+static const bool DEFAULT_CMPCTBLOCKS = true;
+/** Compact blocks are only sent for blocks this close to the tip, deeper ones are sent in full */
+static const int MAX_CMPCTBLOCK_DEPTH = 5;
+/** getblocktxn is only answered for blocks this close to the tip, the full block is sent otherwise */
+static const int MAX_BLOCKTXN_DEPTH = 10;
+/** Number of peers asked to push new blocks as compact blocks without announcing them first */
+static const unsigned int MAX_CMPCTBLOCK_ANNOUNCERS = 3;
+/** -compressblocks default (store new blk/rev records as compressed frames, both formats are always readable) */
+static const bool DEFAULT_COMPRESS_BLOCKS = false;
+/** Number of blocks that can be requested at any given time from a single peer, whatever the block sizes seen. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Upper bound of the blocks in flight per peer when the blocks seen are small. */
+static const int MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER = 128;
+/** Bytes of blocks we want in flight from a single peer, divided by the average block size to get the in-flight count. */
+static const int64_t BLOCKS_IN_TRANSIT_BYTES_PER_PEER = 4 * 1024 * 1024;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
+/** Lower bound in milliseconds of the stalling timeout of a peer that delivers its blocks fast. */
+static const unsigned int MIN_BLOCK_STALLING_TIMEOUT_MS = 500;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
  *  less than this number, we reached its tip. Changing this value is a protocol upgrade. */
 static const unsigned int MAX_HEADERS_RESULTS = 160;
 /** Size of the "block download window": how far ahead of our current height do we fetch?
  *  Larger windows tolerate larger download speed differences between peer, but increase the potential
  *  degree of disordering of blocks on disk (which make reindexing and in the future perhaps pruning
- *  harder). We'll probably want to make this a per-peer adaptive value at some point. */
+ *  harder). The window used grows past this with the in-flight count when the blocks seen are small. */
 static unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
 /** Time to wait (in seconds) between writing blocks/block index to disk. */
 static const unsigned int DATABASE_WRITE_INTERVAL = 60 * 60;
@@ -125,12 +179,22 @@ static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 
 /** Default NSPV support enabled for Tokel */
 static const bool DEFAULT_NSPV_PROCESSING = true;
+/** -nspvcache default (MiB of nSPV responses kept for the current tip, 0 = disabled) */
+static const int64_t DEFAULT_NSPV_RESPONSE_CACHE_SIZE = 16;
+/** -nspvpeerrate default (nSPV request cost units a peer may spend per second, 0 = unlimited) */
+static const int64_t DEFAULT_NSPV_PEER_RATE = 40;
 
 #define DEFAULT_ADDRESSINDEX (GetArg("-ac_cc",0) != 0 || GetArg("-ac_ccactivate",0) != 0)
 #define DEFAULT_SPENTINDEX (GetArg("-ac_cc",0) != 0 || GetArg("-ac_ccactivate",0) != 0)
 
 /** Default unspent cc enabled for Tokel */
 static const bool DEFAULT_UNSPENTCCINDEX = true;
+static const bool DEFAULT_TOKENBALANCEINDEX = false;
+static const bool DEFAULT_ORACLESINDEX = false;
+static const bool DEFAULT_TOKENTAGSINDEX = false;
+static const bool DEFAULT_AGREEMENTSINDEX = false;
+static const bool DEFAULT_GATEWAYSINDEX = false;
+static const bool DEFAULT_ADDRESSBALANCEINDEX = false;
 
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const unsigned int DEFAULT_DB_MAX_OPEN_FILES = 1000;
@@ -164,10 +228,22 @@ extern bool fExperimentalMode;
 extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
+extern bool fParallelCCEval;
+extern bool fCheckHeaderSolutions;
+extern bool fCompactBlocks;
+extern int64_t nTxInvInterval;
+extern bool fCompressBlocks;
+/** Pre-allocation chunk sizes of the blk and rev files, see -blockfilechunk and -undofilechunk. */
+extern unsigned int nBlockFileChunkSize;
+extern unsigned int nUndoFileChunkSize;
+/** Whether the page cache of flushed and reindexed blk/rev files is dropped, see -dropblockcache. */
+extern bool fDropBlockCache;
 extern bool fTxIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+/** -assumenotarized block: its ancestors are connected without script, CC and proof checks. Null if unset. */
+extern uint256 hashAssumeNotarized;
 // TODO: remove this flag by structuring our code such that
 // it is unneeded for testing
 extern bool fCoinbaseEnforcedProtectionEnabled;
@@ -187,6 +263,8 @@ static const uint64_t nMinDiskSpace = 52428800;
 extern bool fHavePruned;
 /** True if we're running in -prune mode. */
 extern bool fPruneMode;
+/** True if the coinbase, staking, notarisation and CC transactions of pruned blocks are kept, see -prunekeeptxs. */
+extern bool fPruneKeepTxs;
 /** Number of MiB of block files that we're trying to stay below. */
 extern uint64_t nPruneTarget;
 /** Block files containing a block-height within MIN_BLOCKS_TO_KEEP of chainActive.Tip() will not be pruned. */
@@ -230,12 +308,22 @@ FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos *dbp = NULL);
+/** Reindex all blk files, nThreads scan threads read and deserialize the files ahead of the ordered import */
+bool LoadBlockFilesParallel(int nThreads);
 /** Initialize a new block tree database + block data on disk */
 bool InitBlockIndex();
 /** Load the block tree and coins database from disk */
 bool LoadBlockIndex();
 /** Unload database information */
 void UnloadBlockIndex();
+/** Stop the background block prefetch thread used by ActivateBestChain */
+void StopBlockPrefetch();
+/** Start and stop the threads checking relayed txns off cs_main */
+void StartTxPreCheck(int nThreads);
+void StopTxPreCheck();
+/** Start and stop the threads running the peer handlers that don't need cs_main throughout */
+void StartMessageWorkers(int nThreads);
+void StopMessageWorkers();
 /** Process protocol messages received from a given node */
 bool ProcessMessages(CNode* pfrom);
 /**
@@ -247,6 +335,12 @@ bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto, bool fSendTrickle);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header solution checking thread */
+void ThreadHeaderSolutionCheck();
+/** Run an instance of the block Sapling proof checking thread */
+void ThreadSaplingProofCheck();
+/** Run an instance of the CC vin signing thread (cc/CCtx.cpp) */
+void ThreadCCSign();
 /** Try to detect Partition (network isolation) attacks against us */
 void PartitionCheck(bool (*initialDownloadCheck)(), CCriticalSection& cs, const CBlockIndex *const &bestHeader, int64_t nPowTargetSpacing);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
@@ -295,6 +389,14 @@ void Misbehaving(NodeId nodeid, int howmuch);
 void FlushStateToDisk();
 /** Prune block files and flush state to disk. */
 void PruneAndFlush();
+/** Read the fee estimator history saved in fee_estimates.dat */
+void LoadFeeEstimates();
+/** Save the fee estimator history to fee_estimates.dat, if it was loaded */
+void DumpFeeEstimates();
+/** Accept the transactions saved in mempool.dat to the mempool, with their fee deltas */
+bool LoadMempool();
+/** Save the mempool and its fee deltas to mempool.dat, unless it is still being loaded */
+bool DumpMempool();
 
 /** (try to) add transaction to memory pool **/
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
@@ -308,6 +410,20 @@ struct CNodeStateStats {
     std::vector<int> vHeightInFlight;
 };
 
+/** The orphan transactions kept and what became of them since startup */
+struct COrphanPoolInfo {
+    size_t nCount;
+    size_t nBytes;
+    uint64_t nAdded;
+    uint64_t nResolved;  //!< accepted to the mempool once their parents arrived
+    uint64_t nRejected;  //!< invalid or not accepted once their parents arrived
+    uint64_t nEvicted;   //!< by -maxorphantx
+    uint64_t nRemoved;   //!< with their peer, or included or conflicted by a block
+
+    COrphanPoolInfo() : nCount(0), nBytes(0), nAdded(0), nResolved(0), nRejected(0), nEvicted(0), nRemoved(0) {}
+};
+COrphanPoolInfo GetOrphanPoolInfo();
+
 struct CTimestampIndexIteratorKey {
     unsigned int timestamp;
 
@@ -730,10 +846,14 @@ bool ContextualCheckOutputs(
 
 /** Check a transaction contextually against a set of consensus rules */
 bool ContextualCheckTransaction(int32_t slowflag,const CBlock *block, CBlockIndex * const pindexPrev,const CTransaction& tx, CValidationState &state, int nHeight, int dosLevel,
-                                bool (*isInitBlockDownload)() = IsInitialBlockDownload,int32_t validateprices=1);
+                                bool (*isInitBlockDownload)() = IsInitialBlockDownload,int32_t validateprices=1,bool fCheckShieldedProofs=true);
 
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight);
+void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, CTxUndo &txundo, int nHeight);
+
+/** Restore the output spent by a tx input from its undo data, as DisconnectBlock does */
+bool ApplyTxInUndo(const CTxInUndo& undo, CCoinsViewCache& view, const COutPoint& out);
 
 /** Transaction validation functions */
 
@@ -835,15 +955,31 @@ bool GetAddressIndex(uint160 addressHash, int type,
                      int start = 0, int end = 0);
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+// streaming variants, func returns false to stop
+bool ForEachAddressIndex(uint160 addressHash, int type, int start, int end, const CAddressIndexKey *pStartAfter,
+                         const std::function<bool(const CAddressIndexKey&, CAmount)> &func);
+bool ForEachAddressIndexReverse(uint160 addressHash, int type, int start, int end, const CAddressIndexKey *pStartBefore,
+                                const std::function<bool(const CAddressIndexKey&, CAmount)> &func);
+bool ForEachAddressUnspent(uint160 addressHash, int type, const CAddressUnspentKey *pStartAfter,
+                           const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> &func);
 
 // get utxos from unspet cc index
 bool GetUnspentCCIndex(uint160 addressHash, uint256 creationId,
-                       std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, int32_t beginHeight, int32_t endHeight, int64_t maxOutputs);
+                       std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, int32_t beginHeight, int32_t endHeight, int64_t maxOutputs,
+                       const std::string &funcids = std::string());
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
+/** Serialized form of a block as WriteBlockToDisk stores it, compressed if -compressblocks is set */
+void GetBlockDiskRecord(const CBlock& block, std::vector<unsigned char>& vRecord);
+bool WriteBlockToDisk(const std::vector<unsigned char>& vRecord, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos,bool checkPOW);
+bool ReadBlockFromDisk(int32_t height,CBlock& block, const CDiskBlockPos& pos,bool checkPOW);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex,bool checkPOW);
+/** Read the serialized block at pos without decoding it, decompressing a compressed record */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vData, const CDiskBlockPos& pos);
+/** Read the undo data of a connected block, false for the genesis block or when it has none */
+bool ReadBlockUndoFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
 bool PruneOneBlockFile(bool tempfile, const int fileNumber);
 
 /** Functions for validating blocks and updating the block tree */
@@ -851,8 +987,9 @@ bool PruneOneBlockFile(bool tempfile, const int fileNumber);
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  In case pfClean is provided, operation will try to be tolerant about errors, and *pfClean
  *  will be true if no problems were found. Otherwise, the return value will be false in case
- *  of problems. Note that in any case, coins may be modified. */
-bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins, bool* pfClean = NULL);
+ *  of problems. Note that in any case, coins may be modified. If pbatch is provided, the
+ *  block tree index changes are added to it instead of being written right away. */
+bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins, bool* pfClean = NULL, CDisconnectBatch* pbatch = NULL);
 
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins */
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins, bool fJustCheck = false,bool fCheckPOW = false);
@@ -969,6 +1106,9 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** The view under pcoinsTip that writes its flushes to the coin database on a thread of its own, NULL with -nobackgroundflush */
+extern CCoinsViewBackgroundFlush *pcoinsflush;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
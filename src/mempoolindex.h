@@ -0,0 +1,181 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef KOMODO_MEMPOOLINDEX_H
+#define KOMODO_MEMPOOLINDEX_H
+
+#include "addressindex.h"
+#include "memusage.h"
+#include "script/script.h"
+#include "spentindex.h"
+#include "uint256.h"
+#include "unspentccindex.h"
+
+#include <string.h>
+#include <utility>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+/** Salted hash of the mempool index keys, as CCoinsKeyHasher for the coins cache */
+class CMempoolIndexHasher
+{
+private:
+    uint256 salt;
+
+public:
+    CMempoolIndexHasher();
+
+    size_t Hash(const uint256& hash, uint32_t n) const {
+        return hash.GetHash(salt) ^ ((uint64_t)n * 0x9e3779b97f4a7c15ULL);
+    }
+
+    size_t Hash(const uint160& hash, int type) const {
+        uint256 key;
+        memcpy(key.begin(), hash.begin(), hash.size());
+        memcpy(key.begin() + hash.size(), &type, sizeof(type));
+        return key.GetHash(salt);
+    }
+};
+
+struct CSpentIndexKeyHasher : public CMempoolIndexHasher
+{
+    size_t operator()(const CSpentIndexKey& key) const { return Hash(key.txid, key.outputIndex); }
+};
+
+/** mempool address index entries, grouped by (address hash, address type) */
+struct CMempoolAddressDeltaKeyHasher : public CMempoolIndexHasher
+{
+    typedef std::pair<uint160, int> group_type;
+
+    static group_type Group(const CMempoolAddressDeltaKey& key) { return std::make_pair(key.addressBytes, key.type); }
+    size_t operator()(const CMempoolAddressDeltaKey& key) const { return Hash(key.txhash, (key.index << 1) | (key.spending != 0)); }
+    size_t operator()(const group_type& group) const { return Hash(group.first, group.second); }
+};
+
+/** mempool unspent cc index entries, grouped by cc address hash */
+struct CUnspentCCIndexKeyHasher : public CMempoolIndexHasher
+{
+    typedef uint160 group_type;
+
+    static group_type Group(const CUnspentCCIndexKey& key) { return key.hashBytes; }
+    size_t operator()(const CUnspentCCIndexKey& key) const { return Hash(key.txhash, key.index); }
+    size_t operator()(const group_type& group) const { return Hash(group, 0); }
+};
+
+/**
+ * Hash map for a mempool side index whose entries are also linked into one
+ * list per group (an address), so a group is read without keeping the whole
+ * index ordered. Adding and erasing an entry are constant time. The lists
+ * link the map nodes, which boost::unordered_map never moves on a rehash.
+ *
+ * Hasher hashes both the keys and the groups and maps a key to its group.
+ * GetGroup returns the entries unordered.
+ */
+template <typename K, typename V, typename Hasher>
+class CMempoolIndexMap
+{
+public:
+    typedef typename Hasher::group_type group_type;
+
+private:
+    struct Entry;
+    typedef std::pair<const K, Entry> Node;
+
+    struct Entry
+    {
+        V value;
+        Node *prev;
+        Node *next;
+
+        Entry(const V& valueIn) : value(valueIn), prev(NULL), next(NULL) {}
+    };
+
+    typedef boost::unordered_map<K, Entry, Hasher> entry_map;
+    typedef boost::unordered_map<group_type, Node*, Hasher> group_map;
+
+    entry_map entries;
+    group_map groups;
+
+public:
+    CMempoolIndexMap() {}
+    // the lists point into the map nodes
+    CMempoolIndexMap(const CMempoolIndexMap&) = delete;
+    CMempoolIndexMap& operator=(const CMempoolIndexMap&) = delete;
+
+    /** Adds an entry, returns false if there is one with this key already */
+    bool insert(const K& key, const V& value)
+    {
+        std::pair<typename entry_map::iterator, bool> ret = entries.insert(std::make_pair(key, Entry(value)));
+        if (!ret.second)
+            return false;
+        Node *node = &(*ret.first);
+        Node *&head = groups[Hasher::Group(key)];
+        node->second.next = head;
+        if (head != NULL)
+            head->second.prev = node;
+        head = node;
+        return true;
+    }
+
+    const V* find(const K& key) const
+    {
+        typename entry_map::const_iterator it = entries.find(key);
+        return it == entries.end() ? NULL : &it->second.value;
+    }
+
+    bool erase(const K& key)
+    {
+        typename entry_map::iterator it = entries.find(key);
+        if (it == entries.end())
+            return false;
+        Entry &entry = it->second;
+        if (entry.next != NULL)
+            entry.next->second.prev = entry.prev;
+        if (entry.prev != NULL)
+            entry.prev->second.next = entry.next;
+        else if (entry.next != NULL)
+            groups[Hasher::Group(key)] = entry.next;
+        else
+            groups.erase(Hasher::Group(key));
+        entries.erase(it);
+        return true;
+    }
+
+    /** Appends the entries of group to results */
+    void GetGroup(const group_type& group, std::vector<std::pair<K, V> >& results) const
+    {
+        typename group_map::const_iterator it = groups.find(group);
+        if (it == groups.end())
+            return;
+        for (const Node *node = it->second; node != NULL; node = node->second.next)
+            results.push_back(std::make_pair(node->first, node->second.value));
+    }
+
+    size_t size() const { return entries.size(); }
+
+    void clear()
+    {
+        entries.clear();
+        groups.clear();
+    }
+
+    size_t DynamicMemoryUsage() const
+    {
+        return memusage::DynamicUsage(entries) + memusage::DynamicUsage(groups);
+    }
+};
+
+#endif // KOMODO_MEMPOOLINDEX_H
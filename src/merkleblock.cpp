@@ -26,6 +26,21 @@
 #include "komodo_defs.h"
 using namespace std;
 
+CBloomBlockData::CBloomBlockData(const CBlock& block) : header(block.GetBlockHeader())
+{
+    vtx.reserve(block.vtx.size());
+    for (unsigned int i = 0; i < block.vtx.size(); i++)
+        vtx.push_back(CBloomTxData(block.vtx[i]));
+}
+
+size_t CBloomBlockData::DynamicMemoryUsage() const
+{
+    size_t nUsage = vtx.capacity() * sizeof(CBloomTxData);
+    for (unsigned int i = 0; i < vtx.size(); i++)
+        nUsage += vtx[i].DynamicMemoryUsage();
+    return nUsage;
+}
+
 CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter)
 {
     header = block.GetBlockHeader();
@@ -52,6 +67,32 @@ CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter)
     txn = CPartialMerkleTree(vHashes, vMatch);
 }
 
+CMerkleBlock::CMerkleBlock(const CBloomBlockData& blockData, CBloomFilter& filter)
+{
+    header = blockData.header;
+
+    vector<bool> vMatch;
+    vector<uint256> vHashes;
+
+    vMatch.reserve(blockData.vtx.size());
+    vHashes.reserve(blockData.vtx.size());
+
+    for (unsigned int i = 0; i < blockData.vtx.size(); i++)
+    {
+        const uint256& hash = blockData.vtx[i].hash;
+        if (filter.IsRelevantAndUpdate(blockData.vtx[i]))
+        {
+            vMatch.push_back(true);
+            vMatchedTxn.push_back(make_pair(i, hash));
+        }
+        else
+            vMatch.push_back(false);
+        vHashes.push_back(hash);
+    }
+
+    txn = CPartialMerkleTree(vHashes, vMatch);
+}
+
 CMerkleBlock::CMerkleBlock(const CBlock& block, const std::set<uint256>& txids)
 {
     header = block.GetBlockHeader();
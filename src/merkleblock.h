@@ -132,6 +132,22 @@ public:
 };
 
 
+/**
+ * A block decoded for bloom filter matching: its header, txids and the
+ * CBloomTxData of each of its transactions. Kept for recently served blocks
+ * so filtered blocks for many peers are built from one decoding.
+ */
+class CBloomBlockData
+{
+public:
+    CBlockHeader header;
+    std::vector<CBloomTxData> vtx;
+
+    explicit CBloomBlockData(const CBlock& block);
+
+    size_t DynamicMemoryUsage() const;
+};
+
 /**
  * Used to relay blocks as header + vector<merkle branch>
  * to filtered nodes.
@@ -153,6 +169,7 @@ public:
      * thus the filter will likely be modified.
      */
     CMerkleBlock(const CBlock& block, CBloomFilter& filter);
+    CMerkleBlock(const CBloomBlockData& blockData, CBloomFilter& filter);
 
     // Create from a CBlock, matching the txids in the set
     CMerkleBlock(const CBlock& block, const std::set<uint256>& txids);
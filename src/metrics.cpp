@@ -22,6 +22,7 @@
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "main.h"
+#include "pow/equihashsolver.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "utiltime.h"
@@ -30,6 +31,8 @@
 
 #include <boost/thread.hpp>
 #include <boost/thread/synchronized_value.hpp>
+#include <map>
+#include <memory>
 #include <string>
 #ifdef _WIN32
 #include <io.h>
@@ -124,6 +127,99 @@ void TrackMinedBlock(uint256 hash)
     trackedBlocks->push_back(hash);
 }
 
+CMetricsHistogram::CMetricsHistogram() : count(0), sumMicros(0)
+{
+    for (size_t i = 0; i <= METRICS_LATENCY_BUCKET_COUNT; i++)
+        buckets[i] = 0;
+}
+
+void CMetricsHistogram::Observe(int64_t nMicros)
+{
+    if (nMicros < 0)
+        nMicros = 0;
+    size_t i = 0;
+    while (i < METRICS_LATENCY_BUCKET_COUNT && nMicros > METRICS_LATENCY_BUCKETS[i])
+        i++;
+    buckets[i].fetch_add(1, std::memory_order_relaxed);
+    sumMicros.fetch_add(nMicros, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CMetricsHistogram::Write(std::string& out, const std::string& name, const std::string& labels) const
+{
+    std::string prefix = labels.empty() ? "" : labels + ",";
+    // the buckets are cumulative in the exposition format
+    uint64_t nCumulative = 0;
+    for (size_t i = 0; i < METRICS_LATENCY_BUCKET_COUNT; i++) {
+        nCumulative += buckets[i].load(std::memory_order_relaxed);
+        out += strprintf("%s_bucket{%sle=\"%g\"} %u\n", name, prefix, METRICS_LATENCY_BUCKETS[i] * 0.000001, nCumulative);
+    }
+    nCumulative += buckets[METRICS_LATENCY_BUCKET_COUNT].load(std::memory_order_relaxed);
+    out += strprintf("%s_bucket{%sle=\"+Inf\"} %u\n", name, prefix, nCumulative);
+    std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+    out += strprintf("%s_sum%s %.6f\n", name, suffix, sumMicros.load(std::memory_order_relaxed) * 0.000001);
+    out += strprintf("%s_count%s %u\n", name, suffix, nCumulative);
+}
+
+struct CMetricsFamily
+{
+    std::string help;
+    std::map<std::string, std::unique_ptr<CMetricsHistogram> > histograms;
+};
+
+static CCriticalSection cs_metricsRegistry;
+static std::map<std::string, CMetricsFamily> metricsRegistry;
+
+CMetricsHistogram& GetMetricsHistogram(const std::string& name, const std::string& help, const std::string& labels)
+{
+    LOCK(cs_metricsRegistry);
+    CMetricsFamily& family = metricsRegistry[name];
+    if (family.help.empty())
+        family.help = help;
+    std::unique_ptr<CMetricsHistogram>& histogram = family.histograms[labels];
+    if (!histogram)
+        histogram.reset(new CMetricsHistogram());
+    return *histogram;
+}
+
+static AtomicCounter csMainContentions;
+
+static void MetricsLockWait(const void* cs, int64_t nWaitMicros)
+{
+    if (cs != (const void*)&cs_main)
+        return;
+    static CMetricsHistogram& histogram = GetMetricsHistogram("komodo_cs_main_wait_seconds",
+        "Time waited for cs_main when another thread held it");
+    csMainContentions.increment();
+    histogram.Observe(nWaitMicros);
+}
+
+void StartLockWaitMetrics()
+{
+    SetLockWaitHook(MetricsLockWait);
+}
+
+static void WriteCounter(std::string& out, const std::string& name, const std::string& help, uint64_t value)
+{
+    out += strprintf("# HELP %s %s\n# TYPE %s counter\n%s %u\n", name, help, name, name, value);
+}
+
+std::string GetPrometheusMetrics()
+{
+    std::string out;
+    WriteCounter(out, "komodo_transactions_validated_total", "Transactions checked by CheckTransaction", transactionsValidated.get());
+    WriteCounter(out, "komodo_mined_blocks_total", "Blocks mined by this node", minedBlocks.get());
+    WriteCounter(out, "komodo_cs_main_contentions_total", "Times a thread had to wait for cs_main", csMainContentions.get());
+
+    LOCK(cs_metricsRegistry);
+    for (const auto& family : metricsRegistry) {
+        out += strprintf("# HELP %s %s\n# TYPE %s histogram\n", family.first, family.second.help, family.first);
+        for (const auto& histogram : family.second.histograms)
+            histogram.second->Write(out, family.first, histogram.first);
+    }
+    return out;
+}
+
 void MarkStartTime()
 {
     *nNodeStartTime = GetTime();
@@ -280,7 +376,7 @@ int printMiningStatus(bool mining)
         auto nThreads = miningTimer.threadCount();
         if (nThreads > 0) {
             std::cout << strprintf(_("You are mining with the %s solver on %d threads."),
-                                   GetArg("-equihashsolver", "default"), nThreads) << std::endl;
+                                   SelectEquihashSolver(Params().EquihashN(), Params().EquihashK())->Name(), nThreads) << std::endl;
         } else {
             bool fvNodesEmpty;
             {
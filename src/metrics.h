@@ -17,7 +17,11 @@
  *                                                                            *
  ******************************************************************************/
 
+#ifndef ZCASH_METRICS_H
+#define ZCASH_METRICS_H
+
 #include "uint256.h"
+#include "utiltime.h"
 
 #include <atomic>
 #include <mutex>
@@ -78,6 +82,59 @@ extern AtomicCounter ehSolverRuns;
 extern AtomicCounter solutionTargetChecks;
 extern AtomicTimer miningTimer;
 
+/** Upper bounds in microseconds of the latency histogram buckets, a +Inf bucket follows them */
+static const int64_t METRICS_LATENCY_BUCKETS[] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 30000000,
+};
+static const size_t METRICS_LATENCY_BUCKET_COUNT = sizeof(METRICS_LATENCY_BUCKETS) / sizeof(METRICS_LATENCY_BUCKETS[0]);
+
+/**
+ * Latency histogram exported in the Prometheus text format, in seconds.
+ * Observe takes no lock and can be called from any thread.
+ */
+class CMetricsHistogram
+{
+private:
+    std::atomic<uint64_t> buckets[METRICS_LATENCY_BUCKET_COUNT + 1];
+    std::atomic<uint64_t> count;
+    std::atomic<int64_t> sumMicros;
+
+public:
+    CMetricsHistogram();
+
+    void Observe(int64_t nMicros);
+    uint64_t Count() const { return count.load(); }
+
+    /** Appends the _bucket, _sum and _count lines of this histogram, labels is like method="getinfo" or empty */
+    void Write(std::string& out, const std::string& name, const std::string& labels) const;
+};
+
+/**
+ * The histogram of this name and labels, created on first use. All the
+ * histograms of a name share its help line. The returned reference stays
+ * valid until shutdown, hot paths keep it in a static.
+ */
+CMetricsHistogram& GetMetricsHistogram(const std::string& name, const std::string& help, const std::string& labels = "");
+
+/** Times the scope it lives in into a histogram */
+class CMetricsScopedTimer
+{
+private:
+    CMetricsHistogram& histogram;
+    int64_t nStart;
+
+public:
+    explicit CMetricsScopedTimer(CMetricsHistogram& histogramIn) : histogram(histogramIn), nStart(GetTimeMicros()) {}
+    ~CMetricsScopedTimer() { histogram.Observe(GetTimeMicros() - nStart); }
+};
+
+/** Starts timing the waits for a contended cs_main */
+void StartLockWaitMetrics();
+
+/** All the histograms and counters, in the Prometheus text exposition format */
+std::string GetPrometheusMetrics();
+
 void TrackMinedBlock(uint256 hash);
 
 void MarkStartTime();
@@ -120,3 +177,5 @@ const std::string METRICS_ART =
 "       [0;34;5;40;100mX[0;30;44m@@@@@@[0;36;5;40;100m8:[0;1;30;90;47m8t.[0;1;37;97;47m..[0;1;30;90;47m.t[0;37;5;40;100m8[0;1;30;90;46m8:[0;34;46m@X[0;1;30;90;46m   ;[0;36;47m@[0m                            [0;1;31;91;41m8[0;31;5;41;101m 8[0m                \n"
 "         [0;37;5;40;100m8[0;34;5;40;100mX[0;30;44m@@@@@@@@@[0;36;44mX@888[0;34;46m888[0;1;30;90;46mt8[0m                                                  \n"
 "              [0;36;5;40;100m X8[0;1;30;90;44m88[0;30;44m@@[0;1;30;90;44m8[0;36;5;40;100m88;[0;1;30;90;47mS[0m                                                      \n";
+
+#endif // ZCASH_METRICS_H
@@ -21,7 +21,7 @@
 #include "pubkey.h"
 #include "miner.h"
 #ifdef ENABLE_MINING
-#include "pow/tromp/equi_miner.h"
+#include "pow/equihashsolver.h"
 #endif
 
 #include "amount.h"
@@ -101,6 +101,9 @@ public:
     }
 };
 
+// ancestors a package lifting the fee rate of its parents may have, see ApplyAncestorPackageRates
+static const unsigned int MINER_PACKAGE_MAX_ANCESTORS = 25;
+
 uint64_t nLastBlockTx = 0;
 uint64_t nLastBlockSize = 0;
 
@@ -166,6 +169,242 @@ int32_t komodo_waituntilelegible(uint32_t blocktime, int32_t stakeHeight, uint32
     return(1);
 }
 
+// The block candidate data of a mempool transaction, as CreateNewBlock computes it for a tip
+struct CBlockCandidate
+{
+    double dPriority;                 //!< before the prioritisetransaction deltas
+    CAmount nTotalIn;                 //!< likewise
+    unsigned int nTxSize;
+    std::set<uint256> setDependsOn;   //!< mempool transactions it spends
+    bool fNotarisation;               //!< a notarisation signed by the notaries in vNotaries
+    std::vector<int8_t> vNotaries;
+
+    CBlockCandidate() : dPriority(0), nTotalIn(0), nTxSize(0), fNotarisation(false) {}
+};
+
+//
+// The input scan of CreateNewBlock is made once per mempool transaction and tip, so that a new
+// template after a few new transactions only scans those. The candidates of transactions no longer
+// in the mempool are dropped by the next template. Guarded by cs_main.
+//
+class CBlockCandidateCache
+{
+private:
+    struct Entry {
+        CBlockCandidate candidate;
+        uint64_t nGeneration;  //!< of the last template that used it
+    };
+    uint256 hashTip;
+    uint256 hashNotaries;
+    uint64_t nGeneration;
+    std::map<uint256, Entry> mapCandidates;
+
+public:
+    CBlockCandidateCache() : nGeneration(0) {}
+
+    // Start a template on pindexPrev with the notaries of its time, the candidates are kept if they are unchanged
+    void Begin(const uint256 &hashPrev, int8_t numSN, uint8_t notarypubkeys[64][33])
+    {
+        uint256 hashSN = Hash(&notarypubkeys[0][0], &notarypubkeys[0][0] + numSN * 33);
+        if (hashPrev != hashTip || hashSN != hashNotaries) {
+            mapCandidates.clear();
+            hashTip = hashPrev;
+            hashNotaries = hashSN;
+        }
+        nGeneration++;
+    }
+
+    bool Get(const uint256 &txid, CBlockCandidate &candidate)
+    {
+        std::map<uint256, Entry>::iterator it = mapCandidates.find(txid);
+        if (it == mapCandidates.end())
+            return false;
+        it->second.nGeneration = nGeneration;
+        candidate = it->second.candidate;
+        return true;
+    }
+
+    void Set(const uint256 &txid, const CBlockCandidate &candidate)
+    {
+        Entry &entry = mapCandidates[txid];
+        entry.candidate = candidate;
+        entry.nGeneration = nGeneration;
+    }
+
+    // Drop the candidates of transactions the template did not see
+    void End()
+    {
+        for (std::map<uint256, Entry>::iterator it = mapCandidates.begin(); it != mapCandidates.end();) {
+            if (it->second.nGeneration != nGeneration)
+                mapCandidates.erase(it++);
+            else
+                ++it;
+        }
+    }
+};
+
+static CBlockCandidateCache blockCandidates;
+
+// Scan the inputs of a mempool transaction for a block at nHeight and nTime, false if one is missing
+static bool ComputeBlockCandidate(const CTransaction &tx, CCoinsViewCache &view, int nHeight, uint32_t nTime, int8_t numSN, uint8_t notarypubkeys[64][33], CBlockCandidate &candidate)
+{
+    double dPriority = 0;
+    CAmount nTotalIn = 0;
+    bool fMissingInputs = false;
+
+    if (tx.IsCoinImport())
+    {
+        CAmount nValueIn = GetCoinImportValue(tx, nTime, nHeight); // burn amount
+        nTotalIn += nValueIn;
+        dPriority += (double)nValueIn * 1000;  // flat multiplier... max = 1e16.
+    } else {
+        bool fToCryptoAddress = false;
+        if ( numSN != 0 && notarypubkeys[0][0] != 0 && komodo_is_notarytx(tx) == 1 )
+            fToCryptoAddress = true;
+
+        BOOST_FOREACH(const CTxIn& txin, tx.vin)
+        {
+            if (tx.IsPegsImport() && txin.prevout.n==10e8)
+            {
+                CAmount nValueIn = GetCoinImportValue(tx, nTime, nHeight); // burn amount
+                nTotalIn += nValueIn;
+                dPriority += (double)nValueIn * 1000;  // flat multiplier... max = 1e16.
+                continue;
+            }
+            // Read prev transaction
+            if (!view.HaveCoins(txin.prevout.hash))
+            {
+                // This should never happen; all transactions in the memory
+                // pool should connect to either transactions in the chain
+                // or other transactions in the memory pool.
+                if (!mempool.mapTx.count(txin.prevout.hash))
+                {
+                    LogPrintf("ERROR: mempool transaction missing input\n");
+                    // if (fDebug) assert("mempool transaction missing input" == 0);
+                    fMissingInputs = true;
+                    break;
+                }
+
+                // Has to wait for dependencies
+                candidate.setDependsOn.insert(txin.prevout.hash);
+                nTotalIn += mempool.mapTx.find(txin.prevout.hash)->GetTx().vout[txin.prevout.n].nValue;
+                continue;
+            }
+            const CCoins* coins = view.AccessCoins(txin.prevout.hash);
+            assert(coins);
+
+            CAmount nValueIn = coins->vout[txin.prevout.n].nValue;
+            nTotalIn += nValueIn;
+
+            int nConf = nHeight - coins->nHeight;
+            
+            uint8_t *script; int32_t scriptlen; uint256 hash; CTransaction tx1;
+            // loop over notaries array and extract index of signers.
+            if ( fToCryptoAddress && myGetTransaction(txin.prevout.hash,tx1,hash) )
+            {
+                for (int8_t i = 0; i < numSN; i++) 
+                {
+                    script = (uint8_t *)&tx1.vout[txin.prevout.n].scriptPubKey[0];
+                    scriptlen = (int32_t)tx1.vout[txin.prevout.n].scriptPubKey.size();
+                    if ( scriptlen == 35 && script[0] == 33 && script[34] == OP_CHECKSIG && memcmp(script+1,notarypubkeys[i],33) == 0 )
+                    {
+                        // We can add the index of each notary to vector, and clear it if this notarisation is not valid later on.
+                        candidate.vNotaries.push_back(i);                          
+                    }
+                }
+            }
+            dPriority += (double)nValueIn * nConf;
+        }
+        if ( numSN != 0 && notarypubkeys[0][0] != 0 && candidate.vNotaries.size() >= numSN / 5 )
+        {
+            // check a notary didnt sign twice (this would be an invalid notarisation later on and cause problems)
+            std::set<int> checkdupes( candidate.vNotaries.begin(), candidate.vNotaries.end() );
+            if ( checkdupes.size() != candidate.vNotaries.size() ) 
+            {
+                fprintf(stderr, "possible notarisation is signed multiple times by same notary, passed as normal transaction.\n");
+            } else candidate.fNotarisation = true;
+        }
+        nTotalIn += tx.GetShieldedValueIn();
+    }
+
+
+    if (fMissingInputs)
+        return false;
+
+    // Priority is sum(valuein * age) / modified_txsize
+    candidate.nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+    candidate.dPriority = tx.ComputePriority(dPriority, candidate.nTxSize);
+    candidate.nTotalIn = nTotalIn;
+    return true;
+}
+
+static bool GetBlockCandidate(const CTransaction &tx, CCoinsViewCache &view, int nHeight, uint32_t nTime, int8_t numSN, uint8_t notarypubkeys[64][33], CBlockCandidate &candidate)
+{
+    // the value of an import depends on the block time
+    bool fCached = !tx.IsCoinImport() && !tx.IsPegsImport();
+    if (fCached && blockCandidates.Get(tx.GetHash(), candidate))
+        return true;
+    if (!ComputeBlockCandidate(tx, view, nHeight, nTime, numSN, notarypubkeys, candidate))
+        return false;
+    if (fCached)
+        blockCandidates.Set(tx.GetHash(), candidate);
+    return true;
+}
+
+// A mempool transaction in the ancestor packages of a template
+struct CPackageTx
+{
+    CAmount nFee;
+    unsigned int nTxSize;
+    std::set<uint256> setDependsOn;
+    CFeeRate *pFeeRate;  //!< its fee rate in the priority queue or its orphan, lifted to the best package it is in
+
+    CPackageTx() : nFee(0), nTxSize(0), pFeeRate(NULL) {}
+    CPackageTx(CAmount nFeeIn, unsigned int nTxSizeIn, const std::set<uint256> &setDependsOnIn) :
+        nFee(nFeeIn), nTxSize(nTxSizeIn), setDependsOn(setDependsOnIn), pFeeRate(NULL) {}
+};
+
+//
+// A transaction waiting for mempool parents lifts their fee rate to that of its package, itself and its
+// ancestors, so that a parent whose fee is paid by its child is selected by the fee rate of both.
+// Packages of more than MINER_PACKAGE_MAX_ANCESTORS ancestors, or with an ancestor that is not a
+// candidate, lift nothing.
+//
+static void ApplyAncestorPackageRates(std::map<uint256, CPackageTx> &mapPackageTxs)
+{
+    for (std::map<uint256, CPackageTx>::const_iterator it = mapPackageTxs.begin(); it != mapPackageTxs.end(); ++it) {
+        if (it->second.setDependsOn.empty())
+            continue;
+        std::set<uint256> setAncestors;
+        std::vector<uint256> vTodo(it->second.setDependsOn.begin(), it->second.setDependsOn.end());
+        CAmount nFees = it->second.nFee;
+        size_t nSize = it->second.nTxSize;
+        bool fComplete = true;
+        while (!vTodo.empty() && fComplete) {
+            uint256 hash = vTodo.back();
+            vTodo.pop_back();
+            if (!setAncestors.insert(hash).second)
+                continue;
+            std::map<uint256, CPackageTx>::const_iterator itParent = mapPackageTxs.find(hash);
+            if (itParent == mapPackageTxs.end() || setAncestors.size() > MINER_PACKAGE_MAX_ANCESTORS) {
+                fComplete = false;
+                break;
+            }
+            nFees += itParent->second.nFee;
+            nSize += itParent->second.nTxSize;
+            vTodo.insert(vTodo.end(), itParent->second.setDependsOn.begin(), itParent->second.setDependsOn.end());
+        }
+        if (!fComplete)
+            continue;
+        CFeeRate packageRate(nFees, nSize);
+        for (const uint256 &hash : setAncestors) {
+            CPackageTx &parent = mapPackageTxs[hash];
+            if (parent.pFeeRate != NULL && *parent.pFeeRate < packageRate)
+                *parent.pFeeRate = packageRate;
+        }
+    }
+}
+
 CBlockTemplate* CreateNewBlock(CPubKey _pk,const CScript& _scriptPubKeyIn, int32_t gpucount, bool isStake)
 {
     CScript scriptPubKeyIn(_scriptPubKeyIn);
@@ -286,6 +525,8 @@ CBlockTemplate* CreateNewBlock(CPubKey _pk,const CScript& _scriptPubKeyIn, int32
 
         // now add transactions from the mem pool
         int32_t Notarisations = 0; uint64_t txvalue;
+        std::map<uint256, CPackageTx> mapPackageTxs;
+        blockCandidates.Begin(pindexPrev->GetBlockHash(), numSN, notarypubkeys);
         for (CTxMemPool::indexed_transaction_set::iterator mi = mempool.mapTx.begin();
              mi != mempool.mapTx.end(); ++mi)
         {
@@ -313,107 +554,18 @@ CBlockTemplate* CreateNewBlock(CPubKey _pk,const CScript& _scriptPubKeyIn, int32
                 continue;
             }
 
-            COrphan* porphan = NULL;
-            double dPriority = 0;
-            CAmount nTotalIn = 0;
-            bool fMissingInputs = false;
-            bool fNotarisation = false;
-            std::vector<int8_t> TMP_NotarisationNotaries;
-            if (tx.IsCoinImport())
-            {
-                CAmount nValueIn = GetCoinImportValue(tx, pblock->nTime, nHeight); // burn amount
-                nTotalIn += nValueIn;
-                dPriority += (double)nValueIn * 1000;  // flat multiplier... max = 1e16.
-            } else {
-                TMP_NotarisationNotaries.clear();
-                bool fToCryptoAddress = false;
-                if ( numSN != 0 && notarypubkeys[0][0] != 0 && komodo_is_notarytx(tx) == 1 )
-                    fToCryptoAddress = true;
-
-                BOOST_FOREACH(const CTxIn& txin, tx.vin)
-                {
-                    if (tx.IsPegsImport() && txin.prevout.n==10e8)
-                    {
-                        CAmount nValueIn = GetCoinImportValue(tx, pblock->nTime, nHeight); // burn amount
-                        nTotalIn += nValueIn;
-                        dPriority += (double)nValueIn * 1000;  // flat multiplier... max = 1e16.
-                        continue;
-                    }
-                    // Read prev transaction
-                    if (!view.HaveCoins(txin.prevout.hash))
-                    {
-                        // This should never happen; all transactions in the memory
-                        // pool should connect to either transactions in the chain
-                        // or other transactions in the memory pool.
-                        if (!mempool.mapTx.count(txin.prevout.hash))
-                        {
-                            LogPrintf("ERROR: mempool transaction missing input\n");
-                            // if (fDebug) assert("mempool transaction missing input" == 0);
-                            fMissingInputs = true;
-                            if (porphan)
-                                vOrphan.pop_back();
-                            break;
-                        }
-
-                        // Has to wait for dependencies
-                        if (!porphan)
-                        {
-                            // Use list for automatic deletion
-                            vOrphan.push_back(COrphan(&tx));
-                            porphan = &vOrphan.back();
-                        }
-                        mapDependers[txin.prevout.hash].push_back(porphan);
-                        porphan->setDependsOn.insert(txin.prevout.hash);
-                        nTotalIn += mempool.mapTx.find(txin.prevout.hash)->GetTx().vout[txin.prevout.n].nValue;
-                        continue;
-                    }
-                    const CCoins* coins = view.AccessCoins(txin.prevout.hash);
-                    assert(coins);
-
-                    CAmount nValueIn = coins->vout[txin.prevout.n].nValue;
-                    nTotalIn += nValueIn;
-
-                    int nConf = nHeight - coins->nHeight;
-                    
-                    uint8_t *script; int32_t scriptlen; uint256 hash; CTransaction tx1;
-                    // loop over notaries array and extract index of signers.
-                    if ( fToCryptoAddress && myGetTransaction(txin.prevout.hash,tx1,hash) )
-                    {
-                        for (int8_t i = 0; i < numSN; i++) 
-                        {
-                            script = (uint8_t *)&tx1.vout[txin.prevout.n].scriptPubKey[0];
-                            scriptlen = (int32_t)tx1.vout[txin.prevout.n].scriptPubKey.size();
-                            if ( scriptlen == 35 && script[0] == 33 && script[34] == OP_CHECKSIG && memcmp(script+1,notarypubkeys[i],33) == 0 )
-                            {
-                                // We can add the index of each notary to vector, and clear it if this notarisation is not valid later on.
-                                TMP_NotarisationNotaries.push_back(i);                          
-                            }
-                        }
-                    }
-                    dPriority += (double)nValueIn * nConf;
-                }
-                if ( numSN != 0 && notarypubkeys[0][0] != 0 && TMP_NotarisationNotaries.size() >= numSN / 5 )
-                {
-                    // check a notary didnt sign twice (this would be an invalid notarisation later on and cause problems)
-                    std::set<int> checkdupes( TMP_NotarisationNotaries.begin(), TMP_NotarisationNotaries.end() );
-                    if ( checkdupes.size() != TMP_NotarisationNotaries.size() ) 
-                    {
-                        fprintf(stderr, "possible notarisation is signed multiple times by same notary, passed as normal transaction.\n");
-                    } else fNotarisation = true;
-                }
-                nTotalIn += tx.GetShieldedValueIn();
-            }
-
-            if (fMissingInputs) continue;
-
-            // Priority is sum(valuein * age) / modified_txsize
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            dPriority = tx.ComputePriority(dPriority, nTxSize);
+            CBlockCandidate candidate;
+            if (!GetBlockCandidate(tx, view, nHeight, pblock->nTime, numSN, notarypubkeys, candidate))
+                continue;
 
             uint256 hash = tx.GetHash();
+            double dPriority = candidate.dPriority;
+            CAmount nTotalIn = candidate.nTotalIn;
+            bool fNotarisation = candidate.fNotarisation;
+            const std::vector<int8_t> &TMP_NotarisationNotaries = candidate.vNotaries;
             mempool.ApplyDeltas(hash, dPriority, nTotalIn);
 
-            CFeeRate feeRate(nTotalIn-tx.GetValueOut(), nTxSize);
+            CFeeRate feeRate(nTotalIn-tx.GetValueOut(), candidate.nTxSize);
 
             if ( fNotarisation ) 
             {
@@ -449,14 +601,27 @@ CBlockTemplate* CreateNewBlock(CPubKey _pk,const CScript& _scriptPubKeyIn, int32
                 dPriority -= 10;
                 // make sure notarisation is tx[1] in block. 
             }
-            if (porphan)
+            CPackageTx &packageTx = mapPackageTxs[hash] = CPackageTx(nTotalIn-tx.GetValueOut(), candidate.nTxSize, candidate.setDependsOn);
+            if (!candidate.setDependsOn.empty())
             {
+                // Has to wait for dependencies, use list for automatic deletion
+                vOrphan.push_back(COrphan(&tx));
+                COrphan* porphan = &vOrphan.back();
+                porphan->setDependsOn = candidate.setDependsOn;
+                BOOST_FOREACH(const uint256& hashParent, candidate.setDependsOn)
+                    mapDependers[hashParent].push_back(porphan);
                 porphan->dPriority = dPriority;
                 porphan->feeRate = feeRate;
+                packageTx.pFeeRate = &porphan->feeRate;
             }
             else
+            {
                 vecPriority.push_back(TxPriority(dPriority, feeRate, &(mi->GetTx())));
+                packageTx.pFeeRate = &vecPriority.back().get<1>();
+            }
         }
+        blockCandidates.End();
+        ApplyAncestorPackageRates(mapPackageTxs);
 
         // Collect transactions into block
         uint64_t nBlockSize = 1000;
@@ -1062,9 +1227,9 @@ void komodo_broadcast(CBlock *pblock,int32_t limit)
     //fprintf(stderr,"finished broadcast new block t.%u\n",(uint32_t)time(NULL));
 }
 
-static bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey)
+bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey)
 #else
-static bool ProcessBlockFound(CBlock* pblock)
+bool ProcessBlockFound(CBlock* pblock)
 #endif // ENABLE_WALLET
 {
     LogPrintf("%s\n", pblock->ToString());
@@ -1506,23 +1671,21 @@ void static BitcoinMiner_noeq()
             while (true)
             {
                 arith_uint256 arNonce = UintToArith256(pblock->nNonce);
-                int64_t *extraPtr;
                 
                 // This seems to be a really bad way to do this, but its better than copy pasting the entire miner function at this stage.
                 CVerusHashWriter ss = CVerusHashWriter(SER_GETHASH, PROTOCOL_VERSION);
                 ss << *((CBlockHeader *)pblock);
-                if ( ASSETCHAINS_ALGO == ASSETCHAINS_VERUSHASH )
-                    extraPtr = ss.xI64p();
                 CVerusHash &vh = ss.GetState();
                 uint256 hashResult = uint256();
                 vh.ClearExtra();
                 
                 CVerusHashV2Writer ss2 = CVerusHashV2Writer(SER_GETHASH, PROTOCOL_VERSION);
                 ss2 << *((CBlockHeader *)pblock);
-                if ( ASSETCHAINS_ALGO == ASSETCHAINS_VERUSHASHV1_1 )
-                    extraPtr = ss2.xI64p();
                 CVerusHashV2 &vh2 = ss2.GetState();
                 vh2.ClearExtra();
+
+                // the hashes of the next VERUSHASH_LANES extra nonces, computed together
+                unsigned char laneHashes[VERUSHASH_LANES][32];
                 
                 int64_t i, count = ASSETCHAINS_NONCEMASK[ASSETCHAINS_ALGO] + 1;
                 int64_t hashesToGo = ASSETCHAINS_HASHESPERROUND[ASSETCHAINS_ALGO];
@@ -1541,11 +1704,15 @@ void static BitcoinMiner_noeq()
                 // for speed check NONCEMASK at a time
                 for (i = 0; i < count; i++)
                 {
-                    *extraPtr = i;
-                    if ( ASSETCHAINS_ALGO == ASSETCHAINS_VERUSHASH )
-                        vh.ExtraHash((unsigned char *)&hashResult);
-                    else if ( ASSETCHAINS_ALGO == ASSETCHAINS_VERUSHASHV1_1 )
-                        vh2.ExtraHash((unsigned char *)&hashResult);
+                    if ( (i % VERUSHASH_LANES) == 0 )
+                    {
+                        int lanes = (int)std::min(count - i, (int64_t)VERUSHASH_LANES);
+                        if ( ASSETCHAINS_ALGO == ASSETCHAINS_VERUSHASH )
+                            vh.ExtraHashes(&laneHashes[0][0], i, lanes);
+                        else if ( ASSETCHAINS_ALGO == ASSETCHAINS_VERUSHASHV1_1 )
+                            vh2.ExtraHashes(&laneHashes[0][0], i, lanes);
+                    }
+                    memcpy(hashResult.begin(), laneHashes[i % VERUSHASH_LANES], 32);
 
                     if ( UintToArith256(hashResult) <= hashTarget )
                     {
@@ -1657,6 +1824,94 @@ void static BitcoinMiner_noeq()
 int32_t gotinvalid;
 extern int32_t getkmdseason(int32_t height);
 
+#ifdef ENABLE_WALLET
+// Notary miners race each other for the blocks they are eligible for at the easy diff, so the next
+// template is built as soon as a tip is connected and handed to the miner thread when it is on that
+// tip with the same gpucount. The notary block time is derived from the notary id, height and
+// previous block hash instead of the clock, so the template built early is the one the miner would
+// have built itself.
+static const int NOTARY_TEMPLATE_WAIT_MS = 2000;
+
+static boost::mutex csNotaryTemplate;
+static boost::condition_variable cvNotaryTemplate;
+static bool fNotaryTipChanged = false;
+static bool fNotaryTemplateBuilding = false;
+static uint256 hashNotaryTemplateTip;                // the tip the template is built or being built on
+static int32_t nNotaryTemplateGpuCount;
+static std::unique_ptr<CBlockTemplate> notaryTemplate;
+static std::atomic<int32_t> nNotaryMinerGpuCount(KOMODO_MAXGPUCOUNT);  // the gpucount the miner builds its next template with
+
+void static NotaryTemplateBuilder(CWallet *pwallet)
+{
+    RenameThread("komodo-notarytmpl");
+    CReserveKey reservekey(pwallet);
+    boost::signals2::connection c = uiInterface.NotifyBlockTip.connect([](const uint256& hashNewTip) {
+        boost::unique_lock<boost::mutex> lock(csNotaryTemplate);
+        fNotaryTipChanged = true;
+        cvNotaryTemplate.notify_all();
+    });
+
+    try {
+        while (true)
+        {
+            {
+                boost::unique_lock<boost::mutex> lock(csNotaryTemplate);
+                while (!fNotaryTipChanged)
+                    cvNotaryTemplate.wait(lock);
+                fNotaryTipChanged = false;
+            }
+            if ( My_notaryid < 0 || IsInitialBlockDownload() )
+                continue;
+            CBlockIndex *pindexPrev;
+            {
+                LOCK(cs_main);
+                pindexPrev = chainActive.LastTip();
+            }
+            if ( pindexPrev == 0 )
+                continue;
+            int32_t gpucount = nNotaryMinerGpuCount;
+            {
+                boost::unique_lock<boost::mutex> lock(csNotaryTemplate);
+                hashNotaryTemplateTip = pindexPrev->GetBlockHash();
+                nNotaryTemplateGpuCount = gpucount;
+                notaryTemplate.reset();
+                fNotaryTemplateBuilding = true;
+            }
+            CBlockTemplate *ptr = CreateNewBlockWithKey(reservekey, pindexPrev->GetHeight()+1, gpucount, false);
+            {
+                boost::unique_lock<boost::mutex> lock(csNotaryTemplate);
+                fNotaryTemplateBuilding = false;
+                if ( hashNotaryTemplateTip == pindexPrev->GetBlockHash() )
+                    notaryTemplate.reset(ptr);
+                else
+                    delete ptr;
+                cvNotaryTemplate.notify_all();
+            }
+        }
+    }
+    catch (const boost::thread_interrupted&)
+    {
+        c.disconnect();
+        throw;
+    }
+}
+
+// the template built on pindexPrev with gpucount, waiting for it while it is being built. NULL if there is none
+static CBlockTemplate* TakeNotaryTemplate(const CBlockIndex *pindexPrev, int32_t gpucount)
+{
+    boost::unique_lock<boost::mutex> lock(csNotaryTemplate);
+    if ( hashNotaryTemplateTip != pindexPrev->GetBlockHash() || nNotaryTemplateGpuCount != gpucount )
+        return NULL;
+    boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(NOTARY_TEMPLATE_WAIT_MS);
+    while ( fNotaryTemplateBuilding )
+    {
+        if ( !cvNotaryTemplate.timed_wait(lock, deadline) )
+            return NULL;
+    }
+    return notaryTemplate.release();
+}
+#endif
+
 #ifdef ENABLE_WALLET
 void static BitcoinMiner(CWallet *pwallet)
 #else
@@ -1689,12 +1944,8 @@ void static BitcoinMiner()
         komodo_chosennotary(&notaryid,chainActive.Height()+1,NOTARY_PUBKEY33,(uint32_t)chainActive.Tip()->GetMedianTimePast());
     if ( notaryid != My_notaryid )
         My_notaryid = notaryid;
-    std::string solver;
-    if ( ASSETCHAINS_NK[0] == 0 && ASSETCHAINS_NK[1] == 0 )
-        solver = "tromp";
-    else 
-        solver = "default";
-    assert(solver == "tromp" || solver == "default");
+    CEquihashSolver *eqSolver = SelectEquihashSolver(n, k);
+    std::string solver = eqSolver->Name();
     LogPrint("pow", "Using Equihash solver \"%s\" with n = %u, k = %u\n", solver, n, k);
     if ( ASSETCHAINS_SYMBOL[0] == 0 )
         fprintf(stderr,"notaryid.%d Mining.%s with %s\n",notaryid,ASSETCHAINS_SYMBOL,solver.c_str());
@@ -1752,8 +2003,12 @@ void static BitcoinMiner()
             }
 
 #ifdef ENABLE_WALLET
+            CBlockTemplate *ptr = 0;
+            if ( ASSETCHAINS_SYMBOL[0] == 0 && notaryid >= 0 )
+                ptr = TakeNotaryTemplate(pindexPrev, gpucount);
             // notaries always default to staking
-            CBlockTemplate *ptr = CreateNewBlockWithKey(reservekey, pindexPrev->GetHeight()+1, gpucount, ASSETCHAINS_STAKED != 0 && KOMODO_MININGTHREADS == 0);
+            if ( ptr == 0 )
+                ptr = CreateNewBlockWithKey(reservekey, pindexPrev->GetHeight()+1, gpucount, ASSETCHAINS_STAKED != 0 && KOMODO_MININGTHREADS == 0);
 #else
             CBlockTemplate *ptr = CreateNewBlockWithKey();
 #endif
@@ -1854,6 +2109,9 @@ void static BitcoinMiner()
                             }
                             if ( dispflag != 0 )
                                 fprintf(stderr," <- prev minerids from ht.%d notary.%d gpucount.%d %.2f%% t.%u\n",pindexPrev->GetHeight(),notaryid,gpucount,100.*(double)gpucount/j,(uint32_t)time(NULL));
+#ifdef ENABLE_WALLET
+                            nNotaryMinerGpuCount = gpucount;
+#endif
                         }
                         for (j=0; j<65; j++)
                             if ( mids[j] == notaryid )
@@ -2022,58 +2280,19 @@ void static BitcoinMiner()
                     std::lock_guard<std::mutex> lock{m_cs};
                     return cancelSolver;
                 };
-                // TODO: factor this out into a function with the same API for each solver.
-                if (solver == "tromp" ) { //&& notaryid >= 0 ) {
-                    // Create solver and initialize it.
-                    equi eq(1);
-                    eq.setstate(&curr_state);
-
-                    // Initialization done, start algo driver.
-                    eq.digit0(0);
-                    eq.xfull = eq.bfull = eq.hfull = 0;
-                    eq.showbsizes(0);
-                    for (u32 r = 1; r < WK; r++) {
-                        (r&1) ? eq.digitodd(r, 0) : eq.digiteven(r, 0);
-                        eq.xfull = eq.bfull = eq.hfull = 0;
-                        eq.showbsizes(r);
-                    }
-                    eq.digitK(0);
+                try {
+                    // If we find a valid block, we rebuild
+                    bool found = eqSolver->Solve(n, k, curr_state, validBlock, cancelled);
                     ehSolverRuns.increment();
-
-                    // Convert solution indices to byte array (decompress) and pass it to validBlock method.
-                    for (size_t s = 0; s < eq.nsols; s++) {
-                        LogPrint("pow", "Checking solution %d\n", s+1);
-                        std::vector<eh_index> index_vector(PROOFSIZE);
-                        for (size_t i = 0; i < PROOFSIZE; i++) {
-                            index_vector[i] = eq.sols[s][i];
-                        }
-                        std::vector<unsigned char> sol_char = GetMinimalFromIndices(index_vector, DIGITBITS);
-
-                        if (validBlock(sol_char)) {
-                            // If we find a POW solution, do not try other solutions
-                            // because they become invalid as we created a new block in blockchain.
-                            break;
-                        }
-                    }
-                } else {
-                    try {
-                        // If we find a valid block, we rebuild
-                        bool found = EhOptimisedSolve(n, k, curr_state, validBlock, cancelled);
-                        ehSolverRuns.increment();
-                        if (found) {
-                            int32_t i; uint256 hash = pblock->GetHash();
-                            //for (i=0; i<32; i++)
-                            //    fprintf(stderr,"%02x",((uint8_t *)&hash)[i]);
-                            //fprintf(stderr," <- %s Block found %d\n",ASSETCHAINS_SYMBOL,Mining_height);
-                            //FOUND_BLOCK = 1;
-                            //KOMODO_MAYBEMINED = Mining_height;
-                            break;
-                        }
-                    } catch (EhSolverCancelledException&) {
-                        LogPrint("pow", "Equihash solver cancelled\n");
-                        std::lock_guard<std::mutex> lock{m_cs};
-                        cancelSolver = false;
+                    if (found) {
+                        //FOUND_BLOCK = 1;
+                        //KOMODO_MAYBEMINED = Mining_height;
+                        break;
                     }
+                } catch (EhSolverCancelledException&) {
+                    LogPrint("pow", "Equihash solver cancelled\n");
+                    std::lock_guard<std::mutex> lock{m_cs};
+                    cancelSolver = false;
                 }
 
                 // Check for stop or if block needs to be rebuilt
@@ -2191,6 +2410,9 @@ void static BitcoinMiner()
         {
             minerThreads->create_thread(boost::bind(&VerusStaker, pwallet));
         }
+        // notaries pay to their -pubkey, the builder never takes a key from the pool
+        if ( ASSETCHAINS_SYMBOL[0] == 0 && IS_KOMODO_NOTARY != 0 && USE_EXTERNAL_PUBKEY != 0 && ASSETCHAINS_ALGO == ASSETCHAINS_EQUIHASH && nThreads > 0 && fGenerate )
+            minerThreads->create_thread(boost::bind(&NotaryTemplateBuilder, pwallet));
 #endif
 
         for (int i = 0; i < nThreads; i++) {
@@ -61,6 +61,12 @@ void GenerateBitcoins(bool fGenerate, CWallet* pwallet, int nThreads);
  #else
 void GenerateBitcoins(bool fGenerate, int nThreads);
  #endif
+/** Submit a solved block as if it were received from a peer, false if it is stale or rejected */
+ #ifdef ENABLE_WALLET
+bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey);
+ #else
+bool ProcessBlockFound(CBlock* pblock);
+ #endif
 #endif
 
 void UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
@@ -37,7 +37,13 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <poll.h>
 #endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#include <atomic>
 
 #include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
@@ -90,6 +96,7 @@ static bool vfLimited[NET_MAX] = {};
 static CNode* pnodeLocalHost = NULL;
 uint64_t nLocalHostNonce = 0;
 static std::vector<ListenSocket> vhListenSocket;
+static SocketEventsMode nSocketEventsMode = SOCKETEVENTS_SELECT;
 CAddrMan addrman;
 int nMaxConnections = DEFAULT_MAX_PEER_CONNECTIONS;
 bool fAddressesInitialized = false;
@@ -121,6 +128,46 @@ static boost::condition_variable messageHandlerCondition;
 static CNodeSignals g_signals;
 CNodeSignals& GetNodeSignals() { return g_signals; }
 
+bool SetSocketEventsMode(const std::string& strMode)
+{
+    if (strMode == "select")
+        nSocketEventsMode = SOCKETEVENTS_SELECT;
+#ifndef _WIN32
+    else if (strMode == "poll")
+        nSocketEventsMode = SOCKETEVENTS_POLL;
+#endif
+#ifdef __linux__
+    else if (strMode == "epoll")
+        nSocketEventsMode = SOCKETEVENTS_EPOLL;
+#endif
+    else
+        return false;
+    return true;
+}
+
+SocketEventsMode GetSocketEventsMode()
+{
+    return nSocketEventsMode;
+}
+
+std::string GetSocketEventsModes()
+{
+    std::string strModes = "select";
+#ifndef _WIN32
+    strModes += ", poll";
+#endif
+#ifdef __linux__
+    strModes += ", epoll";
+#endif
+    return strModes;
+}
+
+// only select() is limited to the sockets below FD_SETSIZE
+static bool IsServiceableSocket(SOCKET hSocket)
+{
+    return nSocketEventsMode != SOCKETEVENTS_SELECT || IsSelectableSocket(hSocket);
+}
+
 void AddOneShot(const std::string& strDest)
 {
     LOCK(cs_vOneShots);
@@ -337,6 +384,9 @@ uint64_t CNode::nTotalBytesRecv = 0;
 uint64_t CNode::nTotalBytesSent = 0;
 CCriticalSection CNode::cs_totalBytesRecv;
 CCriticalSection CNode::cs_totalBytesSent;
+uint64_t CNode::nTotalInvAnnounced = 0;
+uint64_t CNode::nTotalInvDuplicate = 0;
+CCriticalSection CNode::cs_totalInv;
 
 CNode* FindNode(const CNetAddr& ip)
 {
@@ -400,7 +450,7 @@ CNode* ConnectNode(CAddress addrConnect, const char *pszDest)
     if (pszDest ? ConnectSocketByName(addrConnect, hSocket, pszDest, Params().GetDefaultPort(), nConnectTimeout, &proxyConnectionFailed) :
                   ConnectSocket(addrConnect, hSocket, nConnectTimeout, &proxyConnectionFailed))
     {
-        if (!IsSelectableSocket(hSocket)) {
+        if (!IsServiceableSocket(hSocket)) {
             LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
             CloseSocket(hSocket);
             return NULL;
@@ -585,6 +635,11 @@ void CNode::copyStats(CNodeStats &stats, const std::vector<bool> &m_asmap)
     stats.nStartingHeight = nStartingHeight;
     stats.nSendBytes = nSendBytes;
     stats.nRecvBytes = nRecvBytes;
+    {
+        LOCK(cs_inventory);
+        stats.nInvAnnounced = nInvAnnounced;
+        stats.nInvDuplicate = nInvDuplicate;
+    }
     stats.fWhitelisted = fWhitelisted;
 
     // It is common for nodes with good ping times to suddenly become lagged,
@@ -697,10 +752,10 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
 // requires LOCK(cs_vSend)
 void SocketSendData(CNode *pnode)
 {
-    std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
+    std::deque<CSharedMessage>::iterator it = pnode->vSendMsg.begin();
 
     while (it != pnode->vSendMsg.end()) {
-        const CSerializeData &data = *it;
+        const CSerializeData &data = **it;
         assert(data.size() > pnode->nSendOffset);
         int nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
         if (nBytes > 0) {
@@ -964,7 +1019,7 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket))
+    if (!IsServiceableSocket(hSocket))
     {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
@@ -1017,9 +1072,245 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
     }
 }
 
+/**
+ * The sockets ThreadSocketHandler waits on. Wait leaves the ready ones in
+ * recv_set, send_set and error_set. The epoll set is kept across the waits
+ * and only changed for the sockets whose interest changed; it tracks the
+ * owner of each socket, so a socket number reused by a new node after the
+ * old one closed it is registered again.
+ */
+class CSocketEvents
+{
+public:
+    std::set<SOCKET> recv_set;
+    std::set<SOCKET> send_set;
+    std::set<SOCKET> error_set;
+
+    CSocketEvents()
+    {
+#ifdef __linux__
+        epollfd = -1;
+        if (nSocketEventsMode == SOCKETEVENTS_EPOLL) {
+            epollfd = epoll_create1(EPOLL_CLOEXEC);
+            if (epollfd == -1)
+                LogPrintf("epoll_create1 failed: %s, using poll instead\n", NetworkErrorString(errno));
+        }
+#endif
+    }
+
+    ~CSocketEvents()
+    {
+#ifdef __linux__
+        if (epollfd != -1)
+            close(epollfd);
+#endif
+    }
+
+    void Clear()
+    {
+        recv_set.clear();
+        send_set.clear();
+        error_set.clear();
+        mapOwners.clear();
+    }
+
+    /** Adds a socket of node id (-1 for a listening socket) to the next wait */
+    void Add(SOCKET hSocket, NodeId id, bool fRecv, bool fSend, bool fError)
+    {
+        mapOwners[hSocket] = id;
+        if (fRecv)
+            recv_set.insert(hSocket);
+        if (fSend)
+            send_set.insert(hSocket);
+        if (fError)
+            error_set.insert(hSocket);
+    }
+
+    void Wait(int nTimeoutMs)
+    {
+#ifdef __linux__
+        if (nSocketEventsMode == SOCKETEVENTS_EPOLL && epollfd != -1) {
+            WaitEpoll(nTimeoutMs);
+            return;
+        }
+#endif
+#ifndef _WIN32
+        if (nSocketEventsMode != SOCKETEVENTS_SELECT) {
+            WaitPoll(nTimeoutMs);
+            return;
+        }
+#endif
+        WaitSelect(nTimeoutMs);
+    }
+
+private:
+    std::map<SOCKET, NodeId> mapOwners;
+#ifdef __linux__
+    int epollfd;
+    // the sockets in the epoll set, with their owner and events
+    std::map<SOCKET, std::pair<NodeId, uint32_t> > mapRegistered;
+#endif
+
+    // every socket is tried after a failed wait, the broken ones fail their recv
+    void WaitFailed(const char *strWait, int nTimeoutMs)
+    {
+        int nErr = WSAGetLastError();
+        recv_set.clear();
+        send_set.clear();
+        error_set.clear();
+        if (nErr == WSAEINTR)
+            return;
+        if (!mapOwners.empty())
+        {
+            LogPrintf("socket %s error %s\n", strWait, NetworkErrorString(nErr));
+            for (std::map<SOCKET, NodeId>::const_iterator it = mapOwners.begin(); it != mapOwners.end(); ++it)
+                recv_set.insert(it->first);
+        }
+        MilliSleep(nTimeoutMs);
+    }
+
+    void WaitSelect(int nTimeoutMs)
+    {
+        struct timeval timeout = MillisToTimeval(nTimeoutMs);
+        fd_set fdsetRecv;
+        fd_set fdsetSend;
+        fd_set fdsetError;
+        FD_ZERO(&fdsetRecv);
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        SOCKET hSocketMax = 0;
+
+        BOOST_FOREACH(SOCKET hSocket, recv_set)
+            FD_SET(hSocket, &fdsetRecv);
+        BOOST_FOREACH(SOCKET hSocket, send_set)
+            FD_SET(hSocket, &fdsetSend);
+        BOOST_FOREACH(SOCKET hSocket, error_set)
+            FD_SET(hSocket, &fdsetError);
+        if (!mapOwners.empty())
+            hSocketMax = mapOwners.rbegin()->first;
+
+        int nSelect = select(mapOwners.empty() ? 0 : hSocketMax + 1,
+                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        if (nSelect == SOCKET_ERROR)
+        {
+            WaitFailed("select", nTimeoutMs);
+            return;
+        }
+        Filter(recv_set, fdsetRecv);
+        Filter(send_set, fdsetSend);
+        Filter(error_set, fdsetError);
+    }
+
+    static void Filter(std::set<SOCKET>& sockets, fd_set& fdset)
+    {
+        for (std::set<SOCKET>::iterator it = sockets.begin(); it != sockets.end(); )
+        {
+            if (FD_ISSET(*it, &fdset))
+                ++it;
+            else
+                sockets.erase(it++);
+        }
+    }
+
+#ifndef _WIN32
+    void WaitPoll(int nTimeoutMs)
+    {
+        std::vector<struct pollfd> vpollfd;
+        vpollfd.reserve(mapOwners.size());
+        for (std::map<SOCKET, NodeId>::const_iterator it = mapOwners.begin(); it != mapOwners.end(); ++it)
+        {
+            struct pollfd pfd;
+            pfd.fd = it->first;
+            pfd.events = (recv_set.count(it->first) ? POLLIN : 0) | (send_set.count(it->first) ? POLLOUT : 0);
+            pfd.revents = 0;
+            vpollfd.push_back(pfd);
+        }
+
+        if (poll(vpollfd.data(), vpollfd.size(), nTimeoutMs) == SOCKET_ERROR)
+        {
+            WaitFailed("poll", nTimeoutMs);
+            return;
+        }
+        recv_set.clear();
+        send_set.clear();
+        error_set.clear();
+        BOOST_FOREACH(const struct pollfd& pfd, vpollfd)
+            Ready(pfd.fd, pfd.revents & POLLIN, pfd.revents & POLLOUT, pfd.revents & (POLLERR | POLLHUP | POLLNVAL));
+    }
+
+    // a hung up socket is also readable, as select() reports it
+    void Ready(SOCKET hSocket, bool fRecv, bool fSend, bool fError)
+    {
+        if (fRecv || fError)
+            recv_set.insert(hSocket);
+        if (fSend)
+            send_set.insert(hSocket);
+        if (fError && mapOwners[hSocket] != -1)
+            error_set.insert(hSocket);
+    }
+#endif
+
+#ifdef __linux__
+    void WaitEpoll(int nTimeoutMs)
+    {
+        // a closed socket left the epoll set with its close, the stale entries are dropped
+        for (std::map<SOCKET, std::pair<NodeId, uint32_t> >::iterator it = mapRegistered.begin(); it != mapRegistered.end(); )
+        {
+            std::map<SOCKET, NodeId>::const_iterator owner = mapOwners.find(it->first);
+            if (owner == mapOwners.end() || owner->second != it->second.first)
+            {
+                epoll_ctl(epollfd, EPOLL_CTL_DEL, it->first, NULL);
+                mapRegistered.erase(it++);
+            }
+            else
+                ++it;
+        }
+        for (std::map<SOCKET, NodeId>::const_iterator owner = mapOwners.begin(); owner != mapOwners.end(); ++owner)
+        {
+            SOCKET hSocket = owner->first;
+            uint32_t events = (recv_set.count(hSocket) ? EPOLLIN : 0) | (send_set.count(hSocket) ? EPOLLOUT : 0);
+            std::map<SOCKET, std::pair<NodeId, uint32_t> >::iterator it = mapRegistered.find(hSocket);
+            if (it != mapRegistered.end() && it->second.second == events)
+                continue;
+
+            struct epoll_event event;
+            memset(&event, 0, sizeof(event));
+            event.events = events;
+            event.data.fd = hSocket;
+            int op = it == mapRegistered.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+            int ret = epoll_ctl(epollfd, op, hSocket, &event);
+            if (ret == -1 && errno == (op == EPOLL_CTL_ADD ? EEXIST : ENOENT))
+                ret = epoll_ctl(epollfd, op == EPOLL_CTL_ADD ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, hSocket, &event);
+            if (ret == -1)
+            {
+                // closed by another thread, it is dropped next round
+                LogPrint("net", "epoll_ctl for socket %d failed: %s\n", hSocket, NetworkErrorString(errno));
+                mapRegistered.erase(hSocket);
+                continue;
+            }
+            mapRegistered[hSocket] = std::make_pair(owner->second, events);
+        }
+
+        std::vector<struct epoll_event> vEvents(std::max<size_t>(mapRegistered.size(), 1));
+        int nEvents = epoll_wait(epollfd, vEvents.data(), vEvents.size(), nTimeoutMs);
+        if (nEvents == SOCKET_ERROR)
+        {
+            WaitFailed("epoll", nTimeoutMs);
+            return;
+        }
+        recv_set.clear();
+        send_set.clear();
+        error_set.clear();
+        for (int i = 0; i < nEvents; i++)
+            Ready(vEvents[i].data.fd, vEvents[i].events & EPOLLIN, vEvents[i].events & EPOLLOUT, vEvents[i].events & (EPOLLERR | EPOLLHUP));
+    }
+#endif
+};
+
 void ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
+    CSocketEvents events;
     while (true)
     {
         //
@@ -1088,24 +1379,11 @@ void ThreadSocketHandler()
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
+        const int nTimeoutMs = 50; // frequency to poll pnode->vSend
 
-        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
+        events.Clear();
+        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
+            events.Add(hListenSocket.socket, -1, true, false, false);
 
         {
             LOCK(cs_vNodes);
@@ -1113,9 +1391,6 @@ void ThreadSocketHandler()
             {
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = max(hSocketMax, pnode->hSocket);
-                have_fds = true;
 
                 // Implement the following logic:
                 // * If there is data to send, select() for sending data. As this only
@@ -1132,47 +1407,31 @@ void ThreadSocketHandler()
                 // * We send some data.
                 // * We wait for data to be received (and disconnect after timeout).
                 // * We process a message in the buffer (message handler thread).
+                bool fSend = false, fRecv = false;
                 {
                     TRY_LOCK(pnode->cs_vSend, lockSend);
-                    if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
-                        continue;
-                    }
+                    fSend = lockSend && !pnode->vSendMsg.empty();
                 }
+                if (!fSend)
                 {
                     TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                    if (lockRecv && (
+                    fRecv = lockRecv && (
                         pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
-                        pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
-                        FD_SET(pnode->hSocket, &fdsetRecv);
+                        pnode->GetTotalRecvSize() <= ReceiveFloodSize());
                 }
+                events.Add(pnode->hSocket, pnode->id, fRecv, fSend, true);
             }
         }
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        events.Wait(nTimeoutMs);
         boost::this_thread::interruption_point();
 
-        if (nSelect == SOCKET_ERROR)
-        {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec/1000);
-        }
-
         //
         // Accept new connections
         //
         BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (hListenSocket.socket != INVALID_SOCKET && events.recv_set.count(hListenSocket.socket))
             {
                 AcceptConnection(hListenSocket);
             }
@@ -1197,7 +1456,7 @@ void ThreadSocketHandler()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError))
+            if (events.recv_set.count(pnode->hSocket) || events.error_set.count(pnode->hSocket))
             {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                 if (lockRecv)
@@ -1241,7 +1500,7 @@ void ThreadSocketHandler()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetSend))
+            if (events.send_set.count(pnode->hSocket))
             {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
                 if (lockSend)
@@ -1332,12 +1591,22 @@ void ThreadDNSAddressSeed()
 }
 
 
+//! addrman change count that peers.dat was last written (or read) at
+static std::atomic<uint64_t> nAddrmanChangesOnDisk(0);
+
 void DumpAddresses()
 {
+    // Serializing a large table is noticeable on seed nodes, so skip the
+    // periodic and shutdown flushes when nothing has changed since the last one.
+    uint64_t nChanges = addrman.GetChangeCount();
+    if (nChanges == nAddrmanChangesOnDisk)
+        return;
+
     int64_t nStart = GetTimeMillis();
 
     CAddrDB adb;
-    adb.Write(addrman);
+    if (adb.Write(addrman))
+        nAddrmanChangesOnDisk = nChanges;
 
     LogPrint("net", "Flushed %d addresses to peers.dat  %dms\n",
            addrman.size(), GetTimeMillis() - nStart);
@@ -1579,6 +1848,11 @@ bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant *grantOu
 }
 
 
+void WakeMessageHandler()
+{
+    messageHandlerCondition.notify_one();
+}
+
 void ThreadMessageHandler()
 {
     boost::mutex condition_mutex;
@@ -1670,7 +1944,7 @@ bool BindListenPort(const CService &addrBind, string& strError, bool fWhiteliste
         LogPrintf("%s\n", strError);
         return false;
     }
-    if (!IsSelectableSocket(hListenSocket))
+    if (!IsServiceableSocket(hListenSocket))
     {
         strError = "Error: Couldn't create a listenable socket for incoming connections";
         LogPrintf("%s\n", strError);
@@ -1812,6 +2086,8 @@ void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler)
         CAddrDB adb;
         if (!adb.Read(addrman))
             LogPrintf("Invalid or missing peers.dat; recreating\n");
+        else
+            nAddrmanChangesOnDisk = addrman.GetChangeCount();
     }
     LogPrintf("Loaded %i addresses from peers.dat  %dms\n",
            addrman.size(), GetTimeMillis() - nStart);
@@ -1974,6 +2250,28 @@ uint64_t CNode::GetTotalBytesSent()
     return nTotalBytesSent;
 }
 
+void CNode::RecordInv(uint64_t nAnnounced, uint64_t nDuplicate)
+{
+    AssertLockHeld(cs_inventory);
+    nInvAnnounced += nAnnounced;
+    nInvDuplicate += nDuplicate;
+    LOCK(cs_totalInv);
+    nTotalInvAnnounced += nAnnounced;
+    nTotalInvDuplicate += nDuplicate;
+}
+
+uint64_t CNode::GetTotalInvAnnounced()
+{
+    LOCK(cs_totalInv);
+    return nTotalInvAnnounced;
+}
+
+uint64_t CNode::GetTotalInvDuplicate()
+{
+    LOCK(cs_totalInv);
+    return nTotalInvDuplicate;
+}
+
 void CNode::Fuzz(int nChance)
 {
     if (!fSuccessfullyConnected) return; // Don't fuzz initial handshake
@@ -2125,6 +2423,9 @@ CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNa
     nLastRecv = 0;
     nSendBytes = 0;
     nRecvBytes = 0;
+    nNextTxInvSend = 0;
+    nInvAnnounced = 0;
+    nInvDuplicate = 0;
     nTimeConnected = GetTime();
     nTimeOffset = 0;
     addr = addrIn;
@@ -2154,6 +2455,10 @@ CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNa
     fPingQueued = false;
     nMinPingUsecTime = std::numeric_limits<int64_t>::max();
     memset(nspvdata, '\0', sizeof(nspvdata));
+    nNspvTokens = -1; // full on the first request
+    nNspvTokensTime = 0;
+    nNspvRateLimited = 0;
+    nNspvLatencyUsec = 0;
     nLastWsAddrTime = 0LL;
 
     {
@@ -2217,6 +2522,21 @@ void CNode::AskFor(const CInv& inv)
     mapAskFor.insert(std::make_pair(nRequestTime, inv));
 }
 
+/** Set the size and checksum fields of the message framed in ss */
+static void FinalizeMessageHeader(CDataStream& ss)
+{
+    // Set the size
+    unsigned int nSize = ss.size() - CMessageHeader::HEADER_SIZE;
+    WriteLE32((uint8_t*)&ss[CMessageHeader::MESSAGE_SIZE_OFFSET], nSize);
+
+    // Set the checksum
+    uint256 hash = Hash(ss.begin() + CMessageHeader::HEADER_SIZE, ss.end());
+    unsigned int nChecksum = 0;
+    memcpy(&nChecksum, &hash, sizeof(nChecksum));
+    assert(ss.size () >= CMessageHeader::CHECKSUM_OFFSET + sizeof(nChecksum));
+    memcpy((char*)&ss[CMessageHeader::CHECKSUM_OFFSET], &nChecksum, sizeof(nChecksum));
+}
+
 void CNode::BeginMessage(const char* pszCommand) EXCLUSIVE_LOCK_FUNCTION(cs_vSend)
 {
     ENTER_CRITICAL_SECTION(cs_vSend);
@@ -2253,36 +2573,57 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
         LEAVE_CRITICAL_SECTION(cs_vSend);
         return;
     }
-    // Set the size
     unsigned int nSize = ssSend.size() - CMessageHeader::HEADER_SIZE;
-    WriteLE32((uint8_t*)&ssSend[CMessageHeader::MESSAGE_SIZE_OFFSET], nSize);
-
-    // Set the checksum
-    uint256 hash = Hash(ssSend.begin() + CMessageHeader::HEADER_SIZE, ssSend.end());
-    unsigned int nChecksum = 0;
-    memcpy(&nChecksum, &hash, sizeof(nChecksum));
-    assert(ssSend.size () >= CMessageHeader::CHECKSUM_OFFSET + sizeof(nChecksum));
-    memcpy((char*)&ssSend[CMessageHeader::CHECKSUM_OFFSET], &nChecksum, sizeof(nChecksum));
+    FinalizeMessageHeader(ssSend);
 
     LogPrint("net", "(%d bytes) peer=%d\n", nSize, id);
 
-    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
-    ssSend.GetAndClear(*it);
-    nSendSize += (*it).size();
-
-#ifdef ENABLE_WEBSOCKETS
-    if (this->hSocket != INVALID_SOCKET)    {
-#endif
-        // If write queue empty, attempt "optimistic write"
-        if (it == vSendMsg.begin())
-            SocketSendData(this);
-#ifdef ENABLE_WEBSOCKETS
-    }
-#endif
+    std::shared_ptr<CSerializeData> pmsg = std::make_shared<CSerializeData>();
+    ssSend.GetAndClear(*pmsg);
+    QueueMessage(pmsg);
 
     LEAVE_CRITICAL_SECTION(cs_vSend);
 }
 
+// requires LOCK(cs_vSend)
+void CNode::QueueMessage(const CSharedMessage& msg)
+{
+    vSendMsg.push_back(msg);
+    nSendSize += msg->size();
+
+    // If write queue empty, attempt "optimistic write"
+    if (vSendMsg.size() == 1)
+        SendQueuedData();
+}
+
+// requires LOCK(cs_vSend)
+void CNode::SendQueuedData()
+{
+    if (hSocket != INVALID_SOCKET)
+        SocketSendData(this);
+}
+
+void CNode::PushSharedMessage(const CSharedMessage& msg)
+{
+    LOCK(cs_vSend);
+    LogPrint("net", "sending: shared message (%d bytes) peer=%d\n", msg->size() - CMessageHeader::HEADER_SIZE, id);
+    QueueMessage(msg);
+}
+
+void BeginSharedMessage(CDataStream& ss, const char* pszCommand)
+{
+    assert(ss.size() == 0);
+    ss << CMessageHeader(Params().MessageStart(), pszCommand, 0);
+}
+
+CSharedMessage EndSharedMessage(CDataStream& ss)
+{
+    FinalizeMessageHeader(ss);
+    std::shared_ptr<CSerializeData> pmsg = std::make_shared<CSerializeData>();
+    ss.GetAndClear(*pmsg);
+    return pmsg;
+}
+
 void CopyNodeStats(std::vector<CNodeStats>& vstats)
 {
     vstats.clear();
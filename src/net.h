@@ -36,6 +36,7 @@
 #include "util.h"
 
 #include <deque>
+#include <memory>
 #include <stdint.h>
 
 #ifndef _WIN32
@@ -77,9 +78,30 @@ static const size_t SETASKFOR_MAX_SZ = 2 * MAX_INV_SZ;
 static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 384;
 /** The period before a network upgrade activates, where connections to upgrading peers are preferred (in blocks). */
 static const int NETWORK_UPGRADE_PEER_PREFERENCE_BLOCK_PERIOD = 24 * 24 * 3;
+/** -socketevents default, the fastest backend of the platform */
+#if defined(__linux__)
+static const char * const DEFAULT_SOCKETEVENTS = "epoll";
+#elif !defined(_WIN32)
+static const char * const DEFAULT_SOCKETEVENTS = "poll";
+#else
+static const char * const DEFAULT_SOCKETEVENTS = "select";
+#endif
+
+/** How the socket handler thread waits for its sockets to be ready */
+enum SocketEventsMode
+{
+    SOCKETEVENTS_SELECT,
+    SOCKETEVENTS_POLL,
+    SOCKETEVENTS_EPOLL,
+};
 
 unsigned int ReceiveFloodSize();
 unsigned int SendBufferSize();
+/** Sets the socket handler backend by its -socketevents name, returns false if it is not available */
+bool SetSocketEventsMode(const std::string& strMode);
+SocketEventsMode GetSocketEventsMode();
+/** The -socketevents names available on this platform */
+std::string GetSocketEventsModes();
 
 void AddOneShot(const std::string& strDest);
 void AddressCurrentlyConnected(const CService& addr);
@@ -94,9 +116,31 @@ bool BindListenPort(const CService &bindAddr, std::string& strError, bool fWhite
 void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler);
 bool StopNode();
 void SocketSendData(CNode *pnode);
+/** Wake the message handler thread, e.g. when a peer has work for it again */
+void WakeMessageHandler();
 
 typedef int NodeId;
 
+/**
+ * A framed message, immutable once built, so the same message can be queued
+ * for many peers without a copy for each. Only for messages whose encoding
+ * doesn't depend on the peer's version, as blocks.
+ */
+typedef std::shared_ptr<const CSerializeData> CSharedMessage;
+
+/** Start a shared message in ss, EndSharedMessage frames it once the payload is written */
+void BeginSharedMessage(CDataStream& ss, const char* pszCommand);
+CSharedMessage EndSharedMessage(CDataStream& ss);
+
+template<typename T1>
+CSharedMessage MakeSharedMessage(const char* pszCommand, const T1& a1)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    BeginSharedMessage(ss, pszCommand);
+    ss << a1;
+    return EndSharedMessage(ss);
+}
+
 class CNodeStats;
 void CopyNodeStats(std::vector<CNodeStats>& vstats);
 
@@ -204,6 +248,8 @@ public:
     int nStartingHeight;
     uint64_t nSendBytes;
     uint64_t nRecvBytes;
+    uint64_t nInvAnnounced;
+    uint64_t nInvDuplicate;
     bool fWhitelisted;
     double dPingTime;
     double dPingWait;
@@ -268,10 +314,10 @@ public:
     uint64_t nServices;
     SOCKET hSocket;
     CDataStream ssSend;
-    size_t nSendSize; // total size of all vSendMsg entries
+    size_t nSendSize; // total size of all vSendMsg entries, shared ones included
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<CSerializeData> vSendMsg;
+    std::deque<CSharedMessage> vSendMsg;
     CCriticalSection cs_vSend;
 
     std::deque<CInv> vRecvGetData;
@@ -288,6 +334,12 @@ public:
         uint32_t prevtime;
         uint32_t nreqs;
     } nspvdata[32];
+    //! cost weighted nSPV request token bucket, see NSPV_ratelimit
+    double nNspvTokens;
+    int64_t nNspvTokensTime;
+    uint64_t nNspvRateLimited;
+    //! superlite: smoothed nSPV response time of this peer, 0 until it answered
+    int64_t nNspvLatencyUsec;
     uint32_t dexlastping;
     // Address of this peer
     CAddress addr;
@@ -351,6 +403,11 @@ public:
     mruset<CInv> setInventoryKnown;
     std::vector<CInv> vInventoryToSend;
     CCriticalSection cs_inventory;
+    // time in usec of the next coalesced tx inv flush with -txinvinterval
+    int64_t nNextTxInvSend;
+    // invs announced to this peer, and invs dropped as already announced or known to it
+    uint64_t nInvAnnounced;
+    uint64_t nInvDuplicate;
     std::set<uint256> setAskFor;
     std::multimap<int64_t, CInv> mapAskFor;
 
@@ -367,7 +424,7 @@ public:
     bool fPingQueued;
 
     CNode(SOCKET hSocketIn, const CAddress &addrIn, const std::string &addrNameIn = "", bool fInboundIn = false);
-    ~CNode();
+    virtual ~CNode();
 
 private:
     // Network usage totals
@@ -375,6 +432,9 @@ private:
     static CCriticalSection cs_totalBytesSent;
     static uint64_t nTotalBytesRecv;
     static uint64_t nTotalBytesSent;
+    static CCriticalSection cs_totalInv;
+    static uint64_t nTotalInvAnnounced;
+    static uint64_t nTotalInvDuplicate;
 
     CNode(const CNode&);
     void operator=(const CNode&);
@@ -458,6 +518,8 @@ public:
             LOCK(cs_inventory);
             if (!setInventoryKnown.count(inv))
                 vInventoryToSend.push_back(inv);
+            else
+                RecordInv(0, 1);
         }
     }
 
@@ -474,6 +536,15 @@ public:
 
     void PushVersion();
 
+    /** Queue a message built with MakeSharedMessage, it is counted in nSendSize as any other */
+    void PushSharedMessage(const CSharedMessage& msg);
+
+    // requires LOCK(cs_vSend)
+    void QueueMessage(const CSharedMessage& msg);
+
+    /** Start sending vSendMsg, the websocket nodes hand it to their connection. Requires cs_vSend */
+    virtual void SendQueuedData();
+
 
     void PushMessage(const char* pszCommand)
     {
@@ -671,6 +742,11 @@ public:
 
     static uint64_t GetTotalBytesRecv();
     static uint64_t GetTotalBytesSent();
+
+    // inv counters, cs_inventory must be held
+    void RecordInv(uint64_t nAnnounced, uint64_t nDuplicate);
+    static uint64_t GetTotalInvAnnounced();
+    static uint64_t GetTotalInvDuplicate();
 };
 
 
@@ -7,12 +7,25 @@
 #include "notaries_staked.h"
 
 #include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
 
 
 NotarisationDB *pnotarisations;
 
 
-NotarisationDB::NotarisationDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "notarisations", nCacheSize, fMemory, fWipe, false, 64) { }
+static const std::string DB_HEIGHT_INDEX_FLAG = "heightindex";
+
+
+NotarisationDB::NotarisationDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "notarisations", nCacheSize, fMemory, fWipe, false, 64), fHeightIndex(false)
+{
+    // The height index can only be trusted if it was kept from the first block on
+    if (Exists(DB_HEIGHT_INDEX_FLAG))
+        fHeightIndex = true;
+    else if (IsEmpty())
+        fHeightIndex = Write(DB_HEIGHT_INDEX_FLAG, '1', true);
+    else
+        LogPrintf("Notarisations DB has no height index, notarisation scans will be slower until -reindex\n");
+}
 
 
 NotarisationsInBlock ScanBlockNotarisations(const CBlock &block, int nHeight)
@@ -23,7 +36,7 @@ NotarisationsInBlock ScanBlockNotarisations(const CBlock &block, int nHeight)
     int timestamp = block.nTime;
 
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
-        CTransaction tx = block.vtx[i];
+        const CTransaction &tx = block.vtx[i];
 
         NotarisationData data;
         bool parsed = ParseNotarisationOpReturn(tx, data);
@@ -110,6 +123,79 @@ void EraseBackNotarisations(const NotarisationsInBlock notarisations, CDBBatch &
     }
 }
 
+/*
+ * Write the (symbol, height) -> block hash index for every symbol notarised in a block
+ */
+void WriteNotarisationHeights(const NotarisationsInBlock &notarisations, uint256 blockHash, int height, CDBBatch &batch)
+{
+    BOOST_FOREACH(const Notarisation &n, notarisations)
+        batch.Write(CNotarisationHeightKey(n.second.symbol, height), blockHash);
+}
+
+
+void EraseNotarisationHeights(const NotarisationsInBlock &notarisations, int height, CDBBatch &batch)
+{
+    BOOST_FOREACH(const Notarisation &n, notarisations)
+        batch.Erase(CNotarisationHeightKey(n.second.symbol, height));
+}
+
+
+/*
+ * Seek the height index for the nearest block at or after (fForward) or at or
+ * before height holding a notarisation for symbol, without passing limitHeight.
+ * Entries not on the active chain are skipped. Returns the height of the block,
+ * 0 if there is none and -1 if the DB has no height index.
+ */
+int SeekNotarisationHeight(int height, std::string symbol, bool fForward, int limitHeight, uint256 &blockHash)
+{
+    if (!pnotarisations->fHeightIndex)
+        return -1;
+
+    boost::scoped_ptr<CDBIterator> pcursor(pnotarisations->NewIterator());
+    if (fForward)
+        pcursor->Seek(CNotarisationHeightKey(symbol, height));
+    else {
+        pcursor->Seek(CNotarisationHeightKey(symbol, height+1));
+        if (pcursor->Valid())
+            pcursor->Prev();
+        else
+            pcursor->SeekToLast();
+    }
+
+    for (; pcursor->Valid(); fForward ? pcursor->Next() : pcursor->Prev()) {
+        CNotarisationHeightKey key;
+        if (!pcursor->GetKey(key) || key.symbol != symbol)
+            break;
+        if (fForward ? key.height > limitHeight : key.height < limitHeight)
+            break;
+        if (!pcursor->GetValue(blockHash))
+            break;
+        if (key.height <= chainActive.Height() && *chainActive[key.height]->phashBlock == blockHash)
+            return key.height;
+    }
+    return 0;
+}
+
+
+/*
+ * Find the first notarisation for symbol in a block
+ */
+static bool GetBlockNotarisation(uint256 blockHash, std::string symbol, Notarisation& out)
+{
+    NotarisationsInBlock notarisations;
+    if (!GetBlockNotarisations(blockHash, notarisations))
+        return false;
+
+    BOOST_FOREACH(Notarisation& nota, notarisations) {
+        if (strcmp(nota.second.symbol, symbol.data()) == 0) {
+            out = nota;
+            return true;
+        }
+    }
+    return false;
+}
+
+
 /*
  * Scan notarisationsdb backwards for blocks containing a notarisation
  * for given symbol. Return height of matched notarisation or 0.
@@ -119,6 +205,14 @@ int ScanNotarisationsDB(int height, std::string symbol, int scanLimitBlocks, Not
     if (height < 0 || height > chainActive.Height())
         return false;
 
+    if (pnotarisations->fHeightIndex) {
+        uint256 blockHash;
+        int ht = SeekNotarisationHeight(height, symbol, false, std::max(height-scanLimitBlocks+1, 0), blockHash);
+        if (ht > 0 && GetBlockNotarisation(blockHash, symbol, out))
+            return ht;
+        return 0;
+    }
+
     for (int i=0; i<scanLimitBlocks; i++) {
         if (i > height) break;
         NotarisationsInBlock notarisations;
@@ -142,6 +236,14 @@ int ScanNotarisationsDB2(int height, std::string symbol, int scanLimitBlocks, No
     maxheight = chainActive.Height();
     if ( height < 0 || height > maxheight )
         return false;
+    if ( pnotarisations->fHeightIndex )
+    {
+        uint256 blockHash;
+        ht = SeekNotarisationHeight(height,symbol,true,std::min(height+scanLimitBlocks-1,maxheight),blockHash);
+        if ( ht > 0 && GetBlockNotarisation(blockHash,symbol,out) )
+            return(ht);
+        return 0;
+    }
     for (i=0; i<scanLimitBlocks; i++)
     {
         ht = height+i;
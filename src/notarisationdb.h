@@ -10,6 +10,37 @@ class NotarisationDB : public CDBWrapper
 {
 public:
     NotarisationDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    //! true if the (symbol, height) index covers every block in the DB
+    bool fHeightIndex;
+};
+
+
+/*
+ * Key of the secondary index of blocks holding notarisations for a symbol.
+ * Heights are stored big-endian so the entries of a symbol sort by height.
+ */
+struct CNotarisationHeightKey
+{
+    std::string symbol;
+    int height;
+
+    CNotarisationHeightKey() : height(0) {}
+    CNotarisationHeightKey(const std::string &symbolIn, int heightIn) : symbol(symbolIn), height(heightIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        ser_writedata8(s, 'H');
+        ::Serialize(s, symbol);
+        ser_writedata32be(s, height);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        if (ser_readdata8(s) != 'H')
+            throw std::ios_base::failure("not a notarisation height key");
+        ::Unserialize(s, symbol);
+        height = ser_readdata32be(s);
+    }
 };
 
 
@@ -23,6 +54,9 @@ bool GetBlockNotarisations(uint256 blockHash, NotarisationsInBlock &nibs);
 bool GetBackNotarisation(uint256 notarisationHash, Notarisation &n);
 void WriteBackNotarisations(const NotarisationsInBlock notarisations, CDBBatch &batch);
 void EraseBackNotarisations(const NotarisationsInBlock notarisations, CDBBatch &batch);
+void WriteNotarisationHeights(const NotarisationsInBlock &notarisations, uint256 blockHash, int height, CDBBatch &batch);
+void EraseNotarisationHeights(const NotarisationsInBlock &notarisations, int height, CDBBatch &batch);
+int SeekNotarisationHeight(int height, std::string symbol, bool fForward, int limitHeight, uint256 &blockHash);
 int ScanNotarisationsDB(int height, std::string symbol, int scanLimitBlocks, Notarisation& out);
 int ScanNotarisationsDB2(int height, std::string symbol, int scanLimitBlocks, Notarisation& out);
 bool IsTXSCL(const char* symbol);
@@ -40,10 +40,19 @@ PaymentDisclosureDB::PaymentDisclosureDB(const boost::filesystem::path& dbPath)
     leveldb::Status status = leveldb::DB::Open(options, path.string(), &db);
     dbwrapper_private::HandleError(status); // throws exception
     LogPrintf("PaymentDisclosure: Opened LevelDB successfully\n");
+
+    // leveldb defaults, with its internal 8 MiB block cache
+    CDBTuning tuning;
+    tuning.nBlockCache = 8 << 20;
+    tuning.nWriteBuffer = options.write_buffer_size;
+    tuning.nBlockSize = options.block_size;
+    tuning.fCompression = options.compression == leveldb::kSnappyCompression;
+    dbwrapper_private::RegisterDB("paymentdisclosure", db, tuning);
 }
 
 PaymentDisclosureDB::~PaymentDisclosureDB() {
     if (db != nullptr) {
+        dbwrapper_private::UnregisterDB(db);
         delete db;
     }
 }
@@ -21,11 +21,14 @@
 #include "policy/fees.h"
 
 #include "amount.h"
+#include "consensus/params.h"
 #include "primitives/transaction.h"
 #include "streams.h"
 #include "txmempool.h"
 #include "util.h"
 
+#include <cmath>
+
 void TxConfirmStats::Initialize(std::vector<double>& defaultBuckets,
                                 unsigned int maxConfirms, double _decay, std::string _dataTypeString)
 {
@@ -102,6 +105,19 @@ void TxConfirmStats::UpdateMovingAverages()
     }
 }
 
+void TxConfirmStats::SetDecay(double newDecay)
+{
+    // a moving average of n per block settles at n / (1 - decay)
+    double scale = (1 - newDecay) / (1 - decay);
+    for (unsigned int j = 0; j < buckets.size(); j++) {
+        for (unsigned int i = 0; i < confAvg.size(); i++)
+            confAvg[i][j] *= scale;
+        avg[j] *= scale;
+        txCtAvg[j] *= scale;
+    }
+    decay = newDecay;
+}
+
 // returns -1 on error conditions
 double TxConfirmStats::EstimateMedianVal(int confTarget, double sufficientTxVal,
                                          double successBreakPoint, bool requireGreater,
@@ -244,7 +260,6 @@ void TxConfirmStats::Read(CAutoFile& filein)
     }
     // Now that we've processed the entire fee estimate data file and not
     // thrown any errors, we can copy it to our data structures
-    decay = fileDecay;
     buckets = fileBuckets;
     avg = fileAvg;
     confAvg = fileConfAvg;
@@ -269,6 +284,13 @@ void TxConfirmStats::Read(CAutoFile& filein)
     for (unsigned int i = 0; i < buckets.size(); i++)
         bucketMap[buckets[i]] = i;
 
+    // keep the decay we were configured with, the history saved with another one is rescaled to it
+    if (fileDecay != decay) {
+        double configuredDecay = decay;
+        decay = fileDecay;
+        SetDecay(configuredDecay);
+    }
+
     LogPrint("estimatefee", "Reading estimates: %u %s buckets counting confirms up to %u blocks\n",
              numBuckets, dataTypeString, maxConfirms);
 }
@@ -328,7 +350,7 @@ void CBlockPolicyEstimator::removeTx(uint256 hash)
 }
 
 CBlockPolicyEstimator::CBlockPolicyEstimator(const CFeeRate& _minRelayFee)
-    : nBestSeenHeight(0)
+    : nBestSeenHeight(0), nBlocksSeen(0)
 {
     minTrackedFee = _minRelayFee < CFeeRate(MIN_FEERATE) ? CFeeRate(MIN_FEERATE) : _minRelayFee;
     std::vector<double> vfeelist;
@@ -476,6 +498,7 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
     // otherwise we'll miscalculate how many blocks its taking to get included.
     if (!fCurrentEstimate)
         return;
+    nBlocksSeen++;
 
     // Update the dynamic cutoffs
     // a fee/priority is "likely" the reason your tx was included in a block if >85% of such tx's
@@ -531,6 +554,37 @@ CFeeRate CBlockPolicyEstimator::estimateFee(int confTarget)
     return CFeeRate(median);
 }
 
+CFeeRate CBlockPolicyEstimator::estimateFeeFromMempool(int confTarget, const CTxMemPool& pool)
+{
+    if (confTarget <= 0 || confTarget > MAX_MEMPOOL_ESTIMATE_CONFIRMS || nBlocksSeen == 0)
+        return CFeeRate(0);
+
+    // The txs paying the most are mined first, find the fee rate where they stop fitting in the blocks
+    double room = MEMPOOL_ESTIMATE_BLOCK_SHARE * confTarget * MAX_BLOCK_SIZE(nBestSeenHeight + 1);
+    uint64_t nBytes = 0;
+    typedef CTxMemPool::indexed_transaction_set::nth_index<1>::type feerate_index;
+    const feerate_index &index = pool.mapTx.get<1>();
+    for (feerate_index::const_iterator it = index.begin(); it != index.end(); ++it) {
+        nBytes += it->GetTxSize();
+        if (nBytes > room) {
+            // outbid the first tx left out by a bucket
+            CFeeRate feeRate(it->GetFeeRate().GetFeePerK() * FEE_SPACING);
+            LogPrint("estimatefee", "%3d: mempool estimate %s from %u bytes of higher fee txs\n",
+                     confTarget, feeRate.ToString(), nBytes - it->GetTxSize());
+            return feeRate < minTrackedFee ? minTrackedFee : feeRate;
+        }
+    }
+    LogPrint("estimatefee", "%3d: mempool estimate %s, all %u bytes fit\n", confTarget, minTrackedFee.ToString(), nBytes);
+    return minTrackedFee;
+}
+
+void CBlockPolicyEstimator::SetHalfLife(unsigned int nBlocks)
+{
+    double decay = nBlocks == DEFAULT_FEE_ESTIMATE_HALFLIFE ? DEFAULT_DECAY : pow(0.5, 1.0 / std::max(nBlocks, 1u));
+    feeStats.SetDecay(decay);
+    priStats.SetDecay(decay);
+}
+
 double CBlockPolicyEstimator::estimatePriority(int confTarget)
 {
     // Return failure if trying to analyze a target we're not tracking
@@ -30,6 +30,7 @@
 
 class CAutoFile;
 class CFeeRate;
+class CTxMemPool;
 class CTxMemPoolEntry;
 
 /** \class CBlockPolicyEstimator
@@ -84,6 +85,8 @@ class CTxMemPoolEntry;
 
 /** Decay of .998 is a half-life of 346 blocks or about 2.4 days */
 static const double DEFAULT_DECAY = .998;
+/** -feeestimatehalflife default, in blocks, the half-life of DEFAULT_DECAY */
+static const unsigned int DEFAULT_FEE_ESTIMATE_HALFLIFE = 346;
 
 /**
  * We will instantiate two instances of this class, one to track transactions
@@ -170,6 +173,9 @@ public:
         with the data gathered from the current block */
     void UpdateMovingAverages();
 
+    /** Change the decay, rescaling the moving averages to what they would have been with it */
+    void SetDecay(double newDecay);
+
     /**
      * Calculate a fee or priority estimate.  Find the lowest value bucket (or range of buckets
      * to make sure we have enough data points) whose transactions still have sufficient likelihood
@@ -192,7 +198,7 @@ public:
 
     /**
      * Read saved state of estimation data from a file and replace all internal data structures and
-     * variables with this state.
+     * variables with this state. Averages saved with another decay are rescaled to ours.
      */
     void Read(CAutoFile& filein);
 };
@@ -229,6 +235,14 @@ static const double FEE_SPACING = 1.1;
 /** Spacing of Priority buckets */
 static const double PRI_SPACING = 2;
 
+/**
+ * Fee targets up to this many blocks that the history has too few txs for are
+ * estimated from the fee rates in the mempool, with this share of each block
+ * counted as room for them
+ */
+static const int MAX_MEMPOOL_ESTIMATE_CONFIRMS = 6;
+static const double MEMPOOL_ESTIMATE_BLOCK_SHARE = .5;
+
 /**
  *  We want to be able to estimate fees or priorities that are needed on txs to be included in
  * a certain number of blocks.  Every time a block is added to the best chain, this class records
@@ -262,6 +276,17 @@ public:
     /** Return a fee estimate */
     CFeeRate estimateFee(int confTarget);
 
+    /**
+     * Return a fee estimate for a short target from the mempool: the fee rate that outbids
+     * the txs filling the room of confTarget blocks, the lowest tracked fee rate if they
+     * all fit. 0 until a block has been seen since startup, the mempool may not be filled yet.
+     * pool.cs must be held.
+     */
+    CFeeRate estimateFeeFromMempool(int confTarget, const CTxMemPool& pool);
+
+    /** Set the half-life in blocks of the confirmation history */
+    void SetHalfLife(unsigned int nBlocks);
+
     /** Return a priority estimate */
     double estimatePriority(int confTarget);
 
@@ -275,6 +300,8 @@ private:
     CFeeRate minTrackedFee; //! Passed to constructor to avoid dependency on main
     double minTrackedPriority; //! Set to AllowFreeThreshold
     unsigned int nBestSeenHeight;
+    //! blocks processed since startup, not saved
+    unsigned int nBlocksSeen;
     struct TxStatsInfo
     {
         TxConfirmStats *stats;
@@ -754,7 +754,16 @@ uint32_t lwmaGetNextPOSRequired(const CBlockIndex* pindexLast, const Consensus::
     return nextTarget.GetCompact();
 }
 
-bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams& params)
+std::unique_ptr<CBlake2bPrefix> EquihashBaseState(const CChainParams& params)
+{
+    std::unique_ptr<CBlake2bPrefix> pbase;
+    // the NK chains combine several hashes per index, they keep the libsodium path
+    if (ASSETCHAINS_ALGO == ASSETCHAINS_EQUIHASH && ASSETCHAINS_NK[0] == 0 && ASSETCHAINS_NK[1] == 0)
+        pbase.reset(new CBlake2bPrefix(EhInitialisePrefix(params.EquihashN(), params.EquihashK())));
+    return pbase;
+}
+
+bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams& params, const CBlake2bPrefix *pbase)
 {
     if (ASSETCHAINS_ALGO != ASSETCHAINS_EQUIHASH)
         return true;
@@ -767,9 +776,6 @@ bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams& param
 
     if ( Params().NetworkIDString() == "regtest" )
         return(true);
-    // Hash state
-    crypto_generichash_blake2b_state state;
-    EhInitialiseState(n, k, state);
 
     // I = the block header minus nonce and solution.
     CEquihashInput I{*pblock};
@@ -778,11 +784,24 @@ bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams& param
     ss << I;
     ss << pblock->nNonce;
 
-    // H(I||V||...
-    crypto_generichash_blake2b_update(&state, (unsigned char*)&ss[0], ss.size());
-
     bool isValid;
-    EhIsValidSolution(n, k, state, pblock->nSolution, isValid);
+    if ( ASSETCHAINS_NK[0] == 0 && ASSETCHAINS_NK[1] == 0 )
+    {
+        // H(I||V||... for all the indices of the solution in one batch
+        CBlake2bPrefix prefix = pbase != NULL ? *pbase : EhInitialisePrefix(n, k);
+        prefix.Write((unsigned char*)&ss[0], ss.size());
+        EhIsValidSolution(n, k, prefix, pblock->nSolution, isValid);
+    }
+    else
+    {
+        // Hash state
+        crypto_generichash_blake2b_state state;
+        EhInitialiseState(n, k, state);
+
+        // H(I||V||...
+        crypto_generichash_blake2b_update(&state, (unsigned char*)&ss[0], ss.size());
+        EhIsValidSolution(n, k, state, pblock->nSolution, isValid);
+    }
 
     if (!isValid)
         return error("CheckEquihashSolution(): invalid solution");
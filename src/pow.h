@@ -23,7 +23,9 @@
 
 #include "chain.h"
 #include "consensus/params.h"
+#include "crypto/blake2b.h"
 
+#include <memory>
 #include <stdint.h>
 
 class CBlockHeader;
@@ -39,8 +41,14 @@ unsigned int CalculateNextWorkRequired(arith_uint256 bnAvg,
 
 unsigned int lwmaGetNextPOSRequired(const CBlockIndex* pindexLast, const Consensus::Params& params);
 
-/** Check whether the Equihash solution in a block header is valid */
-bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams&);
+/**
+ * The Blake2b state personalised for the chain's Equihash parameters, for a
+ * batch of headers to share. NULL if the chain doesn't check solutions with it.
+ */
+std::unique_ptr<CBlake2bPrefix> EquihashBaseState(const CChainParams&);
+
+/** Check whether the Equihash solution in a block header is valid, starting from pbase if it is not NULL */
+bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams&, const CBlake2bPrefix *pbase = NULL);
 
 /** Check whether a block hash satisfies the proof-of-work requirement specified by nBits */
 bool CheckProofOfWork(const CBlockHeader &blkHeader, uint8_t *pubkey33, int32_t height, const Consensus::Params& params);
@@ -0,0 +1,140 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "pow/equihashsolver.h"
+
+#include "util.h"
+
+#include <atomic>
+
+#ifdef ENABLE_MINING
+#include "pow/tromp/equi_miner.h"
+#endif
+
+bool CEquihashSolver::Solve(unsigned int n, unsigned int k, const eh_HashState& base_state,
+                            const std::function<bool(std::vector<unsigned char>)> validBlock,
+                            const std::function<bool(EhSolverCancelCheck)> cancelled)
+{
+    std::function<bool(std::vector<unsigned char>)> countedBlock = [this, &validBlock](std::vector<unsigned char> soln) {
+        solutions.increment();
+        return validBlock(soln);
+    };
+    bool found = Run(n, k, base_state, countedBlock, cancelled);
+    runs.increment();
+    return found;
+}
+
+#ifdef ENABLE_MINING
+namespace {
+
+/** The optimised solver of crypto/equihash, for any (n, k) */
+class CEquihashDefaultSolver : public CEquihashSolver
+{
+public:
+    const char* Name() const { return "default"; }
+    bool Supports(unsigned int n, unsigned int k) const { return true; }
+
+protected:
+    bool Run(unsigned int n, unsigned int k, const eh_HashState& base_state,
+             const std::function<bool(std::vector<unsigned char>)> validBlock,
+             const std::function<bool(EhSolverCancelCheck)> cancelled)
+    {
+        return EhOptimisedSolve(n, k, base_state, validBlock, cancelled);
+    }
+};
+
+/** John Tromp's solver, built for n = 200, k = 9 only */
+class CEquihashTrompSolver : public CEquihashSolver
+{
+public:
+    const char* Name() const { return "tromp"; }
+    bool Supports(unsigned int n, unsigned int k) const { return n == WN && k == WK; }
+
+protected:
+    bool Run(unsigned int n, unsigned int k, const eh_HashState& base_state,
+             const std::function<bool(std::vector<unsigned char>)> validBlock,
+             const std::function<bool(EhSolverCancelCheck)> cancelled)
+    {
+        // Create solver and initialize it.
+        equi eq(1);
+        eq.setstate(&base_state);
+
+        // Initialization done, start algo driver.
+        eq.digit0(0);
+        eq.xfull = eq.bfull = eq.hfull = 0;
+        eq.showbsizes(0);
+        for (u32 r = 1; r < WK; r++) {
+            if (cancelled(RoundEnd))
+                throw EhSolverCancelledException();
+            (r&1) ? eq.digitodd(r, 0) : eq.digiteven(r, 0);
+            eq.xfull = eq.bfull = eq.hfull = 0;
+            eq.showbsizes(r);
+        }
+        eq.digitK(0);
+
+        // Convert solution indices to byte array (decompress) and pass it to validBlock method.
+        for (size_t s = 0; s < eq.nsols; s++) {
+            LogPrint("pow", "Checking solution %d\n", s+1);
+            std::vector<eh_index> index_vector(PROOFSIZE);
+            for (size_t i = 0; i < PROOFSIZE; i++) {
+                index_vector[i] = eq.sols[s][i];
+            }
+            std::vector<unsigned char> sol_char = GetMinimalFromIndices(index_vector, DIGITBITS);
+
+            if (validBlock(sol_char)) {
+                // If we find a POW solution, do not try other solutions
+                // because they become invalid as we created a new block in blockchain.
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+CEquihashDefaultSolver defaultSolver;
+CEquihashTrompSolver trompSolver;
+
+}
+#endif // ENABLE_MINING
+
+const std::vector<CEquihashSolver*>& GetEquihashSolvers()
+{
+#ifdef ENABLE_MINING
+    static const std::vector<CEquihashSolver*> solvers = { &trompSolver, &defaultSolver };
+#else
+    static const std::vector<CEquihashSolver*> solvers;
+#endif
+    return solvers;
+}
+
+CEquihashSolver* FindEquihashSolver(const std::string& strName)
+{
+    for (CEquihashSolver* solver : GetEquihashSolvers()) {
+        if (strName == solver->Name())
+            return solver;
+    }
+    return NULL;
+}
+
+CEquihashSolver* SelectEquihashSolver(unsigned int n, unsigned int k)
+{
+    CEquihashSolver* solver = FindEquihashSolver(GetArg("-equihashsolver", "tromp"));
+    if (solver != NULL && solver->Supports(n, k))
+        return solver;
+    static std::atomic<bool> fWarned(false);
+    if (mapArgs.count("-equihashsolver") && !fWarned.exchange(true))
+        LogPrintf("Equihash solver \"%s\" is not available for n = %u, k = %u, using \"default\"\n", GetArg("-equihashsolver", ""), n, k);
+    return FindEquihashSolver("default");
+}
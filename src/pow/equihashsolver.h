@@ -0,0 +1,68 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef KOMODO_POW_EQUIHASHSOLVER_H
+#define KOMODO_POW_EQUIHASHSOLVER_H
+
+#include "crypto/equihash.h"
+#include "metrics.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * An Equihash solver the miner threads run over the header and nonce hash
+ * state. Solvers are registered by name and selected with -equihashsolver,
+ * each one counts its own runs and checked solutions for getmininginfo.
+ */
+class CEquihashSolver
+{
+public:
+    AtomicCounter runs;
+    AtomicCounter solutions;
+
+    virtual ~CEquihashSolver() {}
+
+    virtual const char* Name() const = 0;
+    //! Whether the solver implements the (n, k) parameters
+    virtual bool Supports(unsigned int n, unsigned int k) const = 0;
+
+    /**
+     * Runs the solver once over base_state, calling validBlock for each solution
+     * until it returns true. Returns true if a solution was accepted, throws
+     * EhSolverCancelledException when cancelled returns true.
+     */
+    bool Solve(unsigned int n, unsigned int k, const eh_HashState& base_state,
+               const std::function<bool(std::vector<unsigned char>)> validBlock,
+               const std::function<bool(EhSolverCancelCheck)> cancelled);
+
+protected:
+    virtual bool Run(unsigned int n, unsigned int k, const eh_HashState& base_state,
+                     const std::function<bool(std::vector<unsigned char>)> validBlock,
+                     const std::function<bool(EhSolverCancelCheck)> cancelled) = 0;
+};
+
+//! The registered solvers
+const std::vector<CEquihashSolver*>& GetEquihashSolvers();
+//! The solver named strName, NULL if there is none
+CEquihashSolver* FindEquihashSolver(const std::string& strName);
+/**
+ * The -equihashsolver solver for (n, k). Without it "tromp" is used where it
+ * applies, an unknown or unsupported solver falls back to "default".
+ */
+CEquihashSolver* SelectEquihashSolver(unsigned int n, unsigned int k);
+
+#endif // KOMODO_POW_EQUIHASHSOLVER_H
@@ -25,6 +25,7 @@
 #include "utilstrencodings.h"
 
 #include "librustzcash.h"
+#include "zcash/Params.hpp"
 
 JSDescription::JSDescription(
     bool makeGrothProof,
@@ -129,6 +130,7 @@ public:
     {
         uint256 h_sig = params.h_sig(jsdesc.randomSeed, jsdesc.nullifiers, joinSplitPubKey);
 
+        libzcash::LoadGrothParams();
         return librustzcash_sprout_verify(
             proof.begin(),
             jsdesc.anchor.begin(),
@@ -37,6 +37,7 @@
 #endif
 
 #include <array>
+#include <memory>
 
 #include <boost/variant.hpp>
 
@@ -857,4 +858,10 @@ struct CMutableTransaction
     uint256 GetHash() const;
 };
 
+/** A transaction shared by the mempool and the caches instead of copied into each */
+typedef std::shared_ptr<const CTransaction> CTransactionRef;
+
+template <typename Tx>
+static inline CTransactionRef MakeTransactionRef(Tx&& txIn) { return std::make_shared<const CTransaction>(std::forward<Tx>(txIn)); }
+
 #endif // BITCOIN_PRIMITIVES_TRANSACTION_H
@@ -90,6 +90,9 @@ enum : uint64_t {
     // Zcash nodes used to support this by default, without advertising this bit,
     // but no longer do as of protocol version 170004 (= NO_BLOOM_VERSION)
     NODE_BLOOM = (1ULL << 2),
+    // NODE_COMPACT_FILTERS means the node serves the compact block filters of BIP 157 and 158,
+    // getcfilters, getcfheaders and getcfcheckpt
+    NODE_COMPACT_FILTERS = (1ULL << 6),
 
     NODE_NSPV = (1ULL << 30),
     NODE_ADDRINDEX = (1ULL << 29),
@@ -176,6 +179,8 @@ enum {
     // Nodes may always request a MSG_FILTERED_BLOCK in a getdata, however,
     // MSG_FILTERED_BLOCK should not appear in any invs except as a part of getdata.
     MSG_FILTERED_BLOCK,
+    // BIP 152, only requested in a getdata from the peers that sent sendcmpct
+    MSG_CMPCT_BLOCK,
 };
 
 #endif // BITCOIN_PROTOCOL_H
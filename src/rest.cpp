@@ -21,8 +21,12 @@
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "main.h"
+#include "base58.h"
+#include "blockfilterindex.h"
 #include "httpserver.h"
+#include "komodo_defs.h"
 #include "rpc/server.h"
+#include "cc/CCinclude.h"
 #include "streams.h"
 #include "sync.h"
 #include "txmempool.h"
@@ -36,6 +40,8 @@
 
 using namespace std;
 
+extern bool fAddressIndex, fSpentIndex;
+
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
 
 enum RetFormat {
@@ -71,6 +77,82 @@ struct CCoin {
     }
 };
 
+/*
+ * The entries of the binary address, spent and cc index replies. Indexes and
+ * heights are varints, amounts are 8 bytes as the deltas can be negative.
+ */
+struct CRestAddressUtxo {
+    uint256 txid;
+    uint32_t n;
+    CAmount satoshis;
+    uint32_t nHeight;
+    CScript script;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(txid);
+        READWRITE(VARINT(n));
+        READWRITE(satoshis);
+        READWRITE(VARINT(nHeight));
+        READWRITE(*(CScriptBase*)(&script));
+    }
+};
+
+struct CRestAddressDelta {
+    uint256 txid;
+    uint32_t n;
+    CAmount satoshis;
+    uint32_t nHeight;
+    uint32_t nTxIndex;
+    bool fSpending;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(txid);
+        READWRITE(VARINT(n));
+        READWRITE(satoshis);
+        READWRITE(VARINT(nHeight));
+        READWRITE(VARINT(nTxIndex));
+        READWRITE(fSpending);
+    }
+};
+
+struct CRestCCUnspent {
+    uint256 txid;
+    uint32_t n;
+    uint256 creationid;
+    CAmount satoshis;
+    uint32_t nHeight;
+    uint8_t evalcode;
+    uint8_t funcid;
+    uint8_t version;
+    CScript scriptPubKey;
+    CScript opreturn;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(txid);
+        READWRITE(VARINT(n));
+        READWRITE(creationid);
+        READWRITE(satoshis);
+        READWRITE(VARINT(nHeight));
+        READWRITE(evalcode);
+        READWRITE(funcid);
+        READWRITE(version);
+        READWRITE(*(CScriptBase*)(&scriptPubKey));
+        READWRITE(*(CScriptBase*)(&opreturn));
+    }
+};
+
 
 static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, string message)
 {
@@ -116,6 +198,50 @@ static bool ParseHashStr(const string& strReq, uint256& v)
     return true;
 }
 
+/** Write the binary or hex reply of ss, the other formats are the caller's */
+static bool WriteBinaryReply(HTTPRequest* req, enum RetFormat rf, const CDataStream& ss)
+{
+    if (rf == RF_HEX) {
+        string strHex = HexStr(ss.begin(), ss.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+    } else {
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ss.str());
+    }
+    return true;
+}
+
+static bool WriteJSONReply(HTTPRequest* req, const UniValue& obj)
+{
+    string strJSON = obj.write() + "\n";
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteReply(HTTP_OK, strJSON);
+    return true;
+}
+
+/** The height and hash of the tip the index replies start with */
+static void GetChainStamp(int& nHeight, uint256& hashTip)
+{
+    LOCK(cs_main);
+    nHeight = chainActive.Height();
+    hashTip = chainActive.LastTip() ? chainActive.LastTip()->GetBlockHash() : uint256();
+}
+
+/**
+ * Parse "<address>[/cc]" of an address index request, cc asks for the cc
+ * outputs of the address as the ccvout option of the RPCs does.
+ */
+static bool ParseIndexAddress(const string& strReq, string& strAddress, uint160& hashBytes, int& type)
+{
+    vector<string> parts;
+    boost::split(parts, strReq, boost::is_any_of("/"));
+    if (parts.empty() || parts.size() > 2 || (parts.size() == 2 && parts[1] != "cc"))
+        return false;
+    strAddress = parts[0];
+    return CBitcoinAddress(strAddress).GetIndexKey(hashBytes, type, parts.size() == 2);
+}
+
 static bool CheckWarmup(HTTPRequest* req)
 {
     std::string statusmessage;
@@ -198,6 +324,107 @@ static bool rest_headers(HTTPRequest* req,
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/** /rest/blockfilter/<type>/<hash>.<ext>, the filter of a block of the active chain and its header */
+static bool rest_blockfilter(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    if (!IsBlockFilterIndexEnabled())
+        return RESTERR(req, HTTP_NOT_FOUND, "block filter index not enabled");
+
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+    BlockFilterType filterType;
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Use /rest/blockfilter/<type>/<hash>.<ext>.");
+    if (!BlockFilterTypeByName(path[0], filterType))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Unknown filter type: " + path[0]);
+    uint256 hash;
+    if (!ParseHashStr(path[1], hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[1]);
+
+    const CBlockIndex *pindex = NULL;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hash);
+        if (it != mapBlockIndex.end() && chainActive.Contains(it->second))
+            pindex = it->second;
+    }
+    if (pindex == NULL)
+        return RESTERR(req, HTTP_NOT_FOUND, path[1] + " not found");
+    BlockFilter filter;
+    uint256 header;
+    if (!LookupBlockFilter(filterType, pindex, filter) || !LookupBlockFilterHeader(filterType, pindex, header))
+        return RESTERR(req, HTTP_NOT_FOUND, path[1] + " not indexed yet");
+
+    if (rf != RF_JSON) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << filter.GetEncodedFilter() << header;
+        return WriteBinaryReply(req, rf, ss);
+    }
+    UniValue objFilter(UniValue::VOBJ);
+    objFilter.push_back(Pair("filter", HexStr(filter.GetEncodedFilter())));
+    objFilter.push_back(Pair("header", header.GetHex()));
+    return WriteJSONReply(req, objFilter);
+}
+
+/** /rest/blockfilterheaders/<type>/<count>/<hash>.<ext>, as /rest/headers the filter headers from hash on */
+static bool rest_blockfilterheaders(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    if (!IsBlockFilterIndexEnabled())
+        return RESTERR(req, HTTP_NOT_FOUND, "block filter index not enabled");
+
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+    BlockFilterType filterType;
+    if (path.size() != 3)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Use /rest/blockfilterheaders/<type>/<count>/<hash>.<ext>.");
+    if (!BlockFilterTypeByName(path[0], filterType))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Unknown filter type: " + path[0]);
+    long count = strtol(path[1].c_str(), NULL, 10);
+    if (count < 1 || count > MAX_GETCFHEADERS_SIZE)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Header count out of range: " + path[1]);
+    uint256 hash;
+    if (!ParseHashStr(path[2], hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[2]);
+
+    const CBlockIndex *pstart = NULL, *pstop = NULL;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hash);
+        if (it != mapBlockIndex.end() && chainActive.Contains(it->second)) {
+            pstart = it->second;
+            pstop = chainActive[std::min(pstart->GetHeight() + (int)count - 1, chainActive.Height())];
+        }
+    }
+    if (pstart == NULL)
+        return RESTERR(req, HTTP_NOT_FOUND, path[2] + " not found");
+    std::vector<uint256> headers;
+    if (!LookupBlockFilterHeaderRange(filterType, pstart->GetHeight(), pstop, headers))
+        return RESTERR(req, HTTP_NOT_FOUND, "filter headers not indexed yet");
+
+    if (rf != RF_JSON) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        for (const uint256& header : headers)
+            ss << header;
+        return WriteBinaryReply(req, rf, ss);
+    }
+    UniValue jsonHeaders(UniValue::VARR);
+    for (const uint256& header : headers)
+        jsonHeaders.push_back(header.GetHex());
+    return WriteJSONReply(req, jsonHeaders);
+}
+
 static bool rest_block(HTTPRequest* req,
                        const std::string& strURIPart,
                        bool showTxDetails)
@@ -599,6 +826,309 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+static bool rest_address_utxos(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    if (!fAddressIndex)
+        return RESTERR(req, HTTP_NOT_FOUND, "address index not enabled");
+
+    string strAddress;
+    uint160 hashBytes;
+    int type = 0;
+    if (!ParseIndexAddress(params[0], strAddress, hashBytes, type))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + params[0]);
+
+    int nHeight;
+    uint256 hashTip;
+    GetChainStamp(nHeight, hashTip);
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    if (!GetAddressUnspent(hashBytes, type, unspentOutputs))
+        return RESTERR(req, HTTP_NOT_FOUND, "No information available for address");
+
+    if (rf != RF_JSON) {
+        vector<CRestAddressUtxo> utxos;
+        utxos.reserve(unspentOutputs.size());
+        for (const auto& output : unspentOutputs) {
+            CRestAddressUtxo utxo;
+            utxo.txid = output.first.txhash;
+            utxo.n = output.first.index;
+            utxo.satoshis = output.second.satoshis;
+            utxo.nHeight = output.second.blockHeight;
+            utxo.script = output.second.script;
+            utxos.push_back(utxo);
+        }
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << nHeight << hashTip << utxos;
+        return WriteBinaryReply(req, rf, ss);
+    }
+    UniValue objUtxos(UniValue::VOBJ);
+    objUtxos.push_back(Pair("chainHeight", nHeight));
+    objUtxos.push_back(Pair("chaintipHash", hashTip.GetHex()));
+    objUtxos.push_back(Pair("address", strAddress));
+    UniValue utxos(UniValue::VARR);
+    for (const auto& output : unspentOutputs) {
+        UniValue utxo(UniValue::VOBJ);
+        utxo.push_back(Pair("txid", output.first.txhash.GetHex()));
+        utxo.push_back(Pair("outputIndex", (int64_t)output.first.index));
+        utxo.push_back(Pair("script", HexStr(output.second.script.begin(), output.second.script.end())));
+        utxo.push_back(Pair("satoshis", output.second.satoshis));
+        utxo.push_back(Pair("height", output.second.blockHeight));
+        utxos.push_back(utxo);
+    }
+    objUtxos.push_back(Pair("utxos", utxos));
+    return WriteJSONReply(req, objUtxos);
+}
+
+/** The deltas of an address, or with fBalance its balance and what it received in total */
+static bool rest_address_index(HTTPRequest* req, const std::string& strURIPart, bool fBalance)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    if (!fAddressIndex)
+        return RESTERR(req, HTTP_NOT_FOUND, "address index not enabled");
+
+    string strAddress;
+    uint160 hashBytes;
+    int type = 0;
+    if (!ParseIndexAddress(params[0], strAddress, hashBytes, type))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + params[0]);
+
+    int nHeight;
+    uint256 hashTip;
+    GetChainStamp(nHeight, hashTip);
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    if (!GetAddressIndex(hashBytes, type, addressIndex))
+        return RESTERR(req, HTTP_NOT_FOUND, "No information available for address");
+
+    if (fBalance) {
+        CAmount balance = 0, received = 0;
+        for (const auto& entry : addressIndex) {
+            if (entry.second > 0)
+                received += entry.second;
+            balance += entry.second;
+        }
+        if (rf != RF_JSON) {
+            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+            ss << nHeight << hashTip << balance << received;
+            return WriteBinaryReply(req, rf, ss);
+        }
+        UniValue objBalance(UniValue::VOBJ);
+        objBalance.push_back(Pair("chainHeight", nHeight));
+        objBalance.push_back(Pair("chaintipHash", hashTip.GetHex()));
+        objBalance.push_back(Pair("address", strAddress));
+        objBalance.push_back(Pair("balance", balance));
+        objBalance.push_back(Pair("received", received));
+        return WriteJSONReply(req, objBalance);
+    }
+
+    if (rf != RF_JSON) {
+        vector<CRestAddressDelta> deltas;
+        deltas.reserve(addressIndex.size());
+        for (const auto& entry : addressIndex) {
+            CRestAddressDelta delta;
+            delta.txid = entry.first.txhash;
+            delta.n = entry.first.index;
+            delta.satoshis = entry.second;
+            delta.nHeight = entry.first.blockHeight;
+            delta.nTxIndex = entry.first.txindex;
+            delta.fSpending = entry.first.spending;
+            deltas.push_back(delta);
+        }
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << nHeight << hashTip << deltas;
+        return WriteBinaryReply(req, rf, ss);
+    }
+    UniValue objDeltas(UniValue::VOBJ);
+    objDeltas.push_back(Pair("chainHeight", nHeight));
+    objDeltas.push_back(Pair("chaintipHash", hashTip.GetHex()));
+    objDeltas.push_back(Pair("address", strAddress));
+    UniValue deltas(UniValue::VARR);
+    for (const auto& entry : addressIndex) {
+        UniValue delta(UniValue::VOBJ);
+        delta.push_back(Pair("satoshis", entry.second));
+        delta.push_back(Pair("txid", entry.first.txhash.GetHex()));
+        delta.push_back(Pair("index", (int)entry.first.index));
+        delta.push_back(Pair("blockindex", (int)entry.first.txindex));
+        delta.push_back(Pair("height", entry.first.blockHeight));
+        deltas.push_back(delta);
+    }
+    objDeltas.push_back(Pair("deltas", deltas));
+    return WriteJSONReply(req, objDeltas);
+}
+
+static bool rest_address_deltas(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_address_index(req, strURIPart, false);
+}
+
+static bool rest_address_balance(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_address_index(req, strURIPart, true);
+}
+
+static bool rest_spentinfo(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    if (!fSpentIndex)
+        return RESTERR(req, HTTP_NOT_FOUND, "spent index not enabled");
+
+    // <txid>-<n>, as the outpoints of getutxos
+    uint256 txid;
+    int32_t nOutput;
+    size_t nDash = params[0].find("-");
+    if (nDash == string::npos || !ParseHashStr(params[0].substr(0, nDash), txid) ||
+        !ParseInt32(params[0].substr(nDash + 1), &nOutput) || nOutput < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid outpoint: " + params[0]);
+
+    CSpentIndexKey key(txid, nOutput);
+    CSpentIndexValue value;
+    if (!GetSpentIndex(key, value))
+        return RESTERR(req, HTTP_NOT_FOUND, params[0] + " not spent");
+
+    if (rf != RF_JSON) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << value.txid << VARINT(value.inputIndex) << value.blockHeight;
+        return WriteBinaryReply(req, rf, ss);
+    }
+    UniValue objSpent(UniValue::VOBJ);
+    objSpent.push_back(Pair("txid", value.txid.GetHex()));
+    objSpent.push_back(Pair("index", (int)value.inputIndex));
+    objSpent.push_back(Pair("height", value.blockHeight));
+    return WriteJSONReply(req, objSpent);
+}
+
+/**
+ * The unspent cc index outputs of "<evalcode|ccaddress>[/<creationid>]", an
+ * evalcode as two hex digits stands for the global address of its contract.
+ * Outputs spent in the mempool are not filtered out.
+ */
+static bool rest_ccunspents(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    if (!fUnspentCCIndex)
+        return RESTERR(req, HTTP_NOT_FOUND, "unspent cc index not enabled");
+
+    vector<string> parts;
+    boost::split(parts, params[0], boost::is_any_of("/"));
+    if (parts.empty() || parts.size() > 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid request: " + params[0]);
+
+    string strAddress = parts[0];
+    if (strAddress.size() == 2 && IsHex(strAddress)) {
+        struct CCcontract_info *cp, C;
+        cp = CCinit(&C, ParseHex(strAddress)[0]);
+        if (cp == NULL || cp->unspendableCCaddr[0] == 0)
+            return RESTERR(req, HTTP_BAD_REQUEST, "Invalid evalcode: " + strAddress);
+        strAddress = cp->unspendableCCaddr;
+    }
+    uint160 hashBytes;
+    int type = 0;
+    if (!CBitcoinAddress(strAddress).GetIndexKey(hashBytes, type, true))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + strAddress);
+    uint256 creationid;
+    if (parts.size() == 2 && !ParseHashStr(parts[1], creationid))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid creationid: " + parts[1]);
+
+    int nHeight;
+    uint256 hashTip;
+    GetChainStamp(nHeight, hashTip);
+    std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > unspentOutputs;
+    if (!GetUnspentCCIndex(hashBytes, creationid, unspentOutputs, -1, -1, 0))
+        return RESTERR(req, HTTP_NOT_FOUND, "No information available for address");
+
+    if (rf != RF_JSON) {
+        vector<CRestCCUnspent> utxos;
+        utxos.reserve(unspentOutputs.size());
+        for (const auto& output : unspentOutputs) {
+            CRestCCUnspent utxo;
+            utxo.txid = output.first.txhash;
+            utxo.n = output.first.index;
+            utxo.creationid = output.first.creationid;
+            utxo.satoshis = output.second.satoshis;
+            utxo.nHeight = output.second.blockHeight;
+            utxo.evalcode = output.second.evalcode;
+            utxo.funcid = output.second.funcid;
+            utxo.version = output.second.version;
+            utxo.scriptPubKey = output.second.scriptPubKey;
+            utxo.opreturn = output.second.opreturn;
+            utxos.push_back(utxo);
+        }
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << nHeight << hashTip << utxos;
+        return WriteBinaryReply(req, rf, ss);
+    }
+    UniValue objUtxos(UniValue::VOBJ);
+    objUtxos.push_back(Pair("chainHeight", nHeight));
+    objUtxos.push_back(Pair("chaintipHash", hashTip.GetHex()));
+    objUtxos.push_back(Pair("address", strAddress));
+    UniValue utxos(UniValue::VARR);
+    for (const auto& output : unspentOutputs) {
+        UniValue utxo(UniValue::VOBJ);
+        utxo.push_back(Pair("txhash", output.first.txhash.GetHex()));
+        utxo.push_back(Pair("index", (int64_t)output.first.index));
+        utxo.push_back(Pair("creationId", output.first.creationid.GetHex()));
+        utxo.push_back(Pair("satoshis", output.second.satoshis));
+        utxo.push_back(Pair("blockHeight", output.second.blockHeight));
+        utxo.push_back(Pair("evalcode", HexStr(std::string(1, output.second.evalcode))));
+        utxo.push_back(Pair("funcid", std::string(1, output.second.funcid)));
+        utxo.push_back(Pair("version", (int)output.second.version));
+        utxo.push_back(Pair("scriptPubKey", HexStr(output.second.scriptPubKey.begin(), output.second.scriptPubKey.end())));
+        utxo.push_back(Pair("opreturn", HexStr(output.second.opreturn.begin(), output.second.opreturn.end())));
+        utxos.push_back(utxo);
+    }
+    objUtxos.push_back(Pair("utxos", utxos));
+    return WriteJSONReply(req, objUtxos);
+}
+
+/** The last notarization of this chain the node knows of */
+static bool rest_notarization(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    uint256 notarized_hash, notarized_desttxid;
+    int32_t prevMoMheight, notarized_height;
+    {
+        LOCK(cs_main);
+        notarized_height = komodo_notarized_height(&prevMoMheight, &notarized_hash, &notarized_desttxid);
+    }
+
+    if (rf != RF_JSON) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << notarized_height << notarized_hash << notarized_desttxid << prevMoMheight;
+        return WriteBinaryReply(req, rf, ss);
+    }
+    UniValue objNotarization(UniValue::VOBJ);
+    objNotarization.push_back(Pair("notarized", notarized_height));
+    objNotarization.push_back(Pair("notarizedhash", notarized_hash.GetHex()));
+    objNotarization.push_back(Pair("notarizedtxid", notarized_desttxid.GetHex()));
+    objNotarization.push_back(Pair("prevMoMheight", prevMoMheight));
+    return WriteJSONReply(req, objNotarization);
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -610,7 +1140,15 @@ static const struct {
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
+      {"/rest/blockfilter/", rest_blockfilter},
+      {"/rest/blockfilterheaders/", rest_blockfilterheaders},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/address/utxos/", rest_address_utxos},
+      {"/rest/address/deltas/", rest_address_deltas},
+      {"/rest/address/balance/", rest_address_balance},
+      {"/rest/spentinfo/", rest_spentinfo},
+      {"/rest/ccunspents/", rest_ccunspents},
+      {"/rest/notarization", rest_notarization},
 };
 
 bool StartREST()
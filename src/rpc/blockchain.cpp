@@ -19,18 +19,23 @@
 ******************************************************************************/
 
 #include "amount.h"
+#include "blockfilterindex.h"
 #include "chain.h"
+#include "chaineventlog.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "crosschain.h"
 #include "base58.h"
 #include "consensus/validation.h"
+#include "dbwrapper.h"
 #include "cc/eval.h"
 #include "main.h"
 #include "primitives/transaction.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
+#include "txdb.h"
+#include "txoutsnapshot.h"
 #include "util.h"
 #include "script/script.h"
 #include "script/script_error.h"
@@ -51,6 +56,8 @@
 
 using namespace std;
 
+extern CCoinsViewDB *pcoinsdbview;
+
 double GetDifficultyINTERNAL(const CBlockIndex* blockindex, bool networkDifficulty)
 {
     // Floating point number that is a multiple of the minimum difficulty,
@@ -161,25 +168,77 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     return result;
 }
 
+CChainTipSnapshot::CChainTipSnapshot()
+{
+    LOCK(cs_main);
+    tip = chainActive.LastTip();
+}
+
+int CChainTipSnapshot::Height() const
+{
+    return tip ? tip->GetHeight() : -1;
+}
+
+bool CChainTipSnapshot::Contains(const CBlockIndex* pindex) const
+{
+    return tip && pindex && pindex->GetHeight() <= tip->GetHeight() && tip->GetAncestor(pindex->GetHeight()) == pindex;
+}
+
+const CBlockIndex* CChainTipSnapshot::Next(const CBlockIndex* pindex) const
+{
+    if (!Contains(pindex) || pindex == tip)
+        return NULL;
+    return tip->GetAncestor(pindex->GetHeight() + 1);
+}
+
+CBlockIndex* ReadBlockForRPC(const uint256& hash, CBlock& block)
+{
+    CBlockIndex* pblockindex;
+    CDiskBlockPos pos;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(hash);
+        if (mi == mapBlockIndex.end() || mi->second == NULL)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pblockindex = mi->second;
+
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+        // the position is set once, when the block data is stored
+        pos = pblockindex->GetBlockPos();
+    }
+
+    if (!ReadBlockFromDisk(pblockindex->GetHeight(), block, pos, 1) || block.GetHash() != pblockindex->GetBlockHash())
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    return pblockindex;
+}
+
 UniValue blockToDeltasJSON(const CBlock& block, const CBlockIndex* blockindex)
 {
     UniValue result(UniValue::VOBJ);
+    CChainTipSnapshot chain;
     result.push_back(Pair("hash", block.GetHash().GetHex()));
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex)) {
-        confirmations = chainActive.Height() - blockindex->GetHeight() + 1;
+    if (chain.Contains(blockindex)) {
+        confirmations = chain.Height() - blockindex->GetHeight() + 1;
     }
     else {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block is an orphan");
     }
-    result.push_back(Pair("confirmations", komodo_dpowconfs(blockindex->GetHeight(), confirmations)));
+    int dpowconfs, segid;
+    {
+        LOCK(cs_main);
+        dpowconfs = komodo_dpowconfs(blockindex->GetHeight(), confirmations);
+        segid = komodo_segid(0, blockindex->GetHeight());
+    }
+    result.push_back(Pair("confirmations", dpowconfs));
     result.push_back(Pair("rawconfirmations", confirmations));
     result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
     result.push_back(Pair("height", blockindex->GetHeight()));
     result.push_back(Pair("version", block.nVersion));
     result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    result.push_back(Pair("segid", (int)komodo_segid(0, blockindex->GetHeight())));
+    result.push_back(Pair("segid", segid));
 
     UniValue deltas(UniValue::VARR);
 
@@ -278,7 +337,7 @@ UniValue blockToDeltasJSON(const CBlock& block, const CBlockIndex* blockindex)
 
     if (blockindex->pprev)
         result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
+    const CBlockIndex *pnext = chain.Next(blockindex);
     if (pnext)
         result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
     return result;
@@ -287,21 +346,28 @@ UniValue blockToDeltasJSON(const CBlock& block, const CBlockIndex* blockindex)
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
 {
     UniValue result(UniValue::VOBJ);
-    uint256 notarized_hash, notarized_desttxid; int32_t prevMoMheight, notarized_height;
-    notarized_height = komodo_notarized_height(&prevMoMheight, &notarized_hash, &notarized_desttxid);
-    result.push_back(Pair("last_notarized_height", notarized_height));
-    result.push_back(Pair("hash", block.GetHash().GetHex()));
+    // cs_main is held for the komodo state and each tx, not the whole block
+    CChainTipSnapshot chain;
+    uint256 notarized_hash, notarized_desttxid; int32_t prevMoMheight, notarized_height, dpowconfs, segid;
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->GetHeight() + 1;
-    result.push_back(Pair("confirmations", komodo_dpowconfs(blockindex->GetHeight(), confirmations)));
+    if (chain.Contains(blockindex))
+        confirmations = chain.Height() - blockindex->GetHeight() + 1;
+    {
+        LOCK(cs_main);
+        notarized_height = komodo_notarized_height(&prevMoMheight, &notarized_hash, &notarized_desttxid);
+        dpowconfs = komodo_dpowconfs(blockindex->GetHeight(), confirmations);
+        segid = komodo_segid(0, blockindex->GetHeight());
+    }
+    result.push_back(Pair("last_notarized_height", notarized_height));
+    result.push_back(Pair("hash", block.GetHash().GetHex()));
+    result.push_back(Pair("confirmations", dpowconfs));
     result.push_back(Pair("rawconfirmations", confirmations));
     result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
     result.push_back(Pair("height", blockindex->GetHeight()));
     result.push_back(Pair("version", block.nVersion));
     result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    result.push_back(Pair("segid", (int)komodo_segid(0, blockindex->GetHeight())));
+    result.push_back(Pair("segid", segid));
     result.push_back(Pair("finalsaplingroot", block.hashFinalSaplingRoot.GetHex()));
     UniValue txs(UniValue::VARR);
     BOOST_FOREACH(const CTransaction&tx, block.vtx)
@@ -309,7 +375,10 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
         if (txDetails)
         {
             UniValue objTx(UniValue::VOBJ);
-            TxToJSON(tx, uint256(), objTx);
+            {
+                LOCK(cs_main);
+                TxToJSON(tx, uint256(), objTx);
+            }
             txs.push_back(objTx);
         }
         else
@@ -332,7 +401,7 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
 
     if (blockindex->pprev)
         result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
+    const CBlockIndex *pnext = chain.Next(blockindex);
     if (pnext)
         result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
     return result;
@@ -544,17 +613,8 @@ UniValue getblockdeltas(const UniValue& params, bool fHelp, const CPubKey& mypk)
     std::string strHash = params[0].get_str();
     uint256 hash(uint256S(strHash));
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-
     CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
-
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
-
-    if (!ReadBlockFromDisk(block, pblockindex, 1))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    CBlockIndex* pblockindex = ReadBlockForRPC(hash, block);
 
     return blockToDeltasJSON(block, pblockindex);
 }
@@ -609,9 +669,6 @@ UniValue getblockhashes(const UniValue& params, bool fHelp, const CPubKey& mypk)
 
     std::vector<std::pair<uint256, unsigned int> > blockHashes;
 
-    if (fActiveOnly)
-        LOCK(cs_main);
-
     if (!GetTimestampIndex(high, low, fActiveOnly, blockHashes)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for block hashes");
     }
@@ -734,6 +791,58 @@ printf(" blockhash.%d\n",nHeight);
 return(hash);
 }*/
 
+UniValue getblockfilter(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2)
+        throw runtime_error(
+            "getblockfilter \"blockhash\" ( \"filtertype\" )\n"
+            "\nReturns the BIP 158 compact filter of a block of the active chain and its filter header, with -blockfilterindex.\n"
+            "The basic filter holds the output and spent scripts of the block and the cc addresses of its cc scripts.\n"
+            "\nArguments:\n"
+            "1. \"blockhash\"       (string, required) The block hash\n"
+            "2. \"filtertype\"      (string, optional, default=\"basic\") The filter type\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : \"hex\",   (string) the hex encoded filter data\n"
+            "  \"header\" : \"hex\",   (string) the hex encoded filter header\n"
+            "  \"indexheight\" : n   (numeric) the last block height the index has built\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+        );
+
+    if (!IsBlockFilterIndexEnabled())
+        throw JSONRPCError(RPC_MISC_ERROR, "Block filter index not enabled, start with -blockfilterindex");
+
+    uint256 hash(ParseHashV(params[0], "blockhash"));
+    BlockFilterType filterType = BLOCK_FILTER_BASIC;
+    if (params.size() > 1 && !BlockFilterTypeByName(params[1].get_str(), filterType))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+
+    const CBlockIndex *pindex = NULL;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator mi = mapBlockIndex.find(hash);
+        if (mi == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        if (!chainActive.Contains(mi->second))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block is not in the active chain");
+        pindex = mi->second;
+    }
+
+    BlockFilter filter;
+    uint256 header;
+    if (!LookupBlockFilter(filterType, pindex, filter) || !LookupBlockFilterHeader(filterType, pindex, header))
+        throw JSONRPCError(RPC_MISC_ERROR, "Filter not found, the index is still building");
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("filter", HexStr(filter.GetEncodedFilter())));
+    ret.push_back(Pair("header", header.GetHex()));
+    ret.push_back(Pair("indexheight", GetBlockFilterIndexStatus().nHeight));
+    return ret;
+}
+
 UniValue getblockheader(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
@@ -841,8 +950,6 @@ UniValue getblock(const UniValue& params, bool fHelp, const CPubKey& mypk)
             + HelpExampleRpc("getblock", "12800")
         );
 
-    LOCK(cs_main);
-
     std::string strHash = params[0].get_str();
 
     // If height is supplied, find the hash
@@ -861,6 +968,7 @@ UniValue getblock(const UniValue& params, bool fHelp, const CPubKey& mypk)
             throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block height parameter");
         }
 
+        LOCK(cs_main);
         if (nHeight < 0 || nHeight > chainActive.Height()) {
             throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
         }
@@ -883,17 +991,10 @@ UniValue getblock(const UniValue& params, bool fHelp, const CPubKey& mypk)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Verbosity must be in range from 0 to 2");
     }
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-
-    CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
-
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
-
-    if (!ReadBlockFromDisk(block, pblockindex, 1))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    // cs_main is only held to look the block up, not to read and convert it
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    CBlock& block = *pblock;
+    CBlockIndex* pblockindex = ReadBlockForRPC(hash, block);
 
     if (verbosity == 0)
     {
@@ -903,16 +1004,48 @@ UniValue getblock(const UniValue& params, bool fHelp, const CPubKey& mypk)
         return strHex;
     }
 
+    if (verbosity >= 2 && RPCStreamingEnabled()) {
+        // The txs are written into the reply one at a time, their trees
+        // are the bulk of a large block. The rest is as blockToJSON has it.
+        UniValue header = blockToJSON(block, pblockindex, false);
+        SetRPCStreamResult([pblock, header](CJSONStreamWriter& writer) {
+            const std::vector<std::string>& keys = header.getKeys();
+            const std::vector<UniValue>& values = header.getValues();
+            writer.BeginObject();
+            for (size_t i = 0; i < keys.size(); i++) {
+                writer.Key(keys[i]);
+                if (keys[i] != "tx") {
+                    writer.Value(values[i]);
+                    continue;
+                }
+                writer.BeginArray();
+                for (const CTransaction& tx : pblock->vtx) {
+                    UniValue objTx(UniValue::VOBJ);
+                    {
+                        LOCK(cs_main);
+                        TxToJSON(tx, uint256(), objTx);
+                    }
+                    writer.Value(objTx);
+                }
+                writer.EndArray();
+            }
+            writer.EndObject();
+        });
+        return NullUniValue;
+    }
+
     return blockToJSON(block, pblockindex, verbosity >= 2);
 }
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( scan )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "They are kept up to date as blocks are connected, a scan of the whole set also computes hash_serialized.\n"
+            "\nArguments:\n"
+            "1. scan    (boolean, optional, default=false) Scan the whole set, note this may take some time\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
@@ -920,30 +1053,196 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp, const CPubKey& mypk
             "  \"transactions\": n,      (numeric) The number of transactions\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
             "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized hash, with scan only\n"
+            "  \"muhash\": \"hash\",            (string) The multiset hash of the unspent outputs\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "true")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
+    bool fScan = params.size() > 0 && params[0].get_bool();
     FlushStateToDisk();
-    if (pcoinsTip->GetStats(stats)) {
+    if (fScan ? pcoinsdbview->ScanStats(stats) : pcoinsTip->GetStats(stats)) {
         ret.push_back(Pair("height", (int64_t)stats.nHeight));
         ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
         ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
         ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
         ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
-        ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
+        if (!stats.hashSerialized.IsNull())
+            ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
+        ret.push_back(Pair("muhash", stats.hashMuHash.GetHex()));
         ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
     }
     return ret;
 }
 
+UniValue getdbinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getdbinfo\n"
+            "\nReturns the settings, size and compactions of the open LevelDB databases.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"name\",          (string) The database, as -dbtune names it\n"
+            "    \"approximatesize\": n,    (numeric) The approximate bytes on disk\n"
+            "    \"cache\": n,              (numeric) The block cache bytes, the budget of the shared one\n"
+            "    \"sharedcache\": true|false, (boolean) If the block cache is shared with the other databases\n"
+            "    \"cacheusage\": n,         (numeric) The bytes held by its own block cache\n"
+            "    \"writebuffer\": n,        (numeric) The write buffer bytes\n"
+            "    \"blocksize\": n,          (numeric) The table block bytes\n"
+            "    \"bloombits\": n,          (numeric) The bloom filter bits per key, 0 = none\n"
+            "    \"compression\": true|false,\n"
+            "    \"levels\": [            (array) The levels with files or compactions\n"
+            "      {\n"
+            "        \"level\": n,\n"
+            "        \"files\": n,\n"
+            "        \"sizemb\": x.x,\n"
+            "        \"compactionseconds\": x.x,  (numeric) The time spent compacting into the level\n"
+            "        \"readmb\": x.x,              (numeric) The MB read by those compactions\n"
+            "        \"writemb\": x.x              (numeric) The MB written by those compactions\n"
+            "      }, ...\n"
+            "    ]\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getdbinfo", "")
+            + HelpExampleRpc("getdbinfo", "")
+        );
+
+    UniValue ret(UniValue::VARR);
+    for (const CDBStats& stats : GetDBStats()) {
+        UniValue db(UniValue::VOBJ);
+        db.push_back(Pair("name", stats.strName));
+        db.push_back(Pair("approximatesize", (uint64_t)stats.nApproximateSize));
+        db.push_back(Pair("cache", (uint64_t)stats.tuning.nBlockCache));
+        db.push_back(Pair("sharedcache", stats.tuning.fSharedCache));
+        if (!stats.tuning.fSharedCache)
+            db.push_back(Pair("cacheusage", (uint64_t)stats.nCacheUsage));
+        db.push_back(Pair("writebuffer", (uint64_t)stats.tuning.nWriteBuffer));
+        db.push_back(Pair("blocksize", (uint64_t)stats.tuning.nBlockSize));
+        db.push_back(Pair("bloombits", stats.tuning.nBloomBits));
+        db.push_back(Pair("compression", stats.tuning.fCompression));
+        UniValue levels(UniValue::VARR);
+        for (const CDBLevelStats& level : stats.vLevels) {
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("level", level.nLevel));
+            obj.push_back(Pair("files", level.nFiles));
+            obj.push_back(Pair("sizemb", level.dSizeMB));
+            obj.push_back(Pair("compactionseconds", level.dCompactionSeconds));
+            obj.push_back(Pair("readmb", level.dReadMB));
+            obj.push_back(Pair("writemb", level.dWriteMB));
+            levels.push_back(obj);
+        }
+        db.push_back(Pair("levels", levels));
+        ret.push_back(db);
+    }
+    return ret;
+}
+
+UniValue getmemoryinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getmemoryinfo\n"
+            "\nReturns the memory used by the database caches, the UTXO cache and the mempool, with their budgets.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"dbcache\": {            (object) The LevelDB block caches\n"
+            "    \"budget\": n,          (numeric) The bytes the caches may hold\n"
+            "    \"usage\": n,           (numeric) The bytes they hold\n"
+            "    \"shared\": true|false  (boolean) If one cache is shared by the databases (-dbsharedcache)\n"
+            "  },\n"
+            "  \"coinscache\": {         (object) The in-memory UTXO cache\n"
+            "    \"budget\": n,\n"
+            "    \"usage\": n\n"
+            "  },\n"
+            "  \"mempool\": {\n"
+            "    \"usage\": n\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getmemoryinfo", "")
+            + HelpExampleRpc("getmemoryinfo", "")
+        );
+
+    // the databases with a cache of their own add to the shared one
+    size_t nBudget = 0, nUsage = 0;
+    bool fShared = GetSharedDBCacheUsage(nBudget, nUsage);
+    for (const CDBStats& stats : GetDBStats()) {
+        if (!stats.tuning.fSharedCache) {
+            nBudget += stats.tuning.nBlockCache;
+            nUsage += stats.nCacheUsage;
+        }
+    }
+    UniValue dbcache(UniValue::VOBJ);
+    dbcache.push_back(Pair("budget", (uint64_t)nBudget));
+    dbcache.push_back(Pair("usage", (uint64_t)nUsage));
+    dbcache.push_back(Pair("shared", fShared));
+
+    UniValue coinscache(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        coinscache.push_back(Pair("budget", (uint64_t)nCoinCacheUsage));
+        coinscache.push_back(Pair("usage", (uint64_t)pcoinsTip->DynamicMemoryUsage()));
+    }
+
+    UniValue mempoolinfo(UniValue::VOBJ);
+    mempoolinfo.push_back(Pair("usage", (uint64_t)mempool.DynamicMemoryUsage()));
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("dbcache", dbcache));
+    ret.push_back(Pair("coinscache", coinscache));
+    ret.push_back(Pair("mempool", mempoolinfo));
+    return ret;
+}
+
+UniValue dumptxoutset(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites a snapshot of the UTXO set at the tip, with the komodostate notary data, for -loadtxoutset.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The file to create, relative to the data directory if not absolute\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"path\": \"path\",           (string) The absolute path of the snapshot\n"
+            "  \"height\": n,               (numeric) The height of the snapshot block\n"
+            "  \"bestblock\": \"hex\",       (string) The snapshot block hash\n"
+            "  \"entries\": n,              (numeric) The number of chainstate database entries\n"
+            "  \"komodostate_bytes\": n,    (numeric) The size of the komodostate data\n"
+            "  \"hash\": \"hash\"            (string) The snapshot hash, to give as -loadtxoutsethash\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    boost::filesystem::path path = boost::filesystem::absolute(params[0].get_str(), GetDataDir());
+    CTxOutSetSnapshotInfo info;
+    std::string strError;
+    if (!DumpTxOutSet(path, info, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("path", path.string()));
+    ret.push_back(Pair("height", info.nHeight));
+    ret.push_back(Pair("bestblock", info.hashBlock.GetHex()));
+    ret.push_back(Pair("entries", (uint64_t)info.nEntries));
+    ret.push_back(Pair("komodostate_bytes", (uint64_t)info.nKomodoStateSize));
+    ret.push_back(Pair("hash", info.hashSnapshot.GetHex()));
+    return ret;
+}
+
 
 UniValue kvsearch(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
@@ -1370,6 +1669,18 @@ void NetworkUpgradeDescPushBack(
     }
 }
 
+/** The last getblockchaininfo reply and the state it was built for */
+struct BlockchainInfoCache
+{
+    uint256 hashTip;
+    int nHeaders;
+    int32_t longestchain;
+    bool fSynced;
+    UniValue result;
+};
+static CCriticalSection cs_blockchaininfoCache;
+static BlockchainInfoCache blockchaininfoCache;
+
 UniValue getblockchaininfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     if (fHelp || params.size() != 0)
@@ -1420,19 +1731,29 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp, const CPubKey& my
         );
 
     LOCK(cs_main);
+    // the reply only changes with these, polling it then only copies the last one
+    int32_t longestchain = KOMODO_LONGESTCHAIN;
+    bool fSynced = KOMODO_INSYNC != 0;
+    int nHeaders = pindexBestHeader ? pindexBestHeader->GetHeight() : -1;
+    {
+        LOCK(cs_blockchaininfoCache);
+        if (blockchaininfoCache.hashTip == chainActive.LastTip()->GetBlockHash() && blockchaininfoCache.nHeaders == nHeaders &&
+            blockchaininfoCache.longestchain == longestchain && blockchaininfoCache.fSynced == fSynced)
+            return blockchaininfoCache.result;
+    }
+
     double progress;
     if (ASSETCHAINS_SYMBOL[0] == 0) {
         progress = Checkpoints::GuessVerificationProgress(Params().Checkpoints(), chainActive.LastTip());
     }
     else {
-        int32_t longestchain = KOMODO_LONGESTCHAIN;//komodo_longestchain();
         progress = (longestchain > 0) ? (double)chainActive.Height() / longestchain : 1.0;
     }
     UniValue obj(UniValue::VOBJ);
     obj.push_back(Pair("chain", Params().NetworkIDString()));
     obj.push_back(Pair("blocks", (int)chainActive.Height()));
-    obj.push_back(Pair("synced", KOMODO_INSYNC != 0));
-    obj.push_back(Pair("headers", pindexBestHeader ? pindexBestHeader->GetHeight() : -1));
+    obj.push_back(Pair("synced", fSynced));
+    obj.push_back(Pair("headers", nHeaders));
     obj.push_back(Pair("bestblockhash", chainActive.LastTip()->GetBlockHash().GetHex()));
     obj.push_back(Pair("difficulty", (double)GetNetworkDifficulty()));
     obj.push_back(Pair("verificationprogress", progress));
@@ -1480,6 +1801,15 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp, const CPubKey& my
 
         obj.push_back(Pair("pruneheight", block->GetHeight()));
     }
+
+    {
+        LOCK(cs_blockchaininfoCache);
+        blockchaininfoCache.hashTip = tip->GetBlockHash();
+        blockchaininfoCache.nHeaders = nHeaders;
+        blockchaininfoCache.longestchain = longestchain;
+        blockchaininfoCache.fSynced = fSynced;
+        blockchaininfoCache.result = obj;
+    }
     return obj;
 }
 
@@ -1621,6 +1951,20 @@ UniValue mempoolInfoToJSON()
     ret.push_back(Pair("size", (int64_t)mempool.size()));
     ret.push_back(Pair("bytes", (int64_t)mempool.GetTotalTxSize()));
     ret.push_back(Pair("usage", (int64_t)mempool.DynamicMemoryUsage()));
+    size_t maxmempool = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
+    ret.push_back(Pair("maxmempool", (int64_t) maxmempool));
+    ret.push_back(Pair("mempoolminfee", ValueFromAmount(mempool.GetMinFee(maxmempool).GetFeePerK())));
+
+    COrphanPoolInfo orphans = GetOrphanPoolInfo();
+    UniValue objOrphans(UniValue::VOBJ);
+    objOrphans.push_back(Pair("size", (int64_t)orphans.nCount));
+    objOrphans.push_back(Pair("bytes", (int64_t)orphans.nBytes));
+    objOrphans.push_back(Pair("added", (int64_t)orphans.nAdded));
+    objOrphans.push_back(Pair("resolved", (int64_t)orphans.nResolved));
+    objOrphans.push_back(Pair("rejected", (int64_t)orphans.nRejected));
+    objOrphans.push_back(Pair("evicted", (int64_t)orphans.nEvicted));
+    objOrphans.push_back(Pair("removed", (int64_t)orphans.nRemoved));
+    ret.push_back(Pair("orphans", objOrphans));
 
     if (Params().NetworkIDString() == "regtest") {
         ret.push_back(Pair("fullyNotified", mempool.IsFullyNotified()));
@@ -1640,6 +1984,17 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
             "  \"size\": xxxxx                (numeric) Current tx count\n"
             "  \"bytes\": xxxxx               (numeric) Sum of all tx sizes\n"
             "  \"usage\": xxxxx               (numeric) Total memory usage for the mempool\n"
+            "  \"maxmempool\": xxxxx          (numeric) Maximum memory usage for the mempool\n"
+            "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee rate in " + CURRENCY_UNIT + "/kB for a transaction to be accepted\n"
+            "  \"orphans\": {                 Transactions waiting for their parents\n"
+            "    \"size\": xxxxx              (numeric) Current orphan count\n"
+            "    \"bytes\": xxxxx             (numeric) Sum of all orphan sizes\n"
+            "    \"added\": xxxxx             (numeric) Orphans added since startup\n"
+            "    \"resolved\": xxxxx          (numeric) Orphans accepted to the mempool once their parents arrived\n"
+            "    \"rejected\": xxxxx          (numeric) Orphans not accepted once their parents arrived\n"
+            "    \"evicted\": xxxxx           (numeric) Orphans evicted by -maxorphantx\n"
+            "    \"removed\": xxxxx           (numeric) Orphans removed with their peer or by a block\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmempoolinfo", "")
@@ -1649,6 +2004,65 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
     return mempoolInfoToJSON();
 }
 
+UniValue getchainevents(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2)
+        throw runtime_error(
+            "getchainevents since ( count )\n"
+            "\nReturns the block connect and disconnect and mempool add and remove events following the event\n"
+            "numbered since, as published on the ZMQ sequence topic. The node keeps the last -chaineventlogsize events.\n"
+            "\nArguments:\n"
+            "1. since     (numeric, required) The sequence number of the last event seen, 0 for all the events kept\n"
+            "2. count     (numeric, optional, default=1000) The most events to return\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"last\": n,              (numeric) The sequence number of the last event so far\n"
+            "  \"complete\": true|false, (boolean) false if some events following since aren't kept anymore, the mempool must then be resynced\n"
+            "  \"events\": [\n"
+            "    {\n"
+            "      \"sequence\": n,      (numeric) The event sequence number\n"
+            "      \"type\": \"type\",    (string) blockconnected, blockdisconnected, mempooladded or mempoolremoved\n"
+            "      \"hash\": \"hash\",    (string) The block hash or the txid\n"
+            "      \"height\": n         (numeric) The block height, for the block events\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getchainevents", "1234")
+            + HelpExampleRpc("getchainevents", "1234, 100")
+        );
+
+    int64_t nSince = params[0].get_int64();
+    if (nSince < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid since, must be at least 0");
+    int nCount = 1000;
+    if (params.size() > 1) {
+        nCount = params[1].get_int();
+        if (nCount < 1)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid count, must be at least 1");
+    }
+
+    std::vector<CChainEvent> events;
+    uint64_t nLast;
+    bool fComplete = chainEventLog.GetEventsSince(nSince, nCount, events, nLast);
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("last", nLast));
+    result.push_back(Pair("complete", fComplete));
+    UniValue arr(UniValue::VARR);
+    for (const CChainEvent& event : events) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("sequence", event.nSequence));
+        obj.push_back(Pair("type", event.TypeName()));
+        obj.push_back(Pair("hash", event.hash.GetHex()));
+        if (event.IsBlock())
+            obj.push_back(Pair("height", event.nHeight));
+        arr.push_back(obj);
+    }
+    result.push_back(Pair("events", arr));
+    return result;
+}
+
 inline CBlockIndex* LookupBlockIndex(const uint256& hash)
 {
     AssertLockHeld(cs_main);
@@ -1810,21 +2224,26 @@ UniValue reconsiderblock(const UniValue& params, bool fHelp, const CPubKey& mypk
 }
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
+{ //  category              name                      actor (function)         okSafeMode fConcurrentBatch
+  //  --------------------- ------------------------  -----------------------  ---------- ----------
     { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true },
-{ "blockchain",         "getbestblockhash",       &getbestblockhash,       true },
-{ "blockchain",         "getblockcount",          &getblockcount,          true },
-{ "blockchain",         "getblock",               &getblock,               true },
-{ "blockchain",         "getblockhash",           &getblockhash,           true },
-{ "blockchain",         "getblockheader",         &getblockheader,         true },
+{ "blockchain",         "getbestblockhash",       &getbestblockhash,       true, true},
+{ "blockchain",         "getblockcount",          &getblockcount,          true, true},
+{ "blockchain",         "getblock",               &getblock,               true, true},
+{ "blockchain",         "getblockhash",           &getblockhash,           true, true},
+{ "blockchain",         "getblockheader",         &getblockheader,         true, true},
+{ "blockchain",         "getblockfilter",         &getblockfilter,         true },
 { "blockchain",         "getchaintips",           &getchaintips,           true },
 { "blockchain",         "getchaintxstats",        &getchaintxstats,        true },
 { "blockchain",         "getdifficulty",          &getdifficulty,          true },
 { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true },
-{ "blockchain",         "getrawmempool",          &getrawmempool,          true },
-{ "blockchain",         "gettxout",               &gettxout,               true },
+{ "blockchain",         "getchainevents",         &getchainevents,         true },
+{ "blockchain",         "getrawmempool",          &getrawmempool,          true, true},
+{ "blockchain",         "gettxout",               &gettxout,               true, true},
 { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true },
+{ "blockchain",         "getdbinfo",              &getdbinfo,              true },
+{ "blockchain",         "getmemoryinfo",          &getmemoryinfo,          true },
+{ "blockchain",         "dumptxoutset",           &dumptxoutset,           true },
 { "blockchain",         "verifychain",            &verifychain,            true },
 
 /* Not shown in help */
@@ -29,6 +29,7 @@
 #include "../main.h"
 #include "../cc/CCinclude.h"
 #include "../cc/CCfaucet.h"
+#include "../cc/CCstats.h"
 
 
 using namespace std;
@@ -38,8 +39,8 @@ UniValue listccunspents(const UniValue& params, bool fHelp, const CPubKey& mypk)
 	UniValue resarray(UniValue::VARR);
     //bool fUnspentCCIndexTmp = false;
 
-	if (fHelp || (params.size() < 1 || params.size() > 2))
-		throw runtime_error("listccunspents ccadress [creationid]\n");
+	if (fHelp || (params.size() < 1 || params.size() > 3))
+		throw runtime_error("listccunspents ccadress [creationid] [funcids]\n");
 
     //pblocktree->ReadFlag("unspentccindex", fUnspentCCIndexTmp);
 	if (!fUnspentCCIndex)
@@ -49,8 +50,11 @@ UniValue listccunspents(const UniValue& params, bool fHelp, const CPubKey& mypk)
     
     std::string ccaddr = params[0].get_str();
     uint256 creationid;
-    if (params.size() == 2)
+    if (params.size() >= 2)
         creationid = Parseuint256(params[1].get_str().c_str());
+    std::string funcids;
+    if (params.size() == 3)
+        funcids = params[2].get_str();  // e.g. "ct" for outputs of 'c' and 't' txns only
 
     auto addUniElem = [&](const std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> &o, uint256 spenttxid, int32_t spentvin)
     {
@@ -73,7 +77,7 @@ UniValue listccunspents(const UniValue& params, bool fHelp, const CPubKey& mypk)
         resarray.push_back(elem);
     };
 
-    SetCCunspentsCCIndex(unspentOutputs, ccaddr.c_str(), creationid);
+    SetCCunspentsCCIndex(unspentOutputs, ccaddr.c_str(), creationid, funcids);
     LOGSTREAMFN("ccutils", CCLOG_DEBUG1, stream << " non mempool unspentOutputs.size=" << unspentOutputs.size() << std::endl);
     for( auto const &o : unspentOutputs)    {
         uint256 spenttxid;
@@ -82,7 +86,7 @@ UniValue listccunspents(const UniValue& params, bool fHelp, const CPubKey& mypk)
         addUniElem(o, spenttxid, spentvin);
     }
 
-    AddCCunspentsCCIndexMempool(unspentOutputsMem, ccaddr.c_str(), creationid);
+    AddCCunspentsCCIndexMempool(unspentOutputsMem, ccaddr.c_str(), creationid, funcids);
     LOGSTREAMFN("ccutils", CCLOG_DEBUG1, stream << " with mempool unspentOutputs.size=" << unspentOutputs.size() << std::endl);
      
     for( auto const &o : unspentOutputsMem)    {
@@ -321,6 +325,71 @@ UniValue faucetaddccinputs(const UniValue& params, bool fHelp, const CPubKey& re
     return result;
 }
 
+UniValue getccstats(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getccstats ( reset )\n"
+            "\nReturns CC validation statistics by evalcode and funcid, collected when the node runs with -ccstats.\n"
+            "\nArguments:\n"
+            "1. reset      (boolean, optional, default=false) clear the statistics after returning them\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"evalcode\": \"xx\",      (string) evalcode in hex\n"
+            "    \"name\": \"name\",        (string) evalcode name\n"
+            "    \"funcid\": \"c\",         (string) funcid from the tx opreturn, empty if none\n"
+            "    \"count\": n,            (numeric) number of evals\n"
+            "    \"mempool\": n,          (numeric) evals during mempool acceptance\n"
+            "    \"block\": n,            (numeric) evals while connecting blocks\n"
+            "    \"failed\": n,           (numeric) evals that returned invalid\n"
+            "    \"total_ms\": n,         (numeric) total eval time in milliseconds\n"
+            "    \"avg_us\": n,           (numeric) mean eval time in microseconds\n"
+            "    \"p50_us\": n,           (numeric) median eval time upper bound in microseconds\n"
+            "    \"p90_us\": n,           (numeric) 90th percentile eval time upper bound in microseconds\n"
+            "    \"p99_us\": n,           (numeric) 99th percentile eval time upper bound in microseconds\n"
+            "    \"max_us\": n,           (numeric) longest eval time in microseconds\n"
+            "    \"txfetches\": n,        (numeric) transactions fetched by the validators\n"
+            "    \"dblookups\": n         (numeric) address, spent and cc index reads by the validators\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getccstats", "")
+            + HelpExampleCli("getccstats", "true")
+            + HelpExampleRpc("getccstats", "")
+        );
+
+    if (!CCStatsEnabled())
+        throw runtime_error("cc validation statistics not enabled, restart with -ccstats\n");
+
+    std::vector<CCStatsEntry> entries = CCStatsGet();
+    if (params.size() == 1 && params[0].get_bool())
+        CCStatsClear();
+
+    UniValue result(UniValue::VARR);
+    for (const auto &entry : entries)
+    {
+        UniValue elem(UniValue::VOBJ);
+        elem.push_back(Pair("evalcode", HexStr(std::string(1, entry.evalcode))));
+        elem.push_back(Pair("name", EvalToStr(entry.evalcode)));
+        elem.push_back(Pair("funcid", entry.funcid != 0 ? std::string(1, entry.funcid) : std::string()));
+        elem.push_back(Pair("count", (int64_t)entry.Count()));
+        elem.push_back(Pair("mempool", (int64_t)entry.nMempool));
+        elem.push_back(Pair("block", (int64_t)entry.nBlock));
+        elem.push_back(Pair("failed", (int64_t)entry.nFailed));
+        elem.push_back(Pair("total_ms", entry.nTotalMicros / 1000.0));
+        elem.push_back(Pair("avg_us", entry.nTotalMicros / (int64_t)entry.Count()));
+        elem.push_back(Pair("p50_us", entry.Percentile(0.5)));
+        elem.push_back(Pair("p90_us", entry.Percentile(0.9)));
+        elem.push_back(Pair("p99_us", entry.Percentile(0.99)));
+        elem.push_back(Pair("max_us", entry.nMaxMicros));
+        elem.push_back(Pair("txfetches", (int64_t)entry.nTxFetches));
+        elem.push_back(Pair("dblookups", (int64_t)entry.nDBLookups));
+        result.push_back(elem);
+    }
+    return result;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                actor (function)        okSafeMode
   //  -------------- ------------------------  -----------------------  ----------
@@ -328,6 +397,7 @@ static const CRPCCommand commands[] =
 	{ "ccutils",      "listccunspents",    &listccunspents,      true },
 	{ "ccutils",      "getindexkeyforcc",    &getindexkeyforcc,      true },
 	{ "ccutils",      "searchforpubkey",    &searchforpubkey,      true },
+	{ "ccutils",      "getccstats",    &getccstats,      true },
     { "nspv",       "createtxwithnormalinputs",      &createtxwithnormalinputs,         true },
     { "nspv",       "gettransactionsmany",      &gettransactionsmany,         true },
     { "nspv",             "faucetaddccinputs",        &faucetaddccinputs,        true  },
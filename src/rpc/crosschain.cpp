@@ -82,6 +82,34 @@ UniValue assetchainproof(const UniValue& params, bool fHelp, const CPubKey& mypk
 }
 
 
+UniValue assetchainproofs(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if ( fHelp || params.size() != 1 || !params[0].isArray() )
+        throw runtime_error("assetchainproofs [\"txid\",...]\n"
+            "Returns the assetchainproof of each txid, as an array of {\"txid\",\"proof\"} or {\"txid\",\"error\"}.\n"
+            "The burns sharing a notarisation are proven from the one MoM tree.\n");
+
+    const UniValue &txids = params[0].get_array();
+    UniValue ret(UniValue::VARR);
+    ret.reserve(txids.size());
+    for (size_t i = 0; i < txids.size(); i++)
+    {
+        uint256 hash = uint256S(txids[i].get_str());
+        UniValue item(UniValue::VOBJ);
+        item.pushKV("txid", hash.GetHex());
+        try {
+            CTransaction tx;
+            auto proof = GetAssetchainProof(hash,tx);
+            item.pushKV("proof", HexStr(E_MARSHAL(ss << proof)));
+        } catch (const std::runtime_error &e) {
+            item.pushKV("error", e.what());
+        }
+        ret.push_back(std::move(item));
+    }
+    return ret;
+}
+
+
 UniValue crosschainproof(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     UniValue ret(UniValue::VOBJ);
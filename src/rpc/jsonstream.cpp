@@ -0,0 +1,124 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "rpc/jsonstream.h"
+
+#include <assert.h>
+
+CJSONStreamWriter::CJSONStreamWriter(const sink_type& sinkIn, size_t nChunkSizeIn) :
+    sink(sinkIn), nChunkSize(nChunkSizeIn), fAfterKey(false), fFlushed(false)
+{
+    buffer.reserve(nChunkSize + 1024);
+}
+
+void CJSONStreamWriter::Separate()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vEmpty.empty()) {
+        if (!vEmpty.back())
+            buffer += ',';
+        vEmpty.back() = false;
+    }
+}
+
+void CJSONStreamWriter::Append(const std::string& str)
+{
+    buffer += str;
+    if (buffer.size() >= nChunkSize)
+        Flush();
+}
+
+void CJSONStreamWriter::BeginObject()
+{
+    Separate();
+    buffer += '{';
+    vEmpty.push_back(true);
+}
+
+void CJSONStreamWriter::EndObject()
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    vEmpty.pop_back();
+    Append("}");
+}
+
+void CJSONStreamWriter::BeginArray()
+{
+    Separate();
+    buffer += '[';
+    vEmpty.push_back(true);
+}
+
+void CJSONStreamWriter::EndArray()
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    vEmpty.pop_back();
+    Append("]");
+}
+
+void CJSONStreamWriter::Key(const std::string& key)
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    Separate();
+    Append(UniValue(key).write() + ":");
+    fAfterKey = true;
+}
+
+void CJSONStreamWriter::Value(const UniValue& value)
+{
+    if (value.isObject()) {
+        const std::vector<std::string>& keys = value.getKeys();
+        const std::vector<UniValue>& values = value.getValues();
+        BeginObject();
+        for (size_t i = 0; i < keys.size(); i++) {
+            Key(keys[i]);
+            Value(values[i]);
+        }
+        EndObject();
+    } else if (value.isArray()) {
+        const std::vector<UniValue>& values = value.getValues();
+        BeginArray();
+        for (size_t i = 0; i < values.size(); i++)
+            Value(values[i]);
+        EndArray();
+    } else {
+        Separate();
+        Append(value.write());
+    }
+}
+
+void CJSONStreamWriter::Raw(const std::string& str)
+{
+    Append(str);
+}
+
+void CJSONStreamWriter::Flush()
+{
+    if (buffer.empty())
+        return;
+    fFlushed = true;
+    sink(buffer);
+    buffer.clear();
+}
+
+std::string CJSONStreamWriter::Release()
+{
+    std::string str;
+    str.swap(buffer);
+    return str;
+}
@@ -0,0 +1,74 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef KOMODO_RPC_JSONSTREAM_H
+#define KOMODO_RPC_JSONSTREAM_H
+
+#include <univalue.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/** Bytes of JSON text the writer collects before it passes them to its sink */
+static const size_t DEFAULT_JSON_STREAM_CHUNK = 64 * 1024;
+
+/**
+ * Writes compact JSON, the same text as UniValue::write(), and passes it to
+ * a sink in chunks as it is produced. A large result goes out while it is
+ * built and neither its whole text nor, when the caller writes it piece by
+ * piece, its whole UniValue tree is ever held in memory.
+ */
+class CJSONStreamWriter
+{
+public:
+    typedef std::function<void(const std::string&)> sink_type;
+
+private:
+    sink_type sink;
+    size_t nChunkSize;
+    std::string buffer;
+    // per open object or array, whether nothing was written in it yet
+    std::vector<bool> vEmpty;
+    // a key was written, its value follows without a comma
+    bool fAfterKey;
+    bool fFlushed;
+
+    void Separate();
+    void Append(const std::string& str);
+
+public:
+    explicit CJSONStreamWriter(const sink_type& sinkIn, size_t nChunkSizeIn = DEFAULT_JSON_STREAM_CHUNK);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    /** The key of the next value, in an object */
+    void Key(const std::string& key);
+    /** Writes value, an object or array one member at a time */
+    void Value(const UniValue& value);
+    /** Appends text as is, outside of the JSON value */
+    void Raw(const std::string& str);
+
+    /** Passes what is left to the sink */
+    void Flush();
+    /** Whether the sink was called yet */
+    bool Flushed() const { return fFlushed; }
+    /** Takes what is left instead of passing it to the sink */
+    std::string Release();
+};
+
+#endif // KOMODO_RPC_JSONSTREAM_H
@@ -25,6 +25,7 @@
 #include "core_io.h"
 #ifdef ENABLE_MINING
 #include "crypto/equihash.h"
+#include "pow/equihashsolver.h"
 #endif
 #include "init.h"
 #include "main.h"
@@ -460,6 +461,13 @@ UniValue getmininginfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
             "  \"genproclimit\": n          (numeric) The processor limit for generation. -1 if no generation. (see getgenerate or setgenerate calls)\n"
             "  \"localsolps\": xxx.xxxxx    (numeric) The average local solution rate in Sol/s since this node was started\n"
             "  \"networksolps\": x          (numeric) The estimated network solution rate in Sol/s\n"
+            "  \"solvers\": {               (json object) The Equihash solvers, by name\n"
+            "    \"name\": {\n"
+            "      \"runs\": n,               (numeric) The solver runs since this node was started\n"
+            "      \"solutions\": n,          (numeric) The solutions it found\n"
+            "      \"solps\": xxx.xxxxx       (numeric) Its average solution rate in Sol/s while mining\n"
+            "    }, ...\n"
+            "  }\n"
             "  \"pooledtx\": n              (numeric) The size of the mem pool\n"
             "  \"testnet\": true|false      (boolean) If using testnet or not\n"
             "  \"chain\": \"xxxx\",         (string) current network name as defined in BIP70 (main, test, regtest)\n"
@@ -483,6 +491,17 @@ UniValue getmininginfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
     {
         obj.push_back(Pair("localsolps"  , getlocalsolps(params, false, mypk)));
         obj.push_back(Pair("networksolps", getnetworksolps(params, false, mypk)));
+#ifdef ENABLE_MINING
+        UniValue solvers(UniValue::VOBJ);
+        for (CEquihashSolver* solver : GetEquihashSolvers()) {
+            UniValue entry(UniValue::VOBJ);
+            entry.push_back(Pair("runs", (uint64_t)solver->runs.get()));
+            entry.push_back(Pair("solutions", (uint64_t)solver->solutions.get()));
+            entry.push_back(Pair("solps", miningTimer.rate(solver->solutions)));
+            solvers.push_back(Pair(solver->Name(), entry));
+        }
+        obj.push_back(Pair("solvers", solvers));
+#endif
     }
     else
     {
@@ -555,6 +574,75 @@ static UniValue BIP22ValidationResult(const CValidationState& state)
     return "valid?";
 }
 
+/** Seconds a getblocktemplate template is handed out for while only the mempool changes */
+static const int64_t BLOCK_TEMPLATE_REFRESH_INTERVAL = 5;
+
+/**
+ * The template getblocktemplate hands out, with its transactions already
+ * encoded for the response. Pool frontends polling or long-polling together
+ * share it: a new tip or a mempool change after the refresh interval builds
+ * one template for all of them, and each call only updates its time.
+ * Guarded by cs_main, replaced with csBlockTemplateBuild held as well.
+ */
+struct CBlockTemplateCache
+{
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    CBlockIndex* pindexPrev;
+    unsigned int nTransactionsUpdated;
+    int64_t nStart;
+    //! entry of the coinbase without the coinbasetxn fields, and of the other txns in block order
+    UniValue coinbaseEntry;
+    UniValue transactions;
+
+    CBlockTemplateCache() : pindexPrev(NULL), nTransactionsUpdated(0), nStart(0), transactions(UniValue::VARR) {}
+
+    bool NeedsRebuild() const
+    {
+        return pindexPrev != chainActive.LastTip() ||
+            (mempool.GetTransactionsUpdated() != nTransactionsUpdated && GetTime() - nStart > BLOCK_TEMPLATE_REFRESH_INTERVAL);
+    }
+
+    void SetTemplate(CBlockTemplate* pblocktemplateNew, CBlockIndex* pindexPrevNew)
+    {
+        pblocktemplate.reset(pblocktemplateNew);
+        const CBlock& block = pblocktemplate->block;
+        transactions = UniValue(UniValue::VARR);
+        map<uint256, int64_t> setTxIndex;
+        int i = 0;
+        BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+            uint256 txHash = tx.GetHash();
+            setTxIndex[txHash] = i++;
+
+            UniValue entry(UniValue::VOBJ);
+
+            entry.push_back(Pair("data", EncodeHexTx(tx)));
+
+            entry.push_back(Pair("hash", txHash.GetHex()));
+
+            UniValue deps(UniValue::VARR);
+            BOOST_FOREACH (const CTxIn &in, tx.vin)
+            {
+                if (setTxIndex.count(in.prevout.hash))
+                    deps.push_back(setTxIndex[in.prevout.hash]);
+            }
+            entry.push_back(Pair("depends", deps));
+
+            int index_in_template = i - 1;
+            entry.push_back(Pair("fee", pblocktemplate->vTxFees[index_in_template]));
+            entry.push_back(Pair("sigops", pblocktemplate->vTxSigOps[index_in_template]));
+
+            if (index_in_template == 0)
+                coinbaseEntry = entry;
+            else
+                transactions.push_back(entry);
+        }
+        pindexPrev = pindexPrevNew;
+    }
+};
+
+static CBlockTemplateCache gbtCache;
+static boost::mutex csBlockTemplateBuild;
+
 UniValue getblocktemplate(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     if (fHelp || params.size() > 1)
@@ -571,7 +659,8 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp, const CPubKey& myp
             "       \"capabilities\":[       (array, optional) A list of strings\n"
             "           \"support\"           (string) client side supported feature, 'longpoll', 'coinbasetxn', 'coinbasevalue', 'proposal', 'serverlist', 'workid'\n"
             "           ,...\n"
-            "         ]\n"
+            "         ],\n"
+            "       \"longpollid\":\"id\"     (string, optional) The longpollid of the last template, wait until the tip changes, or a minute has passed and the mempool changed\n"
             "     }\n"
             "\n"
 
@@ -599,6 +688,7 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp, const CPubKey& myp
 //            "  },\n"
 //            "  \"coinbasevalue\" : n,               (numeric) maximum allowable input to coinbase transaction, including the generation award and transaction fees (in Satoshis)\n"
             "  \"coinbasetxn\" : { ... },           (json object) information for coinbase transaction\n"
+            "  \"longpollid\" : \"xxxx\",           (string) id to send back to wait for the next template\n"
             "  \"target\" : \"xxxx\",               (string) The hash target\n"
             "  \"mintime\" : xxx,                   (numeric) The minimum timestamp appropriate for next block time in seconds since epoch (Jan 1 1970 GMT)\n"
             "  \"mutable\" : [                      (array of string) list of ways the block template may be changed \n"
@@ -709,8 +799,6 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp, const CPubKey& myp
         throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD, "Komodo is downloading blocks...");
     }
 
-    static unsigned int nTransactionsUpdatedLast;
-
     if (!lpval.isNull())
     {
         // Wait to respond until either the best block changes, OR a minute has passed and there are more transactions
@@ -730,7 +818,7 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp, const CPubKey& myp
         {
             // NOTE: Spec does not specify behaviour for non-string longpollid, but this makes testing easier
             hashWatchedChain = chainActive.LastTip()->GetBlockHash();
-            nTransactionsUpdatedLastLP = nTransactionsUpdatedLast;
+            nTransactionsUpdatedLastLP = gbtCache.nTransactionsUpdated;
         }
 
         // Release the wallet and main lock while waiting
@@ -758,41 +846,43 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp, const CPubKey& myp
     }
 
     // Update block
-    static CBlockIndex* pindexPrev;
-    static int64_t nStart;
-    static CBlockTemplate* pblocktemplate;
-    if (pindexPrev != chainActive.LastTip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
+    if (gbtCache.NeedsRebuild())
     {
-        // Clear pindexPrev so future calls make a new block, despite any failures from here on
-        pindexPrev = NULL;
+        // one caller builds the template while the others wait for it, without cs_main
+        LEAVE_CRITICAL_SECTION(cs_main);
+        boost::unique_lock<boost::mutex> lockBuild(csBlockTemplateBuild);
+        ENTER_CRITICAL_SECTION(cs_main);
+        if (gbtCache.NeedsRebuild())
+        {
+            // Clear pindexPrev so future calls make a new block, despite any failures from here on
+            gbtCache.pindexPrev = NULL;
 
-        // Store the pindexBest used before CreateNewBlockWithKey, to avoid races
-        nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-        CBlockIndex* pindexPrevNew = chainActive.LastTip();
-        nStart = GetTime();
+            // Store the pindexBest used before CreateNewBlockWithKey, to avoid races
+            gbtCache.nTransactionsUpdated = mempool.GetTransactionsUpdated();
+            CBlockIndex* pindexPrevNew = chainActive.LastTip();
+            gbtCache.nStart = GetTime();
 
-        // Create new block
-        if(pblocktemplate)
-        {
-            delete pblocktemplate;
-            pblocktemplate = NULL;
-        }
+            // Create new block
+            CBlockTemplate *pblocktemplateNew;
 #ifdef ENABLE_WALLET
-        CReserveKey reservekey(pwalletMain);
-        LEAVE_CRITICAL_SECTION(cs_main);
-        pblocktemplate = CreateNewBlockWithKey(reservekey,pindexPrevNew->GetHeight()+1,KOMODO_MAXGPUCOUNT,false);
+            CReserveKey reservekey(pwalletMain);
+            LEAVE_CRITICAL_SECTION(cs_main);
+            pblocktemplateNew = CreateNewBlockWithKey(reservekey,pindexPrevNew->GetHeight()+1,KOMODO_MAXGPUCOUNT,false);
 #else
-        pblocktemplate = CreateNewBlockWithKey();
+            pblocktemplateNew = CreateNewBlockWithKey();
 #endif
-        ENTER_CRITICAL_SECTION(cs_main);
-        if (!pblocktemplate)
-            throw std::runtime_error("CreateNewBlock(): create block failed");
-            //throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory or no available utxo for staking");
+            ENTER_CRITICAL_SECTION(cs_main);
+            if (!pblocktemplateNew)
+                throw std::runtime_error("CreateNewBlock(): create block failed");
+                //throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory or no available utxo for staking");
 
-        // Need to update only after we know CreateNewBlockWithKey succeeded
-        pindexPrev = pindexPrevNew;
+            // Need to update only after we know CreateNewBlockWithKey succeeded
+            gbtCache.SetTemplate(pblocktemplateNew, pindexPrevNew);
+        }
     }
+    CBlockTemplate* pblocktemplate = gbtCache.pblocktemplate.get();
+    CBlockIndex* pindexPrev = gbtCache.pindexPrev;
+    unsigned int nTransactionsUpdatedLast = gbtCache.nTransactionsUpdated;
     CBlock* pblock = &pblocktemplate->block; // pointer for convenience
 
     // Update nTime
@@ -801,47 +891,24 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp, const CPubKey& myp
 
     UniValue aCaps(UniValue::VARR); aCaps.push_back("proposal");
 
+    // the transactions were encoded when the template was built
     UniValue txCoinbase = NullUniValue;
     UniValue transactions(UniValue::VARR);
-    map<uint256, int64_t> setTxIndex;
-    int i = 0;
-    BOOST_FOREACH (const CTransaction& tx, pblock->vtx) {
-        uint256 txHash = tx.GetHash();
-        setTxIndex[txHash] = i++;
-
-        //if (tx.IsCoinBase() && !coinbasetxn)
-        //    continue;
-
-        UniValue entry(UniValue::VOBJ);
-
-        entry.push_back(Pair("data", EncodeHexTx(tx)));
-
-        entry.push_back(Pair("hash", txHash.GetHex()));
-
-        UniValue deps(UniValue::VARR);
-        BOOST_FOREACH (const CTxIn &in, tx.vin)
-        {
-            if (setTxIndex.count(in.prevout.hash))
-                deps.push_back(setTxIndex[in.prevout.hash]);
+    if (coinbasetxn == true) {
+        const CTransaction& tx = pblock->vtx[0];
+        txCoinbase = gbtCache.coinbaseEntry;
+        // Show founders' reward if it is required
+        if (ASSETCHAINS_FOUNDERS && tx.vout.size() > 1) {
+            // Correct this if GetBlockTemplate changes the order
+            txCoinbase.push_back(Pair("foundersreward", (int64_t)tx.vout[1].nValue));
         }
-        entry.push_back(Pair("depends", deps));
-
-        int index_in_template = i - 1;
-        entry.push_back(Pair("fee", pblocktemplate->vTxFees[index_in_template]));
-        entry.push_back(Pair("sigops", pblocktemplate->vTxSigOps[index_in_template]));
-
-        if (tx.IsCoinBase() && coinbasetxn == true ) {
-            // Show founders' reward if it is required
-            if (ASSETCHAINS_FOUNDERS && pblock->vtx[0].vout.size() > 1) {
-                // Correct this if GetBlockTemplate changes the order
-                entry.push_back(Pair("foundersreward", (int64_t)tx.vout[1].nValue));
-            }
-            CAmount nReward = GetBlockSubsidy(chainActive.LastTip()->GetHeight()+1, Params().GetConsensus());
-            entry.push_back(Pair("coinbasevalue", nReward));
-            entry.push_back(Pair("required", true));
-            txCoinbase = entry;
-        } else
-            transactions.push_back(entry);
+        CAmount nReward = GetBlockSubsidy(pindexPrev->GetHeight()+1, Params().GetConsensus());
+        txCoinbase.push_back(Pair("coinbasevalue", nReward));
+        txCoinbase.push_back(Pair("required", true));
+        transactions = gbtCache.transactions;
+    } else {
+        transactions.push_back(gbtCache.coinbaseEntry);
+        transactions.push_backV(gbtCache.transactions.getValues());
     }
 
     UniValue aux(UniValue::VOBJ);
@@ -969,7 +1036,8 @@ UniValue submitblock(const UniValue& params, bool fHelp, const CPubKey& mypk)
 
     CValidationState state;
     submitblock_StateCatcher sc(block.GetHash());
-    RegisterValidationInterface(&sc);
+    // synchronous, BlockChecked is read once ProcessNewBlock returns
+    RegisterValidationInterface(&sc, true);
     //printf("submitblock, height=%d, coinbase sequence: %d, scriptSig: %s\n", chainActive.LastTip()->GetHeight()+1, block.vtx[0].vin[0].nSequence, block.vtx[0].vin[0].scriptSig.ToString().c_str());
     bool fAccepted = ProcessNewBlock(1,chainActive.LastTip()->GetHeight()+1,state, NULL, &block, true, NULL);
     UnregisterValidationInterface(&sc);
@@ -1001,6 +1069,9 @@ UniValue estimatefee(const UniValue& params, bool fHelp, const CPubKey& mypk)
             "\nResult:\n"
             "n :    (numeric) estimated fee-per-kilobyte\n"
             "\n"
+            "Without enough confirmed transactions for an estimate, nblocks\n"
+            "up to 6 are estimated from the fee rates in the mempool once a\n"
+            "block has been seen since startup.\n"
             "-1.0 is returned if not enough transactions and\n"
             "blocks have been observed to make an estimate.\n"
             "\nExample:\n"
@@ -19,6 +19,7 @@
  ******************************************************************************/
 
 #include "clientversion.h"
+#include "indexbuilder.h"
 #include "init.h"
 #include "key_io.h"
 #include "main.h"
@@ -169,9 +170,130 @@ UniValue geterablockheights(const UniValue& params, bool fHelp, const CPubKey& m
     return(ret);
 }
 
+/** The parts of getinfo that only change with the tip, cached so polling it doesn't hold cs_main */
+struct GetInfoTipState
+{
+    uint256 hashTip;
+    bool fHaveTip;
+    int64_t nTimeNotarizedTxid;
+    int32_t notarized_height, prevMoMheight, txid_height, kmdnotarized_height;
+    uint256 notarized_hash, notarized_desttxid;
+    int blocks, tiptime;
+    double difficulty;
+    int32_t notaryid;
+    bool fStakedNotary;
+    std::string notaryname;
+    //! the chain parameters, StakedEra changes with the tip
+    UniValue params;
+
+    GetInfoTipState() : fHaveTip(false), nTimeNotarizedTxid(0), notarized_height(0), prevMoMheight(0), txid_height(0), kmdnotarized_height(0),
+                        blocks(-1), tiptime(0), difficulty(0), notaryid(-1), fStakedNotary(false), params(UniValue::VOBJ) {}
+};
+
+/** The KMD confirmations of the last notarization change without a new tip, they are looked up again after this many seconds */
+static const int64_t GETINFO_NOTARIZEDTXID_EXPIRY = 10;
+
+static CCriticalSection cs_getinfoCache;
+static GetInfoTipState getinfoCache;
+
+static UniValue GetInfoChainParams()
+{
+    UniValue params(UniValue::VOBJ);
+    if ( ASSETCHAINS_CC != 0 )
+        params.push_back(Pair("CCid",        (int)ASSETCHAINS_CC));
+    params.push_back(Pair("name",        ASSETCHAINS_SYMBOL[0] == 0 ? "KMD" : ASSETCHAINS_SYMBOL));
+
+    params.push_back(Pair("p2pport",        ASSETCHAINS_P2PPORT));
+    params.push_back(Pair("rpcport",        ASSETCHAINS_RPCPORT));
+    if ( ASSETCHAINS_SYMBOL[0] != 0 )
+    {
+        if ( is_STAKED(ASSETCHAINS_SYMBOL) != 0 )
+            params.push_back(Pair("StakedEra",        STAKED_ERA));
+        //params.push_back(Pair("name",        ASSETCHAINS_SYMBOL));
+        params.push_back(Pair("magic",        (int)ASSETCHAINS_MAGIC));
+        params.push_back(Pair("premine",        ASSETCHAINS_SUPPLY));
+
+        if ( ASSETCHAINS_REWARD[0] != 0 || ASSETCHAINS_LASTERA > 0 )
+        {
+            std::string acReward = "", acHalving = "", acDecay = "", acEndSubsidy = "", acNotaryPay = "";
+            for (int i = 0; i <= ASSETCHAINS_LASTERA; i++)
+            {
+                if (i == 0)
+                {
+                    acReward = std::to_string(ASSETCHAINS_REWARD[i]);
+                    acHalving = std::to_string(ASSETCHAINS_HALVING[i]);
+                    acDecay = std::to_string(ASSETCHAINS_DECAY[i]);
+                    acEndSubsidy = std::to_string(ASSETCHAINS_ENDSUBSIDY[i]);
+                    acNotaryPay = std::to_string(ASSETCHAINS_NOTARY_PAY[i]);
+                }
+                else
+                {
+                    acReward += "," + std::to_string(ASSETCHAINS_REWARD[i]);
+                    acHalving += "," + std::to_string(ASSETCHAINS_HALVING[i]);
+                    acDecay += "," + std::to_string(ASSETCHAINS_DECAY[i]);
+                    acEndSubsidy += "," + std::to_string(ASSETCHAINS_ENDSUBSIDY[i]);
+                    acNotaryPay += "," + std::to_string(ASSETCHAINS_NOTARY_PAY[i]);
+                }
+            }
+            if (ASSETCHAINS_LASTERA > 0)
+                params.push_back(Pair("eras", (int64_t)(ASSETCHAINS_LASTERA + 1)));
+            params.push_back(Pair("reward", acReward));
+            params.push_back(Pair("halving", acHalving));
+            params.push_back(Pair("decay", acDecay));
+            params.push_back(Pair("endsubsidy", acEndSubsidy));
+            params.push_back(Pair("notarypay", acNotaryPay));
+        }
+
+        if ( ASSETCHAINS_COMMISSION != 0 )
+            params.push_back(Pair("commission",        ASSETCHAINS_COMMISSION));
+        if ( ASSETCHAINS_STAKED != 0 )
+            params.push_back(Pair("staked",        ASSETCHAINS_STAKED));
+        if ( ASSETCHAINS_LWMAPOS != 0 )
+            params.push_back(Pair("veruspos", ASSETCHAINS_LWMAPOS));
+        if ( ASSETCHAINS_ALGO != ASSETCHAINS_EQUIHASH )
+            params.push_back(Pair("algo",ASSETCHAINS_ALGORITHMS[ASSETCHAINS_ALGO]));
+    }
+    return params;
+}
+
+static void GetInfoTipCached(GetInfoTipState& state)
+{
+    LOCK(cs_getinfoCache);
+    uint256 hashTip;
+    {
+        LOCK(cs_main);
+        if (chainActive.LastTip() != NULL)
+            hashTip = chainActive.LastTip()->GetBlockHash();
+        if (hashTip != getinfoCache.hashTip || getinfoCache.blocks < 0) {
+            GetInfoTipState tip;
+            tip.hashTip = hashTip;
+            tip.notarized_height = komodo_notarized_height(&tip.prevMoMheight, &tip.notarized_hash, &tip.notarized_desttxid);
+            tip.blocks = chainActive.Height();
+            tip.fHaveTip = chainActive.LastTip() != NULL;
+            if (tip.fHaveTip)
+                tip.tiptime = (int)chainActive.LastTip()->nTime;
+            tip.difficulty = GetDifficulty();
+            if ( NOTARY_PUBKEY33[0] != 0 ) {
+                char pubkeystr[65];
+                if ( (tip.notaryid= StakedNotaryID(tip.notaryname, (char *)NOTARY_ADDRESS.c_str())) != -1 )
+                    tip.fStakedNotary = true;
+                else if ( tip.fHaveTip )
+                    tip.notaryid = komodo_whoami(pubkeystr,(int32_t)chainActive.LastTip()->GetHeight(),komodo_chainactive_timestamp());
+            }
+            tip.params = GetInfoChainParams();
+            getinfoCache = tip;
+        }
+    }
+    if ( KOMODO_NSPV_FULLNODE && (getinfoCache.nTimeNotarizedTxid == 0 || GetTime() - getinfoCache.nTimeNotarizedTxid >= GETINFO_NOTARIZEDTXID_EXPIRY) ) {
+        getinfoCache.txid_height = notarizedtxid_height(ASSETCHAINS_SYMBOL[0] != 0 ? (char *)"KMD" : (char *)"BTC",(char *)getinfoCache.notarized_desttxid.ToString().c_str(),&getinfoCache.kmdnotarized_height);
+        getinfoCache.nTimeNotarizedTxid = GetTime();
+    }
+    state = getinfoCache;
+}
+
 UniValue getinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
-    uint256 notarized_hash,notarized_desttxid; int32_t prevMoMheight,notarized_height,longestchain,kmdnotarized_height,txid_height;
+    int32_t longestchain;
     if (fHelp || params.size() != 0)
         throw runtime_error(
             "getinfo\n"
@@ -199,17 +321,12 @@ UniValue getinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
             + HelpExampleCli("getinfo", "")
             + HelpExampleRpc("getinfo", "")
         );
-    #ifdef ENABLE_WALLET
-        LOCK2(cs_main, pwalletMain ? &pwalletMain->cs_wallet : NULL);
-    #else
-        LOCK(cs_main);
-    #endif
-    
+    GetInfoTipState tip;
+    GetInfoTipCached(tip);
+
     proxyType proxy;
     GetProxy(NET_IPV4, proxy);
-    notarized_height = komodo_notarized_height(&prevMoMheight,&notarized_hash,&notarized_desttxid);
-    //fprintf(stderr,"after notarized_height %u\n",(uint32_t)time(NULL));
-    
+
     UniValue obj(UniValue::VOBJ);
     obj.push_back(Pair("version", CLIENT_VERSION));
     obj.push_back(Pair("protocolversion", PROTOCOL_VERSION));
@@ -217,20 +334,18 @@ UniValue getinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
     obj.push_back(Pair("GRMSVersion", FormatVersion(GRMS_VERSION)));
     obj.push_back(Pair("synced", KOMODO_INSYNC!=0));
     //obj.push_back(Pair("VRSCversion", VERUS_VERSION));
-    obj.push_back(Pair("notarized", notarized_height));
-    obj.push_back(Pair("prevMoMheight", prevMoMheight));
-    obj.push_back(Pair("notarizedhash", notarized_hash.ToString()));
-    obj.push_back(Pair("notarizedtxid", notarized_desttxid.ToString()));
+    obj.push_back(Pair("notarized", tip.notarized_height));
+    obj.push_back(Pair("prevMoMheight", tip.prevMoMheight));
+    obj.push_back(Pair("notarizedhash", tip.notarized_hash.ToString()));
+    obj.push_back(Pair("notarizedtxid", tip.notarized_desttxid.ToString()));
     if ( KOMODO_NSPV_FULLNODE )
     {
-        txid_height = notarizedtxid_height(ASSETCHAINS_SYMBOL[0] != 0 ? (char *)"KMD" : (char *)"BTC",(char *)notarized_desttxid.ToString().c_str(),&kmdnotarized_height);
-        if ( txid_height > 0 )
-            obj.push_back(Pair("notarizedtxid_height", txid_height));
+        if ( tip.txid_height > 0 )
+            obj.push_back(Pair("notarizedtxid_height", tip.txid_height));
         else obj.push_back(Pair("notarizedtxid_height", "mempool"));
         if ( ASSETCHAINS_SYMBOL[0] != 0 )
-            obj.push_back(Pair("KMDnotarized_height", kmdnotarized_height));
-        obj.push_back(Pair("notarized_confirms", txid_height < kmdnotarized_height ? (kmdnotarized_height - txid_height + 1) : 0));
-        //fprintf(stderr,"after notarized_confirms %u\n",(uint32_t)time(NULL));
+            obj.push_back(Pair("KMDnotarized_height", tip.kmdnotarized_height));
+        obj.push_back(Pair("notarized_confirms", tip.txid_height < tip.kmdnotarized_height ? (tip.kmdnotarized_height - tip.txid_height + 1) : 0));
 #ifdef ENABLE_WALLET
         if (pwalletMain) {
             obj.push_back(Pair("walletversion", pwalletMain->GetVersion()));
@@ -245,98 +360,45 @@ UniValue getinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
             }
         }
 #endif
-        //fprintf(stderr,"after wallet %u\n",(uint32_t)time(NULL));
-        obj.push_back(Pair("blocks",        (int)chainActive.Height()));
-        if ( (longestchain= KOMODO_LONGESTCHAIN) != 0 && chainActive.Height() > longestchain )
-            longestchain = chainActive.Height();
-        //fprintf(stderr,"after longestchain %u\n",(uint32_t)time(NULL));
+        obj.push_back(Pair("blocks",        tip.blocks));
+        if ( (longestchain= KOMODO_LONGESTCHAIN) != 0 && tip.blocks > longestchain )
+            longestchain = tip.blocks;
         obj.push_back(Pair("longestchain",        longestchain));
-        if ( chainActive.LastTip() != 0 )
-            obj.push_back(Pair("tiptime", (int)chainActive.LastTip()->nTime));
-        obj.push_back(Pair("difficulty",    (double)GetDifficulty()));
+        if ( tip.fHaveTip )
+            obj.push_back(Pair("tiptime", tip.tiptime));
+        obj.push_back(Pair("difficulty",    tip.difficulty));
 #ifdef ENABLE_WALLET
         if (pwalletMain) {
+            LOCK(pwalletMain->cs_wallet);
             obj.push_back(Pair("keypoololdest", pwalletMain->GetOldestKeyPoolTime()));
             obj.push_back(Pair("keypoolsize",   (int)pwalletMain->GetKeyPoolSize()));
+            if (pwalletMain->IsCrypted())
+                obj.push_back(Pair("unlocked_until", nWalletUnlockTime));
         }
-        if (pwalletMain && pwalletMain->IsCrypted())
-            obj.push_back(Pair("unlocked_until", nWalletUnlockTime));
         obj.push_back(Pair("paytxfee",      ValueFromAmount(payTxFee.GetFeePerK())));
 #endif
         obj.push_back(Pair("sapling", ASSETCHAINS_SAPLING));
     }
     obj.push_back(Pair("timeoffset",    0));
-    obj.push_back(Pair("connections",   (int)vNodes.size()));
+    {
+        LOCK(cs_vNodes);
+        obj.push_back(Pair("connections",   (int)vNodes.size()));
+    }
     obj.push_back(Pair("proxy",         (proxy.IsValid() ? proxy.proxy.ToStringIPPort() : string())));
     obj.push_back(Pair("testnet",       Params().TestnetToBeDeprecatedFieldRPC()));
     obj.push_back(Pair("relayfee",      ValueFromAmount(::minRelayTxFee.GetFeePerK())));
     obj.push_back(Pair("errors",        GetWarnings("statusbar")));
-     if ( NOTARY_PUBKEY33[0] != 0 ) {
-        char pubkeystr[65]; int32_t notaryid; std::string notaryname;
-        if ( (notaryid= StakedNotaryID(notaryname, (char *)NOTARY_ADDRESS.c_str())) != -1 ) {
-            obj.push_back(Pair("notaryid",        notaryid));
-            obj.push_back(Pair("notaryname",      notaryname));
-        } else if( (notaryid= komodo_whoami(pubkeystr,(int32_t)chainActive.LastTip()->GetHeight(),komodo_chainactive_timestamp())) >= 0 )  {
-            obj.push_back(Pair("notaryid",        notaryid));
-            if ( KOMODO_LASTMINED != 0 )
+    if ( NOTARY_PUBKEY33[0] != 0 ) {
+        if ( tip.notaryid >= 0 ) {
+            obj.push_back(Pair("notaryid",        tip.notaryid));
+            if ( tip.fStakedNotary )
+                obj.push_back(Pair("notaryname",      tip.notaryname));
+            else if ( KOMODO_LASTMINED != 0 )
                 obj.push_back(Pair("lastmined", KOMODO_LASTMINED));
         }
         obj.push_back(Pair("pubkey", NOTARY_PUBKEY));
     }
-    if ( ASSETCHAINS_CC != 0 )
-        obj.push_back(Pair("CCid",        (int)ASSETCHAINS_CC));
-    obj.push_back(Pair("name",        ASSETCHAINS_SYMBOL[0] == 0 ? "KMD" : ASSETCHAINS_SYMBOL));
-
-    obj.push_back(Pair("p2pport",        ASSETCHAINS_P2PPORT));
-    obj.push_back(Pair("rpcport",        ASSETCHAINS_RPCPORT));
-    if ( ASSETCHAINS_SYMBOL[0] != 0 )
-    {
-        if ( is_STAKED(ASSETCHAINS_SYMBOL) != 0 )
-            obj.push_back(Pair("StakedEra",        STAKED_ERA));
-        //obj.push_back(Pair("name",        ASSETCHAINS_SYMBOL));
-        obj.push_back(Pair("magic",        (int)ASSETCHAINS_MAGIC));
-        obj.push_back(Pair("premine",        ASSETCHAINS_SUPPLY));
-
-        if ( ASSETCHAINS_REWARD[0] != 0 || ASSETCHAINS_LASTERA > 0 )
-        {
-            std::string acReward = "", acHalving = "", acDecay = "", acEndSubsidy = "", acNotaryPay = "";
-            for (int i = 0; i <= ASSETCHAINS_LASTERA; i++)
-            {
-                if (i == 0)
-                {
-                    acReward = std::to_string(ASSETCHAINS_REWARD[i]);
-                    acHalving = std::to_string(ASSETCHAINS_HALVING[i]);
-                    acDecay = std::to_string(ASSETCHAINS_DECAY[i]);
-                    acEndSubsidy = std::to_string(ASSETCHAINS_ENDSUBSIDY[i]);
-                    acNotaryPay = std::to_string(ASSETCHAINS_NOTARY_PAY[i]);
-                }
-                else
-                {
-                    acReward += "," + std::to_string(ASSETCHAINS_REWARD[i]);
-                    acHalving += "," + std::to_string(ASSETCHAINS_HALVING[i]);
-                    acDecay += "," + std::to_string(ASSETCHAINS_DECAY[i]);
-                    acEndSubsidy += "," + std::to_string(ASSETCHAINS_ENDSUBSIDY[i]);
-                    acNotaryPay += "," + std::to_string(ASSETCHAINS_NOTARY_PAY[i]);
-                }
-            }
-            if (ASSETCHAINS_LASTERA > 0)
-                obj.push_back(Pair("eras", (int64_t)(ASSETCHAINS_LASTERA + 1)));
-            obj.push_back(Pair("reward", acReward));
-            obj.push_back(Pair("halving", acHalving));
-            obj.push_back(Pair("decay", acDecay));
-            obj.push_back(Pair("endsubsidy", acEndSubsidy));
-            obj.push_back(Pair("notarypay", acNotaryPay));
-        }
-
-        if ( ASSETCHAINS_COMMISSION != 0 )
-            obj.push_back(Pair("commission",        ASSETCHAINS_COMMISSION));
-        if ( ASSETCHAINS_STAKED != 0 )
-            obj.push_back(Pair("staked",        ASSETCHAINS_STAKED));
-        if ( ASSETCHAINS_LWMAPOS != 0 )
-            obj.push_back(Pair("veruspos", ASSETCHAINS_LWMAPOS));
-        if ( ASSETCHAINS_ALGO != ASSETCHAINS_EQUIHASH )
-            obj.push_back(Pair("algo",ASSETCHAINS_ALGORITHMS[ASSETCHAINS_ALGO]));
-    }
+    obj.pushKVs(tip.params);
     return obj;
 }
 
@@ -914,6 +976,93 @@ bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint16
     return true;
 }
 
+/** a page of the address index of one address: limit entries after the cursor, before it when reversed */
+struct CAddressIndexPage
+{
+    int limit;
+    bool fReverse;
+    bool fHasCursor;
+    CAddressIndexKey cursor;    //!< last entry of the previous page
+
+    CAddressIndexPage() : limit(0), fReverse(false), fHasCursor(false) {}
+};
+
+// reads the "limit", "reverse" and "cursor" params, returns false if no page is asked for
+static bool getAddressIndexPageFromParams(const UniValue& params, const std::vector<std::pair<uint160, int> > &addresses, CAddressIndexPage &page)
+{
+    if (!params[0].isObject())
+        return false;
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    UniValue reverseValue = find_value(params[0].get_obj(), "reverse");
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (limitValue.isNull() && reverseValue.isNull() && cursorValue.isNull())
+        return false;
+
+    if (addresses.size() != 1)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "limit, reverse and cursor expect a single address");
+    if (!limitValue.isNull()) {
+        page.limit = limitValue.get_int();
+        if (page.limit <= 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "limit is expected to be greater than zero");
+    }
+    if (!reverseValue.isNull())
+        page.fReverse = reverseValue.get_bool();
+    if (!cursorValue.isNull()) {
+        const std::string &strCursor = cursorValue.get_str();
+        if (!IsHex(strCursor) || strCursor.size() != 2 * page.cursor.GetSerializeSize(SER_DISK, CLIENT_VERSION))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        CDataStream ss(ParseHex(strCursor), SER_DISK, CLIENT_VERSION);
+        ss >> page.cursor;
+        if (page.cursor.hashBytes != addresses[0].first || page.cursor.type != (unsigned int)addresses[0].second)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "cursor is not for this address");
+        page.fHasCursor = true;
+    }
+    return true;
+}
+
+// calls func for the entries of the page until it returns false for an entry past the page,
+// returns the cursor of the next page, empty after the last one
+static std::string ForEachAddressIndexPage(const std::pair<uint160, int> &address, int start, int end, const CAddressIndexPage &page,
+                                           const std::function<bool(const CAddressIndexKey&, CAmount)> &func)
+{
+    CAddressIndexKey last;
+    bool fMore = false;
+    auto pagefunc = [&](const CAddressIndexKey &key, CAmount nValue) {
+        if (!func(key, nValue)) {
+            fMore = true;
+            return false;
+        }
+        last = key;
+        return true;
+    };
+    const CAddressIndexKey *pcursor = page.fHasCursor ? &page.cursor : NULL;
+    if (page.fReverse ? !ForEachAddressIndexReverse(address.first, address.second, start, end, pcursor, pagefunc)
+                      : !ForEachAddressIndex(address.first, address.second, start, end, pcursor, pagefunc))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    if (!fMore)
+        return "";
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << last;
+    return HexStr(ss.begin(), ss.end());
+}
+
+static UniValue AddressDeltaToJSON(const CAddressIndexKey &key, CAmount nValue)
+{
+    std::string address;
+    if (!getAddressFromIndex(key.type, key.hashBytes, address)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+    }
+
+    UniValue delta(UniValue::VOBJ);
+    delta.push_back(Pair("satoshis", nValue));
+    delta.push_back(Pair("txid", key.txhash.GetHex()));
+    delta.push_back(Pair("index", (int)key.index));
+    delta.push_back(Pair("blockindex", (int)key.txindex));
+    delta.push_back(Pair("height", key.blockHeight));
+    delta.push_back(Pair("address", address));
+    return delta;
+}
+
 bool heightSort(std::pair<CAddressUnspentKey, CAddressUnspentValue> a,
                 std::pair<CAddressUnspentKey, CAddressUnspentValue> b) {
     return a.second.blockHeight < b.second.blockHeight;
@@ -1099,6 +1248,9 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp, const CPubKey& myp
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
             "  \"chainInfo\" (boolean) Include chain info in results, only applies if start and end specified\n"
+            "  \"limit\" (number, optional) Return at most limit deltas of a single address and a cursor for the next ones\n"
+            "  \"reverse\" (boolean, optional) Return the deltas newest first, with limit or cursor\n"
+            "  \"cursor\" (string, optional) The cursor returned with the previous deltas\n"
             "}\n"
             "\nCCvout (optional) Return CCvouts instead of normal vouts\n"
             "\nResult:\n"
@@ -1111,8 +1263,14 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp, const CPubKey& myp
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult with limit, reverse or cursor:\n"
+            "{\n"
+            "  \"deltas\"  (array) The deltas, as above\n"
+            "  \"cursor\"  (string) Pass it to get the next deltas, absent after the last ones\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"]}' (ccvout)")
+            + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"], \"limit\": 100, \"reverse\": true}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"]} (ccvout)")
         );
 
@@ -1146,6 +1304,23 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp, const CPubKey& myp
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    UniValue deltas(UniValue::VARR);
+    UniValue result(UniValue::VOBJ);
+    CAddressIndexPage page;
+
+    if (getAddressIndexPageFromParams(params, addresses, page)) {
+        std::string cursor = ForEachAddressIndexPage(addresses[0], start, end, page, [&](const CAddressIndexKey &key, CAmount nValue) {
+            if (page.limit > 0 && deltas.size() >= (size_t)page.limit)
+                return false;
+            deltas.push_back(AddressDeltaToJSON(key, nValue));
+            return true;
+        });
+        result.push_back(Pair("deltas", deltas));
+        if (!cursor.empty())
+            result.push_back(Pair("cursor", cursor));
+        return result;
+    }
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
@@ -1160,26 +1335,24 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp, const CPubKey& myp
         }
     }
 
-    UniValue deltas(UniValue::VARR);
+    if (RPCStreamingEnabled() && !(includeChainInfo && start > 0 && end > 0)) {
+        // each delta is written into the reply as it is converted
+        std::shared_ptr<std::vector<std::pair<CAddressIndexKey, CAmount> > > pAddressIndex =
+            std::make_shared<std::vector<std::pair<CAddressIndexKey, CAmount> > >();
+        pAddressIndex->swap(addressIndex);
+        SetRPCStreamResult([pAddressIndex](CJSONStreamWriter& writer) {
+            writer.BeginArray();
+            for (const std::pair<CAddressIndexKey, CAmount>& entry : *pAddressIndex)
+                writer.Value(AddressDeltaToJSON(entry.first, entry.second));
+            writer.EndArray();
+        });
+        return NullUniValue;
+    }
 
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
-        }
-
-        UniValue delta(UniValue::VOBJ);
-        delta.push_back(Pair("satoshis", it->second));
-        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
-        delta.push_back(Pair("index", (int)it->first.index));
-        delta.push_back(Pair("blockindex", (int)it->first.txindex));
-        delta.push_back(Pair("height", it->first.blockHeight));
-        delta.push_back(Pair("address", address));
-        deltas.push_back(delta);
+        deltas.push_back(AddressDeltaToJSON(it->first, it->second));
     }
 
-    UniValue result(UniValue::VOBJ);
-
     if (includeChainInfo && start > 0 && end > 0) {
         LOCK(cs_main);
 
@@ -1440,6 +1613,9 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp, const CPubKey& mypk
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return at most limit txids of a single address and a cursor for the next ones\n"
+            "  \"reverse\" (boolean, optional) Return the txids newest first, with limit or cursor\n"
+            "  \"cursor\" (string, optional) The cursor returned with the previous txids\n"
             "}\n"
             "\nCCvout (optional) Return CCvouts instead of normal vouts\n"
             "\nResult:\n"
@@ -1447,8 +1623,14 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp, const CPubKey& mypk
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult with limit, reverse or cursor:\n"
+            "{\n"
+            "  \"txids\"  (array) The txids, as above\n"
+            "  \"cursor\"  (string) Pass it to get the next txids, absent after the last ones\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"]}' (ccvout)")
+            + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"], \"limit\": 100, \"reverse\": true}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"]} (ccvout)")
         );
 
@@ -1469,6 +1651,27 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp, const CPubKey& mypk
         }
     }
 
+    CAddressIndexPage page;
+    if (getAddressIndexPageFromParams(params, addresses, page)) {
+        // the entries of a tx are adjacent in the index, a page ends with all those of its last tx
+        UniValue txids(UniValue::VARR);
+        uint256 lastTxid;
+        std::string cursor = ForEachAddressIndexPage(addresses[0], start, end, page, [&](const CAddressIndexKey &key, CAmount nValue) {
+            if (txids.size() > 0 && key.txhash == lastTxid)
+                return true;
+            if (page.limit > 0 && txids.size() >= (size_t)page.limit)
+                return false;
+            lastTxid = key.txhash;
+            txids.push_back(key.txhash.GetHex());
+            return true;
+        });
+        UniValue result(UniValue::VOBJ);
+        result.push_back(Pair("txids", txids));
+        if (!cursor.empty())
+            result.push_back(Pair("cursor", cursor));
+        return result;
+    }
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
@@ -1557,6 +1760,45 @@ UniValue getspentinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
     return obj;
 }
 
+UniValue getindexbuilderinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getindexbuilderinfo\n"
+            "\nReturns the progress of the indexes built in the background with -backgroundindex.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"building\": [ \"index\", ... ]  (array) The indexes not yet enabled, empty once they are\n"
+            "  \"height\": n                   (numeric) The height of the last block indexed\n"
+            "  \"tipheight\": n                (numeric) The height of the tip\n"
+            "  \"progress\": x.xxx             (numeric) The fraction of the blocks indexed\n"
+            "  \"blockspersecond\": x.xx       (numeric) The blocks indexed per second since the builder started\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getindexbuilderinfo", "")
+            + HelpExampleRpc("getindexbuilderinfo", "")
+        );
+
+    CIndexBuilderStatus status = GetIndexBuilderStatus();
+    UniValue building(UniValue::VARR);
+    if (status.nIndexes & INDEXBUILDER_ADDRESS)
+        building.push_back("addressindex");
+    if (status.nIndexes & INDEXBUILDER_SPENT)
+        building.push_back("spentindex");
+    if (status.nIndexes & INDEXBUILDER_TIMESTAMP)
+        building.push_back("timestampindex");
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("building", building));
+    obj.push_back(Pair("height", status.nHeight));
+    obj.push_back(Pair("tipheight", status.nTipHeight));
+    obj.push_back(Pair("progress", status.nTipHeight > 0 ? std::max(0, status.nHeight) / (double)status.nTipHeight : 0.0));
+    int64_t nElapsed = GetTime() - status.nStartTime;
+    if (status.nStartTime > 0 && nElapsed > 0 && status.nHeight > status.nStartHeight)
+        obj.push_back(Pair("blockspersecond", (status.nHeight - status.nStartHeight) / (double)nElapsed));
+    return obj;
+}
+
 UniValue txnotarizedconfirmed(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     bool notarizedconfirmed; uint256 txid;
@@ -1583,6 +1825,86 @@ UniValue txnotarizedconfirmed(const UniValue& params, bool fHelp, const CPubKey&
     return result;
 }
 
+UniValue txsnotarizedconfirmed(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2)
+    {
+        string msg = "txsnotarizedconfirmed [\"txid\",...] ( minconfirms )\n"
+            "\nBatch version of txnotarizedconfirmed. All txids are checked against one snapshot of the chain tip and notarized height.\n"
+
+            "\nArguments:\n"
+            "1. txids         (array, required) Transaction ids.\n"
+            "2. minconfirms   (numeric, optional, default=1) Confirmations needed on chains without dPoW, 1 uses the default of " + std::to_string(MIN_NON_NOTARIZED_CONFIRMS) + ".\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"height\": n,              (numeric) Chain tip the txids were checked against.\n"
+            "  \"notarized\": n,           (numeric) Notarized height the txids were checked against.\n"
+            "  \"txids\": [\n"
+            "    {\n"
+            "      \"txid\": \"id\",        (string) Transaction id.\n"
+            "      \"height\": n,          (numeric) Height of the block containing the transaction.\n"
+            "      \"rawconfirmations\": n,(numeric) Confirmations of the transaction.\n"
+            "      \"confirmations\": n,   (numeric) dPoW adjusted confirmations, as reported by getrawtransaction.\n"
+            "      \"result\": true|false  (bool) Same value as txnotarizedconfirmed.\n"
+            "      \"error\": \"msg\"       (string) Set instead of the fields above when the txid is not in a block on the active chain.\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("txsnotarizedconfirmed", "'[\"txid\",...]'")
+            + HelpExampleRpc("txsnotarizedconfirmed", "[\"txid\",...]")
+        ;
+        throw runtime_error(msg);
+    }
+    UniValue txids = params[0].get_array();
+    int32_t minconfirms = params.size() > 1 ? params[1].get_int() : 1;
+    UniValue result(UniValue::VOBJ), items(UniValue::VARR);
+
+    if ( KOMODO_NSPV_SUPERLITE )
+    {
+        for (size_t i = 0; i < txids.size(); i++)
+        {
+            UniValue item(UniValue::VOBJ);
+            item.push_back(Pair("txid", txids[i].get_str()));
+            item.push_back(Pair("result", komodo_txnotarizedconfirmed(uint256S(txids[i].get_str()), minconfirms)));
+            items.push_back(item);
+        }
+        result.push_back(Pair("txids", items));
+        return result;
+    }
+
+    LOCK(cs_main);
+    int32_t tipheight = chainActive.Height();
+    int32_t notarizedheight = komodo_notarizedheight_snapshot();
+    int32_t ntzheight = komodo_dpowconfs_snapshot();
+    for (size_t i = 0; i < txids.size(); i++)
+    {
+        UniValue item(UniValue::VOBJ); CTransaction tx; uint256 hashBlock; CBlockIndex *pindex;
+        uint256 txid = uint256S(txids[i].get_str());
+        item.push_back(Pair("txid", txid.GetHex()));
+        if ( !myGetTransaction(txid, tx, hashBlock) )
+            item.push_back(Pair("error", "cant find txid"));
+        else if ( hashBlock.IsNull() )
+            item.push_back(Pair("error", "txid is not in a block"));
+        else if ( (pindex= komodo_blockindex(hashBlock)) == 0 || pindex->GetHeight() <= 0 || !chainActive.Contains(pindex) )
+            item.push_back(Pair("error", "block of txid is not on the active chain"));
+        else
+        {
+            int32_t txheight = pindex->GetHeight(), confirms = 1 + tipheight - txheight;
+            item.push_back(Pair("height", txheight));
+            item.push_back(Pair("rawconfirmations", confirms));
+            item.push_back(Pair("confirmations", komodo_dpowconfs_at(ntzheight, txheight, confirms)));
+            item.push_back(Pair("result", komodo_notarizedconfirmed(txheight, confirms, notarizedheight, minconfirms)));
+        }
+        items.push_back(item);
+    }
+    result.push_back(Pair("height", tipheight));
+    result.push_back(Pair("notarized", notarizedheight));
+    result.push_back(Pair("txids", items));
+    return result;
+}
+
 UniValue decodeccopret(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     CTransaction tx; uint256 tokenid,txid,hashblock;
@@ -29,6 +29,7 @@
 #include "version.h"
 #include "deprecation.h"
 #include "komodo_version.h"
+#include "komodo_nSPV_defs.h"
 
 #include <boost/foreach.hpp>
 
@@ -94,6 +95,8 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
             "    \"lastrecv\": ttt,           (numeric) The time in seconds since epoch (Jan 1 1970 GMT) of the last receive\n"
             "    \"bytessent\": n,            (numeric) The total bytes sent\n"
             "    \"bytesrecv\": n,            (numeric) The total bytes received\n"
+            "    \"invannounced\": n,         (numeric) The inventory items announced to the peer\n"
+            "    \"invduplicate\": n,         (numeric) The inventory items not announced as the peer already knows them\n"
             "    \"conntime\": ttt,           (numeric) The connection time in seconds since epoch (Jan 1 1970 GMT)\n"
             "  \"timeoffset\": xxxxx,         (numeric) the time offset (deprecated; always 0)\n"
             "    \"pingtime\": n,             (numeric) ping time\n"
@@ -142,6 +145,8 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
         obj.push_back(Pair("lastrecv", stats.nLastRecv));
         obj.push_back(Pair("bytessent", stats.nSendBytes));
         obj.push_back(Pair("bytesrecv", stats.nRecvBytes));
+        obj.push_back(Pair("invannounced", stats.nInvAnnounced));
+        obj.push_back(Pair("invduplicate", stats.nInvDuplicate));
         obj.push_back(Pair("conntime", stats.nTimeConnected));
         obj.push_back(Pair("timeoffset",    0));
         obj.push_back(Pair("pingtime", stats.dPingTime));
@@ -371,6 +376,8 @@ UniValue getnettotals(const UniValue& params, bool fHelp, const CPubKey& mypk)
             "{\n"
             "  \"totalbytesrecv\": n,   (numeric) Total bytes received\n"
             "  \"totalbytessent\": n,   (numeric) Total bytes sent\n"
+            "  \"totalinvannounced\": n, (numeric) Total inventory items announced to peers\n"
+            "  \"totalinvduplicate\": n, (numeric) Total inventory items not announced as the peer already knew them\n"
             "  \"timemillis\": t        (numeric) Total cpu time\n"
             "}\n"
             "\nExamples:\n"
@@ -381,6 +388,8 @@ UniValue getnettotals(const UniValue& params, bool fHelp, const CPubKey& mypk)
     UniValue obj(UniValue::VOBJ);
     obj.push_back(Pair("totalbytesrecv", CNode::GetTotalBytesRecv()));
     obj.push_back(Pair("totalbytessent", CNode::GetTotalBytesSent()));
+    obj.push_back(Pair("totalinvannounced", CNode::GetTotalInvAnnounced()));
+    obj.push_back(Pair("totalinvduplicate", CNode::GetTotalInvDuplicate()));
     obj.push_back(Pair("timemillis", GetTimeMillis()));
     return obj;
 }
@@ -606,6 +615,78 @@ UniValue clearbanned(const UniValue& params, bool fHelp, const CPubKey& mypk)
     return NullUniValue;
 }
 
+UniValue getnspvstats(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getnspvstats ( reset )\n"
+            "\nReturns the nSPV server request counters by request type and the rate limits of the nSPV peers.\n"
+            "\nArguments:\n"
+            "1. reset      (boolean, optional, default=false) clear the request counters after returning them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"peerrate\": n,            (numeric) request cost units a peer may spend per second, 0 if not limited\n"
+            "  \"requests\": [\n"
+            "    {\n"
+            "      \"type\": \"xx\",         (string) request type in hex\n"
+            "      \"cost\": n,            (numeric) cost units of a request of this type\n"
+            "      \"count\": n,           (numeric) requests received\n"
+            "      \"cachehits\": n,       (numeric) requests answered from the response cache\n"
+            "      \"ratelimited\": n,     (numeric) requests dropped by the rate limits\n"
+            "      \"charged\": n          (numeric) cost units charged to the peers\n"
+            "    }, ...\n"
+            "  ],\n"
+            "  \"peers\": [\n"
+            "    {\n"
+            "      \"id\": n,              (numeric) peer index\n"
+            "      \"addr\": \"host:port\", (string) peer address\n"
+            "      \"tokens\": n,          (numeric) cost units left in the peer bucket as of its last request\n"
+            "      \"ratelimited\": n      (numeric) requests of the peer dropped by the cost rate limit\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getnspvstats", "")
+            + HelpExampleCli("getnspvstats", "true")
+            + HelpExampleRpc("getnspvstats", "")
+        );
+
+    std::map<uint8_t, NSPV_requeststats> mapStats;
+    NSPV_getrequeststats(mapStats, params.size() > 0 && params[0].get_bool());
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("peerrate", std::max((int64_t)0, GetArg("-nspvpeerrate", DEFAULT_NSPV_PEER_RATE)));
+    UniValue requests(UniValue::VARR);
+    for (std::map<uint8_t, NSPV_requeststats>::const_iterator it = mapStats.begin(); it != mapStats.end(); ++it) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("type", HexStr(&it->first, &it->first + 1));
+        obj.pushKV("cost", NSPV_requestcost(it->first));
+        obj.pushKV("count", it->second.nRequests);
+        obj.pushKV("cachehits", it->second.nCacheHits);
+        obj.pushKV("ratelimited", it->second.nRateLimited);
+        obj.pushKV("charged", it->second.nCost);
+        requests.push_back(obj);
+    }
+    result.pushKV("requests", requests);
+
+    UniValue peers(UniValue::VARR);
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH(CNode* pnode, vNodes) {
+            if (!pnode->fNspvConnected)
+                continue;
+            UniValue obj(UniValue::VOBJ);
+            obj.pushKV("id", pnode->id);
+            obj.pushKV("addr", pnode->addrName);
+            obj.pushKV("tokens", std::max(0.0, pnode->nNspvTokens));
+            obj.pushKV("ratelimited", pnode->nNspvRateLimited);
+            peers.push_back(obj);
+        }
+    }
+    result.pushKV("peers", peers);
+    return result;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         okSafeMode
   //  --------------------- ------------------------  -----------------------  ----------
@@ -621,6 +702,7 @@ static const CRPCCommand commands[] =
     { "network",            "setban",                 &setban,                 true  },
     { "network",            "listbanned",             &listbanned,             true  },
     { "network",            "clearbanned",            &clearbanned,            true  },
+    { "network",            "getnspvstats",           &getnspvstats,           true  },
 };
 
 void RegisterNetRPCCommands(CRPCTable &tableRPC)
@@ -533,10 +533,11 @@ UniValue getrawtransaction(const UniValue& params, bool fHelp, const CPubKey& my
     int nBlockTime = 0;
 
     {
-        LOCK(cs_main);
+        // not held while the tx is read from disk
         if (!GetTransaction(hash, tx, hashBlock, true))
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available about transaction");
 
+        LOCK(cs_main);
         BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
         if (mi != mapBlockIndex.end() && (*mi).second) {
             CBlockIndex* pindex = (*mi).second;
@@ -1401,12 +1402,12 @@ UniValue sendrawtransaction(const UniValue& params, bool fHelp, const CPubKey& m
 }
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
-    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true  },
+{ //  category              name                      actor (function)         okSafeMode fConcurrentBatch
+  //  --------------------- ------------------------  -----------------------  ---------- ----------
+    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true, true },
     { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true  },
-    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true  },
-    { "rawtransactions",    "decodescript",           &decodescript,           true  },
+    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true, true },
+    { "rawtransactions",    "decodescript",           &decodescript,           true, true },
     { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false },
     { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false }, /* uses wallet if enabled */
 
@@ -21,15 +21,20 @@
 
 #include "rpc/server.h"
 
+#include "httpserver.h"
 #include "init.h"
 #include "key_io.h"
+#include "metrics.h"
 #include "random.h"
 #include "sync.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "validationinterface.h"
 #include "asyncrpcqueue.h"
 
+#include <algorithm>
+#include <limits>
 #include <memory>
 
 #include <univalue.h>
@@ -285,18 +290,123 @@ UniValue stop(const UniValue& params, bool fHelp, const CPubKey& mypk)
     return buf;
 }
 
+UniValue getrpcinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getrpcinfo\n"
+            "\nReturns the state of the queue of the HTTP RPC requests waiting for a worker thread.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"depth\": n,             (numeric) queued requests\n"
+            "  \"prioritydepth\": n,     (numeric) queued light calls, served ahead of the others\n"
+            "  \"clients\": n,           (numeric) clients with queued requests, served in turn\n"
+            "  \"served\": n,            (numeric) requests taken off the queue so far\n"
+            "  \"rejected\": n,          (numeric) requests turned away with a full queue\n"
+            "  \"avgwaitus\": n,         (numeric) average time the served requests waited, in microseconds\n"
+            "  \"maxwaitus\": n          (numeric) longest time a request waited, in microseconds\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getrpcinfo", "")
+            + HelpExampleRpc("getrpcinfo", "")
+        );
+
+    HTTPWorkQueueStats stats;
+    if (!GetHTTPWorkQueueStats(stats))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "HTTP server not started");
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("depth", (uint64_t)stats.nDepth));
+    ret.push_back(Pair("prioritydepth", (uint64_t)stats.nPriorityDepth));
+    ret.push_back(Pair("clients", (uint64_t)stats.nClients));
+    ret.push_back(Pair("served", stats.nServed));
+    ret.push_back(Pair("rejected", stats.nRejected));
+    ret.push_back(Pair("avgwaitus", stats.nServed ? stats.nTotalWaitMicros / (int64_t)stats.nServed : 0));
+    ret.push_back(Pair("maxwaitus", stats.nMaxWaitMicros));
+    return ret;
+}
+
+static UniValue LockProfileBuckets(const uint64_t* buckets)
+{
+    UniValue histogram(UniValue::VARR);
+    for (int i = 0; i < LOCKPROFILE_BUCKETS; i++)
+        histogram.push_back(buckets[i]);
+    return histogram;
+}
+
+UniValue getlockprofile(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getlockprofile ( reset )\n"
+            "\nReturns the locks taken by each lock site, collected when the node runs with -lockprofile, most waited for first.\n"
+            "\nArguments:\n"
+            "1. reset      (boolean, optional, default=false) clear the counters after returning them\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"lock\": \"name\",        (string) the lock, as in LOCK(cs_main)\n"
+            "    \"site\": \"file:line\",   (string) where it is taken\n"
+            "    \"count\": n,            (numeric) times it was taken there\n"
+            "    \"contended\": n,        (numeric) times it had to wait for another thread\n"
+            "    \"wait_us\": n,          (numeric) total wait time in microseconds\n"
+            "    \"hold_us\": n,          (numeric) total hold time in microseconds\n"
+            "    \"max_wait_us\": n,      (numeric) longest wait in microseconds\n"
+            "    \"max_hold_us\": n,      (numeric) longest hold in microseconds\n"
+            "    \"wait_histogram\": [n, ...], (array) the waits by bucket, bucket i counts those below 2^(i+1) microseconds, the last one the longer ones too\n"
+            "    \"hold_histogram\": [n, ...]  (array) the holds, in the same buckets\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getlockprofile", "")
+            + HelpExampleCli("getlockprofile", "true")
+            + HelpExampleRpc("getlockprofile", "")
+        );
+
+    if (!g_lockProfile.load())
+        throw runtime_error("lock profile not enabled, restart with -lockprofile\n");
+
+    std::vector<CLockProfileSite> sites = GetLockProfile();
+    if (params.size() == 1 && params[0].get_bool())
+        ResetLockProfile();
+    std::sort(sites.begin(), sites.end(), [](const CLockProfileSite& a, const CLockProfileSite& b) {
+        return a.nWaitMicros > b.nWaitMicros || (a.nWaitMicros == b.nWaitMicros && a.nHoldMicros > b.nHoldMicros);
+    });
+
+    UniValue ret(UniValue::VARR);
+    for (const CLockProfileSite& site : sites) {
+        if (site.nLocks == 0)
+            continue;
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("lock", site.name));
+        entry.push_back(Pair("site", strprintf("%s:%d", site.file, site.line)));
+        entry.push_back(Pair("count", site.nLocks));
+        entry.push_back(Pair("contended", site.nContended));
+        entry.push_back(Pair("wait_us", site.nWaitMicros));
+        entry.push_back(Pair("hold_us", site.nHoldMicros));
+        entry.push_back(Pair("max_wait_us", site.nMaxWaitMicros));
+        entry.push_back(Pair("max_hold_us", site.nMaxHoldMicros));
+        entry.push_back(Pair("wait_histogram", LockProfileBuckets(site.waitBuckets)));
+        entry.push_back(Pair("hold_histogram", LockProfileBuckets(site.holdBuckets)));
+        ret.push_back(entry);
+    }
+    return ret;
+}
+
 /**
  * Call Table
  */
 static const CRPCCommand vRPCCommands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
+{ //  category              name                      actor (function)         okSafeMode fConcurrentBatch
+  //  --------------------- ------------------------  -----------------------  ---------- ----------
     /* Overall control/query calls */
     { "control",            "help",                   &help,                   true  },
     { "control",            "getiguanajson",          &getiguanajson,          true  },
     { "control",            "getnotarysendmany",      &getnotarysendmany,      true  },
     { "control",            "geterablockheights",     &geterablockheights,     true  },
     { "control",            "stop",                   &stop,                   true  },
+    { "control",            "getrpcinfo",             &getrpcinfo,             true  },
+    { "control",            "getlockprofile",         &getlockprofile,         true  },
 
     /* P2P networking */
     { "network",            "getnetworkinfo",         &getnetworkinfo,         true  },
@@ -311,28 +421,33 @@ static const CRPCCommand vRPCCommands[] =
     { "network",            "setban",                 &setban,                 true  },
     { "network",            "listbanned",             &listbanned,             true  },
     { "network",            "clearbanned",            &clearbanned,            true  },
+    { "network",            "getnspvstats",           &getnspvstats,           true  },
 
     /* Block chain and UTXO */
     { "blockchain",         "coinsupply",             &coinsupply,             true  },
     { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true  },
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true  },
-    { "blockchain",         "getblockcount",          &getblockcount,          true  },
-    { "blockchain",         "getblock",               &getblock,               true  },
-    { "blockchain",         "getblockdeltas",         &getblockdeltas,         false },
-    { "blockchain",         "getblockhashes",         &getblockhashes,         true  },
-    { "blockchain",         "getblockhash",           &getblockhash,           true  },
-    { "blockchain",         "getblockheader",         &getblockheader,         true  },
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  true  },
+    { "blockchain",         "getblockcount",          &getblockcount,          true,  true  },
+    { "blockchain",         "getblock",               &getblock,               true,  true  },
+    { "blockchain",         "getblockdeltas",         &getblockdeltas,         false, true  },
+    { "blockchain",         "getblockhashes",         &getblockhashes,         true,  true  },
+    { "blockchain",         "getblockhash",           &getblockhash,           true,  true  },
+    { "blockchain",         "getblockheader",         &getblockheader,         true,  true  },
     { "blockchain",         "getlastsegidstakes",     &getlastsegidstakes,     true  },
     { "blockchain",         "getchaintips",           &getchaintips,           true  },
     { "blockchain",         "getdifficulty",          &getdifficulty,          true  },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true  },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          true  },
-    { "blockchain",         "gettxout",               &gettxout,               true  },
+    { "blockchain",         "getchainevents",         &getchainevents,         true  },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          true,  true  },
+    { "blockchain",         "gettxout",               &gettxout,               true,  true  },
     { "blockchain",         "gettxoutproof",          &gettxoutproof,          true  },
     { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true  },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
+    { "blockchain",         "getdbinfo",              &getdbinfo,              true  },
+    { "blockchain",         "getmemoryinfo",          &getmemoryinfo,          true  },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           true  },
     { "blockchain",         "verifychain",            &verifychain,            true  },
-    { "blockchain",         "getspentinfo",           &getspentinfo,           false },
+    { "blockchain",         "getspentinfo",           &getspentinfo,           false, true  },
     //{ "blockchain",         "paxprice",               &paxprice,               true  },
     //{ "blockchain",         "paxpending",             &paxpending,             true  },
     //{ "blockchain",         "paxprices",              &paxprices,              true  },
@@ -348,6 +463,7 @@ static const CRPCCommand vRPCCommands[] =
     { "crosschain",         "calc_MoM",               &calc_MoM,               true  },
     { "crosschain",         "height_MoM",             &height_MoM,             true  },
     { "crosschain",         "assetchainproof",        &assetchainproof,        true  },
+    { "crosschain",         "assetchainproofs",       &assetchainproofs,       true  },
     { "crosschain",         "crosschainproof",        &crosschainproof,        true  },
     { "crosschain",         "getNotarisationsForBlock", &getNotarisationsForBlock, true },
     { "crosschain",         "scanNotarisationsDB",    &scanNotarisationsDB,    true },
@@ -396,9 +512,9 @@ static const CRPCCommand vRPCCommands[] =
 
     /* Raw transactions */
     { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true  },
-    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true  },
-    { "rawtransactions",    "decodescript",           &decodescript,           true  },
-    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true  },
+    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true,  true  },
+    { "rawtransactions",    "decodescript",           &decodescript,           true,  true  },
+    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true,  true  },
     { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false },
     { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false }, /* uses wallet if enabled */
 #ifdef ENABLE_WALLET
@@ -423,6 +539,7 @@ static const CRPCCommand vRPCCommands[] =
     { "DEX",   "DEX_list",              &DEX_list, true },
     { "DEX",   "DEX_get",               &DEX_get, true },
     { "DEX",   "DEX_stats",             &DEX_stats, true },
+    { "DEX",   "DEX_perfstats",         &DEX_perfstats, true },
     { "DEX",   "DEX_orderbook",         &DEX_orderbook, true },
     { "DEX",   "DEX_cancel",            &DEX_cancel, true },
     { "DEX",   "DEX_setpubkey",         &DEX_setpubkey, true },
@@ -568,20 +685,22 @@ static const CRPCCommand vRPCCommands[] =
     { "pegs",       "pegsinfo",         &pegsinfo,      true },
     
     /* Address index */
-    { "addressindex",       "getaddressmempool",      &getaddressmempool,      true  },
-    { "addressindex",       "getaddressutxos",        &getaddressutxos,        false },
+    { "addressindex",       "getaddressmempool",      &getaddressmempool,      true,  true  },
+    { "addressindex",       "getaddressutxos",        &getaddressutxos,        false, true  },
     { "addressindex",       "checknotarization",      &checknotarization,      false },
     { "addressindex",       "getnotarypayinfo",       &getnotarypayinfo,       false },
-    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false },
-    { "addressindex",       "getaddresstxids",        &getaddresstxids,        false },
-    { "addressindex",       "getaddressbalance",      &getaddressbalance,      false },
+    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false, true  },
+    { "addressindex",       "getaddresstxids",        &getaddresstxids,        false, true  },
+    { "addressindex",       "getaddressbalance",      &getaddressbalance,      false, true  },
     { "addressindex",       "getsnapshot",            &getsnapshot,            false },
+    { "addressindex",       "getindexbuilderinfo",    &getindexbuilderinfo,    true  },
 
     /* Utility functions */
     { "util",               "createmultisig",         &createmultisig,         true  },
     { "util",               "validateaddress",        &validateaddress,        true  }, /* uses wallet if enabled */
     { "util",               "verifymessage",          &verifymessage,          true  },
     { "util",               "txnotarizedconfirmed",   &txnotarizedconfirmed,   true  },
+    { "util",               "txsnotarizedconfirmed",  &txsnotarizedconfirmed,  true  },
     { "util",               "decodeccopret",   &decodeccopret,   true  },
     { "util",               "estimatefee",            &estimatefee,            true  },
     { "util",               "estimatepriority",       &estimatepriority,       true  },
@@ -635,6 +754,7 @@ static const CRPCCommand vRPCCommands[] =
     { "wallet",             "move",                   &movecmd,                false },
     { "wallet",             "sendfrom",               &sendfrom,               false },
     { "wallet",             "sendmany",               &sendmany,               false },
+    { "wallet",             "sendmanybatch",          &sendmanybatch,          false },
     { "wallet",             "sendtoaddress",          &sendtoaddress,          false },
     { "wallet",             "setaccount",             &setaccount,             true  },
     { "wallet",             "setpubkey",              &setpubkey,              true  },
@@ -708,26 +828,54 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
     return true;
 }
 
+/** Parses a <method>:<n> argument of -rpcasyncpriority and -rpcasynclimit */
+static bool ParseAsyncRPCMethodArg(const std::string& strArg, std::string& method, int64_t& n)
+{
+    size_t pos = strArg.rfind(':');
+    if (pos == std::string::npos || pos == 0)
+        return false;
+    method = strArg.substr(0, pos);
+    return ParseInt64(strArg.substr(pos + 1), &n) && n >= std::numeric_limits<int>::min() && n <= std::numeric_limits<int>::max();
+}
+
 bool StartRPC()
 {
     LogPrint("rpc", "Starting RPC\n");
     fRPCRunning = true;
     g_rpcSignals.Started();
 
-    // Launch one async rpc worker.  The ability to launch multiple workers is not recommended at present and thus the option is disabled.
-    getAsyncRPCQueue()->addWorker();
-/*
-    int n = GetArg("-rpcasyncthreads", 1);
-    if (n<1) {
+    std::shared_ptr<AsyncRPCQueue> q = getAsyncRPCQueue();
+    // The bulk operations give way to the payments queued behind them
+    q->setPriority("z_mergetoaddress", -1);
+    q->setPriority("z_shieldcoinbase", -1);
+    BOOST_FOREACH(const std::string& strArg, mapMultiArgs["-rpcasyncpriority"]) {
+        std::string method;
+        int64_t n;
+        if (!ParseAsyncRPCMethodArg(strArg, method, n)) {
+            LogPrintf("ERROR: Invalid value %s for -rpcasyncpriority, expecting method:priority\n", strArg);
+            return false;
+        }
+        q->setPriority(method, n);
+    }
+    BOOST_FOREACH(const std::string& strArg, mapMultiArgs["-rpcasynclimit"]) {
+        std::string method;
+        int64_t n;
+        if (!ParseAsyncRPCMethodArg(strArg, method, n) || n < 0) {
+            LogPrintf("ERROR: Invalid value %s for -rpcasynclimit, expecting method:limit\n", strArg);
+            return false;
+        }
+        q->setConcurrencyLimit(method, n);
+    }
+
+    // Operations running at once can select the same inputs when those aren't locked,
+    // so one async rpc worker is launched unless more are asked for.
+    int n = GetArg("-rpcasyncthreads", DEFAULT_RPC_ASYNC_THREADS);
+    if (n < 1) {
         LogPrintf("ERROR: Invalid value %d for -rpcasyncthreads.  Must be at least 1.\n", n);
-        strerr = strprintf(_("An error occurred while setting up the Async RPC threads, invalid parameter value of %d (must be at least 1)."), n);
-        uiInterface.ThreadSafeMessageBox(strerr, "", CClientUIInterface::MSG_ERROR);
-        StartShutdown();
-        return;
+        return false;
     }
     for (int i = 0; i < n; i++)
-        getAsyncRPCQueue()->addWorker();
-*/
+        q->addWorker();
     return true;
 }
 
@@ -829,15 +977,104 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
+static bool IsConcurrentBatchRequest(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req.get_obj(), "method");
+    if (!method.isStr())
+        return false;
+    const CRPCCommand *pcmd = tableRPC[method.get_str()];
+    return pcmd && pcmd->fConcurrentBatch;
+}
+
+static void JSONRPCExecBatchRange(const UniValue& vReq, std::vector<UniValue>& vReply, size_t nBegin, size_t nEnd, size_t nStride)
+{
+    for (size_t reqIdx = nBegin; reqIdx < nEnd; reqIdx += nStride)
+        vReply[reqIdx] = JSONRPCExecOne(vReq[reqIdx]);
+}
+
+/** Batch requests a thread runs at least, fewer run on the HTTP worker */
+static const size_t MIN_BATCH_REQUESTS_PER_THREAD = 4;
+
+/**
+ * Runs the requests of a batch in order. A run of requests of fConcurrentBatch
+ * methods, which only read, is spread over several threads; the replies keep
+ * the order of the requests.
+ */
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
+    std::vector<UniValue> vReply(vReq.size());
+    int nMaxThreads = std::max(1, std::min(GetNumCores(), (int)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS)));
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        size_t nEnd = reqIdx;
+        while (nEnd < vReq.size() && IsConcurrentBatchRequest(vReq[nEnd]))
+            nEnd++;
+        int nThreads = std::min((size_t)nMaxThreads, (nEnd - reqIdx) / MIN_BATCH_REQUESTS_PER_THREAD);
+        if (nThreads > 1) {
+            boost::thread_group threads;
+            for (int t = 0; t < nThreads; t++)
+                threads.create_thread(boost::bind(&JSONRPCExecBatchRange, boost::cref(vReq), boost::ref(vReply),
+                                                  reqIdx + t, nEnd, (size_t)nThreads));
+            threads.join_all();
+            reqIdx = nEnd;
+        } else {
+            // a single request, or too few to be worth the threads
+            nEnd = std::max(nEnd, reqIdx + 1);
+            JSONRPCExecBatchRange(vReq, vReply, reqIdx, nEnd, 1);
+            reqIdx = nEnd;
+        }
+    }
+
     UniValue ret(UniValue::VARR);
-    for (size_t reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    for (size_t i = 0; i < vReply.size(); i++)
+        ret.push_back(vReply[i]);
 
     return ret.write() + "\n";
 }
 
+namespace {
+struct CRPCStreamState
+{
+    bool fEnabled;
+    RPCStreamWriterFn writeResult;
+
+    CRPCStreamState() : fEnabled(false) {}
+};
+
+thread_local CRPCStreamState rpcStreamState;
+}
+
+bool RPCStreamingEnabled()
+{
+    return rpcStreamState.fEnabled;
+}
+
+void SetRPCStreamResult(const RPCStreamWriterFn& writeResult)
+{
+    assert(rpcStreamState.fEnabled);
+    rpcStreamState.writeResult = writeResult;
+}
+
+CRPCStreamScope::CRPCStreamScope()
+{
+    assert(!rpcStreamState.fEnabled);
+    rpcStreamState.fEnabled = true;
+    rpcStreamState.writeResult = RPCStreamWriterFn();
+}
+
+CRPCStreamScope::~CRPCStreamScope()
+{
+    rpcStreamState.fEnabled = false;
+    rpcStreamState.writeResult = RPCStreamWriterFn();
+}
+
+const RPCStreamWriterFn& CRPCStreamScope::GetResult() const
+{
+    return rpcStreamState.writeResult;
+}
+
 UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params) const
 {
     // Return immediately if in warmup
@@ -856,9 +1093,14 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
 
     g_rpcSignals.PreCommand(*pcmd);
 
+    // the wallet sees at least the blocks and transactions there were when the call came
+    SyncWithValidationInterfaceQueue();
+
     try
     {
-        // Execute
+        // Execute, timing it into the method's histogram
+        CMetricsScopedTimer timer(GetMetricsHistogram("komodo_rpc_duration_seconds", "Time RPC calls took, by method",
+            "method=\"" + pcmd->name + "\""));
         return pcmd->actor(params, false, CPubKey());
     }
     catch (const std::exception& e)
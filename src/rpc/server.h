@@ -22,9 +22,11 @@
 #define BITCOIN_RPCSERVER_H
 
 #include "amount.h"
+#include "rpc/jsonstream.h"
 #include "rpc/protocol.h"
 #include "uint256.h"
 
+#include <functional>
 #include <list>
 #include <map>
 #include <stdint.h>
@@ -42,6 +44,9 @@
 class AsyncRPCQueue;
 class CRPCCommand;
 
+/** Default number of threads running the async RPC operations */
+static const int DEFAULT_RPC_ASYNC_THREADS = 1;
+
 namespace RPCServer
 {
     void OnStarted(boost::function<void ()> slot);
@@ -145,6 +150,8 @@ public:
     std::string name;
     rpcfn_type actor;
     bool okSafeMode;
+    // Only reads state, so the calls of it in a batch request may run at once
+    bool fConcurrentBatch;
 };
 
 /**
@@ -199,6 +206,33 @@ std::string HelpExampleRpc(const std::string& methodname, const std::string& arg
 
 void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+
+/**
+ * The active chain as of when it was taken, under a short cs_main lock.
+ * Index entries are never freed and the ancestors of an entry don't change,
+ * so a read RPC answers chain questions against it without holding cs_main,
+ * and reports a block against one tip throughout.
+ */
+class CChainTipSnapshot
+{
+private:
+    const CBlockIndex* tip;
+
+public:
+    CChainTipSnapshot();
+
+    const CBlockIndex* Tip() const { return tip; }
+    int Height() const;
+    bool Contains(const CBlockIndex* pindex) const;
+    /** The successor of pindex in this chain, NULL for the tip or a block not in it */
+    const CBlockIndex* Next(const CBlockIndex* pindex) const;
+};
+
+/**
+ * Looks up a block under a short cs_main lock and reads it from disk
+ * without it, throws the RPC errors of a missing or unreadable block.
+ */
+CBlockIndex* ReadBlockForRPC(const uint256& hash, CBlock& block);
 UniValue mempoolInfoToJSON();
 UniValue mempoolToJSON(bool fVerbose = false);
 void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
@@ -212,6 +246,31 @@ void InterruptRPC();
 void StopRPC();
 std::string JSONRPCExecBatch(const UniValue& vReq);
 
+/** Writes the result of an RPC call into the reply */
+typedef std::function<void(CJSONStreamWriter&)> RPCStreamWriterFn;
+
+/**
+ * Whether the running RPC call may stream its result. A handler of a large
+ * result then does all its checks, passes a function writing the result to
+ * SetRPCStreamResult and returns NullUniValue, so the result goes out as it
+ * is written instead of being built as a UniValue tree first. The function
+ * runs after the handler returned and takes the locks it needs itself. If it
+ * throws after a chunk was sent the client gets a truncated reply.
+ */
+bool RPCStreamingEnabled();
+void SetRPCStreamResult(const RPCStreamWriterFn& writeResult);
+
+/** Lets the RPC calls on this thread stream their results while it lives */
+class CRPCStreamScope
+{
+public:
+    CRPCStreamScope();
+    ~CRPCStreamScope();
+
+    /** What the handler passed to SetRPCStreamResult, empty if it returned its result */
+    const RPCStreamWriterFn& GetResult() const;
+};
+
 std::string experimentalDisabledHelpMsg(const std::string& rpc, const std::string& enableArg);
 
 UniValue getconnectioncount(const UniValue& params, bool fHelp, const CPubKey& mypk); // in rpcnet.cpp
@@ -221,6 +280,7 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp, const CPubKey& myp
 UniValue getaddresstxids(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue getsnapshot(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue getaddressbalance(const UniValue& params, bool fHelp, const CPubKey& mypk);
+UniValue getindexbuilderinfo(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue getpeerinfo(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue checknotarization(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue getnotarypayinfo(const UniValue& params, bool fHelp, const CPubKey& mypk);
@@ -232,6 +292,7 @@ UniValue getnettotals(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue setban(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue listbanned(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue clearbanned(const UniValue& params, bool fHelp, const CPubKey& mypk);
+UniValue getnspvstats(const UniValue& params, bool fHelp, const CPubKey& mypk);
 
 UniValue dumpprivkey(const UniValue& params, bool fHelp, const CPubKey& mypk); // in rpcdump.cpp
 UniValue importprivkey(const UniValue& params, bool fHelp, const CPubKey& mypk);
@@ -365,6 +426,7 @@ UniValue getunconfirmedbalance(const UniValue& params, bool fHelp, const CPubKey
 UniValue movecmd(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue sendfrom(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue sendmany(const UniValue& params, bool fHelp, const CPubKey& mypk);
+UniValue sendmanybatch(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue addmultisigaddress(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue createmultisig(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue listreceivedbyaddress(const UniValue& params, bool fHelp, const CPubKey& mypk);
@@ -382,6 +444,7 @@ UniValue walletlock(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue encryptwallet(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue validateaddress(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue txnotarizedconfirmed(const UniValue& params, bool fHelp, const CPubKey& mypk);
+UniValue txsnotarizedconfirmed(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue decodeccopret(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue getinfo(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue getiguanajson(const UniValue& params, bool fHelp, const CPubKey& mypk);
@@ -424,6 +487,7 @@ UniValue getbestblockhash(const UniValue& params, bool fHelp, const CPubKey& myp
 UniValue getdifficulty(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue settxfee(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue getmempoolinfo(const UniValue& params, bool fHelp, const CPubKey& mypk);
+UniValue getchainevents(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue getrawmempool(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue getblockhashes(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue getblockdeltas(const UniValue& params, bool fHelp, const CPubKey& mypk);
@@ -432,6 +496,9 @@ UniValue getblockheader(const UniValue& params, bool fHelp, const CPubKey& mypk)
 UniValue getlastsegidstakes(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue getblock(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp, const CPubKey& mypk);
+UniValue getdbinfo(const UniValue& params, bool fHelp, const CPubKey& mypk);
+UniValue getmemoryinfo(const UniValue& params, bool fHelp, const CPubKey& mypk);
+UniValue dumptxoutset(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue gettxout(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue verifychain(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue getchaintips(const UniValue& params, bool fHelp, const CPubKey& mypk);
@@ -473,6 +540,7 @@ UniValue DEX_anonsend(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue DEX_list(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue DEX_get(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue DEX_stats(const UniValue& params, bool fHelp, const CPubKey& mypk);
+UniValue DEX_perfstats(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue DEX_orderbook(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue DEX_cancel(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue DEX_setpubkey(const UniValue& params, bool fHelp, const CPubKey& mypk);
@@ -510,6 +578,7 @@ UniValue MoMoMdata(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue calc_MoM(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue height_MoM(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue assetchainproof(const UniValue& params, bool fHelp, const CPubKey& mypk);
+UniValue assetchainproofs(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue crosschainproof(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue getNotarisationsForBlock(const UniValue& params, bool fHelp, const CPubKey& mypk);
 UniValue scanNotarisationsDB(const UniValue& params, bool fHelp, const CPubKey& mypk);
@@ -15,6 +15,12 @@
 
 #include "cryptoconditions/include/cryptoconditions.h"
 #include "script/cc.h"
+#include "hash.h"
+#include "random.h"
+#include "util.h"
+
+#include <map>
+#include <boost/thread.hpp>
 
 
 bool IsCryptoConditionsEnabled()
@@ -225,7 +231,7 @@ struct CC* cc_readConditionBinaryMaybeMixed(const uint8_t *condBin, size_t condB
         return NULL;
 
     return CC_MixedModeSubVersion(condBin[0]) >= CC_MIXED_MODE_SUBVER_0 ?
-        cc_readFulfillmentBinaryMixedMode(condBin+1, condBinLength-1) :
+        CCReadFulfillmentCached(condBin+1, condBinLength-1, true) :
         cc_readConditionBinary(condBin, condBinLength);
 }
 
@@ -236,7 +242,7 @@ int cc_verifyMaybeMixed(const struct CC *cond, const uint256 sigHash,
     if (condBinLength == 0) return 0;
     uint8_t condBuf[1000];
     if (CC_MixedModeSubVersion(condBin[0]) >= CC_MIXED_MODE_SUBVER_0) {
-        CC* condMixed = cc_readFulfillmentBinaryMixedMode(condBin+1, condBinLength-1);
+        CC* condMixed = CCReadFulfillmentCached(condBin+1, condBinLength-1, true);
         if (!condMixed) return 0;
         condBinLength = cc_conditionBinary(condMixed, condBuf);
         condBin = condBuf;
@@ -249,3 +255,81 @@ CC_SUBVER CC_MixedModeSubVersion(int c)
 { 
     return (c >= CC_MIXED_MODE_PREFIX && c <= CC_MIXED_MODE_PREFIX + CC_MIXED_MODE_SUBVER_MAX) ? (CC_SUBVER)(c - CC_MIXED_MODE_PREFIX) : CC_OLD_V1_SUBVER; 
 } 
+
+namespace {
+
+class CCCDecodeCache
+{
+private:
+    //! key is (hash of the fulfillment binary, mixed mode), NULL values cache undecodable binaries
+    typedef std::pair<uint256, bool> decodekey_type;
+    std::map<decodekey_type, CC*> mapDecoded;
+    boost::shared_mutex cs_decodecache;
+
+public:
+    bool Get(const decodekey_type &key, CC **ppcond)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_decodecache);
+        std::map<decodekey_type, CC*>::iterator mi = mapDecoded.find(key);
+        if (mi == mapDecoded.end())
+            return false;
+        *ppcond = cc_copy(mi->second);
+        return true;
+    }
+
+    void Set(const decodekey_type &key, const CC *cond)
+    {
+        int64_t nMaxCacheSize = GetArg("-maxccdecodecachesize", DEFAULT_MAX_CC_DECODE_CACHE_SIZE);
+        if (nMaxCacheSize <= 0) return;
+
+        CC *copy = cc_copy(cond);
+        boost::unique_lock<boost::shared_mutex> lock(cs_decodecache);
+        while (static_cast<int64_t>(mapDecoded.size()) >= nMaxCacheSize)
+        {
+            // Evict a random entry, see CSignatureCache
+            std::map<decodekey_type, CC*>::iterator it = mapDecoded.lower_bound(decodekey_type(GetRandHash(), false));
+            if (it == mapDecoded.end())
+                it = mapDecoded.begin();
+            if (it->second != NULL)
+                cc_free(it->second);
+            mapDecoded.erase(it);
+        }
+        std::pair<std::map<decodekey_type, CC*>::iterator, bool> ret = mapDecoded.insert(std::make_pair(key, copy));
+        if (!ret.second && copy != NULL)
+            cc_free(copy);  // set by another thread meanwhile
+    }
+
+    void Clear()
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_decodecache);
+        for (auto &decoded : mapDecoded)
+            if (decoded.second != NULL)
+                cc_free(decoded.second);
+        mapDecoded.clear();
+    }
+
+    ~CCCDecodeCache()
+    {
+        Clear();
+    }
+};
+
+CCCDecodeCache ccDecodeCache;
+
+}
+
+CC* CCReadFulfillmentCached(const uint8_t *ffillBin, size_t ffillBinLength, bool fMixedMode)
+{
+    CC *cond = NULL;
+    std::pair<uint256, bool> key(Hash(ffillBin, ffillBin + ffillBinLength), fMixedMode);
+    if (ccDecodeCache.Get(key, &cond))
+        return cond;
+    cond = fMixedMode ? cc_readFulfillmentBinaryMixedMode(ffillBin, ffillBinLength) : cc_readFulfillmentBinary(ffillBin, ffillBinLength);
+    ccDecodeCache.Set(key, cond);
+    return cond;
+}
+
+void CCDecodeCacheClear()
+{
+    ccDecodeCache.Clear();
+}
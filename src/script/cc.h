@@ -134,4 +134,16 @@ struct CC* cc_readConditionBinaryMaybeMixed(const uint8_t *condBin, size_t condB
 int cc_verifyMaybeMixed(const struct CC *cond, const uint256 sigHash,
         const uint8_t *condBin, size_t condBinLength, VerifyEval verifyEval, void *evalContext);
 
+/** -maxccdecodecachesize default (number of decoded fulfillments kept, 0 = disabled) */
+static const int64_t DEFAULT_MAX_CC_DECODE_CACHE_SIZE = 20000;
+
+/*
+ * Read a fulfillment binary (without the sighash type byte), mixed mode if fMixedMode is set.
+ * Decoded trees are cached by the hash of the binary, so a scriptSig or spk inspected again
+ * (IsCCInput, validation, rpc decoding) is copied from the cache instead of ASN.1 decoded.
+ * The caller owns the returned cond and frees it with cc_free.
+ */
+struct CC* CCReadFulfillmentCached(const uint8_t *ffillBin, size_t ffillBinLength, bool fMixedMode);
+void CCDecodeCacheClear();
+
 #endif /* SCRIPT_CC_H */
@@ -1369,9 +1369,8 @@ int TransactionSignatureChecker::CheckCryptoCondition(
     if (ffillBin.empty())
         return false;
 
-    CC *cond;
-    int error = cc_readFulfillmentBinaryExt((unsigned char*)ffillBin.data(), ffillBin.size()-1, &cond);
-    if (error || !cond) return -1;
+    CC *cond = CCReadFulfillmentCached((unsigned char*)ffillBin.data(), ffillBin.size()-1, false);
+    if (!cond) return -1;
 
     CC_SUBVER ccSubVersion = CC_MixedModeSubVersion(scriptCode[0]); 
 
@@ -451,7 +451,7 @@ bool CScript::SpkHasEvalcodeCCV2(uint8_t evalCode) const
     if (ccdata.empty())
         return (false);
     
-    CC* cond = cc_readFulfillmentBinaryMixedMode((unsigned char*)ccdata.data() + 1, ccdata.size() - 1);
+    CC* cond = CCReadFulfillmentCached((unsigned char*)ccdata.data() + 1, ccdata.size() - 1, true);
     if (cond == nullptr)
         return false;
     
@@ -20,6 +20,7 @@
 
 #include "serverchecker.h"
 #include "script/cc.h"
+#include "script/sigcache.h"
 #include "cc/eval.h"
 
 #include "pubkey.h"
@@ -116,6 +117,17 @@ bool ServerTransactionSignatureChecker::VerifySignature(const std::vector<unsign
  * code without pulling the whole bitcoin server code into bitcoin common was
  * using this class. Thus it has been renamed to ServerTransactionSignatureChecker.
  */
+int ServerTransactionSignatureChecker::CheckCryptoCondition(
+        const std::vector<unsigned char>& condBin,
+        const std::vector<unsigned char>& ffillBin,
+        const CScript& scriptCode,
+        uint32_t consensusBranchId) const
+{
+    // the signatures of a block being connected are not kept, as for VerifySignature
+    CCSignatureCacheStoreScope scope(store);
+    return TransactionSignatureChecker::CheckCryptoCondition(condBin, ffillBin, scriptCode, consensusBranchId);
+}
+
 int ServerTransactionSignatureChecker::CheckEvalCondition(const CC *cond) const
 {
     //fprintf(stderr,"call RunCCeval from ServerTransactionSignatureChecker::CheckEvalCondition\n");
@@ -127,7 +139,7 @@ int ServerTransactionSignatureChecker::CheckCryptoConditionSpk(const std::vector
     CC* condMixed;
     if (CC_MixedModeSubVersion(condBin[0]) >= CC_MIXED_MODE_SUBVER_0)
     {
-        condMixed = cc_readFulfillmentBinaryMixedMode((unsigned char*)condBin.data()+1, condBin.size()-1);
+        condMixed = CCReadFulfillmentCached((unsigned char*)condBin.data()+1, condBin.size()-1, true);
         if (serror) *serror = SCRIPT_ERR_PUBKEYTYPE;
         if (!condMixed) return (false);
     }
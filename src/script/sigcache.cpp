@@ -20,10 +20,12 @@
 
 #include "sigcache.h"
 
+#include "hash.h"
 #include "pubkey.h"
 #include "random.h"
 #include "uint256.h"
 #include "util.h"
+#include "cryptoconditions/include/cryptoconditions.h"
 #ifdef _WIN32
 #undef __cpuid
 #endif
@@ -89,6 +91,61 @@ public:
     }
 };
 
+//! verified secp256k1 signatures of crypto-conditions, checked by cc_verify before secp256k1_ecdsa_verify
+CSignatureCache ccSignatureCache;
+
+//! cleared by CCSignatureCacheStoreScope, e.g. for the checks of a block being connected
+thread_local bool fCCSignatureCacheStore = true;
+
+int CCSignatureCacheGet(const uint8_t *msg32, const uint8_t *publicKey, const uint8_t *signature)
+{
+    return ccSignatureCache.Get(uint256(std::vector<unsigned char>(msg32, msg32 + 32)), std::vector<unsigned char>(signature, signature + 64), CPubKey(publicKey, publicKey + 33));
+}
+
+void CCSignatureCacheSet(const uint8_t *msg32, const uint8_t *publicKey, const uint8_t *signature)
+{
+    if (!fCCSignatureCacheStore)
+        return;
+    ccSignatureCache.Set(uint256(std::vector<unsigned char>(msg32, msg32 + 32)), std::vector<unsigned char>(signature, signature + 64), CPubKey(publicKey, publicKey + 33));
+}
+
+//! verified ed25519 signatures of crypto-conditions, a CPubKey can't hold their
+//! 32 byte keys so the key is hashed into the message
+CSignatureCache ccEd25519SignatureCache;
+
+uint256 CCEd25519SignatureCacheHash(const uint8_t *msg32, const uint8_t *publicKey)
+{
+    return Hash(msg32, msg32 + 32, publicKey, publicKey + 32);
+}
+
+int CCEd25519SignatureCacheGet(const uint8_t *msg32, const uint8_t *publicKey, const uint8_t *signature)
+{
+    return ccEd25519SignatureCache.Get(CCEd25519SignatureCacheHash(msg32, publicKey), std::vector<unsigned char>(signature, signature + 64), CPubKey());
+}
+
+void CCEd25519SignatureCacheSet(const uint8_t *msg32, const uint8_t *publicKey, const uint8_t *signature)
+{
+    if (!fCCSignatureCacheStore)
+        return;
+    ccEd25519SignatureCache.Set(CCEd25519SignatureCacheHash(msg32, publicKey), std::vector<unsigned char>(signature, signature + 64), CPubKey());
+}
+
+}
+
+void InitCCSignatureCache()
+{
+    cc_setSecp256k1VerifyCache(&CCSignatureCacheGet, &CCSignatureCacheSet);
+    cc_setEd25519VerifyCache(&CCEd25519SignatureCacheGet, &CCEd25519SignatureCacheSet);
+}
+
+CCSignatureCacheStoreScope::CCSignatureCacheStoreScope(bool store) : fPrevStore(fCCSignatureCacheStore)
+{
+    fCCSignatureCacheStore = store;
+}
+
+CCSignatureCacheStoreScope::~CCSignatureCacheStoreScope()
+{
+    fCCSignatureCacheStore = fPrevStore;
 }
 
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
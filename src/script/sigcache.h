@@ -27,6 +27,23 @@
 
 class CPubKey;
 
+/** Route the secp256k1 verifications of crypto-conditions through a valid signature cache */
+void InitCCSignatureCache();
+
+/**
+ * While in scope, the crypto-condition signatures verified on this thread are
+ * added to the cache only if store is set. They are always looked up in it.
+ */
+class CCSignatureCacheStoreScope
+{
+private:
+    bool fPrevStore;
+
+public:
+    explicit CCSignatureCacheStoreScope(bool store);
+    ~CCSignatureCacheStoreScope();
+};
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
@@ -0,0 +1,562 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "stratum.h"
+
+#include "arith_uint256.h"
+#include "chainparams.h"
+#include "chainparamsbase.h"
+#include "crypto/common.h"
+#include "init.h"
+#include "komodo_defs.h"
+#include "main.h"
+#include "miner.h"
+#include "netbase.h"
+#include "pow.h"
+#include "streams.h"
+#include "ui_interface.h"
+#include "util.h"
+#include "utilstrencodings.h"
+#ifdef ENABLE_WALLET
+#include "wallet/wallet.h"
+#endif
+
+#include <limits>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <univalue.h>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/signals2/connection.hpp>
+#include <boost/thread.hpp>
+
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+#include <event2/listener.h>
+#include <event2/thread.h>
+
+namespace {
+
+/** A block template sent to the miners with one mining.notify */
+struct CStratumJob
+{
+    std::string strId;
+    int32_t nHeight;
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+#ifdef ENABLE_WALLET
+    std::unique_ptr<CReserveKey> reservekey;  // pays the coinbase, kept when the block is found
+#endif
+    std::set<uint256> setSubmitted;           // the block hashes submitted, to reject duplicates
+};
+
+struct CStratumClient
+{
+    struct bufferevent *bev;
+    CService addr;
+    std::string strNonce1;  // hex of the nonce prefix of this miner, it chooses the rest of the nonce
+    bool fSubscribed;
+    bool fAuthorized;
+
+    CStratumClient() : bev(NULL), fSubscribed(false), fAuthorized(false) {}
+};
+
+// stratum protocol error codes
+enum {
+    STRATUM_ERROR_OTHER = 20,
+    STRATUM_ERROR_JOB_NOT_FOUND = 21,
+    STRATUM_ERROR_DUPLICATE_SHARE = 22,
+    STRATUM_ERROR_LOW_DIFFICULTY = 23,
+    STRATUM_ERROR_UNAUTHORIZED = 24,
+    STRATUM_ERROR_NOT_SUBSCRIBED = 25,
+};
+
+// everything below is only used by the stratum thread, after StopStratum has joined it by the shutdown
+struct event_base *stratumBase = NULL;
+struct event *evNewTip = NULL;
+struct event *evRefresh = NULL;
+std::vector<struct evconnlistener*> vStratumListeners;
+boost::thread stratumThread;
+boost::signals2::connection connNewTip;
+std::vector<CSubNet> stratum_allow_subnets;
+
+std::map<struct bufferevent*, CStratumClient> mapStratumClients;
+std::map<std::string, std::shared_ptr<CStratumJob> > mapStratumJobs;
+std::shared_ptr<CStratumJob> currentStratumJob;
+uint32_t nNextStratumJob = 0;
+uint32_t nNextStratumNonce1 = 0;
+unsigned int nStratumTransactionsUpdated = 0;
+int64_t nStratumJobTime = 0;
+
+std::string HexLE32(uint32_t n)
+{
+    unsigned char buf[4];
+    WriteLE32(buf, n);
+    return HexStr(buf, buf + sizeof(buf));
+}
+
+bool StratumClientAllowed(const CNetAddr& netaddr)
+{
+    if (!netaddr.IsValid())
+        return false;
+    BOOST_FOREACH (const CSubNet& subnet, stratum_allow_subnets)
+        if (subnet.Match(netaddr))
+            return true;
+    return false;
+}
+
+bool InitStratumAllowList()
+{
+    stratum_allow_subnets.clear();
+    stratum_allow_subnets.push_back(CSubNet("127.0.0.0/8")); // always allow IPv4 local subnet
+    stratum_allow_subnets.push_back(CSubNet("::1"));         // always allow IPv6 localhost
+    if (mapMultiArgs.count("-stratumallowip")) {
+        BOOST_FOREACH (const std::string& strAllow, mapMultiArgs["-stratumallowip"]) {
+            CSubNet subnet(strAllow);
+            if (!subnet.IsValid()) {
+                uiInterface.ThreadSafeMessageBox(
+                    strprintf("Invalid -stratumallowip subnet specification: %s. Valid are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24).", strAllow),
+                    "", CClientUIInterface::MSG_ERROR);
+                return false;
+            }
+            stratum_allow_subnets.push_back(subnet);
+        }
+    }
+    return true;
+}
+
+void StratumSend(struct bufferevent *bev, const UniValue& msg)
+{
+    std::string str = msg.write() + "\n";
+    evbuffer_add(bufferevent_get_output(bev), str.data(), str.size());
+}
+
+void StratumReply(struct bufferevent *bev, const UniValue& id, const UniValue& result, const UniValue& error)
+{
+    UniValue reply(UniValue::VOBJ);
+    reply.push_back(Pair("id", id));
+    reply.push_back(Pair("result", result));
+    reply.push_back(Pair("error", error));
+    StratumSend(bev, reply);
+}
+
+void StratumNotify(struct bufferevent *bev, const std::string& strMethod, const UniValue& params)
+{
+    UniValue msg(UniValue::VOBJ);
+    msg.push_back(Pair("id", NullUniValue));
+    msg.push_back(Pair("method", strMethod));
+    msg.push_back(Pair("params", params));
+    StratumSend(bev, msg);
+}
+
+UniValue StratumError(int code, const std::string& strMessage)
+{
+    UniValue error(UniValue::VARR);
+    error.push_back(code);
+    error.push_back(strMessage);
+    error.push_back(NullUniValue);
+    return error;
+}
+
+/** Sends the block target and the job, fClean makes the miner drop the work on earlier jobs */
+void StratumSendJob(const CStratumClient& client, const CStratumJob& job, bool fClean)
+{
+    const CBlock& block = job.pblocktemplate->block;
+    UniValue target(UniValue::VARR);
+    target.push_back(arith_uint256().SetCompact(block.nBits).GetHex());
+    StratumNotify(client.bev, "mining.set_target", target);
+
+    // the header fields as they are serialized, the miner appends the nonce and the solution
+    UniValue params(UniValue::VARR);
+    params.push_back(job.strId);
+    params.push_back(HexLE32(block.nVersion));
+    params.push_back(HexStr(block.hashPrevBlock.begin(), block.hashPrevBlock.end()));
+    params.push_back(HexStr(block.hashMerkleRoot.begin(), block.hashMerkleRoot.end()));
+    params.push_back(HexStr(block.hashFinalSaplingRoot.begin(), block.hashFinalSaplingRoot.end()));
+    params.push_back(HexLE32(block.nTime));
+    params.push_back(HexLE32(block.nBits));
+    params.push_back(UniValue(fClean));
+    StratumNotify(client.bev, "mining.notify", params);
+}
+
+bool StratumHaveMiners()
+{
+    for (const auto& entry : mapStratumClients)
+        if (entry.second.fAuthorized)
+            return true;
+    return false;
+}
+
+/** Builds a job on the tip with CreateNewBlock and sends it to the authorized miners */
+bool StratumNewJob()
+{
+    if (IsInitialBlockDownload())
+        return false;
+    CBlockIndex *pindexPrev;
+    {
+        LOCK(cs_main);
+        pindexPrev = chainActive.LastTip();
+    }
+    if (pindexPrev == NULL)
+        return false;
+
+    std::shared_ptr<CStratumJob> job(new CStratumJob());
+    job->nHeight = pindexPrev->GetHeight() + 1;
+    unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+#ifdef ENABLE_WALLET
+    job->reservekey.reset(new CReserveKey(pwalletMain));
+    job->pblocktemplate.reset(CreateNewBlockWithKey(*job->reservekey, job->nHeight, KOMODO_MAXGPUCOUNT, false));
+#else
+    job->pblocktemplate.reset(CreateNewBlockWithKey());
+#endif
+    if (!job->pblocktemplate)
+        return error("%s: CreateNewBlock failed at height %d", __func__, job->nHeight);
+    CBlock& block = job->pblocktemplate->block;
+    UpdateTime(&block, Params().GetConsensus(), pindexPrev);
+    block.nNonce = uint256();
+    block.nSolution.clear();
+
+    bool fClean = !currentStratumJob || currentStratumJob->pblocktemplate->block.hashPrevBlock != block.hashPrevBlock;
+    if (fClean)
+        mapStratumJobs.clear();
+    job->strId = strprintf("%08x", nNextStratumJob++);
+    mapStratumJobs[job->strId] = job;
+    while (mapStratumJobs.size() > (size_t)MAX_STRATUM_JOBS + 1)
+        mapStratumJobs.erase(mapStratumJobs.begin());
+    currentStratumJob = job;
+    nStratumTransactionsUpdated = nTransactionsUpdated;
+    nStratumJobTime = GetTime();
+
+    LogPrint("stratum", "stratum: job %s at height %d with %u transactions\n", job->strId, job->nHeight, block.vtx.size());
+    for (const auto& entry : mapStratumClients)
+        if (entry.second.fAuthorized)
+            StratumSendJob(entry.second, *job, fClean);
+    return true;
+}
+
+bool StratumSubmit(const CStratumClient& client, const UniValue& params, UniValue& error)
+{
+    if (params.size() < 5 || !params[1].isStr() || !params[2].isStr() || !params[3].isStr() || !params[4].isStr()) {
+        error = StratumError(STRATUM_ERROR_OTHER, "Invalid submit parameters");
+        return false;
+    }
+    std::map<std::string, std::shared_ptr<CStratumJob> >::iterator it = mapStratumJobs.find(params[1].get_str());
+    if (it == mapStratumJobs.end()) {
+        error = StratumError(STRATUM_ERROR_JOB_NOT_FOUND, "Job not found");
+        return false;
+    }
+    CStratumJob& job = *it->second;
+    const std::string& strTime = params[2].get_str();
+    const std::string strNonce = client.strNonce1 + params[3].get_str();
+    const std::string& strSolution = params[4].get_str();
+    if (strTime.size() != 8 || !IsHex(strTime) || strNonce.size() != 2 * uint256().size() || !IsHex(strNonce) || !IsHex(strSolution)) {
+        error = StratumError(STRATUM_ERROR_OTHER, "Malformed submit");
+        return false;
+    }
+
+    CBlock block = job.pblocktemplate->block;
+    std::vector<unsigned char> vTime = ParseHex(strTime);
+    block.nTime = ReadLE32(&vTime[0]);
+    std::vector<unsigned char> vNonce = ParseHex(strNonce);
+    memcpy(block.nNonce.begin(), &vNonce[0], vNonce.size());
+    try {
+        CDataStream ss(ParseHex(strSolution), SER_NETWORK, PROTOCOL_VERSION);
+        ss >> block.nSolution;
+    } catch (const std::exception&) {
+        error = StratumError(STRATUM_ERROR_OTHER, "Malformed solution");
+        return false;
+    }
+
+    if (!job.setSubmitted.insert(block.GetHash()).second) {
+        error = StratumError(STRATUM_ERROR_DUPLICATE_SHARE, "Duplicate share");
+        return false;
+    }
+    if (!CheckEquihashSolution(&block, Params())) {
+        error = StratumError(STRATUM_ERROR_OTHER, "Invalid solution");
+        return false;
+    }
+    if (!CheckProofOfWork(block, NOTARY_PUBKEY33, job.nHeight, Params().GetConsensus())) {
+        error = StratumError(STRATUM_ERROR_LOW_DIFFICULTY, "Low difficulty share");
+        return false;
+    }
+
+    LogPrintf("stratum: block %s at height %d from %s\n", block.GetHash().ToString(), job.nHeight, client.addr.ToString());
+#ifdef ENABLE_WALLET
+    bool fAccepted = ProcessBlockFound(&block, *pwalletMain, *job.reservekey);
+#else
+    bool fAccepted = ProcessBlockFound(&block);
+#endif
+    if (!fAccepted) {
+        error = StratumError(STRATUM_ERROR_OTHER, "Block rejected");
+        return false;
+    }
+    return true;
+}
+
+/** Handles one request line, returns false if the miner is dropped */
+bool StratumHandleLine(CStratumClient& client, const std::string& strLine)
+{
+    UniValue request;
+    if (!request.read(strLine) || !request.isObject()) {
+        LogPrint("stratum", "stratum: malformed request from %s\n", client.addr.ToString());
+        return false;
+    }
+    const UniValue& id = find_value(request, "id");
+    const UniValue& method = find_value(request, "method");
+    const UniValue& params = find_value(request, "params");
+    if (!method.isStr() || !params.isArray()) {
+        StratumReply(client.bev, id, NullUniValue, StratumError(STRATUM_ERROR_OTHER, "Invalid request"));
+        return true;
+    }
+
+    const std::string& strMethod = method.get_str();
+    if (strMethod == "mining.subscribe") {
+        client.fSubscribed = true;
+        UniValue result(UniValue::VARR);
+        result.push_back(NullUniValue);
+        result.push_back(client.strNonce1);
+        StratumReply(client.bev, id, result, NullUniValue);
+    } else if (strMethod == "mining.authorize") {
+        if (!client.fSubscribed) {
+            StratumReply(client.bev, id, NullUniValue, StratumError(STRATUM_ERROR_NOT_SUBSCRIBED, "Not subscribed"));
+            return true;
+        }
+        // the miners are authorized by -stratumallowip, the worker name is only logged
+        client.fAuthorized = true;
+        StratumReply(client.bev, id, true, NullUniValue);
+        LogPrint("stratum", "stratum: miner %s authorized from %s\n", params.size() > 0 && params[0].isStr() ? params[0].get_str() : "", client.addr.ToString());
+        if (currentStratumJob)
+            StratumSendJob(client, *currentStratumJob, true);
+        else
+            StratumNewJob();
+    } else if (strMethod == "mining.submit") {
+        if (!client.fAuthorized) {
+            StratumReply(client.bev, id, NullUniValue, StratumError(STRATUM_ERROR_UNAUTHORIZED, "Unauthorized worker"));
+            return true;
+        }
+        UniValue error;
+        if (StratumSubmit(client, params, error))
+            StratumReply(client.bev, id, true, NullUniValue);
+        else
+            StratumReply(client.bev, id, NullUniValue, error);
+    } else if (strMethod == "mining.extranonce.subscribe") {
+        StratumReply(client.bev, id, false, NullUniValue);
+    } else {
+        StratumReply(client.bev, id, NullUniValue, StratumError(STRATUM_ERROR_OTHER, "Unknown method"));
+    }
+    return true;
+}
+
+void StratumDisconnect(struct bufferevent *bev)
+{
+    std::map<struct bufferevent*, CStratumClient>::iterator it = mapStratumClients.find(bev);
+    if (it != mapStratumClients.end()) {
+        LogPrint("stratum", "stratum: %s disconnected\n", it->second.addr.ToString());
+        mapStratumClients.erase(it);
+    }
+    bufferevent_free(bev);
+}
+
+void StratumReadCb(struct bufferevent *bev, void *ctx)
+{
+    std::map<struct bufferevent*, CStratumClient>::iterator it = mapStratumClients.find(bev);
+    if (it == mapStratumClients.end())
+        return;
+    struct evbuffer *input = bufferevent_get_input(bev);
+    size_t n_read_out = 0;
+    char *line;
+    //  If there is not a whole line to read, evbuffer_readln returns NULL
+    while ((line = evbuffer_readln(input, &n_read_out, EVBUFFER_EOL_CRLF)) != NULL) {
+        std::string strLine(line, n_read_out);
+        free(line);
+        if (strLine.empty())
+            continue;
+        if (!StratumHandleLine(it->second, strLine)) {
+            StratumDisconnect(bev);
+            return;
+        }
+    }
+    if (evbuffer_get_length(input) > MAX_STRATUM_LINE) {
+        LogPrint("stratum", "stratum: request line from %s too long\n", it->second.addr.ToString());
+        StratumDisconnect(bev);
+    }
+}
+
+void StratumEventCb(struct bufferevent *bev, short what, void *ctx)
+{
+    if (what & (BEV_EVENT_EOF | BEV_EVENT_ERROR))
+        StratumDisconnect(bev);
+}
+
+void StratumAcceptCb(struct evconnlistener *listener, evutil_socket_t fd, struct sockaddr *address, int socklen, void *ctx)
+{
+    CService addr;
+    if (!addr.SetSockAddr(address) || !StratumClientAllowed(addr) || mapStratumClients.size() >= (size_t)MAX_STRATUM_CLIENTS) {
+        LogPrint("stratum", "stratum: refused connection from %s\n", addr.ToString());
+        evutil_closesocket(fd);
+        return;
+    }
+    struct bufferevent *bev = bufferevent_socket_new(stratumBase, fd, BEV_OPT_CLOSE_ON_FREE);
+    if (bev == NULL) {
+        evutil_closesocket(fd);
+        return;
+    }
+    CStratumClient& client = mapStratumClients[bev];
+    client.bev = bev;
+    client.addr = addr;
+    client.strNonce1 = HexLE32(nNextStratumNonce1++);
+    bufferevent_setcb(bev, StratumReadCb, NULL, StratumEventCb, NULL);
+    bufferevent_enable(bev, EV_READ | EV_WRITE);
+    LogPrint("stratum", "stratum: %s connected\n", addr.ToString());
+}
+
+void StratumNewTipCb(evutil_socket_t fd, short what, void *arg)
+{
+    if (StratumHaveMiners())
+        StratumNewJob();
+    else
+        currentStratumJob.reset();
+}
+
+void StratumRefreshCb(evutil_socket_t fd, short what, void *arg)
+{
+    if (!StratumHaveMiners())
+        return;
+    // rebuilds a job that failed, and adds the new mempool transactions
+    if (!currentStratumJob || (mempool.GetTransactionsUpdated() != nStratumTransactionsUpdated && GetTime() - nStratumJobTime >= STRATUM_REFRESH_INTERVAL))
+        StratumNewJob();
+}
+
+bool StratumBindAddresses()
+{
+    int defaultPort = GetArg("-stratumport", GetArg("-rpcport", BaseParams().RPCPort()) + 1);
+    std::vector<std::string> vBind;
+
+    if (!mapArgs.count("-stratumallowip")) { // Default to loopback if not allowing external IPs
+        vBind.push_back("::1");
+        vBind.push_back("127.0.0.1");
+        if (mapArgs.count("-stratumbind"))
+            LogPrintf("WARNING: option -stratumbind was ignored because -stratumallowip was not specified, refusing to allow everyone to connect\n");
+    } else if (mapArgs.count("-stratumbind")) {
+        vBind = mapMultiArgs["-stratumbind"];
+    } else {
+        vBind.push_back("::");
+        vBind.push_back("0.0.0.0");
+    }
+
+    BOOST_FOREACH (const std::string& strBind, vBind) {
+        CService addr;
+        struct sockaddr_storage sockaddr;
+        socklen_t len = sizeof(sockaddr);
+        if (!Lookup(strBind.c_str(), addr, defaultPort, false) || !addr.GetSockAddr((struct sockaddr*)&sockaddr, &len)) {
+            LogPrintf("stratum: invalid bind address %s\n", strBind);
+            continue;
+        }
+        struct evconnlistener *listener = evconnlistener_new_bind(stratumBase, StratumAcceptCb, NULL,
+            LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE, -1, (struct sockaddr*)&sockaddr, len);
+        if (listener == NULL) {
+            LogPrintf("stratum: binding on %s failed\n", addr.ToString());
+            continue;
+        }
+        LogPrintf("stratum: listening on %s\n", addr.ToString());
+        vStratumListeners.push_back(listener);
+    }
+    return !vStratumListeners.empty();
+}
+
+void StratumThread()
+{
+    event_base_dispatch(stratumBase);
+}
+
+}
+
+bool StartStratum()
+{
+    assert(!stratumBase);
+    if (ASSETCHAINS_ALGO != ASSETCHAINS_EQUIHASH) {
+        LogPrintf("stratum: only Equihash chains can be mined over stratum\n");
+        return false;
+    }
+#ifdef ENABLE_WALLET
+    if (pwalletMain == NULL) {
+        LogPrintf("stratum: the wallet is needed for the coinbase keys\n");
+        return false;
+    }
+#endif
+    if (!InitStratumAllowList())
+        return false;
+#ifdef WIN32
+    evthread_use_windows_threads();
+#else
+    evthread_use_pthreads();
+#endif
+    stratumBase = event_base_new();
+    if (!stratumBase) {
+        LogPrintf("stratum: Unable to create event_base\n");
+        return false;
+    }
+    if (!StratumBindAddresses()) {
+        LogPrintf("stratum: Unable to bind any endpoint\n");
+        event_base_free(stratumBase);
+        stratumBase = NULL;
+        return false;
+    }
+
+    evNewTip = event_new(stratumBase, -1, 0, StratumNewTipCb, NULL);
+    evRefresh = event_new(stratumBase, -1, EV_PERSIST, StratumRefreshCb, NULL);
+    struct timeval tv = {1, 0};
+    event_add(evRefresh, &tv);
+    nNextStratumNonce1 = (uint32_t)GetRand(std::numeric_limits<uint32_t>::max());
+    connNewTip = uiInterface.NotifyBlockTip.connect([](const uint256& hashNewTip) {
+        event_active(evNewTip, 0, 0);
+    });
+
+    stratumThread = boost::thread(boost::bind(&TraceThread<void (*)()>, "stratum", &StratumThread));
+    return true;
+}
+
+void InterruptStratum()
+{
+    if (stratumBase) {
+        LogPrintf("stratum: Thread interrupt\n");
+        event_base_loopbreak(stratumBase);
+    }
+}
+
+void StopStratum()
+{
+    if (stratumBase) {
+        connNewTip.disconnect();
+        stratumThread.join();
+        while (!mapStratumClients.empty())
+            StratumDisconnect(mapStratumClients.begin()->first);
+        BOOST_FOREACH (struct evconnlistener *listener, vStratumListeners)
+            evconnlistener_free(listener);
+        vStratumListeners.clear();
+        mapStratumJobs.clear();
+        currentStratumJob.reset();
+        event_free(evNewTip);
+        event_free(evRefresh);
+        evNewTip = evRefresh = NULL;
+        event_base_free(stratumBase);
+        stratumBase = NULL;
+    }
+}
@@ -0,0 +1,42 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+/**
+ * Stratum work endpoint for external Equihash miners (the Zcash stratum
+ * protocol of ZIP 301). The node pushes a new job to the subscribed miners
+ * when the tip changes or the mempool changed, and submits the solutions
+ * that meet the block target.
+ */
+#ifndef KOMODO_STRATUM_H
+#define KOMODO_STRATUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const bool DEFAULT_STRATUM = false;
+//! the most miners connected at once
+static const int MAX_STRATUM_CLIENTS = 128;
+//! the jobs kept for late submits after the one being mined
+static const int MAX_STRATUM_JOBS = 8;
+//! seconds between jobs with new mempool transactions
+static const int STRATUM_REFRESH_INTERVAL = 10;
+//! longest request line accepted from a miner
+static const size_t MAX_STRATUM_LINE = 16 * 1024;
+
+bool StartStratum();
+void InterruptStratum();
+void StopStratum();
+
+#endif // KOMODO_STRATUM_H
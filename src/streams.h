@@ -393,6 +393,101 @@ public:
     CDataStream(int nTypeIn, int nVersionIn, Args&&... args) :
             CBaseDataStream(nTypeIn, nVersionIn, args...) { }
 
+    void GetAndClear(CSerializeData &d) {
+        // hand the buffer over rather than copying it when nothing was read from it
+        if (d.empty() && nReadPos == 0 && &d != &vch) {
+            d.swap(vch);
+            clear();
+            return;
+        }
+        CBaseDataStream::GetAndClear(d);
+    }
+};
+
+/** Reads serialized data in place from a buffer owned by the caller, which must outlive the reader.
+ *
+ * Saves copying a whole block or transaction into a CDataStream just to deserialize it.
+ */
+class CSpanReader
+{
+private:
+    const int nType;
+    const int nVersion;
+    const unsigned char* pbegin;
+    const unsigned char* pend;
+
+public:
+    CSpanReader(const unsigned char* pbeginIn, const unsigned char* pendIn, int nTypeIn, int nVersionIn) :
+            nType(nTypeIn), nVersion(nVersionIn), pbegin(pbeginIn), pend(pendIn) { }
+
+    CSpanReader(const std::vector<unsigned char>& vchIn, int nTypeIn, int nVersionIn) :
+            nType(nTypeIn), nVersion(nVersionIn), pbegin(vchIn.data()), pend(vchIn.data() + vchIn.size()) { }
+
+    int GetType() const          { return nType; }
+    int GetVersion() const       { return nVersion; }
+    size_t size() const          { return pend - pbegin; }
+    bool empty() const           { return pbegin == pend; }
+    bool eof() const             { return empty(); }
+
+    void read(char* pch, size_t nSize)
+    {
+        if (nSize == 0) return;
+
+        if (pch == nullptr) {
+            throw std::ios_base::failure("CSpanReader::read(): cannot read from null pointer");
+        }
+        if (nSize > size()) {
+            throw std::ios_base::failure("CSpanReader::read(): end of data");
+        }
+        memcpy(pch, pbegin, nSize);
+        pbegin += nSize;
+    }
+
+    void ignore(size_t nSize)
+    {
+        if (nSize > size()) {
+            throw std::ios_base::failure("CSpanReader::ignore(): end of data");
+        }
+        pbegin += nSize;
+    }
+
+    template<typename T>
+    CSpanReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+};
+
+/** Serializes straight into a byte vector, sized up front by the caller when the size is known */
+class CVectorWriter
+{
+private:
+    const int nType;
+    const int nVersion;
+    std::vector<unsigned char>& vch;
+
+public:
+    CVectorWriter(std::vector<unsigned char>& vchIn, int nTypeIn, int nVersionIn) :
+            nType(nTypeIn), nVersion(nVersionIn), vch(vchIn) { }
+
+    int GetType() const          { return nType; }
+    int GetVersion() const       { return nVersion; }
+    size_t size() const          { return vch.size(); }
+
+    void write(const char* pch, size_t nSize)
+    {
+        vch.insert(vch.end(), (const unsigned char*)pch, (const unsigned char*)pch + nSize);
+    }
+
+    template<typename T>
+    CVectorWriter& operator<<(const T& obj)
+    {
+        // Serialize to this stream
+        ::Serialize(*this, obj);
+        return (*this);
+    }
 };
 
 
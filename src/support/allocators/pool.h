@@ -0,0 +1,204 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef KOMODO_SUPPORT_ALLOCATORS_POOL_H
+#define KOMODO_SUPPORT_ALLOCATORS_POOL_H
+
+#include "memusage.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <algorithm>
+#include <new>
+#include <vector>
+
+/**
+ * Memory resource for the nodes of a node based container. Chunks of up to
+ * MAX_BLOCK_SIZE_BYTES are carved from large blocks taken from the system,
+ * a freed chunk goes to the free list of its size for the next allocation
+ * of that size. The blocks are only given back when the resource is
+ * destroyed, all at once, so a container that is emptied is best destroyed
+ * with its resource. Larger or more aligned allocations, like the bucket
+ * array of a hash map, go to operator new.
+ *
+ * Not thread safe, its containers need a lock of their own anyway.
+ */
+template <size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+class PoolResource
+{
+private:
+    struct ListNode
+    {
+        ListNode *next;
+        explicit ListNode(ListNode *nextIn) : next(nextIn) {}
+    };
+
+    static const size_t ELEM_ALIGN_BYTES = alignof(ListNode) > ALIGN_BYTES ? alignof(ListNode) : ALIGN_BYTES;
+    static_assert((ELEM_ALIGN_BYTES & (ELEM_ALIGN_BYTES - 1)) == 0, "the alignment must be a power of two");
+    static_assert(sizeof(ListNode) <= ELEM_ALIGN_BYTES, "a free chunk must hold a list node");
+    static const size_t NUM_FREE_LISTS = MAX_BLOCK_SIZE_BYTES / ELEM_ALIGN_BYTES + 2;
+
+    const size_t nBlockSizeBytes;
+    std::vector<char*> blocks;
+    //! the free lists by size in ELEM_ALIGN_BYTES units
+    ListNode *freeLists[NUM_FREE_LISTS];
+    //! the part of the last block not handed out yet
+    char *availableBegin;
+    char *availableEnd;
+    //! the MallocUsage of the allocations passed to operator new
+    size_t nOversizeUsage;
+
+    static size_t NumElemAlign(size_t bytes)
+    {
+        return std::max<size_t>(1, (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES);
+    }
+
+    static bool IsFreeListUsable(size_t bytes, size_t alignment)
+    {
+        return alignment <= ELEM_ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    void PushFree(size_t n, void *p)
+    {
+        freeLists[n] = new (p) ListNode(freeLists[n]);
+    }
+
+    void AllocateBlock()
+    {
+        // the rest of the last block is a chunk of its own
+        if (availableBegin != availableEnd)
+            PushFree((availableEnd - availableBegin) / ELEM_ALIGN_BYTES, availableBegin);
+        char *block = static_cast<char*>(::operator new(nBlockSizeBytes));
+        blocks.push_back(block);
+        availableBegin = block;
+        availableEnd = block + nBlockSizeBytes;
+    }
+
+public:
+    explicit PoolResource(size_t nBlockSizeBytesIn = 256 * 1024) :
+        nBlockSizeBytes(NumElemAlign(nBlockSizeBytesIn) * ELEM_ALIGN_BYTES), availableBegin(NULL), availableEnd(NULL), nOversizeUsage(0)
+    {
+        assert(nBlockSizeBytes >= MAX_BLOCK_SIZE_BYTES);
+        std::fill(freeLists, freeLists + NUM_FREE_LISTS, (ListNode*)NULL);
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource()
+    {
+        for (char *block : blocks)
+            ::operator delete(block);
+    }
+
+    void* Allocate(size_t bytes, size_t alignment)
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            nOversizeUsage += memusage::MallocUsage(bytes);
+            return ::operator new(bytes);
+        }
+        size_t n = NumElemAlign(bytes);
+        if (freeLists[n] != NULL) {
+            ListNode *node = freeLists[n];
+            freeLists[n] = node->next;
+            return node;
+        }
+        size_t nBytes = n * ELEM_ALIGN_BYTES;
+        if ((size_t)(availableEnd - availableBegin) < nBytes)
+            AllocateBlock();
+        void *p = availableBegin;
+        availableBegin += nBytes;
+        return p;
+    }
+
+    void Deallocate(void *p, size_t bytes, size_t alignment)
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            nOversizeUsage -= memusage::MallocUsage(bytes);
+            ::operator delete(p);
+            return;
+        }
+        PushFree(NumElemAlign(bytes), p);
+    }
+
+    size_t NumBlocks() const { return blocks.size(); }
+
+    /** The memory taken from the system, including the chunks on the free lists */
+    size_t DynamicMemoryUsage() const
+    {
+        return blocks.size() * memusage::MallocUsage(nBlockSizeBytes) + nOversizeUsage +
+            memusage::MallocUsage(blocks.capacity() * sizeof(char*));
+    }
+};
+
+/**
+ * Allocator of a container whose nodes come from a PoolResource. A default
+ * constructed one has no resource and allocates with operator new, for the
+ * containers that aren't worth a pool of their own.
+ */
+template <typename T, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES = alignof(T)>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> resource_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+private:
+    resource_type *resource;
+
+public:
+    PoolAllocator() noexcept : resource(NULL) {}
+    explicit PoolAllocator(resource_type *resourceIn) noexcept : resource(resourceIn) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> &other) noexcept : resource(other.Resource()) {}
+
+    T* allocate(size_t n)
+    {
+        if (resource == NULL)
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, size_t n) noexcept
+    {
+        if (resource == NULL)
+            ::operator delete(p);
+        else
+            resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    resource_type* Resource() const noexcept { return resource; }
+};
+
+template <typename T, typename U, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+bool operator==(const PoolAllocator<T, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> &a, const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> &b) noexcept
+{
+    return a.Resource() == b.Resource();
+}
+
+template <typename T, typename U, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+bool operator!=(const PoolAllocator<T, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> &a, const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> &b) noexcept
+{
+    return !(a == b);
+}
+
+#endif // KOMODO_SUPPORT_ALLOCATORS_POOL_H
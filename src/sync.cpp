@@ -24,9 +24,170 @@
 
 #include <stdio.h>
 
+#include <map>
+
 #include <boost/foreach.hpp>
 #include <boost/thread.hpp>
 
+std::atomic<LockWaitHook> g_lockWaitHook(NULL);
+std::atomic<bool> g_lockProfile(false);
+
+//
+// Lock profile, the counters of each LOCK site are kept in a slot of a fixed
+// table found by the address of the file name and the line. Sites are only
+// added, under cs_lockProfile, so the slots in use are read without a lock.
+//
+
+static const int LOCKPROFILE_SLOTS = 4096;
+
+namespace {
+
+struct CLockProfileSlot
+{
+    std::atomic<bool> fUsed;
+    const char* pszName;
+    const char* pszFile;
+    int nLine;
+    std::atomic<uint64_t> nLocks;
+    std::atomic<uint64_t> nContended;
+    std::atomic<int64_t> nWaitMicros;
+    std::atomic<int64_t> nHoldMicros;
+    std::atomic<int64_t> nMaxWaitMicros;
+    std::atomic<int64_t> nMaxHoldMicros;
+    std::atomic<uint64_t> waitBuckets[LOCKPROFILE_BUCKETS];
+    std::atomic<uint64_t> holdBuckets[LOCKPROFILE_BUCKETS];
+};
+
+CLockProfileSlot lockProfileSlots[LOCKPROFILE_SLOTS];
+boost::mutex cs_lockProfile;
+
+//! The slot of the site, or the free slot it goes to, -1 when the table is full
+int FindLockProfileSlot(const char* pszFile, int nLine)
+{
+    size_t nHash = (reinterpret_cast<uintptr_t>(pszFile) >> 3) * 0x9E3779B1u + nLine;
+    for (int i = 0; i < LOCKPROFILE_SLOTS; i++) {
+        int nSlot = (nHash + i) % LOCKPROFILE_SLOTS;
+        const CLockProfileSlot& slot = lockProfileSlots[nSlot];
+        if (!slot.fUsed.load(std::memory_order_acquire))
+            return nSlot;
+        if (slot.pszFile == pszFile && slot.nLine == nLine)
+            return nSlot;
+    }
+    return -1;
+}
+
+int LockProfileBucket(int64_t nMicros)
+{
+    int nBucket = 0;
+    while (nMicros > 1 && nBucket < LOCKPROFILE_BUCKETS - 1) {
+        nMicros >>= 1;
+        nBucket++;
+    }
+    return nBucket;
+}
+
+void LockProfileMax(std::atomic<int64_t>& nMax, int64_t nMicros)
+{
+    int64_t nOld = nMax.load(std::memory_order_relaxed);
+    while (nMicros > nOld && !nMax.compare_exchange_weak(nOld, nMicros, std::memory_order_relaxed))
+        ;
+}
+
+}
+
+int LockProfileSite(const char* pszName, const char* pszFile, int nLine)
+{
+    int nSlot = FindLockProfileSlot(pszFile, nLine);
+    if (nSlot < 0 || lockProfileSlots[nSlot].fUsed.load(std::memory_order_acquire))
+        return nSlot;
+
+    // a new site, looked up again as another thread may have added it meanwhile
+    boost::unique_lock<boost::mutex> lock(cs_lockProfile);
+    nSlot = FindLockProfileSlot(pszFile, nLine);
+    if (nSlot < 0)
+        return -1;
+    CLockProfileSlot& slot = lockProfileSlots[nSlot];
+    if (!slot.fUsed.load(std::memory_order_relaxed)) {
+        slot.pszName = pszName;
+        slot.pszFile = pszFile;
+        slot.nLine = nLine;
+        slot.fUsed.store(true, std::memory_order_release);
+    }
+    return nSlot;
+}
+
+void LockProfileAcquired(int nSite, bool fContended, int64_t nWaitMicros)
+{
+    CLockProfileSlot& slot = lockProfileSlots[nSite];
+    slot.nLocks.fetch_add(1, std::memory_order_relaxed);
+    if (fContended) {
+        slot.nContended.fetch_add(1, std::memory_order_relaxed);
+        slot.nWaitMicros.fetch_add(nWaitMicros, std::memory_order_relaxed);
+        LockProfileMax(slot.nMaxWaitMicros, nWaitMicros);
+    }
+    slot.waitBuckets[LockProfileBucket(nWaitMicros)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LockProfileReleased(int nSite, int64_t nHoldMicros)
+{
+    CLockProfileSlot& slot = lockProfileSlots[nSite];
+    slot.nHoldMicros.fetch_add(nHoldMicros, std::memory_order_relaxed);
+    LockProfileMax(slot.nMaxHoldMicros, nHoldMicros);
+    slot.holdBuckets[LockProfileBucket(nHoldMicros)].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<CLockProfileSite> GetLockProfile()
+{
+    // a header locking in several files has a site in each, with its own copy of the file name
+    std::map<std::pair<std::string, int>, CLockProfileSite> mapSites;
+    for (int i = 0; i < LOCKPROFILE_SLOTS; i++) {
+        const CLockProfileSlot& slot = lockProfileSlots[i];
+        if (!slot.fUsed.load(std::memory_order_acquire))
+            continue;
+        std::map<std::pair<std::string, int>, CLockProfileSite>::iterator it = mapSites.find(std::make_pair(std::string(slot.pszFile), slot.nLine));
+        if (it == mapSites.end()) {
+            CLockProfileSite site = {};
+            site.name = slot.pszName;
+            site.file = slot.pszFile;
+            site.line = slot.nLine;
+            it = mapSites.insert(std::make_pair(std::make_pair(site.file, site.line), site)).first;
+        }
+        CLockProfileSite& site = it->second;
+        site.nLocks += slot.nLocks.load(std::memory_order_relaxed);
+        site.nContended += slot.nContended.load(std::memory_order_relaxed);
+        site.nWaitMicros += slot.nWaitMicros.load(std::memory_order_relaxed);
+        site.nHoldMicros += slot.nHoldMicros.load(std::memory_order_relaxed);
+        site.nMaxWaitMicros = std::max(site.nMaxWaitMicros, slot.nMaxWaitMicros.load(std::memory_order_relaxed));
+        site.nMaxHoldMicros = std::max(site.nMaxHoldMicros, slot.nMaxHoldMicros.load(std::memory_order_relaxed));
+        for (int j = 0; j < LOCKPROFILE_BUCKETS; j++) {
+            site.waitBuckets[j] += slot.waitBuckets[j].load(std::memory_order_relaxed);
+            site.holdBuckets[j] += slot.holdBuckets[j].load(std::memory_order_relaxed);
+        }
+    }
+    std::vector<CLockProfileSite> sites;
+    for (std::map<std::pair<std::string, int>, CLockProfileSite>::const_iterator it = mapSites.begin(); it != mapSites.end(); it++)
+        sites.push_back(it->second);
+    return sites;
+}
+
+void ResetLockProfile()
+{
+    // the sites stay, their counters start again
+    for (int i = 0; i < LOCKPROFILE_SLOTS; i++) {
+        CLockProfileSlot& slot = lockProfileSlots[i];
+        slot.nLocks.store(0, std::memory_order_relaxed);
+        slot.nContended.store(0, std::memory_order_relaxed);
+        slot.nWaitMicros.store(0, std::memory_order_relaxed);
+        slot.nHoldMicros.store(0, std::memory_order_relaxed);
+        slot.nMaxWaitMicros.store(0, std::memory_order_relaxed);
+        slot.nMaxHoldMicros.store(0, std::memory_order_relaxed);
+        for (int j = 0; j < LOCKPROFILE_BUCKETS; j++) {
+            slot.waitBuckets[j].store(0, std::memory_order_relaxed);
+            slot.holdBuckets[j].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
 #ifdef DEBUG_LOCKCONTENTION
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 {
@@ -24,6 +24,11 @@
 #include "threadsafety.h"
 
 #undef __cpuid
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
@@ -115,24 +120,90 @@ void static inline AssertLockHeldInternal(const char* pszName, const char* pszFi
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/** Told how long a LOCK waited for a mutex another thread held, uncontended locks aren't timed */
+typedef void (*LockWaitHook)(const void* cs, int64_t nWaitMicros);
+extern std::atomic<LockWaitHook> g_lockWaitHook;
+inline void SetLockWaitHook(LockWaitHook hook) { g_lockWaitHook.store(hook); }
+
+/** Power of two buckets of microseconds for the lock profile wait and hold times, the last one is open ended */
+static const int LOCKPROFILE_BUCKETS = 24;
+
+/** What -lockprofile counted for a LOCK site */
+struct CLockProfileSite
+{
+    //! the locked expression, as in LOCK(cs_main)
+    std::string name;
+    std::string file;
+    int line;
+    uint64_t nLocks;
+    //! the locks that had to wait for another thread
+    uint64_t nContended;
+    int64_t nWaitMicros;
+    int64_t nHoldMicros;
+    int64_t nMaxWaitMicros;
+    int64_t nMaxHoldMicros;
+    uint64_t waitBuckets[LOCKPROFILE_BUCKETS];
+    uint64_t holdBuckets[LOCKPROFILE_BUCKETS];
+};
+
+/** Count the locks, wait and hold times of every LOCK site */
+extern std::atomic<bool> g_lockProfile;
+inline void EnableLockProfile(bool fEnable) { g_lockProfile.store(fEnable); }
+inline int64_t LockProfileMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+//! The profile slot of a LOCK site, -1 when there is no slot left
+int LockProfileSite(const char* pszName, const char* pszFile, int nLine);
+void LockProfileAcquired(int nSite, bool fContended, int64_t nWaitMicros);
+void LockProfileReleased(int nSite, int64_t nHoldMicros);
+//! The sites locked since the start or the reset, by file and line
+std::vector<CLockProfileSite> GetLockProfile();
+void ResetLockProfile();
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template <typename Mutex>
 class SCOPED_LOCKABLE CMutexLock
 {
 private:
     boost::unique_lock<Mutex> lock;
+    //! the lock profile slot of the site, -1 when not profiled, and when the lock was taken
+    int nProfileSite;
+    int64_t nProfileStart;
+
+    void ProfileAcquired(const char* pszName, const char* pszFile, int nLine, bool fContended, int64_t nWaitMicros)
+    {
+        nProfileSite = LockProfileSite(pszName, pszFile, nLine);
+        if (nProfileSite < 0)
+            return;
+        LockProfileAcquired(nProfileSite, fContended, nWaitMicros);
+        nProfileStart = LockProfileMicros();
+    }
 
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
-#ifdef DEBUG_LOCKCONTENTION
+        bool fProfile = g_lockProfile.load(std::memory_order_relaxed);
         if (!lock.try_lock()) {
+#ifdef DEBUG_LOCKCONTENTION
             PrintLockContention(pszName, pszFile, nLine);
 #endif
+            LockWaitHook hook = g_lockWaitHook.load(std::memory_order_relaxed);
+            if (hook == NULL && !fProfile) {
+                lock.lock();
+                return;
+            }
+            int64_t nStart = LockProfileMicros();
             lock.lock();
-#ifdef DEBUG_LOCKCONTENTION
+            int64_t nWaitMicros = LockProfileMicros() - nStart;
+            if (hook != NULL)
+                hook(lock.mutex(), nWaitMicros);
+            if (fProfile)
+                ProfileAcquired(pszName, pszFile, nLine, true, nWaitMicros);
+            return;
         }
-#endif
+        if (fProfile)
+            ProfileAcquired(pszName, pszFile, nLine, false, 0);
     }
 
     bool TryEnter(const char* pszName, const char* pszFile, int nLine)
@@ -141,11 +212,13 @@ private:
         lock.try_lock();
         if (!lock.owns_lock())
             LeaveCritical();
+        else if (g_lockProfile.load(std::memory_order_relaxed))
+            ProfileAcquired(pszName, pszFile, nLine, false, 0);
         return lock.owns_lock();
     }
 
 public:
-    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(mutexIn) : lock(mutexIn, boost::defer_lock)
+    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(mutexIn) : lock(mutexIn, boost::defer_lock), nProfileSite(-1), nProfileStart(0)
     {
         if (fTry)
             TryEnter(pszName, pszFile, nLine);
@@ -153,7 +226,7 @@ public:
             Enter(pszName, pszFile, nLine);
     }
 
-    CMutexLock(Mutex* pmutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(pmutexIn)
+    CMutexLock(Mutex* pmutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(pmutexIn) : nProfileSite(-1), nProfileStart(0)
     {
         if (!pmutexIn) return;
 
@@ -166,8 +239,11 @@ public:
 
     ~CMutexLock() UNLOCK_FUNCTION()
     {
-        if (lock.owns_lock())
+        if (lock.owns_lock()) {
+            if (nProfileSite >= 0)
+                LockProfileReleased(nProfileSite, LockProfileMicros() - nProfileStart);
             LeaveCritical();
+        }
     }
 
     operator bool()
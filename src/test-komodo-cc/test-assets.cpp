@@ -25,6 +25,8 @@
 #include "script/interpreter.h"
 #include "script/serverchecker.h"
 #include "txmempool.h"
+#include "undo.h"
+#include "utiltime.h"
 
 extern Eval* EVAL_TEST;
 extern bool fDisableCCLogForTests;
@@ -2958,4 +2960,120 @@ TEST_F(TestAssetsCC, ccupgrade_tokel)
     EXPECT_EQ(GetCurrentUpgradeInfo(CCUpgrades::CCMIXEDMODE_SUBVER_1_TOKEL_TIMESTAMP, CCUpgrades::CCASSETS_OPDROP_FIX_TOKEL_HEIGHT+1, CCUpgrades::GetUpgrades()).nProtocolVersion, CCUpgrades::CCMIXEDMODE_SUBVER_1_PROTOCOL_VERSION);
 }
 
+// --------------------------------------------------
+// synthetic block benchmarks, run with --gtest_also_run_disabled_tests --gtest_filter='*bench*'
+// the number of txns per module block is set with the CCBENCH_TXNS env var (default 200)
+
+struct CCBenchTimes {
+    int64_t nBuild = 0, nCheck = 0, nEval = 0, nConnect = 0, nDisconnect = 0;
+};
+
+static int CCBenchTxns()
+{
+    const char *env = getenv("CCBENCH_TXNS");
+    int n = env ? atoi(env) : 0;
+    return n > 0 ? n : 200;
+}
+
+// times the phases ConnectBlock and DisconnectBlock go through for each tx of a synthetic block:
+// context free checks, cc validation, coins update with undo data and its rollback
+static void CCBenchReport(const char *module, const std::vector<CTransaction> &vtx, const std::map<uint256, CTransaction> &prevTxs, CCBenchTimes &times)
+{
+    CValidationState state;
+    auto verifier = libzcash::ProofVerifier::Disabled();
+    int64_t nStart = GetTimeMicros();
+    for (int i = 0; i < vtx.size(); i ++)
+        EXPECT_TRUE(CheckTransaction(eval.GetCurrentTime(), vtx[i], state, verifier, i + 1, vtx.size() + 1));
+    times.nCheck = GetTimeMicros() - nStart;
+
+    CCoinsView viewDummy;
+    CCoinsViewCache viewBase(&viewDummy);
+    for (auto const &t : prevTxs)
+        viewBase.ModifyCoins(t.first)->FromTx(t.second, eval.GetCurrentHeight() - 1);
+    CCoinsViewCache view(&viewBase);
+
+    std::vector<CTxUndo> vtxundo(vtx.size());
+    nStart = GetTimeMicros();
+    for (int i = 0; i < vtx.size(); i ++)
+        UpdateCoins(vtx[i], view, vtxundo[i], eval.GetCurrentHeight());
+    times.nConnect = GetTimeMicros() - nStart;
+
+    nStart = GetTimeMicros();
+    for (int i = vtx.size() - 1; i >= 0; i --) {
+        view.ModifyCoins(vtx[i].GetHash())->Clear();
+        for (int j = vtx[i].vin.size() - 1; j >= 0; j --)
+            EXPECT_TRUE(ApplyTxInUndo(vtxundo[i].vprevout[j], view, vtx[i].vin[j].prevout));
+    }
+    times.nDisconnect = GetTimeMicros() - nStart;
+
+    double ntx = vtx.empty() ? 1 : vtx.size();
+    std::cerr << "ccbench " << module << " txns=" << vtx.size()
+              << " build=" << times.nBuild * 0.001 << "ms"
+              << " check=" << times.nCheck * 0.001 << "ms (" << times.nCheck / ntx << "us/tx)"
+              << " cceval=" << times.nEval * 0.001 << "ms (" << times.nEval / ntx << "us/tx)"
+              << " connect=" << times.nConnect * 0.001 << "ms (" << times.nConnect / ntx << "us/tx)"
+              << " disconnect=" << times.nDisconnect * 0.001 << "ms (" << times.nDisconnect / ntx << "us/tx)" << std::endl;
+}
+
+// adds a built tx to the mock chain, timing its cc validation
+static bool CCBenchAddTx(const CTransaction &tx, std::vector<CTransaction> &vtx, CCBenchTimes &times)
+{
+    if (tx.IsNull())
+        return false;
+    int64_t nStart = GetTimeMicros();
+    bool fAdded = eval.AddTx(tx);
+    times.nEval += GetTimeMicros() - nStart;
+    if (fAdded)
+        vtx.push_back(tx);
+    return fAdded;
+}
+
+TEST_F(TestAssetsCC, DISABLED_bench_tokenv2create)
+{
+    eval.SetCurrentHeight(111);
+    std::map<uint256, CTransaction> prevTxs = eval.getTxs();
+    std::vector<CTransaction> vtx;
+    CCBenchTimes times;
+    int64_t nStart = GetTimeMicros();
+    for (int i = 0; i < CCBenchTxns(); i ++)
+        ASSERT_TRUE(CCBenchAddTx(MakeTokenV2CreateTx(pk1, 10), vtx, times));
+    times.nBuild = GetTimeMicros() - nStart - times.nEval;
+    CCBenchReport("tokenv2create", vtx, prevTxs, times);
+}
+
+TEST_F(TestAssetsCC, DISABLED_bench_tokenv2transfer)
+{
+    eval.SetCurrentHeight(111);
+    CMutableTransaction mcreatetx = MakeTokenV2CreateTx(pk1, CCBenchTxns());
+    ASSERT_TRUE(eval.AddTx(mcreatetx));
+    uint256 tokenid = mcreatetx.GetHash();
+    std::map<uint256, CTransaction> prevTxs = eval.getTxs();
+    std::vector<CTransaction> vtx;
+    CCBenchTimes times;
+    std::vector<std::string> tokenaddrs = GetTokenV2IndexKeys(pk1);
+    int64_t nStart = GetTimeMicros();
+    for (int i = 0; i < CCBenchTxns(); i ++)
+        ASSERT_TRUE(CCBenchAddTx(MakeTokenV2TransferTx(pk1, 0, tokenid, tokenaddrs, {}, 1, { pk2.GetID() }, 1, false, false), vtx, times));
+    times.nBuild = GetTimeMicros() - nStart - times.nEval;
+    CCBenchReport("tokenv2transfer", vtx, prevTxs, times);
+}
+
+TEST_F(TestAssetsCC, DISABLED_bench_tokenv2ask)
+{
+    struct CCcontract_info *cpTokens, tokensC;
+    cpTokens = CCinit(&tokensC, TokensV2::EvalCode());
+    eval.SetCurrentHeight(111);
+    CMutableTransaction mcreatetx = MakeTokenV2CreateTx(pk1, CCBenchTxns());
+    ASSERT_TRUE(eval.AddTx(mcreatetx));
+    uint256 tokenid = mcreatetx.GetHash();
+    std::map<uint256, CTransaction> prevTxs = eval.getTxs();
+    std::vector<CTransaction> vtx;
+    CCBenchTimes times;
+    int64_t nStart = GetTimeMicros();
+    for (int i = 0; i < CCBenchTxns(); i ++)
+        ASSERT_TRUE(CCBenchAddTx(MakeTokenV2AskTx(cpTokens, pk1, tokenid, 1, ASSETS_NORMAL_DUST+1, 222), vtx, times));
+    times.nBuild = GetTimeMicros() - nStart - times.nEval;
+    CCBenchReport("tokenv2ask", vtx, prevTxs, times);
+}
+
 } /* namespace CCAssetsTests */
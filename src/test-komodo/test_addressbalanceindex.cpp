@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include "main.h"
+#include "random.h"
+#include "txdb.h"
+
+namespace TestAddressBalanceIndex {
+
+    class TestAddressBalanceIndex : public ::testing::Test {
+    protected:
+        CBlockTreeDB *db;
+        bool fAddressBalanceIndexSaved;
+
+        virtual void SetUp() {
+            fAddressBalanceIndexSaved = fAddressBalanceIndex;
+            fAddressBalanceIndex = true;
+            db = new CBlockTreeDB(1 << 20, true);
+        }
+        virtual void TearDown() {
+            delete db;
+            fAddressBalanceIndex = fAddressBalanceIndexSaved;
+        }
+    };
+
+    static uint160 Address(unsigned char n)
+    {
+        uint160 hash;
+        *hash.begin() = n;
+        return hash;
+    }
+
+    static std::pair<CAddressUnspentKey, CAddressUnspentValue> Unspent(unsigned int type, unsigned char address, const uint256 &txid, size_t n, CAmount value)
+    {
+        return std::make_pair(CAddressUnspentKey(type, Address(address), txid, n), value < 0 ? CAddressUnspentValue() : CAddressUnspentValue(value, CScript(), 1));
+    }
+
+    TEST_F(TestAddressBalanceIndex, testBalances)
+    {
+        uint256 txid1 = GetRandHash(), txid2 = GetRandHash();
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vect;
+        vect.push_back(Unspent(1, 1, txid1, 0, 5 * COIN));
+        vect.push_back(Unspent(1, 1, txid1, 1, 3 * COIN));
+        vect.push_back(Unspent(1, 2, txid1, 2, 0));
+        vect.push_back(Unspent(3, 3, txid1, 3, 7 * COIN));
+        // created and spent in the same batch
+        vect.push_back(Unspent(1, 2, txid2, 0, 2 * COIN));
+        vect.push_back(Unspent(1, 2, txid2, 0, -1));
+        ASSERT_TRUE(db->UpdateAddressUnspentIndex(vect));
+
+        CAddressBalanceValue balance;
+        ASSERT_TRUE(db->ReadAddressBalance(Address(1), 1, balance));
+        EXPECT_EQ(balance.satoshis, 8 * COIN);
+        EXPECT_EQ(balance.utxos, 2);
+        EXPECT_FALSE(db->ReadAddressBalance(Address(2), 1, balance));
+
+        CAddressBalanceTotals totals;
+        ASSERT_TRUE(db->ReadAddressBalanceTotals(totals));
+        EXPECT_EQ(totals.satoshis, 8 * COIN);
+        EXPECT_EQ(totals.utxos, 2);
+        EXPECT_EQ(totals.addresses, 1);
+        EXPECT_EQ(totals.ccSatoshis, 7 * COIN);
+        EXPECT_EQ(totals.ccUtxos, 1);
+
+        // spend one output of address 1 in a later batch
+        vect.clear();
+        vect.push_back(Unspent(1, 1, txid1, 0, -1));
+        ASSERT_TRUE(db->UpdateAddressUnspentIndex(vect));
+        ASSERT_TRUE(db->ReadAddressBalance(Address(1), 1, balance));
+        EXPECT_EQ(balance.satoshis, 3 * COIN);
+        EXPECT_EQ(balance.utxos, 1);
+    }
+
+    TEST_F(TestAddressBalanceIndex, testRichList)
+    {
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vect;
+        for (unsigned char i = 1; i <= 20; i++)
+            vect.push_back(Unspent(i % 2 ? 1 : 2, i, GetRandHash(), 0, (i % 7 + 1) * COIN));
+        ASSERT_TRUE(db->UpdateAddressUnspentIndex(vect));
+
+        std::vector<CAmount> amounts;
+        db->ForEachAddressRichList([&](const CAddressRichListKey &key) {
+            amounts.push_back(key.satoshis);
+            return true;
+        });
+        ASSERT_EQ(amounts.size(), 20);
+        for (size_t i = 1; i < amounts.size(); i++)
+            EXPECT_GE(amounts[i-1], amounts[i]);
+        EXPECT_EQ(amounts[0], 7 * COIN);
+    }
+
+    TEST_F(TestAddressBalanceIndex, testSnapshotMatchesUnspentIndex)
+    {
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vect;
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > spent;
+        for (int i = 0; i < 200; i++)
+        {
+            vect.push_back(Unspent(1 + GetRand(3), GetRand(30), GetRandHash(), 0, GetRand(100) * COIN));
+            if (GetRand(4) == 0)
+                spent.push_back(std::make_pair(vect.back().first, CAddressUnspentValue()));
+        }
+        ASSERT_TRUE(db->UpdateAddressUnspentIndex(vect));
+        ASSERT_TRUE(db->UpdateAddressUnspentIndex(spent));
+
+        std::map<std::string, CAmount> fromBalances, fromUnspents;
+        UniValue retBalances(UniValue::VOBJ), retUnspents(UniValue::VOBJ);
+        ASSERT_TRUE(db->Snapshot2(fromBalances, &retBalances));
+        fAddressBalanceIndex = false;
+        ASSERT_TRUE(db->Snapshot2(fromUnspents, &retUnspents));
+        EXPECT_EQ(fromBalances, fromUnspents);
+        EXPECT_EQ(retBalances.write(), retUnspents.write());
+
+        // the rich list snapshot has the same totals and the same top addresses
+        fAddressBalanceIndex = true;
+        std::vector<std::pair<CAmount, std::string> > vaddr, sorted;
+        UniValue retRichList(UniValue::VOBJ);
+        ASSERT_TRUE(db->SnapshotRichList(10, vaddr, &retRichList));
+        EXPECT_EQ(retRichList.write(), retUnspents.write());
+        for (const auto &element : fromUnspents)
+            sorted.push_back(std::make_pair(element.second, element.first));
+        std::sort(sorted.rbegin(), sorted.rend());
+        ASSERT_GE(vaddr.size(), std::min<size_t>(10, sorted.size()));
+        for (size_t i = 0; i < 10 && i < sorted.size(); i++)
+            EXPECT_EQ(vaddr[i], sorted[i]);
+    }
+
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include "main.h"
+#include "random.h"
+#include "txdb.h"
+
+namespace TestAddressIndexPage {
+
+    class TestAddressIndexPage : public ::testing::Test {
+    protected:
+        CBlockTreeDB *db;
+        uint160 address, other;
+
+        virtual void SetUp() {
+            db = new CBlockTreeDB(1 << 20, true);
+            GetRandBytes(address.begin(), address.size());
+            *address.begin() = 1;
+            other = address;
+            *other.begin() = 0;
+
+            // heights 1..10 for the address, with a neighbour on each side in key order
+            std::vector<std::pair<CAddressIndexKey, CAmount> > vect;
+            for (int h = 1; h <= 10; h++)
+                vect.push_back(std::make_pair(CAddressIndexKey(1, address, h, 1, GetRandHash(), 0, false), h * COIN));
+            vect.push_back(std::make_pair(CAddressIndexKey(1, other, 5, 1, GetRandHash(), 0, false), COIN));
+            vect.push_back(std::make_pair(CAddressIndexKey(2, address, 5, 1, GetRandHash(), 0, false), COIN));
+            ASSERT_TRUE(db->WriteAddressIndex(vect));
+        }
+        virtual void TearDown() {
+            delete db;
+        }
+
+        std::vector<int> Heights(bool fReverse, int start, int end, const CAddressIndexKey *pcursor, size_t limit, CAddressIndexKey *plast = NULL) {
+            std::vector<int> heights;
+            auto func = [&](const CAddressIndexKey &key, CAmount nValue) {
+                if (heights.size() >= limit)
+                    return false;
+                EXPECT_EQ(nValue, key.blockHeight * COIN);
+                heights.push_back(key.blockHeight);
+                if (plast != NULL)
+                    *plast = key;
+                return true;
+            };
+            if (fReverse)
+                EXPECT_TRUE(db->ForEachAddressIndexReverse(address, 1, start, end, pcursor, func));
+            else
+                EXPECT_TRUE(db->ForEachAddressIndex(address, 1, start, end, pcursor, func));
+            return heights;
+        }
+    };
+
+    TEST_F(TestAddressIndexPage, testReverse)
+    {
+        EXPECT_EQ(Heights(true, 0, 0, NULL, 100), std::vector<int>({10, 9, 8, 7, 6, 5, 4, 3, 2, 1}));
+        EXPECT_EQ(Heights(true, 0, 0, NULL, 3), std::vector<int>({10, 9, 8}));
+        EXPECT_EQ(Heights(true, 3, 6, NULL, 100), std::vector<int>({6, 5, 4, 3}));
+    }
+
+    TEST_F(TestAddressIndexPage, testCursor)
+    {
+        for (bool fReverse : {false, true}) {
+            std::vector<int> all;
+            CAddressIndexKey last;
+            bool fHasCursor = false;
+            while (true) {
+                std::vector<int> page = Heights(fReverse, 0, 0, fHasCursor ? &last : NULL, 4, &last);
+                if (page.empty())
+                    break;
+                all.insert(all.end(), page.begin(), page.end());
+                fHasCursor = true;
+            }
+            std::vector<int> expected({1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+            if (fReverse)
+                std::reverse(expected.begin(), expected.end());
+            EXPECT_EQ(all, expected);
+        }
+    }
+
+}
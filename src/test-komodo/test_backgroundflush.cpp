@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include "coins.h"
+#include "random.h"
+#include "txdb.h"
+
+namespace TestBackgroundFlush {
+
+    static uint256 AddCoins(CCoinsViewCache &view, unsigned int nOutputs)
+    {
+        CMutableTransaction mtx;
+        mtx.nLockTime = GetRand(1 << 30);
+        mtx.vout.resize(nOutputs, CTxOut(1000, CScript() << OP_TRUE));
+        CTransaction tx(mtx);
+        view.ModifyCoins(tx.GetHash())->FromTx(tx, 1);
+        return tx.GetHash();
+    }
+
+    TEST(TestBackgroundFlush, testReadWhilePending)
+    {
+        CCoinsViewDB db(1 << 20, true);
+        CCoinsViewBackgroundFlush flush(&db, &db);
+        CCoinsViewCache tip(&flush);
+
+        uint256 txid = AddCoins(tip, 2);
+        uint256 hashBlock = GetRandHash();
+        tip.SetBestBlock(hashBlock);
+        ASSERT_TRUE(tip.Flush());
+        EXPECT_EQ(tip.GetCacheSize(), 0U);
+
+        // read from the flush or, once written, the database
+        EXPECT_TRUE(tip.HaveCoins(txid));
+        EXPECT_EQ(tip.GetBestBlock(), hashBlock);
+        EXPECT_EQ(flush.GetBestBlock(), hashBlock);
+
+        ASSERT_TRUE(flush.Sync());
+        EXPECT_EQ(flush.DynamicMemoryUsage(), 0U);
+        CCoins coins;
+        ASSERT_TRUE(db.GetCoins(txid, coins));
+        EXPECT_EQ(coins.vout.size(), 2U);
+        EXPECT_EQ(db.GetBestBlock(), hashBlock);
+
+        // the spent outputs go with the next flush
+        tip.ModifyCoins(txid)->Spend(0);
+        tip.ModifyCoins(txid)->Spend(1);
+        ASSERT_TRUE(tip.Flush());
+        EXPECT_FALSE(flush.HaveCoins(txid));
+        ASSERT_TRUE(flush.Sync());
+        EXPECT_FALSE(db.HaveCoins(txid));
+    }
+
+    TEST(TestBackgroundFlush, testWriteOnDestroy)
+    {
+        CCoinsViewDB db(1 << 20, true);
+        std::vector<uint256> txids;
+        uint256 hashBlock = GetRandHash();
+        {
+            CCoinsViewBackgroundFlush flush(&db, &db);
+            CCoinsViewCache tip(&flush);
+            for (int i = 0; i < 1000; i++)
+                txids.push_back(AddCoins(tip, 1 + i % 3));
+            tip.SetBestBlock(hashBlock);
+            ASSERT_TRUE(tip.Flush());
+            // a second flush waits for the first one
+            txids.push_back(AddCoins(tip, 1));
+            ASSERT_TRUE(tip.Flush());
+        }
+        for (const uint256 &txid : txids)
+            EXPECT_TRUE(db.HaveCoins(txid));
+        EXPECT_EQ(db.GetBestBlock(), hashBlock);
+    }
+}
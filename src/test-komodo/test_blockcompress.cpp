@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+#include "blockcompress.h"
+#include "random.h"
+
+namespace TestBlockCompress {
+
+    static std::vector<unsigned char> RepetitiveData(size_t nSize)
+    {
+        std::vector<unsigned char> vData(nSize);
+        for (size_t i = 0; i < nSize; i++)
+            vData[i] = (i % 97 == 0) ? (unsigned char)GetRand(256) : (unsigned char)(i % 13);
+        return vData;
+    }
+
+    TEST(TestBlockCompress, testRoundTrip)
+    {
+        std::vector<unsigned char> vData = RepetitiveData(50000), vFrame, vOut;
+        ASSERT_TRUE(CompressBlockData(&vData[0], vData.size(), vFrame));
+        EXPECT_LT(vFrame.size(), vData.size());
+        EXPECT_TRUE(IsBlockDataFrame(&vFrame[0]));
+
+        uint32_t nRawSize, nCompressedSize;
+        ASSERT_TRUE(ParseBlockDataFrameHeader(&vFrame[0], nRawSize, nCompressedSize));
+        EXPECT_EQ(nRawSize, vData.size());
+        EXPECT_EQ(nCompressedSize + BLOCKDATA_FRAME_HEADER_SIZE, vFrame.size());
+        ASSERT_TRUE(DecompressBlockData(&vFrame[BLOCKDATA_FRAME_HEADER_SIZE], nCompressedSize, nRawSize, vOut));
+        EXPECT_EQ(vOut, vData);
+    }
+
+    TEST(TestBlockCompress, testIncompressible)
+    {
+        std::vector<unsigned char> vData(5000), vFrame;
+        GetRandBytes(&vData[0], vData.size());
+        EXPECT_FALSE(CompressBlockData(&vData[0], vData.size(), vFrame));
+        EXPECT_TRUE(vFrame.empty());
+    }
+
+    TEST(TestBlockCompress, testCorruptFrame)
+    {
+        std::vector<unsigned char> vData = RepetitiveData(20000), vFrame, vOut;
+        ASSERT_TRUE(CompressBlockData(&vData[0], vData.size(), vFrame));
+        uint32_t nRawSize, nCompressedSize;
+        ASSERT_TRUE(ParseBlockDataFrameHeader(&vFrame[0], nRawSize, nCompressedSize));
+
+        // truncated payload and wrong raw size must both be rejected
+        EXPECT_FALSE(DecompressBlockData(&vFrame[BLOCKDATA_FRAME_HEADER_SIZE], nCompressedSize - 1, nRawSize, vOut));
+        EXPECT_FALSE(DecompressBlockData(&vFrame[BLOCKDATA_FRAME_HEADER_SIZE], nCompressedSize, nRawSize - 1, vOut));
+        EXPECT_FALSE(DecompressBlockData(&vFrame[BLOCKDATA_FRAME_HEADER_SIZE], nCompressedSize, nRawSize + 1, vOut));
+    }
+}
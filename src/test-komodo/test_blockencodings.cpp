@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include "blockencodings.h"
+#include "main.h"
+#include "random.h"
+#include "streams.h"
+#include "txmempool.h"
+
+namespace TestBlockEncodings {
+
+    static CTransaction MakeTx(const uint256 &prevhash, uint32_t n)
+    {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(prevhash, n);
+        mtx.vout.resize(1);
+        mtx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        mtx.vout[0].nValue = COIN;
+        return CTransaction(mtx);
+    }
+
+    static void AddTx(CTxMemPool &pool, const CTransaction &tx)
+    {
+        CTxMemPoolEntry entry(tx, 0, GetTime(), 0.0, 1, pool.HasNoInputsOf(tx), false, 0);
+        pool.addUnchecked(tx.GetHash(), entry, false);
+    }
+
+    static CBlock MakeBlock()
+    {
+        CBlock block;
+        CMutableTransaction coinbase;
+        coinbase.vin.resize(1);
+        coinbase.vin[0].prevout.SetNull();
+        coinbase.vin[0].scriptSig = CScript() << 1 << OP_0;
+        coinbase.vout.resize(1);
+        coinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        coinbase.vout[0].nValue = COIN;
+        block.vtx.push_back(CTransaction(coinbase));
+        for (int i = 0; i < 3; i++)
+            block.vtx.push_back(MakeTx(GetRandHash(), 0));
+        block.hashPrevBlock = GetRandHash();
+        block.nTime = GetTime();
+        block.hashMerkleRoot = block.BuildMerkleTree();
+        return block;
+    }
+
+    TEST(TestBlockEncodings, testReconstructFromMempool)
+    {
+        CTxMemPool pool(CFeeRate(0));
+        CBlock block = MakeBlock();
+        AddTx(pool, block.vtx[1]);
+        AddTx(pool, block.vtx[3]);
+
+        CBlockHeaderAndShortTxIDs cmpctblock(block, false);
+        EXPECT_EQ(block.vtx.size(), cmpctblock.BlockTxCount());
+
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << cmpctblock;
+        CBlockHeaderAndShortTxIDs received;
+        ss >> received;
+        EXPECT_EQ(block.GetHash(), received.header.GetHash());
+        EXPECT_EQ(cmpctblock.GetShortID(block.vtx[2].GetHash()), received.GetShortID(block.vtx[2].GetHash()));
+
+        PartiallyDownloadedBlock partialBlock(&pool);
+        ASSERT_EQ(READ_STATUS_OK, partialBlock.InitData(received));
+        EXPECT_EQ(1U, partialBlock.PrefilledCount());
+        EXPECT_EQ(2U, partialBlock.MempoolCount());
+
+        // the tx missing from the mempool is asked for
+        std::vector<uint16_t> indexes;
+        partialBlock.GetMissing(indexes);
+        ASSERT_EQ(1U, indexes.size());
+        EXPECT_EQ(2, indexes[0]);
+
+        CBlock reconstructed;
+        std::vector<CTransaction> vtx_missing(1, block.vtx[2]);
+        ASSERT_EQ(READ_STATUS_OK, partialBlock.FillBlock(reconstructed, vtx_missing));
+        EXPECT_EQ(block.GetHash(), reconstructed.GetHash());
+        EXPECT_EQ(block.hashMerkleRoot, reconstructed.BuildMerkleTree());
+    }
+
+    TEST(TestBlockEncodings, testWrongMissingTxns)
+    {
+        CTxMemPool pool(CFeeRate(0));
+        CBlock block = MakeBlock();
+
+        PartiallyDownloadedBlock partialBlock(&pool);
+        ASSERT_EQ(READ_STATUS_OK, partialBlock.InitData(CBlockHeaderAndShortTxIDs(block, true)));
+        EXPECT_EQ(2U, partialBlock.PrefilledCount());
+
+        // a tx in the place of another one doesn't match the merkle root
+        CBlock reconstructed;
+        std::vector<CTransaction> vtx_missing;
+        vtx_missing.push_back(block.vtx[2]);
+        vtx_missing.push_back(block.vtx[1]);
+        EXPECT_EQ(READ_STATUS_FAILED, partialBlock.FillBlock(reconstructed, vtx_missing));
+
+        // too few txns is the peer's fault
+        PartiallyDownloadedBlock partialBlock2(&pool);
+        ASSERT_EQ(READ_STATUS_OK, partialBlock2.InitData(CBlockHeaderAndShortTxIDs(block, true)));
+        vtx_missing.pop_back();
+        EXPECT_EQ(READ_STATUS_INVALID, partialBlock2.FillBlock(reconstructed, vtx_missing));
+    }
+
+    TEST(TestBlockEncodings, testRequestIndexes)
+    {
+        BlockTransactionsRequest req;
+        req.blockhash = GetRandHash();
+        req.indexes.push_back(0);
+        req.indexes.push_back(1);
+        req.indexes.push_back(3);
+        req.indexes.push_back(65535);
+
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << req;
+        BlockTransactionsRequest received;
+        ss >> received;
+        EXPECT_EQ(req.blockhash, received.blockhash);
+        EXPECT_EQ(req.indexes, received.indexes);
+
+        // an index past 16 bits once the offsets are added up is rejected
+        CDataStream ssOverflow(SER_NETWORK, PROTOCOL_VERSION);
+        ssOverflow << req.blockhash;
+        WriteCompactSize(ssOverflow, 2);
+        WriteCompactSize(ssOverflow, 65535);
+        WriteCompactSize(ssOverflow, 0);
+        EXPECT_THROW(ssOverflow >> received, std::ios_base::failure);
+    }
+}
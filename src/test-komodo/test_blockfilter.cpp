@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+#include "blockfilter.h"
+#include "cc/CCinclude.h"
+#include "hash.h"
+#include "key.h"
+#include "script/cc.h"
+#include "script/standard.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "streams.h"
+#include "undo.h"
+#include "utilstrencodings.h"
+
+namespace TestBlockFilter {
+
+    static GCSFilter::Element RandomElement()
+    {
+        GCSFilter::Element element(32);
+        GetRandBytes(element.data(), element.size());
+        return element;
+    }
+
+    TEST(TestBlockFilter, sipHashBytesVectors)
+    {
+        // the SipHash-2-4 reference vectors, key 00..0f and the message 00..len-1
+        unsigned char data[32];
+        for (int i = 0; i < 32; i++)
+            data[i] = i;
+        uint64_t k0 = 0x0706050403020100ULL, k1 = 0x0F0E0D0C0B0A0908ULL;
+        EXPECT_EQ(SipHashBytes(k0, k1, data, 0), 0x726fdb47dd0e0e31ULL);
+        EXPECT_EQ(SipHashBytes(k0, k1, data, 1), 0x74f839c593dc67fdULL);
+        EXPECT_EQ(SipHashBytes(k0, k1, data, 8), 0x93f5f5799a932462ULL);
+
+        uint256 val;
+        memcpy(val.begin(), data, 32);
+        EXPECT_EQ(SipHashBytes(k0, k1, data, 32), SipHashUint256(k0, k1, val));
+    }
+
+    TEST(TestBlockFilter, gcsFilterMatchAndDecode)
+    {
+        GCSFilter::ElementSet included, excluded;
+        for (int i = 0; i < 200; i++) {
+            included.insert(RandomElement());
+            excluded.insert(RandomElement());
+        }
+        GCSFilter::Params params(GetRand(std::numeric_limits<uint64_t>::max()), GetRand(std::numeric_limits<uint64_t>::max()), BASIC_FILTER_P, BASIC_FILTER_M);
+        GCSFilter filter(params, included);
+        EXPECT_EQ(filter.GetN(), 200);
+
+        for (const GCSFilter::Element& element : included)
+            EXPECT_TRUE(filter.Match(element));
+        EXPECT_TRUE(filter.MatchAny(included));
+
+        // 1/M false positives, 200 misses out of 200 are all but certain
+        int nFalsePositives = 0;
+        for (const GCSFilter::Element& element : excluded)
+            nFalsePositives += filter.Match(element);
+        EXPECT_LE(nFalsePositives, 1);
+
+        GCSFilter decoded(params, filter.GetEncoded());
+        EXPECT_EQ(decoded.GetN(), filter.GetN());
+        EXPECT_EQ(decoded.GetEncoded(), filter.GetEncoded());
+        EXPECT_TRUE(decoded.MatchAny(included));
+    }
+
+    TEST(TestBlockFilter, gcsFilterRejectsTruncated)
+    {
+        GCSFilter::ElementSet elements;
+        for (int i = 0; i < 10; i++)
+            elements.insert(RandomElement());
+        GCSFilter filter(GCSFilter::Params(1, 2, BASIC_FILTER_P, BASIC_FILTER_M), elements);
+
+        std::vector<unsigned char> vTruncated(filter.GetEncoded().begin(), filter.GetEncoded().end() - 3);
+        EXPECT_THROW(GCSFilter(filter.GetParams(), vTruncated), std::ios_base::failure);
+
+        GCSFilter empty(filter.GetParams(), GCSFilter::ElementSet());
+        EXPECT_EQ(empty.GetEncoded().size(), 1);
+        EXPECT_FALSE(empty.Match(*elements.begin()));
+    }
+
+    TEST(TestBlockFilter, basicFilterElements)
+    {
+        CKey key;
+        key.MakeNewKey(true);
+        CScript p2pkh = GetScriptForDestination(key.GetPubKey().GetID());
+        CScript spent = GetScriptForDestination(CPubKey(ParseHex("0205a8ad0c1dbc515f149af377981aab58b836af008d4d7ab21bd76faf80550b47")).GetID());
+        CScript opret = CScript() << OP_RETURN << ParseHex("deadbeef");
+
+        CC *cond = MakeCCcond1(EVAL_TOKENS, key.GetPubKey());
+        CScript ccScript = CCPubKey(cond);
+        cc_free(cond);
+        char ccaddr[KOMODO_ADDRESS_BUFSIZE];
+        ASSERT_TRUE(Getscriptaddress(ccaddr, ccScript));
+
+        CMutableTransaction coinbase, mtx;
+        coinbase.vin.resize(1);
+        coinbase.vout.push_back(CTxOut(1000, p2pkh));
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout.hash = GetRandHash();
+        mtx.vout.push_back(CTxOut(500, ccScript));
+        mtx.vout.push_back(CTxOut(0, opret));
+        CBlock block;
+        block.vtx.push_back(CTransaction(coinbase));
+        block.vtx.push_back(CTransaction(mtx));
+
+        CBlockUndo blockUndo;
+        blockUndo.vtxundo.resize(1);
+        blockUndo.vtxundo[0].vprevout.push_back(CTxInUndo(CTxOut(700, spent), false, 10, 1));
+
+        BlockFilter filter(BLOCK_FILTER_BASIC, block, blockUndo);
+        const GCSFilter& gcs = filter.GetFilter();
+        EXPECT_EQ(gcs.GetN(), 4);
+        EXPECT_TRUE(gcs.Match(GCSFilter::Element(p2pkh.begin(), p2pkh.end())));
+        EXPECT_TRUE(gcs.Match(GCSFilter::Element(spent.begin(), spent.end())));
+        EXPECT_TRUE(gcs.Match(GCSFilter::Element(ccScript.begin(), ccScript.end())));
+        EXPECT_TRUE(gcs.Match(GCSFilter::Element((unsigned char*)ccaddr, (unsigned char*)ccaddr + strlen(ccaddr))));
+        EXPECT_FALSE(gcs.Match(GCSFilter::Element(opret.begin(), opret.end())));
+
+        // the key of the set is the block hash, as a client rebuilds it
+        BlockFilter decoded(BLOCK_FILTER_BASIC, block.GetHash(), filter.GetEncodedFilter());
+        EXPECT_EQ(decoded.GetHash(), filter.GetHash());
+        EXPECT_TRUE(decoded.GetFilter().Match(GCSFilter::Element(p2pkh.begin(), p2pkh.end())));
+
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << filter;
+        BlockFilter unserialized;
+        ss >> unserialized;
+        EXPECT_EQ(unserialized.GetBlockHash(), block.GetHash());
+        EXPECT_EQ(unserialized.GetEncodedFilter(), filter.GetEncodedFilter());
+    }
+
+    TEST(TestBlockFilter, filterHeadersChain)
+    {
+        CMutableTransaction coinbase;
+        coinbase.vin.resize(1);
+        coinbase.vout.push_back(CTxOut(1000, CScript() << OP_TRUE));
+        CBlock block;
+        block.vtx.push_back(CTransaction(coinbase));
+        BlockFilter filter(BLOCK_FILTER_BASIC, block, CBlockUndo());
+
+        uint256 filterHash = filter.GetHash();
+        uint256 genesisHeader = filter.ComputeHeader(uint256());
+        EXPECT_EQ(genesisHeader, Hash(filterHash.begin(), filterHash.end(), uint256().begin(), uint256().end()));
+        EXPECT_NE(filter.ComputeHeader(genesisHeader), genesisHeader);
+        EXPECT_EQ(filterHash, Hash(filter.GetEncodedFilter().begin(), filter.GetEncodedFilter().end()));
+    }
+}
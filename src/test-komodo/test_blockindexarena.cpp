@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+#include "chain.h"
+#include "random.h"
+#include "uint256.h"
+
+namespace TestBlockIndexArena {
+
+    TEST(TestBlockIndexArena, testAllocate)
+    {
+        CBlockIndexArena arena;
+        EXPECT_EQ(arena.Size(), 0U);
+
+        std::vector<uint256> vHashes;
+        std::vector<CBlockIndex*> vIndex;
+        for (int i = 0; i < 20000; i++) {
+            vHashes.push_back(GetRandHash());
+            vIndex.push_back(arena.Allocate(vHashes.back()));
+        }
+        EXPECT_EQ(arena.Size(), 20000U);
+        for (int i = 0; i < 20000; i++)
+            EXPECT_EQ(vIndex[i]->GetBlockHash(), vHashes[i]);
+
+        arena.Clear();
+        EXPECT_EQ(arena.Size(), 0U);
+        EXPECT_EQ(arena.DynamicMemoryUsage(), 0U);
+    }
+
+    TEST(TestBlockIndexArena, testAllocateFromHeader)
+    {
+        CBlockIndexArena arena;
+        CBlockHeader header;
+        header.nVersion = 4;
+        header.nTime = 1600000000;
+        header.nBits = 0x200f0f0f;
+        header.nSolution.assign(1344, 0x5a);
+
+        uint256 hash = GetRandHash();
+        CBlockIndex* pindex = arena.Allocate(hash, header);
+        EXPECT_EQ(pindex->GetBlockHash(), hash);
+        EXPECT_EQ(pindex->nTime, header.nTime);
+        EXPECT_EQ(pindex->nBits, header.nBits);
+        EXPECT_EQ(pindex->nSolution, header.nSolution);
+        EXPECT_EQ(pindex->pprev, (CBlockIndex*)NULL);
+    }
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include "cc/eval.h"
+#include "cc/CCevalcache.h"
+#include "cc/CCupgrades.h"
+#include "random.h"
+#include "uint256.h"
+
+namespace TestCCEvalCache {
+
+    class TestCCEvalCache : public ::testing::Test {
+    protected:
+        virtual void SetUp() { CCEvalCacheClear(); }
+        virtual void TearDown() { CCEvalCacheClear(); CCUpgrades::SelectUpgrades(""); }
+    };
+
+    TEST_F(TestCCEvalCache, testSameTipContext)
+    {
+        uint256 txid = GetRandHash(), tip = GetRandHash();
+        CCEvalCacheSet(txid, 1, EVAL_TOKENS, tip, 100, 1600000000);
+
+        EXPECT_TRUE(CCEvalCacheGet(txid, 1, EVAL_TOKENS, tip, 100, 1600000010));
+        EXPECT_FALSE(CCEvalCacheGet(txid, 0, EVAL_TOKENS, tip, 100, 1600000010));
+        EXPECT_FALSE(CCEvalCacheGet(txid, 1, EVAL_ASSETS, tip, 100, 1600000010));
+        EXPECT_FALSE(CCEvalCacheGet(GetRandHash(), 1, EVAL_TOKENS, tip, 100, 1600000010));
+    }
+
+    TEST_F(TestCCEvalCache, testOtherTipContext)
+    {
+        uint256 txid = GetRandHash(), tip = GetRandHash();
+        CCEvalCacheSet(txid, 0, EVAL_ASSETSV2, tip, 100, 1600000000);
+
+        EXPECT_FALSE(CCEvalCacheGet(txid, 0, EVAL_ASSETSV2, GetRandHash(), 100, 1600000000));
+        EXPECT_FALSE(CCEvalCacheGet(txid, 0, EVAL_ASSETSV2, tip, 101, 1600000000));
+        EXPECT_FALSE(CCEvalCacheGet(txid, 0, EVAL_ASSETSV2, uint256(), 100, 1600000000));
+    }
+
+    TEST_F(TestCCEvalCache, testNotCacheable)
+    {
+        uint256 txid = GetRandHash(), tip = GetRandHash();
+        CCEvalCacheSet(txid, 0, EVAL_ORACLES, tip, 100, 1600000000);
+        CCEvalCacheSet(txid, 0, EVAL_FIRSTUSER, tip, 100, 1600000000);
+
+        EXPECT_FALSE(CCEvalCacheIsCacheable(EVAL_ORACLES));
+        EXPECT_FALSE(CCEvalCacheGet(txid, 0, EVAL_ORACLES, tip, 100, 1600000000));
+        EXPECT_FALSE(CCEvalCacheGet(txid, 0, EVAL_FIRSTUSER, tip, 100, 1600000000));
+    }
+
+    TEST_F(TestCCEvalCache, testUpgradeBetweenValidations)
+    {
+        // TOKEL activates the mixed mode upgrade by timestamp
+        CCUpgrades::SelectUpgrades("TOKEL");
+        int64_t nActivation = CCUpgrades::CCMIXEDMODE_SUBVER_1_TOKEL_TIMESTAMP;
+        int32_t nHeight = CCUpgrades::CCASSETS_OPDROP_FIX_TOKEL_HEIGHT + 1;
+        uint256 txid = GetRandHash(), tip = GetRandHash();
+        CCEvalCacheSet(txid, 0, EVAL_TOKENSV2, tip, nHeight, nActivation - 10);
+
+        EXPECT_TRUE(CCEvalCacheGet(txid, 0, EVAL_TOKENSV2, tip, nHeight, nActivation - 1));
+        EXPECT_FALSE(CCEvalCacheGet(txid, 0, EVAL_TOKENSV2, tip, nHeight, nActivation));
+    }
+}
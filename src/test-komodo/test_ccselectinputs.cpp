@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include "cc/CCinclude.h"
+
+namespace TestCCSelectInputs {
+
+    TEST(TestCCSelectInputs, testExactMatch)
+    {
+        std::vector<CAmount> values = { 5, 10, 20 };
+        CAmount totalinputs;
+        std::vector<int32_t> picked = CC_selectinputs(values, 10, 10, totalinputs);
+        ASSERT_EQ(1, picked.size());
+        EXPECT_EQ(1, picked[0]);
+        EXPECT_EQ(10, totalinputs);
+    }
+
+    TEST(TestCCSelectInputs, testSmallestAbove)
+    {
+        std::vector<CAmount> values = { 50, 12, 30, 11 };
+        CAmount totalinputs;
+        std::vector<int32_t> picked = CC_selectinputs(values, 10, 10, totalinputs);
+        ASSERT_EQ(1, picked.size());
+        EXPECT_EQ(3, picked[0]);
+        EXPECT_EQ(11, totalinputs);
+    }
+
+    TEST(TestCCSelectInputs, testLargestBelow)
+    {
+        // nothing covers 25: take 10, then the smallest covering the remaining 15 is 20
+        std::vector<CAmount> values = { 3, 10, 20, 0, -5 };
+        CAmount totalinputs;
+        std::vector<int32_t> picked = CC_selectinputs(values, 25, 10, totalinputs);
+        ASSERT_EQ(2, picked.size());
+        EXPECT_EQ(2, picked[0]);
+        EXPECT_EQ(1, picked[1]);
+        EXPECT_EQ(30, totalinputs);
+    }
+
+    TEST(TestCCSelectInputs, testMaxInputs)
+    {
+        std::vector<CAmount> values(1000, 1);
+        CAmount totalinputs;
+        std::vector<int32_t> picked = CC_selectinputs(values, 500, 100, totalinputs);
+        EXPECT_EQ(100, picked.size());
+        EXPECT_EQ(100, totalinputs);
+
+        picked = CC_selectinputs(values, 2000, 1024, totalinputs);
+        EXPECT_EQ(1000, picked.size());
+        EXPECT_EQ(1000, totalinputs);
+    }
+
+    TEST(TestCCSelectInputs, testNoCandidates)
+    {
+        std::vector<CAmount> values = { 0, -1 };
+        CAmount totalinputs;
+        EXPECT_TRUE(CC_selectinputs(values, 10, 10, totalinputs).empty());
+        EXPECT_EQ(0, totalinputs);
+    }
+}
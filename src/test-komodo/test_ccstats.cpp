@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include "cc/CCstats.h"
+
+namespace TestCCStats {
+
+    class TestCCStats : public ::testing::Test {
+    protected:
+        virtual void SetUp() { CCStatsClear(); }
+        virtual void TearDown() { CCStatsClear(); }
+    };
+
+    TEST_F(TestCCStats, testRecord)
+    {
+        CCStatsRecord(0xf2, 'c', true, true, 100, 2, 1);
+        CCStatsRecord(0xf2, 'c', false, false, 300, 1, 0);
+        CCStatsRecord(0xf2, 't', false, true, 10, 0, 0);
+
+        std::vector<CCStatsEntry> entries = CCStatsGet();
+        ASSERT_EQ(2, entries.size());
+        const CCStatsEntry &entry = entries[0];
+        EXPECT_EQ(0xf2, entry.evalcode);
+        EXPECT_EQ('c', entry.funcid);
+        EXPECT_EQ(2, entry.Count());
+        EXPECT_EQ(1, entry.nMempool);
+        EXPECT_EQ(1, entry.nBlock);
+        EXPECT_EQ(1, entry.nFailed);
+        EXPECT_EQ(400, entry.nTotalMicros);
+        EXPECT_EQ(300, entry.nMaxMicros);
+        EXPECT_EQ(3, entry.nTxFetches);
+        EXPECT_EQ(1, entry.nDBLookups);
+        EXPECT_EQ('t', entries[1].funcid);
+
+        CCStatsClear();
+        EXPECT_TRUE(CCStatsGet().empty());
+    }
+
+    TEST_F(TestCCStats, testPercentile)
+    {
+        for (int i = 0; i < 99; i++)
+            CCStatsRecord(0xf2, 0, false, true, 5, 0, 0);
+        CCStatsRecord(0xf2, 0, false, true, 5000, 0, 0);
+
+        std::vector<CCStatsEntry> entries = CCStatsGet();
+        ASSERT_EQ(1, entries.size());
+        EXPECT_EQ(8, entries[0].Percentile(0.5));      // 5us falls in the [4, 8) bucket
+        EXPECT_EQ(8, entries[0].Percentile(0.99));
+        EXPECT_EQ(5000, entries[0].Percentile(1.0));   // bounded by the max
+    }
+
+    TEST_F(TestCCStats, testThreadCounters)
+    {
+        uint64_t nTxFetches = CCStatsThreadTxFetches(), nDBLookups = CCStatsThreadDBLookups();
+        CCStatsCountTxFetch();
+        CCStatsCountDBLookup();
+        CCStatsCountDBLookup();
+        EXPECT_EQ(1, CCStatsThreadTxFetches() - nTxFetches);
+        EXPECT_EQ(2, CCStatsThreadDBLookups() - nDBLookups);
+    }
+}
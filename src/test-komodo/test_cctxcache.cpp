@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include "cc/CCtxcache.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "random.h"
+#include "uint256.h"
+#include "util.h"
+
+namespace TestCCTxCache {
+
+    class TestCCTxCache : public ::testing::Test {
+    protected:
+        virtual void SetUp() { CCTxCacheClear(); }
+        virtual void TearDown() { CCTxCacheClear(); mapArgs.erase("-maxcctxcachesize"); }
+    };
+
+    static CTransaction MakeTx(uint32_t nLockTime)
+    {
+        CMutableTransaction mtx;
+        mtx.nLockTime = nLockTime;
+        return CTransaction(mtx);
+    }
+
+    TEST_F(TestCCTxCache, testGetSet)
+    {
+        CTransaction tx = MakeTx(1), txOut;
+        uint256 hashBlock = GetRandHash(), hashBlockOut;
+        int32_t nHeight;
+
+        EXPECT_FALSE(CCTxCacheGet(tx.GetHash(), txOut, hashBlockOut, nHeight));
+        CCTxCacheSet(tx, hashBlock, 100);
+        ASSERT_TRUE(CCTxCacheGet(tx.GetHash(), txOut, hashBlockOut, nHeight));
+        EXPECT_EQ(tx.GetHash(), txOut.GetHash());
+        EXPECT_EQ(hashBlock, hashBlockOut);
+        EXPECT_EQ(100, nHeight);
+
+        // unconfirmed txs are not cached
+        CTransaction tx2 = MakeTx(2);
+        CCTxCacheSet(tx2, uint256(), 0);
+        EXPECT_FALSE(CCTxCacheGet(tx2.GetHash(), txOut, hashBlockOut, nHeight));
+    }
+
+    TEST_F(TestCCTxCache, testEraseBlock)
+    {
+        CBlock block;
+        block.vtx.push_back(MakeTx(1));
+        block.vtx.push_back(MakeTx(2));
+        CTransaction other = MakeTx(3), txOut;
+        uint256 hashBlockOut;
+        int32_t nHeight;
+
+        CCTxCacheSet(block.vtx[0], block.GetHash(), 0);
+        CCTxCacheSet(block.vtx[1], block.GetHash(), 0);
+        CCTxCacheSet(other, GetRandHash(), 0);
+        CCTxCacheEraseBlock(block);
+
+        EXPECT_FALSE(CCTxCacheGet(block.vtx[0].GetHash(), txOut, hashBlockOut, nHeight));
+        EXPECT_FALSE(CCTxCacheGet(block.vtx[1].GetHash(), txOut, hashBlockOut, nHeight));
+        EXPECT_TRUE(CCTxCacheGet(other.GetHash(), txOut, hashBlockOut, nHeight));
+    }
+
+    TEST_F(TestCCTxCache, testLeastRecentlyUsedEvicted)
+    {
+        mapArgs["-maxcctxcachesize"] = "2";
+        CTransaction tx1 = MakeTx(1), tx2 = MakeTx(2), tx3 = MakeTx(3), txOut;
+        uint256 hashBlockOut;
+        int32_t nHeight;
+
+        CCTxCacheSet(tx1, GetRandHash(), 0);
+        CCTxCacheSet(tx2, GetRandHash(), 0);
+        EXPECT_TRUE(CCTxCacheGet(tx1.GetHash(), txOut, hashBlockOut, nHeight));
+        CCTxCacheSet(tx3, GetRandHash(), 0);
+
+        EXPECT_TRUE(CCTxCacheGet(tx1.GetHash(), txOut, hashBlockOut, nHeight));
+        EXPECT_FALSE(CCTxCacheGet(tx2.GetHash(), txOut, hashBlockOut, nHeight));
+        EXPECT_TRUE(CCTxCacheGet(tx3.GetHash(), txOut, hashBlockOut, nHeight));
+    }
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include "chain.h"
+
+#include <deque>
+
+namespace TestChainLogicalTimes {
+
+    static CBlockIndex *AddBlock(std::deque<CBlockIndex> &blocks, CBlockIndex *pprev, unsigned int nTime)
+    {
+        blocks.push_back(CBlockIndex());
+        CBlockIndex *pindex = &blocks.back();
+        pindex->pprev = pprev;
+        pindex->SetHeight(pprev == NULL ? 0 : pprev->GetHeight() + 1);
+        pindex->nTime = nTime;
+        return pindex;
+    }
+
+    TEST(TestChainLogicalTimes, testFindRange)
+    {
+        std::deque<CBlockIndex> blocks;
+        CChain chain;
+        CChainLogicalTimes times;
+
+        // the block at height 3 is older than its parent, its logical timestamp is 1201
+        CBlockIndex *pindex = AddBlock(blocks, NULL, 900);
+        const unsigned int nTimes[] = {1000, 1200, 1100, 1300};
+        for (unsigned int nTime : nTimes)
+            pindex = AddBlock(blocks, pindex, nTime);
+        chain.SetTip(pindex);
+        times.SetTip(chain);
+        EXPECT_EQ(times.Get(3), 1201U);
+
+        int nBegin, nEnd;
+        times.FindRange(1000, 1300, nBegin, nEnd);
+        EXPECT_EQ(nBegin, 1);
+        EXPECT_EQ(nEnd, 4);
+        // the genesis block is not in the timestamp index
+        times.FindRange(0, 1000, nBegin, nEnd);
+        EXPECT_EQ(nBegin, nEnd);
+        times.FindRange(1201, 2000, nBegin, nEnd);
+        EXPECT_EQ(nBegin, 3);
+        EXPECT_EQ(nEnd, 5);
+
+        // a reorg from height 2 replaces the later timestamps
+        CBlockIndex *pfork = AddBlock(blocks, chain[2], 1500);
+        pfork = AddBlock(blocks, pfork, 1400);
+        chain.SetTip(pfork);
+        times.SetTip(chain);
+        EXPECT_EQ(times.Get(3), 1500U);
+        EXPECT_EQ(times.Get(4), 1501U);
+        times.FindRange(1300, 1501, nBegin, nEnd);
+        EXPECT_EQ(nBegin, 3);
+        EXPECT_EQ(nEnd, 4);
+
+        times.Clear();
+        EXPECT_TRUE(times.IsEmpty());
+    }
+
+}
@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+#include "coins.h"
+#include "crypto/muhash.h"
+#include "dbwrapper.h"
+#include "random.h"
+#include "streams.h"
+#include "txdb.h"
+
+#include <boost/scoped_ptr.hpp>
+
+namespace TestCoinsStats {
+
+    static bool WriteCoins(CCoinsViewDB &view, const uint256 &txid, const CCoins &coins, unsigned char flags, const uint256 &hashBlock)
+    {
+        CCoinsMap mapCoins;
+        CAnchorsSproutMap mapSproutAnchors;
+        CAnchorsSaplingMap mapSaplingAnchors;
+        CNullifiersMap mapSproutNullifiers, mapSaplingNullifiers;
+
+        CCoinsCacheEntry &entry = mapCoins[txid];
+        entry.coins = coins;
+        entry.flags = flags;
+        return view.BatchWrite(mapCoins, hashBlock, uint256(), uint256(), mapSproutAnchors, mapSaplingAnchors, mapSproutNullifiers, mapSaplingNullifiers);
+    }
+
+    static void ExpectSameStats(const CCoinsStats &a, const CCoinsStats &b)
+    {
+        EXPECT_EQ(a.hashBlock, b.hashBlock);
+        EXPECT_EQ(a.nTransactions, b.nTransactions);
+        EXPECT_EQ(a.nTransactionOutputs, b.nTransactionOutputs);
+        EXPECT_EQ(a.nSerializedSize, b.nSerializedSize);
+        EXPECT_EQ(a.nTotalAmount, b.nTotalAmount);
+        EXPECT_EQ(a.hashMuHash, b.hashMuHash);
+    }
+
+    TEST(TestCoinsStats, testMuHash)
+    {
+        const unsigned char a[] = "a", b[] = "b";
+        unsigned char hash1[MuHash3072::OUTPUT_SIZE], hash2[MuHash3072::OUTPUT_SIZE], hashEmpty[MuHash3072::OUTPUT_SIZE];
+
+        MuHash3072 set1, set2, empty;
+        set1.Insert(a, 1);
+        set1.Insert(b, 1);
+        set2.Insert(b, 1);
+        set2.Insert(a, 1);
+        set1.Finalize(hash1);
+        set2.Finalize(hash2);
+        EXPECT_EQ(memcmp(hash1, hash2, sizeof(hash1)), 0);
+
+        set1.Remove(a, 1);
+        set1.Remove(b, 1);
+        set1.Finalize(hash1);
+        empty.Finalize(hashEmpty);
+        EXPECT_EQ(memcmp(hash1, hashEmpty, sizeof(hash1)), 0);
+        EXPECT_NE(memcmp(hash2, hashEmpty, sizeof(hash2)), 0);
+    }
+
+    TEST(TestCoinsStats, testRunningStats)
+    {
+        CCoinsViewDB view(1 << 20, true);
+        ASSERT_TRUE(view.InitRunningStats());
+
+        uint256 txidA = GetRandHash(), txidB = GetRandHash(), hashBlock1 = GetRandHash(), hashBlock2 = GetRandHash();
+        CCoins coinsA, coinsB;
+        coinsA.nHeight = 10;
+        coinsA.vout.resize(3);
+        for (int i = 0; i < 3; i++) {
+            coinsA.vout[i].nValue = 1000 * (i + 1);
+            coinsA.vout[i].scriptPubKey = CScript() << OP_TRUE;
+        }
+        coinsB.nHeight = 11;
+        coinsB.fCoinBase = true;
+        coinsB.vout.resize(1);
+        coinsB.vout[0].nValue = 50000;
+        ASSERT_TRUE(WriteCoins(view, txidA, coinsA, CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH, hashBlock1));
+        ASSERT_TRUE(WriteCoins(view, txidB, coinsB, CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH, hashBlock1));
+
+        // spend an output of A, then all of B
+        coinsA.Spend(1);
+        ASSERT_TRUE(WriteCoins(view, txidA, coinsA, CCoinsCacheEntry::DIRTY, hashBlock2));
+        coinsB.Spend(0);
+        ASSERT_TRUE(WriteCoins(view, txidB, coinsB, CCoinsCacheEntry::DIRTY, hashBlock2));
+
+        CCoinsStats running, scanned;
+        ASSERT_TRUE(view.GetStats(running));
+        ASSERT_TRUE(view.ScanStats(scanned));
+        EXPECT_TRUE(running.hashSerialized.IsNull());
+        EXPECT_EQ(running.hashBlock, hashBlock2);
+        EXPECT_EQ(running.nTransactions, 1U);
+        EXPECT_EQ(running.nTransactionOutputs, 2U);
+        EXPECT_EQ(running.nTotalAmount, 4000);
+        ExpectSameStats(running, scanned);
+    }
+
+    // the number of database records whose key starts with prefix
+    static size_t CountRecords(const CCoinsViewDB &view, char prefix)
+    {
+        size_t n = 0;
+        boost::scoped_ptr<CDBIterator> pcursor(view.RawCursor());
+        for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next())
+            if (pcursor->GetRawKey()[0] == prefix)
+                n++;
+        return n;
+    }
+
+    static CCoins MakeCoins(int nHeight, int nOutputs)
+    {
+        CCoins coins;
+        coins.nHeight = nHeight;
+        coins.nVersion = 4;
+        coins.vout.resize(nOutputs);
+        for (int i = 0; i < nOutputs; i++) {
+            coins.vout[i].nValue = 1000 * (i + 1);
+            coins.vout[i].scriptPubKey = CScript() << OP_TRUE;
+        }
+        return coins;
+    }
+
+    TEST(TestCoinsStats, testPerOutputRecords)
+    {
+        CCoinsViewDB view(1 << 20, true);
+        ASSERT_TRUE(view.InitRunningStats());
+        EXPECT_FALSE(view.HasLegacyCoins());
+
+        uint256 txid = GetRandHash();
+        CCoins coins = MakeCoins(20, 5);
+        ASSERT_TRUE(WriteCoins(view, txid, coins, CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH, GetRandHash()));
+        EXPECT_EQ(CountRecords(view, 'C'), 5U);
+        EXPECT_EQ(CountRecords(view, 'c'), 0U);
+
+        // spending an output only erases its record
+        coins.Spend(2);
+        coins.Spend(4);
+        ASSERT_TRUE(WriteCoins(view, txid, coins, CCoinsCacheEntry::DIRTY, GetRandHash()));
+        EXPECT_EQ(CountRecords(view, 'C'), 3U);
+
+        CCoins read;
+        ASSERT_TRUE(view.GetCoins(txid, read));
+        EXPECT_TRUE(read == coins);
+        ASSERT_EQ(read.vout.size(), 4U);
+        EXPECT_FALSE(read.IsAvailable(2));
+        EXPECT_TRUE(view.HaveCoins(txid));
+        EXPECT_FALSE(view.HaveCoins(GetRandHash()));
+
+        CCoinsStats running, scanned;
+        ASSERT_TRUE(view.GetStats(running));
+        ASSERT_TRUE(view.ScanStats(scanned));
+        ExpectSameStats(running, scanned);
+
+        coins.Spend(0);
+        coins.Spend(1);
+        coins.Spend(3);
+        ASSERT_TRUE(WriteCoins(view, txid, coins, CCoinsCacheEntry::DIRTY, GetRandHash()));
+        EXPECT_EQ(CountRecords(view, 'C'), 0U);
+        EXPECT_FALSE(view.HaveCoins(txid));
+        EXPECT_FALSE(view.GetCoins(txid, read));
+    }
+
+    TEST(TestCoinsStats, testUpgradeCoinsFormat)
+    {
+        CCoinsViewDB view(1 << 20, true);
+        uint256 txidA = GetRandHash(), txidB = GetRandHash();
+        CCoins coinsA = MakeCoins(30, 3), coinsB = MakeCoins(31, 300);
+        coinsB.Spend(7);
+
+        // coins as an older version wrote them, a record per transaction
+        std::vector<std::pair<std::string, std::string> > entries;
+        for (int i = 0; i < 2; i++) {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION), ssValue(SER_DISK, CLIENT_VERSION);
+            ssKey << std::make_pair('c', i == 0 ? txidA : txidB);
+            ssValue << (i == 0 ? coinsA : coinsB);
+            entries.push_back(std::make_pair(ssKey.str(), ssValue.str()));
+        }
+        ASSERT_TRUE(view.WriteRaw(entries, GetRandHash()));
+        ASSERT_TRUE(view.HasLegacyCoins());
+        ASSERT_TRUE(view.InitRunningStats());
+
+        CCoins read;
+        ASSERT_TRUE(view.GetCoins(txidA, read));
+        EXPECT_TRUE(read == coinsA);
+        CCoinsStats before;
+        ASSERT_TRUE(view.ScanStats(before));
+
+        ASSERT_TRUE(view.UpgradeCoinsFormat());
+        EXPECT_FALSE(view.HasLegacyCoins());
+        EXPECT_EQ(CountRecords(view, 'c'), 0U);
+        EXPECT_EQ(CountRecords(view, 'C'), 3U + 299U);
+        ASSERT_TRUE(view.GetCoins(txidB, read));
+        EXPECT_TRUE(read == coinsB);
+
+        CCoinsStats after, running;
+        ASSERT_TRUE(view.ScanStats(after));
+        ExpectSameStats(before, after);
+        EXPECT_EQ(before.hashSerialized, after.hashSerialized);
+        ASSERT_TRUE(view.GetStats(running));
+        ExpectSameStats(running, after);
+    }
+
+}
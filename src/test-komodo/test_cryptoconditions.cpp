@@ -198,3 +198,28 @@ TEST_F(CCTest, testLargeCondition)
     EXPECT_EQ(1744, CCSig(cond).size());
     ASSERT_TRUE(CCVerify(mtxTo, cond));
 }
+
+
+TEST_F(CCTest, testReadFulfillmentCached)
+{
+    CCDecodeCacheClear();
+    CMutableTransaction mtxTo;
+    CC *cond = CCNewThreshold(1, {CCNewSecp256k1(notaryKey.GetPubKey())});
+    CCSign(mtxTo, cond);
+
+    std::vector<unsigned char> ffillBin;
+    GetPushData(mtxTo.vin[0].scriptSig, ffillBin);
+    for (int i = 0; i < 2; i++) {  // decoded, then copied from the cache
+        CC *decoded = CCReadFulfillmentCached(ffillBin.data(), ffillBin.size()-1, false);
+        ASSERT_TRUE(decoded != NULL);
+        EXPECT_EQ(CCSig(cond), CCSig(decoded));
+        cc_free(decoded);
+    }
+
+    // undecodable binaries are cached as NULL
+    ffillBin[1] ^= 0xff;
+    EXPECT_TRUE(CCReadFulfillmentCached(ffillBin.data(), ffillBin.size()-1, false) == NULL);
+    EXPECT_TRUE(CCReadFulfillmentCached(ffillBin.data(), ffillBin.size()-1, false) == NULL);
+    cc_free(cond);
+    CCDecodeCacheClear();
+}
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include "dbwrapper.h"
+#include "util.h"
+
+namespace TestDBTune {
+
+    static const CDBStats *FindStats(const std::vector<CDBStats> &vStats, const std::string &strName)
+    {
+        for (const CDBStats &stats : vStats)
+            if (stats.strName == strName)
+                return &stats;
+        return NULL;
+    }
+
+    TEST(TestDBTune, testTuningAndStats)
+    {
+        std::vector<std::string> vTuneSaved = mapMultiArgs["-dbtune"];
+        mapMultiArgs["-dbtune"] = {"dbtunetest:cache=2", "dbtunetest:bloombits=0", "dbtunetest:blocksize=16", "other:writebuffer=5", "malformed"};
+        {
+            CDBWrapper db(GetTempPath() / "blocks" / "dbtunetest", 1 << 20, true, false, true);
+            for (int i = 0; i < 100; i++)
+                ASSERT_TRUE(db.Write(i, std::string(100, 'x')));
+
+            std::vector<CDBStats> vStats = GetDBStats();
+            const CDBStats *pstats = FindStats(vStats, "blocks/dbtunetest");
+            ASSERT_TRUE(pstats != NULL);
+            EXPECT_EQ(pstats->tuning.nBlockCache, (size_t)2 << 20);
+            EXPECT_EQ(pstats->tuning.nWriteBuffer, (size_t)(1 << 20) / 4);
+            EXPECT_EQ(pstats->tuning.nBlockSize, (size_t)16 << 10);
+            EXPECT_EQ(pstats->tuning.nBloomBits, 0);
+            EXPECT_TRUE(pstats->tuning.fCompression);
+        }
+        // closed databases are not reported
+        EXPECT_TRUE(FindStats(GetDBStats(), "blocks/dbtunetest") == NULL);
+        mapMultiArgs["-dbtune"] = vTuneSaved;
+    }
+
+    TEST(TestDBTune, testSharedCache)
+    {
+        size_t nBudget = 0, nUsage = 0;
+        if (!GetSharedDBCacheUsage(nBudget, nUsage)) {
+            InitSharedDBCache(4 << 20);
+            ASSERT_TRUE(GetSharedDBCacheUsage(nBudget, nUsage));
+        }
+        std::vector<std::string> vTuneSaved = mapMultiArgs["-dbtune"];
+        mapMultiArgs["-dbtune"] = {"owncache:cache=1"};
+        {
+            CDBWrapper shared(GetTempPath() / "sharedcache", 1 << 20, true);
+            CDBWrapper own(GetTempPath() / "owncache", 1 << 20, true);
+
+            std::vector<CDBStats> vStats = GetDBStats();
+            const CDBStats *pshared = FindStats(vStats, "sharedcache"), *pown = FindStats(vStats, "owncache");
+            ASSERT_TRUE(pshared != NULL && pown != NULL);
+            EXPECT_TRUE(pshared->tuning.fSharedCache);
+            EXPECT_EQ(pshared->tuning.nBlockCache, nBudget);
+            EXPECT_FALSE(pown->tuning.fSharedCache);
+            EXPECT_EQ(pown->tuning.nBlockCache, (size_t)1 << 20);
+        }
+        mapMultiArgs["-dbtune"] = vTuneSaved;
+    }
+
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include "sync.h"
+#include "utiltime.h"
+
+#include <boost/thread.hpp>
+
+namespace TestLockProfile {
+
+    class TestLockProfile : public ::testing::Test {
+    protected:
+        virtual void SetUp() { ResetLockProfile(); EnableLockProfile(true); }
+        virtual void TearDown() { EnableLockProfile(false); ResetLockProfile(); }
+    };
+
+    static const CLockProfileSite* FindSite(const std::vector<CLockProfileSite>& sites, int nLine)
+    {
+        for (const CLockProfileSite& site : sites)
+            if (site.line == nLine && site.file == __FILE__)
+                return &site;
+        return NULL;
+    }
+
+    TEST_F(TestLockProfile, testCounts)
+    {
+        CCriticalSection cs;
+        int nLine = 0;
+        for (int i = 0; i < 3; i++) {
+            LOCK(cs); nLine = __LINE__;
+        }
+
+        std::vector<CLockProfileSite> sites = GetLockProfile();
+        const CLockProfileSite* site = FindSite(sites, nLine);
+        ASSERT_TRUE(site != NULL);
+        EXPECT_EQ(site->name, "cs");
+        EXPECT_EQ(site->nLocks, 3U);
+        EXPECT_EQ(site->nContended, 0U);
+        EXPECT_EQ(site->waitBuckets[0], 3U);
+        uint64_t nHolds = 0;
+        for (int i = 0; i < LOCKPROFILE_BUCKETS; i++)
+            nHolds += site->holdBuckets[i];
+        EXPECT_EQ(nHolds, 3U);
+
+        ResetLockProfile();
+        sites = GetLockProfile();
+        site = FindSite(sites, nLine);
+        ASSERT_TRUE(site != NULL);
+        EXPECT_EQ(site->nLocks, 0U);
+    }
+
+    TEST_F(TestLockProfile, testContention)
+    {
+        CCriticalSection cs;
+        CSemaphore locked(0);
+        boost::thread holder([&cs, &locked]() {
+            LOCK(cs);
+            locked.post();
+            MilliSleep(50);
+        });
+        locked.wait();
+        int nLine;
+        {
+            LOCK(cs); nLine = __LINE__;
+        }
+        holder.join();
+
+        std::vector<CLockProfileSite> sites = GetLockProfile();
+        const CLockProfileSite* site = FindSite(sites, nLine);
+        ASSERT_TRUE(site != NULL);
+        EXPECT_EQ(site->nLocks, 1U);
+        EXPECT_EQ(site->nContended, 1U);
+        EXPECT_GT(site->nMaxWaitMicros, 10000);
+        EXPECT_EQ(site->nWaitMicros, site->nMaxWaitMicros);
+    }
+
+    TEST_F(TestLockProfile, testDisabled)
+    {
+        EnableLockProfile(false);
+        CCriticalSection cs;
+        int nLine;
+        {
+            LOCK(cs); nLine = __LINE__;
+        }
+        std::vector<CLockProfileSite> sites = GetLockProfile();
+        EXPECT_TRUE(FindSite(sites, nLine) == NULL);
+    }
+}
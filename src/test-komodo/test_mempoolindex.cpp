@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include "mempoolindex.h"
+#include "random.h"
+
+#include <map>
+
+namespace TestMempoolIndex {
+
+    typedef CMempoolIndexMap<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyHasher> AddressIndexMap;
+    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> AddressIndexRef;
+
+    static void ExpectSameGroups(const AddressIndexMap &index, const AddressIndexRef &ref, const std::vector<uint160> &addrs)
+    {
+        for (int type = 1; type <= 2; type++) {
+            for (const uint160 &addr : addrs) {
+                std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > results;
+                index.GetGroup(std::make_pair(addr, type), results);
+                size_t n = 0;
+                for (const auto &entry : ref)
+                    if (entry.first.type == type && entry.first.addressBytes == addr)
+                        n++;
+                EXPECT_EQ(n, results.size());
+                for (const auto &result : results) {
+                    AddressIndexRef::const_iterator it = ref.find(result.first);
+                    ASSERT_TRUE(it != ref.end());
+                    EXPECT_EQ(it->second.time, result.second.time);
+                }
+            }
+        }
+    }
+
+    TEST(TestMempoolIndex, testGroupedMap)
+    {
+        AddressIndexMap index;
+        AddressIndexRef ref;
+        std::vector<uint160> addrs;
+        std::vector<CMempoolAddressDeltaKey> keys;
+
+        for (int i = 0; i < 5; i++)
+            addrs.push_back(uint160(std::vector<unsigned char>(20, (unsigned char)i)));
+
+        for (int i = 0; i < 20000; i++) {
+            if (insecure_rand() % 3 != 0 || keys.empty()) {
+                CMempoolAddressDeltaKey key(1 + insecure_rand() % 2, addrs[insecure_rand() % addrs.size()], GetRandHash(), insecure_rand() % 4, insecure_rand() % 2);
+                CMempoolAddressDelta delta(i, i);
+                EXPECT_EQ(ref.insert(std::make_pair(key, delta)).second, index.insert(key, delta));
+                keys.push_back(key);
+            } else {
+                // erase from anywhere in the group lists
+                size_t n = insecure_rand() % keys.size();
+                EXPECT_EQ(ref.erase(keys[n]) != 0, index.erase(keys[n]));
+                keys[n] = keys.back();
+                keys.pop_back();
+            }
+        }
+        EXPECT_EQ(ref.size(), index.size());
+        ExpectSameGroups(index, ref, addrs);
+
+        for (const CMempoolAddressDeltaKey &key : keys) {
+            ASSERT_TRUE(index.find(key) != NULL);
+            EXPECT_TRUE(index.erase(key));
+            EXPECT_FALSE(index.erase(key));
+            EXPECT_TRUE(index.find(key) == NULL);
+        }
+        EXPECT_EQ(0U, index.size());
+        ref.clear();
+        ExpectSameGroups(index, ref, addrs);
+    }
+}
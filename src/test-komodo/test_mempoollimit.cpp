@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include "main.h"
+#include "random.h"
+#include "txmempool.h"
+
+namespace TestMempoolLimit {
+
+    static CTransaction MakeTx(const uint256 &prevhash, uint32_t n)
+    {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(prevhash, n);
+        mtx.vout.resize(1);
+        mtx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        mtx.vout[0].nValue = COIN;
+        return CTransaction(mtx);
+    }
+
+    static void AddTx(CTxMemPool &pool, const CTransaction &tx, CAmount nFee)
+    {
+        CTxMemPoolEntry entry(tx, nFee, GetTime(), 0.0, 1, pool.HasNoInputsOf(tx), false, 0);
+        pool.addUnchecked(tx.GetHash(), entry, false);
+    }
+
+    TEST(TestMempoolLimit, testEvictLowestPackage)
+    {
+        CTxMemPool pool(CFeeRate(0));
+
+        CTransaction txLow = MakeTx(GetRandHash(), 0);
+        CTransaction txHigh = MakeTx(GetRandHash(), 0);
+        CTransaction txParent = MakeTx(GetRandHash(), 0);
+        CTransaction txChild = MakeTx(txParent.GetHash(), 0);
+        AddTx(pool, txLow, 1000);
+        AddTx(pool, txHigh, 100000);
+        AddTx(pool, txParent, 0);
+        AddTx(pool, txChild, 400000);
+        EXPECT_EQ(0, pool.GetMinFee(1).GetFeePerK());
+
+        // the parent pays nothing but its child pays for both, so the low fee tx goes first
+        pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+        EXPECT_FALSE(pool.exists(txLow.GetHash()));
+        EXPECT_TRUE(pool.exists(txHigh.GetHash()));
+        EXPECT_TRUE(pool.exists(txParent.GetHash()));
+        EXPECT_TRUE(pool.exists(txChild.GetHash()));
+
+        size_t nSize = ::GetSerializeSize(txLow, SER_NETWORK, PROTOCOL_VERSION);
+        CAmount nMinFee = CFeeRate(1000, nSize).GetFeePerK() + ::minRelayTxFee.GetFeePerK();
+        EXPECT_EQ(nMinFee, pool.GetMinFee(1).GetFeePerK());
+
+        pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+        EXPECT_FALSE(pool.exists(txHigh.GetHash()));
+        EXPECT_TRUE(pool.exists(txParent.GetHash()));
+
+        // the package is evicted as a whole
+        pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+        EXPECT_FALSE(pool.exists(txParent.GetHash()));
+        EXPECT_FALSE(pool.exists(txChild.GetHash()));
+        EXPECT_EQ(0U, pool.size());
+        EXPECT_EQ(0U, pool.DynamicMemoryUsage());
+        EXPECT_GT(pool.GetMinFee(1).GetFeePerK(), nMinFee);
+    }
+
+    TEST(TestMempoolLimit, testRollingFeeDecay)
+    {
+        CTxMemPool pool(CFeeRate(0));
+
+        CTransaction tx = MakeTx(GetRandHash(), 0);
+        AddTx(pool, tx, 50000);
+        pool.TrimToSize(0);
+        CAmount nMinFee = pool.GetMinFee(1000000).GetFeePerK();
+        EXPECT_GT(nMinFee, 0);
+
+        // the minimum fee only decays once a block is found after the bump
+        SetMockTime(GetTime() + CTxMemPool::ROLLING_FEE_HALFLIFE);
+        EXPECT_EQ(nMinFee, pool.GetMinFee(1000000).GetFeePerK());
+        std::list<CTransaction> conflicts;
+        pool.removeForBlock(std::vector<CTransaction>(), 1, conflicts, false);
+        SetMockTime(GetTime() + CTxMemPool::ROLLING_FEE_HALFLIFE / 4);
+        // an empty pool decays with a quarter of the half life
+        EXPECT_EQ(nMinFee / 2, pool.GetMinFee(1000000).GetFeePerK());
+        SetMockTime(0);
+    }
+}
@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+
+#include "komodo_structs.h"
+
+
+extern int32_t komodo_notaries(uint8_t pubkeys[64][33],int32_t height,uint32_t timestamp);
+
+
+namespace TestNotarySet {
+
+    TEST(TestNotarySet, testSeasonSetsMatchNotaries)
+    {
+        for (int32_t s = 0; s < NUM_KMD_SEASONS; s++)
+        {
+            int32_t height = KMD_SEASON_HEIGHTS[s];
+            const struct komodo_notaryset *ns = komodo_notaryset_get(height, 0);
+            ASSERT_TRUE(ns != 0);
+            EXPECT_EQ(ns->season, s+1);
+            EXPECT_EQ(ns, komodo_notaryset_get(height, 0));
+
+            uint8_t pubkeys[64][33];
+            int32_t n = komodo_notaries(pubkeys, height, 0);
+            ASSERT_EQ(n, ns->numnotaries);
+            for (int32_t i = 0; i < n; i++)
+            {
+                EXPECT_EQ(0, memcmp(pubkeys[i], ns->pubkeys[i], 33));
+                EXPECT_EQ(i, komodo_notaryset_find(ns, 0, 0, pubkeys[i]));
+                EXPECT_EQ(i, komodo_notaryset_find(0, pubkeys, n, pubkeys[i]));
+                int32_t numnotaries = 0;
+                EXPECT_EQ(i, komodo_electednotary(&numnotaries, pubkeys[i], height, 0));
+                EXPECT_EQ(n, numnotaries);
+            }
+        }
+    }
+
+    TEST(TestNotarySet, testUnknownPubkey)
+    {
+        uint8_t pubkey33[33];
+        memset(pubkey33, 0x02, sizeof(pubkey33));
+        const struct komodo_notaryset *ns = komodo_notaryset_get(KMD_SEASON_HEIGHTS[0], 0);
+        ASSERT_TRUE(ns != 0);
+        EXPECT_EQ(-1, komodo_notaryset_find(ns, 0, 0, pubkey33));
+    }
+
+    TEST(TestNotarySet, testPreHardcodedHeight)
+    {
+        EXPECT_TRUE(komodo_notaryset_get(KOMODO_NOTARIES_HARDCODED-1, 0) == 0);
+    }
+
+}
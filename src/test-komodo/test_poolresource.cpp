@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include "coins.h"
+#include "random.h"
+#include "support/allocators/pool.h"
+#include "uint256.h"
+
+#include <map>
+
+namespace TestPoolResource {
+
+    TEST(TestPoolResource, testReuseFreedChunks)
+    {
+        PoolResource<64, 8> resource(1024);
+        EXPECT_EQ(resource.NumBlocks(), 0U);
+
+        void *p = resource.Allocate(24, 8);
+        EXPECT_EQ(resource.NumBlocks(), 1U);
+        resource.Deallocate(p, 24, 8);
+        EXPECT_EQ(resource.Allocate(24, 8), p);
+
+        // a whole block of chunks of one size, then the next block
+        std::vector<void*> chunks;
+        for (int i = 0; i < 1024 / 32 + 1; i++)
+            chunks.push_back(resource.Allocate(32, 8));
+        EXPECT_EQ(resource.NumBlocks(), 2U);
+        size_t nUsage = resource.DynamicMemoryUsage();
+        for (void *chunk : chunks)
+            resource.Deallocate(chunk, 32, 8);
+        for (int i = 0; i < 1024 / 32 + 1; i++)
+            resource.Allocate(32, 8);
+        EXPECT_EQ(resource.NumBlocks(), 2U);
+        EXPECT_EQ(resource.DynamicMemoryUsage(), nUsage);
+    }
+
+    TEST(TestPoolResource, testOversize)
+    {
+        PoolResource<64, 8> resource(1024);
+        void *p = resource.Allocate(200, 8);
+        EXPECT_EQ(resource.NumBlocks(), 0U);
+        EXPECT_GE(resource.DynamicMemoryUsage(), 200U);
+        resource.Deallocate(p, 200, 8);
+        EXPECT_EQ(resource.DynamicMemoryUsage(), 0U);
+    }
+
+    TEST(TestPoolResource, testPooledMap)
+    {
+        typedef std::pair<const int, uint64_t> value_type;
+        typedef PoolAllocator<value_type, 64> allocator_type;
+        allocator_type::resource_type resource;
+        std::less<int> compare;
+        std::map<int, uint64_t, std::less<int>, allocator_type> m(compare, allocator_type(&resource));
+        for (int i = 0; i < 10000; i++)
+            m[i] = i;
+        for (int i = 0; i < 10000; i += 2)
+            m.erase(i);
+        for (int i = 1; i < 10000; i += 2)
+            EXPECT_EQ(m[i], (uint64_t)i);
+        EXPECT_GT(resource.NumBlocks(), 0U);
+    }
+
+    TEST(TestPoolResource, testCoinsCacheUsage)
+    {
+        CCoinsView base;
+        CCoinsViewCache view(&base);
+        size_t nEmpty = view.DynamicMemoryUsage();
+
+        CMutableTransaction mtx;
+        mtx.vout.resize(2, CTxOut(1000, CScript() << OP_TRUE));
+        for (int i = 0; i < 1000; i++) {
+            mtx.nLockTime = i;
+            CTransaction tx(mtx);
+            view.ModifyCoins(tx.GetHash())->FromTx(tx, 1);
+        }
+        EXPECT_GT(view.DynamicMemoryUsage(), nEmpty);
+
+        // the base view takes no writes, the flush is only for freeing the pool
+        view.Flush();
+        EXPECT_EQ(view.GetCacheSize(), 0U);
+        EXPECT_EQ(view.DynamicMemoryUsage(), nEmpty);
+    }
+}
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include "cc/CCpricescache.h"
+#include "random.h"
+#include "uint256.h"
+#include "util.h"
+
+namespace TestPricesCache {
+
+    class TestPricesCache : public ::testing::Test {
+    protected:
+        virtual void SetUp() { PricesCacheClear(); }
+        virtual void TearDown() { PricesCacheClear(); mapArgs.erase("-maxpricescachesize"); }
+    };
+
+    TEST_F(TestPricesCache, testGetSet)
+    {
+        uint256 hash1 = GetRandHash(), hash2 = GetRandHash();
+        int64_t price;
+
+        EXPECT_FALSE(PricesCacheGet(hash1, 100, price));
+        PricesCacheSet(hash1, 100, 12345);
+        ASSERT_TRUE(PricesCacheGet(hash1, 100, price));
+        EXPECT_EQ(12345, price);
+        EXPECT_FALSE(PricesCacheGet(hash1, 101, price));
+        EXPECT_FALSE(PricesCacheGet(hash2, 100, price));
+    }
+
+    TEST_F(TestPricesCache, testEraseFrom)
+    {
+        uint256 hash1 = GetRandHash(), hash2 = GetRandHash();
+        int64_t price;
+
+        PricesCacheSet(hash1, 99, 1);
+        PricesCacheSet(hash1, 100, 2);
+        PricesCacheSet(hash2, 101, 3);
+        PricesCacheEraseFrom(102);  // new tip, nothing to erase
+        EXPECT_TRUE(PricesCacheGet(hash2, 101, price));
+
+        PricesCacheEraseFrom(100);
+        EXPECT_TRUE(PricesCacheGet(hash1, 99, price));
+        EXPECT_FALSE(PricesCacheGet(hash1, 100, price));
+        EXPECT_FALSE(PricesCacheGet(hash2, 101, price));
+
+        // heights above the erased ones are cached again
+        PricesCacheSet(hash2, 101, 4);
+        PricesCacheEraseFrom(101);
+        EXPECT_FALSE(PricesCacheGet(hash2, 101, price));
+    }
+
+    TEST_F(TestPricesCache, testLeastRecentlyUsedEvicted)
+    {
+        mapArgs["-maxpricescachesize"] = "2";
+        uint256 hash = GetRandHash();
+        int64_t price;
+
+        PricesCacheSet(hash, 1, 1);
+        PricesCacheSet(hash, 2, 2);
+        EXPECT_TRUE(PricesCacheGet(hash, 1, price));
+        PricesCacheSet(hash, 3, 3);
+
+        EXPECT_TRUE(PricesCacheGet(hash, 1, price));
+        EXPECT_FALSE(PricesCacheGet(hash, 2, price));
+        EXPECT_TRUE(PricesCacheGet(hash, 3, price));
+    }
+}
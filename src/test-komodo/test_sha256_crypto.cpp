@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "crypto/sha256.h"
+#include "hash.h"
 #include "uint256.h"
 #include <stdexcept>
 #include "random.h"
@@ -155,4 +156,20 @@ namespace TestSHA256Crypto {
             "d7a8fbb307d7809469ca9abcb0082e4f8d5651e46d3cdb762d02d0bf37c9e592");
     }
 
+    TEST(TestSHA256Crypto, sha256d64)
+    {
+        SHA256AutoDetect();
+        // every count exercises a different mix of the 8, 4 and single input kernels
+        for (int i = 0; i <= 32; ++i) {
+            unsigned char in[64 * 32];
+            unsigned char out1[32 * 32], out2[32 * 32];
+            for (int j = 0; j < 64 * i; ++j)
+                in[j] = insecure_rand();
+            for (int j = 0; j < i; ++j)
+                CHash256().Write(in + 64 * j, 64).Finalize(out1 + 32 * j);
+            SHA256D64(out2, in, i);
+            ASSERT_TRUE(memcmp(out1, out2, 32 * i) == 0) << i;
+        }
+    }
+
 }
\ No newline at end of file
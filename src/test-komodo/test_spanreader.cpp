@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include "clientversion.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "streams.h"
+
+namespace TestSpanReader {
+
+    static CBlock MakeBlock(int nTxs)
+    {
+        CBlock block;
+        block.nVersion = 4;
+        block.nTime = 1234;
+        for (int i = 0; i < nTxs; i++) {
+            CMutableTransaction mtx;
+            mtx.vin.resize(1);
+            mtx.vin[0].prevout.n = i;
+            mtx.vout.resize(1);
+            mtx.vout[0].nValue = i * 1000;
+            mtx.nLockTime = i;
+            block.vtx.push_back(CTransaction(mtx));
+        }
+        return block;
+    }
+
+    TEST(TestSpanReader, testVectorWriterMatchesDataStream)
+    {
+        CBlock block = MakeBlock(5);
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << block;
+
+        std::vector<unsigned char> vch;
+        vch.reserve(GetSerializeSize(block, SER_DISK, CLIENT_VERSION));
+        CVectorWriter(vch, SER_DISK, CLIENT_VERSION) << block;
+        ASSERT_EQ(vch.size(), ss.size());
+        EXPECT_TRUE(std::equal(vch.begin(), vch.end(), (const unsigned char*)&ss[0]));
+        // the size computed up front was exact
+        EXPECT_EQ(vch.capacity(), vch.size());
+    }
+
+    TEST(TestSpanReader, testReadInPlace)
+    {
+        CBlock block = MakeBlock(3);
+        std::vector<unsigned char> vch;
+        CVectorWriter(vch, SER_NETWORK, PROTOCOL_VERSION) << block << block.vtx[1];
+
+        CSpanReader reader(vch, SER_NETWORK, PROTOCOL_VERSION);
+        CBlock blockRead;
+        CTransaction txRead;
+        reader >> blockRead;
+        EXPECT_FALSE(reader.eof());
+        reader >> txRead;
+        EXPECT_TRUE(reader.eof());
+        EXPECT_EQ(blockRead.GetHash(), block.GetHash());
+        ASSERT_EQ(blockRead.vtx.size(), 3U);
+        EXPECT_EQ(blockRead.vtx[2].GetHash(), block.vtx[2].GetHash());
+        EXPECT_EQ(txRead.GetHash(), block.vtx[1].GetHash());
+        // the buffer was read, not consumed
+        EXPECT_EQ(vch.size(), GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION) + GetSerializeSize(block.vtx[1], SER_NETWORK, PROTOCOL_VERSION));
+    }
+
+    TEST(TestSpanReader, testIgnoreAndEndOfData)
+    {
+        std::vector<unsigned char> vch = {1, 2, 3, 4, 5};
+        CSpanReader reader(&vch[0], &vch[0] + vch.size(), SER_DISK, CLIENT_VERSION);
+        EXPECT_EQ(reader.size(), 5U);
+        reader.ignore(2);
+        uint8_t n;
+        reader >> n;
+        EXPECT_EQ(n, 3);
+        EXPECT_THROW(reader.ignore(3), std::ios_base::failure);
+        uint32_t n32;
+        EXPECT_THROW(reader >> n32, std::ios_base::failure);
+        uint16_t n16;
+        reader >> n16;
+        EXPECT_TRUE(reader.empty());
+        EXPECT_THROW(reader >> n, std::ios_base::failure);
+    }
+
+    TEST(TestSpanReader, testGetAndClearHandsOverTheBuffer)
+    {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << std::string("payload");
+        const char* pch = &ss[0];
+        CSerializeData d;
+        ss.GetAndClear(d);
+        EXPECT_EQ(ss.size(), 0U);
+        ASSERT_EQ(d.size(), 8U);
+        EXPECT_EQ(&d[0], pch);
+
+        // appends after a partial read
+        ss << uint8_t(1) << uint8_t(2);
+        uint8_t n;
+        ss >> n;
+        ss.GetAndClear(d);
+        ASSERT_EQ(d.size(), 9U);
+        EXPECT_EQ(d[8], 2);
+    }
+}
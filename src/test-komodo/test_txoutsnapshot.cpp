@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include "coins.h"
+#include "dbwrapper.h"
+#include "random.h"
+#include "txdb.h"
+
+#include <boost/scoped_ptr.hpp>
+
+namespace TestTxOutSnapshot {
+
+    static std::vector<std::pair<std::string, std::string> > ReadEntries(const CCoinsViewDB &view)
+    {
+        std::vector<std::pair<std::string, std::string> > entries;
+        boost::scoped_ptr<CDBIterator> pcursor(view.RawCursor());
+        for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next())
+            entries.push_back(std::make_pair(pcursor->GetRawKey(), pcursor->GetRawValue()));
+        return entries;
+    }
+
+    TEST(TestTxOutSnapshot, testRawCopy)
+    {
+        CCoinsViewDB src(1 << 20, true), dst(1 << 20, true);
+        CCoinsMap mapCoins;
+        CAnchorsSproutMap mapSproutAnchors;
+        CAnchorsSaplingMap mapSaplingAnchors;
+        CNullifiersMap mapSproutNullifiers, mapSaplingNullifiers;
+
+        uint256 txid = GetRandHash(), nullifier = GetRandHash(), hashBlock = GetRandHash();
+        CCoinsCacheEntry &entry = mapCoins[txid];
+        entry.coins.nHeight = 7;
+        entry.coins.vout.resize(2);
+        entry.coins.vout[1].nValue = 5000;
+        entry.flags = CCoinsCacheEntry::DIRTY;
+        mapSaplingNullifiers[nullifier].entered = true;
+        mapSaplingNullifiers[nullifier].flags = CNullifiersCacheEntry::DIRTY;
+        ASSERT_TRUE(src.BatchWrite(mapCoins, hashBlock, uint256(), uint256(), mapSproutAnchors, mapSaplingAnchors, mapSproutNullifiers, mapSaplingNullifiers));
+
+        // the best block of the entries is not copied, only the one given
+        ASSERT_TRUE(dst.WriteRaw(ReadEntries(src), uint256()));
+        EXPECT_TRUE(dst.GetBestBlock().IsNull());
+        CCoins coins;
+        ASSERT_TRUE(dst.GetCoins(txid, coins));
+        EXPECT_EQ(coins.nHeight, 7);
+        ASSERT_EQ(coins.vout.size(), 2U);
+        EXPECT_EQ(coins.vout[1].nValue, 5000);
+        EXPECT_TRUE(dst.GetNullifier(nullifier, SAPLING));
+
+        ASSERT_TRUE(dst.WriteRaw(std::vector<std::pair<std::string, std::string> >(), hashBlock));
+        EXPECT_EQ(dst.GetBestBlock(), hashBlock);
+        EXPECT_EQ(ReadEntries(dst), ReadEntries(src));
+    }
+
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "validationinterface.h"
+
+#include <boost/thread.hpp>
+
+namespace TestValidationQueue {
+
+    class CRecorder : public CValidationInterface {
+    public:
+        std::vector<uint32_t> vLockTimes;
+        std::vector<const CBlock*> vBlocks;
+        std::vector<boost::thread::id> vThreads;
+        CBlock blockSeen;
+
+    protected:
+        void SyncTransaction(const CTransaction &tx, const CBlock *pblock)
+        {
+            vLockTimes.push_back(tx.nLockTime);
+            vBlocks.push_back(pblock);
+            vThreads.push_back(boost::this_thread::get_id());
+            if (pblock != NULL)
+                blockSeen = *pblock;
+        }
+    };
+
+    static CBlock MakeBlock(int nTxs)
+    {
+        CBlock block;
+        for (int i = 0; i < nTxs; i++) {
+            CMutableTransaction mtx;
+            mtx.nLockTime = i;
+            block.vtx.push_back(CTransaction(mtx));
+        }
+        return block;
+    }
+
+    TEST(TestValidationQueue, testAsyncInOrder)
+    {
+        CRecorder recorder;
+        RegisterValidationInterface(&recorder);
+
+        {
+            // the block is gone once the signals return
+            CBlock block = MakeBlock(3);
+            for (const CTransaction &tx : block.vtx)
+                SyncWithWallets(tx, &block);
+        }
+        CMutableTransaction mtx;
+        mtx.nLockTime = 7;
+        SyncWithWallets(CTransaction(mtx));
+
+        SyncWithValidationInterfaceQueue();
+        ASSERT_EQ(recorder.vLockTimes.size(), 4U);
+        EXPECT_EQ(recorder.vLockTimes[0], 0U);
+        EXPECT_EQ(recorder.vLockTimes[1], 1U);
+        EXPECT_EQ(recorder.vLockTimes[2], 2U);
+        EXPECT_EQ(recorder.vLockTimes[3], 7U);
+        // a copy of the block
+        EXPECT_TRUE(recorder.vBlocks[0] != NULL);
+        EXPECT_TRUE(recorder.vBlocks[3] == NULL);
+        EXPECT_EQ(recorder.blockSeen.vtx.size(), 3U);
+        EXPECT_NE(recorder.vThreads[0], boost::this_thread::get_id());
+
+        UnregisterValidationInterface(&recorder);
+        SyncWithWallets(CTransaction(mtx));
+        SyncWithValidationInterfaceQueue();
+        EXPECT_EQ(recorder.vLockTimes.size(), 4U);
+    }
+
+    TEST(TestValidationQueue, testSynchronous)
+    {
+        CRecorder recorder;
+        RegisterValidationInterface(&recorder, true);
+
+        CBlock block = MakeBlock(1);
+        SyncWithWallets(block.vtx[0], &block);
+        ASSERT_EQ(recorder.vLockTimes.size(), 1U);
+        EXPECT_EQ(recorder.vBlocks[0], &block);
+        EXPECT_EQ(recorder.vThreads[0], boost::this_thread::get_id());
+
+        UnregisterValidationInterface(&recorder);
+    }
+
+    TEST(TestValidationQueue, testUnregisterRunsTheQueue)
+    {
+        CRecorder recorder;
+        RegisterValidationInterface(&recorder);
+
+        CBlock block = MakeBlock(50);
+        for (const CTransaction &tx : block.vtx)
+            SyncWithWallets(tx, &block);
+        UnregisterValidationInterface(&recorder);
+        EXPECT_EQ(recorder.vLockTimes.size(), 50U);
+    }
+}
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include "crypto/verus_hash.h"
+#include "random.h"
+
+namespace TestVerusHash {
+
+    class TestVerusHash : public ::testing::Test {};
+
+    template<typename Hasher>
+    void TestHashMulti()
+    {
+        Hasher::init();
+        // lengths of a partial, exact and multi block input, counts around the lane count
+        const size_t lens[] = {0, 7, 32, 64, 75, 1487};
+        for (size_t len : lens) {
+            for (int n = 0; n <= 2 * VERUSHASH_LANES + 1; n++) {
+                std::vector<std::vector<unsigned char> > inputs(n, std::vector<unsigned char>(len + 1));
+                std::vector<const unsigned char *> data(n);
+                std::vector<unsigned char> out1(32 * n + 1), out2(32 * n + 1);
+                for (int j = 0; j < n; j++) {
+                    for (size_t k = 0; k < len; k++)
+                        inputs[j][k] = insecure_rand();
+                    data[j] = inputs[j].data();
+                    Hasher::Hash(&out1[32 * j], data[j], len);
+                }
+                Hasher::HashMulti(out2.data(), data.data(), len, n);
+                ASSERT_TRUE(memcmp(out1.data(), out2.data(), 32 * n) == 0) << len << " " << n;
+            }
+        }
+    }
+
+    template<typename Hasher>
+    void TestExtraHashes()
+    {
+        Hasher::init();
+        unsigned char header[75];
+        for (size_t k = 0; k < sizeof(header); k++)
+            header[k] = insecure_rand();
+        Hasher h;
+        h.Write(header, sizeof(header));
+        h.ClearExtra();
+
+        unsigned char hashes[VERUSHASH_LANES][32], hash[32];
+        int64_t first = 1 << 20;
+        h.ExtraHashes(&hashes[0][0], first, VERUSHASH_LANES);
+        for (int l = 0; l < VERUSHASH_LANES; l++) {
+            *h.ExtraI64Ptr() = first + l;
+            h.ExtraHash(hash);
+            ASSERT_TRUE(memcmp(hash, hashes[l], 32) == 0) << l;
+        }
+    }
+
+    TEST(TestVerusHash, hashmulti)
+    {
+        TestHashMulti<CVerusHash>();
+        TestHashMulti<CVerusHashV2>();
+    }
+
+    TEST(TestVerusHash, extrahashes)
+    {
+        TestExtraHashes<CVerusHash>();
+        TestExtraHashes<CVerusHashV2>();
+    }
+
+}
@@ -34,9 +34,11 @@ extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
 struct COrphanTx {
     CTransaction tx;
     NodeId fromPeer;
+    unsigned int nTxSize;
 };
 extern std::map<uint256, COrphanTx> mapOrphanTransactions;
-extern std::map<uint256, std::set<uint256> > mapOrphanTransactionsByPrev;
+extern std::map<COutPoint, std::set<uint256> > mapOrphanTransactionsByPrev;
+extern std::map<NodeId, size_t> mapOrphanBytesByPeer;
 
 CService ip(uint32_t i)
 {
@@ -201,6 +203,50 @@ BOOST_DATA_TEST_CASE(DoS_mapOrphans, boost::unit_test::data::xrange(static_cast<
     LimitOrphanTxSize(0);
     BOOST_CHECK(mapOrphanTransactions.empty());
     BOOST_CHECK(mapOrphanTransactionsByPrev.empty());
+    BOOST_CHECK(mapOrphanBytesByPeer.empty());
+}
+
+BOOST_AUTO_TEST_CASE(DoS_mapOrphansPeerBytes)
+{
+    CKey key;
+    key.MakeNewKey(true);
+
+    mapArgs["-maxorphanpeerbytes"] = "1000";
+    std::vector<CTransaction> vOrphans;
+    for (int i = 0; i < 40; i++)
+    {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout.n = i;
+        tx.vin[0].prevout.hash = GetRandHash();
+        tx.vin[0].scriptSig << OP_1;
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 1*CENT;
+        tx.vout[0].scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+        vOrphans.push_back(tx);
+    }
+    unsigned int sz = GetSerializeSize(vOrphans[0], SER_NETWORK, vOrphans[0].nVersion);
+
+    // peer 1 fills its share, peer 2 still gets its orphans in
+    int nAdded = 0;
+    for (int i = 0; i < 30; i++)
+        nAdded += AddOrphanTx(vOrphans[i], 1) ? 1 : 0;
+    BOOST_CHECK_EQUAL(nAdded, (int)(1000 / sz));
+    BOOST_CHECK(mapOrphanBytesByPeer[1] <= 1000);
+    BOOST_CHECK(AddOrphanTx(vOrphans[30], 2));
+
+    // orphans are found by the outpoints they spend
+    BOOST_CHECK(mapOrphanTransactionsByPrev.count(vOrphans[30].vin[0].prevout));
+    BOOST_CHECK(!mapOrphanTransactionsByPrev.count(COutPoint(vOrphans[30].vin[0].prevout.hash, vOrphans[30].vin[0].prevout.n + 1)));
+
+    // erasing the orphans of peer 1 gives its share back
+    EraseOrphansFor(1);
+    BOOST_CHECK(!mapOrphanBytesByPeer.count(1));
+    BOOST_CHECK(AddOrphanTx(vOrphans[31], 1));
+
+    LimitOrphanTxSize(0);
+    BOOST_CHECK(mapOrphanBytesByPeer.empty());
+    mapArgs.erase("-maxorphanpeerbytes");
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -180,12 +180,73 @@ BOOST_AUTO_TEST_CASE(addrman_select)
     BOOST_CHECK(addrman.size() == 7);
 
     // Test 12: Select pulls from new and tried regardless of port number.
+    BOOST_CHECK(addrman.Select().ToString() == "250.4.4.4:8333");
     BOOST_CHECK(addrman.Select().ToString() == "250.4.6.6:8333");
     BOOST_CHECK(addrman.Select().ToString() == "250.3.2.2:9999");
-    BOOST_CHECK(addrman.Select().ToString() == "250.3.3.3:9999");
     BOOST_CHECK(addrman.Select().ToString() == "250.4.4.4:8333");
 }
 
+BOOST_AUTO_TEST_CASE(addrman_select_reaches_all)
+{
+    CAddrManTest addrman;
+
+    // Set addrman addr placement to be deterministic.
+    addrman.MakeDeterministic();
+
+    // Spread addresses over many buckets of both tables.
+    std::set<std::string> setAddrs;
+    for (unsigned int i = 1; i < 41; i++) {
+        CService addr = CService("250.1." + boost::to_string(i) + ".1");
+        addrman.Add(CAddress(addr), CNetAddr("252." + boost::to_string(i % 8) + ".1.1"));
+        if (i % 2 == 0)
+            addrman.Good(CAddress(addr));
+        setAddrs.insert(addr.ToString());
+    }
+    BOOST_CHECK(addrman.size() == setAddrs.size());
+
+    // Every occupied position can be drawn, from the new table alone too.
+    std::set<std::string> setSelected;
+    std::set<std::string> setSelectedNew;
+    for (int i = 0; i < 2000; i++) {
+        setSelected.insert(addrman.Select().ToString());
+        setSelectedNew.insert(addrman.Select(true).ToString());
+    }
+    BOOST_CHECK(setSelected == setAddrs);
+    BOOST_CHECK(setSelectedNew.size() > 0 && setSelectedNew.size() < setAddrs.size());
+    for (std::set<std::string>::const_iterator it = setSelectedNew.begin(); it != setSelectedNew.end(); ++it)
+        BOOST_CHECK(setAddrs.count(*it));
+}
+
+BOOST_AUTO_TEST_CASE(addrman_change_count)
+{
+    CAddrManTest addrman;
+
+    // Set addrman addr placement to be deterministic.
+    addrman.MakeDeterministic();
+
+    CService addr1 = CService("250.1.1.1", 8333);
+    uint64_t nChanges = addrman.GetChangeCount();
+
+    // Looking up or selecting addresses does not count as a change.
+    addrman.Select();
+    addrman.Good(CAddress(addr1));
+    BOOST_CHECK_EQUAL(addrman.GetChangeCount(), nChanges);
+
+    addrman.Add(CAddress(addr1), CNetAddr("252.2.2.2"));
+    BOOST_CHECK(addrman.GetChangeCount() != nChanges);
+
+    nChanges = addrman.GetChangeCount();
+    addrman.Select();
+    BOOST_CHECK_EQUAL(addrman.GetChangeCount(), nChanges);
+
+    addrman.Attempt(CAddress(addr1));
+    BOOST_CHECK(addrman.GetChangeCount() != nChanges);
+
+    nChanges = addrman.GetChangeCount();
+    addrman.Good(CAddress(addr1));
+    BOOST_CHECK(addrman.GetChangeCount() != nChanges);
+}
+
 BOOST_AUTO_TEST_CASE(addrman_new_collisions)
 {
     CAddrManTest addrman;
@@ -84,9 +84,9 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
         block.clear();
         if (blocknum == 30) {
             // At this point we should need to combine 5 buckets to get enough data points
-            // So estimateFee(1) should fail and estimateFee(2) should return somewhere around
-            // 8*baserate
-            BOOST_CHECK(mpool.estimateFee(1) == CFeeRate(0));
+            // So estimateFee(1) should fall back to the mempool, where all txs fit in a block,
+            // and estimateFee(2) should return somewhere around 8*baserate
+            BOOST_CHECK(mpool.estimateFee(1) == CFeeRate(1000));
             BOOST_CHECK(mpool.estimateFee(2).GetFeePerK() < 8*baseRate.GetFeePerK() + deltaFee);
             BOOST_CHECK(mpool.estimateFee(2).GetFeePerK() > 8*baseRate.GetFeePerK() - deltaFee);
         }
@@ -184,6 +184,73 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     }
 }
 
+BOOST_AUTO_TEST_CASE(MempoolFeeEstimates)
+{
+    CTxMemPool mpool(CFeeRate(1000));
+    TestMemPoolEntryHelper entry;
+    std::list<CTransaction> dummyConflicted;
+    std::vector<CTransaction> block;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    for (unsigned int i = 0; i < 10000; i++)
+        tx.vin[0].scriptSig.push_back('X');
+    tx.vout.resize(1);
+    tx.vout[0].nValue=0LL;
+    size_t nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+
+    // Nothing to go on before a block is seen
+    BOOST_CHECK(mpool.estimateFee(1) == CFeeRate(0));
+    mpool.removeForBlock(block, 1, dummyConflicted);
+    // With an empty mempool the lowest fee rate gets in, for short targets only
+    BOOST_CHECK(mpool.estimateFee(1) == CFeeRate(1000));
+    BOOST_CHECK(mpool.estimateFee(MAX_MEMPOOL_ESTIMATE_CONFIRMS) == CFeeRate(1000));
+    BOOST_CHECK(mpool.estimateFee(MAX_MEMPOOL_ESTIMATE_CONFIRMS + 1) == CFeeRate(0));
+
+    // Fill more than the room of two blocks with fees going down
+    double room = MEMPOOL_ESTIMATE_BLOCK_SHARE * MAX_BLOCK_SIZE(2);
+    int nTxs = 2 * room / nTxSize + 10;
+    for (int i = 0; i < nTxs; i++) {
+        tx.vin[0].prevout.n = i;
+        mpool.addUnchecked(tx.GetHash(), entry.Fee(1000000 - 100 * i).Height(1).FromTx(tx, &mpool));
+    }
+
+    // One block outbids the first tx it has no room for
+    int nFit = room / nTxSize;
+    CFeeRate feeLeftOut(1000000 - 100 * nFit, nTxSize);
+    BOOST_CHECK(mpool.estimateFee(1) == CFeeRate(feeLeftOut.GetFeePerK() * FEE_SPACING));
+    BOOST_CHECK(mpool.estimateFee(2) < mpool.estimateFee(1));
+    BOOST_CHECK(mpool.estimateFee(3) == CFeeRate(1000));
+}
+
+BOOST_AUTO_TEST_CASE(TxConfirmStats_SetDecay)
+{
+    std::vector<double> buckets {1000.0, 2000.0};
+    TxConfirmStats txcs;
+    txcs.Initialize(buckets, MAX_BLOCK_CONFIRMS, DEFAULT_DECAY, "Test");
+
+    // Two txs a block confirming at once give an estimate, which the history
+    // rescaled to another decay still gives
+    for (unsigned int i = 1; i <= 2000; i++) {
+        txcs.ClearCurrent(i);
+        txcs.Record(1, 1500.0);
+        txcs.Record(1, 1500.0);
+        txcs.UpdateMovingAverages();
+    }
+    BOOST_CHECK_CLOSE(txcs.EstimateMedianVal(1, 1, MIN_SUCCESS_PCT, true, 2000), 1500.0, 0.01);
+    txcs.SetDecay(.9);
+    BOOST_CHECK_CLOSE(txcs.EstimateMedianVal(1, 1, MIN_SUCCESS_PCT, true, 2000), 1500.0, 0.01);
+
+    // With the faster decay that history is gone 200 blocks of a tx every 20 blocks later
+    for (unsigned int i = 2001; i <= 2200; i++) {
+        txcs.ClearCurrent(i);
+        if (i % 20 == 0)
+            txcs.Record(1, 1500.0);
+        txcs.UpdateMovingAverages();
+    }
+    BOOST_CHECK_EQUAL(txcs.EstimateMedianVal(1, 1, MIN_SUCCESS_PCT, true, 2200), -1);
+}
+
 BOOST_AUTO_TEST_CASE(TxConfirmStats_FindBucketIndex)
 {
     std::vector<double> buckets {0.0, 3.5, 42.0};
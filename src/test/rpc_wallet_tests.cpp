@@ -824,6 +824,70 @@ BOOST_AUTO_TEST_CASE(rpc_wallet_async_operations_parallel_cancel)
     BOOST_CHECK(ids.size()==0);
 }
 
+// Records the order the operations of each method start in and how many run at once
+class MethodOperation : public AsyncRPCOperation {
+public:
+    static std::mutex mutex;
+    static std::vector<std::string> order;
+    static std::map<std::string, int> running, maxRunning;
+
+    std::string method;
+    MethodOperation(const std::string& methodIn) : method(methodIn) {}
+    virtual ~MethodOperation() {}
+    virtual std::string getMethod() const { return method; }
+    virtual void main() {
+        set_state(OperationStatus::EXECUTING);
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            order.push_back(method);
+            maxRunning[method] = std::max(maxRunning[method], ++running[method]);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            running[method]--;
+        }
+        set_state(OperationStatus::SUCCESS);
+    }
+};
+std::mutex MethodOperation::mutex;
+std::vector<std::string> MethodOperation::order;
+std::map<std::string, int> MethodOperation::running, MethodOperation::maxRunning;
+
+// This tests the priorities and concurrency limits of the methods
+BOOST_AUTO_TEST_CASE(rpc_wallet_async_operations_priority_limit)
+{
+    MethodOperation::order.clear();
+    MethodOperation::maxRunning.clear();
+
+    std::shared_ptr<AsyncRPCQueue> q = std::make_shared<AsyncRPCQueue>();
+    q->setPriority("merge", -1);
+    q->setConcurrencyLimit("merge", 1);
+    for (int i = 0; i < 3; i++) {
+        std::shared_ptr<AsyncRPCOperation> op(new MethodOperation("merge"));
+        q->addOperation(op);
+    }
+    for (int i = 0; i < 2; i++) {
+        std::shared_ptr<AsyncRPCOperation> op(new MethodOperation("send"));
+        q->addOperation(op);
+    }
+    BOOST_CHECK(q->getOperationCount() == 5);
+
+    // the sends were queued last but start first, the two of them run at
+    // once, the merges one at a time
+    q->addWorker();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    q->addWorker();
+    q->addWorker();
+    q->finishAndWait();
+    BOOST_CHECK(q->getOperationCount() == 0);
+    BOOST_CHECK_EQUAL(MethodOperation::order.size(), 5);
+    BOOST_CHECK_EQUAL(MethodOperation::order[0], "send");
+    BOOST_CHECK_EQUAL(MethodOperation::order[1], "send");
+    BOOST_CHECK_EQUAL(MethodOperation::maxRunning["merge"], 1);
+    BOOST_CHECK_EQUAL(MethodOperation::maxRunning["send"], 2);
+}
+
 // This tests z_getoperationstatus, z_getoperationresult, z_listoperationids
 BOOST_AUTO_TEST_CASE(rpc_z_getoperations)
 {
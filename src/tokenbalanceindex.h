@@ -0,0 +1,122 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef TOKENBALANCEINDEX_H
+#define TOKENBALANCEINDEX_H
+
+#include "uint256.h"
+#include "amount.h"
+#include "primitives/transaction.h"
+#include "serialize.h"
+
+#include <utility>
+#include <vector>
+
+// token balance index key: tokens evalcode, token cc address and tokenid
+struct CTokenBalanceKey {
+    uint8_t evalcode;
+    uint160 hashBytes;
+    uint256 tokenid;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(evalcode);
+        READWRITE(hashBytes);
+        READWRITE(tokenid);
+    }
+
+    CTokenBalanceKey(uint8_t _evalcode, uint160 addressHash, uint256 _tokenid) {
+        evalcode = _evalcode;
+        hashBytes = addressHash;
+        tokenid = _tokenid;
+    }
+
+    CTokenBalanceKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        evalcode = 0;
+        hashBytes.SetNull();
+        tokenid.SetNull();
+    }
+
+    friend bool operator<(const CTokenBalanceKey& a, const CTokenBalanceKey& b) {
+        if (a.evalcode != b.evalcode)
+            return a.evalcode < b.evalcode;
+        if (a.hashBytes != b.hashBytes)
+            return a.hashBytes < b.hashBytes;
+        return a.tokenid < b.tokenid;
+    }
+};
+
+// partial key for the balances of all tokens on an address
+struct CTokenBalanceKeyAddr {
+    uint8_t evalcode;
+    uint160 hashBytes;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(evalcode);
+        READWRITE(hashBytes);
+    }
+
+    CTokenBalanceKeyAddr(uint8_t _evalcode, uint160 addressHash) {
+        evalcode = _evalcode;
+        hashBytes = addressHash;
+    }
+};
+
+// unspent token output counted in a balance, keyed by its outpoint
+struct CTokenBalanceUtxo {
+    CTokenBalanceKey key;
+    CAmount amount;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(key);
+        READWRITE(amount);
+    }
+
+    CTokenBalanceUtxo(const CTokenBalanceKey &_key, CAmount _amount) : key(_key), amount(_amount) {}
+
+    CTokenBalanceUtxo() : amount(0) {}
+};
+
+// token balance index changes of a connected block, keyed by block hash, to roll it back
+struct CTokenBalanceUndo {
+    std::vector<std::pair<COutPoint, CTokenBalanceUtxo> > spent;
+    std::vector<COutPoint> created;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(spent);
+        READWRITE(created);
+    }
+
+    bool IsEmpty() const {
+        return spent.empty() && created.empty();
+    }
+};
+
+#endif // #ifndef TOKENBALANCEINDEX_H
@@ -0,0 +1,82 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef TOKENTAGSINDEX_H
+#define TOKENTAGSINDEX_H
+
+#include "uint256.h"
+#include "serialize.h"
+
+// token tags index key: token tag id, block height and tx position in the block
+struct CTokenTagEventKey {
+    uint256 tokentagid;
+    int blockHeight;
+    unsigned int txindex;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 40;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        tokentagid.Serialize(s);
+        // Heights are stored big-endian for key sorting in LevelDB
+        ser_writedata32be(s, blockHeight);
+        ser_writedata32be(s, txindex);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        tokentagid.Unserialize(s);
+        blockHeight = ser_readdata32be(s);
+        txindex = ser_readdata32be(s);
+    }
+
+    CTokenTagEventKey(uint256 _tokentagid, int height, unsigned int blockindex) {
+        tokentagid = _tokentagid;
+        blockHeight = height;
+        txindex = blockindex;
+    }
+
+    CTokenTagEventKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        tokentagid.SetNull();
+        blockHeight = 0;
+        txindex = 0;
+    }
+};
+
+// token tag create, update or escrow update tx
+struct CTokenTagEvent {
+    uint256 txid;
+    uint256 prevtxid;     //!< tx whose vout0 baton is spent by vin0, null if vin0 does not spend a vout0
+    uint160 batonHash;    //!< address of the vout0 cc output, null if vout0 is not a cc output
+    uint8_t funcid;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txid);
+        READWRITE(prevtxid);
+        READWRITE(batonHash);
+        READWRITE(funcid);
+    }
+
+    CTokenTagEvent() : funcid(0) {}
+};
+
+#endif // #ifndef TOKENTAGSINDEX_H
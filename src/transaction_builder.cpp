@@ -7,6 +7,7 @@
 #include "main.h"
 #include "pubkey.h"
 #include "script/sign.h"
+#include "zcash/Params.hpp"
 
 #include <boost/variant.hpp>
 #include <librustzcash.h>
@@ -167,10 +168,15 @@ boost::optional<CTransaction> TransactionBuilder::Build()
     // Sapling spends and outputs
     //
 
+    // Every proof adds the randomness of its value commitment to ctx, which
+    // the binding signature is made with, so the proofs share the one context
+    // and are made in turn. librustzcash runs each proof on all the cores.
+    if (!spends.empty() || !outputs.empty())
+        libzcash::LoadGrothParams();
     auto ctx = librustzcash_sapling_proving_ctx_init();
 
     // Create Sapling SpendDescriptions
-    for (auto spend : spends) {
+    for (const auto& spend : spends) {
         auto cm = spend.note.cm();
         auto nf = spend.note.nullifier(
             spend.expsk.full_viewing_key(), spend.witness.position());
@@ -207,7 +213,7 @@ boost::optional<CTransaction> TransactionBuilder::Build()
     }
 
     // Create Sapling OutputDescriptions
-    for (auto output : outputs) {
+    for (const auto& output : outputs) {
         auto cm = output.note.cm();
         if (!cm) {
             librustzcash_sapling_proving_ctx_free(ctx);
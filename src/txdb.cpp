@@ -22,12 +22,14 @@
 
 #include "chainparams.h"
 #include "hash.h"
+#include "init.h"
 #include "main.h"
 #include "pow.h"
 #include "uint256.h"
 #include "core_io.h"
 
 #include <stdint.h>
+#include <limits>
 
 #include <boost/thread.hpp>
 
@@ -40,6 +42,10 @@ static const char DB_SAPLING_ANCHOR = 'Z';
 static const char DB_NULLIFIER = 's';
 static const char DB_SAPLING_NULLIFIER = 'S';
 static const char DB_COINS = 'c';
+// one unspent output, with the height, coinbase flag and version of its transaction, keyed by outpoint
+static const char DB_COIN = 'C';
+// the coins format version, once the coins are written one record per output
+static const char DB_COINS_FORMAT = 'P';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'd';
@@ -52,6 +58,7 @@ static const char DB_BLOCK_INDEX = 'b';
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_BEST_SPROUT_ANCHOR = 'a';
 static const char DB_BEST_SAPLING_ANCHOR = 'z';
+static const char DB_COINS_STATS = 'X';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
@@ -59,12 +66,152 @@ static const char DB_LAST_BLOCK = 'l';
 // cc module outputs index with opdrop or opreturn data
 static const char DB_ADDRESSUNSPENT_CC_INDEX = 'O';
 
+// transactions kept from a pruned block file, the hash of the block and the transaction keyed by txid
+static const char DB_PRUNEDTX = 'x';
 
-CCoinsViewDB::CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / dbName, nCacheSize, fMemory, fWipe) {
+// coinbase signer pubkey and notary id of a block, keyed by block hash
+static const char DB_BLOCK_SIGNER = 'k';
+
+// staking segid of a block (-1 for PoW blocks), keyed by block hash
+static const char DB_BLOCK_SEGID = 'g';
+static const char DB_BLOCK_SUPPLY = 'y';
+
+// token balances by tokens evalcode, address and tokenid, the token utxos counted in them and per block undo data
+static const char DB_TOKENBALANCE_INDEX = 'T';
+static const char DB_TOKENBALANCE_UTXO = 'U';
+static const char DB_TOKENBALANCE_UNDO = 'V';
+
+// oracles data samples by oracle txid, publisher baton address and height
+static const char DB_ORACLES_SAMPLE = 'Q';
+
+// token tag create and update txns by token tag id and height
+static const char DB_TOKENTAGS_EVENT = 'G';
+
+// agreements, their events and the agreements referencing them by agreement txid and height
+static const char DB_AGREEMENTS_EVENT = 'E';
+
+// gateways withdraws with an unspent marker, by bind txid
+static const char DB_GATEWAYS_MARKER = 'W';
+
+// address balances, the rich list ordered by balance and their totals
+static const char DB_ADDRESSBALANCE = 'h';
+static const char DB_ADDRESSRICHLIST = 'r';
+static const char DB_ADDRESSBALANCE_TOTALS = 'H';
+
+// last block of the background index builder and the indexes it builds
+static const char DB_INDEXBUILDER_BEST = 'I';
+
+static const int COINS_FORMAT_PER_OUTPUT = 1;
+//! transactions rewritten per batch by UpgradeCoinsFormat
+static const size_t COINS_UPGRADE_BATCH_SIZE = 10000;
+
+namespace {
+
+/** A DB_COIN record */
+struct CCoinsOutputValue
+{
+    int nVersion;
+    int nHeight;
+    bool fCoinBase;
+    CTxOut out;
+
+    CCoinsOutputValue() : nVersion(0), nHeight(0), fCoinBase(false) {}
+    CCoinsOutputValue(const CCoins &coins, unsigned int i) : nVersion(coins.nVersion), nHeight(coins.nHeight), fCoinBase(coins.fCoinBase), out(coins.vout[i]) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        uint32_t nCode = (uint32_t)nHeight * 2 + (fCoinBase ? 1 : 0);
+        READWRITE(VARINT(nVersion));
+        READWRITE(VARINT(nCode));
+        READWRITE(REF(CTxOutCompressor(out)));
+        if (ser_action.ForRead()) {
+            nHeight = nCode / 2;
+            fCoinBase = nCode & 1;
+        }
+    }
+};
+
+struct CBlockSignerValue
+{
+    uint8_t pubkey33[33];
+    int8_t notaryid;
+
+    CBlockSignerValue() : notaryid(-2) { memset(pubkey33, 0, sizeof(pubkey33)); }
+    explicit CBlockSignerValue(const CBlockIndex *pindex) : notaryid(pindex->notaryid) { memcpy(pubkey33, pindex->pubkey33, sizeof(pubkey33)); }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(FLATDATA(pubkey33));
+        READWRITE(notaryid);
+    }
+};
+
+/** The komodo_newcoins results of a block */
+struct CBlockSupplyValue
+{
+    int64_t newcoins, zfunds, sproutfunds;
+
+    CBlockSupplyValue() : newcoins(0), zfunds(0), sproutfunds(0) {}
+    explicit CBlockSupplyValue(const CBlockIndex *pindex) : newcoins(pindex->newcoins), zfunds(pindex->zfunds), sproutfunds(pindex->sproutfunds) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(newcoins);
+        READWRITE(zfunds);
+        READWRITE(sproutfunds);
+    }
+};
+
+}
+
+
+CCoinsViewDB::CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / dbName, nCacheSize, fMemory, fWipe), fRunningStatsRead(false), fRunningStats(false) {
+    ReadCoinsFormat();
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe), fRunningStatsRead(false), fRunningStats(false)
 {
+    ReadCoinsFormat();
+}
+
+void CCoinsViewDB::ReadCoinsFormat() {
+    int nFormat = 0;
+    fPerOutputMarked = db.Read(DB_COINS_FORMAT, nFormat) && nFormat >= COINS_FORMAT_PER_OUTPUT;
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(DB_COINS);
+    std::pair<char, uint256> key;
+    fLegacyCoins = pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_COINS;
+    // a new database is written per output, an old one is until UpgradeCoinsFormat
+    fPerOutput = fPerOutputMarked || !fLegacyCoins;
+}
+
+bool CCoinsViewDB::GetCoinOutputs(const uint256 &txid, CCoins &coins) const {
+    boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper*>(&db)->NewCachedIterator());
+    pcursor->Seek(make_pair(DB_COIN, COutPoint(txid, 0)));
+    coins.Clear();
+    bool fFound = false;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        std::pair<char, COutPoint> key;
+        if (!pcursor->GetKey(key) || key.first != DB_COIN || key.second.hash != txid)
+            break;
+        CCoinsOutputValue value;
+        if (!pcursor->GetValue(value))
+            throw runtime_error("unable to read a coin output from the database");
+        if (key.second.n >= coins.vout.size())
+            coins.vout.resize(key.second.n + 1);
+        coins.vout[key.second.n] = value.out;
+        coins.nVersion = value.nVersion;
+        coins.nHeight = value.nHeight;
+        coins.fCoinBase = value.fCoinBase;
+        fFound = true;
+    }
+    return fFound;
 }
 
 
@@ -109,11 +256,20 @@ bool CCoinsViewDB::GetNullifier(const uint256 &nf, ShieldedType type) const {
 }
 
 bool CCoinsViewDB::GetCoins(const uint256 &txid, CCoins &coins) const {
-    return db.Read(make_pair(DB_COINS, txid), coins);
+    if (fPerOutput && GetCoinOutputs(txid, coins))
+        return true;
+    return fLegacyCoins && db.Read(make_pair(DB_COINS, txid), coins);
 }
 
 bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
-    return db.Exists(make_pair(DB_COINS, txid));
+    if (fPerOutput) {
+        boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper*>(&db)->NewCachedIterator());
+        pcursor->Seek(make_pair(DB_COIN, COutPoint(txid, 0)));
+        std::pair<char, COutPoint> key;
+        if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_COIN && key.second.hash == txid)
+            return true;
+    }
+    return fLegacyCoins && db.Exists(make_pair(DB_COINS, txid));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
@@ -142,9 +298,9 @@ uint256 CCoinsViewDB::GetBestAnchor(ShieldedType type) const {
     return hashBestAnchor;
 }
 
-void BatchWriteNullifiers(CDBBatch& batch, CNullifiersMap& mapToUse, const char& dbChar)
+void BatchWriteNullifiers(CDBBatch& batch, const CNullifiersMap& mapToUse, const char& dbChar)
 {
-    for (CNullifiersMap::iterator it = mapToUse.begin(); it != mapToUse.end();) {
+    for (CNullifiersMap::const_iterator it = mapToUse.begin(); it != mapToUse.end(); it++) {
         if (it->second.flags & CNullifiersCacheEntry::DIRTY) {
             if (!it->second.entered)
                 batch.Erase(make_pair(dbChar, it->first));
@@ -152,15 +308,13 @@ void BatchWriteNullifiers(CDBBatch& batch, CNullifiersMap& mapToUse, const char&
                 batch.Write(make_pair(dbChar, it->first), true);
             // TODO: changed++? ... See comment in CCoinsViewDB::BatchWrite. If this is needed we could return an int
         }
-        CNullifiersMap::iterator itOld = it++;
-        mapToUse.erase(itOld);
     }
 }
 
 template<typename Map, typename MapIterator, typename MapEntry, typename Tree>
-void BatchWriteAnchors(CDBBatch& batch, Map& mapToUse, const char& dbChar)
+void BatchWriteAnchors(CDBBatch& batch, const Map& mapToUse, const char& dbChar)
 {
-    for (MapIterator it = mapToUse.begin(); it != mapToUse.end();) {
+    for (MapIterator it = mapToUse.begin(); it != mapToUse.end(); it++) {
         if (it->second.flags & MapEntry::DIRTY) {
             if (!it->second.entered)
                 batch.Erase(make_pair(dbChar, it->first));
@@ -171,11 +325,83 @@ void BatchWriteAnchors(CDBBatch& batch, Map& mapToUse, const char& dbChar)
             }
             // TODO: changed++?
         }
-        MapIterator itOld = it++;
-        mapToUse.erase(itOld);
     }
 }
 
+// Remove (fInsert false) or add the unspent output i of txid to the UTXO set hash
+static void HashCoinsStatsOutput(MuHash3072 &muhash, const uint256 &txid, unsigned int i, const CCoins &coins, const CTxOut &out, bool fInsert)
+{
+    CDataStream ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << txid << i << coins.nHeight << coins.fCoinBase << out;
+    if (fInsert)
+        muhash.Insert((const unsigned char*)&ss[0], ss.size());
+    else
+        muhash.Remove((const unsigned char*)&ss[0], ss.size());
+}
+
+// Update stats for the coins of txid changing from coinsOld to coinsNew, either may be pruned
+static void UpdateCoinsStats(CCoinsRunningStats &stats, const uint256 &txid, const CCoins &coinsOld, const CCoins &coinsNew)
+{
+    if (!coinsOld.IsPruned()) {
+        stats.nTransactions--;
+        stats.nSerializedSize -= 32 + ::GetSerializeSize(coinsOld, SER_DISK, CLIENT_VERSION);
+    }
+    if (!coinsNew.IsPruned()) {
+        stats.nTransactions++;
+        stats.nSerializedSize += 32 + ::GetSerializeSize(coinsNew, SER_DISK, CLIENT_VERSION);
+    }
+    // only the outputs that changed are removed and added, usually one that is spent
+    bool fSameTx = coinsOld.nHeight == coinsNew.nHeight && coinsOld.fCoinBase == coinsNew.fCoinBase;
+    for (unsigned int i = 0; i < std::max(coinsOld.vout.size(), coinsNew.vout.size()); i++) {
+        const CTxOut *poutOld = i < coinsOld.vout.size() && !coinsOld.vout[i].IsNull() ? &coinsOld.vout[i] : NULL;
+        const CTxOut *poutNew = i < coinsNew.vout.size() && !coinsNew.vout[i].IsNull() ? &coinsNew.vout[i] : NULL;
+        if (fSameTx && poutOld != NULL && poutNew != NULL && *poutOld == *poutNew)
+            continue;
+        if (poutOld != NULL) {
+            stats.nTransactionOutputs--;
+            stats.nTotalAmount -= poutOld->nValue;
+            HashCoinsStatsOutput(stats.muhash, txid, i, coinsOld, *poutOld, false);
+        }
+        if (poutNew != NULL) {
+            stats.nTransactionOutputs++;
+            stats.nTotalAmount += poutNew->nValue;
+            HashCoinsStatsOutput(stats.muhash, txid, i, coinsNew, *poutNew, true);
+        }
+    }
+}
+
+// Write the outputs of txid that changed from coinsOld to coinsNew and erase the spent ones, either may be pruned
+static void BatchWriteCoinOutputs(CDBBatch &batch, const uint256 &txid, const CCoins &coinsOld, const CCoins &coinsNew)
+{
+    bool fSameTx = coinsOld.nHeight == coinsNew.nHeight && coinsOld.fCoinBase == coinsNew.fCoinBase && coinsOld.nVersion == coinsNew.nVersion;
+    for (unsigned int i = 0; i < std::max(coinsOld.vout.size(), coinsNew.vout.size()); i++) {
+        bool fOld = coinsOld.IsAvailable(i), fNew = coinsNew.IsAvailable(i);
+        if (fNew) {
+            if (!fOld || !fSameTx || coinsOld.vout[i] != coinsNew.vout[i])
+                batch.Write(make_pair(DB_COIN, COutPoint(txid, i)), CCoinsOutputValue(coinsNew, i));
+        } else if (fOld) {
+            batch.Erase(make_pair(DB_COIN, COutPoint(txid, i)));
+        }
+    }
+}
+
+static void RunningStatsToStats(const CCoinsRunningStats &running, CCoinsStats &stats)
+{
+    stats.hashBlock = running.hashBlock;
+    stats.nTransactions = running.nTransactions;
+    stats.nTransactionOutputs = running.nTransactionOutputs;
+    stats.nSerializedSize = running.nSerializedSize;
+    stats.nTotalAmount = running.nTotalAmount;
+    running.muhash.Finalize(stats.hashMuHash.begin());
+}
+
+void CCoinsViewDB::ReadRunningStats() {
+    runningStats = CCoinsRunningStats();
+    // an empty database starts them
+    fRunningStats = db.Read(DB_COINS_STATS, runningStats) || db.IsEmpty();
+    fRunningStatsRead = true;
+}
+
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
                               const uint256 &hashBlock,
                               const uint256 &hashSproutAnchor,
@@ -184,24 +410,58 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
                               CAnchorsSaplingMap &mapSaplingAnchors,
                               CNullifiersMap &mapSproutNullifiers,
                               CNullifiersMap &mapSaplingNullifiers) {
+    bool fOk = WriteCoins(mapCoins, hashBlock, hashSproutAnchor, hashSaplingAnchor, mapSproutAnchors, mapSaplingAnchors, mapSproutNullifiers, mapSaplingNullifiers);
+    mapCoins.clear();
+    mapSproutAnchors.clear();
+    mapSaplingAnchors.clear();
+    mapSproutNullifiers.clear();
+    mapSaplingNullifiers.clear();
+    return fOk;
+}
+
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins,
+                              const uint256 &hashBlock,
+                              const uint256 &hashSproutAnchor,
+                              const uint256 &hashSaplingAnchor,
+                              const CAnchorsSproutMap &mapSproutAnchors,
+                              const CAnchorsSaplingMap &mapSaplingAnchors,
+                              const CNullifiersMap &mapSproutNullifiers,
+                              const CNullifiersMap &mapSaplingNullifiers) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    if (!fRunningStatsRead)
+        ReadRunningStats();
+    CCoinsRunningStats stats = runningStats;
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            if (it->second.coins.IsPruned())
+            // a fresh entry is not in the database, the outputs of another one are written when they changed
+            CCoins coinsOld;
+            bool fOldLegacy = false;
+            if (!(it->second.flags & CCoinsCacheEntry::FRESH) && (fRunningStats || fPerOutput)) {
+                if (!fPerOutput || !GetCoinOutputs(it->first, coinsOld))
+                    fOldLegacy = (fLegacyCoins || !fPerOutput) && db.Read(make_pair(DB_COINS, it->first), coinsOld);
+            }
+            if (fRunningStats)
+                UpdateCoinsStats(stats, it->first, coinsOld, it->second.coins);
+            if (!fPerOutput) {
+                if (it->second.coins.IsPruned())
+                    batch.Erase(make_pair(DB_COINS, it->first));
+                else
+                    batch.Write(make_pair(DB_COINS, it->first), it->second.coins);
+            } else if (fOldLegacy) {
                 batch.Erase(make_pair(DB_COINS, it->first));
-            else
-                batch.Write(make_pair(DB_COINS, it->first), it->second.coins);
+                BatchWriteCoinOutputs(batch, it->first, CCoins(), it->second.coins);
+            } else {
+                BatchWriteCoinOutputs(batch, it->first, coinsOld, it->second.coins);
+            }
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
     }
 
-    ::BatchWriteAnchors<CAnchorsSproutMap, CAnchorsSproutMap::iterator, CAnchorsSproutCacheEntry, SproutMerkleTree>(batch, mapSproutAnchors, DB_SPROUT_ANCHOR);
-    ::BatchWriteAnchors<CAnchorsSaplingMap, CAnchorsSaplingMap::iterator, CAnchorsSaplingCacheEntry, SaplingMerkleTree>(batch, mapSaplingAnchors, DB_SAPLING_ANCHOR);
+    ::BatchWriteAnchors<CAnchorsSproutMap, CAnchorsSproutMap::const_iterator, CAnchorsSproutCacheEntry, SproutMerkleTree>(batch, mapSproutAnchors, DB_SPROUT_ANCHOR);
+    ::BatchWriteAnchors<CAnchorsSaplingMap, CAnchorsSaplingMap::const_iterator, CAnchorsSaplingCacheEntry, SaplingMerkleTree>(batch, mapSaplingAnchors, DB_SAPLING_ANCHOR);
 
     ::BatchWriteNullifiers(batch, mapSproutNullifiers, DB_NULLIFIER);
     ::BatchWriteNullifiers(batch, mapSaplingNullifiers, DB_SAPLING_NULLIFIER);
@@ -212,12 +472,298 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
         batch.Write(DB_BEST_SPROUT_ANCHOR, hashSproutAnchor);
     if (!hashSaplingAnchor.IsNull())
         batch.Write(DB_BEST_SAPLING_ANCHOR, hashSaplingAnchor);
+    if (fRunningStats) {
+        if (!hashBlock.IsNull())
+            stats.hashBlock = hashBlock;
+        batch.Write(DB_COINS_STATS, stats);
+    }
+    if (fPerOutput && !fPerOutputMarked)
+        batch.Write(DB_COINS_FORMAT, COINS_FORMAT_PER_OUTPUT);
 
     LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
-    return db.WriteBatch(batch);
+    if (!db.WriteBatch(batch))
+        return false;
+    runningStats = stats;
+    if (fPerOutput)
+        fPerOutputMarked = true;
+    return true;
+}
+
+struct CCoinsViewBackgroundFlush::CFlush
+{
+    CCoinsMapResource coinsResource;
+    CNullifiersMapResource sproutNullifiersResource;
+    CNullifiersMapResource saplingNullifiersResource;
+    CCoinsMap mapCoins;
+    CAnchorsSproutMap mapSproutAnchors;
+    CAnchorsSaplingMap mapSaplingAnchors;
+    CNullifiersMap mapSproutNullifiers;
+    CNullifiersMap mapSaplingNullifiers;
+    uint256 hashBlock;
+    uint256 hashSproutAnchor;
+    uint256 hashSaplingAnchor;
+    //! the memory of the coins outside the pools
+    size_t nCoinsUsage;
+
+    CFlush() :
+        mapCoins(0, CCoinsKeyHasher(), CCoinsMap::key_equal(), CCoinsMap::allocator_type(&coinsResource)),
+        mapSproutNullifiers(0, CCoinsKeyHasher(), CNullifiersMap::key_equal(), CNullifiersMap::allocator_type(&sproutNullifiersResource)),
+        mapSaplingNullifiers(0, CCoinsKeyHasher(), CNullifiersMap::key_equal(), CNullifiersMap::allocator_type(&saplingNullifiersResource)),
+        nCoinsUsage(0) {}
+
+    const CNullifiersMap& Nullifiers(ShieldedType type) const
+    {
+        switch (type) {
+            case SPROUT:
+                return mapSproutNullifiers;
+            case SAPLING:
+                return mapSaplingNullifiers;
+            default:
+                throw runtime_error("Unknown shielded type");
+        }
+    }
+};
+
+// Move the dirty anchors or nullifiers of from to to, leaving from empty
+template<typename Map, typename MapEntry>
+static void MoveDirtyEntries(Map &from, Map &to)
+{
+    for (typename Map::iterator it = from.begin(); it != from.end();) {
+        if (it->second.flags & MapEntry::DIRTY)
+            to[it->first] = it->second;
+        typename Map::iterator itOld = it++;
+        from.erase(itOld);
+    }
+}
+
+CCoinsViewBackgroundFlush::CCoinsViewBackgroundFlush(CCoinsView *viewIn, CCoinsViewDB *dbIn) :
+    CCoinsViewBacked(viewIn), db(dbIn), fFailed(false), fStop(false)
+{
+    thread = boost::thread(&CCoinsViewBackgroundFlush::ThreadFlush, this);
+}
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = true;
+        condFlush.notify_all();
+    }
+    thread.join();
+}
+
+void CCoinsViewBackgroundFlush::ThreadFlush()
+{
+    RenameThread("komodo-coinsflush");
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (true) {
+        while (!fStop && (!pending || fFailed))
+            condFlush.wait(lock);
+        // a pending flush is still written on a stop
+        if (!pending || fFailed)
+            return;
+        // BatchWrite waits for this write to replace the flush, the reads meanwhile only look into it
+        const CFlush &flush = *pending;
+        lock.unlock();
+
+        int64_t nStart = GetTimeMicros();
+        bool fOk = false;
+        try {
+            fOk = db->WriteCoins(flush.mapCoins, flush.hashBlock, flush.hashSproutAnchor, flush.hashSaplingAnchor,
+                                 flush.mapSproutAnchors, flush.mapSaplingAnchors, flush.mapSproutNullifiers, flush.mapSaplingNullifiers);
+        } catch (const std::exception &e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        LogPrint("coindb", "Background flush of %u transactions written in %.2fms\n", (unsigned int)flush.mapCoins.size(), 0.001 * (GetTimeMicros() - nStart));
+
+        std::unique_ptr<CFlush> written;
+        lock.lock();
+        if (fOk) {
+            written.swap(pending);
+        } else {
+            LogPrintf("%s: failed to write to the coin database\n", __func__);
+            fFailed = true;
+        }
+        condFlush.notify_all();
+        // the pools of the written flush are freed without holding up the reads
+        lock.unlock();
+        written.reset();
+        lock.lock();
+    }
+}
+
+void CCoinsViewBackgroundFlush::WaitForWrite(boost::unique_lock<boost::mutex> &lock) const
+{
+    while (pending && !fFailed)
+        condFlush.wait(lock);
+}
+
+bool CCoinsViewBackgroundFlush::GetSproutAnchorAt(const uint256 &rt, SproutMerkleTree &tree) const {
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (pending) {
+            CAnchorsSproutMap::const_iterator it = pending->mapSproutAnchors.find(rt);
+            if (it != pending->mapSproutAnchors.end()) {
+                if (!it->second.entered)
+                    return false;
+                tree = it->second.tree;
+                return true;
+            }
+        }
+    }
+    return base->GetSproutAnchorAt(rt, tree);
+}
+
+bool CCoinsViewBackgroundFlush::GetSaplingAnchorAt(const uint256 &rt, SaplingMerkleTree &tree) const {
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (pending) {
+            CAnchorsSaplingMap::const_iterator it = pending->mapSaplingAnchors.find(rt);
+            if (it != pending->mapSaplingAnchors.end()) {
+                if (!it->second.entered)
+                    return false;
+                tree = it->second.tree;
+                return true;
+            }
+        }
+    }
+    return base->GetSaplingAnchorAt(rt, tree);
+}
+
+bool CCoinsViewBackgroundFlush::GetNullifier(const uint256 &nullifier, ShieldedType type) const {
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (pending) {
+            const CNullifiersMap &mapNullifiers = pending->Nullifiers(type);
+            CNullifiersMap::const_iterator it = mapNullifiers.find(nullifier);
+            if (it != mapNullifiers.end())
+                return it->second.entered;
+        }
+    }
+    return base->GetNullifier(nullifier, type);
+}
+
+bool CCoinsViewBackgroundFlush::GetCoins(const uint256 &txid, CCoins &coins) const {
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (pending) {
+            CCoinsMap::const_iterator it = pending->mapCoins.find(txid);
+            if (it != pending->mapCoins.end()) {
+                coins = it->second.coins;
+                return true;
+            }
+        }
+    }
+    return base->GetCoins(txid, coins);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoins(const uint256 &txid) const {
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (pending) {
+            CCoinsMap::const_iterator it = pending->mapCoins.find(txid);
+            if (it != pending->mapCoins.end())
+                return !it->second.coins.IsPruned();
+        }
+    }
+    return base->HaveCoins(txid);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const {
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (pending && !pending->hashBlock.IsNull())
+            return pending->hashBlock;
+    }
+    return base->GetBestBlock();
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestAnchor(ShieldedType type) const {
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (pending) {
+            const uint256 &hashAnchor = type == SPROUT ? pending->hashSproutAnchor : type == SAPLING ? pending->hashSaplingAnchor : uint256();
+            if (!hashAnchor.IsNull())
+                return hashAnchor;
+        }
+    }
+    return base->GetBestAnchor(type);
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CCoinsMap &mapCoins,
+                                           const uint256 &hashBlockIn,
+                                           const uint256 &hashSproutAnchorIn,
+                                           const uint256 &hashSaplingAnchorIn,
+                                           CAnchorsSproutMap &mapSproutAnchors,
+                                           CAnchorsSaplingMap &mapSaplingAnchors,
+                                           CNullifiersMap &mapSproutNullifiers,
+                                           CNullifiersMap &mapSaplingNullifiers) {
+    boost::unique_lock<boost::mutex> lock(cs);
+    WaitForWrite(lock);
+    if (fFailed)
+        return false;
+
+    pending.reset(new CFlush());
+    CFlush &flush = *pending;
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            CCoinsCacheEntry &entry = flush.mapCoins[it->first];
+            entry.coins.swap(it->second.coins);
+            entry.flags = it->second.flags;
+            flush.nCoinsUsage += entry.coins.DynamicMemoryUsage();
+        }
+        CCoinsMap::iterator itOld = it++;
+        mapCoins.erase(itOld);
+    }
+    ::MoveDirtyEntries<CAnchorsSproutMap, CAnchorsSproutCacheEntry>(mapSproutAnchors, flush.mapSproutAnchors);
+    ::MoveDirtyEntries<CAnchorsSaplingMap, CAnchorsSaplingCacheEntry>(mapSaplingAnchors, flush.mapSaplingAnchors);
+    ::MoveDirtyEntries<CNullifiersMap, CNullifiersCacheEntry>(mapSproutNullifiers, flush.mapSproutNullifiers);
+    ::MoveDirtyEntries<CNullifiersMap, CNullifiersCacheEntry>(mapSaplingNullifiers, flush.mapSaplingNullifiers);
+    flush.hashBlock = hashBlockIn;
+    flush.hashSproutAnchor = hashSproutAnchorIn;
+    flush.hashSaplingAnchor = hashSaplingAnchorIn;
+    condFlush.notify_all();
+    return true;
+}
+
+bool CCoinsViewBackgroundFlush::GetStats(CCoinsStats &stats) const {
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        WaitForWrite(lock);
+    }
+    return base->GetStats(stats);
+}
+
+bool CCoinsViewBackgroundFlush::Sync() {
+    boost::unique_lock<boost::mutex> lock(cs);
+    WaitForWrite(lock);
+    return !fFailed;
+}
+
+bool CCoinsViewBackgroundFlush::HasFailed() const {
+    boost::unique_lock<boost::mutex> lock(cs);
+    return fFailed;
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe, bool compression, int maxOpenFiles) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, compression, maxOpenFiles) {
+size_t CCoinsViewBackgroundFlush::DynamicMemoryUsage() const {
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (!pending)
+        return 0;
+    return pending->coinsResource.DynamicMemoryUsage() +
+           memusage::DynamicUsage(pending->mapSproutAnchors) +
+           memusage::DynamicUsage(pending->mapSaplingAnchors) +
+           pending->sproutNullifiersResource.DynamicMemoryUsage() +
+           pending->saplingNullifiersResource.DynamicMemoryUsage() +
+           pending->nCoinsUsage;
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe, bool compression, int maxOpenFiles, size_t nIndexCacheSize) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, compression, maxOpenFiles), pindexdb(NULL) {
+    if (nIndexCacheSize > 0)
+        pindexdb = new CDBWrapper(GetDataDir() / "blocks" / "indexes", nIndexCacheSize, fMemory, fWipe, compression, maxOpenFiles);
+}
+
+CBlockTreeDB::~CBlockTreeDB() {
+    delete pindexdb;
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -236,53 +782,189 @@ bool CBlockTreeDB::ReadReindexing(bool &fReindexing) {
     return true;
 }
 
+bool CBlockTreeDB::ReadDiskBlockIndex(const uint256 &hash, CDiskBlockIndex &diskindex) {
+    return Read(make_pair(DB_BLOCK_INDEX, hash), diskindex);
+}
+
 bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
     return Read(DB_LAST_BLOCK, nFile);
 }
 
 bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
+    CCoinsRunningStats running;
+    if (!db.Read(DB_COINS_STATS, running))
+        return ScanStats(stats);
+    RunningStatsToStats(running, stats);
+    LOCK(cs_main);
+    BlockMap::iterator mi = mapBlockIndex.find(stats.hashBlock);
+    if (mi != mapBlockIndex.end() && mi->second != NULL)
+        stats.nHeight = mi->second->GetHeight();
+    return true;
+}
+
+bool CCoinsViewDB::ScanStats(CCoinsStats &stats, CCoinsRunningStats *pRunning) const {
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
     boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper*>(&db)->NewIterator());
-    pcursor->Seek(DB_COINS);
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    MuHash3072 muhash;
     stats.hashBlock = GetBestBlock();
     ss << stats.hashBlock;
     CAmount nTotalAmount = 0;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        CCoins coins;
-        if (pcursor->GetKey(key) && key.first == DB_COINS) {
-            if (pcursor->GetValue(coins)) {
-                stats.nTransactions++;
-                for (unsigned int i=0; i<coins.vout.size(); i++) {
-                    const CTxOut &out = coins.vout[i];
-                    if (!out.IsNull()) {
-                        stats.nTransactionOutputs++;
-                        ss << VARINT(i+1);
-                        ss << out;
-                        nTotalAmount += out.nValue;
-                    }
-                }
-                stats.nSerializedSize += 32 + pcursor->GetValueSize();
-                ss << VARINT(0);
-            } else {
-                return error("CCoinsViewDB::GetStats() : unable to read value");
+    // the sizes are those of the record per transaction, whatever the format
+    auto addCoins = [&](const uint256 &txid, const CCoins &coins) {
+        stats.nTransactions++;
+        for (unsigned int i=0; i<coins.vout.size(); i++) {
+            const CTxOut &out = coins.vout[i];
+            if (!out.IsNull()) {
+                stats.nTransactionOutputs++;
+                ss << VARINT(i+1);
+                ss << out;
+                nTotalAmount += out.nValue;
+                HashCoinsStatsOutput(muhash, txid, i, coins, out, true);
             }
-        } else {
+        }
+        stats.nSerializedSize += 32 + ::GetSerializeSize(coins, SER_DISK, CLIENT_VERSION);
+        ss << VARINT(0);
+    };
+
+    // the outputs of a transaction are next to each other
+    uint256 txid;
+    CCoins coins;
+    for (pcursor->Seek(DB_COIN); pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, COutPoint> key;
+        if (!pcursor->GetKey(key) || key.first != DB_COIN)
             break;
+        if (key.second.hash != txid) {
+            if (!coins.vout.empty())
+                addCoins(txid, coins);
+            txid = key.second.hash;
+            coins.Clear();
         }
-        pcursor->Next();
+        CCoinsOutputValue value;
+        if (!pcursor->GetValue(value))
+            return error("CCoinsViewDB::GetStats() : unable to read value");
+        if (key.second.n >= coins.vout.size())
+            coins.vout.resize(key.second.n + 1);
+        coins.vout[key.second.n] = value.out;
+        coins.nVersion = value.nVersion;
+        coins.nHeight = value.nHeight;
+        coins.fCoinBase = value.fCoinBase;
+    }
+    if (!coins.vout.empty())
+        addCoins(txid, coins);
+
+    for (pcursor->Seek(DB_COINS); pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_COINS)
+            break;
+        if (!pcursor->GetValue(coins))
+            return error("CCoinsViewDB::GetStats() : unable to read value");
+        addCoins(key.second, coins);
     }
     {
         LOCK(cs_main);
-        stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->GetHeight();
+        BlockMap::iterator mi = mapBlockIndex.find(stats.hashBlock);
+        if (mi != mapBlockIndex.end() && mi->second != NULL)
+            stats.nHeight = mi->second->GetHeight();
     }
     stats.hashSerialized = ss.GetHash();
     stats.nTotalAmount = nTotalAmount;
+    muhash.Finalize(stats.hashMuHash.begin());
+    if (pRunning != NULL) {
+        pRunning->hashBlock = stats.hashBlock;
+        pRunning->nTransactions = stats.nTransactions;
+        pRunning->nTransactionOutputs = stats.nTransactionOutputs;
+        pRunning->nSerializedSize = stats.nSerializedSize;
+        pRunning->nTotalAmount = stats.nTotalAmount;
+        pRunning->muhash = muhash;
+    }
+    return true;
+}
+
+bool CCoinsViewDB::InitRunningStats() {
+    ReadRunningStats();
+    if (fRunningStats)
+        return true;
+    CCoinsRunningStats running;
+    CCoinsStats stats;
+    LogPrintf("Computing the UTXO set statistics, once...\n");
+    if (!ScanStats(stats, &running))
+        return false;
+    if (!db.Write(DB_COINS_STATS, running, true))
+        return false;
+    runningStats = running;
+    fRunningStats = true;
+    return true;
+}
+
+CDBIterator *CCoinsViewDB::RawCursor() const {
+    return const_cast<CDBWrapper*>(&db)->NewIterator();
+}
+
+bool CCoinsViewDB::WriteRaw(const std::vector<std::pair<std::string, std::string> > &entries, const uint256 &hashBlock) {
+    CDBBatch batch(db);
+    const std::string strBestBlock(1, DB_BEST_BLOCK);
+    for (std::vector<std::pair<std::string, std::string> >::const_iterator it=entries.begin(); it != entries.end(); it++) {
+        if (it->first != strBestBlock)
+            batch.WriteRaw(it->first, it->second);
+    }
+    if (!hashBlock.IsNull())
+        batch.Write(DB_BEST_BLOCK, hashBlock);
+    // the entries may have the running statistics of the snapshot, and coins in either format
+    fRunningStatsRead = false;
+    if (!db.WriteBatch(batch, true))
+        return false;
+    ReadCoinsFormat();
+    return true;
+}
+
+bool CCoinsViewDB::UpgradeCoinsFormat() {
+    if (!fLegacyCoins)
+        return true;
+    // from the format record on every write is per output, the coins not rewritten yet are read from their old records
+    if (!fPerOutputMarked) {
+        if (!db.Write(DB_COINS_FORMAT, COINS_FORMAT_PER_OUTPUT, true))
+            return false;
+        fPerOutput = fPerOutputMarked = true;
+    }
+    LogPrintf("Upgrading the coin database to one record per output...\n");
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(DB_COINS);
+    CDBBatch batch(db);
+    size_t nBatch = 0;
+    uint64_t nTransactions = 0;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_COINS)
+            break;
+        CCoins coins;
+        if (!pcursor->GetValue(coins))
+            return error("%s: unable to read the coins of %s", __func__, key.second.ToString());
+        batch.Erase(key);
+        BatchWriteCoinOutputs(batch, key.second, CCoins(), coins);
+        nTransactions++;
+        if (++nBatch == COINS_UPGRADE_BATCH_SIZE) {
+            if (!db.WriteBatch(batch))
+                return false;
+            batch.Clear();
+            nBatch = 0;
+            if (nTransactions % (COINS_UPGRADE_BATCH_SIZE * 100) == 0)
+                LogPrintf("Upgraded the coins of %u transactions\n", nTransactions);
+            if (ShutdownRequested()) {
+                LogPrintf("Coin database upgrade interrupted after %u transactions, it goes on at the next start\n", nTransactions);
+                return true;
+            }
+        }
+    }
+    if (nBatch > 0 && !db.WriteBatch(batch))
+        return false;
+    fLegacyCoins = false;
+    LogPrintf("Upgraded the coins of %u transactions to one record per output\n", nTransactions);
     return true;
 }
 
@@ -294,6 +976,14 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     batch.Write(DB_LAST_BLOCK, nLastFile);
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
+        if ((*it)->notaryid != -2)
+            batch.Write(make_pair(DB_BLOCK_SIGNER, (*it)->GetBlockHash()), CBlockSignerValue(*it));
+        if ((*it)->segid != -2)
+            batch.Write(make_pair(DB_BLOCK_SEGID, (*it)->GetBlockHash()), (*it)->segid);
+        else
+            batch.Erase(make_pair(DB_BLOCK_SEGID, (*it)->GetBlockHash()));
+        if ((*it)->fHaveNewcoins)
+            batch.Write(make_pair(DB_BLOCK_SUPPLY, (*it)->GetBlockHash()), CBlockSupplyValue(*it));
     }
     return WriteBatch(batch, true);
 }
@@ -302,6 +992,9 @@ bool CBlockTreeDB::EraseBatchSync(const std::vector<const CBlockIndex*>& blockin
     CDBBatch batch(*this);
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Erase(make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()));
+        batch.Erase(make_pair(DB_BLOCK_SIGNER, (*it)->GetBlockHash()));
+        batch.Erase(make_pair(DB_BLOCK_SEGID, (*it)->GetBlockHash()));
+        batch.Erase(make_pair(DB_BLOCK_SUPPLY, (*it)->GetBlockHash()));
     }
     return WriteBatch(batch, true);
 }
@@ -317,12 +1010,28 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadPrunedTx(const uint256 &txid, CTransaction &tx, uint256 &hashBlock) {
+    std::pair<uint256, CTransaction> value;
+    if (!Read(make_pair(DB_PRUNEDTX, txid), value))
+        return false;
+    hashBlock = value.first;
+    tx = value.second;
+    return true;
+}
+
+bool CBlockTreeDB::WritePrunedTxs(const std::vector<std::pair<uint256, CTransaction> > &list) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<uint256, CTransaction> >::const_iterator it=list.begin(); it!=list.end(); it++)
+        batch.Write(make_pair(DB_PRUNEDTX, it->second.GetHash()), *it);
+    return WriteBatch(batch, true);
+}
+
 bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(make_pair(DB_SPENTINDEX, key), value);
+    return IndexDB().Read(make_pair(DB_SPENTINDEX, key), value);
 }
 
 bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
-    CDBBatch batch(*this);
+    CDBBatch batch(IndexDB());
     for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
         if (it->second.IsNull()) {
             batch.Erase(make_pair(DB_SPENTINDEX, it->first));
@@ -330,11 +1039,95 @@ bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey,
             batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
         }
     }
-    return WriteBatch(batch);
+    return IndexDB().WriteBatch(batch);
+}
+
+void CBlockTreeDB::BatchAddressBalances(CDBBatch &batch, const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect) {
+    typedef std::pair<unsigned int, uint160> AddressKey;
+    typedef std::pair<AddressKey, std::pair<uint256, size_t> > OutputKey;
+    // the unspent values as vect left them, for the outputs created and spent in the same batch
+    std::map<OutputKey, CAmount> pending;
+    std::map<AddressKey, CAddressBalanceValue> deltas;
+
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        OutputKey output(AddressKey(it->first.type, it->first.hashBytes), std::make_pair(it->first.txhash, it->first.index));
+        CAmount oldValue = 0, newValue = it->second.IsNull() ? 0 : it->second.satoshis;
+        std::map<OutputKey, CAmount>::iterator pos = pending.find(output);
+        if (pos != pending.end()) {
+            oldValue = pos->second;
+        } else {
+            CAddressUnspentValue value;
+            if (IndexDB().Read(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), value))
+                oldValue = value.satoshis;
+        }
+        pending[output] = newValue;
+        // zero value outputs are not counted, as the snapshots skip them
+        CAddressBalanceValue &delta = deltas[output.first];
+        delta.satoshis += newValue - oldValue;
+        delta.utxos += (newValue != 0) - (oldValue != 0);
+    }
+
+    CAddressBalanceTotals totals;
+    IndexDB().Read(DB_ADDRESSBALANCE_TOTALS, totals);
+    for (std::map<AddressKey, CAddressBalanceValue>::const_iterator it=deltas.begin(); it!=deltas.end(); it++) {
+        if (it->second.satoshis == 0 && it->second.utxos == 0)
+            continue;
+        CAddressIndexIteratorKey key(it->first.first, it->first.second);
+        CAddressBalanceValue balance;
+        IndexDB().Read(make_pair(DB_ADDRESSBALANCE, key), balance);
+        if (balance.utxos > 0)
+            batch.Erase(make_pair(DB_ADDRESSRICHLIST, CAddressRichListKey(balance.satoshis, key.type, key.hashBytes)));
+        totals.Add(key.type, balance, -1);
+        balance.satoshis += it->second.satoshis;
+        balance.utxos += it->second.utxos;
+        totals.Add(key.type, balance, 1);
+        if (balance.utxos > 0) {
+            batch.Write(make_pair(DB_ADDRESSBALANCE, key), balance);
+            batch.Write(make_pair(DB_ADDRESSRICHLIST, CAddressRichListKey(balance.satoshis, key.type, key.hashBytes)), 0);
+        } else {
+            batch.Erase(make_pair(DB_ADDRESSBALANCE, key));
+        }
+    }
+    batch.Write(DB_ADDRESSBALANCE_TOTALS, totals);
+}
+
+bool CBlockTreeDB::ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &balance) {
+    balance = CAddressBalanceValue();
+    return IndexDB().Read(make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(type, addressHash)), balance);
+}
+
+bool CBlockTreeDB::ReadAddressBalanceTotals(CAddressBalanceTotals &totals) {
+    totals = CAddressBalanceTotals();
+    return IndexDB().Read(DB_ADDRESSBALANCE_TOTALS, totals);
+}
+
+bool CBlockTreeDB::ForEachAddressRichList(const std::function<bool(const CAddressRichListKey&)> &func) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(IndexDB().NewIterator());
+
+    // walk back from the first key after the rich list
+    pcursor->Seek((char)(DB_ADDRESSRICHLIST + 1));
+    if (pcursor->Valid())
+        pcursor->Prev();
+    else
+        pcursor->SeekToLast();
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CAddressRichListKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSRICHLIST)
+            break;
+        if (!func(key.second))
+            break;
+        pcursor->Prev();
+    }
+    return true;
 }
 
 bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
-    CDBBatch batch(*this);
+    CDBBatch batch(IndexDB());
+    if (fAddressBalanceIndex)
+        BatchAddressBalances(batch, vect);
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
         if (it->second.IsNull()) {
             batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
@@ -342,30 +1135,48 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddres
             batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
         }
     }
-    return WriteBatch(batch);
+    return IndexDB().WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
                                            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+    return ForEachAddressUnspentIndex(addressHash, type, NULL, [&](const CAddressUnspentKey &key, const CAddressUnspentValue &value) {
+        unspentOutputs.push_back(make_pair(key, value));
+        return true;
+    });
+}
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+bool CBlockTreeDB::ForEachAddressUnspentIndex(uint160 addressHash, int type, const CAddressUnspentKey *pStartAfter,
+                                              const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> &func) {
 
-    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    boost::scoped_ptr<CDBIterator> pcursor(IndexDB().NewIterator());
+    CAddressUnspentKey startKey;
+
+    if (pStartAfter != NULL) {
+        startKey = *pStartAfter;  // func may change *pStartAfter
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, startKey));
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         try {
-            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
             pair<char, CAddressUnspentKey> keyObj;
             pcursor->GetKey(keyObj);
             char chType = keyObj.first;
             CAddressUnspentKey indexKey = keyObj.second;
 
             if (chType == DB_ADDRESSUNSPENTINDEX && indexKey.hashBytes == addressHash) {
+                if (pStartAfter != NULL && indexKey.type == startKey.type && indexKey.txhash == startKey.txhash && indexKey.index == startKey.index) {
+                    pcursor->Next();
+                    continue;
+                }
                 try {
                     CAddressUnspentValue nValue;
                     pcursor->GetValue(nValue);
-                    unspentOutputs.push_back(make_pair(indexKey, nValue));
+                    if (!func(indexKey, nValue))
+                        break;
                     pcursor->Next();
                 } catch (const std::exception& e) {
                     return error("failed to get address unspent value");
@@ -381,26 +1192,110 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
 }
 
 bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
+    CDBBatch batch(IndexDB());
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
+    return IndexDB().WriteBatch(batch);
 }
 
 bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
+    CDBBatch batch(IndexDB());
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
+    return IndexDB().WriteBatch(batch);
+}
+
+bool CBlockTreeDB::WriteDisconnectedIndexes(const std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                            const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &addressUnspentIndex,
+                                            const std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentCCIndex) {
+    CDBBatch batch(IndexDB());
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++)
+        batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
+    if (fAddressBalanceIndex)
+        BatchAddressBalances(batch, addressUnspentIndex);
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=addressUnspentIndex.begin(); it!=addressUnspentIndex.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+        }
+    }
+    for (std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> >::const_iterator it=unspentCCIndex.begin(); it!=unspentCCIndex.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSUNSPENT_CC_INDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSUNSPENT_CC_INDEX, it->first), it->second);
+        }
+    }
+    return IndexDB().WriteBatch(batch);
+}
+
+bool CBlockTreeDB::WriteConnectedIndexes(const std::vector<std::pair<uint256, CDiskTxPos> > &txIndex,
+                                         const std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                         const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &addressUnspentIndex,
+                                         const std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentCCIndex,
+                                         const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > &spentIndex,
+                                         const uint256 &hashBlock, unsigned int logicalTS) {
+    CDBBatch batch(*this);
+    CDBBatch separateBatch(IndexDB());
+    CDBBatch &indexBatch = pindexdb != NULL ? separateBatch : batch;
+
+    for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=txIndex.begin(); it!=txIndex.end(); it++)
+        batch.Write(make_pair(DB_TXINDEX, it->first), it->second);
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++)
+        indexBatch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
+    if (fAddressBalanceIndex)
+        BatchAddressBalances(indexBatch, addressUnspentIndex);
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=addressUnspentIndex.begin(); it!=addressUnspentIndex.end(); it++) {
+        if (it->second.IsNull()) {
+            indexBatch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
+        } else {
+            indexBatch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+        }
+    }
+    for (std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> >::const_iterator it=unspentCCIndex.begin(); it!=unspentCCIndex.end(); it++) {
+        if (it->second.IsNull()) {
+            indexBatch.Erase(make_pair(DB_ADDRESSUNSPENT_CC_INDEX, it->first));
+        } else {
+            indexBatch.Write(make_pair(DB_ADDRESSUNSPENT_CC_INDEX, it->first), it->second);
+        }
+    }
+    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=spentIndex.begin(); it!=spentIndex.end(); it++) {
+        if (it->second.IsNull()) {
+            indexBatch.Erase(make_pair(DB_SPENTINDEX, it->first));
+        } else {
+            indexBatch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
+        }
+    }
+    if (logicalTS != 0) {
+        indexBatch.Write(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexKey(logicalTS, hashBlock)), 0);
+        indexBatch.Write(make_pair(DB_BLOCKHASHINDEX, CTimestampBlockIndexKey(hashBlock)), CTimestampBlockIndexValue(logicalTS));
+    }
+
+    if (pindexdb != NULL && !pindexdb->WriteBatch(separateBatch))
+        return false;
     return WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                                     int start, int end) {
+    return ForEachAddressIndex(addressHash, type, start, end, NULL, [&](const CAddressIndexKey &key, CAmount nValue) {
+        addressIndex.push_back(make_pair(key, nValue));
+        return true;
+    });
+}
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+bool CBlockTreeDB::ForEachAddressIndex(uint160 addressHash, int type, int start, int end, const CAddressIndexKey *pStartAfter,
+                                       const std::function<bool(const CAddressIndexKey&, CAmount)> &func) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(IndexDB().NewIterator());
+    CAddressIndexKey startKey;
 
-    if (start > 0 && end > 0) {
+    if (pStartAfter != NULL) {
+        startKey = *pStartAfter;  // func may change *pStartAfter
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, startKey));
+    } else if (start > 0 && end > 0) {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
     } else {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
@@ -418,11 +1313,17 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                 if (end > 0 && indexKey.blockHeight > end) {
                     break;
                 }
+                if (pStartAfter != NULL && indexKey.type == startKey.type && indexKey.blockHeight == startKey.blockHeight && indexKey.txindex == startKey.txindex &&
+                    indexKey.txhash == startKey.txhash && indexKey.index == startKey.index && indexKey.spending == startKey.spending) {
+                    pcursor->Next();
+                    continue;
+                }
                 try {
                     CAmount nValue;
                     pcursor->GetValue(nValue);
 
-                    addressIndex.push_back(make_pair(indexKey, nValue));
+                    if (!func(indexKey, nValue))
+                        break;
                     pcursor->Next();
                 } catch (const std::exception& e) {
                     return error("failed to get address index value");
@@ -438,6 +1339,42 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool CBlockTreeDB::ForEachAddressIndexReverse(uint160 addressHash, int type, int start, int end, const CAddressIndexKey *pStartBefore,
+                                              const std::function<bool(const CAddressIndexKey&, CAmount)> &func) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(IndexDB().NewIterator());
+
+    // walk back from the first key after the range
+    if (pStartBefore != NULL)
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, *pStartBefore));
+    else
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, end > 0 ? end + 1 : std::numeric_limits<int>::max())));
+    if (pcursor->Valid())
+        pcursor->Prev();
+    else
+        pcursor->SeekToLast();
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        pair<char, CAddressIndexKey> keyObj;
+        if (!pcursor->GetKey(keyObj) || keyObj.first != DB_ADDRESSINDEX || keyObj.second.hashBytes != addressHash || keyObj.second.type != (unsigned int)type)
+            break;
+        const CAddressIndexKey &indexKey = keyObj.second;
+        if (start > 0 && indexKey.blockHeight < start)
+            break;
+        if (end <= 0 || indexKey.blockHeight <= end) {
+            CAmount nValue;
+            if (!pcursor->GetValue(nValue))
+                return error("failed to get address index value");
+            if (!func(indexKey, nValue))
+                break;
+        }
+        pcursor->Prev();
+    }
+
+    return true;
+}
+
 bool getAddressFromIndex(const int &type, const uint160 &hash, std::string &address);
 uint32_t komodo_segid32(char *coinaddr);
 
@@ -461,76 +1398,123 @@ uint32_t komodo_segid32(char *coinaddr);
     {"RD6GgnrMpPaTSMn8vai6yiGA7mN4QGPVMY", 1} \
 };
 
+static const std::map <std::string,int> &SnapshotIgnoreList()
+{
+    static DECLARE_IGNORELIST
+    return ignoredMap;
+}
+
+bool SnapshotIgnoredAddress(const std::string &address)
+{
+    return SnapshotIgnoreList().count(address) != 0;
+}
+
 bool CBlockTreeDB::Snapshot2(std::map <std::string, CAmount> &addressAmounts, UniValue *ret)
 {
     int64_t total = 0; int64_t totalAddresses = 0; std::string address;
     int64_t utxos = 0; int64_t ignoredAddresses = 0, cryptoConditionsUTXOs = 0, cryptoConditionsTotals = 0;
     DECLARE_IGNORELIST
-    boost::scoped_ptr<CDBIterator> iter(NewIterator());
+    boost::scoped_ptr<CDBIterator> iter(IndexDB().NewIterator());
     //std::map <std::string, CAmount> addressAmounts;
-    for (iter->SeekToLast(); iter->Valid(); iter->Prev())
+    if (fAddressBalanceIndex)
     {
-        boost::this_thread::interruption_point();
-        try
+        // the address balance index has the sums of the unspent index by address
+        for (iter->Seek(DB_ADDRESSBALANCE); iter->Valid(); iter->Next())
         {
-            std::vector<unsigned char> slKey = std::vector<unsigned char>();
-            pair<char, CAddressIndexIteratorKey> keyObj;
-            iter->GetKey(keyObj);
-            char chType = keyObj.first;
+            boost::this_thread::interruption_point();
+            pair<char, CAddressIndexIteratorKey> keyObj; CAddressBalanceValue balance;
+            if (!iter->GetKey(keyObj) || keyObj.first != DB_ADDRESSBALANCE)
+                break;
+            if (!iter->GetValue(balance))
+            {
+                fprintf(stderr, "DONE %s: LevelDB address balance index read failure\n", __func__);
+                return false;
+            }
             CAddressIndexIteratorKey indexKey = keyObj.second;
-            //fprintf(stderr, "chType=%d\n", chType);
-            if (chType == DB_ADDRESSUNSPENTINDEX)
+            if ( indexKey.type == 3 )
             {
-                try {
-                    CAmount nValue;
-                    iter->GetValue(nValue);
-                    if ( nValue == 0 )
-                        continue;
-                    getAddressFromIndex(indexKey.type, indexKey.hashBytes, address);
-                    if ( indexKey.type == 3 )
-                    {
-                        cryptoConditionsUTXOs++;
-                        cryptoConditionsTotals += nValue;
+                cryptoConditionsUTXOs += balance.utxos;
+                cryptoConditionsTotals += balance.satoshis;
+                total += balance.satoshis;
+                continue;
+            }
+            getAddressFromIndex(indexKey.type, indexKey.hashBytes, address);
+            if (ignoredMap.find(address) != ignoredMap.end())
+            {
+                fprintf(stderr,"ignoring %s\n", address.c_str());
+                ignoredAddresses += balance.utxos;
+                continue;
+            }
+            addressAmounts[address] += balance.satoshis;
+            totalAddresses++;
+            utxos += balance.utxos;
+            total += balance.satoshis;
+        }
+    }
+    else
+    {
+        // only the address unspent index range is read, the sums do not depend on the order of its entries
+        for (iter->Seek(DB_ADDRESSUNSPENTINDEX); iter->Valid(); iter->Next())
+        {
+            boost::this_thread::interruption_point();
+            try
+            {
+                pair<char, CAddressIndexIteratorKey> keyObj;
+                if (!iter->GetKey(keyObj) || keyObj.first != DB_ADDRESSUNSPENTINDEX)
+                    break;
+                CAddressIndexIteratorKey indexKey = keyObj.second;
+                {
+                    try {
+                        CAmount nValue;
+                        iter->GetValue(nValue);
+                        if ( nValue == 0 )
+                            continue;
+                        getAddressFromIndex(indexKey.type, indexKey.hashBytes, address);
+                        if ( indexKey.type == 3 )
+                        {
+                            cryptoConditionsUTXOs++;
+                            cryptoConditionsTotals += nValue;
+                            total += nValue;
+                            continue;
+                        }
+                        std::map <std::string, int>::iterator ignored = ignoredMap.find(address);
+                        if (ignored != ignoredMap.end())
+                        {
+                            fprintf(stderr,"ignoring %s\n", address.c_str());
+                            ignoredAddresses++;
+                            continue;
+                        }
+                        std::map <std::string, CAmount>::iterator pos = addressAmounts.find(address);
+                        if ( pos == addressAmounts.end() )
+                        {
+                            // insert new address + utxo amount
+                            //fprintf(stderr, "inserting new address %s with amount %li\n", address.c_str(), nValue);
+                            addressAmounts[address] = nValue;
+                            totalAddresses++;
+                        }
+                        else
+                        {
+                            // update unspent tally for this address
+                            //fprintf(stderr, "updating address %s with new utxo amount %li\n", address.c_str(), nValue);
+                            addressAmounts[address] += nValue;
+                        }
+                        //fprintf(stderr,"{\"%s\", %.8f},\n",address.c_str(),(double)nValue/COIN);
+                        // total += nValue;
+                        utxos++;
                         total += nValue;
-                        continue;
-                    }
-                    std::map <std::string, int>::iterator ignored = ignoredMap.find(address);
-                    if (ignored != ignoredMap.end())
-                    {
-                        fprintf(stderr,"ignoring %s\n", address.c_str());
-                        ignoredAddresses++;
-                        continue;
-                    }
-                    std::map <std::string, CAmount>::iterator pos = addressAmounts.find(address);
-                    if ( pos == addressAmounts.end() )
-                    {
-                        // insert new address + utxo amount
-                        //fprintf(stderr, "inserting new address %s with amount %li\n", address.c_str(), nValue);
-                        addressAmounts[address] = nValue;
-                        totalAddresses++;
                     }
-                    else
+                    catch (const std::exception& e)
                     {
-                        // update unspent tally for this address
-                        //fprintf(stderr, "updating address %s with new utxo amount %li\n", address.c_str(), nValue);
-                        addressAmounts[address] += nValue;
+                        fprintf(stderr, "DONE %s: LevelDB addressindex exception! - %s\n", __func__, e.what());
+                        return false; //break; this means failiure of DB? we need to exit here if so for consensus code!
                     }
-                    //fprintf(stderr,"{\"%s\", %.8f},\n",address.c_str(),(double)nValue/COIN);
-                    // total += nValue;
-                    utxos++;
-                    total += nValue;
-                }
-                catch (const std::exception& e)
-                {
-                    fprintf(stderr, "DONE %s: LevelDB addressindex exception! - %s\n", __func__, e.what());
-                    return false; //break; this means failiure of DB? we need to exit here if so for consensus code!
                 }
             }
-        }
-        catch (const std::exception& e)
-        {
-            fprintf(stderr, "DONE reading index entries\n");
-            break;
+            catch (const std::exception& e)
+            {
+                fprintf(stderr, "DONE reading index entries\n");
+                break;
+            }
         }
     }
     //fprintf(stderr, "total=%f, totalAddresses=%li, utxos=%li, ignored=%li\n", (double) total / COIN, totalAddresses, utxos, ignoredAddresses);
@@ -560,6 +1544,47 @@ bool CBlockTreeDB::Snapshot2(std::map <std::string, CAmount> &addressAmounts, Un
     return true;
 }
 
+bool CBlockTreeDB::SnapshotRichList(int top, std::vector <std::pair<CAmount, std::string>> &vaddr, UniValue *ret)
+{
+    CAddressBalanceTotals totals; int64_t ignoredAddresses = 0; std::string address;
+    if (!fAddressBalanceIndex)
+        return false;
+    ReadAddressBalanceTotals(totals);
+    // the ignored addresses are taken out of the totals as Snapshot2 skips them
+    for (const auto &ignored : SnapshotIgnoreList())
+    {
+        uint160 hashBytes; int type; CAddressBalanceValue balance;
+        if (!CBitcoinAddress(ignored.first).GetIndexKey(hashBytes, type, false) || type == 3 || !ReadAddressBalance(hashBytes, type, balance) || balance.utxos <= 0)
+            continue;
+        totals.Add(type, balance, -1);
+        ignoredAddresses += balance.utxos;
+    }
+    // read the richest addresses and those with the same balance as the last of them, for the same order as sorting all of them
+    ForEachAddressRichList([&](const CAddressRichListKey &key) {
+        if (vaddr.size() >= (size_t)top && key.satoshis < vaddr.back().first)
+            return false;
+        if (key.type == 3 || !getAddressFromIndex(key.type, key.hashBytes, address) || SnapshotIgnoredAddress(address))
+            return true;
+        vaddr.push_back(make_pair(key.satoshis, address));
+        return true;
+    });
+    std::sort(vaddr.rbegin(), vaddr.rend());
+    if (ret)
+    {
+        CAmount total = totals.satoshis + totals.ccSatoshis;
+        ret->push_back(make_pair("total", (double) (total)/ COIN ));
+        ret->push_back(make_pair("average",(double) (total/COIN) / totals.addresses ));
+        ret->push_back(make_pair("utxos", totals.utxos));
+        ret->push_back(make_pair("total_addresses", totals.addresses ));
+        ret->push_back(make_pair("ignored_addresses", ignoredAddresses));
+        ret->push_back(make_pair("skipped_cc_utxos", totals.ccUtxos));
+        ret->push_back(make_pair("cc_utxo_value", (double) totals.ccSatoshis / COIN));
+        ret->push_back(make_pair("total_includeCCvouts", (double) (total+totals.ccSatoshis)/ COIN ));
+        ret->push_back(make_pair("ending_height", chainActive.Height()));
+    }
+    return true;
+}
+
 extern std::vector <std::pair<CAmount, CTxDestination>> vAddressSnapshot;
 
 UniValue CBlockTreeDB::Snapshot(int top)
@@ -571,9 +1596,15 @@ UniValue CBlockTreeDB::Snapshot(int top)
     UniValue result(UniValue::VOBJ);
     UniValue addressesSorted(UniValue::VARR);
     result.push_back(Pair("start_time", (int) time(NULL)));
-    if ( (vAddressSnapshot.size() > 0 && top < 0) || (Snapshot2(addressAmounts,&result) && top >= 0) )
+    // with the address balance index the top addresses are read from the rich list
+    bool fRichList = fAddressBalanceIndex && top > 0;
+    if ( (fRichList && SnapshotRichList(top,vaddr,&result)) || (!fRichList && ((vAddressSnapshot.size() > 0 && top < 0) || (Snapshot2(addressAmounts,&result) && top >= 0))) )
     {
-        if ( top > -1 )
+        if ( fRichList )
+        {
+            // vaddr is already sorted
+        }
+        else if ( top > -1 )
         {
             for (std::pair<std::string, CAmount> element : addressAmounts)
                 vaddr.push_back( make_pair(element.second, element.first) );
@@ -607,14 +1638,14 @@ UniValue CBlockTreeDB::Snapshot(int top)
 }
 
 bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
-    CDBBatch batch(*this);
+    CDBBatch batch(IndexDB());
     batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
-    return WriteBatch(batch);
+    return IndexDB().WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes) {
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    boost::scoped_ptr<CDBIterator> pcursor(IndexDB().NewIterator());
 
     pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
 
@@ -648,21 +1679,38 @@ bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned i
 }
 
 bool CBlockTreeDB::WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts) {
-    CDBBatch batch(*this);
+    CDBBatch batch(IndexDB());
     batch.Write(make_pair(DB_BLOCKHASHINDEX, blockhashIndex), logicalts);
-    return WriteBatch(batch);
+    return IndexDB().WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp) {
 
     CTimestampBlockIndexValue(lts);
-    if (!Read(std::make_pair(DB_BLOCKHASHINDEX, hash), lts))
+    if (!IndexDB().Read(std::make_pair(DB_BLOCKHASHINDEX, hash), lts))
 	return false;
 
     ltimestamp = lts.ltimestamp;
     return true;
 }
 
+bool CBlockTreeDB::ReadIndexBuilderBest(uint256 &hashBest, int &nIndexes) {
+    std::pair<uint256, int> best;
+    if (!IndexDB().Read(DB_INDEXBUILDER_BEST, best))
+        return false;
+    hashBest = best.first;
+    nIndexes = best.second;
+    return true;
+}
+
+bool CBlockTreeDB::WriteIndexBuilderBest(const uint256 &hashBest, int nIndexes) {
+    return IndexDB().Write(DB_INDEXBUILDER_BEST, std::make_pair(hashBest, nIndexes));
+}
+
+bool CBlockTreeDB::EraseIndexBuilderBest() {
+    return IndexDB().Erase(DB_INDEXBUILDER_BEST);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -745,12 +1793,194 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
         }
     }
 
+    return LoadBlockSigners() && LoadBlockSegids() && LoadBlockSupply();
+}
+
+bool CBlockTreeDB::LoadBlockSigners()
+{
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_BLOCK_SIGNER, uint256()));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_BLOCK_SIGNER)
+            break;
+        CBlockSignerValue signer;
+        if (!pcursor->GetValue(signer))
+            return error("LoadBlockSigners() : failed to read value");
+        BlockMap::iterator mi = mapBlockIndex.find(key.second);
+        if (mi != mapBlockIndex.end() && mi->second != NULL) {
+            memcpy(mi->second->pubkey33, signer.pubkey33, sizeof(signer.pubkey33));
+            mi->second->notaryid = signer.notaryid;
+        }
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CBlockTreeDB::LoadBlockSupply()
+{
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_BLOCK_SUPPLY, uint256()));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_BLOCK_SUPPLY)
+            break;
+        CBlockSupplyValue supply;
+        if (!pcursor->GetValue(supply))
+            return error("LoadBlockSupply() : failed to read value");
+        BlockMap::iterator mi = mapBlockIndex.find(key.second);
+        if (mi != mapBlockIndex.end() && mi->second != NULL) {
+            mi->second->newcoins = supply.newcoins;
+            mi->second->zfunds = supply.zfunds;
+            mi->second->sproutfunds = supply.sproutfunds;
+            mi->second->fHaveNewcoins = true;
+        }
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CBlockTreeDB::LoadBlockSegids()
+{
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_BLOCK_SEGID, uint256()));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_BLOCK_SEGID)
+            break;
+        int8_t segid;
+        if (!pcursor->GetValue(segid))
+            return error("LoadBlockSegids() : failed to read value");
+        BlockMap::iterator mi = mapBlockIndex.find(key.second);
+        // the segid serialized with the index entry after the hardfork takes precedence
+        if (mi != mapBlockIndex.end() && mi->second != NULL && mi->second->segid == -2)
+            mi->second->segid = segid;
+        pcursor->Next();
+    }
     return true;
 }
 
+namespace {
+
+/** Block index entries read from one key range of the block tree db */
+struct CBlockIndexShard
+{
+    CBlockIndexShard() : fOk(true) {}
+    std::vector<std::pair<uint256, CDiskBlockIndex> > vEntries;
+    bool fOk;
+    std::string strError;
+};
+
+/** Read and hash the block index entries whose hash starts with a byte in [nBegin, nEnd) */
+void ReadBlockIndexShard(CBlockTreeDB *pdb, int nBegin, int nEnd, CBlockIndexShard *pshard)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(pdb->NewIterator());
+
+    uint256 hashBegin;
+    *hashBegin.begin() = (unsigned char)nBegin;
+    pcursor->Seek(make_pair(DB_BLOCK_INDEX, hashBegin));
+
+    while (pcursor->Valid()) {
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX || *key.second.begin() >= nEnd)
+            break;
+        CDiskBlockIndex diskindex;
+        if (!pcursor->GetValue(diskindex)) {
+            pshard->fOk = false;
+            pshard->strError = "LoadBlockIndex() : failed to read value";
+            return;
+        }
+        // Consistency check, see the serial path
+        uint256 hash = diskindex.GetBlockHash();
+        CBlockHeader header;
+        header.nVersion = diskindex.nVersion;
+        header.hashPrevBlock = diskindex.hashPrev;
+        header.hashMerkleRoot = diskindex.hashMerkleRoot;
+        header.hashFinalSaplingRoot = diskindex.hashFinalSaplingRoot;
+        header.nTime = diskindex.nTime;
+        header.nBits = diskindex.nBits;
+        header.nNonce = diskindex.nNonce;
+        header.nSolution = diskindex.nSolution;
+        if (header.GetHash() != hash) {
+            pshard->fOk = false;
+            pshard->strError = strprintf("LoadBlockIndex(): block header inconsistency detected: on-disk = %s", diskindex.ToString());
+            return;
+        }
+        pshard->vEntries.push_back(std::make_pair(hash, diskindex));
+        pcursor->Next();
+    }
+}
+
+}
+
+bool CBlockTreeDB::LoadBlockIndexGuts(int nThreads)
+{
+    if (nThreads <= 1)
+        return LoadBlockIndexGuts();
+
+    int64_t nStart = GetTimeMillis();
+    // Split the key range on the first byte of the block hash, they are uniformly distributed
+    std::vector<CBlockIndexShard> vShards(nThreads);
+    boost::thread_group readThreads;
+    for (int i = 0; i < nThreads; i++)
+        readThreads.create_thread(boost::bind(&ReadBlockIndexShard, this, 256 * i / nThreads, 256 * (i + 1) / nThreads, &vShards[i]));
+    readThreads.join_all();
+    boost::this_thread::interruption_point();
+
+    size_t nEntries = 0;
+    BOOST_FOREACH(const CBlockIndexShard &shard, vShards) {
+        if (!shard.fOk)
+            return error("%s", shard.strError);
+        nEntries += shard.vEntries.size();
+    }
+    int64_t nRead = GetTimeMillis();
+
+    // Stitch the entries into mapBlockIndex in key order, the same order as the serial path
+    mapBlockIndex.reserve(mapBlockIndex.size() + nEntries);
+    BOOST_FOREACH(CBlockIndexShard &shard, vShards) {
+        for (size_t i = 0; i < shard.vEntries.size(); i++) {
+            const CDiskBlockIndex &diskindex = shard.vEntries[i].second;
+            CBlockIndex* pindexNew = InsertBlockIndex(shard.vEntries[i].first);
+            pindexNew->pprev          = InsertBlockIndex(diskindex.hashPrev);
+            pindexNew->SetHeight(diskindex.GetHeight());
+            pindexNew->nFile          = diskindex.nFile;
+            pindexNew->nDataPos       = diskindex.nDataPos;
+            pindexNew->nUndoPos       = diskindex.nUndoPos;
+            pindexNew->hashSproutAnchor     = diskindex.hashSproutAnchor;
+            pindexNew->nVersion       = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->hashFinalSaplingRoot   = diskindex.hashFinalSaplingRoot;
+            pindexNew->nTime          = diskindex.nTime;
+            pindexNew->nBits          = diskindex.nBits;
+            pindexNew->nNonce         = diskindex.nNonce;
+            pindexNew->nSolution      = diskindex.nSolution;
+            pindexNew->nStatus        = diskindex.nStatus;
+            pindexNew->nCachedBranchId = diskindex.nCachedBranchId;
+            pindexNew->nTx            = diskindex.nTx;
+            pindexNew->nSproutValue   = diskindex.nSproutValue;
+            pindexNew->nSaplingValue  = diskindex.nSaplingValue;
+            pindexNew->segid          = diskindex.segid;
+            pindexNew->nNotaryPay     = diskindex.nNotaryPay;
+        }
+        std::vector<std::pair<uint256, CDiskBlockIndex> >().swap(shard.vEntries);
+    }
+    LogPrintf("%s: read %u entries with %d threads in %dms, linked in %dms\n", __func__,
+              (unsigned int)nEntries, nThreads, nRead - nStart, GetTimeMillis() - nRead);
+    return LoadBlockSigners() && LoadBlockSegids() && LoadBlockSupply();
+}
+
 // update or erase entry for unspent cc index
 bool CBlockTreeDB::UpdateUnspentCCIndex(const std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue > >&vect) {
-    CDBBatch batch(*this);
+    CDBBatch batch(IndexDB());
     for (std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
         if (it->second.IsNull()) {
             batch.Erase(make_pair(DB_ADDRESSUNSPENT_CC_INDEX, it->first));
@@ -758,14 +1988,15 @@ bool CBlockTreeDB::UpdateUnspentCCIndex(const std::vector<std::pair<CUnspentCCIn
             batch.Write(make_pair(DB_ADDRESSUNSPENT_CC_INDEX, it->first), it->second);
         }
     }
-    return WriteBatch(batch);
+    return IndexDB().WriteBatch(batch);
 }
 
 // read unspent cc index by address or address+creationid key
 bool CBlockTreeDB::ReadUnspentCCIndex(uint160 addressHash, uint256 creationid,
-                                           std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, int32_t beginHeight, int32_t endHeight, int64_t maxOutputs) {
+                                           std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, int32_t beginHeight, int32_t endHeight, int64_t maxOutputs,
+                                           const std::string &funcids) {
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    boost::scoped_ptr<CDBIterator> pcursor(IndexDB().NewIterator());
 
     if (creationid.IsNull())
         pcursor->Seek(make_pair(DB_ADDRESSUNSPENT_CC_INDEX, CUnspentCCIndexKeyAddr(addressHash)));  //search first address
@@ -786,7 +2017,8 @@ bool CBlockTreeDB::ReadUnspentCCIndex(uint160 addressHash, uint256 creationid,
                 try {
                     CUnspentCCIndexValue ccValue;
                     pcursor->GetValue(ccValue);
-                    if ((beginHeight < 0 || ccValue.blockHeight >= beginHeight) && (endHeight < 0 || ccValue.blockHeight <= endHeight))   { 
+                    if ((beginHeight < 0 || ccValue.blockHeight >= beginHeight) && (endHeight < 0 || ccValue.blockHeight <= endHeight) &&
+                        (funcids.empty() || funcids.find((char)ccValue.funcid) != std::string::npos))   { 
                         unspentOutputs.push_back(make_pair(indexKey, ccValue));
                         n ++;
                     }
@@ -804,3 +2036,219 @@ bool CBlockTreeDB::ReadUnspentCCIndex(uint160 addressHash, uint256 creationid,
     }
     return true;
 }
+
+bool CBlockTreeDB::ReadTokenBalance(const CTokenBalanceKey &key, CAmount &balance) {
+    balance = 0;
+    if (!Exists(make_pair(DB_TOKENBALANCE_INDEX, key)))
+        return true;
+    return Read(make_pair(DB_TOKENBALANCE_INDEX, key), balance);
+}
+
+// read the balances of all tokens on an address
+bool CBlockTreeDB::ReadTokenBalances(uint8_t evalcode, uint160 addressHash, std::vector<std::pair<CTokenBalanceKey, CAmount> > &balances) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_TOKENBALANCE_INDEX, CTokenBalanceKeyAddr(evalcode, addressHash)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            pair<char, CTokenBalanceKey> keyObj;
+            if (!pcursor->GetKey(keyObj) || keyObj.first != DB_TOKENBALANCE_INDEX || keyObj.second.evalcode != evalcode || keyObj.second.hashBytes != addressHash)
+                break;
+            CAmount balance;
+            if (!pcursor->GetValue(balance))
+                return error("failed to get token balance index value");
+            balances.push_back(make_pair(keyObj.second, balance));
+            pcursor->Next();
+        } catch (const std::exception& e) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::ReadTokenBalanceUtxo(const COutPoint &outpoint, CTokenBalanceUtxo &utxo) {
+    return Read(make_pair(DB_TOKENBALANCE_UTXO, outpoint), utxo);
+}
+
+bool CBlockTreeDB::ReadTokenBalanceUndo(const uint256 &hashBlock, CTokenBalanceUndo &undo) {
+    return Read(make_pair(DB_TOKENBALANCE_UNDO, hashBlock), undo);
+}
+
+bool CBlockTreeDB::WriteTokenBalanceIndex(const std::map<CTokenBalanceKey, CAmount> &balances,
+                                          const std::vector<std::pair<COutPoint, CTokenBalanceUtxo> > &utxos, const std::vector<COutPoint> &erasedUtxos,
+                                          const uint256 &hashBlock, const CTokenBalanceUndo *undo) {
+    CDBBatch batch(*this);
+    for (std::map<CTokenBalanceKey, CAmount>::const_iterator it=balances.begin(); it!=balances.end(); it++) {
+        if (it->second == 0)
+            batch.Erase(make_pair(DB_TOKENBALANCE_INDEX, it->first));
+        else
+            batch.Write(make_pair(DB_TOKENBALANCE_INDEX, it->first), it->second);
+    }
+    for (std::vector<COutPoint>::const_iterator it=erasedUtxos.begin(); it!=erasedUtxos.end(); it++)
+        batch.Erase(make_pair(DB_TOKENBALANCE_UTXO, *it));
+    for (std::vector<std::pair<COutPoint, CTokenBalanceUtxo> >::const_iterator it=utxos.begin(); it!=utxos.end(); it++)
+        batch.Write(make_pair(DB_TOKENBALANCE_UTXO, it->first), it->second);
+    if (undo == NULL)
+        batch.Erase(make_pair(DB_TOKENBALANCE_UNDO, hashBlock));
+    else if (!undo->IsEmpty())
+        batch.Write(make_pair(DB_TOKENBALANCE_UNDO, hashBlock), *undo);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadOraclesSamples(const COraclesSampleKey &endKey, int startHeight, int num, std::vector<std::pair<COraclesSampleKey, COraclesSample> > &samples) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    // the keys are iterated backwards from the last key before endKey
+    pcursor->Seek(make_pair(DB_ORACLES_SAMPLE, endKey));
+    if (pcursor->Valid())
+        pcursor->Prev();
+    else
+        pcursor->SeekToLast();
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            pair<char, COraclesSampleKey> keyObj;
+            if (!pcursor->GetKey(keyObj) || keyObj.first != DB_ORACLES_SAMPLE || keyObj.second.oracletxid != endKey.oracletxid ||
+                keyObj.second.hashBytes != endKey.hashBytes || keyObj.second.blockHeight < startHeight)
+                break;
+            COraclesSample sample;
+            if (!pcursor->GetValue(sample))
+                return error("failed to get oracles sample index value");
+            samples.push_back(make_pair(keyObj.second, sample));
+            if (num > 0 && samples.size() >= (size_t)num)
+                break;
+            pcursor->Prev();
+        } catch (const std::exception& e) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::WriteOraclesSamples(const std::vector<std::pair<COraclesSampleKey, COraclesSample> > &samples) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<COraclesSampleKey, COraclesSample> >::const_iterator it=samples.begin(); it!=samples.end(); it++)
+        batch.Write(make_pair(DB_ORACLES_SAMPLE, it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseOraclesSamples(const std::vector<COraclesSampleKey> &keys) {
+    CDBBatch batch(*this);
+    for (std::vector<COraclesSampleKey>::const_iterator it=keys.begin(); it!=keys.end(); it++)
+        batch.Erase(make_pair(DB_ORACLES_SAMPLE, *it));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadTokenTagEvents(const uint256 &tokentagid, std::vector<std::pair<CTokenTagEventKey, CTokenTagEvent> > &events) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_TOKENTAGS_EVENT, CTokenTagEventKey(tokentagid, 0, 0)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            pair<char, CTokenTagEventKey> keyObj;
+            if (!pcursor->GetKey(keyObj) || keyObj.first != DB_TOKENTAGS_EVENT || keyObj.second.tokentagid != tokentagid)
+                break;
+            CTokenTagEvent event;
+            if (!pcursor->GetValue(event))
+                return error("failed to get token tags index value");
+            events.push_back(make_pair(keyObj.second, event));
+            pcursor->Next();
+        } catch (const std::exception& e) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::WriteTokenTagEvents(const std::vector<std::pair<CTokenTagEventKey, CTokenTagEvent> > &events) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CTokenTagEventKey, CTokenTagEvent> >::const_iterator it=events.begin(); it!=events.end(); it++)
+        batch.Write(make_pair(DB_TOKENTAGS_EVENT, it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseTokenTagEvents(const std::vector<CTokenTagEventKey> &keys) {
+    CDBBatch batch(*this);
+    for (std::vector<CTokenTagEventKey>::const_iterator it=keys.begin(); it!=keys.end(); it++)
+        batch.Erase(make_pair(DB_TOKENTAGS_EVENT, *it));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAgreementEvents(const uint256 &agreementtxid, std::vector<std::pair<CAgreementEventKey, CAgreementEvent> > &events) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_AGREEMENTS_EVENT, CAgreementEventKey(agreementtxid, 0, 0)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            pair<char, CAgreementEventKey> keyObj;
+            if (!pcursor->GetKey(keyObj) || keyObj.first != DB_AGREEMENTS_EVENT || keyObj.second.agreementtxid != agreementtxid)
+                break;
+            CAgreementEvent event;
+            if (!pcursor->GetValue(event))
+                return error("failed to get agreements index value");
+            events.push_back(make_pair(keyObj.second, event));
+            pcursor->Next();
+        } catch (const std::exception& e) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::WriteAgreementEvents(const std::vector<std::pair<CAgreementEventKey, CAgreementEvent> > &events) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CAgreementEventKey, CAgreementEvent> >::const_iterator it=events.begin(); it!=events.end(); it++)
+        batch.Write(make_pair(DB_AGREEMENTS_EVENT, it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseAgreementEvents(const std::vector<CAgreementEventKey> &keys) {
+    CDBBatch batch(*this);
+    for (std::vector<CAgreementEventKey>::const_iterator it=keys.begin(); it!=keys.end(); it++)
+        batch.Erase(make_pair(DB_AGREEMENTS_EVENT, *it));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadGatewaysMarkers(const uint256 &bindtxid, std::vector<std::pair<CGatewaysMarkerKey, CGatewaysMarker> > &markers) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_GATEWAYS_MARKER, CGatewaysMarkerKey(bindtxid, uint256())));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            pair<char, CGatewaysMarkerKey> keyObj;
+            if (!pcursor->GetKey(keyObj) || keyObj.first != DB_GATEWAYS_MARKER || keyObj.second.bindtxid != bindtxid)
+                break;
+            CGatewaysMarker marker;
+            if (!pcursor->GetValue(marker))
+                return error("failed to get gateways index value");
+            markers.push_back(make_pair(keyObj.second, marker));
+            pcursor->Next();
+        } catch (const std::exception& e) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::UpdateGatewaysMarkers(const std::vector<std::pair<CGatewaysMarkerKey, CGatewaysMarker> > &markers, const std::vector<CGatewaysMarkerKey> &spent) {
+    CDBBatch batch(*this);
+    for (std::vector<CGatewaysMarkerKey>::const_iterator it=spent.begin(); it!=spent.end(); it++)
+        batch.Erase(make_pair(DB_GATEWAYS_MARKER, *it));
+    for (std::vector<std::pair<CGatewaysMarkerKey, CGatewaysMarker> >::const_iterator it=markers.begin(); it!=markers.end(); it++)
+        batch.Write(make_pair(DB_GATEWAYS_MARKER, it->first), it->second);
+    return WriteBatch(batch);
+}
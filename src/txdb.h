@@ -24,15 +24,29 @@
 #include "coins.h"
 #include "dbwrapper.h"
 #include "unspentccindex.h"
+#include "tokenbalanceindex.h"
+#include "oraclesindex.h"
+#include "tokentagsindex.h"
+#include "agreementsindex.h"
+#include "gatewaysindex.h"
+#include "addressbalanceindex.h"
+#include "crypto/muhash.h"
+#include "sync.h"
 
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 #include <univalue.h>
 
+#include <boost/thread.hpp>
+
 class CBlockFileInfo;
 class CBlockIndex;
+class CDiskBlockIndex;
+class CDBIterator;
 struct CDiskTxPos;
 struct CAddressUnspentKey;
 struct CAddressUnspentValue;
@@ -53,13 +67,61 @@ static const int64_t nDefaultDbCache = 450;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
+//! notarisations database cache (bytes)
+static const int64_t nNotarisationsDbCache = 100 << 20;
+//! -dbsharedcache default
+static const bool DEFAULT_DB_SHARED_CACHE = true;
+//! -backgroundflush default
+static const bool DEFAULT_BACKGROUND_FLUSH = true;
 
 /** CCoinsView backed by the coin database (chainstate/) */
+/**
+ * UTXO set statistics, kept up to date by CCoinsViewDB::BatchWrite in the same batch as the coins,
+ * so that gettxoutsetinfo does not scan the chainstate database
+ */
+struct CCoinsRunningStats
+{
+    uint256 hashBlock;
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    uint64_t nSerializedSize;
+    CAmount nTotalAmount;
+    MuHash3072 muhash;  //!< of the unspent outputs, with their txid, index, height and coinbase flag
+
+    CCoinsRunningStats() : nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hashBlock);
+        READWRITE(nTransactions);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nSerializedSize);
+        READWRITE(nTotalAmount);
+        READWRITE(muhash);
+    }
+};
+
 class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
     CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+private:
+    //! the running statistics as in the database, read by the first BatchWrite
+    CCoinsRunningStats runningStats;
+    bool fRunningStatsRead;
+    //! false when the database has coins but no running statistics yet, BatchWrite then leaves them to InitRunningStats
+    bool fRunningStats;
+    void ReadRunningStats();
+    //! coins are written one record per unspent output, which the format record marks once written
+    bool fPerOutput;
+    bool fPerOutputMarked;
+    //! the database may still have coins in the record per transaction format, read when there are no outputs
+    bool fLegacyCoins;
+    void ReadCoinsFormat();
+    bool GetCoinOutputs(const uint256 &txid, CCoins &coins) const;
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -78,50 +140,217 @@ public:
                     CAnchorsSaplingMap &mapSaplingAnchors,
                     CNullifiersMap &mapSproutNullifiers,
                     CNullifiersMap &mapSaplingNullifiers);
+    //! Write the dirty entries of the maps as BatchWrite does, but leave the maps as they are
+    bool WriteCoins(const CCoinsMap &mapCoins,
+                    const uint256 &hashBlock,
+                    const uint256 &hashSproutAnchor,
+                    const uint256 &hashSaplingAnchor,
+                    const CAnchorsSproutMap &mapSproutAnchors,
+                    const CAnchorsSaplingMap &mapSaplingAnchors,
+                    const CNullifiersMap &mapSproutNullifiers,
+                    const CNullifiersMap &mapSaplingNullifiers);
+    //! the running statistics, or those of a scan of the database when it has none
+    bool GetStats(CCoinsStats &stats) const;
+    //! Scan the whole database, for the serialized hash and to check the running statistics
+    bool ScanStats(CCoinsStats &stats, CCoinsRunningStats *pRunning = NULL) const;
+    //! Start the running statistics of a database that has coins but none, by a scan
+    bool InitRunningStats();
+    //! Rewrite the coins of a database in the record per transaction format one record per output. Stops early,
+    //! to resume at the next start, on a shutdown request
+    bool UpgradeCoinsFormat();
+    //! whether some coins are still in the record per transaction format
+    bool HasLegacyCoins() const { return fLegacyCoins; }
+    //! Cursor over every entry of the database as stored, for a UTXO set snapshot (see txoutsnapshot.h)
+    CDBIterator *RawCursor() const;
+    //! Write entries read by RawCursor and, when hashBlock is not null, the best block. The best block entries of a
+    //! snapshot are always skipped, so that a load interrupted before its last call leaves no best block
+    bool WriteRaw(const std::vector<std::pair<std::string, std::string> > &entries, const uint256 &hashBlock);
+};
+
+/**
+ * View between the tip cache and the coin database that writes what the tip
+ * flushes to it on a thread of its own, so a flush only costs moving the dirty
+ * entries of the tip here while blocks keep being connected on a new, empty
+ * tip. The entries are read from here until they are in the database. One
+ * write is in progress at a time, a flush arriving meanwhile waits for it.
+ *
+ * The best block is written in the same batch as the coins, so a crash during
+ * a write leaves the database at the best block of the flush before.
+ */
+class CCoinsViewBackgroundFlush : public CCoinsViewBacked
+{
+private:
+    CCoinsViewDB *db;
+
+    struct CFlush;
+
+    mutable CWaitableCriticalSection cs;
+    mutable CConditionVariable condFlush;
+    //! the flush that is not in the database yet, the thread only reads it while it writes it
+    std::unique_ptr<CFlush> pending;
+    //! the last write failed, its flush stays pending
+    bool fFailed;
+    bool fStop;
+    boost::thread thread;
+
+    void ThreadFlush();
+    //! Wait, with cs held by lock, until the thread has written the pending flush or failed to
+    void WaitForWrite(boost::unique_lock<boost::mutex> &lock) const;
+
+public:
+    //! Reads that miss the pending flush go to viewIn, the writes to dbIn under it
+    CCoinsViewBackgroundFlush(CCoinsView *viewIn, CCoinsViewDB *dbIn);
+    //! Writes a pending flush before it returns
+    ~CCoinsViewBackgroundFlush();
+
+    bool GetSproutAnchorAt(const uint256 &rt, SproutMerkleTree &tree) const;
+    bool GetSaplingAnchorAt(const uint256 &rt, SaplingMerkleTree &tree) const;
+    bool GetNullifier(const uint256 &nullifier, ShieldedType type) const;
+    bool GetCoins(const uint256 &txid, CCoins &coins) const;
+    bool HaveCoins(const uint256 &txid) const;
+    uint256 GetBestBlock() const;
+    uint256 GetBestAnchor(ShieldedType type) const;
+    //! Moves the dirty entries to this view for the thread to write, after the write in progress. False if a write failed
+    bool BatchWrite(CCoinsMap &mapCoins,
+                    const uint256 &hashBlock,
+                    const uint256 &hashSproutAnchor,
+                    const uint256 &hashSaplingAnchor,
+                    CAnchorsSproutMap &mapSproutAnchors,
+                    CAnchorsSaplingMap &mapSaplingAnchors,
+                    CNullifiersMap &mapSproutNullifiers,
+                    CNullifiersMap &mapSaplingNullifiers);
+    //! the statistics of the database once the pending flush is in it
     bool GetStats(CCoinsStats &stats) const;
+
+    //! Wait until the pending flush is in the database, false if it could not be written
+    bool Sync();
+    //! whether a write failed, the node can't go on then
+    bool HasFailed() const;
+    //! the memory of the pending flush
+    size_t DynamicMemoryUsage() const;
 };
 
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
 public:
-    CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool compression = true, int maxOpenFiles = 1000);
+    //! nIndexCacheSize > 0 keeps the address, spent, unspent CC and timestamp indexes in their own database with that cache
+    CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool compression = true, int maxOpenFiles = 1000, size_t nIndexCacheSize = 0);
+    ~CBlockTreeDB();
 private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
+    //! the database of the indexes, NULL when they share the block index database
+    CDBWrapper *pindexdb;
+    CDBWrapper &IndexDB() { return pindexdb != NULL ? *pindexdb : *this; }
+    //! Add the address balance index changes of the address unspent index updates vect to batch
+    void BatchAddressBalances(CDBBatch &batch, const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
 public:
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
     bool EraseBatchSync(const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &fileinfo);
     bool ReadLastBlockFile(int &nFile);
+    bool ReadDiskBlockIndex(const uint256 &hash, CDiskBlockIndex &diskindex);
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool &fReindex);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
+    //! transactions kept from pruned block files with the hash of their block, see -prunekeeptxs
+    bool ReadPrunedTx(const uint256 &txid, CTransaction &tx, uint256 &hashBlock);
+    bool WritePrunedTxs(const std::vector<std::pair<uint256, CTransaction> > &list);
     bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
     bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
     bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
                                  std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+    //! Call func for the unspent outputs of an address in key order, after pStartAfter if not NULL, until func returns false
+    bool ForEachAddressUnspentIndex(uint160 addressHash, int type, const CAddressUnspentKey *pStartAfter,
+                                    const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> &func);
+    bool ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &balance);
+    bool ReadAddressBalanceTotals(CAddressBalanceTotals &totals);
+    //! Call func for the addresses with a balance, richest first, until func returns false
+    bool ForEachAddressRichList(const std::function<bool(const CAddressRichListKey&)> &func);
     bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+    //! Apply the index changes of a run of disconnected blocks in one batch, in the order they were made
+    bool WriteDisconnectedIndexes(const std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                  const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &addressUnspentIndex,
+                                  const std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentCCIndex);
+    //! Write the index entries of a connected block in one batch per database, the timestamp index if logicalTS is not 0
+    bool WriteConnectedIndexes(const std::vector<std::pair<uint256, CDiskTxPos> > &txIndex,
+                               const std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                               const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &addressUnspentIndex,
+                               const std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentCCIndex,
+                               const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > &spentIndex,
+                               const uint256 &hashBlock, unsigned int logicalTS);
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
+    //! Call func for the address index entries of an address in key order, after pStartAfter if not NULL, until func returns false
+    bool ForEachAddressIndex(uint160 addressHash, int type, int start, int end, const CAddressIndexKey *pStartAfter,
+                             const std::function<bool(const CAddressIndexKey&, CAmount)> &func);
+    //! Same in reverse key order (newest first), before pStartBefore if not NULL
+    bool ForEachAddressIndexReverse(uint160 addressHash, int type, int start, int end, const CAddressIndexKey *pStartBefore,
+                                    const std::function<bool(const CAddressIndexKey&, CAmount)> &func);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &vect);
     bool WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
     bool ReadTimestampBlockIndex(const uint256 &hash, unsigned int &logicalTS);
+    //! Last block indexed by the background index builder, with the indexes it builds
+    bool ReadIndexBuilderBest(uint256 &hashBest, int &nIndexes);
+    bool WriteIndexBuilderBest(const uint256 &hashBest, int nIndexes);
+    bool EraseIndexBuilderBest();
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts();
+    //! Read the block index with nThreads threads, each one reading and hashing a part of the key range
+    bool LoadBlockIndexGuts(int nThreads);
+    //! Attach the persisted coinbase signers to the loaded mapBlockIndex entries
+    bool LoadBlockSigners();
+    //! Attach the persisted staking segids to the loaded mapBlockIndex entries that did not serialize one
+    bool LoadBlockSegids();
+    //! Attach the persisted komodo_newcoins results to the loaded mapBlockIndex entries
+    bool LoadBlockSupply();
     bool blockOnchainActive(const uint256 &hash);
     UniValue Snapshot(int top);
     bool Snapshot2(std::map <std::string, CAmount> &addressAmounts, UniValue *ret);
+    //! Snapshot of the top addresses from the address balance index rich list, vaddr sorted as Snapshot sorts the Snapshot2 balances
+    bool SnapshotRichList(int top, std::vector <std::pair<CAmount, std::string>> &vaddr, UniValue *ret);
 
     bool UpdateUnspentCCIndex(const std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue > >&vect);
     bool ReadUnspentCCIndex(uint160 addressHash, uint256 creationid,
-                                 std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &vect, int32_t beginHeight, int32_t endHeight, int64_t maxOutputs);
+                                 std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &vect, int32_t beginHeight, int32_t endHeight, int64_t maxOutputs,
+                                 const std::string &funcids = std::string());
+
+    bool ReadTokenBalance(const CTokenBalanceKey &key, CAmount &balance);
+    bool ReadTokenBalances(uint8_t evalcode, uint160 addressHash, std::vector<std::pair<CTokenBalanceKey, CAmount> > &balances);
+    bool ReadTokenBalanceUtxo(const COutPoint &outpoint, CTokenBalanceUtxo &utxo);
+    bool ReadTokenBalanceUndo(const uint256 &hashBlock, CTokenBalanceUndo &undo);
+    //! Write the token balances (zero balances are erased) and utxos of a connected or disconnected block in one batch,
+    //! with its undo data, or erase the undo data if undo is NULL
+    bool WriteTokenBalanceIndex(const std::map<CTokenBalanceKey, CAmount> &balances,
+                                const std::vector<std::pair<COutPoint, CTokenBalanceUtxo> > &utxos, const std::vector<COutPoint> &erasedUtxos,
+                                const uint256 &hashBlock, const CTokenBalanceUndo *undo);
+
+    //! Read the samples of an oracle publisher with keys before endKey, newest first, down to startHeight and at most num samples (0 = all)
+    bool ReadOraclesSamples(const COraclesSampleKey &endKey, int startHeight, int num, std::vector<std::pair<COraclesSampleKey, COraclesSample> > &samples);
+    bool WriteOraclesSamples(const std::vector<std::pair<COraclesSampleKey, COraclesSample> > &samples);
+    bool EraseOraclesSamples(const std::vector<COraclesSampleKey> &keys);
+
+    //! Read the events of a token tag in chain order
+    bool ReadTokenTagEvents(const uint256 &tokentagid, std::vector<std::pair<CTokenTagEventKey, CTokenTagEvent> > &events);
+    bool WriteTokenTagEvents(const std::vector<std::pair<CTokenTagEventKey, CTokenTagEvent> > &events);
+    bool EraseTokenTagEvents(const std::vector<CTokenTagEventKey> &keys);
+
+    //! Read the events and references of an agreement in chain order
+    bool ReadAgreementEvents(const uint256 &agreementtxid, std::vector<std::pair<CAgreementEventKey, CAgreementEvent> > &events);
+    bool WriteAgreementEvents(const std::vector<std::pair<CAgreementEventKey, CAgreementEvent> > &events);
+    bool EraseAgreementEvents(const std::vector<CAgreementEventKey> &keys);
+    bool ReadGatewaysMarkers(const uint256 &bindtxid, std::vector<std::pair<CGatewaysMarkerKey, CGatewaysMarker> > &markers);
+    bool UpdateGatewaysMarkers(const std::vector<std::pair<CGatewaysMarkerKey, CGatewaysMarker> > &markers, const std::vector<CGatewaysMarkerKey> &spent);
 };
 
+/** true for the addresses Snapshot2 leaves out of the snapshot balances */
+bool SnapshotIgnoredAddress(const std::string &address);
+
 #endif // BITCOIN_TXDB_H
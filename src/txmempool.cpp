@@ -25,6 +25,7 @@
 #include "consensus/validation.h"
 #include "main.h"
 #include "policy/fees.h"
+#include "random.h"
 #include "streams.h"
 #include "timedata.h"
 #include "util.h"
@@ -35,10 +36,14 @@
 
 #include "cc/CCinclude.h"
 
+#include <algorithm>
+
 using namespace std;
 
+CMempoolIndexHasher::CMempoolIndexHasher() : salt(GetRandHash()) {}
+
 CTxMemPoolEntry::CTxMemPoolEntry():
-    nFee(0), nTxSize(0), nModSize(0), nUsageSize(0), nTime(0), dPriority(0.0),
+    tx(MakeTransactionRef(CTransaction())), nFee(0), nTxSize(0), nModSize(0), nUsageSize(0), nTime(0), dPriority(0.0),
     hadNoDependencies(false), spendsCoinbase(false)
 {
     nHeight = MEMPOOL_HEIGHT;
@@ -48,12 +53,12 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
                                  int64_t _nTime, double _dPriority,
                                  unsigned int _nHeight, bool poolHasNoInputsOf,
                                  bool _spendsCoinbase, uint32_t _nBranchId):
-    tx(_tx), nFee(_nFee), nTime(_nTime), dPriority(_dPriority), nHeight(_nHeight),
+    tx(MakeTransactionRef(_tx)), nFee(_nFee), nTime(_nTime), dPriority(_dPriority), nHeight(_nHeight),
     hadNoDependencies(poolHasNoInputsOf),
     spendsCoinbase(_spendsCoinbase), nBranchId(_nBranchId)
 {
-    nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-    nModSize = tx.CalculateModifiedSize(nTxSize);
+    nTxSize = ::GetSerializeSize(*tx, SER_NETWORK, PROTOCOL_VERSION);
+    nModSize = tx->CalculateModifiedSize(nTxSize);
     nUsageSize = RecursiveDynamicUsage(tx);
     feeRate = CFeeRate(nFee, nTxSize);
 }
@@ -66,7 +71,7 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTxMemPoolEntry& other)
 double
 CTxMemPoolEntry::GetPriority(unsigned int currentHeight) const
 {
-    CAmount nValueIn = tx.GetValueOut()+nFee;
+    CAmount nValueIn = tx->GetValueOut()+nFee;
     double deltaPriority = ((double)(currentHeight-nHeight)*nValueIn)/nModSize;
     double dResult = dPriority + deltaPriority;
     return dResult;
@@ -80,6 +85,10 @@ CTxMemPool::CTxMemPool(const CFeeRate& _minRelayFee) :
     // of transactions in the pool
     nCheckFrequency = 0;
 
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = false;
+    rollingMinimumFeeRate = 0;
+
     minerPolicyEstimator = new CBlockPolicyEstimator(_minRelayFee);
 }
 
@@ -170,8 +179,10 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
                 // add index entry for vins:
                 CMempoolAddressDeltaKey key(keyType, addr.size() == 20 ? uint160(addr) : Hash160(addr), txhash, j, true);  
                 CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-                mapAddress.insert(make_pair(key, delta));
+                mapAddress.insert(key, delta);
                 inserted.push_back(key);
+                // a mempool output spent by this tx is no longer unspent
+                mapAddressUnspent.erase(CMempoolAddressDeltaKey(keyType, key.addressBytes, input.prevout.hash, input.prevout.n, 0));
             }
         }
     }
@@ -189,13 +200,25 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
             {
                 // add index entry for vouts:
                 CMempoolAddressDeltaKey key(keyType, addr.size() == 20 ? uint160(addr) : Hash160(addr), txhash, k, 0);
-                mapAddress.insert(make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
+                mapAddress.insert(key, CMempoolAddressDelta(entry.GetTime(), out.nValue));
                 inserted.push_back(key);
+                // children already in the mempool after a reorg may spend it
+                if (mapNextTx.count(COutPoint(txhash, k)) == 0)
+                    mapAddressUnspent.insert(key, CMempoolAddressDelta(entry.GetTime(), out.nValue));
             }
         }
     }
 
-    mapAddressInserted.insert(make_pair(txhash, inserted));
+    CMempoolIndexInserted &txInserted = mapIndexInserted[txhash];
+    if (txInserted.addressKeys.empty()) {
+        txInserted.addressKeys.swap(inserted);
+        cachedIndexUsage += memusage::DynamicUsage(txInserted.addressKeys);
+    }
+}
+
+static bool CompareAddressDeltas(const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> &a, const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> &b)
+{
+    return CMempoolAddressDeltaKeyCompare()(a.first, b.first);
 }
 
 bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresses,
@@ -203,11 +226,9 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresse
 {
     LOCK(cs);
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second) {
-            results.push_back(*ait);
-            ait++;
-        }
+        size_t nStart = results.size();
+        mapAddress.GetGroup(*it, results);
+        std::sort(results.begin() + nStart, results.end(), CompareAddressDeltas);
     }
     return true;
 }
@@ -215,19 +236,45 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresse
 bool CTxMemPool::removeAddressIndex(const uint256 txhash)
 {
     LOCK(cs);
-    addressDeltaMapInserted::iterator it = mapAddressInserted.find(txhash);
+    mapIndexInsertedType::iterator it = mapIndexInserted.find(txhash);
 
-    if (it != mapAddressInserted.end()) {
-        std::vector<CMempoolAddressDeltaKey> keys = (*it).second;
+    if (it != mapIndexInserted.end()) {
+        std::vector<CMempoolAddressDeltaKey> &keys = (*it).second.addressKeys;
         for (std::vector<CMempoolAddressDeltaKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
+            if ((*mit).spending) {
+                // the mempool output this tx spent is unspent again, if its tx is still here
+                const CMempoolAddressDelta *pdelta = mapAddress.find(*mit);
+                if (pdelta != NULL) {
+                    CMempoolAddressDeltaKey prevkey((*mit).type, (*mit).addressBytes, pdelta->prevhash, pdelta->prevout, 0);
+                    const CMempoolAddressDelta *pprev = mapAddress.find(prevkey);
+                    if (pprev != NULL)
+                        mapAddressUnspent.insert(prevkey, *pprev);
+                }
+            } else
+                mapAddressUnspent.erase(*mit);
             mapAddress.erase(*mit);
         }
-        mapAddressInserted.erase(it);
+        cachedIndexUsage -= memusage::DynamicUsage(keys);
+        std::vector<CMempoolAddressDeltaKey>().swap(keys);
+        if ((*it).second.spentKeys.empty())
+            mapIndexInserted.erase(it);
     }
 
     return true;
 }
 
+bool CTxMemPool::getAddressUnspent(std::vector<std::pair<uint160, int> > &addresses,
+                                   std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results)
+{
+    LOCK(cs);
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        size_t nStart = results.size();
+        mapAddressUnspent.GetGroup(*it, results);
+        std::sort(results.begin() + nStart, results.end(), CompareAddressDeltas);
+    }
+    return true;
+}
+
 void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
 {
     LOCK(cs);
@@ -264,7 +311,11 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
             inserted.push_back(key);
         }
     }
-    mapSpentInserted.insert(make_pair(txhash, inserted));
+    CMempoolIndexInserted &txInserted = mapIndexInserted[txhash];
+    if (txInserted.spentKeys.empty()) {
+        txInserted.spentKeys.swap(inserted);
+        cachedIndexUsage += memusage::DynamicUsage(txInserted.spentKeys);
+    }
 }
 
 bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
@@ -280,17 +331,28 @@ bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     return false;
 }
 
+void CTxMemPool::getSpentOutpoints(const std::vector<COutPoint> &outpoints, std::vector<bool> &spent)
+{
+    LOCK(cs);
+    spent.resize(outpoints.size());
+    for (size_t i = 0; i < outpoints.size(); i++)
+        spent[i] = mapNextTx.count(outpoints[i]) != 0;
+}
+
 bool CTxMemPool::removeSpentIndex(const uint256 txhash)
 {
     LOCK(cs);
-    mapSpentIndexInserted::iterator it = mapSpentInserted.find(txhash);
+    mapIndexInsertedType::iterator it = mapIndexInserted.find(txhash);
 
-    if (it != mapSpentInserted.end()) {
-        std::vector<CSpentIndexKey> keys = (*it).second;
+    if (it != mapIndexInserted.end()) {
+        std::vector<CSpentIndexKey> &keys = (*it).second.spentKeys;
         for (std::vector<CSpentIndexKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
             mapSpent.erase(*mit);
         }
-        mapSpentInserted.erase(it);
+        cachedIndexUsage -= memusage::DynamicUsage(keys);
+        std::vector<CSpentIndexKey>().swap(keys);
+        if ((*it).second.addressKeys.empty())
+            mapIndexInserted.erase(it);
     }
 
     return true;
@@ -300,7 +362,6 @@ void CTxMemPool::addUnspentCCIndex(const CTxMemPoolEntry &entry, const CCoinsVie
 {
     LOCK(cs);
     const CTransaction& tx = entry.GetTx();
-    std::vector<CUnspentCCIndexKey> inserted;
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -334,9 +395,8 @@ void CTxMemPool::addUnspentCCIndex(const CTxMemPoolEntry &entry, const CCoinsVie
 
                     if (CCDecodeTxVout(vintx, input.prevout.n, evalcode, funcid, version, creationId))  {
                         CUnspentCCIndexKey key(addrHash, creationId, input.prevout.hash, input.prevout.n);
-                        mapUnspentCCIndex.erase(key);
+                        eraseUnspentCCIndex(key);
                         //std::cerr << __func__ << " removing previous from mempool cc index addrHash=" << addrHash.GetHex() << " tx=" << txhash.GetHex() << " input.prevout.hash=" << input.prevout.hash.GetHex() << " input.prevout.n=" << j << " evalcode=" << (int)evalcode << " creationId=" << creationId.GetHex() << " prevOpreturn.size()=" << prevOpreturn.size() << std::endl; 
-                        inserted.push_back(key);
                     }
                 }
             }
@@ -365,15 +425,32 @@ void CTxMemPool::addUnspentCCIndex(const CTxMemPoolEntry &entry, const CCoinsVie
                     // record cc index output with spk and opreturn
                     CUnspentCCIndexKey key(addrHash, creationId, txhash, k);
                     CUnspentCCIndexValue value(tx.vout[k].nValue, tx.vout[k].scriptPubKey, opreturn, 0, evalcode, funcid, version);
-                    mapUnspentCCIndex.insert(make_pair(key, value));
+                    insertUnspentCCIndex(key, value);
                     //std::cerr << __func__ << " adding to mempool cc index addrHash=" << addrHash.GetHex() << " tx=" << txhash.GetHex() << " nvout=" << k << " evalcode=" << (int)evalcode << " creationId=" << creationId.GetHex() << " opreturn.size()=" << opreturn.size() << " mapUnspentCCIndex.size=" << mapUnspentCCIndex.size() << std::endl; 
-                    inserted.push_back(key);
                 }
             }
         }
     }
+}
+
+void CTxMemPool::insertUnspentCCIndex(const CUnspentCCIndexKey &key, const CUnspentCCIndexValue &value)
+{
+    if (mapUnspentCCIndex.insert(key, value))
+        cachedIndexUsage += RecursiveDynamicUsage(value.scriptPubKey) + RecursiveDynamicUsage(value.opreturn);
+}
 
-    mapUnspentCCIndexInserted.insert(make_pair(txhash, inserted));
+void CTxMemPool::eraseUnspentCCIndex(const CUnspentCCIndexKey &key)
+{
+    const CUnspentCCIndexValue *pvalue = mapUnspentCCIndex.find(key);
+    if (pvalue != NULL) {
+        cachedIndexUsage -= RecursiveDynamicUsage(pvalue->scriptPubKey) + RecursiveDynamicUsage(pvalue->opreturn);
+        mapUnspentCCIndex.erase(key);
+    }
+}
+
+static bool CompareUnspentCCOutputs(const std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> &a, const std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> &b)
+{
+    return CUnspentCCIndexKeyCompare()(a.first, b.first);
 }
 
 // finds outputs by hash160 of a cc address (creationid must by null)
@@ -382,20 +459,13 @@ bool CTxMemPool::getUnspentCCIndex(const std::vector<std::pair<uint160, uint256>
 {
     LOCK(cs);
     for (std::vector<std::pair<uint160, uint256> >::const_iterator it = keys.begin(); it != keys.end(); it++) {
-        mapUnspentCCIndexType::iterator ait = mapUnspentCCIndex.lower_bound(CUnspentCCIndexKey((*it).first, (*it).second, zeroid, 0));        
-        while (ait != mapUnspentCCIndex.end() && (*ait).first.hashBytes == (*it).first && ((*ait).first.creationid == (*it).second || (*it).second.IsNull())) {
-            outputs.push_back(*ait);
-            ait++;
-        }
-
-        {
-            //std::cerr << __func__ << " (*it).first=" << (*it).first.GetHex() << std::endl;
-            mapUnspentCCIndexType::iterator ait = mapUnspentCCIndex.lower_bound(CUnspentCCIndexKey((*it).first, (*it).second, zeroid, 0));        
-            while (ait != mapUnspentCCIndex.end() ) {
-                //std::cerr << __func__ << " (*ait).first.hashBytes=" << (*ait).first.hashBytes.GetHex() << " (*ait).first.creationid=" << (*ait).first.creationid.GetHex() << " txhash=" << (*ait).first.txhash.GetHex() << " index=" << (*ait).first.index << std::endl;
-                ait++;
-            }
-        }
+        std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > addressOutputs;
+        mapUnspentCCIndex.GetGroup((*it).first, addressOutputs);
+        size_t nStart = outputs.size();
+        for (const auto &output : addressOutputs)
+            if (output.first.creationid == (*it).second || (*it).second.IsNull())
+                outputs.push_back(output);
+        std::sort(outputs.begin() + nStart, outputs.end(), CompareUnspentCCOutputs);
     }
     return true;
 }
@@ -449,7 +519,7 @@ bool CTxMemPool::removeUnspentCCIndex(const CTransaction &tx)
                     if (CCDecodeTxVout(vintx, input.prevout.n, evalcode, funcid, version, creationId))  {
                         CUnspentCCIndexKey key(addrHash, creationId, input.prevout.hash, input.prevout.n);
                         CUnspentCCIndexValue value(vintx.vout[input.prevout.n].nValue, vintx.vout[input.prevout.n].scriptPubKey, prevOpreturn, 0, evalcode, funcid, version);
-                        mapUnspentCCIndex.insert(make_pair(key, value));
+                        insertUnspentCCIndex(key, value);
                         //std::cerr << __func__ << " restoring previous to mempool cc index addrHash=" << addrHash.GetHex() << " tx=" << txhash.GetHex() << " input.prevout.hash=" << input.prevout.hash.GetHex() << " input.prevout.n=" << j << " evalcode=" << (int)evalcode << " creationId=" << creationId.GetHex() << " prevOpreturn.size()=" << prevOpreturn.size() << std::endl; 
                     }
                 }
@@ -480,7 +550,7 @@ bool CTxMemPool::removeUnspentCCIndex(const CTransaction &tx)
                     // record cc index output with spk and opreturn
                     CUnspentCCIndexKey key(addrHash, creationId, txhash, k);
                     CUnspentCCIndexValue value(tx.vout[k].nValue, tx.vout[k].scriptPubKey, opreturn, 0, evalcode, funcid, version);
-                    mapUnspentCCIndex.erase(key);
+                    eraseUnspentCCIndex(key);
                     //std::cerr << __func__ << " removing from mempool cc index addrHash=" << addrHash.GetHex() << " tx=" << txhash.GetHex() << " nvout=" << k << " evalcode=" << (int)evalcode << " creationId=" << creationId.GetHex() << " opreturn.size()=" << opreturn.size() << std::endl; 
                 }
             }
@@ -524,7 +594,9 @@ void CTxMemPool::remove(const CTransaction &origTx, std::list<CTransaction>& rem
                     txToRemove.push_back(it->second.ptx->GetHash());
                 }
             }
-            mapRecentlyAddedTx.erase(hash);
+            // a tx never announced isn't announced as removed either
+            if (mapRecentlyAddedTx.erase(hash) == 0)
+                vRecentlyRemovedTx.push_back(txCopy);
             BOOST_FOREACH(const CTxIn& txin, tx.vin)
                 mapNextTx.erase(txin.prevout);
             BOOST_FOREACH(const JSDescription& joinsplit, tx.vjoinsplit) {
@@ -713,12 +785,17 @@ void CTxMemPool::removeForBlock(const std::vector<CTransaction>& vtx, unsigned i
     BOOST_FOREACH(const CTransaction& tx, vtx)
     {
         std::list<CTransaction> dummy;
+        // the mined txs are announced with the block, not as removed
+        size_t nRemoved = vRecentlyRemovedTx.size();
         remove(tx, dummy, false);
+        vRecentlyRemovedTx.resize(nRemoved);
         removeConflicts(tx, conflicts);
         ClearPrioritisation(tx.GetHash());
     }
     // After the txs in the new block have been removed from the mempool, update policy estimates
     minerPolicyEstimator->processBlock(nBlockHeight, entries, fCurrentEstimate);
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = true;
 }
 
 /**
@@ -748,8 +825,14 @@ void CTxMemPool::clear()
     LOCK(cs);
     mapTx.clear();
     mapNextTx.clear();
+    mapAddress.clear();
+    mapAddressUnspent.clear();
+    mapSpent.clear();
+    mapUnspentCCIndex.clear();
+    mapIndexInserted.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
+    cachedIndexUsage = 0;
     ++nTransactionsUpdated;
 }
 
@@ -910,10 +993,28 @@ bool CTxMemPool::lookup(uint256 hash, CTransaction& result) const
     return true;
 }
 
+CTransactionRef CTxMemPool::get(const uint256& hash) const
+{
+    LOCK(cs);
+    indexed_transaction_set::const_iterator i = mapTx.find(hash);
+    if (i == mapTx.end())
+        return CTransactionRef();
+    return i->GetSharedTx();
+}
+
 CFeeRate CTxMemPool::estimateFee(int nBlocks) const
 {
     LOCK(cs);
-    return minerPolicyEstimator->estimateFee(nBlocks);
+    CFeeRate feeRate = minerPolicyEstimator->estimateFee(nBlocks);
+    // quiet chains rarely have the history for an estimate, short targets are estimated from the mempool then
+    if (feeRate == CFeeRate(0))
+        feeRate = minerPolicyEstimator->estimateFeeFromMempool(nBlocks, *this);
+    return feeRate;
+}
+void CTxMemPool::SetFeeEstimateHalfLife(unsigned int nBlocks)
+{
+    LOCK(cs);
+    minerPolicyEstimator->SetHalfLife(nBlocks);
 }
 double CTxMemPool::estimatePriority(int nBlocks) const
 {
@@ -1007,7 +1108,7 @@ bool CTxMemPool::nullifierExists(const uint256& nullifier, ShieldedType type) co
 void CTxMemPool::NotifyRecentlyAdded()
 {
     uint64_t recentlyAddedSequence;
-    std::vector<CTransaction> txs;
+    std::vector<CTransaction> txs, txsRemoved;
     {
         LOCK(cs);
         recentlyAddedSequence = nRecentlyAddedSequence;
@@ -1015,6 +1116,19 @@ void CTxMemPool::NotifyRecentlyAdded()
             txs.push_back(*(kv.second));
         }
         mapRecentlyAddedTx.clear();
+        txsRemoved.swap(vRecentlyRemovedTx);
+    }
+
+    for (const CTransaction& tx : txsRemoved) {
+        try {
+            GetMainSignals().TransactionRemovedFromMempool(tx);
+        } catch (const boost::thread_interrupted&) {
+            throw;
+        } catch (const std::exception& e) {
+            PrintExceptionContinue(&e, "CTxMemPool::NotifyRecentlyAdded()");
+        } catch (...) {
+            PrintExceptionContinue(NULL, "CTxMemPool::NotifyRecentlyAdded()");
+        }
     }
 
     // A race condition can occur here between these SyncWithWallets calls, and
@@ -1023,6 +1137,7 @@ void CTxMemPool::NotifyRecentlyAdded()
     // wallet transaction's block information.
     for (auto tx : txs) {
         try {
+            GetMainSignals().TransactionAddedToMempool(tx);
             SyncWithWallets(tx, NULL);
         } catch (const boost::thread_interrupted&) {
             throw;
@@ -1073,5 +1188,113 @@ bool CCoinsViewMemPool::HaveCoins(const uint256 &txid) const {
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 6 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 6 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + cachedInnerUsage;
+    size_t usage = memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 6 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + cachedInnerUsage;
+    usage += memusage::DynamicUsage(mapRecentlyAddedTx) + memusage::DynamicUsage(mapSproutNullifiers) + memusage::DynamicUsage(mapSaplingNullifiers);
+    // the side indexes grow with the pool too
+    usage += mapAddress.DynamicMemoryUsage() + mapAddressUnspent.DynamicMemoryUsage() + mapUnspentCCIndex.DynamicMemoryUsage();
+    usage += memusage::DynamicUsage(mapSpent) + memusage::DynamicUsage(mapIndexInserted);
+    return usage + cachedIndexUsage;
+}
+
+CFeeRate CTxMemPool::GetMinFee(size_t sizelimit) const {
+    LOCK(cs);
+    if (!blockSinceLastRollingFeeBump || rollingMinimumFeeRate == 0)
+        return CFeeRate(rollingMinimumFeeRate);
+
+    int64_t time = GetTime();
+    if (time > lastRollingFeeUpdate + 10) {
+        double halflife = ROLLING_FEE_HALFLIFE;
+        if (DynamicMemoryUsage() < sizelimit / 4)
+            halflife /= 4;
+        else if (DynamicMemoryUsage() < sizelimit / 2)
+            halflife /= 2;
+
+        rollingMinimumFeeRate = rollingMinimumFeeRate / pow(2.0, (time - lastRollingFeeUpdate) / halflife);
+        lastRollingFeeUpdate = time;
+
+        if (rollingMinimumFeeRate < ::minRelayTxFee.GetFeePerK() / 2) {
+            rollingMinimumFeeRate = 0;
+            return CFeeRate(0);
+        }
+    }
+    return std::max(CFeeRate(rollingMinimumFeeRate), ::minRelayTxFee);
+}
+
+void CTxMemPool::trackPackageRemoved(const CFeeRate& rate) {
+    AssertLockHeld(cs);
+    if (rate.GetFeePerK() > rollingMinimumFeeRate) {
+        rollingMinimumFeeRate = rate.GetFeePerK();
+        blockSinceLastRollingFeeBump = false;
+    }
+}
+
+// lowest fee rate transactions looked at for the package to evict
+static const int MEMPOOL_TRIM_CANDIDATES = 100;
+
+void CTxMemPool::TrimToSize(size_t sizelimit) {
+    LOCK(cs);
+
+    unsigned int nTxnRemoved = 0;
+    CFeeRate maxFeeRateRemoved(0);
+    while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
+        // A package is a transaction with all its mempool descendants, which are
+        // evicted with it. Its score is the higher of the transaction fee rate and
+        // the package fee rate, so a parent paid for by its child is kept. The
+        // score is never below the transaction fee rate, so walking up from the
+        // lowest fee rate can stop as soon as it passes the best score found.
+        const CTxMemPoolEntry *pevict = NULL;
+        CFeeRate evictScore, evictRate;
+        int nCandidates = 0;
+        for (indexed_transaction_set::nth_index<1>::type::reverse_iterator it = mapTx.get<1>().rbegin();
+             it != mapTx.get<1>().rend() && nCandidates < MEMPOOL_TRIM_CANDIDATES; it++, nCandidates++)
+        {
+            if (pevict != NULL && !(it->GetFeeRate() < evictScore))
+                break;
+            std::set<uint256> setPackage;
+            std::deque<uint256> vQueue;
+            CAmount nPackageFees = 0;
+            size_t nPackageSize = 0;
+            CAmount nModFee = 0;
+            vQueue.push_back(it->GetTx().GetHash());
+            setPackage.insert(it->GetTx().GetHash());
+            while (!vQueue.empty()) {
+                uint256 hash = vQueue.front();
+                vQueue.pop_front();
+                indexed_transaction_set::const_iterator pit = mapTx.find(hash);
+                double dPriorityDelta = 0;
+                CAmount nFeeDelta = 0;
+                ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
+                if (hash == it->GetTx().GetHash())
+                    nModFee = pit->GetFee() + nFeeDelta;
+                nPackageFees += pit->GetFee() + nFeeDelta;
+                nPackageSize += pit->GetTxSize();
+                for (std::map<COutPoint, CInPoint>::const_iterator nit = mapNextTx.lower_bound(COutPoint(hash, 0));
+                     nit != mapNextTx.end() && nit->first.hash == hash; nit++) {
+                    const uint256 &childhash = nit->second.ptx->GetHash();
+                    if (setPackage.insert(childhash).second)
+                        vQueue.push_back(childhash);
+                }
+            }
+            CFeeRate packageRate(nPackageFees, nPackageSize);
+            CFeeRate score = std::max(CFeeRate(nModFee, it->GetTxSize()), packageRate);
+            if (pevict == NULL || score < evictScore) {
+                pevict = &(*it);
+                evictScore = score;
+                evictRate = packageRate;
+            }
+        }
+
+        // evicted packages have to be outbid by new transactions
+        CFeeRate removed(evictRate.GetFeePerK() + ::minRelayTxFee.GetFeePerK());
+        trackPackageRemoved(removed);
+        maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
+
+        const CTransaction txEvict = pevict->GetTx();
+        std::list<CTransaction> txRemoved;
+        remove(txEvict, txRemoved, true);
+        nTxnRemoved += txRemoved.size();
+    }
+
+    if (maxFeeRateRemoved > CFeeRate(0))
+        LogPrint("mempool", "Removed %u txn, rolling minimum fee bumped to %s\n", nTxnRemoved, maxFeeRateRemoved.ToString());
 }
@@ -27,6 +27,7 @@
 #include "spentindex.h"
 #include "amount.h"
 #include "coins.h"
+#include "mempoolindex.h"
 #include "primitives/transaction.h"
 #include "sync.h"
 
@@ -59,7 +60,7 @@ static const unsigned int MEMPOOL_HEIGHT = 0x7FFFFFFF;
 class CTxMemPoolEntry
 {
 private:
-    CTransaction tx;
+    CTransactionRef tx;
     CAmount nFee; //! Cached to avoid expensive parent-transaction lookups
     size_t nTxSize; //! ... and avoid recomputing tx size
     size_t nModSize; //! ... and modified size for priority
@@ -79,7 +80,9 @@ public:
     CTxMemPoolEntry();
     CTxMemPoolEntry(const CTxMemPoolEntry& other);
 
-    const CTransaction& GetTx() const { return this->tx; }
+    const CTransaction& GetTx() const { return *this->tx; }
+    //! the entry's transaction itself, for keeping it without a copy
+    CTransactionRef GetSharedTx() const { return this->tx; }
     double GetPriority(unsigned int currentHeight) const;
     CAmount GetFee() const { return nFee; }
     CFeeRate GetFeeRate() const { return feeRate; }
@@ -149,8 +152,15 @@ private:
 
     uint64_t totalTxSize = 0; //! sum of all mempool tx' byte sizes
     uint64_t cachedInnerUsage; //! sum of dynamic memory usage of all the map elements (NOT the maps themselves)
+    uint64_t cachedIndexUsage = 0; //! ... and of the heap data held by the address, spent and unspent cc index entries
+
+    mutable int64_t lastRollingFeeUpdate;
+    mutable bool blockSinceLastRollingFeeBump;
+    mutable double rollingMinimumFeeRate; //! minimum fee to get into the pool, decreases exponentially
 
     std::map<uint256, const CTransaction*> mapRecentlyAddedTx;
+    //! announced txs removed other than by being mined, in the order they were removed
+    std::vector<CTransaction> vRecentlyRemovedTx;
     uint64_t nRecentlyAddedSequence = 0;
     uint64_t nNotifiedSequence = 0;
 
@@ -158,6 +168,10 @@ private:
     std::map<uint256, const CTransaction*> mapSaplingNullifiers;
 
     void checkNullifiers(ShieldedType type) const;
+
+    void insertUnspentCCIndex(const CUnspentCCIndexKey &key, const CUnspentCCIndexValue &value);
+    void eraseUnspentCCIndex(const CUnspentCCIndexKey &key);
+    void trackPackageRemoved(const CFeeRate& rate);
     
 public:
     typedef boost::multi_index_container<
@@ -176,24 +190,29 @@ public:
     mutable CCriticalSection cs;
     indexed_transaction_set mapTx;
 
+    static const int ROLLING_FEE_HALFLIFE = 60 * 60 * 12; // public only for testing
+
 private:
-    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
+    typedef CMempoolIndexMap<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyHasher> addressDeltaMap;
     addressDeltaMap mapAddress;
 
-    typedef std::map<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
-    addressDeltaMapInserted mapAddressInserted;
+    //! outputs of mapAddress not spent by another mempool tx, kept up to date with it
+    addressDeltaMap mapAddressUnspent;
 
-    typedef std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare> mapSpentIndex;
+    typedef boost::unordered_map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyHasher> mapSpentIndex;
     mapSpentIndex mapSpent;
 
-    typedef std::map<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
-    mapSpentIndexInserted mapSpentInserted;
-
-    typedef std::map<CUnspentCCIndexKey, CUnspentCCIndexValue, CUnspentCCIndexKeyCompare> mapUnspentCCIndexType;
+    typedef CMempoolIndexMap<CUnspentCCIndexKey, CUnspentCCIndexValue, CUnspentCCIndexKeyHasher> mapUnspentCCIndexType;
     mapUnspentCCIndexType mapUnspentCCIndex;
 
-    typedef std::map<uint256, std::vector<CUnspentCCIndexKey> > mapUnspentCCIndexInsertedType;
-    mapUnspentCCIndexInsertedType mapUnspentCCIndexInserted;
+    //! the address and spent index keys added for each tx, to remove them with it
+    struct CMempoolIndexInserted
+    {
+        std::vector<CMempoolAddressDeltaKey> addressKeys;
+        std::vector<CSpentIndexKey> spentKeys;
+    };
+    typedef boost::unordered_map<uint256, CMempoolIndexInserted, CCoinsKeyHasher> mapIndexInsertedType;
+    mapIndexInsertedType mapIndexInserted;
 
 public:
     std::map<COutPoint, CInPoint> mapNextTx;
@@ -216,9 +235,13 @@ public:
     bool getAddressIndex(std::vector<std::pair<uint160, int> > &addresses,
                          std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results);
     bool removeAddressIndex(const uint256 txhash);
+    bool getAddressUnspent(std::vector<std::pair<uint160, int> > &addresses,
+                           std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results);
 
     void addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view);
     bool getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
+    /** Marks each of the outpoints spent by a mempool transaction, looked up under a single lock */
+    void getSpentOutpoints(const std::vector<COutPoint> &outpoints, std::vector<bool> &spent);
     bool removeSpentIndex(const uint256 txhash);
 
     // unspent cc index support:
@@ -252,6 +275,21 @@ public:
 
     bool nullifierExists(const uint256& nullifier, ShieldedType type) const;
 
+    /**
+     * The minimum fee to get into the mempool, which may itself not be enough
+     * to get into a block. It is raised above the package fee rate of each
+     * eviction by TrimToSize and decays back once blocks are found, faster
+     * while the pool is well below sizelimit.
+     */
+    CFeeRate GetMinFee(size_t sizelimit) const;
+
+    /**
+     * Remove transactions from the mempool until its dynamic size is <= sizelimit,
+     * evicting the descendant package with the lowest fee rate first.
+     */
+    void TrimToSize(size_t sizelimit);
+
+    /** Announces the txs removed and then the ones added since the last call */
     void NotifyRecentlyAdded();
     bool IsFullyNotified();
     
@@ -274,10 +312,15 @@ public:
     }
 
     bool lookup(uint256 hash, CTransaction& result) const;
+    //! the mempool's own transaction, NULL if it isn't in the mempool
+    CTransactionRef get(const uint256& hash) const;
 
-    /** Estimate fee rate needed to get into the next nBlocks */
+    /** Estimate fee rate needed to get into the next nBlocks, from the mempool for short targets the history can't estimate */
     CFeeRate estimateFee(int nBlocks) const;
 
+    /** Set the half-life in blocks of the confirmation history fees are estimated from */
+    void SetFeeEstimateHalfLife(unsigned int nBlocks);
+
     /** Estimate priority needed to get into the next nBlocks */
     double estimatePriority(int nBlocks) const;
     
@@ -0,0 +1,315 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "txoutsnapshot.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "hash.h"
+#include "main.h"
+#include "serialize.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <functional>
+#include <utility>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+extern char ASSETCHAINS_SYMBOL[65];
+extern CCoinsViewDB *pcoinsdbview;
+
+static const uint32_t TXOUTSNAPSHOT_MAGIC = 0x7874756b;  // "kutx"
+static const int TXOUTSNAPSHOT_VERSION = 1;
+// loaded chainstate entries are written in batches of about this many bytes
+static const size_t TXOUTSNAPSHOT_BATCH_SIZE = 16 << 20;
+// komodostate is stored in records of at most this many bytes
+static const size_t TXOUTSNAPSHOT_CHUNK_SIZE = 1 << 20;
+
+/** snapshot records, after the header */
+enum {
+    TXOUTSNAPSHOT_END = 0,          //!< followed by the snapshot hash
+    TXOUTSNAPSHOT_ENTRY = 1,        //!< a chainstate database entry, key and value as stored
+    TXOUTSNAPSHOT_KOMODOSTATE = 2,  //!< the next bytes of komodostate, in the value
+};
+
+namespace {
+
+struct CTxOutSetSnapshotHeader
+{
+    uint32_t nMagic;
+    int nVersion;
+    std::string strSymbol;
+    uint256 hashGenesis;
+    uint256 hashBlock;
+    int nHeight;
+
+    CTxOutSetSnapshotHeader() : nMagic(TXOUTSNAPSHOT_MAGIC), nVersion(TXOUTSNAPSHOT_VERSION), nHeight(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nMagic);
+        READWRITE(nVersion);
+        READWRITE(LIMITED_STRING(strSymbol, 64));
+        READWRITE(hashGenesis);
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+    }
+};
+
+typedef std::function<bool(uint8_t type, const std::string &key, const std::string &value)> TxOutSetRecordFn;
+
+}
+
+static boost::filesystem::path KomodoStatePath()
+{
+    return GetDataDir() / "komodostate";
+}
+
+static bool ReadKomodoState(std::string &strState, std::string &strError)
+{
+    boost::filesystem::path path = KomodoStatePath();
+
+    strState.clear();
+    if (!boost::filesystem::exists(path))
+        return true;
+    FILE *fp = fopen(path.string().c_str(), "rb");
+    if (fp == NULL) {
+        strError = "unable to open " + path.string();
+        return false;
+    }
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        strState.append(buf, n);
+    bool fOk = !ferror(fp);
+    fclose(fp);
+    if (!fOk)
+        strError = "unable to read " + path.string();
+    return fOk;
+}
+
+static void WriteTxOutSetRecord(CAutoFile &file, CHashWriter &hasher, uint8_t type, const std::string &key, const std::string &value)
+{
+    file << type << key << value;
+    hasher << type << key << value;
+}
+
+bool DumpTxOutSet(const boost::filesystem::path &path, CTxOutSetSnapshotInfo &info, std::string &strError)
+{
+    boost::filesystem::path pathTmp = path.string() + ".incomplete";
+    CTxOutSetSnapshotHeader header;
+    boost::scoped_ptr<CDBIterator> pcursor;
+    std::string strKomodoState;
+
+    if (boost::filesystem::exists(path)) {
+        strError = path.string() + " already exists";
+        return false;
+    }
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        // the cursor reads the database as it is now, blocks connected while the snapshot is written are not in it
+        pcursor.reset(pcoinsdbview->RawCursor());
+        header.hashBlock = pcoinsdbview->GetBestBlock();
+        BlockMap::iterator mi = mapBlockIndex.find(header.hashBlock);
+        if (mi == mapBlockIndex.end() || mi->second == NULL) {
+            strError = "the chainstate best block is not in the block index";
+            return false;
+        }
+        header.nHeight = mi->second->GetHeight();
+        // komodostate is appended to as blocks are connected, under cs_main
+        if (!ReadKomodoState(strKomodoState, strError))
+            return false;
+    }
+    header.strSymbol = ASSETCHAINS_SYMBOL;
+    header.hashGenesis = Params().GetConsensus().hashGenesisBlock;
+
+    info = CTxOutSetSnapshotInfo();
+    info.hashBlock = header.hashBlock;
+    info.nHeight = header.nHeight;
+    info.nKomodoStateSize = strKomodoState.size();
+
+    CAutoFile file(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        strError = "unable to create " + pathTmp.string();
+        return false;
+    }
+    CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+    try {
+        file << header;
+        hasher << header;
+        for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next()) {
+            boost::this_thread::interruption_point();
+            WriteTxOutSetRecord(file, hasher, TXOUTSNAPSHOT_ENTRY, pcursor->GetRawKey(), pcursor->GetRawValue());
+            info.nEntries++;
+        }
+        for (size_t pos = 0; pos < strKomodoState.size(); pos += TXOUTSNAPSHOT_CHUNK_SIZE)
+            WriteTxOutSetRecord(file, hasher, TXOUTSNAPSHOT_KOMODOSTATE, std::string(), strKomodoState.substr(pos, TXOUTSNAPSHOT_CHUNK_SIZE));
+        info.hashSnapshot = hasher.GetHash();
+        file << (uint8_t)TXOUTSNAPSHOT_END << info.hashSnapshot;
+        FileCommit(file.Get());
+    } catch (const std::exception &e) {
+        file.fclose();
+        boost::filesystem::remove(pathTmp);
+        strError = strprintf("unable to write %s: %s", pathTmp.string(), e.what());
+        return false;
+    }
+    file.fclose();
+    boost::filesystem::rename(pathTmp, path);
+    return true;
+}
+
+/** Read the snapshot at path, calling fn for each record, and check its hash in info.hashSnapshot */
+static bool ReadTxOutSet(const boost::filesystem::path &path, CTxOutSetSnapshotHeader &header, CTxOutSetSnapshotInfo &info, TxOutSetRecordFn fn, std::string &strError)
+{
+    CAutoFile file(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        strError = "unable to open " + path.string();
+        return false;
+    }
+    CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+    try {
+        file >> header;
+        if (header.nMagic != TXOUTSNAPSHOT_MAGIC || header.nVersion != TXOUTSNAPSHOT_VERSION) {
+            strError = path.string() + " is not a UTXO set snapshot of a supported version";
+            return false;
+        }
+        if (header.strSymbol != ASSETCHAINS_SYMBOL || header.hashGenesis != Params().GetConsensus().hashGenesisBlock) {
+            strError = strprintf("%s is a snapshot of another chain (%s)", path.string(), header.strSymbol);
+            return false;
+        }
+        hasher << header;
+
+        info = CTxOutSetSnapshotInfo();
+        info.hashBlock = header.hashBlock;
+        info.nHeight = header.nHeight;
+        while (true) {
+            uint8_t type;
+            std::string key, value;
+            file >> type;
+            if (type == TXOUTSNAPSHOT_END)
+                break;
+            if (type != TXOUTSNAPSHOT_ENTRY && type != TXOUTSNAPSHOT_KOMODOSTATE) {
+                strError = strprintf("unknown record %d in %s", type, path.string());
+                return false;
+            }
+            file >> key >> value;
+            hasher << type << key << value;
+            if (type == TXOUTSNAPSHOT_ENTRY)
+                info.nEntries++;
+            else
+                info.nKomodoStateSize += value.size();
+            if (!fn(type, key, value))
+                return false;
+        }
+        uint256 hashStored;
+        file >> hashStored;
+        info.hashSnapshot = hasher.GetHash();
+        if (hashStored != info.hashSnapshot) {
+            strError = path.string() + " is corrupt, its records do not match its hash";
+            return false;
+        }
+    } catch (const std::exception &e) {
+        strError = strprintf("unable to read %s: %s", path.string(), e.what());
+        return false;
+    }
+    return true;
+}
+
+bool LoadTxOutSet(const boost::filesystem::path &path, const uint256 &hashExpected, CTxOutSetSnapshotInfo &info, std::string &strError)
+{
+    CTxOutSetSnapshotHeader header;
+    CDiskBlockIndex diskindex;
+
+    if (hashExpected.IsNull()) {
+        strError = "-loadtxoutsethash is not set";
+        return false;
+    }
+    // check the snapshot before anything is written
+    if (!ReadTxOutSet(path, header, info, [](uint8_t, const std::string&, const std::string&) { return true; }, strError))
+        return false;
+    if (info.hashSnapshot != hashExpected) {
+        strError = strprintf("the snapshot hash %s is not -loadtxoutsethash", info.hashSnapshot.GetHex());
+        return false;
+    }
+    if (!pblocktree->ReadDiskBlockIndex(header.hashBlock, diskindex) || !(diskindex.nStatus & BLOCK_HAVE_DATA) || diskindex.GetHeight() != header.nHeight) {
+        strError = strprintf("the snapshot block %s at height %d is not on disk", header.hashBlock.GetHex(), header.nHeight);
+        return false;
+    }
+
+    boost::filesystem::path pathState = KomodoStatePath();
+    boost::filesystem::path pathStateTmp = pathState.string() + ".incomplete";
+    FILE *fpState = fopen(pathStateTmp.string().c_str(), "wb");
+    if (fpState == NULL) {
+        strError = "unable to create " + pathStateTmp.string();
+        return false;
+    }
+    std::vector<std::pair<std::string, std::string> > entries;
+    size_t nBatchSize = 0;
+    bool fOk = ReadTxOutSet(path, header, info, [&](uint8_t type, const std::string &key, const std::string &value) {
+        if (type == TXOUTSNAPSHOT_KOMODOSTATE) {
+            if (fwrite(value.data(), 1, value.size(), fpState) != value.size()) {
+                strError = "unable to write " + pathStateTmp.string();
+                return false;
+            }
+            return true;
+        }
+        entries.push_back(std::make_pair(key, value));
+        nBatchSize += key.size() + value.size();
+        if (nBatchSize >= TXOUTSNAPSHOT_BATCH_SIZE) {
+            if (!pcoinsdbview->WriteRaw(entries, uint256())) {
+                strError = "unable to write the chainstate database";
+                return false;
+            }
+            entries.clear();
+            nBatchSize = 0;
+        }
+        return true;
+    }, strError);
+    // the file may have changed since it was checked, its hash is checked again as it is read
+    if (fOk && info.hashSnapshot != hashExpected) {
+        strError = path.string() + " changed while it was loaded";
+        fOk = false;
+    }
+    if (fOk && !pcoinsdbview->WriteRaw(entries, uint256())) {
+        strError = "unable to write the chainstate database";
+        fOk = false;
+    }
+    if (fOk)
+        FileCommit(fpState);
+    fclose(fpState);
+    if (!fOk) {
+        boost::filesystem::remove(pathStateTmp);
+        return false;
+    }
+    boost::filesystem::rename(pathStateTmp, pathState);
+    boost::filesystem::remove(pathState.string() + ".ind");
+
+    // last, so that the chainstate has no best block until the whole snapshot is in it
+    if (!pcoinsdbview->WriteRaw(std::vector<std::pair<std::string, std::string> >(), header.hashBlock)) {
+        strError = "unable to write the chainstate database";
+        return false;
+    }
+    LogPrintf("Loaded the UTXO set snapshot %s of block %s at height %d: %u entries, %u komodostate bytes\n",
+        info.hashSnapshot.GetHex(), info.hashBlock.GetHex(), info.nHeight, info.nEntries, info.nKomodoStateSize);
+    return true;
+}
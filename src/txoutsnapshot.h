@@ -0,0 +1,55 @@
+/******************************************************************************
+ * Copyright © 2014-2022 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef BITCOIN_TXOUTSNAPSHOT_H
+#define BITCOIN_TXOUTSNAPSHOT_H
+
+#include "uint256.h"
+
+#include <stdint.h>
+#include <string>
+#include <boost/filesystem/path.hpp>
+
+/**
+ * UTXO set snapshots: a flat file with every entry of the chainstate database
+ * (coins, Sprout and Sapling anchors and nullifiers) and the komodostate notary
+ * data at a block, committed to by a SHA256d hash over all of it.
+ *
+ * A node that has the blocks on disk but no chainstate loads a snapshot with
+ * -loadtxoutset, instead of replaying the blocks up to it. The hash is checked
+ * against -loadtxoutsethash, published with the snapshot, before anything is
+ * written.
+ */
+struct CTxOutSetSnapshotInfo
+{
+    uint256 hashBlock;
+    int nHeight;
+    uint64_t nEntries;           //!< chainstate database entries
+    uint64_t nKomodoStateSize;   //!< komodostate bytes
+    uint256 hashSnapshot;        //!< the commitment to configure as -loadtxoutsethash
+
+    CTxOutSetSnapshotInfo() : nHeight(0), nEntries(0), nKomodoStateSize(0) {}
+};
+
+/** Write a snapshot of the chainstate at the tip to path, which must not exist yet */
+bool DumpTxOutSet(const boost::filesystem::path &path, CTxOutSetSnapshotInfo &info, std::string &strError);
+
+/**
+ * Load the snapshot at path into an empty chainstate database, if its hash is hashExpected and its block is
+ * in the block index with its data. Called before LoadBlockIndex, so that the chain tip is the snapshot block.
+ */
+bool LoadTxOutSet(const boost::filesystem::path &path, const uint256 &hashExpected, CTxOutSetSnapshotInfo &info, std::string &strError);
+
+#endif // BITCOIN_TXOUTSNAPSHOT_H
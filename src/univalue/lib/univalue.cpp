@@ -83,6 +83,7 @@ void UniValue::clear()
     val.clear();
     keys.clear();
     values.clear();
+    keyIndex.reset();
 }
 
 bool UniValue::setNull()
@@ -119,22 +120,31 @@ bool UniValue::setNumStr(const std::string& val_)
     return true;
 }
 
+// integers are formatted by hand, they are always valid numbers so there is no need to re-parse them
 bool UniValue::setInt(uint64_t val_)
 {
-    std::ostringstream oss;
+    char buf[24];
+    char *p = buf + sizeof(buf);
 
-    oss << val_;
+    do {
+        *--p = '0' + (val_ % 10);
+        val_ /= 10;
+    } while (val_ != 0);
 
-    return setNumStr(oss.str());
+    clear();
+    typ = VNUM;
+    val.assign(p, buf + sizeof(buf) - p);
+    return true;
 }
 
 bool UniValue::setInt(int64_t val_)
 {
-    std::ostringstream oss;
-
-    oss << val_;
+    if (val_ >= 0)
+        return setInt((uint64_t)val_);
 
-    return setNumStr(oss.str());
+    setInt((uint64_t)0 - (uint64_t)val_);
+    val.insert(val.begin(), '-');
+    return true;
 }
 
 bool UniValue::setFloat(double val_)
@@ -156,6 +166,14 @@ bool UniValue::setStr(const std::string& val_)
     return true;
 }
 
+bool UniValue::setStr(std::string&& val_)
+{
+    clear();
+    typ = VSTR;
+    val = std::move(val_);
+    return true;
+}
+
 bool UniValue::setArray()
 {
     clear();
@@ -179,6 +197,15 @@ bool UniValue::push_back(const UniValue& val_)
     return true;
 }
 
+bool UniValue::push_back(UniValue&& val_)
+{
+    if (typ != VARR)
+        return false;
+
+    values.push_back(std::move(val_));
+    return true;
+}
+
 bool UniValue::push_backV(const std::vector<UniValue>& vec)
 {
     if (typ != VARR)
@@ -189,10 +216,63 @@ bool UniValue::push_backV(const std::vector<UniValue>& vec)
     return true;
 }
 
+bool UniValue::push_backV(std::vector<UniValue>&& vec)
+{
+    if (typ != VARR)
+        return false;
+
+    if (values.empty()) {
+        values.swap(vec);
+    } else {
+        values.reserve(values.size() + vec.size());
+        for (size_t i = 0; i < vec.size(); i++)
+            values.push_back(std::move(vec[i]));
+    }
+    vec.clear();
+
+    return true;
+}
+
+void UniValue::reserve(size_t n)
+{
+    if (typ == VOBJ)
+        keys.reserve(n);
+    values.reserve(n);
+}
+
+void UniValue::indexKey(size_t idx)
+{
+    if (!keyIndex) {
+        if (keys.size() >= KEY_INDEX_MIN_SIZE)
+            indexKeys();
+        return;
+    }
+    // copy on write, the index may be shared with copies of this object
+    if (keyIndex.use_count() > 1)
+        keyIndex = std::make_shared<KeyIndex>(*keyIndex);
+    keyIndex->emplace(keys[idx], idx);
+}
+
+void UniValue::indexKeys()
+{
+    keyIndex = std::make_shared<KeyIndex>();
+    keyIndex->reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        keyIndex->emplace(keys[i], i);
+}
+
 void UniValue::__pushKV(const std::string& key, const UniValue& val_)
 {
     keys.push_back(key);
     values.push_back(val_);
+    indexKey(keys.size() - 1);
+}
+
+void UniValue::__pushKV(std::string&& key, UniValue&& val_)
+{
+    keys.push_back(std::move(key));
+    values.push_back(std::move(val_));
+    indexKey(keys.size() - 1);
 }
 
 bool UniValue::pushKV(const std::string& key, const UniValue& val_)
@@ -208,11 +288,25 @@ bool UniValue::pushKV(const std::string& key, const UniValue& val_)
     return true;
 }
 
+bool UniValue::pushKV(const std::string& key, UniValue&& val_)
+{
+    if (typ != VOBJ)
+        return false;
+
+    size_t idx;
+    if (findKey(key, idx))
+        values[idx] = std::move(val_);
+    else
+        __pushKV(std::string(key), std::move(val_));
+    return true;
+}
+
 bool UniValue::pushKVs(const UniValue& obj)
 {
     if (typ != VOBJ || obj.typ != VOBJ)
         return false;
 
+    reserve(keys.size() + obj.keys.size());
     for (size_t i = 0; i < obj.keys.size(); i++)
         __pushKV(obj.keys[i], obj.values.at(i));
 
@@ -231,6 +325,14 @@ void UniValue::getObjMap(std::map<std::string,UniValue>& kv) const
 
 bool UniValue::findKey(const std::string& key, size_t& retIdx) const
 {
+    if (keyIndex) {
+        KeyIndex::const_iterator it = keyIndex->find(key);
+        if (it == keyIndex->end())
+            return false;
+        retIdx = it->second;
+        return true;
+    }
+
     for (size_t i = 0; i < keys.size(); i++) {
         if (keys[i] == key) {
             retIdx = i;
@@ -298,9 +400,9 @@ const char *uvTypeName(UniValue::VType t)
 
 const UniValue& find_value(const UniValue& obj, const std::string& name)
 {
-    for (unsigned int i = 0; i < obj.keys.size(); i++)
-        if (obj.keys[i] == name)
-            return obj.values.at(i);
+    size_t i;
+    if (obj.findKey(name, i))
+        return obj.values.at(i);
 
     return NullUniValue;
 }
@@ -347,6 +347,81 @@ BOOST_AUTO_TEST_CASE(univalue_object)
 
 }
 
+BOOST_AUTO_TEST_CASE(univalue_move)
+{
+    UniValue arr(UniValue::VARR);
+    arr.reserve(3);
+    UniValue inner(UniValue::VOBJ);
+    inner.pushKV("a", 1);
+    BOOST_CHECK(arr.push_back(std::move(inner)));
+    BOOST_CHECK(arr.push_back(UniValue(UniValue::VSTR, std::string("moved"))));
+    BOOST_CHECK_EQUAL(arr.size(), 2);
+    BOOST_CHECK_EQUAL(arr[0]["a"].getValStr(), "1");
+    BOOST_CHECK_EQUAL(arr[1].getValStr(), "moved");
+
+    std::vector<UniValue> vec(2, UniValue("x"));
+    BOOST_CHECK(arr.push_backV(std::move(vec)));
+    BOOST_CHECK_EQUAL(arr.size(), 4);
+    BOOST_CHECK_EQUAL(arr[3].getValStr(), "x");
+
+    UniValue obj(UniValue::VOBJ);
+    BOOST_CHECK(obj.pushKV("arr", std::move(arr)));
+    BOOST_CHECK(obj.push_back(Pair("str", UniValue("y"))));
+    BOOST_CHECK(obj.push_back(Pair("str", UniValue("z"))));
+    BOOST_CHECK_EQUAL(obj.size(), 2);
+    BOOST_CHECK_EQUAL(obj["arr"].size(), 4);
+    BOOST_CHECK_EQUAL(obj["str"].getValStr(), "z");
+    BOOST_CHECK(!arr.push_back(Pair("k", UniValue("v"))));
+
+    BOOST_CHECK_EQUAL(UniValue((int64_t)-9223372036854775807LL - 1).getValStr(), "-9223372036854775808");
+    BOOST_CHECK_EQUAL(UniValue((uint64_t)18446744073709551615ULL).getValStr(), "18446744073709551615");
+    BOOST_CHECK_EQUAL(UniValue(0).getValStr(), "0");
+    BOOST_CHECK_EQUAL(UniValue(-7).write(), "-7");
+}
+
+BOOST_AUTO_TEST_CASE(univalue_keyindex)
+{
+    // large enough for the hashed key index
+    UniValue obj(UniValue::VOBJ);
+    std::string json = "{";
+    for (int i = 0; i < 100; i++) {
+        std::ostringstream key;
+        key << "key" << i;
+        BOOST_CHECK(obj.pushKV(key.str(), i));
+        json += (i ? ",\"" : "\"") + key.str() + "\":" + UniValue(i).getValStr();
+    }
+    json += "}";
+    BOOST_CHECK_EQUAL(obj.write(), json);
+    BOOST_CHECK_EQUAL(obj["key0"].get_int(), 0);
+    BOOST_CHECK_EQUAL(find_value(obj, "key99").get_int(), 99);
+    BOOST_CHECK(!obj.exists("key100"));
+
+    // a copy shares the index until one of them changes
+    UniValue copy = obj;
+    BOOST_CHECK(copy.pushKV("extra", "e"));
+    BOOST_CHECK(copy.pushKV("key5", 55));
+    BOOST_CHECK(copy.exists("extra"));
+    BOOST_CHECK(!obj.exists("extra"));
+    BOOST_CHECK_EQUAL(copy["key5"].get_int(), 55);
+    BOOST_CHECK_EQUAL(obj["key5"].get_int(), 5);
+    BOOST_CHECK_EQUAL(copy.size(), 101);
+
+    // the first of duplicate keys wins, as with the linear lookup
+    copy.__pushKV("key7", UniValue("dup"));
+    BOOST_CHECK_EQUAL(copy["key7"].get_int(), 7);
+
+    UniValue read;
+    BOOST_CHECK(read.read(json));
+    BOOST_CHECK_EQUAL(read["key42"].get_int(), 42);
+    BOOST_CHECK(!read.exists("extra"));
+
+    obj.clear();
+    BOOST_CHECK(!obj.exists("key0"));
+    BOOST_CHECK(obj.setObject());
+    BOOST_CHECK(obj.pushKV("key0", "again"));
+    BOOST_CHECK_EQUAL(obj["key0"].getValStr(), "again");
+}
+
 static const char *json1 =
 "[1.10000000,{\"key1\":\"str\\u0000\",\"key2\":800,\"key3\":{\"name\":\"martian http://test.com\"}}]";
 
@@ -402,6 +477,8 @@ int main (int argc, char *argv[])
     univalue_set();
     univalue_array();
     univalue_object();
+    univalue_move();
+    univalue_keyindex();
     univalue_readwrite();
     return 0;
 }
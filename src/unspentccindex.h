@@ -61,6 +61,10 @@ struct CUnspentCCIndexKey {
         txhash.SetNull();
         index = 0;
     }
+
+    friend bool operator==(const CUnspentCCIndexKey& a, const CUnspentCCIndexKey& b) {
+        return a.txhash == b.txhash && a.index == b.index && a.hashBytes == b.hashBytes && a.creationid == b.creationid;
+    }
 };
 
 // partial key for cc address only
@@ -801,6 +801,22 @@ void FileCommit(FILE *fileout)
 #endif
 }
 
+/**
+ * this function tells the kernel how a range of a file is going to be read, length 0 meaning up to its end.
+ * it is advisory, and a no-op where posix_fadvise is not available
+ */
+void FileAdvise(FILE *file, unsigned int offset, unsigned int length, FileAdvice advice) {
+#if defined(__linux__)
+    int nAdvice = POSIX_FADV_NORMAL;
+    switch (advice) {
+        case FILE_ADVICE_SEQUENTIAL: nAdvice = POSIX_FADV_SEQUENTIAL; break;
+        case FILE_ADVICE_WILLNEED: nAdvice = POSIX_FADV_WILLNEED; break;
+        case FILE_ADVICE_DONTNEED: nAdvice = POSIX_FADV_DONTNEED; break;
+    }
+    posix_fadvise(fileno(file), offset, length, nAdvice);
+#endif
+}
+
 bool TruncateFile(FILE *file, unsigned int length) {
 #if defined(WIN32)
     return _chsize(_fileno(file), length) == 0;
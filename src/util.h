@@ -137,6 +137,9 @@ void FileCommit(FILE *fileout);
 bool TruncateFile(FILE *file, unsigned int length);
 int RaiseFileDescriptorLimit(int nMinFD);
 void AllocateFileRange(FILE *file, unsigned int offset, unsigned int length);
+/** Access pattern hints for FileAdvise */
+enum FileAdvice { FILE_ADVICE_SEQUENTIAL, FILE_ADVICE_WILLNEED, FILE_ADVICE_DONTNEED };
+void FileAdvise(FILE *file, unsigned int offset, unsigned int length, FileAdvice advice);
 bool RenameOver(boost::filesystem::path src, boost::filesystem::path dest);
 bool TryCreateDirectory(const boost::filesystem::path& p);
 boost::filesystem::path GetDefaultDataDir();
@@ -5,6 +5,20 @@
 
 #include "validationinterface.h"
 
+#include "chaineventlog.h"
+#include "consensus/validation.h"
+#include "primitives/block.h"
+#include "util.h"
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 static CMainSignals g_signals;
 
 CMainSignals& GetMainSignals()
@@ -12,7 +26,216 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
+namespace {
+
+/** Runs the callbacks of an asynchronous subscriber on a thread of its own, in the order they were queued */
+class CValidationQueue
+{
+private:
+    boost::mutex cs;
+    boost::condition_variable cond;
+    std::deque<std::function<void ()> > queue;
+    //! callbacks queued and run so far
+    uint64_t nQueued;
+    uint64_t nRun;
+    bool fStop;
+    boost::thread thread;
+
+    void Thread()
+    {
+        RenameThread("komodo-validation");
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (true) {
+            while (queue.empty() && !fStop)
+                cond.wait(lock);
+            if (queue.empty())
+                return;
+            std::function<void ()> f = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            try {
+                f();
+            } catch (const std::exception& e) {
+                PrintExceptionContinue(&e, "validationqueue");
+            } catch (...) {
+                PrintExceptionContinue(NULL, "validationqueue");
+            }
+            lock.lock();
+            nRun++;
+            cond.notify_all();
+        }
+    }
+
+public:
+    CValidationQueue() : nQueued(0), nRun(0), fStop(false)
+    {
+        thread = boost::thread(&CValidationQueue::Thread, this);
+    }
+
+    ~CValidationQueue()
+    {
+        Stop();
+    }
+
+    void Push(std::function<void ()> f)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        // the subscriber was unregistered while the signal was being sent
+        if (fStop)
+            return;
+        queue.push_back(std::move(f));
+        nQueued++;
+        cond.notify_all();
+    }
+
+    size_t Size()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        return queue.size();
+    }
+
+    //! Wait until the callbacks queued so far have run, at once from a callback
+    void Sync()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (thread.get_id() == boost::this_thread::get_id())
+            return;
+        uint64_t nTarget = nQueued;
+        while (nRun < nTarget)
+            cond.wait(lock);
+    }
+
+    //! Runs what is queued, then stops the thread. Later callbacks are dropped
+    void Stop()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fStop = true;
+            cond.notify_all();
+        }
+        if (thread.joinable())
+            thread.join();
+    }
+};
+
+struct CAsyncSubscriber
+{
+    std::shared_ptr<CValidationQueue> queue;
+    std::vector<boost::signals2::connection> connections;
+};
+
+boost::mutex cs_async;
+std::map<CValidationInterface*, CAsyncSubscriber> mapAsync;
+
+/** A copy of pblock for the queues, shared by the callbacks that are sent the same block one after the other */
+std::shared_ptr<const CBlock> ShareBlock(const CBlock* pblock)
+{
+    static boost::mutex cs_block;
+    static const CBlock* pblockLast = NULL;
+    static std::weak_ptr<const CBlock> wpLast;
+
+    if (pblock == NULL)
+        return std::shared_ptr<const CBlock>();
+    boost::unique_lock<boost::mutex> lock(cs_block);
+    std::shared_ptr<const CBlock> p = wpLast.lock();
+    // the address alone may be that of a new block in the place of the last one
+    if (!p || pblock != pblockLast || p->GetHash() != pblock->GetHash()) {
+        p = std::make_shared<const CBlock>(*pblock);
+        pblockLast = pblock;
+        wpLast = p;
+    }
+    return p;
+}
+
+/** The transaction of pshared that tx is the original of, or a copy of tx when it isn't in pblock */
+std::shared_ptr<const CTransaction> ShareTransaction(const CTransaction& tx, const CBlock* pblock, const std::shared_ptr<const CBlock>& pshared)
+{
+    if (pblock != NULL && !pblock->vtx.empty() &&
+        std::less_equal<const CTransaction*>()(&pblock->vtx.front(), &tx) &&
+        std::less_equal<const CTransaction*>()(&tx, &pblock->vtx.back()))
+        return std::shared_ptr<const CTransaction>(pshared, &pshared->vtx[&tx - &pblock->vtx.front()]);
+    return std::make_shared<const CTransaction>(tx);
+}
+
+/** Connect f to a signal whose arguments are copied as they are into the queue */
+template<typename F, typename... Args>
+boost::signals2::connection ConnectQueued(boost::signals2::signal<void (Args...)>& sig, const std::shared_ptr<CValidationQueue>& queue, F f)
+{
+    return sig.connect([queue, f](Args... args) {
+        queue->Push(std::bind(f, args...));
+    });
+}
+
+std::vector<std::shared_ptr<CValidationQueue> > GetAsyncQueues()
+{
+    std::vector<std::shared_ptr<CValidationQueue> > queues;
+    boost::unique_lock<boost::mutex> lock(cs_async);
+    for (std::map<CValidationInterface*, CAsyncSubscriber>::iterator it = mapAsync.begin(); it != mapAsync.end(); it++)
+        queues.push_back(it->second.queue);
+    return queues;
+}
+
+/** Disconnect the subscriber, if it is asynchronous, after its queued callbacks have run */
+bool UnregisterAsync(CValidationInterface* pwalletIn)
+{
+    std::shared_ptr<CValidationQueue> queue;
+    {
+        boost::unique_lock<boost::mutex> lock(cs_async);
+        std::map<CValidationInterface*, CAsyncSubscriber>::iterator it = mapAsync.find(pwalletIn);
+        if (it == mapAsync.end())
+            return false;
+        for (boost::signals2::connection& connection : it->second.connections)
+            connection.disconnect();
+        queue = it->second.queue;
+        mapAsync.erase(it);
+    }
+    queue->Stop();
+    return true;
+}
+
+}
+
+void RegisterValidationInterface(CValidationInterface* pwalletIn, bool fSynchronous) {
+    if (!fSynchronous && GetBoolArg("-asyncvalidation", DEFAULT_ASYNC_VALIDATION)) {
+        std::shared_ptr<CValidationQueue> queue = std::make_shared<CValidationQueue>();
+        std::vector<boost::signals2::connection> connections;
+
+        // the block and its transactions are copied once for all the callbacks of the subscribers
+        std::function<void (const CTransaction &, const CBlock *)> syncTransaction = boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2);
+        connections.push_back(g_signals.SyncTransaction.connect([queue, syncTransaction](const CTransaction &tx, const CBlock *pblock) {
+            std::shared_ptr<const CBlock> pshared = ShareBlock(pblock);
+            std::shared_ptr<const CTransaction> ptx = ShareTransaction(tx, pblock, pshared);
+            queue->Push([syncTransaction, ptx, pshared]() { syncTransaction(*ptx, pshared.get()); });
+        }));
+        std::function<void (const CBlockIndex *, const CBlock *, SproutMerkleTree, SaplingMerkleTree, bool)> chainTip = boost::bind(&CValidationInterface::ChainTip, pwalletIn, _1, _2, _3, _4, _5);
+        connections.push_back(g_signals.ChainTip.connect([queue, chainTip](const CBlockIndex *pindex, const CBlock *pblock, SproutMerkleTree sproutTree, SaplingMerkleTree saplingTree, bool added) {
+            std::shared_ptr<const CBlock> pshared = ShareBlock(pblock);
+            queue->Push([chainTip, pindex, pshared, sproutTree, saplingTree, added]() { chainTip(pindex, pshared.get(), sproutTree, saplingTree, added); });
+        }));
+        std::function<void (const CBlock&, const CValidationState&)> blockChecked = boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2);
+        connections.push_back(g_signals.BlockChecked.connect([queue, blockChecked](const CBlock &block, const CValidationState &state) {
+            std::shared_ptr<const CBlock> pshared = ShareBlock(&block);
+            queue->Push([blockChecked, pshared, state]() { blockChecked(*pshared, state); });
+        }));
+        // the block indexes are never freed, the other arguments are values
+        connections.push_back(ConnectQueued(g_signals.UpdatedBlockTip, queue, boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1)));
+        connections.push_back(ConnectQueued(g_signals.EraseTransaction, queue, boost::bind(&CValidationInterface::EraseFromWallet, pwalletIn, _1)));
+        connections.push_back(ConnectQueued(g_signals.UpdatedTransaction, queue, boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1)));
+        connections.push_back(ConnectQueued(g_signals.RescanWallet, queue, boost::bind(&CValidationInterface::RescanWallet, pwalletIn)));
+        connections.push_back(ConnectQueued(g_signals.SetBestChain, queue, boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1)));
+        connections.push_back(ConnectQueued(g_signals.Inventory, queue, boost::bind(&CValidationInterface::Inventory, pwalletIn, _1)));
+        connections.push_back(ConnectQueued(g_signals.Broadcast, queue, boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1)));
+        connections.push_back(ConnectQueued(g_signals.TransactionAddedToMempool, queue, boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1)));
+        connections.push_back(ConnectQueued(g_signals.TransactionRemovedFromMempool, queue, boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1)));
+        connections.push_back(ConnectQueued(g_signals.Notarized, queue, boost::bind(&CValidationInterface::Notarized, pwalletIn, _1, _2, _3, _4, _5)));
+        connections.push_back(ConnectQueued(g_signals.ChainEvent, queue, boost::bind(&CValidationInterface::ChainEvent, pwalletIn, _1)));
+
+        boost::unique_lock<boost::mutex> lock(cs_async);
+        CAsyncSubscriber &subscriber = mapAsync[pwalletIn];
+        subscriber.queue = queue;
+        subscriber.connections = connections;
+        return;
+    }
     g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
     g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
     g_signals.EraseTransaction.connect(boost::bind(&CValidationInterface::EraseFromWallet, pwalletIn, _1));
@@ -23,9 +246,19 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
     g_signals.Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1));
     g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
+    g_signals.TransactionAddedToMempool.connect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1));
+    g_signals.TransactionRemovedFromMempool.connect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1));
+    g_signals.Notarized.connect(boost::bind(&CValidationInterface::Notarized, pwalletIn, _1, _2, _3, _4, _5));
+    g_signals.ChainEvent.connect(boost::bind(&CValidationInterface::ChainEvent, pwalletIn, _1));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
+    if (UnregisterAsync(pwalletIn))
+        return;
+    g_signals.ChainEvent.disconnect(boost::bind(&CValidationInterface::ChainEvent, pwalletIn, _1));
+    g_signals.Notarized.disconnect(boost::bind(&CValidationInterface::Notarized, pwalletIn, _1, _2, _3, _4, _5));
+    g_signals.TransactionRemovedFromMempool.disconnect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1));
+    g_signals.TransactionAddedToMempool.disconnect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1));
     g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
     g_signals.Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1));
     g_signals.Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
@@ -39,6 +272,10 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
 }
 
 void UnregisterAllValidationInterfaces() {
+    g_signals.ChainEvent.disconnect_all_slots();
+    g_signals.Notarized.disconnect_all_slots();
+    g_signals.TransactionRemovedFromMempool.disconnect_all_slots();
+    g_signals.TransactionAddedToMempool.disconnect_all_slots();
     g_signals.BlockChecked.disconnect_all_slots();
     g_signals.Broadcast.disconnect_all_slots();
     g_signals.Inventory.disconnect_all_slots();
@@ -49,6 +286,14 @@ void UnregisterAllValidationInterfaces() {
     g_signals.SyncTransaction.disconnect_all_slots();
     g_signals.RescanWallet.disconnect_all_slots();
     g_signals.UpdatedBlockTip.disconnect_all_slots();
+
+    std::map<CValidationInterface*, CAsyncSubscriber> mapStopped;
+    {
+        boost::unique_lock<boost::mutex> lock(cs_async);
+        mapStopped.swap(mapAsync);
+    }
+    for (std::map<CValidationInterface*, CAsyncSubscriber>::iterator it = mapStopped.begin(); it != mapStopped.end(); it++)
+        it->second.queue->Stop();
 }
 
 void SyncWithWallets(const CTransaction &tx, const CBlock *pblock) {
@@ -61,4 +306,16 @@ void EraseFromWallets(const uint256 &hash) {
 
 void RescanWallets() {
     g_signals.RescanWallet();
-}
\ No newline at end of file
+}
+
+void SyncWithValidationInterfaceQueue() {
+    for (const std::shared_ptr<CValidationQueue>& queue : GetAsyncQueues())
+        queue->Sync();
+}
+
+void LimitValidationInterfaceQueue() {
+    for (const std::shared_ptr<CValidationQueue>& queue : GetAsyncQueues()) {
+        if (queue->Size() > MAX_VALIDATION_QUEUE_SIZE)
+            queue->Sync();
+    }
+}
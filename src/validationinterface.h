@@ -13,15 +13,26 @@
 class CBlock;
 class CBlockIndex;
 struct CBlockLocator;
+struct CChainEvent;
 class CTransaction;
 class CValidationInterface;
 class CValidationState;
 class uint256;
 
+//! -asyncvalidation default
+static const bool DEFAULT_ASYNC_VALIDATION = true;
+//! Callbacks queued for a subscriber above which ActivateBestChain waits for them to run
+static const size_t MAX_VALIDATION_QUEUE_SIZE = 1000;
+
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
+/**
+ * Register a wallet to receive updates from core. Its callbacks run in order on
+ * a thread of its own, with copies of the arguments, unless fSynchronous or
+ * -noasyncvalidation. Those that must see the state of the caller, or run
+ * before the signal returns, stay synchronous.
+ */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, bool fSynchronous = false);
 /** Unregister a wallet from core */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
@@ -32,6 +43,10 @@ void SyncWithWallets(const CTransaction& tx, const CBlock* pblock = NULL);
 void EraseFromWallets(const uint256 &hash);
 /** Rescan all registered wallets */
 void RescanWallets();
+/** Wait until the asynchronous wallets have run the callbacks queued so far, not with cs_main held as they may take it */
+void SyncWithValidationInterfaceQueue();
+/** SyncWithValidationInterfaceQueue if a wallet has more than MAX_VALIDATION_QUEUE_SIZE callbacks queued */
+void LimitValidationInterfaceQueue();
 
 class CValidationInterface {
 protected:
@@ -45,7 +60,11 @@ protected:
     virtual void Inventory(const uint256 &hash) {}
     virtual void ResendWalletTransactions(int64_t nBestBlockTime) {}
     virtual void BlockChecked(const CBlock&, const CValidationState&) {}
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    virtual void TransactionAddedToMempool(const CTransaction &tx) {}
+    virtual void TransactionRemovedFromMempool(const CTransaction &tx) {}
+    virtual void ChainEvent(const CChainEvent &event) {}
+    virtual void Notarized(int32_t height, int32_t notarizedHeight, const uint256 &notarizedHash, const uint256 &destTxid, const uint256 &txid) {}
+    friend void ::RegisterValidationInterface(CValidationInterface*, bool);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
 };
@@ -71,6 +90,14 @@ struct CMainSignals {
     boost::signals2::signal<void (int64_t nBestBlockTime)> Broadcast;
     /** Notifies listeners of a block validation result */
     boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
+    /** Notifies listeners of a transaction added to the mempool */
+    boost::signals2::signal<void (const CTransaction &)> TransactionAddedToMempool;
+    /** Notifies listeners of a transaction leaving the mempool other than by being mined */
+    boost::signals2::signal<void (const CTransaction &)> TransactionRemovedFromMempool;
+    /** Notifies listeners of a notarization of the chain at height, by the tx txid of the block at height */
+    boost::signals2::signal<void (int32_t, int32_t, const uint256 &, const uint256 &, const uint256 &)> Notarized;
+    /** Notifies listeners of an event numbered by the chain event log, in sequence order */
+    boost::signals2::signal<void (const CChainEvent &)> ChainEvent;
 };
 
 CMainSignals& GetMainSignals();
@@ -1068,7 +1068,7 @@ UniValue AsyncRPCOperation_mergetoaddress::getStatus() const
     }
 
     UniValue obj = v.get_obj();
-    obj.push_back(Pair("method", "z_mergetoaddress"));
+    obj.push_back(Pair("method", getMethod()));
     obj.push_back(Pair("params", contextinfo_));
     return obj;
 }
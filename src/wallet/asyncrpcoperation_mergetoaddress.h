@@ -90,6 +90,10 @@ public:
     virtual void main();
     
     virtual UniValue getStatus() const;
+
+    virtual std::string getMethod() const {
+        return "z_mergetoaddress";
+    }
     
     bool testmode = false; // Set to true to disable sending txs and generating proofs
     
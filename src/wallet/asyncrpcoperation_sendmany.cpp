@@ -1448,7 +1448,7 @@ UniValue AsyncRPCOperation_sendmany::getStatus() const {
     }
 
     UniValue obj = v.get_obj();
-    obj.push_back(Pair("method", "z_sendmany"));
+    obj.push_back(Pair("method", getMethod()));
     obj.push_back(Pair("params", contextinfo_ ));
     return obj;
 }
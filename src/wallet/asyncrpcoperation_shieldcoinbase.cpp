@@ -574,7 +574,7 @@ UniValue AsyncRPCOperation_shieldcoinbase::getStatus() const {
     }
 
     UniValue obj = v.get_obj();
-    obj.push_back(Pair("method", "z_shieldcoinbase"));
+    obj.push_back(Pair("method", getMethod()));
     obj.push_back(Pair("params", contextinfo_ ));
     return obj;
 }
@@ -77,6 +77,10 @@ public:
 
     virtual UniValue getStatus() const;
 
+    virtual std::string getMethod() const {
+        return "z_shieldcoinbase";
+    }
+
     bool testmode = false;  // Set to true to disable sending txs and generating proofs
     bool cheatSpend = false; // set when this is shielding a cheating coinbase
 
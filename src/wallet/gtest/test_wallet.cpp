@@ -2160,3 +2160,22 @@ TEST(WalletTests, SaplingNoteLocking) {
     EXPECT_FALSE(wallet.IsLockedNote(sop1));
     EXPECT_FALSE(wallet.IsLockedNote(sop2));
 }
+
+TEST(WalletTests, GenerateNewKeysOnSeveralThreads) {
+    TestWallet wallet;
+    LOCK(wallet.cs_wallet);
+
+    // enough keys to be split over derivation threads
+    std::vector<CPubKey> pubkeys = wallet.GenerateNewKeys(1000);
+    ASSERT_EQ(pubkeys.size(), 1000);
+
+    std::set<CKeyID> ids;
+    for (const CPubKey &pubkey : pubkeys) {
+        ASSERT_TRUE(pubkey.IsFullyValid());
+        CKey key;
+        ASSERT_TRUE(wallet.GetKey(pubkey.GetID(), key));
+        EXPECT_EQ(key.GetPubKey(), pubkey);
+        ids.insert(pubkey.GetID());
+    }
+    EXPECT_EQ(ids.size(), pubkeys.size());
+}
@@ -89,6 +89,34 @@ std::string DecodeDumpString(const std::string &str) {
     return ret.str();
 }
 
+/** Adds the address index entries of script, returns false if it isn't indexed */
+static bool AddAddressIndexKeys(const CScript& script, std::set<std::pair<uint160, int> >& addresses)
+{
+    std::vector<std::vector<unsigned char> > vSols;
+    CTxDestination dest;
+    txnouttype txType = TX_PUBKEYHASH;
+    int keyType = GetAddressType(script, dest, txType, vSols);
+    if (keyType == 0 || vSols.empty())
+        return false;
+    for (const std::vector<unsigned char>& sol : vSols)
+        addresses.insert(std::make_pair(sol.size() == 20 ? uint160(sol) : Hash160(sol), keyType));
+    return true;
+}
+
+/** The p2pkh and p2pk outputs of a key and the cc outputs the wallet counts as its own are indexed under its keyid */
+static void AddAddressIndexKeys(const CPubKey& pubkey, std::set<std::pair<uint160, int> >& addresses)
+{
+    AddAddressIndexKeys(GetScriptForDestination(pubkey.GetID()), addresses);
+    addresses.insert(std::make_pair(uint160(pubkey.GetID()), 3));
+}
+
+/** Rescans the txs of the addresses found in the address index, or all the blocks without one */
+static void RescanForAddresses(const std::set<std::pair<uint160, int> >& addresses, CBlockIndex* pindexStart, bool fUpdate)
+{
+    if (!pwalletMain->ScanAddressIndexForWalletTransactions(addresses, pindexStart, fUpdate))
+        pwalletMain->ScanForWalletTransactions(pindexStart, fUpdate);
+}
+
 UniValue convertpassphrase(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     if (fHelp || params.size() < 1 || params.size() > 1)
@@ -237,7 +265,9 @@ UniValue importprivkey(const UniValue& params, bool fHelp, const CPubKey& mypk)
         pwalletMain->nTimeFirstKey = 1; // 0 would be considered 'no value'
 
         if (fRescan) {
-            pwalletMain->ScanForWalletTransactions(chainActive[height], true);
+            std::set<std::pair<uint160, int> > addresses;
+            AddAddressIndexKeys(pubkey, addresses);
+            RescanForAddresses(addresses, chainActive[height], true);
         }
     }
 
@@ -344,7 +374,11 @@ UniValue importaddress(const UniValue& params, bool fHelp, const CPubKey& mypk)
 
         if (fRescan)
         {
-            pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
+            std::set<std::pair<uint160, int> > addresses;
+            if (AddAddressIndexKeys(script, addresses))
+                RescanForAddresses(addresses, chainActive.Genesis(), true);
+            else
+                pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
             pwalletMain->ReacceptWalletTransactions();
         }
     }
@@ -412,6 +446,9 @@ UniValue importwallet_impl(const UniValue& params, bool fHelp, bool fImportZKeys
     int64_t nTimeBegin = chainActive.LastTip()->GetBlockTime();
 
     bool fGood = true;
+    // the transparent keys can be rescanned from the address index, unless there are z-keys
+    std::set<std::pair<uint160, int> > addresses;
+    bool fZKeysAdded = false;
 
     int64_t nFilesize = std::max((int64_t)1, (int64_t)file.tellg());
     file.seekg(0, file.beg);
@@ -444,6 +481,8 @@ UniValue importwallet_impl(const UniValue& params, bool fHelp, bool fImportZKeys
                 } else if (addResult == KeyNotAdded) {
                     // Something went wrong
                     fGood = false;
+                } else {
+                    fZKeysAdded = true;
                 }
                 continue;
             } else {
@@ -485,6 +524,7 @@ UniValue importwallet_impl(const UniValue& params, bool fHelp, bool fImportZKeys
         pwalletMain->mapKeyMetadata[keyid].nCreateTime = nTime;
         if (fLabel)
             pwalletMain->SetAddressBook(keyid, strLabel, "receive");
+        AddAddressIndexKeys(pubkey, addresses);
         nTimeBegin = std::min(nTimeBegin, nTime);
     }
     file.close();
@@ -498,7 +538,10 @@ UniValue importwallet_impl(const UniValue& params, bool fHelp, bool fImportZKeys
         pwalletMain->nTimeFirstKey = nTimeBegin;
 
     LogPrintf("Rescanning last %i blocks\n", chainActive.Height() - pindex->GetHeight() + 1);
-    pwalletMain->ScanForWalletTransactions(pindex);
+    if (fZKeysAdded)
+        pwalletMain->ScanForWalletTransactions(pindex);
+    else
+        RescanForAddresses(addresses, pindex, false);
     pwalletMain->MarkDirty();
 
     if (!fGood)
@@ -1027,6 +1070,7 @@ int32_t decode_hex(uint8_t *bytes,int32_t n,char *hex);
 void komodo_DEX_pubkeyupdate();
 
 UniValue komodo_DEX_stats(void);
+UniValue komodo_DEX_perfstats(void);
 uint256 Parseuint256(const char *hexstr);
 extern std::string NSPV_address,NOTARY_PUBKEY;
 extern uint8_t NOTARY_PUBKEY33[33];
@@ -1262,6 +1306,16 @@ UniValue DEX_stats(const UniValue& params, bool fHelp, const CPubKey& mypk)
    return(komodo_DEX_stats());
 }
 
+UniValue DEX_perfstats(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if ( fHelp || params.size() != 0 )
+        throw runtime_error("DEX_perfstats\n"
+            "receive and relay lag histograms (seconds), lock hold and purge time histograms (log2 usecs), packets/sec by funcid since the previous call, hashtable occupancy and relay fanout\n");
+    if ( KOMODO_DEX_P2P == 0 )
+        throw runtime_error("only -dexp2p nodes have DEX_perfstats\n");
+    return(komodo_DEX_perfstats());
+}
+
 UniValue DEX_setpubkey(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     UniValue p; int32_t n;
@@ -1462,6 +1462,41 @@ UniValue sendfrom(const UniValue& params, bool fHelp, const CPubKey& mypk)
 }
 
 
+/** The recipients of a sendmany amounts object, returns their total */
+static CAmount ParseSendManyRecipients(const UniValue& sendTo, const UniValue& subtractFeeFromAmount, std::vector<CRecipient>& vecSend)
+{
+    CAmount totalAmount = 0;
+    std::vector<std::string> keys = sendTo.getKeys();
+    int32_t i = 0;
+    for (const std::string& name_ : keys) {
+        CTxDestination dest = DecodeDestination(name_);
+        if (!IsValidDestination(dest)) {
+            CScript tmpspk;
+            tmpspk << ParseHex(name_) << OP_CHECKSIG;
+            if ( !ExtractDestination(tmpspk, dest, true) )
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, std::string("Invalid Komodo address or pubkey: ") + name_);
+        }
+        CScript scriptPubKey = GetScriptForDestination(dest);
+        
+        CAmount nAmount = AmountFromValue(sendTo[i]);
+        i++;
+        if (nAmount <= 0)
+            throw JSONRPCError(RPC_TYPE_ERROR, "Invalid amount for send");
+        totalAmount += nAmount;
+
+        bool fSubtractFeeFromAmount = false;
+        for (size_t idx = 0; idx < subtractFeeFromAmount.size(); idx++) {
+            const UniValue& addr = subtractFeeFromAmount[idx];
+            if (addr.get_str() == name_)
+                fSubtractFeeFromAmount = true;
+        }
+
+        CRecipient recipient = {scriptPubKey, nAmount, fSubtractFeeFromAmount};
+        vecSend.push_back(recipient);
+    }
+    return totalAmount;
+}
+
 UniValue sendmany(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     if (!EnsureWalletIsAvailable(fHelp))
@@ -1523,36 +1558,7 @@ UniValue sendmany(const UniValue& params, bool fHelp, const CPubKey& mypk)
         subtractFeeFromAmount = params[4].get_array();
 
     std::vector<CRecipient> vecSend;
-
-    CAmount totalAmount = 0;
-    std::vector<std::string> keys = sendTo.getKeys();
-    int32_t i = 0;
-    for (const std::string& name_ : keys) {
-        CTxDestination dest = DecodeDestination(name_);
-        if (!IsValidDestination(dest)) {
-            CScript tmpspk;
-            tmpspk << ParseHex(name_) << OP_CHECKSIG;
-            if ( !ExtractDestination(tmpspk, dest, true) )
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, std::string("Invalid Komodo address or pubkey: ") + name_);
-        }
-        CScript scriptPubKey = GetScriptForDestination(dest);
-        
-        CAmount nAmount = AmountFromValue(sendTo[i]);
-        i++;
-        if (nAmount <= 0)
-            throw JSONRPCError(RPC_TYPE_ERROR, "Invalid amount for send");
-        totalAmount += nAmount;
-
-        bool fSubtractFeeFromAmount = false;
-        for (size_t idx = 0; idx < subtractFeeFromAmount.size(); idx++) {
-            const UniValue& addr = subtractFeeFromAmount[idx];
-            if (addr.get_str() == name_)
-                fSubtractFeeFromAmount = true;
-        }
-
-        CRecipient recipient = {scriptPubKey, nAmount, fSubtractFeeFromAmount};
-        vecSend.push_back(recipient);
-    }
+    CAmount totalAmount = ParseSendManyRecipients(sendTo, subtractFeeFromAmount, vecSend);
 
     EnsureWalletIsUnlocked();
 
@@ -1575,6 +1581,111 @@ UniValue sendmany(const UniValue& params, bool fHelp, const CPubKey& mypk)
     return wtx.GetHash().GetHex();
 }
 
+/** Recipients paid by one transaction of sendmanybatch unless maxoutputs is given */
+static const int DEFAULT_BATCH_OUTPUTS = 500;
+
+UniValue sendmanybatch(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (!EnsureWalletIsAvailable(fHelp))
+        return NullUniValue;
+
+    if (fHelp || params.size() < 2 || params.size() > 5)
+        throw runtime_error(
+            "sendmanybatch \"fromaccount\" {\"address\":amount,...} ( minconf \"comment\" maxoutputs )\n"
+            "\nPay many recipients, with as many transactions of at most maxoutputs recipients each as needed. Each\n"
+            "transaction selects its coins after the previous one was committed, so it may spend its change, and\n"
+            "the transactions are relayed in that order. Amounts are decimal numbers with at most 8 digits of precision."
+            + HelpRequiringPassphrase() + "\n"
+            "\nArguments:\n"
+            "1. \"fromaccount\"         (string, required) MUST be set to the empty string \"\" to represent the default account. Passing any other string will result in an error.\n"
+            "2. \"amounts\"             (string, required) A json object with addresses and amounts\n"
+            "    {\n"
+            "      \"address\":amount   (numeric) The " + strprintf("%s",komodo_chainname()) + " address is the key, the numeric amount in " + strprintf("%s",komodo_chainname()) + " is the value\n"
+            "      ,...\n"
+            "    }\n"
+            "3. minconf                 (numeric, optional, default=1) Only use the balance confirmed at least this many times.\n"
+            "4. \"comment\"             (string, optional) A comment stored with every transaction\n"
+            "5. maxoutputs              (numeric, optional, default=" + strprintf("%d", DEFAULT_BATCH_OUTPUTS) + ") The most recipients paid by one transaction\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"txids\": [\"transactionid\",...]  (array) The transactions sent, in the order they were committed\n"
+            "  \"error\": \"reason\"              (string, optional) Why the next transaction failed, the recipients of it\n"
+            "                                  and of the ones after it weren't paid\n"
+            "  \"unpaid\": n                     (numeric, optional) The number of recipients not paid\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("sendmanybatch", "\"\" \"{\\\"RD6GgnrMpPaTSMn8vai6yiGA7mN4QGPVMY\\\":0.01,\\\"RRyyejME7LRTuvdziWsXkAbSW1fdiohGwK\\\":0.02}\" 1 \"airdrop\" 1") +
+            "\nAs a json rpc call\n"
+            + HelpExampleRpc("sendmanybatch", "\"\", {\"RD6GgnrMpPaTSMn8vai6yiGA7mN4QGPVMY\":0.01,\"RRyyejME7LRTuvdziWsXkAbSW1fdiohGwK\":0.02}, 1, \"airdrop\", 1")
+        );
+    if ( ASSETCHAINS_PRIVATE != 0 )
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "cant use transparent addresses in private chain");
+
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    string strAccount = AccountFromValue(params[0]);
+    UniValue sendTo = params[1].get_obj();
+    int nMinDepth = 1;
+    if (params.size() > 2)
+        nMinDepth = params[2].get_int();
+    std::string strComment;
+    if (params.size() > 3 && !params[3].isNull())
+        strComment = params[3].get_str();
+    int nMaxOutputs = DEFAULT_BATCH_OUTPUTS;
+    if (params.size() > 4)
+        nMaxOutputs = params[4].get_int();
+    if (nMaxOutputs < 1)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid parameter, maxoutputs must be at least 1");
+
+    std::vector<CRecipient> vecRecipients;
+    CAmount totalAmount = ParseSendManyRecipients(sendTo, UniValue(UniValue::VARR), vecRecipients);
+
+    EnsureWalletIsUnlocked();
+
+    // Check funds
+    CAmount nBalance = GetAccountBalance(strAccount, nMinDepth, ISMINE_SPENDABLE);
+    if (totalAmount > nBalance)
+        throw JSONRPCError(RPC_WALLET_INSUFFICIENT_FUNDS, "Account has insufficient funds");
+
+    // One transaction after the other, all within the one lock, coin
+    // selection leaves out the coins the ones before spent
+    UniValue txids(UniValue::VARR);
+    std::string strError;
+    int nErrorCode = RPC_WALLET_INSUFFICIENT_FUNDS;
+    size_t nPaid = 0;
+    while (nPaid < vecRecipients.size()) {
+        std::vector<CRecipient> vecSend(vecRecipients.begin() + nPaid,
+                                        vecRecipients.begin() + std::min(vecRecipients.size(), nPaid + nMaxOutputs));
+        CWalletTx wtx;
+        wtx.strFromAccount = strAccount;
+        if (!strComment.empty())
+            wtx.mapValue["comment"] = strComment;
+
+        CReserveKey keyChange(pwalletMain);
+        CAmount nFeeRequired = 0;
+        int nChangePosRet = -1;
+        if (!pwalletMain->CreateTransaction(vecSend, wtx, keyChange, nFeeRequired, nChangePosRet, strError))
+            break;
+        if (!pwalletMain->CommitTransaction(wtx, keyChange)) {
+            strError = "Transaction commit failed";
+            nErrorCode = RPC_WALLET_ERROR;
+            break;
+        }
+        txids.push_back(wtx.GetHash().GetHex());
+        nPaid += vecSend.size();
+    }
+    if (txids.empty() && !strError.empty())
+        throw JSONRPCError(nErrorCode, strError);
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("txids", txids));
+    if (nPaid < vecRecipients.size()) {
+        result.push_back(Pair("error", strError));
+        result.push_back(Pair("unpaid", (int64_t)(vecRecipients.size() - nPaid)));
+    }
+    return result;
+}
+
 // Defined in rpc/misc.cpp
 extern CScript _createmultisig_redeemScript(const UniValue& params);
 
@@ -3023,26 +3134,27 @@ uint64_t komodo_interestsum()
 #ifdef ENABLE_WALLET
     if ( ASSETCHAINS_SYMBOL[0] == 0 && GetBoolArg("-disablewallet", false) == 0 && KOMODO_NSPV_FULLNODE )
     {
-        uint64_t interest,sum = 0; int32_t txheight; uint32_t locktime;
+        uint64_t sum = 0;
         vector<COutput> vecOutputs;
+        std::vector<struct komodo_interestutxo> utxos;
         assert(pwalletMain != NULL);
         LOCK2(cs_main, pwalletMain->cs_wallet);
         pwalletMain->AvailableCoins(vecOutputs, false, NULL, true);
         BOOST_FOREACH(const COutput& out,vecOutputs)
         {
-            CAmount nValue = out.tx->vout[out.i].nValue;
             if ( out.tx->nLockTime != 0 && out.fSpendable != 0 )
             {
-                BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
-                CBlockIndex *tipindex,*pindex = it->second;
-                if ( pindex != 0 && (tipindex= chainActive.LastTip()) != 0 )
-                {
-                    interest = komodo_accrued_interest(&txheight,&locktime,out.tx->GetHash(),out.i,0,nValue,(int32_t)tipindex->GetHeight());
-                    //interest = komodo_interest(pindex->GetHeight(),nValue,out.tx->nLockTime,tipindex->nTime);
-                    sum += interest;
-                }
+                struct komodo_interestutxo utxo;
+                utxo.txid = out.tx->GetHash();
+                utxo.vout = out.i;
+                utxo.value = out.tx->vout[out.i].nValue;
+                utxos.push_back(utxo);
             }
         }
+        BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
+        CBlockIndex *tipindex;
+        if ( utxos.size() > 0 && it != mapBlockIndex.end() && it->second != 0 && (tipindex= chainActive.LastTip()) != 0 )
+            sum = komodo_accrued_interests(utxos,(int32_t)tipindex->GetHeight());
         KOMODO_INTERESTSUM = sum;
         KOMODO_WALLETBALANCE = pwalletMain->GetBalance();
         return(sum);
@@ -3422,6 +3534,107 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp, const CPubKey& mypk)
             sample_times.push_back(benchmark_loadwallet());
         } else if (benchmarktype == "listunspent") {
             sample_times.push_back(benchmark_listunspent());
+        } else if (benchmarktype == "pricecorrelated") {
+            sample_times.push_back(benchmark_price_correlated());
+        } else if (benchmarktype == "mempoolindex") {
+            int nTxs = 10000;
+            if (params.size() >= 3) {
+                nTxs = params[2].get_int();
+            }
+            sample_times.push_back(benchmark_mempool_index(nTxs));
+        } else if (benchmarktype == "mempoolaccept") {
+            if (Params().NetworkIDString() != "regtest") {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Benchmark must be run in regtest mode");
+            }
+            // transparent chains and their length, then Sapling, CC txns and threads
+            int nChains = params.size() >= 3 ? params[2].get_int() : 100;
+            int nChainLength = params.size() >= 4 ? params[3].get_int() : 10;
+            int nSapling = params.size() >= 5 ? params[4].get_int() : 0;
+            int nCC = params.size() >= 6 ? params[5].get_int() : 100;
+            int nThreads = params.size() >= 7 ? params[6].get_int() : 1;
+            if (nChains < 0 || nChainLength < 0 || nSapling < 0 || nCC < 0 || nThreads < 1)
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid mempoolaccept parameters");
+            sample_times.push_back(benchmark_mempool_accept(nChains, nChainLength, nSapling, nCC, nThreads));
+        } else if (benchmarktype == "coinscache") {
+            int nBlocks = 100;
+            if (params.size() >= 3) {
+                nBlocks = params[2].get_int();
+            }
+            int nBlockTxs = 2000;
+            if (params.size() >= 4) {
+                nBlockTxs = params[3].get_int();
+            }
+            int nCacheMiB = 16;
+            if (params.size() >= 5) {
+                nCacheMiB = params[4].get_int();
+            }
+            sample_times.push_back(benchmark_coins_cache(nBlocks, nBlockTxs, nCacheMiB));
+        } else if (benchmarktype == "hash160s") {
+            int nKeys = 100000;
+            if (params.size() >= 3) {
+                nKeys = params[2].get_int();
+            }
+            sample_times.push_back(benchmark_hash160s(nKeys));
+        } else if (benchmarktype == "sha256") {
+            int nBytes = 1000000;
+            if (params.size() >= 3) {
+                nBytes = params[2].get_int();
+            }
+            sample_times.push_back(benchmark_sha256(nBytes));
+        } else if (benchmarktype == "sha256d64") {
+            int nBlocks = 100000;
+            if (params.size() >= 3) {
+                nBlocks = params[2].get_int();
+            }
+            sample_times.push_back(benchmark_sha256d64(nBlocks));
+        } else if (benchmarktype == "verushash" || benchmarktype == "verushashv2") {
+            int nHashes = 100000;
+            if (params.size() >= 3) {
+                nHashes = params[2].get_int();
+            }
+            sample_times.push_back(benchmark_verushash(nHashes, benchmarktype == "verushashv2"));
+        } else if (benchmarktype == "haraka512") {
+            int nHashes = 1000000;
+            if (params.size() >= 3) {
+                nHashes = params[2].get_int();
+            }
+            sample_times.push_back(benchmark_haraka512(nHashes));
+        } else if (benchmarktype == "ccverify" || benchmarktype == "ccreadfulfillment") {
+            // 1 for a MakeCCcond1 condition, 2 for a MakeCCcond1of2 one
+            int nPubkeys = 1;
+            if (params.size() >= 3) {
+                nPubkeys = params[2].get_int();
+            }
+            int nCount = 1000;
+            if (params.size() >= 4) {
+                nCount = params[3].get_int();
+            }
+            if (benchmarktype == "ccverify")
+                sample_times.push_back(benchmark_cc_verify(nPubkeys, nCount));
+            else
+                sample_times.push_back(benchmark_cc_read_fulfillment(nPubkeys, nCount));
+        } else if (benchmarktype == "stakehash") {
+            int nHashes = 100000;
+            if (params.size() >= 3) {
+                nHashes = params[2].get_int();
+            }
+            sample_times.push_back(benchmark_stakehash(nHashes));
+        } else if (benchmarktype == "dexcipher") {
+            int nBytes = 1024;
+            if (params.size() >= 3) {
+                nBytes = params[2].get_int();
+            }
+            int nMessages = 1000;
+            if (params.size() >= 4) {
+                nMessages = params[3].get_int();
+            }
+            sample_times.push_back(benchmark_dex_cipher(nMessages, nBytes));
+        } else if (benchmarktype == "merkleroot") {
+            int nLeaves = 10000;
+            if (params.size() >= 3) {
+                nLeaves = params[2].get_int();
+            }
+            sample_times.push_back(benchmark_merkle_root(nLeaves));
         } else if (benchmarktype == "createsaplingspend") {
             sample_times.push_back(benchmark_create_sapling_spend());
         } else if (benchmarktype == "createsaplingoutput") {
@@ -7680,6 +7893,7 @@ static const CRPCCommand commands[] =
     { "wallet",             "move",                     &movecmd,                  false },
     { "wallet",             "sendfrom",                 &sendfrom,                 false },
     { "wallet",             "sendmany",                 &sendmany,                 false },
+    { "wallet",             "sendmanybatch",            &sendmanybatch,            false },
     { "wallet",             "sendtoaddress",            &sendtoaddress,            false },
     { "wallet",             "setaccount",               &setaccount,               true  },
     { "wallet",             "settxfee",                 &settxfee,                 true  },
@@ -243,29 +243,62 @@ bool CWallet::AddSproutZKey(const libzcash::SproutSpendingKey &key)
 }
 
 CPubKey CWallet::GenerateNewKey()
+{
+    return GenerateNewKeys(1)[0];
+}
+
+/** Keys a derivation thread is given at least, fewer are derived on the calling thread */
+static const unsigned int MIN_KEYS_PER_THREAD = 64;
+
+static void DeriveNewKeys(std::vector<CKey>& secrets, std::vector<CPubKey>& pubkeys, size_t nBegin, size_t nEnd, bool fCompressed)
+{
+    for (size_t i = nBegin; i < nEnd; i++)
+    {
+        secrets[i].MakeNewKey(fCompressed);
+        pubkeys[i] = secrets[i].GetPubKey();
+        assert(secrets[i].VerifyPubKey(pubkeys[i]));
+    }
+}
+
+std::vector<CPubKey> CWallet::GenerateNewKeys(unsigned int nKeys)
 {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
     bool fCompressed = CanSupportFeature(FEATURE_COMPRPUBKEY); // default to compressed public keys if we want 0.6.0 wallets
 
-    CKey secret;
-    secret.MakeNewKey(fCompressed);
+    // the secp256k1 signing context is read only, so the point multiplications
+    // and the self checks of the keys run concurrently
+    std::vector<CKey> secrets(nKeys);
+    std::vector<CPubKey> pubkeys(nKeys);
+    int nThreads = std::min((int)(nKeys / MIN_KEYS_PER_THREAD), std::min(GetNumCores(), MAX_SCRIPTCHECK_THREADS));
+    if (nThreads > 1)
+    {
+        boost::thread_group threads;
+        for (int t = 0; t < nThreads; t++)
+            threads.create_thread(boost::bind(&DeriveNewKeys, boost::ref(secrets), boost::ref(pubkeys),
+                                              (size_t)nKeys * t / nThreads, (size_t)nKeys * (t + 1) / nThreads, fCompressed));
+        threads.join_all();
+    }
+    else
+        DeriveNewKeys(secrets, pubkeys, 0, nKeys, fCompressed);
 
     // Compressed public keys were introduced in version 0.6.0
     if (fCompressed)
         SetMinVersion(FEATURE_COMPRPUBKEY);
 
-    CPubKey pubkey = secret.GetPubKey();
-    assert(secret.VerifyPubKey(pubkey));
-
     // Create new metadata
     int64_t nCreationTime = GetTime();
-    mapKeyMetadata[pubkey.GetID()] = CKeyMetadata(nCreationTime);
     if (!nTimeFirstKey || nCreationTime < nTimeFirstKey)
         nTimeFirstKey = nCreationTime;
-
-    if (!AddKeyPubKey(secret, pubkey))
-        throw std::runtime_error("CWallet::GenerateNewKey(): AddKey failed");
-    return pubkey;
+    // no wallet tx pays to a key that didn't exist yet
+    bool fWasDirty = fSpendableCoinsDirty;
+    for (unsigned int i = 0; i < nKeys; i++)
+    {
+        mapKeyMetadata[pubkeys[i].GetID()] = CKeyMetadata(nCreationTime);
+        if (!AddKeyPubKey(secrets[i], pubkeys[i]))
+            throw std::runtime_error("CWallet::GenerateNewKey(): AddKey failed");
+    }
+    fSpendableCoinsDirty = fWasDirty;
+    return pubkeys;
 }
 
 bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
@@ -279,6 +312,8 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
     script = GetScriptForDestination(pubkey.GetID());
     if (HaveWatchOnly(script))
         RemoveWatchOnly(script);
+    // wallet txs paying to an imported key are ours now
+    MarkSpendableCoinsDirty();
 
     if (!fFileBacked)
         return true;
@@ -456,6 +491,7 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    MarkSpendableCoinsDirty();
     if (!fFileBacked)
         return true;
     return CWalletDB(strWalletFile).WriteCScript(Hash160(redeemScript), redeemScript);
@@ -482,6 +518,7 @@ bool CWallet::AddWatchOnly(const CScript &dest)
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
     nTimeFirstKey = 1; // No birthday information for watch-only keys.
+    MarkSpendableCoinsDirty();
     NotifyWatchonlyChanged(true);
     if (!fFileBacked)
         return true;
@@ -583,6 +620,8 @@ void CWallet::ChainTip(const CBlockIndex *pindex,
         IncrementNoteWitnesses(pindex, pblock, sproutTree, saplingTree);
     } else {
         DecrementNoteWitnesses(pindex);
+        // the outputs the block spent are unspent again
+        MarkSpendableCoinsDirty();
     }
     UpdateSaplingNullifierNoteMapForBlock(pblock);
 }
@@ -590,7 +629,8 @@ void CWallet::ChainTip(const CBlockIndex *pindex,
 void CWallet::SetBestChain(const CBlockLocator& loc)
 {
     CWalletDB walletdb(strWalletFile);
-    SetBestChainINTERNAL(walletdb, loc);
+    // an interrupted rescan has to go on from where it stopped
+    SetBestChainINTERNAL(walletdb, rescanCheckpoint.IsNull() ? loc : rescanCheckpoint);
 }
 
 std::set<std::pair<libzcash::PaymentAddress, uint256>> CWallet::GetNullifiersForAddresses(
@@ -877,6 +917,30 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
     return false;
 }
 
+/**
+ * Whether wtx has an output of ours that no wallet tx in a block spends yet,
+ * only those are kept in setSpendableCoinTxs. A spend in a block can only be
+ * undone by a reorg, which marks the set dirty.
+ */
+bool CWallet::HasUnspentOutputs(const uint256& wtxid, const CWalletTx& wtx) const
+{
+    for (unsigned int i = 0; i < wtx.vout.size(); i++)
+    {
+        if (IsMine(wtx.vout[i]) == ISMINE_NO)
+            continue;
+        bool fSpentInBlock = false;
+        pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(COutPoint(wtxid, i));
+        for (TxSpends::const_iterator it = range.first; it != range.second && !fSpentInBlock; ++it)
+        {
+            std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+            fSpentInBlock = mit != mapWallet.end() && mit->second.GetDepthInMainChain() > 0;
+        }
+        if (!fSpentInBlock)
+            return true;
+    }
+    return false;
+}
+
 /**
  * Note is spent if any non-conflicted transaction
  * spends it:
@@ -1000,8 +1064,12 @@ void CopyPreviousWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t nW
     }
 }
 
-template<typename NoteDataMap>
-void AppendNoteCommitment(NoteDataMap& noteDataMap, int indexHeight, int64_t nWitnessCacheSize, const uint256& note_commitment)
+/**
+ * Adds the notes of noteDataMap whose witnesses are incremented by the block
+ * at indexHeight to appends, to have all of its commitments appended.
+ */
+template<typename OutPoint, typename NoteData>
+void FindWitnessesToIncrement(std::map<OutPoint, NoteData>& noteDataMap, int indexHeight, int64_t nWitnessCacheSize, std::map<NoteData*, size_t>& appends)
 {
     for (auto& item : noteDataMap) {
         auto* nd = &(item.second);
@@ -1009,13 +1077,57 @@ void AppendNoteCommitment(NoteDataMap& noteDataMap, int indexHeight, int64_t nWi
             // Check the validity of the cache
             // See comment in CopyPreviousWitnesses about validity.
             assert(nWitnessCacheSize >= nd->witnesses.size());
-            nd->witnesses.front().append(note_commitment);
+            appends[nd] = 0;
         }
     }
 }
 
+template<typename NoteData>
+void AppendNoteCommitmentRange(const std::vector<std::pair<NoteData*, size_t> >& appends, size_t nBegin, size_t nEnd, const std::vector<uint256>& commitments)
+{
+    for (size_t i = nBegin; i < nEnd; i++) {
+        auto& witness = appends[i].first->witnesses.front();
+        for (size_t j = appends[i].second; j < commitments.size(); j++)
+            witness.append(commitments[j]);
+    }
+}
+
+/** Witness appends a thread is given at least, fewer are done on the calling thread */
+static const size_t MIN_WITNESS_APPENDS_PER_THREAD = 64;
+
+/**
+ * Appends the commitments of a block, from the index given for each note on,
+ * to the newest witnesses of the notes. The notes are independent, so they
+ * are split over several threads.
+ */
+template<typename NoteData>
+void AppendNoteCommitments(const std::map<NoteData*, size_t>& appends, const std::vector<uint256>& commitments)
+{
+    std::vector<std::pair<NoteData*, size_t> > vAppends;
+    size_t nAppends = 0;
+    for (const auto& append : appends) {
+        if (append.second < commitments.size()) {
+            vAppends.push_back(append);
+            nAppends += commitments.size() - append.second;
+        }
+    }
+    int nThreads = std::min((size_t)std::min(GetNumCores(), MAX_SCRIPTCHECK_THREADS),
+                            std::min(nAppends / MIN_WITNESS_APPENDS_PER_THREAD, vAppends.size()));
+    if (nThreads > 1) {
+        boost::thread_group threads;
+        for (int t = 0; t < nThreads; t++)
+            threads.create_thread(boost::bind(&AppendNoteCommitmentRange<NoteData>, boost::cref(vAppends),
+                                              vAppends.size() * t / nThreads, vAppends.size() * (t + 1) / nThreads,
+                                              boost::cref(commitments)));
+        threads.join_all();
+    } else {
+        AppendNoteCommitmentRange(vAppends, 0, vAppends.size(), commitments);
+    }
+}
+
+/** Returns true if the note of key is given witness, as the block at indexHeight created it */
 template<typename OutPoint, typename NoteData, typename Witness>
-void WitnessNoteIfMine(std::map<OutPoint, NoteData>& noteDataMap, int indexHeight, int64_t nWitnessCacheSize, const OutPoint& key, const Witness& witness)
+bool WitnessNoteIfMine(std::map<OutPoint, NoteData>& noteDataMap, int indexHeight, int64_t nWitnessCacheSize, const OutPoint& key, const Witness& witness)
 {
     if (noteDataMap.count(key) && noteDataMap[key].witnessHeight < indexHeight) {
         auto* nd = &(noteDataMap[key]);
@@ -1041,7 +1153,9 @@ void WitnessNoteIfMine(std::map<OutPoint, NoteData>& noteDataMap, int indexHeigh
         nd->witnessHeight = indexHeight - 1;
         // Check the validity of the cache
         assert(nWitnessCacheSize >= nd->witnesses.size());
+        return true;
     }
+    return false;
 }
 
 
@@ -1074,6 +1188,17 @@ void CWallet::IncrementNoteWitnesses(const CBlockIndex* pindex,
         nWitnessCacheSize += 1;
     }
 
+    // The notes whose witnesses get the commitments of the block, with the
+    // index of the first one; the wallet is walked once, not per commitment.
+    std::map<SproutNoteData*, size_t> sproutAppends;
+    std::map<SaplingNoteData*, size_t> saplingAppends;
+    for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
+        ::FindWitnessesToIncrement(wtxItem.second.mapSproutNoteData, pindex->GetHeight(), nWitnessCacheSize, sproutAppends);
+        ::FindWitnessesToIncrement(wtxItem.second.mapSaplingNoteData, pindex->GetHeight(), nWitnessCacheSize, saplingAppends);
+    }
+    std::vector<uint256> sproutCommitments;
+    std::vector<uint256> saplingCommitments;
+
     const CBlock* pblock {pblockIn};
     CBlock block;
     if (!pblock) {
@@ -1090,16 +1215,14 @@ void CWallet::IncrementNoteWitnesses(const CBlockIndex* pindex,
             for (uint8_t j = 0; j < jsdesc.commitments.size(); j++) {
                 const uint256& note_commitment = jsdesc.commitments[j];
                 sproutTree.append(note_commitment);
+                sproutCommitments.push_back(note_commitment);
 
-                // Increment existing witnesses
-                for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
-                    ::AppendNoteCommitment(wtxItem.second.mapSproutNoteData, pindex->GetHeight(), nWitnessCacheSize, note_commitment);
-                }
-
-                // If this is our note, witness it
+                // If this is our note, witness it, the rest of the block is appended to it
                 if (txIsOurs) {
                     JSOutPoint jsoutpt {hash, i, j};
-                    ::WitnessNoteIfMine(mapWallet[hash].mapSproutNoteData, pindex->GetHeight(), nWitnessCacheSize, jsoutpt, sproutTree.witness());
+                    mapSproutNoteData_t& noteData = mapWallet[hash].mapSproutNoteData;
+                    if (::WitnessNoteIfMine(noteData, pindex->GetHeight(), nWitnessCacheSize, jsoutpt, sproutTree.witness()))
+                        sproutAppends[&noteData[jsoutpt]] = sproutCommitments.size();
                 }
             }
         }
@@ -1107,20 +1230,22 @@ void CWallet::IncrementNoteWitnesses(const CBlockIndex* pindex,
         for (uint32_t i = 0; i < tx.vShieldedOutput.size(); i++) {
             const uint256& note_commitment = tx.vShieldedOutput[i].cm;
             saplingTree.append(note_commitment);
+            saplingCommitments.push_back(note_commitment);
 
-            // Increment existing witnesses
-            for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
-                ::AppendNoteCommitment(wtxItem.second.mapSaplingNoteData, pindex->GetHeight(), nWitnessCacheSize, note_commitment);
-            }
-
-            // If this is our note, witness it
+            // If this is our note, witness it, the rest of the block is appended to it
             if (txIsOurs) {
                 SaplingOutPoint outPoint {hash, i};
-                ::WitnessNoteIfMine(mapWallet[hash].mapSaplingNoteData, pindex->GetHeight(), nWitnessCacheSize, outPoint, saplingTree.witness());
+                mapSaplingNoteData_t& noteData = mapWallet[hash].mapSaplingNoteData;
+                if (::WitnessNoteIfMine(noteData, pindex->GetHeight(), nWitnessCacheSize, outPoint, saplingTree.witness()))
+                    saplingAppends[&noteData[outPoint]] = saplingCommitments.size();
             }
         }
     }
 
+    // Increment existing witnesses
+    ::AppendNoteCommitments(sproutAppends, sproutCommitments);
+    ::AppendNoteCommitments(saplingAppends, saplingCommitments);
+
     // Update witness heights
     for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
         ::UpdateWitnessHeights(wtxItem.second.mapSproutNoteData, pindex->GetHeight(), nWitnessCacheSize);
@@ -1691,6 +1816,9 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         // Break debit/credit balance caches:
         wtx.MarkDirty();
 
+        if (!fSpendableCoinsDirty && HasUnspentOutputs(hash, wtx))
+            setSpendableCoinTxs.insert(hash);
+
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
 
@@ -1749,7 +1877,8 @@ bool CWallet::UpdatedNoteData(const CWalletTx& wtxIn, CWalletTx& wtx)
  * pblock is optional, but should be provided if the transaction is known to be in a block.
  * If fUpdate is true, existing transactions will be updated.
  */
-bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate)
+bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate,
+                                       const std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap>* pSaplingNotes)
 {
     {
         AssertLockHeld(cs_wallet);
@@ -1758,7 +1887,7 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pbl
         bool fExisted = mapWallet.count(tx.GetHash()) != 0;
         if (fExisted && !fUpdate) return false;
         auto sproutNoteData = FindMySproutNotes(tx);
-        auto saplingNoteDataAndAddressesToAdd = FindMySaplingNotes(tx);
+        auto saplingNoteDataAndAddressesToAdd = pSaplingNotes ? *pSaplingNotes : FindMySaplingNotes(tx);
         auto saplingNoteData = saplingNoteDataAndAddressesToAdd.first;
         auto addressesToAdd = saplingNoteDataAndAddressesToAdd.second;
         for (const auto &addressToAdd : addressesToAdd) {
@@ -1971,6 +2100,24 @@ mapSproutNoteData_t CWallet::FindMySproutNotes(const CTransaction &tx) const
 }
 
 
+/** Trial decryptions a thread is given at least, fewer are run on the calling thread */
+static const size_t MIN_TRIAL_DECRYPTIONS_PER_THREAD = 256;
+
+/** vMatch[i] is set to the first of ivks[nBegin, nEnd) that decrypts output i of tx, if it is before vMatch[i] */
+static void TrialDecryptSaplingOutputs(const CTransaction &tx, const std::vector<SaplingIncomingViewingKey> &ivks,
+                                       size_t nBegin, size_t nEnd, std::vector<size_t> &vMatch)
+{
+    for (uint32_t i = 0; i < tx.vShieldedOutput.size(); ++i) {
+        const OutputDescription &output = tx.vShieldedOutput[i];
+        for (size_t j = nBegin; j < nEnd && j < vMatch[i]; j++) {
+            if (SaplingNotePlaintext::decrypt(output.encCiphertext, ivks[j], output.ephemeralKey, output.cm)) {
+                vMatch[i] = j;
+                break;
+            }
+        }
+    }
+}
+
 /**
  * Finds all output notes in the given transaction that have been sent to
  * SaplingPaymentAddresses in this wallet.
@@ -1987,44 +2134,63 @@ std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> CWallet::FindMySap
     mapSaplingNoteData_t noteData;
     SaplingIncomingViewingKeyMap viewingKeysToAdd;
 
+    if (tx.vShieldedOutput.empty())
+        return std::make_pair(noteData, viewingKeysToAdd);
+
+    // The ivks of the full viewing keys come first, then those only known by
+    // their addresses. Every address of a diversified ivk maps to it, so each
+    // ivk is tried once.
+    std::vector<SaplingIncomingViewingKey> ivks;
+    std::set<SaplingIncomingViewingKey> setIvks;
+    for (auto it = mapSaplingFullViewingKeys.begin(); it != mapSaplingFullViewingKeys.end(); ++it) {
+        ivks.push_back(it->first);
+        setIvks.insert(it->first);
+    }
+    size_t nFullViewingKeys = ivks.size();
+    for (auto it = mapSaplingIncomingViewingKeys.begin(); it != mapSaplingIncomingViewingKeys.end(); ++it) {
+        if (setIvks.insert(it->second).second)
+            ivks.push_back(it->second);
+    }
+
     // Protocol Spec: 4.19 Block Chain Scanning (Sapling)
+    // The outputs x ivks trial decryptions are split by ivk over the threads.
+    std::vector<size_t> vMatch(tx.vShieldedOutput.size(), ivks.size());
+    size_t nDecryptions = tx.vShieldedOutput.size() * ivks.size();
+    int nThreads = std::min((size_t)std::min(GetNumCores(), MAX_SCRIPTCHECK_THREADS),
+                            std::min(nDecryptions / MIN_TRIAL_DECRYPTIONS_PER_THREAD, ivks.size()));
+    if (nThreads > 1) {
+        std::vector<std::vector<size_t> > vThreadMatch(nThreads, vMatch);
+        boost::thread_group threads;
+        for (int t = 0; t < nThreads; t++)
+            threads.create_thread(boost::bind(&TrialDecryptSaplingOutputs, boost::cref(tx), boost::cref(ivks),
+                                              ivks.size() * t / nThreads, ivks.size() * (t + 1) / nThreads,
+                                              boost::ref(vThreadMatch[t])));
+        threads.join_all();
+        for (int t = 0; t < nThreads; t++)
+            for (size_t i = 0; i < vMatch.size(); i++)
+                vMatch[i] = std::min(vMatch[i], vThreadMatch[t][i]);
+    } else {
+        TrialDecryptSaplingOutputs(tx, ivks, 0, ivks.size(), vMatch);
+    }
+
     for (uint32_t i = 0; i < tx.vShieldedOutput.size(); ++i) {
-        const OutputDescription output = tx.vShieldedOutput[i];
-        bool found = false;
-        for (auto it = mapSaplingFullViewingKeys.begin(); it != mapSaplingFullViewingKeys.end(); ++it) {
-            SaplingIncomingViewingKey ivk = it->first;
+        if (vMatch[i] == ivks.size())
+            continue;
+        const SaplingIncomingViewingKey &ivk = ivks[vMatch[i]];
+        if (vMatch[i] < nFullViewingKeys) {
+            const OutputDescription &output = tx.vShieldedOutput[i];
             auto result = SaplingNotePlaintext::decrypt(output.encCiphertext, ivk, output.ephemeralKey, output.cm);
-            if (result) {
-                auto address = ivk.address(result.get().d);
-                if (address && mapSaplingIncomingViewingKeys.count(address.get()) == 0) {
-                    viewingKeysToAdd[address.get()] = ivk;
-                }
-                // We don't cache the nullifier here as computing it requires knowledge of the note position
-                // in the commitment tree, which can only be determined when the transaction has been mined.
-                SaplingOutPoint op {hash, i};
-                SaplingNoteData nd;
-                nd.ivk = ivk;
-                noteData.insert(std::make_pair(op, nd));
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            for (auto it = mapSaplingIncomingViewingKeys.begin(); it != mapSaplingIncomingViewingKeys.end(); ++it) {
-                SaplingIncomingViewingKey ivk = it-> second;
-                auto result = SaplingNotePlaintext::decrypt(output.encCiphertext, ivk, output.ephemeralKey, output.cm);
-                if (!result) {
-                    continue;
-                }
-                // We don't cache the nullifier here as computing it requires knowledge of the note position
-                // in the commitment tree, which can only be determined when the transaction has been mined.
-                SaplingOutPoint op {hash, i};
-                SaplingNoteData nd;
-                nd.ivk = ivk;
-                noteData.insert(std::make_pair(op, nd));
-                break;
+            auto address = ivk.address(result.get().d);
+            if (address && mapSaplingIncomingViewingKeys.count(address.get()) == 0) {
+                viewingKeysToAdd[address.get()] = ivk;
             }
         }
+        // We don't cache the nullifier here as computing it requires knowledge of the note position
+        // in the commitment tree, which can only be determined when the transaction has been mined.
+        SaplingOutPoint op {hash, i};
+        SaplingNoteData nd;
+        nd.ivk = ivk;
+        noteData.insert(std::make_pair(op, nd));
     }
 
     return std::make_pair(noteData, viewingKeysToAdd);
@@ -2868,16 +3034,37 @@ void CWallet::WitnessNoteCommitment(std::vector<uint256> commitments,
     }
 }
 
+/** A block of a rescan run, read and trial decrypted by a worker */
+struct CRescanBlock
+{
+    CBlockIndex *pindex;
+    CBlock block;
+    std::vector<std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> > vSaplingNotes;
+};
+
+/** Blocks read ahead at once by the rescan workers */
+static const size_t RESCAN_RUN_BLOCKS = 100;
+/** Seconds between two rescan progress checkpoints */
+static const int64_t RESCAN_CHECKPOINT_INTERVAL = 300;
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
+ *
+ * Runs of blocks are read and their Sapling outputs trial decrypted on
+ * several threads, the wallet is then updated from them in chain order. The
+ * scan writes its progress as the wallet best block every few minutes and
+ * stops on shutdown, so the next start rescans from where it was.
  */
 int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
     int ret = 0;
     int64_t nNow = GetTime();
+    int64_t nLastCheckpoint = nNow;
+    bool fCheckpointed = false;
     const CChainParams& chainParams = Params();
+    int nThreads = std::max(1, std::min(GetNumCores(), MAX_SCRIPTCHECK_THREADS));
 
     CBlockIndex* pindex = pindexStart;
 
@@ -2896,38 +3083,78 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
         double dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.LastTip(), false);
         while (pindex)
         {
-            if (pindex->GetHeight() % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+            if (ShutdownRequested()) {
+                // the wallet keeps the checkpoint as its best block until the next start
+                LogPrintf("Rescan interrupted at block %d\n", pindex->GetHeight());
+                rescanCheckpoint = chainActive.GetLocator(pindex->pprev ? pindex->pprev : pindex);
+                SetBestChain(rescanCheckpoint);
+                break;
+            }
+
+            // workers read and trial decrypt blocks t, t+nThreads, ... of the run
+            std::vector<CRescanBlock> vBlocks;
+            for (CBlockIndex *pindexRun = pindex; pindexRun && vBlocks.size() < RESCAN_RUN_BLOCKS; pindexRun = chainActive.Next(pindexRun)) {
+                vBlocks.push_back(CRescanBlock());
+                vBlocks.back().pindex = pindexRun;
+            }
+            boost::thread_group workers;
+            for (int t = 0; t < nThreads; t++)
+                workers.create_thread([this, &vBlocks, t, nThreads]() {
+                    for (size_t i = t; i < vBlocks.size(); i += nThreads) {
+                        CRescanBlock &entry = vBlocks[i];
+                        ReadBlockFromDisk(entry.block, entry.pindex, 1);
+                        entry.vSaplingNotes.resize(entry.block.vtx.size());
+                        for (size_t j = 0; j < entry.block.vtx.size(); j++)
+                            if (!entry.block.vtx[j].vShieldedOutput.empty())
+                                entry.vSaplingNotes[j] = FindMySaplingNotes(entry.block.vtx[j]);
+                    }
+                });
+            workers.join_all();
 
-            CBlock block;
-            ReadBlockFromDisk(block, pindex,1);
-            BOOST_FOREACH(CTransaction& tx, block.vtx)
+            for (CRescanBlock &entry : vBlocks)
             {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate)) {
-                    myTxHashes.push_back(tx.GetHash());
-                    ret++;
+                pindex = entry.pindex;
+                CBlock &block = entry.block;
+                if (pindex->GetHeight() % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+                    ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+
+                for (size_t j = 0; j < block.vtx.size(); j++)
+                {
+                    const CTransaction& tx = block.vtx[j];
+                    if (AddToWalletIfInvolvingMe(tx, &block, fUpdate, &entry.vSaplingNotes[j])) {
+                        myTxHashes.push_back(tx.GetHash());
+                        ret++;
+                    }
                 }
-            }
 
-            SproutMerkleTree sproutTree;
-            SaplingMerkleTree saplingTree;
-            // This should never fail: we should always be able to get the tree
-            // state on the path to the tip of our chain
-            assert(pcoinsTip->GetSproutAnchorAt(pindex->hashSproutAnchor, sproutTree));
-            if (pindex->pprev) {
-                if (NetworkUpgradeActive(pindex->pprev->GetHeight(), Params().GetConsensus(), Consensus::UPGRADE_SAPLING)) {
-                    assert(pcoinsTip->GetSaplingAnchorAt(pindex->pprev->hashFinalSaplingRoot, saplingTree));
+                SproutMerkleTree sproutTree;
+                SaplingMerkleTree saplingTree;
+                // This should never fail: we should always be able to get the tree
+                // state on the path to the tip of our chain
+                assert(pcoinsTip->GetSproutAnchorAt(pindex->hashSproutAnchor, sproutTree));
+                if (pindex->pprev) {
+                    if (NetworkUpgradeActive(pindex->pprev->GetHeight(), Params().GetConsensus(), Consensus::UPGRADE_SAPLING)) {
+                        assert(pcoinsTip->GetSaplingAnchorAt(pindex->pprev->hashFinalSaplingRoot, saplingTree));
+                    }
                 }
+                // Increment note witness caches
+                ChainTip(pindex, &block, sproutTree, saplingTree, true);
             }
-            // Increment note witness caches
-            ChainTip(pindex, &block, sproutTree, saplingTree, true);
 
-            pindex = chainActive.Next(pindex);
             if (GetTime() >= nNow + 60) {
                 nNow = GetTime();
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->GetHeight(), Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
             }
+            // the witness caches and the wallet best block are written together
+            if (GetTime() >= nLastCheckpoint + RESCAN_CHECKPOINT_INTERVAL) {
+                nLastCheckpoint = GetTime();
+                SetBestChain(chainActive.GetLocator(pindex));
+                fCheckpointed = true;
+            }
+            pindex = chainActive.Next(pindex);
         }
+        if (fCheckpointed)
+            SetBestChain(chainActive.GetLocator());
 
         // After rescanning, persist Sapling note data that might have changed, e.g. nullifiers.
         // Do not flush the wallet here for performance reasons.
@@ -2946,6 +3173,47 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
     return ret;
 }
 
+/**
+ * Rescan only the txs the address index has for addresses ((hash, type) as
+ * GetAddressType indexes them) from pindexStart on, in chain order. Returns
+ * false if there is no address index or it can't be read, the caller scans
+ * all the blocks then.
+ */
+bool CWallet::ScanAddressIndexForWalletTransactions(const std::set<std::pair<uint160, int> >& addresses, CBlockIndex* pindexStart, bool fUpdate)
+{
+    extern bool fAddressIndex;
+    if (!fAddressIndex || pindexStart == NULL)
+        return false;
+
+    LOCK2(cs_main, cs_wallet);
+
+    // the txs receiving or spending from the addresses, by height and position
+    std::map<int, std::set<unsigned int> > mapTxs;
+    for (const std::pair<uint160, int>& address : addresses) {
+        if (!ForEachAddressIndex(address.first, address.second, std::max(1, pindexStart->GetHeight()), std::max(1, chainActive.Height()), NULL,
+                                 [&](const CAddressIndexKey &key, CAmount nValue) {
+                                     mapTxs[key.blockHeight].insert(key.txindex);
+                                     return true;
+                                 }))
+            return false;
+    }
+
+    int nTxs = 0, nFound = 0;
+    for (const std::pair<int, std::set<unsigned int> >& txs : mapTxs) {
+        CBlockIndex *pindex = chainActive[txs.first];
+        CBlock block;
+        if (pindex == NULL || !ReadBlockFromDisk(block, pindex, 1))
+            return false;
+        nTxs += txs.second.size();
+        for (unsigned int txindex : txs.second) {
+            if (txindex < block.vtx.size() && AddToWalletIfInvolvingMe(block.vtx[txindex], &block, fUpdate))
+                nFound++;
+        }
+    }
+    LogPrintf("%s: %d txs in %u blocks of the address index, %d added or updated\n", __func__, nTxs, mapTxs.size(), nFound);
+    return true;
+}
+
 void CWallet::ReacceptWalletTransactions()
 {
     if ( IsInitialBlockDownload() )
@@ -3393,8 +3661,23 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        if (fSpendableCoinsDirty)
         {
+            setSpendableCoinTxs.clear();
+            for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+                if (HasUnspentOutputs(it->first, it->second))
+                    setSpendableCoinTxs.insert(it->first);
+            fSpendableCoinsDirty = false;
+        }
+        for (std::set<uint256>::iterator sit = setSpendableCoinTxs.begin(); sit != setSpendableCoinTxs.end(); )
+        {
+            map<uint256, CWalletTx>::const_iterator it = mapWallet.find(*sit);
+            if (it == mapWallet.end() || !HasUnspentOutputs(it->first, it->second))
+            {
+                setSpendableCoinTxs.erase(sit++);
+                continue;
+            }
+            ++sit;
             const uint256& wtxid = it->first;
             const CWalletTx* pcoin = &(*it).second;
 
@@ -4369,10 +4652,11 @@ bool CWallet::NewKeyPool()
             return false;
 
         int64_t nKeys = max(GetArg("-keypool", 100), (int64_t)0);
+        std::vector<CPubKey> pubkeys = GenerateNewKeys(nKeys);
         for (int i = 0; i < nKeys; i++)
         {
             int64_t nIndex = i+1;
-            walletdb.WritePool(nIndex, CKeyPool(GenerateNewKey()));
+            walletdb.WritePool(nIndex, CKeyPool(pubkeys[i]));
             setKeyPool.insert(nIndex);
         }
         LogPrintf("CWallet::NewKeyPool wrote %d new keys\n", nKeys);
@@ -4397,15 +4681,19 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         else
             nTargetSize = max(GetArg("-keypool", 100), (int64_t) 0);
 
-        while (setKeyPool.size() < (nTargetSize + 1))
+        if (setKeyPool.size() < (nTargetSize + 1))
         {
+            std::vector<CPubKey> pubkeys = GenerateNewKeys(nTargetSize + 1 - setKeyPool.size());
             int64_t nEnd = 1;
             if (!setKeyPool.empty())
                 nEnd = *(--setKeyPool.end()) + 1;
-            if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey())))
-                throw runtime_error("TopUpKeyPool(): writing generated key failed");
-            setKeyPool.insert(nEnd);
-            LogPrintf("keypool added key %d, size=%u\n", nEnd, setKeyPool.size());
+            for (const CPubKey &pubkey : pubkeys)
+            {
+                if (!walletdb.WritePool(nEnd, CKeyPool(pubkey)))
+                    throw runtime_error("TopUpKeyPool(): writing generated key failed");
+                setKeyPool.insert(nEnd++);
+            }
+            LogPrintf("keypool added %u keys up to key %d, size=%u\n", pubkeys.size(), nEnd - 1, setKeyPool.size());
         }
     }
     return true;
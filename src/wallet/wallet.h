@@ -784,6 +784,17 @@ private:
     void AddToSaplingSpends(const uint256& nullifier, const uint256& wtxid);
     void AddToSpends(const uint256& wtxid);
 
+    /**
+     * The txs of mapWallet that may still have an unspent output of ours, so
+     * AvailableCoins doesn't walk the whole wallet. A tx leaves it once each of
+     * its outputs of ours is spent in a block, fSpendableCoinsDirty has it built
+     * again from mapWallet after a reorg or a key import.
+     */
+    mutable std::set<uint256> setSpendableCoinTxs;
+    mutable bool fSpendableCoinsDirty;
+    bool HasUnspentOutputs(const uint256& wtxid, const CWalletTx& wtx) const;
+    void MarkSpendableCoinsDirty() { fSpendableCoinsDirty = true; }
+
 public:
     /*
      * Size of the incremental witness cache for the notes in our wallet.
@@ -792,6 +803,11 @@ public:
      */
     int64_t nWitnessCacheSize;
     bool needsRescan = false;
+    /**
+     * The last block an interrupted rescan got to. SetBestChain writes it
+     * instead of the tip, so the rescan goes on from it on the next start.
+     */
+    CBlockLocator rescanCheckpoint;
 
     void ClearNoteWitnessCache();
 
@@ -816,8 +832,10 @@ protected:
             return;
         }
         try {
-            for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
-                auto wtx = wtxItem.second;
+            // The txs are written from mapWallet, a copy of each would copy
+            // the whole witness caches of its notes as well
+            for (const std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
+                const CWalletTx& wtx = wtxItem.second;
                 // We skip transactions for which mapSproutNoteData and mapSaplingNoteData
                 // are empty. This covers transactions that have no Sprout or Sapling data
                 // (i.e. are purely transparent), as well as shielding and unshielding
@@ -919,6 +937,7 @@ public:
         nTimeFirstKey = 0;
         fBroadcastTransactions = false;
         nWitnessCacheSize = 0;
+        fSpendableCoinsDirty = true;
     }
 
     /**
@@ -1023,6 +1042,8 @@ public:
      * Generate a new key
      */
     CPubKey GenerateNewKey();
+    //! Generate nKeys new keys, deriving their pubkeys on several threads
+    std::vector<CPubKey> GenerateNewKeys(unsigned int nKeys);
     //! Adds a key to the store, and saves it to disk.
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey);
     //! Adds a key to the store, without saving it to disk (used by LoadWallet)
@@ -1139,12 +1160,15 @@ public:
     void EraseFromWallet(const uint256 &hash);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
     void RescanWallet();
-    bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
+    /** pSaplingNotes is the FindMySaplingNotes result for tx, if it was already found */
+    bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate,
+                                  const std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap>* pSaplingNotes = NULL);
     void WitnessNoteCommitment(
          std::vector<uint256> commitments,
          std::vector<boost::optional<SproutWitness>>& witnesses,
          uint256 &final_anchor);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    bool ScanAddressIndexForWalletTransactions(const std::set<std::pair<uint160, int> >& addresses, CBlockIndex* pindexStart, bool fUpdate = false);
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime);
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime);
@@ -457,6 +457,86 @@ public:
     }
 };
 
+/**
+ * Checks a wallet tx read from its "tx" record and adds it to the wallet,
+ * ssValue holds what is left of the record after the CWalletTx.
+ */
+static bool LoadWalletTx(CWallet* pwallet, const uint256& hash, CWalletTx& wtx, CDataStream& ssValue,
+                         CWalletScanState &wss, string& strErr)
+{
+    CValidationState state;
+    auto verifier = libzcash::ProofVerifier::Strict();
+    // ac_public chains set at height like KMD and ZEX, will force a rescan if we dont ignore this error: bad-txns-acpublic-chain
+    // there cannot be any ztx in the wallet on ac_public chains that started from block 1, so this wont affect those. 
+    // PIRATE fails this check for notary nodes, need exception. Triggers full rescan without it. 
+    if ( !(CheckTransaction(0,wtx, state, verifier, 0, 0) && (wtx.GetHash() == hash) && state.IsValid()) && (state.GetRejectReason() != "bad-txns-acpublic-chain" && state.GetRejectReason() != "bad-txns-acprivacy-chain" && state.GetRejectReason() != "bad-txns-stakingtx") )
+    {
+        //fprintf(stderr, "tx failed: %s rejectreason.%s\n", wtx.GetHash().GetHex().c_str(), state.GetRejectReason().c_str());
+        // vin-empty on staking chains is error relating to a failed staking tx, that for some unknown reason did not fully erase. save them here to erase and re-add later on.
+        if ( ASSETCHAINS_STAKED != 0 && state.GetRejectReason() == "bad-txns-vin-empty" )
+            deadTxns.push_back(hash);
+        return false;
+    }
+    // Undo serialize changes in 31600
+    if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
+    {
+        if (!ssValue.empty())
+        {
+            char fTmp;
+            char fUnused;
+            ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
+            strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
+                               wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = fTmp;
+        }
+        else
+        {
+            strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = 0;
+        }
+        wss.vWalletUpgrade.push_back(hash);
+    }
+
+    if (wtx.nOrderPos == -1)
+        wss.fAnyUnordered = true;
+
+    pwallet->AddToWallet(wtx, true, NULL);
+    return true;
+}
+
+/** A "tx" record of the wallet, read from the database and then deserialized with others on several threads */
+struct CWalletTxRecord
+{
+    CDataStream ssKey;
+    CDataStream ssValue;
+    uint256 hash;
+    CWalletTx wtx;
+    bool fRead;
+
+    CWalletTxRecord(const CDataStream& ssKeyIn, const CDataStream& ssValueIn) :
+        ssKey(ssKeyIn), ssValue(ssValueIn), fRead(false) {}
+};
+
+static void DeserializeWalletTxRecords(std::vector<CWalletTxRecord>& records, size_t nBegin, size_t nEnd)
+{
+    for (size_t i = nBegin; i < nEnd; i++) {
+        CWalletTxRecord& record = records[i];
+        try {
+            string strType;
+            record.ssKey >> strType >> record.hash;
+            record.ssValue >> record.wtx;
+            record.fRead = true;
+        } catch (...) {
+            record.fRead = false;
+        }
+    }
+}
+
+/** Wallet tx records read before they are deserialized and added, the witness caches make them large */
+static const size_t WALLET_TX_RECORDS_BATCH_BYTES = 64 * 1024 * 1024;
+/** Wallet tx records a thread deserializes at least */
+static const size_t MIN_WALLET_TX_RECORDS_PER_THREAD = 16;
+
 bool
 ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
              CWalletScanState &wss, string& strType, string& strErr)
@@ -484,43 +564,8 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
             ssKey >> hash;
             CWalletTx wtx;
             ssValue >> wtx;
-            CValidationState state;
-            auto verifier = libzcash::ProofVerifier::Strict();
-            // ac_public chains set at height like KMD and ZEX, will force a rescan if we dont ignore this error: bad-txns-acpublic-chain
-            // there cannot be any ztx in the wallet on ac_public chains that started from block 1, so this wont affect those. 
-            // PIRATE fails this check for notary nodes, need exception. Triggers full rescan without it. 
-            if ( !(CheckTransaction(0,wtx, state, verifier, 0, 0) && (wtx.GetHash() == hash) && state.IsValid()) && (state.GetRejectReason() != "bad-txns-acpublic-chain" && state.GetRejectReason() != "bad-txns-acprivacy-chain" && state.GetRejectReason() != "bad-txns-stakingtx") )
-            {
-                //fprintf(stderr, "tx failed: %s rejectreason.%s\n", wtx.GetHash().GetHex().c_str(), state.GetRejectReason().c_str());
-                // vin-empty on staking chains is error relating to a failed staking tx, that for some unknown reason did not fully erase. save them here to erase and re-add later on.
-                if ( ASSETCHAINS_STAKED != 0 && state.GetRejectReason() == "bad-txns-vin-empty" )
-                    deadTxns.push_back(hash);
+            if (!LoadWalletTx(pwallet, hash, wtx, ssValue, wss, strErr))
                 return false;
-            }
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
-            {
-                if (!ssValue.empty())
-                {
-                    char fTmp;
-                    char fUnused;
-                    ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
-                                       wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                }
-                else
-                {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
-                wss.vWalletUpgrade.push_back(hash);
-            }
-
-            if (wtx.nOrderPos == -1)
-                wss.fAnyUnordered = true;
-
-            pwallet->AddToWallet(wtx, true, NULL);
         }
         else if (strType == "acentry")
         {
@@ -918,6 +963,56 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             return DB_CORRUPT;
         }
 
+        // Try to be tolerant of single corrupt records:
+        auto recordFailed = [&](const string& strType) {
+            // losing keys is considered a catastrophic error, anything else
+            // we assume the user can live with:
+            if (IsKeyType(strType))
+                result = DB_CORRUPT;
+            else
+            {
+                // Leave other errors alone, if we try to fix them we might make things worse.
+                fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
+                // set rescan for any error that is not vin-empty on staking chains.
+                if ( deadTxns.empty() && strType == "tx")
+                    SoftSetBoolArg("-rescan", true);
+            }
+        };
+
+        // The wallet txs are deserialized in batches on several threads, then
+        // checked and added in the order of the database
+        std::vector<CWalletTxRecord> txRecords;
+        size_t nTxRecordBytes = 0;
+        auto loadTxRecords = [&]() {
+            int nThreads = std::min((size_t)std::min(GetNumCores(), MAX_SCRIPTCHECK_THREADS), txRecords.size() / MIN_WALLET_TX_RECORDS_PER_THREAD);
+            if (nThreads > 1) {
+                boost::thread_group threads;
+                for (int t = 0; t < nThreads; t++)
+                    threads.create_thread(boost::bind(&DeserializeWalletTxRecords, boost::ref(txRecords),
+                                                      txRecords.size() * t / nThreads, txRecords.size() * (t + 1) / nThreads));
+                threads.join_all();
+            } else {
+                DeserializeWalletTxRecords(txRecords, 0, txRecords.size());
+            }
+            for (CWalletTxRecord& record : txRecords) {
+                string strErr;
+                bool fLoaded = false;
+                if (record.fRead) {
+                    try {
+                        fLoaded = LoadWalletTx(pwallet, record.hash, record.wtx, record.ssValue, wss, strErr);
+                    } catch (...) {
+                        fLoaded = false;
+                    }
+                }
+                if (!fLoaded)
+                    recordFailed("tx");
+                if (!strErr.empty())
+                    LogPrintf("%s\n", strErr);
+            }
+            txRecords.clear();
+            nTxRecordBytes = 0;
+        };
+
         while (true)
         {
             // Read next record
@@ -932,26 +1027,27 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
                 return DB_CORRUPT;
             }
 
-            // Try to be tolerant of single corrupt records:
             string strType, strErr;
-            if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
+            try {
+                CDataStream(ssKey) >> strType;
+            } catch (...) {
+                strType.clear();
+            }
+            if (strType == "tx")
             {
-                // losing keys is considered a catastrophic error, anything else
-                // we assume the user can live with:
-                if (IsKeyType(strType))
-                    result = DB_CORRUPT;
-                else
-                {
-                    // Leave other errors alone, if we try to fix them we might make things worse.
-                    fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
-                    // set rescan for any error that is not vin-empty on staking chains.
-                    if ( deadTxns.empty() && strType == "tx")
-                        SoftSetBoolArg("-rescan", true);
-                }
+                txRecords.push_back(CWalletTxRecord(ssKey, ssValue));
+                nTxRecordBytes += ssValue.size();
+                if (nTxRecordBytes >= WALLET_TX_RECORDS_BATCH_BYTES)
+                    loadTxRecords();
+                continue;
             }
+
+            if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
+                recordFailed(strType);
             if (!strErr.empty())
                 LogPrintf("%s\n", strErr);
         }
+        loadTxRecords();
         pcursor->close();
     }
     catch (const boost::thread_interrupted&) {
@@ -2,6 +2,7 @@
 #include "prf.h"
 #include "sodium.h"
 
+#include "zcash/Params.hpp"
 #include "zcash/util.h"
 
 #include <memory>
@@ -287,6 +288,7 @@ public:
             ss2 << inputs[1].witness.path();
             std::vector<unsigned char> auth2(ss2.begin(), ss2.end());
 
+            LoadGrothParams();
             librustzcash_sprout_prove(
                 proof.begin(),
 
@@ -0,0 +1,73 @@
+#include "zcash/Params.hpp"
+
+#include "librustzcash.h"
+#include "../util.h"
+#include "utiltime.h"
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+
+namespace libzcash {
+
+static boost::filesystem::path saplingSpendPath;
+static boost::filesystem::path saplingOutputPath;
+static boost::filesystem::path sproutGroth16Path;
+static std::once_flag grothParamsOnce;
+static std::atomic<bool> fGrothParamsLoaded(false);
+
+void SetGrothParamsPaths(const boost::filesystem::path& saplingSpend,
+                         const boost::filesystem::path& saplingOutput,
+                         const boost::filesystem::path& sproutGroth16)
+{
+    saplingSpendPath = saplingSpend;
+    saplingOutputPath = saplingOutput;
+    sproutGroth16Path = sproutGroth16;
+}
+
+static void ReadGrothParams()
+{
+    if (saplingSpendPath.empty() || saplingOutputPath.empty() || sproutGroth16Path.empty())
+        throw std::runtime_error("LoadGrothParams(): the parameter paths are not set");
+
+    static_assert(
+        sizeof(boost::filesystem::path::value_type) == sizeof(codeunit),
+        "librustzcash not configured correctly");
+    auto sapling_spend_str = saplingSpendPath.native();
+    auto sapling_output_str = saplingOutputPath.native();
+    auto sprout_groth16_str = sproutGroth16Path.native();
+
+    LogPrintf("Loading Sapling (Spend) parameters from %s\n", saplingSpendPath.string().c_str());
+    LogPrintf("Loading Sapling (Output) parameters from %s\n", saplingOutputPath.string().c_str());
+    LogPrintf("Loading Sapling (Sprout Groth16) parameters from %s\n", sproutGroth16Path.string().c_str());
+    int64_t nStart = GetTimeMicros();
+
+    librustzcash_init_zksnark_params(
+        reinterpret_cast<const codeunit*>(sapling_spend_str.c_str()),
+        sapling_spend_str.length(),
+        "8270785a1a0d0bc77196f000ee6d221c9c9894f55307bd9357c3f0105d31ca63991ab91324160d8f53e2bbd3c2633a6eb8bdf5205d822e7f3f73edac51b2b70c",
+        reinterpret_cast<const codeunit*>(sapling_output_str.c_str()),
+        sapling_output_str.length(),
+        "657e3d38dbb5cb5e7dd2970e8b03d69b4787dd907285b5a7f0790dcc8072f60bf593b32cc2d1c030e00ff5ae64bf84c5c3beb84ddc841d48264b4a171744d028",
+        reinterpret_cast<const codeunit*>(sprout_groth16_str.c_str()),
+        sprout_groth16_str.length(),
+        "e9b238411bd6c0ec4791e9d04245ec350c9c5744f5610dfcce4365d5ca49dfefd5054e371842b3f88fa1b9d7e8e075249b3ebabd167fa8b0f3161292d36c180a"
+    );
+
+    LogPrintf("Loaded Sapling parameters in %fs seconds.\n", (GetTimeMicros() - nStart) * 0.000001);
+    fGrothParamsLoaded = true;
+}
+
+void LoadGrothParams()
+{
+    if (fGrothParamsLoaded)
+        return;
+    std::call_once(grothParamsOnce, ReadGrothParams);
+}
+
+bool GrothParamsLoaded()
+{
+    return fGrothParamsLoaded;
+}
+
+}
@@ -0,0 +1,30 @@
+#ifndef ZC_PARAMS_H_
+#define ZC_PARAMS_H_
+
+#include <boost/filesystem/path.hpp>
+
+namespace libzcash {
+
+/**
+ * Remember where the Sapling spend, Sapling output and Sprout Groth16
+ * parameters are, without reading them. Those are only read by
+ * LoadGrothParams(), so a node that never sees a shielded transaction
+ * never pays for them.
+ */
+void SetGrothParamsPaths(const boost::filesystem::path& saplingSpend,
+                         const boost::filesystem::path& saplingOutput,
+                         const boost::filesystem::path& sproutGroth16);
+
+/**
+ * Read the parameters into librustzcash unless that happened already.
+ * Anything making or checking a Sapling or a Sprout Groth16 proof calls
+ * this first, it is cheap once the parameters are loaded.
+ */
+void LoadGrothParams();
+
+/** Whether LoadGrothParams() has read the parameters */
+bool GrothParamsLoaded();
+
+}
+
+#endif // ZC_PARAMS_H_
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <future>
 #include <map>
@@ -8,9 +10,15 @@
 #include "coins.h"
 #include "util.h"
 #include "init.h"
+#include "key_io.h"
+#include "komodo_defs.h"
 #include "primitives/transaction.h"
 #include "base58.h"
+#include "cc/CCinclude.h"
+#include "cc/eval.h"
 #include "crypto/equihash.h"
+#include "crypto/sha256.h"
+#include "crypto/verus_hash.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "consensus/upgrades.h"
@@ -22,7 +30,9 @@
 #include "script/sign.h"
 #include "sodium.h"
 #include "streams.h"
+#include "transaction_builder.h"
 #include "txdb.h"
+#include "txmempool.h"
 #include "utiltest.h"
 #include "wallet/wallet.h"
 
@@ -31,6 +41,7 @@
 #include "zcash/Zcash.h"
 #include "zcash/IncrementalMerkleTree.hpp"
 #include "zcash/Note.hpp"
+#include "zcash/Params.hpp"
 #include "librustzcash.h"
 
 using namespace libzcash;
@@ -59,7 +70,7 @@ void pre_wallet_load()
 }
 
 void post_wallet_load(){
-    RegisterValidationInterface(pwalletMain);
+    RegisterValidationInterface(pwalletMain, true);
 #ifdef ENABLE_MINING
     // Generate coins in the background
     if (pwalletMain || !GetArg("-mineraddress", "").empty())
@@ -475,6 +486,402 @@ double benchmark_listunspent()
     return timer_stop(tv_start);
 }
 
+// komodo_pricecorrelated on a day window of volatile prices, where few reference prices have half of the window in their interval
+double benchmark_price_correlated()
+{
+    std::vector<uint32_t> rawprices(PRICES_DAYWINDOW);
+    uint32_t price = 1000000;
+    for (auto &rawprice : rawprices) {
+        price = price * (1000 + GetRand(41) - 20) / 1000 + 1;
+        rawprice = price;
+    }
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (int32_t ind = 1; ind < 256; ind++)
+        komodo_pricecorrelated(GetRand(PRICES_DAYWINDOW), ind, rawprices.data(), 1, 0, PRICES_SMOOTHWIDTH);
+    return timer_stop(tv_start);
+}
+
+// connects nBlocks blocks of nBlockTxs txns to a coins cache on an in memory coin database, flushing the cache when
+// it grows past nCacheMiB as FlushStateToDisk does for -dbcache. Each txn spends an output of an earlier one and makes
+// two, with the coins updates of ConnectBlock
+double benchmark_coins_cache(size_t nBlocks, size_t nBlockTxs, size_t nCacheMiB)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewCache tip(&db);
+    const CScript script = CScript() << OP_TRUE;
+
+    std::vector<COutPoint> unspent;
+    CMutableTransaction mtxFund;
+    mtxFund.vout.resize(nBlockTxs, CTxOut(COIN, script));
+    CTransaction txFund(mtxFund);
+    tip.ModifyCoins(txFund.GetHash())->FromTx(txFund, 1);
+    for (size_t i = 0; i < nBlockTxs; i++)
+        unspent.push_back(COutPoint(txFund.GetHash(), i));
+
+    // the txns are made beforehand, spending random unspent outputs
+    std::vector<std::vector<CTransaction> > blocks(nBlocks);
+    uint64_t nRand = 88172645463325252ULL;
+    for (size_t b = 0; b < nBlocks; b++) {
+        for (size_t t = 0; t < nBlockTxs; t++) {
+            nRand ^= nRand << 13; nRand ^= nRand >> 7; nRand ^= nRand << 17;
+            size_t k = nRand % unspent.size();
+            CMutableTransaction mtx;
+            mtx.vin.push_back(CTxIn(unspent[k]));
+            unspent[k] = unspent.back();
+            unspent.pop_back();
+            mtx.vout.resize(2, CTxOut(COIN / 2, script));
+            blocks[b].push_back(CTransaction(mtx));
+            unspent.push_back(COutPoint(blocks[b].back().GetHash(), 0));
+            unspent.push_back(COutPoint(blocks[b].back().GetHash(), 1));
+        }
+    }
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (size_t b = 0; b < nBlocks; b++) {
+        CCoinsViewCache view(&tip);
+        for (const CTransaction &tx : blocks[b])
+            UpdateCoins(tx, view, 2 + b);
+        assert(view.Flush());
+        if (tip.DynamicMemoryUsage() > (nCacheMiB << 20))
+            assert(tip.Flush());
+    }
+    assert(tip.Flush());
+    return timer_stop(tv_start);
+}
+
+// adds nTxs txns with their address and spent index entries to a mempool and removes them.
+// The txns pay to a few addresses, as cc txns pay to the cc global addresses
+double benchmark_mempool_index(size_t nTxs)
+{
+    CTxMemPool pool(::minRelayTxFee);
+    CCoinsView dummy;
+    CCoinsViewCache view(&dummy);
+
+    std::vector<CScript> scripts;
+    for (int i = 0; i < 4; i++)
+        scripts.push_back(GetScriptForDestination(CKeyID(uint160(std::vector<unsigned char>(20, (unsigned char)i)))));
+
+    std::vector<CTransaction> vtx;
+    for (size_t i = 0; i < nTxs; i++) {
+        CMutableTransaction mtxFund;
+        mtxFund.vin.resize(1);
+        mtxFund.vin[0].prevout = COutPoint(GetRandHash(), 0);
+        mtxFund.vout.push_back(CTxOut(2 * COIN, scripts[i % scripts.size()]));
+        CTransaction txFund(mtxFund);
+        view.ModifyCoins(txFund.GetHash())->FromTx(txFund, 1);
+
+        CMutableTransaction mtx;
+        mtx.vin.push_back(CTxIn(txFund.GetHash(), 0));
+        mtx.vout.push_back(CTxOut(COIN, scripts[(i + 1) % scripts.size()]));
+        mtx.vout.push_back(CTxOut(COIN, scripts[(i + 2) % scripts.size()]));
+        vtx.push_back(CTransaction(mtx));
+    }
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (const CTransaction &tx : vtx) {
+        CTxMemPoolEntry entry(tx, 0, GetTime(), 0, 1, true, false, 0);
+        pool.addUnchecked(tx.GetHash(), entry, false);
+        pool.addAddressIndex(entry, view);
+        pool.addSpentIndex(entry, view);
+        pool.addUnspentCCIndex(entry, view);
+    }
+    for (const CTransaction &tx : vtx) {
+        std::list<CTransaction> removed;
+        pool.remove(tx, removed, false);
+    }
+    return timer_stop(tv_start);
+}
+
+// Feeds pre-made chains of transparent, Sapling and CC transactions to AcceptToMemoryPool
+// with a private pool from nThreads threads, and logs the throughput and latency percentiles.
+// Each chain is submitted in order by one thread, so in-pool parents are exercised.
+// Requires cs_main, which is released while the threads run.
+double benchmark_mempool_accept(size_t nChains, size_t nChainLength, size_t nSapling, size_t nCC, size_t nThreads)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    const int nHeight = chainActive.Height() + 1;
+    const auto consensusBranchId = CurrentEpochBranchId(nHeight, consensusParams);
+    const CAmount nFee = 10000;
+    nThreads = std::max<size_t>(nThreads, 1);
+
+    CKey priv;
+    priv.MakeNewKey(true);
+    CPubKey pub = priv.GetPubKey();
+    CBasicKeyStore keystore;
+    keystore.AddKey(priv);
+    const CScript script = GetScriptForDestination(pub.GetID());
+
+    // one funding output per chain, Sapling and CC transaction
+    CMutableTransaction mtxFund;
+    mtxFund.vin.resize(1);
+    mtxFund.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    mtxFund.vout.resize(nChains + nSapling + nCC, CTxOut(COIN, script));
+    CTransaction txFund(mtxFund);
+
+    std::vector<std::vector<CTransaction> > vChains;
+    for (size_t c = 0; c < nChains; c++) {
+        std::vector<CTransaction> chain;
+        COutPoint prevout(txFund.GetHash(), c);
+        CAmount nValue = COIN;
+        for (size_t k = 0; k < nChainLength; k++) {
+            CMutableTransaction mtx = CreateNewContextualCMutableTransaction(consensusParams, nHeight);
+            mtx.vin.push_back(CTxIn(prevout));
+            nValue -= nFee;
+            mtx.vout.push_back(CTxOut(nValue, script));
+            SignSignature(keystore, script, mtx, 0, nValue + nFee, SIGHASH_ALL, consensusBranchId);
+            chain.push_back(CTransaction(mtx));
+            prevout = COutPoint(chain.back().GetHash(), 0);
+        }
+        vChains.push_back(chain);
+    }
+    if (nSapling > 0) {
+        libzcash::LoadGrothParams();
+        auto sk = libzcash::SaplingSpendingKey::random();
+        for (size_t i = 0; i < nSapling; i++) {
+            TransactionBuilder builder(consensusParams, nHeight, &keystore);
+            builder.SetFee(nFee);
+            builder.AddTransparentInput(COutPoint(txFund.GetHash(), nChains + i), script, COIN);
+            builder.AddSaplingOutput(sk.expanded_spending_key().ovk, sk.default_address(), COIN - nFee);
+            auto tx = builder.Build();
+            if (!tx)
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Failed to build a Sapling transaction");
+            vChains.push_back(std::vector<CTransaction>(1, tx.get()));
+        }
+    }
+    for (size_t i = 0; i < nCC; i++) {
+        // a CC output with an opreturn, as most token and asset transactions have
+        CMutableTransaction mtx = CreateNewContextualCMutableTransaction(consensusParams, nHeight);
+        mtx.vin.push_back(CTxIn(txFund.GetHash(), nChains + nSapling + i));
+        mtx.vout.push_back(MakeCC1vout(EVAL_FAUCET, COIN - nFee, pub));
+        mtx.vout.push_back(CTxOut(0, CScript() << OP_RETURN << std::vector<unsigned char>(32, (unsigned char)i)));
+        SignSignature(keystore, script, mtx, 0, COIN, SIGHASH_ALL, consensusBranchId);
+        vChains.push_back(std::vector<CTransaction>(1, CTransaction(mtx)));
+    }
+
+    CTxMemPool pool(::minRelayTxFee);
+    pcoinsTip->ModifyCoins(txFund.GetHash())->FromTx(txFund, nHeight - 1);
+
+    std::atomic<size_t> nAccepted(0);
+    std::vector<std::vector<int64_t> > vLatencies(nThreads);
+    struct timeval tv_start;
+    LEAVE_CRITICAL_SECTION(cs_main);
+    timer_start(tv_start);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nThreads; t++) {
+        threads.emplace_back([&, t]() {
+            for (size_t c = t; c < vChains.size(); c += nThreads) {
+                for (const CTransaction &tx : vChains[c]) {
+                    int64_t nStart = GetTimeMicros();
+                    LOCK(cs_main);
+                    CValidationState state;
+                    if (AcceptToMemoryPool(pool, state, tx, false, NULL))
+                        nAccepted++;
+                    vLatencies[t].push_back(GetTimeMicros() - nStart);
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    double duration = timer_stop(tv_start);
+    ENTER_CRITICAL_SECTION(cs_main);
+
+    pcoinsTip->ModifyCoins(txFund.GetHash())->Clear();
+
+    std::vector<int64_t> vAll;
+    for (const std::vector<int64_t> &v : vLatencies)
+        vAll.insert(vAll.end(), v.begin(), v.end());
+    std::sort(vAll.begin(), vAll.end());
+    auto percentile = [&](double p) { return vAll.empty() ? 0 : vAll[std::min(vAll.size() - 1, (size_t)(p * vAll.size()))] * 0.001; };
+    LogPrintf("benchmark_mempool_accept: %u/%u txns accepted by %u threads in %.3fs, %.0f tx/s, latency p50 %.3fms p90 %.3fms p99 %.3fms max %.3fms\n",
+        (unsigned int)nAccepted, (unsigned int)vAll.size(), (unsigned int)nThreads, duration, duration > 0 ? vAll.size() / duration : 0,
+        percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0));
+    return duration;
+}
+
+double benchmark_hash160s(size_t nKeys)
+{
+    std::vector<uint8_t> pubkeys(nKeys * 33);
+    std::vector<uint8_t> rmd160s(nKeys * 20);
+    GetRandBytes(pubkeys.data(), pubkeys.size());
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    calc_rmd160_sha256s((uint8_t (*)[20])rmd160s.data(), pubkeys.data(), 33, nKeys);
+    return timer_stop(tv_start);
+}
+
+double benchmark_sha256(size_t nBytes)
+{
+    std::vector<unsigned char> data(nBytes);
+    GetRandBytes(data.data(), data.size());
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    CSHA256().Write(data.data(), data.size()).Finalize(hash);
+    return timer_stop(tv_start);
+}
+
+double benchmark_sha256d64(size_t nBlocks)
+{
+    std::vector<unsigned char> data(nBlocks * 64);
+    std::vector<unsigned char> hashes(nBlocks * 32);
+    GetRandBytes(data.data(), data.size());
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    SHA256D64(hashes.data(), data.data(), nBlocks);
+    return timer_stop(tv_start);
+}
+
+// VerusHash of nHashes block headers without their solution, the nonce changing
+double benchmark_verushash(size_t nHashes, bool fV2)
+{
+    std::vector<unsigned char> header(140);
+    GetRandBytes(header.data(), header.size());
+    uint256 hash;
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (size_t i = 0; i < nHashes; i++) {
+        WriteLE32(&header[108], i);
+        if (fV2)
+            CVerusHashV2::Hash(hash.begin(), header.data(), header.size());
+        else
+            CVerusHash::Hash(hash.begin(), header.data(), header.size());
+    }
+    return timer_stop(tv_start);
+}
+
+double benchmark_haraka512(size_t nHashes)
+{
+    unsigned char in[64], out[32];
+    GetRandBytes(in, sizeof(in));
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (size_t i = 0; i < nHashes; i++) {
+        (*CVerusHashV2::haraka512Function)(out, in);
+        memcpy(in, out, sizeof(out));
+    }
+    return timer_stop(tv_start);
+}
+
+static int benchmark_cc_eval(CC *cond, void *context)
+{
+    return 1;
+}
+
+// the eval code and secp256k1 key conditions of MakeCCcond1 and MakeCCcond1of2
+static CC *benchmark_cc_cond(int nPubkeys, const CKey &key)
+{
+    if (nPubkeys < 2)
+        return MakeCCcond1(EVAL_FAUCET, key.GetPubKey());
+    CKey other;
+    other.MakeNewKey(true);
+    return MakeCCcond1of2(EVAL_FAUCET, key.GetPubKey(), other.GetPubKey());
+}
+
+// each fulfillment signs its own message, the CC signature cache would answer repeated ones
+double benchmark_cc_verify(int nPubkeys, size_t nSigs)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CCwrapper cond(benchmark_cc_cond(nPubkeys, key));
+    std::vector<unsigned char> condBin(1000);
+    condBin.resize(cc_conditionBinary(cond.get(), condBin.data()));
+
+    std::vector<uint256> msgs(nSigs);
+    std::vector<CCwrapper> ffills(nSigs, cond);
+    for (size_t i = 0; i < nSigs; i++) {
+        msgs[i] = GetRandHash();
+        cc_signTreeSecp256k1Msg32(ffills[i].get(), key.begin(), msgs[i].begin());
+    }
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (size_t i = 0; i < nSigs; i++)
+        assert(cc_verify(ffills[i].get(), msgs[i].begin(), 32, 0, condBin.data(), condBin.size(), benchmark_cc_eval, NULL));
+    return timer_stop(tv_start);
+}
+
+double benchmark_cc_read_fulfillment(int nPubkeys, size_t nReads)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CCwrapper cond(benchmark_cc_cond(nPubkeys, key));
+    uint256 msg = GetRandHash();
+    cc_signTreeSecp256k1Msg32(cond.get(), key.begin(), msg.begin());
+    std::vector<unsigned char> ffillBin(10000);
+    ffillBin.resize(cc_fulfillmentBinary(cond.get(), ffillBin.data(), ffillBin.size()));
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (size_t i = 0; i < nReads; i++) {
+        CC *ffill = cc_readFulfillmentBinary(ffillBin.data(), ffillBin.size());
+        assert(ffill != NULL);
+        cc_free(ffill);
+    }
+    return timer_stop(tv_start);
+}
+
+double benchmark_stakehash(size_t nHashes)
+{
+    char address[64];
+    strcpy(address, EncodeDestination(CKeyID(uint160(std::vector<unsigned char>(20, 1)))).c_str());
+    uint8_t hashbuf[128];
+    GetRandBytes(hashbuf, sizeof(hashbuf));
+    uint256 txid = GetRandHash(), hash;
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (size_t i = 0; i < nHashes; i++)
+        komodo_stakehash(&hash, address, hashbuf, txid, i);
+    return timer_stop(tv_start);
+}
+
+// crypto_box encryption and decryption of nMessages DEX payloads of nBytes between two keys
+double benchmark_dex_cipher(size_t nMessages, size_t nBytes)
+{
+    bits256 privkey, destprivkey, destpubkey;
+    GetRandBytes(privkey.bytes, sizeof(privkey));
+    GetRandBytes(destprivkey.bytes, sizeof(destprivkey));
+    destpubkey = curve25519(destprivkey, curve25519_basepoint9());
+    std::vector<uint8_t> data(nBytes);
+    GetRandBytes(data.data(), data.size());
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (size_t i = 0; i < nMessages; i++) {
+        uint8_t *cipherptr, *msgptr, senderpub[32];
+        int32_t cipherlen, msglen;
+        uint8_t *cipher = SuperNET_ciphercalc(&cipherptr, &cipherlen, privkey, destpubkey, data.data(), data.size());
+        uint8_t *msg = SuperNET_deciphercalc(senderpub, &msgptr, &msglen, destprivkey, cipher, cipherlen);
+        assert(msg != NULL && msglen == (int32_t)nBytes);
+        free(cipherptr);
+        free(msgptr);
+    }
+    return timer_stop(tv_start);
+}
+
+// the merkle root of nLeaves hashes, as for a block, a MoM or a MoMoM
+double benchmark_merkle_root(size_t nLeaves)
+{
+    std::vector<uint256> leaves(nLeaves);
+    for (uint256 &leaf : leaves)
+        leaf = GetRandHash();
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    GetMerkleRoot(leaves);
+    return timer_stop(tv_start);
+}
+
 double benchmark_create_sapling_spend()
 {
     auto sk = libzcash::SaplingSpendingKey::random();
@@ -498,6 +905,7 @@ double benchmark_create_sapling_spend()
     uint256 alpha;
     librustzcash_sapling_generate_r(alpha.begin());
 
+    libzcash::LoadGrothParams();
     auto ctx = librustzcash_sapling_proving_ctx_init();
 
     struct timeval tv_start;
@@ -543,6 +951,7 @@ double benchmark_create_sapling_output()
     auto enc = res.get();
     auto encryptor = enc.second;
 
+    libzcash::LoadGrothParams();
     auto ctx = librustzcash_sapling_proving_ctx_init();
 
     struct timeval tv_start;
@@ -577,6 +986,7 @@ double benchmark_verify_sapling_spend()
     ss >> spend;
     uint256 dataToBeSigned = uint256S("0x2dbf83fe7b88a7cbd80fac0c719483906bb9a0c4fc69071e4780d5f2c76e592c");
 
+    libzcash::LoadGrothParams();
     auto ctx = librustzcash_sapling_verification_ctx_init();
 
     struct timeval tv_start;
@@ -610,6 +1020,7 @@ double benchmark_verify_sapling_output()
     CDataStream ss(ParseHex("edd742af18857e5ec2d71d346a7fe2ac97c137339bd5268eea86d32e0ff4f38f76213fa8cfed3347ac4e8572dd88aff395c0c10a59f8b3f49d2bc539ed6c726667e29d4763f914ddd0abf1cdfa84e44de87c233434c7e69b8b5b8f4623c8aa444163425bae5cef842972fed66046c1c6ce65c866ad894d02e6e6dcaae7a962d9f2ef95757a09c486928e61f0f7aed90ad0a542b0d3dc5fe140dfa7626b9315c77e03b055f19cbacd21a866e46f06c00e0c7792b2a590a611439b510a9aaffcf1073bad23e712a9268b36888e3727033eee2ab4d869f54a843f93b36ef489fb177bf74b41a9644e5d2a0a417c6ac1c8869bc9b83273d453f878ed6fd96b82a5939903f7b64ecaf68ea16e255a7fb7cc0b6d8b5608a1c6b0ed3024cc62c2f0f9c5cfc7b431ae6e9d40815557aa1d010523f9e1960de77b2274cb6710d229d475c87ae900183206ba90cb5bbc8ec0df98341b82726c705e0308ca5dc08db4db609993a1046dfb43dfd8c760be506c0bed799bb2205fc29dc2e654dce731034a23b0aaf6da0199248702ee0523c159f41f4cbfff6c35ace4dd9ae834e44e09c76a0cbdda1d3f6a2c75ad71212daf9575ab5f09ca148718e667f29ddf18c8a330a86ace18a86e89454653902aa393c84c6b694f27d0d42e24e7ac9fe34733de5ec15f5066081ce912c62c1a804a2bb4dedcef7cc80274f6bb9e89e2fce91dc50d6a73c8aefb9872f1cf3524a92626a0b8f39bbf7bf7d96ca2f770fc04d7f457021c536a506a187a93b2245471ddbfb254a71bc4a0d72c8d639a31c7b1920087ffca05c24214157e2e7b28184e91989ef0b14f9b34c3dc3cc0ac64226b9e337095870cb0885737992e120346e630a416a9b217679ce5a778fb15779c136bcecca5efe79012013d77d90b4e99dd22c8f35bc77121716e160d05bd30d288ee8886390ee436f85bdc9029df888a3a3326d9d4ddba5cb5318b3274928829d662e96fea1d601f7a306251ed8c6cc4e5a3a7a98c35a3650482a0eee08f3b4c2da9b22947c96138f1505c2f081f8972d429f3871f32bef4aaa51aa6945df8e9c9760531ac6f627d17c1518202818a91ca304fb4037875c666060597976144fcbbc48a776a2c61beb9515fa8f3ae6d3a041d320a38a8ac75cb47bb9c866ee497fc3cd13299970c4b369c1c2ceb4220af082fbecdd8114492a8e4d713b5a73396fd224b36c1185bd5e20d683e6c8db35346c47ae7401988255da7cfffdced5801067d4d296688ee8fe424b4a8a69309ce257eefb9345ebfda3f6de46bb11ec94133e1f72cd7ac54934d6cf17b3440800e70b80ebc7c7bfc6fb0fc2c"), SER_NETWORK, PROTOCOL_VERSION);
     ss >> output;
 
+    libzcash::LoadGrothParams();
     auto ctx = librustzcash_sapling_verification_ctx_init();
 
     struct timeval tv_start;
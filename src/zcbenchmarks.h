@@ -19,6 +19,20 @@ extern double benchmark_connectblock_slow();
 extern double benchmark_sendtoaddress(CAmount amount);
 extern double benchmark_loadwallet();
 extern double benchmark_listunspent();
+extern double benchmark_price_correlated();
+extern double benchmark_mempool_index(size_t nTxs);
+extern double benchmark_mempool_accept(size_t nChains, size_t nChainLength, size_t nSapling, size_t nCC, size_t nThreads);
+extern double benchmark_coins_cache(size_t nBlocks, size_t nBlockTxs, size_t nCacheMiB);
+extern double benchmark_hash160s(size_t nKeys);
+extern double benchmark_sha256(size_t nBytes);
+extern double benchmark_sha256d64(size_t nBlocks);
+extern double benchmark_verushash(size_t nHashes, bool fV2);
+extern double benchmark_haraka512(size_t nHashes);
+extern double benchmark_cc_verify(int nPubkeys, size_t nSigs);
+extern double benchmark_cc_read_fulfillment(int nPubkeys, size_t nReads);
+extern double benchmark_stakehash(size_t nHashes);
+extern double benchmark_dex_cipher(size_t nMessages, size_t nBytes);
+extern double benchmark_merkle_root(size_t nLeaves);
 extern double benchmark_create_sapling_spend();
 extern double benchmark_create_sapling_output();
 extern double benchmark_verify_sapling_spend();
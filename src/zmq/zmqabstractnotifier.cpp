@@ -25,3 +25,23 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyCCEvent(const std::string &/*event*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyTransactionRemoved(const CTransaction &/*transaction*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyNotarized(const std::string &/*event*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyChainEvent(const CChainEvent &/*event*/)
+{
+    return true;
+}
@@ -8,6 +8,7 @@
 #include "zmqconfig.h"
 
 class CBlockIndex;
+struct CChainEvent;
 class CZMQAbstractNotifier;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
@@ -35,6 +36,12 @@ public:
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyBlock(const CBlock& pblock);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    //! event is the JSON of CCEventToJSON, of a tx NotifyTransaction was called for
+    virtual bool NotifyCCEvent(const std::string &event);
+    virtual bool NotifyTransactionRemoved(const CTransaction &transaction);
+    //! event is the JSON of NotarizationEventToJSON
+    virtual bool NotifyNotarized(const std::string &event);
+    virtual bool NotifyChainEvent(const CChainEvent &event);
 
 protected:
     void *psocket;
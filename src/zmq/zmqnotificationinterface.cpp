@@ -5,6 +5,7 @@
 #include "zmqnotificationinterface.h"
 #include "zmqpublishnotifier.h"
 
+#include "cc/CCevents.h"
 #include "version.h"
 #include "main.h"
 #include "streams.h"
@@ -15,7 +16,7 @@ void zmqError(const char *str)
     LogPrint("zmq", "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
 }
 
-CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL)
+CZMQNotificationInterface::CZMQNotificationInterface() : fCCEvents(false), pcontext(NULL)
 {
 }
 
@@ -40,6 +41,10 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
     factories["pubcheckedblock"] = CZMQAbstractNotifier::Create<CZMQPublishCheckedBlockNotifier>;
+    factories["pubccevent"] = CZMQAbstractNotifier::Create<CZMQPublishCCEventNotifier>;
+    factories["pubremovedtx"] = CZMQAbstractNotifier::Create<CZMQPublishRemovedTransactionNotifier>;
+    factories["pubnotarized"] = CZMQAbstractNotifier::Create<CZMQPublishNotarizedNotifier>;
+    factories["pubsequence"] = CZMQAbstractNotifier::Create<CZMQPublishSequenceNotifier>;
 
     for (std::map<std::string, CZMQNotifierFactory>::const_iterator i=factories.begin(); i!=factories.end(); ++i)
     {
@@ -59,6 +64,7 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
     {
         notificationInterface = new CZMQNotificationInterface();
         notificationInterface->notifiers = notifiers;
+        notificationInterface->fCCEvents = args.count("-zmqpubccevent") != 0;
 
         if (!notificationInterface->Initialize())
         {
@@ -164,11 +170,72 @@ void CZMQNotificationInterface::BlockChecked(const CBlock& block, const CValidat
 }
 
 void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
+{
+    // decoded once for all the notifiers
+    std::string strCCEvent;
+    UniValue ccEvent;
+    if (fCCEvents && CCEventToJSON(tx, ccEvent)) {
+        if (pblock != NULL)
+            ccEvent.push_back(Pair("blockhash", pblock->GetHash().GetHex()));
+        strCCEvent = ccEvent.write();
+    }
+
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyTransaction(tx) && (strCCEvent.empty() || notifier->NotifyCCEvent(strCCEvent)))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void CZMQNotificationInterface::TransactionRemovedFromMempool(const CTransaction &tx)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyTransactionRemoved(tx))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void CZMQNotificationInterface::Notarized(int32_t height, int32_t notarizedHeight, const uint256 &notarizedHash, const uint256 &destTxid, const uint256 &txid)
+{
+    std::string strEvent = NotarizationEventToJSON(height, notarizedHeight, notarizedHash, destTxid, txid).write();
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyNotarized(strEvent))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void CZMQNotificationInterface::ChainEvent(const CChainEvent &event)
 {
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
+        if (notifier->NotifyChainEvent(event))
         {
             i++;
         }
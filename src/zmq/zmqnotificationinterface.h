@@ -28,10 +28,16 @@ protected:
     void SyncTransaction(const CTransaction &tx, const CBlock *pblock);
     void UpdatedBlockTip(const CBlockIndex *pindex);
     void BlockChecked(const CBlock& block, const CValidationState& state);
+    void TransactionRemovedFromMempool(const CTransaction &tx);
+    void Notarized(int32_t height, int32_t notarizedHeight, const uint256 &notarizedHash, const uint256 &destTxid, const uint256 &txid);
+    void ChainEvent(const CChainEvent &event);
 
 private:
     CZMQNotificationInterface();
 
+    //! whether a notifier publishes CC events, so the txs need decoding
+    bool fCCEvents;
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
 };
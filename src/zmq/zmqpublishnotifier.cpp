@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "zmqpublishnotifier.h"
+#include "chaineventlog.h"
 #include "main.h"
 #include "util.h"
 
@@ -13,6 +14,10 @@ static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
 static const char *MSG_CHECKEDBLOCK = "checkedblock";
+static const char *MSG_CCEVENT   = "ccevent";
+static const char *MSG_REMOVEDTX = "removedtx";
+static const char *MSG_NOTARIZED = "notarized";
+static const char *MSG_SEQUENCE  = "sequence";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -204,3 +209,36 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishCCEventNotifier::NotifyCCEvent(const std::string &event)
+{
+    LogPrint("zmq", "zmq: Publish ccevent %s\n", event);
+    return SendMessage(MSG_CCEVENT, event.data(), event.size());
+}
+
+bool CZMQPublishRemovedTransactionNotifier::NotifyTransactionRemoved(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint("zmq", "zmq: Publish removedtx %s\n", hash.GetHex());
+    char data[32];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    return SendMessage(MSG_REMOVEDTX, data, 32);
+}
+
+bool CZMQPublishNotarizedNotifier::NotifyNotarized(const std::string &event)
+{
+    LogPrint("zmq", "zmq: Publish notarized %s\n", event);
+    return SendMessage(MSG_NOTARIZED, event.data(), event.size());
+}
+
+bool CZMQPublishSequenceNotifier::NotifyChainEvent(const CChainEvent &event)
+{
+    LogPrint("zmq", "zmq: Publish sequence %s %s %u\n", event.TypeName(), event.hash.GetHex(), event.nSequence);
+    unsigned char data[32 + 1 + sizeof(uint64_t)];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = event.hash.begin()[i];
+    data[32] = event.type;
+    WriteLE64(&data[33], event.nSequence);
+    return SendMessage(MSG_SEQUENCE, data, sizeof(data));
+}
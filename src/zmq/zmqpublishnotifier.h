@@ -52,6 +52,31 @@ public:
     bool NotifyTransaction(const CTransaction &transaction);
 };
 
+class CZMQPublishCCEventNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyCCEvent(const std::string &event);
+};
+
+class CZMQPublishRemovedTransactionNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionRemoved(const CTransaction &transaction);
+};
+
+class CZMQPublishNotarizedNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyNotarized(const std::string &event);
+};
+
+/** Publishes the chain event log: the hash, the event type byte and the LE 8 byte event sequence number */
+class CZMQPublishSequenceNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyChainEvent(const CChainEvent &event);
+};
+
 class CZMQPublishCheckedBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public: